@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_BENCH_HELPERS_HPP_INCLUDED
+#define UAVCAN_BENCH_HELPERS_HPP_INCLUDED
+
+#include <uavcan/driver/can.hpp>
+#include <uavcan/driver/system_clock.hpp>
+
+/**
+ * Clock that advances by one microsecond per reading, so that the timestamps are monotonic and nothing expires.
+ */
+class BenchClock : public uavcan::ISystemClock
+{
+    mutable uavcan::uint64_t monotonic_;
+
+public:
+    BenchClock() : monotonic_(1000000) { }
+
+    virtual uavcan::MonotonicTime getMonotonic() const
+    {
+        return uavcan::MonotonicTime::fromUSec(monotonic_++);
+    }
+
+    virtual uavcan::UtcTime getUtc() const { return uavcan::UtcTime::fromUSec(monotonic_); }
+
+    virtual void adjustUtc(uavcan::UtcDuration) { }
+};
+
+/**
+ * Single interface that accepts every frame and receives the same frame a given number of times.
+ */
+class BenchCanDriver : public uavcan::ICanDriver
+                     , public uavcan::ICanIface
+{
+    const uavcan::ISystemClock& clock_;
+    uavcan::CanFrame rx_frame_;
+    unsigned num_pending_rx_;
+
+public:
+    explicit BenchCanDriver(const uavcan::ISystemClock& clock)
+        : clock_(clock)
+        , num_pending_rx_(0)
+    { }
+
+    void setRxFrame(const uavcan::CanFrame& frame, unsigned count)
+    {
+        rx_frame_ = frame;
+        num_pending_rx_ = count;
+    }
+
+    virtual uavcan::int16_t send(const uavcan::CanFrame&, uavcan::MonotonicTime, uavcan::CanIOFlags) { return 1; }
+
+    virtual uavcan::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                                    uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags)
+    {
+        if (num_pending_rx_ == 0)
+        {
+            return 0;
+        }
+        num_pending_rx_--;
+        out_frame = rx_frame_;
+        out_ts_monotonic = clock_.getMonotonic();
+        out_ts_utc = uavcan::UtcTime();
+        out_flags = 0;
+        return 1;
+    }
+
+    virtual uavcan::int16_t configureFilters(const uavcan::CanFilterConfig*, uavcan::uint16_t) { return 0; }
+    virtual uavcan::uint16_t getNumFilters() const { return 0; }
+    virtual uavcan::uint64_t getErrorCount() const { return 0; }
+
+    virtual uavcan::ICanIface* getIface(uavcan::uint8_t iface_index)
+    {
+        return (iface_index == 0) ? this : UAVCAN_NULLPTR;
+    }
+    virtual const uavcan::ICanIface* getIface(uavcan::uint8_t iface_index) const
+    {
+        return (iface_index == 0) ? this : UAVCAN_NULLPTR;
+    }
+    virtual uavcan::uint8_t getNumIfaces() const { return 1; }
+
+    virtual uavcan::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                                   const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                                   uavcan::MonotonicTime)
+    {
+        inout_masks.read = uavcan::uint8_t(inout_masks.read & ((num_pending_rx_ > 0) ? 1U : 0U));
+        inout_masks.write = uavcan::uint8_t(inout_masks.write & 1U);
+        return 1;
+    }
+};
+
+#endif // UAVCAN_BENCH_HELPERS_HPP_INCLUDED
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ *
+ * End-to-end latency from the publication of a message to the invocation of the subscription callback on another
+ * node, through the whole stack. Two nodes are connected over a simulated bus that timestamps every frame when it is
+ * accepted for transmission and when it is received, like the TX loopback and RX timestamps of a real driver. The
+ * latency is split into the following stages, each reported as p50/p99/p99.9 in nanoseconds:
+ *
+ *  tx    - from the publish call until the last frame of the transfer is accepted by the driver: encoding, transfer
+ *          sender, TX queue
+ *  bus   - from the transmission of the last frame until it is received by the other node; the simulated bus is
+ *          instant, so this is the time the receiving node spends on the preceding frames of the transfer
+ *  rx    - from the reception of the last frame until the callback is invoked: dispatcher, reassembly, decoding
+ *  total - from the publish call until the callback is invoked
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <uavcan/node/abstract_node.hpp>
+#include <uavcan/node/publisher.hpp>
+#include <uavcan/node/subscriber.hpp>
+#include <uavcan/protocol/debug/LogMessage.hpp>
+
+namespace
+{
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+inline TimePoint now() { return std::chrono::steady_clock::now(); }
+
+inline double nanosecondsBetween(TimePoint a, TimePoint b)
+{
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(b - a).count());
+}
+
+/**
+ * The library needs the real time here, since the measured intervals are reported by the same clock.
+ */
+class SteadyClock : public uavcan::ISystemClock
+{
+public:
+    virtual uavcan::MonotonicTime getMonotonic() const
+    {
+        return uavcan::MonotonicTime::fromUSec(uavcan::uint64_t(
+            std::chrono::duration_cast<std::chrono::microseconds>(now().time_since_epoch()).count()));
+    }
+
+    virtual uavcan::UtcTime getUtc() const { return uavcan::UtcTime(); }
+
+    virtual void adjustUtc(uavcan::UtcDuration) { }
+};
+
+/**
+ * Single interface attached to the simulated bus. The bus has no arbitration and never loses frames; every frame is
+ * delivered to the peer with the timestamp of its transmission.
+ */
+class SimulatedBusDriver : public uavcan::ICanDriver
+                         , public uavcan::ICanIface
+{
+    struct TimestampedFrame
+    {
+        uavcan::CanFrame frame;
+        TimePoint tx_timestamp;
+        uavcan::CanIOFlags flags;
+    };
+
+    const uavcan::ISystemClock& clock_;
+    SimulatedBusDriver* peer_;
+    std::deque<TimestampedFrame> rx_queue_;
+
+public:
+    TimePoint last_tx_timestamp;    ///< Transmission of the last frame sent by this node
+    TimePoint last_rx_timestamp;    ///< Reception of the last frame received by this node
+
+    explicit SimulatedBusDriver(const uavcan::ISystemClock& clock)
+        : clock_(clock)
+        , peer_(UAVCAN_NULLPTR)
+    { }
+
+    void connect(SimulatedBusDriver& peer)
+    {
+        peer_ = &peer;
+        peer.peer_ = this;
+    }
+
+    virtual uavcan::int16_t send(const uavcan::CanFrame& frame, uavcan::MonotonicTime, uavcan::CanIOFlags flags)
+    {
+        TimestampedFrame tf;
+        tf.frame = frame;
+        tf.tx_timestamp = now();
+        tf.flags = 0;
+        last_tx_timestamp = tf.tx_timestamp;
+        if (peer_ != UAVCAN_NULLPTR)
+        {
+            peer_->rx_queue_.push_back(tf);
+        }
+        if ((flags & uavcan::CanIOFlagLoopback) != 0)
+        {
+            tf.flags = uavcan::CanIOFlagLoopback;
+            rx_queue_.push_back(tf);
+        }
+        return 1;
+    }
+
+    virtual uavcan::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                                    uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags)
+    {
+        if (rx_queue_.empty())
+        {
+            return 0;
+        }
+        last_rx_timestamp = now();
+        out_frame = rx_queue_.front().frame;
+        out_flags = rx_queue_.front().flags;
+        out_ts_monotonic = clock_.getMonotonic();
+        out_ts_utc = uavcan::UtcTime();
+        rx_queue_.pop_front();
+        return 1;
+    }
+
+    virtual uavcan::int16_t configureFilters(const uavcan::CanFilterConfig*, uavcan::uint16_t) { return 0; }
+    virtual uavcan::uint16_t getNumFilters() const { return 0; }
+    virtual uavcan::uint64_t getErrorCount() const { return 0; }
+
+    virtual uavcan::ICanIface* getIface(uavcan::uint8_t iface_index)
+    {
+        return (iface_index == 0) ? this : UAVCAN_NULLPTR;
+    }
+    virtual const uavcan::ICanIface* getIface(uavcan::uint8_t iface_index) const
+    {
+        return (iface_index == 0) ? this : UAVCAN_NULLPTR;
+    }
+    virtual uavcan::uint8_t getNumIfaces() const { return 1; }
+
+    virtual uavcan::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                                   const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                                   uavcan::MonotonicTime)
+    {
+        inout_masks.read = uavcan::uint8_t(inout_masks.read & (rx_queue_.empty() ? 0U : 1U));
+        inout_masks.write = uavcan::uint8_t(inout_masks.write & 1U);
+        return 1;
+    }
+};
+
+typedef uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 256, uavcan::MemPoolBlockSize> BenchPool;
+
+class BenchNode : public uavcan::INode
+{
+    std::unique_ptr<BenchPool> pool_;
+    uavcan::Scheduler scheduler_;
+
+public:
+    BenchNode(uavcan::ICanDriver& driver, uavcan::ISystemClock& clock, uavcan::NodeID node_id)
+        : pool_(new BenchPool)
+        , scheduler_(driver, *pool_, clock)
+    {
+        setNodeID(node_id);
+    }
+
+    virtual void registerInternalFailure(const char*) { }
+    virtual uavcan::IPoolAllocator& getAllocator() { return *pool_; }
+    virtual uavcan::Scheduler& getScheduler() { return scheduler_; }
+    virtual const uavcan::Scheduler& getScheduler() const { return scheduler_; }
+};
+
+/**
+ * Samples of one stage, in nanoseconds.
+ */
+class StageSamples
+{
+    std::vector<double> samples_;
+
+    double getPercentile(double p)
+    {
+        const std::size_t index = std::min(samples_.size() - 1, std::size_t(p * double(samples_.size())));
+        std::nth_element(samples_.begin(), samples_.begin() + std::ptrdiff_t(index), samples_.end());
+        return samples_[index];
+    }
+
+public:
+    void add(double ns) { samples_.push_back(ns); }
+
+    void report(benchmark::State& state, const char* stage)
+    {
+        if (samples_.empty())
+        {
+            return;
+        }
+        const std::string prefix(stage);
+        state.counters[prefix + "_p50_ns"] = getPercentile(0.5);
+        state.counters[prefix + "_p99_ns"] = getPercentile(0.99);
+        state.counters[prefix + "_p999_ns"] = getPercentile(0.999);
+    }
+};
+
+/*
+ * Publication of the log message with the text of the given length; the second argument enables CAN FD.
+ * The text length defines the number of frames: 0 fits a single classic frame, 40 fits a single CAN FD frame,
+ * and 80 takes two CAN FD frames or a dozen classic frames.
+ */
+void EndToEndLatency(benchmark::State& state)
+{
+    typedef uavcan::protocol::debug::LogMessage Message;
+
+    SteadyClock clock;
+    SimulatedBusDriver driver_a(clock);
+    SimulatedBusDriver driver_b(clock);
+    driver_a.connect(driver_b);
+    BenchNode node_a(driver_a, clock, 1);
+    BenchNode node_b(driver_b, clock, 2);
+    if (state.range(1) != 0)
+    {
+        node_a.enableCanFd();
+        node_b.enableCanFd();
+    }
+
+    Message msg;
+    for (int i = 0; i < state.range(0); i++)
+    {
+        msg.text.push_back(uavcan::uint8_t('a' + (i % 26)));
+    }
+
+    TimePoint callback_timestamp;
+    unsigned num_received = 0;
+    uavcan::Subscriber<Message> sub(node_b);
+    if (sub.start([&](const Message&) { callback_timestamp = now(); num_received++; }) < 0)
+    {
+        state.SkipWithError("Subscriber failed");
+        return;
+    }
+    uavcan::Publisher<Message> pub(node_a);
+    if (pub.init() < 0)
+    {
+        state.SkipWithError("Publisher failed");
+        return;
+    }
+
+    StageSamples tx;
+    StageSamples bus;
+    StageSamples rx;
+    StageSamples total;
+
+    for (auto _ : state)
+    {
+        const unsigned expected_num_received = num_received + 1;
+        const TimePoint publish_timestamp = now();
+        if (pub.broadcast(msg) < 0)
+        {
+            state.SkipWithError("Publication failed");
+            return;
+        }
+        (void)node_a.spinOnce();                // Flushes the TX queue, should there be anything left
+        for (unsigned i = 0; (i < 100) && (num_received != expected_num_received); i++)
+        {
+            (void)node_b.spinOnce();
+        }
+        if (num_received != expected_num_received)
+        {
+            state.SkipWithError("Message was not delivered");
+            return;
+        }
+
+        tx.add(nanosecondsBetween(publish_timestamp, driver_a.last_tx_timestamp));
+        bus.add(nanosecondsBetween(driver_a.last_tx_timestamp, driver_b.last_rx_timestamp));
+        rx.add(nanosecondsBetween(driver_b.last_rx_timestamp, callback_timestamp));
+        total.add(nanosecondsBetween(publish_timestamp, callback_timestamp));
+    }
+
+    tx.report(state, "tx");
+    bus.report(state, "bus");
+    rx.report(state, "rx");
+    total.report(state, "total");
+}
+BENCHMARK(EndToEndLatency)->Args({ 0, 0 })->Args({ 80, 0 })
+#if UAVCAN_SUPPORT_CANFD
+                          ->Args({ 40, 1 })->Args({ 80, 1 })
+#endif
+                          ;
+
+}
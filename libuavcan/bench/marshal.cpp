@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <uavcan/marshal/bit_stream.hpp>
+#include <uavcan/marshal/scalar_codec.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
+#include <uavcan/protocol/NodeStatus.hpp>
+#include <uavcan/protocol/GetNodeInfo.hpp>
+
+namespace
+{
+/*
+ * Copy of the given number of bits; the second argument is the source and destination bit offset, where zero
+ * stands for the byte aligned case
+ */
+void BitarrayCopy(benchmark::State& state)
+{
+    const std::size_t num_bits = std::size_t(state.range(0));
+    const std::size_t offset = std::size_t(state.range(1));
+    std::vector<unsigned char> src((num_bits + offset + 7) / 8 + 1, 0x5A);
+    std::vector<unsigned char> dst(src.size(), 0);
+
+    for (auto _ : state)
+    {
+        uavcan::bitarrayCopy(src.data(), offset, num_bits, dst.data(), (offset * 3) % 8);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(num_bits / 8));
+}
+BENCHMARK(BitarrayCopy)->Args({ 13, 0 })->Args({ 13, 3 })->Args({ 512, 0 })->Args({ 512, 3 });
+
+/*
+ * Write and read back of the given number of 13-bit fields via a static transfer buffer
+ */
+void BitStreamWriteRead(benchmark::State& state)
+{
+    const unsigned num_fields = unsigned(state.range(0));
+    uavcan::StaticTransferBuffer<1024> buf;
+    const uavcan::uint8_t field[2] = { 0xA5, 0xF8 };
+    uavcan::uint8_t out[2] = { 0, 0 };
+
+    for (auto _ : state)
+    {
+        buf.setMaxWritePos(0);
+        uavcan::BitStream writer(buf);
+        for (unsigned i = 0; i < num_fields; i++)
+        {
+            benchmark::DoNotOptimize(writer.write(field, 13));
+        }
+        uavcan::BitStream reader(buf);
+        for (unsigned i = 0; i < num_fields; i++)
+        {
+            benchmark::DoNotOptimize(reader.read(out, 13));
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BitStreamWriteRead)->Arg(1)->Arg(16)->Arg(256);
+
+/*
+ * Generated codecs of a small single frame message and of a large service response with strings and arrays
+ */
+uavcan::protocol::NodeStatus makeNodeStatus()
+{
+    uavcan::protocol::NodeStatus msg;
+    msg.uptime_sec = 123456;
+    msg.health = msg.HEALTH_WARNING;
+    msg.mode = msg.MODE_OPERATIONAL;
+    msg.vendor_specific_status_code = 0xBEEF;
+    return msg;
+}
+
+uavcan::protocol::GetNodeInfo::Response makeNodeInfo()
+{
+    uavcan::protocol::GetNodeInfo::Response msg;
+    msg.status = makeNodeStatus();
+    msg.software_version.major = 1;
+    msg.software_version.minor = 2;
+    msg.software_version.vcs_commit = 0xDEADBEEF;
+    msg.hardware_version.major = 3;
+    for (unsigned i = 0; i < msg.hardware_version.unique_id.size(); i++)
+    {
+        msg.hardware_version.unique_id[i] = uavcan::uint8_t(i);
+    }
+    msg.name = "org.uavcan.libuavcan.benchmark.node";
+    return msg;
+}
+
+template <typename T>
+void encode(benchmark::State& state, const T& msg)
+{
+    uavcan::StaticTransferBuffer<(T::MaxBitLen + 7) / 8> buf;
+    for (auto _ : state)
+    {
+        buf.setMaxWritePos(0);
+        uavcan::BitStream bitstream(buf);
+        uavcan::ScalarCodec codec(bitstream);
+        benchmark::DoNotOptimize(T::encode(msg, codec));
+    }
+}
+
+template <typename T>
+void decode(benchmark::State& state, const T& msg)
+{
+    uavcan::StaticTransferBuffer<(T::MaxBitLen + 7) / 8> buf;
+    {
+        uavcan::BitStream bitstream(buf);
+        uavcan::ScalarCodec codec(bitstream);
+        if (T::encode(msg, codec) <= 0)
+        {
+            state.SkipWithError("Encoding failed");
+            return;
+        }
+    }
+    const unsigned len = buf.getMaxWritePos();
+
+    T decoded;
+    for (auto _ : state)
+    {
+        // Decoding from contiguous memory, like the subscribers do for single frame transfers
+        uavcan::BitStream bitstream(buf.getRawPtr(), len);
+        uavcan::ScalarCodec codec(bitstream);
+        benchmark::DoNotOptimize(T::decode(decoded, codec));
+    }
+}
+
+void NodeStatusEncode(benchmark::State& state) { encode(state, makeNodeStatus()); }
+void NodeStatusDecode(benchmark::State& state) { decode(state, makeNodeStatus()); }
+void GetNodeInfoResponseEncode(benchmark::State& state) { encode(state, makeNodeInfo()); }
+void GetNodeInfoResponseDecode(benchmark::State& state) { decode(state, makeNodeInfo()); }
+BENCHMARK(NodeStatusEncode);
+BENCHMARK(NodeStatusDecode);
+BENCHMARK(GetNodeInfoResponseEncode);
+BENCHMARK(GetNodeInfoResponseDecode);
+
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <memory>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <uavcan/node/scheduler.hpp>
+#include "bench_helpers.hpp"
+
+namespace
+{
+
+typedef uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 1024, uavcan::MemPoolBlockSize> BenchPool;
+
+class BenchDeadlineHandler : public uavcan::DeadlineHandler
+{
+public:
+    explicit BenchDeadlineHandler(uavcan::Scheduler& scheduler)
+        : uavcan::DeadlineHandler(scheduler)
+    { }
+
+    virtual void handleDeadline(uavcan::MonotonicTime) override { }
+};
+
+/*
+ * Start and stop of one deadline handler while the given number of other handlers are running; the deadlines are
+ * pseudo-random within a few seconds, like those of the timers of a typical node
+ */
+void DeadlineSchedulerAddRemove(benchmark::State& state)
+{
+    const unsigned num_running = unsigned(state.range(0));
+
+    BenchClock clock;
+    BenchCanDriver driver(clock);
+    std::unique_ptr<BenchPool> pool(new BenchPool);
+    uavcan::Scheduler scheduler(driver, *pool, clock);
+
+    uavcan::uint32_t lcg = 12345;
+    const auto next_deadline = [&lcg, &clock]()
+    {
+        lcg = lcg * 1103515245U + 12345U;
+        return clock.getMonotonic() + uavcan::MonotonicDuration::fromUSec(1000 + (lcg >> 8) % 5000000U);
+    };
+
+    std::vector<std::unique_ptr<BenchDeadlineHandler> > handlers;
+    for (unsigned i = 0; i < num_running; i++)
+    {
+        handlers.push_back(std::unique_ptr<BenchDeadlineHandler>(new BenchDeadlineHandler(scheduler)));
+        handlers.back()->startWithDeadline(next_deadline());
+    }
+
+    BenchDeadlineHandler handler(scheduler);
+    for (auto _ : state)
+    {
+        handler.startWithDeadline(next_deadline());
+        handler.stop();
+    }
+}
+BENCHMARK(DeadlineSchedulerAddRemove)->Arg(0)->Arg(8)->Arg(64)->Arg(512);
+
+}
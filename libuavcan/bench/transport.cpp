@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <deque>
+#include <memory>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <uavcan/transport/crc.hpp>
+#include <uavcan/transport/dispatcher.hpp>
+#include <uavcan/transport/transfer_receiver.hpp>
+#include "bench_helpers.hpp"
+
+namespace
+{
+
+typedef uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 4096, uavcan::MemPoolBlockSize> BenchPool;
+
+const uavcan::uint8_t Payload[7] = { 1, 2, 3, 4, 5, 6, 7 };
+
+class BenchListener : public uavcan::TransferListener
+{
+public:
+    unsigned num_transfers;
+
+    BenchListener(uavcan::TransferPerfCounter& perf, const uavcan::DataTypeDescriptor& data_type,
+                  uavcan::IPoolAllocator& allocator)
+        : uavcan::TransferListener(perf, data_type, 256, allocator)
+        , num_transfers(0)
+    { }
+
+    virtual void handleIncomingTransfer(uavcan::IncomingTransfer&) override { num_transfers++; }
+};
+
+/*
+ * Transfer CRC over the payload of the given length
+ */
+void TransferCRCAdd(benchmark::State& state)
+{
+    const std::vector<uavcan::uint8_t> data(std::size_t(state.range(0)), 0xA5);
+    for (auto _ : state)
+    {
+        uavcan::TransferCRC crc;
+        crc.add(data.data(), unsigned(data.size()));
+        benchmark::DoNotOptimize(crc.get());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(TransferCRCAdd)->Arg(7)->Arg(64)->Arg(256)->Arg(1024);
+
+/*
+ * Reception of a single frame message by the dispatcher with the given number of listeners; the frame goes
+ * through the driver interface, the dispatcher, and the listener of the last registered data type
+ */
+void DispatcherHandleFrame(benchmark::State& state)
+{
+    const unsigned num_listeners = unsigned(state.range(0));
+
+    BenchClock clock;
+    BenchCanDriver driver(clock);
+    std::unique_ptr<BenchPool> pool(new BenchPool);
+    uavcan::Dispatcher dispatcher(driver, *pool, clock);
+    (void)dispatcher.setNodeID(1);
+
+    std::deque<uavcan::DataTypeDescriptor> data_types;
+    std::vector<std::unique_ptr<BenchListener> > listeners;
+    for (unsigned i = 0; i < num_listeners; i++)
+    {
+        const uavcan::DataTypeID dtid(uavcan::uint16_t(100 + i));
+        data_types.push_back(uavcan::DataTypeDescriptor(uavcan::DataTypeKindMessage, dtid,
+                                                        uavcan::DataTypeSignature(0x123456789ULL + i), "bench.Msg"));
+        listeners.push_back(std::unique_ptr<BenchListener>(new BenchListener(dispatcher.getTransferPerfCounter(),
+                                                                             data_types.back(), *pool)));
+        (void)dispatcher.registerMessageListener(listeners.back().get());
+    }
+
+    uavcan::Frame frame(uavcan::DataTypeID(uavcan::uint16_t(100 + num_listeners - 1)),
+                        uavcan::TransferTypeMessageBroadcast, 42, uavcan::NodeID::Broadcast, 0);
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    (void)frame.setPayload(Payload, sizeof(Payload));
+    uavcan::CanFrame can_frame;
+    (void)frame.compile(can_frame);
+
+    uavcan::TransferID tid;
+    for (auto _ : state)
+    {
+        // Every transfer gets a new transfer ID, otherwise it would be discarded as a duplicate
+        can_frame.data[can_frame.dlc - 1] = uavcan::Frame::compileTailByte(tid, true, true, false);
+        tid.increment();
+        driver.setRxFrame(can_frame, 1);
+        benchmark::DoNotOptimize(dispatcher.spinOnce());
+    }
+
+    if (listeners.back()->num_transfers != state.iterations())
+    {
+        state.SkipWithError("Transfers were lost");
+    }
+}
+BENCHMARK(DispatcherHandleFrame)->Arg(1)->Arg(8)->Arg(32)->Arg(128);
+
+/*
+ * Reassembly of a multi-frame transfer of the given number of frames
+ */
+void TransferReceiverReassembly(benchmark::State& state)
+{
+    const unsigned num_frames = unsigned(state.range(0));
+    const uavcan::TransferBufferManagerKey key(42, uavcan::TransferTypeMessageBroadcast);
+
+    std::unique_ptr<BenchPool> pool(new BenchPool);
+    uavcan::TransferBufferManager bufmgr(uavcan::uint16_t(num_frames * sizeof(Payload)), *pool);
+    uavcan::TransferReceiver receiver;
+
+    // The frames of all transfer IDs are prepared beforehand
+    std::vector<uavcan::Frame> frames;
+    for (unsigned tid = 0; tid <= uavcan::TransferID::Max; tid++)
+    {
+        for (unsigned i = 0; i < num_frames; i++)
+        {
+            uavcan::Frame frame(200, uavcan::TransferTypeMessageBroadcast, 42, uavcan::NodeID::Broadcast,
+                                uavcan::TransferID(uavcan::uint8_t(tid)));
+            frame.setStartOfTransfer(i == 0);
+            frame.setEndOfTransfer(i == (num_frames - 1));
+            if ((i % 2) != 0)
+            {
+                frame.flipToggle();
+            }
+            (void)frame.setPayload(Payload, sizeof(Payload));
+            frames.push_back(frame);
+        }
+    }
+
+    uavcan::uint64_t ts_usec = 1000000;
+    unsigned tid = 0;
+    unsigned num_completed = 0;
+    for (auto _ : state)
+    {
+        uavcan::TransferBufferAccessor tba(bufmgr, key);
+        for (unsigned i = 0; i < num_frames; i++)
+        {
+            const uavcan::RxFrame rx_frame(frames[tid * num_frames + i], uavcan::MonotonicTime::fromUSec(ts_usec++),
+                                           uavcan::UtcTime(), 0);
+            if (receiver.addFrame(rx_frame, tba) == uavcan::TransferReceiver::ResultComplete)
+            {
+                num_completed++;
+            }
+        }
+        tba.remove();
+        tid = (tid + 1U) % (uavcan::TransferID::Max + 1U);
+    }
+    receiver = uavcan::TransferReceiver();
+
+    if (num_completed != state.iterations())
+    {
+        state.SkipWithError("Transfers were not completed");
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(TransferReceiverReassembly)->Arg(2)->Arg(8)->Arg(32);
+
+/*
+ * Push and peek/remove of one frame at the given queue depth; the priorities are pseudo-random
+ */
+void CanTxQueuePushPeek(benchmark::State& state)
+{
+    const unsigned depth = unsigned(state.range(0));
+
+    BenchClock clock;
+    std::unique_ptr<BenchPool> pool(new BenchPool);
+    uavcan::CanTxQueue queue(*pool, clock, BenchPool::NumBlocks);
+    const uavcan::MonotonicTime deadline = uavcan::MonotonicTime::getMax();
+
+    uavcan::uint32_t lcg = 12345;
+    uavcan::CanFrame frame(uavcan::CanFrame::FlagEFF, Payload, sizeof(Payload));
+    const auto next_id = [&lcg]()
+    {
+        lcg = lcg * 1103515245U + 12345U;
+        return uavcan::uint32_t((lcg >> 3) & uavcan::CanFrame::MaskExtID) | uavcan::CanFrame::FlagEFF;
+    };
+
+    for (unsigned i = 0; i < depth; i++)
+    {
+        frame.id = next_id();
+        (void)queue.push(frame, deadline, uavcan::CanTxQueue::Volatile, 0);
+    }
+
+    for (auto _ : state)
+    {
+        frame.id = next_id();
+        benchmark::DoNotOptimize(queue.push(frame, deadline, uavcan::CanTxQueue::Volatile, 0));
+        uavcan::CanTxQueue::Entry* entry = queue.peek();
+        queue.remove(entry);
+    }
+}
+BENCHMARK(CanTxQueuePushPeek)->Arg(1)->Arg(16)->Arg(128)->Arg(512);
+
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <memory>
+#include <benchmark/benchmark.h>
+#include <uavcan/util/map.hpp>
+#include <uavcan/util/multiset.hpp>
+#include <uavcan/dynamic_memory.hpp>
+
+namespace
+{
+
+typedef uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 4096, uavcan::MemPoolBlockSize> BenchPool;
+
+/*
+ * Insertion, lookup and removal of one key in a map that holds the given number of other keys
+ */
+void MapInsertAccessRemove(benchmark::State& state)
+{
+    const unsigned size = unsigned(state.range(0));
+    std::unique_ptr<BenchPool> pool(new BenchPool);
+    uavcan::Map<uavcan::uint32_t, uavcan::uint32_t> map(*pool);
+
+    for (unsigned i = 0; i < size; i++)
+    {
+        (void)map.insert(i + 1U, i);
+    }
+
+    const uavcan::uint32_t key = size + 1U;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(map.insert(key, 123));
+        benchmark::DoNotOptimize(map.access(key));
+        map.remove(key);
+    }
+
+    if (map.getSize() != size)
+    {
+        state.SkipWithError("Map is corrupted");
+    }
+}
+BENCHMARK(MapInsertAccessRemove)->Arg(0)->Arg(8)->Arg(64)->Arg(256);
+
+/*
+ * Lookup of a key that is not in a map of the given size, i.e. the full scan
+ */
+void MapAccessMiss(benchmark::State& state)
+{
+    const unsigned size = unsigned(state.range(0));
+    std::unique_ptr<BenchPool> pool(new BenchPool);
+    uavcan::Map<uavcan::uint32_t, uavcan::uint32_t> map(*pool);
+
+    for (unsigned i = 0; i < size; i++)
+    {
+        (void)map.insert(i + 1U, i);
+    }
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(map.access(size + 1U));
+    }
+}
+BENCHMARK(MapAccessMiss)->Arg(8)->Arg(64)->Arg(256);
+
+/*
+ * Insertion and removal of one item in a multiset that holds the given number of other items
+ */
+void MultisetEmplaceRemove(benchmark::State& state)
+{
+    const unsigned size = unsigned(state.range(0));
+    std::unique_ptr<BenchPool> pool(new BenchPool);
+    uavcan::Multiset<uavcan::uint32_t> mset(*pool);
+
+    for (unsigned i = 0; i < size; i++)
+    {
+        (void)mset.emplace(i);
+    }
+
+    const uavcan::uint32_t item = size;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(mset.emplace(item));
+        mset.removeFirst(item);
+    }
+
+    if (mset.getSize() != size)
+    {
+        state.SkipWithError("Multiset is corrupted");
+    }
+}
+BENCHMARK(MultisetEmplaceRemove)->Arg(0)->Arg(8)->Arg(64)->Arg(256);
+
+}
@@ -13,7 +13,7 @@ It is based on the DSDL parsing package from pyuavcan.
 '''
 
 from __future__ import division, absolute_import, print_function, unicode_literals
-import sys, os, logging, errno, re
+import sys, os, logging, errno, re, fnmatch
 from .pyratemp import Template
 from dronecan import dsdl
 
@@ -34,7 +34,7 @@ class DsdlCompilerException(Exception):
 
 logger = logging.getLogger(__name__)
 
-def run(source_dirs, include_dirs, output_dir):
+def run(source_dirs, include_dirs, output_dir, table_codec=False, inline_codec_patterns=None, data_type_table=None):
     '''
     This function takes a list of root namespace directories (containing DSDL definition files to parse), a
     possibly empty list of search directories (containing DSDL definition files that can be referenced from the types
@@ -50,6 +50,13 @@ def run(source_dirs, include_dirs, output_dir):
         include_dirs   List of root namespace directories with referenced types (possibly empty). This list is
                        automaitcally extended with source_dirs.
         output_dir     Output directory path. Will be created if doesn't exist.
+        table_codec    Emit compact field descriptor tables interpreted by the shared table-driven codec instead of
+                       the inlined per-field codec calls, see uavcan/marshal/table_codec.hpp.
+        inline_codec_patterns  List of full type name patterns (fnmatch syntax) that keep the inline codec even if
+                       table_codec is set, e.g. the types on the hot path.
+        data_type_table  Path of the header file, relative to output_dir, where the table of descriptors of all
+                       data types with default Data Type ID will be stored; see GlobalDataTypeRegistry::adoptTable().
+                       Not generated if None.
     '''
     assert isinstance(source_dirs, list)
     assert isinstance(include_dirs, list)
@@ -60,7 +67,9 @@ def run(source_dirs, include_dirs, output_dir):
         die('No type definitions were found')
 
     logger.info('%d types total', len(types))
-    run_generator(types, output_dir)
+    run_generator(types, output_dir, table_codec, inline_codec_patterns or [])
+    if data_type_table:
+        run_table_generator(types, output_dir, data_type_table)
 
 # -----------------
 
@@ -97,7 +106,7 @@ def run_parser(source_dirs, search_dirs):
         die(ex)
     return types
 
-def run_generator(types, dest_dir):
+def run_generator(types, dest_dir, table_codec, inline_codec_patterns):
     try:
         template_expander = make_template_expander(TEMPLATE_FILENAME)
         dest_dir = os.path.abspath(dest_dir)  # Removing '..'
@@ -105,12 +114,22 @@ def run_generator(types, dest_dir):
         for t in types:
             logger.info('Generating type %s', t.full_name)
             filename = os.path.join(dest_dir, type_output_filename(t))
-            text = generate_one_type(template_expander, t)
+            use_table_codec = table_codec and not any(fnmatch.fnmatchcase(t.full_name, x)
+                                                      for x in inline_codec_patterns)
+            text = generate_one_type(template_expander, t, use_table_codec)
             write_generated_data(filename, text)
     except Exception as ex:
         logger.info('Generator failure', exc_info=True)
         die(ex)
 
+def run_table_generator(types, dest_dir, table_filename):
+    try:
+        filename = os.path.join(os.path.abspath(dest_dir), table_filename)
+        write_generated_data(filename, generate_data_type_table(types))
+    except Exception as ex:
+        logger.info('Table generator failure', exc_info=True)
+        die(ex)
+
 def write_generated_data(filename, data):
     dirname = os.path.dirname(filename)
     makedirs(dirname)
@@ -164,7 +183,77 @@ def type_to_cpp_type(t):
     else:
         raise DsdlCompilerException('Unknown type category: %s' % t.category)
 
-def generate_one_type(template_expander, t):
+def compute_transfer_crc_base(signature):
+    '''
+    Transfer CRC seeded with the data type signature (CRC-16-CCITT, signature bytes LSB first), so that it
+    doesn't have to be computed at run time by every transfer sender and listener of the type.
+    '''
+    crc = 0xFFFF
+    for i in range(0, 64, 8):
+        crc ^= ((signature >> i) & 0xFF) << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+def generate_data_type_table(types):
+    '''
+    The table is sorted the way GlobalDataTypeRegistry::adoptTable() expects: messages first, then services,
+    each by Data Type ID. The descriptors are constant-initialized, so the table ends up in ROM.
+    '''
+    types = [t for t in types if t.default_dtid is not None]
+    types.sort(key=lambda t: (0 if t.kind == t.KIND_MESSAGE else 1, t.default_dtid))
+    for a, b in zip(types, types[1:]):
+        if a.kind == b.kind and a.default_dtid == b.default_dtid:
+            die('Default Data Type ID collision: %s, %s' % (a.full_name, b.full_name))
+
+    num_messages = len([t for t in types if t.kind == t.KIND_MESSAGE])
+    lines = [
+        '/*',
+        ' * UAVCAN data type table for libuavcan.',
+        ' *',
+        ' * Autogenerated, do not edit.',
+        ' *',
+        ' * %d message types, %d service types.' % (num_messages, len(types) - num_messages),
+        ' * Usage: uavcan::GlobalDataTypeRegistry::instance().adoptTable(uavcan::getGeneratedDataTypeTable(),',
+        ' *                                                               uavcan::GeneratedDataTypeTableLength);',
+        ' */',
+        '',
+        '#ifndef UAVCAN_GENERATED_DATA_TYPE_TABLE_HPP_INCLUDED',
+        '#define UAVCAN_GENERATED_DATA_TYPE_TABLE_HPP_INCLUDED',
+        '',
+        '#include <uavcan/build_config.hpp>',
+        '#include <uavcan/data_type.hpp>',
+        '',
+        'namespace uavcan',
+        '{',
+        '',
+        'enum { GeneratedDataTypeTableLength = %d };' % len(types),
+        '',
+        'inline const DataTypeDescriptor* getGeneratedDataTypeTable()',
+        '{',
+        '    static const DataTypeDescriptor table[] =',
+        '    {',
+    ]
+    for i, t in enumerate(types):
+        kind = {t.KIND_MESSAGE: 'DataTypeKindMessage', t.KIND_SERVICE: 'DataTypeKindService'}[t.kind]
+        signature = t.get_data_type_signature()
+        lines.append('        DataTypeDescriptor(%s, %d, 0x%016xULL, "%s", 0x%04xU)%s' %
+                     (kind, t.default_dtid, signature, t.full_name, compute_transfer_crc_base(signature),
+                      ',' if i + 1 < len(types) else ''))
+    lines += [
+        '    };',
+        '    return table;',
+        '}',
+        '',
+        '}',
+        '',
+        '#endif // UAVCAN_GENERATED_DATA_TYPE_TABLE_HPP_INCLUDED',
+        '',
+    ]
+    return '\n'.join(lines)
+
+def generate_one_type(template_expander, t, use_table_codec=False):
     t.short_name = t.full_name.split('.')[-1]
     t.cpp_type_name = t.short_name + '_'
     t.cpp_full_type_name = '::' + t.full_name.replace('.', '::')
@@ -212,6 +301,77 @@ def generate_one_type(template_expander, t):
         t.request_union = t.request_union and len(t.request_fields)
         t.response_union = t.response_union and len(t.response_fields)
 
+    # Fixed layout - all fields are located at constant bit offsets, which allows to generate a fused codec
+    def inject_fixed_layout(fields, union):
+        if union or not fields:
+            return False
+        if any(a.type.category not in (a.type.CATEGORY_PRIMITIVE, a.type.CATEGORY_VOID) for a in fields):
+            return False
+        bit_offset = 0
+        for a in fields:
+            a.bit_offset = bit_offset
+            bit_offset += a.type.bitlen
+        return True
+
+    if t.kind == t.KIND_MESSAGE:
+        t.fixed_layout = inject_fixed_layout(t.fields, t.union)
+    else:
+        t.request_fixed_layout = inject_fixed_layout(t.request_fields, t.request_union)
+        t.response_fixed_layout = inject_fixed_layout(t.response_fields, t.response_union)
+
+    # Lazy view - the leading primitive fields are located at constant bit offsets even if the rest of the type is
+    # dynamic, which allows to decode them one by one straight from the serialized representation
+    def inject_lazy_view(fields, union):
+        if union:
+            return []
+        view_fields = []
+        bit_offset = 0
+        for a in fields:
+            if a.type.category not in (a.type.CATEGORY_PRIMITIVE, a.type.CATEGORY_VOID):
+                break
+            a.bit_offset = bit_offset
+            bit_offset += a.type.bitlen
+            if not a.void:
+                view_fields.append(a)
+        return view_fields
+
+    if t.kind == t.KIND_MESSAGE:
+        t.lazy_view_fields = inject_lazy_view(t.fields, t.union)
+    else:
+        t.request_lazy_view_fields = inject_lazy_view(t.request_fields, t.request_union)
+        t.response_lazy_view_fields = inject_lazy_view(t.response_fields, t.response_union)
+
+    # Table codec - the fields are described by a table in ROM that is interpreted by the shared codec loop,
+    # which trades some speed for a much smaller code footprint. Unions and empty types keep the inline codec.
+    def inject_table_codec(fields, union):
+        if not use_table_codec or union or not [a for a in fields if not a.void]:
+            return False
+        for a in fields:
+            tp = a.type
+            if tp.category in (tp.CATEGORY_PRIMITIVE, tp.CATEGORY_VOID):
+                if tp.category == tp.CATEGORY_VOID:
+                    kind = 'KindVoid'
+                else:
+                    kind = {
+                        tp.KIND_BOOLEAN: 'KindBool',
+                        tp.KIND_UNSIGNED_INT: 'KindUnsigned',
+                        tp.KIND_SIGNED_INT: 'KindSigned',
+                        tp.KIND_FLOAT: 'KindFloat',
+                    }[tp.kind]
+                saturate = tp.category == tp.CATEGORY_VOID or tp.cast_mode == tp.CAST_MODE_SATURATED
+                a.table_codec_entry = '::uavcan::TableCodecField::%s, %d, %d, UAVCAN_NULLPTR' % \
+                    (kind, tp.bitlen, int(saturate))
+            else:
+                a.table_codec_entry = '::uavcan::TableCodecField::KindOther, 0, 0, ' \
+                    '&::uavcan::TableCodecFieldOps< typename FieldTypes::%s >::Instance' % a.name
+        return True
+
+    if t.kind == t.KIND_MESSAGE:
+        t.table_codec = inject_table_codec(t.fields, t.union)
+    else:
+        t.request_table_codec = inject_table_codec(t.request_fields, t.request_union)
+        t.response_table_codec = inject_table_codec(t.response_fields, t.response_union)
+
     # Constant properties
     def inject_constant_info(constants):
         for c in constants:
@@ -230,6 +390,8 @@ def generate_one_type(template_expander, t):
         inject_constant_info(t.request_constants)
         inject_constant_info(t.response_constants)
 
+    t.transfer_crc_base = compute_transfer_crc_base(t.get_data_type_signature())
+
     # Data type kind
     t.cpp_kind = {
         t.KIND_MESSAGE: '::uavcan::DataTypeKindMessage',
@@ -0,0 +1,50 @@
+#!/usr/bin/env python
+#
+# Reports the code size of the marshalling code of every generated type covered by the footprint program.
+# The sizes are taken from the symbol table of the footprint executable: the probes footprintEncode<T>() and
+# footprintDecode<T>() contain the inlined marshalling code of the type T. Out-of-line helpers that are shared between
+# the types (e.g. the bit stream) are not attributed to any type.
+#
+# Usage: code_size.py <footprint executable> [nm executable]
+#
+# Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+#
+
+from __future__ import division, absolute_import, print_function, unicode_literals
+import re, sys, subprocess
+
+PROBE_REGEX = re.compile(r'footprint(Encode|Decode)<(.+)>\(\)')
+
+
+def read_probe_sizes(executable, nm):
+    output = subprocess.check_output([nm, '-C', '-S', executable]).decode('utf8')
+    sizes = {}
+    for line in output.splitlines():
+        fields = line.split(None, 3)
+        if len(fields) < 4 or fields[2].lower() != 't':
+            continue
+        match = PROBE_REGEX.search(fields[3])
+        if match:
+            # Cold parts of the functions are emitted as separate symbols, they are accounted for too
+            key = match.group(2), match.group(1).lower()
+            sizes[key] = sizes.get(key, 0) + int(fields[1], 16)
+    return sizes
+
+
+def main():
+    if len(sys.argv) < 2:
+        print('Usage: %s <footprint executable> [nm executable]' % sys.argv[0], file=sys.stderr)
+        sys.exit(1)
+    sizes = read_probe_sizes(sys.argv[1], sys.argv[2] if len(sys.argv) > 2 else 'nm')
+    if not sizes:
+        print('No probes found; the executable must not be stripped', file=sys.stderr)
+        sys.exit(1)
+
+    print('Code size of the generated types, bytes')
+    print('%-60s %8s %8s' % ('Type', 'encode', 'decode'))
+    for type_name in sorted(set(name for name, _ in sizes)):
+        print('%-60s %8d %8d' % (type_name, sizes.get((type_name, 'encode'), 0), sizes.get((type_name, 'decode'), 0)))
+
+
+if __name__ == '__main__':
+    main()
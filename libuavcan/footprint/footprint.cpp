@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ *
+ * Memory footprint report: sizes of the core objects of the library, and the stack usage of the marshalling code of
+ * the generated data types. The code size of the marshalling code is reported by code_size.py, which inspects the
+ * symbols of this executable, see the target libuavcan_footprint_report.
+ *
+ * The stack usage is measured by running the code on a separate thread whose stack is painted with a known pattern
+ * beforehand; the depth of the overwritten area, minus the depth of an empty function, is the stack usage of the code
+ * including everything it calls. Unlike the output of -fstack-usage, this accounts for the callees and the inlining.
+ */
+
+#include <pthread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <uavcan/uavcan.hpp>
+#include <uavcan/protocol/NodeStatus.hpp>
+#include <uavcan/protocol/GetNodeInfo.hpp>
+#include <uavcan/protocol/GetTransportStats.hpp>
+#include <uavcan/protocol/GlobalTimeSync.hpp>
+#include <uavcan/protocol/debug/LogMessage.hpp>
+#include <uavcan/protocol/dynamic_node_id/Allocation.hpp>
+#include <uavcan/protocol/param/GetSet.hpp>
+#include <uavcan/protocol/file/Read.hpp>
+
+/**
+ * Generated types to report, as (label, type).
+ * Service types are listed per request and per response, since these are marshalled separately.
+ */
+#define UAVCAN_FOOTPRINT_DATA_TYPES(X) \
+    X("NodeStatus",                 uavcan::protocol::NodeStatus) \
+    X("GetNodeInfo::Response",      uavcan::protocol::GetNodeInfo::Response) \
+    X("GetTransportStats::Response",uavcan::protocol::GetTransportStats::Response) \
+    X("GlobalTimeSync",             uavcan::protocol::GlobalTimeSync) \
+    X("debug::LogMessage",          uavcan::protocol::debug::LogMessage) \
+    X("dynamic_node_id::Allocation",uavcan::protocol::dynamic_node_id::Allocation) \
+    X("param::GetSet::Request",     uavcan::protocol::param::GetSet::Request) \
+    X("param::GetSet::Response",    uavcan::protocol::param::GetSet::Response) \
+    X("file::Read::Request",        uavcan::protocol::file::Read::Request) \
+    X("file::Read::Response",       uavcan::protocol::file::Read::Response)
+
+/**
+ * Core objects to report; the list is expected to grow along with the library.
+ */
+#define UAVCAN_FOOTPRINT_CORE_TYPES(X) \
+    X(uavcan::CanFrame) \
+    X(uavcan::Frame) \
+    X(uavcan::RxFrame) \
+    X(uavcan::CanTxQueue::Entry) \
+    X(uavcan::CanIOManager) \
+    X(uavcan::TransferReceiver) \
+    X(uavcan::TransferBufferManagerEntry) \
+    X(uavcan::TransferListener) \
+    X(uavcan::TransferListenerWithFilter) \
+    X(uavcan::OutgoingTransferRegistry) \
+    X(uavcan::Dispatcher) \
+    X(uavcan::Scheduler) \
+    X(uavcan::Timer) \
+    X(uavcan::Node<0>)
+
+namespace
+{
+
+const std::size_t StackSize = 256 * 1024;
+const unsigned char PaintPattern = 0xA5;
+
+typedef void (*Probe)();
+
+void* runProbe(void* arg)
+{
+    Probe probe = Probe();
+    std::memcpy(&probe, &arg, sizeof(probe));
+    probe();
+    return UAVCAN_NULLPTR;
+}
+
+/**
+ * Runs the probe on a freshly painted stack and returns the depth of the overwritten area in bytes.
+ * The stack grows downwards on all supported platforms.
+ */
+std::size_t measureStackDepth(Probe probe)
+{
+    static unsigned char stack[StackSize] __attribute__((aligned(4096)));
+    std::memset(stack, PaintPattern, sizeof(stack));
+
+    pthread_attr_t attr;
+    pthread_t thread;
+    void* arg = UAVCAN_NULLPTR;
+    std::memcpy(&arg, &probe, sizeof(probe));
+    if ((pthread_attr_init(&attr) != 0) ||
+        (pthread_attr_setstack(&attr, stack, sizeof(stack)) != 0) ||
+        (pthread_create(&thread, &attr, &runProbe, arg) != 0) ||
+        (pthread_join(thread, UAVCAN_NULLPTR) != 0))
+    {
+        std::fprintf(stderr, "Failed to run the probe thread\n");
+        std::exit(1);
+    }
+    (void)pthread_attr_destroy(&attr);
+
+    std::size_t untouched = 0;
+    while ((untouched < sizeof(stack)) && (stack[untouched] == PaintPattern))
+    {
+        untouched++;
+    }
+    return sizeof(stack) - untouched;
+}
+
+__attribute__((noinline)) void emptyProbe()
+{
+    asm volatile ("" ::: "memory");
+}
+
+/**
+ * The probes of every type follow the code paths of the library: encoding goes into a stack-allocated buffer of the
+ * maximum size like in the publisher, and decoding goes into a stack-allocated ReceivedDataStructure<> like in the
+ * subscriber. The encoded default-initialized object is what is decoded.
+ * The probes are named footprintEncode/footprintDecode, which is what code_size.py looks for.
+ */
+template <typename T>
+struct Marshalling
+{
+    enum { BufferSize = uavcan::BitLenToByteLen<T::MaxBitLen>::Result };
+    typedef uavcan::StaticTransferBuffer<BufferSize> Buffer;
+
+    struct ReceivedDataStructureSpec : public uavcan::ReceivedDataStructure<T>
+    {
+        ReceivedDataStructureSpec() { }
+    };
+
+    static uavcan::uint8_t encoded[BufferSize];
+    static unsigned encoded_len;
+    static int result;
+};
+
+template <typename T> uavcan::uint8_t Marshalling<T>::encoded[Marshalling<T>::BufferSize];
+template <typename T> unsigned Marshalling<T>::encoded_len = 0;
+template <typename T> int Marshalling<T>::result = 0;
+
+template <typename T>
+__attribute__((noinline)) void footprintEncode()
+{
+    T obj;
+    typename Marshalling<T>::Buffer buffer;
+    uavcan::BitStream bitstream(buffer);
+    uavcan::ScalarCodec codec(bitstream);
+    Marshalling<T>::result = T::encode(obj, codec, uavcan::TailArrayOptEnabled);
+    Marshalling<T>::encoded_len = buffer.getMaxWritePos();
+    std::memcpy(Marshalling<T>::encoded, buffer.getRawPtr(), Marshalling<T>::encoded_len);
+}
+
+template <typename T>
+__attribute__((noinline)) void footprintDecode()
+{
+    typename Marshalling<T>::ReceivedDataStructureSpec rx_struct;
+    uavcan::BitStream bitstream(Marshalling<T>::encoded, Marshalling<T>::encoded_len);
+    uavcan::ScalarCodec codec(bitstream);
+    Marshalling<T>::result = T::decode(rx_struct, codec, uavcan::TailArrayOptEnabled);
+}
+
+template <typename T>
+void reportDataType(const char* label, std::size_t baseline)
+{
+    const std::size_t encode_depth = measureStackDepth(&footprintEncode<T>) - baseline;
+    if (Marshalling<T>::result <= 0)
+    {
+        std::fprintf(stderr, "Failed to encode %s: %d\n", label, Marshalling<T>::result);
+        std::exit(1);
+    }
+    const std::size_t decode_depth = measureStackDepth(&footprintDecode<T>) - baseline;
+    if (Marshalling<T>::result <= 0)
+    {
+        std::fprintf(stderr, "Failed to decode %s: %d\n", label, Marshalling<T>::result);
+        std::exit(1);
+    }
+    std::printf("%-32s %8u %10u %12u %12u\n", label, unsigned(sizeof(T)), unsigned(T::MaxBitLen + 7U) / 8U,
+                unsigned(encode_depth), unsigned(decode_depth));
+}
+
+}
+
+int main()
+{
+    std::printf("Core objects\n");
+    std::printf("%-40s %8s\n", "Type", "sizeof");
+#define UAVCAN_FOOTPRINT_PRINT_SIZEOF(T) std::printf("%-40s %8u\n", #T, unsigned(sizeof(T)));
+    UAVCAN_FOOTPRINT_CORE_TYPES(UAVCAN_FOOTPRINT_PRINT_SIZEOF)
+#undef UAVCAN_FOOTPRINT_PRINT_SIZEOF
+    std::printf("Memory pool block size: %u, CAN FD support: %u\n",
+                unsigned(uavcan::MemPoolBlockSize), unsigned(UAVCAN_SUPPORT_CANFD));
+
+    const std::size_t baseline = measureStackDepth(&emptyProbe);
+    std::printf("\nGenerated types (stack depth in bytes, excluding the baseline of %u)\n", unsigned(baseline));
+    std::printf("%-32s %8s %10s %12s %12s\n", "Type", "sizeof", "max bytes", "encode stack", "decode stack");
+#define UAVCAN_FOOTPRINT_REPORT_DATA_TYPE(label, T) reportDataType<T>(label, baseline);
+    UAVCAN_FOOTPRINT_DATA_TYPES(UAVCAN_FOOTPRINT_REPORT_DATA_TYPE)
+#undef UAVCAN_FOOTPRINT_REPORT_DATA_TYPE
+
+    return 0;
+}
@@ -50,6 +50,18 @@
 # endif
 #endif
 
+/**
+ * Constructors of the basic value types are marked with this, so that in C++11 mode tables of such objects are
+ * initialized at compile time and can be placed in ROM, e.g. the data type table generated by the DSDL compiler.
+ */
+#ifndef UAVCAN_CONSTEXPR
+# if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+#  define UAVCAN_CONSTEXPR constexpr
+# else
+#  define UAVCAN_CONSTEXPR
+# endif
+#endif
+
 /**
  * By default, libuavcan enables all features if it detects that it is being built for a general-purpose
  * target like Linux. Value of this macro influences other configuration options located below in this file.
@@ -73,6 +85,16 @@
 # define UAVCAN_DEBUG 0
 #endif
 
+/**
+ * Structured trace points on the hot paths of the library, see @ref ITraceSink. The value is a mask of the enabled
+ * events, where bit N stands for the event N of @ref TraceEventID. Zero (the default) removes the trace points
+ * from the code entirely. Unlike UAVCAN_DEBUG, the trace points don't format any strings, so they are usable in
+ * production builds.
+ */
+#ifndef UAVCAN_TRACE_POINTS
+# define UAVCAN_TRACE_POINTS 0
+#endif
+
 /**
  * This option allows to select whether libuavcan should throw exceptions on fatal errors, or try to handle
  * errors differently. By default, exceptions will be enabled only if the library is built for a general-purpose
@@ -106,6 +128,19 @@
 # define UAVCAN_EXPORT
 #endif
 
+/**
+ * C++20 coroutine support, e.g. awaitable service calls (see ServiceCallFuture).
+ * Enabled automatically if the compiler implements coroutines. Note that UAVCAN_CPP_VERSION has to be set
+ * explicitly in C++20 mode.
+ */
+#ifndef UAVCAN_COROUTINES
+# if defined(__cpp_impl_coroutine) && (__cpp_impl_coroutine >= 201902L)
+#  define UAVCAN_COROUTINES 1
+# else
+#  define UAVCAN_COROUTINES 0
+# endif
+#endif
+
 /**
  * Trade-off between ROM/RAM usage and functionality/determinism.
  * Note that this feature is not well tested and should be avoided.
@@ -123,6 +158,16 @@
 # define UAVCAN_NO_GLOBAL_DATA_TYPE_REGISTRY 0
 #endif
 
+/**
+ * Disable the registration of the generated data types before main(); every generated header otherwise adds a static
+ * constructor that inserts the type into the global data type registry. This is meant for applications that adopt
+ * the data type table generated by the DSDL compiler instead (see GlobalDataTypeRegistry::adoptTable()), which makes
+ * the startup faster and deterministic. The types that are not in the table must be registered manually.
+ */
+#ifndef UAVCAN_NO_DEFAULT_DATA_TYPE_REGISTRATION
+# define UAVCAN_NO_DEFAULT_DATA_TYPE_REGISTRATION 0
+#endif
+
 /**
  * toString() methods will be disabled by default, unless the library is built for a general-purpose target like Linux.
  * It is not recommended to enable toString() on embedded targets as code size will explode.
@@ -167,6 +212,18 @@
 # define UAVCAN_USE_EXTERNAL_FLOAT16_CONVERSION 0
 #endif
 
+/**
+ * Use the F16C (x86) or the half-precision NEON (ARMv8, or ARMv7 with the FP16 extension) instructions for the
+ * float16 conversions, both for single values and for arrays. Takes effect only if the compiler targets such a CPU
+ * (e.g. -mf16c) and UAVCAN_USE_EXTERNAL_FLOAT16_CONVERSION is disabled; otherwise the portable implementation is used.
+ * Note that the hardware rounds halfway cases to even whereas the portable implementation rounds them away from zero,
+ * and it keeps the NaN payload (the portable implementation encodes all NaNs as 0x7FFF); hence a few values may be
+ * encoded differently than with the default configuration.
+ */
+#ifndef UAVCAN_FLOAT16_CONVERSION_INTRINSICS
+# define UAVCAN_FLOAT16_CONVERSION_INTRINSICS 0
+#endif
+
 /**
  * Run time checks.
  * Resolves to the standard assert() by default.
@@ -207,6 +264,518 @@
 # define UAVCAN_SUPPORT_CANFD 0
 #endif
 
+/**
+ * Capacity of the lookup index that the global data type registry builds when it gets frozen, in data types of
+ * each kind (messages, services). The index consists of an array sorted by data type ID and a hash table by full
+ * data type name, which make the lookups O(log N) and O(1) respectively instead of walking the list of registered
+ * types. If more types of a kind are registered, lookups of that kind fall back to the linear scan.
+ * Zero disables the index completely, which is the default for UAVCAN_TINY.
+ */
+#ifndef UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY
+# if UAVCAN_TINY
+#  define UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY 0
+# elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY 128
+# else
+#  define UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY 32
+# endif
+#endif
+
+/**
+ * Capacity of the sorted data type ID index that the dispatcher maintains for each of its listener registries
+ * (messages, service requests, service responses), in unique data type IDs. The index allows the dispatcher to
+ * locate the listeners of a received frame in O(log N) instead of walking the whole list of listeners.
+ * If the number of unique data type IDs in a registry exceeds the capacity, that registry falls back to the
+ * linear scan. Zero disables the index completely, which is the default for UAVCAN_TINY.
+ */
+#ifndef UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY
+# if UAVCAN_TINY
+#  define UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY 0
+# elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY 64
+# else
+#  define UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY 16
+# endif
+#endif
+
+/**
+ * Capacity of the hash table that every service client maintains to locate its pending calls by server node ID and
+ * transfer ID, so that the check of every received response frame is O(1) instead of walking all pending calls.
+ * The table is kept no more than 3/4 full; if there are more pending calls, the client falls back to the linear scan
+ * until all of them are completed. Zero disables the table completely, which is the default for UAVCAN_TINY.
+ */
+#ifndef UAVCAN_SERVICE_CLIENT_CALL_INDEX_CAPACITY
+# if UAVCAN_TINY
+#  define UAVCAN_SERVICE_CLIENT_CALL_INDEX_CAPACITY 0
+# elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_SERVICE_CLIENT_CALL_INDEX_CAPACITY 256
+# else
+#  define UAVCAN_SERVICE_CLIENT_CALL_INDEX_CAPACITY 16
+# endif
+#endif
+
+#if UAVCAN_SERVICE_CLIENT_CALL_INDEX_CAPACITY > 65535
+# error UAVCAN_SERVICE_CLIENT_CALL_INDEX_CAPACITY is too large
+#endif
+
+/**
+ * Number of CAN ID streams tracked by the redundant interface filter of the dispatcher, see
+ * @ref RedundantFrameFilter. The filter drops the copies of frames received via the redundant interfaces before they
+ * are parsed. Must be a power of two; zero disables the filter, which is the default for UAVCAN_TINY.
+ * The filter is bypassed anyway if there is only one interface.
+ */
+#ifndef UAVCAN_DISPATCHER_REDUNDANCY_FILTER_CAPACITY
+# if UAVCAN_TINY
+#  define UAVCAN_DISPATCHER_REDUNDANCY_FILTER_CAPACITY 0
+# elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_DISPATCHER_REDUNDANCY_FILTER_CAPACITY 64
+# else
+#  define UAVCAN_DISPATCHER_REDUNDANCY_FILTER_CAPACITY 16
+# endif
+#endif
+
+#if (UAVCAN_DISPATCHER_REDUNDANCY_FILTER_CAPACITY & (UAVCAN_DISPATCHER_REDUNDANCY_FILTER_CAPACITY - 1)) != 0
+# error UAVCAN_DISPATCHER_REDUNDANCY_FILTER_CAPACITY must be a power of two
+#endif
+
+/**
+ * Enables the per-source rate limiting of incoming transfers in the dispatcher, see @ref RxRateLimiter.
+ * The limiter keeps 4 bytes of state per node ID per transfer type, so it is enabled by default only on
+ * general purpose platforms. Even if enabled, no limits are applied until they are configured.
+ */
+#ifndef UAVCAN_DISPATCHER_RX_RATE_LIMITING
+# if UAVCAN_GENERAL_PURPOSE_PLATFORM && !UAVCAN_TINY
+#  define UAVCAN_DISPATCHER_RX_RATE_LIMITING 1
+# else
+#  define UAVCAN_DISPATCHER_RX_RATE_LIMITING 0
+# endif
+#endif
+
+/**
+ * Maximum number of CAN frames the dispatcher fetches from the CAN IO manager per select() call.
+ * The frames are buffered on the stack of Dispatcher::spin() and Dispatcher::spinOnce(), so the stack usage grows
+ * linearly with this value. The driver can serve a whole batch at once by overriding ICanIface::receiveBatch().
+ * One restores the frame-by-frame behavior.
+ */
+#ifndef UAVCAN_DISPATCHER_RX_BATCH_SIZE
+# if UAVCAN_TINY
+#  define UAVCAN_DISPATCHER_RX_BATCH_SIZE 1
+# elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_DISPATCHER_RX_BATCH_SIZE 16
+# else
+#  define UAVCAN_DISPATCHER_RX_BATCH_SIZE 4
+# endif
+#endif
+
+#if UAVCAN_DISPATCHER_RX_BATCH_SIZE < 1
+# error UAVCAN_DISPATCHER_RX_BATCH_SIZE must be at least 1
+#endif
+
+/**
+ * Capacity of the RX staging buffer of the dispatcher, in CAN frames, see Dispatcher::enableRxPriorityStaging().
+ * The buffer is a member of the dispatcher. Zero removes the staging mode.
+ */
+#ifndef UAVCAN_DISPATCHER_RX_STAGING_CAPACITY
+# if UAVCAN_TINY
+#  define UAVCAN_DISPATCHER_RX_STAGING_CAPACITY 0
+# elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_DISPATCHER_RX_STAGING_CAPACITY 64
+# else
+#  define UAVCAN_DISPATCHER_RX_STAGING_CAPACITY 16
+# endif
+#endif
+
+/**
+ * Number of scheduler ticks the periodic cleanup is spread over. Every tick cleans up one slice of the transfer
+ * listeners, so that the latency spike caused by the cleanup doesn't grow with the number of listeners; every
+ * listener is still cleaned up once per cleanup period. One restores the cleanup of everything at once.
+ */
+#ifndef UAVCAN_SCHEDULER_CLEANUP_SLICES
+# if UAVCAN_TINY
+#  define UAVCAN_SCHEDULER_CLEANUP_SLICES 1
+# elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_SCHEDULER_CLEANUP_SLICES 8
+# else
+#  define UAVCAN_SCHEDULER_CLEANUP_SLICES 4
+# endif
+#endif
+
+#if (UAVCAN_SCHEDULER_CLEANUP_SLICES < 1) || (UAVCAN_SCHEDULER_CLEANUP_SLICES > 255)
+# error UAVCAN_SCHEDULER_CLEANUP_SLICES must be within [1, 255]
+#endif
+
+/**
+ * Deadline scheduler backend.
+ * Zero keeps the deadline handlers in a list sorted by deadline, which is the smallest and the fastest option for
+ * a few handlers, but every start of a timer or a service call costs O(N).
+ * One selects a hierarchical timer wheel, where starting and stopping a handler is O(1) regardless of the number of
+ * running handlers; this costs two more pointers per handler and a few kilobytes of slot table in the scheduler.
+ */
+#ifndef UAVCAN_SCHEDULER_TIMER_WHEEL
+# define UAVCAN_SCHEDULER_TIMER_WHEEL 0
+#endif
+
+/**
+ * Timer wheel tick, in microseconds. Handlers whose deadlines fall into the same tick share a slot.
+ * The default matches the finest deadline resolution of the scheduler, see Scheduler::setDeadlineResolution().
+ */
+#ifndef UAVCAN_SCHEDULER_TIMER_WHEEL_TICK_USEC
+# define UAVCAN_SCHEDULER_TIMER_WHEEL_TICK_USEC 1000
+#endif
+
+#if UAVCAN_SCHEDULER_TIMER_WHEEL_TICK_USEC < 1
+# error UAVCAN_SCHEDULER_TIMER_WHEEL_TICK_USEC must be positive
+#endif
+
+/**
+ * Resolution of the phase spreading of periodic timers, see TimerBase::startPeriodicSpread(): the period is divided
+ * into this many phases, and every timer takes the least loaded one. Must be a power of two.
+ */
+#ifndef UAVCAN_SCHEDULER_PHASE_BINS
+# if UAVCAN_TINY
+#  define UAVCAN_SCHEDULER_PHASE_BINS 4
+# elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_SCHEDULER_PHASE_BINS 32
+# else
+#  define UAVCAN_SCHEDULER_PHASE_BINS 16
+# endif
+#endif
+
+#if (UAVCAN_SCHEDULER_PHASE_BINS < 1) || (UAVCAN_SCHEDULER_PHASE_BINS > 128) || \
+    ((UAVCAN_SCHEDULER_PHASE_BINS & (UAVCAN_SCHEDULER_PHASE_BINS - 1)) != 0)
+# error UAVCAN_SCHEDULER_PHASE_BINS must be a power of two within [1, 128]
+#endif
+
+/**
+ * Maximum number of frames the CAN IO manager hands over from a TX queue to the driver per ICanIface::sendBatch()
+ * call. The frame references are buffered on the stack, so the cost of a larger value is small.
+ * One restores the frame-by-frame behavior.
+ */
+#ifndef UAVCAN_CAN_TX_BATCH_SIZE
+# if UAVCAN_TINY
+#  define UAVCAN_CAN_TX_BATCH_SIZE 1
+# elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_CAN_TX_BATCH_SIZE 16
+# else
+#  define UAVCAN_CAN_TX_BATCH_SIZE 3
+# endif
+#endif
+
+#if UAVCAN_CAN_TX_BATCH_SIZE < 1
+# error UAVCAN_CAN_TX_BATCH_SIZE must be at least 1
+#endif
+
+/**
+ * Share of the TX queue memory quota of every interface, in percent, that is guaranteed to the interface.
+ * The rest of the quotas is lent by CanIOManager to the queues of the interfaces that are congested but still
+ * transmitting, and returned once the congestion is gone. 100 disables the lending, so that the quotas are static.
+ */
+#ifndef UAVCAN_CAN_TX_QUEUE_GUARANTEED_QUOTA_PERCENT
+# if UAVCAN_TINY
+#  define UAVCAN_CAN_TX_QUEUE_GUARANTEED_QUOTA_PERCENT 100
+# else
+#  define UAVCAN_CAN_TX_QUEUE_GUARANTEED_QUOTA_PERCENT 50
+# endif
+#endif
+
+#if (UAVCAN_CAN_TX_QUEUE_GUARANTEED_QUOTA_PERCENT < 1) || (UAVCAN_CAN_TX_QUEUE_GUARANTEED_QUOTA_PERCENT > 100)
+# error UAVCAN_CAN_TX_QUEUE_GUARANTEED_QUOTA_PERCENT must be within [1, 100]
+#endif
+
+/**
+ * Allows the TX queues of redundant interfaces to share one entry between them, so that a frame that has to be
+ * queued on several interfaces occupies one memory block instead of one per interface. The block is released
+ * once the frame has left all of the queues. Every entry gets one list link per interface, which is why this
+ * option is disabled on tiny platforms, where a single interface is typical.
+ */
+#ifndef UAVCAN_CAN_TX_QUEUE_SHARED_ENTRIES
+# if UAVCAN_TINY
+#  define UAVCAN_CAN_TX_QUEUE_SHARED_ENTRIES 0
+# else
+#  define UAVCAN_CAN_TX_QUEUE_SHARED_ENTRIES 1
+# endif
+#endif
+
+/**
+ * With CAN FD support, TX queue entries of classic frames are allocated without the unused 56 bytes of the data
+ * field, so that a pool with several size classes (e.g. @ref SegregatedPoolAllocator) can serve them from a smaller
+ * class. The driver always gets a complete frame: the frame of such an entry is copied to the stack before it is
+ * passed to the driver. With a single block size pool this option makes no difference in memory usage.
+ */
+#ifndef UAVCAN_CAN_TX_QUEUE_COMPACT_ENTRIES
+# define UAVCAN_CAN_TX_QUEUE_COMPACT_ENTRIES UAVCAN_SUPPORT_CANFD
+#endif
+
+#if UAVCAN_CAN_TX_QUEUE_COMPACT_ENTRIES && !UAVCAN_SUPPORT_CANFD
+# error UAVCAN_CAN_TX_QUEUE_COMPACT_ENTRIES requires UAVCAN_SUPPORT_CANFD
+#endif
+
+/**
+ * Deadline-aware scheduling of the TX queues: frames whose TX deadline is about to expire may be promoted ahead
+ * of the frames of higher priority, and the number of queued frames can be limited per priority band.
+ * Both are disabled at run time by default, see @ref CanTxQueue::setUrgencyWindow() and
+ * @ref CanTxQueue::setBandBacklogLimit(). The option only costs a few bytes per queue; it is left out on tiny
+ * platforms anyway, since they rarely have the memory to queue enough frames for the order to matter.
+ */
+#ifndef UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING
+# if UAVCAN_TINY
+#  define UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING 0
+# else
+#  define UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING 1
+# endif
+#endif
+
+/**
+ * Number of concurrent multi-frame reception buffers of a single transfer listener starting from which the
+ * listener maintains a hash index over its buffers, so that every received frame doesn't have to walk the whole
+ * list of buffers. The index is allocated from the memory pool (two blocks at least) and is released once the
+ * number of buffers goes down again. Zero disables the index, which is the default for UAVCAN_TINY.
+ */
+#ifndef UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD
+# if UAVCAN_TINY
+#  define UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD 0
+# elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD 4
+# else
+#  define UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD 8
+# endif
+#endif
+
+/**
+ * Maximum payload length, in bytes, of a multi-frame transfer that subscribers copy into a contiguous buffer on the
+ * stack before decoding, so that the decoder reads the memory directly instead of calling the reception buffer for
+ * every field. The buffer is limited to the maximum encoded length of the data type, so the stack usage is the
+ * smaller of the two. Longer transfers are decoded from the reception buffer. Zero disables the copying.
+ */
+#ifndef UAVCAN_RX_LINEARIZATION_MAX_LEN
+# if UAVCAN_TINY
+#  define UAVCAN_RX_LINEARIZATION_MAX_LEN 0
+# elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_RX_LINEARIZATION_MAX_LEN 512
+# else
+#  define UAVCAN_RX_LINEARIZATION_MAX_LEN 64
+# endif
+#endif
+
+/**
+ * Number of entries of a @ref HashMap starting from which the map maintains a hash index over its entries, so that
+ * lookups don't have to walk the whole map. The index is allocated from the memory pool (two blocks at least) and
+ * is released once the number of entries goes down again. Zero disables the index, which is the default for
+ * UAVCAN_TINY; HashMap is equivalent to Map then.
+ */
+#ifndef UAVCAN_HASH_MAP_INDEX_THRESHOLD
+# if UAVCAN_TINY
+#  define UAVCAN_HASH_MAP_INDEX_THRESHOLD 0
+# elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_HASH_MAP_INDEX_THRESHOLD 4
+# else
+#  define UAVCAN_HASH_MAP_INDEX_THRESHOLD 8
+# endif
+#endif
+
+/**
+ * Number of distinct frame classes (data type ID, destination and service flags) tracked by the CAN bus traffic
+ * monitor that drives the cost model of the acceptance filter configurator. Must be a power of two.
+ * Each entry takes 8 bytes. Frames of untracked classes are accounted for in a common counter.
+ */
+#ifndef UAVCAN_CAN_TRAFFIC_MONITOR_CAPACITY
+# if UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_CAN_TRAFFIC_MONITOR_CAPACITY 128
+# else
+#  define UAVCAN_CAN_TRAFFIC_MONITOR_CAPACITY 32
+# endif
+#endif
+
+#if (UAVCAN_CAN_TRAFFIC_MONITOR_CAPACITY < 1) || \
+    ((UAVCAN_CAN_TRAFFIC_MONITOR_CAPACITY & (UAVCAN_CAN_TRAFFIC_MONITOR_CAPACITY - 1)) != 0)
+# error UAVCAN_CAN_TRAFFIC_MONITOR_CAPACITY must be a power of two
+#endif
+
+/**
+ * Capacity of the routing table of @ref CanFrameBridge. Each route takes 12 bytes.
+ */
+#ifndef UAVCAN_CAN_FRAME_BRIDGE_MAX_ROUTES
+# define UAVCAN_CAN_FRAME_BRIDGE_MAX_ROUTES 16
+#endif
+
+#if (UAVCAN_CAN_FRAME_BRIDGE_MAX_ROUTES < 1) || (UAVCAN_CAN_FRAME_BRIDGE_MAX_ROUTES > 255)
+# error UAVCAN_CAN_FRAME_BRIDGE_MAX_ROUTES must be within [1, 255]
+#endif
+
+/**
+ * Maximum number of virtual nodes that can share one @ref RxFrameDemultiplexer.
+ */
+#ifndef UAVCAN_RX_FRAME_DEMULTIPLEXER_MAX_NODES
+# define UAVCAN_RX_FRAME_DEMULTIPLEXER_MAX_NODES 8
+#endif
+
+#if (UAVCAN_RX_FRAME_DEMULTIPLEXER_MAX_NODES < 1) || (UAVCAN_RX_FRAME_DEMULTIPLEXER_MAX_NODES > 255)
+# error UAVCAN_RX_FRAME_DEMULTIPLEXER_MAX_NODES must be within [1, 255]
+#endif
+
+/**
+ * Extended transport statistics, see @ref TransportStats: transfer counters per data type, reception errors by
+ * cause, and latency histograms of the frame reception and of the TX queues. It costs about a kilobyte of RAM per
+ * node with the default table size, and a clock read per batch of received or transmitted frames.
+ * Disabled for UAVCAN_TINY; the totals of @ref TransferPerfCounter are maintained regardless of this option.
+ */
+#ifndef UAVCAN_TRANSPORT_STATS
+# if UAVCAN_TINY
+#  define UAVCAN_TRANSPORT_STATS 0
+# else
+#  define UAVCAN_TRANSPORT_STATS 1
+# endif
+#endif
+
+/**
+ * Number of distinct data types whose transfers are counted individually by @ref TransportStats.
+ * Must be a power of two. Each entry takes 12 bytes. Transfers of untracked data types are accounted for in a
+ * common counter.
+ */
+#ifndef UAVCAN_TRANSPORT_STATS_CAPACITY
+# if UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_TRANSPORT_STATS_CAPACITY 64
+# else
+#  define UAVCAN_TRANSPORT_STATS_CAPACITY 32
+# endif
+#endif
+
+#if (UAVCAN_TRANSPORT_STATS_CAPACITY < 1) || \
+    ((UAVCAN_TRANSPORT_STATS_CAPACITY & (UAVCAN_TRANSPORT_STATS_CAPACITY - 1)) != 0)
+# error UAVCAN_TRANSPORT_STATS_CAPACITY must be a power of two
+#endif
+
+/**
+ * Number of transfer streams, i.e. pairs of a source node and a data type, whose losses are tracked individually
+ * by @ref TransportStats. Must be a power of two. Each entry takes 24 bytes. Streams that don't fit into the table
+ * are accounted for in a common counter.
+ */
+#ifndef UAVCAN_TRANSPORT_STATS_SOURCE_CAPACITY
+# if UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_TRANSPORT_STATS_SOURCE_CAPACITY 128
+# else
+#  define UAVCAN_TRANSPORT_STATS_SOURCE_CAPACITY 16
+# endif
+#endif
+
+#if (UAVCAN_TRANSPORT_STATS_SOURCE_CAPACITY < 1) || \
+    ((UAVCAN_TRANSPORT_STATS_SOURCE_CAPACITY & (UAVCAN_TRANSPORT_STATS_SOURCE_CAPACITY - 1)) != 0)
+# error UAVCAN_TRANSPORT_STATS_SOURCE_CAPACITY must be a power of two
+#endif
+
+/**
+ * Health tracking of redundant interfaces, see @ref CanIOManager::setIfaceProbeInterval(). An interface whose error
+ * counter keeps rising while its TX queue makes no progress is excluded from transmission for a while, so that
+ * its frames don't occupy the memory pool until they expire. Useless with a single interface, hence disabled
+ * for UAVCAN_TINY.
+ */
+#ifndef UAVCAN_CAN_IFACE_HEALTH_TRACKING
+# if UAVCAN_TINY
+#  define UAVCAN_CAN_IFACE_HEALTH_TRACKING 0
+# else
+#  define UAVCAN_CAN_IFACE_HEALTH_TRACKING 1
+# endif
+#endif
+
+/**
+ * Bus load estimation per interface, see @ref BusLoadEstimator and @ref CanIOManager::getBusLoadPercent().
+ * Bulk traffic (firmware updates, node discovery, publishers with a load limit) uses it to back off when the bus is
+ * busy. Costs about a hundred bytes of RAM per interface and a clock read per batch of frames.
+ * Disabled for UAVCAN_TINY; the bus load reads zero then.
+ */
+#ifndef UAVCAN_BUS_LOAD_ESTIMATION
+# if UAVCAN_TINY
+#  define UAVCAN_BUS_LOAD_ESTIMATION 0
+# else
+#  define UAVCAN_BUS_LOAD_ESTIMATION 1
+# endif
+#endif
+
+/**
+ * Cache line size of the target, in bytes. It is used to keep the data that is written concurrently from different
+ * contexts (e.g. from an ISR and from the main loop) on separate cache lines, see @ref CanRxRing.
+ */
+#ifndef UAVCAN_CACHE_LINE_SIZE
+# if UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_CACHE_LINE_SIZE 64
+# else
+#  define UAVCAN_CACHE_LINE_SIZE 32
+# endif
+#endif
+
+/**
+ * Implementation of the transfer CRC, see @ref TransferCRC:
+ *  0 - bitwise, no lookup tables;
+ *  1 - one 256-entry table, one byte per step (512 bytes of ROM);
+ *  4 - slicing-by-4, four bytes per step (2 KB of ROM);
+ *  8 - slicing-by-8, eight bytes per step (4 KB of ROM).
+ */
+#ifndef UAVCAN_TRANSFER_CRC_SLICING
+# if UAVCAN_TINY
+#  define UAVCAN_TRANSFER_CRC_SLICING 0
+# elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+#  define UAVCAN_TRANSFER_CRC_SLICING 8
+# else
+#  define UAVCAN_TRANSFER_CRC_SLICING 1
+# endif
+#endif
+
+#if (UAVCAN_TRANSFER_CRC_SLICING != 0) && (UAVCAN_TRANSFER_CRC_SLICING != 1) && \
+    (UAVCAN_TRANSFER_CRC_SLICING != 4) && (UAVCAN_TRANSFER_CRC_SLICING != 8)
+# error UAVCAN_TRANSFER_CRC_SLICING must be 0, 1, 4 or 8
+#endif
+
+/**
+ * Allows the user's application to provide a custom implementation of TransferCRC::add(const uint8_t*, unsigned),
+ * e.g. one that offloads the computation to the CRC peripheral of the MCU. The peripheral must be configured for
+ * CRC-16-CCITT-FALSE: polynomial 0x1021, 16-bit, no input/output reflection, initial value = current CRC value.
+ */
+#ifndef UAVCAN_USE_EXTERNAL_TRANSFER_CRC
+# define UAVCAN_USE_EXTERNAL_TRANSFER_CRC 0
+#endif
+
+/**
+ * Attribution of the memory pool usage to the library subsystems (TX queues, RX buffers, etc.), see
+ * @ref PoolUsageTracker. If disabled, the subsystems allocate directly from the node's allocator, which saves
+ * a few bytes of RAM per transfer listener, and the tracker attributes all blocks to PoolUsageTagOther.
+ */
+#ifndef UAVCAN_POOL_USAGE_ATTRIBUTION
+# if UAVCAN_TINY
+#  define UAVCAN_POOL_USAGE_ATTRIBUTION 0
+# else
+#  define UAVCAN_POOL_USAGE_ATTRIBUTION 1
+# endif
+#endif
+
+/**
+ * Default callback type of the node classes (subscribers, service clients and servers, timers, ...) in C++11 mode.
+ * If enabled, it's @ref InplaceFunction, which keeps the callable object in a fixed buffer inside the node class
+ * object, so that setting a callback never allocates from the heap, and invokes it through a single function pointer.
+ * If disabled, it's std::function<>. Either way the callback type can be specified explicitly per object.
+ */
+#ifndef UAVCAN_INPLACE_CALLBACKS
+# define UAVCAN_INPLACE_CALLBACKS UAVCAN_GENERAL_PURPOSE_PLATFORM
+#endif
+
+/**
+ * Size of the buffer of @ref InplaceFunction by default, in bytes. A callable object that doesn't fit is rejected
+ * at compile time. The default fits a lambda that captures four pointers or references on a 64-bit platform,
+ * or a @ref MethodBinder.
+ */
+#ifndef UAVCAN_INPLACE_FUNCTION_CAPACITY
+# define UAVCAN_INPLACE_FUNCTION_CAPACITY 32
+#endif
+
+/**
+ * Profiling of the handlers invoked by the scheduler, see @ref HandlerProfiler: the callbacks of the subscribers and
+ * service servers, and the deadline handlers (timers). Every handler accumulates its invocation count and execution
+ * time, and optionally the stack high water mark. It costs two clock reads per invocation and about 40 bytes of RAM
+ * per handler, so it is disabled by default.
+ */
+#ifndef UAVCAN_HANDLER_PROFILING
+# define UAVCAN_HANDLER_PROFILING 0
+#endif
+
 namespace uavcan
 {
 /**
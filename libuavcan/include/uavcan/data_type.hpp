@@ -10,12 +10,11 @@
 #include <uavcan/std.hpp>
 #include <uavcan/build_config.hpp>
 #include <uavcan/transport/transfer.hpp>
+#include <uavcan/transport/crc.hpp>
 
 namespace uavcan
 {
 
-class UAVCAN_EXPORT TransferCRC;
-
 enum DataTypeKind
 {
     DataTypeKindService,
@@ -55,7 +54,7 @@ public:
 
     DataTypeID() : value_(0xFFFFFFFFUL) { }
 
-    DataTypeID(uint16_t id)  // Implicit
+    UAVCAN_CONSTEXPR DataTypeID(uint16_t id)  // Implicit
         : value_(id)
     { }
 
@@ -112,7 +111,7 @@ class UAVCAN_EXPORT DataTypeSignature
 
 public:
     DataTypeSignature() : value_(0) { }
-    explicit DataTypeSignature(uint64_t value) : value_(value) { }
+    UAVCAN_CONSTEXPR explicit DataTypeSignature(uint64_t value) : value_(value) { }
 
     void extend(DataTypeSignature dts);
 
@@ -133,31 +132,67 @@ class UAVCAN_EXPORT DataTypeDescriptor
     const char* full_name_;
     DataTypeKind kind_;
     DataTypeID id_;
+    TransferCRC transfer_crc_base_;
 
 public:
     static const unsigned MaxFullNameLen = 80;
 
     DataTypeDescriptor() :
         full_name_(""),
-        kind_(DataTypeKind(0))
+        kind_(DataTypeKind(0)),
+        transfer_crc_base_(signature_.toTransferCRC())
     { }
 
     DataTypeDescriptor(DataTypeKind kind, DataTypeID id, const DataTypeSignature& signature, const char* name) :
         signature_(signature),
         full_name_(name),
         kind_(kind),
-        id_(id)
+        id_(id),
+        transfer_crc_base_(signature.toTransferCRC())
     {
         UAVCAN_ASSERT((kind == DataTypeKindMessage) || (kind == DataTypeKindService));
         UAVCAN_ASSERT(name);
         UAVCAN_ASSERT(std::strlen(name) <= MaxFullNameLen);
     }
 
+    /**
+     * Same as above, but the transfer CRC seeded with the signature is provided by the caller, e.g. as
+     * precomputed by the DSDL compiler (TransferCRCBase of the generated types).
+     */
+    DataTypeDescriptor(DataTypeKind kind, DataTypeID id, const DataTypeSignature& signature, const char* name,
+                       TransferCRC transfer_crc_base) :
+        signature_(signature),
+        full_name_(name),
+        kind_(kind),
+        id_(id),
+        transfer_crc_base_(transfer_crc_base)
+    {
+        UAVCAN_ASSERT((kind == DataTypeKindMessage) || (kind == DataTypeKindService));
+        UAVCAN_ASSERT(name);
+        UAVCAN_ASSERT(std::strlen(name) <= MaxFullNameLen);
+        UAVCAN_ASSERT(signature.toTransferCRC().get() == transfer_crc_base.get());
+    }
+
+    /**
+     * Compile-time constructor for the data type tables generated by the DSDL compiler, which can be placed in ROM.
+     * The arguments are not checked here; the table is validated when it is adopted by the registry,
+     * see @ref GlobalDataTypeRegistry::adoptTable().
+     */
+    UAVCAN_CONSTEXPR DataTypeDescriptor(DataTypeKind kind, uint16_t id, uint64_t signature, const char* name,
+                                        uint16_t transfer_crc_base) :
+        signature_(signature),
+        full_name_(name),
+        kind_(kind),
+        id_(id),
+        transfer_crc_base_(transfer_crc_base)
+    { }
+
     bool isValid() const;
 
     DataTypeKind getKind() const { return kind_; }
     DataTypeID getID() const { return id_; }
     const DataTypeSignature& getSignature() const { return signature_; }
+    TransferCRC getTransferCRCBase() const { return transfer_crc_base_; }    ///< @ref DataTypeSignature::toTransferCRC()
     const char* getFullName() const { return full_name_; }
 
     bool match(DataTypeKind kind, const char* name) const;
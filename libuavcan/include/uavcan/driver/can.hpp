@@ -36,17 +36,31 @@ struct UAVCAN_EXPORT CanFrame
 #endif
 
     uint32_t id;                ///< CAN ID with flags (above)
-    uint8_t data[MaxDataLen];
     uint8_t dlc;                ///< Data Length Code
     bool canfd;
+    uint8_t data[MaxDataLen];   ///< The last field, see UAVCAN_CAN_TX_QUEUE_COMPACT_ENTRIES
+
+    enum UsedDataOnlyTag { UsedDataOnly };
 
     CanFrame() :
         id(0),
-        dlc(0)
+        dlc(0),
+        canfd(false)
     {
         fill(data, data + MaxDataLen, uint8_t(0));
     }
 
+    /**
+     * Copies the frame without the unused part of the data field, which is neither read nor written.
+     */
+    CanFrame(const CanFrame& other, UsedDataOnlyTag) :
+        id(other.id),
+        dlc(other.dlc),
+        canfd(other.canfd)
+    {
+        (void)copy(other.data, other.data + getDataLength(), data);
+    }
+
     CanFrame(uint32_t can_id, const uint8_t* can_data, uint8_t data_len, bool canfd_frame = false) :
         id(can_id),
         canfd(canfd_frame)
@@ -83,6 +97,8 @@ struct UAVCAN_EXPORT CanFrame
 
     bool isCanFDFrame() const { return canfd; }
 
+    uint8_t getDataLength() const { return dlcToDataLength(dlc); }
+
     bool operator!=(const CanFrame& rhs) const { return !operator==(rhs); }
     bool operator==(const CanFrame& rhs) const
     {
@@ -166,6 +182,24 @@ struct UAVCAN_EXPORT CanFrame
     bool priorityLowerThan(const CanFrame& rhs) const { return rhs.priorityHigherThan(*this); }
 };
 
+/**
+ * Received CAN frame together with its timestamps and the index of the interface it was received from.
+ */
+struct UAVCAN_EXPORT CanRxFrame : public CanFrame
+{
+    MonotonicTime ts_mono;
+    UtcTime ts_utc;
+    uint8_t iface_index;
+
+    CanRxFrame()
+        : iface_index(0)
+    { }
+
+#if UAVCAN_TOSTRING
+    std::string toString(StringRepresentation mode = StrTight) const;
+#endif
+};
+
 /**
  * CAN hardware filter config struct.
  * Flags from @ref CanFrame can be applied to define frame type (EFF, EXT, etc.).
@@ -237,6 +271,83 @@ public:
      */
     virtual int16_t send(const CanFrame& frame, MonotonicTime tx_deadline, CanIOFlags flags) = 0;
 
+    /**
+     * Non-blocking transmission of multiple frames at once.
+     *
+     * The frames are ordered by priority, highest first; the driver must accept them strictly in this order,
+     * i.e. it may accept only a prefix of the array. Drivers that can fill several hardware mailboxes or
+     * messages per system call (e.g. sendmmsg() on SocketCAN) should override this method.
+     * The default implementation invokes @ref send() for the first frame only.
+     *
+     * @param [in] frames           Array of num_frames pointers to the frames.
+     * @param [in] tx_deadlines     Array of num_frames TX deadlines, per frame.
+     * @param [in] flags            Array of num_frames flags, per frame.
+     * @param [in] num_frames       Number of frames to transmit; at least one.
+     * @return Number of frames accepted, 0 = TX buffer full, negative for error.
+     */
+    virtual int16_t sendBatch(const CanFrame* const* frames, const MonotonicTime* tx_deadlines,
+                              const CanIOFlags* flags, uint16_t num_frames)
+    {
+        if ((frames == UAVCAN_NULLPTR) || (tx_deadlines == UAVCAN_NULLPTR) || (flags == UAVCAN_NULLPTR) ||
+            (num_frames == 0))
+        {
+            UAVCAN_ASSERT(0);
+            return 0;
+        }
+        return send(*frames[0], tx_deadlines[0], flags[0]);
+    }
+
+    /**
+     * Aborts the pending transmission of a frame held by the driver (e.g. in a hardware mailbox) in favor of
+     * a frame of higher priority, so that the latter can be accepted by the next call of @ref send().
+     * This prevents priority inversion on controllers with few TX mailboxes, where a low priority frame would
+     * otherwise keep a mailbox while frames of higher priority are waiting. Drivers that implement this method
+     * should also report the interface writeable in select() if the pending frame of the interface has higher
+     * priority than one of the frames held by the driver.
+     *
+     * The driver should abort the held frame of the lowest priority; among frames of equal priority, the one
+     * that would be transmitted last. A frame whose transmission could not be aborted (e.g. because it has
+     * already started) must not be reported. The library puts the aborted frame back into its TX queue.
+     *
+     * The default implementation aborts nothing, which suits drivers with their own priority-ordered queues.
+     *
+     * @param [in]  frame               Frame that needs a mailbox.
+     * @param [out] out_frame           The aborted frame.
+     * @param [out] out_tx_deadline     TX deadline of the aborted frame, as it was passed to @ref send().
+     * @param [out] out_flags           Flags of the aborted frame, as they were passed to @ref send().
+     * @return 1 = one frame aborted, 0 = nothing to abort, negative for error.
+     */
+    virtual int16_t abortLowerPriority(const CanFrame& frame, CanFrame& out_frame, MonotonicTime& out_tx_deadline,
+                                       CanIOFlags& out_flags)
+    {
+        (void)frame;
+        (void)out_frame;
+        (void)out_tx_deadline;
+        (void)out_flags;
+        return 0;
+    }
+
+    /**
+     * Transmits the frame as soon as possible, ahead of the frames queued in the driver and, if the hardware
+     * allows, of the frames held in the TX mailboxes, bypassing the TX queue of the library. This is used for the
+     * emergency messages, see @ref PanicBroadcaster::triggerEmergency(), which may have to be sent while the node
+     * thread is stuck or the TX queue is full.
+     *
+     * Unlike the other methods, this one may be invoked from an interrupt handler or from any thread, concurrently
+     * with the other methods, and the implementation must be safe for that, e.g. by keeping a TX mailbox reserved
+     * for this purpose. The frame must be sent without loopback. A driver may abort a pending frame of lower
+     * priority to make room; the aborted frame is then lost, which is acceptable in an emergency.
+     *
+     * The default implementation doesn't support this and returns a negative value.
+     *
+     * @return 1 = the frame will be transmitted, 0 = no room, negative for error.
+     */
+    virtual int16_t sendEmergency(const CanFrame& frame)
+    {
+        (void)frame;
+        return -1;
+    }
+
     /**
      * Non-blocking reception.
      *
@@ -257,6 +368,32 @@ public:
     virtual int16_t receive(CanFrame& out_frame, MonotonicTime& out_ts_monotonic, UtcTime& out_ts_utc,
                             CanIOFlags& out_flags) = 0;
 
+    /**
+     * Non-blocking reception of multiple frames at once.
+     *
+     * Drivers that can fetch several frames per system call or per interrupt (e.g. recvmmsg() on SocketCAN,
+     * multi-message hardware RX FIFOs) should override this method in order to let the library drain a whole
+     * burst of frames without running select() and a virtual call per frame.
+     * The default implementation invokes @ref receive() once.
+     *
+     * The interface index field of the output frames need not be set by the driver; the library sets it.
+     * Timestamps and flags follow the same rules as for @ref receive(). Flags are zeroed by the caller.
+     *
+     * @param [out] out_frames  Array of at least max_frames frames.
+     * @param [out] out_flags   Array of at least max_frames flags, per frame.
+     * @param [in]  max_frames  Capacity of the output arrays; at least one.
+     * @return Number of frames received, 0 = RX buffer empty, negative for error.
+     */
+    virtual int16_t receiveBatch(CanRxFrame* out_frames, CanIOFlags* out_flags, uint16_t max_frames)
+    {
+        if ((out_frames == UAVCAN_NULLPTR) || (out_flags == UAVCAN_NULLPTR) || (max_frames == 0))
+        {
+            UAVCAN_ASSERT(0);
+            return 0;
+        }
+        return receive(out_frames[0], out_frames[0].ts_mono, out_frames[0].ts_utc, out_flags[0]);
+    }
+
     /**
      * Configure the hardware CAN filters. @ref CanFilterConfig.
      *
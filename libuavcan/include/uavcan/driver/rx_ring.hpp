@@ -0,0 +1,222 @@
+/*
+ * Lock-free RX ring buffer for CAN drivers.
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_DRIVER_RX_RING_HPP_INCLUDED
+#define UAVCAN_DRIVER_RX_RING_HPP_INCLUDED
+
+#include <atomic>
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/driver/can.hpp>
+#include <uavcan/util/templates.hpp>
+
+namespace uavcan
+{
+/**
+ * Single-producer/single-consumer lock-free ring buffer of received CAN frames.
+ *
+ * It is intended to pass frames from the CAN RX interrupt handler (producer) to the thread that runs the library
+ * (consumer). The producer side never blocks and is safe to use from an ISR; if the ring is full, the new frame is
+ * dropped and counted as an overflow, so the frames that are already enqueued are delivered in order.
+ * The consumer side methods have the same semantics as the corresponding methods of @ref ICanIface, so that the
+ * driver can simply forward its @ref ICanIface::receive() and @ref ICanIface::receiveBatch() to the ring.
+ *
+ * The indices written by the producer and by the consumer are kept on separate cache lines
+ * (@ref UAVCAN_CACHE_LINE_SIZE) to avoid false sharing on multi-core targets.
+ * Only plain atomic loads and stores are used, which are lock-free on all supported architectures.
+ *
+ * @tparam Capacity_    Number of frames, must be a power of two.
+ */
+template <unsigned Capacity_>
+class UAVCAN_EXPORT CanRxRing : Noncopyable
+{
+public:
+    enum { Capacity = Capacity_ };
+
+private:
+    /// Indices are free-running and wrap around naturally, because the capacity is a power of two
+    typedef uint32_t Index;
+
+    enum { IndexMask = Capacity - 1 };
+
+    struct Entry
+    {
+        CanRxFrame frame;
+        CanIOFlags flags;
+
+        Entry() : flags(0) { }
+    };
+
+    Entry entries_[Capacity];
+
+    // Written by the producer only
+    alignas(UAVCAN_CACHE_LINE_SIZE) std::atomic<Index> head_;
+    std::atomic<uint32_t> num_overflows_;
+    std::atomic<uint16_t> peak_size_;
+
+    // Written by the consumer only
+    alignas(UAVCAN_CACHE_LINE_SIZE) std::atomic<Index> tail_;
+
+    Entry* acquire()
+    {
+        const Index head = head_.load(std::memory_order_relaxed);
+        if ((head - tail_.load(std::memory_order_acquire)) >= Index(Capacity))
+        {
+            num_overflows_.store(num_overflows_.load(std::memory_order_relaxed) + 1U, std::memory_order_relaxed);
+            return UAVCAN_NULLPTR;
+        }
+        return &entries_[head & IndexMask];
+    }
+
+public:
+    CanRxRing()
+        : head_(0)
+        , num_overflows_(0)
+        , peak_size_(0)
+        , tail_(0)
+    {
+        StaticAssert<(Capacity >= 2)>::check();
+        StaticAssert<((Capacity & (Capacity - 1)) == 0)>::check();
+        StaticAssert<(Capacity <= 0x8000U)>::check();
+    }
+
+    /**
+     * Producer side (ISR).
+     * Zero-copy insertion: returns a slot to fill in, or null if the ring is full (the overflow is counted).
+     * The slot becomes visible to the consumer once @ref commitPush() is called.
+     */
+    CanRxFrame* beginPush()
+    {
+        Entry* const e = acquire();
+        return (e != UAVCAN_NULLPTR) ? &e->frame : UAVCAN_NULLPTR;
+    }
+
+    /**
+     * Producer side (ISR).
+     * Must follow a successful @ref beginPush().
+     */
+    void commitPush(CanIOFlags flags = 0)
+    {
+        const Index head = head_.load(std::memory_order_relaxed);
+        entries_[head & IndexMask].flags = flags;
+        head_.store(head + 1U, std::memory_order_release);
+
+        const uint16_t size = static_cast<uint16_t>(head + 1U - tail_.load(std::memory_order_relaxed));
+        if (size > peak_size_.load(std::memory_order_relaxed))
+        {
+            peak_size_.store(size, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Producer side (ISR).
+     * @return True if the frame was enqueued, false if the ring is full and the frame has been dropped.
+     */
+    bool push(const CanRxFrame& frame, CanIOFlags flags = 0)
+    {
+        CanRxFrame* const slot = beginPush();
+        if (slot == UAVCAN_NULLPTR)
+        {
+            return false;
+        }
+        *slot = frame;
+        commitPush(flags);
+        return true;
+    }
+
+    bool push(const CanFrame& frame, MonotonicTime ts_mono, UtcTime ts_utc, CanIOFlags flags = 0)
+    {
+        CanRxFrame* const slot = beginPush();
+        if (slot == UAVCAN_NULLPTR)
+        {
+            return false;
+        }
+        static_cast<CanFrame&>(*slot) = frame;
+        slot->ts_mono = ts_mono;
+        slot->ts_utc = ts_utc;
+        commitPush(flags);
+        return true;
+    }
+
+    /**
+     * Consumer side.
+     * Refer to @ref ICanIface::receive().
+     * @return 1 = one frame received, 0 = the ring is empty.
+     */
+    int16_t receive(CanFrame& out_frame, MonotonicTime& out_ts_monotonic, UtcTime& out_ts_utc,
+                    CanIOFlags& out_flags)
+    {
+        const Index tail = tail_.load(std::memory_order_relaxed);
+        if (head_.load(std::memory_order_acquire) == tail)
+        {
+            return 0;
+        }
+        const Entry& e = entries_[tail & IndexMask];
+        out_frame = e.frame;
+        out_ts_monotonic = e.frame.ts_mono;
+        out_ts_utc = e.frame.ts_utc;
+        out_flags = e.flags;
+        tail_.store(tail + 1U, std::memory_order_release);
+        return 1;
+    }
+
+    /**
+     * Consumer side.
+     * Refer to @ref ICanIface::receiveBatch().
+     * @return Number of frames received, 0 = the ring is empty.
+     */
+    int16_t receiveBatch(CanRxFrame* out_frames, CanIOFlags* out_flags, uint16_t max_frames)
+    {
+        if ((out_frames == UAVCAN_NULLPTR) || (out_flags == UAVCAN_NULLPTR))
+        {
+            UAVCAN_ASSERT(0);
+            return 0;
+        }
+        const Index tail = tail_.load(std::memory_order_relaxed);
+        const Index available = head_.load(std::memory_order_acquire) - tail;
+        const uint16_t num = static_cast<uint16_t>(min<Index>(available, min<Index>(max_frames, 0x7FFFU)));
+        for (uint16_t i = 0; i < num; i++)
+        {
+            const Entry& e = entries_[(tail + i) & IndexMask];
+            out_frames[i] = e.frame;
+            out_flags[i] = e.flags;
+        }
+        tail_.store(tail + num, std::memory_order_release);
+        return static_cast<int16_t>(num);
+    }
+
+    /**
+     * Consumer side.
+     * Drops all enqueued frames.
+     */
+    void clear()
+    {
+        tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    /**
+     * Number of enqueued frames; can be called from either side, the result is a snapshot.
+     */
+    unsigned getSize() const
+    {
+        return unsigned(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+    }
+
+    bool isEmpty() const { return getSize() == 0; }
+
+    /**
+     * Number of frames dropped because the ring was full.
+     */
+    uint32_t getNumOverflows() const { return num_overflows_.load(std::memory_order_relaxed); }
+
+    /**
+     * Maximum number of frames that were enqueued at once; helps to choose the capacity.
+     */
+    unsigned getPeakSize() const { return peak_size_.load(std::memory_order_relaxed); }
+};
+
+}
+
+#endif // UAVCAN_DRIVER_RX_RING_HPP_INCLUDED
@@ -53,6 +53,24 @@ public:
      * @param [in] adjustment Amount of time to add to the clock value.
      */
     virtual void adjustUtc(UtcDuration adjustment) = 0;
+
+    /**
+     * Make the network-synchronized clock run faster or slower than the monotonic clock.
+     * This method is optional; the time synchronization works without it, but it allows the slave to compensate
+     * the frequency error of the local clock continuously rather than in steps.
+     *
+     * For POSIX refer to adjtimex(), ntp_adjtime().
+     *
+     * @param [in] ppm  Rate correction in parts per million; positive makes the clock run faster.
+     *                  Replaces the previous correction.
+     *
+     * @return True if supported; the default implementation does nothing and returns false.
+     */
+    virtual bool setUtcRateAdjustment(float ppm)
+    {
+        (void)ppm;
+        return false;
+    }
 };
 
 }
@@ -15,6 +15,21 @@
 
 namespace uavcan
 {
+/**
+ * Library subsystems the memory pool usage is attributed to, see @ref PoolUsageTracker.
+ */
+enum PoolUsageTag
+{
+    PoolUsageTagOther,                      ///< Everything that is not attributed explicitly, e.g. the application
+    PoolUsageTagTxQueue,                    ///< CAN TX queues
+    PoolUsageTagRxBuffer,                   ///< Multi-frame transfer reception buffers and their index
+    PoolUsageTagReceiverMap,                ///< Transfer receiver maps of the transfer listeners
+    PoolUsageTagOutgoingTransferRegistry,   ///< Transfer ID registry of the publishers and servers
+    PoolUsageTagServiceCallRegistry,        ///< Pending calls of the service clients
+    PoolUsageTagRxQueue,                    ///< Receive queues of the queued subscribers
+    NumPoolUsageTags
+};
+
 /**
  * This interface is used by other library components that need dynamic memory.
  */
@@ -30,6 +45,19 @@ public:
      * Returns the maximum number of blocks this allocator can allocate.
      */
     virtual uint16_t getBlockCapacity() const = 0;
+
+    /**
+     * Returns the number of blocks that are currently allocated.
+     * Allocators that don't keep track of it return zero; the usage watermarks of the scheduler don't work with them.
+     */
+    virtual uint16_t getNumUsedBlocks() const { return 0; }
+
+    /**
+     * Same as allocate()/deallocate(), with the subsystem the memory is allocated by.
+     * Allocators that don't account the usage per subsystem ignore the tag.
+     */
+    virtual void* allocateTagged(std::size_t size, PoolUsageTag) { return allocate(size); }
+    virtual void deallocateTagged(const void* ptr, PoolUsageTag) { deallocate(ptr); }
 };
 
 /**
@@ -82,7 +110,7 @@ public:
     /**
      * Return the number of blocks that are currently allocated/unallocated.
      */
-    uint16_t getNumUsedBlocks() const
+    virtual uint16_t getNumUsedBlocks() const override
     {
         RaiiSynchronizer lock;
         (void)lock;
@@ -104,6 +132,115 @@ public:
         (void)lock;
         return max_used_;
     }
+
+    /**
+     * Whether the pointer refers to a block of this pool.
+     */
+    bool isOwnerOf(const void* ptr) const
+    {
+        const uint8_t* const p = static_cast<const uint8_t*>(ptr);
+        return (p >= pool_.bytes) && (p < (pool_.bytes + PoolSize));
+    }
+};
+
+/**
+ * Segregated-fit pool allocator with three size classes, each of which is a separate @ref PoolAllocator.
+ * An allocation is served by the smallest class the requested size fits in; if that class is exhausted, the next
+ * larger one is used. Objects allocated by the library vary in size considerably (e.g. a CAN FD TX queue entry
+ * versus an outgoing transfer registry entry), so that with a single block size most blocks are partly wasted.
+ *
+ * The library checks the size of its dynamically allocated types against @ref MemPoolBlockSize at compile time,
+ * hence the largest block size must not be smaller than that.
+ *
+ * Statistics are available per size class via the accessors of the underlying pools.
+ */
+template <std::size_t SmallPoolSize, uint8_t SmallBlockSize,
+          std::size_t MediumPoolSize, uint8_t MediumBlockSize,
+          std::size_t LargePoolSize, uint8_t LargeBlockSize,
+          typename RaiiSynchronizer = char>
+class UAVCAN_EXPORT SegregatedPoolAllocator : public IPoolAllocator,
+                                              Noncopyable
+{
+public:
+    typedef PoolAllocator<SmallPoolSize, SmallBlockSize, RaiiSynchronizer> SmallPool;
+    typedef PoolAllocator<MediumPoolSize, MediumBlockSize, RaiiSynchronizer> MediumPool;
+    typedef PoolAllocator<LargePoolSize, LargeBlockSize, RaiiSynchronizer> LargePool;
+
+private:
+    SmallPool small_;
+    MediumPool medium_;
+    LargePool large_;
+
+public:
+    SegregatedPoolAllocator()
+    {
+        StaticAssert<(SmallBlockSize < MediumBlockSize) && (MediumBlockSize < LargeBlockSize)>::check();
+        StaticAssert<(LargeBlockSize >= MemPoolBlockSize)>::check();
+        StaticAssert<((SmallBlockSize % MemPoolAlignment) == 0) && ((MediumBlockSize % MemPoolAlignment) == 0)>::
+            check();
+        StaticAssert<((SmallPool::NumBlocks + MediumPool::NumBlocks + LargePool::NumBlocks) <= 0xFFFFU)>::check();
+    }
+
+    virtual void* allocate(std::size_t size) override
+    {
+        void* ptr = UAVCAN_NULLPTR;
+        if (size <= SmallBlockSize)
+        {
+            ptr = small_.allocate(size);
+        }
+        if ((ptr == UAVCAN_NULLPTR) && (size <= MediumBlockSize))
+        {
+            ptr = medium_.allocate(size);
+        }
+        if (ptr == UAVCAN_NULLPTR)
+        {
+            ptr = large_.allocate(size);
+        }
+        return ptr;
+    }
+
+    virtual void deallocate(const void* ptr) override
+    {
+        if (ptr == UAVCAN_NULLPTR)
+        {
+            return;
+        }
+        if (small_.isOwnerOf(ptr))
+        {
+            small_.deallocate(ptr);
+        }
+        else if (medium_.isOwnerOf(ptr))
+        {
+            medium_.deallocate(ptr);
+        }
+        else
+        {
+            UAVCAN_ASSERT(large_.isOwnerOf(ptr));
+            large_.deallocate(ptr);
+        }
+    }
+
+    virtual uint16_t getBlockCapacity() const override
+    {
+        return static_cast<uint16_t>(SmallPool::NumBlocks + MediumPool::NumBlocks + LargePool::NumBlocks);
+    }
+
+    /**
+     * Totals over all size classes.
+     */
+    virtual uint16_t getNumUsedBlocks() const override
+    {
+        return static_cast<uint16_t>(small_.getNumUsedBlocks() + medium_.getNumUsedBlocks() +
+                                     large_.getNumUsedBlocks());
+    }
+    uint16_t getNumFreeBlocks() const
+    {
+        return static_cast<uint16_t>(getBlockCapacity() - getNumUsedBlocks());
+    }
+
+    const SmallPool& getSmallPool() const { return small_; }
+    const MediumPool& getMediumPool() const { return medium_; }
+    const LargePool& getLargePool() const { return large_; }
 };
 
 /**
@@ -112,7 +249,7 @@ public:
 class LimitedPoolAllocator : public IPoolAllocator
 {
     IPoolAllocator& allocator_;
-    const uint16_t max_blocks_;
+    uint16_t max_blocks_;
     uint16_t used_blocks_;
 
 public:
@@ -128,6 +265,271 @@ public:
     virtual void deallocate(const void* ptr) override;
 
     virtual uint16_t getBlockCapacity() const override;
+
+    /**
+     * The limit can be changed at any time. If it is set below the number of used blocks, the blocks stay allocated
+     * and further allocations fail until enough blocks are released.
+     */
+    void setMaxBlocks(std::size_t max_blocks)
+    {
+        max_blocks_ = static_cast<uint16_t>(min<std::size_t>(max_blocks, 0xFFFFU));
+        UAVCAN_ASSERT(max_blocks_ > 0);
+    }
+    uint16_t getMaxBlocks() const { return max_blocks_; }
+
+    virtual uint16_t getNumUsedBlocks() const override { return used_blocks_; }
+};
+
+/**
+ * Guarantees a minimum number of blocks to its owner, which is the opposite of @ref LimitedPoolAllocator.
+ * The guaranteed blocks are taken from the given allocator in advance and kept in a reserve. Allocations are served
+ * by the given allocator first; the reserve is used only if it fails, e.g. because the shared pool has been used up
+ * by other subsystems. Deallocated blocks are returned to the given allocator, and the reserve, if it is not full,
+ * is refilled with a new block of @ref MemPoolBlockSize bytes, so that smaller blocks never end up in the reserve.
+ * This way the owner can always have at least the guaranteed number of blocks allocated, no matter what the rest
+ * of the application does with the pool.
+ *
+ * The reserve can serve only allocations of up to @ref MemPoolBlockSize bytes, which are all allocations made by
+ * the library. All memory is allocated from the given allocator with the tag passed to the constructor.
+ */
+class GuaranteedPoolAllocator : public IPoolAllocator
+{
+    struct ReservedBlock
+    {
+        ReservedBlock* next;
+    };
+
+    IPoolAllocator& allocator_;
+    ReservedBlock* reserve_;
+    uint16_t min_blocks_;
+    uint16_t num_reserved_blocks_;
+#if UAVCAN_POOL_USAGE_ATTRIBUTION
+    const PoolUsageTag tag_;
+#endif
+
+    PoolUsageTag getTag() const
+    {
+#if UAVCAN_POOL_USAGE_ATTRIBUTION
+        return tag_;
+#else
+        return PoolUsageTagOther;
+#endif
+    }
+
+    void releaseReserve(uint16_t num_blocks_to_keep);
+
+public:
+    explicit GuaranteedPoolAllocator(IPoolAllocator& allocator, PoolUsageTag tag = PoolUsageTagOther)
+        : allocator_(allocator)
+        , reserve_(UAVCAN_NULLPTR)
+        , min_blocks_(0)
+        , num_reserved_blocks_(0)
+#if UAVCAN_POOL_USAGE_ATTRIBUTION
+        , tag_(tag)
+#endif
+    {
+        (void)tag;
+    }
+
+    virtual ~GuaranteedPoolAllocator() { releaseReserve(0); }
+
+    virtual void* allocate(std::size_t size) override;
+    virtual void deallocate(const void* ptr) override;
+
+    virtual uint16_t getBlockCapacity() const override { return allocator_.getBlockCapacity(); }
+
+    /**
+     * The reserved blocks are counted as used, since they are allocated from the given allocator.
+     */
+    virtual uint16_t getNumUsedBlocks() const override { return allocator_.getNumUsedBlocks(); }
+
+    /**
+     * Same as allocate(), but never touches the reserve.
+     * Useful if only some of the allocations made by the owner are entitled to the guaranteed blocks.
+     */
+    void* allocateUnreserved(std::size_t size) { return allocator_.allocateTagged(size, getTag()); }
+
+    /**
+     * Changes the number of guaranteed blocks. Raising it allocates the missing blocks of the reserve at once;
+     * if the given allocator can't provide them all, nothing is changed and false is returned.
+     * Lowering it returns the excess blocks of the reserve to the given allocator.
+     */
+    bool setMinBlocks(std::size_t min_blocks);
+    uint16_t getMinBlocks() const { return min_blocks_; }
+
+    /**
+     * Number of blocks that are currently kept in the reserve. It is lower than the guaranteed number of blocks
+     * only while the reserve is being used.
+     */
+    uint16_t getNumReservedBlocks() const { return num_reserved_blocks_; }
+};
+
+#if UAVCAN_POOL_USAGE_ATTRIBUTION
+/**
+ * Attributes all allocations made through it to one subsystem and forwards them to the given allocator.
+ * Library subsystems allocate through an instance of this class, so that the usage can be accounted by
+ * a @ref PoolUsageTracker further down the chain. When chained, the innermost tag takes precedence.
+ */
+class TaggedPoolAllocator : public IPoolAllocator
+{
+    IPoolAllocator& allocator_;
+    const PoolUsageTag tag_;
+
+public:
+    TaggedPoolAllocator(IPoolAllocator& allocator, PoolUsageTag tag)
+        : allocator_(allocator)
+        , tag_(tag)
+    { }
+
+    virtual void* allocate(std::size_t size) override { return allocator_.allocateTagged(size, tag_); }
+    virtual void deallocate(const void* ptr) override { allocator_.deallocateTagged(ptr, tag_); }
+
+    virtual uint16_t getBlockCapacity() const override { return allocator_.getBlockCapacity(); }
+    virtual uint16_t getNumUsedBlocks() const override { return allocator_.getNumUsedBlocks(); }
+
+    virtual void* allocateTagged(std::size_t size, PoolUsageTag tag) override
+    {
+        return allocator_.allocateTagged(size, tag);
+    }
+    virtual void deallocateTagged(const void* ptr, PoolUsageTag tag) override
+    {
+        allocator_.deallocateTagged(ptr, tag);
+    }
+
+    PoolUsageTag getTag() const { return tag_; }
+};
+#else
+/**
+ * The attribution is disabled; the subsystems allocate directly from the given allocator.
+ */
+class TaggedPoolAllocator
+{
+    IPoolAllocator& allocator_;
+
+public:
+    TaggedPoolAllocator(IPoolAllocator& allocator, PoolUsageTag)
+        : allocator_(allocator)
+    { }
+
+    operator IPoolAllocator&() const { return allocator_; }
+};
+#endif
+
+/**
+ * Accounts the current and peak number of blocks used by every library subsystem, as well as the number of
+ * allocations that failed, in a given allocator. The tracker should be passed to the node in place of the pool:
+ *     uavcan::PoolAllocator<PoolSize, uavcan::MemPoolBlockSize> pool;
+ *     uavcan::PoolUsageTracker tracker(pool);
+ *     uavcan::Node<0> node(can_driver, system_clock, tracker);
+ *
+ * Memory allocated not through the library subsystems is attributed to PoolUsageTagOther.
+ * This class is not thread-safe, same as @ref LimitedPoolAllocator.
+ */
+class PoolUsageTracker : public IPoolAllocator
+{
+    struct Usage
+    {
+        uint16_t used;
+        uint16_t max_used;
+        uint32_t failures;
+    };
+
+    IPoolAllocator& allocator_;
+    Usage usage_[NumPoolUsageTags];
+
+public:
+    explicit PoolUsageTracker(IPoolAllocator& allocator)
+        : allocator_(allocator)
+    {
+        (void)std::memset(usage_, 0, sizeof(usage_));
+    }
+
+    virtual void* allocate(std::size_t size) override { return allocateTagged(size, PoolUsageTagOther); }
+    virtual void deallocate(const void* ptr) override { deallocateTagged(ptr, PoolUsageTagOther); }
+
+    virtual uint16_t getBlockCapacity() const override { return allocator_.getBlockCapacity(); }
+
+    /**
+     * Number of blocks currently used in the given allocator, including the memory not allocated through the tracker.
+     */
+    virtual uint16_t getNumUsedBlocks() const override { return allocator_.getNumUsedBlocks(); }
+
+    virtual void* allocateTagged(std::size_t size, PoolUsageTag tag) override;
+    virtual void deallocateTagged(const void* ptr, PoolUsageTag tag) override;
+
+    /**
+     * Number of blocks currently used by the subsystem.
+     */
+    uint16_t getNumUsedBlocks(PoolUsageTag tag) const;
+
+    /**
+     * Maximum number of blocks that were used by the subsystem at the same time.
+     */
+    uint16_t getPeakNumUsedBlocks(PoolUsageTag tag) const;
+
+    /**
+     * Number of allocations of the subsystem that failed, e.g. because the pool was exhausted.
+     */
+    uint32_t getNumFailedAllocations(PoolUsageTag tag) const;
+
+    /**
+     * Sum of the current number of blocks used by all subsystems.
+     */
+    uint16_t getTotalNumUsedBlocks() const;
+
+    /**
+     * Sets the peaks to the current usage, e.g. to find out the usage over a specific period of operation.
+     */
+    void resetPeaks();
+};
+
+/**
+ * Routes the memory of every library subsystem to a separate allocator, so that each can be placed in the memory
+ * region that suits it best, e.g. the TX queues and RX buffers in the core coupled memory and the rest in SRAM:
+ *     uavcan::PoolAllocator<4096, uavcan::MemPoolBlockSize> sram_pool;
+ *     uavcan::PoolAllocator<2048, uavcan::MemPoolBlockSize> ccm_pool __attribute__((section(".ccm")));
+ *     uavcan::PoolAllocatorRouter router(sram_pool);
+ *     router.setAllocator(uavcan::PoolUsageTagTxQueue, ccm_pool);
+ *     router.setAllocator(uavcan::PoolUsageTagRxBuffer, ccm_pool);
+ *     uavcan::Node<0> node(can_driver, system_clock, router);
+ *
+ * The subsystems that have no allocator assigned, as well as the untagged allocations, use the default allocator.
+ * A block is returned to the allocator of the tag it is deallocated with, which is the tag it was allocated with,
+ * so the routing of a subsystem must not be changed while it holds any blocks; it's best set up before the node is
+ * constructed. The router can be chained with @ref PoolUsageTracker in either order.
+ *
+ * Requires UAVCAN_POOL_USAGE_ATTRIBUTION; if it is disabled, all memory is taken from the default allocator.
+ * The capacity and usage reported by the router are the sums over all distinct allocators; note that the default
+ * quota of the TX queues is derived from the capacity, so it may need to be adjusted if the TX queues have
+ * a smaller region of their own.
+ */
+class PoolAllocatorRouter : public IPoolAllocator
+{
+    IPoolAllocator* allocators_[NumPoolUsageTags];
+
+    bool isFirstOccurrence(unsigned index) const;
+
+public:
+    explicit PoolAllocatorRouter(IPoolAllocator& default_allocator)
+    {
+        fill_n(allocators_, unsigned(NumPoolUsageTags), &default_allocator);
+    }
+
+    virtual void* allocate(std::size_t size) override { return allocateTagged(size, PoolUsageTagOther); }
+    virtual void deallocate(const void* ptr) override { deallocateTagged(ptr, PoolUsageTagOther); }
+
+    virtual uint16_t getBlockCapacity() const override;
+    virtual uint16_t getNumUsedBlocks() const override;
+
+    virtual void* allocateTagged(std::size_t size, PoolUsageTag tag) override;
+    virtual void deallocateTagged(const void* ptr, PoolUsageTag tag) override;
+
+    /**
+     * Assigns the allocator to the subsystem. PoolUsageTagOther is the default allocator.
+     */
+    void setAllocator(PoolUsageTag tag, IPoolAllocator& allocator);
+
+    IPoolAllocator& getAllocator(PoolUsageTag tag) const;
 };
 
 // ----------------------------------------------------------------------------
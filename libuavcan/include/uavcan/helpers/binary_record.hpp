@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_HELPERS_BINARY_RECORD_HPP_INCLUDED
+#define UAVCAN_HELPERS_BINARY_RECORD_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
+#include <uavcan/marshal/bit_stream.hpp>
+#include <uavcan/marshal/scalar_codec.hpp>
+#include <uavcan/marshal/type_util.hpp>
+
+namespace uavcan
+{
+/**
+ * Binary records hold the decoded objects in a form suitable for logging: a header followed by the DSDL
+ * serialization of the object (with the tail array optimization, i.e. exactly as it is transferred over CAN 2.0).
+ * The records can be concatenated; every one of them can be skipped without decoding.
+ *
+ * Header, little endian:
+ *  - payload length in bytes (2)
+ *  - schema ID (8), which is the data type signature; services use the signature of the service type
+ *
+ * Encoding and decoding don't allocate memory; the functions below work with the buffers provided by the caller.
+ */
+struct UAVCAN_EXPORT BinaryRecordHeader
+{
+    enum { Size = 10 };
+
+    uint64_t schema_id;
+    uint16_t payload_length;
+
+    BinaryRecordHeader()
+        : schema_id(0)
+        , payload_length(0)
+    { }
+
+    unsigned getRecordLength() const { return unsigned(Size) + payload_length; }
+};
+
+/**
+ * Returns the length of the header, zero if the buffer is too short, or negative error code.
+ */
+inline int readBinaryRecordHeader(const uint8_t* buffer, unsigned size, BinaryRecordHeader& out_header)
+{
+    if (buffer == UAVCAN_NULLPTR)
+    {
+        return -ErrInvalidParam;
+    }
+    if (size < unsigned(BinaryRecordHeader::Size))
+    {
+        return 0;
+    }
+    out_header.payload_length = uint16_t(buffer[0] | (buffer[1] << 8));
+    out_header.schema_id = 0;
+    for (unsigned i = 0; i < 8; i++)
+    {
+        out_header.schema_id |= uint64_t(buffer[2 + i]) << (i * 8U);
+    }
+    return BinaryRecordHeader::Size;
+}
+
+/**
+ * Writes the record of the object with the given schema ID into the buffer.
+ * Returns the length of the record, zero if the buffer is too short, or negative error code.
+ */
+template <typename DataType>
+int encodeBinaryRecord(const DataType& obj, uint64_t schema_id, uint8_t* buffer, unsigned size)
+{
+    if (buffer == UAVCAN_NULLPTR)
+    {
+        return -ErrInvalidParam;
+    }
+
+    const unsigned payload_length = (DataType::computeEncodedBitLen(obj, TailArrayOptEnabled) + 7U) / 8U;
+    if (payload_length > 0xFFFFU)
+    {
+        return -ErrInvalidParam;
+    }
+    if ((unsigned(BinaryRecordHeader::Size) + payload_length) > size)
+    {
+        return 0;
+    }
+
+    StaticTransferBufferImpl payload(buffer + BinaryRecordHeader::Size, uint16_t(payload_length));
+    BitStream bitstream(payload);
+    ScalarCodec codec(bitstream);
+    const int res = DataType::encode(obj, codec, TailArrayOptEnabled);
+    if (res <= 0)
+    {
+        UAVCAN_ASSERT(0);   // The length has been checked
+        return -ErrInvalidMarshalData;
+    }
+
+    buffer[0] = uint8_t(payload_length & 0xFFU);
+    buffer[1] = uint8_t(payload_length >> 8);
+    for (unsigned i = 0; i < 8; i++)
+    {
+        buffer[2 + i] = uint8_t((schema_id >> (i * 8U)) & 0xFFU);
+    }
+    return int(BinaryRecordHeader::Size + payload_length);
+}
+
+/**
+ * Same as above, with the signature of the data type as the schema ID. Messages only.
+ */
+template <typename DataType>
+int encodeBinaryRecord(const DataType& obj, uint8_t* buffer, unsigned size)
+{
+    return encodeBinaryRecord(obj, DataType::getDataTypeSignature().get(), buffer, size);
+}
+
+/**
+ * Decodes the object from the record at the beginning of the buffer.
+ * Returns the length of the record, zero if the buffer is too short, -ErrUnknownDataType if the record has a different
+ * schema ID, or other negative error code.
+ */
+template <typename DataType>
+int decodeBinaryRecord(const uint8_t* buffer, unsigned size, uint64_t schema_id, DataType& out_obj)
+{
+    BinaryRecordHeader header;
+    const int header_res = readBinaryRecordHeader(buffer, size, header);
+    if (header_res <= 0)
+    {
+        return header_res;
+    }
+    if (header.getRecordLength() > size)
+    {
+        return 0;
+    }
+    if (header.schema_id != schema_id)
+    {
+        return -ErrUnknownDataType;
+    }
+
+    BitStream bitstream(buffer + BinaryRecordHeader::Size, header.payload_length);
+    ScalarCodec codec(bitstream);
+    const int res = DataType::decode(out_obj, codec, TailArrayOptEnabled);
+    if (res <= 0)
+    {
+        return -ErrInvalidMarshalData;
+    }
+    return int(header.getRecordLength());
+}
+
+/**
+ * Same as above, with the signature of the data type as the schema ID. Messages only.
+ */
+template <typename DataType>
+int decodeBinaryRecord(const uint8_t* buffer, unsigned size, DataType& out_obj)
+{
+    return decodeBinaryRecord(buffer, size, DataType::getDataTypeSignature().get(), out_obj);
+}
+
+}
+
+#endif // UAVCAN_HELPERS_BINARY_RECORD_HPP_INCLUDED
@@ -9,17 +9,36 @@
 #include <uavcan/build_config.hpp>
 #include <uavcan/debug.hpp>
 #include <uavcan/dynamic_memory.hpp>
+#include <uavcan/node/timer.hpp>
 
 namespace uavcan
 {
+/**
+ * Default source of the memory of @ref HeapBasedPoolAllocator: the heap.
+ * A custom source can be provided via the third template argument of the allocator, e.g. one that maps huge pages;
+ * it must be a type with static methods of the same signatures. The returned memory must be aligned for any type.
+ */
+struct UAVCAN_EXPORT HeapChunkSource
+{
+    static void* allocate(std::size_t size) { return std::malloc(size); }
+    static void deallocate(void* ptr, std::size_t) { std::free(ptr); }
+};
+
 /**
  * A special-purpose implementation of a pool allocator that keeps the pool in the heap using malloc()/free().
  * The pool grows dynamically, ad-hoc, thus using as little memory as possible.
  *
- * Allocated blocks will not be freed back automatically, but there are two ways to force their deallocation:
+ * Allocated blocks will not be freed back automatically, but there are three ways to force their deallocation:
  *  - Call @ref shrink() - this method frees all blocks that are unused at the moment.
+ *  - Call @ref trim() periodically, e.g. from @ref HeapBasedPoolAllocatorTrimmer - frees the blocks that haven't
+ *    been needed since the previous call.
  *  - Destroy the object - the desctructor calls @ref shrink().
  *
+ * By default the pool grows by one block at a time. Alternatively, it can grow by chunks of many blocks, which
+ * are acquired from the heap with one call; see @ref setChunkSize(). This keeps the blocks close to each other in
+ * memory, and makes a load spike hit the heap once per chunk rather than once per block. Blocks can be returned
+ * to the heap only by whole chunks, i.e. a chunk is freed once none of its blocks is in use.
+ *
  * The pool can be limited in growth with hard and soft limits.
  * The soft limit defines the value that will be reported via @ref IPoolAllocator::getBlockCapacity().
  * The hard limit defines the maximum number of blocks that can be allocated from heap.
@@ -34,9 +53,13 @@ namespace uavcan
  *         RaiiSynchronizer()  { __disable_irq(); }
  *         ~RaiiSynchronizer() { __enable_irq(); }
  *     };
+ * The only exception is returning the chunks to the heap, which holds the lock while the reserve is scanned.
+ *
+ * The third template argument defines where the memory comes from, see @ref HeapChunkSource.
  */
 template <std::size_t BlockSize,
-          typename RaiiSynchronizer = char>
+          typename RaiiSynchronizer = char,
+          typename ChunkSource = HeapChunkSource>
 class UAVCAN_EXPORT HeapBasedPoolAllocator : public IPoolAllocator,
                                              Noncopyable
 {
@@ -49,13 +72,102 @@ class UAVCAN_EXPORT HeapBasedPoolAllocator : public IPoolAllocator,
         long long _aligner2;
     };
 
+    /**
+     * Placed in the first node(s) of every chunk; the blocks of the chunk follow.
+     */
+    struct Chunk
+    {
+        Chunk* next;
+        uint16_t num_blocks;
+    };
+
+    enum { NumChunkHeaderNodes = (sizeof(Chunk) + sizeof(Node) - 1U) / sizeof(Node) };
+
     const uint16_t capacity_soft_limit_;
     const uint16_t capacity_hard_limit_;
 
     uint16_t num_reserved_blocks_;
     uint16_t num_allocated_blocks_;
+    uint16_t chunk_size_;
+    uint16_t min_free_blocks_;          ///< Low watermark of the free blocks since the last trim
 
     Node* reserve_;
+    Chunk* chunks_;
+
+    static std::size_t getChunkMemorySize(uint16_t num_blocks)
+    {
+        return sizeof(Node) * (NumChunkHeaderNodes + std::size_t(num_blocks));
+    }
+
+    static Node* getChunkBlocks(Chunk* chunk)
+    {
+        return static_cast<Node*>(static_cast<void*>(chunk)) + NumChunkHeaderNodes;
+    }
+
+    void updateLowWatermark()
+    {
+        const uint16_t num_free = uint16_t(num_reserved_blocks_ - num_allocated_blocks_);
+        if (num_free < min_free_blocks_)
+        {
+            min_free_blocks_ = num_free;
+        }
+    }
+
+    /**
+     * Acquires a new chunk from the source; returns one block of it, the rest goes to the reserve.
+     */
+    void* allocateChunk(uint16_t max_blocks)
+    {
+        if (chunk_size_ <= 1)
+        {
+            void* const m = ChunkSource::allocate(sizeof(Node));
+            if (m != UAVCAN_NULLPTR)
+            {
+                RaiiSynchronizer lock;
+                (void)lock;
+
+                num_reserved_blocks_++;
+                num_allocated_blocks_++;
+                updateLowWatermark();
+            }
+            return m;
+        }
+
+        const uint16_t num_blocks = min(chunk_size_, max_blocks);
+        void* const m = ChunkSource::allocate(getChunkMemorySize(num_blocks));
+        if (m == UAVCAN_NULLPTR)
+        {
+            return UAVCAN_NULLPTR;
+        }
+
+        Chunk* const chunk = new (m) Chunk();
+        chunk->num_blocks = num_blocks;
+        Node* const blocks = getChunkBlocks(chunk);
+        for (uint16_t i = 1; i < (num_blocks - 1U); i++)
+        {
+            blocks[i].next = &blocks[i + 1U];
+        }
+
+        RaiiSynchronizer lock;
+        (void)lock;
+
+        chunk->next = chunks_;
+        chunks_ = chunk;
+        if (num_blocks > 1)
+        {
+            blocks[num_blocks - 1U].next = reserve_;
+            reserve_ = &blocks[1];
+        }
+        num_reserved_blocks_ = uint16_t(num_reserved_blocks_ + num_blocks);
+        num_allocated_blocks_++;
+        updateLowWatermark();
+        return &blocks[0];
+    }
+
+    /**
+     * Returns up to the specified number of unused blocks to the source; returns the number of blocks released.
+     */
+    uint16_t release(uint16_t max_blocks);
 
 public:
     /**
@@ -75,12 +187,15 @@ public:
                                                        static_cast<uint32_t>(NumericTraits<uint16_t>::max())))),
         num_reserved_blocks_(0),
         num_allocated_blocks_(0),
-        reserve_(UAVCAN_NULLPTR)
+        chunk_size_(1),
+        min_free_blocks_(0),
+        reserve_(UAVCAN_NULLPTR),
+        chunks_(UAVCAN_NULLPTR)
     { }
 
     /**
      * The destructor de-allocates all blocks that are currently in the reserve.
-     * BLOCKS THAT ARE CURRENTLY HELD BY THE APPLICATION WILL LEAK.
+     * BLOCKS THAT ARE CURRENTLY HELD BY THE APPLICATION WILL LEAK, along with the chunks they belong to.
      */
     ~HeapBasedPoolAllocator()
     {
@@ -95,7 +210,7 @@ public:
 
     /**
      * Takes a block from the reserve, unless it's empty.
-     * In the latter case, allocates a new block in the heap.
+     * In the latter case, allocates a new block or chunk in the heap.
      */
     virtual void* allocate(std::size_t size) override
     {
@@ -104,6 +219,7 @@ public:
             return UAVCAN_NULLPTR;
         }
 
+        uint16_t max_new_blocks = 0;
         {
             RaiiSynchronizer lock;
             (void)lock;
@@ -114,6 +230,7 @@ public:
             {
                 reserve_ = reserve_->next;
                 num_allocated_blocks_++;
+                updateLowWatermark();
                 return p;
             }
 
@@ -121,24 +238,16 @@ public:
             {
                 return UAVCAN_NULLPTR;
             }
+            max_new_blocks = uint16_t(capacity_hard_limit_ - num_reserved_blocks_);
         }
 
         // Unlikely branch
-        void* const m = std::malloc(sizeof(Node));
-        if (m != UAVCAN_NULLPTR)
-        {
-            RaiiSynchronizer lock;
-            (void)lock;
-
-            num_reserved_blocks_++;
-            num_allocated_blocks_++;
-        }
-        return m;
+        return allocateChunk(max_new_blocks);
     }
 
     /**
      * Puts the block back to reserve.
-     * The block will not be free()d automatically; see @ref shrink().
+     * The block will not be free()d automatically; see @ref shrink() and @ref trim().
      */
     virtual void deallocate(const void* ptr) override
     {
@@ -165,33 +274,62 @@ public:
      */
     uint16_t getBlockCapacityHardLimit() const { return capacity_hard_limit_; }
 
+    /**
+     * Number of blocks the pool grows by when the reserve is empty; one by default. The last chunk is made
+     * smaller if the hard limit would be exceeded otherwise. Should be set before the first allocation,
+     * because the blocks acquired one by one can't be returned to the heap once the chunk size is changed.
+     */
+    void setChunkSize(uint16_t num_blocks)
+    {
+        RaiiSynchronizer lock;
+        (void)lock;
+        UAVCAN_ASSERT((num_reserved_blocks_ == 0) || ((chunk_size_ > 1) == (num_blocks > 1)));
+        chunk_size_ = max<uint16_t>(num_blocks, 1);
+    }
+
+    uint16_t getChunkSize() const { return chunk_size_; }
+
+    /**
+     * Grows the pool until it has at least the specified number of unused blocks, so that the following
+     * allocations are served from the reserve. Returns false if the heap or the hard limit has run out.
+     */
+    bool preallocate(uint16_t num_blocks);
+
     /**
      * Frees all blocks that are not in use at the moment.
-     * Post-condition is getNumAllocatedBlocks() == getNumReservedBlocks().
+     * Post-condition is getNumAllocatedBlocks() == getNumReservedBlocks(), unless the pool grows by chunks;
+     * in the latter case only the chunks that are not in use are freed.
      */
     void shrink()
     {
-        Node* p = UAVCAN_NULLPTR;
-        for (;;)
+        (void)release(NumericTraits<uint16_t>::max());
+
+        RaiiSynchronizer lock;
+        (void)lock;
+        min_free_blocks_ = uint16_t(num_reserved_blocks_ - num_allocated_blocks_);
+    }
+
+    /**
+     * Frees the unused blocks that were not needed since the previous call, i.e. the number of the blocks freed
+     * is limited by the lowest number of unused blocks observed in between. Invoked periodically, this makes the
+     * reserve follow the peak load over the period: it doesn't shrink while the load is recurring, and is
+     * returned to the heap once the load is gone. Returns the number of blocks freed.
+     */
+    uint16_t trim()
+    {
+        uint16_t budget = 0;
         {
-            {
-                RaiiSynchronizer lock;
-                (void)lock;
-                // Removing from reserve and updating the counter.
-                p = reserve_;
-                if (p != UAVCAN_NULLPTR)
-                {
-                    reserve_ = reserve_->next;
-                    num_reserved_blocks_--;
-                }
-                else
-                {
-                    break;
-                }
-            }
-            // Then freeing, having left the critical section.
-            std::free(p);
+            RaiiSynchronizer lock;
+            (void)lock;
+            budget = min_free_blocks_;
         }
+
+        const uint16_t num_released = (budget > 0) ? release(budget) : uint16_t(0);
+
+        RaiiSynchronizer lock;
+        (void)lock;
+        min_free_blocks_ = uint16_t(num_reserved_blocks_ - num_allocated_blocks_);
+        return num_released;
     }
 
     /**
@@ -204,6 +342,11 @@ public:
         return num_allocated_blocks_;
     }
 
+    /**
+     * Same as @ref getNumAllocatedBlocks(), compared against the soft limit.
+     */
+    virtual uint16_t getNumUsedBlocks() const override { return getNumAllocatedBlocks(); }
+
     /**
      * Number of blocks that are acquired from the heap.
      */
@@ -215,6 +358,157 @@ public:
     }
 };
 
+/**
+ * Calls @ref HeapBasedPoolAllocator::trim() of the given allocator periodically from the node's scheduler.
+ * The period should be long compared to the recurrence of the load peaks, e.g. tens of seconds.
+ */
+template <typename Allocator>
+class UAVCAN_EXPORT HeapBasedPoolAllocatorTrimmer : private TimerBase
+{
+    Allocator& allocator_;
+
+    virtual void handleTimerEvent(const TimerEvent&) override
+    {
+        const uint16_t num_released = allocator_.trim();
+        if (num_released > 0)
+        {
+            UAVCAN_TRACE("HeapBasedPoolAllocator", "Trimmed %u blocks", unsigned(num_released));
+        }
+    }
+
+public:
+    HeapBasedPoolAllocatorTrimmer(INode& node, Allocator& allocator)
+        : TimerBase(node)
+        , allocator_(allocator)
+    { }
+
+    void start(MonotonicDuration period) { startPeriodic(period); }
+    void stop() { TimerBase::stop(); }
+    bool isRunning() const { return TimerBase::isRunning(); }
+};
+
+// ----------------------------------------------------------------------------
+
+template <std::size_t BlockSize, typename RaiiSynchronizer, typename ChunkSource>
+bool HeapBasedPoolAllocator<BlockSize, RaiiSynchronizer, ChunkSource>::preallocate(uint16_t num_blocks)
+{
+    for (;;)
+    {
+        uint16_t max_new_blocks = 0;
+        {
+            RaiiSynchronizer lock;
+            (void)lock;
+            if ((num_reserved_blocks_ - num_allocated_blocks_) >= num_blocks)
+            {
+                return true;
+            }
+            if (num_reserved_blocks_ >= capacity_hard_limit_)
+            {
+                return false;
+            }
+            max_new_blocks = uint16_t(capacity_hard_limit_ - num_reserved_blocks_);
+        }
+
+        // The new block is put into the reserve right away
+        void* const block = allocateChunk(max_new_blocks);
+        if (block == UAVCAN_NULLPTR)
+        {
+            return false;
+        }
+        deallocate(block);
+    }
+}
+
+template <std::size_t BlockSize, typename RaiiSynchronizer, typename ChunkSource>
+uint16_t HeapBasedPoolAllocator<BlockSize, RaiiSynchronizer, ChunkSource>::release(uint16_t max_blocks)
+{
+    uint16_t num_released = 0;
+
+    if (chunk_size_ <= 1 && chunks_ == UAVCAN_NULLPTR)
+    {
+        while (num_released < max_blocks)
+        {
+            Node* p = UAVCAN_NULLPTR;
+            {
+                RaiiSynchronizer lock;
+                (void)lock;
+                // Removing from reserve and updating the counter.
+                p = reserve_;
+                if (p == UAVCAN_NULLPTR)
+                {
+                    break;
+                }
+                reserve_ = reserve_->next;
+                num_reserved_blocks_--;
+            }
+            // Then freeing, having left the critical section.
+            ChunkSource::deallocate(p, sizeof(Node));
+            num_released++;
+        }
+        return num_released;
+    }
+
+    Chunk* released_chunks = UAVCAN_NULLPTR;
+    {
+        RaiiSynchronizer lock;
+        (void)lock;
+
+        Chunk** link = &chunks_;
+        while (*link != UAVCAN_NULLPTR)
+        {
+            Chunk* const chunk = *link;
+            const Node* const begin = getChunkBlocks(chunk);
+            const Node* const end = begin + chunk->num_blocks;
+
+            unsigned num_unused = 0;
+            if ((num_released + chunk->num_blocks) <= max_blocks)
+            {
+                for (const Node* p = reserve_; p != UAVCAN_NULLPTR; p = p->next)
+                {
+                    num_unused += ((p >= begin) && (p < end)) ? 1U : 0U;
+                }
+            }
+
+            if (num_unused < chunk->num_blocks)
+            {
+                link = &chunk->next;
+                continue;
+            }
+
+            // All blocks of the chunk are in the reserve - unlinking them, then the chunk itself
+            Node** node_link = &reserve_;
+            while (*node_link != UAVCAN_NULLPTR)
+            {
+                if ((*node_link >= begin) && (*node_link < end))
+                {
+                    *node_link = (*node_link)->next;
+                }
+                else
+                {
+                    node_link = &(*node_link)->next;
+                }
+            }
+            *link = chunk->next;
+            chunk->next = released_chunks;
+            released_chunks = chunk;
+
+            num_reserved_blocks_ = uint16_t(num_reserved_blocks_ - chunk->num_blocks);
+            num_released = uint16_t(num_released + chunk->num_blocks);
+        }
+    }
+
+    // Freeing, having left the critical section.
+    while (released_chunks != UAVCAN_NULLPTR)
+    {
+        Chunk* const chunk = released_chunks;
+        released_chunks = chunk->next;
+        const std::size_t size = getChunkMemorySize(chunk->num_blocks);
+        chunk->~Chunk();
+        ChunkSource::deallocate(chunk, size);
+    }
+    return num_released;
+}
+
 }
 
 #endif
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_HELPERS_JSON_WRITER_HPP_INCLUDED
+#define UAVCAN_HELPERS_JSON_WRITER_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/util/templates.hpp>
+#include <uavcan/marshal/type_util.hpp>
+
+namespace uavcan
+{
+/**
+ * Writes compact JSON into a buffer provided by the caller. This is the stream type for @ref JsonStreamer, which is
+ * generated by the DSDL compiler for every data type. Unlike the YAML streaming, it doesn't involve iostreams and
+ * never allocates memory, so it's fast enough to convert every transfer of a busy bus, e.g. on a logging node.
+ *
+ * Usage:
+ *      char buf[512];
+ *      const int len = uavcan::encodeJson(msg, buf, sizeof(buf));  // {"seq":1,"payload":"Hello"}
+ *
+ * The output is always null-terminated. If the buffer runs out, the output is truncated, which is indicated by
+ * @ref isOverflowed(). Non-finite floating point values are written as null, since JSON can't represent them.
+ */
+class UAVCAN_EXPORT JsonWriter : Noncopyable
+{
+    char* const buf_;
+    const unsigned capacity_;       ///< Not including the null terminator
+    unsigned len_;
+    bool overflow_;
+
+    void writeDigits(uint64_t x)
+    {
+        char digits[20];
+        unsigned num_digits = 0;
+        do
+        {
+            digits[num_digits++] = char('0' + char(x % 10U));
+            x /= 10U;
+        }
+        while (x > 0);
+
+        while (num_digits > 0)
+        {
+            write(digits[--num_digits]);
+        }
+    }
+
+public:
+    JsonWriter(char* buffer, unsigned size)
+        : buf_(buffer)
+        , capacity_((size > 0) ? (size - 1U) : 0U)
+        , len_(0)
+        , overflow_(size == 0)
+    {
+        if (size > 0)
+        {
+            buf_[0] = '\0';
+        }
+    }
+
+    void write(char c)
+    {
+        if (len_ < capacity_)
+        {
+            buf_[len_++] = c;
+            buf_[len_] = '\0';
+        }
+        else
+        {
+            overflow_ = true;
+        }
+    }
+
+    void write(const char* str)
+    {
+        while (*str != '\0')
+        {
+            write(*str++);
+        }
+    }
+
+    void writeSigned(int64_t x)
+    {
+        if (x < 0)
+        {
+            write('-');
+            writeDigits(uint64_t(0) - uint64_t(x));
+        }
+        else
+        {
+            writeDigits(uint64_t(x));
+        }
+    }
+
+    void writeUnsigned(uint64_t x) { writeDigits(x); }
+
+    void writeReal(double x, int num_significant_digits)
+    {
+        if (!isFinite(x))
+        {
+            write("null");
+            return;
+        }
+        char tmp[32];
+        (void)snprintf(tmp, sizeof(tmp), "%.*g", num_significant_digits, x);
+        write(tmp);
+    }
+
+    /**
+     * Writes one character of a string, escaped as required by JSON.
+     */
+    void writeEscaped(char c)
+    {
+        switch (c)
+        {
+        case '"':  write("\\\""); break;
+        case '\\': write("\\\\"); break;
+        case '\n': write("\\n");  break;
+        case '\r': write("\\r");  break;
+        case '\t': write("\\t");  break;
+        default:
+        {
+            if (static_cast<unsigned char>(c) < 0x20U)
+            {
+                static const char Hex[] = "0123456789abcdef";
+                write("\\u00");
+                write(Hex[(c >> 4) & 0xF]);
+                write(Hex[c & 0xF]);
+            }
+            else
+            {
+                write(c);
+            }
+            break;
+        }
+        }
+    }
+
+    void reset()
+    {
+        len_ = 0;
+        overflow_ = capacity_ == 0;
+        if (capacity_ > 0)
+        {
+            buf_[0] = '\0';
+        }
+    }
+
+    const char* getText() const { return buf_; }
+    unsigned getLength() const { return len_; }
+    bool isOverflowed() const { return overflow_; }
+};
+
+/**
+ * Writes the object into the buffer as compact JSON, see @ref JsonWriter.
+ * Returns the length of the output not including the null terminator, zero if the buffer is too short,
+ * or negative error code.
+ */
+template <typename DataType>
+int encodeJson(const DataType& obj, char* buffer, unsigned size)
+{
+    if ((buffer == UAVCAN_NULLPTR) || (size == 0))
+    {
+        return -ErrInvalidParam;
+    }
+    JsonWriter writer(buffer, size);
+    JsonStreamer<DataType>::stream(writer, obj);
+    return writer.isOverflowed() ? 0 : int(writer.getLength());
+}
+
+}
+
+#endif // UAVCAN_HELPERS_JSON_WRITER_HPP_INCLUDED
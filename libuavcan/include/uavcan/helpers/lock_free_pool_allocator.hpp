@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_HELPERS_LOCK_FREE_POOL_ALLOCATOR_HPP_INCLUDED
+#define UAVCAN_HELPERS_LOCK_FREE_POOL_ALLOCATOR_HPP_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/dynamic_memory.hpp>
+
+#if !UAVCAN_GENERAL_PURPOSE_PLATFORM
+# error The lock-free pool allocator requires a general purpose platform
+#endif
+
+namespace uavcan
+{
+/**
+ * Pool allocator for nodes or sub-nodes that share one pool between several threads.
+ * Unlike @ref PoolAllocator with a RAII-lock, it never blocks.
+ *
+ * The free blocks are kept in a Treiber stack. Its head is a single 64-bit word holding the index of the top
+ * block and a modification counter, which is incremented by every update, so that the ABA problem can't occur.
+ * The links between the free blocks are stored outside of the blocks, so that reading a link concurrently with
+ * a thread that has just popped the block and is writing its data is not a data race.
+ *
+ * Additionally, there is a number of small magazines of free blocks. Every thread is mapped to one of them, and
+ * deallocated blocks are put there first, so that a thread that frees and allocates blocks in turns doesn't
+ * touch the shared stack at all. A magazine is guarded by a flag that is practically never contended as long as
+ * there are not more threads than magazines; if it is taken, the shared stack is used instead. When both the
+ * magazine of the thread and the shared stack are empty, the blocks are taken from the other magazines, so that
+ * cached blocks can't cause an out of memory condition.
+ *
+ * The number of used blocks and its peak are maintained with atomic counters.
+ *
+ * @tparam PoolSize         Size of the pool in bytes.
+ * @tparam BlockSize        Size of a block in bytes.
+ * @tparam MagazineSize     Maximum number of blocks cached per magazine; at least 2.
+ * @tparam NumMagazines     Number of magazines; should be no less than the number of threads using the pool.
+ */
+template <std::size_t PoolSize,
+          uint8_t BlockSize,
+          unsigned MagazineSize = 16,
+          unsigned NumMagazines = 8>
+class UAVCAN_EXPORT LockFreePoolAllocator : public IPoolAllocator,
+                                            Noncopyable
+{
+public:
+    static const uint16_t NumBlocks = PoolSize / BlockSize;
+
+private:
+    typedef uint32_t BlockIndex;
+    static const BlockIndex NoBlock = 0xFFFFFFFFU;
+
+    /**
+     * Index of the top block plus one (zero if the stack is empty) in the lower half, tag in the upper half.
+     */
+    alignas(UAVCAN_CACHE_LINE_SIZE) std::atomic<uint64_t> head_;
+
+    std::atomic<uint32_t> used_;
+    std::atomic<uint32_t> max_used_;
+
+    struct alignas(UAVCAN_CACHE_LINE_SIZE) Magazine
+    {
+        std::atomic_flag busy;
+        uint16_t num_blocks;
+        BlockIndex blocks[MagazineSize];
+    };
+
+    Magazine magazines_[NumMagazines];
+
+    std::atomic<BlockIndex> next_[NumBlocks];  ///< Links of the stack, index plus one; zero terminates
+
+    union
+    {
+        uint8_t bytes[PoolSize];
+        long double _aligner1;
+        long long _aligner2;
+    } pool_;
+
+    static unsigned getThreadMagazineIndex()
+    {
+        static std::atomic<unsigned> thread_counter(0);
+        static thread_local const unsigned thread_index = thread_counter.fetch_add(1U, std::memory_order_relaxed);
+        return thread_index % NumMagazines;
+    }
+
+    void* getBlockPtr(BlockIndex index) { return pool_.bytes + std::size_t(index) * BlockSize; }
+
+    /**
+     * Pushes a chain of blocks that are already linked from first to last.
+     */
+    void pushChain(BlockIndex first, BlockIndex last)
+    {
+        uint64_t old_head = head_.load(std::memory_order_relaxed);
+        uint64_t new_head = 0;
+        do
+        {
+            next_[last].store(BlockIndex(old_head & 0xFFFFFFFFU), std::memory_order_relaxed);
+            new_head = (((old_head >> 32) + 1U) << 32) | uint64_t(first + 1U);
+        }
+        while (!head_.compare_exchange_weak(old_head, new_head, std::memory_order_release,
+                                            std::memory_order_relaxed));
+    }
+
+    BlockIndex pop()
+    {
+        uint64_t old_head = head_.load(std::memory_order_acquire);
+        while (true)
+        {
+            const BlockIndex top = BlockIndex(old_head & 0xFFFFFFFFU);
+            if (top == 0)
+            {
+                return NoBlock;
+            }
+            // The block may be popped and reused by another thread meanwhile; then the tag won't match
+            const uint64_t next = next_[top - 1U].load(std::memory_order_relaxed);
+            const uint64_t new_head = (((old_head >> 32) + 1U) << 32) | next;
+            if (head_.compare_exchange_weak(old_head, new_head, std::memory_order_acquire,
+                                            std::memory_order_acquire))
+            {
+                return top - 1U;
+            }
+        }
+    }
+
+    static BlockIndex takeFromMagazine(Magazine& mag)
+    {
+        BlockIndex index = NoBlock;
+        if (!mag.busy.test_and_set(std::memory_order_acquire))
+        {
+            if (mag.num_blocks > 0)
+            {
+                index = mag.blocks[--mag.num_blocks];
+            }
+            mag.busy.clear(std::memory_order_release);
+        }
+        return index;
+    }
+
+    BlockIndex stealFromMagazines()
+    {
+        for (unsigned i = 0; i < NumMagazines; i++)
+        {
+            const BlockIndex index = takeFromMagazine(magazines_[i]);
+            if (index != NoBlock)
+            {
+                return index;
+            }
+        }
+        return NoBlock;
+    }
+
+public:
+    LockFreePoolAllocator()
+        : head_(NumBlocks > 0 ? 1U : 0U)
+        , used_(0)
+        , max_used_(0)
+    {
+        StaticAssert<(MagazineSize >= 2)>::check();
+        StaticAssert<(NumMagazines >= 1)>::check();
+        StaticAssert<(NumBlocks > 0)>::check();
+        StaticAssert<(BlockSize >= sizeof(void*))>::check();
+        UAVCAN_ASSERT(head_.is_lock_free());
+
+        for (unsigned i = 0; i < NumMagazines; i++)
+        {
+            magazines_[i].busy.clear();
+            magazines_[i].num_blocks = 0;
+        }
+        for (unsigned i = 0; i < NumBlocks; i++)
+        {
+            next_[i].store(((i + 1U) < NumBlocks) ? BlockIndex(i + 2U) : BlockIndex(0), std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    virtual void* allocate(std::size_t size) override
+    {
+        if (size > BlockSize)
+        {
+            return UAVCAN_NULLPTR;
+        }
+
+        BlockIndex index = takeFromMagazine(magazines_[getThreadMagazineIndex()]);
+        if (index == NoBlock)
+        {
+            index = pop();
+        }
+        if (index == NoBlock)
+        {
+            index = stealFromMagazines();
+        }
+        if (index == NoBlock)
+        {
+            return UAVCAN_NULLPTR;
+        }
+
+        // Statistics
+        const uint32_t used = used_.fetch_add(1U, std::memory_order_relaxed) + 1U;
+        UAVCAN_ASSERT(used <= NumBlocks);
+        uint32_t max_used = max_used_.load(std::memory_order_relaxed);
+        while ((used > max_used) &&
+               !max_used_.compare_exchange_weak(max_used, used, std::memory_order_relaxed))
+        { }
+
+        return getBlockPtr(index);
+    }
+
+    virtual void deallocate(const void* ptr) override
+    {
+        if (ptr == UAVCAN_NULLPTR)
+        {
+            return;
+        }
+
+        const std::size_t offset = std::size_t(static_cast<const uint8_t*>(ptr) - pool_.bytes);
+        UAVCAN_ASSERT((offset % BlockSize) == 0);
+        const BlockIndex index = BlockIndex(offset / BlockSize);
+        UAVCAN_ASSERT(index < NumBlocks);
+
+        // Statistics
+        UAVCAN_ASSERT(used_.load(std::memory_order_relaxed) > 0);
+        used_.fetch_sub(1U, std::memory_order_relaxed);
+
+        Magazine& mag = magazines_[getThreadMagazineIndex()];
+        if (!mag.busy.test_and_set(std::memory_order_acquire))
+        {
+            if (mag.num_blocks >= MagazineSize)
+            {
+                // Returning the older half of the magazine to the stack in one go
+                const unsigned num_returned = MagazineSize / 2U;
+                for (unsigned i = 0; (i + 1U) < num_returned; i++)
+                {
+                    next_[mag.blocks[i]].store(mag.blocks[i + 1U] + 1U, std::memory_order_relaxed);
+                }
+                pushChain(mag.blocks[0], mag.blocks[num_returned - 1U]);
+                for (unsigned i = num_returned; i < mag.num_blocks; i++)
+                {
+                    mag.blocks[i - num_returned] = mag.blocks[i];
+                }
+                mag.num_blocks = uint16_t(mag.num_blocks - num_returned);
+            }
+            mag.blocks[mag.num_blocks++] = index;
+            mag.busy.clear(std::memory_order_release);
+        }
+        else
+        {
+            pushChain(index, index);
+        }
+    }
+
+    virtual uint16_t getBlockCapacity() const override { return NumBlocks; }
+
+    /**
+     * Return the number of blocks that are currently allocated/unallocated.
+     * Blocks cached in the magazines are not allocated.
+     */
+    virtual uint16_t getNumUsedBlocks() const override { return uint16_t(used_.load(std::memory_order_relaxed)); }
+    uint16_t getNumFreeBlocks() const { return uint16_t(NumBlocks - getNumUsedBlocks()); }
+
+    /**
+     * Returns the maximum number of blocks that were ever allocated at the same time.
+     */
+    uint16_t getPeakNumUsedBlocks() const { return uint16_t(max_used_.load(std::memory_order_relaxed)); }
+};
+
+template <std::size_t PoolSize, uint8_t BlockSize, unsigned MagazineSize, unsigned NumMagazines>
+const uint16_t LockFreePoolAllocator<PoolSize, BlockSize, MagazineSize, NumMagazines>::NumBlocks;
+
+template <std::size_t PoolSize, uint8_t BlockSize, unsigned MagazineSize, unsigned NumMagazines>
+const uint32_t LockFreePoolAllocator<PoolSize, BlockSize, MagazineSize, NumMagazines>::NoBlock;
+
+}
+
+#endif // UAVCAN_HELPERS_LOCK_FREE_POOL_ALLOCATOR_HPP_INCLUDED
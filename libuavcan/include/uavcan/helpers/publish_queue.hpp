@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_HELPERS_PUBLISH_QUEUE_HPP_INCLUDED
+#define UAVCAN_HELPERS_PUBLISH_QUEUE_HPP_INCLUDED
+
+#include <atomic>
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/node/generic_publisher.hpp>
+#include <uavcan/node/timer.hpp>
+#include <uavcan/util/method_binder.hpp>
+
+#if !UAVCAN_GENERAL_PURPOSE_PLATFORM
+# error The publish queue requires a general purpose platform
+#endif
+
+namespace uavcan
+{
+/**
+ * Lets any thread broadcast messages without locking the node. The message is encoded by the calling thread
+ * straight into a pre-allocated slot of a lock-free multi-producer/single-consumer queue; the node thread takes
+ * the encoded messages from the queue and sends them, either explicitly via @ref drain() or periodically from
+ * the scheduler, see @ref startAutoDrain(). This way, the encoding doesn't need to be serialized against the
+ * spinning of the node.
+ *
+ * The queue is a bounded array of slots, each of them carrying a sequence number that tells whether the slot
+ * is free or holds a message of the current lap. A producer claims the next slot by advancing the shared
+ * enqueue position with a compare-and-swap, encodes into it, and publishes it by updating its sequence number.
+ * When all slots are taken, @ref push() fails immediately instead of waiting.
+ *
+ * Only @ref push() and the counters of rejected messages may be used from other threads. Everything else,
+ * including @ref init(), which must be called before the first push, is to be called from the node thread.
+ * The transmission settings of the node (CAN FD, tail array optimization) should not change while the producers
+ * are running, since they define the encoding.
+ *
+ * @tparam DataType_        Message data type.
+ * @tparam Capacity_        Number of slots, must be a power of two.
+ */
+template <typename DataType_, unsigned Capacity_ = 16>
+class UAVCAN_EXPORT PublishQueue : protected GenericPublisher<DataType_, DataType_>
+{
+    typedef GenericPublisher<DataType_, DataType_> BaseType;
+    typedef PublishQueue<DataType_, Capacity_> SelfType;
+    typedef typename BaseType::EncodedBuffer EncodedBuffer;
+    typedef MethodBinder<SelfType*, void (SelfType::*)(const TimerEvent&)> TimerCallback;
+
+public:
+    typedef DataType_ DataType;
+
+    enum { Capacity = Capacity_ };
+
+private:
+    enum { IndexMask = Capacity_ - 1 };
+
+    struct Slot
+    {
+        std::atomic<uint32_t> sequence;     ///< Position + 1 when holding a message, position + Capacity when free
+        bool valid;                         ///< False if the encoding has failed
+        EncodedBuffer buffer;
+    };
+
+    Slot slots_[Capacity_];
+    alignas(UAVCAN_CACHE_LINE_SIZE) std::atomic<uint32_t> enqueue_pos_;
+    alignas(UAVCAN_CACHE_LINE_SIZE) uint32_t dequeue_pos_;
+    std::atomic<uint32_t> num_rejected_;
+    uint32_t num_send_failures_;
+    TimerEventForwarder<TimerCallback> timer_;
+
+    void handleTimerEvent(const TimerEvent&) { (void)drain(); }
+
+public:
+    explicit PublishQueue(INode& node, bool force_std_can = false,
+                          MonotonicDuration tx_timeout = getDefaultTxTimeout())
+        : BaseType(node, force_std_can, tx_timeout)
+        , enqueue_pos_(0)
+        , dequeue_pos_(0)
+        , num_rejected_(0)
+        , num_send_failures_(0)
+        , timer_(node, TimerCallback(this, &SelfType::handleTimerEvent))
+    {
+        StaticAssert<DataTypeKind(DataType::DataTypeKind) == DataTypeKindMessage>::check();
+        StaticAssert<(Capacity_ >= 2) && ((Capacity_ & (Capacity_ - 1)) == 0)>::check();
+        for (unsigned i = 0; i < Capacity_; i++)
+        {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+            slots_[i].valid = false;
+        }
+    }
+
+    static MonotonicDuration getDefaultTxTimeout() { return MonotonicDuration::fromMSec(100); }
+
+    /**
+     * Must be called from the node thread before the first @ref push().
+     * Returns negative error code.
+     */
+    using BaseType::init;
+
+    /**
+     * Encodes the message and puts it into the queue. Can be called from any thread.
+     * Returns negative error code; @ref ErrMemory means that the queue is full.
+     */
+    int push(const DataType& message);
+
+    /**
+     * Sends the queued messages, oldest first. Must be called from the node thread.
+     *
+     * @param max_messages      Maximum number of messages to send; zero means the whole queue.
+     *
+     * Returns the number of messages taken from the queue, including those that could not be sent,
+     * see @ref getNumSendFailures().
+     */
+    unsigned drain(unsigned max_messages = 0);
+
+    /**
+     * Drains the queue from a timer of the node with the given period, so that the application doesn't need to
+     * call @ref drain() itself. The actual period is limited by the deadline resolution of the scheduler.
+     */
+    void startAutoDrain(MonotonicDuration period) { timer_.startPeriodic(period); }
+    void stopAutoDrain() { timer_.stop(); }
+    bool isAutoDrainRunning() const { return timer_.isRunning(); }
+
+    /**
+     * Number of messages that have been rejected by @ref push() because the queue was full.
+     * Can be called from any thread.
+     */
+    uint32_t getNumRejectedMessages() const { return num_rejected_.load(std::memory_order_relaxed); }
+
+    /**
+     * Number of queued messages that could not be sent, e.g. because the TX queues were full.
+     */
+    uint32_t getNumSendFailures() const { return num_send_failures_; }
+
+    using BaseType::allowAnonymousTransfers;
+    using BaseType::getTransferSender;
+    using BaseType::getTxTimeout;
+    using BaseType::setTxTimeout;
+    using BaseType::getPriority;
+    using BaseType::setPriority;
+    using BaseType::isCoalescing;
+    using BaseType::setCoalescing;
+    using BaseType::getMinPublicationInterval;
+    using BaseType::setMinPublicationInterval;
+    using BaseType::getNode;
+};
+
+// ----------------------------------------------------------------------------
+
+template <typename DataType_, unsigned Capacity_>
+int PublishQueue<DataType_, Capacity_>::push(const DataType& message)
+{
+    if (!BaseType::isInited())
+    {
+        UAVCAN_ASSERT(0);           // init() must be called from the node thread beforehand
+        return -ErrNotInited;
+    }
+
+    uint32_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Slot* slot = UAVCAN_NULLPTR;
+    for (;;)
+    {
+        slot = &slots_[pos & IndexMask];
+        const uint32_t seq = slot->sequence.load(std::memory_order_acquire);
+        const int32_t diff = static_cast<int32_t>(seq - pos);
+        if (diff == 0)
+        {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1U, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            (void)num_rejected_.fetch_add(1, std::memory_order_relaxed);
+            return -ErrMemory;      // The slot is still occupied by the previous lap
+        }
+        else
+        {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    const int res = BaseType::encode(message, slot->buffer);
+    slot->valid = res >= 0;
+    slot->sequence.store(pos + 1U, std::memory_order_release);
+    return (res < 0) ? res : 0;
+}
+
+template <typename DataType_, unsigned Capacity_>
+unsigned PublishQueue<DataType_, Capacity_>::drain(unsigned max_messages)
+{
+    unsigned num_taken = 0;
+    while ((max_messages == 0) || (num_taken < max_messages))
+    {
+        Slot& slot = slots_[dequeue_pos_ & IndexMask];
+        if (slot.sequence.load(std::memory_order_acquire) != (dequeue_pos_ + 1U))
+        {
+            break;                  // Empty, or the producer is still encoding
+        }
+
+        if (slot.valid && !BaseType::isRateLimited())
+        {
+            const StaticTransferBufferImpl& buffer = slot.buffer;
+            const int res = GenericPublisherBase::genericPublish(buffer, TransferTypeMessageBroadcast,
+                                                                 NodeID::Broadcast, UAVCAN_NULLPTR, MonotonicTime());
+            if (res < 0)
+            {
+                UAVCAN_TRACE("PublishQueue", "Send failure %i [%s]", res, DataType::getDataTypeFullName());
+                num_send_failures_++;
+            }
+        }
+
+        slot.sequence.store(dequeue_pos_ + unsigned(Capacity_), std::memory_order_release);
+        dequeue_pos_++;
+        num_taken++;
+    }
+    return num_taken;
+}
+
+}
+
+#endif // UAVCAN_HELPERS_PUBLISH_QUEUE_HPP_INCLUDED
@@ -0,0 +1,708 @@
+/*
+ * Multi-threaded reception pipeline.
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_HELPERS_RX_PIPELINE_HPP_INCLUDED
+#define UAVCAN_HELPERS_RX_PIPELINE_HPP_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/driver/rx_ring.hpp>
+#include <uavcan/helpers/heap_based_pool_allocator.hpp>
+#include <uavcan/node/abstract_node.hpp>
+#include <uavcan/node/global_data_type_registry.hpp>
+
+#if !UAVCAN_GENERAL_PURPOSE_PLATFORM
+# error The RX pipeline requires a general purpose platform
+#endif
+
+namespace uavcan
+{
+/**
+ * Optional pipelined reception for multi-core general purpose platforms.
+ *
+ * Normally, the whole reception path runs inside the spin() method of the node: frame parsing, transfer
+ * reassembly, CRC checking, decoding and the user callbacks. The pipeline moves the first three stages out of the
+ * node thread, to one worker thread per CAN interface:
+ *
+ *  - The driver pushes the received frames via @ref push() from its own RX thread(s), instead of returning them
+ *    from @ref ICanIface::receive(). Loopback frames must still be returned via @ref ICanIface::receive().
+ *  - Each worker parses the frames of its interface and reassembles the transfers using its own memory pool.
+ *    Completed transfers are passed to the node thread via a lock-free queue.
+ *  - The node thread calls @ref dispatch() or @ref spin(), which drops the copies of the same transfer received
+ *    via redundant interfaces and delivers the transfers to the listeners, so that the decoding and all callbacks
+ *    are executed in the node thread as usual.
+ *
+ * Workers reassemble the transfers of all data types that are registered in @ref GlobalDataTypeRegistry (it gets
+ * frozen by @ref start()), because the listeners may change at any time. Transfers nobody listens to are dropped
+ * by the dispatcher later. Transfer timeouts are checked against the frame timestamps.
+ *
+ * @tparam RingCapacity     Capacity of the per-interface frame ring, see @ref CanRxRing.
+ * @tparam QueueCapacity    Capacity of the per-interface queue of completed transfers, must be a power of two.
+ */
+template <unsigned RingCapacity = 512, unsigned QueueCapacity = 256>
+class UAVCAN_EXPORT RxPipeline : Noncopyable
+{
+public:
+    enum { DefaultMaxTransferPayloadLen = 1024 };
+    enum { DefaultPoolBlocksPerIface = 1024 };
+
+private:
+    enum { FrameBatchSize = 16 };
+    enum { IdleWakeupIntervalMSec = 10 };
+    enum { CleanupIntervalMSec = 1000 };
+    enum { MaxRedundancyStates = 1024 };
+
+    /**
+     * Owned by the worker until it is pushed into the queue, then by the node thread.
+     */
+    struct CompletedTransfer
+    {
+        RxFrame last_frame;                 ///< Header fields only, no payload
+        bool tao_disabled;
+        std::vector<uint8_t> payload;
+
+        CompletedTransfer() : tao_disabled(false) { }
+    };
+
+    /**
+     * Node thread view of a completed transfer.
+     */
+    class PipelinedIncomingTransfer : public IncomingTransfer
+    {
+        const CompletedTransfer& ct_;
+
+    public:
+        explicit PipelinedIncomingTransfer(const CompletedTransfer& ct)
+            : IncomingTransfer(ct.last_frame.getMonotonicTimestamp(), ct.last_frame.getUtcTimestamp(),
+                               ct.last_frame.getPriority(), ct.last_frame.getTransferType(),
+                               ct.last_frame.getTransferID(), ct.last_frame.getSrcNodeID(),
+                               ct.last_frame.getIfaceIndex(), ct.last_frame.isCanFDFrame(), ct.tao_disabled)
+            , ct_(ct)
+        { }
+
+        virtual int read(unsigned offset, uint8_t* data, unsigned len) const override
+        {
+            if (data == UAVCAN_NULLPTR)
+            {
+                UAVCAN_ASSERT(0);
+                return -ErrInvalidParam;
+            }
+            const unsigned size = unsigned(ct_.payload.size());
+            if (offset >= size)
+            {
+                return 0;
+            }
+            len = min(len, size - offset);
+            (void)std::copy(ct_.payload.begin() + offset, ct_.payload.begin() + offset + len, data);
+            return int(len);
+        }
+
+        virtual const uint8_t* getContiguousPayload(unsigned& out_len) const override
+        {
+            out_len = unsigned(ct_.payload.size());
+            return ct_.payload.empty() ? UAVCAN_NULLPTR : &ct_.payload[0];
+        }
+
+        virtual bool isAnonymousTransfer() const override
+        {
+            return (getTransferType() == TransferTypeMessageBroadcast) && getSrcNodeID().isBroadcast();
+        }
+    };
+
+    /**
+     * Single-producer/single-consumer lock-free queue of completed transfers, worker to node thread.
+     */
+    class TransferQueue : Noncopyable
+    {
+        enum { IndexMask = QueueCapacity - 1 };
+
+        CompletedTransfer* items_[QueueCapacity];
+        alignas(UAVCAN_CACHE_LINE_SIZE) std::atomic<uint32_t> head_;
+        alignas(UAVCAN_CACHE_LINE_SIZE) std::atomic<uint32_t> tail_;
+
+    public:
+        TransferQueue()
+            : head_(0)
+            , tail_(0)
+        {
+            StaticAssert<(QueueCapacity >= 2) && ((QueueCapacity & (QueueCapacity - 1)) == 0)>::check();
+        }
+
+        ~TransferQueue()
+        {
+            while (CompletedTransfer* const ct = pop())
+            {
+                delete ct;
+            }
+        }
+
+        bool push(CompletedTransfer* ct)
+        {
+            const uint32_t head = head_.load(std::memory_order_relaxed);
+            if ((head - tail_.load(std::memory_order_acquire)) >= uint32_t(QueueCapacity))
+            {
+                return false;
+            }
+            items_[head & IndexMask] = ct;
+            head_.store(head + 1U, std::memory_order_release);
+            return true;
+        }
+
+        CompletedTransfer* pop()
+        {
+            const uint32_t tail = tail_.load(std::memory_order_relaxed);
+            if (head_.load(std::memory_order_acquire) == tail)
+            {
+                return UAVCAN_NULLPTR;
+            }
+            CompletedTransfer* const ct = items_[tail & IndexMask];
+            tail_.store(tail + 1U, std::memory_order_release);
+            return ct;
+        }
+    };
+
+    class Worker;
+
+    /**
+     * Reassembles the transfers of one data type within a worker.
+     */
+    class Assembler : public TransferListener
+    {
+        Worker& worker_;
+
+        virtual void handleIncomingTransfer(IncomingTransfer& transfer) override
+        {
+            worker_.handleTransfer(getDataTypeDescriptor(), transfer);
+        }
+
+    public:
+        Assembler(Worker& worker, TransferPerfCounter& perf, const DataTypeDescriptor& data_type,
+                  uint16_t max_buffer_size, IPoolAllocator& allocator)
+            : TransferListener(perf, data_type, max_buffer_size, allocator)
+            , worker_(worker)
+        {
+            allowAnonymousTransfers();
+        }
+    };
+
+    class Worker : Noncopyable
+    {
+        RxPipeline& owner_;
+        const uint8_t iface_index_;
+
+        CanRxRing<RingCapacity> ring_;
+        TransferQueue queue_;
+
+        // The assemblers must be destroyed first, as they refer to the allocator and to the perf counter
+        HeapBasedPoolAllocator<MemPoolBlockSize> allocator_;
+        TransferPerfCounter perf_;
+        std::map<uint32_t, std::unique_ptr<Assembler> > assemblers_;    ///< Null if the data type is unknown
+        MonotonicTime last_cleanup_ts_;
+
+        std::atomic<uint64_t> num_errors_;
+        std::atomic<uint64_t> num_dropped_transfers_;
+
+        std::atomic<bool> sleeping_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::thread thread_;
+
+        Assembler* findAssembler(const RxFrame& frame)
+        {
+            const DataTypeKind kind = (frame.getTransferType() == TransferTypeMessageBroadcast) ?
+                                      DataTypeKindMessage : DataTypeKindService;
+            const uint32_t key = (uint32_t(kind) << 16) | frame.getDataTypeID().get();
+
+            typename std::map<uint32_t, std::unique_ptr<Assembler> >::iterator it = assemblers_.find(key);
+            if (it == assemblers_.end())
+            {
+                const DataTypeDescriptor* const dtd =
+                    GlobalDataTypeRegistry::instance().find(kind, frame.getDataTypeID());
+                std::unique_ptr<Assembler> assembler;
+                if (dtd != UAVCAN_NULLPTR)
+                {
+                    assembler.reset(new Assembler(*this, perf_, *dtd, owner_.max_transfer_payload_len_,
+                                                  allocator_));
+                }
+                it = assemblers_.insert(std::make_pair(key, std::move(assembler))).first;
+            }
+            return it->second.get();
+        }
+
+        void processFrame(CanRxFrame& can_frame)
+        {
+            can_frame.iface_index = iface_index_;
+
+            RxFrame frame;
+            if (!frame.parse(can_frame, RxFrame::PayloadReference))
+            {
+                return;
+            }
+
+            const NodeID self(owner_.self_node_id_.load(std::memory_order_relaxed));
+            if ((frame.getDstNodeID() != NodeID::Broadcast) && (frame.getDstNodeID() != self))
+            {
+                return;
+            }
+
+            Assembler* const assembler = findAssembler(frame);
+            if (assembler != UAVCAN_NULLPTR)
+            {
+                assembler->handleFrame(frame, owner_.tao_disabled_.load(std::memory_order_relaxed));
+            }
+
+            if ((frame.getMonotonicTimestamp() - last_cleanup_ts_).toMSec() >= CleanupIntervalMSec)
+            {
+                last_cleanup_ts_ = frame.getMonotonicTimestamp();
+                for (typename std::map<uint32_t, std::unique_ptr<Assembler> >::iterator it = assemblers_.begin();
+                     it != assemblers_.end(); ++it)
+                {
+                    if (it->second)
+                    {
+                        it->second->cleanup(last_cleanup_ts_);
+                    }
+                }
+            }
+        }
+
+        void waitForFrames()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            sleeping_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);            // Pairs with the fence in push()
+            if (ring_.isEmpty() && !owner_.stop_requested_.load(std::memory_order_acquire))
+            {
+                // The timeout is only a safety net; normally the worker is woken up by push()
+                (void)cv_.wait_for(lock, std::chrono::milliseconds(IdleWakeupIntervalMSec));
+            }
+            sleeping_.store(false, std::memory_order_relaxed);
+        }
+
+        void run()
+        {
+            CanRxFrame frames[FrameBatchSize];
+            CanIOFlags flags[FrameBatchSize];
+            while (!owner_.stop_requested_.load(std::memory_order_acquire))
+            {
+                const int16_t num = ring_.receiveBatch(frames, flags, FrameBatchSize);
+                if (num <= 0)
+                {
+                    waitForFrames();
+                    continue;
+                }
+                for (int16_t i = 0; i < num; i++)
+                {
+                    processFrame(frames[i]);
+                }
+                num_errors_.store(perf_.getErrorCount(), std::memory_order_relaxed);
+            }
+        }
+
+    public:
+        /*
+         * Plain operator new does not honor the alignment of the ring indices before C++17,
+         * so the storage is over-allocated and aligned manually; the original pointer is kept right before the object.
+         */
+        static void* operator new(std::size_t size)
+        {
+            const std::size_t alignment = alignof(Worker);
+            uint8_t* const raw = static_cast<uint8_t*>(::operator new(size + alignment + sizeof(void*)));
+            const std::size_t address = reinterpret_cast<std::size_t>(raw + sizeof(void*));
+            uint8_t* const aligned = raw + sizeof(void*) + ((alignment - (address % alignment)) % alignment);
+            reinterpret_cast<void**>(aligned)[-1] = raw;
+            return aligned;
+        }
+
+        static void operator delete(void* ptr)
+        {
+            if (ptr != UAVCAN_NULLPTR)
+            {
+                ::operator delete(static_cast<void**>(ptr)[-1]);
+            }
+        }
+
+        Worker(RxPipeline& owner, uint8_t iface_index, uint16_t pool_blocks)
+            : owner_(owner)
+            , iface_index_(iface_index)
+            , allocator_(pool_blocks)
+            , num_errors_(0)
+            , num_dropped_transfers_(0)
+            , sleeping_(false)
+        { }
+
+        ~Worker() { join(); }
+
+        void start() { thread_ = std::thread(&Worker::run, this); }
+
+        void join()
+        {
+            if (thread_.joinable())
+            {
+                wakeUp();
+                thread_.join();
+            }
+        }
+
+        void wakeUp()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cv_.notify_one();
+        }
+
+        /// Driver RX thread
+        bool push(const CanRxFrame& frame)
+        {
+            const bool res = ring_.push(frame);
+            std::atomic_thread_fence(std::memory_order_seq_cst);            // Pairs with the fence in waitForFrames()
+            if (sleeping_.load(std::memory_order_relaxed))
+            {
+                wakeUp();
+            }
+            return res;
+        }
+
+        /// Worker thread, invoked by the assemblers
+        void handleTransfer(const DataTypeDescriptor& data_type, IncomingTransfer& transfer)
+        {
+            std::unique_ptr<CompletedTransfer> ct(new CompletedTransfer);
+
+            uint8_t buf[64];
+            unsigned offset = 0;
+            while (true)
+            {
+                const int res = transfer.read(offset, buf, sizeof(buf));
+                if (res < 0)
+                {
+                    UAVCAN_TRACE("RxPipeline", "Transfer read failure %i", res);
+                    return;
+                }
+                if (res == 0)
+                {
+                    break;
+                }
+                ct->payload.insert(ct->payload.end(), buf, buf + res);
+                offset += unsigned(res);
+            }
+
+            const NodeID dst = (transfer.getTransferType() == TransferTypeMessageBroadcast) ? NodeID::Broadcast :
+                               NodeID(owner_.self_node_id_.load(std::memory_order_relaxed));
+            Frame header(data_type.getID(), transfer.getTransferType(), transfer.getSrcNodeID(), dst,
+                         transfer.getTransferID(), transfer.isCanFDTransfer());
+            header.setPriority(transfer.getPriority());
+            header.setStartOfTransfer(true);
+            header.setEndOfTransfer(true);
+            ct->last_frame = RxFrame(header, transfer.getMonotonicTimestamp(), transfer.getUtcTimestamp(),
+                                     transfer.getIfaceIndex());
+            ct->tao_disabled = transfer.isTaoDisabled();
+
+            if (queue_.push(ct.get()))
+            {
+                (void)ct.release();
+            }
+            else
+            {
+                num_dropped_transfers_.store(num_dropped_transfers_.load(std::memory_order_relaxed) + 1U,
+                                             std::memory_order_relaxed);
+            }
+        }
+
+        /// Node thread
+        CompletedTransfer* popTransfer() { return queue_.pop(); }
+
+        uint32_t getNumRingOverflows() const { return ring_.getNumOverflows(); }
+        uint64_t getNumErrors() const { return num_errors_.load(std::memory_order_relaxed); }
+        uint64_t getNumDroppedTransfers() const { return num_dropped_transfers_.load(std::memory_order_relaxed); }
+    };
+
+    /**
+     * Redundant interface deduplication state, one per (transfer type, data type ID, source node ID).
+     * Same policy as in @ref TransferReceiver: the interface that delivered the last transfer is preferred,
+     * the other interfaces are accepted only if the preferred one has been silent for a while.
+     */
+    struct RedundancyState
+    {
+        MonotonicTime ts;
+        uint8_t iface_index;
+    };
+
+    INode& node_;
+    const uint16_t max_transfer_payload_len_;
+    const uint16_t pool_blocks_per_iface_;
+
+    std::vector<std::unique_ptr<Worker> > workers_;
+
+    // Snapshots of the dispatcher state for the workers, updated by the node thread
+    std::atomic<uint8_t> self_node_id_;
+    std::atomic<bool> tao_disabled_;
+    std::atomic<bool> stop_requested_;
+
+    std::map<uint32_t, RedundancyState> redundancy_states_;
+    MonotonicTime latest_transfer_ts_;
+    uint64_t num_duplicate_transfers_;
+
+    static MonotonicDuration getIfaceSwitchDelay()
+    {
+        return MonotonicDuration::fromMSec(TransferReceiver::DefaultTransferIntervalMSec);
+    }
+
+    void updateSnapshots()
+    {
+        const Dispatcher& dispatcher = node_.getDispatcher();
+        self_node_id_.store(dispatcher.getNodeID().get(), std::memory_order_relaxed);
+        tao_disabled_.store(dispatcher.isTaoDisabled(), std::memory_order_relaxed);
+    }
+
+    void pruneRedundancyStates()
+    {
+        const MonotonicTime deadline = latest_transfer_ts_ - getIfaceSwitchDelay();
+        for (typename std::map<uint32_t, RedundancyState>::iterator it = redundancy_states_.begin();
+             it != redundancy_states_.end();)
+        {
+            if (it->second.ts < deadline)
+            {
+                redundancy_states_.erase(it++);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    bool isDuplicate(const RxFrame& frame)
+    {
+        // Anonymous transfers can't be told apart, so they are never deduplicated, same as in the dispatcher
+        if ((workers_.size() < 2) || frame.getSrcNodeID().isBroadcast())
+        {
+            return false;
+        }
+
+        if (latest_transfer_ts_ < frame.getMonotonicTimestamp())
+        {
+            latest_transfer_ts_ = frame.getMonotonicTimestamp();
+        }
+
+        const uint32_t key = (uint32_t(frame.getTransferType()) << 24) |
+                             (uint32_t(frame.getDataTypeID().get()) << 8) | frame.getSrcNodeID().get();
+        typename std::map<uint32_t, RedundancyState>::iterator it = redundancy_states_.find(key);
+        if (it == redundancy_states_.end())
+        {
+            if (redundancy_states_.size() >= MaxRedundancyStates)
+            {
+                pruneRedundancyStates();
+            }
+            RedundancyState& state = redundancy_states_[key];
+            state.ts = frame.getMonotonicTimestamp();
+            state.iface_index = frame.getIfaceIndex();
+            return false;
+        }
+
+        RedundancyState& state = it->second;
+        if ((state.iface_index == frame.getIfaceIndex()) ||
+            ((frame.getMonotonicTimestamp() - state.ts) > getIfaceSwitchDelay()))
+        {
+            state.ts = frame.getMonotonicTimestamp();
+            state.iface_index = frame.getIfaceIndex();
+            return false;
+        }
+        return true;
+    }
+
+public:
+    /**
+     * @param node                          The node whose dispatcher will receive the transfers.
+     * @param max_transfer_payload_len      Longer transfers will be dropped by the workers.
+     * @param pool_blocks_per_iface         Reassembly memory pool size of each worker, in blocks.
+     */
+    explicit RxPipeline(INode& node,
+                        uint16_t max_transfer_payload_len = DefaultMaxTransferPayloadLen,
+                        uint16_t pool_blocks_per_iface = DefaultPoolBlocksPerIface)
+        : node_(node)
+        , max_transfer_payload_len_(max_transfer_payload_len)
+        , pool_blocks_per_iface_(pool_blocks_per_iface)
+        , self_node_id_(NodeID::Broadcast.get())
+        , tao_disabled_(false)
+        , stop_requested_(false)
+        , num_duplicate_transfers_(0)
+    { }
+
+    ~RxPipeline() { stop(); }
+
+    /**
+     * Starts one worker per CAN interface. Freezes the global data type registry.
+     * @return Non-negative on success, negative error code if the pipeline is already running.
+     */
+    int start()
+    {
+        if (isRunning())
+        {
+            return -ErrLogic;
+        }
+        GlobalDataTypeRegistry::instance().freeze();
+        updateSnapshots();
+        stop_requested_.store(false, std::memory_order_release);
+
+        const uint8_t num_ifaces = node_.getDispatcher().getCanIOManager().getNumIfaces();
+        for (uint8_t i = 0; i < num_ifaces; i++)
+        {
+            workers_.push_back(std::unique_ptr<Worker>(new Worker(*this, i, pool_blocks_per_iface_)));
+        }
+        for (uint8_t i = 0; i < num_ifaces; i++)
+        {
+            workers_[i]->start();
+        }
+        UAVCAN_TRACE("RxPipeline", "Started with %u workers", unsigned(num_ifaces));
+        return 0;
+    }
+
+    /**
+     * Stops and joins the workers. Frames and transfers that have not been dispatched yet are discarded.
+     */
+    void stop()
+    {
+        stop_requested_.store(true, std::memory_order_release);
+        for (unsigned i = 0; i < workers_.size(); i++)
+        {
+            workers_[i]->join();
+        }
+        workers_.clear();
+        redundancy_states_.clear();
+    }
+
+    bool isRunning() const { return !workers_.empty(); }
+
+    /**
+     * Called by the driver from its RX thread(s) for every received frame, except loopback frames.
+     * Different interfaces can be served by different threads, but calls for the same interface must not be
+     * concurrent. This method never blocks.
+     * @return True if the frame was accepted, false if the ring is full or the pipeline is not running.
+     */
+    bool push(uint8_t iface_index, const CanRxFrame& frame)
+    {
+        if (iface_index >= workers_.size())
+        {
+            return false;
+        }
+        return workers_[iface_index]->push(frame);
+    }
+
+    /**
+     * Delivers the completed transfers to the listeners. Must be called from the node thread.
+     * @return Number of delivered transfers, not including duplicates.
+     */
+    unsigned dispatch()
+    {
+        updateSnapshots();
+        Dispatcher& dispatcher = node_.getDispatcher();
+        unsigned num_delivered = 0;
+
+        for (unsigned i = 0; i < workers_.size(); i++)
+        {
+            // Bounded in order to not starve the other queues if the worker is faster than the node thread
+            for (unsigned k = 0; k < QueueCapacity; k++)
+            {
+                const std::unique_ptr<CompletedTransfer> ct(workers_[i]->popTransfer());
+                if (!ct)
+                {
+                    break;
+                }
+                if (isDuplicate(ct->last_frame))
+                {
+                    num_duplicate_transfers_++;
+                    continue;
+                }
+                PipelinedIncomingTransfer transfer(*ct);
+                dispatcher.dispatchCompletedTransfer(ct->last_frame, transfer);
+                num_delivered++;
+            }
+        }
+        return num_delivered;
+    }
+
+    /**
+     * Replaces the spin() method of the node: alternates between the scheduler, which handles timers, TX and
+     * loopback frames, and @ref dispatch().
+     * @param duration      Returns when this time has elapsed.
+     * @param slice         Maximum time spent in the scheduler at once, i.e. the maximum dispatch latency.
+     * @return Non-negative on success, negative error code from the scheduler otherwise.
+     */
+    int spin(MonotonicDuration duration, MonotonicDuration slice = MonotonicDuration::fromMSec(1))
+    {
+        const MonotonicTime deadline = node_.getMonotonicTime() + duration;
+        while (true)
+        {
+            (void)dispatch();
+            const MonotonicTime now = node_.getMonotonicTime();
+            if (now >= deadline)
+            {
+                return 0;
+            }
+            const MonotonicTime slice_deadline = min(deadline, now + slice);
+            const int res = node_.getScheduler().spin(slice_deadline);
+            if (res < 0)
+            {
+                return res;
+            }
+        }
+    }
+
+    /**
+     * Frames dropped because the ring of the interface was full.
+     */
+    uint64_t getNumRingOverflows() const
+    {
+        uint64_t sum = 0;
+        for (unsigned i = 0; i < workers_.size(); i++)
+        {
+            sum += workers_[i]->getNumRingOverflows();
+        }
+        return sum;
+    }
+
+    /**
+     * Completed transfers dropped because the node thread did not dispatch them in time.
+     */
+    uint64_t getNumDroppedTransfers() const
+    {
+        uint64_t sum = 0;
+        for (unsigned i = 0; i < workers_.size(); i++)
+        {
+            sum += workers_[i]->getNumDroppedTransfers();
+        }
+        return sum;
+    }
+
+    /**
+     * Reassembly errors of all workers, refer to @ref TransferPerfCounter.
+     */
+    uint64_t getNumTransferErrors() const
+    {
+        uint64_t sum = 0;
+        for (unsigned i = 0; i < workers_.size(); i++)
+        {
+            sum += workers_[i]->getNumErrors();
+        }
+        return sum;
+    }
+
+    /**
+     * Copies of the same transfer received via redundant interfaces that were dropped.
+     */
+    uint64_t getNumDuplicateTransfers() const { return num_duplicate_transfers_; }
+};
+
+}
+
+#endif // UAVCAN_HELPERS_RX_PIPELINE_HPP_INCLUDED
@@ -0,0 +1,581 @@
+/*
+ * Multi-threaded reception sharded by data type.
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_HELPERS_SHARDED_DISPATCHER_HPP_INCLUDED
+#define UAVCAN_HELPERS_SHARDED_DISPATCHER_HPP_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <uavcan/util/inplace_function.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/driver/rx_ring.hpp>
+#include <uavcan/helpers/heap_based_pool_allocator.hpp>
+#include <uavcan/marshal/scalar_codec.hpp>
+#include <uavcan/node/generic_subscriber.hpp>
+#include <uavcan/node/global_data_type_registry.hpp>
+#include <uavcan/transport/dispatcher.hpp>
+
+#if !UAVCAN_GENERAL_PURPOSE_PLATFORM
+# error The sharded dispatcher requires a general purpose platform
+#endif
+
+namespace uavcan
+{
+/**
+ * Optional multi-core reception for the gateways whose node thread can't keep up with the reassembly and the
+ * decoding of the transfers alone.
+ *
+ * The listeners are partitioned across the worker threads (shards) by the hash of the data type; each shard owns
+ * its listeners, its reassembly memory pool and its perf counter, and the callbacks of its listeners are executed
+ * in its thread. The node thread remains the front-end:
+ *
+ *  - The sharded dispatcher is installed as the RX frame listener of the dispatcher of the node, see
+ *    @ref Dispatcher::installRxFrameListener(), by @ref start(). Every received frame is classified by its CAN ID
+ *    alone; the frames nobody listens to and the service frames addressed to other nodes are dropped, the others
+ *    are pushed into the single-producer/single-consumer ring of their shard.
+ *  - Each shard parses the frames and hands them over to its listeners, so the frames of one data type are
+ *    processed by one thread in the order of reception.
+ *
+ * The listeners of the shards must not be registered in the dispatcher of the node; they can only be registered
+ * and unregistered while the shards are stopped, so the routing tables are read without locks. They must be
+ * destroyed before the sharded dispatcher, as they use the memory pool of their shard, see @ref getShardFor().
+ * The redundant copies of the frames are dropped by the transfer receivers of the listeners, as usual.
+ *
+ * @tparam RingCapacity     Capacity of the frame ring of each shard, see @ref CanRxRing.
+ */
+template <unsigned RingCapacity = 512>
+class UAVCAN_EXPORT ShardedDispatcher : public IRxFrameListener, Noncopyable
+{
+public:
+    enum { MaxShards = 32 };
+    enum { DefaultPoolBlocksPerShard = 1024 };
+
+    class Shard;
+
+private:
+    enum { FrameBatchSize = 16 };
+    enum { IdleWakeupIntervalMSec = 10 };
+    enum { CleanupIntervalMSec = 1000 };
+
+    typedef std::map<uint32_t, std::vector<TransferListener*> > ListenerMap;
+
+public:
+    /**
+     * One worker thread with its listeners.
+     */
+    class Shard : Noncopyable
+    {
+        ShardedDispatcher& owner_;
+
+        CanRxRing<RingCapacity> ring_;
+        HeapBasedPoolAllocator<MemPoolBlockSize> allocator_;
+        TransferPerfCounter perf_;
+        ListenerMap listeners_;
+        MonotonicTime last_cleanup_ts_;
+
+        std::atomic<uint64_t> num_processed_frames_;
+        std::atomic<uint64_t> num_errors_;
+
+        std::atomic<bool> sleeping_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::thread thread_;
+
+        void processFrame(const CanRxFrame& can_frame)
+        {
+            RxFrame frame;
+            if (frame.parse(can_frame, RxFrame::PayloadReference))
+            {
+                const typename ListenerMap::const_iterator it =
+                    listeners_.find(makeKey(frame.getTransferType(), frame.getDataTypeID()));
+                if (it != listeners_.end())
+                {
+                    const bool tao_disabled = owner_.tao_disabled_.load(std::memory_order_relaxed);
+                    for (unsigned i = 0; i < it->second.size(); i++)
+                    {
+                        it->second[i]->handleFrame(frame, tao_disabled);
+                    }
+                }
+            }
+
+            if ((can_frame.ts_mono - last_cleanup_ts_).toMSec() >= CleanupIntervalMSec)
+            {
+                last_cleanup_ts_ = can_frame.ts_mono;
+                for (typename ListenerMap::const_iterator it = listeners_.begin(); it != listeners_.end(); ++it)
+                {
+                    for (unsigned i = 0; i < it->second.size(); i++)
+                    {
+                        it->second[i]->cleanup(last_cleanup_ts_);
+                    }
+                }
+            }
+        }
+
+        void waitForFrames()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            sleeping_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);            // Pairs with the fence in push()
+            if (ring_.isEmpty() && !owner_.stop_requested_.load(std::memory_order_acquire))
+            {
+                // The timeout is only a safety net; normally the shard is woken up by push()
+                (void)cv_.wait_for(lock, std::chrono::milliseconds(IdleWakeupIntervalMSec));
+            }
+            sleeping_.store(false, std::memory_order_relaxed);
+        }
+
+        void run()
+        {
+            CanRxFrame frames[FrameBatchSize];
+            CanIOFlags flags[FrameBatchSize];
+            while (!owner_.stop_requested_.load(std::memory_order_acquire))
+            {
+                const int16_t num = ring_.receiveBatch(frames, flags, FrameBatchSize);
+                if (num <= 0)
+                {
+                    waitForFrames();
+                    continue;
+                }
+                for (int16_t i = 0; i < num; i++)
+                {
+                    processFrame(frames[i]);
+                }
+                num_errors_.store(perf_.getErrorCount(), std::memory_order_relaxed);
+                num_processed_frames_.store(num_processed_frames_.load(std::memory_order_relaxed) + uint64_t(num),
+                                            std::memory_order_release);
+            }
+        }
+
+    public:
+        /*
+         * Same as in RxPipeline: plain operator new does not honor the alignment of the ring indices before C++17.
+         */
+        static void* operator new(std::size_t size)
+        {
+            const std::size_t alignment = alignof(Shard);
+            uint8_t* const raw = static_cast<uint8_t*>(::operator new(size + alignment + sizeof(void*)));
+            const std::size_t address = reinterpret_cast<std::size_t>(raw + sizeof(void*));
+            uint8_t* const aligned = raw + sizeof(void*) + ((alignment - (address % alignment)) % alignment);
+            reinterpret_cast<void**>(aligned)[-1] = raw;
+            return aligned;
+        }
+
+        static void operator delete(void* ptr)
+        {
+            if (ptr != UAVCAN_NULLPTR)
+            {
+                ::operator delete(static_cast<void**>(ptr)[-1]);
+            }
+        }
+
+        Shard(ShardedDispatcher& owner, uint16_t pool_blocks)
+            : owner_(owner)
+            , allocator_(pool_blocks)
+            , num_processed_frames_(0)
+            , num_errors_(0)
+            , sleeping_(false)
+        { }
+
+        ~Shard() { join(); }
+
+        void start() { thread_ = std::thread(&Shard::run, this); }
+
+        void join()
+        {
+            if (thread_.joinable())
+            {
+                wakeUp();
+                thread_.join();
+            }
+        }
+
+        void wakeUp()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cv_.notify_one();
+        }
+
+        /// Front-end thread
+        bool push(const CanRxFrame& frame)
+        {
+            const bool res = ring_.push(frame);
+            std::atomic_thread_fence(std::memory_order_seq_cst);            // Pairs with the fence in waitForFrames()
+            if (sleeping_.load(std::memory_order_relaxed))
+            {
+                wakeUp();
+            }
+            return res;
+        }
+
+        /// Any thread while stopped
+        void addListener(uint32_t key, TransferListener* listener) { listeners_[key].push_back(listener); }
+        void removeListener(uint32_t key, TransferListener* listener)
+        {
+            const typename ListenerMap::iterator it = listeners_.find(key);
+            if (it == listeners_.end())
+            {
+                return;
+            }
+            for (unsigned i = 0; i < it->second.size(); i++)
+            {
+                if (it->second[i] == listener)
+                {
+                    it->second.erase(it->second.begin() + long(i));
+                    break;
+                }
+            }
+            if (it->second.empty())
+            {
+                listeners_.erase(it);
+            }
+        }
+
+        /// Front-end thread while running; the map is not modified then
+        bool hasListeners(uint32_t key) const { return listeners_.find(key) != listeners_.end(); }
+
+        /**
+         * The memory pool and the perf counter that the listeners of this shard must be constructed with.
+         */
+        IPoolAllocator& getAllocator() { return allocator_; }
+        TransferPerfCounter& getTransferPerfCounter() { return perf_; }
+
+        uint64_t getNumProcessedFrames() const { return num_processed_frames_.load(std::memory_order_acquire); }
+        uint32_t getNumRingOverflows() const { return ring_.getNumOverflows(); }
+        uint64_t getNumErrors() const { return num_errors_.load(std::memory_order_relaxed); }
+    };
+
+private:
+    Dispatcher& frontend_;
+    std::vector<std::unique_ptr<Shard> > shards_;
+    bool running_;
+    uint64_t num_dropped_frames_;
+
+    // Snapshots of the dispatcher state for the shards, updated by the front-end thread
+    std::atomic<uint8_t> self_node_id_;
+    std::atomic<bool> tao_disabled_;
+    std::atomic<bool> stop_requested_;
+
+    static uint32_t makeKey(TransferType transfer_type, DataTypeID dtid)
+    {
+        return (uint32_t(transfer_type) << 16) | dtid.get();
+    }
+
+    void updateSnapshots()
+    {
+        self_node_id_.store(frontend_.getNodeID().get(), std::memory_order_relaxed);
+        tao_disabled_.store(frontend_.isTaoDisabled(), std::memory_order_relaxed);
+    }
+
+    /**
+     * Decodes the CAN ID fields the same way as the dispatcher does before parsing.
+     * Returns false if the frame is not a UAVCAN frame or is addressed to another node.
+     */
+    bool classify(const CanFrame& frame, TransferType& out_transfer_type, DataTypeID& out_dtid) const
+    {
+        if ((frame.id & (CanFrame::FlagEFF | CanFrame::FlagRTR | CanFrame::FlagERR)) != CanFrame::FlagEFF)
+        {
+            return false;
+        }
+        const uint32_t id = frame.id & CanFrame::MaskExtID;
+        if ((id & 0x80U) != 0U)
+        {
+            if (((id >> 8) & NodeID::Max) != self_node_id_.load(std::memory_order_relaxed))
+            {
+                return false;
+            }
+            out_transfer_type = ((id >> 15) & 1U) ? TransferTypeServiceRequest : TransferTypeServiceResponse;
+            out_dtid = DataTypeID(uint16_t((id >> 16) & 0xFFU));
+        }
+        else
+        {
+            uint16_t dtid = uint16_t((id >> 8) & 0xFFFFU);
+            if ((id & 0x7FU) == 0U)
+            {
+                dtid = uint16_t(dtid & 3U);         // Anonymous frame, removing the discriminator
+            }
+            out_transfer_type = TransferTypeMessageBroadcast;
+            out_dtid = DataTypeID(dtid);
+        }
+        return true;
+    }
+
+public:
+    /**
+     * @param frontend              The dispatcher of the node, whose thread receives the frames.
+     * @param num_shards            Number of worker threads, up to @ref MaxShards.
+     * @param pool_blocks_per_shard Reassembly memory pool size of each shard, in blocks.
+     */
+    ShardedDispatcher(Dispatcher& frontend, uint8_t num_shards,
+                      uint16_t pool_blocks_per_shard = DefaultPoolBlocksPerShard)
+        : frontend_(frontend)
+        , running_(false)
+        , num_dropped_frames_(0)
+        , self_node_id_(NodeID::Broadcast.get())
+        , tao_disabled_(false)
+        , stop_requested_(false)
+    {
+        num_shards = uint8_t(max<unsigned>(1U, min<unsigned>(num_shards, MaxShards)));
+        for (uint8_t i = 0; i < num_shards; i++)
+        {
+            shards_.push_back(std::unique_ptr<Shard>(new Shard(*this, pool_blocks_per_shard)));
+        }
+    }
+
+    virtual ~ShardedDispatcher() { stop(); }
+
+    unsigned getNumShards() const { return unsigned(shards_.size()); }
+
+    /**
+     * The requests and the responses of a service are handled by the same shard.
+     */
+    unsigned getShardIndex(DataTypeKind kind, DataTypeID dtid) const
+    {
+        const uint32_t hash = ((uint32_t(kind) << 16) | dtid.get()) * 2654435761U;     // Knuth's multiplicative
+        return unsigned((hash >> 16) % shards_.size());
+    }
+
+    Shard& getShard(unsigned index) { return *shards_.at(index); }
+
+    /**
+     * The shard of the data type; its listeners must be constructed with the allocator and the perf counter
+     * of this shard.
+     */
+    Shard& getShardFor(const DataTypeDescriptor& data_type)
+    {
+        return getShard(getShardIndex(data_type.getKind(), data_type.getID()));
+    }
+
+    /**
+     * The listener is assigned to the shard of its data type.
+     * @return Negative error code; -ErrLogic if the shards are running.
+     */
+    int registerListener(TransferType transfer_type, TransferListener& listener)
+    {
+        if (running_)
+        {
+            return -ErrLogic;
+        }
+        const DataTypeDescriptor& dtd = listener.getDataTypeDescriptor();
+        getShardFor(dtd).addListener(makeKey(transfer_type, dtd.getID()), &listener);
+        return 0;
+    }
+
+    int unregisterListener(TransferType transfer_type, TransferListener& listener)
+    {
+        if (running_)
+        {
+            return -ErrLogic;
+        }
+        const DataTypeDescriptor& dtd = listener.getDataTypeDescriptor();
+        getShardFor(dtd).removeListener(makeKey(transfer_type, dtd.getID()), &listener);
+        return 0;
+    }
+
+    /**
+     * Starts the shards and installs the front-end into the dispatcher of the node.
+     * @return Non-negative on success, -ErrLogic if already running or if the dispatcher has another RX listener.
+     */
+    int start()
+    {
+        if (running_ || (frontend_.getRxFrameListener() != UAVCAN_NULLPTR))
+        {
+            return -ErrLogic;
+        }
+        updateSnapshots();
+        stop_requested_.store(false, std::memory_order_release);
+        for (unsigned i = 0; i < shards_.size(); i++)
+        {
+            shards_[i]->start();
+        }
+        frontend_.installRxFrameListener(this);
+        running_ = true;
+        UAVCAN_TRACE("ShardedDispatcher", "Started with %u shards", unsigned(shards_.size()));
+        return 0;
+    }
+
+    /**
+     * Stops and joins the shards. Must be called from the front-end thread. The frames that have not been
+     * processed yet are discarded.
+     */
+    void stop()
+    {
+        if (!running_)
+        {
+            return;
+        }
+        frontend_.removeRxFrameListener();
+        stop_requested_.store(true, std::memory_order_release);
+        for (unsigned i = 0; i < shards_.size(); i++)
+        {
+            shards_[i]->join();
+        }
+        running_ = false;
+    }
+
+    bool isRunning() const { return running_; }
+
+    /**
+     * Front-end; invoked by the dispatcher of the node for every received frame.
+     */
+    virtual void handleRxFrame(const CanRxFrame& frame, CanIOFlags flags) override
+    {
+        if ((flags & CanIOFlagLoopback) == 0)
+        {
+            updateSnapshots();
+            (void)push(frame);
+        }
+    }
+
+    /**
+     * Classifies the frame and passes it to its shard; never blocks. Can be used instead of the installed
+     * front-end by a driver that receives the frames in its own thread, but the calls must not be concurrent.
+     * @return True if the frame was passed to a shard.
+     */
+    bool push(const CanRxFrame& frame)
+    {
+        TransferType transfer_type = TransferTypeMessageBroadcast;
+        DataTypeID dtid;
+        if (!running_ || !classify(frame, transfer_type, dtid))
+        {
+            return false;
+        }
+        const DataTypeKind kind = (transfer_type == TransferTypeMessageBroadcast) ? DataTypeKindMessage :
+                                  DataTypeKindService;
+        Shard& shard = *shards_[getShardIndex(kind, dtid)];
+        if (!shard.hasListeners(makeKey(transfer_type, dtid)))
+        {
+            return false;
+        }
+        if (!shard.push(frame))
+        {
+            num_dropped_frames_++;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Frames of interest that were dropped because the ring of their shard was full.
+     */
+    uint64_t getNumDroppedFrames() const { return num_dropped_frames_; }
+
+    /**
+     * Reassembly errors of all shards, refer to @ref TransferPerfCounter.
+     */
+    uint64_t getNumTransferErrors() const
+    {
+        uint64_t sum = 0;
+        for (unsigned i = 0; i < shards_.size(); i++)
+        {
+            sum += shards_[i]->getNumErrors();
+        }
+        return sum;
+    }
+};
+
+/**
+ * Subscriber that lives in a shard of @ref ShardedDispatcher: the messages are decoded and the callback is invoked
+ * in the thread of the shard. The callback receives the same structure as the callback of @ref Subscriber.
+ * The data type must be registered in @ref GlobalDataTypeRegistry, which gets frozen. The subscriber can only be
+ * constructed and destroyed while the shards are stopped, and must be destroyed before the sharded dispatcher.
+ */
+template <typename DataType_,
+          typename Callback_ = DefaultCallback<void (const ReceivedDataStructure<DataType_>&)>,
+          unsigned RingCapacity = 512>
+class UAVCAN_EXPORT ShardedSubscriber : public TransferListener
+{
+public:
+    typedef DataType_ DataType;
+    typedef Callback_ Callback;
+
+private:
+    struct ReceivedDataStructureSpec : public ReceivedDataStructure<DataType>
+    {
+        explicit ReceivedDataStructureSpec(const IncomingTransfer* arg_transfer)
+            : ReceivedDataStructure<DataType>(arg_transfer)
+        { }
+    };
+
+    static const DataTypeDescriptor& getDescriptor()
+    {
+        GlobalDataTypeRegistry::instance().freeze();
+        const DataTypeDescriptor* const descr =
+            GlobalDataTypeRegistry::instance().find(DataTypeKind(DataType::DataTypeKind),
+                                                    DataType::getDataTypeFullName());
+        UAVCAN_ASSERT(descr != UAVCAN_NULLPTR);
+        return *descr;
+    }
+
+    ShardedDispatcher<RingCapacity>& sharded_;
+    TransferPerfCounter& shard_perf_;
+    Callback callback_;
+    uint32_t failure_count_;
+
+    virtual void handleIncomingTransfer(IncomingTransfer& transfer) override
+    {
+        ReceivedDataStructureSpec rx_struct(&transfer);
+
+        const LinearizedIncomingTransfer<RxLinearizationBufferSize<DataType>::Result> payload(transfer);
+        BitStream bitstream = (payload.getData() != UAVCAN_NULLPTR) ?
+                              BitStream(payload.getData(), payload.getLength()) : BitStream(transfer);
+        ScalarCodec codec(bitstream);
+
+        const TailArrayOptimizationMode tao_mode = (transfer.isCanFDTransfer() || transfer.isTaoDisabled()) ?
+                                                   TailArrayOptDisabled : TailArrayOptEnabled;
+        const int decode_res = DataType::decode(rx_struct, codec, tao_mode);
+        transfer.release();
+
+        if (decode_res <= 0)
+        {
+            UAVCAN_TRACE("ShardedSubscriber", "Unable to decode the message [%i] [%s]",
+                         decode_res, DataType::getDataTypeFullName());
+            failure_count_++;
+            shard_perf_.addError();
+            return;
+        }
+        callback_(rx_struct);
+    }
+
+public:
+    ShardedSubscriber(ShardedDispatcher<RingCapacity>& sharded, const Callback& callback)
+        : TransferListener(sharded.getShardFor(getDescriptor()).getTransferPerfCounter(), getDescriptor(),
+                           BitLenToByteLen<DataType::MaxBitLen>::Result,
+                           sharded.getShardFor(getDescriptor()).getAllocator())
+        , sharded_(sharded)
+        , shard_perf_(sharded.getShardFor(getDescriptor()).getTransferPerfCounter())
+        , callback_(callback)
+        , failure_count_(0)
+    {
+        allowAnonymousTransfers();
+        const int res = sharded_.registerListener(TransferTypeMessageBroadcast, *this);
+        UAVCAN_ASSERT(res >= 0);
+        (void)res;
+    }
+
+    virtual ~ShardedSubscriber()
+    {
+        const int res = sharded_.unregisterListener(TransferTypeMessageBroadcast, *this);
+        UAVCAN_ASSERT(res >= 0);
+        (void)res;
+    }
+
+    /**
+     * Number of the messages that could not be decoded; must be read while the shards are stopped.
+     */
+    uint32_t getFailureCount() const { return failure_count_; }
+};
+
+}
+
+#endif // UAVCAN_HELPERS_SHARDED_DISPATCHER_HPP_INCLUDED
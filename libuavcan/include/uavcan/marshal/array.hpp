@@ -434,7 +434,42 @@ class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
     int encodeImpl(ScalarCodec& codec, const TailArrayOptimizationMode tao_mode, FalseType) const  /// Static
     {
         UAVCAN_ASSERT(size() > 0);
-        for (SizeType i = 0; i < size(); i++)
+        return encodeElements(codec, tao_mode, BooleanType<(BulkArrayCodec<RawValueType>::IsSupported != 0)>());
+    }
+
+    /**
+     * Bulk coding works in chunks that fit one stream operation, which has no effect if it fails. If a chunk does not
+     * fit, it is retried element by element, so that the stream ends up in the same state as without bulk coding.
+     */
+    enum { BulkChunkSize = BitStream::MaxBitsPerRW / T::MaxBitLen };
+
+    int encodeElements(ScalarCodec& codec, const TailArrayOptimizationMode tao_mode, TrueType) const   /// Bulk
+    {
+        for (unsigned offset = 0; offset < size(); offset += unsigned(BulkChunkSize))    // May exceed SizeType
+        {
+            const unsigned end = min(unsigned(size()), offset + unsigned(BulkChunkSize));
+            const int res = BulkArrayCodec<RawValueType>::encode(Base::begin() + offset, end - offset, codec);
+            if (res == 0)
+            {
+                return encodeElements(codec, tao_mode, SizeType(offset), FalseType());
+            }
+            if (res < 0)
+            {
+                return res;
+            }
+        }
+        return 1;
+    }
+
+    int encodeElements(ScalarCodec& codec, const TailArrayOptimizationMode tao_mode, FalseType) const
+    {
+        return encodeElements(codec, tao_mode, 0, FalseType());
+    }
+
+    int encodeElements(ScalarCodec& codec, const TailArrayOptimizationMode tao_mode,
+                       const typename Base::SizeType first, FalseType) const
+    {
+        for (SizeType i = first; i < size(); i++)
         {
             const bool last_item = i == (size() - 1);
             const int res = RawValueType::encode(Base::at(i), codec, last_item ? tao_mode : TailArrayOptDisabled);
@@ -470,7 +505,36 @@ class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
     int decodeImpl(ScalarCodec& codec, const TailArrayOptimizationMode tao_mode, FalseType)  /// Static
     {
         UAVCAN_ASSERT(size() > 0);
-        for (SizeType i = 0; i < size(); i++)
+        return decodeElements(codec, tao_mode, BooleanType<(BulkArrayCodec<RawValueType>::IsSupported != 0)>());
+    }
+
+    int decodeElements(ScalarCodec& codec, const TailArrayOptimizationMode tao_mode, TrueType)           /// Bulk
+    {
+        for (unsigned offset = 0; offset < size(); offset += unsigned(BulkChunkSize))    // May exceed SizeType
+        {
+            const unsigned end = min(unsigned(size()), offset + unsigned(BulkChunkSize));
+            const int res = BulkArrayCodec<RawValueType>::decode(Base::begin() + offset, end - offset, codec);
+            if (res == 0)
+            {
+                return decodeElements(codec, tao_mode, SizeType(offset), FalseType());
+            }
+            if (res < 0)
+            {
+                return res;
+            }
+        }
+        return 1;
+    }
+
+    int decodeElements(ScalarCodec& codec, const TailArrayOptimizationMode tao_mode, FalseType)
+    {
+        return decodeElements(codec, tao_mode, 0, FalseType());
+    }
+
+    int decodeElements(ScalarCodec& codec, const TailArrayOptimizationMode tao_mode,
+                       const typename Base::SizeType first, FalseType)
+    {
+        for (SizeType i = first; i < size(); i++)
         {
             const bool last_item = i == (size() - 1);
             ValueType value = ValueType();                          // TODO: avoid extra copy
@@ -484,6 +548,28 @@ class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
         return 1;
     }
 
+    /**
+     * The length of a tail array is not known in advance, so it is decoded in bulk chunks while they fit;
+     * the remainder of the stream is decoded element by element.
+     */
+    int decodeTailChunks(ScalarCodec& codec, TrueType)
+    {
+        while ((unsigned(size()) + unsigned(BulkChunkSize)) <= MaxSize_)
+        {
+            const SizeType offset = size();
+            resize(SizeType(offset + BulkChunkSize));
+            const int res = BulkArrayCodec<RawValueType>::decode(Base::begin() + offset, BulkChunkSize, codec);
+            if (res <= 0)
+            {
+                resize(offset);
+                return res;
+            }
+        }
+        return 1;
+    }
+
+    int decodeTailChunks(ScalarCodec&, FalseType) { return 1; }
+
 #if __GNUC__
 # pragma GCC diagnostic push
 # pragma GCC diagnostic ignored "-Wtype-limits"
@@ -494,6 +580,12 @@ class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
         Base::clear();
         if (isOptimizedTailArray(tao_mode))
         {
+            const int res_bulk =
+                decodeTailChunks(codec, BooleanType<(BulkArrayCodec<RawValueType>::IsSupported != 0)>());
+            if (res_bulk < 0)
+            {
+                return res_bulk;
+            }
             while (true)
             {
                 ValueType value = ValueType();
@@ -540,6 +632,21 @@ class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
 # pragma GCC diagnostic pop
 #endif
 
+    unsigned computeElementsBitLen(const TailArrayOptimizationMode tao_mode) const
+    {
+        if (static_cast<unsigned>(T::MinBitLen) == static_cast<unsigned>(T::MaxBitLen))
+        {
+            return unsigned(size()) * unsigned(T::MaxBitLen);
+        }
+        unsigned bitlen = 0;
+        for (typename Base::SizeType i = 0; i < size(); i++)
+        {
+            const bool last_item = i == (size() - 1);
+            bitlen += T::computeEncodedBitLen(Base::at(i), last_item ? tao_mode : TailArrayOptDisabled);
+        }
+        return bitlen;
+    }
+
     template <typename InputIter>
     void packSquareMatrixImpl(const InputIter src_row_major)
     {
@@ -704,6 +811,23 @@ public:
         return array.decodeImpl(codec, tao_mode, BooleanType<IsDynamic>());
     }
 
+    /**
+     * Returns the number of bits that @ref encode() would produce with the same arguments.
+     * This takes constant time if the elements are of fixed size.
+     */
+    static unsigned computeEncodedBitLen(const SelfType& array, const TailArrayOptimizationMode tao_mode)
+    {
+        if (IsDynamic == 0)
+        {
+            return array.computeElementsBitLen(tao_mode);
+        }
+        if (isOptimizedTailArray(tao_mode))
+        {
+            return array.computeElementsBitLen(TailArrayOptDisabled);
+        }
+        return unsigned(Base::SizeBitLen) + array.computeElementsBitLen(tao_mode);
+    }
+
     static void extendDataTypeSignature(DataTypeSignature& signature)
     {
         RawValueType::extendDataTypeSignature(signature);
@@ -1265,6 +1389,64 @@ public:
     }
 };
 
+template <typename T, ArrayMode ArrayMode, unsigned MaxSize>
+class UAVCAN_EXPORT JsonStreamer<Array<T, ArrayMode, MaxSize> >
+{
+    typedef Array<T, ArrayMode, MaxSize> ArrayType;
+
+    template <typename Stream>
+    static void streamElements(Stream& s, const ArrayType& array)
+    {
+        s.write('[');
+        for (typename ArrayType::SizeType i = 0; i < array.size(); i++)
+        {
+            if (i > 0)
+            {
+                s.write(',');
+            }
+            JsonStreamer<T>::stream(s, array.at(i));
+        }
+        s.write(']');
+    }
+
+    template <typename Stream>
+    static void streamImpl(Stream& s, const ArrayType& array, TrueType)
+    {
+        // Same as YAML: text only if it's printable, otherwise the values
+        for (typename ArrayType::SizeType i = 0; i < array.size(); i++)
+        {
+            const int c = array[i];
+            if ((c < 32 || c > 126) && (c != '\n') && (c != '\r') && (c != '\t'))
+            {
+                streamElements(s, array);
+                return;
+            }
+        }
+        s.write('"');
+        for (typename ArrayType::SizeType i = 0; i < array.size(); i++)
+        {
+            s.writeEscaped(char(array[i]));
+        }
+        s.write('"');
+    }
+
+    template <typename Stream>
+    static void streamImpl(Stream& s, const ArrayType& array, FalseType)
+    {
+        streamElements(s, array);
+    }
+
+public:
+    /**
+     * Prints Array<> into the stream as a JSON array, or as a string if it's a printable string-like array.
+     */
+    template <typename Stream>
+    static void stream(Stream& s, const ArrayType& array)
+    {
+        streamImpl(s, array, BooleanType<ArrayType::IsStringLike>());
+    }
+};
+
 }
 
 #endif // UAVCAN_MARSHAL_ARRAY_HPP_INCLUDED
@@ -24,6 +24,8 @@ namespace uavcan
 void bitarrayCopy(const unsigned char* src_org, std::size_t src_offset, std::size_t src_len,
                   unsigned char* dst_org, std::size_t dst_offset);
 
+class StaticTransferBufferImpl;
+
 /**
  * This class treats a chunk of memory as an array of bits.
  * It is used by the bit codec for serialization/deserialization.
@@ -32,7 +34,10 @@ class UAVCAN_EXPORT BitStream
 {
     static const unsigned MaxBytesPerRW = 16;
 
-    ITransferBuffer& buf_;
+    ITransferBuffer* const buf_;
+    StaticTransferBufferImpl* const static_buf_;    ///< Same as buf_ if the buffer is contiguous, accessed directly
+    const uint8_t* const direct_data_;  ///< Read-only memory that is accessed directly, bypassing the buffer
+    const unsigned direct_len_;
     unsigned bit_offset_;
     uint8_t byte_cache_;
 
@@ -52,6 +57,9 @@ class UAVCAN_EXPORT BitStream
                      reinterpret_cast<unsigned char*>(dst_org), 0);
     }
 
+    int writeStatic(const uint8_t* bytes, const unsigned bitlen);
+    int readStatic(uint8_t* bytes, const unsigned bitlen);
+
 public:
     static const unsigned MaxBitsPerRW = MaxBytesPerRW * 8;
 
@@ -62,13 +70,40 @@ public:
     };
 
     explicit BitStream(ITransferBuffer& buf)
-        : buf_(buf)
+        : buf_(&buf)
+        , static_buf_(UAVCAN_NULLPTR)
+        , direct_data_(UAVCAN_NULLPTR)
+        , direct_len_(0)
         , bit_offset_(0)
         , byte_cache_(0)
     {
         StaticAssert<sizeof(uint8_t) == 1>::check();
     }
 
+    /**
+     * Stream over a contiguous buffer, e.g. the serialization buffer of a publisher. This overload is preferred
+     * by the compiler for such buffers. The bits are written in place, so that the buffer is accessed without
+     * virtual calls and intermediate copying, and the last partially written byte is not rewritten each time.
+     * The semantics are the same as for an arbitrary transfer buffer.
+     */
+    explicit BitStream(StaticTransferBufferImpl& buf);
+
+    /**
+     * Read-only stream over a contiguous chunk of memory, e.g. payload of a single-frame transfer.
+     * Reads are served directly from the memory, without virtual calls and intermediate copying.
+     * Writes are rejected with an error.
+     */
+    BitStream(const uint8_t* data, unsigned len)
+        : buf_(UAVCAN_NULLPTR)
+        , static_buf_(UAVCAN_NULLPTR)
+        , direct_data_(data)
+        , direct_len_(len)
+        , bit_offset_(0)
+        , byte_cache_(0)
+    {
+        UAVCAN_ASSERT((data != UAVCAN_NULLPTR) || (len == 0));
+    }
+
     /**
      * Write/read calls interpret bytes as bit arrays, 8 bits per byte, where the most
      * significant bits have lower index, i.e.:
@@ -83,6 +118,26 @@ public:
     int write(const uint8_t* bytes, const unsigned bitlen);
     int read(uint8_t* bytes, const unsigned bitlen);
 
+    /**
+     * Contiguous buffers only: accepts the given number of bits that the caller has written straight into the
+     * buffer at the current offset, which must be byte aligned. Return values are the same as for write().
+     */
+    int advanceWritten(const unsigned bitlen);
+
+    /**
+     * Number of bits written or read so far.
+     */
+    unsigned getBitOffset() const { return bit_offset_; }
+
+    /**
+     * Restarts from the beginning of the buffer. The contents of the buffer are not affected.
+     */
+    void rewind()
+    {
+        bit_offset_ = 0;
+        byte_cache_ = 0;
+    }
+
 #if UAVCAN_TOSTRING
     std::string toString() const;
 #endif
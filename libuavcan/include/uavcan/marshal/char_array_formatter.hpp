@@ -76,6 +76,15 @@ public:
     ArrayType& getArray() { return array_; }
     const ArrayType& getArray() const { return array_; }
 
+    /**
+     * Writes one value the same way as it would be substituted into the format string by @ref write().
+     */
+    template <typename T>
+    void writeArgument(T value)
+    {
+        writeValue(value);
+    }
+
     void write(const char* text)
     {
         writeValue(text);
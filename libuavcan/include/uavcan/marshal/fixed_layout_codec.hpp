@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_MARSHAL_FIXED_LAYOUT_CODEC_HPP_INCLUDED
+#define UAVCAN_MARSHAL_FIXED_LAYOUT_CODEC_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/util/templates.hpp>
+#include <uavcan/transport/abstract_transfer_buffer.hpp>
+#include <uavcan/marshal/scalar_codec.hpp>
+#include <uavcan/marshal/type_util.hpp>
+
+namespace uavcan
+{
+/**
+ * Drop-in replacement for @ref ScalarCodec that places one scalar at a compile-time constant bit offset
+ * in a bit image held in memory, which is then written into or read from the stream in one operation.
+ *
+ * This is used by the code generated by the DSDL compiler for the data types whose layout is fixed, i.e. that
+ * contain only primitive and void fields; this way all offsets and shifts are resolved at compile time.
+ * The bits are packed exactly the same way as by @ref ScalarCodec.
+ *
+ * The image must be zero-initialized before encoding, because the bits are merged in with bitwise OR.
+ */
+template <unsigned BitOffset>
+class UAVCAN_EXPORT FixedLayoutCodec
+{
+    uint8_t* const image_;
+
+    /**
+     * Stores or loads the given number of the least significant bits, the most significant of them goes first.
+     */
+    template <unsigned Position, unsigned NumBits>
+    void storeBits(unsigned bits)
+    {
+        StaticAssert<(NumBits > 0) && (NumBits <= 8)>::check();
+        const unsigned shifted = (bits & ((1U << NumBits) - 1U)) << (16U - NumBits - (Position % 8U));
+        image_[Position / 8U] = uint8_t(image_[Position / 8U] | (shifted >> 8));
+        if (((Position % 8U) + NumBits) > 8U)
+        {
+            image_[Position / 8U + 1U] = uint8_t(image_[Position / 8U + 1U] | (shifted & 0xFFU));
+        }
+    }
+
+    template <unsigned Position, unsigned NumBits>
+    unsigned loadBits() const
+    {
+        StaticAssert<(NumBits > 0) && (NumBits <= 8)>::check();
+        unsigned word = unsigned(image_[Position / 8U]) << 8;
+        if (((Position % 8U) + NumBits) > 8U)
+        {
+            word |= image_[Position / 8U + 1U];
+        }
+        return (word >> (16U - NumBits - (Position % 8U))) & ((1U << NumBits) - 1U);
+    }
+
+    /*
+     * The scalar is split into the bytes of its little endian representation; the last byte can be incomplete.
+     * The recursion is resolved at compile time.
+     */
+    template <unsigned BitLen, unsigned ByteIndex>
+    typename EnableIf<(ByteIndex * 8U < BitLen)>::Type storeBytes(uint64_t value)
+    {
+        enum { NumBits = ((BitLen - ByteIndex * 8U) < 8U) ? (BitLen - ByteIndex * 8U) : 8U };
+        storeBits<BitOffset + ByteIndex * 8U, NumBits>(unsigned(value >> (ByteIndex * 8U)) & 0xFFU);
+        storeBytes<BitLen, ByteIndex + 1U>(value);
+    }
+
+    template <unsigned BitLen, unsigned ByteIndex>
+    typename EnableIf<(ByteIndex * 8U >= BitLen)>::Type storeBytes(uint64_t) { }
+
+    template <unsigned BitLen, unsigned ByteIndex>
+    typename EnableIf<(ByteIndex * 8U < BitLen), uint64_t>::Type loadBytes() const
+    {
+        enum { NumBits = ((BitLen - ByteIndex * 8U) < 8U) ? (BitLen - ByteIndex * 8U) : 8U };
+        return (uint64_t(loadBits<BitOffset + ByteIndex * 8U, NumBits>()) << (ByteIndex * 8U)) |
+               loadBytes<BitLen, ByteIndex + 1U>();
+    }
+
+    template <unsigned BitLen, unsigned ByteIndex>
+    typename EnableIf<(ByteIndex * 8U >= BitLen), uint64_t>::Type loadBytes() const { return 0; }
+
+    template <unsigned BitLen, typename T>
+    static typename EnableIf<static_cast<bool>(NumericTraits<T>::IsSigned) && (BitLen < 64)>::Type
+    fixTwosComplement(uint64_t& value)
+    {
+        if ((value & (uint64_t(1) << (BitLen - 1U))) != 0)
+        {
+            value |= ~((uint64_t(1) << BitLen) - 1U);
+        }
+    }
+
+    template <unsigned BitLen, typename T>
+    static typename EnableIf<!static_cast<bool>(NumericTraits<T>::IsSigned) || (BitLen >= 64)>::Type
+    fixTwosComplement(uint64_t&) { }
+
+public:
+    explicit FixedLayoutCodec(uint8_t* image)
+        : image_(image)
+    {
+        UAVCAN_ASSERT(image_ != UAVCAN_NULLPTR);
+    }
+
+    /**
+     * Same semantics as in @ref ScalarCodec. These never fail; the stream is accessed later.
+     */
+    template <unsigned BitLen, typename T>
+    int encode(const T value)
+    {
+        StaticAssert<((sizeof(T) * 8) >= BitLen)>::check();
+        StaticAssert<(BitLen <= 64)>::check();
+        storeBytes<BitLen, 0>(uint64_t(value));
+        return BitStream::ResultOk;
+    }
+
+    template <unsigned BitLen, typename T>
+    int decode(T& value)
+    {
+        StaticAssert<((sizeof(T) * 8) >= BitLen)>::check();
+        StaticAssert<(BitLen <= 64)>::check();
+        uint64_t raw = loadBytes<BitLen, 0>();
+        fixTwosComplement<BitLen, T>(raw);
+        value = static_cast<T>(raw);
+        return BitStream::ResultOk;
+    }
+};
+
+/**
+ * Decodes one primitive field located at the given constant bit offset straight from the serialized representation,
+ * reading only the bytes that the field occupies. This is used by the lazy views generated by the DSDL compiler.
+ * Returns negative error code, zero if the buffer is too short, or positive on success.
+ */
+template <typename FieldType, unsigned BitOffset>
+int decodeFixedLayoutField(const ITransferBuffer& buffer, typename StorageType<FieldType>::Type& out_value)
+{
+    StaticAssert<FieldType::IsPrimitive>::check();
+    enum { NumBytes = BitLenToByteLen<(BitOffset % 8U) + FieldType::BitLen>::Result };
+
+    uint8_t image[NumBytes] = {};
+    const int res = buffer.read(BitOffset / 8U, image, NumBytes);
+    if (res < 0)
+    {
+        return res;
+    }
+    if (static_cast<unsigned>(res) < NumBytes)
+    {
+        return BitStream::ResultOutOfBuffer;
+    }
+
+    FixedLayoutCodec<BitOffset % 8U> codec(image);
+    return FieldType::decode(out_value, codec, TailArrayOptDisabled);
+}
+
+/**
+ * Same as above, but decodes from a contiguous piece of the serialized representation, e.g. the payload of the first
+ * frame of a transfer (not including the transfer CRC), before the transfer is reassembled.
+ */
+template <typename FieldType, unsigned BitOffset>
+int decodeFixedLayoutField(const uint8_t* data, unsigned len, typename StorageType<FieldType>::Type& out_value)
+{
+    StaticAssert<FieldType::IsPrimitive>::check();
+    enum { NumBytes = BitLenToByteLen<(BitOffset % 8U) + FieldType::BitLen>::Result };
+
+    if (data == UAVCAN_NULLPTR)
+    {
+        return -ErrInvalidParam;
+    }
+    if (len < (BitOffset / 8U + NumBytes))
+    {
+        return BitStream::ResultOutOfBuffer;
+    }
+
+    uint8_t image[NumBytes] = {};
+    (void)copy(data + BitOffset / 8U, data + BitOffset / 8U + NumBytes, image);
+
+    FixedLayoutCodec<BitOffset % 8U> codec(image);
+    return FieldType::decode(out_value, codec, TailArrayOptDisabled);
+}
+
+/**
+ * Counterpart of the above: overwrites one primitive field located at the given constant bit offset in a contiguous
+ * serialized representation, leaving the neighbouring bits intact. This allows to update a message that has been
+ * encoded once without encoding it again, see @ref Publisher::PreparedMessage.
+ * Returns negative error code, zero if the buffer is too short, or positive on success.
+ */
+template <typename FieldType, unsigned BitOffset>
+int encodeFixedLayoutField(uint8_t* data, unsigned len, const typename StorageType<FieldType>::Type& value)
+{
+    StaticAssert<FieldType::IsPrimitive>::check();
+    enum { NumBytes = BitLenToByteLen<(BitOffset % 8U) + FieldType::BitLen>::Result };
+
+    if (data == UAVCAN_NULLPTR)
+    {
+        return -ErrInvalidParam;
+    }
+    if (len < (BitOffset / 8U + NumBytes))
+    {
+        return BitStream::ResultOutOfBuffer;
+    }
+
+    uint8_t image[NumBytes] = {};
+    uint8_t mask[NumBytes] = {};
+    {
+        FixedLayoutCodec<BitOffset % 8U> codec(image);
+        const int res = FieldType::encode(value, codec, TailArrayOptDisabled);
+        if (res <= 0)
+        {
+            return res;
+        }
+    }
+    {
+        FixedLayoutCodec<BitOffset % 8U> codec(mask);
+        (void)codec.template encode<FieldType::BitLen>(~uint64_t(0));
+    }
+
+    uint8_t* const dest = data + BitOffset / 8U;
+    for (unsigned i = 0; i < NumBytes; i++)
+    {
+        dest[i] = uint8_t((dest[i] & ~mask[i]) | image[i]);
+    }
+    return BitStream::ResultOk;
+}
+
+}
+
+#endif // UAVCAN_MARSHAL_FIXED_LAYOUT_CODEC_HPP_INCLUDED
@@ -12,6 +12,7 @@
 #include <uavcan/build_config.hpp>
 #include <uavcan/marshal/type_util.hpp>
 #include <uavcan/marshal/integer_spec.hpp>
+#include <uavcan/marshal/scalar_codec.hpp>
 
 #ifndef UAVCAN_CPP_VERSION
 # error UAVCAN_CPP_VERSION
@@ -56,6 +57,13 @@ class UAVCAN_EXPORT IEEE754Converter
     }
 
 public:
+    /**
+     * Converts arrays of float16 values, the results are the same as of @ref toIeee<16>() and @ref toNative<16>().
+     * These are vectorized if UAVCAN_FLOAT16_CONVERSION_INTRINSICS is enabled.
+     */
+    static void nativeIeeeArrayToHalf(const float* src, uint16_t* dst, unsigned count);
+    static void halfArrayToNativeIeee(const uint16_t* src, float* dst, unsigned count);
+
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
     /// UAVCAN requires rounding to nearest for all float conversions
     static std::float_round_style roundstyle() { return std::round_to_nearest; }
@@ -129,6 +137,8 @@ template <> struct IEEE754Limits<64>
 template <unsigned BitLen_, CastMode CastMode>
 class UAVCAN_EXPORT FloatSpec : public IEEE754Limits<BitLen_>
 {
+    template <typename> friend struct BulkArrayCodec;
+
     FloatSpec();
 
 public:
@@ -151,7 +161,8 @@ public:
     static std::float_round_style roundstyle() { return IEEE754Converter::roundstyle(); }
 #endif
 
-    static int encode(StorageType value, ScalarCodec& codec, TailArrayOptimizationMode)
+    template <typename Codec>
+    static int encode(StorageType value, Codec& codec, TailArrayOptimizationMode)
     {
         // cppcheck-suppress duplicateExpression
         if (CastMode == CastModeSaturate)
@@ -162,13 +173,14 @@ public:
         {
             truncate(value);
         }
-        return codec.encode<BitLen>(IEEE754Converter::toIeee<BitLen>(value));
+        return codec.template encode<BitLen>(IEEE754Converter::toIeee<BitLen>(value));
     }
 
-    static int decode(StorageType& out_value, ScalarCodec& codec, TailArrayOptimizationMode)
+    template <typename Codec>
+    static int decode(StorageType& out_value, Codec& codec, TailArrayOptimizationMode)
     {
         typename IntegerSpec<BitLen, SignednessUnsigned, CastModeTruncate>::StorageType ieee = 0;
-        const int res = codec.decode<BitLen>(ieee);
+        const int res = codec.template decode<BitLen>(ieee);
         if (res <= 0)
         {
             return res;
@@ -177,6 +189,8 @@ public:
         return res;
     }
 
+    static unsigned computeEncodedBitLen(StorageType, TailArrayOptimizationMode) { return BitLen; }
+
     static void extendDataTypeSignature(DataTypeSignature&) { }
 
 private:
@@ -220,6 +234,88 @@ private:
 };
 
 
+/**
+ * Arrays of float16 are converted in chunks by @ref IEEE754Converter and then written or read as one bit array.
+ */
+template <CastMode CastMode>
+struct UAVCAN_EXPORT BulkArrayCodec<FloatSpec<16, CastMode> >
+{
+    typedef FloatSpec<16, CastMode> Spec;
+    typedef typename Spec::StorageType StorageType;
+
+    enum { IsSupported = 1 };
+    enum { ChunkSize = 16 };
+
+    static int encode(const StorageType* values, unsigned count, ScalarCodec& codec)
+    {
+        while (count > 0)
+        {
+            const unsigned chunk = min(count, unsigned(ChunkSize));
+
+            StorageType native[ChunkSize];
+            for (unsigned i = 0; i < chunk; i++)
+            {
+                native[i] = values[i];
+                // cppcheck-suppress duplicateExpression
+                if (CastMode == CastModeSaturate)
+                {
+                    Spec::saturate(native[i]);
+                }
+                else
+                {
+                    Spec::truncate(native[i]);
+                }
+            }
+
+            uint16_t halfs[ChunkSize];
+            IEEE754Converter::nativeIeeeArrayToHalf(native, halfs, chunk);
+
+            uint8_t bytes[ChunkSize * 2];
+            for (unsigned i = 0; i < chunk; i++)            // Little endian, same as ScalarCodec
+            {
+                bytes[i * 2U]      = uint8_t(halfs[i] & 0xFFU);
+                bytes[i * 2U + 1U] = uint8_t(halfs[i] >> 8);
+            }
+
+            const int res = codec.encodeBitArray(bytes, chunk * 16U);
+            if (res <= 0)
+            {
+                return res;
+            }
+            values += chunk;
+            count -= chunk;
+        }
+        return 1;
+    }
+
+    static int decode(StorageType* values, unsigned count, ScalarCodec& codec)
+    {
+        while (count > 0)
+        {
+            const unsigned chunk = min(count, unsigned(ChunkSize));
+
+            uint8_t bytes[ChunkSize * 2];
+            const int res = codec.decodeBitArray(bytes, chunk * 16U);
+            if (res <= 0)
+            {
+                return res;
+            }
+
+            uint16_t halfs[ChunkSize];
+            for (unsigned i = 0; i < chunk; i++)
+            {
+                halfs[i] = uint16_t(bytes[i * 2U] | (unsigned(bytes[i * 2U + 1U]) << 8));
+            }
+            IEEE754Converter::halfArrayToNativeIeee(halfs, values, chunk);
+
+            values += chunk;
+            count -= chunk;
+        }
+        return 1;
+    }
+};
+
+
 template <unsigned BitLen, CastMode CastMode>
 class UAVCAN_EXPORT YamlStreamer<FloatSpec<BitLen, CastMode> >
 {
@@ -233,6 +329,24 @@ public:
     }
 };
 
+template <unsigned BitLen, CastMode CastMode>
+class UAVCAN_EXPORT JsonStreamer<FloatSpec<BitLen, CastMode> >
+{
+    typedef typename FloatSpec<BitLen, CastMode>::StorageType StorageType;
+
+public:
+    /**
+     * Enough significant digits to restore the exact value.
+     */
+    enum { NumSignificantDigits = (BitLen <= 16) ? 5 : ((BitLen <= 32) ? 9 : 17) };
+
+    template <typename Stream>  // cppcheck-suppress passedByValue
+    static void stream(Stream& s, const StorageType value)
+    {
+        s.writeReal(double(value), NumSignificantDigits);
+    }
+};
+
 }
 
 #endif // UAVCAN_MARSHAL_FLOAT_SPEC_HPP_INCLUDED
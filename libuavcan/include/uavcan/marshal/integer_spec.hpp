@@ -107,7 +107,8 @@ public:
     static StorageType min() { return IsSigned ? StorageType(-max() - 1) : 0; }
     static UnsignedStorageType mask() { return Limits::mask(); }
 
-    static int encode(StorageType value, ScalarCodec& codec, TailArrayOptimizationMode)
+    template <typename Codec>
+    static int encode(StorageType value, Codec& codec, TailArrayOptimizationMode)
     {
         validate();
         // cppcheck-suppress duplicateExpression
@@ -119,15 +120,18 @@ public:
         {
             truncate(value);
         }
-        return codec.encode<BitLen>(value);
+        return codec.template encode<BitLen>(value);
     }
 
-    static int decode(StorageType& out_value, ScalarCodec& codec, TailArrayOptimizationMode)
+    template <typename Codec>
+    static int decode(StorageType& out_value, Codec& codec, TailArrayOptimizationMode)
     {
         validate();
-        return codec.decode<BitLen>(out_value);
+        return codec.template decode<BitLen>(out_value);
     }
 
+    static unsigned computeEncodedBitLen(StorageType, TailArrayOptimizationMode) { return BitLen; }
+
     static void extendDataTypeSignature(DataTypeSignature&) { }
 };
 
@@ -155,16 +159,20 @@ public:
     static StorageType min() { return false; }
     static UnsignedStorageType mask() { return true; }
 
-    static int encode(StorageType value, ScalarCodec& codec, TailArrayOptimizationMode)
+    template <typename Codec>
+    static int encode(StorageType value, Codec& codec, TailArrayOptimizationMode)
     {
-        return codec.encode<BitLen>(value);
+        return codec.template encode<BitLen>(value);
     }
 
-    static int decode(StorageType& out_value, ScalarCodec& codec, TailArrayOptimizationMode)
+    template <typename Codec>
+    static int decode(StorageType& out_value, Codec& codec, TailArrayOptimizationMode)
     {
-        return codec.decode<BitLen>(out_value);
+        return codec.template decode<BitLen>(out_value);
     }
 
+    static unsigned computeEncodedBitLen(StorageType, TailArrayOptimizationMode) { return BitLen; }
+
     static void extendDataTypeSignature(DataTypeSignature&) { }
 };
 
@@ -188,6 +196,175 @@ struct IsIntegerSpec<IntegerSpec<BitLen, Signedness, CastMode> >
 };
 
 
+/**
+ * Arrays of bytes are written and read as they are, since 8-bit values fill the storage type completely and the cast
+ * modes have no effect. The stream copies the whole array at once at any bit offset.
+ */
+template <Signedness Signedness, CastMode CastMode>
+struct UAVCAN_EXPORT BulkArrayCodec<IntegerSpec<8, Signedness, CastMode> >
+{
+    typedef typename IntegerSpec<8, Signedness, CastMode>::StorageType StorageType;
+
+    enum { IsSupported = 1 };
+
+    static int encode(const StorageType* values, unsigned count, ScalarCodec& codec)
+    {
+        StaticAssert<sizeof(StorageType) == 1>::check();
+        return codec.encodeBitArray(reinterpret_cast<const uint8_t*>(values), count * 8U);
+    }
+
+    static int decode(StorageType* values, unsigned count, ScalarCodec& codec)
+    {
+        StaticAssert<sizeof(StorageType) == 1>::check();
+        return codec.decodeBitArray(reinterpret_cast<uint8_t*>(values), count * 8U);
+    }
+};
+
+/**
+ * Arrays of integers of other bit lengths are packed into a temporary bit array, which is then written or read in
+ * one go. The elements are shifted through an accumulator of one machine word (two words for the lengths above
+ * 24 bits), so that several elements are processed per word instead of one stream operation per element.
+ * Booleans and 64-bit integers are coded element by element.
+ */
+template <unsigned BitLen_, Signedness Signedness, CastMode CastMode, bool Enabled = ((BitLen_ > 1) && (BitLen_ <= 32))>
+struct UAVCAN_EXPORT PackedIntegerArrayCodec
+{
+    enum { IsSupported = 0 };
+};
+
+template <unsigned BitLen_, Signedness Signedness, CastMode CastMode>
+struct UAVCAN_EXPORT PackedIntegerArrayCodec<BitLen_, Signedness, CastMode, true>
+{
+    typedef IntegerSpec<BitLen_, Signedness, CastMode> Spec;
+    typedef typename Spec::StorageType StorageType;
+    typedef typename Spec::UnsignedStorageType UnsignedStorageType;
+    typedef typename Select<(Spec::BitLen <= 24), uint32_t, uint64_t>::Result Accumulator;
+
+    enum { IsSupported = 1 };
+    enum { BitLen = Spec::BitLen };
+
+private:
+    static Accumulator mask(unsigned bitlen) { return Accumulator((Accumulator(1) << bitlen) - 1U); }
+
+    /**
+     * The stream order of a scalar is its little endian bytes, with the bits of the last incomplete byte written
+     * starting from the most significant one, see @ref ScalarCodec. Returns the value whose bits, most significant
+     * first, are in the stream order.
+     */
+    static Accumulator toStreamOrder(const Accumulator value)
+    {
+        Accumulator out = 0;
+        unsigned i = 0;
+        for (; (i + 8U) <= unsigned(BitLen); i += 8U)
+        {
+            out = Accumulator(Accumulator(out << 8) | ((value >> i) & 0xFFU));
+        }
+        if (i < unsigned(BitLen))
+        {
+            out = Accumulator(Accumulator(out << (unsigned(BitLen) - i)) | (value >> i));
+        }
+        return out;
+    }
+
+    static Accumulator fromStreamOrder(const Accumulator stream_order)
+    {
+        Accumulator out = 0;
+        unsigned i = 0;
+        for (; (i + 8U) <= unsigned(BitLen); i += 8U)
+        {
+            out = Accumulator(out | (((stream_order >> (unsigned(BitLen) - i - 8U)) & 0xFFU) << i));
+        }
+        if (i < unsigned(BitLen))
+        {
+            out = Accumulator(out | ((stream_order & mask(unsigned(BitLen) - i)) << i));
+        }
+        return out;
+    }
+
+    static StorageType castValue(StorageType value)
+    {
+        // cppcheck-suppress duplicateExpression
+        if (CastMode == CastModeSaturate)
+        {
+            if (value > Spec::max())
+            {
+                value = Spec::max();
+            }
+            else if (value <= Spec::min()) // 'Less or Equal' allows to suppress compiler warning on unsigned types
+            {
+                value = Spec::min();
+            }
+            else
+            {
+                ; // Valid range
+            }
+        }
+        return value;                   // Truncation is done by masking
+    }
+
+public:
+    static int encode(const StorageType* values, const unsigned count, ScalarCodec& codec)
+    {
+        UAVCAN_ASSERT((count * unsigned(BitLen)) <= BitStream::MaxBitsPerRW);
+        uint8_t bytes[BitStream::MaxBitsPerRW / 8];
+        unsigned num_bytes = 0;
+        Accumulator acc = 0;
+        unsigned acc_bitlen = 0;
+        for (unsigned i = 0; i < count; i++)
+        {
+            const Accumulator raw = Accumulator(UnsignedStorageType(castValue(values[i]))) & mask(BitLen);
+            acc = Accumulator(Accumulator(acc << unsigned(BitLen)) | toStreamOrder(raw));
+            acc_bitlen += unsigned(BitLen);
+            while (acc_bitlen >= 8U)
+            {
+                acc_bitlen -= 8U;
+                bytes[num_bytes++] = uint8_t(acc >> acc_bitlen);
+            }
+        }
+        if (acc_bitlen > 0)
+        {
+            bytes[num_bytes] = uint8_t(acc << (8U - acc_bitlen));
+        }
+        return codec.encodeBitArray(bytes, count * unsigned(BitLen));
+    }
+
+    static int decode(StorageType* values, const unsigned count, ScalarCodec& codec)
+    {
+        UAVCAN_ASSERT((count * unsigned(BitLen)) <= BitStream::MaxBitsPerRW);
+        uint8_t bytes[BitStream::MaxBitsPerRW / 8];
+        const int res = codec.decodeBitArray(bytes, count * unsigned(BitLen));
+        if (res <= 0)
+        {
+            return res;
+        }
+        const uint8_t* next_byte = bytes;
+        Accumulator acc = 0;
+        unsigned acc_bitlen = 0;
+        for (unsigned i = 0; i < count; i++)
+        {
+            while (acc_bitlen < unsigned(BitLen))
+            {
+                acc = Accumulator(Accumulator(acc << 8) | *next_byte++);
+                acc_bitlen += 8U;
+            }
+            acc_bitlen -= unsigned(BitLen);
+            Accumulator raw = fromStreamOrder(Accumulator(acc >> acc_bitlen) & mask(BitLen));
+            if (Spec::IsSigned && ((raw >> (unsigned(BitLen) - 1U)) != 0))
+            {
+                raw = Accumulator(raw | ~mask(BitLen));       // Sign extension
+            }
+            values[i] = StorageType(UnsignedStorageType(raw));
+        }
+        return res;
+    }
+};
+
+template <unsigned BitLen, Signedness Signedness, CastMode CastMode>
+struct UAVCAN_EXPORT BulkArrayCodec<IntegerSpec<BitLen, Signedness, CastMode> >
+    : public PackedIntegerArrayCodec<BitLen, Signedness, CastMode>
+{ };
+
+
 template <unsigned BitLen, Signedness Signedness, CastMode CastMode>
 class UAVCAN_EXPORT YamlStreamer<IntegerSpec<BitLen, Signedness, CastMode> >
 {
@@ -205,6 +382,26 @@ public:
     }
 };
 
+template <unsigned BitLen, Signedness Signedness, CastMode CastMode>
+class UAVCAN_EXPORT JsonStreamer<IntegerSpec<BitLen, Signedness, CastMode> >
+{
+    typedef IntegerSpec<BitLen, Signedness, CastMode> RawType;
+    typedef typename RawType::StorageType StorageType;
+
+    template <typename Stream>
+    static void streamImpl(Stream& s, const StorageType value, TrueType) { s.writeSigned(int64_t(value)); }
+
+    template <typename Stream>
+    static void streamImpl(Stream& s, const StorageType value, FalseType) { s.writeUnsigned(uint64_t(value)); }
+
+public:
+    template <typename Stream>  // cppcheck-suppress passedByValue
+    static void stream(Stream& s, const StorageType value)
+    {
+        streamImpl(s, value, BooleanType<RawType::IsSigned>());
+    }
+};
+
 }
 
 #endif // UAVCAN_MARSHAL_INTEGER_SPEC_HPP_INCLUDED
@@ -6,6 +6,7 @@
 #define UAVCAN_MARSHAL_SCALAR_CODEC_HPP_INCLUDED
 
 #include <cassert>
+#include <cstring>
 #include <uavcan/std.hpp>
 #include <uavcan/build_config.hpp>
 #include <uavcan/util/templates.hpp>
@@ -23,11 +24,45 @@ class UAVCAN_EXPORT ScalarCodec
 
     static void swapByteOrder(uint8_t* bytes, unsigned len);
 
+    /*
+     * The standard widths are swapped as one word; the compiler reduces these to a single instruction.
+     */
+    template <unsigned Size>
+    static void swapByteOrder(uint8_t (&bytes)[Size]) { swapByteOrder(bytes, Size); }
+
+#if __GNUC__
+    static void swapByteOrder(uint8_t (&bytes)[2])
+    {
+        uint16_t x = 0;
+        (void)std::memcpy(&x, bytes, sizeof(x));
+        x = __builtin_bswap16(x);
+        (void)std::memcpy(bytes, &x, sizeof(x));
+    }
+
+    static void swapByteOrder(uint8_t (&bytes)[4])
+    {
+        uint32_t x = 0;
+        (void)std::memcpy(&x, bytes, sizeof(x));
+        x = __builtin_bswap32(x);
+        (void)std::memcpy(bytes, &x, sizeof(x));
+    }
+
+    static void swapByteOrder(uint8_t (&bytes)[8])
+    {
+        uint64_t x = 0;
+        (void)std::memcpy(&x, bytes, sizeof(x));
+        x = __builtin_bswap64(x);
+        (void)std::memcpy(bytes, &x, sizeof(x));
+    }
+#endif
+
     template <unsigned BitLen, unsigned Size>
     static typename EnableIf<(BitLen > 8)>::Type
     convertByteOrder(uint8_t (&bytes)[Size])
     {
-#if defined(BYTE_ORDER) && defined(BIG_ENDIAN)
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__)
+        static const bool big_endian = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;    // Known at compile time
+#elif defined(BYTE_ORDER) && defined(BIG_ENDIAN)
         static const bool big_endian = BYTE_ORDER == BIG_ENDIAN;
 #else
         union { long int l; char c[sizeof(long int)]; } u;
@@ -41,7 +76,7 @@ class UAVCAN_EXPORT ScalarCodec
         UAVCAN_ASSERT(big_endian == false);
         if (big_endian)
         {
-            swapByteOrder(bytes, Size);
+            swapByteOrder(bytes);
         }
     }
 
@@ -54,10 +89,11 @@ class UAVCAN_EXPORT ScalarCodec
     fixTwosComplement(T& value)
     {
         StaticAssert<NumericTraits<T>::IsInteger>::check(); // Not applicable to floating point types
-        if (value & (T(1) << (BitLen - 1)))                        // The most significant bit is set --> negative
-        {
-            value |= T(T(0xFFFFFFFFFFFFFFFFULL) & ~((T(1) << BitLen) - 1));
-        }
+        // Branch-free: flipping the sign bit and subtracting it back propagates it into the upper bits, which are
+        // zero after decoding. Done on the unsigned type to avoid the overflow.
+        typedef typename Select<(sizeof(T) <= 4), uint32_t, uint64_t>::Result Unsigned;
+        const Unsigned sign_bit = Unsigned(1) << (BitLen - 1);
+        value = T((Unsigned(value) ^ sign_bit) - sign_bit);
     }
 
     template <unsigned BitLen, typename T>
@@ -68,7 +104,8 @@ class UAVCAN_EXPORT ScalarCodec
     static typename EnableIf<((sizeof(T) * 8) > BitLen)>::Type
     clearExtraBits(T& value)
     {
-        value &= (T(1) << BitLen) - 1;  // Signedness doesn't matter
+        typedef typename Select<(sizeof(T) <= 4), uint32_t, uint64_t>::Result Unsigned;
+        value = T(Unsigned(value) & ((Unsigned(1) << BitLen) - 1U));   // Signedness doesn't matter
     }
 
     template <unsigned BitLen, typename T>
@@ -96,6 +133,21 @@ public:
 
     template <unsigned BitLen, typename T>
     int decode(T& value);
+
+    /**
+     * Writes or reads a bit array of arbitrary length, e.g. a prepacked image of a data structure
+     * (see @ref FixedLayoutCodec). Bits are ordered in the same way as in @ref BitStream.
+     * Return values are the same as for the scalars.
+     */
+    int encodeBitArray(const uint8_t* bytes, unsigned bitlen);
+    int decodeBitArray(uint8_t* bytes, unsigned bitlen);
+
+    /**
+     * Run-time counterparts of @ref encode() and @ref decode() for unsigned values of 1 to 64 bits; these are used by
+     * the table-driven codec (see @ref TableCodec). The value is not sign-extended when decoded.
+     */
+    int encodeBits(uint64_t value, unsigned bitlen);
+    int decodeBits(uint64_t& out_value, unsigned bitlen);
 };
 
 // ----------------------------------------------------------------------------
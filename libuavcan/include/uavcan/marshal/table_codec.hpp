@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_MARSHAL_TABLE_CODEC_HPP_INCLUDED
+#define UAVCAN_MARSHAL_TABLE_CODEC_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/marshal/scalar_codec.hpp>
+#include <uavcan/marshal/type_util.hpp>
+
+namespace uavcan
+{
+/**
+ * Encoding and decoding routines of a field that the table-driven codec can't handle by itself,
+ * i.e. arrays and nested types. There is one instance per field type, see @ref TableCodecFieldOps.
+ */
+struct UAVCAN_EXPORT TableCodecOps
+{
+    int (*encode)(const void* field, ScalarCodec& codec, TailArrayOptimizationMode tao_mode);
+    int (*decode)(void* field, ScalarCodec& codec, TailArrayOptimizationMode tao_mode);
+    unsigned (*computeEncodedBitLen)(const void* field, TailArrayOptimizationMode tao_mode);
+};
+
+/**
+ * One entry of the field descriptor table generated by the DSDL compiler when the compact codec is selected.
+ * The entries are plain aggregates, so the tables are placed in ROM.
+ */
+struct UAVCAN_EXPORT TableCodecField
+{
+    enum Kind
+    {
+        KindVoid,           ///< Padding; has no storage
+        KindBool,
+        KindUnsigned,
+        KindSigned,
+        KindFloat,
+        KindOther           ///< Handled by the ops
+    };
+
+    uint8_t kind;
+    uint8_t bitlen;         ///< Not used with KindOther
+    uint8_t saturate;       ///< Cast mode of the primitive types; truncation otherwise
+    const TableCodecOps* ops;
+};
+
+/**
+ * Out of line codec routines of a field type that is not a primitive; generated code refers to the instance.
+ * The functions are instantiated once per field type, regardless of how many data types contain such a field.
+ */
+template <typename FieldType>
+struct UAVCAN_EXPORT TableCodecFieldOps
+{
+    typedef typename StorageType<FieldType>::Type FieldStorageType;
+
+    static int encode(const void* field, ScalarCodec& codec, TailArrayOptimizationMode tao_mode)
+    {
+        return FieldType::encode(*static_cast<const FieldStorageType*>(field), codec, tao_mode);
+    }
+
+    static int decode(void* field, ScalarCodec& codec, TailArrayOptimizationMode tao_mode)
+    {
+        return FieldType::decode(*static_cast<FieldStorageType*>(field), codec, tao_mode);
+    }
+
+    static unsigned computeEncodedBitLen(const void* field, TailArrayOptimizationMode tao_mode)
+    {
+        return FieldType::computeEncodedBitLen(*static_cast<const FieldStorageType*>(field), tao_mode);
+    }
+
+    static const TableCodecOps Instance;
+};
+
+template <typename FieldType>
+const TableCodecOps TableCodecFieldOps<FieldType>::Instance =
+{
+    &TableCodecFieldOps<FieldType>::encode,
+    &TableCodecFieldOps<FieldType>::decode,
+    &TableCodecFieldOps<FieldType>::computeEncodedBitLen
+};
+
+/**
+ * Table-driven codec. The DSDL compiler can be told to emit a compact field descriptor table instead of the inlined
+ * per-field codec calls (option --table-codec), so that all such data types share a single out of line
+ * interpreter loop. This trades some speed for a much smaller code footprint, which matters on microcontrollers
+ * where hundreds of data types are linked in and the code doesn't fit into the instruction cache. The types that
+ * are on the hot path can be left on the inline codec (option --inline-codec).
+ *
+ * The fields are passed as an array of pointers, one per non-void entry of the table, in the order of declaration.
+ * The tail array optimization mode applies to the last field only, as in the inline codec.
+ */
+class UAVCAN_EXPORT TableCodec
+{
+    TableCodec();
+
+public:
+    static int encode(const TableCodecField* table, unsigned table_len, const void* const* fields,
+                      ScalarCodec& codec, TailArrayOptimizationMode tao_mode);
+
+    static int decode(const TableCodecField* table, unsigned table_len, void* const* fields,
+                      ScalarCodec& codec, TailArrayOptimizationMode tao_mode);
+
+    static unsigned computeEncodedBitLen(const TableCodecField* table, unsigned table_len,
+                                         const void* const* fields, TailArrayOptimizationMode tao_mode);
+};
+
+}
+
+#endif // UAVCAN_MARSHAL_TABLE_CODEC_HPP_INCLUDED
@@ -77,12 +77,28 @@ public:
     enum { Result = sizeof(test<T>(0)) == sizeof(Yes) };
 };
 
+/**
+ * Compile-time: Codec that encodes or decodes a whole array of elements of the given type in one go.
+ * The default does not exist, arrays fall back to per-element coding; see the specializations.
+ */
+template <typename T>
+struct UAVCAN_EXPORT BulkArrayCodec
+{
+    enum { IsSupported = 0 };
+};
+
 /**
  * Streams a given value into YAML string. Please see the specializations.
  */
 template <typename T>
 class UAVCAN_EXPORT YamlStreamer;
 
+/**
+ * Streams a given value into compact JSON, see @ref JsonWriter. Please see the specializations.
+ */
+template <typename T>
+class UAVCAN_EXPORT JsonStreamer;
+
 }
 
 #endif // UAVCAN_MARSHAL_TYPE_UTIL_HPP_INCLUDED
@@ -7,6 +7,8 @@
 
 #include <uavcan/marshal/integer_spec.hpp>
 #include <uavcan/marshal/float_spec.hpp>
+#include <uavcan/marshal/fixed_layout_codec.hpp>
+#include <uavcan/marshal/table_codec.hpp>
 #include <uavcan/marshal/array.hpp>
 #include <uavcan/marshal/type_util.hpp>
 
@@ -8,6 +8,7 @@
 #include <uavcan/build_config.hpp>
 #include <uavcan/dynamic_memory.hpp>
 #include <uavcan/node/scheduler.hpp>
+#include <uavcan/util/bump_arena.hpp>
 
 namespace uavcan
 {
@@ -19,7 +20,9 @@ namespace uavcan
 class UAVCAN_EXPORT INode
 {
     bool canfd_ = false;
+    bool canfd_negotiation_ = false;
     bool tao_disabled_ = false;
+    BumpArena* decode_arena_ = UAVCAN_NULLPTR;
 public:
     virtual ~INode() { }
     virtual IPoolAllocator& getAllocator() = 0;
@@ -64,7 +67,7 @@ public:
      */
     int spin(MonotonicTime deadline)
     {
-        getScheduler().getDispatcher().set_options(tao_disabled_, canfd_);
+        getScheduler().getDispatcher().set_options(tao_disabled_, canfd_, canfd_negotiation_);
         return getScheduler().spin(deadline);
     }
 
@@ -76,10 +79,20 @@ public:
      */
     int spin(MonotonicDuration duration)
     {
-        getScheduler().getDispatcher().set_options(tao_disabled_, canfd_);
+        getScheduler().getDispatcher().set_options(tao_disabled_, canfd_, canfd_negotiation_);
         return getScheduler().spin(getMonotonicTime() + duration);
     }
 
+    /**
+     * Same as @ref spin(MonotonicTime), but the work is done in slices limited by the budget.
+     * Refer to @ref Scheduler::spin(MonotonicTime, const SpinBudget&) for details.
+     */
+    int spin(MonotonicTime deadline, const SpinBudget& budget)
+    {
+        getScheduler().getDispatcher().set_options(tao_disabled_, canfd_, canfd_negotiation_);
+        return getScheduler().spin(deadline, budget);
+    }
+
     /**
      * This method is designed for non-blocking applications.
      * Instead of blocking, it returns immediately once all available CAN frames and timer events are processed.
@@ -89,10 +102,20 @@ public:
      */
     int spinOnce()
     {
-        getScheduler().getDispatcher().set_options(tao_disabled_, canfd_);
+        getScheduler().getDispatcher().set_options(tao_disabled_, canfd_, canfd_negotiation_);
         return getScheduler().spinOnce();
     }
 
+    /**
+     * Non-blocking entry point for the applications that run the node from their own event loop.
+     * Refer to @ref Scheduler::getNextDeadline() for details.
+     */
+    int processReady(MonotonicTime& out_next_deadline)
+    {
+        getScheduler().getDispatcher().set_options(tao_disabled_, canfd_, canfd_negotiation_);
+        return getScheduler().processReady(out_next_deadline);
+    }
+
     /**
      * This method allows to directly transmit a raw CAN frame circumventing the whole UAVCAN stack.
      * Mandatory parameters:
@@ -160,6 +183,27 @@ public:
      */
     void disableCanFd()          { canfd_ = false; }
 
+    /**
+     * @brief Enable CAN FD for service transfers to the nodes that support it
+     *
+     * Meant for networks where classic CAN nodes coexist with CAN FD ones, so that CAN FD can't be enabled for
+     * all transfers. Messages and the service transfers to the other nodes keep using classic frames.
+     * The driver must support CAN FD. Refer to @ref Dispatcher::shouldUseCanFd() for details.
+     */
+    void enableCanFdNegotiation()       { canfd_negotiation_ = true; }
+    void disableCanFdNegotiation()      { canfd_negotiation_ = false; }
+    bool isCanFdNegotiationEnabled()    { return canfd_negotiation_; }
+
+    /**
+     * Received data structures are decoded into the temporary storage right before the subscription callback is
+     * invoked. By default this storage is allocated on the stack, which may take a few KB for large types.
+     * If a decode arena is installed, the structures are placed into the arena instead, and the memory is returned
+     * to it once the callback returns; the stack is used only if the arena has not enough space left.
+     * The arena must not be shared with other nodes that are spinning concurrently. Pass null to remove it.
+     */
+    void setDecodeArena(BumpArena* arena) { decode_arena_ = arena; }
+    BumpArena* getDecodeArena() const     { return decode_arena_; }
+
 #if !UAVCAN_TINY
     /**
      * The @ref IRxFrameListener interface allows one to monitor all incoming CAN frames.
@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_ASYNC_SERVICE_CLIENT_HPP_INCLUDED
+#define UAVCAN_NODE_ASYNC_SERVICE_CLIENT_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/node/service_client.hpp>
+#include <uavcan/util/linked_list.hpp>
+#include <uavcan/util/method_binder.hpp>
+
+#if UAVCAN_COROUTINES
+# include <coroutine>
+#endif
+
+namespace uavcan
+{
+
+template <typename DataType_> class UAVCAN_EXPORT AsyncServiceClientBase;
+
+/**
+ * Handle of a single service call made via @ref AsyncServiceClient.
+ * The handle keeps a copy of the response, so that the application can check the outcome of the call whenever
+ * convenient instead of handling it in a callback, e.g. by spinning the node until @ref isReady() returns true.
+ *
+ * If @ref UAVCAN_COROUTINES is enabled, the handle is also awaitable: co_await suspends the coroutine until the call
+ * completes, and the coroutine is resumed from within the node's spin() call when the response arrives or the call
+ * times out. The result of co_await is true if the call was successful.
+ *
+ * Destroying the handle or starting a new call with it cancels the pending call, if any. A coroutine awaiting
+ * a cancelled call will not be resumed.
+ */
+template <typename DataType_>
+class UAVCAN_EXPORT ServiceCallFuture : public LinkedListNode<ServiceCallFuture<DataType_> >
+{
+    friend class AsyncServiceClientBase<DataType_>;
+
+public:
+    typedef DataType_ DataType;
+    typedef typename DataType::Response ResponseType;
+
+    enum Status { Idle, Pending, Success, ErrorTimeout };
+
+private:
+    AsyncServiceClientBase<DataType>* owner_;   ///< Non-null while pending
+    ServiceCallID call_id_;
+    Status status_;
+    ResponseType response_;
+#if UAVCAN_COROUTINES
+    std::coroutine_handle<> waiter_;
+#endif
+
+    void complete(const ServiceCallResult<DataType>& result);
+
+public:
+    ServiceCallFuture()
+        : owner_(UAVCAN_NULLPTR)
+        , status_(Idle)
+    { }
+
+    ~ServiceCallFuture() { cancel(); }
+
+    /**
+     * Cancels the call if it is pending; the handle becomes idle.
+     */
+    void cancel();
+
+    Status getStatus() const { return status_; }
+
+    bool isPending() const { return status_ == Pending; }
+    bool isReady() const { return (status_ == Success) || (status_ == ErrorTimeout); }
+    bool isSuccessful() const { return status_ == Success; }
+
+    /**
+     * Invalid unless a call has been made with this handle.
+     */
+    ServiceCallID getCallID() const { return call_id_; }
+
+    /**
+     * Value is undefined unless the call was successful.
+     */
+    const ResponseType& getResponse() const { return response_; }
+    ResponseType& getResponse() { return response_; }
+
+#if UAVCAN_COROUTINES
+    bool await_ready() const { return !isPending(); }
+    void await_suspend(std::coroutine_handle<> waiter) { waiter_ = waiter; }
+    bool await_resume() const { return isSuccessful(); }
+#endif
+};
+
+/**
+ * Do not use directly.
+ * Keeps track of the pending @ref ServiceCallFuture objects of a client.
+ */
+template <typename DataType_>
+class UAVCAN_EXPORT AsyncServiceClientBase : Noncopyable
+{
+    friend class ServiceCallFuture<DataType_>;
+
+    typedef ServiceCallFuture<DataType_> Future;
+
+    LinkedListRoot<Future> pending_;
+
+    virtual void cancelCall(ServiceCallID call_id) = 0;
+
+protected:
+    AsyncServiceClientBase() { }
+
+    virtual ~AsyncServiceClientBase() { UAVCAN_ASSERT(pending_.isEmpty()); }
+
+    void addFuture(Future& future, ServiceCallID call_id);
+
+    void handleCallResult(const ServiceCallResult<DataType_>& result);
+
+    /**
+     * Must be called by the derived class destructor, while the call states still exist.
+     */
+    void cancelAllFutures();
+};
+
+/**
+ * Use this class to invoke services on remote nodes when the callback based interface of @ref ServiceClient
+ * leads to deeply nested state machines. Every call is represented with a @ref ServiceCallFuture handle owned by
+ * the application; any number of calls can be kept in flight, limited only by the underlying @ref ServiceClient.
+ *
+ * A call completes the same way as with @ref ServiceClient, i.e. it either succeeds or times out. The completion
+ * is processed within the node's spin() call, no extra thread is needed.
+ *
+ * @tparam DataType_        Service data type.
+ *
+ * @tparam NumStaticCalls_  Refer to @ref ServiceClient.
+ */
+template <typename DataType_, unsigned NumStaticCalls_ = 0>
+class UAVCAN_EXPORT AsyncServiceClient : public AsyncServiceClientBase<DataType_>
+{
+public:
+    typedef DataType_ DataType;
+    typedef typename DataType::Request RequestType;
+    typedef ServiceCallFuture<DataType> Future;
+
+private:
+    typedef AsyncServiceClient<DataType, NumStaticCalls_> SelfType;
+    typedef AsyncServiceClientBase<DataType> Base;
+
+    void handleResult(const ServiceCallResult<DataType>& result) { Base::handleCallResult(result); }
+
+public:
+    typedef MethodBinder<SelfType*, void (SelfType::*)(const ServiceCallResult<DataType>&)> Callback;
+    typedef ServiceClient<DataType, Callback, NumStaticCalls_> ServiceClientType;
+
+private:
+    ServiceClientType client_;
+
+    virtual void cancelCall(ServiceCallID call_id) override { client_.cancelCall(call_id); }
+
+public:
+    explicit AsyncServiceClient(INode& node, bool force_std_can = false)
+        : client_(node, Callback(this, &SelfType::handleResult), force_std_can)
+    { }
+
+    virtual ~AsyncServiceClient() { Base::cancelAllFutures(); }
+
+    /**
+     * Refer to @ref ServiceClient::init().
+     */
+    int init() { return client_.init(); }
+    int init(TransferPriority priority) { return client_.init(priority); }
+
+    /**
+     * Performs non-blocking service call; the outcome will be delivered into the future.
+     * If the future refers to a pending call, that call will be cancelled.
+     * Returns negative error code; the future is left idle in this case.
+     */
+    int call(NodeID server_node_id, const RequestType& request, Future& out_future)
+    {
+        out_future.cancel();
+        ServiceCallID call_id;
+        const int res = client_.call(server_node_id, request, call_id);
+        if (res >= 0)
+        {
+            Base::addFuture(out_future, call_id);
+        }
+        return res;
+    }
+
+    /**
+     * Gives access to the timeout, priority and pending call counters of the underlying client.
+     * Its callback must not be changed.
+     */
+    ServiceClientType& getServiceClient() { return client_; }
+    const ServiceClientType& getServiceClient() const { return client_; }
+};
+
+// ----------------------------------------------------------------------------
+
+/*
+ * ServiceCallFuture<>
+ */
+template <typename DataType_>
+void ServiceCallFuture<DataType_>::complete(const ServiceCallResult<DataType>& result)
+{
+    UAVCAN_ASSERT(status_ == Pending);
+    owner_ = UAVCAN_NULLPTR;
+    if (result.isSuccessful())
+    {
+        response_ = result.getResponse();
+        status_ = Success;
+    }
+    else
+    {
+        status_ = ErrorTimeout;
+    }
+#if UAVCAN_COROUTINES
+    if (waiter_)
+    {
+        const std::coroutine_handle<> waiter = waiter_;
+        waiter_ = std::coroutine_handle<>();
+        waiter.resume();                // The coroutine may destroy this object, so this goes last
+    }
+#endif
+}
+
+template <typename DataType_>
+void ServiceCallFuture<DataType_>::cancel()
+{
+    if (owner_ != UAVCAN_NULLPTR)
+    {
+        owner_->pending_.remove(this);
+        owner_->cancelCall(call_id_);
+        owner_ = UAVCAN_NULLPTR;
+    }
+    status_ = Idle;
+#if UAVCAN_COROUTINES
+    waiter_ = std::coroutine_handle<>();
+#endif
+}
+
+/*
+ * AsyncServiceClientBase<>
+ */
+template <typename DataType_>
+void AsyncServiceClientBase<DataType_>::addFuture(Future& future, ServiceCallID call_id)
+{
+    UAVCAN_ASSERT(future.owner_ == UAVCAN_NULLPTR);
+    future.owner_ = this;
+    future.call_id_ = call_id;
+    future.status_ = Future::Pending;
+    pending_.insert(&future);
+}
+
+template <typename DataType_>
+void AsyncServiceClientBase<DataType_>::handleCallResult(const ServiceCallResult<DataType_>& result)
+{
+    Future* p = pending_.get();
+    while (p != UAVCAN_NULLPTR)
+    {
+        if (p->call_id_ == result.getCallID())
+        {
+            pending_.remove(p);
+            p->complete(result);
+            return;
+        }
+        p = p->getNextListNode();
+    }
+    UAVCAN_TRACE("AsyncServiceClient", "No future for the call nid=%d tid=%d",
+                 int(result.getCallID().server_node_id.get()), int(result.getCallID().transfer_id.get()));
+}
+
+template <typename DataType_>
+void AsyncServiceClientBase<DataType_>::cancelAllFutures()
+{
+    while (Future* const p = pending_.get())
+    {
+        p->cancel();
+    }
+}
+
+}
+
+#endif // UAVCAN_NODE_ASYNC_SERVICE_CLIENT_HPP_INCLUDED
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_BATCH_SUBSCRIBER_HPP_INCLUDED
+#define UAVCAN_NODE_BATCH_SUBSCRIBER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/node/generic_subscriber.hpp>
+#include <uavcan/node/scheduler.hpp>
+#include <uavcan/util/lazy_constructor.hpp>
+
+#if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
+# error UAVCAN_CPP_VERSION
+#endif
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+# include <functional>
+# include <uavcan/util/inplace_function.hpp>
+#endif
+
+namespace uavcan
+{
+/**
+ * A contiguous sequence of received messages, oldest first, that is passed to the callback of
+ * @ref BatchSubscriber. The messages are valid only until the callback returns.
+ */
+template <typename DataType_>
+class UAVCAN_EXPORT ReceivedDataBatch : Noncopyable
+{
+    ReceivedDataStructure<DataType_>* const* const items_;
+    const unsigned size_;
+
+public:
+    typedef DataType_ DataType;
+
+    ReceivedDataBatch(ReceivedDataStructure<DataType>* const* items, unsigned size)
+        : items_(items)
+        , size_(size)
+    { }
+
+    unsigned getSize() const { return size_; }
+    bool isEmpty() const { return size_ == 0; }
+
+    const ReceivedDataStructure<DataType>& operator[](unsigned index) const
+    {
+        UAVCAN_ASSERT(index < size_);
+        return *items_[index];
+    }
+};
+
+/**
+ * Use this class to subscribe to a high rate message, e.g. the statuses of a set of actuators. Instead of invoking
+ * the callback once per message, the received messages are accumulated and passed to the callback together, as
+ * soon as the ongoing spin iteration has processed the received frames. This way the per-message overhead of the
+ * callback is avoided, and the application can process the whole batch at once, e.g. taking its locks only once.
+ *
+ * The messages are stored in the object itself, so no dynamic memory is needed. If more messages are received
+ * within one spin iteration than the batch can hold, the full batch is delivered right away from the reception
+ * path and a new one is started.
+ *
+ * @tparam DataType_        Message data type.
+ *
+ * @tparam BatchSize_       Maximum number of messages per batch.
+ *
+ * @tparam Callback_        Type of the callback that will be used to deliver the batches into the application.
+ *                          The argument type is const ReceivedDataBatch<DataType_>&.
+ *                          In C++11 mode this type defaults to @ref DefaultCallback<>.
+ *                          In C++03 mode this type defaults to a plain function pointer; use binder to
+ *                          call member functions as callbacks.
+ *
+ * @tparam TransferListener_    Refer to @ref Subscriber.
+ */
+template <typename DataType_,
+          unsigned BatchSize_,
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+          typename Callback_ = DefaultCallback<void (const ReceivedDataBatch<DataType_>&)>,
+#else
+          typename Callback_ = void (*)(const ReceivedDataBatch<DataType_>&),
+#endif
+          typename TransferListener_ = TransferListener
+          >
+class UAVCAN_EXPORT BatchSubscriber
+    : public GenericSubscriber<DataType_, DataType_, TransferListener_>
+{
+public:
+    typedef Callback_ Callback;
+    typedef DataType_ DataType;
+
+    enum { BatchSize = BatchSize_ };
+
+private:
+    typedef GenericSubscriber<DataType_, DataType_, TransferListener_> BaseType;
+    typedef BatchSubscriber<DataType_, BatchSize_, Callback_, TransferListener_> SelfType;
+    typedef typename BaseType::ReceivedDataStructureSpec ReceivedDataStructureSpec;
+
+    struct Entry : Noncopyable
+    {
+        StoredIncomingTransfer transfer;
+        ReceivedDataStructureSpec msg;
+
+        explicit Entry(const ReceivedDataStructure<DataType>& source)
+            : transfer(source)
+            , msg(&transfer)
+        {
+            static_cast<DataType&>(msg) = source;
+        }
+    };
+
+    class DeliveryHandler : public DeadlineHandler
+    {
+        SelfType& owner_;
+
+        virtual void handleDeadline(MonotonicTime) override { (void)owner_.flush(); }
+
+    public:
+        DeliveryHandler(SelfType& owner, Scheduler& scheduler)
+            : DeadlineHandler(scheduler)
+            , owner_(owner)
+        { }
+    };
+
+    LazyConstructor<Entry> entries_[BatchSize_];
+    ReceivedDataStructure<DataType>* items_[BatchSize_];
+    unsigned num_items_;
+    Callback callback_;
+    DeliveryHandler delivery_handler_;
+
+    void discard();
+
+    virtual void handleReceivedDataStruct(ReceivedDataStructure<DataType>& msg) override;
+
+public:
+    explicit BatchSubscriber(INode& node)
+        : BaseType(node)
+        , num_items_(0)
+        , callback_()
+        , delivery_handler_(*this, node.getScheduler())
+    {
+        StaticAssert<DataTypeKind(DataType::DataTypeKind) == DataTypeKindMessage>::check();
+        StaticAssert<(BatchSize_ > 0)>::check();
+    }
+
+    virtual ~BatchSubscriber()
+    {
+        BaseType::stop();
+        discard();
+    }
+
+    /**
+     * Begin receiving messages.
+     * The messages will be passed to the application via the callback in batches.
+     * Returns negative error code.
+     */
+    int start(const Callback& callback)
+    {
+        BaseType::stop();
+
+        if (!coerceOrFallback<bool>(callback, true))
+        {
+            UAVCAN_TRACE("BatchSubscriber", "Invalid callback");
+            return -ErrInvalidParam;
+        }
+        callback_ = callback;
+
+        return BaseType::startAsMessageListener();
+    }
+
+    /**
+     * Passes the accumulated messages to the callback immediately, without waiting for the end of the spin
+     * iteration. Does nothing if there are no messages.
+     * Returns the number of messages delivered.
+     */
+    unsigned flush();
+
+    /**
+     * Number of messages that have been received but not delivered yet.
+     */
+    unsigned getNumPendingMessages() const { return num_items_; }
+
+    using BaseType::allowAnonymousTransfers;
+    using BaseType::stop;
+    using BaseType::getFailureCount;
+    using BaseType::reservePoolBlocks;
+};
+
+// ----------------------------------------------------------------------------
+
+template <typename DataType_, unsigned BatchSize_, typename Callback_, typename TransferListener_>
+void BatchSubscriber<DataType_, BatchSize_, Callback_, TransferListener_>::discard()
+{
+    for (unsigned i = 0; i < num_items_; i++)
+    {
+        entries_[i].destroy();
+    }
+    num_items_ = 0;
+    delivery_handler_.stop();
+}
+
+template <typename DataType_, unsigned BatchSize_, typename Callback_, typename TransferListener_>
+void BatchSubscriber<DataType_, BatchSize_, Callback_, TransferListener_>::
+handleReceivedDataStruct(ReceivedDataStructure<DataType>& msg)
+{
+    if (num_items_ >= BatchSize_)
+    {
+        UAVCAN_TRACE("BatchSubscriber", "Batch full [%s]", DataType::getDataTypeFullName());
+        (void)flush();
+    }
+
+    entries_[num_items_].template construct<const ReceivedDataStructure<DataType>&>(msg);
+    items_[num_items_] = &entries_[num_items_]->msg;
+    num_items_++;
+
+    if (!delivery_handler_.isRunning())
+    {
+        delivery_handler_.generateDeadlineImmediately();
+    }
+}
+
+template <typename DataType_, unsigned BatchSize_, typename Callback_, typename TransferListener_>
+unsigned BatchSubscriber<DataType_, BatchSize_, Callback_, TransferListener_>::flush()
+{
+    const unsigned num_delivered = num_items_;
+    if (num_delivered > 0)
+    {
+        const ReceivedDataBatch<DataType> batch(items_, num_delivered);
+        if (coerceOrFallback<bool>(callback_, true))
+        {
+            callback_(batch);
+        }
+        else
+        {
+            handleFatalError("BatchSub clbk");
+        }
+    }
+    discard();
+    return num_delivered;
+}
+
+}
+
+#endif // UAVCAN_NODE_BATCH_SUBSCRIBER_HPP_INCLUDED
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_EXECUTOR_HPP_INCLUDED
+#define UAVCAN_NODE_EXECUTOR_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/util/templates.hpp>
+#include <uavcan/util/linked_list.hpp>
+
+namespace uavcan
+{
+/**
+ * Work that is done off the node thread by an @ref IExecutor, e.g. file IO or fsync() of a storage backend, and
+ * then completed in the node thread. The task is posted with @ref Scheduler::post(); once @ref execute() has
+ * returned, @ref handleCompletion() is invoked from Scheduler::spin(), where the library can be used again.
+ *
+ * The task object is owned by the component that posts it, so the executors never allocate memory per task.
+ * It must not be destroyed or posted again while it is pending.
+ */
+class UAVCAN_EXPORT ExecutorTask : public DoublyLinkedListNode<ExecutorTask>
+{
+    friend class Scheduler;
+
+    bool pending_;
+
+protected:
+    ExecutorTask()
+        : pending_(false)
+    { }
+
+    virtual ~ExecutorTask() { UAVCAN_ASSERT(!pending_); }
+
+public:
+    /**
+     * Invoked by the executor, possibly from another thread; must not use the library.
+     */
+    virtual void execute() = 0;
+
+    /**
+     * Invoked from the node thread after @ref execute() has returned. The task may be posted again from here.
+     */
+    virtual void handleCompletion() = 0;
+
+    /**
+     * True from the moment the task is posted until @ref handleCompletion() is invoked.
+     */
+    bool isPending() const { return pending_; }
+};
+
+/**
+ * Runs the tasks of @ref Scheduler::post(). The executor is only called from the node thread; it hands the
+ * executed tasks back with @ref popCompleted(), which the scheduler polls once per iteration of spin().
+ * See @ref InlineExecutor for the simplest implementation; the POSIX driver provides a thread pool.
+ */
+class UAVCAN_EXPORT IExecutor
+{
+public:
+    virtual ~IExecutor() { }
+
+    /**
+     * Queues the task for execution. Returns negative error code.
+     */
+    virtual int post(ExecutorTask& task) = 0;
+
+    /**
+     * Returns a task whose @ref ExecutorTask::execute() has returned, or null if there are none.
+     * The tasks may be returned in any order.
+     */
+    virtual ExecutorTask* popCompleted() = 0;
+};
+
+/**
+ * Executes the tasks right away in the node thread, which is the only option on bare metal. The completions are
+ * still deferred until the next iteration of spin(), so the components don't depend on the executor in use.
+ * This is the default executor of @ref Scheduler.
+ */
+class UAVCAN_EXPORT InlineExecutor : public IExecutor, Noncopyable
+{
+    DoublyLinkedListRoot<ExecutorTask> completed_;
+
+public:
+    virtual int post(ExecutorTask& task) override
+    {
+        task.execute();
+        completed_.pushBack(&task);
+        return 0;
+    }
+
+    virtual ExecutorTask* popCompleted() override
+    {
+        ExecutorTask* const task = completed_.get();
+        completed_.remove(task);
+        return task;
+    }
+};
+
+}
+
+#endif // UAVCAN_NODE_EXECUTOR_HPP_INCLUDED
@@ -22,15 +22,34 @@ class GenericPublisherBase : Noncopyable
 {
     TransferSender sender_;
     MonotonicDuration tx_timeout_;
+    MonotonicDuration min_publication_interval_;
+    MonotonicDuration max_silence_interval_;
+    MonotonicTime last_publication_ts_;
+    uint64_t last_payload_hash_;
     INode& node_;
+    uint16_t num_reserved_tx_blocks_;
+    uint8_t max_bus_load_percent_;
     bool force_std_can_;
+    bool last_payload_hash_valid_;
+
+    uint64_t computePayloadHash(const StaticTransferBufferImpl& buffer, TransferType transfer_type,
+                                NodeID dst_node_id) const;
+
+    bool isUnchanged(uint64_t payload_hash) const;
+
+    void registerPublication(int send_result, uint64_t payload_hash);
+
 protected:
     GenericPublisherBase(INode& node, bool force_std_can, MonotonicDuration tx_timeout,
                          MonotonicDuration max_transfer_interval)
         : sender_(node.getDispatcher(), max_transfer_interval)
         , tx_timeout_(tx_timeout)
+        , last_payload_hash_(0)
         , node_(node)
+        , num_reserved_tx_blocks_(0)
+        , max_bus_load_percent_(0)
         , force_std_can_(force_std_can)
+        , last_payload_hash_valid_(false)
     {
         setTxTimeout(tx_timeout);
 #if UAVCAN_DEBUG
@@ -38,7 +57,7 @@ protected:
 #endif
     }
 
-    ~GenericPublisherBase() { }
+    ~GenericPublisherBase() { (void)reserveTxQueueMemory(0); }
 
     bool isInited() const;
 
@@ -48,9 +67,34 @@ protected:
 
     MonotonicTime getTxDeadline() const;
 
+    /**
+     * True if the previous publication was too recent, see @ref setMinPublicationInterval(), or if the bus is
+     * too busy, see @ref setMaxBusLoad().
+     */
+    bool isRateLimited() const;
+
+    /**
+     * Transfer buffer located in the data field of a CAN frame, so that single frame transfers can be encoded
+     * straight into the frame, see @ref TransferSender::sendInPlace().
+     */
+    class FrameTransferBuffer : public StaticTransferBufferImpl
+    {
+        CanFrame frame_;
+
+    public:
+        enum { Size = CanFrame::MaxDataLen - 1U };      // The last byte is taken by the tail byte
+
+        FrameTransferBuffer() : StaticTransferBufferImpl(frame_.data, Size) { }
+
+        CanFrame& getFrame() { return frame_; }
+    };
+
     int genericPublish(const StaticTransferBufferImpl& buffer, TransferType transfer_type,
                        NodeID dst_node_id, TransferID* tid, MonotonicTime blocking_deadline);
 
+    int genericPublish(FrameTransferBuffer& buffer, TransferType transfer_type,
+                       NodeID dst_node_id, TransferID* tid, MonotonicTime blocking_deadline);
+
     TransferSender& getTransferSender() { return sender_; }
     const TransferSender& getTransferSender() const { return sender_; }
 
@@ -76,6 +120,56 @@ public:
     TransferPriority getPriority() const { return sender_.getPriority(); }
     void setPriority(const TransferPriority prio) { sender_.setPriority(prio); }
 
+    /**
+     * Latest value wins: a new publication drops the frames of the previous ones that are still waiting in the
+     * TX queues, so that the queues never fill up with stale copies when the publisher is invoked faster than
+     * the bus can drain. Useful for estimator outputs and alike, where only the latest sample matters.
+     * Disabled by default. Refer to @ref TransferSender::setCoalescing() for details.
+     */
+    bool isCoalescing() const { return sender_.isCoalescing(); }
+    void setCoalescing(bool enable) { sender_.setCoalescing(enable); }
+
+    /**
+     * Publications that come sooner than this interval after the previous one are skipped: nothing is sent and
+     * zero is returned. Zero, which is the default, disables the rate limit.
+     */
+    MonotonicDuration getMinPublicationInterval() const { return min_publication_interval_; }
+    void setMinPublicationInterval(MonotonicDuration interval) { min_publication_interval_ = interval; }
+
+    /**
+     * Publications are skipped the same way while the estimated load of any bus is at or above this limit, in
+     * percent; see @ref CanIOManager::getBusLoadPercent(). Meant for bulk or low-priority data that should give
+     * way to the control traffic. Zero, which is the default, disables the limit.
+     */
+    uint8_t getMaxBusLoad() const { return max_bus_load_percent_; }
+    void setMaxBusLoad(uint8_t percent) { max_bus_load_percent_ = percent; }
+
+    /**
+     * Change-only publishing: a publication whose encoded payload is identical to the last one sent is skipped
+     * the same way, unless the last publication is this old, so that the subscribers keep receiving the message
+     * at this interval at least. Zero, which is the default, disables the suppression; infinite never repeats
+     * an unchanged message. The interval should be shorter than any timeout the subscribers apply to the topic.
+     * The message is still encoded on every publication, but the transfer CRC and the CAN frames are saved.
+     * The payloads are compared by their CRC-64, which can't miss a change confined to 64 adjacent bits.
+     * Publications with an explicitly specified Transfer ID are never suppressed.
+     */
+    MonotonicDuration getMaxSilenceInterval() const { return max_silence_interval_; }
+    void setMaxSilenceInterval(MonotonicDuration interval)
+    {
+        max_silence_interval_ = interval;
+        last_payload_hash_valid_ = false;
+    }
+
+    /**
+     * Sets aside the given number of TX queue memory blocks (one block per frame) on every interface, so that
+     * the frames of this publisher can be queued even if the memory of the TX queues has been used up by other
+     * traffic. Publishers that have not reserved any memory can't use these blocks. Zero cancels the reservation.
+     * The memory is released when the publisher is destroyed.
+     * Returns negative error code; on failure, the previous reservation stays in effect.
+     */
+    int reserveTxQueueMemory(uint16_t num_blocks);
+    uint16_t getNumReservedTxQueueBlocks() const { return num_reserved_tx_blocks_; }
+
     INode& getNode() const { return node_; }
 };
 
@@ -96,6 +190,17 @@ class UAVCAN_EXPORT GenericPublisher : public GenericPublisherBase
                             ZeroTransferBuffer,
                             StaticTransferBuffer<BitLenToByteLen<DataStruct::MaxBitLen>::Result> >::Result Buffer;
 
+    /*
+     * Messages that fit one CAN frame are encoded straight into the frame instead of the worst-case buffer;
+     * the encoded length is known in advance from DataStruct::computeEncodedBitLen().
+     */
+    enum { SmallBufferSize = FrameTransferBuffer::Size };
+    enum { MaxBufferSize = BitLenToByteLen<DataStruct::MaxBitLen>::Result };
+
+    typedef typename Select<(unsigned(MaxBufferSize) > unsigned(SmallBufferSize)),
+                            FrameTransferBuffer,
+                            Buffer>::Result SmallBuffer;
+
     enum
     {
         Qos = (DataTypeKind(DataSpec::DataTypeKind) == DataTypeKindMessage) ?
@@ -104,12 +209,35 @@ class UAVCAN_EXPORT GenericPublisher : public GenericPublisherBase
 
     int checkInit();
 
-    int doEncode(const DataStruct& message, ITransferBuffer& buffer) const;
+    int doEncode(const DataStruct& message, StaticTransferBufferImpl& buffer) const;
+
+    template <typename BufferType>
+#if __GNUC__
+    __attribute__ ((noinline))      // Keeps the stack frames of the two buffer types apart
+#endif
+    int encodeAndPublish(const DataStruct& message, TransferType transfer_type, NodeID dst_node_id,
+                         TransferID* tid, MonotonicTime blocking_deadline);
 
     int genericPublish(const DataStruct& message, TransferType transfer_type, NodeID dst_node_id,
                        TransferID* tid, MonotonicTime blocking_deadline);
 
+    int publishEncodedImpl(const Buffer& buffer, TransferType transfer_type, NodeID dst_node_id,
+                           TransferID* tid, MonotonicTime blocking_deadline)
+    {
+        UAVCAN_ASSERT(isInited());
+        if (isRateLimited())
+        {
+            return 0;
+        }
+        return GenericPublisherBase::genericPublish(buffer, transfer_type, dst_node_id, tid, blocking_deadline);
+    }
+
 public:
+    /**
+     * Storage of an encoded message, see @ref encode().
+     */
+    typedef Buffer EncodedBuffer;
+
     /**
      * @param max_transfer_interval     Maximum expected time interval between subsequent publications. Leave default.
      */
@@ -149,6 +277,36 @@ public:
     {
         return genericPublish(message, transfer_type, dst_node_id, &tid, blocking_deadline);
     }
+
+    /**
+     * Tail array optimization mode the messages of this publisher are encoded with.
+     */
+    TailArrayOptimizationMode getTaoMode() const;
+
+    /**
+     * Encodes the message once, so that it can be sent to several destinations with @ref publishEncoded()
+     * without being serialized again for each of them.
+     * Returns negative error code.
+     */
+    int encode(const DataStruct& message, EncodedBuffer& out_buffer);
+
+    /**
+     * Sends a message that has been encoded with @ref encode() by this publisher.
+     */
+    int publishEncoded(const EncodedBuffer& buffer, TransferType transfer_type, NodeID dst_node_id, TransferID tid,
+                       MonotonicTime blocking_deadline = MonotonicTime())
+    {
+        return publishEncodedImpl(buffer, transfer_type, dst_node_id, &tid, blocking_deadline);
+    }
+
+    /**
+     * Same as above, the Transfer ID is allocated automatically.
+     */
+    int publishEncoded(const EncodedBuffer& buffer, TransferType transfer_type, NodeID dst_node_id,
+                       MonotonicTime blocking_deadline = MonotonicTime())
+    {
+        return publishEncodedImpl(buffer, transfer_type, dst_node_id, UAVCAN_NULLPTR, blocking_deadline);
+    }
 };
 
 // ----------------------------------------------------------------------------
@@ -164,13 +322,20 @@ int GenericPublisher<DataSpec, DataStruct>::checkInit()
 }
 
 template <typename DataSpec, typename DataStruct>
-int GenericPublisher<DataSpec, DataStruct>::doEncode(const DataStruct& message, ITransferBuffer& buffer) const
+TailArrayOptimizationMode GenericPublisher<DataSpec, DataStruct>::getTaoMode() const
+{
+    // if doing canfd transfer tail array optimisation is disabled
+    return (!isStdOnly() && (getNode().isTaoDisabled() || getNode().isCanFdEnabled())) ?
+           TailArrayOptDisabled : TailArrayOptEnabled;
+}
+
+template <typename DataSpec, typename DataStruct>
+int GenericPublisher<DataSpec, DataStruct>::doEncode(const DataStruct& message,
+                                                     StaticTransferBufferImpl& buffer) const
 {
     BitStream bitstream(buffer);
     ScalarCodec codec(bitstream);
-    // if doing canfd transfer tail array optimisation is disabled
-    TailArrayOptimizationMode tao_mode = (!isStdOnly() && (getNode().isTaoDisabled() || getNode().isCanFdEnabled())) ? TailArrayOptDisabled:TailArrayOptEnabled;
-    const int encode_res = DataStruct::encode(message, codec, tao_mode);
+    const int encode_res = DataStruct::encode(message, codec, getTaoMode());
     if (encode_res <= 0)
     {
         UAVCAN_ASSERT(0);   // Impossible, internal error
@@ -179,6 +344,24 @@ int GenericPublisher<DataSpec, DataStruct>::doEncode(const DataStruct& message,
     return encode_res;
 }
 
+template <typename DataSpec, typename DataStruct>
+template <typename BufferType>
+int GenericPublisher<DataSpec, DataStruct>::encodeAndPublish(const DataStruct& message, TransferType transfer_type,
+                                                             NodeID dst_node_id, TransferID* tid,
+                                                             MonotonicTime blocking_deadline)
+{
+    BufferType buffer;
+
+    const int encode_res = doEncode(message, buffer);
+    if (encode_res < 0)
+    {
+        return encode_res;
+    }
+    UAVCAN_ASSERT(buffer.getMaxWritePos() == (DataStruct::computeEncodedBitLen(message, getTaoMode()) + 7U) / 8U);
+
+    return GenericPublisherBase::genericPublish(buffer, transfer_type, dst_node_id, tid, blocking_deadline);
+}
+
 template <typename DataSpec, typename DataStruct>
 int GenericPublisher<DataSpec, DataStruct>::genericPublish(const DataStruct& message, TransferType transfer_type,
                                                            NodeID dst_node_id, TransferID* tid,
@@ -189,16 +372,29 @@ int GenericPublisher<DataSpec, DataStruct>::genericPublish(const DataStruct& mes
     {
         return res;
     }
+    if (isRateLimited())
+    {
+        return 0;                       // Checked before encoding, which is the expensive part
+    }
 
-    Buffer buffer;
-
-    const int encode_res = doEncode(message, buffer);
-    if (encode_res < 0)
+    const unsigned encoded_len = (DataStruct::computeEncodedBitLen(message, getTaoMode()) + 7U) / 8U;
+    if (encoded_len <= unsigned(SmallBufferSize))
     {
-        return encode_res;
+        return encodeAndPublish<SmallBuffer>(message, transfer_type, dst_node_id, tid, blocking_deadline);
     }
+    return encodeAndPublish<Buffer>(message, transfer_type, dst_node_id, tid, blocking_deadline);
+}
 
-    return GenericPublisherBase::genericPublish(buffer, transfer_type, dst_node_id, tid, blocking_deadline);
+template <typename DataSpec, typename DataStruct>
+int GenericPublisher<DataSpec, DataStruct>::encode(const DataStruct& message, EncodedBuffer& out_buffer)
+{
+    const int res = checkInit();
+    if (res < 0)
+    {
+        return res;
+    }
+    out_buffer.reset();
+    return doEncode(message, out_buffer);
 }
 
 }
@@ -11,7 +11,9 @@
 #include <uavcan/node/global_data_type_registry.hpp>
 #include <uavcan/util/templates.hpp>
 #include <uavcan/util/lazy_constructor.hpp>
+#include <uavcan/util/placement_new.hpp>
 #include <uavcan/debug.hpp>
+#include <uavcan/trace.hpp>
 #include <uavcan/transport/transfer_listener.hpp>
 #include <uavcan/marshal/scalar_codec.hpp>
 #include <uavcan/marshal/types.hpp>
@@ -94,16 +96,47 @@ static Stream& operator<<(Stream& s, const ReceivedDataStructure<DataType>& rds)
 }
 
 
+/**
+ * Internal.
+ * Keeps the transport layer information of a received transfer after the transfer itself is gone, so that
+ * a message can be delivered as @ref ReceivedDataStructure<> later on. The payload cannot be read.
+ */
+class UAVCAN_EXPORT StoredIncomingTransfer : public IncomingTransfer
+{
+    const bool anonymous_;
+
+public:
+    template <typename DataType>
+    explicit StoredIncomingTransfer(const ReceivedDataStructure<DataType>& rds)
+        : IncomingTransfer(rds.getMonotonicTimestamp(), rds.getUtcTimestamp(), rds.getPriority(),
+                           rds.getTransferType(), rds.getTransferID(), rds.getSrcNodeID(), rds.getIfaceIndex(),
+                           rds.isCanFDTransfer(), rds.isTaoDisabled())
+        , anonymous_(rds.isAnonymousTransfer())
+    { }
+
+    virtual int read(unsigned, uint8_t*, unsigned) const override { return -ErrLogic; }
+    virtual bool isAnonymousTransfer() const override { return anonymous_; }
+};
+
+
 class GenericSubscriberBase : Noncopyable
 {
 protected:
     INode& node_;
     uint32_t failure_count_;
+#if UAVCAN_HANDLER_PROFILING
+    HandlerProfile handler_profile_;
+#endif
 
-    explicit GenericSubscriberBase(INode& node)
+    GenericSubscriberBase(INode& node, const char* name)
         : node_(node)
         , failure_count_(0)
-    { }
+#if UAVCAN_HANDLER_PROFILING
+        , handler_profile_(node.getScheduler().getHandlerProfiler(), HandlerProfile::KindSubscriber, name)
+#endif
+    {
+        (void)name;
+    }
 
     ~GenericSubscriberBase() { }
 
@@ -120,11 +153,24 @@ public:
     uint32_t getFailureCount() const { return failure_count_; }
 
     INode& getNode() const { return node_; }
+
+#if UAVCAN_HANDLER_PROFILING
+    /**
+     * Execution statistics of the callback, see @ref HandlerProfiler.
+     */
+    HandlerProfile& getHandlerProfile() { return handler_profile_; }
+    const HandlerProfile& getHandlerProfile() const { return handler_profile_; }
+#endif
 };
 
 /**
- * Please note that the reference passed to the RX callback points to a stack-allocated object, which means
- * that it gets invalidated shortly after the callback returns.
+ * Please note that the reference passed to the RX callback points to a temporary object, which is allocated either
+ * on the stack or in the decode arena of the node (see @ref INode::setDecodeArena()). It gets invalidated shortly
+ * after the callback returns.
+ *
+ * Message subscribers of the same type can be started in the shared mode, see @ref startAsSharedMessageListener().
+ * Such subscribers form a group where only the first one (the leader) registers its transfer listener; each
+ * transfer is reassembled and decoded once by the leader and then passed to every subscriber of the group.
  */
 template <typename DataSpec, typename DataStruct, typename TransferListenerType>
 class UAVCAN_EXPORT GenericSubscriber : public GenericSubscriberBase
@@ -141,6 +187,11 @@ class UAVCAN_EXPORT GenericSubscriber : public GenericSubscriberBase
             obj_.handleIncomingTransfer(transfer);
         }
 
+        const void* getSharingKey() const override
+        {
+            return obj_.shared_ ? getSharingKeyOfThisType() : UAVCAN_NULLPTR;
+        }
+
     public:
         TransferForwarder(SelfType& obj,
                           const DataTypeDescriptor& data_type,
@@ -152,14 +203,51 @@ class UAVCAN_EXPORT GenericSubscriber : public GenericSubscriberBase
                                  allocator),
             obj_(obj)
         { }
+
+        static const void* getSharingKeyOfThisType()
+        {
+            static const char key = 0;
+            return &key;
+        }
+
+        SelfType& getOwner() const { return obj_; }
+    };
+
+    /**
+     * Tracks the delivery of a transfer to a shared group, so that the subscribers can stop or be destroyed from
+     * their callbacks.
+     */
+    struct SharedDelivery
+    {
+        SelfType* leader;       ///< Null if all subscribers of the group are gone
+        SelfType* next;         ///< Next subscriber to deliver to
     };
 
     LazyConstructor<TransferForwarder> forwarder_;
 
+    bool shared_;
+    bool anonymous_allowed_;
+    SelfType* shared_leader_;               ///< Null unless this subscriber is a follower in a shared group
+    SelfType* shared_next_;                 ///< Next follower; the first follower if this subscriber is the leader
+    SharedDelivery* shared_delivery_;       ///< Ongoing delivery, leader only
+
     int checkInit();
 
     void handleIncomingTransfer(IncomingTransfer& transfer);
 
+#if __GNUC__
+    __attribute__ ((noinline))      // Keeps the stack frame of the fallback out of the arena path
+#endif
+    void handleIncomingTransferOnStack(IncomingTransfer& transfer);
+
+    void decodeAndHandle(IncomingTransfer& transfer, ReceivedDataStructure<DataStruct>& rx_struct);
+
+    void deliver(IncomingTransfer& transfer, ReceivedDataStructure<DataStruct>& rx_struct);
+
+    void deliverToSharedGroup(IncomingTransfer& transfer, ReceivedDataStructure<DataStruct>& rx_struct);
+
+    void leaveSharedGroup();
+
     int genericStart(bool (Dispatcher::*registration_method)(TransferListener*));
 
 protected:
@@ -172,7 +260,51 @@ protected:
         { }
     };
 
-    explicit GenericSubscriber(INode& node) : GenericSubscriberBase(node)
+    /**
+     * Places the data structure into the decode arena of the node, if there is one and it has enough space left.
+     * The structure is destroyed and the arena is rolled back when this object goes out of scope, so that nested
+     * usage is possible. If get() returns null, the caller should fall back to a stack-allocated structure.
+     */
+    class ArenaDataStructure : uavcan::Noncopyable
+    {
+        BumpArena* const arena_;
+        const BumpArena::Marker marker_;
+        ReceivedDataStructureSpec* ptr_;
+
+    public:
+        ArenaDataStructure(INode& node, const IncomingTransfer* transfer)
+            : arena_(node.getDecodeArena())
+            , marker_((arena_ == UAVCAN_NULLPTR) ? 0 : arena_->getMarker())
+            , ptr_(UAVCAN_NULLPTR)
+        {
+            void* const mem =
+                (arena_ == UAVCAN_NULLPTR) ? UAVCAN_NULLPTR : arena_->allocate(sizeof(ReceivedDataStructureSpec));
+            if (mem != UAVCAN_NULLPTR)
+            {
+                ptr_ = (transfer == UAVCAN_NULLPTR) ? new (mem) ReceivedDataStructureSpec()
+                                                    : new (mem) ReceivedDataStructureSpec(transfer);
+            }
+        }
+
+        ~ArenaDataStructure()
+        {
+            if (ptr_ != UAVCAN_NULLPTR)
+            {
+                ptr_->~ReceivedDataStructureSpec();
+                arena_->rollback(marker_);
+            }
+        }
+
+        ReceivedDataStructureSpec* get() const { return ptr_; }
+    };
+
+    explicit GenericSubscriber(INode& node)
+        : GenericSubscriberBase(node, DataSpec::getDataTypeFullName())
+        , shared_(false)
+        , anonymous_allowed_(false)
+        , shared_leader_(UAVCAN_NULLPTR)
+        , shared_next_(UAVCAN_NULLPTR)
+        , shared_delivery_(UAVCAN_NULLPTR)
     { }
 
     virtual ~GenericSubscriber() { stop(); }
@@ -185,6 +317,18 @@ protected:
         return genericStart(&Dispatcher::registerMessageListener);
     }
 
+    /**
+     * Joins the group of the subscribers of the same type that have been started this way, or becomes the leader
+     * of a new group if there is none. Only the leader of a group is registered with the dispatcher; its transfer
+     * listener and its pool block reservation serve the whole group, and the failure count of the group is
+     * accumulated by the leader. The callbacks of the group receive the same object, so they must not modify it.
+     *
+     * When the leader stops, the next subscriber of the group takes over; the transfers that are being reassembled
+     * at this moment are lost. If a subscriber is started from a callback, it may receive the message that is
+     * being delivered.
+     */
+    int startAsSharedMessageListener();
+
     int startAsServiceRequestListener()
     {
         UAVCAN_TRACE("GenericSubscriber", "Start as service request listener; dtname=%s",
@@ -205,7 +349,12 @@ protected:
      */
     void allowAnonymousTransfers()
     {
+        anonymous_allowed_ = true;
         forwarder_->allowAnonymousTransfers();
+        if (shared_leader_ != UAVCAN_NULLPTR)
+        {
+            shared_leader_->forwarder_->allowAnonymousTransfers();      // Filtered per subscriber on delivery
+        }
     }
 
     /**
@@ -215,9 +364,84 @@ protected:
     void stop()
     {
         UAVCAN_TRACE("GenericSubscriber", "Stop; dtname=%s", DataSpec::getDataTypeFullName());
+        leaveSharedGroup();
         GenericSubscriberBase::stop(forwarder_);
     }
 
+    /**
+     * Sets aside the memory pool blocks for the reception of this data type, see
+     * @ref TransferListener::reservePoolBlocks(). Can be called before or after the subscription is started.
+     * Returns negative error code.
+     */
+    int reservePoolBlocks(uint16_t num_buffer_blocks, uint16_t num_receiver_blocks)
+    {
+        const int res = checkInit();
+        if (res < 0)
+        {
+            return res;
+        }
+        return forwarder_->reservePoolBlocks(num_buffer_blocks, num_receiver_blocks);
+    }
+
+    /**
+     * Creates the receiver for the transfers from the given node in advance, see
+     * @ref TransferListener::preregisterSource(). In a shared group, the receiver belongs to the leader.
+     * Can be called before or after the subscription is started.
+     * Returns negative error code.
+     */
+    int preregisterSource(NodeID node_id, TransferType transfer_type)
+    {
+        const int res = checkInit();
+        if (res < 0)
+        {
+            return res;
+        }
+        SelfType& owner = (shared_leader_ != UAVCAN_NULLPTR) ? *shared_leader_ : *this;
+        return owner.forwarder_->preregisterSource(node_id, transfer_type);
+    }
+
+    /**
+     * Drops the transfers from the nodes that are not in the set before they are reassembled and decoded, see
+     * @ref TransferListener::setSourceNodeFilter(). An empty set accepts all nodes.
+     * The filters can't be used in the shared mode, because the listener of a shared group serves all of its
+     * subscribers. Can be called before or after the subscription is started.
+     * Returns negative error code; -ErrLogic if the subscriber is shared.
+     */
+    int setSourceNodeFilter(const NodeIDSet& sources)
+    {
+        const int res = checkInit();
+        if (res < 0)
+        {
+            return res;
+        }
+        if (shared_)
+        {
+            return -ErrLogic;
+        }
+        forwarder_->setSourceNodeFilter(sources);
+        return 0;
+    }
+
+    /**
+     * Drops the frames that the filter rejects before they are reassembled, see
+     * @ref TransferListener::setFrameFilter(). Null removes the filter. Same limitations as above.
+     * Returns negative error code; -ErrLogic if the subscriber is shared.
+     */
+    int setFrameFilter(const ITransferAcceptanceFilter* filter)
+    {
+        const int res = checkInit();
+        if (res < 0)
+        {
+            return res;
+        }
+        if (shared_)
+        {
+            return -ErrLogic;
+        }
+        forwarder_->setFrameFilter(filter);
+        return 0;
+    }
+
     TransferListenerType* getTransferListener() { return forwarder_; }
 };
 
@@ -253,13 +477,38 @@ int GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::checkInit()
 
 template <typename DataSpec, typename DataStruct, typename TransferListenerType>
 void GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::handleIncomingTransfer(IncomingTransfer& transfer)
+{
+    ArenaDataStructure arena_struct(node_, &transfer);
+    if (arena_struct.get() != UAVCAN_NULLPTR)
+    {
+        decodeAndHandle(transfer, *arena_struct.get());
+    }
+    else
+    {
+        handleIncomingTransferOnStack(transfer);
+    }
+}
+
+template <typename DataSpec, typename DataStruct, typename TransferListenerType>
+void GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::
+handleIncomingTransferOnStack(IncomingTransfer& transfer)
 {
     ReceivedDataStructureSpec rx_struct(&transfer);
+    decodeAndHandle(transfer, rx_struct);
+}
 
+template <typename DataSpec, typename DataStruct, typename TransferListenerType>
+void GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::
+decodeAndHandle(IncomingTransfer& transfer, ReceivedDataStructure<DataStruct>& rx_struct)
+{
     /*
      * Decoding into the temporary storage
+     * Single-frame transfers are decoded straight from the frame payload, short multi-frame transfers are copied
+     * into contiguous memory first
      */
-    BitStream bitstream(transfer);
+    const LinearizedIncomingTransfer<RxLinearizationBufferSize<DataStruct>::Result> payload(transfer);
+    BitStream bitstream = (payload.getData() != UAVCAN_NULLPTR) ? BitStream(payload.getData(), payload.getLength())
+                                                                : BitStream(transfer);
     ScalarCodec codec(bitstream);
 
     // disable tail array optimisation if CANFD transfer
@@ -281,7 +530,173 @@ void GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::handleIncomi
     /*
      * Invoking the callback
      */
-    handleReceivedDataStruct(rx_struct);
+    if (!shared_)
+    {
+        deliver(transfer, rx_struct);
+    }
+    else
+    {
+        deliverToSharedGroup(transfer, rx_struct);
+    }
+}
+
+template <typename DataSpec, typename DataStruct, typename TransferListenerType>
+void GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::
+deliver(IncomingTransfer& transfer, ReceivedDataStructure<DataStruct>& rx_struct)
+{
+    UAVCAN_TRACE_POINT(TraceEventSubscriberDelivery, forwarder_->getDataTypeDescriptor().getID().get(),
+                       transfer.getSrcNodeID().get(), transfer.getTransferID().get());
+    {
+#if UAVCAN_HANDLER_PROFILING
+        const HandlerProfilingScope profiling_scope(handler_profile_);
+#endif
+        handleReceivedDataStruct(rx_struct);
+    }
+    // The subscriber may be gone at this point, only the transfer is still there
+    UAVCAN_TRACE_POINT(TraceEventSubscriberDone, 0, transfer.getSrcNodeID().get(), transfer.getTransferID().get());
+    (void)transfer;
+}
+
+template <typename DataSpec, typename DataStruct, typename TransferListenerType>
+void GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::
+deliverToSharedGroup(IncomingTransfer& transfer, ReceivedDataStructure<DataStruct>& rx_struct)
+{
+    /*
+     * Any subscriber of the group may be stopped or destroyed by the callbacks, including this one, so that
+     * the iteration state is kept on the stack and fixed up by leaveSharedGroup()
+     */
+    SharedDelivery delivery;
+    delivery.leader = this;
+    delivery.next = this;
+#if __GNUC__ >= 12
+# pragma GCC diagnostic push
+# pragma GCC diagnostic ignored "-Wdangling-pointer"   // Reset by the current leader below
+#endif
+    shared_delivery_ = &delivery;
+#if __GNUC__ >= 12
+# pragma GCC diagnostic pop
+#endif
+
+    while (delivery.next != UAVCAN_NULLPTR)
+    {
+        SelfType* const sub = delivery.next;
+        delivery.next = sub->shared_next_;
+        if (!transfer.isAnonymousTransfer() || sub->anonymous_allowed_)
+        {
+            sub->deliver(transfer, rx_struct);
+        }
+    }
+
+    if (delivery.leader != UAVCAN_NULLPTR)
+    {
+        delivery.leader->shared_delivery_ = UAVCAN_NULLPTR;
+    }
+}
+
+template <typename DataSpec, typename DataStruct, typename TransferListenerType>
+void GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::leaveSharedGroup()
+{
+    if (!shared_)
+    {
+        return;
+    }
+    shared_ = false;
+
+    SelfType* const leader = (shared_leader_ != UAVCAN_NULLPTR) ? shared_leader_ : this;
+    SharedDelivery* const delivery = leader->shared_delivery_;
+    if ((delivery != UAVCAN_NULLPTR) && (delivery->next == this))
+    {
+        delivery->next = shared_next_;
+    }
+
+    if (shared_leader_ != UAVCAN_NULLPTR)
+    {
+        SelfType* prev = shared_leader_;
+        while (prev->shared_next_ != this)
+        {
+            UAVCAN_ASSERT(prev->shared_next_ != UAVCAN_NULLPTR);
+            prev = prev->shared_next_;
+        }
+        prev->shared_next_ = shared_next_;
+    }
+    else if (shared_next_ != UAVCAN_NULLPTR)
+    {
+        // The first follower takes over
+        SelfType* const new_leader = shared_next_;
+        new_leader->shared_leader_ = UAVCAN_NULLPTR;
+        new_leader->shared_delivery_ = delivery;
+        bool allow_anonymous = new_leader->anonymous_allowed_;
+        for (SelfType* p = new_leader->shared_next_; p != UAVCAN_NULLPTR; p = p->shared_next_)
+        {
+            p->shared_leader_ = new_leader;
+            allow_anonymous = allow_anonymous || p->anonymous_allowed_;
+        }
+        if (allow_anonymous)
+        {
+            new_leader->forwarder_->allowAnonymousTransfers();
+        }
+        if (delivery != UAVCAN_NULLPTR)
+        {
+            delivery->leader = new_leader;
+        }
+        // Replaced in place, so that the new listener doesn't receive the frame that may be being processed now
+        if (!node_.getDispatcher().replaceMessageListener(forwarder_, new_leader->forwarder_))
+        {
+            UAVCAN_ASSERT(0);
+            (void)node_.getDispatcher().registerMessageListener(new_leader->forwarder_);
+        }
+    }
+    else if (delivery != UAVCAN_NULLPTR)
+    {
+        delivery->leader = UAVCAN_NULLPTR;
+    }
+
+    shared_leader_ = UAVCAN_NULLPTR;
+    shared_next_ = UAVCAN_NULLPTR;
+    shared_delivery_ = UAVCAN_NULLPTR;
+}
+
+template <typename DataSpec, typename DataStruct, typename TransferListenerType>
+int GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::startAsSharedMessageListener()
+{
+    UAVCAN_TRACE("GenericSubscriber", "Start as shared message listener; dtname=%s",
+                 DataSpec::getDataTypeFullName());
+    const int res = checkInit();
+    if (res < 0)
+    {
+        UAVCAN_TRACE("GenericSubscriber", "Initialization failure [%s]", DataSpec::getDataTypeFullName());
+        return res;
+    }
+    if (forwarder_->isFrameFilteringEnabled())
+    {
+        UAVCAN_TRACE("GenericSubscriber", "Filtered subscriber can't be shared [%s]", DataSpec::getDataTypeFullName());
+        return -ErrLogic;
+    }
+    stop();
+
+    const TransferListener* p = node_.getDispatcher().getListOfMessageListeners().get();
+    while (p != UAVCAN_NULLPTR)
+    {
+        if (p->getSharingKey() == TransferForwarder::getSharingKeyOfThisType())
+        {
+            SelfType& leader = static_cast<const TransferForwarder*>(p)->getOwner();
+            shared_ = true;
+            shared_leader_ = &leader;
+            shared_next_ = leader.shared_next_;     // Inserted first, see the note about the ongoing delivery
+            leader.shared_next_ = this;
+            if (anonymous_allowed_)
+            {
+                leader.forwarder_->allowAnonymousTransfers();
+            }
+            return 0;
+        }
+        p = p->getNextListNode();
+    }
+
+    shared_ = true;
+    const int start_res = GenericSubscriberBase::genericStart(forwarder_, &Dispatcher::registerMessageListener);
+    shared_ = start_res >= 0;
+    return start_res;
 }
 
 template <typename DataSpec, typename DataStruct, typename TransferListenerType>
@@ -294,6 +709,7 @@ genericStart(bool (Dispatcher::*registration_method)(TransferListener*))
         UAVCAN_TRACE("GenericSubscriber", "Initialization failure [%s]", DataSpec::getDataTypeFullName());
         return res;
     }
+    leaveSharedGroup();
     return GenericSubscriberBase::genericStart(forwarder_, registration_method);
 }
 
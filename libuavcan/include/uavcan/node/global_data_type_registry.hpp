@@ -31,6 +31,9 @@ namespace uavcan
  *
  * Attempt to use a data type that was not registered with this singleton (e.g. publish, subscribe,
  * perform a service call etc.) will fail with an error code @ref ErrUnknownDataType.
+ *
+ * Instead of registering the generated types one by one, the application can adopt the table of all data types
+ * with default Data Type ID generated by the DSDL compiler, see @ref adoptTable().
  */
 class UAVCAN_EXPORT GlobalDataTypeRegistry : Noncopyable
 {
@@ -74,17 +77,99 @@ public:
 
 private:
     typedef LinkedListRoot<Entry> List;
+
+#if UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY > 0
+    /**
+     * Built when the registry gets frozen, since the lists can't change afterwards.
+     * The entries are sorted by data type ID; the hash table by full name is open-addressed with linear probing.
+     */
+    class Index
+    {
+        enum { Capacity = UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY };
+        enum { HashTableSize = Capacity * 2 };          // Load factor of at most one half keeps the probes short
+
+        const DataTypeDescriptor* by_id_[Capacity];
+        uint16_t by_name_[HashTableSize];               ///< Position in by_id_ plus one, zero if free
+        uint16_t len_;
+        bool valid_;
+
+        static unsigned hashName(const char* name);
+
+    public:
+        Index()
+            : len_(0)
+            , valid_(false)
+        { }
+
+        void build(const List& list, const DataTypeDescriptor* table, unsigned table_len);
+        void invalidate() { valid_ = false; }
+
+        bool isValid() const { return valid_; }
+
+        const DataTypeDescriptor* find(DataTypeID dtid) const;
+        const DataTypeDescriptor* find(const char* name) const;
+    };
+
+    Index msg_index_;
+    Index srv_index_;
+
+    const Index* selectIndex(DataTypeKind kind) const;
+#endif
+
+    /**
+     * Descriptors of one kind in the adopted table, sorted by data type ID.
+     */
+    struct TableRange
+    {
+        const DataTypeDescriptor* begin;
+        uint16_t len;
+
+        TableRange() : begin(UAVCAN_NULLPTR), len(0) { }
+    };
+
     mutable List msgs_;
     mutable List srvs_;
+    TableRange msg_table_;
+    TableRange srv_table_;
     bool frozen_;
 
     GlobalDataTypeRegistry() : frozen_(false) { }
 
+    static bool isNameInList(const List& list, const char* name);
+
     List* selectList(DataTypeKind kind) const;
+    const TableRange& selectTableRange(DataTypeKind kind) const;
+
+    /**
+     * Entries of the adopted table are overridden by the registrations of the same data type with another ID.
+     */
+    bool isOverridden(const DataTypeDescriptor& table_entry) const;
+    const DataTypeDescriptor* findInTable(DataTypeKind kind, const char* name) const;
+    const DataTypeDescriptor* findInTable(DataTypeKind kind, DataTypeID dtid) const;
+    unsigned getNumTypes(DataTypeKind kind) const;
 
     RegistrationResult remove(Entry* dtd);
     RegistrationResult registImpl(Entry* dtd);
 
+    /**
+     * The generated types provide the transfer CRC seeded with their signature as TransferCRCBase,
+     * for other types it is computed.
+     */
+    template <typename Type>
+    static DataTypeDescriptor makeDescriptor(DataTypeID id,
+                                             typename EnableIf<(sizeof(Type::TransferCRCBase) > 0), int>::Type)
+    {
+        return DataTypeDescriptor(DataTypeKind(Type::DataTypeKind), id, Type::getDataTypeSignature(),
+                                  Type::getDataTypeFullName(), TransferCRC(uint16_t(Type::TransferCRCBase)));
+    }
+
+    template <typename Type>
+    static DataTypeDescriptor makeDescriptor(DataTypeID id, long)
+    {
+        return DataTypeDescriptor(DataTypeKind(Type::DataTypeKind), id,
+                                  Type::getDataTypeSignature(), Type::getDataTypeFullName());
+    }
+
 public:
     /**
      * Returns the reference to the singleton.
@@ -118,9 +203,32 @@ public:
     void freeze();
     bool isFrozen() const { return frozen_; }
 
+    /**
+     * Adopts a table of data type descriptors, typically the one generated by the DSDL compiler with the option
+     * --data-type-table, so that the types don't have to be registered one by one at startup. The table is
+     * referenced, not copied, so it must stay valid forever; the generated one is placed in ROM.
+     *
+     * The table must contain the messages followed by the services, each sorted by data type ID, with unique names.
+     * The types registered with @ref registerDataType() take precedence: a registration of a type from the table
+     * under another ID overrides the table entry, and a registration under the same ID has no effect.
+     * The table can be adopted only once and only before the registry is frozen; the types that have been
+     * registered earlier, e.g. by the static constructors of the generated types, stay registered.
+     *
+     * Returns RegistrationResultInvalidParams if the table is not valid, or RegistrationResultCollision if
+     * a data type ID is already taken by another registered type.
+     */
+    RegistrationResult adoptTable(const DataTypeDescriptor* table, unsigned len);
+
+    template <unsigned Len>
+    RegistrationResult adoptTable(const DataTypeDescriptor (&table)[Len]) { return adoptTable(table, Len); }
+
+    bool hasTable() const { return (msg_table_.len + srv_table_.len) > 0; }
+
     /**
      * Finds data type descriptor by full data type name, e.g. "uavcan.protocol.NodeStatus".
      * Messages are searched first, then services.
+     * Once the registry is frozen, the lookups by name and by ID use the index, see
+     * UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY.
      * Returns null pointer if the data type with this name is not registered.
      * @param name  Full data type name
      * @return      Descriptor for this data type or null pointer if not found
@@ -148,12 +256,12 @@ public:
     /**
      * Returns the number of registered message types.
      */
-    unsigned getNumMessageTypes() const { return msgs_.getLength(); }
+    unsigned getNumMessageTypes() const { return getNumTypes(DataTypeKindMessage); }
 
     /**
      * Returns the number of registered service types.
      */
-    unsigned getNumServiceTypes() const { return srvs_.getLength(); }
+    unsigned getNumServiceTypes() const { return getNumTypes(DataTypeKindService); }
 
 #if UAVCAN_DEBUG
     /// Required for unit testing
@@ -162,6 +270,12 @@ public:
         UAVCAN_TRACE("GlobalDataTypeRegistry", "Reset; was frozen: %i, num msgs: %u, num srvs: %u",
                      int(frozen_), getNumMessageTypes(), getNumServiceTypes());
         frozen_ = false;
+        msg_table_ = TableRange();
+        srv_table_ = TableRange();
+#if UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY > 0
+        msg_index_.invalidate();
+        srv_index_.invalidate();
+#endif
         while (msgs_.get())
         {
             msgs_.remove(msgs_.get());
@@ -181,13 +295,14 @@ public:
  * unit of the application, the data type will not be registered.
  *
  * Data type needs to have a default ID to be registrable by this class.
+ * Does nothing if UAVCAN_NO_DEFAULT_DATA_TYPE_REGISTRATION is set.
  */
 template <typename Type>
 struct UAVCAN_EXPORT DefaultDataTypeRegistrator
 {
     DefaultDataTypeRegistrator()
     {
-#if !UAVCAN_NO_GLOBAL_DATA_TYPE_REGISTRY
+#if !UAVCAN_NO_GLOBAL_DATA_TYPE_REGISTRY && !UAVCAN_NO_DEFAULT_DATA_TYPE_REGISTRATION
         const GlobalDataTypeRegistry::RegistrationResult res =
             GlobalDataTypeRegistry::instance().registerDataType<Type>(Type::DefaultDataTypeID);
 
@@ -223,8 +338,7 @@ GlobalDataTypeRegistry::RegistrationResult GlobalDataTypeRegistry::registerDataT
     }
 
     // We can't just overwrite the entry itself because it's noncopyable
-    entry.descriptor = DataTypeDescriptor(DataTypeKind(Type::DataTypeKind), id,
-                                          Type::getDataTypeSignature(), Type::getDataTypeFullName());
+    entry.descriptor = makeDescriptor<Type>(id, 0);
 
     {
         const RegistrationResult remove_res = remove(&entry);
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_HANDLER_PROFILER_HPP_INCLUDED
+#define UAVCAN_NODE_HANDLER_PROFILER_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/util/templates.hpp>
+#include <uavcan/util/linked_list.hpp>
+#include <uavcan/driver/system_clock.hpp>
+
+#if UAVCAN_HANDLER_PROFILING
+
+namespace uavcan
+{
+
+class UAVCAN_EXPORT HandlerProfiler;
+
+/**
+ * Lets the application measure the handlers more precisely than with the system clock, and sample the stack usage.
+ * Both methods are invoked from the hot paths of the library, so they must be fast.
+ */
+class UAVCAN_EXPORT IHandlerProfilerHooks
+{
+public:
+    virtual ~IHandlerProfilerHooks() { }
+
+    /**
+     * Free running counter, e.g. the CPU cycle counter. It may wrap around, as long as no handler runs longer than
+     * the wrap around period.
+     */
+    virtual uint32_t readTicks() = 0;
+
+    /**
+     * Stack high water mark of the thread that runs the node, in bytes; e.g. the depth of the painted stack area that
+     * has been overwritten. It is sampled after every profiled handler. Zero means that it's not known.
+     */
+    virtual uint32_t sampleStackUsage() { return 0; }
+};
+
+/**
+ * Execution statistics of one handler. Every profiled object (subscriber, service server, deadline handler) owns
+ * its profile, which is registered in the @ref HandlerProfiler of the node for as long as the object exists.
+ *
+ * The time is measured in ticks, which are microseconds of the monotonic clock unless the ticks are provided by
+ * @ref IHandlerProfilerHooks. Subscribers and service servers are measured from the moment the decoded data
+ * structure is passed to the callback, so the decoding time is not included.
+ */
+class UAVCAN_EXPORT HandlerProfile : public LinkedListNode<HandlerProfile>
+{
+public:
+    enum Kind
+    {
+        KindSubscriber,
+        KindServiceServer,
+        KindDeadlineHandler
+    };
+
+private:
+    friend class HandlerProfilingScope;
+
+    HandlerProfiler& profiler_;
+    const char* name_;
+    uint64_t total_ticks_;
+    uint32_t num_invocations_;
+    uint32_t max_ticks_;
+    uint32_t max_stack_usage_;
+    Kind kind_;
+
+    void account(uint32_t ticks, uint32_t stack_usage);
+
+public:
+    HandlerProfile(HandlerProfiler& profiler, Kind kind, const char* name = UAVCAN_NULLPTR);
+
+    ~HandlerProfile();
+
+    /**
+     * The name is used only for reporting, it is not copied. Subscribers and service servers are named after their
+     * data types; deadline handlers are not named by default.
+     */
+    const char* getName() const { return name_; }
+    void setName(const char* name) { name_ = name; }
+
+    Kind getKind() const { return kind_; }
+    void setKind(Kind kind) { kind_ = kind; }
+
+    uint32_t getNumInvocations() const { return num_invocations_; }
+    uint64_t getTotalTicks() const { return total_ticks_; }
+    uint32_t getMaxTicks() const { return max_ticks_; }
+
+    /**
+     * Maximum of the stack usage samples taken after this handler, zero if the samples are not available.
+     * Since the high water mark never goes down, the handler that raised it is the first one to report the new value.
+     */
+    uint32_t getMaxStackUsage() const { return max_stack_usage_; }
+
+    void reset();
+};
+
+/**
+ * Keeps the execution statistics of the handlers of one node, see @ref UAVCAN_HANDLER_PROFILING.
+ * The handlers are profiled only while they are invoked by the library, i.e. from spin().
+ *
+ * Typical usage, e.g. from a debug console:
+ *
+ *     for (const HandlerProfile* p = node.getScheduler().getHandlerProfiler().getProfiles();
+ *          p != nullptr; p = p->getNextListNode())
+ *     {
+ *         printf("%s %u %u\n", p->getName(), p->getNumInvocations(), p->getMaxTicks());
+ *     }
+ */
+class UAVCAN_EXPORT HandlerProfiler : Noncopyable
+{
+    friend class HandlerProfile;
+    friend class HandlerProfilingScope;
+
+    ISystemClock& sysclock_;
+    IHandlerProfilerHooks* hooks_;
+    LinkedListRoot<HandlerProfile> profiles_;
+    HandlerProfile* active_;            ///< Null if no handler is running or if it has been destroyed
+
+    uint32_t readTicks() const;
+
+public:
+    explicit HandlerProfiler(ISystemClock& sysclock)
+        : sysclock_(sysclock)
+        , hooks_(UAVCAN_NULLPTR)
+        , active_(UAVCAN_NULLPTR)
+    { }
+
+    /**
+     * Null removes the hooks. Since the hooks define the units of the ticks, the statistics should be reset after
+     * the hooks are changed. The hooks must outlive their installation.
+     */
+    IHandlerProfilerHooks* getHooks() const { return hooks_; }
+    void setHooks(IHandlerProfilerHooks* hooks) { hooks_ = hooks; }
+
+    /**
+     * Profiles of all existing handlers, newest first. The list is linked through getNextListNode().
+     */
+    const HandlerProfile* getProfiles() const { return profiles_.get(); }
+    unsigned getNumProfiles() const { return profiles_.getLength(); }
+
+    /**
+     * Returns the profile with the largest maximum execution time, or null if no handler has been invoked yet.
+     */
+    const HandlerProfile* findSlowest() const;
+
+    void resetAll();
+};
+
+/**
+ * Measures one invocation of a handler; it is placed around the call by the library.
+ * The handler may destroy its object, and its profile along with it; the measurement is discarded then.
+ */
+class UAVCAN_EXPORT HandlerProfilingScope : Noncopyable
+{
+    HandlerProfiler& profiler_;
+    HandlerProfile* const outer_;
+    const uint32_t started_at_;
+
+public:
+    explicit HandlerProfilingScope(HandlerProfile& profile)
+        : profiler_(profile.profiler_)
+        , outer_(profiler_.active_)
+        , started_at_(profiler_.readTicks())
+    {
+        profiler_.active_ = &profile;
+    }
+
+    ~HandlerProfilingScope();
+};
+
+}
+
+#endif
+
+#endif // UAVCAN_NODE_HANDLER_PROFILER_HPP_INCLUDED
@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_LATEST_VALUE_SUBSCRIBER_HPP_INCLUDED
+#define UAVCAN_NODE_LATEST_VALUE_SUBSCRIBER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/node/generic_subscriber.hpp>
+#include <uavcan/util/seqlock.hpp>
+
+namespace uavcan
+{
+/**
+ * Keeps only the most recent message of the given type, so that it can be read by other threads at their own rate,
+ * e.g. by a control loop that needs the latest attitude estimate or the latest ESC status of every node.
+ *
+ * Each received message is decoded in the reception path and copied into a slot protected by a sequence lock,
+ * see @ref SeqLocked. The reception path never waits for the readers; a reader retries the copy if the slot was
+ * updated while it was being read, so that it always gets a consistent snapshot without taking a lock.
+ * The snapshot also contains the timestamps and the source node ID of the message, which allows the reader
+ * to check the age of the data.
+ *
+ * If MaxSourceNodes_ is zero, there is one slot that holds the latest message from any node. Otherwise, there is
+ * one slot per source node, assigned when the first message from that node is received; messages from nodes that
+ * don't fit into the table are discarded and counted. Slots are never reassigned.
+ *
+ * The data type is copied as raw memory, which is fine for the generated types since they don't own any
+ * external resources. The subscription is managed (started, stopped) from the thread that spins the node;
+ * only @ref read() and the getters may be called from other threads.
+ *
+ * @tparam DataType_            Message data type.
+ *
+ * @tparam MaxSourceNodes_      Number of per-node slots; zero keeps only the latest message from any node.
+ *
+ * @tparam TransferListener_    Refer to @ref Subscriber.
+ */
+template <typename DataType_,
+          unsigned MaxSourceNodes_ = 0,
+          typename TransferListener_ = TransferListener
+          >
+class UAVCAN_EXPORT LatestValueSubscriber
+    : public GenericSubscriber<DataType_, DataType_, TransferListener_>
+{
+public:
+    typedef DataType_ DataType;
+
+    /**
+     * Copy of a received message.
+     */
+    struct Snapshot
+    {
+        DataType msg;
+        MonotonicTime ts_monotonic;
+        UtcTime ts_utc;
+        NodeID src_node_id;
+        uint32_t update_count;  ///< Number of messages stored into this slot, including this one
+
+        Snapshot() : update_count(0) { }
+    };
+
+    enum { NumSlots = (MaxSourceNodes_ == 0) ? 1 : MaxSourceNodes_ };
+
+private:
+    typedef GenericSubscriber<DataType_, DataType_, TransferListener_> BaseType;
+
+    enum { FreeSlot = 0xFF };
+
+    struct Slot
+    {
+        SeqLocked<Snapshot> value;
+        std::atomic<uint8_t> node_id;       ///< Published once the slot holds its first message
+        uint32_t update_count;              ///< Accessed only by the reception path
+    };
+
+    Slot slots_[NumSlots];
+    std::atomic<uint8_t> latest_slot_;
+    std::atomic<uint8_t> num_used_slots_;
+    std::atomic<uint32_t> num_dropped_;
+
+    Slot* findOrAssignSlot(NodeID src_node_id);
+
+    virtual void handleReceivedDataStruct(ReceivedDataStructure<DataType>& msg) override;
+
+public:
+    explicit LatestValueSubscriber(INode& node)
+        : BaseType(node)
+        , latest_slot_(FreeSlot)
+        , num_used_slots_(0)
+        , num_dropped_(0)
+    {
+        StaticAssert<DataTypeKind(DataType::DataTypeKind) == DataTypeKindMessage>::check();
+        StaticAssert<(unsigned(NumSlots) < unsigned(FreeSlot))>::check();
+        for (unsigned i = 0; i < NumSlots; i++)
+        {
+            slots_[i].node_id.store(FreeSlot, std::memory_order_relaxed);
+            slots_[i].update_count = 0;
+        }
+    }
+
+    virtual ~LatestValueSubscriber() { BaseType::stop(); }
+
+    /**
+     * Begin receiving messages. The slots keep their contents when the subscription is stopped and restarted.
+     * Returns negative error code.
+     */
+    int start() { return BaseType::startAsMessageListener(); }
+
+    /**
+     * Copies the most recent message, from any node, into the snapshot. Can be called from any thread.
+     * Returns false if nothing has been received yet.
+     */
+    bool read(Snapshot& out_snapshot) const;
+
+    /**
+     * Copies the most recent message from the given node into the snapshot. Can be called from any thread.
+     * With a single slot, this succeeds only if the latest message came from that node.
+     * Returns false if nothing has been received from that node.
+     */
+    bool read(NodeID src_node_id, Snapshot& out_snapshot) const;
+
+    /**
+     * Number of slots that hold a message; with per-node slots, this is the number of nodes heard from.
+     */
+    unsigned getNumUsedSlots() const { return num_used_slots_.load(std::memory_order_relaxed); }
+
+    /**
+     * Returns the source node ID of the given slot, or an invalid node ID if the slot is not used yet.
+     * Together with @ref getNumUsedSlots() this allows to enumerate the known nodes.
+     */
+    NodeID getSlotNodeID(unsigned index) const
+    {
+        if (index >= NumSlots)
+        {
+            return NodeID();
+        }
+        const uint8_t node_id = slots_[index].node_id.load(std::memory_order_acquire);
+        return (node_id == FreeSlot) ? NodeID() : NodeID(node_id);
+    }
+
+    /**
+     * Returns the number of messages that were discarded because there was no slot for their source node.
+     */
+    uint32_t getNumDroppedMessages() const { return num_dropped_.load(std::memory_order_relaxed); }
+
+    using BaseType::allowAnonymousTransfers;
+    using BaseType::stop;
+    using BaseType::getFailureCount;
+    using BaseType::reservePoolBlocks;
+};
+
+// ----------------------------------------------------------------------------
+
+template <typename DataType_, unsigned MaxSourceNodes_, typename TransferListener_>
+typename LatestValueSubscriber<DataType_, MaxSourceNodes_, TransferListener_>::Slot*
+LatestValueSubscriber<DataType_, MaxSourceNodes_, TransferListener_>::findOrAssignSlot(NodeID src_node_id)
+{
+    if (MaxSourceNodes_ == 0)
+    {
+        return &slots_[0];
+    }
+
+    // Slots are assigned in order and never released, so the used ones form a prefix of the table
+    const unsigned num_used = num_used_slots_.load(std::memory_order_relaxed);
+    for (unsigned i = 0; i < num_used; i++)
+    {
+        if (slots_[i].node_id.load(std::memory_order_relaxed) == src_node_id.get())
+        {
+            return &slots_[i];
+        }
+    }
+    if (num_used < NumSlots)
+    {
+        return &slots_[num_used];       // Published after the first message has been stored
+    }
+    return UAVCAN_NULLPTR;
+}
+
+template <typename DataType_, unsigned MaxSourceNodes_, typename TransferListener_>
+void LatestValueSubscriber<DataType_, MaxSourceNodes_, TransferListener_>::
+handleReceivedDataStruct(ReceivedDataStructure<DataType>& msg)
+{
+    Slot* const slot = findOrAssignSlot(msg.getSrcNodeID());
+    if (slot == UAVCAN_NULLPTR)
+    {
+        UAVCAN_TRACE("LatestValueSubscriber", "No slot for node %d, message dropped [%s]",
+                     int(msg.getSrcNodeID().get()), DataType::getDataTypeFullName());
+        (void)num_dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Snapshot snapshot;
+    snapshot.msg = msg;
+    snapshot.ts_monotonic = msg.getMonotonicTimestamp();
+    snapshot.ts_utc = msg.getUtcTimestamp();
+    snapshot.src_node_id = msg.getSrcNodeID();
+    snapshot.update_count = ++slot->update_count;
+
+    slot->value.store(snapshot);
+
+    const uint8_t index = uint8_t(slot - &slots_[0]);
+    if (slot->node_id.load(std::memory_order_relaxed) == FreeSlot)
+    {
+        slot->node_id.store(msg.getSrcNodeID().get(), std::memory_order_release);
+        if (MaxSourceNodes_ > 0)
+        {
+            (void)num_used_slots_.fetch_add(1, std::memory_order_release);
+        }
+        else
+        {
+            num_used_slots_.store(1, std::memory_order_release);
+        }
+    }
+    else if (MaxSourceNodes_ == 0)
+    {
+        slot->node_id.store(msg.getSrcNodeID().get(), std::memory_order_release);
+    }
+    latest_slot_.store(index, std::memory_order_release);
+}
+
+template <typename DataType_, unsigned MaxSourceNodes_, typename TransferListener_>
+bool LatestValueSubscriber<DataType_, MaxSourceNodes_, TransferListener_>::read(Snapshot& out_snapshot) const
+{
+    const uint8_t index = latest_slot_.load(std::memory_order_acquire);
+    if (index == FreeSlot)
+    {
+        return false;
+    }
+    return slots_[index].value.load(out_snapshot);
+}
+
+template <typename DataType_, unsigned MaxSourceNodes_, typename TransferListener_>
+bool LatestValueSubscriber<DataType_, MaxSourceNodes_, TransferListener_>::read(NodeID src_node_id,
+                                                                                 Snapshot& out_snapshot) const
+{
+    if (MaxSourceNodes_ == 0)
+    {
+        return slots_[0].value.load(out_snapshot) && (out_snapshot.src_node_id == src_node_id);
+    }
+
+    const unsigned num_used = getNumUsedSlots();
+    for (unsigned i = 0; i < num_used; i++)
+    {
+        if (slots_[i].node_id.load(std::memory_order_acquire) == src_node_id.get())
+        {
+            return slots_[i].value.load(out_snapshot);
+        }
+    }
+    return false;
+}
+
+}
+
+#endif // UAVCAN_NODE_LATEST_VALUE_SUBSCRIBER_HPP_INCLUDED
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_LAZY_SUBSCRIBER_HPP_INCLUDED
+#define UAVCAN_NODE_LAZY_SUBSCRIBER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/node/generic_subscriber.hpp>
+
+#if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
+# error UAVCAN_CPP_VERSION
+#endif
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+# include <functional>
+# include <uavcan/util/inplace_function.hpp>
+#endif
+
+namespace uavcan
+{
+/**
+ * Lazy view of a received message: the fields located at constant offsets at the beginning of the message are
+ * decoded on demand straight from the transfer payload, via the accessors of the LazyView class generated by the
+ * DSDL compiler (e.g. get_seq()). The extra information from the transport layer is available the same way as with
+ * @ref ReceivedDataStructure.
+ *
+ * This class holds a reference to the transfer, which is valid only until the subscription callback returns.
+ */
+template <typename DataType_>
+class UAVCAN_EXPORT ReceivedLazyView : public DataType_::LazyView, Noncopyable
+{
+    IncomingTransfer& transfer_;
+
+public:
+    typedef DataType_ DataType;
+
+    explicit ReceivedLazyView(IncomingTransfer& transfer)
+        : DataType_::LazyView(transfer)
+        , transfer_(transfer)
+    { }
+
+    MonotonicTime getMonotonicTimestamp() const { return transfer_.getMonotonicTimestamp(); }
+    UtcTime getUtcTimestamp()             const { return transfer_.getUtcTimestamp(); }
+    TransferPriority getPriority()        const { return transfer_.getPriority(); }
+    TransferType getTransferType()        const { return transfer_.getTransferType(); }
+    TransferID getTransferID()            const { return transfer_.getTransferID(); }
+    NodeID getSrcNodeID()                 const { return transfer_.getSrcNodeID(); }
+    uint8_t getIfaceIndex()               const { return transfer_.getIfaceIndex(); }
+    bool isAnonymousTransfer()            const { return transfer_.isAnonymousTransfer(); }
+    bool isCanFDTransfer()                const { return transfer_.isCanFDTransfer(); }
+    bool isTaoDisabled()                  const { return transfer_.isTaoDisabled(); }
+
+    /**
+     * Decodes the whole message, for the case when the application needs more than the leading fields after all.
+     * Returns negative error code, zero if the message is malformed, or positive on success.
+     */
+    int decode(DataType& out_message) const
+    {
+        const LinearizedIncomingTransfer<RxLinearizationBufferSize<DataType>::Result> payload(transfer_);
+        BitStream bitstream = (payload.getData() != UAVCAN_NULLPTR) ?
+                              BitStream(payload.getData(), payload.getLength()) : BitStream(transfer_);
+        ScalarCodec codec(bitstream);
+        const TailArrayOptimizationMode tao_mode =
+            (transfer_.isCanFDTransfer() || transfer_.isTaoDisabled()) ? TailArrayOptDisabled : TailArrayOptEnabled;
+        return DataType::decode(out_message, codec, tao_mode);
+    }
+};
+
+/**
+ * Use this class to subscribe to a message without decoding every received transfer.
+ * The callback receives a @ref ReceivedLazyView<>, which decodes the requested fields on demand; this saves the time
+ * and the memory needed to decode large messages when the application only needs a few leading fields of them.
+ *
+ * @tparam DataType_        Message data type.
+ *
+ * @tparam Callback_        Type of the callback that will be used to deliver received messages into the application.
+ *                          The argument type is const ReceivedLazyView<DataType_>&.
+ *                          In C++11 mode this type defaults to @ref DefaultCallback<>.
+ *                          In C++03 mode this type defaults to a plain function pointer; use binder to
+ *                          call member functions as callbacks.
+ */
+template <typename DataType_,
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+          typename Callback_ = DefaultCallback<void (const ReceivedLazyView<DataType_>&)>
+#else
+          typename Callback_ = void (*)(const ReceivedLazyView<DataType_>&)
+#endif
+          >
+class UAVCAN_EXPORT LazySubscriber : public GenericSubscriberBase
+{
+public:
+    typedef Callback_ Callback;
+    typedef DataType_ DataType;
+
+private:
+    typedef LazySubscriber<DataType_, Callback_> SelfType;
+
+    class TransferForwarder : public TransferListener
+    {
+        SelfType& obj_;
+
+        void handleIncomingTransfer(IncomingTransfer& transfer) override
+        {
+            obj_.handleIncomingTransfer(transfer);
+        }
+
+    public:
+        TransferForwarder(SelfType& obj,
+                          const DataTypeDescriptor& data_type,
+                          uint16_t max_buffer_size,
+                          IPoolAllocator& allocator) :
+            TransferListener(obj.node_.getDispatcher().getTransferPerfCounter(),
+                             data_type,
+                             max_buffer_size,
+                             allocator),
+            obj_(obj)
+        { }
+    };
+
+    LazyConstructor<TransferForwarder> forwarder_;
+    Callback callback_;
+
+    int checkInit();
+
+    void handleIncomingTransfer(IncomingTransfer& transfer)
+    {
+        if (coerceOrFallback<bool>(callback_, true))
+        {
+            const ReceivedLazyView<DataType> view(transfer);
+#if UAVCAN_HANDLER_PROFILING
+            const HandlerProfilingScope profiling_scope(handler_profile_);
+#endif
+            callback_(view);
+        }
+        else
+        {
+            handleFatalError("LazySub clbk");
+        }
+    }
+
+public:
+    explicit LazySubscriber(INode& node)
+        : GenericSubscriberBase(node, DataType::getDataTypeFullName())
+        , callback_()
+    {
+        StaticAssert<DataTypeKind(DataType::DataTypeKind) == DataTypeKindMessage>::check();
+    }
+
+    virtual ~LazySubscriber() { stop(); }
+
+    /**
+     * Begin receiving messages.
+     * Each message will be passed to the application via the callback.
+     * Returns negative error code.
+     */
+    int start(const Callback& callback)
+    {
+        stop();
+
+        if (!coerceOrFallback<bool>(callback, true))
+        {
+            UAVCAN_TRACE("LazySubscriber", "Invalid callback");
+            return -ErrInvalidParam;
+        }
+        callback_ = callback;
+
+        const int res = checkInit();
+        if (res < 0)
+        {
+            return res;
+        }
+        UAVCAN_TRACE("LazySubscriber", "Start; dtname=%s", DataType::getDataTypeFullName());
+        return GenericSubscriberBase::genericStart(forwarder_, &Dispatcher::registerMessageListener);
+    }
+
+    /**
+     * Terminate the subscription.
+     */
+    void stop()
+    {
+        GenericSubscriberBase::stop(forwarder_);
+    }
+
+    /**
+     * @ref Subscriber::allowAnonymousTransfers().
+     */
+    void allowAnonymousTransfers()
+    {
+        if (checkInit() >= 0)
+        {
+            forwarder_->allowAnonymousTransfers();
+        }
+    }
+};
+
+// ----------------------------------------------------------------------------
+
+template <typename DataType_, typename Callback_>
+int LazySubscriber<DataType_, Callback_>::checkInit()
+{
+    if (forwarder_)
+    {
+        return 0;
+    }
+
+    GlobalDataTypeRegistry::instance().freeze();
+    const DataTypeDescriptor* const descr =
+        GlobalDataTypeRegistry::instance().find(DataTypeKind(DataType::DataTypeKind), DataType::getDataTypeFullName());
+    if (descr == UAVCAN_NULLPTR)
+    {
+        UAVCAN_TRACE("LazySubscriber", "Type [%s] is not registered", DataType::getDataTypeFullName());
+        return -ErrUnknownDataType;
+    }
+
+    static const uint16_t MaxBufferSize = BitLenToByteLen<DataType::MaxBitLen>::Result;
+
+    forwarder_.template construct<SelfType&, const DataTypeDescriptor&, uint16_t, IPoolAllocator&>
+        (*this, *descr, MaxBufferSize, node_.getAllocator());
+
+    return 0;
+}
+
+}
+
+#endif // UAVCAN_NODE_LAZY_SUBSCRIBER_HPP_INCLUDED
@@ -26,6 +26,54 @@
 
 namespace uavcan
 {
+/**
+ * Optional built-in protocol services of @ref Node. The application selects the services by combining these flags
+ * in the template argument of the node class; the services that are not selected are not instantiated at all, so
+ * they don't take any RAM, pool memory or dispatcher entries. NodeStatus is mandatory, so it's always available.
+ * With @ref UAVCAN_TINY no optional services are available.
+ */
+enum NodeServiceFlags
+{
+    NodeServiceDataTypeInfo   = 1,      ///< Responds to uavcan.protocol.GetDataTypeInfo
+    NodeServiceLogger         = 2,      ///< Node logging, uavcan.protocol.debug.LogMessage
+    NodeServiceRestartRequest = 4,      ///< Responds to uavcan.protocol.RestartNode
+    NodeServiceTransportStats = 8,      ///< Responds to uavcan.protocol.GetTransportStats
+    NodeServicesNone          = 0,
+    NodeServicesAll           = 15
+};
+
+#if !UAVCAN_TINY
+/**
+ * Holds one optional service of @ref Node if it is enabled; otherwise holds nothing.
+ */
+template <typename Service, bool Enabled>
+class UAVCAN_EXPORT NodeServiceHolder
+{
+    Service service_;
+
+    static int startService(DataTypeInfoProvider& s)   { return s.start(); }
+    static int startService(Logger& s)                 { return s.init(); }
+    static int startService(RestartRequestServer& s)   { return s.start(); }
+    static int startService(TransportStatsProvider& s) { return s.start(); }
+
+public:
+    explicit NodeServiceHolder(INode& node) : service_(node) { }
+
+    int start() { return startService(service_); }
+
+    Service& get() { return service_; }
+};
+
+template <typename Service>
+class UAVCAN_EXPORT NodeServiceHolder<Service, false>
+{
+public:
+    explicit NodeServiceHolder(INode&) { }
+
+    int start() { return 0; }
+};
+#endif
+
 /**
  * This is the top-level node API.
  * A custom node class can be implemented if needed, in which case it shall inherit INode.
@@ -33,8 +81,11 @@ namespace uavcan
  * @tparam MemPoolSize      Size of memory pool for this node, in bytes.
  *                          Please refer to the documentation for details.
  *                          If this value is zero, the constructor will accept a reference to user-provided allocator.
+ *
+ * @tparam Services         Optional built-in services, see @ref NodeServiceFlags; all of them by default.
+ *                          The accessors of the services that are not selected fail to compile.
  */
-template <std::size_t MemPoolSize = 0>
+template <std::size_t MemPoolSize = 0, unsigned Services = (UAVCAN_TINY ? NodeServicesNone : NodeServicesAll)>
 class UAVCAN_EXPORT Node : public INode
 {
     typedef typename
@@ -48,10 +99,16 @@ class UAVCAN_EXPORT Node : public INode
 
     NodeStatusProvider proto_nsp_;
 #if !UAVCAN_TINY
-    DataTypeInfoProvider proto_dtp_;
-    Logger proto_logger_;
-    RestartRequestServer proto_rrs_;
-    TransportStatsProvider proto_tsp_;
+    NodeServiceHolder<DataTypeInfoProvider, (Services & NodeServiceDataTypeInfo) != 0> proto_dtp_;
+    NodeServiceHolder<Logger, (Services & NodeServiceLogger) != 0> proto_logger_;
+    NodeServiceHolder<RestartRequestServer, (Services & NodeServiceRestartRequest) != 0> proto_rrs_;
+    NodeServiceHolder<TransportStatsProvider, (Services & NodeServiceTransportStats) != 0> proto_tsp_;
+
+    static void logInternalFailure(NodeServiceHolder<Logger, true>& logger, const char* msg)
+    {
+        (void)logger.get().log(protocol::debug::LogLevel::ERROR, "UAVCAN", msg);
+    }
+    static void logInternalFailure(NodeServiceHolder<Logger, false>&, const char*) { }
 #endif
 
     uint64_t internal_failure_cnt_;
@@ -59,6 +116,8 @@ class UAVCAN_EXPORT Node : public INode
 
     void commonInit()
     {
+        StaticAssert<(Services & ~unsigned(NodeServicesAll)) == 0>::check();
+        StaticAssert<!UAVCAN_TINY || (Services == NodeServicesNone)>::check();   // Not available in tiny mode
         internal_failure_cnt_ = 0;
         started_ = false;
     }
@@ -71,7 +130,7 @@ protected:
 #if UAVCAN_TINY
         (void)msg;
 #else
-        (void)getLogger().log(protocol::debug::LogLevel::ERROR, "UAVCAN", msg);
+        logInternalFailure(proto_logger_, msg);
 #endif
     }
 
@@ -135,6 +194,15 @@ public:
         return -ErrNotInited;
     }
 
+    int spin(MonotonicTime deadline, const SpinBudget& budget)
+    {
+        if (started_)
+        {
+            return INode::spin(deadline, budget);
+        }
+        return -ErrNotInited;
+    }
+
     int spinOnce()
     {
         if (started_)
@@ -144,6 +212,15 @@ public:
         return -ErrNotInited;
     }
 
+    int processReady(MonotonicTime& out_next_deadline)
+    {
+        if (started_)
+        {
+            return INode::processReady(out_next_deadline);
+        }
+        return -ErrNotInited;
+    }
+
     bool isStarted() const { return started_; }
 
     uint64_t getInternalFailureCount() const { return internal_failure_cnt_; }
@@ -212,9 +289,9 @@ public:
     /**
      * Restart handler can be installed to handle external node restart requests (highly recommended).
      */
-    void setRestartRequestHandler(IRestartRequestHandler* handler) { proto_rrs_.setHandler(handler); }
+    void setRestartRequestHandler(IRestartRequestHandler* handler) { proto_rrs_.get().setHandler(handler); }
 
-    RestartRequestServer& getRestartRequestServer() { return proto_rrs_; }
+    RestartRequestServer& getRestartRequestServer() { return proto_rrs_.get(); }
 
     /**
      * Node logging.
@@ -227,33 +304,33 @@ public:
     template <typename... Args>
     inline void logDebug(const char* source, const char* format, Args... args)
     {
-        (void)proto_logger_.logDebug(source, format, args...);
+        (void)proto_logger_.get().logDebug(source, format, args...);
     }
 
     template <typename... Args>
     inline void logInfo(const char* source, const char* format, Args... args)
     {
-        (void)proto_logger_.logInfo(source, format, args...);
+        (void)proto_logger_.get().logInfo(source, format, args...);
     }
 
     template <typename... Args>
     inline void logWarning(const char* source, const char* format, Args... args)
     {
-        (void)proto_logger_.logWarning(source, format, args...);
+        (void)proto_logger_.get().logWarning(source, format, args...);
     }
 
     template <typename... Args>
     inline void logError(const char* source, const char* format, Args... args)
     {
-        (void)proto_logger_.logError(source, format, args...);
+        (void)proto_logger_.get().logError(source, format, args...);
     }
 
 #else
 
-    void logDebug(const char* source, const char* text)   { (void)proto_logger_.logDebug(source, text); }
-    void logInfo(const char* source, const char* text)    { (void)proto_logger_.logInfo(source, text); }
-    void logWarning(const char* source, const char* text) { (void)proto_logger_.logWarning(source, text); }
-    void logError(const char* source, const char* text)   { (void)proto_logger_.logError(source, text); }
+    void logDebug(const char* source, const char* text)   { (void)proto_logger_.get().logDebug(source, text); }
+    void logInfo(const char* source, const char* text)    { (void)proto_logger_.get().logInfo(source, text); }
+    void logWarning(const char* source, const char* text) { (void)proto_logger_.get().logWarning(source, text); }
+    void logError(const char* source, const char* text)   { (void)proto_logger_.get().logError(source, text); }
 
 #endif
     /**
@@ -263,15 +340,15 @@ public:
     /**
      * Use this method to configure logging.
      */
-    Logger& getLogger() { return proto_logger_; }
+    Logger& getLogger() { return proto_logger_.get(); }
 
 #endif  // UAVCAN_TINY
 };
 
 // ----------------------------------------------------------------------------
 
-template <std::size_t MemPoolSize_>
-int Node<MemPoolSize_>::start(const TransferPriority priority)
+template <std::size_t MemPoolSize_, unsigned Services_>
+int Node<MemPoolSize_, Services_>::start(const TransferPriority priority)
 {
     if (started_)
     {
@@ -291,7 +368,7 @@ int Node<MemPoolSize_>::start(const TransferPriority priority)
     {
         goto fail;
     }
-    res = proto_logger_.init();
+    res = proto_logger_.start();
     if (res < 0)
     {
         goto fail;
@@ -22,6 +22,51 @@ class UAVCAN_EXPORT Publisher : protected GenericPublisher<DataType_, DataType_>
 public:
     typedef DataType_ DataType; ///< Message data type
 
+    /**
+     * Message that has been encoded once with @ref prepare() and can be broadcast many times without being encoded
+     * again. This suits periodic messages that are mostly constant between publications: the fields that change
+     * can be overwritten in place, as long as they are among the leading primitive fields, which are located at
+     * constant offsets; the poke_*() accessors of the lazy view of the generated type do exactly that:
+     *
+     *      Publisher<MyMessage>::PreparedMessage prepared;
+     *      publisher.prepare(msg, prepared);
+     *      ...
+     *      prepared.patch(&MyMessage::LazyView::poke_counter, counter);
+     *      publisher.broadcast(prepared);
+     *
+     * The other fields must not be changed this way, because that may change the length of the message;
+     * use @ref prepare() again instead.
+     */
+    class PreparedMessage : Noncopyable
+    {
+        friend class Publisher;
+
+        typename BaseType::EncodedBuffer buffer_;
+        bool valid_;
+
+    public:
+        PreparedMessage() : valid_(false) { }
+
+        bool isValid() const { return valid_; }
+
+        /**
+         * Overwrites one field of the encoded message.
+         * Returns negative error code, zero if the field lies beyond the message, or positive on success.
+         */
+        template <typename FieldValue>
+        int patch(int (*poker)(uint8_t* data, unsigned len, const FieldValue& value), const FieldValue& value)
+        {
+            UAVCAN_ASSERT(poker != UAVCAN_NULLPTR);
+            if (!valid_)
+            {
+                return -ErrInvalidParam;
+            }
+            return poker(buffer_.getRawPtr(), buffer_.getMaxWritePos(), value);
+        }
+
+        const typename BaseType::EncodedBuffer& getBuffer() const { return buffer_; }
+    };
+
     /**
      * @param node          Node instance this publisher will be registered with.
      *
@@ -47,7 +92,8 @@ public:
 
     /**
      * Broadcast the message.
-     * Returns negative error code.
+     * Returns negative error code; zero if skipped due to @ref setMinPublicationInterval() or
+     * @ref setMaxSilenceInterval().
      */
     int broadcast(const DataType& message)
     {
@@ -65,6 +111,36 @@ public:
         return BaseType::publish(message, TransferTypeMessageBroadcast, NodeID::Broadcast, tid);
     }
 
+    /**
+     * Encodes the message into a @ref PreparedMessage for this publisher.
+     * Returns negative error code.
+     */
+    int prepare(const DataType& message, PreparedMessage& out_prepared)
+    {
+        const int res = BaseType::encode(message, out_prepared.buffer_);
+        out_prepared.valid_ = res >= 0;
+        return res;
+    }
+
+    /**
+     * Broadcast the message that has been encoded with @ref prepare().
+     * Returns negative error code; zero if skipped due to @ref setMinPublicationInterval() or
+     * @ref setMaxSilenceInterval().
+     */
+    int broadcast(const PreparedMessage& prepared)
+    {
+        if (!prepared.valid_)
+        {
+            return -ErrInvalidParam;
+        }
+        const int res = BaseType::init();
+        if (res < 0)
+        {
+            return res;
+        }
+        return BaseType::publishEncoded(prepared.buffer_, TransferTypeMessageBroadcast, NodeID::Broadcast);
+    }
+
     static MonotonicDuration getDefaultTxTimeout() { return MonotonicDuration::fromMSec(100); }
 
     /**
@@ -81,6 +157,14 @@ public:
     using BaseType::setTxTimeout;
     using BaseType::getPriority;
     using BaseType::setPriority;
+    using BaseType::isCoalescing;
+    using BaseType::setCoalescing;
+    using BaseType::getMinPublicationInterval;
+    using BaseType::setMinPublicationInterval;
+    using BaseType::getMaxSilenceInterval;
+    using BaseType::setMaxSilenceInterval;
+    using BaseType::reserveTxQueueMemory;
+    using BaseType::getNumReservedTxQueueBlocks;
     using BaseType::getNode;
 };
 
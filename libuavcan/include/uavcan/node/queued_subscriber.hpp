@@ -0,0 +1,381 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_QUEUED_SUBSCRIBER_HPP_INCLUDED
+#define UAVCAN_NODE_QUEUED_SUBSCRIBER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/dynamic_memory.hpp>
+#include <uavcan/node/generic_subscriber.hpp>
+#include <uavcan/node/scheduler.hpp>
+
+#if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
+# error UAVCAN_CPP_VERSION
+#endif
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+# include <functional>
+# include <uavcan/util/inplace_function.hpp>
+#endif
+
+namespace uavcan
+{
+/**
+ * Use this class to subscribe to a message when the application can't afford to process the messages right in the
+ * reception path. Received messages are decoded and put into a bounded queue instead of being passed to the callback
+ * immediately, so that a slow callback does not hold up the processing of the other incoming frames. The queue is
+ * drained by the application with @ref drain() or @ref peek() / @ref pop(), or automatically by the scheduler
+ * after the frames received within the same spin iteration have been processed, see @ref setAutoDrain().
+ *
+ * Every queued message takes one allocation of QueueEntrySize bytes, which is normally served by the node's
+ * memory pool. Since decoded messages are often larger than a pool block, a dedicated allocator can be provided
+ * instead. When the queue is full or the allocation fails, a message is discarded according to the overflow policy.
+ *
+ * The queue is not thread safe; it must be drained from the thread that spins the node.
+ *
+ * @tparam DataType_        Message data type.
+ *
+ * @tparam Callback_        Refer to @ref Subscriber.
+ *
+ * @tparam TransferListener_    Refer to @ref Subscriber.
+ */
+template <typename DataType_,
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+          typename Callback_ = DefaultCallback<void (const ReceivedDataStructure<DataType_>&)>,
+#else
+          typename Callback_ = void (*)(const ReceivedDataStructure<DataType_>&),
+#endif
+          typename TransferListener_ = TransferListener
+          >
+class UAVCAN_EXPORT QueuedSubscriber
+    : public GenericSubscriber<DataType_, DataType_, TransferListener_>
+{
+public:
+    typedef Callback_ Callback;
+    typedef DataType_ DataType;
+
+    enum OverflowPolicy
+    {
+        DropOldest,     ///< The oldest queued message is discarded to make room for the new one
+        DropNewest      ///< The new message is discarded
+    };
+
+private:
+    typedef GenericSubscriber<DataType_, DataType_, TransferListener_> BaseType;
+    typedef QueuedSubscriber<DataType_, Callback_, TransferListener_> SelfType;
+    typedef typename BaseType::ReceivedDataStructureSpec ReceivedDataStructureSpec;
+
+    struct Entry : Noncopyable
+    {
+        Entry* next;
+        StoredIncomingTransfer transfer;
+        ReceivedDataStructureSpec msg;
+
+        explicit Entry(const ReceivedDataStructure<DataType>& source)
+            : next(UAVCAN_NULLPTR)
+            , transfer(source)
+            , msg(&transfer)
+        {
+            static_cast<DataType&>(msg) = source;
+        }
+    };
+
+    class DeliveryHandler : public DeadlineHandler
+    {
+        SelfType& owner_;
+
+        virtual void handleDeadline(MonotonicTime) override { (void)owner_.drain(); }
+
+    public:
+        DeliveryHandler(SelfType& owner, Scheduler& scheduler)
+            : DeadlineHandler(scheduler)
+            , owner_(owner)
+        { }
+    };
+
+    TaggedPoolAllocator allocator_;
+    Entry* head_;
+    Entry* tail_;
+    uint16_t size_;
+    uint16_t capacity_;
+    OverflowPolicy policy_;
+    bool auto_drain_;
+    uint32_t num_dropped_;
+    Callback callback_;
+    DeliveryHandler delivery_handler_;
+
+    Entry* unlinkFront();
+    void destroyEntry(Entry* entry);
+
+    virtual void handleReceivedDataStruct(ReceivedDataStructure<DataType>& msg) override;
+
+public:
+    enum { QueueEntrySize = sizeof(Entry) };
+
+    /**
+     * @param node              The node the subscription belongs to; the queue is allocated from its pool.
+     * @param capacity          Maximum number of queued messages.
+     * @param policy            What to discard when the queue is full.
+     */
+    QueuedSubscriber(INode& node, uint16_t capacity, OverflowPolicy policy = DropOldest)
+        : BaseType(node)
+        , allocator_(node.getAllocator(), PoolUsageTagRxQueue)
+        , head_(UAVCAN_NULLPTR)
+        , tail_(UAVCAN_NULLPTR)
+        , size_(0)
+        , capacity_(capacity)
+        , policy_(policy)
+        , auto_drain_(false)
+        , num_dropped_(0)
+        , callback_()
+        , delivery_handler_(*this, node.getScheduler())
+    {
+        StaticAssert<DataTypeKind(DataType::DataTypeKind) == DataTypeKindMessage>::check();
+    }
+
+    /**
+     * Same as above, but the queue is allocated from the given allocator, which must be able to serve
+     * allocations of QueueEntrySize bytes.
+     */
+    QueuedSubscriber(INode& node, IPoolAllocator& queue_allocator, uint16_t capacity,
+                     OverflowPolicy policy = DropOldest)
+        : BaseType(node)
+        , allocator_(queue_allocator, PoolUsageTagRxQueue)
+        , head_(UAVCAN_NULLPTR)
+        , tail_(UAVCAN_NULLPTR)
+        , size_(0)
+        , capacity_(capacity)
+        , policy_(policy)
+        , auto_drain_(false)
+        , num_dropped_(0)
+        , callback_()
+        , delivery_handler_(*this, node.getScheduler())
+    {
+        StaticAssert<DataTypeKind(DataType::DataTypeKind) == DataTypeKindMessage>::check();
+    }
+
+    virtual ~QueuedSubscriber()
+    {
+        BaseType::stop();
+        clear();
+    }
+
+    /**
+     * Begin receiving messages.
+     * The messages will be queued and passed to the application via the callback when the queue is drained.
+     * Returns negative error code.
+     */
+    int start(const Callback& callback)
+    {
+        BaseType::stop();
+
+        if (!coerceOrFallback<bool>(callback, true))
+        {
+            UAVCAN_TRACE("QueuedSubscriber", "Invalid callback");
+            return -ErrInvalidParam;
+        }
+        callback_ = callback;
+
+        return BaseType::startAsMessageListener();
+    }
+
+    /**
+     * Passes the queued messages to the callback, oldest first. The callback may receive new messages and drain
+     * the queue recursively. Stopping the subscription does not discard the messages that are already queued.
+     *
+     * @param max_messages      Maximum number of messages to deliver; zero means the whole queue.
+     *
+     * Returns the number of messages delivered.
+     */
+    unsigned drain(unsigned max_messages = 0);
+
+    /**
+     * Returns the oldest queued message without removing it from the queue, or null if the queue is empty.
+     * The message stays valid until it is removed with @ref pop(), @ref clear(), or @ref drain().
+     */
+    ReceivedDataStructure<DataType>* peek() { return (head_ == UAVCAN_NULLPTR) ? UAVCAN_NULLPTR : &head_->msg; }
+
+    /**
+     * Removes the oldest queued message without delivering it. Does nothing if the queue is empty.
+     */
+    void pop();
+
+    /**
+     * Discards all queued messages; they are not counted as dropped.
+     */
+    void clear();
+
+    /**
+     * If enabled, the queue is drained by the scheduler as soon as the ongoing spin iteration has processed the
+     * received frames, so that the messages received in a burst are passed to the callback in one batch.
+     * This option is disabled by default.
+     */
+    bool isAutoDrainEnabled() const { return auto_drain_; }
+    void setAutoDrain(bool enabled);
+
+    uint16_t getQueueSize() const { return size_; }
+
+    /**
+     * Reducing the capacity below the current size of the queue discards the oldest messages.
+     */
+    uint16_t getQueueCapacity() const { return capacity_; }
+    void setQueueCapacity(uint16_t capacity);
+
+    OverflowPolicy getOverflowPolicy() const { return policy_; }
+    void setOverflowPolicy(OverflowPolicy policy) { policy_ = policy; }
+
+    /**
+     * Returns the number of messages that were discarded because the queue was full or there was no memory.
+     */
+    uint32_t getNumDroppedMessages() const { return num_dropped_; }
+
+    using BaseType::allowAnonymousTransfers;
+    using BaseType::stop;
+    using BaseType::getFailureCount;
+    using BaseType::reservePoolBlocks;
+};
+
+// ----------------------------------------------------------------------------
+
+template <typename DataType_, typename Callback_, typename TransferListener_>
+typename QueuedSubscriber<DataType_, Callback_, TransferListener_>::Entry*
+QueuedSubscriber<DataType_, Callback_, TransferListener_>::unlinkFront()
+{
+    Entry* const entry = head_;
+    if (entry != UAVCAN_NULLPTR)
+    {
+        head_ = entry->next;
+        if (head_ == UAVCAN_NULLPTR)
+        {
+            tail_ = UAVCAN_NULLPTR;
+        }
+        UAVCAN_ASSERT(size_ > 0);
+        size_--;
+    }
+    return entry;
+}
+
+template <typename DataType_, typename Callback_, typename TransferListener_>
+void QueuedSubscriber<DataType_, Callback_, TransferListener_>::destroyEntry(Entry* entry)
+{
+    entry->~Entry();
+    allocator_.deallocate(entry);
+}
+
+template <typename DataType_, typename Callback_, typename TransferListener_>
+void QueuedSubscriber<DataType_, Callback_, TransferListener_>::
+handleReceivedDataStruct(ReceivedDataStructure<DataType>& msg)
+{
+    if (size_ >= capacity_)
+    {
+        num_dropped_++;
+        if ((policy_ == DropNewest) || (head_ == UAVCAN_NULLPTR))
+        {
+            UAVCAN_TRACE("QueuedSubscriber", "Queue full, message dropped [%s]", DataType::getDataTypeFullName());
+            return;
+        }
+        destroyEntry(unlinkFront());
+    }
+
+    void* mem = allocator_.allocate(sizeof(Entry));
+    if ((mem == UAVCAN_NULLPTR) && (policy_ == DropOldest) && (head_ != UAVCAN_NULLPTR))
+    {
+        num_dropped_++;
+        destroyEntry(unlinkFront());
+        mem = allocator_.allocate(sizeof(Entry));
+    }
+    if (mem == UAVCAN_NULLPTR)
+    {
+        UAVCAN_TRACE("QueuedSubscriber", "No memory, message dropped [%s]", DataType::getDataTypeFullName());
+        num_dropped_++;
+        return;
+    }
+
+    Entry* const entry = new (mem) Entry(msg);
+    if (tail_ == UAVCAN_NULLPTR)
+    {
+        head_ = entry;
+    }
+    else
+    {
+        tail_->next = entry;
+    }
+    tail_ = entry;
+    size_++;
+
+    if (auto_drain_ && !delivery_handler_.isRunning())
+    {
+        delivery_handler_.generateDeadlineImmediately();
+    }
+}
+
+template <typename DataType_, typename Callback_, typename TransferListener_>
+unsigned QueuedSubscriber<DataType_, Callback_, TransferListener_>::drain(unsigned max_messages)
+{
+    unsigned num_delivered = 0;
+    while ((head_ != UAVCAN_NULLPTR) && ((max_messages == 0) || (num_delivered < max_messages)))
+    {
+        Entry* const entry = unlinkFront();     // Unlinked first, so that the callback can use the queue freely
+        if (coerceOrFallback<bool>(callback_, true))
+        {
+            callback_(entry->msg);
+        }
+        else
+        {
+            handleFatalError("QSub clbk");
+        }
+        destroyEntry(entry);
+        num_delivered++;
+    }
+    return num_delivered;
+}
+
+template <typename DataType_, typename Callback_, typename TransferListener_>
+void QueuedSubscriber<DataType_, Callback_, TransferListener_>::pop()
+{
+    Entry* const entry = unlinkFront();
+    if (entry != UAVCAN_NULLPTR)
+    {
+        destroyEntry(entry);
+    }
+}
+
+template <typename DataType_, typename Callback_, typename TransferListener_>
+void QueuedSubscriber<DataType_, Callback_, TransferListener_>::clear()
+{
+    while (head_ != UAVCAN_NULLPTR)
+    {
+        pop();
+    }
+    delivery_handler_.stop();
+}
+
+template <typename DataType_, typename Callback_, typename TransferListener_>
+void QueuedSubscriber<DataType_, Callback_, TransferListener_>::setAutoDrain(bool enabled)
+{
+    auto_drain_ = enabled;
+    if (!enabled)
+    {
+        delivery_handler_.stop();
+    }
+    else if (head_ != UAVCAN_NULLPTR)
+    {
+        delivery_handler_.generateDeadlineImmediately();
+    }
+}
+
+template <typename DataType_, typename Callback_, typename TransferListener_>
+void QueuedSubscriber<DataType_, Callback_, TransferListener_>::setQueueCapacity(uint16_t capacity)
+{
+    capacity_ = capacity;
+    while (size_ > capacity_)
+    {
+        num_dropped_++;
+        pop();
+    }
+}
+
+}
+
+#endif // UAVCAN_NODE_QUEUED_SUBSCRIBER_HPP_INCLUDED
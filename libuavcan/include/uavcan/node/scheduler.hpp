@@ -8,22 +8,38 @@
 #include <uavcan/error.hpp>
 #include <uavcan/util/linked_list.hpp>
 #include <uavcan/transport/dispatcher.hpp>
+#include <uavcan/node/handler_profiler.hpp>
+#include <uavcan/node/executor.hpp>
 
 namespace uavcan
 {
 
 class UAVCAN_EXPORT Scheduler;
 
-class UAVCAN_EXPORT DeadlineHandler : public LinkedListNode<DeadlineHandler>
+class UAVCAN_EXPORT DeadlineHandler
+#if UAVCAN_SCHEDULER_TIMER_WHEEL
+    : public DoublyLinkedListNode<DeadlineHandler>
+#else
+    : public LinkedListNode<DeadlineHandler>
+#endif
 {
+    friend class DeadlineScheduler;
+
     MonotonicTime deadline_;
+    MonotonicDuration slack_;
+#if UAVCAN_SCHEDULER_TIMER_WHEEL
+    DoublyLinkedListRoot<DeadlineHandler>* slot_;       ///< Null if not running
+#endif
+#if UAVCAN_HANDLER_PROFILING
+    HandlerProfile handler_profile_;
+#endif
+
+    void invokeHandler(MonotonicTime current);
 
 protected:
     Scheduler& scheduler_;
 
-    explicit DeadlineHandler(Scheduler& scheduler)
-        : scheduler_(scheduler)
-    { }
+    explicit DeadlineHandler(Scheduler& scheduler);
 
     virtual ~DeadlineHandler() { stop(); }
 
@@ -40,21 +56,180 @@ public:
 
     MonotonicTime getDeadline() const { return deadline_; }
     Scheduler& getScheduler() const { return scheduler_; }
+
+    /**
+     * How late the handler may be invoked past its deadline, zero by default.
+     * The handler is still invoked by the first scheduler wakeup after the deadline, but the scheduler won't wake up
+     * just for it until the slack has elapsed, so that the handlers whose slack windows overlap are invoked together.
+     * This matters in the event driven mode, where the scheduler sleeps until the next deadline; e.g. a few periodic
+     * housekeeping timers with a small slack will share one wakeup instead of waking the CPU up one by one.
+     * If the handler is running, the new slack takes effect immediately. Negative values are treated as zero.
+     */
+    MonotonicDuration getSlack() const { return slack_; }
+    void setSlack(MonotonicDuration slack);
+
+#if UAVCAN_HANDLER_PROFILING
+    /**
+     * Execution statistics of this handler, see @ref HandlerProfiler.
+     */
+    HandlerProfile& getHandlerProfile() { return handler_profile_; }
+    const HandlerProfile& getHandlerProfile() const { return handler_profile_; }
+#endif
 };
 
 
+/**
+ * Keeps the running deadline handlers and invokes them when their deadlines are reached.
+ * The backend is selected with @ref UAVCAN_SCHEDULER_TIMER_WHEEL.
+ *
+ * The timer wheel has several levels of slots; the slots of the level zero are one tick wide, and every next level
+ * is SlotsPerLevel times coarser. A handler is placed into a slot by the distance from the current tick to its
+ * deadline, and the coarse slots are redistributed to the finer levels as the current tick reaches them.
+ * The handlers of the same tick are invoked in the order of their deadlines; the handlers with equal deadlines may
+ * be invoked in any order.
+ */
 class UAVCAN_EXPORT DeadlineScheduler : Noncopyable
 {
+#if UAVCAN_SCHEDULER_TIMER_WHEEL
+    enum { LevelBits = 6 };
+    enum { SlotsPerLevel = 1U << LevelBits };
+    enum { NumLevels = 4 };
+
+    typedef DoublyLinkedListRoot<DeadlineHandler> Slot;
+
+    Slot slots_[NumLevels][SlotsPerLevel];
+    uint64_t current_tick_;                     ///< All ticks before this one have been processed
+    unsigned num_handlers_;
+    unsigned num_slack_handlers_;               ///< Running handlers with nonzero slack
+
+    static uint64_t getTickOf(MonotonicTime ts)
+    {
+        return ts.toUSec() / uint64_t(UAVCAN_SCHEDULER_TIMER_WHEEL_TICK_USEC);
+    }
+
+    void place(DeadlineHandler* mdh);
+    void cascade(unsigned level);
+    void jumpTo(uint64_t tick);
+    DeadlineHandler* popDue(MonotonicTime ts);
+    static DeadlineHandler* findEarliest(const Slot& slot);
+#else
     LinkedListRoot<DeadlineHandler> handlers_;  // Ordered by deadline, lowest first
+#endif
 
 public:
+#if UAVCAN_SCHEDULER_TIMER_WHEEL
+    DeadlineScheduler()
+        : current_tick_(0)
+        , num_handlers_(0)
+        , num_slack_handlers_(0)
+    { }
+#endif
+
     void add(DeadlineHandler* mdh);
     void remove(DeadlineHandler* mdh);
     bool doesExist(const DeadlineHandler* mdh) const;
+#if UAVCAN_SCHEDULER_TIMER_WHEEL
+    unsigned getNumHandlers() const { return num_handlers_; }
+#else
     unsigned getNumHandlers() const { return handlers_.getLength(); }
+#endif
 
     MonotonicTime pollAndGetMonotonicTime(ISystemClock& sysclock);
+
+    /**
+     * Same as above, but invokes no more than the specified number of due handlers; the rest are left for the next
+     * call. The returned time is sampled after the last invoked handler.
+     */
+    MonotonicTime pollAndGetMonotonicTime(ISystemClock& sysclock, unsigned max_handlers);
     MonotonicTime getEarliestDeadline() const;
+
+    /**
+     * Earliest time when some handler must be invoked, i.e. the lowest deadline plus slack.
+     * The scheduler doesn't need to wake up before that.
+     */
+    MonotonicTime getEarliestWakeup() const;
+};
+
+/**
+ * Limits of the work done by one iteration (slice) of Scheduler::spin(MonotonicTime, const SpinBudget&).
+ * Every slice processes the received frames, then the due deadline handlers, then the cleanup, each within its
+ * limit, so that none of them can starve the others under load. The defaults are unlimited.
+ */
+struct UAVCAN_EXPORT SpinBudget
+{
+    unsigned max_frames;                    ///< Received CAN frames, including loopback
+    MonotonicDuration max_rx_duration;      ///< Time spent in the RX phase, including waiting for frames
+    unsigned max_deadline_handlers;         ///< Deadline handlers (timers, service call timeouts, ...)
+
+    SpinBudget()
+        : max_frames(NumericTraits<unsigned>::max())
+        , max_rx_duration(MonotonicDuration::getInfinite())
+        , max_deadline_handlers(NumericTraits<unsigned>::max())
+    { }
+};
+
+/**
+ * Implement this interface to be notified when the memory pool usage crosses the watermarks,
+ * see @ref Scheduler::setPoolWatermarks(). Applications that produce bulk traffic (e.g. file transfers) can use it
+ * to back off before the pool is exhausted and the library starts dropping frames.
+ */
+class UAVCAN_EXPORT IPoolPressureListener
+{
+public:
+    virtual ~IPoolPressureListener() { }
+
+    /**
+     * Called from spin() when the usage reaches the high watermark (true), after the cleanup it has triggered,
+     * and when the usage drops back to the low watermark (false).
+     */
+    virtual void handlePoolPressure(bool high) = 0;
+};
+
+/**
+ * Distributes the phases of the periodic timers of the node over their periods, so that the timers started at the
+ * same time with the same period don't fire at once and publish bursts of transfers that fill the TX queue.
+ * The period is divided into @ref NumBins phases; every timer takes the phase with the least total weight, where
+ * the weight is the cost of the work done by the timer, e.g. the number of CAN frames it publishes.
+ * The phases are relative to the monotonic time rather than to the start of the timer, see
+ * TimerBase::startPeriodicSpread(). Timers of different periods are spread as well, but only approximately.
+ */
+class UAVCAN_EXPORT PeriodicPhaseAllocator : Noncopyable
+{
+public:
+    enum { NumBins = UAVCAN_SCHEDULER_PHASE_BINS };
+
+private:
+    uint32_t loads_[NumBins];
+
+    static uint8_t reverseBinIndex(uint8_t index);
+
+public:
+    PeriodicPhaseAllocator()
+    {
+        fill_n(loads_, unsigned(NumBins), 0U);
+    }
+
+    /**
+     * Takes the least loaded phase. Equally loaded phases are taken in the bit-reversed order (0, 1/2, 1/4, 3/4, ...
+     * of the period), so that the phases of a few timers of equal weight are far apart.
+     * @return          Phase index, to be released with @ref release().
+     */
+    uint8_t allocate(uint16_t weight);
+
+    void release(uint8_t bin, uint16_t weight);
+
+    /**
+     * Offset of the phase from the start of the period.
+     */
+    static MonotonicDuration computeOffset(uint8_t bin, MonotonicDuration period)
+    {
+        return MonotonicDuration::fromUSec((period.toUSec() / NumBins) * bin);
+    }
+
+    /**
+     * Total weight of the timers that hold the phase.
+     */
+    uint32_t getLoad(uint8_t bin) const { return (bin < NumBins) ? loads_[bin] : 0; }
 };
 
 /**
@@ -71,11 +246,26 @@ class UAVCAN_EXPORT Scheduler : Noncopyable
     enum { MaxCleanupPeriodMs = 10000 };
 
     DeadlineScheduler deadline_scheduler_;
+    PeriodicPhaseAllocator phase_allocator_;
     Dispatcher dispatcher_;
+    IPoolAllocator& allocator_;
+    IPoolPressureListener* pool_pressure_listener_;
+#if UAVCAN_HANDLER_PROFILING
+    HandlerProfiler handler_profiler_;
+#endif
+    InlineExecutor inline_executor_;
+    IExecutor* executor_;
+    unsigned num_pending_tasks_;
     MonotonicTime prev_cleanup_ts_;
     MonotonicDuration deadline_resolution_;
     MonotonicDuration cleanup_period_;
+    uint8_t cleanup_slice_;
+    uint16_t pool_high_watermark_;          ///< Zero if the monitoring is disabled
+    uint16_t pool_low_watermark_;
+    uint32_t num_pool_pressure_events_;
+    bool pool_pressure_;
     bool inside_spin_;
+    bool event_driven_;
 
     struct InsideSpinSetter
     {
@@ -88,16 +278,35 @@ class UAVCAN_EXPORT Scheduler : Noncopyable
         ~InsideSpinSetter() { owner.inside_spin_ = false; }
     };
 
-    MonotonicTime computeDispatcherSpinDeadline(MonotonicTime spin_deadline) const;
+    friend class DeadlineHandler;
+
+    MonotonicTime computeDispatcherSpinDeadline(MonotonicTime spin_deadline, MonotonicTime current) const;
+    MonotonicDuration getCleanupSlicePeriod() const;
+    void handleDeadlineHandlerStart(MonotonicTime deadline);
+    void pollPoolWatermarks(MonotonicTime mono_ts);
     void pollCleanup(MonotonicTime mono_ts, uint32_t num_frames_processed_with_last_spin);
+    void pollExecutor();
 
 public:
     Scheduler(ICanDriver& can_driver, IPoolAllocator& allocator, ISystemClock& sysclock)
         : dispatcher_(can_driver, allocator, sysclock)
+        , allocator_(allocator)
+        , pool_pressure_listener_(UAVCAN_NULLPTR)
+#if UAVCAN_HANDLER_PROFILING
+        , handler_profiler_(sysclock)
+#endif
+        , executor_(&inline_executor_)
+        , num_pending_tasks_(0)
         , prev_cleanup_ts_(sysclock.getMonotonic())
         , deadline_resolution_(MonotonicDuration::fromMSec(DefaultDeadlineResolutionMs))
         , cleanup_period_(MonotonicDuration::fromMSec(DefaultCleanupPeriodMs))
+        , cleanup_slice_(0)
+        , pool_high_watermark_(0)
+        , pool_low_watermark_(0)
+        , num_pool_pressure_events_(0)
+        , pool_pressure_(false)
         , inside_spin_(false)
+        , event_driven_(false)
     { }
 
     /**
@@ -107,6 +316,15 @@ public:
      */
     int spin(MonotonicTime deadline);
 
+    /**
+     * Same as above, but the work is done in slices bounded by the budget, see @ref SpinBudget.
+     * Unlike the plain spin(), the cleanup is not postponed when the node is busy receiving frames, since the
+     * amount of RX work between cleanups is bounded already. This is intended for the applications that have to
+     * guarantee the latency of other tasks sharing the CPU, e.g. in an RTOS.
+     * Returns the number of processed frames or negative error code.
+     */
+    int spin(MonotonicTime deadline, const SpinBudget& budget);
+
     /**
      * Non-blocking version of @ref spin() - spins until all pending frames and events are processed,
      * or until some error occurs. If there's nothing to do, returns immediately.
@@ -114,11 +332,48 @@ public:
      */
     int spinOnce();
 
+    /**
+     * Integration with an external event loop (epoll, asio, libuv, ...), which replaces @ref spin() and saves
+     * the application a dedicated thread or periodic polling. The loop watches the CAN interfaces of the driver
+     * (e.g. the file descriptors of SocketCAN) for reading, and for writing as well for the interfaces reported by
+     * @ref getIfacesAwaitingWrite(); it also arms a timer for @ref getNextDeadline(). Whenever an interface is ready
+     * or the timer expires, the loop calls @ref processReady(), which does the work without blocking:
+     *
+     *     MonotonicTime next_deadline;
+     *     node.processReady(next_deadline);
+     *     timer.expires_at(to_host_time(next_deadline));
+     *     watch_fds(node.getScheduler().getIfacesAwaitingWrite());
+     *
+     * The deadline and the masks have to be obtained again after every call, and after the application has
+     * started a timer, called a service or published something outside of processReady().
+     */
+    MonotonicTime getNextDeadline() const;
+
+    /**
+     * Bit mask of the interfaces that have frames waiting for transmission, bit position defines the index.
+     */
+    uint8_t getIfacesAwaitingWrite() const { return dispatcher_.getCanIOManager().makePendingTxMask(); }
+
+    /**
+     * Same as @ref spinOnce(), but also reports the time when it has to be called next if no interface becomes
+     * ready before, same as @ref getNextDeadline().
+     * Returns negative error code.
+     */
+    int processReady(MonotonicTime& out_next_deadline);
+
     DeadlineScheduler& getDeadlineScheduler() { return deadline_scheduler_; }
 
+    PeriodicPhaseAllocator& getPhaseAllocator()             { return phase_allocator_; }
+    const PeriodicPhaseAllocator& getPhaseAllocator() const { return phase_allocator_; }
+
     Dispatcher& getDispatcher()             { return dispatcher_; }
     const Dispatcher& getDispatcher() const { return dispatcher_; }
 
+#if UAVCAN_HANDLER_PROFILING
+    HandlerProfiler& getHandlerProfiler()             { return handler_profiler_; }
+    const HandlerProfiler& getHandlerProfiler() const { return handler_profiler_; }
+#endif
+
     ISystemClock& getSystemClock()         { return dispatcher_.getSystemClock(); }
     MonotonicTime getMonotonicTime() const { return dispatcher_.getSystemClock().getMonotonic(); }
     UtcTime getUtcTime()             const { return dispatcher_.getSystemClock().getUtc(); }
@@ -136,9 +391,21 @@ public:
     }
 
     /**
-     * How often the scheduler will run cleanup (listeners, outgoing transfer registry, ...).
+     * In the event driven mode, the scheduler blocks in the driver until the next frame, the earliest deadline or
+     * the next cleanup, whichever comes first, instead of waking up every deadline resolution period. This reduces
+     * idle CPU usage and the deadline callback jitter, but relies on the driver to honor the blocking deadline of
+     * ICanDriver::select() precisely. Deadline handlers started from the frame reception callbacks take effect as
+     * soon as the callback returns.
+     * This mode is disabled by default.
+     */
+    bool isEventDriven() const { return event_driven_; }
+    void setEventDriven(bool enabled) { event_driven_ = enabled; }
+
+    /**
+     * How often the scheduler will run cleanup (listeners, outgoing transfer registry, CAN TX queues, ...).
      * Cleanup execution time grows linearly with number of listeners and number of items
-     * in the Outgoing Transfer ID registry.
+     * in the Outgoing Transfer ID registry. The listeners are cleaned up in @ref UAVCAN_SCHEDULER_CLEANUP_SLICES
+     * slices evenly spread over the period.
      * Lower period increases CPU usage.
      */
     MonotonicDuration getCleanupPeriod() const { return cleanup_period_; }
@@ -148,6 +415,62 @@ public:
         period = max(period, MonotonicDuration::fromMSec(MinCleanupPeriodMs));
         cleanup_period_ = period;
     }
+
+    /**
+     * Memory pressure monitoring, based on @ref IPoolAllocator::getNumUsedBlocks() of the allocator of the node.
+     * Once the number of used blocks reaches the high watermark, the scheduler immediately cleans up everything
+     * at once: timed out transfer receivers, expired TX queue entries and stale outgoing transfer registry entries.
+     * Until the usage drops to the low watermark, the cleanup runs with the regular period no matter how many
+     * frames are being processed. The listener, if any, is notified about both transitions.
+     * The usage is checked once per iteration of spin(). The monitoring is disabled by default.
+     *
+     * @param high_blocks   High watermark in blocks, zero disables the monitoring.
+     * @param low_blocks    Low watermark in blocks, clamped to the high watermark.
+     */
+    void setPoolWatermarks(uint16_t high_blocks, uint16_t low_blocks)
+    {
+        pool_high_watermark_ = high_blocks;
+        pool_low_watermark_ = min(low_blocks, high_blocks);
+        if (pool_high_watermark_ == 0)
+        {
+            pool_pressure_ = false;
+        }
+    }
+    uint16_t getPoolHighWatermark() const { return pool_high_watermark_; }
+    uint16_t getPoolLowWatermark() const { return pool_low_watermark_; }
+
+    void setPoolPressureListener(IPoolPressureListener* listener) { pool_pressure_listener_ = listener; }
+    IPoolPressureListener* getPoolPressureListener() const { return pool_pressure_listener_; }
+
+    /**
+     * Whether the usage has reached the high watermark and has not dropped to the low watermark since.
+     */
+    bool isUnderPoolPressure() const { return pool_pressure_; }
+
+    /**
+     * Number of times the usage has reached the high watermark.
+     */
+    uint32_t getNumPoolPressureEvents() const { return num_pool_pressure_events_; }
+
+    /**
+     * Runs the task off the node thread with the executor, see @ref ExecutorTask. The completions are polled once
+     * per iteration of spin(); while there are pending tasks, the scheduler wakes up at least once per deadline
+     * resolution period even in the event driven mode, so the completion latency is bounded by that period.
+     * Returns negative error code; -ErrLogic if the task is already pending.
+     */
+    int post(ExecutorTask& task);
+
+    /**
+     * The executor can be replaced only while there are no pending tasks; null restores the default one, which
+     * is @ref InlineExecutor. Returns negative error code.
+     */
+    int setExecutor(IExecutor* executor);
+    IExecutor& getExecutor() { return *executor_; }
+
+    /**
+     * Number of the tasks that have been posted and not completed yet.
+     */
+    unsigned getNumPendingTasks() const { return num_pending_tasks_; }
 };
 
 }
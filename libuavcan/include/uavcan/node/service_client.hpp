@@ -16,6 +16,7 @@
 
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
 # include <functional>
+# include <uavcan/util/inplace_function.hpp>
 #endif
 
 namespace uavcan
@@ -113,6 +114,10 @@ static Stream& operator<<(Stream& s, const ServiceCallResult<DataType>& scr)
 
 /**
  * Do not use directly.
+ *
+ * Pending calls are linked into a list sorted by deadline, so that only the earliest deadline needs to be watched
+ * by the scheduler, and they are also placed into a hash table keyed by call ID, so that received response frames
+ * can be matched against the pending calls in constant time. See @ref UAVCAN_SERVICE_CLIENT_CALL_INDEX_CAPACITY.
  */
 class ServiceClientBase : protected ITransferAcceptanceFilter
                         , protected DeadlineHandler
@@ -120,30 +125,37 @@ class ServiceClientBase : protected ITransferAcceptanceFilter
     const DataTypeDescriptor* data_type_descriptor_;  ///< This will be initialized at the time of first call
 
 protected:
-    class CallState : DeadlineHandler
+    class CallState : public DoublyLinkedListNode<CallState>
     {
         ServiceClientBase& owner_;
+        const MonotonicTime started_at_;
+        const MonotonicTime deadline_;
         const ServiceCallID id_;
         bool timed_out_;
 
-        virtual void handleDeadline(MonotonicTime) override;
+        friend class ServiceClientBase;
 
     public:
         CallState(INode& node, ServiceClientBase& owner, ServiceCallID call_id)
-            : DeadlineHandler(node.getScheduler())
-            , owner_(owner)
+            : owner_(owner)
+            , started_at_(node.getMonotonicTime())
+            , deadline_(started_at_ + owner.getRequestTimeoutFor(call_id.server_node_id))
             , id_(call_id)
             , timed_out_(false)
         {
             UAVCAN_ASSERT(id_.isValid());
-            DeadlineHandler::startWithDelay(owner_.request_timeout_);
+            owner_.registerCall(*this);
         }
 
+        ~CallState() { owner_.unregisterCall(*this); }
+
         ServiceCallID getCallID() const { return id_; }
 
-        bool hasTimedOut() const { return timed_out_; }
+        MonotonicTime getStartTime() const { return started_at_; }
 
-        static bool hasTimedOutPredicate(const CallState& cs) { return cs.hasTimedOut(); }
+        MonotonicTime getDeadline() const { return deadline_; }
+
+        bool hasTimedOut() const { return timed_out_; }
 
         bool operator==(const CallState& rhs) const
         {
@@ -158,6 +170,17 @@ protected:
         bool operator()(const CallState& state) const { return (state.getCallID() == id) && !state.hasTimedOut(); }
     };
 
+    struct CallStateIdentityPredicate
+    {
+        const CallState* const ptr;
+        const bool timed_out;
+        CallStateIdentityPredicate(const CallState* reference, bool arg_timed_out)
+            : ptr(reference)
+            , timed_out(arg_timed_out)
+        { }
+        bool operator()(const CallState& state) const { return (&state == ptr) && (state.hasTimedOut() == timed_out); }
+    };
+
     struct ServerSearchPredicate
     {
         const NodeID server_node_id;
@@ -165,18 +188,114 @@ protected:
         bool operator()(const CallState& state) const { return state.getCallID().server_node_id == server_node_id; }
     };
 
+private:
+    DoublyLinkedListRoot<CallState> calls_by_deadline_;     ///< Calls that have not timed out yet, earliest first
+
+    /**
+     * Transfer ID state of the recently called servers, direct-mapped by server node ID.
+     */
+    enum { TransferIDCacheSize = UAVCAN_TINY ? 1 : 4 };
+    OutgoingTransferRegistry::EntryCache otr_cache_[TransferIDCacheSize];
+
+#if UAVCAN_SERVICE_CLIENT_CALL_INDEX_CAPACITY > 0
+    enum { CallIndexCapacity = UAVCAN_SERVICE_CLIENT_CALL_INDEX_CAPACITY };
+    enum { CallIndexMaxSize = (CallIndexCapacity * 3) / 4 };
+
+    CallState* call_index_[CallIndexCapacity];              ///< Open addressing with linear probing
+    uint16_t call_index_size_;
+    bool call_index_overflow_;                              ///< Some of the calls are not indexed
+
+    static unsigned computeCallIndexSlot(ServiceCallID call_id);
+
+    void addIndexedCall(CallState& state);
+    void removeIndexedCall(const CallState& state);
+#endif
+
+    /**
+     * Round trip time statistics of the recently called servers, direct-mapped by server node ID.
+     * The estimation follows RFC 6298.
+     */
+    struct RttEstimate
+    {
+        uint32_t srtt_usec;             ///< Zero if there are no samples yet
+        uint32_t rttvar_usec;
+        uint8_t server_node_id;         ///< Zero if the entry is unused
+        uint8_t backoff;                ///< Number of consecutive timeouts; each one doubles the timeout
+
+        RttEstimate()
+            : srtt_usec(0)
+            , rttvar_usec(0)
+            , server_node_id(0)
+            , backoff(0)
+        { }
+    };
+
+    enum { RttTableSize = UAVCAN_TINY ? 1 : 4 };
+    enum { MaxRttBackoff = 6 };
+    RttEstimate rtt_table_[RttTableSize];
+    bool adaptive_request_timeout_;
+
+    const RttEstimate* findRttEstimate(NodeID server_node_id) const;
+
+    void registerCall(CallState& state);
+    void unregisterCall(CallState& state);
+    void removeFromDeadlineOrder(CallState& state);
+
+protected:
     MonotonicDuration request_timeout_;
 
     ServiceClientBase(INode& node)
         : DeadlineHandler(node.getScheduler())
         , data_type_descriptor_(UAVCAN_NULLPTR)
+#if UAVCAN_SERVICE_CLIENT_CALL_INDEX_CAPACITY > 0
+        , call_index_size_(0)
+        , call_index_overflow_(false)
+#endif
+        , adaptive_request_timeout_(false)
         , request_timeout_(getDefaultRequestTimeout())
-    { }
+    {
+#if UAVCAN_SERVICE_CLIENT_CALL_INDEX_CAPACITY > 0
+        fill_n(call_index_, unsigned(CallIndexCapacity), static_cast<CallState*>(UAVCAN_NULLPTR));
+#endif
+    }
 
-    virtual ~ServiceClientBase() { }
+    virtual ~ServiceClientBase() { UAVCAN_ASSERT(calls_by_deadline_.isEmpty()); }
 
     int prepareToCall(INode& node, const char* dtname, NodeID server_node_id, ServiceCallID& out_call_id);
 
+    /**
+     * Returns false if the index cannot be relied upon, in which case the call registry has to be searched instead.
+     */
+    bool isCallIndexUsable() const
+    {
+#if UAVCAN_SERVICE_CLIENT_CALL_INDEX_CAPACITY > 0
+        return !call_index_overflow_;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * Looks up a call that has not timed out yet. Must not be used unless @ref isCallIndexUsable() returns true.
+     */
+    const CallState* findIndexedCall(ServiceCallID call_id) const;
+
+    /**
+     * Marks the earliest call as timed out and returns it if its deadline has been reached, otherwise returns null.
+     * The timed out call remains allocated in the registry; it is no longer matched to incoming responses.
+     */
+    const CallState* popTimedOutCall(MonotonicTime current);
+
+    /**
+     * Restarts the timer for the earliest call, if there are any pending calls.
+     */
+    void scheduleNextTimeout();
+
+    /**
+     * Feeds the round trip time of a successful call into the estimator of its server.
+     */
+    void registerResponse(const CallState& state, MonotonicTime response_ts);
+
 public:
     /**
      * It's not recommended to override default timeouts.
@@ -185,13 +304,53 @@ public:
     static MonotonicDuration getDefaultRequestTimeout() { return MonotonicDuration::fromMSec(1000); }
     static MonotonicDuration getMinRequestTimeout() { return MonotonicDuration::fromMSec(10); }
     static MonotonicDuration getMaxRequestTimeout() { return MonotonicDuration::fromMSec(60000); }
+
+    /**
+     * Adaptive request timeouts. If enabled, the timeout of a new call is derived from the round trip times of
+     * the previous calls to the same server (smoothed RTT plus four times its variance, as in RFC 6298), so that
+     * a lost request or response is detected long before the configured request timeout, which becomes the upper
+     * limit. Every timeout doubles the timeout of the next call to the server, up to the limit, until a response
+     * is received. The configured timeout is used for the servers that have not responded yet.
+     * Only a few recently called servers are tracked; they share the slots by node ID. Disabled by default.
+     */
+    bool isAdaptiveRequestTimeoutEnabled() const { return adaptive_request_timeout_; }
+    void setAdaptiveRequestTimeout(bool enable) { adaptive_request_timeout_ = enable; }
+
+    /**
+     * Smoothed round trip time of the calls to the given server; zero if it is not known.
+     * The statistics are collected regardless of whether the adaptive timeouts are enabled.
+     */
+    MonotonicDuration getSmoothedRtt(NodeID server_node_id) const;
+
+    /**
+     * Timeout the next call to the given server will use.
+     */
+    MonotonicDuration getRequestTimeoutFor(NodeID server_node_id) const;
+};
+
+/**
+ * Storage of the pending calls of @ref ServiceClient.
+ * If the static capacity is zero, the calls are allocated in the pool; otherwise they are stored in the object.
+ */
+template <typename CallStateType, unsigned StaticCapacity>
+class UAVCAN_EXPORT ServiceCallRegistry : public StaticMultiset<CallStateType, StaticCapacity>
+{
+public:
+    explicit ServiceCallRegistry(IPoolAllocator&) { }
+};
+
+template <typename CallStateType>
+class UAVCAN_EXPORT ServiceCallRegistry<CallStateType, 0> : public Multiset<CallStateType>
+{
+public:
+    explicit ServiceCallRegistry(IPoolAllocator& allocator) : Multiset<CallStateType>(allocator) { }
 };
 
 /**
  * Use this class to invoke services on remote nodes.
  *
  * This class can manage multiple concurrent calls to the same or different remote servers. Number of concurrent
- * calls is limited only by amount of available pool memory.
+ * calls is limited only by amount of available pool memory, unless the static capacity is specified (see below).
  *
  * Note that the reference passed to the callback points to a stack-allocated object, which means that the
  * reference invalidates once the callback returns. If you want to use this object after the callback execution,
@@ -203,16 +362,21 @@ public:
  * @tparam DataType_        Service data type.
  *
  * @tparam Callback_        Service response will be delivered through the callback of this type.
- *                          In C++11 mode this type defaults to std::function<>.
+ *                          In C++11 mode this type defaults to @ref DefaultCallback<>.
  *                          In C++03 mode this type defaults to a plain function pointer; use binder to
  *                          call member functions as callbacks.
+ *
+ * @tparam NumStaticCalls_  If nonzero, the pending calls are kept in the object itself rather than in the memory
+ *                          pool, and no more than this number of concurrent calls can be made. Zero by default,
+ *                          which means that the number of concurrent calls is limited only by the pool.
  */
 template <typename DataType_,
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
-          typename Callback_ = std::function<void (const ServiceCallResult<DataType_>&)>
+          typename Callback_ = DefaultCallback<void (const ServiceCallResult<DataType_>&)>
 #else
           typename Callback_ = void (*)(const ServiceCallResult<DataType_>&)
 #endif
+          , unsigned NumStaticCalls_ = 0
           >
 class UAVCAN_EXPORT ServiceClient
     : public GenericSubscriber<DataType_,
@@ -227,11 +391,16 @@ public:
     typedef Callback_ Callback;
 
 private:
-    typedef ServiceClient<DataType, Callback> SelfType;
+    typedef ServiceClient<DataType, Callback, NumStaticCalls_> SelfType;
     typedef GenericPublisher<DataType, RequestType> PublisherType;
+
+public:
+    typedef typename PublisherType::EncodedBuffer EncodedRequest;
+
+private:
     typedef GenericSubscriber<DataType, ResponseType, TransferListenerWithFilter> SubscriberType;
 
-    typedef Multiset<CallState> CallRegistry;
+    typedef ServiceCallRegistry<CallState, NumStaticCalls_> CallRegistry;
 
     struct TimeoutCallbackCaller
     {
@@ -239,24 +408,42 @@ private:
 
         TimeoutCallbackCaller(ServiceClient& arg_owner) : owner(arg_owner) { }
 
-        void operator()(const CallState& state)
+        void operator()(ServiceCallID call_id)
         {
-            if (state.hasTimedOut())
+            UAVCAN_TRACE("ServiceClient::TimeoutCallbackCaller", "Timeout from nid=%d, tid=%d, dtname=%s",
+                         int(call_id.server_node_id.get()), int(call_id.transfer_id.get()),
+                         DataType::getDataTypeFullName());
+
+            typename SubscriberType::ArenaDataStructure arena_struct(owner.SubscriberType::getNode(),
+                                                                     UAVCAN_NULLPTR);
+            if (arena_struct.get() != UAVCAN_NULLPTR)
+            {
+                invoke(call_id, *arena_struct.get());
+            }
+            else
             {
-                UAVCAN_TRACE("ServiceClient::TimeoutCallbackCaller", "Timeout from nid=%d, tid=%d, dtname=%s",
-                             int(state.getCallID().server_node_id.get()), int(state.getCallID().transfer_id.get()),
-                             DataType::getDataTypeFullName());
+                invokeOnStack(call_id);
+            }
+        }
 
-                typename SubscriberType::ReceivedDataStructureSpec rx_struct; // Default-initialized
+        void invoke(ServiceCallID call_id, ReceivedDataStructure<ResponseType>& rx_struct)
+        {
+            ServiceCallResultType result(ServiceCallResultType::ErrorTimeout, call_id, rx_struct);    // Mutable!
 
-                ServiceCallResultType result(ServiceCallResultType::ErrorTimeout, state.getCallID(),
-                                             rx_struct);    // Mutable!
+            owner.invokeCallback(result);
+        }
 
-                owner.invokeCallback(result);
-            }
+#if __GNUC__
+        __attribute__ ((noinline))
+#endif
+        void invokeOnStack(ServiceCallID call_id)
+        {
+            typename SubscriberType::ReceivedDataStructureSpec rx_struct; // Default-initialized
+            invoke(call_id, rx_struct);
         }
     };
 
+    TaggedPoolAllocator call_registry_allocator_;
     CallRegistry call_registry_;
 
     PublisherType publisher_;
@@ -272,15 +459,22 @@ private:
 
     int addCallState(ServiceCallID call_id);
 
+    int beginCall(NodeID server_node_id, ServiceCallID& out_call_id);
+
+    const CallState* findCall(ServiceCallID call_id) const;
+
 public:
     /**
-     * @param node      Node instance this client will be registered with.
-     * @param callback  Callback instance. Optional, can be assigned later.
+     * @param node            Node instance this client will be registered with.
+     * @param callback        Callback instance. Optional, can be assigned later.
+     * @param force_std_can   Send the requests in classic CAN frames even if CAN FD is enabled or the server is
+     *                        known to support it, see @ref Dispatcher::shouldUseCanFd().
      */
     explicit ServiceClient(INode& node, const Callback& callback = Callback(), bool force_std_can = false)
         : SubscriberType(node)
         , ServiceClientBase(node)
-        , call_registry_(node.getAllocator())
+        , call_registry_allocator_(node.getAllocator(), PoolUsageTagServiceCallRegistry)
+        , call_registry_(call_registry_allocator_)
         , publisher_(node, force_std_can, getDefaultRequestTimeout())
         , callback_(callback)
     {
@@ -330,6 +524,21 @@ public:
      */
     int call(NodeID server_node_id, const RequestType& request, ServiceCallID& out_call_id);
 
+    /**
+     * Serializes the request once, so that the same request can be sent to many servers with @ref callEncoded()
+     * without encoding it again for every server. See also @ref ServiceFanOut.
+     * Returns negative error code.
+     */
+    int encodeRequest(const RequestType& request, EncodedRequest& out_encoded)
+    {
+        return publisher_.encode(request, out_encoded);
+    }
+
+    /**
+     * Same as @ref call(), but takes the request encoded with @ref encodeRequest() by this client.
+     */
+    int callEncoded(NodeID server_node_id, const EncodedRequest& encoded_request, ServiceCallID& out_call_id);
+
     /**
      * Cancels certain call referred via call ID structure.
      */
@@ -376,6 +585,16 @@ public:
      */
     uint32_t getResponseFailureCount() const { return SubscriberType::getFailureCount(); }
 
+    /**
+     * Allocates the receiver for the responses of the given server in advance, so that the first response does not
+     * depend on the state of the memory pool, see @ref TransferListener::preregisterSource().
+     * Returns negative error code.
+     */
+    int preregisterServer(NodeID server_node_id)
+    {
+        return SubscriberType::preregisterSource(server_node_id, TransferTypeServiceResponse);
+    }
+
     /**
      * Request timeouts. Note that changing the request timeout will not affect calls that are already pending.
      * There is no such config as TX timeout - TX timeouts are configured automagically according to request timeouts.
@@ -402,8 +621,8 @@ public:
 
 // ----------------------------------------------------------------------------
 
-template <typename DataType_, typename Callback_>
-void ServiceClient<DataType_, Callback_>::invokeCallback(ServiceCallResultType& result)
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+void ServiceClient<DataType_, Callback_, NumStaticCalls_>::invokeCallback(ServiceCallResultType& result)
 {
     if (coerceOrFallback<bool>(callback_, true))
     {
@@ -415,42 +634,49 @@ void ServiceClient<DataType_, Callback_>::invokeCallback(ServiceCallResultType&
     }
 }
 
-template <typename DataType_, typename Callback_>
-bool ServiceClient<DataType_, Callback_>::shouldAcceptFrame(const RxFrame& frame) const
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+bool ServiceClient<DataType_, Callback_, NumStaticCalls_>::shouldAcceptFrame(const RxFrame& frame) const
 {
     UAVCAN_ASSERT(frame.getTransferType() == TransferTypeServiceResponse); // Other types filtered out by dispatcher
 
-    return UAVCAN_NULLPTR != call_registry_.find(CallStateMatchingPredicate(ServiceCallID(frame.getSrcNodeID(),
-                                                                                          frame.getTransferID())));
-
+    return UAVCAN_NULLPTR != findCall(ServiceCallID(frame.getSrcNodeID(), frame.getTransferID()));
 }
 
-template <typename DataType_, typename Callback_>
-void ServiceClient<DataType_, Callback_>::handleReceivedDataStruct(ReceivedDataStructure<ResponseType>& response)
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+void ServiceClient<DataType_, Callback_, NumStaticCalls_>::handleReceivedDataStruct(
+    ReceivedDataStructure<ResponseType>& response)
 {
     UAVCAN_ASSERT(response.getTransferType() == TransferTypeServiceResponse);
 
     ServiceCallID call_id(response.getSrcNodeID(), response.getTransferID());
+    const CallState* const state = findCall(call_id);
+    if (state != UAVCAN_NULLPTR)
+    {
+        registerResponse(*state, response.getMonotonicTimestamp());
+    }
     cancelCall(call_id);
     ServiceCallResultType result(ServiceCallResultType::Success, call_id, response);    // Mutable!
     invokeCallback(result);
 }
 
 
-template <typename DataType_, typename Callback_>
-void ServiceClient<DataType_, Callback_>::handleDeadline(MonotonicTime)
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+void ServiceClient<DataType_, Callback_, NumStaticCalls_>::handleDeadline(MonotonicTime current)
 {
     UAVCAN_TRACE("ServiceClient", "Shared deadline event received");
     /*
-     * Invoking callbacks for timed out call state objects.
+     * The calls are ordered by deadline, so only the timed out ones are visited here.
+     * The timed out call state is kept in the registry while its callback is running, which is why the number
+     * of pending calls does not change until the callback returns. The callback may make new calls or cancel
+     * the existing ones, so the state is looked up again before removal.
      */
     TimeoutCallbackCaller callback_caller(*this);
-    call_registry_.template forEach<TimeoutCallbackCaller&>(callback_caller);
-    /*
-     * Removing timed out objects.
-     * This operation cannot be merged with the previous one because that will not work with recursive calls.
-     */
-    call_registry_.removeAllWhere(&CallState::hasTimedOutPredicate);
+    while (const CallState* const state = popTimedOutCall(current))
+    {
+        callback_caller(state->getCallID());
+        call_registry_.removeFirstWhere(CallStateIdentityPredicate(state, true));
+    }
+    scheduleNextTimeout();
     /*
      * Subscriber does not need to be registered if we don't have any pending calls.
      * Removing it makes processing of incoming frames a bit faster.
@@ -461,8 +687,8 @@ void ServiceClient<DataType_, Callback_>::handleDeadline(MonotonicTime)
     }
 }
 
-template <typename DataType_, typename Callback_>
-int ServiceClient<DataType_, Callback_>::addCallState(ServiceCallID call_id)
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+int ServiceClient<DataType_, Callback_, NumStaticCalls_>::addCallState(ServiceCallID call_id)
 {
     if (call_registry_.isEmpty())
     {
@@ -484,16 +710,26 @@ int ServiceClient<DataType_, Callback_>::addCallState(ServiceCallID call_id)
     return 0;
 }
 
-template <typename DataType_, typename Callback_>
-int ServiceClient<DataType_, Callback_>::call(NodeID server_node_id, const RequestType& request)
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+const typename ServiceClient<DataType_, Callback_, NumStaticCalls_>::CallState*
+ServiceClient<DataType_, Callback_, NumStaticCalls_>::findCall(ServiceCallID call_id) const
+{
+    if (isCallIndexUsable())
+    {
+        return findIndexedCall(call_id);
+    }
+    return call_registry_.find(CallStateMatchingPredicate(call_id));
+}
+
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+int ServiceClient<DataType_, Callback_, NumStaticCalls_>::call(NodeID server_node_id, const RequestType& request)
 {
    ServiceCallID dummy;
    return call(server_node_id, request, dummy);
 }
 
-template <typename DataType_, typename Callback_>
-int ServiceClient<DataType_, Callback_>::call(NodeID server_node_id, const RequestType& request,
-                                              ServiceCallID& out_call_id)
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+int ServiceClient<DataType_, Callback_, NumStaticCalls_>::beginCall(NodeID server_node_id, ServiceCallID& out_call_id)
 {
     if (!coerceOrFallback<bool>(callback_, true))
     {
@@ -535,6 +771,19 @@ int ServiceClient<DataType_, Callback_>::call(NodeID server_node_id, const Reque
     }
     tl->installAcceptanceFilter(this);
 
+    return 0;
+}
+
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+int ServiceClient<DataType_, Callback_, NumStaticCalls_>::call(NodeID server_node_id, const RequestType& request,
+                                              ServiceCallID& out_call_id)
+{
+    const int begin_res = beginCall(server_node_id, out_call_id);
+    if (begin_res < 0)
+    {
+        return begin_res;
+    }
+
     /*
      * Publishing the request
      */
@@ -550,31 +799,58 @@ int ServiceClient<DataType_, Callback_>::call(NodeID server_node_id, const Reque
     return publisher_res;
 }
 
-template <typename DataType_, typename Callback_>
-void ServiceClient<DataType_, Callback_>::cancelCall(ServiceCallID call_id)
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+int ServiceClient<DataType_, Callback_, NumStaticCalls_>::callEncoded(NodeID server_node_id,
+                                                                      const EncodedRequest& encoded_request,
+                                                                      ServiceCallID& out_call_id)
 {
-    call_registry_.removeFirstWhere(CallStateMatchingPredicate(call_id));
+    const int begin_res = beginCall(server_node_id, out_call_id);
+    if (begin_res < 0)
+    {
+        return begin_res;
+    }
+
+    const int publisher_res = publisher_.publishEncoded(encoded_request, TransferTypeServiceRequest, server_node_id,
+                                                        out_call_id.transfer_id);
+    if (publisher_res < 0)
+    {
+        cancelCall(out_call_id);
+        return publisher_res;
+    }
+
+    UAVCAN_ASSERT(server_node_id == out_call_id.server_node_id);
+    return publisher_res;
+}
+
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+void ServiceClient<DataType_, Callback_, NumStaticCalls_>::cancelCall(ServiceCallID call_id)
+{
+    const CallState* const state = findCall(call_id);
+    if (state != UAVCAN_NULLPTR)
+    {
+        call_registry_.removeFirstWhere(CallStateIdentityPredicate(state, false));
+    }
     if (call_registry_.isEmpty())
     {
         SubscriberType::stop();
     }
 }
 
-template <typename DataType_, typename Callback_>
-void ServiceClient<DataType_, Callback_>::cancelAllCalls()
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+void ServiceClient<DataType_, Callback_, NumStaticCalls_>::cancelAllCalls()
 {
     call_registry_.clear();
     SubscriberType::stop();
 }
 
-template <typename DataType_, typename Callback_>
-bool ServiceClient<DataType_, Callback_>::hasPendingCallToServer(NodeID server_node_id) const
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+bool ServiceClient<DataType_, Callback_, NumStaticCalls_>::hasPendingCallToServer(NodeID server_node_id) const
 {
     return UAVCAN_NULLPTR != call_registry_.find(ServerSearchPredicate(server_node_id));
 }
 
-template <typename DataType_, typename Callback_>
-ServiceCallID ServiceClient<DataType_, Callback_>::getCallIDByIndex(unsigned index) const
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+ServiceCallID ServiceClient<DataType_, Callback_, NumStaticCalls_>::getCallIDByIndex(unsigned index) const
 {
     const CallState* const id = call_registry_.getByIndex(index);
     return (id == UAVCAN_NULLPTR) ? ServiceCallID() : id->getCallID();
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_SERVICE_FAN_OUT_HPP_INCLUDED
+#define UAVCAN_NODE_SERVICE_FAN_OUT_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/node/service_client.hpp>
+#include <uavcan/transport/node_id_set.hpp>
+#include <uavcan/util/method_binder.hpp>
+
+#if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
+# error UAVCAN_CPP_VERSION
+#endif
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+# include <functional>
+# include <uavcan/util/inplace_function.hpp>
+#endif
+
+namespace uavcan
+{
+/**
+ * Use this class to send the same service request to a set of servers, e.g. to query or restart every node
+ * in the network. The request is encoded only once, and the number of calls that are in flight at the same time
+ * can be limited in order to avoid flooding the bus and the TX queues; the remaining servers are called as soon as
+ * the previous calls complete. The outcome is tracked per server, so the application can see which servers have
+ * responded, which have timed out, and which could not be called at all.
+ *
+ * The callback is invoked for every call separately, the same way as with @ref ServiceClient. It may start
+ * a new round with @ref start().
+ *
+ * @tparam DataType_        Service data type.
+ *
+ * @tparam Callback_        Refer to @ref ServiceClient. The callback is optional.
+ *
+ * @tparam NumStaticCalls_  Refer to @ref ServiceClient; should not be less than the in-flight window.
+ */
+template <typename DataType_,
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+          typename Callback_ = DefaultCallback<void (const ServiceCallResult<DataType_>&)>
+#else
+          typename Callback_ = void (*)(const ServiceCallResult<DataType_>&)
+#endif
+          , unsigned NumStaticCalls_ = 0
+          >
+class UAVCAN_EXPORT ServiceFanOut : Noncopyable
+{
+public:
+    typedef DataType_ DataType;
+    typedef typename DataType::Request RequestType;
+    typedef ServiceCallResult<DataType> ServiceCallResultType;
+    typedef Callback_ Callback;
+
+    enum NodeStatus
+    {
+        NotRequested,       ///< Not in the set of servers of the current round
+        Queued,             ///< Waiting for a free slot in the in-flight window
+        Pending,            ///< Request sent, waiting for the response
+        Success,
+        ErrorTimeout,
+        ErrorSend           ///< The request could not be sent, e.g. due to lack of memory
+    };
+
+private:
+    typedef ServiceFanOut<DataType, Callback, NumStaticCalls_> SelfType;
+
+    void handleResult(const ServiceCallResultType& result);
+
+public:
+    typedef MethodBinder<SelfType*, void (SelfType::*)(const ServiceCallResultType&)> ClientCallback;
+    typedef ServiceClient<DataType, ClientCallback, NumStaticCalls_> ServiceClientType;
+
+private:
+    ServiceClientType client_;
+    typename ServiceClientType::EncodedRequest request_;
+    NodeIDSet queued_;
+    NodeIDSet pending_;
+    NodeIDSet succeeded_;
+    NodeIDSet timed_out_;
+    NodeIDSet send_failed_;
+    Callback callback_;
+    unsigned max_in_flight_;
+
+    void sendQueued();
+
+public:
+    explicit ServiceFanOut(INode& node, const Callback& callback = Callback(), bool force_std_can = false)
+        : client_(node, ClientCallback(this, &SelfType::handleResult), force_std_can)
+        , callback_(callback)
+        , max_in_flight_(0)
+    { }
+
+    /**
+     * Refer to @ref ServiceClient::init().
+     */
+    int init() { return client_.init(); }
+    int init(TransferPriority priority) { return client_.init(priority); }
+
+    /**
+     * Starts a new round of calls; the round that is still in progress, if any, is cancelled.
+     * The servers are called in ascending order of node ID.
+     *
+     * @param server_node_ids   Servers to call. Calls to the local node ID or the broadcast node ID end up as
+     *                          @ref ErrorSend.
+     * @param request           The request; it's encoded immediately and need not be kept by the caller.
+     * @param max_in_flight     Maximum number of concurrent calls; zero means that all servers are called at once.
+     *
+     * Returns negative error code if the request could not be encoded; otherwise the number of servers that have
+     * been called immediately, which can be less than the number of servers if some calls failed.
+     */
+    int start(const NodeIDSet& server_node_ids, const RequestType& request, unsigned max_in_flight = 0);
+
+    /**
+     * Cancels the pending calls; the servers that have not responded yet are reported as not requested.
+     */
+    void cancel();
+
+    /**
+     * True when every server of the current round has either responded or failed.
+     */
+    bool isFinished() const { return queued_.isEmpty() && pending_.isEmpty(); }
+
+    NodeStatus getNodeStatus(NodeID server_node_id) const;
+
+    const NodeIDSet& getSucceededNodes() const { return succeeded_; }
+    const NodeIDSet& getTimedOutNodes() const { return timed_out_; }
+    const NodeIDSet& getSendFailedNodes() const { return send_failed_; }
+
+    const Callback& getCallback() const { return callback_; }
+    void setCallback(const Callback& cb) { callback_ = cb; }
+
+    /**
+     * Gives access to the timeout and priority settings of the underlying client.
+     * Its callback must not be changed, and calls must not be made with it directly.
+     */
+    ServiceClientType& getServiceClient() { return client_; }
+    const ServiceClientType& getServiceClient() const { return client_; }
+};
+
+// ----------------------------------------------------------------------------
+
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+void ServiceFanOut<DataType_, Callback_, NumStaticCalls_>::sendQueued()
+{
+    while (!queued_.isEmpty() && ((max_in_flight_ == 0) || (pending_.getSize() < max_in_flight_)))
+    {
+        const NodeID server_node_id = queued_.getFirst();
+        queued_.remove(server_node_id);
+
+        ServiceCallID call_id;
+        const int res = client_.callEncoded(server_node_id, request_, call_id);
+        if (res < 0)
+        {
+            UAVCAN_TRACE("ServiceFanOut", "Failed to call nid=%d, error: %i", int(server_node_id.get()), res);
+            send_failed_.add(server_node_id);
+        }
+        else
+        {
+            pending_.add(server_node_id);
+        }
+    }
+}
+
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+void ServiceFanOut<DataType_, Callback_, NumStaticCalls_>::handleResult(const ServiceCallResultType& result)
+{
+    const NodeID server_node_id = result.getCallID().server_node_id;
+    if (!pending_.contains(server_node_id))
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    pending_.remove(server_node_id);
+    if (result.isSuccessful())
+    {
+        succeeded_.add(server_node_id);
+    }
+    else
+    {
+        timed_out_.add(server_node_id);
+    }
+
+    sendQueued();
+
+    if (coerceOrFallback<bool>(callback_, true))
+    {
+        callback_(result);      // May start a new round, so this goes last
+    }
+}
+
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+int ServiceFanOut<DataType_, Callback_, NumStaticCalls_>::start(const NodeIDSet& server_node_ids,
+                                                                const RequestType& request, unsigned max_in_flight)
+{
+    cancel();
+    succeeded_.clear();
+    timed_out_.clear();
+    send_failed_.clear();
+
+    const int res = client_.encodeRequest(request, request_);
+    if (res < 0)
+    {
+        return res;
+    }
+
+    max_in_flight_ = max_in_flight;
+    queued_ = server_node_ids;
+    sendQueued();
+    return int(pending_.getSize());
+}
+
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+void ServiceFanOut<DataType_, Callback_, NumStaticCalls_>::cancel()
+{
+    client_.cancelAllCalls();
+    queued_.clear();
+    pending_.clear();
+}
+
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+typename ServiceFanOut<DataType_, Callback_, NumStaticCalls_>::NodeStatus
+ServiceFanOut<DataType_, Callback_, NumStaticCalls_>::getNodeStatus(NodeID server_node_id) const
+{
+    if (queued_.contains(server_node_id))
+    {
+        return Queued;
+    }
+    if (pending_.contains(server_node_id))
+    {
+        return Pending;
+    }
+    if (succeeded_.contains(server_node_id))
+    {
+        return Success;
+    }
+    if (timed_out_.contains(server_node_id))
+    {
+        return ErrorTimeout;
+    }
+    if (send_failed_.contains(server_node_id))
+    {
+        return ErrorSend;
+    }
+    return NotRequested;
+}
+
+}
+
+#endif // UAVCAN_NODE_SERVICE_FAN_OUT_HPP_INCLUDED
@@ -6,8 +6,10 @@
 #define UAVCAN_NODE_SERVICE_SERVER_HPP_INCLUDED
 
 #include <uavcan/build_config.hpp>
+#include <uavcan/dynamic_memory.hpp>
 #include <uavcan/node/generic_publisher.hpp>
 #include <uavcan/node/generic_subscriber.hpp>
+#include <uavcan/util/placement_new.hpp>
 
 #if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
 # error UAVCAN_CPP_VERSION
@@ -15,6 +17,7 @@
 
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
 # include <functional>
+# include <uavcan/util/inplace_function.hpp>
 #endif
 
 namespace uavcan
@@ -61,6 +64,220 @@ public:
     bool isResponseEnabled() const { return _enabled_; }
 };
 
+/**
+ * Response encoder passed to the callback of @ref DirectServiceServer. The callback writes the fields of the
+ * response one by one, in the order they are defined in DSDL, straight into the transfer buffer of the server;
+ * no response object is constructed and nothing is copied on the way.
+ *
+ * Byte arrays (uint8 or int8 elements) can be filled in place: @ref beginByteArray() returns a window of the
+ * maximum size located in the transfer buffer, so the data can be produced right there, e.g. read from a file,
+ * and @ref commitByteArray() completes the field once the actual length is known.
+ *
+ * Encoding errors are latched; if any field could not be written, the response is not sent.
+ */
+class UAVCAN_EXPORT ServiceResponseWriter : Noncopyable
+{
+    StaticTransferBufferImpl& buffer_;
+    BitStream stream_;
+    ScalarCodec codec_;
+    const TailArrayOptimizationMode tao_mode_;
+    unsigned window_max_len_;               ///< Of the byte array that is being filled in place, zero if none
+    uint8_t window_prefix_bitlen_;          ///< Length prefix of that array, zero if omitted
+    bool enabled_;
+    bool failed_;
+
+    uint8_t* openByteArrayWindow(unsigned max_len, unsigned prefix_bitlen);
+    int finishByteArray(unsigned len);
+
+    int checkResult(int res)
+    {
+        if (res <= 0)
+        {
+            failed_ = true;
+        }
+        return res;
+    }
+
+public:
+    ServiceResponseWriter(StaticTransferBufferImpl& buffer, TailArrayOptimizationMode tao_mode)
+        : buffer_(buffer)
+        , stream_(buffer)
+        , codec_(stream_)
+        , tao_mode_(tao_mode)
+        , window_max_len_(0)
+        , window_prefix_bitlen_(0)
+        , enabled_(true)
+        , failed_(false)
+    { }
+
+    /**
+     * Encodes the next field of the response. FieldType is the type from the FieldTypes of the generated response
+     * type, e.g. Response::FieldTypes::error; last_field must be set for the last field of the response.
+     * Returns negative error code, zero if the buffer is exhausted, or positive on success.
+     */
+    template <typename FieldType>
+    int encodeField(const typename StorageType<FieldType>::Type& value, bool last_field = false)
+    {
+        return checkResult(FieldType::encode(value, codec_, last_field ? tao_mode_ : TailArrayOptDisabled));
+    }
+
+    /**
+     * Starts the next field, which is a dynamic byte array of the given type, e.g. Response::FieldTypes::data.
+     * Returns a pointer to ArrayType::MaxSize bytes the elements should be written to, or null if the field
+     * can't be started. The field must be completed with @ref commitByteArray() before anything else is written.
+     */
+    template <typename ArrayType>
+    uint8_t* beginByteArray(bool last_field = false)
+    {
+        StaticAssert<unsigned(ArrayType::IsDynamic) != 0>::check();
+        StaticAssert<unsigned(ArrayType::RawValueType::MaxBitLen) == 8>::check();
+        // The length prefix is omitted only for the tail array, the same way as by the generated code
+        const bool prefixed = !(last_field && (tao_mode_ == TailArrayOptEnabled));
+        const unsigned prefix_bitlen = prefixed ? unsigned(IntegerBitLen<ArrayType::MaxSize>::Result) : 0U;
+        return openByteArrayWindow(ArrayType::MaxSize, prefix_bitlen);
+    }
+
+    /**
+     * Completes the byte array started with @ref beginByteArray(); len is the number of elements written.
+     * Returns negative error code, zero if the buffer is exhausted, or positive on success.
+     */
+    template <typename ArrayType>
+    int commitByteArray(unsigned len)
+    {
+        if ((window_max_len_ != unsigned(ArrayType::MaxSize)) || (len > window_max_len_))
+        {
+            UAVCAN_ASSERT(0);
+            failed_ = true;
+            return -ErrInvalidParam;
+        }
+        if (window_prefix_bitlen_ != 0)
+        {
+            const int res = codec_.encode<IntegerBitLen<ArrayType::MaxSize>::Result>(len);
+            if (res <= 0)
+            {
+                window_max_len_ = 0;
+                return checkResult(res);
+            }
+        }
+        return checkResult(finishByteArray(len));
+    }
+
+    /**
+     * Discards everything that has been written so far, including the errors, so that a different response can
+     * be written from scratch, e.g. one reporting an error instead of the data.
+     */
+    void restart();
+
+    /**
+     * Low level access, e.g. for scalar fields: getCodec().encode<16>(value).
+     * Errors reported by the codec are not latched.
+     */
+    ScalarCodec& getCodec() { return codec_; }
+
+    TailArrayOptimizationMode getTaoMode() const { return tao_mode_; }
+
+    /**
+     * Refer to @ref ServiceResponseDataStructure::setResponseEnabled().
+     */
+    void setResponseEnabled(bool x) { enabled_ = x; }
+    bool isResponseEnabled() const { return enabled_; }
+
+    /**
+     * True if some of the fields could not be encoded.
+     */
+    bool isFailed() const { return failed_; }
+};
+
+/**
+ * Identifies a request of @ref ServiceServer, the response to which has been deferred by the application.
+ * Default constructed token is invalid.
+ */
+class UAVCAN_EXPORT ServiceResponseToken
+{
+    uint32_t id_;
+
+public:
+    ServiceResponseToken() : id_(0) { }
+    explicit ServiceResponseToken(uint32_t id) : id_(id) { }
+
+    uint32_t get() const { return id_; }
+    bool isValid() const { return id_ != 0; }
+
+    bool operator==(const ServiceResponseToken& rhs) const { return id_ == rhs.id_; }
+    bool operator!=(const ServiceResponseToken& rhs) const { return id_ != rhs.id_; }
+};
+
+/**
+ * Internal for @ref ServiceServer.
+ * Keeps the metadata of the requests the responses to which have been deferred. The entries are allocated from
+ * the pool of the node one by one, and they are dropped once the requester would have stopped waiting.
+ */
+class UAVCAN_EXPORT DeferredServiceResponseTable : Noncopyable
+{
+public:
+    struct Entry
+    {
+        Entry* next;
+        MonotonicTime deadline;
+        uint32_t token;
+        TransferPriority priority;
+        TransferID transfer_id;
+        NodeID dst_node_id;
+    };
+
+    enum { DefaultCapacity = 4 };
+
+private:
+    IPoolAllocator& allocator_;
+    Entry* list_;
+    MonotonicDuration timeout_;
+    uint32_t last_token_;
+    uint32_t num_expired_;
+    uint16_t size_;
+    uint16_t capacity_;
+
+    void destroy(Entry* entry);
+    void removeExpired(MonotonicTime ts);
+
+public:
+    DeferredServiceResponseTable(IPoolAllocator& allocator, MonotonicDuration timeout)
+        : allocator_(allocator)
+        , list_(UAVCAN_NULLPTR)
+        , timeout_(timeout)
+        , last_token_(0)
+        , num_expired_(0)
+        , size_(0)
+        , capacity_(DefaultCapacity)
+    {
+        IsDynamicallyAllocatable<Entry>::check();
+    }
+
+    ~DeferredServiceResponseTable() { clear(); }
+
+    /**
+     * Returns an invalid token if the table is full or there is no memory.
+     */
+    ServiceResponseToken add(MonotonicTime ts, NodeID dst_node_id, TransferID transfer_id,
+                             TransferPriority priority);
+
+    /**
+     * Removes the entry; returns false if there is no such entry, e.g. because it has expired.
+     */
+    bool remove(ServiceResponseToken token, MonotonicTime ts, Entry& out_entry);
+
+    void clear();
+
+    uint16_t getSize() const { return size_; }
+
+    uint16_t getCapacity() const { return capacity_; }
+    void setCapacity(uint16_t capacity) { capacity_ = capacity; }
+
+    MonotonicDuration getTimeout() const { return timeout_; }
+    void setTimeout(MonotonicDuration timeout) { timeout_ = timeout; }
+
+    uint32_t getNumExpired() const { return num_expired_; }
+};
+
 /**
  * Use this class to implement UAVCAN service servers.
  *
@@ -74,13 +291,13 @@ public:
  *                          the reference to service response data struct passed to the callback always points
  *                          to a default initialized response object.
  *                          Please also refer to @ref ReceivedDataStructure<> and @ref ServiceResponseDataStructure<>.
- *                          In C++11 mode this type defaults to std::function<>.
+ *                          In C++11 mode this type defaults to @ref DefaultCallback<>.
  *                          In C++03 mode this type defaults to a plain function pointer; use binder to
  *                          call member functions as callbacks.
  */
 template <typename DataType_,
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
-          typename Callback_ = std::function<void (const ReceivedDataStructure<typename DataType_::Request>&,
+          typename Callback_ = DefaultCallback<void (const ReceivedDataStructure<typename DataType_::Request>&,
                                                    ServiceResponseDataStructure<typename DataType_::Response>&)>
 #else
           typename Callback_ = void (*)(const ReceivedDataStructure<typename DataType_::Request>&,
@@ -100,31 +317,82 @@ private:
     typedef GenericSubscriber<DataType, RequestType, TransferListener> SubscriberType;
     typedef GenericPublisher<DataType, ResponseType> PublisherType;
 
+    struct CacheEntry : Noncopyable
+    {
+        CacheEntry* next;
+        MonotonicTime deadline;
+        TailArrayOptimizationMode tao_mode;
+        RequestType request;
+        typename PublisherType::EncodedBuffer response;
+
+        CacheEntry()
+            : next(UAVCAN_NULLPTR)
+            , tao_mode(TailArrayOptEnabled)
+        { }
+    };
+
     PublisherType publisher_;
     Callback callback_;
     uint32_t response_failure_count_;
 
+    CacheEntry* cache_;                     ///< Most recent first
+    IPoolAllocator* cache_allocator_;       ///< Null if the cache is disabled
+    MonotonicDuration cache_ttl_;
+    uint16_t cache_size_;
+    uint16_t cache_capacity_;
+    uint32_t cache_hit_count_;
+
+    DeferredServiceResponseTable deferred_;
+    bool in_callback_;
+    bool response_deferred_;            ///< By the ongoing callback
+
+    void destroyCacheEntry(CacheEntry* entry)
+    {
+        entry->~CacheEntry();
+        cache_allocator_->deallocate(entry);
+        UAVCAN_ASSERT(cache_size_ > 0);
+        cache_size_--;
+    }
+
+    void dropOldestCacheEntry();
+    bool respondFromCache(const ReceivedDataStructure<RequestType>& request);
+    int cacheAndPublish(const ResponseType& response, const ReceivedDataStructure<RequestType>& request);
+
     virtual void handleReceivedDataStruct(ReceivedDataStructure<RequestType>& request) override
     {
         UAVCAN_ASSERT(request.getTransferType() == TransferTypeServiceRequest);
 
+        if ((cache_allocator_ != UAVCAN_NULLPTR) && respondFromCache(request))
+        {
+            return;
+        }
+
         ServiceResponseDataStructure<ResponseType> response;
 
         if (coerceOrFallback<bool>(callback_, true))
         {
             UAVCAN_ASSERT(response.isResponseEnabled());  // Enabled by default
+            in_callback_ = true;
+            response_deferred_ = false;
             callback_(request, response);
+            in_callback_ = false;
         }
         else
         {
             handleFatalError("Srv serv clbk");
         }
 
-        if (response.isResponseEnabled())
+        if (response_deferred_)
+        {
+            UAVCAN_TRACE("ServiceServer", "Response was deferred by the application");
+            response_deferred_ = false;
+        }
+        else if (response.isResponseEnabled())
         {
             publisher_.setPriority(request.getPriority());      // Responding at the same priority.
 
-            const int res = publisher_.publish(response, TransferTypeServiceResponse, request.getSrcNodeID(),
+            const int res = (cache_allocator_ != UAVCAN_NULLPTR) ? cacheAndPublish(response, request) :
+                            publisher_.publish(response, TransferTypeServiceResponse, request.getSrcNodeID(),
                                                request.getTransferID());
             if (res < 0)
             {
@@ -145,12 +413,30 @@ public:
         , publisher_(node, force_std_can, getDefaultTxTimeout())
         , callback_()
         , response_failure_count_(0)
+        , cache_(UAVCAN_NULLPTR)
+        , cache_allocator_(UAVCAN_NULLPTR)
+        , cache_size_(0)
+        , cache_capacity_(0)
+        , cache_hit_count_(0)
+        , deferred_(node.getAllocator(), getDefaultDeferredResponseTimeout())
+        , in_callback_(false)
+        , response_deferred_(false)
     {
         UAVCAN_ASSERT(getTxTimeout() == getDefaultTxTimeout());  // Making sure it is valid
 
         StaticAssert<DataTypeKind(DataType::DataTypeKind) == DataTypeKindService>::check();
+#if UAVCAN_HANDLER_PROFILING
+        SubscriberType::getHandlerProfile().setKind(HandlerProfile::KindServiceServer);
+#endif
     }
 
+    virtual ~ServiceServer() { disableResponseCache(); }
+
+    /**
+     * Size of the memory blocks that are allocated for the entries of the response cache.
+     */
+    enum { ResponseCacheEntrySize = sizeof(CacheEntry) };
+
     /**
      * Starts the server.
      * Incoming service requests will be passed to the application via the callback.
@@ -194,6 +480,396 @@ public:
      */
     uint32_t getRequestFailureCount() const { return SubscriberType::getFailureCount(); }
     uint32_t getResponseFailureCount() const { return response_failure_count_; }
+
+    /**
+     * Allocates the receiver for the requests of the given client in advance, so that the first request does not
+     * depend on the state of the memory pool, see @ref TransferListener::preregisterSource().
+     * Returns negative error code.
+     */
+    int preregisterClient(NodeID client_node_id)
+    {
+        return SubscriberType::preregisterSource(client_node_id, TransferTypeServiceRequest);
+    }
+
+    /**
+     * Enables the response cache, which is disabled by default. Once enabled, the encoded responses are kept for
+     * the given time, and the requests equal to one seen before are answered by sending its encoded response
+     * again, to the new requester and with the new transfer ID, without invoking the callback. This helps when
+     * many nodes ask for the same data, e.g. at boot time.
+     *
+     * Enable it only if the response depends on nothing but the request, in particular not on the identity of
+     * the requester; @ref invalidateResponseCache() should be called whenever the served data changes.
+     * The requests are compared in decoded form, so that a response can never be sent to a different request.
+     *
+     * @param allocator     The entries are allocated from it, blocks of @ref ResponseCacheEntrySize bytes.
+     * @param max_entries   Once reached, the oldest entry is replaced. Must be positive.
+     * @param ttl           Lifetime of an entry. Must be positive.
+     *
+     * Returns negative error code. The existing entries, if any, are discarded.
+     */
+    int enableResponseCache(IPoolAllocator& allocator, uint16_t max_entries, MonotonicDuration ttl)
+    {
+        if ((max_entries == 0) || !ttl.isPositive())
+        {
+            return -ErrInvalidParam;
+        }
+        disableResponseCache();
+        cache_allocator_ = &allocator;
+        cache_capacity_ = max_entries;
+        cache_ttl_ = ttl;
+        return 0;
+    }
+
+    void disableResponseCache()
+    {
+        invalidateResponseCache();
+        cache_allocator_ = UAVCAN_NULLPTR;
+        cache_capacity_ = 0;
+    }
+
+    bool isResponseCacheEnabled() const { return cache_allocator_ != UAVCAN_NULLPTR; }
+
+    /**
+     * Discards all cached responses, so that the following requests are served by the callback.
+     */
+    void invalidateResponseCache()
+    {
+        while (cache_ != UAVCAN_NULLPTR)
+        {
+            CacheEntry* const entry = cache_;
+            cache_ = entry->next;
+            destroyCacheEntry(entry);
+        }
+        UAVCAN_ASSERT(cache_size_ == 0);
+    }
+
+    uint16_t getResponseCacheSize() const { return cache_size_; }
+
+    /**
+     * Number of requests that have been answered from the cache.
+     */
+    uint32_t getResponseCacheHitCount() const { return cache_hit_count_; }
+
+    /**
+     * Can be called from the callback in order to respond later, e.g. once a slow operation has completed,
+     * instead of blocking the node until then. The response object passed to the callback is not sent then,
+     * and the application is expected to complete the request via @ref sendDeferredResponse() using the
+     * returned token, from the same thread that spins the node.
+     *
+     * The metadata of the request are kept in a table that is allocated from the pool of the node; see
+     * @ref setMaxDeferredResponses(). If the table is full or there is no memory, the returned token is invalid
+     * and the response must be filled in by the callback as usual.
+     *
+     * @param request       The request that has been passed to the callback.
+     */
+    ServiceResponseToken deferResponse(const ReceivedDataStructure<RequestType>& request)
+    {
+        if (!in_callback_)
+        {
+            UAVCAN_ASSERT(0);
+            return ServiceResponseToken();
+        }
+        const ServiceResponseToken token = deferred_.add(publisher_.getNode().getMonotonicTime(),
+                                                         request.getSrcNodeID(), request.getTransferID(),
+                                                         request.getPriority());
+        response_deferred_ = response_deferred_ || token.isValid();
+        return token;
+    }
+
+    /**
+     * Sends the response to a request deferred with @ref deferResponse().
+     * Returns negative error code; @ref ErrInvalidParam means that there is no such request, e.g. because it
+     * has been completed already or has expired, see @ref setDeferredResponseTimeout().
+     */
+    int sendDeferredResponse(ServiceResponseToken token, const ResponseType& response)
+    {
+        DeferredServiceResponseTable::Entry entry;
+        if (!deferred_.remove(token, publisher_.getNode().getMonotonicTime(), entry))
+        {
+            return -ErrInvalidParam;
+        }
+        publisher_.setPriority(entry.priority);
+        const int res = publisher_.publish(response, TransferTypeServiceResponse, entry.dst_node_id,
+                                           entry.transfer_id);
+        if (res < 0)
+        {
+            UAVCAN_TRACE("ServiceServer", "Deferred response publication failure: %i", res);
+            publisher_.getNode().getDispatcher().getTransferPerfCounter().addError();
+            response_failure_count_++;
+        }
+        return res;
+    }
+
+    /**
+     * Forgets a deferred request without responding to it. Returns false if there is no such request.
+     */
+    bool cancelDeferredResponse(ServiceResponseToken token)
+    {
+        DeferredServiceResponseTable::Entry entry;
+        return deferred_.remove(token, publisher_.getNode().getMonotonicTime(), entry);
+    }
+
+    /**
+     * Number of the deferred requests that have not been completed yet, including the expired ones that have
+     * not been cleaned up yet.
+     */
+    uint16_t getNumDeferredResponses() const { return deferred_.getSize(); }
+
+    /**
+     * Maximum number of simultaneously deferred requests, 4 by default.
+     */
+    uint16_t getMaxDeferredResponses() const { return deferred_.getCapacity(); }
+    void setMaxDeferredResponses(uint16_t num) { deferred_.setCapacity(num); }
+
+    /**
+     * A deferred request that has not been completed within this time is dropped, since the requester has
+     * stopped waiting for the response. The default matches the default timeout of @ref ServiceClient.
+     */
+    static MonotonicDuration getDefaultDeferredResponseTimeout() { return MonotonicDuration::fromMSec(1000); }
+    MonotonicDuration getDeferredResponseTimeout() const { return deferred_.getTimeout(); }
+    void setDeferredResponseTimeout(MonotonicDuration timeout) { deferred_.setTimeout(timeout); }
+
+    /**
+     * Number of the deferred requests that have been dropped because they had not been completed in time.
+     */
+    uint32_t getNumExpiredDeferredResponses() const { return deferred_.getNumExpired(); }
+};
+
+// ----------------------------------------------------------------------------
+
+template <typename DataType_, typename Callback_>
+void ServiceServer<DataType_, Callback_>::dropOldestCacheEntry()
+{
+    CacheEntry** link = &cache_;
+    while ((*link != UAVCAN_NULLPTR) && ((*link)->next != UAVCAN_NULLPTR))
+    {
+        link = &(*link)->next;
+    }
+    if (*link != UAVCAN_NULLPTR)
+    {
+        CacheEntry* const entry = *link;
+        *link = UAVCAN_NULLPTR;
+        destroyCacheEntry(entry);
+    }
+}
+
+template <typename DataType_, typename Callback_>
+bool ServiceServer<DataType_, Callback_>::respondFromCache(const ReceivedDataStructure<RequestType>& request)
+{
+    const MonotonicTime ts = publisher_.getNode().getMonotonicTime();
+    const TailArrayOptimizationMode tao_mode = publisher_.getTaoMode();
+
+    CacheEntry** link = &cache_;
+    while (*link != UAVCAN_NULLPTR)
+    {
+        CacheEntry* const entry = *link;
+        if ((entry->deadline <= ts) || (entry->tao_mode != tao_mode))
+        {
+            *link = entry->next;            // Expired, or the transport settings have changed since
+            destroyCacheEntry(entry);
+            continue;
+        }
+
+        if (entry->request == static_cast<const RequestType&>(request))
+        {
+            if (link != &cache_)
+            {
+                *link = entry->next;        // Moving to the front, so that the frequent requests are kept longer
+                entry->next = cache_;
+                cache_ = entry;
+            }
+
+            publisher_.setPriority(request.getPriority());
+            const int res = publisher_.publishEncoded(entry->response, TransferTypeServiceResponse,
+                                                      request.getSrcNodeID(), request.getTransferID());
+            if (res < 0)
+            {
+                UAVCAN_TRACE("ServiceServer", "Cached response publication failure: %i", res);
+                publisher_.getNode().getDispatcher().getTransferPerfCounter().addError();
+                response_failure_count_++;
+            }
+            cache_hit_count_++;
+            return true;
+        }
+        link = &entry->next;
+    }
+    return false;
+}
+
+template <typename DataType_, typename Callback_>
+int ServiceServer<DataType_, Callback_>::cacheAndPublish(const ResponseType& response,
+                                                         const ReceivedDataStructure<RequestType>& request)
+{
+    if (cache_size_ >= cache_capacity_)
+    {
+        dropOldestCacheEntry();
+    }
+    void* mem = cache_allocator_->allocate(sizeof(CacheEntry));
+    if ((mem == UAVCAN_NULLPTR) && (cache_ != UAVCAN_NULLPTR))
+    {
+        dropOldestCacheEntry();             // The allocator may be shared, trying to reuse our own block
+        mem = cache_allocator_->allocate(sizeof(CacheEntry));
+    }
+    if (mem == UAVCAN_NULLPTR)
+    {
+        UAVCAN_TRACE("ServiceServer", "Response cache: no memory [%s]", DataType::getDataTypeFullName());
+        return publisher_.publish(response, TransferTypeServiceResponse, request.getSrcNodeID(),
+                                  request.getTransferID());
+    }
+
+    CacheEntry* const entry = new (mem) CacheEntry();
+    cache_size_++;
+
+    const int encode_res = publisher_.encode(response, entry->response);
+    if (encode_res < 0)
+    {
+        destroyCacheEntry(entry);
+        return encode_res;
+    }
+    entry->request = request;
+    entry->tao_mode = publisher_.getTaoMode();
+    entry->deadline = publisher_.getNode().getMonotonicTime() + cache_ttl_;
+    entry->next = cache_;
+    cache_ = entry;
+
+    return publisher_.publishEncoded(entry->response, TransferTypeServiceResponse, request.getSrcNodeID(),
+                                     request.getTransferID());
+}
+
+
+/**
+ * Same as @ref ServiceServer, except that the callback encodes the response directly via
+ * @ref ServiceResponseWriter instead of filling a response object. This saves the stack space and the time
+ * needed to construct and encode large responses, e.g. the data of uavcan.protocol.file.Read.
+ *
+ * @tparam DataType_        Service data type.
+ *
+ * @tparam Callback_        The callback accepts the request the same way as with @ref ServiceServer, and
+ *                          ServiceResponseWriter& as the second argument.
+ *                          In C++11 mode this type defaults to @ref DefaultCallback<>.
+ *                          In C++03 mode this type defaults to a plain function pointer; use binder to
+ *                          call member functions as callbacks.
+ */
+template <typename DataType_,
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+          typename Callback_ = DefaultCallback<void (const ReceivedDataStructure<typename DataType_::Request>&,
+                                                   ServiceResponseWriter&)>
+#else
+          typename Callback_ = void (*)(const ReceivedDataStructure<typename DataType_::Request>&,
+                                        ServiceResponseWriter&)
+#endif
+          >
+class UAVCAN_EXPORT DirectServiceServer
+    : public GenericSubscriber<DataType_, typename DataType_::Request, TransferListener>
+{
+public:
+    typedef DataType_ DataType;
+    typedef typename DataType::Request RequestType;
+    typedef typename DataType::Response ResponseType;
+    typedef Callback_ Callback;
+
+private:
+    typedef GenericSubscriber<DataType, RequestType, TransferListener> SubscriberType;
+    typedef GenericPublisher<DataType, ResponseType> PublisherType;
+
+    PublisherType publisher_;
+    Callback callback_;
+    uint32_t response_failure_count_;
+
+    virtual void handleReceivedDataStruct(ReceivedDataStructure<RequestType>& request) override
+    {
+        UAVCAN_ASSERT(request.getTransferType() == TransferTypeServiceRequest);
+
+        typename PublisherType::EncodedBuffer buffer;
+        ServiceResponseWriter writer(buffer, publisher_.getTaoMode());
+
+        if (coerceOrFallback<bool>(callback_, true))
+        {
+            callback_(request, writer);
+        }
+        else
+        {
+            handleFatalError("Srv serv clbk");
+        }
+
+        if (!writer.isResponseEnabled())
+        {
+            UAVCAN_TRACE("DirectServiceServer", "Response was suppressed by the application");
+            return;
+        }
+
+        int res = -ErrInvalidMarshalData;
+        if (!writer.isFailed())
+        {
+            publisher_.setPriority(request.getPriority());      // Responding at the same priority.
+            res = publisher_.publishEncoded(buffer, TransferTypeServiceResponse, request.getSrcNodeID(),
+                                            request.getTransferID());
+        }
+        if (res < 0)
+        {
+            UAVCAN_TRACE("DirectServiceServer", "Response publication failure: %i", res);
+            publisher_.getNode().getDispatcher().getTransferPerfCounter().addError();
+            response_failure_count_++;
+        }
+    }
+
+public:
+    explicit DirectServiceServer(INode& node, bool force_std_can = false)
+        : SubscriberType(node)
+        , publisher_(node, force_std_can, getDefaultTxTimeout())
+        , callback_()
+        , response_failure_count_(0)
+    {
+        StaticAssert<DataTypeKind(DataType::DataTypeKind) == DataTypeKindService>::check();
+#if UAVCAN_HANDLER_PROFILING
+        SubscriberType::getHandlerProfile().setKind(HandlerProfile::KindServiceServer);
+#endif
+    }
+
+    /**
+     * Refer to @ref ServiceServer::start().
+     */
+    int start(const Callback& callback)
+    {
+        stop();
+
+        if (!coerceOrFallback<bool>(callback, true))
+        {
+            UAVCAN_TRACE("DirectServiceServer", "Invalid callback");
+            return -ErrInvalidParam;
+        }
+        callback_ = callback;
+
+        const int publisher_res = publisher_.init();
+        if (publisher_res < 0)
+        {
+            UAVCAN_TRACE("DirectServiceServer", "Publisher initialization failure: %i", publisher_res);
+            return publisher_res;
+        }
+        return SubscriberType::startAsServiceRequestListener();
+    }
+
+    using SubscriberType::stop;
+
+    static MonotonicDuration getDefaultTxTimeout() { return MonotonicDuration::fromMSec(1000); }
+
+    MonotonicDuration getTxTimeout() const { return publisher_.getTxTimeout(); }
+    void setTxTimeout(MonotonicDuration tx_timeout) { publisher_.setTxTimeout(tx_timeout); }
+
+    uint32_t getRequestFailureCount() const { return SubscriberType::getFailureCount(); }
+
+    /**
+     * See @ref ServiceServer::preregisterClient().
+     */
+    int preregisterClient(NodeID client_node_id)
+    {
+        return SubscriberType::preregisterSource(client_node_id, TransferTypeServiceRequest);
+    }
+
+    /**
+     * Includes the responses that could not be encoded.
+     */
+    uint32_t getResponseFailureCount() const { return response_failure_count_; }
 };
 
 }
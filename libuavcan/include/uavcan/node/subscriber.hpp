@@ -15,6 +15,7 @@
 
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
 # include <functional>
+# include <uavcan/util/inplace_function.hpp>
 #endif
 
 namespace uavcan
@@ -31,25 +32,30 @@ namespace uavcan
  *                          - ReceivedDataStructure<DataType_>&
  *                          - const ReceivedDataStructure<DataType_>&
  *                          For the first two options, @ref ReceivedDataStructure<> will be casted implicitly.
- *                          In C++11 mode this type defaults to std::function<>.
+ *                          In C++11 mode this type defaults to @ref DefaultCallback<>.
  *                          In C++03 mode this type defaults to a plain function pointer; use binder to
  *                          call member functions as callbacks.
+ *
+ * @tparam TransferListener_    Transfer listener implementation. The default one allocates transfer receivers
+ *                              from the pool; use @ref DirectIndexedTransferListener<> to trade a fixed amount
+ *                              of memory for constant time receiver lookup on heavily loaded subscriptions.
  */
 template <typename DataType_,
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
-          typename Callback_ = std::function<void (const ReceivedDataStructure<DataType_>&)>
+          typename Callback_ = DefaultCallback<void (const ReceivedDataStructure<DataType_>&)>,
 #else
-          typename Callback_ = void (*)(const ReceivedDataStructure<DataType_>&)
+          typename Callback_ = void (*)(const ReceivedDataStructure<DataType_>&),
 #endif
+          typename TransferListener_ = TransferListener
           >
 class UAVCAN_EXPORT Subscriber
-    : public GenericSubscriber<DataType_, DataType_, TransferListener>
+    : public GenericSubscriber<DataType_, DataType_, TransferListener_>
 {
 public:
     typedef Callback_ Callback;
 
 private:
-    typedef GenericSubscriber<DataType_, DataType_, TransferListener> BaseType;
+    typedef GenericSubscriber<DataType_, DataType_, TransferListener_> BaseType;
 
     Callback callback_;
 
@@ -94,9 +100,42 @@ public:
         return BaseType::startAsMessageListener();
     }
 
+    /**
+     * Same as start(), except that the subscribers of this data type that are started this way on the same node
+     * share one transfer listener, so that every transfer is reassembled and decoded only once and the memory pool
+     * is used only once. The subscribers must have the same transfer listener type; the callback types may differ.
+     * Refer to @ref GenericSubscriber::startAsSharedMessageListener() for details.
+     * Returns negative error code.
+     */
+    int startShared(const Callback& callback)
+    {
+        stop();
+
+        if (!coerceOrFallback<bool>(callback, true))
+        {
+            UAVCAN_TRACE("Subscriber", "Invalid callback");
+            return -ErrInvalidParam;
+        }
+        callback_ = callback;
+
+        return BaseType::startAsSharedMessageListener();
+    }
+
     using BaseType::allowAnonymousTransfers;
     using BaseType::stop;
     using BaseType::getFailureCount;
+    using BaseType::reservePoolBlocks;
+    using BaseType::setSourceNodeFilter;
+    using BaseType::setFrameFilter;
+
+    /**
+     * Makes the reception of the first message from the given node deterministic, see
+     * @ref TransferListener::preregisterSource(). Useful for the messages that are expected right after boot.
+     */
+    int preregisterPublisher(NodeID node_id)
+    {
+        return BaseType::preregisterSource(node_id, TransferTypeMessageBroadcast);
+    }
 };
 
 }
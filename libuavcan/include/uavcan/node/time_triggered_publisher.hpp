@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_TIME_TRIGGERED_PUBLISHER_HPP_INCLUDED
+#define UAVCAN_NODE_TIME_TRIGGERED_PUBLISHER_HPP_INCLUDED
+
+#include <uavcan/node/publisher.hpp>
+#include <uavcan/node/scheduler.hpp>
+
+namespace uavcan
+{
+/**
+ * Non-generic part of @ref TimeTriggeredPublisher: the schedule of the slots.
+ *
+ * The time is divided into cycles of equal length; every cycle contains one slot of the publisher, which begins at
+ * the given offset from the start of the cycle and lasts for the given duration. The cycles are aligned either to
+ * the monotonic time, so that the slots start at (N * cycle + offset), or to the UTC time, which makes the slots of
+ * different nodes line up if their UTC clocks are synchronized, e.g. by @ref GlobalTimeSyncSlave.
+ */
+class UAVCAN_EXPORT TimeTriggeredPublisherBase : private DeadlineHandler
+{
+    MonotonicDuration cycle_;
+    MonotonicDuration slot_offset_;
+    MonotonicDuration slot_duration_;
+    MonotonicDuration max_release_delay_;
+    uint32_t num_released_slots_;
+    uint32_t num_missed_slots_;
+    bool utc_aligned_;
+
+    virtual void handleDeadline(MonotonicTime current) override;
+
+    /**
+     * Start of the earliest slot that does not begin before the given moment.
+     */
+    MonotonicTime computeNextSlotStart(MonotonicTime after) const;
+
+protected:
+    explicit TimeTriggeredPublisherBase(Scheduler& scheduler)
+        : DeadlineHandler(scheduler)
+        , num_released_slots_(0)
+        , num_missed_slots_(0)
+        , utc_aligned_(false)
+    { }
+
+    /**
+     * Invoked at the start of every slot.
+     * Returns the number of released frames, zero if there was nothing to publish, or negative error code.
+     */
+    virtual int releaseSlot() = 0;
+
+    /**
+     * Returns negative error code if the parameters are invalid; see @ref TimeTriggeredPublisher::start().
+     */
+    int startSchedule(MonotonicDuration cycle, MonotonicDuration slot_offset, MonotonicDuration slot_duration);
+
+public:
+    using DeadlineHandler::stop;
+    using DeadlineHandler::isRunning;
+    using DeadlineHandler::getScheduler;
+
+    /**
+     * If enabled, the cycles are aligned to the UTC time of the node rather than to its monotonic time.
+     * Until the UTC time is known, i.e. while it reads zero, the monotonic time is used. Disabled by default.
+     * The alignment is re-evaluated at every slot, so it follows the adjustments of the UTC clock; an adjustment
+     * by less than half of the cycle does not cause a slot to be skipped or repeated.
+     */
+    void setUtcAlignment(bool enabled);
+    bool isUtcAligned() const { return utc_aligned_; }
+
+    MonotonicDuration getCycle() const { return cycle_; }
+    MonotonicDuration getSlotOffset() const { return slot_offset_; }
+    MonotonicDuration getSlotDuration() const { return slot_duration_; }
+
+    /**
+     * Monotonic time of the start of the next slot; valid while running.
+     */
+    MonotonicTime getNextSlotStart() const { return getDeadline(); }
+
+    /**
+     * Slots in which the message has been published.
+     */
+    uint32_t getNumReleasedSlots() const { return num_released_slots_; }
+
+    /**
+     * Slots that have been skipped because the scheduler had not been spinning by the end of the slot, or
+     * because the publication has failed.
+     */
+    uint32_t getNumMissedSlots() const { return num_missed_slots_; }
+
+    /**
+     * Maximum delay between the start of a slot and the release of the message into the TX queue, which is the
+     * jitter introduced by the scheduler. It depends on how often the application spins the node, and on the tick
+     * of the scheduler if @ref UAVCAN_SCHEDULER_TIMER_WHEEL is enabled.
+     */
+    MonotonicDuration getMaxReleaseDelay() const { return max_release_delay_; }
+};
+
+/**
+ * Publishes a message in the assigned time slots instead of on demand, so that the publications of the nodes
+ * sharing a bus don't collide in arbitration and their latency is predictable; see @ref TimeTriggeredPublisherBase
+ * for the schedule.
+ *
+ * The application updates the message with @ref setMessage() at any time; the message is encoded there, so that
+ * only the ready frames are released into the TX queue at the start of the slot. The last message is published in
+ * every slot until it is updated. The TX timeout of the frames is the duration of the slot, so the frames that
+ * could not be transmitted within their slot are discarded rather than delayed into the slots of other nodes.
+ *
+ * Usage:
+ *
+ *      TimeTriggeredPublisher<Command> pub(node);
+ *      pub.start(MonotonicDuration::fromMSec(10), MonotonicDuration::fromUSec(2500), MonotonicDuration::fromMSec(1));
+ *      ...
+ *      pub.setMessage(cmd);
+ *
+ * @tparam DataType_    Message data type
+ */
+template <typename DataType_>
+class UAVCAN_EXPORT TimeTriggeredPublisher : public TimeTriggeredPublisherBase
+{
+public:
+    typedef DataType_ DataType;
+    typedef typename Publisher<DataType>::PreparedMessage PreparedMessage;
+
+private:
+    Publisher<DataType> publisher_;
+    PreparedMessage prepared_;
+
+    virtual int releaseSlot() override
+    {
+        if (!prepared_.isValid())
+        {
+            return 0;           // Nothing to publish yet
+        }
+        return publisher_.broadcast(prepared_);
+    }
+
+public:
+    explicit TimeTriggeredPublisher(INode& node)
+        : TimeTriggeredPublisherBase(node.getScheduler())
+        , publisher_(node)
+    { }
+
+    /**
+     * Starts publishing, or changes the schedule.
+     * @param cycle             Period of the slots, must be positive.
+     * @param slot_offset       Start of the slot relative to the start of the cycle; less than the cycle.
+     * @param slot_duration     Positive, not longer than the cycle. Also the TX timeout of the frames.
+     * @return                  Negative error code.
+     */
+    int start(MonotonicDuration cycle, MonotonicDuration slot_offset, MonotonicDuration slot_duration)
+    {
+        const int res = publisher_.init();
+        if (res < 0)
+        {
+            return res;
+        }
+        publisher_.setTxTimeout(slot_duration);
+        return startSchedule(cycle, slot_offset, slot_duration);
+    }
+
+    /**
+     * Sets the message to publish in the next slots. Returns negative error code.
+     */
+    int setMessage(const DataType& message) { return publisher_.prepare(message, prepared_); }
+
+    /**
+     * The encoded message; its leading fields can be updated in place, see @ref Publisher::PreparedMessage.
+     */
+    PreparedMessage& getPreparedMessage() { return prepared_; }
+
+    Publisher<DataType>& getPublisher() { return publisher_; }
+};
+
+}
+
+#endif // UAVCAN_NODE_TIME_TRIGGERED_PUBLISHER_HPP_INCLUDED
@@ -19,6 +19,7 @@
 
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
 # include <functional>
+# include <uavcan/util/inplace_function.hpp>
 #endif
 
 namespace uavcan
@@ -45,21 +46,35 @@ struct UAVCAN_EXPORT TimerEvent
  */
 class UAVCAN_EXPORT TimerBase : private DeadlineHandler
 {
+    enum { NoPhase = 0xFF };
+
     MonotonicDuration period_;
+    uint16_t phase_weight_;
+    uint8_t phase_bin_;             ///< Phase taken from the allocator of the scheduler, if any
 
     virtual void handleDeadline(MonotonicTime current) override;
 
+    void releasePhase();
+
 public:
-    using DeadlineHandler::stop;
     using DeadlineHandler::isRunning;
     using DeadlineHandler::getDeadline;
     using DeadlineHandler::getScheduler;
+    using DeadlineHandler::getSlack;
+    using DeadlineHandler::setSlack;
+#if UAVCAN_HANDLER_PROFILING
+    using DeadlineHandler::getHandlerProfile;
+#endif
 
     explicit TimerBase(INode& node)
         : DeadlineHandler(node.getScheduler())
         , period_(MonotonicDuration::getInfinite())
+        , phase_weight_(0)
+        , phase_bin_(NoPhase)
     { }
 
+    virtual ~TimerBase() { releasePhase(); }
+
     /**
      * Various ways to start the timer - periodically or once.
      * If it is running already, it will be restarted.
@@ -70,6 +85,18 @@ public:
     void startOneShotWithDelay(MonotonicDuration delay);
     void startPeriodic(MonotonicDuration period);
 
+    /**
+     * Same as @ref startPeriodic(), but the phase of the timer is taken from the @ref PeriodicPhaseAllocator of the
+     * scheduler, so that the periodic timers of the node are spread over their periods instead of firing at once.
+     * The first event occurs within one period, at the allocated phase.
+     * @param period    Period of the timer.
+     * @param weight    Cost of the timer events relative to the other spread timers, e.g. the number of CAN frames
+     *                  of the transfers published from the handler.
+     */
+    void startPeriodicSpread(MonotonicDuration period, uint16_t weight = 1);
+
+    void stop();
+
     /**
      * Returns period if the timer is in periodic mode.
      * Returns infinite duration if the timer is in one-shot mode or stopped.
@@ -137,9 +164,9 @@ public:
 
 /**
  * Use this timer in C++11 mode.
- * Callback type is std::function<>.
+ * Callback type is @ref DefaultCallback<>.
  */
-typedef TimerEventForwarder<std::function<void (const TimerEvent& event)> > Timer;
+typedef TimerEventForwarder<DefaultCallback<void (const TimerEvent& event)> > Timer;
 
 #endif
 
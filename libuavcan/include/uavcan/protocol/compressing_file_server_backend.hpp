@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_COMPRESSING_FILE_SERVER_BACKEND_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_COMPRESSING_FILE_SERVER_BACKEND_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/protocol/file_server.hpp>
+#include <uavcan/protocol/file_compression.hpp>
+
+namespace uavcan
+{
+/**
+ * Adapter that can be placed in front of any other file server backend, so that every file can also be read in the
+ * compressed representation, which is defined by @ref BlockLZ. This is useful for large files that are read by
+ * many nodes, such as firmware images, because the bus time of a download is proportional to the size:
+ *
+ *      MyBackend my_backend;
+ *      uavcan::CompressingFileServerBackend<> compressing_backend(my_backend);
+ *      uavcan::BasicFileServer server(node, compressing_backend);
+ *
+ * A path that ends with @ref BlockLZ::getPathSuffix() refers to the compressed representation of the file without
+ * the suffix; all other paths are passed to the underlying backend as is. Therefore a client that doesn't know the
+ * capabilities of the server can request the compressed file first, and fall back to the original one on error.
+ *
+ * The file is compressed on the fly, block by block. The offsets where the compressed blocks start are remembered,
+ * so that any offset can be served later without compressing the file from the beginning again; the last compressed
+ * block is kept for the following requests. Only one file is indexed at a time, so the nodes that read different
+ * compressed files at the same time make the blocks be compressed repeatedly. The size that is reported by
+ * getInfo() for the compressed file requires the whole file to be compressed once.
+ *
+ * The adapter assumes that the files are not modified behind its back; otherwise, @ref invalidate() should be
+ * called. Modifications made through this backend invalidate the index.
+ *
+ * @tparam MaxBlocks_       Maximum size of the file in blocks of @ref BlockLZ::BlockSize bytes, which defines
+ *                          the size of the index; larger files are reported as FILE_TOO_LARGE.
+ */
+template <unsigned MaxBlocks_ = 1024>
+class UAVCAN_EXPORT CompressingFileServerBackend : public IFileServerBackend
+{
+    IFileServerBackend& backend_;
+    BlockLZEncoder encoder_;
+    Path path_;                                 ///< Original path of the indexed file
+    uint32_t block_offsets_[MaxBlocks_ + 1];    ///< Where the compressed blocks start; the last one is the end
+    unsigned num_indexed_blocks_;
+    bool end_indexed_;                          ///< The last block of the file is indexed
+    bool cached_block_valid_;
+    unsigned cached_block_index_;
+    unsigned cached_block_size_;
+    uint8_t cached_block_[BlockLZ::MaxEncodedBlockSize];
+    uint8_t raw_block_[BlockLZ::BlockSize];
+    uint32_t num_blocks_compressed_;
+
+    void syncRootPaths();
+
+    void selectFile(const Path& path);
+
+    /**
+     * Returns the error code of the underlying backend.
+     */
+    int16_t compressBlock(unsigned index);
+
+    int16_t indexUpTo(uint64_t offset);
+
+public:
+    explicit CompressingFileServerBackend(IFileServerBackend& backend)
+        : backend_(backend)
+        , num_indexed_blocks_(0)
+        , end_indexed_(false)
+        , cached_block_valid_(false)
+        , cached_block_index_(0)
+        , cached_block_size_(0)
+        , num_blocks_compressed_(0)
+    {
+        StaticAssert<(MaxBlocks_ > 0)>::check();
+        block_offsets_[0] = 0;
+    }
+
+    virtual int16_t getInfo(const Path& path, uint64_t& out_size, EntryType& out_type) override;
+
+    virtual int16_t read(const Path& path, const uint64_t offset, uint8_t* out_buffer, uint16_t& inout_size)
+        override;
+
+    virtual int16_t write(const Path& path, const uint64_t offset, const uint8_t* buffer, const uint16_t size)
+        override
+    {
+        syncRootPaths();
+        if (path == path_)
+        {
+            invalidate();
+        }
+        return backend_.write(path, offset, buffer, size);
+    }
+
+    virtual int16_t remove(const Path& path) override
+    {
+        syncRootPaths();
+        if (path == path_)
+        {
+            invalidate();
+        }
+        return backend_.remove(path);
+    }
+
+    virtual int16_t getDirectoryEntryInfo(const Path& directory_path, const uint32_t entry_index,
+                                          EntryType& out_type, Path& out_entry_full_path) override
+    {
+        syncRootPaths();
+        return backend_.getDirectoryEntryInfo(directory_path, entry_index, out_type, out_entry_full_path);
+    }
+
+    /**
+     * Discards the index and the cached block.
+     */
+    void invalidate()
+    {
+        path_.clear();
+        num_indexed_blocks_ = 0;
+        end_indexed_ = false;
+        cached_block_valid_ = false;
+    }
+
+    /**
+     * Number of the blocks that had to be compressed to serve the requests.
+     */
+    uint32_t getNumBlocksCompressed() const { return num_blocks_compressed_; }
+};
+
+// ----------------------------------------------------------------------------
+
+template <unsigned MaxBlocks_>
+void CompressingFileServerBackend<MaxBlocks_>::syncRootPaths()
+{
+    // The file server configures the root paths of this backend only, but the underlying one resolves them
+    if ((backend_.getRootPath() != getRootPath()) || (backend_.getAltRootPath() != getAltRootPath()))
+    {
+        backend_.getRootPath() = getRootPath();
+        backend_.getAltRootPath() = getAltRootPath();
+        invalidate();
+    }
+}
+
+template <unsigned MaxBlocks_>
+void CompressingFileServerBackend<MaxBlocks_>::selectFile(const Path& path)
+{
+    if ((path != path_) || path_.empty())
+    {
+        invalidate();
+        path_ = path;
+    }
+}
+
+template <unsigned MaxBlocks_>
+int16_t CompressingFileServerBackend<MaxBlocks_>::compressBlock(unsigned index)
+{
+    if (index >= MaxBlocks_)
+    {
+        return Error::FILE_TOO_LARGE;
+    }
+    UAVCAN_ASSERT(index <= num_indexed_blocks_);
+
+    cached_block_valid_ = false;
+    uint16_t size = uint16_t(BlockLZ::BlockSize);
+    const int16_t res = backend_.read(path_, uint64_t(index) * unsigned(BlockLZ::BlockSize), raw_block_, size);
+    if (res != Error::OK)
+    {
+        return res;
+    }
+    if (size > unsigned(BlockLZ::BlockSize))
+    {
+        UAVCAN_ASSERT(0);
+        return Error::UNKNOWN_ERROR;
+    }
+
+    cached_block_size_ = encoder_.encode(raw_block_, size, cached_block_);
+    cached_block_index_ = index;
+    cached_block_valid_ = true;
+    num_blocks_compressed_++;
+
+    if (index == num_indexed_blocks_)
+    {
+        block_offsets_[index + 1U] = block_offsets_[index] + uint32_t(cached_block_size_);
+        num_indexed_blocks_++;
+        end_indexed_ = size < unsigned(BlockLZ::BlockSize);
+    }
+    else if ((block_offsets_[index + 1U] - block_offsets_[index]) != cached_block_size_)
+    {
+        UAVCAN_TRACE("CompressingFileServerBackend", "File has changed");
+        invalidate();
+        return Error::UNKNOWN_ERROR;
+    }
+    return Error::OK;
+}
+
+template <unsigned MaxBlocks_>
+int16_t CompressingFileServerBackend<MaxBlocks_>::indexUpTo(uint64_t offset)
+{
+    while (!end_indexed_ && (offset >= block_offsets_[num_indexed_blocks_]))
+    {
+        const int16_t res = compressBlock(num_indexed_blocks_);
+        if (res != Error::OK)
+        {
+            return res;
+        }
+    }
+    return Error::OK;
+}
+
+template <unsigned MaxBlocks_>
+int16_t CompressingFileServerBackend<MaxBlocks_>::getInfo(const Path& path, uint64_t& out_size, EntryType& out_type)
+{
+    syncRootPaths();
+    if (!BlockLZ::isCompressedFilePath(path))
+    {
+        return backend_.getInfo(path, out_size, out_type);
+    }
+
+    Path original_path;
+    BlockLZ::makeOriginalFilePath(path, original_path);
+    const int16_t res = backend_.getInfo(original_path, out_size, out_type);
+    if ((res != Error::OK) || ((out_type.flags & EntryType::FLAG_DIRECTORY) != 0))
+    {
+        return res;
+    }
+
+    selectFile(original_path);
+    const int16_t index_res = indexUpTo(NumericTraits<uint64_t>::max());
+    if (index_res != Error::OK)
+    {
+        return index_res;
+    }
+    out_size = block_offsets_[num_indexed_blocks_];
+    return Error::OK;
+}
+
+template <unsigned MaxBlocks_>
+int16_t CompressingFileServerBackend<MaxBlocks_>::read(const Path& path, const uint64_t offset, uint8_t* out_buffer,
+                                                      uint16_t& inout_size)
+{
+    syncRootPaths();
+    if (!BlockLZ::isCompressedFilePath(path))
+    {
+        return backend_.read(path, offset, out_buffer, inout_size);
+    }
+
+    Path original_path;
+    BlockLZ::makeOriginalFilePath(path, original_path);
+    selectFile(original_path);
+
+    const unsigned requested = inout_size;
+    unsigned done = 0;
+    while (done < requested)
+    {
+        const uint64_t pos = offset + done;
+        int16_t res = indexUpTo(pos);
+        if ((res == Error::OK) && (pos >= block_offsets_[num_indexed_blocks_]))
+        {
+            break;                          // End of file
+        }
+
+        unsigned index = 0;
+        if (res == Error::OK)
+        {
+            // The last block that starts at or before the position
+            unsigned low = 0;
+            unsigned high = num_indexed_blocks_;
+            while ((high - low) > 1U)
+            {
+                const unsigned middle = low + (high - low) / 2U;
+                if (block_offsets_[middle] <= pos)
+                {
+                    low = middle;
+                }
+                else
+                {
+                    high = middle;
+                }
+            }
+            index = low;
+            if (!cached_block_valid_ || (cached_block_index_ != index))
+            {
+                res = compressBlock(index);
+            }
+        }
+        if (res != Error::OK)
+        {
+            if (done == 0)
+            {
+                return res;
+            }
+            break;                          // Serving what has been compressed, the next request will fail
+        }
+
+        const unsigned pos_in_block = unsigned(pos - block_offsets_[index]);
+        UAVCAN_ASSERT(pos_in_block < cached_block_size_);
+        const unsigned len = min(cached_block_size_ - pos_in_block, requested - done);
+        (void)copy(cached_block_ + pos_in_block, cached_block_ + pos_in_block + len, out_buffer + done);
+        done += len;
+    }
+
+    inout_size = uint16_t(done);
+    return Error::OK;
+}
+
+}
+
+#endif // UAVCAN_PROTOCOL_COMPRESSING_FILE_SERVER_BACKEND_HPP_INCLUDED
@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_DELTA_FILE_SERVER_BACKEND_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_DELTA_FILE_SERVER_BACKEND_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/protocol/file_server.hpp>
+#include <uavcan/protocol/firmware_delta.hpp>
+
+namespace uavcan
+{
+/**
+ * Adapter that can be placed in front of any other file server backend, so that the firmware images can also be
+ * read as patches against the older images, see @ref FirmwareDelta:
+ *
+ *      MyBackend my_backend;
+ *      static uavcan::DeltaFileServerBackend<> delta_backend(my_backend);  // Large, better not on the stack
+ *      delta_backend.setArchivePath("archive");
+ *      uavcan::BasicFileServer server(node, delta_backend);
+ *
+ * The older images are looked up in the archive directory, which is resolved by the underlying backend like any
+ * other path, under the names made of the image CRC as 16 lowercase hex digits followed by ".bin", e.g.
+ * "archive/0123456789abcdef.bin"; see @ref makeArchivedImagePath(). A path that is recognized by
+ * @ref FirmwareDelta::parseDeltaFilePath() refers to the patch; all other paths are passed to the underlying
+ * backend as is. If the base is not in the archive, or if the patch would not be smaller than the image, the patch
+ * is reported as NOT_FOUND, and the node falls back to the full image.
+ *
+ * The patch is made when it is requested first, from the complete images read into memory; the last patch is
+ * kept for the following requests, which is enough when a batch of nodes running the same version is updated.
+ * The adapter assumes that the files are not modified behind its back; otherwise, @ref invalidate() should be
+ * called. Modifications made through this backend invalidate the patch.
+ *
+ * @tparam MaxImageSize_    Maximum size of the images in bytes; the adapter takes about three times as much memory.
+ *                          Larger images are reported as FILE_TOO_LARGE.
+ * @tparam HashBits_        See @ref FirmwareDeltaEncoder.
+ */
+template <unsigned MaxImageSize_ = 256 * 1024, unsigned HashBits_ = 16>
+class UAVCAN_EXPORT DeltaFileServerBackend : public IFileServerBackend
+{
+    enum
+    {
+        MaxPatchSize = FirmwareDelta::HeaderSize + MaxImageSize_ +
+                       (MaxImageSize_ + FirmwareDelta::MaxLiteralRunLength - 1U) / FirmwareDelta::MaxLiteralRunLength
+    };
+
+    IFileServerBackend& backend_;
+    FirmwareDeltaEncoder<HashBits_> encoder_;
+    Path archive_path_;
+    Path patch_path_;                           ///< Path of the cached patch; empty if none
+    int16_t patch_error_;                       ///< Result of the last attempt to make the cached patch
+    uint32_t patch_size_;
+    uint32_t max_shift_;
+    uint32_t num_patches_made_;
+    uint8_t base_[MaxImageSize_];
+    uint8_t target_[MaxImageSize_];
+    uint8_t patch_[MaxPatchSize];
+
+    void syncRootPaths();
+
+    /**
+     * Returns the error code of the underlying backend.
+     */
+    int16_t readWholeFile(const Path& path, uint8_t* out_data, uint32_t& out_size);
+
+    int16_t makePatch(const Path& original_path, uint64_t base_crc);
+
+    /**
+     * Makes the patch unless it is cached; returns the error code.
+     */
+    int16_t selectPatch(const Path& delta_path);
+
+    void invalidateIfAffected(const Path& path)
+    {
+        Path original_path;
+        uint64_t base_crc = 0;
+        if (!patch_path_.empty() && FirmwareDelta::parseDeltaFilePath(patch_path_, original_path, base_crc))
+        {
+            Path base_path;
+            (void)makeArchivedImagePath(base_crc, base_path);
+            if ((path == original_path) || (path == base_path))
+            {
+                invalidate();
+            }
+        }
+    }
+
+public:
+    explicit DeltaFileServerBackend(IFileServerBackend& backend)
+        : backend_(backend)
+        , patch_error_(Error::OK)
+        , patch_size_(0)
+        , max_shift_(4096)
+        , num_patches_made_(0)
+    {
+        StaticAssert<(MaxImageSize_ > 0)>::check();
+    }
+
+    virtual int16_t getInfo(const Path& path, uint64_t& out_size, EntryType& out_type) override;
+
+    virtual int16_t read(const Path& path, const uint64_t offset, uint8_t* out_buffer, uint16_t& inout_size)
+        override;
+
+    virtual int16_t write(const Path& path, const uint64_t offset, const uint8_t* buffer, const uint16_t size)
+        override
+    {
+        syncRootPaths();
+        invalidateIfAffected(path);
+        return backend_.write(path, offset, buffer, size);
+    }
+
+    virtual int16_t remove(const Path& path) override
+    {
+        syncRootPaths();
+        invalidateIfAffected(path);
+        return backend_.remove(path);
+    }
+
+    virtual int16_t getDirectoryEntryInfo(const Path& directory_path, const uint32_t entry_index,
+                                          EntryType& out_type, Path& out_entry_full_path) override
+    {
+        syncRootPaths();
+        return backend_.getDirectoryEntryInfo(directory_path, entry_index, out_type, out_entry_full_path);
+    }
+
+    /**
+     * Directory where the older images are kept, relative to the root paths. Empty by default, i.e. the root.
+     */
+    void setArchivePath(const char* path)
+    {
+        archive_path_ = path;
+        if (!archive_path_.empty() && (archive_path_.back() != getPathSeparator()))
+        {
+            archive_path_.push_back(static_cast<unsigned char>(getPathSeparator()));
+        }
+        invalidate();
+    }
+
+    const Path& getArchivePath() const { return archive_path_; }
+
+    /**
+     * Path of the archived image with the given CRC. Returns false if the archive path is too long.
+     */
+    bool makeArchivedImagePath(uint64_t image_crc, Path& out_path) const
+    {
+        static const char Suffix[] = ".bin";
+        if ((archive_path_.size() + unsigned(FirmwareDelta::BaseCRCHexDigits) + sizeof(Suffix) - 1U) >
+            archive_path_.capacity())
+        {
+            return false;
+        }
+        static const char Digits[] = "0123456789abcdef";
+        out_path = archive_path_;
+        for (int i = FirmwareDelta::BaseCRCHexDigits - 1; i >= 0; i--)
+        {
+            out_path.push_back(uint8_t(Digits[(image_crc >> (unsigned(i) * 4U)) & 0xFU]));
+        }
+        out_path += Suffix;
+        return true;
+    }
+
+    /**
+     * Limit of the shift of the patches, see @ref FirmwareDeltaEncoder::encode(). The nodes must have this much
+     * memory beyond the end of the base image; the patches against the images that fill the memory are less
+     * efficient. Default is 4096 bytes.
+     */
+    void setMaxShift(uint32_t max_shift)
+    {
+        max_shift_ = max_shift;
+        invalidate();
+    }
+
+    uint32_t getMaxShift() const { return max_shift_; }
+
+    /**
+     * Discards the cached patch.
+     */
+    void invalidate()
+    {
+        patch_path_.clear();
+        patch_error_ = Error::OK;
+        patch_size_ = 0;
+    }
+
+    /**
+     * Number of the patches that had to be made to serve the requests, including the ones that were found not
+     * to be worth it.
+     */
+    uint32_t getNumPatchesMade() const { return num_patches_made_; }
+};
+
+// ----------------------------------------------------------------------------
+
+template <unsigned MaxImageSize_, unsigned HashBits_>
+void DeltaFileServerBackend<MaxImageSize_, HashBits_>::syncRootPaths()
+{
+    // The file server configures the root paths of this backend only, but the underlying one resolves them
+    if ((backend_.getRootPath() != getRootPath()) || (backend_.getAltRootPath() != getAltRootPath()))
+    {
+        backend_.getRootPath() = getRootPath();
+        backend_.getAltRootPath() = getAltRootPath();
+        invalidate();
+    }
+}
+
+template <unsigned MaxImageSize_, unsigned HashBits_>
+int16_t DeltaFileServerBackend<MaxImageSize_, HashBits_>::readWholeFile(const Path& path, uint8_t* out_data,
+                                                                        uint32_t& out_size)
+{
+    out_size = 0;
+    while (true)
+    {
+        uint8_t buffer[ReadSize];
+        uint16_t size = uint16_t(ReadSize);
+        const int16_t res = backend_.read(path, out_size, buffer, size);
+        if (res != Error::OK)
+        {
+            return res;
+        }
+        if (size > unsigned(ReadSize))
+        {
+            UAVCAN_ASSERT(0);
+            return Error::UNKNOWN_ERROR;
+        }
+        if ((out_size + size) > MaxImageSize_)
+        {
+            return Error::FILE_TOO_LARGE;
+        }
+        (void)copy(buffer, buffer + size, out_data + out_size);
+        out_size += size;
+        if (size < unsigned(ReadSize))
+        {
+            return Error::OK;
+        }
+    }
+}
+
+template <unsigned MaxImageSize_, unsigned HashBits_>
+int16_t DeltaFileServerBackend<MaxImageSize_, HashBits_>::makePatch(const Path& original_path, uint64_t base_crc)
+{
+    Path base_path;
+    if (!makeArchivedImagePath(base_crc, base_path))
+    {
+        return Error::NOT_FOUND;
+    }
+
+    uint32_t base_size = 0;
+    int16_t res = readWholeFile(base_path, base_, base_size);
+    if (res != Error::OK)
+    {
+        UAVCAN_TRACE("DeltaFileServerBackend", "Base %s not available: %d", base_path.c_str(), int(res));
+        return (res == Error::FILE_TOO_LARGE) ? res : int16_t(Error::NOT_FOUND);
+    }
+
+    uint32_t target_size = 0;
+    res = readWholeFile(original_path, target_, target_size);
+    if (res != Error::OK)
+    {
+        return res;
+    }
+
+    patch_size_ = encoder_.encode(base_, base_size, base_crc, target_, target_size, max_shift_, patch_);
+    num_patches_made_++;
+    UAVCAN_TRACE("DeltaFileServerBackend", "Patch %s: %u --> %u bytes", original_path.c_str(),
+                 unsigned(target_size), unsigned(patch_size_));
+
+    // The client would rather download the image itself, it doesn't need to be patched
+    return (patch_size_ < target_size) ? int16_t(Error::OK) : int16_t(Error::NOT_FOUND);
+}
+
+template <unsigned MaxImageSize_, unsigned HashBits_>
+int16_t DeltaFileServerBackend<MaxImageSize_, HashBits_>::selectPatch(const Path& delta_path)
+{
+    if (patch_path_.empty() || (patch_path_ != delta_path))
+    {
+        Path original_path;
+        uint64_t base_crc = 0;
+        (void)FirmwareDelta::parseDeltaFilePath(delta_path, original_path, base_crc);
+
+        invalidate();
+        patch_error_ = makePatch(original_path, base_crc);
+        patch_path_ = delta_path;           // The failure is cached as well, the nodes retry the requests
+    }
+    return patch_error_;
+}
+
+template <unsigned MaxImageSize_, unsigned HashBits_>
+int16_t DeltaFileServerBackend<MaxImageSize_, HashBits_>::getInfo(const Path& path, uint64_t& out_size,
+                                                                  EntryType& out_type)
+{
+    syncRootPaths();
+    Path original_path;
+    uint64_t base_crc = 0;
+    if (!FirmwareDelta::parseDeltaFilePath(path, original_path, base_crc))
+    {
+        return backend_.getInfo(path, out_size, out_type);
+    }
+
+    const int16_t res = backend_.getInfo(original_path, out_size, out_type);
+    if ((res != Error::OK) || ((out_type.flags & EntryType::FLAG_DIRECTORY) != 0))
+    {
+        return res;
+    }
+
+    const int16_t patch_res = selectPatch(path);
+    if (patch_res != Error::OK)
+    {
+        return patch_res;
+    }
+    out_size = patch_size_;
+    out_type.flags = uint8_t(out_type.flags & ~EntryType::FLAG_WRITEABLE);
+    return Error::OK;
+}
+
+template <unsigned MaxImageSize_, unsigned HashBits_>
+int16_t DeltaFileServerBackend<MaxImageSize_, HashBits_>::read(const Path& path, const uint64_t offset,
+                                                               uint8_t* out_buffer, uint16_t& inout_size)
+{
+    syncRootPaths();
+    Path original_path;
+    uint64_t base_crc = 0;
+    if (!FirmwareDelta::parseDeltaFilePath(path, original_path, base_crc))
+    {
+        return backend_.read(path, offset, out_buffer, inout_size);
+    }
+
+    const int16_t res = selectPatch(path);
+    if (res != Error::OK)
+    {
+        return res;
+    }
+    const uint32_t len = (offset < patch_size_) ? min(patch_size_ - uint32_t(offset), uint32_t(inout_size)) : 0U;
+    (void)copy(patch_ + offset, patch_ + offset + len, out_buffer);
+    inout_size = uint16_t(len);
+    return Error::OK;
+}
+
+}
+
+#endif // UAVCAN_PROTOCOL_DELTA_FILE_SERVER_BACKEND_HPP_INCLUDED
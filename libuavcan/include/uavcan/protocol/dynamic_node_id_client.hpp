@@ -24,6 +24,10 @@ namespace uavcan
  * If the local node is equipped with redundant CAN interfaces, all of them will be used for publishing requests
  * and listening for responses.
  *
+ * If CAN FD is enabled on the local node (see @ref INode::enableCanFd()), the whole unique ID is sent in one
+ * request, so the allocation takes one round instead of three; otherwise, the unique ID is split across three
+ * classic CAN frames, as defined by the specification.
+ *
  * Once dynamic allocation is complete (or not needed anymore), the object can be deleted.
  *
  * Note that this class uses std::rand(), which must be correctly seeded before use.
@@ -58,6 +62,8 @@ class UAVCAN_EXPORT DynamicNodeIDClient : private TimerBase
 
     void restartTimer(const Mode mode);
 
+    bool isSingleRoundAllocation();
+
     virtual void handleTimerEvent(const TimerEvent&) override;
 
     void handleAllocation(const ReceivedDataStructure<protocol::dynamic_node_id::Allocation>& msg);
@@ -67,7 +73,7 @@ public:
 
     DynamicNodeIDClient(INode& node)
         : TimerBase(node)
-        , dnida_pub_(node)   // never use can fd for DNIDA
+        , dnida_pub_(node)
         , dnida_sub_(node)
         , size_of_received_unique_id_(0)
     { }
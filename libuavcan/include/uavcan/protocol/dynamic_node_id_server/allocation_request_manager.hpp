@@ -41,9 +41,19 @@ public:
 /**
  * This class manages communication with allocation clients.
  * Three-stage unique ID exchange is implemented here, as well as response publication.
+ * A request that carries the whole unique ID, which fits into one CAN FD frame, completes the exchange in one stage.
+ *
+ * The second and third stage requests don't identify the client, so only one multi-stage exchange can be in
+ * progress at a time. The first stage requests of other clients that arrive meanwhile are parked rather than
+ * dropped, and once the exchange is over, the next one is started right away with a follow-up response to the
+ * parked client; otherwise the client would have to wait for its next request period to try again.
  */
 class AllocationRequestManager
 {
+public:
+    enum { MaxParkedRequests = 4 };
+
+private:
     typedef MethodBinder<AllocationRequestManager*,
                          void (AllocationRequestManager::*)(const ReceivedDataStructure<Allocation>&)>
         AllocationCallback;
@@ -54,6 +64,15 @@ class AllocationRequestManager
     MonotonicTime last_activity_timestamp_;
     Allocation::FieldTypes::unique_id current_unique_id_;
 
+    struct ParkedRequest
+    {
+        MonotonicTime timestamp;
+        Allocation::FieldTypes::unique_id unique_id;    ///< First part only
+    };
+
+    ParkedRequest parked_requests_[MaxParkedRequests];
+    uint8_t num_parked_requests_;
+
     IAllocationRequestHandler& handler_;
     IEventTracer& tracer_;
 
@@ -125,6 +144,99 @@ class AllocationRequestManager
         }
     }
 
+    void dropParkedRequest(uint8_t index)
+    {
+        UAVCAN_ASSERT(index < num_parked_requests_);
+        for (uint8_t i = index; (i + 1U) < num_parked_requests_; i++)
+        {
+            parked_requests_[i] = parked_requests_[i + 1U];
+        }
+        num_parked_requests_--;
+    }
+
+    /**
+     * The clients that have not repeated their requests for a whole request period are assumed to be gone.
+     */
+    void dropStaleParkedRequests(MonotonicTime ts)
+    {
+        const MonotonicDuration max_age = MonotonicDuration::fromMSec(Allocation::MAX_REQUEST_PERIOD_MS);
+        uint8_t i = 0;
+        while (i < num_parked_requests_)
+        {
+            if (ts > (parked_requests_[i].timestamp + max_age))
+            {
+                dropParkedRequest(i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+
+    bool parkRequest(const ReceivedDataStructure<Allocation>& msg)
+    {
+        dropStaleParkedRequests(msg.getMonotonicTimestamp());
+
+        for (uint8_t i = 0; i < num_parked_requests_; i++)
+        {
+            if (parked_requests_[i].unique_id == msg.unique_id)
+            {
+                parked_requests_[i].timestamp = msg.getMonotonicTimestamp();    // The client is still waiting
+                return true;
+            }
+        }
+
+        if (num_parked_requests_ >= MaxParkedRequests)
+        {
+            return false;
+        }
+
+        parked_requests_[num_parked_requests_].timestamp = msg.getMonotonicTimestamp();
+        parked_requests_[num_parked_requests_].unique_id = msg.unique_id;
+        num_parked_requests_++;
+
+        trace(TraceAllocationRequestParked, num_parked_requests_);
+        return true;
+    }
+
+    /**
+     * Starts the exchange with the longest waiting parked client, as if it had just sent its first stage request.
+     */
+    void startParkedExchange(MonotonicTime ts)
+    {
+        UAVCAN_ASSERT(current_unique_id_.empty());
+
+        dropStaleParkedRequests(ts);
+        if ((num_parked_requests_ == 0) || !handler_.canPublishFollowupAllocationResponse())
+        {
+            return;
+        }
+
+        current_unique_id_ = parked_requests_[0].unique_id;
+        dropParkedRequest(0);
+
+        trace(TraceAllocationRequestAccepted, current_unique_id_.size());
+        publishFollowupAllocationResponse();
+        last_message_timestamp_ = ts;
+    }
+
+    void completeExchange(const UniqueID& unique_id, const uint8_t preferred_node_id)
+    {
+        UAVCAN_TRACE("AllocationRequestManager", "Allocation request received; preferred node ID: %d",
+                     int(preferred_node_id));
+        {
+            uint64_t event_agrument = 0;
+            for (uint8_t i = 0; i < 8; i++)
+            {
+                event_agrument |= static_cast<uint64_t>(unique_id[i]) << (56U - i * 8U);
+            }
+            trace(TraceAllocationExchangeComplete, static_cast<int64_t>(event_agrument));
+        }
+
+        handler_.handleAllocationRequest(unique_id, preferred_node_id);
+    }
+
     void handleAllocation(const ReceivedDataStructure<Allocation>& msg)
     {
         trace(TraceAllocationActivity, msg.getSrcNodeID().get());
@@ -135,6 +247,20 @@ class AllocationRequestManager
             return;         // This is a response from another allocator, ignore
         }
 
+        /*
+         * Single stage request, e.g. in a CAN FD frame. It is self-contained, so it is processed at once, leaving
+         * the multi-stage exchange with another client that may be in progress intact.
+         */
+        if (msg.first_part_of_unique_id && (msg.unique_id.size() == msg.unique_id.capacity()))
+        {
+            trace(TraceAllocationRequestAccepted, msg.unique_id.size());
+
+            UniqueID unique_id;
+            copy(msg.unique_id.begin(), msg.unique_id.end(), unique_id.begin());
+            completeExchange(unique_id, msg.node_id);
+            return;
+        }
+
         /*
          * Reset the expected stage on timeout
          */
@@ -164,6 +290,10 @@ class AllocationRequestManager
 
         if (request_stage != expected_stage)
         {
+            if ((request_stage == 1) && parkRequest(msg))
+            {
+                return;         // Another exchange is in progress, this one will follow
+            }
             trace(TraceAllocationUnexpectedStage, request_stage);
             return;             // Ignore - stage mismatch
         }
@@ -193,23 +323,11 @@ class AllocationRequestManager
          */
         if (current_unique_id_.size() == current_unique_id_.capacity())
         {
-            UAVCAN_TRACE("AllocationRequestManager", "Allocation request received; preferred node ID: %d",
-                         int(msg.node_id));
-
             UniqueID unique_id;
             copy(current_unique_id_.begin(), current_unique_id_.end(), unique_id.begin());
             current_unique_id_.clear();
 
-            {
-                uint64_t event_agrument = 0;
-                for (uint8_t i = 0; i < 8; i++)
-                {
-                    event_agrument |= static_cast<uint64_t>(unique_id[i]) << (56U - i * 8U);
-                }
-                trace(TraceAllocationExchangeComplete, static_cast<int64_t>(event_agrument));
-            }
-
-            handler_.handleAllocationRequest(unique_id, msg.node_id);
+            completeExchange(unique_id, msg.node_id);
         }
         else
         {
@@ -228,11 +346,20 @@ class AllocationRequestManager
          * It is super important to update timestamp only if the request has been processed successfully.
          */
         last_message_timestamp_ = msg.getMonotonicTimestamp();
+
+        /*
+         * If the exchange is over, the next parked client can proceed without waiting for its next request period.
+         */
+        if (current_unique_id_.empty())
+        {
+            startParkedExchange(msg.getMonotonicTimestamp());
+        }
     }
 
 public:
     AllocationRequestManager(INode& node, IEventTracer& tracer, IAllocationRequestHandler& handler)
         : stage_timeout_(MonotonicDuration::fromMSec(Allocation::FOLLOWUP_TIMEOUT_MS))
+        , num_parked_requests_(0)
         , handler_(handler)
         , tracer_(tracer)
         , allocation_sub_(node)
@@ -273,6 +400,27 @@ public:
         return allocation_pub_.broadcast(msg);
     }
 
+    /**
+     * Starts the exchange with a parked client unless there's an exchange in progress already. The allocator should
+     * call this once it is allowed to publish follow-up responses again, see
+     * @ref IAllocationRequestHandler::canPublishFollowupAllocationResponse().
+     */
+    void resumeParkedRequests()
+    {
+        const MonotonicTime ts = allocation_pub_.getNode().getMonotonicTime();
+        if (!current_unique_id_.empty() && (ts > (last_message_timestamp_ + stage_timeout_)))
+        {
+            UAVCAN_TRACE("AllocationRequestManager", "Stage timeout, reset");
+            current_unique_id_.clear();
+        }
+        if (current_unique_id_.empty())
+        {
+            startParkedExchange(ts);
+        }
+    }
+
+    uint8_t getNumParkedRequests() const { return num_parked_requests_; }
+
     /**
      * When the last allocation activity was registered.
      * This value can be used to heuristically determine whether there are any unallocated nodes left in the network.
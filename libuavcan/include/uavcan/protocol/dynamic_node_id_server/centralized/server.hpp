@@ -11,6 +11,7 @@
 #include <uavcan/protocol/dynamic_node_id_server/node_id_selector.hpp>
 #include <uavcan/protocol/dynamic_node_id_server/storage_marshaller.hpp>
 #include <uavcan/protocol/dynamic_node_id_server/centralized/storage.hpp>
+#include <uavcan/node/timer.hpp>
 
 namespace uavcan
 {
@@ -26,8 +27,10 @@ namespace centralized
  * This version is suitable only for simple non-critical systems.
  */
 class Server : public AbstractServer
+             , TimerBase
 {
     Storage storage_;
+    MonotonicDuration allocation_batch_window_;     ///< Zero if the batching is disabled
 
     /*
      * Private methods
@@ -47,6 +50,55 @@ class Server : public AbstractServer
         }
     }
 
+    void flushAllocationBatch()
+    {
+        TimerBase::stop();
+
+        const int res = storage_.commitPending();
+        if (res < 0)
+        {
+            tracer_.onEvent(TraceError, res);
+            node_.registerInternalFailure("CentralizedServer storage commit");
+        }
+        else
+        {
+            // The responses are sent only after the allocations have been stored
+            for (uint8_t i = 0; i < storage_.getNumPendingEntries(); i++)
+            {
+                const Storage::PendingEntry& entry = storage_.getPendingEntry(i);
+                tryPublishAllocationResult(entry.node_id, entry.unique_id);
+            }
+        }
+
+        // If the commit has failed, the allocatees will repeat their requests
+        storage_.discardPending();
+    }
+
+    int addToAllocationBatch(const NodeID node_id, const UniqueID& unique_id)
+    {
+        const int res = storage_.addPending(node_id, unique_id);
+        if (res < 0)
+        {
+            return res;
+        }
+
+        if (storage_.getNumPendingEntries() >= Storage::MaxPendingEntries)
+        {
+            flushAllocationBatch();
+        }
+        else if (!TimerBase::isRunning())
+        {
+            // The window starts with the first entry of the batch
+            TimerBase::startOneShotWithDelay(allocation_batch_window_);
+        }
+        return 0;
+    }
+
+    virtual void handleTimerEvent(const TimerEvent&) override
+    {
+        flushAllocationBatch();
+    }
+
     /*
      * Methods of IAllocationRequestHandler
      */
@@ -62,12 +114,25 @@ class Server : public AbstractServer
         {
             tryPublishAllocationResult(existing_node_id, unique_id);
         }
+        else if (storage_.getPendingNodeIDForUniqueID(unique_id).isValid())
+        {
+            UAVCAN_TRACE("dynamic_node_id_server::centralized::Server", "Request ignored - allocation is pending");
+        }
         else
         {
             const NodeID allocated_node_id =
                 NodeIDSelector<Server>(this, &Server::isNodeIDTaken).findFreeNodeID(preferred_node_id);
 
-            if (allocated_node_id.isUnicast())
+            if (allocated_node_id.isUnicast() && isAllocationBatchingEnabled())
+            {
+                const int res = addToAllocationBatch(allocated_node_id, unique_id);
+                if (res < 0)
+                {
+                    tracer_.onEvent(TraceError, res);
+                    node_.registerInternalFailure("CentralizedServer storage add");
+                }
+            }
+            else if (allocated_node_id.isUnicast())
             {
                 const int res = storage_.add(allocated_node_id, unique_id);
                 if (res >= 0)
@@ -121,6 +186,7 @@ public:
            IStorageBackend& storage,
            IEventTracer& tracer)
         : AbstractServer(node, tracer)
+        , TimerBase(node)
         , storage_(storage)
     { }
 
@@ -170,7 +236,32 @@ public:
         return 0;
     }
 
+    /**
+     * Number of stored allocations; the allocations of the current batch are not included.
+     */
     uint8_t getNumAllocations() const { return storage_.getSize(); }
+
+    /**
+     * When many nodes request allocations at once (e.g. at power up), every allocation costs two synchronous writes
+     * to the storage. With batching enabled, the new allocations are collected for up to the given window and then
+     * written together, with one occupation mask update and one call to @ref IStorageBackend::setMany(). The
+     * allocation responses are sent only after the batch has been written, so the window adds to the allocation
+     * latency; it should be well below the request period of the allocatees, e.g. 100 ms. A batch is written early
+     * once it reaches @ref Storage::MaxPendingEntries entries.
+     *
+     * @param window    Maximum delay of the first allocation of a batch; zero disables the batching (default).
+     */
+    void setAllocationBatchWindow(MonotonicDuration window)
+    {
+        allocation_batch_window_ = window.isNegative() ? MonotonicDuration() : window;
+        if (!isAllocationBatchingEnabled() && (storage_.getNumPendingEntries() > 0))
+        {
+            flushAllocationBatch();
+        }
+    }
+    MonotonicDuration getAllocationBatchWindow() const { return allocation_batch_window_; }
+
+    bool isAllocationBatchingEnabled() const { return allocation_batch_window_.isPositive(); }
 };
 
 }
@@ -20,9 +20,24 @@ namespace centralized
 /**
  * This class transparently replicates its state to the storage backend, keeping the most recent state in memory.
  * Writes are slow, reads are instantaneous.
+ *
+ * Besides the synchronous @ref add(), the entries can be collected into a pending batch with @ref addPending() and
+ * written together with @ref commitPending(), which costs one occupation mask update per batch rather than per entry.
+ * The pending entries are not durable, but their node IDs are reported as occupied, so that they can't be allocated
+ * twice.
  */
 class Storage
 {
+public:
+    enum { MaxPendingEntries = 8 };
+
+    struct PendingEntry
+    {
+        NodeID node_id;
+        UniqueID unique_id;
+    };
+
+private:
     typedef BitSet<NodeID::Max + 1> OccupationMask;
     typedef Array<IntegerSpec<8, SignednessUnsigned, CastModeSaturate>, ArrayModeStatic,
                   BitLenToByteLen<NodeID::Max + 1>::Result>
@@ -30,6 +45,8 @@ class Storage
 
     IStorageBackend& storage_;
     OccupationMask occupation_mask_;
+    PendingEntry pending_[MaxPendingEntries];
+    uint8_t num_pending_;
 
     static IStorageBackend::String getOccupationMaskKey() { return "occupation_mask"; }
 
@@ -64,7 +81,8 @@ class Storage
 
 public:
     Storage(IStorageBackend& storage) :
-        storage_(storage)
+        storage_(storage),
+        num_pending_(0)
     { }
 
     /**
@@ -127,8 +145,121 @@ public:
         return 0;
     }
 
+    /**
+     * Adds the entry to the pending batch; no storage IO is involved.
+     * Returns negative error code if the batch is full, see @ref MaxPendingEntries.
+     */
+    int addPending(const NodeID node_id, const UniqueID& unique_id)
+    {
+        if (!node_id.isUnicast() || isNodeIDOccupied(node_id))
+        {
+            return -ErrInvalidParam;
+        }
+        if (num_pending_ >= MaxPendingEntries)
+        {
+            return -ErrLogic;
+        }
+        pending_[num_pending_].node_id = node_id;
+        pending_[num_pending_].unique_id = unique_id;
+        num_pending_++;
+        return 0;
+    }
+
+    /**
+     * This method invokes storage IO.
+     * Writes all pending entries and the occupation mask with one call to @ref IStorageBackend::setMany(), then
+     * reads them back. The entries remain accessible via @ref getPendingEntry() until @ref discardPending() is called,
+     * so that the caller can act upon them, e.g. send the allocation responses.
+     * Returned value indicates whether the batch was successfully written; if it was not, the storage may contain
+     * dangling unique ID entries, which is OK.
+     */
+    int commitPending()
+    {
+        if (num_pending_ == 0)
+        {
+            return 0;
+        }
+
+        IStorageBackend::String keys[MaxPendingEntries + 1];
+        IStorageBackend::String values[MaxPendingEntries + 1];
+
+        OccupationMask new_occupation_mask = occupation_mask_;
+        for (uint8_t i = 0; i < num_pending_; i++)
+        {
+            keys[i] = StorageMarshaller::convertUniqueIDToHex(pending_[i].unique_id);
+            values[i].appendFormatted("%u", static_cast<unsigned>(pending_[i].node_id.get()));
+            new_occupation_mask[pending_[i].node_id.get()] = true;
+        }
+        keys[num_pending_] = getOccupationMaskKey();
+        values[num_pending_] = StorageMarshaller::convertUniqueIDToHex(maskToArray(new_occupation_mask));
+
+        UAVCAN_TRACE("dynamic_node_id_server::centralized::Storage", "Committing %u entries", unsigned(num_pending_));
+        storage_.setMany(keys, values, static_cast<uint8_t>(num_pending_ + 1U));
+
+        // Reading back
+        StorageMarshaller io(storage_);
+        for (uint8_t i = 0; i < num_pending_; i++)
+        {
+            uint32_t node_id_int = 0;
+            const int res = io.get(keys[i], node_id_int);
+            if (res < 0)
+            {
+                return res;
+            }
+            if (node_id_int != pending_[i].node_id.get())
+            {
+                return -ErrFailure;
+            }
+        }
+
+        OccupationMaskArray occupation_array;
+        const int res = io.get(getOccupationMaskKey(), occupation_array);
+        if (res < 0)
+        {
+            return res;
+        }
+        if (occupation_array != maskToArray(new_occupation_mask))
+        {
+            return -ErrFailure;
+        }
+
+        // Updating the cached mask only if the storage was updated successfully
+        occupation_mask_ = new_occupation_mask;
+
+        return 0;
+    }
+
+    /**
+     * Forgets the pending entries, whether they have been committed or not.
+     */
+    void discardPending() { num_pending_ = 0; }
+
+    uint8_t getNumPendingEntries() const { return num_pending_; }
+
+    const PendingEntry& getPendingEntry(uint8_t index) const
+    {
+        UAVCAN_ASSERT(index < num_pending_);
+        return pending_[min(index, static_cast<uint8_t>(MaxPendingEntries - 1))];
+    }
+
+    /**
+     * Returns an invalid node ID if there's no such pending entry.
+     */
+    NodeID getPendingNodeIDForUniqueID(const UniqueID& unique_id) const
+    {
+        for (uint8_t i = 0; i < num_pending_; i++)
+        {
+            if (pending_[i].unique_id == unique_id)
+            {
+                return pending_[i].node_id;
+            }
+        }
+        return NodeID();
+    }
+
     /**
      * Returns an invalid node ID if there's no such allocation.
+     * The pending entries are not considered.
      */
     NodeID getNodeIDForUniqueID(const UniqueID& unique_id) const
     {
@@ -138,8 +269,28 @@ public:
         return (node_id > 0 && node_id <= NodeID::Max) ? NodeID(static_cast<uint8_t>(node_id)) : NodeID();
     }
 
-    bool isNodeIDOccupied(NodeID node_id) const { return occupation_mask_[node_id.get()]; }
+    /**
+     * The pending entries are considered occupied.
+     */
+    bool isNodeIDOccupied(NodeID node_id) const
+    {
+        if (occupation_mask_[node_id.get()])
+        {
+            return true;
+        }
+        for (uint8_t i = 0; i < num_pending_; i++)
+        {
+            if (pending_[i].node_id == node_id)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
 
+    /**
+     * Number of committed allocations.
+     */
     uint8_t getSize() const { return static_cast<uint8_t>(occupation_mask_.count()); }
 };
 
@@ -359,6 +359,19 @@ public:
         }
     }
 
+    void setServerNextIndex(NodeID server_node_id, Log::Index next_index)
+    {
+        Server* const s = findServer(server_node_id);
+        if (s != UAVCAN_NULLPTR)
+        {
+            s->next_index = next_index;
+        }
+        else
+        {
+            UAVCAN_ASSERT(0);
+        }
+    }
+
     void decrementServerNextIndex(NodeID server_node_id)
     {
         Server* const s = findServer(server_node_id);
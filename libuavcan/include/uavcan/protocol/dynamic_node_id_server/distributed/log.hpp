@@ -21,6 +21,16 @@ namespace distributed
  * Raft log.
  * This class transparently replicates its state to the storage backend, keeping the most recent state in memory.
  * Writes are slow, reads are instantaneous.
+ *
+ * If the storage backend provides a journal (see @ref IStorageBackend::getJournal()), every operation on the log
+ * is stored as one journal record; the state of the log is restored by replaying the records at startup.
+ * Otherwise every entry is stored as three key/value pairs, plus the key that holds the last index.
+ *
+ * The journal also carries the other persistent variables of Raft on behalf of @ref PersistentState, and the
+ * writes can be batched, so that all updates caused by one request are committed with one sync.
+ *
+ * The entries are indexed by unique ID and by node ID in memory, so that the allocator can find an existing
+ * allocation without traversing the log. The indexes are rebuilt on initialization.
  */
 class Log
 {
@@ -29,11 +39,111 @@ public:
 
     enum { Capacity = NodeID::Max + 1 };
 
+    /**
+     * Latest values of the persistent variables of Raft found in the journal.
+     */
+    struct JournaledState
+    {
+        Term current_term;
+        NodeID voted_for;
+        bool has_current_term;
+        bool has_voted_for;
+
+        JournaledState()
+            : current_term(0)
+            , has_current_term(false)
+            , has_voted_for(false)
+        { }
+    };
+
 private:
+    enum JournalRecordType
+    {
+        JournalRecordEntry = 1,         ///< Type, index, term (4 bytes LE), unique ID, node ID
+        JournalRecordLastIndex = 2,     ///< Type, index; entries past the index are removed
+        JournalRecordCurrentTerm = 3,   ///< Type, term (4 bytes LE)
+        JournalRecordVotedFor = 4       ///< Type, node ID
+    };
+
+    enum { JournalEntryRecordLength = 2 + 4 + UniqueID::MaxSize + 1 };
+
+    enum { UniqueIDHashTableSize = 64 };    ///< Must be a power of two
+
+    enum { NoIndex = 0xFF };
+
     IStorageBackend& storage_;
+    IJournalStorageBackend* const journal_;
     IEventTracer& tracer_;
     Entry entries_[Capacity];
     Index last_index_;             // Index zero always contains an empty entry
+    JournaledState journaled_state_;
+    bool batch_open_;
+    bool batch_dirty_;             // Has records that are not synced yet
+
+    /*
+     * In-memory indexes. Every bucket is a chain of log indexes in descending order, so that the last matching entry
+     * is found first, and the entries that are removed from the end of the log are always at the heads of the chains.
+     */
+    Index unique_id_buckets_[UniqueIDHashTableSize];
+    Index node_id_buckets_[NodeID::Max + 1];
+    Index unique_id_chain_[Capacity];       ///< Next lower index in the same bucket
+    Index node_id_chain_[Capacity];
+
+    static uint8_t hashUniqueID(const UniqueID& unique_id)
+    {
+        uint32_t hash = 0;
+        for (uint8_t i = 0; i < UniqueID::MaxSize; i++)
+        {
+            hash = hash * 31U + unique_id[i];
+        }
+        return uint8_t((hash ^ (hash >> 8)) & (UniqueIDHashTableSize - 1U));
+    }
+
+    void resetIndexes()
+    {
+        fill_n(unique_id_buckets_, unsigned(UniqueIDHashTableSize), Index(NoIndex));
+        fill_n(node_id_buckets_, unsigned(NodeID::Max + 1), Index(NoIndex));
+    }
+
+    /**
+     * Must be called for every new entry, in ascending order of indexes.
+     */
+    void addEntryToIndexes(Index index)
+    {
+        const Entry& entry = entries_[index];
+        Index& uid_head = unique_id_buckets_[hashUniqueID(entry.unique_id)];
+        unique_id_chain_[index] = uid_head;
+        uid_head = index;
+        Index& nid_head = node_id_buckets_[entry.node_id];
+        node_id_chain_[index] = nid_head;
+        nid_head = index;
+    }
+
+    void rebuildIndexes()
+    {
+        resetIndexes();
+        for (unsigned index = 0; index <= last_index_; index++)
+        {
+            addEntryToIndexes(Index(index));
+        }
+    }
+
+    /**
+     * Must be called before the entries past the new last index are removed.
+     */
+    void removeEntriesFromIndexes(Index new_last_index)
+    {
+        for (unsigned index = last_index_; index > new_last_index; index--)
+        {
+            const Entry& entry = entries_[index];
+            Index& uid_head = unique_id_buckets_[hashUniqueID(entry.unique_id)];
+            UAVCAN_ASSERT(uid_head == index);
+            uid_head = unique_id_chain_[index];
+            Index& nid_head = node_id_buckets_[entry.node_id];
+            UAVCAN_ASSERT(nid_head == index);
+            nid_head = node_id_chain_[index];
+        }
+    }
 
     static IStorageBackend::String getLastIndexKey() { return "log_last_index"; }
 
@@ -108,6 +218,125 @@ private:
         return (temp == entry) ? 0 : -ErrFailure;
     }
 
+    /*
+     * Journal IO
+     */
+    static void encodeTerm(Term term, uint8_t* out)
+    {
+        for (unsigned i = 0; i < 4; i++)
+        {
+            out[i] = uint8_t(term >> (i * 8U));
+        }
+    }
+
+    static Term decodeTerm(const uint8_t* data)
+    {
+        Term term = 0;
+        for (unsigned i = 0; i < 4; i++)
+        {
+            term |= Term(data[i]) << (i * 8U);
+        }
+        return term;
+    }
+
+    int writeToJournal(const uint8_t* record, uint8_t length)
+    {
+        UAVCAN_ASSERT(journal_ != UAVCAN_NULLPTR);
+        if (batch_open_)
+        {
+            batch_dirty_ = true;
+            return journal_->appendWithoutSync(record, length);
+        }
+        return journal_->append(record, length);
+    }
+
+    int appendEntryToJournal(Index index, const Entry& entry)
+    {
+        uint8_t record[JournalEntryRecordLength];
+        record[0] = JournalRecordEntry;
+        record[1] = index;
+        encodeTerm(entry.term, &record[2]);
+        (void)copy(entry.unique_id.begin(), entry.unique_id.end(), &record[6]);
+        record[JournalEntryRecordLength - 1] = entry.node_id;
+        return writeToJournal(record, uint8_t(sizeof(record)));
+    }
+
+    int appendLastIndexToJournal(Index index)
+    {
+        const uint8_t record[2] = { JournalRecordLastIndex, index };
+        return writeToJournal(record, uint8_t(sizeof(record)));
+    }
+
+    int initFromJournal()
+    {
+        entries_[0] = Entry();
+        last_index_ = 0;
+        journaled_state_ = JournaledState();
+
+        for (uint32_t record_index = 0; true; record_index++)
+        {
+            uint8_t record[IJournalStorageBackend::MaxRecordLength];
+            const int length = journal_->read(record_index, record);
+            if (length < 0)
+            {
+                return length;
+            }
+            if (length == 0)
+            {
+                break;
+            }
+
+            const Index index = record[1];
+            if ((record[0] == JournalRecordEntry) && (length == JournalEntryRecordLength))
+            {
+                // Entries are only ever appended to the end of the log
+                if ((index == 0) || (index >= Capacity) || (index > (last_index_ + 1U)) ||
+                    (record[JournalEntryRecordLength - 1] > NodeID::Max))
+                {
+                    return -ErrFailure;
+                }
+                Entry& entry = entries_[index];
+                entry.term = decodeTerm(&record[2]);
+                (void)copy(&record[6], &record[6 + UniqueID::MaxSize], entry.unique_id.begin());
+                entry.node_id = record[JournalEntryRecordLength - 1];
+                last_index_ = index;
+            }
+            else if ((record[0] == JournalRecordLastIndex) && (length == 2))
+            {
+                if (index > last_index_)
+                {
+                    return -ErrFailure;
+                }
+                last_index_ = index;
+            }
+            else if ((record[0] == JournalRecordCurrentTerm) && (length == 5))
+            {
+                journaled_state_.current_term = decodeTerm(&record[1]);
+                journaled_state_.has_current_term = true;
+            }
+            else if ((record[0] == JournalRecordVotedFor) && (length == 2) && (record[1] <= NodeID::Max))
+            {
+                journaled_state_.voted_for = NodeID(record[1]);
+                journaled_state_.has_voted_for = true;
+            }
+            else
+            {
+                UAVCAN_TRACE("dynamic_node_id_server::distributed::Log", "Bad journal record %u",
+                             unsigned(record_index));
+                return -ErrFailure;
+            }
+        }
+
+        rebuildIndexes();
+        tracer_.onEvent(TraceRaftLogLastIndexRestored, last_index_);
+        UAVCAN_TRACE("dynamic_node_id_server::distributed::Log", "Restored %u log entries from journal",
+                     unsigned(last_index_));
+        return 0;
+    }
+
+    /*
+     * Key/value IO
+     */
     int initEmptyLogStorage()
     {
         StorageMarshaller io(storage_);
@@ -139,18 +368,31 @@ private:
             return -ErrFailure;
         }
 
+        rebuildIndexes();
         return 0;
     }
 
 public:
     Log(IStorageBackend& storage, IEventTracer& tracer)
         : storage_(storage)
+        , journal_(storage.getJournal())
         , tracer_(tracer)
         , last_index_(0)
-    { }
+        , batch_open_(false)
+        , batch_dirty_(false)
+    {
+        StaticAssert<(unsigned(Capacity) < unsigned(NoIndex))>::check();
+        resetIndexes();
+        addEntryToIndexes(0);
+    }
 
     int init()
     {
+        if (journal_ != UAVCAN_NULLPTR)
+        {
+            return initFromJournal();
+        }
+
         StorageMarshaller io(storage_);
 
         // Reading max index
@@ -191,6 +433,7 @@ public:
             }
         }
 
+        rebuildIndexes();
         UAVCAN_TRACE("dynamic_node_id_server::distributed::Log", "Restored %u log entries", unsigned(last_index_));
         return 0;
     }
@@ -208,6 +451,21 @@ public:
 
         tracer_.onEvent(TraceRaftLogAppend, last_index_ + 1U);
 
+        if (journal_ != UAVCAN_NULLPTR)
+        {
+            const int res = appendEntryToJournal(Index(last_index_ + 1), entry);
+            if (res < 0)
+            {
+                return res;
+            }
+            last_index_++;
+            entries_[last_index_] = entry;
+            addEntryToIndexes(last_index_);
+            UAVCAN_TRACE("dynamic_node_id_server::distributed::Log", "New entry, index %u, node ID %u, term %u",
+                         unsigned(last_index_), unsigned(entry.node_id), unsigned(entry.term));
+            return 0;
+        }
+
         // If next operations fail, we'll get a dangling entry, but it's absolutely OK.
         int res = writeEntryToStorage(Index(last_index_ + 1), entry);
         if (res < 0)
@@ -229,6 +487,7 @@ public:
         }
         entries_[new_last_index] = entry;
         last_index_ = Index(new_last_index);
+        addEntryToIndexes(last_index_);
 
         UAVCAN_TRACE("dynamic_node_id_server::distributed::Log", "New entry, index %u, node ID %u, term %u",
                      unsigned(last_index_), unsigned(entry.node_id), unsigned(entry.term));
@@ -252,7 +511,23 @@ public:
 
         tracer_.onEvent(TraceRaftLogRemove, new_last_index);
 
-        if (new_last_index != last_index_)
+        if (journal_ != UAVCAN_NULLPTR)
+        {
+            if (new_last_index >= last_index_)
+            {
+                return 0;                   // Nothing to remove
+            }
+            const int res = appendLastIndexToJournal(Index(new_last_index));
+            if (res < 0)
+            {
+                return res;
+            }
+            UAVCAN_TRACE("dynamic_node_id_server::distributed::Log", "Entries removed, last index %u --> %u",
+                         unsigned(last_index_), unsigned(new_last_index));
+            removeEntriesFromIndexes(Index(new_last_index));
+            last_index_ = Index(new_last_index);
+        }
+        else if (new_last_index != last_index_)
         {
             StorageMarshaller io(storage_);
             int res = io.setAndGetBack(getLastIndexKey(), new_last_index);
@@ -266,6 +541,7 @@ public:
             }
             UAVCAN_TRACE("dynamic_node_id_server::distributed::Log", "Entries removed, last index %u --> %u",
                          unsigned(last_index_), unsigned(new_last_index));
+            removeEntriesFromIndexes(Index(new_last_index));
             last_index_ = Index(new_last_index);
         }
 
@@ -278,6 +554,63 @@ public:
         return removeEntriesWhereIndexGreaterOrEqual(Index(index + 1U));
     }
 
+    /**
+     * Until the batch is committed, the updates of the journal are not guaranteed to be on stable storage, although
+     * the state in memory is updated immediately. Batching has no effect without a journal, because every
+     * key/value pair is stored separately.
+     * Committing returns negative error code if the batch could not be synced.
+     */
+    void beginBatch()
+    {
+        UAVCAN_ASSERT(!batch_open_);
+        batch_open_ = true;
+    }
+
+    int commitBatch()
+    {
+        UAVCAN_ASSERT(batch_open_);
+        batch_open_ = false;
+        if (!batch_dirty_)
+        {
+            return 0;                       // Nothing was written, no need to sync
+        }
+        batch_dirty_ = false;
+        return journal_->sync();
+    }
+
+    /**
+     * These methods are used by @ref PersistentState to keep its variables in the journal.
+     * The journaled state is restored by @ref init().
+     */
+    bool hasJournal() const { return journal_ != UAVCAN_NULLPTR; }
+
+    const JournaledState& getJournaledState() const { return journaled_state_; }
+
+    int journalCurrentTerm(Term term)
+    {
+        uint8_t record[5] = { JournalRecordCurrentTerm, 0, 0, 0, 0 };
+        encodeTerm(term, &record[1]);
+        const int res = writeToJournal(record, uint8_t(sizeof(record)));
+        if (res >= 0)
+        {
+            journaled_state_.current_term = term;
+            journaled_state_.has_current_term = true;
+        }
+        return res;
+    }
+
+    int journalVotedFor(NodeID node_id)
+    {
+        const uint8_t record[2] = { JournalRecordVotedFor, node_id.get() };
+        const int res = writeToJournal(record, uint8_t(sizeof(record)));
+        if (res >= 0)
+        {
+            journaled_state_.voted_for = node_id;
+            journaled_state_.has_voted_for = true;
+        }
+        return res;
+    }
+
     /**
      * Returns nullptr if there's no such index.
      * This method does not use storage IO.
@@ -290,6 +623,37 @@ public:
 
     Index getLastIndex() const { return last_index_; }
 
+    /**
+     * Returns the index of the last entry with the given unique ID or node ID, or a negative value if there's
+     * no such entry. The zero entry is included, like in a traversal of the log.
+     * These methods do not use storage IO; the complexity is O(1) on average.
+     */
+    int findLastIndexOfUniqueID(const UniqueID& unique_id) const
+    {
+        for (Index index = unique_id_buckets_[hashUniqueID(unique_id)];
+             index != NoIndex;
+             index = unique_id_chain_[index])
+        {
+            UAVCAN_ASSERT(index <= last_index_);
+            if (entries_[index].unique_id == unique_id)
+            {
+                return index;
+            }
+        }
+        return -1;
+    }
+
+    int findLastIndexOfNodeID(NodeID node_id) const
+    {
+        if (!node_id.isValid())
+        {
+            return -1;
+        }
+        const Index index = node_id_buckets_[node_id.get()];
+        UAVCAN_ASSERT((index == NoIndex) || (index <= last_index_));
+        return (index == NoIndex) ? -1 : int(index);
+    }
+
     bool isOtherLogUpToDate(Index other_last_index, Term other_last_term) const
     {
         UAVCAN_ASSERT(last_index_ < Capacity);
@@ -21,6 +21,9 @@ namespace distributed
 /**
  * This class is a convenient container for persistent state variables defined by Raft.
  * Writes are slow, reads are instantaneous.
+ *
+ * If the storage backend provides a journal, the variables are stored there along with the log, so that
+ * the updates can be grouped into transactions; see @ref beginTransaction().
  */
 class PersistentState
 {
@@ -34,6 +37,41 @@ class PersistentState
     static IStorageBackend::String getCurrentTermKey() { return "current_term"; }
     static IStorageBackend::String getVotedForKey() { return "voted_for"; }
 
+    /**
+     * Same rules as for the key/value storage, except that the missing initial values are not written out,
+     * because an empty journal is restored to the same state.
+     */
+    int initFromJournal(bool log_is_empty, const Entry& last_entry)
+    {
+        const Log::JournaledState& state = log_.getJournaledState();
+
+        if (!state.has_current_term && !log_is_empty)
+        {
+            UAVCAN_TRACE("dynamic_node_id_server::distributed::PersistentState", "No current term in journal");
+            return -ErrFailure;
+        }
+        current_term_ = state.has_current_term ? state.current_term : 0;
+        tracer_.onEvent(TraceRaftCurrentTermRestored, current_term_);
+
+        if (current_term_ < last_entry.term)
+        {
+            UAVCAN_TRACE("dynamic_node_id_server::distributed::PersistentState",
+                         "Persistent storage is damaged: current term is less than term of the last log entry (%u < %u)",
+                         unsigned(current_term_), unsigned(last_entry.term));
+            return -ErrLogic;
+        }
+
+        if (!state.has_voted_for && !(log_is_empty && (current_term_ == 0)))
+        {
+            UAVCAN_TRACE("dynamic_node_id_server::distributed::PersistentState", "No votedFor in journal");
+            return -ErrFailure;
+        }
+        voted_for_ = state.has_voted_for ? state.voted_for : NodeID(0);
+        tracer_.onEvent(TraceRaftVotedForRestored, voted_for_.get());
+
+        return 0;
+    }
+
 public:
     PersistentState(IStorageBackend& storage, IEventTracer& tracer)
         : storage_(storage)
@@ -71,6 +109,11 @@ public:
 
         const bool log_is_empty = (log_.getLastIndex() == 0) && (last_entry->term == 0);
 
+        if (log_.hasJournal())
+        {
+            return initFromJournal(log_is_empty, *last_entry);
+        }
+
         StorageMarshaller io(storage_);
 
         /*
@@ -157,6 +200,15 @@ public:
         return 0;
     }
 
+    /**
+     * Updates made between these calls are committed to stable storage at once, if the storage backend provides
+     * a journal; otherwise every update is stored immediately, as usual. Transactions can't be nested.
+     * The values in memory are updated immediately in either case.
+     * Committing returns negative error code; in that case, the updates may have been lost.
+     */
+    void beginTransaction() { log_.beginBatch(); }
+    int commitTransaction() { return log_.commitBatch(); }
+
     Term getCurrentTerm() const { return current_term_; }
 
     NodeID getVotedFor() const { return voted_for_; }
@@ -178,6 +230,16 @@ public:
 
         tracer_.onEvent(TraceRaftCurrentTermUpdate, term);
 
+        if (log_.hasJournal())
+        {
+            const int res = log_.journalCurrentTerm(term);
+            if (res >= 0)
+            {
+                current_term_ = term;
+            }
+            return res;
+        }
+
         StorageMarshaller io(storage_);
 
         Term tmp = term;
@@ -209,6 +271,16 @@ public:
 
         tracer_.onEvent(TraceRaftVotedForUpdate, node_id.get());
 
+        if (log_.hasJournal())
+        {
+            const int res = log_.journalVotedFor(node_id);
+            if (res >= 0)
+            {
+                voted_for_ = node_id;
+            }
+            return res;
+        }
+
         StorageMarshaller io(storage_);
 
         uint32_t tmp = node_id.get();
@@ -60,6 +60,16 @@ public:
  *   - newer term in response (also switch to follower)
  *   - append entries request with term >= currentTerm
  *   - vote granted
+ *
+ * Elections are made as non-disruptive as the RequestVote data type allows:
+ *   - A candidate does not commit to the term it is campaigning for until it has won the election, so that a server
+ *     that keeps campaigning in a minor partition does not inflate its term and does not depose the leader with
+ *     a newer term once the partition is healed. This is what the pre-vote phase achieves in the Raft thesis;
+ *     RequestVote has no field to mark a pre-vote request, hence the candidate probes with the real request.
+ *   - Leader stickiness: a server refuses to vote without updating its term while it hears from the leader, or,
+ *     being the leader, while it hears from the quorum. See the Raft thesis, section 4.2.3.
+ *   - A leader that is going to shut down can hand over the leadership, see @ref handOverLeadership(); the other
+ *     servers elect a new leader as soon as they learn about the shutdown, see @ref handleServerShutdown().
  */
 class RaftCore : private TimerBase
 {
@@ -88,6 +98,7 @@ private:
 
     struct PendingAppendEntriesFields
     {
+        ServiceCallID call_id;          ///< Invalid if not in use
         Log::Index prev_log_index;
         Log::Index num_entries;
 
@@ -102,6 +113,15 @@ private:
      */
     enum { MaxNumFollowers = ClusterManager::MaxClusterSize - 1 };
 
+    /**
+     * Number of AppendEntries calls that can be outstanding to one follower at a time.
+     * The requests are sent back-to-back, each one carrying the entry that follows the previous request, without
+     * waiting for the responses; the transport delivers them to the follower in order.
+     */
+    enum { AppendEntriesPipelineDepth = 4 };
+
+    enum { MaxPendingAppendEntriesCalls = MaxNumFollowers * AppendEntriesPipelineDepth };
+
     IEventTracer& tracer_;
     IRaftLeaderMonitor& leader_monitor_;
 
@@ -118,8 +138,13 @@ private:
 
     uint8_t next_server_index_;         ///< Next server to query AE from
     uint8_t num_votes_received_in_this_campaign_;
+    Term campaign_term_;                ///< Committed to the persistent state only once the election is won
+
+    NodeID leader_node_id_;             ///< Leader of the current term as seen by a follower; invalid if unknown
+    MonotonicTime last_leader_contact_timestamp_;
+    MonotonicTime follower_contact_timestamps_[MaxNumFollowers];    ///< Indexed like the known servers
 
-    PendingAppendEntriesFields pending_append_entries_fields_;
+    PendingAppendEntriesFields pending_append_entries_fields_[MaxPendingAppendEntriesCalls];
 
     /*
      * Transport
@@ -150,11 +175,11 @@ private:
 
         // Elections
         UAVCAN_ASSERT(server_state_ != ServerStateCandidate || !request_vote_client_.hasPendingCalls() ||
-                      persistent_state_.getVotedFor() == getNode().getNodeID());
+                      campaign_term_ == persistent_state_.getCurrentTerm() + 1U);
         UAVCAN_ASSERT(num_votes_received_in_this_campaign_ <= cluster_.getClusterSize());
 
         // Transport
-        UAVCAN_ASSERT(append_entries_client_.getNumPendingCalls() <= 1);
+        UAVCAN_ASSERT(append_entries_client_.getNumPendingCalls() <= MaxPendingAppendEntriesCalls);
         UAVCAN_ASSERT(request_vote_client_.getNumPendingCalls() <= cluster_.getNumKnownServers());
         UAVCAN_ASSERT(server_state_ != ServerStateCandidate || !append_entries_client_.hasPendingCalls());
         UAVCAN_ASSERT(server_state_ != ServerStateLeader    || !request_vote_client_.hasPendingCalls());
@@ -183,6 +208,53 @@ private:
         return getNode().getMonotonicTime() > (last_activity_timestamp_ + randomized_activity_timeout_);
     }
 
+    static MonotonicDuration getMinElectionTimeout()
+    {
+        return MonotonicDuration::fromMSec(AppendEntries::Request::DEFAULT_MIN_ELECTION_TIMEOUT_MS);
+    }
+
+    void registerFollowerContact(NodeID node_id)
+    {
+        for (uint8_t i = 0; i < cluster_.getNumKnownServers(); i++)
+        {
+            if (cluster_.getRemoteServerNodeIDAtIndex(i) == node_id)
+            {
+                follower_contact_timestamps_[i] = getNode().getMonotonicTime();
+                break;
+            }
+        }
+    }
+
+    /**
+     * Whether the current leader is known to be alive; if so, vote requests are refused (leader stickiness).
+     * A follower relies on the AppendEntries requests from the leader, the leader relies on the responses from the
+     * followers: a leader that can't reach the quorum does not hold on to the leadership.
+     */
+    bool isLeaderAlive() const
+    {
+        const MonotonicTime contact_deadline = getNode().getMonotonicTime() - getMinElectionTimeout();
+
+        if (server_state_ == ServerStateFollower)
+        {
+            return leader_node_id_.isUnicast() && (last_leader_contact_timestamp_ > contact_deadline);
+        }
+
+        if (server_state_ == ServerStateLeader)
+        {
+            uint8_t num_servers_in_contact = 1;         // Local node
+            for (uint8_t i = 0; i < cluster_.getNumKnownServers(); i++)
+            {
+                if (follower_contact_timestamps_[i] > contact_deadline)
+                {
+                    num_servers_in_contact++;
+                }
+            }
+            return num_servers_in_contact >= cluster_.getQuorumSize();
+        }
+
+        return false;
+    }
+
     void handlePersistentStateUpdateError(int error)
     {
         UAVCAN_ASSERT(error < 0);
@@ -209,32 +281,47 @@ private:
 
             UAVCAN_TRACE("dynamic_node_id_server::distributed::RaftCore", "Election complete, won: %d", int(won));
 
+            if (won)
+            {
+                /*
+                 * Set votedFor and increment current term in one transaction, abort on failure.
+                 * The term could not have changed during the campaign, since that would have ended it.
+                 */
+                UAVCAN_ASSERT(campaign_term_ == persistent_state_.getCurrentTerm() + 1U);
+                persistent_state_.beginTransaction();
+                int res = persistent_state_.setVotedFor(getNode().getNodeID());
+                if (res >= 0)
+                {
+                    res = persistent_state_.setCurrentTerm(campaign_term_);
+                }
+                const int commit_res = persistent_state_.commitTransaction();
+                if (res >= 0)
+                {
+                    res = commit_res;
+                }
+                if (res < 0)
+                {
+                    handlePersistentStateUpdateError(res);
+                    return;
+                }
+            }
+
             switchState(won ? ServerStateLeader : ServerStateFollower);       // Start over or become leader
         }
         else
         {
-            // Set votedFor, abort on failure
-            int res = persistent_state_.setVotedFor(getNode().getNodeID());
-            if (res < 0)
-            {
-                handlePersistentStateUpdateError(res);
-                return;
-            }
-
-            // Increment current term, abort on failure
-            res = persistent_state_.setCurrentTerm(persistent_state_.getCurrentTerm() + 1U);
-            if (res < 0)
-            {
-                handlePersistentStateUpdateError(res);
-                return;
-            }
-
+            /*
+             * The next term is only proposed; should the election fail, the local term stays where it was.
+             * The servers that have granted their votes will have moved to the proposed term, but since they
+             * have voted for this server, the term can be proposed again.
+             */
+            campaign_term_ = Term(persistent_state_.getCurrentTerm() + 1U);
             num_votes_received_in_this_campaign_ = 1;               // Voting for self
 
             RequestVote::Request req;
             req.last_log_index = persistent_state_.getLog().getLastIndex();
             req.last_log_term = persistent_state_.getLog().getEntryAtIndex(req.last_log_index)->term;
-            req.term = persistent_state_.getCurrentTerm();
+            req.term = campaign_term_;
 
             for (uint8_t i = 0; i < MaxNumFollowers; i++)
             {
@@ -248,7 +335,7 @@ private:
                              "Requesting vote from %d", int(node_id.get()));
                 trace(TraceRaftVoteRequestInitiation, node_id.get());
 
-                res = request_vote_client_.call(node_id, req);
+                const int res = request_vote_client_.call(node_id, req);
                 if (res < 0)
                 {
                     trace(TraceError, res);
@@ -257,58 +344,154 @@ private:
         }
     }
 
-    void updateLeader()
+    /**
+     * Returns the fields of the pending call with the given ID, or a free slot if the ID is invalid.
+     */
+    PendingAppendEntriesFields* findPendingAppendEntries(ServiceCallID call_id)
     {
-        if (append_entries_client_.hasPendingCalls())
+        for (unsigned i = 0; i < MaxPendingAppendEntriesCalls; i++)
         {
-            append_entries_client_.cancelAllCalls();    // Refer to the response callback to learn why
+            const ServiceCallID& id = pending_append_entries_fields_[i].call_id;
+            if (call_id.isValid() ? (id == call_id) : !id.isValid())
+            {
+                return &pending_append_entries_fields_[i];
+            }
         }
+        return UAVCAN_NULLPTR;
+    }
 
-        if (cluster_.getClusterSize() > 1)
+    unsigned getNumPendingAppendEntries(NodeID node_id) const
+    {
+        unsigned num = 0;
+        for (unsigned i = 0; i < MaxPendingAppendEntriesCalls; i++)
         {
-            const NodeID node_id = cluster_.getRemoteServerNodeIDAtIndex(next_server_index_);
-            UAVCAN_ASSERT(node_id.isUnicast());
+            if (pending_append_entries_fields_[i].call_id.server_node_id == node_id)
+            {
+                num++;
+            }
+        }
+        return num;
+    }
 
-            next_server_index_++;
-            if (next_server_index_ >= cluster_.getNumKnownServers())
+    /**
+     * Index of the last entry that has been sent to the follower, acknowledged or not.
+     */
+    Log::Index getReplicationHead(NodeID node_id) const
+    {
+        Log::Index head = Log::Index(cluster_.getServerNextIndex(node_id) - 1U);
+        for (unsigned i = 0; i < MaxPendingAppendEntriesCalls; i++)
+        {
+            const PendingAppendEntriesFields& f = pending_append_entries_fields_[i];
+            if (f.call_id.server_node_id == node_id)
             {
-                next_server_index_ = 0;
+                head = max(head, Log::Index(f.prev_log_index + f.num_entries));
+            }
+        }
+        return head;
+    }
+
+    void cancelPendingAppendEntries(NodeID node_id)
+    {
+        for (unsigned i = 0; i < MaxPendingAppendEntriesCalls; i++)
+        {
+            if (pending_append_entries_fields_[i].call_id.server_node_id == node_id)
+            {
+                append_entries_client_.cancelCall(pending_append_entries_fields_[i].call_id);
+                pending_append_entries_fields_[i] = PendingAppendEntriesFields();
             }
+        }
+    }
 
-            AppendEntries::Request req;
-            req.term = persistent_state_.getCurrentTerm();
-            req.leader_commit = commit_index_;
+    void resetPendingAppendEntries()
+    {
+        append_entries_client_.cancelAllCalls();
+        for (unsigned i = 0; i < MaxPendingAppendEntriesCalls; i++)
+        {
+            pending_append_entries_fields_[i] = PendingAppendEntriesFields();
+        }
+    }
 
-            req.prev_log_index = Log::Index(cluster_.getServerNextIndex(node_id) - 1U);
+    /**
+     * Sends the entry that follows the replication head to the follower, or no entries if there are no more.
+     * Returns false if the request could not be sent, e.g. because the pipeline is full.
+     */
+    bool sendAppendEntries(NodeID node_id)
+    {
+        UAVCAN_ASSERT(node_id.isUnicast());
 
-            const Entry* const entry = persistent_state_.getLog().getEntryAtIndex(req.prev_log_index);
-            if (entry == UAVCAN_NULLPTR)
+        PendingAppendEntriesFields* const pending = findPendingAppendEntries(ServiceCallID());
+        if ((pending == UAVCAN_NULLPTR) || (getNumPendingAppendEntries(node_id) >= AppendEntriesPipelineDepth))
+        {
+            return false;
+        }
+
+        AppendEntries::Request req;
+        req.term = persistent_state_.getCurrentTerm();
+        req.leader_commit = commit_index_;
+
+        req.prev_log_index = getReplicationHead(node_id);
+
+        const Entry* const entry = persistent_state_.getLog().getEntryAtIndex(req.prev_log_index);
+        if (entry == UAVCAN_NULLPTR)
+        {
+            UAVCAN_ASSERT(0);
+            handlePersistentStateUpdateError(-ErrLogic);
+            return false;
+        }
+
+        req.prev_log_term = entry->term;
+
+        for (Log::Index index = Log::Index(req.prev_log_index + 1U);
+             index <= persistent_state_.getLog().getLastIndex();
+             index++)
+        {
+            req.entries.push_back(*persistent_state_.getLog().getEntryAtIndex(index));
+            if (req.entries.size() == req.entries.capacity())
             {
-                UAVCAN_ASSERT(0);
-                handlePersistentStateUpdateError(-ErrLogic);
-                return;
+                break;
             }
+        }
+
+        ServiceCallID call_id;
+        const int res = append_entries_client_.call(node_id, req, call_id);
+        if (res < 0)
+        {
+            trace(TraceRaftAppendEntriesCallFailure, res);
+            return false;
+        }
+
+        pending->call_id = call_id;
+        pending->num_entries = req.entries.size();
+        pending->prev_log_index = req.prev_log_index;
+        return true;
+    }
+
+    /**
+     * Sends the entries that the follower doesn't have yet, as many as the pipeline allows.
+     */
+    void fillAppendEntriesPipeline(NodeID node_id)
+    {
+        while ((getReplicationHead(node_id) < persistent_state_.getLog().getLastIndex()) &&
+               sendAppendEntries(node_id))
+        { }
+    }
 
-            req.prev_log_term = entry->term;
+    void updateLeader()
+    {
+        if (cluster_.getClusterSize() > 1)
+        {
+            const NodeID node_id = cluster_.getRemoteServerNodeIDAtIndex(next_server_index_);
 
-            for (Log::Index index = cluster_.getServerNextIndex(node_id);
-                 index <= persistent_state_.getLog().getLastIndex();
-                 index++)
+            next_server_index_++;
+            if (next_server_index_ >= cluster_.getNumKnownServers())
             {
-                req.entries.push_back(*persistent_state_.getLog().getEntryAtIndex(index));
-                if (req.entries.size() == req.entries.capacity())
-                {
-                    break;
-                }
+                next_server_index_ = 0;
             }
 
-            pending_append_entries_fields_.num_entries = req.entries.size();
-            pending_append_entries_fields_.prev_log_index = req.prev_log_index;
-
-            const int res = append_entries_client_.call(node_id, req);
-            if (res < 0)
+            // The first request serves as a heartbeat if there are no new entries for this follower
+            if (sendAppendEntries(node_id))
             {
-                trace(TraceRaftAppendEntriesCallFailure, res);
+                fillAppendEntriesPipeline(node_id);
             }
         }
 
@@ -343,8 +526,17 @@ private:
         next_server_index_ = 0;
         num_votes_received_in_this_campaign_ = 0;
 
+        if (new_state != ServerStateFollower)
+        {
+            leader_node_id_ = NodeID();
+        }
+        for (uint8_t i = 0; i < MaxNumFollowers; i++)
+        {
+            follower_contact_timestamps_[i] = MonotonicTime();
+        }
+
         request_vote_client_.cancelAllCalls();
-        append_entries_client_.cancelAllCalls();
+        resetPendingAppendEntries();
 
         /*
          * Calling the switch handler
@@ -375,11 +567,11 @@ private:
         UAVCAN_ASSERT(server_state_ == ServerStateLeader);
         UAVCAN_ASSERT(commit_index_ <= persistent_state_.getLog().getLastIndex());
 
-        if (commit_index_ < persistent_state_.getLog().getLastIndex())
+        while (commit_index_ < persistent_state_.getLog().getLastIndex())
         {
             /*
              * Not all local entries are committed.
-             * Deciding if it is safe to increment commit index.
+             * Deciding if it is safe to increment commit index; all entries that are safe are committed at once.
              */
             uint8_t num_nodes_with_next_log_entry_available = 1; // Local node
             for (uint8_t i = 0; i < cluster_.getNumKnownServers(); i++)
@@ -400,11 +592,38 @@ private:
                 // AT THIS POINT ALLOCATION IS COMPLETE
                 leader_monitor_.handleLogCommitOnLeader(*persistent_state_.getLog().getEntryAtIndex(commit_index_));
             }
+            else
+            {
+                break;
+            }
+        }
+    }
+
+    /**
+     * The persistent state updates caused by one request are committed at once, before the response is sent.
+     * Should the commit fail, the response is suppressed as if the updates themselves have failed.
+     */
+    template <typename Response>
+    void commitPersistentStateUpdates(Response& response)
+    {
+        const int res = persistent_state_.commitTransaction();
+        if (res < 0)
+        {
+            handlePersistentStateUpdateError(res);
+            response.setResponseEnabled(false);
         }
     }
 
     void handleAppendEntriesRequest(const ReceivedDataStructure<AppendEntries::Request>& request,
                                     ServiceResponseDataStructure<AppendEntries::Response>& response)
+    {
+        persistent_state_.beginTransaction();
+        processAppendEntriesRequest(request, response);
+        commitPersistentStateUpdates(response);
+    }
+
+    void processAppendEntriesRequest(const ReceivedDataStructure<AppendEntries::Request>& request,
+                                     ServiceResponseDataStructure<AppendEntries::Response>& response)
     {
         checkInvariants();
 
@@ -466,6 +685,9 @@ private:
         registerActivity();
         switchState(ServerStateFollower);
 
+        leader_node_id_ = request.getSrcNodeID();
+        last_leader_contact_timestamp_ = getNode().getMonotonicTime();
+
         /*
          * Step 2
          * Reject the request if the assumed log index does not exist on the local node.
@@ -539,38 +761,78 @@ private:
         UAVCAN_ASSERT(server_state_ == ServerStateLeader);  // When state switches, all requests must be cancelled
         checkInvariants();
 
+        PendingAppendEntriesFields* const pending = findPendingAppendEntries(result.getCallID());
+        if (pending == UAVCAN_NULLPTR)
+        {
+            UAVCAN_ASSERT(0);
+            return;
+        }
+        const PendingAppendEntriesFields fields = *pending;
+        *pending = PendingAppendEntriesFields();
+
         if (!result.isSuccessful())
         {
             return;
         }
 
+        const NodeID node_id = result.getCallID().server_node_id;
+
         if (result.getResponse().term > persistent_state_.getCurrentTerm())
         {
             tryIncrementCurrentTermFromResponse(result.getResponse().term);
+            return;
         }
-        else
+
+        registerFollowerContact(node_id);
+
+        if (result.getResponse().success)
         {
-            if (result.getResponse().success)
+            const Log::Index match_index = Log::Index(fields.prev_log_index + fields.num_entries);
+            if (match_index >= cluster_.getServerNextIndex(node_id))
             {
-                cluster_.incrementServerNextIndexBy(result.getCallID().server_node_id,
-                                                    pending_append_entries_fields_.num_entries);
-                cluster_.setServerMatchIndex(result.getCallID().server_node_id,
-                                             Log::Index(pending_append_entries_fields_.prev_log_index +
-                                                        pending_append_entries_fields_.num_entries));
+                cluster_.setServerNextIndex(node_id, Log::Index(match_index + 1U));
             }
-            else
+            if (match_index > cluster_.getServerMatchIndex(node_id))
+            {
+                cluster_.setServerMatchIndex(node_id, match_index);
+            }
+            propagateCommitIndex();
+        }
+        else
+        {
+            /*
+             * The follower's log doesn't match at the assumed index, so the requests that followed this one will
+             * fail too. The pipeline is restarted one entry lower, as the Raft paper prescribes.
+             */
+            cancelPendingAppendEntries(node_id);
+            if ((fields.prev_log_index > 0) && (fields.prev_log_index < cluster_.getServerNextIndex(node_id)))
             {
-                cluster_.decrementServerNextIndex(result.getCallID().server_node_id);
-                trace(TraceRaftAppendEntriesRespUnsucfl, result.getCallID().server_node_id.get());
+                cluster_.setServerNextIndex(node_id, fields.prev_log_index);
             }
+            trace(TraceRaftAppendEntriesRespUnsucfl, node_id.get());
         }
 
-        pending_append_entries_fields_ = PendingAppendEntriesFields();
+        /*
+         * A follower that lags behind, e.g. a replaced server that has joined with an empty log, is caught up
+         * with back-to-back requests rather than with one entry per update interval.
+         */
+        if (server_state_ == ServerStateLeader)
+        {
+            fillAppendEntriesPipeline(node_id);
+        }
         // Rest of the logic is implemented in periodic update handlers.
     }
 
     void handleRequestVoteRequest(const ReceivedDataStructure<RequestVote::Request>& request,
                                   ServiceResponseDataStructure<RequestVote::Response>& response)
+    {
+        persistent_state_.beginTransaction();
+        processRequestVoteRequest(request, response);
+        commitPersistentStateUpdates(response);
+    }
+
+    void processRequestVoteRequest(const ReceivedDataStructure<RequestVote::Request>& request,
+                                  ServiceResponseDataStructure<RequestVote::Response>& response)
     {
         checkInvariants();
         trace(TraceRaftVoteRequestReceived, request.getSrcNodeID().get());
@@ -584,6 +846,19 @@ private:
 
         UAVCAN_ASSERT(response.isResponseEnabled());  // This is default
 
+        /*
+         * Leader stickiness: the vote is refused and the term is kept as long as the leader is alive, so that a
+         * server that has lost contact with the leader can't depose it. The candidate will learn about the leader
+         * from its AppendEntries requests once the contact is restored.
+         */
+        if (isLeaderAlive() && (request.getSrcNodeID() != leader_node_id_))
+        {
+            trace(TraceRaftVoteRequestRejected, request.getSrcNodeID().get());
+            response.term = persistent_state_.getCurrentTerm();
+            response.vote_granted = false;
+            return;
+        }
+
         /*
          * Checking if our current state is up to date.
          * The request will be ignored if persistent state cannot be updated.
@@ -655,16 +930,14 @@ private:
 
         trace(TraceRaftVoteRequestSucceeded, result.getCallID().server_node_id.get());
 
-        if (result.getResponse().term > persistent_state_.getCurrentTerm())
+        // The voters move to the proposed term, which is not yet the local one
+        if (result.getResponse().vote_granted && (result.getResponse().term == campaign_term_))
         {
-            tryIncrementCurrentTermFromResponse(result.getResponse().term);
+            num_votes_received_in_this_campaign_++;
         }
-        else
+        else if (result.getResponse().term > persistent_state_.getCurrentTerm())
         {
-            if (result.getResponse().vote_granted)
-            {
-                num_votes_received_in_this_campaign_++;
-            }
+            tryIncrementCurrentTermFromResponse(result.getResponse().term);
         }
         // Rest of the logic is implemented in periodic update handlers.
         // I'm no fan of asynchronous programming. At all.
@@ -716,6 +989,7 @@ public:
         , server_state_(ServerStateFollower)
         , next_server_index_(0)
         , num_votes_received_in_this_campaign_(0)
+        , campaign_term_(0)
         , append_entries_srv_(node)
         , append_entries_client_(node)
         , request_vote_srv_(node)
@@ -737,6 +1011,7 @@ public:
         next_server_index_ = 0;
         num_votes_received_in_this_campaign_ = 0;
         commit_index_ = 0;
+        leader_node_id_ = NodeID();
 
         registerActivity();
 
@@ -824,6 +1099,47 @@ public:
      */
     bool isLeader() const { return server_state_ == ServerStateLeader; }
 
+    /**
+     * Makes the local leader step down, e.g. before a graceful shutdown, so that another server can take over
+     * right away. The local server does not run for election again until its election timeout expires.
+     * The other servers learn about the shutdown from the NodeStatus message of this node with MODE_OFFLINE,
+     * see @ref handleServerShutdown(); the application should publish it immediately after this call.
+     * Does nothing if the local node is not the leader.
+     */
+    void handOverLeadership()
+    {
+        if (isLeader())
+        {
+            UAVCAN_TRACE("dynamic_node_id_server::distributed::RaftCore", "Handing over the leadership");
+            switchState(ServerStateFollower);
+            registerActivity();                 // Deferring own candidacy
+        }
+    }
+
+    /**
+     * Shall be invoked when a server of the cluster is known to have gone offline, i.e. when it has published
+     * NodeStatus with MODE_OFFLINE. If that server is the leader the local node follows, the election is started
+     * after a short random delay instead of waiting for the election timeout.
+     */
+    void handleServerShutdown(NodeID node_id)
+    {
+        if ((server_state_ != ServerStateFollower) || !node_id.isUnicast() || (node_id != leader_node_id_))
+        {
+            return;
+        }
+
+        trace(TraceRaftLeaderShutdown, node_id.get());
+        leader_node_id_ = NodeID();
+
+        // Randomized within one update interval to keep the candidates apart
+        const int32_t update_interval_msec = static_cast<int32_t>(max(getPeriod().toMSec(), int64_t(1)));
+        // coverity[dont_call]
+        const int32_t random_msec = std::rand() % update_interval_msec;
+
+        last_activity_timestamp_ = getNode().getMonotonicTime();
+        randomized_activity_timeout_ = MonotonicDuration::fromMSec(random_msec);
+    }
+
     /**
      * Inserts one entry into log.
      * This method will trigger an assertion failure and return error if the current node is not the leader.
@@ -893,6 +1209,34 @@ public:
         return LazyConstructor<LogEntryInfo>();
     }
 
+private:
+    LazyConstructor<LogEntryInfo> makeLogEntryInfo(int index) const
+    {
+        LazyConstructor<LogEntryInfo> ret;
+        if (index >= 0)
+        {
+            const Entry* const entry = persistent_state_.getLog().getEntryAtIndex(Log::Index(index));
+            UAVCAN_ASSERT(entry != UAVCAN_NULLPTR);
+            ret.template construct<const LogEntryInfo&>(LogEntryInfo(*entry, Log::Index(index) <= commit_index_));
+        }
+        return ret;
+    }
+
+public:
+    /**
+     * Same as @ref traverseLogFromEndUntil() with a predicate that matches the unique ID or the node ID of the entry,
+     * but these methods use the indexes of the log rather than traversing it.
+     */
+    LazyConstructor<LogEntryInfo> findLastLogEntryByUniqueID(const Entry::FieldTypes::unique_id& unique_id) const
+    {
+        return makeLogEntryInfo(persistent_state_.getLog().findLastIndexOfUniqueID(unique_id));
+    }
+
+    LazyConstructor<LogEntryInfo> findLastLogEntryByNodeID(NodeID node_id) const
+    {
+        return makeLogEntryInfo(persistent_state_.getLog().findLastIndexOfNodeID(node_id));
+    }
+
     Log::Index getNumAllocations() const
     {
         // Remember that index zero contains a special-purpose entry that doesn't count as allocation
@@ -906,6 +1250,7 @@ public:
     const ClusterManager& getClusterManager()   const { return cluster_; }
     MonotonicTime getLastActivityTimestamp()    const { return last_activity_timestamp_; }
     ServerState getServerState()                const { return server_state_; }
+    NodeID getLeaderNodeID()                    const { return isLeader() ? getNode().getNodeID() : leader_node_id_; }
     MonotonicDuration getUpdateInterval()       const { return getPeriod(); }
     MonotonicDuration getRandomizedTimeout()    const { return randomized_activity_timeout_; }
 };
@@ -12,6 +12,8 @@
 #include <uavcan/protocol/dynamic_node_id_server/abstract_server.hpp>
 #include <uavcan/protocol/dynamic_node_id_server/node_id_selector.hpp>
 #include <uavcan/protocol/dynamic_node_id_server/event.hpp>
+#include <uavcan/node/subscriber.hpp>
+#include <uavcan/protocol/NodeStatus.hpp>
 
 namespace uavcan
 {
@@ -25,38 +27,27 @@ namespace distributed
 class UAVCAN_EXPORT Server : public AbstractServer
                            , IRaftLeaderMonitor
 {
-    struct UniqueIDLogPredicate
-    {
-        const UniqueID unique_id;
+    typedef MethodBinder<Server*, void (Server::*)(const ReceivedDataStructure<protocol::NodeStatus>&)>
+        NodeStatusCallback;
 
-        UniqueIDLogPredicate(const UniqueID& uid)
-            : unique_id(uid)
-        { }
+    /*
+     * States
+     */
+    RaftCore raft_core_;
 
-        bool operator()(const RaftCore::LogEntryInfo& info) const
-        {
-            return info.entry.unique_id == unique_id;
-        }
-    };
+    Subscriber<protocol::NodeStatus, NodeStatusCallback> node_status_sub_;
 
-    struct NodeIDLogPredicate
+    /**
+     * A leader that is shutting down gracefully reports it with NodeStatus, so the followers don't have to wait
+     * for the election timeout to replace it.
+     */
+    void handleNodeStatus(const ReceivedDataStructure<protocol::NodeStatus>& msg)
     {
-        const NodeID node_id;
-
-        NodeIDLogPredicate(const NodeID& nid)
-            : node_id(nid)
-        { }
-
-        bool operator()(const RaftCore::LogEntryInfo& info) const
+        if (msg.mode == protocol::NodeStatus::MODE_OFFLINE)
         {
-            return info.entry.node_id == node_id.get();
+            raft_core_.handleServerShutdown(msg.getSrcNodeID());
         }
-    };
-
-    /*
-     * States
-     */
-    RaftCore raft_core_;
+    }
 
     /*
      * Methods of IAllocationRequestHandler
@@ -97,7 +88,7 @@ class UAVCAN_EXPORT Server : public AbstractServer
          * otherwise the request will be ignored because only leader can add new allocations.
          */
         const LazyConstructor<RaftCore::LogEntryInfo> result =
-            raft_core_.traverseLogFromEndUntil(UniqueIDLogPredicate(unique_id));
+            raft_core_.findLastLogEntryByUniqueID(unique_id);
 
          if (result.isConstructed())
          {
@@ -135,7 +126,7 @@ class UAVCAN_EXPORT Server : public AbstractServer
     virtual NodeAwareness checkNodeAwareness(NodeID node_id) const
     {
         const LazyConstructor<RaftCore::LogEntryInfo> result =
-            raft_core_.traverseLogFromEndUntil(NodeIDLogPredicate(node_id));
+            raft_core_.findLastLogEntryByNodeID(node_id);
         if (result.isConstructed())
         {
             return result->committed ? NodeAwarenessKnownAndCommitted : NodeAwarenessKnownButNotCommitted;
@@ -148,7 +139,7 @@ class UAVCAN_EXPORT Server : public AbstractServer
 
     virtual void handleNewNodeDiscovery(const UniqueID* unique_id_or_null, NodeID node_id)
     {
-        if (raft_core_.traverseLogFromEndUntil(NodeIDLogPredicate(node_id)).isConstructed())
+        if (raft_core_.findLastLogEntryByNodeID(node_id).isConstructed())
         {
             UAVCAN_ASSERT(0);   // Such node is already known, the class that called this method should have known that
             return;
@@ -171,6 +162,12 @@ class UAVCAN_EXPORT Server : public AbstractServer
          * Maybe this node did not request allocation at all, we don't care, we publish anyway.
          */
         tryPublishAllocationResult(entry);
+
+        // The follow-up responses were blocked by the uncommitted entry, the parked clients can proceed now
+        if (raft_core_.areAllLogEntriesCommitted())
+        {
+            allocation_request_manager_.resumeParkedRequests();
+        }
     }
 
     virtual void handleLocalLeadershipChange(bool local_node_is_leader)
@@ -181,7 +178,7 @@ class UAVCAN_EXPORT Server : public AbstractServer
         }
 
         const LazyConstructor<RaftCore::LogEntryInfo> result =
-            raft_core_.traverseLogFromEndUntil(NodeIDLogPredicate(node_.getNodeID()));
+            raft_core_.findLastLogEntryByNodeID(node_.getNodeID());
 
         if (!result.isConstructed())
         {
@@ -196,7 +193,7 @@ class UAVCAN_EXPORT Server : public AbstractServer
     {
         UAVCAN_TRACE("dynamic_node_id_server::distributed::Server",
                      "Testing if node ID %d is taken", int(node_id.get()));
-        return raft_core_.traverseLogFromEndUntil(NodeIDLogPredicate(node_id));
+        return raft_core_.findLastLogEntryByNodeID(node_id);
     }
 
     void allocateNewNode(const UniqueID& unique_id, const NodeID preferred_node_id)
@@ -230,6 +227,7 @@ public:
            IEventTracer& tracer)
         : AbstractServer(node, tracer)
         , raft_core_(node, storage, tracer, *this)
+        , node_status_sub_(node)
     { }
 
     int init(const UniqueID& own_unique_id,
@@ -254,11 +252,17 @@ public:
             return res;
         }
 
+        res = node_status_sub_.start(NodeStatusCallback(this, &Server::handleNodeStatus));
+        if (res < 0)
+        {
+            return res;
+        }
+
         /*
          * Making sure that the server is started with the same node ID
          */
         const LazyConstructor<RaftCore::LogEntryInfo> own_log_entry =
-            raft_core_.traverseLogFromEndUntil(NodeIDLogPredicate(node_.getNodeID()));
+            raft_core_.findLastLogEntryByNodeID(node_.getNodeID());
 
         if (own_log_entry.isConstructed())
         {
@@ -273,6 +277,15 @@ public:
 
     Log::Index getNumAllocations() const { return raft_core_.getNumAllocations(); }
 
+    /**
+     * Shall be called before a graceful shutdown of the node; see @ref RaftCore::handOverLeadership().
+     * The application is expected to publish NodeStatus with MODE_OFFLINE right after, e.g.:
+     *
+     *      server.handOverLeadership();
+     *      node.setModeOfflineAndPublish();
+     */
+    void handOverLeadership() { raft_core_.handOverLeadership(); }
+
     /**
      * These accessors are needed for debugging, visualization and testing.
      */
@@ -38,7 +38,7 @@ enum UAVCAN_EXPORT TraceCode
     TraceRaftCoreInited,                // update interval in usec
     TraceRaftStateSwitch,               // 0 - Follower, 1 - Candidate, 2 - Leader
     // 15
-    Trace0,
+    TraceRaftVoteRequestRejected,       // node ID of the client; the vote was refused because the leader is alive
     TraceRaftNewLogEntry,               // node ID value
     TraceRaftRequestIgnored,            // node ID of the client
     TraceRaftVoteRequestReceived,       // node ID of the client
@@ -53,7 +53,7 @@ enum UAVCAN_EXPORT TraceCode
     TraceRaftAppendEntriesCallFailure,  // error code (may be negated)
     TraceRaftElectionComplete,          // number of votes collected
     TraceRaftAppendEntriesRespUnsucfl,  // node ID of the client
-    Trace2,
+    TraceRaftLeaderShutdown,            // node ID of the leader that has gone offline
     Trace3,
     // 30
     TraceAllocationFollowupResponse,    // number of unique ID bytes in this response
@@ -66,7 +66,7 @@ enum UAVCAN_EXPORT TraceCode
     TraceAllocationExchangeComplete,    // first 8 bytes of unique ID interpreted as signed 64 bit big endian
     TraceAllocationResponse,            // allocated node ID
     TraceAllocationActivity,            // source node ID of the message
-    Trace12,
+    TraceAllocationRequestParked,       // number of parked first stage requests
     // 40
     TraceDiscoveryNewNodeFound,         // node ID
     TraceDiscoveryCommitCacheUpdated,   // node ID marked as committed
@@ -115,7 +115,7 @@ public:
             "RaftBadClusterSizeReceived",
             "RaftCoreInited",
             "RaftStateSwitch",
-            "",
+            "RaftVoteRequestRejected",
             "RaftNewLogEntry",
             "RaftRequestIgnored",
             "RaftVoteRequestReceived",
@@ -128,7 +128,7 @@ public:
             "RaftAppendEntriesCallFailure",
             "RaftElectionComplete",
             "RaftAppendEntriesRespUnsucfl",
-            "",
+            "RaftLeaderShutdown",
             "",
             "AllocationFollowupResponse",
             "AllocationFollowupDenied",
@@ -139,7 +139,7 @@ public:
             "AllocationExchangeComplete",
             "AllocationResponse",
             "AllocationActivity",
-            "",
+            "AllocationRequestParked",
             "DiscoveryNewNodeFound",
             "DiscoveryCommitCacheUpdated",
             "DiscoveryNodeFinalized",
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_DYNAMIC_NODE_ID_SERVER_JOURNAL_STORAGE_BACKEND_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_DYNAMIC_NODE_ID_SERVER_JOURNAL_STORAGE_BACKEND_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/std.hpp>
+
+namespace uavcan
+{
+namespace dynamic_node_id_server
+{
+/**
+ * This interface is used by the server to store the Raft log as an append-only sequence of binary records,
+ * which is much cheaper than updating several key/value pairs per log entry: one log operation is one record,
+ * and only one write needs to be synced to stable storage.
+ *
+ * The backend is responsible for the integrity of the records, e.g. by protecting them with a CRC.
+ * A record that has not been written completely, e.g. because of a power loss, must be discarded together
+ * with all the records that follow it, so that the journal always ends with the last complete record.
+ *
+ * Refer to @ref IStorageBackend::getJournal() to see how the server finds the journal.
+ * Besides the log, the server keeps the current term and the vote of Raft in the journal too, so that all
+ * updates caused by one request can be committed at once.
+ */
+class UAVCAN_EXPORT IJournalStorageBackend
+{
+public:
+    /**
+     * Maximum length of one record in bytes. The server never writes empty records.
+     */
+    enum { MaxRecordLength = 32 };
+
+    /**
+     * Appends one record to the end of the journal.
+     * The record must be on stable storage by the time this method returns.
+     * This method should not block for more than 50 ms.
+     * Returns negative error code.
+     */
+    virtual int append(const uint8_t* data, uint8_t length) = 0;
+
+    /**
+     * Same as @ref append(), except that the record doesn't need to be on stable storage until @ref sync()
+     * is called. This allows to commit a group of records with one write to the stable storage.
+     * The default implementation is @ref append().
+     */
+    virtual int appendWithoutSync(const uint8_t* data, uint8_t length) { return append(data, length); }
+
+    /**
+     * Puts the records appended with @ref appendWithoutSync() on stable storage.
+     * Returns negative error code.
+     */
+    virtual int sync() { return 0; }
+
+    /**
+     * Reads the record with the given sequence number, counting from zero, into the buffer.
+     * The server reads the records in ascending order, so the backend may optimize for sequential access.
+     * Returns the length of the record; zero if there's no such record; negative error code on failure.
+     */
+    virtual int read(uint32_t index, uint8_t (&out_data)[MaxRecordLength]) = 0;
+
+    virtual ~IJournalStorageBackend() { }
+};
+
+}
+}
+
+#endif // Include guard
@@ -6,7 +6,6 @@
 #define UAVCAN_PROTOCOL_DYNAMIC_NODE_ID_SERVER_NODE_DISCOVERER_HPP_INCLUDED
 
 #include <uavcan/build_config.hpp>
-#include <uavcan/util/map.hpp>
 #include <uavcan/util/method_binder.hpp>
 #include <uavcan/util/bitset.hpp>
 #include <uavcan/node/timer.hpp>
@@ -64,9 +63,20 @@ public:
 /**
  * This class listens to NodeStatus messages from other nodes and retrieves their unique ID if they are not
  * known to the allocator.
+ *
+ * Several nodes can be queried concurrently, see @ref setMaxConcurrentRequests(). The nodes that have been heard
+ * from most recently are queried first, because they are the most likely to respond. Only one request at a time is
+ * sent to every node.
  */
 class NodeDiscoverer : TimerBase
 {
+public:
+    /**
+     * Maximum number of GetNodeInfo requests that can be pending at the same time.
+     */
+    enum { MaxConcurrentRequests = 4 };
+
+private:
     typedef MethodBinder<NodeDiscoverer*, void (NodeDiscoverer::*)(const ServiceCallResult<protocol::GetNodeInfo>&)>
         GetNodeInfoResponseCallback;
 
@@ -76,15 +86,17 @@ class NodeDiscoverer : TimerBase
     struct NodeData
     {
         uint32_t last_seen_uptime;
+        uint32_t last_seen_msec;            ///< Lower 32 bits of the local monotonic time
         uint8_t num_get_node_info_attempts;
 
         NodeData()
             : last_seen_uptime(0)
+            , last_seen_msec(0)
             , num_get_node_info_attempts(0)
         { }
     };
 
-    typedef Map<NodeID, NodeData> NodeMap;
+    typedef BitSet<NodeID::Max + 1> NodeMask;
 
     /**
      * When this number of attempts has been made, the discoverer will give up and assume that the node
@@ -100,10 +112,12 @@ class NodeDiscoverer : TimerBase
     INodeDiscoveryHandler& handler_;
     IEventTracer& tracer_;
 
-    BitSet<NodeID::Max + 1> committed_node_mask_;       ///< Nodes that are marked will not be queried
-    NodeMap node_map_;
+    NodeMask committed_node_mask_;      ///< Nodes that are marked will not be queried
+    NodeMask unknown_node_mask_;        ///< Nodes that are waiting to be queried
+    NodeData node_data_[NodeID::Max + 1];
+    uint8_t max_concurrent_requests_;
 
-    ServiceClient<protocol::GetNodeInfo, GetNodeInfoResponseCallback> get_node_info_client_;
+    ServiceClient<protocol::GetNodeInfo, GetNodeInfoResponseCallback, MaxConcurrentRequests> get_node_info_client_;
     Subscriber<protocol::NodeStatus, NodeStatusCallback> node_status_sub_;
 
     /*
@@ -113,17 +127,36 @@ class NodeDiscoverer : TimerBase
 
     INode& getNode() { return node_status_sub_.getNode(); }
 
+    uint32_t getMonotonicMSec() { return static_cast<uint32_t>(getNode().getMonotonicTime().toMSec()); }
+
     void removeNode(const NodeID node_id)
     {
-        node_map_.remove(node_id);
+        unknown_node_mask_[node_id.get()] = false;
         trace(TraceDiscoveryNodeRemoved, node_id.get());
     }
 
-    NodeID pickNextNodeToQuery() const
+    /**
+     * Picks the unknown node that has been seen most recently among those that are not being queried already.
+     */
+    NodeID pickNextNodeToQuery()
     {
-        // This essentially means that we pick first available node. Remember that the map is unordered.
-        const NodeMap::KVPair* const pair = node_map_.getByIndex(0);
-        return (pair == UAVCAN_NULLPTR) ? NodeID() : pair->key;
+        const uint32_t now_msec = getMonotonicMSec();
+        NodeID best;
+        uint32_t best_age_msec = 0;
+        for (uint8_t i = 1; i <= NodeID::Max; i++)
+        {
+            if (!unknown_node_mask_[i] || get_node_info_client_.hasPendingCallToServer(i))
+            {
+                continue;
+            }
+            const uint32_t age_msec = now_msec - node_data_[i].last_seen_msec;
+            if (!best.isUnicast() || (age_msec < best_age_msec))
+            {
+                best = i;
+                best_age_msec = age_msec;
+            }
+        }
+        return best;
     }
 
     bool needToQuery(NodeID node_id)
@@ -166,7 +199,7 @@ class NodeDiscoverer : TimerBase
         }
     }
 
-    NodeID pickNextNodeToQueryAndCleanupMap()
+    NodeID pickNextNodeToQueryAndCleanupMask()
     {
         NodeID node_id;
         do
@@ -210,57 +243,71 @@ class NodeDiscoverer : TimerBase
             UAVCAN_TRACE("dynamic_node_id_server::NodeDiscoverer", "GetNodeInfo response from %d",
                          int(result.getCallID().server_node_id.get()));
             finalizeNodeDiscovery(&result.getResponse().hardware_version.unique_id, result.getCallID().server_node_id);
+
+            // The freed slot of the request window is reused immediately rather than on the next timer event
+            startQueries();
         }
         else
         {
             trace(TraceDiscoveryGetNodeInfoFailure, result.getCallID().server_node_id.get());
 
-            NodeData* const data = node_map_.access(result.getCallID().server_node_id);
-            if (data == UAVCAN_NULLPTR)
+            const uint8_t node_id = result.getCallID().server_node_id.get();
+            if (!unknown_node_mask_[node_id])
             {
                 return;         // Probably it is a known node now
             }
 
+            NodeData& data = node_data_[node_id];
             UAVCAN_TRACE("dynamic_node_id_server::NodeDiscoverer",
                          "GetNodeInfo request to %d has timed out, %d attempts",
-                         int(result.getCallID().server_node_id.get()), int(data->num_get_node_info_attempts));
-            data->num_get_node_info_attempts++;
-            if (data->num_get_node_info_attempts >= MaxAttemptsToGetNodeInfo)
+                         int(node_id), int(data.num_get_node_info_attempts));
+            data.num_get_node_info_attempts++;
+            if (data.num_get_node_info_attempts >= MaxAttemptsToGetNodeInfo)
             {
                 finalizeNodeDiscovery(UAVCAN_NULLPTR, result.getCallID().server_node_id);
-                // Warning: data pointer is invalidated now
             }
         }
     }
 
-    void handleTimerEvent(const TimerEvent&) override
+    /**
+     * Sends requests to the unknown nodes until the request window is full.
+     * Returns false if there are no more nodes to query.
+     */
+    bool startQueries()
     {
-        if (get_node_info_client_.hasPendingCalls())
+        while (get_node_info_client_.getNumPendingCalls() < max_concurrent_requests_)
         {
-            return;
-        }
+            const NodeID node_id = pickNextNodeToQueryAndCleanupMask();
+            if (!node_id.isUnicast())
+            {
+                return get_node_info_client_.hasPendingCalls();
+            }
 
-        const NodeID node_id = pickNextNodeToQueryAndCleanupMap();
-        if (!node_id.isUnicast())
-        {
-            trace(TraceDiscoveryTimerStop, 0);
-            stop();
-            return;
-        }
+            if (!handler_.canDiscoverNewNodes())
+            {
+                return true;    // Timer must continue to run in order to not stuck when it unlocks
+            }
 
-        if (!handler_.canDiscoverNewNodes())
-        {
-            return;     // Timer must continue to run in order to not stuck when it unlocks
-        }
+            trace(TraceDiscoveryGetNodeInfoRequest, node_id.get());
 
-        trace(TraceDiscoveryGetNodeInfoRequest, node_id.get());
+            UAVCAN_TRACE("dynamic_node_id_server::NodeDiscoverer", "Requesting GetNodeInfo from node %d",
+                         int(node_id.get()));
+            const int res = get_node_info_client_.call(node_id, protocol::GetNodeInfo::Request());
+            if (res < 0)
+            {
+                getNode().registerInternalFailure("NodeDiscoverer GetNodeInfo call");
+                return true;
+            }
+        }
+        return true;
+    }
 
-        UAVCAN_TRACE("dynamic_node_id_server::NodeDiscoverer", "Requesting GetNodeInfo from node %d",
-                     int(node_id.get()));
-        const int res = get_node_info_client_.call(node_id, protocol::GetNodeInfo::Request());
-        if (res < 0)
+    void handleTimerEvent(const TimerEvent&) override
+    {
+        if (!startQueries())
         {
-            getNode().registerInternalFailure("NodeDiscoverer GetNodeInfo call");
+            trace(TraceDiscoveryTimerStop, 0);
+            stop();
         }
     }
 
@@ -271,26 +318,21 @@ class NodeDiscoverer : TimerBase
             return;
         }
 
-        NodeData* data = node_map_.access(msg.getSrcNodeID());
-        if (data == UAVCAN_NULLPTR)
+        NodeData& data = node_data_[msg.getSrcNodeID().get()];
+        if (!unknown_node_mask_[msg.getSrcNodeID().get()])
         {
             trace(TraceDiscoveryNewNodeFound, msg.getSrcNodeID().get());
 
-            data = node_map_.insert(msg.getSrcNodeID(), NodeData());
-            if (data == UAVCAN_NULLPTR)
-            {
-                getNode().registerInternalFailure("NodeDiscoverer OOM");
-                return;
-            }
+            unknown_node_mask_[msg.getSrcNodeID().get()] = true;
+            data = NodeData();
         }
-        UAVCAN_ASSERT(data != UAVCAN_NULLPTR);
-
-        if (msg.uptime_sec < data->last_seen_uptime)
+        else if (msg.uptime_sec < data.last_seen_uptime)
         {
             trace(TraceDiscoveryNodeRestartDetected, msg.getSrcNodeID().get());
-            data->num_get_node_info_attempts = 0;
+            data.num_get_node_info_attempts = 0;
         }
-        data->last_seen_uptime = msg.uptime_sec;
+        data.last_seen_uptime = msg.uptime_sec;
+        data.last_seen_msec = getMonotonicMSec();
 
         if (!isRunning())
         {
@@ -304,7 +346,7 @@ public:
         : TimerBase(node)
         , handler_(handler)
         , tracer_(tracer)
-        , node_map_(node.getAllocator())
+        , max_concurrent_requests_(MaxConcurrentRequests)
         , get_node_info_client_(node)
         , node_status_sub_(node)
     { }
@@ -330,16 +372,28 @@ public:
         return 0;
     }
 
+    /**
+     * Maximum number of nodes that are queried at the same time; the value is clamped to [1, MaxConcurrentRequests].
+     * Lower values reduce the peak bus load caused by discovery after a cold start of the network.
+     * Default is @ref MaxConcurrentRequests.
+     */
+    void setMaxConcurrentRequests(uint8_t num)
+    {
+        max_concurrent_requests_ = uint8_t(max<uint8_t>(1U, min<uint8_t>(num, MaxConcurrentRequests)));
+    }
+
+    uint8_t getMaxConcurrentRequests() const { return max_concurrent_requests_; }
+
     /**
      * Returns true if there's at least one node with pending GetNodeInfo.
      */
-    bool hasUnknownNodes() const { return !node_map_.isEmpty(); }
+    bool hasUnknownNodes() const { return unknown_node_mask_.any(); }
 
     /**
      * Returns number of nodes that are being queried at the moment.
      * This method is needed for testing and state visualization.
      */
-    uint8_t getNumUnknownNodes() const { return static_cast<uint8_t>(node_map_.getSize()); }
+    uint8_t getNumUnknownNodes() const { return static_cast<uint8_t>(unknown_node_mask_.count()); }
 };
 
 }
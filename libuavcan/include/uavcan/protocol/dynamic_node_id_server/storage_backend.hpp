@@ -7,6 +7,7 @@
 
 #include <uavcan/build_config.hpp>
 #include <uavcan/marshal/types.hpp>
+#include <uavcan/protocol/dynamic_node_id_server/journal_storage_backend.hpp>
 
 namespace uavcan
 {
@@ -53,6 +54,30 @@ public:
      */
     virtual void set(const String& key, const String& value) = 0;
 
+    /**
+     * Create or update several values at once; the default implementation calls set() for every pair.
+     * The centralized server writes the entries of a batch of allocations with one call, so the backends that can
+     * store several pairs in one operation (e.g. one file rewrite or one flash page program) may override this.
+     * This method should not block for more than 50 ms.
+     * Failures will be ignored.
+     */
+    virtual void setMany(const String* keys, const String* values, uint8_t count)
+    {
+        for (uint8_t i = 0; i < count; i++)
+        {
+            set(keys[i], values[i]);
+        }
+    }
+
+    /**
+     * If the backend provides a journal, the persistent state of Raft (the log, the current term and the vote)
+     * will be kept there rather than in the key/value storage; refer to @ref IJournalStorageBackend. The other
+     * data will still be stored as key/value pairs. The centralized server doesn't use the journal.
+     * The state is not migrated; a journal should be introduced together with a new storage.
+     * By default there's no journal.
+     */
+    virtual IJournalStorageBackend* getJournal() { return UAVCAN_NULLPTR; }
+
     virtual ~IStorageBackend() { }
 };
 
@@ -0,0 +1,638 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_FILE_BROADCAST_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_FILE_BROADCAST_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/data_type.hpp>
+#include <uavcan/node/publisher.hpp>
+#include <uavcan/node/subscriber.hpp>
+#include <uavcan/node/service_client.hpp>
+#include <uavcan/node/timer.hpp>
+#include <uavcan/util/bitset.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <uavcan/protocol/file_server.hpp>
+// UAVCAN types
+#include <uavcan/protocol/file/Read.hpp>
+
+namespace uavcan
+{
+/**
+ * Identifier of the broadcast image of the file, which is CRC-64-WE of its path.
+ * Both the broadcaster and the receivers compute it from the path that the receivers use with
+ * uavcan.protocol.file.Read, so the path itself doesn't need to be broadcast.
+ */
+inline uint64_t makeFileBroadcastImageID(const protocol::file::Path::FieldTypes::path& path)
+{
+    DataTypeSignatureCRC crc;
+    crc.add(path.begin(), unsigned(path.size()));
+    return crc.get();
+}
+
+/**
+ * Broadcasts a file in chunks, so that any number of nodes that need the same file, e.g. the same firmware image,
+ * can receive it at once, instead of reading it one by one via uavcan.protocol.file.Read. The receiving side is
+ * implemented by @ref FileBroadcastReceiver; the chunks that it has missed are read via the file server.
+ *
+ * There is no standard data type for the chunks, so the application has to define its own message type
+ * (usually a vendor-specific one) with the following fields:
+ *
+ *      uint64 image_id         # See makeFileBroadcastImageID()
+ *      uint40 offset
+ *      uint8[<=256] data       # The file ends at the first chunk that is shorter than 256 bytes
+ *
+ * The chunks are aligned with the responses of uavcan.protocol.file.Read: every chunk, except the last one,
+ * contains exactly @ref IFileServerBackend::ReadSize bytes. The file is read through the same backend as
+ * the one that serves @ref BasicFileServer.
+ *
+ * The file is broadcast round after round; @ref start() defines the number of rounds. Calling @ref start() with
+ * the same path again, e.g. from @ref IFirmwareVersionChecker::handleFirmwareUpdateConfirmation() of
+ * @ref FirmwareUpdateTrigger when another node has confirmed its update, continues the broadcast from the current
+ * offset and extends it so that the new receiver gets the required number of whole rounds too.
+ * The chunks are broadcast at a fixed rate, and no chunk is broadcast while the TX queue of any interface is more
+ * than half full, so that the broadcast does not crowd out the rest of the traffic.
+ *
+ * @tparam ChunkMessage_    Message type of the chunks, see above.
+ */
+template <typename ChunkMessage_>
+class UAVCAN_EXPORT FileBroadcaster : private TimerBase
+{
+public:
+    typedef protocol::file::Path::FieldTypes::path Path;
+
+    enum { ChunkSize = IFileServerBackend::ReadSize };
+
+    enum { DefaultChunkIntervalMs = 20 };
+
+    enum { DefaultNumRounds = 2 };
+
+private:
+    Publisher<ChunkMessage_> pub_;
+    IFileServerBackend& backend_;
+    ChunkMessage_ msg_;
+    Path path_;
+    uint64_t offset_;
+    uint64_t stop_offset_;              ///< The broadcast finishes here when there are no more rounds left
+    uint32_t num_chunks_broadcast_;
+    uint8_t num_rounds_left_;
+    MonotonicDuration chunk_interval_;
+
+    bool isTxQueueBusy() const
+    {
+        const CanIOManager& canio = pub_.getNode().getDispatcher().getCanIOManager();
+        for (uint8_t i = 0; i < canio.getNumIfaces(); i++)
+        {
+            if ((canio.getTxQueueNumUsedBlocks(i) * 2U) > canio.getTxQueueQuota(i))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    virtual void handleTimerEvent(const TimerEvent&);
+
+public:
+    FileBroadcaster(INode& node, IFileServerBackend& backend)
+        : TimerBase(node)
+        , pub_(node)
+        , backend_(backend)
+        , offset_(0)
+        , stop_offset_(0)
+        , num_chunks_broadcast_(0)
+        , num_rounds_left_(0)
+        , chunk_interval_(MonotonicDuration::fromMSec(DefaultChunkIntervalMs))
+    {
+        StaticAssert<(ChunkMessage_::FieldTypes::data::MaxSize >= unsigned(ChunkSize))>::check();
+    }
+
+    /**
+     * Begins or extends the broadcast of the file. If another file is being broadcast, it is abandoned; its
+     * receivers will read the rest of it via the file server.
+     * Returns negative error code.
+     */
+    int start(const Path& path, uint8_t num_rounds = DefaultNumRounds,
+              const TransferPriority priority = TransferPriority::OneHigherThanLowest);
+
+    /**
+     * Stops the broadcast immediately.
+     */
+    void stop()
+    {
+        TimerBase::stop();
+        num_rounds_left_ = 0;
+    }
+
+    bool isRunning() const { return TimerBase::isRunning(); }
+
+    const Path& getPath() const { return path_; }
+
+    /**
+     * This method is mostly needed for testing.
+     */
+    uint32_t getNumChunksBroadcast() const { return num_chunks_broadcast_; }
+
+    /**
+     * Interval between the chunks; it defines the bus bandwidth consumed by the broadcast.
+     * The default value is conservative enough for a 1 Mbit/s bus.
+     */
+    MonotonicDuration getChunkInterval() const { return chunk_interval_; }
+    void setChunkInterval(const MonotonicDuration interval)
+    {
+        if (interval.isPositive())
+        {
+            chunk_interval_ = interval;
+            if (TimerBase::isRunning())
+            {
+                TimerBase::startPeriodic(chunk_interval_);
+            }
+        }
+        else
+        {
+            UAVCAN_ASSERT(0);
+        }
+    }
+};
+
+/**
+ * Receives the chunks of the file collected by @ref FileBroadcastReceiver.
+ */
+class UAVCAN_EXPORT IFileBroadcastSink
+{
+public:
+    /**
+     * Called once for every chunk of the file. The chunks arrive in no particular order, so the sink must be able
+     * to store them at arbitrary offsets, e.g. directly into flash.
+     * The data pointer is valid only until this method returns.
+     */
+    virtual void handleFileChunk(uint64_t offset, const uint8_t* data, uint16_t size) = 0;
+
+    /**
+     * Called once when the reception is over, unless it has been cancelled.
+     *
+     * @param error     Zero if the whole file has been received;
+     *                  positive uavcan.protocol.file.Error code if the server has reported an error;
+     *                  negative error code if the server didn't respond, the file is too large, or the request
+     *                  could not be sent.
+     */
+    virtual void handleFileReceptionCompletion(int error) = 0;
+
+    virtual ~IFileBroadcastSink() { }
+};
+
+/**
+ * Receives a file broadcast by @ref FileBroadcaster. A bitmap keeps track of the chunks that have been received.
+ * Once the broadcast of the file has ceased, or if it has not been heard at all, the missing chunks are read from
+ * the file server via uavcan.protocol.file.Read, a few requests at a time. The chunks that keep arriving via
+ * the broadcast meanwhile are used as well.
+ *
+ * @tparam ChunkMessage_    Message type of the chunks, see @ref FileBroadcaster.
+ * @tparam MaxFileSize_     Maximum size of the file in bytes; defines the size of the bitmap.
+ * @tparam NumReadRequests_ Maximum number of concurrent read requests.
+ */
+template <typename ChunkMessage_, unsigned MaxFileSize_, unsigned NumReadRequests_ = 4>
+class UAVCAN_EXPORT FileBroadcastReceiver : private TimerBase
+{
+public:
+    typedef protocol::file::Path::FieldTypes::path Path;
+
+    enum { ChunkSize = protocol::file::Read::Response::FieldTypes::data::MaxSize };
+
+    /// The last chunk is shorter than the others; it is empty if the file size is a multiple of the chunk size
+    enum { MaxNumChunks = MaxFileSize_ / ChunkSize + 1 };
+
+    enum { DefaultBroadcastTimeoutMs = 1000 };
+
+    enum { DefaultMaxAttempts = 3 };
+
+private:
+    typedef FileBroadcastReceiver<ChunkMessage_, MaxFileSize_, NumReadRequests_> SelfType;
+    typedef MethodBinder<SelfType*, void (SelfType::*)(const ReceivedDataStructure<ChunkMessage_>&)>
+        ChunkCallback;
+    typedef MethodBinder<SelfType*, void (SelfType::*)(const ServiceCallResult<protocol::file::Read>&)>
+        ReadResponseCallback;
+
+    enum { PollIntervalMs = 100 };
+
+    struct ReadRequest
+    {
+        ServiceCallID call_id;
+        uint32_t chunk_index;
+        uint8_t num_attempts;
+        bool pending;
+
+        ReadRequest()
+            : chunk_index(0)
+            , num_attempts(0)
+            , pending(false)
+        { }
+    };
+
+    Subscriber<ChunkMessage_, ChunkCallback> chunk_sub_;
+    /// A request that has timed out is repeated from the timeout callback, before its call state is released
+    ServiceClient<protocol::file::Read, ReadResponseCallback, NumReadRequests_ + 1> read_client_;
+    IFileBroadcastSink& sink_;
+    BitSet<MaxNumChunks> received_;
+    ReadRequest requests_[NumReadRequests_];
+    Path path_;
+    uint64_t image_id_;
+    MonotonicTime last_broadcast_ts_;
+    MonotonicDuration broadcast_timeout_;
+    uint32_t num_chunks_;               ///< Including the last short one; MaxNumChunks + 1 while unknown
+    uint32_t num_chunks_received_;
+    uint32_t num_chunks_read_;
+    NodeID server_node_id_;
+    uint8_t max_attempts_;
+    bool running_;
+
+    bool isNumChunksKnown() const { return num_chunks_ <= MaxNumChunks; }
+
+    bool isComplete() const { return isNumChunksKnown() && (num_chunks_received_ == num_chunks_); }
+
+    bool isReadPending(uint32_t chunk_index) const
+    {
+        for (unsigned i = 0; i < NumReadRequests_; i++)
+        {
+            if (requests_[i].pending && (requests_[i].chunk_index == chunk_index))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool isRepairing() const
+    {
+        return (getNode().getMonotonicTime() - last_broadcast_ts_) >= broadcast_timeout_;
+    }
+
+    INode& getNode() const { return read_client_.getNode(); }
+
+    void storeChunk(uint32_t chunk_index, const uint8_t* data, uint16_t size);
+
+    int request(ReadRequest& req, uint32_t chunk_index);
+
+    int fillReadRequests();
+
+    void finish(int error);
+
+    void handleChunk(const ReceivedDataStructure<ChunkMessage_>& msg);
+
+    void handleReadResponse(const ServiceCallResult<protocol::file::Read>& result);
+
+    virtual void handleTimerEvent(const TimerEvent&);
+
+public:
+    FileBroadcastReceiver(INode& node, IFileBroadcastSink& sink)
+        : TimerBase(node)
+        , chunk_sub_(node)
+        , read_client_(node)
+        , sink_(sink)
+        , image_id_(0)
+        , broadcast_timeout_(MonotonicDuration::fromMSec(DefaultBroadcastTimeoutMs))
+        , num_chunks_(MaxNumChunks + 1)
+        , num_chunks_received_(0)
+        , num_chunks_read_(0)
+        , max_attempts_(DefaultMaxAttempts)
+        , running_(false)
+    {
+        StaticAssert<(NumReadRequests_ > 0)>::check();
+        StaticAssert<(ChunkMessage_::FieldTypes::data::MaxSize >= unsigned(ChunkSize))>::check();
+    }
+
+    /**
+     * Begins receiving the file, cancelling the reception in progress, if any.
+     * The missing chunks will be read from the given file server.
+     * Returns negative error code.
+     */
+    int start(NodeID server_node_id, const Path& path);
+
+    /**
+     * Stops the reception in progress. The sink will not be notified.
+     */
+    void cancel()
+    {
+        running_ = false;
+        TimerBase::stop();
+        read_client_.cancelAllCalls();
+        for (unsigned i = 0; i < NumReadRequests_; i++)
+        {
+            requests_[i].pending = false;
+        }
+    }
+
+    bool isRunning() const { return running_; }
+
+    /**
+     * These methods are mostly needed for testing.
+     */
+    uint32_t getNumChunksReceived() const { return num_chunks_received_; }
+    uint32_t getNumChunksRead() const { return num_chunks_read_; }
+
+    /**
+     * If no chunk of the file has been broadcast for this long, the missing chunks are read from the file server.
+     */
+    MonotonicDuration getBroadcastTimeout() const { return broadcast_timeout_; }
+    void setBroadcastTimeout(MonotonicDuration timeout) { broadcast_timeout_ = timeout; }
+
+    /**
+     * How many times a read request may be sent before the reception is considered failed. At least one.
+     */
+    uint8_t getMaxAttempts() const { return max_attempts_; }
+    void setMaxAttempts(uint8_t num) { max_attempts_ = max<uint8_t>(num, 1); }
+};
+
+// ----------------------------------------------------------------------------
+
+/*
+ * FileBroadcaster
+ */
+template <typename ChunkMessage_>
+int FileBroadcaster<ChunkMessage_>::start(const Path& path, uint8_t num_rounds, const TransferPriority priority)
+{
+    if (num_rounds == 0)
+    {
+        return -ErrInvalidParam;
+    }
+
+    const int res = pub_.init(priority);
+    if (res < 0)
+    {
+        return res;
+    }
+    pub_.setTxTimeout(chunk_interval_);
+
+    if (!TimerBase::isRunning() || (path != path_))
+    {
+        path_ = path;
+        msg_.image_id = makeFileBroadcastImageID(path_);
+        offset_ = 0;
+        TimerBase::startPeriodic(chunk_interval_);
+    }
+    stop_offset_ = offset_;
+    num_rounds_left_ = num_rounds;
+
+    UAVCAN_TRACE("FileBroadcaster", "Broadcasting '%s' from offset %u, rounds: %u",
+                 path_.c_str(), unsigned(offset_), unsigned(num_rounds_left_));
+    return 0;
+}
+
+template <typename ChunkMessage_>
+void FileBroadcaster<ChunkMessage_>::handleTimerEvent(const TimerEvent&)
+{
+    if (isTxQueueBusy())
+    {
+        return;
+    }
+
+    msg_.offset = offset_;
+    msg_.data.resize(ChunkSize);
+    uint16_t size = ChunkSize;
+    const int16_t error = backend_.read(path_, offset_, msg_.data.begin(), size);
+    if ((error != protocol::file::Error::OK) || (size > unsigned(ChunkSize)))
+    {
+        UAVCAN_TRACE("FileBroadcaster", "Read failure %i at offset %u, stopping", int(error), unsigned(offset_));
+        stop();
+        return;
+    }
+    msg_.data.resize(size);
+
+    const int res = pub_.broadcast(msg_);
+    if (res < 0)
+    {
+        pub_.getNode().registerInternalFailure("FileBroadcaster pub");
+        return;                             // This chunk will be repeated
+    }
+    num_chunks_broadcast_++;
+
+    offset_ = (size < unsigned(ChunkSize)) ? 0 : (offset_ + size);
+    if (offset_ == stop_offset_)
+    {
+        num_rounds_left_--;
+        if (num_rounds_left_ == 0)
+        {
+            UAVCAN_TRACE("FileBroadcaster", "Broadcast of '%s' is complete", path_.c_str());
+            stop();
+        }
+    }
+}
+
+/*
+ * FileBroadcastReceiver
+ */
+template <typename ChunkMessage_, unsigned MaxFileSize_, unsigned NumReadRequests_>
+void FileBroadcastReceiver<ChunkMessage_, MaxFileSize_, NumReadRequests_>::storeChunk(uint32_t chunk_index,
+                                                                                     const uint8_t* data,
+                                                                                     uint16_t size)
+{
+    if (chunk_index >= MaxNumChunks)
+    {
+        UAVCAN_TRACE("FileBroadcastReceiver", "File is too large");
+        finish(-ErrFailure);
+        return;
+    }
+    if (size < unsigned(ChunkSize))
+    {
+        num_chunks_ = chunk_index + 1U;
+    }
+    if ((chunk_index >= num_chunks_) || received_.test(chunk_index))
+    {
+        return;
+    }
+
+    received_.set(chunk_index);
+    num_chunks_received_++;
+    if (size > 0)
+    {
+        sink_.handleFileChunk(uint64_t(chunk_index) * unsigned(ChunkSize), data, size);
+    }
+    if (running_ && isComplete())
+    {
+        finish(0);
+    }
+}
+
+template <typename ChunkMessage_, unsigned MaxFileSize_, unsigned NumReadRequests_>
+int FileBroadcastReceiver<ChunkMessage_, MaxFileSize_, NumReadRequests_>::request(ReadRequest& req,
+                                                                                 uint32_t chunk_index)
+{
+    protocol::file::Read::Request msg;
+    msg.offset = uint64_t(chunk_index) * unsigned(ChunkSize);
+    msg.path.path = path_;
+
+    const int res = read_client_.call(server_node_id_, msg, req.call_id);
+    if (res < 0)
+    {
+        UAVCAN_TRACE("FileBroadcastReceiver", "Read request failure %i", res);
+        return res;
+    }
+    req.chunk_index = chunk_index;
+    req.num_attempts++;
+    req.pending = true;
+    return res;
+}
+
+template <typename ChunkMessage_, unsigned MaxFileSize_, unsigned NumReadRequests_>
+int FileBroadcastReceiver<ChunkMessage_, MaxFileSize_, NumReadRequests_>::fillReadRequests()
+{
+    // The missing chunks are requested in the order of offsets. While the size is unknown, the search goes one chunk
+    // past the end of the bitmap, so that a file that is too large is detected rather than waited for forever.
+    const uint32_t limit = isNumChunksKnown() ? num_chunks_ : uint32_t(MaxNumChunks + 1);
+    uint32_t chunk_index = 0;
+    for (unsigned i = 0; i < NumReadRequests_; i++)
+    {
+        ReadRequest& req = requests_[i];
+        if (req.pending)
+        {
+            continue;
+        }
+        while ((chunk_index < limit) && (received_.test(chunk_index) || isReadPending(chunk_index)))
+        {
+            chunk_index++;
+        }
+        if (chunk_index >= limit)
+        {
+            break;
+        }
+        req.num_attempts = 0;
+        const int res = request(req, chunk_index);
+        if (res < 0)
+        {
+            return res;
+        }
+    }
+    return 0;
+}
+
+template <typename ChunkMessage_, unsigned MaxFileSize_, unsigned NumReadRequests_>
+void FileBroadcastReceiver<ChunkMessage_, MaxFileSize_, NumReadRequests_>::finish(int error)
+{
+    UAVCAN_TRACE("FileBroadcastReceiver", "Finished with %i; chunks received: %u, read: %u", error,
+                 unsigned(num_chunks_received_), unsigned(num_chunks_read_));
+    cancel();
+    sink_.handleFileReceptionCompletion(error);
+}
+
+template <typename ChunkMessage_, unsigned MaxFileSize_, unsigned NumReadRequests_>
+void FileBroadcastReceiver<ChunkMessage_, MaxFileSize_, NumReadRequests_>::handleChunk(
+    const ReceivedDataStructure<ChunkMessage_>& msg)
+{
+    if (!running_ || (msg.image_id != image_id_) || ((msg.offset % unsigned(ChunkSize)) != 0))
+    {
+        return;
+    }
+    last_broadcast_ts_ = msg.getMonotonicTimestamp();
+    storeChunk(uint32_t(msg.offset / unsigned(ChunkSize)), msg.data.begin(), uint16_t(msg.data.size()));
+}
+
+template <typename ChunkMessage_, unsigned MaxFileSize_, unsigned NumReadRequests_>
+void FileBroadcastReceiver<ChunkMessage_, MaxFileSize_, NumReadRequests_>::handleReadResponse(
+    const ServiceCallResult<protocol::file::Read>& result)
+{
+    ReadRequest* req = UAVCAN_NULLPTR;
+    for (unsigned i = 0; i < NumReadRequests_; i++)
+    {
+        if (requests_[i].pending && (requests_[i].call_id == result.getCallID()))
+        {
+            req = &requests_[i];
+            break;
+        }
+    }
+    if (!running_ || (req == UAVCAN_NULLPTR))
+    {
+        return;
+    }
+    req->pending = false;
+
+    if (!result.isSuccessful())
+    {
+        if (req->num_attempts >= max_attempts_)
+        {
+            finish(-ErrFailure);
+            return;
+        }
+        const int res = request(*req, req->chunk_index);
+        if (res < 0)
+        {
+            finish(res);
+        }
+        return;
+    }
+
+    const protocol::file::Read::Response& response = result.getResponse();
+    if (response.error.value != protocol::file::Error::OK)
+    {
+        finish(response.error.value);
+        return;
+    }
+
+    num_chunks_read_++;
+    storeChunk(req->chunk_index, response.data.begin(), uint16_t(response.data.size()));
+
+    if (running_ && isRepairing())      // Otherwise the broadcast has resumed
+    {
+        const int res = fillReadRequests();
+        if (res < 0)
+        {
+            finish(res);
+        }
+    }
+}
+
+template <typename ChunkMessage_, unsigned MaxFileSize_, unsigned NumReadRequests_>
+void FileBroadcastReceiver<ChunkMessage_, MaxFileSize_, NumReadRequests_>::handleTimerEvent(const TimerEvent&)
+{
+    if (running_ && isRepairing())
+    {
+        const int res = fillReadRequests();
+        if (res < 0)
+        {
+            finish(res);
+        }
+    }
+}
+
+template <typename ChunkMessage_, unsigned MaxFileSize_, unsigned NumReadRequests_>
+int FileBroadcastReceiver<ChunkMessage_, MaxFileSize_, NumReadRequests_>::start(NodeID server_node_id,
+                                                                               const Path& path)
+{
+    cancel();
+
+    if (!server_node_id.isUnicast())
+    {
+        return -ErrInvalidParam;
+    }
+
+    int res = read_client_.init();
+    if (res < 0)
+    {
+        return res;
+    }
+    read_client_.setCallback(ReadResponseCallback(this, &SelfType::handleReadResponse));
+
+    res = chunk_sub_.start(ChunkCallback(this, &SelfType::handleChunk));
+    if (res < 0)
+    {
+        return res;
+    }
+
+    path_ = path;
+    image_id_ = makeFileBroadcastImageID(path_);
+    server_node_id_ = server_node_id;
+    received_.reset();
+    num_chunks_ = MaxNumChunks + 1;
+    num_chunks_received_ = 0;
+    num_chunks_read_ = 0;
+    last_broadcast_ts_ = getNode().getMonotonicTime();
+    running_ = true;
+
+    TimerBase::startPeriodic(MonotonicDuration::fromMSec(PollIntervalMs));
+    return 0;
+}
+
+}
+
+#endif // UAVCAN_PROTOCOL_FILE_BROADCAST_HPP_INCLUDED
@@ -0,0 +1,457 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_FILE_COMPRESSION_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_FILE_COMPRESSION_HPP_INCLUDED
+
+#include <cstring>
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/util/templates.hpp>
+#include <uavcan/protocol/file_downloader.hpp>
+// UAVCAN types
+#include <uavcan/protocol/file/Path.hpp>
+
+namespace uavcan
+{
+/**
+ * Compressed representation of files that are transferred via uavcan.protocol.file.Read, e.g. firmware images.
+ * The file server provides the compressed representation of any file under the name of the file followed by
+ * @ref getPathSuffix(), see @ref CompressingFileServerBackend; a client that gets an error for such a name
+ * can fall back to the original one. The client restores the contents with @ref DecompressingFileDownloadSink.
+ *
+ * The file is split into blocks of @ref BlockSize bytes that are compressed independently, so that the decoder
+ * needs no more memory than one block. Every block is stored as a 4-byte header, which is the size of the block
+ * and the size of its compressed payload (both unsigned 16-bit, little endian), followed by the payload. The file
+ * ends with the first block that is shorter than @ref BlockSize, which may be empty.
+ *
+ * The payload is a sequence of LZ77 tokens, every token starts with one byte:
+ *  - 0xxxxxxx  - literal run, x + 1 bytes follow that are copied to the output as is;
+ *  - 1xxxxxxx  - match, x + 3 bytes are copied from the output of the same block; the distance back from the
+ *                current position follows as unsigned 16-bit little endian.
+ */
+class UAVCAN_EXPORT BlockLZ
+{
+public:
+    typedef protocol::file::Path::FieldTypes::path Path;
+
+    enum { BlockSize = 1024 };
+    enum { HeaderSize = 4 };
+    enum { MinMatchLength = 3 };
+    enum { MaxMatchLength = 0x7F + MinMatchLength };
+    enum { MaxLiteralRunLength = 0x80 };
+
+    /// Incompressible data only gains one byte per literal run
+    enum { MaxEncodedBlockSize = HeaderSize + BlockSize + (BlockSize + MaxLiteralRunLength - 1) / MaxLiteralRunLength };
+
+    static const char* getPathSuffix() { return ".blz"; }
+
+    static bool isCompressedFilePath(const Path& path)
+    {
+        const char* const suffix = getPathSuffix();
+        const unsigned suffix_len = unsigned(std::strlen(suffix));
+        if (path.size() <= suffix_len)
+        {
+            return false;
+        }
+        return std::memcmp(path.begin() + (path.size() - suffix_len), suffix, suffix_len) == 0;
+    }
+
+    /**
+     * Returns false if the path is too long to add the suffix.
+     */
+    static bool makeCompressedFilePath(const Path& path, Path& out_path)
+    {
+        const char* const suffix = getPathSuffix();
+        if ((path.size() + std::strlen(suffix)) > Path::MaxSize)
+        {
+            return false;
+        }
+        out_path = path;
+        out_path += suffix;
+        return true;
+    }
+
+    static void makeOriginalFilePath(const Path& compressed_path, Path& out_path)
+    {
+        UAVCAN_ASSERT(isCompressedFilePath(compressed_path));
+        out_path = compressed_path;
+        out_path.resize(uint8_t(compressed_path.size() - std::strlen(getPathSuffix())));
+    }
+};
+
+/**
+ * Compresses single blocks, see @ref BlockLZ. The matches are found greedily via a hash table of the recent
+ * positions; the table is the only state besides the block itself.
+ */
+class UAVCAN_EXPORT BlockLZEncoder
+{
+    enum { HashBits = 10 };
+    enum { HashSize = 1U << HashBits };
+
+    uint16_t table_[HashSize];      ///< Position plus one of the last occurrence; zero if none
+
+    static unsigned hash(const uint8_t* p)
+    {
+        const uint32_t x = uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16);
+        return unsigned((x * 2654435761U) >> (32U - unsigned(HashBits)));
+    }
+
+    static unsigned flushLiterals(const uint8_t* in, unsigned begin, unsigned end, uint8_t* out, unsigned out_pos)
+    {
+        while (begin < end)
+        {
+            const unsigned len = min(end - begin, unsigned(BlockLZ::MaxLiteralRunLength));
+            out[out_pos++] = uint8_t(len - 1U);
+            (void)copy(in + begin, in + begin + len, out + out_pos);
+            out_pos += len;
+            begin += len;
+        }
+        return out_pos;
+    }
+
+public:
+    BlockLZEncoder()
+    {
+        fill(table_, table_ + HashSize, uint16_t(0));
+    }
+
+    /**
+     * Encodes one block, including its header.
+     * @param in        Contents of the block; at most @ref BlockLZ::BlockSize bytes.
+     * @param out       At least @ref BlockLZ::MaxEncodedBlockSize bytes.
+     * @return          Number of bytes written to the output.
+     */
+    unsigned encode(const uint8_t* in, unsigned in_size, uint8_t* out)
+    {
+        UAVCAN_ASSERT(in_size <= unsigned(BlockLZ::BlockSize));
+        fill(table_, table_ + HashSize, uint16_t(0));
+
+        unsigned out_pos = BlockLZ::HeaderSize;
+        unsigned literals_begin = 0;
+        unsigned pos = 0;
+        while ((pos + unsigned(BlockLZ::MinMatchLength)) <= in_size)
+        {
+            uint16_t& entry = table_[hash(in + pos)];
+            const unsigned candidate = entry;
+            entry = uint16_t(pos + 1U);
+            if (candidate == 0)
+            {
+                pos++;
+                continue;
+            }
+
+            const unsigned match_pos = candidate - 1U;
+            const unsigned max_len = min(in_size - pos, unsigned(BlockLZ::MaxMatchLength));
+            unsigned len = 0;
+            while ((len < max_len) && (in[match_pos + len] == in[pos + len]))
+            {
+                len++;
+            }
+            if (len < unsigned(BlockLZ::MinMatchLength))
+            {
+                pos++;
+                continue;
+            }
+
+            out_pos = flushLiterals(in, literals_begin, pos, out, out_pos);
+            const unsigned distance = pos - match_pos;
+            out[out_pos++] = uint8_t(0x80U | (len - unsigned(BlockLZ::MinMatchLength)));
+            out[out_pos++] = uint8_t(distance & 0xFFU);
+            out[out_pos++] = uint8_t(distance >> 8);
+
+            for (unsigned i = 1; (i < len) && ((pos + i + unsigned(BlockLZ::MinMatchLength)) <= in_size); i++)
+            {
+                table_[hash(in + pos + i)] = uint16_t(pos + i + 1U);
+            }
+            pos += len;
+            literals_begin = pos;
+        }
+        out_pos = flushLiterals(in, literals_begin, in_size, out, out_pos);
+
+        const unsigned payload_size = out_pos - unsigned(BlockLZ::HeaderSize);
+        out[0] = uint8_t(in_size & 0xFFU);
+        out[1] = uint8_t(in_size >> 8);
+        out[2] = uint8_t(payload_size & 0xFFU);
+        out[3] = uint8_t(payload_size >> 8);
+        UAVCAN_ASSERT(out_pos <= unsigned(BlockLZ::MaxEncodedBlockSize));
+        return out_pos;
+    }
+};
+
+/**
+ * Restores the blocks of a compressed file, see @ref BlockLZ. The input can be fed in pieces of any size.
+ * The decoder validates every token, so that a corrupted input can't make it write outside of the block.
+ */
+class UAVCAN_EXPORT BlockLZDecoder
+{
+    enum State { StateHeader, StateToken, StateLiterals, StateDistanceLow, StateDistanceHigh };
+
+    uint8_t block_[BlockLZ::BlockSize];
+    uint8_t header_[BlockLZ::HeaderSize];
+    uint16_t block_size_;           ///< Size of the block being decoded, from its header
+    uint16_t num_decoded_;
+    uint16_t payload_left_;
+    uint16_t distance_;
+    uint8_t header_pos_;
+    uint8_t run_left_;              ///< Literals left in the current run, or the length of the current match
+    State state_;
+    bool failed_;
+    bool last_block_short_;
+
+    int fail()
+    {
+        UAVCAN_TRACE("BlockLZDecoder", "Corrupted input");
+        failed_ = true;
+        return -ErrFailure;
+    }
+
+    int finishBlock()
+    {
+        if ((state_ != StateToken) || (num_decoded_ != block_size_))
+        {
+            return fail();
+        }
+        state_ = StateHeader;
+        last_block_short_ = block_size_ < unsigned(BlockLZ::BlockSize);
+        return 1;
+    }
+
+public:
+    BlockLZDecoder() { reset(); }
+
+    void reset()
+    {
+        block_size_ = 0;
+        num_decoded_ = 0;
+        payload_left_ = 0;
+        distance_ = 0;
+        header_pos_ = 0;
+        run_left_ = 0;
+        state_ = StateHeader;
+        failed_ = false;
+        last_block_short_ = false;
+    }
+
+    /**
+     * Consumes the input until a block has been decoded or the input is exhausted, advancing the arguments.
+     * @return  1 if a block has been decoded, see @ref getBlock(); 0 if more input is needed;
+     *          negative error code if the input is corrupted, the decoder will reject all input until reset.
+     */
+    int feed(const uint8_t*& data, unsigned& size);
+
+    const uint8_t* getBlock() const { return block_; }
+    uint16_t getBlockSize() const { return num_decoded_; }
+
+    /**
+     * True if the input so far is a complete file, i.e. it ends with a short block.
+     */
+    bool isComplete() const
+    {
+        return !failed_ && (state_ == StateHeader) && (header_pos_ == 0) && last_block_short_;
+    }
+
+    bool hasFailed() const { return failed_; }
+};
+
+inline int BlockLZDecoder::feed(const uint8_t*& data, unsigned& size)
+{
+    if (failed_)
+    {
+        return -ErrFailure;
+    }
+
+    while (size > 0)
+    {
+        const uint8_t byte = *data++;
+        size--;
+
+        if (state_ == StateHeader)
+        {
+            if (last_block_short_)
+            {
+                return fail();              // Nothing can follow the last block
+            }
+            header_[header_pos_++] = byte;
+            if (header_pos_ < unsigned(BlockLZ::HeaderSize))
+            {
+                continue;
+            }
+            header_pos_ = 0;
+            block_size_ = uint16_t(header_[0] | (header_[1] << 8));
+            payload_left_ = uint16_t(header_[2] | (header_[3] << 8));
+            num_decoded_ = 0;
+            if (block_size_ > unsigned(BlockLZ::BlockSize))
+            {
+                return fail();
+            }
+            state_ = StateToken;
+            if (payload_left_ == 0)
+            {
+                return finishBlock();
+            }
+            continue;
+        }
+
+        payload_left_--;
+        switch (state_)
+        {
+        case StateToken:
+        {
+            if ((byte & 0x80U) != 0)
+            {
+                run_left_ = uint8_t((byte & 0x7FU) + unsigned(BlockLZ::MinMatchLength));
+                state_ = StateDistanceLow;
+            }
+            else
+            {
+                run_left_ = uint8_t(byte + 1U);
+                state_ = StateLiterals;
+            }
+            break;
+        }
+        case StateLiterals:
+        {
+            if (num_decoded_ >= block_size_)
+            {
+                return fail();
+            }
+            block_[num_decoded_++] = byte;
+            run_left_--;
+            if (run_left_ == 0)
+            {
+                state_ = StateToken;
+            }
+            break;
+        }
+        case StateDistanceLow:
+        {
+            distance_ = byte;
+            state_ = StateDistanceHigh;
+            break;
+        }
+        case StateDistanceHigh:
+        {
+            distance_ = uint16_t(distance_ | (byte << 8));
+            if ((distance_ == 0) || (distance_ > num_decoded_) || ((num_decoded_ + run_left_) > block_size_))
+            {
+                return fail();
+            }
+            for (unsigned i = 0; i < run_left_; i++)    // The source may overlap with the destination
+            {
+                block_[num_decoded_] = block_[num_decoded_ - distance_];
+                num_decoded_++;
+            }
+            state_ = StateToken;
+            break;
+        }
+        case StateHeader:
+        default:
+        {
+            UAVCAN_ASSERT(0);
+            return fail();
+        }
+        }
+
+        if (payload_left_ == 0)
+        {
+            return finishBlock();
+        }
+    }
+    return 0;
+}
+
+/**
+ * Decompresses a file that is being downloaded by @ref FileDownloader on the fly and passes the original contents
+ * to another sink:
+ *
+ *      MySink my_sink;
+ *      uavcan::DecompressingFileDownloadSink decompressor(my_sink);
+ *      uavcan::FileDownloader<> downloader(node, decompressor);
+ *      ...
+ *      decompressor.reset();
+ *      downloader.start(server_node_id, compressed_path);     // See BlockLZ::makeCompressedFilePath()
+ *
+ * The target sink receives the data in blocks of up to @ref BlockLZ::BlockSize bytes, in order; the offsets refer
+ * to the original file. The download must start from the beginning of the file. The completion is reported as
+ * failed if the compressed file is corrupted or truncated.
+ */
+class UAVCAN_EXPORT DecompressingFileDownloadSink : public IFileDownloadSink
+{
+    IFileDownloadSink& target_;
+    BlockLZDecoder decoder_;
+    uint64_t next_input_offset_;
+    uint64_t output_offset_;
+    bool failed_;
+
+public:
+    explicit DecompressingFileDownloadSink(IFileDownloadSink& target)
+        : target_(target)
+        , next_input_offset_(0)
+        , output_offset_(0)
+        , failed_(false)
+    { }
+
+    /**
+     * Must be called before a new download is started.
+     */
+    void reset()
+    {
+        decoder_.reset();
+        next_input_offset_ = 0;
+        output_offset_ = 0;
+        failed_ = false;
+    }
+
+    virtual void handleFileData(uint64_t offset, const uint8_t* data, uint16_t size) override
+    {
+        if (failed_)
+        {
+            return;
+        }
+        if (offset != next_input_offset_)
+        {
+            UAVCAN_TRACE("DecompressingFileDownloadSink", "Unexpected offset");
+            failed_ = true;
+            return;
+        }
+        next_input_offset_ += size;
+
+        unsigned left = size;
+        while (left > 0)
+        {
+            const int res = decoder_.feed(data, left);
+            if (res < 0)
+            {
+                failed_ = true;
+                return;
+            }
+            if ((res > 0) && (decoder_.getBlockSize() > 0))
+            {
+                target_.handleFileData(output_offset_, decoder_.getBlock(), decoder_.getBlockSize());
+                output_offset_ += decoder_.getBlockSize();
+            }
+        }
+    }
+
+    virtual void handleFileDownloadCompletion(int error) override
+    {
+        if ((error == 0) && (failed_ || !decoder_.isComplete()))
+        {
+            error = -ErrFailure;
+        }
+        reset();
+        target_.handleFileDownloadCompletion(error);
+    }
+
+    /**
+     * Number of bytes of the original file passed to the target sink since the last reset.
+     */
+    uint64_t getNumBytesDecompressed() const { return output_offset_; }
+};
+
+}
+
+#endif // UAVCAN_PROTOCOL_FILE_COMPRESSION_HPP_INCLUDED
@@ -0,0 +1,362 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_FILE_DOWNLOADER_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_FILE_DOWNLOADER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/node/service_client.hpp>
+#include <uavcan/util/method_binder.hpp>
+// UAVCAN types
+#include <uavcan/protocol/file/Read.hpp>
+
+namespace uavcan
+{
+/**
+ * Receives the contents of the file being downloaded by @ref FileDownloader.
+ */
+class UAVCAN_EXPORT IFileDownloadSink
+{
+public:
+    /**
+     * Called for every received chunk of the file, in the order of offsets, without gaps.
+     * The data pointer is valid only until this method returns.
+     * The download can be cancelled from this method.
+     */
+    virtual void handleFileData(uint64_t offset, const uint8_t* data, uint16_t size) = 0;
+
+    /**
+     * Called once when the download is over, unless it has been cancelled.
+     *
+     * @param error     Zero if the whole file has been received;
+     *                  positive uavcan.protocol.file.Error code if the server has reported an error;
+     *                  negative error code if the server didn't respond or the request could not be sent.
+     *
+     * A new download can be started from this method.
+     */
+    virtual void handleFileDownloadCompletion(int error) = 0;
+
+    virtual ~IFileDownloadSink() { }
+};
+
+/**
+ * Downloads a file from a remote node via the service uavcan.protocol.file.Read.
+ *
+ * Instead of waiting for the response to every request before sending the next one, this class keeps a window of
+ * concurrent requests at increasing offsets, so that the throughput is limited by the bandwidth of the bus rather
+ * than by the round trip time. The responses that arrive out of order are buffered until the preceding chunks
+ * are received, and the data is passed to the sink strictly in order. The file ends at the first chunk that is
+ * shorter than the maximum size. A request that has timed out is repeated a few times before giving up.
+ *
+ * The server must be able to process several read requests from the same client at once, which is the case for
+ * @ref BasicFileServer and @ref FileServer.
+ *
+ * @tparam WindowSize_      Maximum number of concurrent requests. Each of them needs a buffer for one chunk.
+ */
+template <unsigned WindowSize_ = 4>
+class UAVCAN_EXPORT FileDownloader : Noncopyable
+{
+public:
+    typedef protocol::file::Path::FieldTypes::path Path;
+
+    enum { WindowSize = WindowSize_ };
+
+    enum { ChunkSize = protocol::file::Read::Response::FieldTypes::data::MaxSize };
+
+    enum { DefaultMaxAttempts = 3 };
+
+private:
+    typedef FileDownloader<WindowSize_> SelfType;
+    typedef MethodBinder<SelfType*, void (SelfType::*)(const ServiceCallResult<protocol::file::Read>&)>
+        ReadResponseCallback;
+
+    struct Chunk
+    {
+        ServiceCallID call_id;
+        uint64_t offset;
+        uint8_t num_attempts;
+        bool pending;                   ///< The request is in flight
+        bool received;                  ///< The response is waiting for the preceding chunks
+        protocol::file::Read::Response response;
+
+        Chunk()
+            : offset(0)
+            , num_attempts(0)
+            , pending(false)
+            , received(false)
+        { }
+    };
+
+    /// A request that has timed out is repeated from the timeout callback, before its call state is released
+    ServiceClient<protocol::file::Read, ReadResponseCallback, WindowSize_ + 1> read_client_;
+    IFileDownloadSink& sink_;
+    Chunk chunks_[WindowSize_];
+    Path path_;
+    NodeID server_node_id_;
+    uint64_t start_offset_;
+    uint64_t next_request_offset_;
+    uint64_t next_delivery_offset_;
+    uint64_t end_offset_;               ///< Where the file ends, if known
+    uint32_t num_retries_;
+    uint8_t max_attempts_;
+    bool running_;
+
+    int request(Chunk& chunk, uint64_t offset);
+
+    int fillWindow();
+
+    void deliver();
+
+    void finish(int error);
+
+    void handleReadResponse(const ServiceCallResult<protocol::file::Read>& result);
+
+public:
+    FileDownloader(INode& node, IFileDownloadSink& sink)
+        : read_client_(node)
+        , sink_(sink)
+        , start_offset_(0)
+        , next_request_offset_(0)
+        , next_delivery_offset_(0)
+        , end_offset_(0)
+        , num_retries_(0)
+        , max_attempts_(DefaultMaxAttempts)
+        , running_(false)
+    {
+        StaticAssert<(WindowSize_ > 0)>::check();
+        read_client_.setCallback(ReadResponseCallback(this, &SelfType::handleReadResponse));
+    }
+
+    /**
+     * Begins downloading the file from the given server, cancelling the download in progress, if any.
+     * The data will be delivered to the sink starting from the specified offset.
+     * Returns negative error code.
+     */
+    int start(NodeID server_node_id, const Path& path, uint64_t offset = 0);
+
+    /**
+     * Stops the download in progress. The sink will not be notified.
+     */
+    void cancel()
+    {
+        running_ = false;
+        read_client_.cancelAllCalls();
+        for (unsigned i = 0; i < WindowSize_; i++)
+        {
+            chunks_[i].pending = false;
+            chunks_[i].received = false;
+        }
+    }
+
+    bool isRunning() const { return running_; }
+
+    NodeID getServerNodeID() const { return server_node_id_; }
+    const Path& getPath() const { return path_; }
+
+    /**
+     * Number of bytes passed to the sink since the download has been started.
+     */
+    uint64_t getNumBytesDelivered() const { return next_delivery_offset_ - start_offset_; }
+
+    /**
+     * Number of requests that have been repeated because the previous attempt has timed out.
+     */
+    uint32_t getNumRetries() const { return num_retries_; }
+
+    /**
+     * How many times a request may be sent before the download is considered failed. At least one.
+     */
+    uint8_t getMaxAttempts() const { return max_attempts_; }
+    void setMaxAttempts(uint8_t num) { max_attempts_ = max<uint8_t>(num, 1); }
+
+    /**
+     * Refer to @ref ServiceClient for details. Changes will not affect the requests that are already pending.
+     */
+    MonotonicDuration getRequestTimeout() const { return read_client_.getRequestTimeout(); }
+    void setRequestTimeout(MonotonicDuration timeout) { read_client_.setRequestTimeout(timeout); }
+
+    TransferPriority getPriority() const { return read_client_.getPriority(); }
+    void setPriority(const TransferPriority prio) { read_client_.setPriority(prio); }
+};
+
+// ----------------------------------------------------------------------------
+
+template <unsigned WindowSize_>
+int FileDownloader<WindowSize_>::request(Chunk& chunk, uint64_t offset)
+{
+    protocol::file::Read::Request req;
+    req.offset = offset;
+    req.path.path = path_;
+
+    const int res = read_client_.call(server_node_id_, req, chunk.call_id);
+    if (res < 0)
+    {
+        UAVCAN_TRACE("FileDownloader", "Read request failure %i", res);
+        return res;
+    }
+    chunk.offset = offset;
+    chunk.num_attempts++;
+    chunk.pending = true;
+    chunk.received = false;
+    return res;
+}
+
+template <unsigned WindowSize_>
+int FileDownloader<WindowSize_>::fillWindow()
+{
+    for (unsigned i = 0; (i < WindowSize_) && (next_request_offset_ < end_offset_); i++)
+    {
+        Chunk& chunk = chunks_[i];
+        if (!chunk.pending && !chunk.received)
+        {
+            chunk.num_attempts = 0;
+            const int res = request(chunk, next_request_offset_);
+            if (res < 0)
+            {
+                return res;
+            }
+            next_request_offset_ += unsigned(ChunkSize);
+        }
+    }
+    return 0;
+}
+
+template <unsigned WindowSize_>
+void FileDownloader<WindowSize_>::deliver()
+{
+    bool progress = true;
+    while (running_ && progress)
+    {
+        progress = false;
+        for (unsigned i = 0; i < WindowSize_; i++)
+        {
+            Chunk& chunk = chunks_[i];
+            if (!chunk.received || (chunk.offset != next_delivery_offset_))
+            {
+                continue;
+            }
+
+            chunk.received = false;
+            const uint16_t size = uint16_t(chunk.response.data.size());
+            next_delivery_offset_ += size;
+            if (size > 0)
+            {
+                sink_.handleFileData(chunk.offset, chunk.response.data.begin(), size);
+            }
+            if (!running_)
+            {
+                return;                     // Cancelled by the sink
+            }
+            if (size < unsigned(ChunkSize))
+            {
+                finish(0);
+                return;
+            }
+            progress = true;
+            break;
+        }
+    }
+}
+
+template <unsigned WindowSize_>
+void FileDownloader<WindowSize_>::finish(int error)
+{
+    UAVCAN_TRACE("FileDownloader", "Finished with %i after %llu bytes", error,
+                 static_cast<unsigned long long>(getNumBytesDelivered()));
+    cancel();
+    sink_.handleFileDownloadCompletion(error);
+}
+
+template <unsigned WindowSize_>
+void FileDownloader<WindowSize_>::handleReadResponse(const ServiceCallResult<protocol::file::Read>& result)
+{
+    Chunk* chunk = UAVCAN_NULLPTR;
+    for (unsigned i = 0; i < WindowSize_; i++)
+    {
+        if (chunks_[i].pending && (chunks_[i].call_id == result.getCallID()))
+        {
+            chunk = &chunks_[i];
+            break;
+        }
+    }
+    if (!running_ || (chunk == UAVCAN_NULLPTR))
+    {
+        return;
+    }
+    chunk->pending = false;
+
+    if (!result.isSuccessful())
+    {
+        if (chunk->num_attempts >= max_attempts_)
+        {
+            finish(-ErrFailure);
+            return;
+        }
+        num_retries_++;
+        const int res = request(*chunk, chunk->offset);
+        if (res < 0)
+        {
+            finish(res);
+        }
+        return;
+    }
+
+    const protocol::file::Read::Response& response = result.getResponse();
+    if (response.error.value != protocol::file::Error::OK)
+    {
+        finish(response.error.value);
+        return;
+    }
+
+    chunk->response = response;
+    chunk->received = true;
+    if (response.data.size() < unsigned(ChunkSize))
+    {
+        end_offset_ = min(end_offset_, chunk->offset + response.data.size());
+    }
+
+    deliver();
+
+    if (running_)
+    {
+        const int res = fillWindow();
+        if (res < 0)
+        {
+            finish(res);
+        }
+    }
+}
+
+template <unsigned WindowSize_>
+int FileDownloader<WindowSize_>::start(NodeID server_node_id, const Path& path, uint64_t offset)
+{
+    cancel();
+
+    int res = read_client_.init();
+    if (res < 0)
+    {
+        return res;
+    }
+
+    path_ = path;
+    server_node_id_ = server_node_id;
+    start_offset_ = offset;
+    next_request_offset_ = offset;
+    next_delivery_offset_ = offset;
+    end_offset_ = NumericTraits<uint64_t>::max();
+    num_retries_ = 0;
+    running_ = true;
+
+    res = fillWindow();
+    if (res < 0)
+    {
+        cancel();
+    }
+    return res;
+}
+
+}
+
+#endif // UAVCAN_PROTOCOL_FILE_DOWNLOADER_HPP_INCLUDED
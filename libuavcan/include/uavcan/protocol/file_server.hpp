@@ -165,39 +165,56 @@ class BasicFileServer
             GetInfoCallback;
 
     typedef MethodBinder<BasicFileServer*,
-        void (BasicFileServer::*)(const protocol::file::Read::Request&, protocol::file::Read::Response&)>
+        void (BasicFileServer::*)(const protocol::file::Read::Request&, ServiceResponseWriter&)>
             ReadCallback;
 
     ServiceServer<protocol::file::GetInfo, GetInfoCallback> get_info_srv_;
-    ServiceServer<protocol::file::Read, ReadCallback> read_srv_;
+    DirectServiceServer<protocol::file::Read, ReadCallback> read_srv_;
 
     void handleGetInfo(const protocol::file::GetInfo::Request& req, protocol::file::GetInfo::Response& resp)
     {
         resp.error.value = backend_.getInfo(req.path.path, resp.size, resp.entry_type);
     }
 
-    void handleRead(const protocol::file::Read::Request& req, protocol::file::Read::Response& resp)
+    /**
+     * The backend reads straight into the transfer buffer of the response, no intermediate copy is made.
+     * The error field precedes the data, so it is written in advance; if the read fails, the response is
+     * rewritten with the error code and no data.
+     */
+    void handleRead(const protocol::file::Read::Request& req, ServiceResponseWriter& writer)
     {
-        uint16_t inout_size = resp.data.capacity();
-
-        resp.data.resize(inout_size);
+        typedef protocol::file::Read::Response::FieldTypes FieldTypes;
 
-        resp.error.value = backend_.read(req.path.path, req.offset, resp.data.begin(), inout_size);
+        protocol::file::Error error;
+        error.value = protocol::file::Error::OK;
+        (void)writer.encodeField<FieldTypes::error>(error);
 
-        if (resp.error.value != protocol::file::Error::OK)
+        uint8_t* const data = writer.beginByteArray<FieldTypes::data>(true);
+        if (data == UAVCAN_NULLPTR)
         {
-            inout_size = 0;
+            UAVCAN_ASSERT(0);
+            return;
         }
 
-        if (inout_size > resp.data.capacity())
+        uint16_t inout_size = FieldTypes::data::MaxSize;
+
+        error.value = backend_.read(req.path.path, req.offset, data, inout_size);
+
+        if ((error.value == protocol::file::Error::OK) && (inout_size > FieldTypes::data::MaxSize))
         {
             UAVCAN_ASSERT(0);
-            resp.error.value = protocol::file::Error::UNKNOWN_ERROR;
+            error.value = protocol::file::Error::UNKNOWN_ERROR;
         }
-        else
+
+        if (error.value != protocol::file::Error::OK)
         {
-            resp.data.resize(inout_size);
+            writer.restart();
+            (void)writer.encodeField<FieldTypes::error>(error);
+            (void)writer.beginByteArray<FieldTypes::data>(true);
+            inout_size = 0;
         }
+
+        (void)writer.commitByteArray<FieldTypes::data>(inout_size);
     }
 
 protected:
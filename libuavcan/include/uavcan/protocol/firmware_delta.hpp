@@ -0,0 +1,711 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_FIRMWARE_DELTA_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_FIRMWARE_DELTA_HPP_INCLUDED
+
+#include <cstring>
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/util/templates.hpp>
+#include <uavcan/transport/crc.hpp>
+#include <uavcan/protocol/file_downloader.hpp>
+// UAVCAN types
+#include <uavcan/protocol/file/Path.hpp>
+
+namespace uavcan
+{
+/**
+ * Binary patch that turns one firmware image (the base) into another one (the target), so that a node that runs
+ * a known version only downloads the difference. The base is identified by its image CRC, which the node reports
+ * in uavcan.protocol.GetNodeInfo (software_version.image_crc).
+ *
+ * The file server provides the patch for the file P against the base with the CRC X under the name of P followed by
+ * ".<X as 16 lowercase hex digits>" and @ref getPathSuffix(), see @ref makeDeltaFilePath(). A node that is asked to
+ * update to P requests the patch first, and falls back to P itself if the server reports an error, e.g. because it
+ * doesn't know the base; the patch is applied by @ref DeltaPatchingFileDownloadSink.
+ *
+ * The patch can be applied in place, i.e. in the memory that holds the base: the base is moved up by the shift from
+ * the header first, then the target is written from the beginning upwards, and the encoder guarantees that every
+ * copied range of the moved base is read before it is overwritten. The memory must hold max(target size,
+ * base size + shift) bytes.
+ *
+ * Header, little endian:
+ *  - magic "UFD1" (4)
+ *  - image CRC of the base (8)
+ *  - size of the base (4)
+ *  - size of the target (4)
+ *  - shift (4)
+ *  - CRC-16-CCITT of the target, see @ref TransferCRC (2)
+ *  - reserved, zero (2)
+ *
+ * The header is followed by a sequence of operations, every operation starts with one byte:
+ *  - 0xxxxxxx  - literal run, x + 1 bytes follow that are copied to the output as is;
+ *  - 10000000  - copy from the base; the offset in the base (4) and the length (2, non-zero) follow.
+ * Other values are reserved. The operations produce the target from the beginning to the end, without gaps.
+ */
+class UAVCAN_EXPORT FirmwareDelta
+{
+public:
+    typedef protocol::file::Path::FieldTypes::path Path;
+
+    enum { HeaderSize = 28 };
+    enum { CopyOpSize = 7 };
+    enum { CopyOpTag = 0x80 };
+    enum { MaxLiteralRunLength = 0x80 };
+    enum { MaxCopyLength = 0xFFFF };
+    enum { BaseCRCHexDigits = 16 };
+
+    struct Header
+    {
+        uint64_t base_crc;
+        uint32_t base_size;
+        uint32_t target_size;
+        uint32_t shift;
+        uint16_t target_crc;
+
+        Header()
+            : base_crc(0)
+            , base_size(0)
+            , target_size(0)
+            , shift(0)
+            , target_crc(0)
+        { }
+    };
+
+    static const char* getPathSuffix() { return ".dlt"; }
+
+    /**
+     * The patch can't be longer than this, which is the target as a single run of literals.
+     */
+    static uint32_t getMaxPatchSize(uint32_t target_size)
+    {
+        return uint32_t(HeaderSize) + target_size +
+               (target_size + uint32_t(MaxLiteralRunLength) - 1U) / uint32_t(MaxLiteralRunLength);
+    }
+
+    static void writeHeader(const Header& header, uint8_t* out);
+
+    /**
+     * Returns false if the magic doesn't match.
+     */
+    static bool readHeader(const uint8_t* in, Header& out_header);
+
+    /**
+     * Returns false if the path is too long to add the suffix.
+     */
+    static bool makeDeltaFilePath(const Path& path, uint64_t base_crc, Path& out_path);
+
+    /**
+     * Extracts the name of the target file and the CRC of the base from the name of a patch.
+     * Returns false if the path doesn't refer to a patch.
+     */
+    static bool parseDeltaFilePath(const Path& delta_path, Path& out_path, uint64_t& out_base_crc);
+};
+
+/**
+ * Makes the patches, see @ref FirmwareDelta. The encoder works on the complete images in memory, so it is meant for
+ * the server side; the matches are found greedily via a hash table of the positions in the base, preferring the
+ * displacement of the previous match, which is what code that has only moved looks like.
+ *
+ * @tparam HashBits_    Size of the hash table in bits; the table takes 4 * 2^HashBits_ bytes.
+ */
+template <unsigned HashBits_ = 16>
+class UAVCAN_EXPORT FirmwareDeltaEncoder : Noncopyable
+{
+    enum { HashSize = 1U << HashBits_ };
+
+    /// Shorter matches are encoded as literals, they would not save anything
+    enum { MinCopyLength = 8 };
+
+    /// The shift costs memory on the node, so it is only increased for the matches that are worth it
+    enum { MinShiftingCopyLength = 64 };
+
+    uint32_t table_[HashSize];      ///< Position plus one of the last occurrence in the base; zero if none
+
+    static unsigned hash(const uint8_t* p)
+    {
+        const uint32_t lo = uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+        const uint32_t hi = uint32_t(p[4]) | (uint32_t(p[5]) << 8) | (uint32_t(p[6]) << 16) | (uint32_t(p[7]) << 24);
+        return unsigned(((lo * 2654435761U) ^ (hi * 2246822519U)) >> (32U - HashBits_));
+    }
+
+    static unsigned flushLiterals(const uint8_t* in, uint32_t begin, uint32_t end, uint8_t* out, unsigned out_pos);
+
+    /**
+     * Length of the match of the target at the position with the base at the offset; zero if it can't be used.
+     */
+    static uint32_t measureMatch(const uint8_t* base, uint32_t base_size, uint32_t offset,
+                                 const uint8_t* target, uint32_t target_size, uint32_t pos,
+                                 uint32_t shift, uint32_t max_shift);
+
+public:
+    FirmwareDeltaEncoder()
+    {
+        StaticAssert<(HashBits_ >= 8) && (HashBits_ <= 24)>::check();
+    }
+
+    /**
+     * Makes the patch.
+     * @param base_crc      Image CRC of the base, which is written into the header.
+     * @param max_shift     Limit of the shift, i.e. how far the base can be moved up in the memory of the node
+     *                      to be patched in place; zero if only the copies from the same or higher offsets are
+     *                      allowed. The matches that would need a larger shift are encoded as literals.
+     * @param out           At least @ref FirmwareDelta::getMaxPatchSize() bytes.
+     * @return              Length of the patch.
+     */
+    uint32_t encode(const uint8_t* base, uint32_t base_size, uint64_t base_crc,
+                    const uint8_t* target, uint32_t target_size, uint32_t max_shift, uint8_t* out);
+};
+
+/**
+ * Memory that holds the firmware image of the node being updated, e.g. the application area of the flash.
+ * Refer to @ref DeltaPatchingFileDownloadSink.
+ */
+class UAVCAN_EXPORT IFirmwareImageStorage
+{
+public:
+    /**
+     * Both methods return negative error code.
+     */
+    virtual int read(uint32_t offset, uint8_t* data, uint16_t size) = 0;
+    virtual int write(uint32_t offset, const uint8_t* data, uint16_t size) = 0;
+
+    /**
+     * Size of the memory in bytes.
+     */
+    virtual uint32_t getCapacity() const = 0;
+
+    virtual ~IFirmwareImageStorage() { }
+};
+
+/**
+ * Applies a patch that is being downloaded by @ref FileDownloader to the image in the storage, in place, and
+ * passes the new image to another sink, e.g. to track the progress or to compute the image CRC:
+ *
+ *      MyFlash flash;
+ *      MySink my_sink;
+ *      uavcan::DeltaPatchingFileDownloadSink patcher(flash, my_sink);
+ *      uavcan::FileDownloader<> downloader(node, patcher);
+ *      ...
+ *      uavcan::FirmwareDelta::makeDeltaFilePath(path, my_image_crc, delta_path);
+ *      patcher.reset(my_image_crc, my_image_size);
+ *      downloader.start(server_node_id, delta_path);
+ *
+ * The target sink receives the new image in order, after it has been written to the storage, and the completion.
+ * If the completion is reported with an error, the image should be downloaded in full. The storage is not modified
+ * until the header has been received and found to match the image, so nothing is lost if the server doesn't have
+ * the patch; afterwards the image is incomplete until the patch has been applied or the full image is downloaded.
+ * The completion is reported as failed if the patch is corrupted or truncated, or if the result doesn't match the
+ * CRC of the target. The download must start from the beginning of the file.
+ */
+class UAVCAN_EXPORT DeltaPatchingFileDownloadSink : public IFileDownloadSink
+{
+    enum State { StateHeader, StateOp, StateLiterals, StateCopyArgs, StateFailed };
+
+    enum { BufferSize = FirmwareDelta::MaxLiteralRunLength };
+
+    IFirmwareImageStorage& storage_;
+    IFileDownloadSink& target_;
+    FirmwareDelta::Header header_;
+    TransferCRC crc_;
+    uint64_t expected_base_crc_;
+    uint64_t next_input_offset_;
+    uint32_t expected_base_size_;
+    uint32_t output_size_;
+    uint8_t buffer_[BufferSize];        ///< Header, literals or copy arguments
+    uint8_t buffered_;
+    uint8_t run_left_;
+    State state_;
+    bool storage_modified_;
+
+    int fail(const char* reason)
+    {
+        (void)reason;
+        UAVCAN_TRACE("DeltaPatchingFileDownloadSink", "Failed: %s", reason);
+        state_ = StateFailed;
+        return -ErrFailure;
+    }
+
+    int handleHeader();
+
+    int moveBase();
+
+    int writeOutput(const uint8_t* data, uint16_t size);
+
+    int copyFromBase(uint32_t offset, uint16_t length);
+
+    int consume(uint8_t byte);
+
+public:
+    DeltaPatchingFileDownloadSink(IFirmwareImageStorage& storage, IFileDownloadSink& target)
+        : storage_(storage)
+        , target_(target)
+        , expected_base_crc_(0)
+        , next_input_offset_(0)
+        , expected_base_size_(0)
+        , output_size_(0)
+        , buffered_(0)
+        , run_left_(0)
+        , state_(StateFailed)
+        , storage_modified_(false)
+    { }
+
+    /**
+     * Must be called before a new download is started.
+     * @param base_crc      Image CRC of the firmware in the storage, as reported in GetNodeInfo.
+     * @param base_size     Size of the firmware in the storage.
+     */
+    void reset(uint64_t base_crc, uint32_t base_size)
+    {
+        header_ = FirmwareDelta::Header();
+        crc_ = TransferCRC();
+        expected_base_crc_ = base_crc;
+        expected_base_size_ = base_size;
+        next_input_offset_ = 0;
+        output_size_ = 0;
+        buffered_ = 0;
+        run_left_ = 0;
+        state_ = StateHeader;
+        storage_modified_ = false;
+    }
+
+    virtual void handleFileData(uint64_t offset, const uint8_t* data, uint16_t size) override;
+
+    virtual void handleFileDownloadCompletion(int error) override;
+
+    /**
+     * True if the storage has been modified since the last reset.
+     */
+    bool hasModifiedStorage() const { return storage_modified_; }
+
+    /**
+     * Size of the new image, valid once the download has completed successfully.
+     */
+    uint32_t getTargetSize() const { return header_.target_size; }
+
+    /**
+     * Number of bytes of the new image written so far.
+     */
+    uint32_t getNumBytesPatched() const { return output_size_; }
+};
+
+// ----------------------------------------------------------------------------
+
+inline void FirmwareDelta::writeHeader(const Header& header, uint8_t* out)
+{
+    out[0] = 'U';
+    out[1] = 'F';
+    out[2] = 'D';
+    out[3] = '1';
+    for (unsigned i = 0; i < 8; i++)
+    {
+        out[4 + i] = uint8_t((header.base_crc >> (i * 8U)) & 0xFFU);
+    }
+    for (unsigned i = 0; i < 4; i++)
+    {
+        out[12 + i] = uint8_t((header.base_size >> (i * 8U)) & 0xFFU);
+        out[16 + i] = uint8_t((header.target_size >> (i * 8U)) & 0xFFU);
+        out[20 + i] = uint8_t((header.shift >> (i * 8U)) & 0xFFU);
+    }
+    out[24] = uint8_t(header.target_crc & 0xFFU);
+    out[25] = uint8_t(header.target_crc >> 8);
+    out[26] = 0;
+    out[27] = 0;
+}
+
+inline bool FirmwareDelta::readHeader(const uint8_t* in, Header& out_header)
+{
+    if ((in[0] != 'U') || (in[1] != 'F') || (in[2] != 'D') || (in[3] != '1'))
+    {
+        return false;
+    }
+    out_header = Header();
+    for (unsigned i = 0; i < 8; i++)
+    {
+        out_header.base_crc |= uint64_t(in[4 + i]) << (i * 8U);
+    }
+    for (unsigned i = 0; i < 4; i++)
+    {
+        out_header.base_size |= uint32_t(in[12 + i]) << (i * 8U);
+        out_header.target_size |= uint32_t(in[16 + i]) << (i * 8U);
+        out_header.shift |= uint32_t(in[20 + i]) << (i * 8U);
+    }
+    out_header.target_crc = uint16_t(in[24] | (in[25] << 8));
+    return true;
+}
+
+inline bool FirmwareDelta::makeDeltaFilePath(const Path& path, uint64_t base_crc, Path& out_path)
+{
+    const char* const suffix = getPathSuffix();
+    if ((path.size() + 1U + unsigned(BaseCRCHexDigits) + std::strlen(suffix)) > Path::MaxSize)
+    {
+        return false;
+    }
+    static const char Hex[] = "0123456789abcdef";
+    out_path = path;
+    out_path.push_back('.');
+    for (int i = BaseCRCHexDigits - 1; i >= 0; i--)
+    {
+        out_path.push_back(uint8_t(Hex[(base_crc >> (unsigned(i) * 4U)) & 0xFU]));
+    }
+    out_path += suffix;
+    return true;
+}
+
+inline bool FirmwareDelta::parseDeltaFilePath(const Path& delta_path, Path& out_path, uint64_t& out_base_crc)
+{
+    const unsigned suffix_len = unsigned(std::strlen(getPathSuffix()));
+    const unsigned tail_len = 1U + unsigned(BaseCRCHexDigits) + suffix_len;
+    if ((delta_path.size() <= tail_len) ||
+        (std::memcmp(delta_path.begin() + (delta_path.size() - suffix_len), getPathSuffix(), suffix_len) != 0))
+    {
+        return false;
+    }
+
+    const unsigned crc_begin = unsigned(delta_path.size()) - unsigned(BaseCRCHexDigits) - suffix_len;
+    if (delta_path[uint8_t(crc_begin - 1U)] != '.')
+    {
+        return false;
+    }
+    uint64_t crc = 0;
+    for (unsigned i = 0; i < unsigned(BaseCRCHexDigits); i++)
+    {
+        const char c = char(delta_path[uint8_t(crc_begin + i)]);
+        unsigned digit = 0;
+        if ((c >= '0') && (c <= '9'))
+        {
+            digit = unsigned(c - '0');
+        }
+        else if ((c >= 'a') && (c <= 'f'))
+        {
+            digit = unsigned(c - 'a') + 10U;
+        }
+        else
+        {
+            return false;
+        }
+        crc = (crc << 4) | digit;
+    }
+
+    out_base_crc = crc;
+    out_path = delta_path;
+    out_path.resize(uint8_t(delta_path.size() - tail_len));
+    return true;
+}
+
+template <unsigned HashBits_>
+unsigned FirmwareDeltaEncoder<HashBits_>::flushLiterals(const uint8_t* in, uint32_t begin, uint32_t end,
+                                                        uint8_t* out, unsigned out_pos)
+{
+    while (begin < end)
+    {
+        const uint32_t len = min(end - begin, uint32_t(FirmwareDelta::MaxLiteralRunLength));
+        out[out_pos++] = uint8_t(len - 1U);
+        (void)copy(in + begin, in + begin + len, out + out_pos);
+        out_pos += len;
+        begin += len;
+    }
+    return out_pos;
+}
+
+template <unsigned HashBits_>
+uint32_t FirmwareDeltaEncoder<HashBits_>::measureMatch(const uint8_t* base, uint32_t base_size, uint32_t offset,
+                                                       const uint8_t* target, uint32_t target_size, uint32_t pos,
+                                                       uint32_t shift, uint32_t max_shift)
+{
+    const uint32_t required_shift = (pos > offset) ? (pos - offset) : 0U;
+    if ((offset >= base_size) || (required_shift > max_shift))
+    {
+        return 0;
+    }
+    const uint32_t max_len = min(min(base_size - offset, target_size - pos), uint32_t(FirmwareDelta::MaxCopyLength));
+    uint32_t len = 0;
+    while ((len < max_len) && (base[offset + len] == target[pos + len]))
+    {
+        len++;
+    }
+    return ((required_shift > shift) && (len < uint32_t(MinShiftingCopyLength))) ? 0U : len;
+}
+
+template <unsigned HashBits_>
+uint32_t FirmwareDeltaEncoder<HashBits_>::encode(const uint8_t* base, uint32_t base_size, uint64_t base_crc,
+                                                 const uint8_t* target, uint32_t target_size, uint32_t max_shift,
+                                                 uint8_t* out)
+{
+    fill(table_, table_ + HashSize, uint32_t(0));
+    for (uint32_t i = 0; (i + uint32_t(MinCopyLength)) <= base_size; i++)
+    {
+        table_[hash(base + i)] = i + 1U;
+    }
+
+    FirmwareDelta::Header header;
+    header.base_crc = base_crc;
+    header.base_size = base_size;
+    header.target_size = target_size;
+
+    unsigned out_pos = FirmwareDelta::HeaderSize;
+    uint32_t literals_begin = 0;
+    uint32_t pos = 0;
+    uint32_t last_offset_end = 0;           ///< Where the previous copy ended in the base
+    uint32_t last_pos_end = 0;              ///< Where the previous copy ended in the target
+    bool have_last = false;
+
+    while ((pos + uint32_t(MinCopyLength)) <= target_size)
+    {
+        uint32_t best_offset = 0;
+        uint32_t best_len = 0;
+
+        // The same displacement as the previous match, i.e. the change in between didn't move the code
+        if (have_last)
+        {
+            const uint32_t offset = last_offset_end + (pos - last_pos_end);
+            if (offset >= last_offset_end)
+            {
+                best_len = measureMatch(base, base_size, offset, target, target_size, pos, header.shift, max_shift);
+                best_offset = offset;
+            }
+        }
+
+        const uint32_t candidate = table_[hash(target + pos)];
+        if (candidate != 0)
+        {
+            const uint32_t len = measureMatch(base, base_size, candidate - 1U, target, target_size, pos,
+                                              header.shift, max_shift);
+            if (len > best_len)
+            {
+                best_len = len;
+                best_offset = candidate - 1U;
+            }
+        }
+
+        if (best_len < uint32_t(MinCopyLength))
+        {
+            pos++;
+            continue;
+        }
+
+        out_pos = flushLiterals(target, literals_begin, pos, out, out_pos);
+        out[out_pos++] = uint8_t(FirmwareDelta::CopyOpTag);
+        for (unsigned i = 0; i < 4; i++)
+        {
+            out[out_pos++] = uint8_t((best_offset >> (i * 8U)) & 0xFFU);
+        }
+        out[out_pos++] = uint8_t(best_len & 0xFFU);
+        out[out_pos++] = uint8_t(best_len >> 8);
+
+        if (pos > best_offset)
+        {
+            header.shift = max(header.shift, pos - best_offset);
+        }
+        pos += best_len;
+        literals_begin = pos;
+        last_offset_end = best_offset + best_len;
+        last_pos_end = pos;
+        have_last = true;
+    }
+    out_pos = flushLiterals(target, literals_begin, target_size, out, out_pos);
+
+    TransferCRC crc;
+    crc.add(target, target_size);
+    header.target_crc = crc.get();
+    FirmwareDelta::writeHeader(header, out);
+
+    UAVCAN_ASSERT(out_pos <= FirmwareDelta::getMaxPatchSize(target_size));
+    return uint32_t(out_pos);
+}
+
+inline int DeltaPatchingFileDownloadSink::handleHeader()
+{
+    if (!FirmwareDelta::readHeader(buffer_, header_))
+    {
+        return fail("magic");
+    }
+    if ((header_.base_crc != expected_base_crc_) || (header_.base_size != expected_base_size_))
+    {
+        return fail("different base");
+    }
+    const uint32_t capacity = storage_.getCapacity();
+    if ((header_.target_size > capacity) || (header_.base_size > capacity) ||
+        (header_.shift > (capacity - header_.base_size)))
+    {
+        return fail("too large");
+    }
+    buffered_ = 0;
+    state_ = StateOp;
+    storage_modified_ = true;
+    return moveBase();
+}
+
+inline int DeltaPatchingFileDownloadSink::moveBase()
+{
+    if (header_.shift == 0)
+    {
+        return 0;
+    }
+    // From the end downwards, so that the source is read before the overlapping destination is written
+    uint32_t end = header_.base_size;
+    while (end > 0)
+    {
+        const uint16_t len = uint16_t(min(end, uint32_t(BufferSize)));
+        end -= len;
+        int res = storage_.read(end, buffer_, len);
+        if (res >= 0)
+        {
+            res = storage_.write(end + header_.shift, buffer_, len);
+        }
+        if (res < 0)
+        {
+            (void)fail("storage");
+            return res;
+        }
+    }
+    return 0;
+}
+
+inline int DeltaPatchingFileDownloadSink::writeOutput(const uint8_t* data, uint16_t size)
+{
+    if ((uint32_t(size) > header_.target_size) || (output_size_ > (header_.target_size - size)))
+    {
+        return fail("output overflow");
+    }
+    const int res = storage_.write(output_size_, data, size);
+    if (res < 0)
+    {
+        (void)fail("storage");
+        return res;
+    }
+    crc_.add(data, size);
+    target_.handleFileData(output_size_, data, size);
+    output_size_ += size;
+    return 0;
+}
+
+inline int DeltaPatchingFileDownloadSink::copyFromBase(uint32_t offset, uint16_t length)
+{
+    if ((length == 0) || (offset >= header_.base_size) || (length > (header_.base_size - offset)))
+    {
+        return fail("copy range");
+    }
+    // The moved base must not have been overwritten yet; the encoder guarantees that
+    if ((offset + header_.shift) < output_size_)
+    {
+        return fail("copy order");
+    }
+    while (length > 0)
+    {
+        const uint16_t len = uint16_t(min(length, uint16_t(BufferSize)));
+        const int res = storage_.read(offset + header_.shift, buffer_, len);
+        if (res < 0)
+        {
+            (void)fail("storage");
+            return res;
+        }
+        const int write_res = writeOutput(buffer_, len);
+        if (write_res < 0)
+        {
+            return write_res;
+        }
+        offset += len;
+        length = uint16_t(length - len);
+    }
+    return 0;
+}
+
+inline int DeltaPatchingFileDownloadSink::consume(uint8_t byte)
+{
+    switch (state_)
+    {
+    case StateHeader:
+    {
+        buffer_[buffered_++] = byte;
+        return (buffered_ < unsigned(FirmwareDelta::HeaderSize)) ? 0 : handleHeader();
+    }
+    case StateOp:
+    {
+        if ((byte & 0x80U) == 0)
+        {
+            run_left_ = uint8_t(byte + 1U);
+            state_ = StateLiterals;
+        }
+        else if (byte == uint8_t(FirmwareDelta::CopyOpTag))
+        {
+            state_ = StateCopyArgs;
+        }
+        else
+        {
+            return fail("reserved op");
+        }
+        buffered_ = 0;
+        return 0;
+    }
+    case StateLiterals:
+    {
+        buffer_[buffered_++] = byte;
+        if (buffered_ < run_left_)
+        {
+            return 0;
+        }
+        state_ = StateOp;
+        return writeOutput(buffer_, buffered_);
+    }
+    case StateCopyArgs:
+    {
+        buffer_[buffered_++] = byte;
+        if (buffered_ < (unsigned(FirmwareDelta::CopyOpSize) - 1U))
+        {
+            return 0;
+        }
+        const uint32_t offset = uint32_t(buffer_[0]) | (uint32_t(buffer_[1]) << 8) |
+                                (uint32_t(buffer_[2]) << 16) | (uint32_t(buffer_[3]) << 24);
+        const uint16_t length = uint16_t(buffer_[4] | (buffer_[5] << 8));
+        state_ = StateOp;
+        return copyFromBase(offset, length);
+    }
+    case StateFailed:
+    default:
+    {
+        return -ErrFailure;
+    }
+    }
+}
+
+inline void DeltaPatchingFileDownloadSink::handleFileData(uint64_t offset, const uint8_t* data, uint16_t size)
+{
+    if (state_ == StateFailed)
+    {
+        return;
+    }
+    if (offset != next_input_offset_)
+    {
+        (void)fail("unexpected offset");
+        return;
+    }
+    next_input_offset_ += size;
+
+    for (uint16_t i = 0; i < size; i++)
+    {
+        if (consume(data[i]) < 0)
+        {
+            return;
+        }
+    }
+}
+
+inline void DeltaPatchingFileDownloadSink::handleFileDownloadCompletion(int error)
+{
+    if ((error == 0) &&
+        ((state_ != StateOp) || (output_size_ != header_.target_size) || (crc_.get() != header_.target_crc)))
+    {
+        UAVCAN_TRACE("DeltaPatchingFileDownloadSink", "Incomplete or wrong result");
+        error = -ErrFailure;
+    }
+    state_ = StateFailed;               // Until reset
+    target_.handleFileDownloadCompletion(error);
+}
+
+}
+
+#endif // UAVCAN_PROTOCOL_FIRMWARE_DELTA_HPP_INCLUDED
@@ -10,6 +10,7 @@
 #include <uavcan/node/service_client.hpp>
 #include <uavcan/util/method_binder.hpp>
 #include <uavcan/util/map.hpp>
+#include <uavcan/transport/node_id_set.hpp>
 #include <uavcan/protocol/node_info_retriever.hpp>
 // UAVCAN types
 #include <uavcan/protocol/file/BeginFirmwareUpdate.hpp>
@@ -53,6 +54,44 @@ public:
     virtual bool shouldRequestFirmwareUpdate(NodeID node_id, const protocol::GetNodeInfo::Response& node_info,
                                              FirmwareFilePath& out_firmware_file_path) = 0;
 
+    /**
+     * This method will be invoked right after @ref shouldRequestFirmwareUpdate() has confirmed the update.
+     * The nodes with lower values are requested first; nodes of equal priority are requested in a round-robin
+     * fashion.
+     *
+     * Implementation is optional; default one returns the same priority for all nodes.
+     *
+     * @param node_id                   Node ID that this GetNodeInfo response was received from.
+     *
+     * @param node_info                 Actual node info structure.
+     *
+     * @return                          Update priority of the node, lower value means more urgent.
+     */
+    virtual uint8_t getFirmwareUpdatePriority(NodeID node_id, const protocol::GetNodeInfo::Response& node_info)
+    {
+        (void)node_id;
+        (void)node_info;
+        return 0;
+    }
+
+    /**
+     * This method will be invoked before the update request is sent to the node. It allows the application to
+     * hold the request back while its file server is overloaded, e.g. if it is already serving too many reads.
+     * The request will be reconsidered on the next request interval.
+     *
+     * Implementation is optional; default one always admits the request.
+     *
+     * @param node_id                   Node ID that the request is going to be sent to.
+     *
+     * @return                          True - the request will be sent now.
+     *                                  False - the request will be postponed.
+     */
+    virtual bool canBeginFirmwareUpdate(NodeID node_id)
+    {
+        (void)node_id;
+        return true;
+    }
+
     /**
      * This method will be invoked when a node responds to the update request with an error. If the request simply
      * times out, this method will not be invoked.
@@ -132,6 +171,14 @@ public:
  * will be prepended to firmware pathes before sending requests.
  * Interval at which requests are being sent is configurable, but the default value should cover the needs of
  * virtually all use cases (as always).
+ *
+ * Updating many nodes at once makes all of them read the firmware from the file server at the same time, which may
+ * starve the rest of the traffic on the bus. The number of nodes that are allowed to update concurrently can be
+ * limited, see @ref setMaxConcurrentUpdates(). A node occupies one slot since it has confirmed the request until it
+ * leaves the software update mode, restarts, or goes offline. Besides that, requests are not sent while the TX queue
+ * of any interface is more than half full or while the bus load is above the limit, see @ref setMaxBusLoad(), and
+ * the application can postpone them via @ref IFirmwareVersionChecker::canBeginFirmwareUpdate(). Pending nodes are
+ * requested in the order of their priority, @ref IFirmwareVersionChecker::getFirmwareUpdatePriority().
  */
 class FirmwareUpdateTrigger : public INodeInfoListener,
                               private TimerBase
@@ -144,29 +191,6 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
 
     enum { DefaultRequestIntervalMs = 1000 };   ///< Shall not be less than default service response timeout.
 
-    struct NextNodeIDSearchPredicate : ::uavcan::Noncopyable
-    {
-        enum { DefaultOutput = 0xFFU };
-
-        const FirmwareUpdateTrigger& owner;
-        uint8_t output;
-
-        NextNodeIDSearchPredicate(const FirmwareUpdateTrigger& arg_owner)
-            : owner(arg_owner)
-            , output(DefaultOutput)
-        { }
-
-        bool operator()(const NodeID node_id, const FirmwareFilePath&)
-        {
-            if (node_id.get() > owner.last_queried_node_id_ &&
-                !owner.begin_fw_update_client_.hasPendingCallToServer(node_id))
-            {
-                output = min(output, node_id.get());
-            }
-            return false;
-        }
-    };
-
     /*
      * State
      */
@@ -177,6 +201,10 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
     NodeInfoRetriever* node_info_retriever_;
 
     Map<NodeID, FirmwareFilePath> pending_nodes_;
+    NodeIDSet pending_node_ids_;        ///< Same keys as pending_nodes_, for the round-robin selection
+    NodeIDSet updating_node_ids_;       ///< Nodes that have confirmed the request and are still updating
+
+    uint8_t priorities_[NodeID::Max + 1];   ///< Indexed by node ID; valid for the pending nodes only
 
     MonotonicDuration request_interval_;
 
@@ -184,29 +212,37 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
 
     mutable uint8_t last_queried_node_id_;
 
+    uint8_t max_concurrent_updates_;
+
+    uint8_t max_bus_load_percent_;
+
     /*
      * Methods of INodeInfoListener
      */
     virtual void handleNodeInfoUnavailable(NodeID node_id)
     {
         UAVCAN_TRACE("FirmwareUpdateTrigger", "Node ID %d could not provide GetNodeInfo response", int(node_id.get()));
-        pending_nodes_.remove(node_id); // For extra paranoia
+        removePendingNode(node_id); // For extra paranoia
+        updating_node_ids_.remove(node_id);
     }
 
     virtual void handleNodeInfoRetrieved(const NodeID node_id, const protocol::GetNodeInfo::Response& node_info)
     {
+        updating_node_ids_.remove(node_id);     // The node has restarted, so it is not updating anymore
+
         FirmwareFilePath firmware_file_path;
         const bool update_needed = checker_.shouldRequestFirmwareUpdate(node_id, node_info, firmware_file_path);
         if (update_needed)
         {
             UAVCAN_TRACE("FirmwareUpdateTrigger", "Node ID %d requires update; file path: %s",
                          int(node_id.get()), firmware_file_path.c_str());
+            priorities_[node_id.get()] = checker_.getFirmwareUpdatePriority(node_id, node_info);
             trySetPendingNode(node_id, firmware_file_path);
         }
         else
         {
             UAVCAN_TRACE("FirmwareUpdateTrigger", "Node ID %d does not need update", int(node_id.get()));
-            pending_nodes_.remove(node_id);
+            removePendingNode(node_id);
         }
     }
 
@@ -214,9 +250,18 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
     {
         if (event.status.mode == protocol::NodeStatus::MODE_OFFLINE)
         {
-            pending_nodes_.remove(event.node_id);
+            removePendingNode(event.node_id);
+            updating_node_ids_.remove(event.node_id);
             UAVCAN_TRACE("FirmwareUpdateTrigger", "Node ID %d is offline hence forgotten", int(event.node_id.get()));
         }
+        else if (event.was_known &&
+                 (event.old_status.mode == protocol::NodeStatus::MODE_SOFTWARE_UPDATE) &&
+                 (event.status.mode != protocol::NodeStatus::MODE_SOFTWARE_UPDATE))
+        {
+            updating_node_ids_.remove(event.node_id);
+            UAVCAN_TRACE("FirmwareUpdateTrigger", "Node ID %d has left the software update mode",
+                         int(event.node_id.get()));
+        }
     }
 
     /*
@@ -224,10 +269,17 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
      */
     INode& getNode() { return begin_fw_update_client_.getNode(); }
 
+    void removePendingNode(const NodeID node_id)
+    {
+        pending_nodes_.remove(node_id);
+        pending_node_ids_.remove(node_id);
+    }
+
     void trySetPendingNode(const NodeID node_id, const FirmwareFilePath& path)
     {
         if (UAVCAN_NULLPTR != pending_nodes_.insert(node_id, path))
         {
+            pending_node_ids_.add(node_id);
             if (!TimerBase::isRunning())
             {
                 TimerBase::startPeriodic(request_interval_);
@@ -242,32 +294,19 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
 
     NodeID pickNextNodeID() const
     {
-        // We can't do index search because indices are unstable in Map<>
-        // First try - from the current node up
-        NextNodeIDSearchPredicate s1(*this);
-        (void)pending_nodes_.find<NextNodeIDSearchPredicate&>(s1);
-
-        if (s1.output != NextNodeIDSearchPredicate::DefaultOutput)
+        // The most urgent of the pending nodes; round-robin among equals, starting after the last queried one
+        NodeID node_id = pending_node_ids_.getNextCyclic(last_queried_node_id_);
+        const unsigned num_candidates = pending_node_ids_.getSize();
+        last_queried_node_id_ = 0;
+        for (unsigned i = 0; i < num_candidates; i++)
         {
-            last_queried_node_id_ = s1.output;
-        }
-        else if (last_queried_node_id_ != 0)
-        {
-            // Nothing was found, resetting the selector and trying again
-            UAVCAN_TRACE("FirmwareUpdateTrigger", "Node selector reset, last value: %d", int(last_queried_node_id_));
-            last_queried_node_id_ = 0;
-
-            NextNodeIDSearchPredicate s2(*this);
-            (void)pending_nodes_.find<NextNodeIDSearchPredicate&>(s2);
-
-            if (s2.output != NextNodeIDSearchPredicate::DefaultOutput)
+            UAVCAN_ASSERT(node_id.isUnicast());
+            if (!begin_fw_update_client_.hasPendingCallToServer(node_id) &&
+                ((last_queried_node_id_ == 0) || (priorities_[node_id.get()] < priorities_[last_queried_node_id_])))
             {
-                last_queried_node_id_ = s2.output;
+                last_queried_node_id_ = node_id.get();
             }
-        }
-        else
-        {
-            ; // Hopeless
+            node_id = pending_node_ids_.getNextCyclic(node_id);
         }
         UAVCAN_TRACE("FirmwareUpdateTrigger", "Next node ID to query: %d, pending nodes: %u, pending calls: %u",
                      int(last_queried_node_id_), pending_nodes_.getSize(),
@@ -299,7 +338,8 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
         {
             UAVCAN_TRACE("FirmwareUpdateTrigger", "Node %d confirmed the update request",
                          int(result.getCallID().server_node_id.get()));
-            pending_nodes_.remove(result.getCallID().server_node_id);
+            removePendingNode(result.getCallID().server_node_id);
+            updating_node_ids_.add(result.getCallID().server_node_id);
             checker_.handleFirmwareUpdateConfirmation(result.getCallID().server_node_id, result.getResponse());
         }
         else
@@ -315,9 +355,39 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
             {
                 UAVCAN_TRACE("FirmwareUpdateTrigger", "Node %d does not need retry",
                              int(result.getCallID().server_node_id.get()));
-                pending_nodes_.remove(result.getCallID().server_node_id);
+                removePendingNode(result.getCallID().server_node_id);
+            }
+        }
+    }
+
+    bool isTxQueueBusy()
+    {
+        const CanIOManager& canio = getNode().getDispatcher().getCanIOManager();
+        for (uint8_t i = 0; i < canio.getNumIfaces(); i++)
+        {
+            if ((canio.getTxQueueNumUsedBlocks(i) * 2U) > canio.getTxQueueQuota(i))
+            {
+                return true;
             }
         }
+        return false;
+    }
+
+    bool isBusBusy()
+    {
+        return (max_bus_load_percent_ > 0) &&
+               (getNode().getDispatcher().getCanIOManager().getMaxBusLoadPercent() >= max_bus_load_percent_);
+    }
+
+    bool isUpdateSlotAvailable() const
+    {
+        if (max_concurrent_updates_ == 0)
+        {
+            return true;
+        }
+        // A node that is being requested may confirm any moment, so it holds a slot too
+        return (updating_node_ids_.getSize() + begin_fw_update_client_.getNumPendingCalls()) <
+               max_concurrent_updates_;
     }
 
     virtual void handleTimerEvent(const TimerEvent&)
@@ -329,8 +399,15 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
             return;
         }
 
+        if (!isUpdateSlotAvailable() || isTxQueueBusy() || isBusBusy())
+        {
+            UAVCAN_TRACE("FirmwareUpdateTrigger", "Request postponed, updating nodes: %u",
+                         updating_node_ids_.getSize());
+            return;
+        }
+
         const NodeID node_id = pickNextNodeID();
-        if (!node_id.isUnicast())
+        if (!node_id.isUnicast() || !checker_.canBeginFirmwareUpdate(node_id))
         {
             return;
         }
@@ -366,7 +443,11 @@ public:
         , pending_nodes_(node.getAllocator())
         , request_interval_(MonotonicDuration::fromMSec(DefaultRequestIntervalMs))
         , last_queried_node_id_(0)
-    { }
+        , max_concurrent_updates_(0)
+        , max_bus_load_percent_(0)
+    {
+        fill(priorities_, priorities_ + NodeID::Max + 1, uint8_t(0));
+    }
 
     ~FirmwareUpdateTrigger()
     {
@@ -454,6 +535,27 @@ public:
         }
     }
 
+    /**
+     * Maximum number of nodes that are allowed to update their firmware at the same time.
+     * Zero means no limit, which is the default.
+     * Read the class documentation for details.
+     */
+    uint8_t getMaxConcurrentUpdates() const { return max_concurrent_updates_; }
+    void setMaxConcurrentUpdates(const uint8_t num) { max_concurrent_updates_ = num; }
+
+    /**
+     * Requests are postponed while the estimated load of any bus is at or above this limit, in percent;
+     * see @ref CanIOManager::getBusLoadPercent(). Zero, which is the default, disables the limit.
+     * Note that this only delays the requests; the firmware download traffic is generated by the updating nodes.
+     */
+    uint8_t getMaxBusLoad() const { return max_bus_load_percent_; }
+    void setMaxBusLoad(const uint8_t percent) { max_bus_load_percent_ = percent; }
+
+    /**
+     * Number of nodes that have confirmed the update request and have not finished updating yet.
+     */
+    unsigned getNumUpdatingNodes() const { return updating_node_ids_.getSize(); }
+
     /**
      * This method is mostly needed for testing.
      * When triggering is not in progress, the class consumes zero CPU time.
@@ -25,6 +25,9 @@ namespace uavcan
  * NOTE: In order for this class to work, the platform driver must implement
  *       CAN bus TX loopback with both UTC and monotonic timestamping.
  *
+ * A backup master can run in the hot standby mode, taking over once the active master goes silent,
+ * see @ref enableStandby().
+ *
  * Ref. M. Gergeleit, H. Streich - "Implementing a Distributed High-Resolution Real-Time Clock using the CAN-Bus"
  *
  * TODO: Enforce max one master per node
@@ -95,20 +98,68 @@ class UAVCAN_EXPORT GlobalTimeSyncMaster : protected LoopbackFrameListenerBase
         }
     };
 
+    typedef MethodBinder<GlobalTimeSyncMaster*,
+                         void (GlobalTimeSyncMaster::*)(const ReceivedDataStructure<protocol::GlobalTimeSync>&)>
+        GlobalTimeSyncCallback;
+
     INode& node_;
     LazyConstructor<IfaceMaster> iface_masters_[MaxCanIfaces];
     MonotonicTime prev_pub_mono_;
     DataTypeID dtid_;
     bool initialized_;
 
+    Subscriber<protocol::GlobalTimeSync, GlobalTimeSyncCallback> standby_sub_;
+    MonotonicTime active_master_last_seen_;
+    MonotonicDuration active_master_period_;    ///< Zero if not measured yet
+    MonotonicDuration takeover_timeout_;        ///< Zero if derived from the period
+    NodeID active_master_nid_;
+    bool standby_;
+
+    bool isOtherMasterActive(MonotonicTime current_time) const
+    {
+        return !active_master_last_seen_.isZero() &&
+               ((current_time - active_master_last_seen_) <= getTakeoverTimeout());
+    }
+
+    void handleGlobalTimeSync(const ReceivedDataStructure<protocol::GlobalTimeSync>& msg)
+    {
+        // Only the masters that are preferred by the slaves over this one are followed
+        if ((msg.getTransferType() != TransferTypeMessageBroadcast) || !(msg.getSrcNodeID() < node_.getNodeID()))
+        {
+            return;
+        }
+
+        const MonotonicTime ts = msg.getMonotonicTimestamp();
+        if (msg.getSrcNodeID() == active_master_nid_)
+        {
+            // The copies received via the redundant interfaces are too close to be taken for the period
+            const int64_t interval_ms = (ts - active_master_last_seen_).toMSec();
+            if ((interval_ms >= protocol::GlobalTimeSync::MIN_BROADCASTING_PERIOD_MS) &&
+                (interval_ms <= protocol::GlobalTimeSync::MAX_BROADCASTING_PERIOD_MS))
+            {
+                active_master_period_ = ts - active_master_last_seen_;
+            }
+        }
+        else if ((msg.getSrcNodeID() < active_master_nid_) || !isOtherMasterActive(ts))
+        {
+            UAVCAN_TRACE("GlobalTimeSyncMaster", "Following master %i", int(msg.getSrcNodeID().get()));
+            active_master_nid_ = msg.getSrcNodeID();
+            active_master_period_ = MonotonicDuration();
+        }
+        else
+        {
+            return;
+        }
+        active_master_last_seen_ = ts;
+    }
+
     virtual void handleLoopbackFrame(const RxFrame& frame)
     {
         const uint8_t iface = frame.getIfaceIndex();
         if (initialized_ && iface < MaxCanIfaces)
         {
-            if (frame.getDataTypeID() == dtid_ &&
-                frame.getTransferType() == TransferTypeMessageBroadcast &&
-                frame.isStartOfTransfer() && frame.isEndOfTransfer() &&
+            // The data type and the transfer type are checked by the dispatcher
+            if (frame.isStartOfTransfer() && frame.isEndOfTransfer() &&
                 frame.getSrcNodeID() == node_.getNodeID())
             {
                 iface_masters_[iface]->setTxTimestamp(frame.getUtcTimestamp());
@@ -144,6 +195,8 @@ public:
         : LoopbackFrameListenerBase(node.getDispatcher())
         , node_(node)
         , initialized_(false)
+        , standby_sub_(node)
+        , standby_(false)
     { }
 
     /**
@@ -186,7 +239,7 @@ public:
         initialized_ = res >= 0;
         if (initialized_)
         {
-            LoopbackFrameListenerBase::startListening();
+            LoopbackFrameListenerBase::startListening(dtid_, TransferTypeMessageBroadcast);
         }
         return res;
     }
@@ -218,6 +271,12 @@ public:
             }
         }
 
+        if (!isActive())
+        {
+            UAVCAN_TRACE("GlobalTimeSyncMaster", "Standing by for master %i", int(active_master_nid_.get()));
+            return 0;
+        }
+
         /*
          * Enforce max frequency
          */
@@ -255,6 +314,74 @@ public:
         }
         return 0;
     }
+
+    /**
+     * Enable or disable the hot standby mode.
+     *
+     * In the standby mode the master follows the sync messages of the masters that the slaves prefer over this
+     * one, i.e. of those with lower Node ID, and @ref publish() does nothing as long as any of them is active.
+     * Once it has been silent for the takeover timeout, this master takes over on the next call to publish(),
+     * which therefore shall be called at the normal rate in the standby mode as well.
+     *
+     * In order for the slaves to see no step when the master changes, the local clock must be synchronized with
+     * the active master by a @ref GlobalTimeSyncSlave, which must be suppressed while this master is active:
+     *
+     *      master.publish();
+     *      slave.suppress(master.isActive());
+     *
+     * The slaves switch to the new master without waiting for the broadcaster timeout if they are configured
+     * to, see @ref GlobalTimeSyncSlave::setMasterFailoverTimeout().
+     *
+     * The standby mode is disabled by default.
+     * Returns negative error code.
+     */
+    int enableStandby(bool enabled)
+    {
+        if (enabled && !standby_)
+        {
+            const int res =
+                standby_sub_.start(GlobalTimeSyncCallback(this, &GlobalTimeSyncMaster::handleGlobalTimeSync));
+            if (res < 0)
+            {
+                return res;
+            }
+        }
+        if (!enabled)
+        {
+            standby_sub_.stop();
+            active_master_last_seen_ = MonotonicTime();
+            active_master_period_ = MonotonicDuration();
+            active_master_nid_ = NodeID();
+        }
+        standby_ = enabled;
+        return 0;
+    }
+    bool isStandbyEnabled() const { return standby_; }
+
+    /**
+     * Whether the master publishes; false if it is in the standby mode and a preferred master is active.
+     */
+    bool isActive() const { return !standby_ || !isOtherMasterActive(node_.getMonotonicTime()); }
+
+    /**
+     * How long the preferred master must be silent for the standby master to take over.
+     * By default it is 2.5 broadcasting periods of the preferred master, as measured by the standby one, or
+     * @ref protocol::GlobalTimeSync::RECOMMENDED_BROADCASTER_TIMEOUT_MS if the period is not known yet.
+     * Zero restores the default.
+     */
+    MonotonicDuration getTakeoverTimeout() const
+    {
+        if (takeover_timeout_.isPositive())
+        {
+            return takeover_timeout_;
+        }
+        if (active_master_period_.isPositive())
+        {
+            return MonotonicDuration::fromUSec(active_master_period_.toUSec() * 5 / 2);
+        }
+        return MonotonicDuration::fromMSec(protocol::GlobalTimeSync::RECOMMENDED_BROADCASTER_TIMEOUT_MS);
+    }
+    void setTakeoverTimeout(MonotonicDuration timeout) { takeover_timeout_ = timeout; }
 };
 
 }
@@ -13,6 +13,115 @@
 
 namespace uavcan
 {
+/**
+ * Clock servo that turns the raw clock offsets measured by @ref GlobalTimeSyncSlave into clock adjustments,
+ * in order to suppress the jitter of the frame timestamps caused by the bus load:
+ *  - The offsets that are much larger than the average are considered outliers and are skipped, unless there
+ *    are several of them in a row;
+ *  - The offsets are fed into a proportional-integral loop, whose integral term tracks the rate difference
+ *    between the local clock and the master clock;
+ *  - Offsets larger than the step threshold, and the first offset after reset, are applied at once.
+ */
+class UAVCAN_EXPORT GlobalTimeSyncFilter
+{
+public:
+    struct Output
+    {
+        int64_t phase_usec;             ///< Phase correction; the whole offset if stepped
+        int64_t drift_usec;             ///< Rate correction accumulated over the interval, if applied as phase
+        float rate_ppm;                 ///< Rate correction, if the clock supports it
+        bool stepped;
+        bool rejected;                  ///< The offset is an outlier; nothing to apply
+
+        Output()
+            : phase_usec(0)
+            , drift_usec(0)
+            , rate_ppm(0.0F)
+            , stepped(false)
+            , rejected(false)
+        { }
+    };
+
+private:
+    float kp_;
+    float ki_;
+    float rate_;                        ///< Estimated rate difference, dimensionless
+    float jitter_usec_;                 ///< Average magnitude of the accepted offsets
+    uint32_t step_threshold_usec_;
+    uint32_t min_outlier_usec_;
+    uint32_t num_rejected_;
+    uint8_t outlier_factor_;
+    uint8_t max_consecutive_outliers_;
+    uint8_t num_consecutive_outliers_;
+    bool locked_;
+
+public:
+    GlobalTimeSyncFilter()
+        : kp_(0.2F)
+        , ki_(0.02F)
+        , rate_(0.0F)
+        , jitter_usec_(0.0F)
+        , step_threshold_usec_(10000)
+        , min_outlier_usec_(100)
+        , num_rejected_(0)
+        , outlier_factor_(4)
+        , max_consecutive_outliers_(3)
+        , num_consecutive_outliers_(0)
+        , locked_(false)
+    { }
+
+    /**
+     * Forgets the state; the next offset will be applied at once.
+     */
+    void reset()
+    {
+        rate_ = 0.0F;
+        jitter_usec_ = 0.0F;
+        num_consecutive_outliers_ = 0;
+        locked_ = false;
+    }
+
+    /**
+     * Processes the offset of the master clock relative to the local clock, measured the given time after the
+     * previous one.
+     */
+    Output update(int64_t offset_usec, MonotonicDuration interval);
+
+    /**
+     * Gains of the loop; both are dimensionless and must be in (0, 1].
+     * Lower values suppress more jitter but take longer to converge. Defaults are 0.2 and 0.02.
+     */
+    void setGains(float kp, float ki)
+    {
+        kp_ = kp;
+        ki_ = ki;
+    }
+    float getProportionalGain() const { return kp_; }
+    float getIntegralGain() const { return ki_; }
+
+    /**
+     * Offsets larger than this are applied at once, resetting the loop. Default is 10 ms.
+     */
+    void setStepThreshold(MonotonicDuration threshold) { step_threshold_usec_ = uint32_t(threshold.toUSec()); }
+
+    /**
+     * An offset is an outlier if it exceeds both the average magnitude of the accepted offsets multiplied by the
+     * factor and the minimum. No more than the given number of outliers in a row are skipped.
+     * Defaults are 4, 100 us and 3.
+     */
+    void setOutlierRejection(uint8_t factor, MonotonicDuration min_outlier, uint8_t max_consecutive_outliers)
+    {
+        outlier_factor_ = factor;
+        min_outlier_usec_ = uint32_t(min_outlier.toUSec());
+        max_consecutive_outliers_ = max_consecutive_outliers;
+    }
+
+    bool isLocked() const { return locked_; }
+    float getRateAdjustmentPPM() const { return rate_ * 1e6F; }
+    float getJitterUSec() const { return jitter_usec_; }
+    uint32_t getNumRejectedOffsets() const { return num_rejected_; }
+};
+
 /**
  * Please read the specs to learn how the time synchronization works.
  *
@@ -36,14 +145,34 @@ class UAVCAN_EXPORT GlobalTimeSyncSlave : Noncopyable
     UtcTime prev_ts_utc_;
     MonotonicTime prev_ts_mono_;
     MonotonicTime last_adjustment_ts_;
+    MonotonicTime last_master_msg_ts_;          ///< Any message of the current master
+    MonotonicDuration failover_timeout_;        ///< Zero if disabled
     enum State { Update, Adjust } state_;
     NodeID master_nid_;
     TransferID prev_tid_;
     uint8_t prev_iface_index_;
     bool suppressed_;
+    bool filter_enabled_;
+    GlobalTimeSyncFilter filter_;
 
     ISystemClock& getSystemClock() const { return sub_.getNode().getSystemClock(); }
 
+    void applyFiltered(UtcDuration adjustment, MonotonicTime ts)
+    {
+        const MonotonicDuration interval = last_adjustment_ts_.isZero() ?
+            MonotonicDuration::fromMSec(protocol::GlobalTimeSync::MAX_BROADCASTING_PERIOD_MS) :
+            (ts - last_adjustment_ts_);
+        const GlobalTimeSyncFilter::Output out = filter_.update(adjustment.toUSec(), interval);
+        if (out.rejected)
+        {
+            UAVCAN_TRACE("GlobalTimeSyncSlave", "Outlier rejected: usec=%lli",
+                         static_cast<long long>(adjustment.toUSec()));
+            return;
+        }
+        const bool rate_adjusted = getSystemClock().setUtcRateAdjustment(out.rate_ppm);
+        getSystemClock().adjustUtc(UtcDuration::fromUSec(out.phase_usec + (rate_adjusted ? 0 : out.drift_usec)));
+    }
+
     void adjustFromMsg(const ReceivedDataStructure<protocol::GlobalTimeSync>& msg)
     {
         UAVCAN_ASSERT(msg.previous_transmission_timestamp_usec > 0);
@@ -53,7 +182,15 @@ class UAVCAN_EXPORT GlobalTimeSyncSlave : Noncopyable
                      static_cast<long long>(adjustment.toUSec()),
                      int(msg.getSrcNodeID().get()), int(msg.getIfaceIndex()), int(suppressed_));
 
-        if (!suppressed_)
+        if (suppressed_)
+        {
+            ;
+        }
+        else if (filter_enabled_)
+        {
+            applyFiltered(adjustment, msg.getMonotonicTimestamp());
+        }
+        else
         {
             getSystemClock().adjustUtc(adjustment);
         }
@@ -83,11 +220,20 @@ class UAVCAN_EXPORT GlobalTimeSyncSlave : Noncopyable
         const bool switch_master = msg.getSrcNodeID() < master_nid_;
         // TODO: Make configurable
         const bool pub_timeout = since_prev_msg.toMSec() > protocol::GlobalTimeSync::RECOMMENDED_BROADCASTER_TIMEOUT_MS;
+        const bool master_lost = failover_timeout_.isPositive() && !needs_init &&
+                                 (msg.getSrcNodeID() != master_nid_) &&
+                                 ((msg.getMonotonicTimestamp() - last_master_msg_ts_) > failover_timeout_);
 
-        if (switch_master || pub_timeout || needs_init)
+        if (switch_master || pub_timeout || needs_init || master_lost)
         {
-            UAVCAN_TRACE("GlobalTimeSyncSlave", "Force update: needs_init=%i switch_master=%i pub_timeout=%i",
-                         int(needs_init), int(switch_master), int(pub_timeout));
+            UAVCAN_TRACE("GlobalTimeSyncSlave",
+                         "Force update: needs_init=%i switch_master=%i pub_timeout=%i master_lost=%i",
+                         int(needs_init), int(switch_master), int(pub_timeout), int(master_lost));
+            // The new master is expected to be a standby synchronized with the lost one, so the filter keeps going
+            if (!master_lost)
+            {
+                filter_.reset();
+            }
             updateFromMsg(msg);
         }
         else if (msg.getIfaceIndex() == prev_iface_index_ && msg.getSrcNodeID() == master_nid_)
@@ -119,6 +265,11 @@ class UAVCAN_EXPORT GlobalTimeSyncSlave : Noncopyable
             UAVCAN_TRACE("GlobalTimeSyncSlave", "Ignored: snid=%i iface=%i",
                          int(msg.getSrcNodeID().get()), int(msg.getIfaceIndex()));
         }
+
+        if (msg.getSrcNodeID() == master_nid_)
+        {
+            last_master_msg_ts_ = msg.getMonotonicTimestamp();
+        }
     }
 
     void handleGlobalTimeSync(const ReceivedDataStructure<protocol::GlobalTimeSync>& msg)
@@ -139,6 +290,7 @@ public:
         , state_(Update)
         , prev_iface_index_(0xFF)
         , suppressed_(false)
+        , filter_enabled_(false)
     { }
 
     /**
@@ -168,6 +320,45 @@ public:
     void suppress(bool suppressed) { suppressed_ = suppressed; }
     bool isSuppressed() const { return suppressed_; }
 
+    /**
+     * Enable or disable the filtering of the clock adjustments, see @ref GlobalTimeSyncFilter.
+     *
+     * By default, every measured offset is applied to the local clock as is, so the local clock inherits the
+     * jitter of the frame timestamps. With the filter, the local clock converges to the master clock gradually,
+     * and the rate difference between the clocks is compensated via @ref ISystemClock::setUtcRateAdjustment()
+     * if the clock supports it, or in steps otherwise.
+     *
+     * Filtering is disabled by default.
+     */
+    void enableFilter(bool enabled)
+    {
+        if (filter_enabled_ && !enabled)
+        {
+            (void)getSystemClock().setUtcRateAdjustment(0.0F);
+        }
+        filter_enabled_ = enabled;
+        filter_.reset();
+    }
+    bool isFilterEnabled() const { return filter_enabled_; }
+
+    /**
+     * Allows to configure the filter.
+     */
+    GlobalTimeSyncFilter& getFilter() { return filter_; }
+    const GlobalTimeSyncFilter& getFilter() const { return filter_; }
+
+    /**
+     * Makes the slave switch to another master once the current one has been silent for the given time, rather
+     * than after @ref protocol::GlobalTimeSync::RECOMMENDED_BROADCASTER_TIMEOUT_MS; a few broadcasting periods
+     * of the master is a sensible value. Unlike other master switches, this one keeps the state of the filter,
+     * so that the local clock sees no step if the new master is a hot standby of the lost one,
+     * see @ref GlobalTimeSyncMaster::enableStandby().
+     *
+     * Zero disables the fast failover; it is disabled by default.
+     */
+    void setMasterFailoverTimeout(MonotonicDuration timeout) { failover_timeout_ = timeout; }
+    MonotonicDuration getMasterFailoverTimeout() const { return failover_timeout_; }
+
     /**
      * If the clock sync slave sees any clock sync masters in the network, it is ACTIVE.
      * When the last master times out (PUBLISHER_TIMEOUT), the slave will be INACTIVE.
@@ -193,6 +384,43 @@ public:
     MonotonicTime getLastAdjustmentTime() const { return last_adjustment_ts_; }
 };
 
+// ----------------------------------------------------------------------------
+
+inline GlobalTimeSyncFilter::Output GlobalTimeSyncFilter::update(int64_t offset_usec, MonotonicDuration interval)
+{
+    Output out;
+    const uint64_t magnitude = uint64_t((offset_usec < 0) ? -offset_usec : offset_usec);
+
+    if (!locked_ || (magnitude >= step_threshold_usec_))
+    {
+        reset();
+        locked_ = true;
+        out.phase_usec = offset_usec;
+        out.stepped = true;
+        return out;
+    }
+
+    const float threshold = max(float(min_outlier_usec_), jitter_usec_ * float(outlier_factor_));
+    if ((float(magnitude) > threshold) && (num_consecutive_outliers_ < max_consecutive_outliers_))
+    {
+        num_consecutive_outliers_++;
+        num_rejected_++;
+        out.rejected = true;
+        return out;
+    }
+    num_consecutive_outliers_ = 0;
+    jitter_usec_ += (float(magnitude) - jitter_usec_) / 8.0F;
+
+    const float interval_usec = float(max<int64_t>(interval.toUSec(), 1));
+    const float offset = float(offset_usec);
+    rate_ += ki_ * offset / interval_usec;
+
+    out.phase_usec = int64_t(kp_ * offset);
+    out.drift_usec = int64_t(rate_ * interval_usec);
+    out.rate_ppm = getRateAdjustmentPPM();
+    return out;
+}
+
 }
 
 #endif // UAVCAN_PROTOCOL_GLOBAL_TIME_SYNC_SLAVE_HPP_INCLUDED
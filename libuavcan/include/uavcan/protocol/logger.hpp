@@ -10,7 +10,10 @@
 #include <uavcan/protocol/debug/LogMessage.hpp>
 #include <uavcan/marshal/char_array_formatter.hpp>
 #include <uavcan/node/publisher.hpp>
+#include <uavcan/node/timer.hpp>
+#include <uavcan/util/method_binder.hpp>
 #include <cstdlib>
+#include <cstring>
 
 #if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
 # error UAVCAN_CPP_VERSION
@@ -54,6 +57,13 @@ public:
  *  - Sink into the application via @ref ILogSink.
  *
  * For each sink an individual severity threshold filter can be configured.
+ *
+ * By default, the messages are broadcast immediately, so that a chatty application can flood the transmission
+ * queue with low-value frames and delay the more important ones. In that case the broadcasting can be buffered,
+ * see @ref enableBuffering(). The external sink is always invoked immediately.
+ *
+ * Formatting the text takes time. For logging from the time-critical code the formatting can be deferred until
+ * the message is actually delivered to the sinks, see @ref enableDeferredFormatting().
  */
 class UAVCAN_EXPORT Logger
 {
@@ -66,23 +76,416 @@ public:
      */
     static LogLevel getLogLevelAboveAll() { return (1U << protocol::debug::LogLevel::FieldTypes::value::BitLen) - 1U; }
 
+    /**
+     * Element of the buffer of the messages waiting to be broadcast, see @ref enableBuffering().
+     */
+    struct BufferEntry
+    {
+        protocol::debug::LogMessage message;
+        uint16_t num_repeats;           ///< Number of identical messages that followed this one
+    };
+
+    static MonotonicDuration getDefaultFlushPeriod() { return MonotonicDuration::fromMSec(100); }
+
+    /**
+     * Deferred records are at most that large, see @ref enableDeferredFormatting().
+     */
+    enum { MaxDeferredRecordSize = 128 };
+
 private:
     enum { DefaultTxTimeoutMs = 2000 };
 
+    /*
+     * Deferred record:
+     *  size (2), level (1), flags (1), number of arguments (1), format pointer, source length (1), source,
+     *  arguments: type tag (1) followed by the value; strings are stored as length (1) and characters.
+     */
+    enum { DeferredFlagBroadcast = 1, DeferredFlagSink = 2 };
+    enum { DeferredRecordHeaderSize = 5 + sizeof(const char*) + 1 };
+    enum
+    {
+        DeferredArgSigned,
+        DeferredArgUnsigned,
+        DeferredArgReal,
+        DeferredArgChar,
+        DeferredArgPointer,
+        DeferredArgString
+    };
+
+    typedef MethodBinder<Logger*, void (Logger::*)(const TimerEvent&)> TimerCallback;
+
     Publisher<protocol::debug::LogMessage> logmsg_pub_;
     protocol::debug::LogMessage msg_buf_;
     LogLevel level_;
     ILogSink* external_sink_;
 
+    BufferEntry* buffer_;
+    uint16_t buffer_capacity_;
+    uint16_t buffer_head_;              ///< Oldest entry
+    uint16_t buffer_size_;
+    uint16_t max_messages_per_flush_;
+    uint32_t num_dropped_messages_;
+    TimerEventForwarder<TimerCallback> flush_timer_;
+    MonotonicDuration flush_period_;
+
+    uint8_t* deferred_ring_;
+    uint16_t deferred_capacity_;
+    uint16_t deferred_head_;            ///< Offset of the oldest record
+    uint16_t deferred_size_;            ///< Bytes in use
+    uint16_t num_deferred_records_;
+    uint16_t max_records_per_deferred_flush_;
+
+    void handleTimerEvent(const TimerEvent&)
+    {
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+        (void)flushDeferred(max_records_per_deferred_flush_);
+#endif
+        (void)flush(max_messages_per_flush_);
+        if ((buffer_size_ == 0) && (num_deferred_records_ == 0))
+        {
+            flush_timer_.stop();
+        }
+    }
+
+    void startFlushTimer()
+    {
+        if (!flush_timer_.isRunning())
+        {
+            flush_timer_.startPeriodic(flush_period_);
+        }
+    }
+
+    void enqueue(const protocol::debug::LogMessage& message)
+    {
+        if (buffer_size_ > 0)
+        {
+            BufferEntry& newest = buffer_[(buffer_head_ + buffer_size_ - 1U) % buffer_capacity_];
+            if (newest.message == message)
+            {
+                if (newest.num_repeats < 0xFFFFU)
+                {
+                    newest.num_repeats++;
+                }
+                return;
+            }
+        }
+
+        if (buffer_size_ >= buffer_capacity_)
+        {
+            buffer_head_ = uint16_t((buffer_head_ + 1U) % buffer_capacity_);   // Overwriting the oldest one
+            buffer_size_--;
+            num_dropped_messages_++;
+        }
+
+        BufferEntry& entry = buffer_[(buffer_head_ + buffer_size_) % buffer_capacity_];
+        entry.message = message;
+        entry.num_repeats = 0;
+        buffer_size_++;
+
+        startFlushTimer();
+    }
+
     LogLevel getExternalSinkLevel() const
     {
         return (external_sink_ == UAVCAN_NULLPTR) ? getLogLevelAboveAll() : external_sink_->getLogLevel();
     }
 
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+    /**
+     * Encodes the arguments of a deferred record. The arguments are classified the same way as by
+     * @ref CharArrayFormatter, so that the deferred output is identical to the immediate one.
+     * The arguments that don't fit into the record are dropped.
+     */
+    class DeferredRecordWriter
+    {
+        uint8_t* const record_;
+        unsigned size_;
+        unsigned num_args_;
+        bool full_;
+
+        template <typename T>
+        void add(uint8_t tag, const T& value)
+        {
+            if (full_ || ((size_ + 1U + sizeof(T)) > MaxDeferredRecordSize))
+            {
+                full_ = true;
+                return;
+            }
+            record_[size_++] = tag;
+            (void)std::memcpy(record_ + size_, &value, sizeof(T));
+            size_ += unsigned(sizeof(T));
+            num_args_++;
+        }
+
+        template <typename T>
+        typename std::enable_if<std::is_floating_point<T>::value>::type
+        write(T value)
+        {
+            add(DeferredArgReal, double(value));
+        }
+
+        template <typename T>
+        typename std::enable_if<std::is_integral<T>::value>::type
+        write(T value)
+        {
+            if (std::is_same<T, char>())
+            {
+                add(DeferredArgChar, char(value));
+            }
+            else if (std::is_signed<T>())
+            {
+                add(DeferredArgSigned, static_cast<long long>(value));
+            }
+            else
+            {
+                add(DeferredArgUnsigned, static_cast<unsigned long long>(value));
+            }
+        }
+
+        template <typename T>
+        typename std::enable_if<std::is_pointer<T>::value && !std::is_same<T, const char*>::value>::type
+        write(T value)
+        {
+            add(DeferredArgPointer, static_cast<const void*>(value));
+        }
+
+        void write(const char* value)
+        {
+            if (full_ || ((size_ + 2U) > MaxDeferredRecordSize))
+            {
+                full_ = true;
+                return;
+            }
+            // The string is copied because it may not outlive the call; it is truncated to the free space
+            const unsigned len = (value == UAVCAN_NULLPTR) ? 0U : unsigned(std::strlen(value));
+            const unsigned copied_len = min(len, unsigned(MaxDeferredRecordSize) - size_ - 2U);
+            record_[size_++] = DeferredArgString;
+            record_[size_++] = uint8_t(copied_len);
+            if (copied_len > 0)
+            {
+                (void)std::memcpy(record_ + size_, value, copied_len);
+            }
+            size_ += copied_len;
+            num_args_++;
+        }
+
+    public:
+        DeferredRecordWriter(uint8_t* record, unsigned header_size)
+            : record_(record)
+            , size_(header_size)
+            , num_args_(0)
+            , full_(false)
+        { }
+
+        void writeAll() { }
+
+        template <typename T, typename... Args>
+        void writeAll(T value, Args... args)
+        {
+            write(value);
+            writeAll(args...);
+        }
+
+        unsigned getSize() const { return size_; }
+        unsigned getNumArgs() const { return num_args_; }
+    };
+
+    template <typename... Args>
+    void logDeferred(LogLevel level, const char* source, const char* format, Args... args);
+
+    void copyToDeferredRing(unsigned offset, const uint8_t* data, unsigned size)
+    {
+        offset %= deferred_capacity_;
+        const unsigned first_part = min(size, deferred_capacity_ - offset);
+        (void)std::memcpy(deferred_ring_ + offset, data, first_part);
+        (void)std::memcpy(deferred_ring_, data + first_part, size - first_part);
+    }
+
+    void copyFromDeferredRing(unsigned offset, uint8_t* data, unsigned size) const
+    {
+        offset %= deferred_capacity_;
+        const unsigned first_part = min(size, deferred_capacity_ - offset);
+        (void)std::memcpy(data, deferred_ring_ + offset, first_part);
+        (void)std::memcpy(data + first_part, deferred_ring_, size - first_part);
+    }
+
+    uint16_t getOldestDeferredRecordSize() const
+    {
+        uint8_t buf[2] = { 0, 0 };
+        copyFromDeferredRing(deferred_head_, buf, 2);
+        uint16_t size = 0;
+        (void)std::memcpy(&size, buf, 2);
+        UAVCAN_ASSERT((size <= deferred_size_) && (size <= MaxDeferredRecordSize));
+        return size;
+    }
+
+    void removeOldestDeferredRecord(uint16_t size)
+    {
+        deferred_head_ = uint16_t((deferred_head_ + size) % deferred_capacity_);
+        deferred_size_ = uint16_t(deferred_size_ - size);
+        num_deferred_records_--;
+    }
+
+    void pushDeferredRecord(uint8_t* record, unsigned size)
+    {
+        UAVCAN_ASSERT(size <= MaxDeferredRecordSize);
+        const uint16_t size16 = uint16_t(size);
+        (void)std::memcpy(record, &size16, 2);
+
+        while (unsigned(deferred_capacity_ - deferred_size_) < size)
+        {
+            removeOldestDeferredRecord(getOldestDeferredRecordSize());  // Overwriting the oldest one
+            num_dropped_messages_++;
+        }
+
+        copyToDeferredRing(deferred_head_ + deferred_size_, record, size);
+        deferred_size_ = uint16_t(deferred_size_ + size);
+        num_deferred_records_++;
+
+        startFlushTimer();
+    }
+
+    /**
+     * Replicates @ref CharArrayFormatter::write() with the arguments taken from the record.
+     */
+    void formatDeferredText(const char* s, const uint8_t* args, unsigned num_args)
+    {
+        CharArrayFormatter<typename protocol::debug::LogMessage::FieldTypes::text> formatter(msg_buf_.text);
+        while (s && *s)
+        {
+            if (num_args == 0)
+            {
+                formatter.write(s);     // Insufficient arguments - the rest is written as is
+                break;
+            }
+            if (*s == '%')
+            {
+                s += 1;
+                if (*s != '%')
+                {
+                    args = writeDeferredArgument(formatter, args);
+                    num_args--;
+                    if (*s != '\0')
+                    {
+                        s++;
+                    }
+                    continue;
+                }
+            }
+            formatter.writeArgument(*s++);
+        }
+    }
+
+    template <typename Formatter>
+    static const uint8_t* writeDeferredArgument(Formatter& formatter, const uint8_t* arg)
+    {
+        const uint8_t tag = *arg++;
+        switch (tag)
+        {
+        case DeferredArgSigned:
+        {
+            long long x = 0;
+            (void)std::memcpy(&x, arg, sizeof(x));
+            formatter.writeArgument(x);
+            return arg + sizeof(x);
+        }
+        case DeferredArgUnsigned:
+        {
+            unsigned long long x = 0;
+            (void)std::memcpy(&x, arg, sizeof(x));
+            formatter.writeArgument(x);
+            return arg + sizeof(x);
+        }
+        case DeferredArgReal:
+        {
+            double x = 0.0;
+            (void)std::memcpy(&x, arg, sizeof(x));
+            formatter.writeArgument(x);
+            return arg + sizeof(x);
+        }
+        case DeferredArgChar:
+        {
+            formatter.writeArgument(char(*arg));
+            return arg + 1;
+        }
+        case DeferredArgPointer:
+        {
+            const void* x = UAVCAN_NULLPTR;
+            (void)std::memcpy(&x, arg, sizeof(x));
+            formatter.writeArgument(x);
+            return arg + sizeof(x);
+        }
+        case DeferredArgString:
+        {
+            const unsigned len = *arg++;
+            for (unsigned i = 0; i < len; i++)
+            {
+                formatter.writeArgument(char(arg[i]));
+            }
+            return arg + len;
+        }
+        default:
+        {
+            UAVCAN_ASSERT(0);
+            return arg;
+        }
+        }
+    }
+
+    void emitDeferredRecord(const uint8_t* record)
+    {
+        const uint8_t flags = record[3];
+        const unsigned num_args = record[4];
+        const char* format = UAVCAN_NULLPTR;
+        (void)std::memcpy(&format, record + 5, sizeof(format));
+
+        const uint8_t* p = record + DeferredRecordHeaderSize - 1;
+        const unsigned source_len = *p++;
+        msg_buf_.level.value = record[2];
+        msg_buf_.source.clear();
+        for (unsigned i = 0; i < source_len; i++)
+        {
+            msg_buf_.source.push_back(*p++);
+        }
+        msg_buf_.text.clear();
+        formatDeferredText(format, p, num_args);
+
+        if (((flags & DeferredFlagSink) != 0) && (external_sink_ != UAVCAN_NULLPTR))
+        {
+            external_sink_->log(msg_buf_);
+        }
+        if ((flags & DeferredFlagBroadcast) != 0)
+        {
+            if (buffer_ != UAVCAN_NULLPTR)
+            {
+                enqueue(msg_buf_);
+            }
+            else
+            {
+                (void)logmsg_pub_.broadcast(msg_buf_);
+            }
+        }
+    }
+#endif
+
 public:
     explicit Logger(INode& node)
         : logmsg_pub_(node)
         , external_sink_(UAVCAN_NULLPTR)
+        , buffer_(UAVCAN_NULLPTR)
+        , buffer_capacity_(0)
+        , buffer_head_(0)
+        , buffer_size_(0)
+        , max_messages_per_flush_(1)
+        , num_dropped_messages_(0)
+        , flush_timer_(node, TimerCallback(this, &Logger::handleTimerEvent))
+        , flush_period_(getDefaultFlushPeriod())
+        , deferred_ring_(UAVCAN_NULLPTR)
+        , deferred_capacity_(0)
+        , deferred_head_(0)
+        , deferred_size_(0)
+        , num_deferred_records_(0)
+        , max_records_per_deferred_flush_(1)
     {
         level_ = protocol::debug::LogLevel::ERROR;
         setTxTimeout(MonotonicDuration::fromMSec(DefaultTxTimeoutMs));
@@ -124,11 +527,174 @@ public:
         }
         if (message.level.value >= level_)
         {
-            retval = logmsg_pub_.broadcast(message);
+            if (buffer_ != UAVCAN_NULLPTR)
+            {
+                enqueue(message);
+            }
+            else
+            {
+                retval = logmsg_pub_.broadcast(message);
+            }
         }
         return retval;
     }
 
+    /**
+     * Makes the logger store the messages to be broadcast in the given buffer instead of broadcasting them
+     * immediately. The buffered messages are broadcast from a timer, at most the given number of messages per
+     * period, oldest first. A message that is identical to the preceding one is not stored again; instead, it is
+     * counted, and the count is broadcast after the message as a separate message "Last message repeated N times".
+     * When the buffer is full, the oldest message is discarded, see @ref getNumDroppedMessages().
+     *
+     * The buffer must stay valid until the buffering is disabled.
+     * Returns negative error code.
+     */
+    int enableBuffering(BufferEntry* buffer, unsigned capacity,
+                        MonotonicDuration flush_period = getDefaultFlushPeriod(),
+                        unsigned max_messages_per_flush = 1)
+    {
+        if ((buffer == UAVCAN_NULLPTR) || (capacity == 0) || (capacity > 0xFFFFU) ||
+            (max_messages_per_flush == 0) || (max_messages_per_flush > 0xFFFFU) || !flush_period.isPositive())
+        {
+            return -ErrInvalidParam;
+        }
+        disableBuffering();
+        buffer_ = buffer;
+        buffer_capacity_ = uint16_t(capacity);
+        max_messages_per_flush_ = uint16_t(max_messages_per_flush);
+        flush_period_ = flush_period;
+        return 0;
+    }
+
+    /**
+     * Makes the logger broadcast the messages immediately again. The messages that are still buffered are lost.
+     */
+    void disableBuffering()
+    {
+        if (num_deferred_records_ == 0)
+        {
+            flush_timer_.stop();
+        }
+        buffer_ = UAVCAN_NULLPTR;
+        buffer_capacity_ = 0;
+        buffer_head_ = 0;
+        buffer_size_ = 0;
+    }
+
+    bool isBufferingEnabled() const { return buffer_ != UAVCAN_NULLPTR; }
+
+    /**
+     * Broadcasts up to the given number of buffered messages right away, e.g. before a reboot.
+     * Zero means all of them. The repetition notices are not counted against the limit.
+     * Returns the number of messages taken from the buffer.
+     */
+    unsigned flush(unsigned max_messages = 0)
+    {
+        unsigned num_taken = 0;
+        while ((buffer_size_ > 0) && ((max_messages == 0) || (num_taken < max_messages)))
+        {
+            BufferEntry& entry = buffer_[buffer_head_];
+            buffer_head_ = uint16_t((buffer_head_ + 1U) % buffer_capacity_);
+            buffer_size_--;
+            num_taken++;
+
+            (void)logmsg_pub_.broadcast(entry.message);
+            if (entry.num_repeats > 0)
+            {
+                entry.message.text = "Last message repeated ";
+                entry.message.text.appendFormatted("%u", unsigned(entry.num_repeats));
+                entry.message.text += " times";
+                (void)logmsg_pub_.broadcast(entry.message);
+            }
+        }
+        return num_taken;
+    }
+
+    /**
+     * Number of buffered messages waiting to be broadcast.
+     */
+    unsigned getNumBufferedMessages() const { return buffer_size_; }
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+    /**
+     * Makes the logging methods with formatting (@ref logDebug() etc) store the format string and the arguments in
+     * the given ring instead of formatting the text right away, which makes logging from the hot code paths cheap.
+     * The records are formatted and delivered to the external sink and/or to the bus from a timer, at most the given
+     * number of records per period, oldest first; the period is shared with @ref enableBuffering(), which can be
+     * used together with this mode. The severity filters are applied when the record is stored.
+     * When the ring is full, the oldest records are discarded, see @ref getNumDroppedMessages().
+     *
+     * The format strings must have static storage duration, e.g. be string literals; the source names and the
+     * string arguments are copied. The arguments that don't fit into @ref MaxDeferredRecordSize are dropped.
+     *
+     * The ring must be at least @ref MaxDeferredRecordSize bytes large and stay valid until this mode is disabled.
+     * Returns negative error code.
+     */
+    int enableDeferredFormatting(uint8_t* ring, unsigned size_bytes,
+                                 MonotonicDuration flush_period = getDefaultFlushPeriod(),
+                                 unsigned max_records_per_flush = 1)
+    {
+        if ((ring == UAVCAN_NULLPTR) || (size_bytes < MaxDeferredRecordSize) || (size_bytes > 0xFFFFU) ||
+            (max_records_per_flush == 0) || (max_records_per_flush > 0xFFFFU) || !flush_period.isPositive())
+        {
+            return -ErrInvalidParam;
+        }
+        disableDeferredFormatting();
+        deferred_ring_ = ring;
+        deferred_capacity_ = uint16_t(size_bytes);
+        max_records_per_deferred_flush_ = uint16_t(max_records_per_flush);
+        flush_period_ = flush_period;
+        return 0;
+    }
+
+    /**
+     * Makes the logger format the messages immediately again. The records that are still in the ring are lost.
+     */
+    void disableDeferredFormatting()
+    {
+        if (buffer_size_ == 0)
+        {
+            flush_timer_.stop();
+        }
+        deferred_ring_ = UAVCAN_NULLPTR;
+        deferred_capacity_ = 0;
+        deferred_head_ = 0;
+        deferred_size_ = 0;
+        num_deferred_records_ = 0;
+    }
+
+    bool isDeferredFormattingEnabled() const { return deferred_ring_ != UAVCAN_NULLPTR; }
+
+    /**
+     * Formats and delivers up to the given number of deferred records right away; zero means all of them.
+     * Returns the number of records taken from the ring.
+     */
+    unsigned flushDeferred(unsigned max_records = 0)
+    {
+        unsigned num_taken = 0;
+        while ((num_deferred_records_ > 0) && ((max_records == 0) || (num_taken < max_records)))
+        {
+            uint8_t record[MaxDeferredRecordSize];
+            const uint16_t size = getOldestDeferredRecordSize();
+            copyFromDeferredRing(deferred_head_, record, size);
+            removeOldestDeferredRecord(size);
+            num_taken++;
+            emitDeferredRecord(record);
+        }
+        return num_taken;
+    }
+#endif
+
+    /**
+     * Number of deferred records waiting to be formatted.
+     */
+    unsigned getNumDeferredRecords() const { return num_deferred_records_; }
+
+    /**
+     * Number of messages that have been discarded because the buffer or the ring of deferred records was full.
+     */
+    uint32_t getNumDroppedMessages() const { return num_dropped_messages_; }
+
     /**
      * Severity filter for UAVCAN broadcasting.
      * Log message will be broadcasted via the UAVCAN network only if its severity is >= getLevel().
@@ -262,6 +828,11 @@ int Logger::log(LogLevel level, const char* source, const char* format, Args...
     {
         if (level >= level_ || level >= getExternalSinkLevel())
         {
+            if (deferred_ring_ != UAVCAN_NULLPTR)
+            {
+                logDeferred(level, source, format, args...);
+                return 0;
+            }
             msg_buf_.level.value = level;
             msg_buf_.source = source;
             msg_buf_.text.clear();
@@ -279,6 +850,30 @@ int Logger::log(LogLevel level, const char* source, const char* format, Args...
 #endif
 }
 
+template <typename... Args>
+void Logger::logDeferred(LogLevel level, const char* source, const char* format, Args... args)
+{
+    uint8_t record[MaxDeferredRecordSize];
+    record[2] = uint8_t(level);
+    record[3] = uint8_t(((level >= level_) ? unsigned(DeferredFlagBroadcast) : 0U) |
+                        ((level >= getExternalSinkLevel()) ? unsigned(DeferredFlagSink) : 0U));
+    (void)std::memcpy(record + 5, &format, sizeof(format));
+
+    const unsigned source_len = (source == UAVCAN_NULLPTR) ? 0U :
+                                min(unsigned(std::strlen(source)), unsigned(msg_buf_.source.capacity()));
+    record[DeferredRecordHeaderSize - 1] = uint8_t(source_len);
+    if (source_len > 0)
+    {
+        (void)std::memcpy(record + DeferredRecordHeaderSize, source, source_len);
+    }
+
+    DeferredRecordWriter writer(record, DeferredRecordHeaderSize + source_len);
+    writer.writeAll(args...);
+    record[4] = uint8_t(writer.getNumArgs());
+
+    pushDeferredRecord(record, writer.getSize());
+}
+
 #endif
 
 }
@@ -35,6 +35,14 @@ public:
      */
     virtual void handleNodeInfoUnavailable(NodeID node_id) = 0;
 
+    /**
+     * Called once after a batch of @ref handleNodeInfoRetrieved() and @ref handleNodeInfoUnavailable() calls,
+     * at most once per request interval. Consumers that index the whole fleet can update the index here once,
+     * rather than on every node.
+     * Default implementation does nothing.
+     */
+    virtual void handleNodeInfoBatchComplete() { }
+
     /**
      * This call is routed directly from @ref NodeStatusMonitor.
      * Default implementation does nothing.
@@ -58,6 +66,31 @@ public:
     virtual ~INodeInfoListener() { }
 };
 
+/**
+ * Persistent storage of the GetNodeInfo responses for @ref NodeInfoRetriever, so that a gateway that restarts
+ * doesn't have to re-query every node of the bus. The responses are stored together with the UTC time of retrieval;
+ * see the POSIX driver for a file based implementation.
+ * The methods are invoked from the node thread; they may block, but not for long.
+ */
+class UAVCAN_EXPORT INodeInfoCache
+{
+public:
+    /**
+     * Returns false if there's no entry for the node.
+     */
+    virtual bool load(NodeID node_id, protocol::GetNodeInfo::Response& out_node_info,
+                      UtcTime& out_retrieval_time) = 0;
+
+    /**
+     * Replaces the entry of the node. Errors are not reported, the entry will be retrieved again next time.
+     */
+    virtual void store(NodeID node_id, const protocol::GetNodeInfo::Response& node_info, UtcTime retrieval_time) = 0;
+
+    virtual void remove(NodeID node_id) = 0;
+
+    virtual ~INodeInfoCache() { }
+};
+
 /**
  * This class automatically retrieves a response to GetNodeInfo once a node appears online or restarts.
  * It does a number of attempts in case if there's a communication failure before assuming that the node does not
@@ -86,6 +119,19 @@ public:
  *
  * Note that all nodes are queried in a round-robin fashion, regardless of their uptime, number of requests made, etc.
  *
+ * On a bus with many nodes that do respond, one request per interval is the bottleneck. The retriever can be allowed
+ * to keep several requests in flight, see @ref setMaxConcurrentRequests(); every interval it then issues requests
+ * until that many are pending. The extra requests are held back while the TX queue of any interface is more than
+ * half full, so that the discovery traffic doesn't crowd out the rest of the application. Likewise, the retriever
+ * can be made to pause while the bus load is high, see @ref setMaxBusLoad().
+ *
+ * With a cache installed (@ref setCache()), a node that appears online is not queried if its cached response shows
+ * that it has not restarted since the response was retrieved: its uptime now must be the cached uptime plus the UTC
+ * time elapsed since, give or take a few seconds of clock drift. The listeners are then fed the cached response as
+ * if it was just received. A different device that took over the node ID with a longer uptime would be mistaken for
+ * the cached one; this is unlikely, and the unique ID is corrected on the next restart of either. A node that is
+ * actually queried replaces its cache entry. The UTC time must be valid, otherwise the cache is never hit.
+ *
  * Events from this class can be routed to many listeners, @ref INodeInfoListener.
  */
 class UAVCAN_EXPORT NodeInfoRetriever : public NodeStatusMonitor
@@ -94,6 +140,7 @@ class UAVCAN_EXPORT NodeInfoRetriever : public NodeStatusMonitor
 public:
     enum { MaxNumRequestAttempts = 254 };
     enum { UnlimitedRequestAttempts = 0 };
+    enum { MaxConcurrentRequests = 32 };
 
 private:
     typedef MethodBinder<NodeInfoRetriever*,
@@ -104,14 +151,14 @@ private:
     {
         uint32_t uptime_sec;
         uint8_t num_attempts_made;
-        bool request_needed;                    ///< Always false for unknown nodes
         bool updated_since_last_attempt;        ///< Always false for unknown nodes
+        bool cache_checked;                     ///< The cache is only consulted once the node appears online
 
         Entry()
             : uptime_sec(0)
             , num_attempts_made(0)
-            , request_needed(false)
             , updated_since_last_attempt(false)
+            , cache_checked(false)
         {
 #if UAVCAN_DEBUG
             StaticAssert<sizeof(Entry) <= 8>::check();
@@ -156,14 +203,27 @@ private:
         }
     };
 
+    struct BatchCompleteHandlerCaller
+    {
+        bool operator()(INodeInfoListener* key)
+        {
+            UAVCAN_ASSERT(key != UAVCAN_NULLPTR);
+            key->handleNodeInfoBatchComplete();
+            return false;
+        }
+    };
+
     enum { DefaultNumRequestAttempts = 16 };
     enum { DefaultTimerIntervalMSec = 40 };  ///< Read explanation in the class documentation
+    enum { CacheUptimeToleranceSec = 2 };    ///< Plus 0.1% of the time elapsed since the retrieval
 
     /*
      * State
      */
     Entry entries_[NodeID::Max];  // [1, NodeID::Max]
 
+    NodeIDSet nodes_to_query_;    ///< Nodes that need the request; never contains unknown nodes
+
     Multiset<INodeInfoListener*> listeners_;
 
     ServiceClient<protocol::GetNodeInfo, GetNodeInfoResponseCallback> get_node_info_client_;
@@ -174,6 +234,14 @@ private:
 
     uint8_t num_attempts_;
 
+    uint8_t max_concurrent_requests_;
+    uint8_t max_bus_load_percent_;
+
+    bool batch_complete_notification_pending_;
+
+    INodeInfoCache* cache_;
+    uint32_t num_cache_hits_;
+
     /*
      * Methods
      */
@@ -198,58 +266,149 @@ private:
 
     NodeID pickNextNodeToQuery(bool& out_at_least_one_request_needed) const
     {
-        out_at_least_one_request_needed = false;
+        out_at_least_one_request_needed = !nodes_to_query_.isEmpty();
 
-        for (unsigned iter_cnt_ = 0; iter_cnt_ < (sizeof(entries_) / sizeof(entries_[0])); iter_cnt_++) // Round-robin
+        // Round-robin over the nodes that need the request only, the rest of the node ID space is skipped
+        const unsigned num_candidates = nodes_to_query_.getSize();
+        for (unsigned iter_cnt_ = 0; iter_cnt_ < num_candidates; iter_cnt_++)
         {
-            last_picked_node_++;
-            if (last_picked_node_ > NodeID::Max)
+            const NodeID nid = nodes_to_query_.getNextCyclic(last_picked_node_);
+            UAVCAN_ASSERT(nid.isUnicast());
+            last_picked_node_ = nid.get();
+
+            if (getEntry(nid).updated_since_last_attempt &&
+                !get_node_info_client_.hasPendingCallToServer(nid))
             {
-                last_picked_node_ = 1;
+                UAVCAN_TRACE("NodeInfoRetriever", "Next node to query: %d", int(last_picked_node_));
+                return nid;
             }
-            UAVCAN_ASSERT((last_picked_node_ >= 1) &&
-                          (last_picked_node_ <= NodeID::Max));
+        }
 
-            const Entry& entry = getEntry(last_picked_node_);
+        return NodeID();        // No node could be found
+    }
 
-            if (entry.request_needed)
+    bool isTxQueueBusy() const
+    {
+        const CanIOManager& canio = get_node_info_client_.getNode().getDispatcher().getCanIOManager();
+        for (uint8_t i = 0; i < canio.getNumIfaces(); i++)
+        {
+            if ((canio.getTxQueueNumUsedBlocks(i) * 2U) > canio.getTxQueueQuota(i))
             {
-                out_at_least_one_request_needed = true;
-
-                if (entry.updated_since_last_attempt &&
-                    !get_node_info_client_.hasPendingCallToServer(last_picked_node_))
-                {
-                    UAVCAN_TRACE("NodeInfoRetriever", "Next node to query: %d", int(last_picked_node_));
-                    return NodeID(last_picked_node_);
-                }
+                return true;
             }
         }
+        return false;
+    }
 
-        return NodeID();        // No node could be found
+    bool isBusBusy() const
+    {
+        return (max_bus_load_percent_ > 0) &&
+               (get_node_info_client_.getNode().getDispatcher().getCanIOManager().getMaxBusLoadPercent() >=
+                max_bus_load_percent_);
+    }
+
+    void scheduleBatchCompleteNotification()
+    {
+        batch_complete_notification_pending_ = true;
+        startTimerIfNotRunning();       // The notification will be delivered from the next timer event
+    }
+
+    void notifyBatchCompleteIfPending()
+    {
+        if (batch_complete_notification_pending_)
+        {
+            batch_complete_notification_pending_ = false;
+            listeners_.forEach(BatchCompleteHandlerCaller());
+        }
+    }
+
+    /**
+     * Returns true if the node has been served from the cache.
+     */
+    bool tryCache(NodeID node_id)
+    {
+        Entry& entry = getEntry(node_id);
+        if ((cache_ == UAVCAN_NULLPTR) || entry.cache_checked)
+        {
+            return false;
+        }
+        entry.cache_checked = true;
+
+        protocol::GetNodeInfo::Response node_info;
+        UtcTime retrieval_time;
+        if (!cache_->load(node_id, node_info, retrieval_time))
+        {
+            return false;
+        }
+
+        const UtcTime now = get_node_info_client_.getNode().getUtcTime();
+        if (now.isZero() || retrieval_time.isZero() || (now < retrieval_time))
+        {
+            return false;
+        }
+        const uint64_t elapsed_sec = uint64_t((now - retrieval_time).toMSec() / 1000);
+        const uint64_t expected_uptime_sec = node_info.status.uptime_sec + elapsed_sec;
+        const uint64_t tolerance_sec = CacheUptimeToleranceSec + elapsed_sec / 1000U;
+
+        if ((entry.uptime_sec < node_info.status.uptime_sec) ||
+            ((uint64_t(entry.uptime_sec) + tolerance_sec) < expected_uptime_sec))
+        {
+            UAVCAN_TRACE("NodeInfoRetriever", "Cache entry of node %d is stale", int(node_id.get()));
+            return false;
+        }
+
+        UAVCAN_TRACE("NodeInfoRetriever", "Node %d served from the cache", int(node_id.get()));
+        num_cache_hits_++;
+        entry.num_attempts_made = 0;
+        nodes_to_query_.remove(node_id);
+        listeners_.forEach(NodeInfoRetrievedHandlerCaller(node_id, node_info));
+        scheduleBatchCompleteNotification();
+        return true;
     }
 
     virtual void handleTimerEvent(const TimerEvent&)
     {
+        notifyBatchCompleteIfPending();
+
+        if (isBusBusy())
+        {
+            UAVCAN_TRACE("NodeInfoRetriever", "Requests postponed, bus load is too high");
+            return;                     // The timer keeps running, so the requests are resumed once the load drops
+        }
+
         bool at_least_one_request_needed = false;
-        const NodeID next = pickNextNodeToQuery(at_least_one_request_needed);
+        unsigned num_sent = 0;
 
-        if (next.isUnicast())
+        // The first request of the interval goes out regardless of the number of pending ones and the TX queue
+        while ((num_sent == 0) ||
+               ((get_node_info_client_.getNumPendingCalls() < max_concurrent_requests_) && !isTxQueueBusy()))
         {
+            const NodeID next = pickNextNodeToQuery(at_least_one_request_needed);
+            if (!next.isUnicast())
+            {
+                break;
+            }
+
             UAVCAN_ASSERT(at_least_one_request_needed);
+            if (tryCache(next))
+            {
+                continue;               // Costs no bus traffic, hence not counted
+            }
             getEntry(next).updated_since_last_attempt = false;
             const int res = get_node_info_client_.call(next, protocol::GetNodeInfo::Request());
             if (res < 0)
             {
                 get_node_info_client_.getNode().registerInternalFailure("NodeInfoRetriever GetNodeInfo call");
+                break;
             }
+            num_sent++;
         }
-        else
+
+        // A notification may have been scheduled by a cache hit above
+        if ((num_sent == 0) && !at_least_one_request_needed && !batch_complete_notification_pending_)
         {
-            if (!at_least_one_request_needed)
-            {
-                TimerBase::stop();
-                UAVCAN_TRACE("NodeInfoRetriever", "Timer stopped");
-            }
+            TimerBase::stop();
+            UAVCAN_TRACE("NodeInfoRetriever", "Timer stopped");
         }
     }
 
@@ -264,13 +423,14 @@ private:
         {
             Entry& entry = getEntry(event.node_id);
 
-            entry.request_needed = !offline_now;
+            nodes_to_query_.set(event.node_id, !offline_now);
             entry.num_attempts_made = 0;
+            entry.cache_checked = false;
 
             UAVCAN_TRACE("NodeInfoRetriever", "Offline status change: node ID %d, request needed: %d",
-                         int(event.node_id.get()), int(entry.request_needed));
+                         int(event.node_id.get()), int(!offline_now));
 
-            if (entry.request_needed)
+            if (!offline_now)
             {
                 startTimerIfNotRunning();
             }
@@ -286,8 +446,9 @@ private:
 
         if (msg.uptime_sec < entry.uptime_sec)
         {
-            entry.request_needed = true;
+            nodes_to_query_.add(msg.getSrcNodeID());
             entry.num_attempts_made = 0;
+            entry.cache_checked = true;         // Restarted before our eyes, the cached response is outdated
 
             startTimerIfNotRunning();
         }
@@ -309,9 +470,15 @@ private:
              * after the device has restarted and published its new NodeStatus (although it's unlikely to happen).
              */
             entry.uptime_sec = result.getResponse().status.uptime_sec;
-            entry.request_needed = false;
+            nodes_to_query_.remove(result.getCallID().server_node_id);
+            if (cache_ != UAVCAN_NULLPTR)
+            {
+                cache_->store(result.getCallID().server_node_id, result.getResponse(),
+                              get_node_info_client_.getNode().getUtcTime());
+            }
             listeners_.forEach(NodeInfoRetrievedHandlerCaller(result.getCallID().server_node_id,
                                                               result.getResponse()));
+            scheduleBatchCompleteNotification();
         }
         else
         {
@@ -320,9 +487,10 @@ private:
                 entry.num_attempts_made++;
                 if (entry.num_attempts_made >= num_attempts_)
                 {
-                    entry.request_needed = false;
+                    nodes_to_query_.remove(result.getCallID().server_node_id);
                     listeners_.forEach(GenericHandlerCaller<NodeID>(&INodeInfoListener::handleNodeInfoUnavailable,
                                                                     result.getCallID().server_node_id));
+                    scheduleBatchCompleteNotification();
                 }
             }
         }
@@ -337,6 +505,11 @@ public:
         , request_interval_(MonotonicDuration::fromMSec(DefaultTimerIntervalMSec))
         , last_picked_node_(1)
         , num_attempts_(DefaultNumRequestAttempts)
+        , max_concurrent_requests_(1)
+        , max_bus_load_percent_(0)
+        , batch_complete_notification_pending_(false)
+        , cache_(UAVCAN_NULLPTR)
+        , num_cache_hits_(0)
     { }
 
     /**
@@ -365,7 +538,7 @@ public:
 
     /**
      * This method forces the class to re-request uavcan.protocol.GetNodeInfo from all nodes as if they
-     * have just appeared in the network.
+     * have just appeared in the network. The cache is cleared as well.
      */
     void invalidateAll()
     {
@@ -375,7 +548,13 @@ public:
         for (unsigned i = 0; i < (sizeof(entries_) / sizeof(entries_[0])); i++)
         {
             entries_[i] = Entry();
+            if (cache_ != UAVCAN_NULLPTR)
+            {
+                cache_->remove(NodeID(static_cast<uint8_t>(i + 1U)));
+            }
         }
+        nodes_to_query_.clear();
+        batch_complete_notification_pending_ = false;
         // It is not necessary to reset the last picked node index
     }
 
@@ -446,6 +625,38 @@ public:
         }
     }
 
+    /**
+     * Number of pending requests up to which the retriever keeps issuing new requests every request interval.
+     * One request per interval is issued regardless of this limit, so the default value of one yields exactly one
+     * request per interval. The value is clamped to [1, @ref MaxConcurrentRequests].
+     * Read the class documentation for details.
+     */
+    uint8_t getMaxConcurrentRequests() const { return max_concurrent_requests_; }
+    void setMaxConcurrentRequests(const uint8_t num)
+    {
+        max_concurrent_requests_ = max(static_cast<uint8_t>(1),
+                                       min(static_cast<uint8_t>(MaxConcurrentRequests), num));
+    }
+
+    /**
+     * No requests are sent while the estimated load of any bus is at or above this limit, in percent;
+     * see @ref CanIOManager::getBusLoadPercent(). Zero, which is the default, disables the limit.
+     */
+    uint8_t getMaxBusLoad() const { return max_bus_load_percent_; }
+    void setMaxBusLoad(const uint8_t percent) { max_bus_load_percent_ = percent; }
+
+    /**
+     * Persistent cache of the responses, see @ref INodeInfoCache. Null, which is the default, disables caching.
+     * The cache must outlive the retriever.
+     */
+    INodeInfoCache* getCache() const { return cache_; }
+    void setCache(INodeInfoCache* cache) { cache_ = cache; }
+
+    /**
+     * Number of nodes that were not queried because their response was found in the cache.
+     */
+    uint32_t getNumCacheHits() const { return num_cache_hits_; }
+
     /**
      * These methods are needed mostly for testing.
      */
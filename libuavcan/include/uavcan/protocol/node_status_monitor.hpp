@@ -9,6 +9,7 @@
 #include <uavcan/util/method_binder.hpp>
 #include <uavcan/node/subscriber.hpp>
 #include <uavcan/node/timer.hpp>
+#include <uavcan/transport/node_id_set.hpp>
 #include <uavcan/protocol/NodeStatus.hpp>
 #include <cassert>
 #include <cstdlib>
@@ -18,6 +19,10 @@ namespace uavcan
 /**
  * This class implements the core functionality of a network monitor.
  * It can be extended by inheritance to add more complex logic, or used directly as is.
+ *
+ * Every online node has a deadline by which its next status message is expected. Instead of ticking
+ * periodically, the timer is scheduled at the earliest deadline, so that there is no work to do while
+ * the messages keep arriving in time.
  */
 class UAVCAN_EXPORT NodeStatusMonitor
 {
@@ -67,8 +72,6 @@ public:
     };
 
 private:
-    enum { TimerPeriodMs100 = 2 };
-
     typedef MethodBinder<NodeStatusMonitor*,
                          void (NodeStatusMonitor::*)(const ReceivedDataStructure<protocol::NodeStatus>&)>
             NodeStatusCallback;
@@ -82,14 +85,19 @@ private:
     struct Entry
     {
         NodeStatus status;
-        int8_t time_since_last_update_ms100;
+        uint32_t deadline_ms;           ///< Lower bits of the monotonic time when the node goes offline
         Entry() :
-            time_since_last_update_ms100(-1)
+            deadline_ms(0)
         { }
     };
 
     mutable Entry entries_[NodeID::Max];  // [1, NodeID::Max]
 
+    NodeIDSet known_nodes_;                 ///< Observed at least once
+    NodeIDSet online_nodes_;                ///< Known and not offline; only these are tracked by the timer
+
+    bool rx_state_reclaim_enabled_;
+
     Entry& getEntry(NodeID node_id) const
     {
         if (node_id.get() < 1 || node_id.get() > NodeID::Max)
@@ -99,6 +107,14 @@ private:
         return entries_[node_id.get() - 1];
     }
 
+    static uint32_t toDeadlineMs(MonotonicTime ts) { return uint32_t(ts.toMSec()); }
+
+    /// Signed difference is immune to the overflow of the deadline
+    static int32_t getTimeToDeadlineMs(const Entry& entry, MonotonicTime ts)
+    {
+        return int32_t(entry.deadline_ms - toDeadlineMs(ts));
+    }
+
     void changeNodeStatus(const NodeID node_id, const Entry new_entry_value)
     {
         Entry& entry = getEntry(node_id);
@@ -108,7 +124,7 @@ private:
             event.node_id    = node_id;
             event.old_status = entry.status;
             event.status     = new_entry_value.status;
-            event.was_known  = entry.time_since_last_update_ms100 >= 0;
+            event.was_known  = known_nodes_.contains(node_id);
 
             UAVCAN_TRACE("NodeStatusMonitor", "Node %i [%s] status change: [%s] --> [%s]", int(node_id.get()),
                          (event.was_known ? "known" : "new"),
@@ -117,42 +133,68 @@ private:
             handleNodeStatusChange(event);
         }
         entry = new_entry_value;
+
+        known_nodes_.add(node_id);
+        const bool was_online = online_nodes_.contains(node_id);
+        online_nodes_.set(node_id, entry.status.mode != protocol::NodeStatus::MODE_OFFLINE);
+
+        if (rx_state_reclaim_enabled_ && was_online && !online_nodes_.contains(node_id))
+        {
+            sub_.getNode().getDispatcher().removeRxStateOf(node_id);
+        }
     }
 
     void handleNodeStatus(const ReceivedDataStructure<protocol::NodeStatus>& msg)
     {
+        const MonotonicTime deadline =
+            msg.getMonotonicTimestamp() + MonotonicDuration::fromMSec(protocol::NodeStatus::OFFLINE_TIMEOUT_MS);
+
         Entry new_entry;
-        new_entry.time_since_last_update_ms100 = 0;
+        new_entry.deadline_ms = toDeadlineMs(deadline);
         new_entry.status.health   = msg.health   & ((1 << protocol::NodeStatus::FieldTypes::health::BitLen) - 1);
         new_entry.status.mode     = msg.mode     & ((1 << protocol::NodeStatus::FieldTypes::mode::BitLen) - 1);
         new_entry.status.sub_mode = msg.sub_mode & ((1 << protocol::NodeStatus::FieldTypes::sub_mode::BitLen) - 1);
 
         changeNodeStatus(msg.getSrcNodeID(), new_entry);
 
+        // The new deadline is the latest one, so the timer only needs to be started if it is idle
+        if (!timer_.isRunning() && online_nodes_.contains(msg.getSrcNodeID()))
+        {
+            timer_.startOneShotWithDeadline(deadline);
+        }
+
         handleNodeStatusMessage(msg);
     }
 
-    void handleTimerEvent(const TimerEvent&)
+    void handleTimerEvent(const TimerEvent& event)
     {
-        const int OfflineTimeoutMs100 = protocol::NodeStatus::OFFLINE_TIMEOUT_MS / 100;
+        bool have_deadline = false;
+        int32_t earliest_deadline_ms = 0;
 
-        for (uint8_t i = 1; i <= NodeID::Max; i++)
+        // The handler may forget nodes, which is fine because the next member is looked up afresh
+        for (NodeID nid = online_nodes_.getFirst(); nid.isValid(); nid = online_nodes_.getNext(nid))
         {
-            Entry& entry = getEntry(i);
-            if (entry.time_since_last_update_ms100 >= 0 &&
-                entry.status.mode != protocol::NodeStatus::MODE_OFFLINE)
+            Entry& entry = getEntry(nid);
+            UAVCAN_ASSERT(entry.status.mode != protocol::NodeStatus::MODE_OFFLINE);
+
+            const int32_t time_to_deadline_ms = getTimeToDeadlineMs(entry, event.real_time);
+            if (time_to_deadline_ms <= 0)
             {
-                entry.time_since_last_update_ms100 =
-                    int8_t(entry.time_since_last_update_ms100 + int8_t(TimerPeriodMs100));
-
-                if (entry.time_since_last_update_ms100 > OfflineTimeoutMs100)
-                {
-                    Entry new_entry_value = entry;
-                    new_entry_value.time_since_last_update_ms100 = OfflineTimeoutMs100;
-                    new_entry_value.status.mode = protocol::NodeStatus::MODE_OFFLINE;
-                    changeNodeStatus(i, new_entry_value);
-                }
+                Entry new_entry_value = entry;
+                new_entry_value.status.mode = protocol::NodeStatus::MODE_OFFLINE;
+                changeNodeStatus(nid, new_entry_value);
             }
+            else if (!have_deadline || (time_to_deadline_ms < earliest_deadline_ms))
+            {
+                have_deadline = true;
+                earliest_deadline_ms = time_to_deadline_ms;
+            }
+        }
+
+        // The handler may also have received new nodes, in which case the timer is running already
+        if (have_deadline && !timer_.isRunning())
+        {
+            timer_.startOneShotWithDeadline(event.real_time + MonotonicDuration::fromMSec(earliest_deadline_ms));
         }
     }
 
@@ -181,6 +223,7 @@ public:
     explicit NodeStatusMonitor(INode& node)
         : sub_(node)
         , timer_(node)
+        , rx_state_reclaim_enabled_(true)
     { }
 
     virtual ~NodeStatusMonitor() { }
@@ -196,11 +239,19 @@ public:
         if (res >= 0)
         {
             timer_.setCallback(TimerCallback(this, &NodeStatusMonitor::handleTimerEvent));
-            timer_.startPeriodic(MonotonicDuration::fromMSec(TimerPeriodMs100 * 100));
         }
         return res;
     }
 
+    /**
+     * When a node goes offline, its transfer receivers and the buffers of its unfinished transfers are released
+     * in all listeners of the local node at once, see @ref Dispatcher::removeRxStateOf(), rather than when they
+     * time out one by one. This keeps the memory pool from being held by the nodes that are gone, e.g. while
+     * many nodes are being replaced. Enabled by default.
+     */
+    void setRxStateReclaimEnabled(bool enabled) { rx_state_reclaim_enabled_ = enabled; }
+    bool isRxStateReclaimEnabled() const { return rx_state_reclaim_enabled_; }
+
     /**
      * Make the node unknown.
      */
@@ -210,6 +261,8 @@ public:
         {
             Entry& entry = getEntry(node_id);
             entry = Entry();
+            known_nodes_.remove(node_id);
+            online_nodes_.remove(node_id);
         }
         else
         {
@@ -226,6 +279,8 @@ public:
         {
             entries_[i] = Entry();
         }
+        known_nodes_.clear();
+        online_nodes_.clear();
     }
 
     /**
@@ -242,7 +297,7 @@ public:
         }
 
         const Entry& entry = getEntry(node_id);
-        if (entry.time_since_last_update_ms100 >= 0)
+        if (known_nodes_.contains(node_id))
         {
             return entry.status;
         }
@@ -263,7 +318,20 @@ public:
             UAVCAN_ASSERT(0);
             return false;
         }
-        return getEntry(node_id).time_since_last_update_ms100 >= 0;
+        return known_nodes_.contains(node_id);
+    }
+
+    /**
+     * Sets of the nodes that have been observed at least once, and of those of them that are not offline.
+     * The known nodes that are not online have timed out or reported the offline mode.
+     */
+    const NodeIDSet& getKnownNodes() const  { return known_nodes_; }
+    const NodeIDSet& getOnlineNodes() const { return online_nodes_; }
+    NodeIDSet getOfflineNodes() const
+    {
+        NodeIDSet offline = known_nodes_;
+        offline.remove(online_nodes_);
+        return offline;
     }
 
     /**
@@ -276,18 +344,14 @@ public:
         NodeID nid_with_worst_health;
         uint8_t worst_health = protocol::NodeStatus::HEALTH_OK;
 
-        for (uint8_t i = 1; i <= NodeID::Max; i++)
+        for (NodeID nid = known_nodes_.getFirst(); nid.isValid(); nid = known_nodes_.getNext(nid))
         {
-            const NodeID nid(i);
             UAVCAN_ASSERT(nid.isUnicast());
             const Entry& entry = getEntry(nid);
-            if (entry.time_since_last_update_ms100 >= 0)
+            if (entry.status.health > worst_health || !nid_with_worst_health.isValid())
             {
-                if (entry.status.health > worst_health || !nid_with_worst_health.isValid())
-                {
-                    nid_with_worst_health = nid;
-                    worst_health = entry.status.health;
-                }
+                nid_with_worst_health = nid;
+                worst_health = entry.status.health;
             }
         }
 
@@ -295,22 +359,18 @@ public:
     }
 
     /**
-     * Calls the operator for every known node.
+     * Calls the operator for every known node, in the order of node ID.
+     * Complexity O(number of known nodes).
      * Operator signature:
      *   void (NodeID, NodeStatus)
      */
     template <typename Operator>
     void forEachNode(Operator op) const
     {
-        for (uint8_t i = 1; i <= NodeID::Max; i++)
+        for (NodeID nid = known_nodes_.getFirst(); nid.isValid(); nid = known_nodes_.getNext(nid))
         {
-            const NodeID nid(i);
             UAVCAN_ASSERT(nid.isUnicast());
-            const Entry& entry = getEntry(nid);
-            if (entry.time_since_last_update_ms100 >= 0)
-            {
-                op(nid, entry.status);
-            }
+            op(nid, getEntry(nid).status);
         }
     }
 };
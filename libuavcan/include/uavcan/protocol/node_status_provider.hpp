@@ -63,12 +63,21 @@ class UAVCAN_EXPORT NodeStatusProvider : private TimerBase
 
     IAdHocNodeStatusUpdater* ad_hoc_status_updater_;
 
+    MonotonicDuration publication_period_;
+
+    uint8_t published_health_;
+    uint8_t published_mode_;
+    bool adaptive_publication_;
+    bool ad_hoc_update_in_progress_;
+
     INode& getNode() { return node_status_pub_.getNode(); }
 
     bool isNodeInfoInitialized() const;
 
     int publish();
 
+    void handleStatusChange();
+
     virtual void handleTimerEvent(const TimerEvent&) override;
     void handleGetNodeInfoRequest(const protocol::GetNodeInfo::Request&, protocol::GetNodeInfo::Response& rsp);
 
@@ -84,6 +93,11 @@ public:
         , node_status_pub_(node)
         , gni_srv_(node)
         , ad_hoc_status_updater_(UAVCAN_NULLPTR)
+        , publication_period_(MonotonicDuration::getInfinite())
+        , published_health_(0)
+        , published_mode_(0)
+        , adaptive_publication_(false)
+        , ad_hoc_update_in_progress_(false)
     {
         UAVCAN_ASSERT(!creation_timestamp_.isZero());
 
@@ -112,6 +126,17 @@ public:
     void setStatusPublicationPeriod(uavcan::MonotonicDuration period);
     uavcan::MonotonicDuration getStatusPublicationPeriod() const;
 
+    /**
+     * In the adaptive mode, a change of the health or mode code is published immediately, and while the status
+     * stays the same, the period of the periodic publications is doubled after each of them until it reaches
+     * the maximum allowed by the DSDL definition. A change of the status restores the configured period.
+     * This reduces the bus load on large networks where the status of the nodes rarely changes, without
+     * delaying the status updates.
+     * Disabled by default.
+     */
+    void enableAdaptivePublication(bool enabled);
+    bool isAdaptivePublicationEnabled() const { return adaptive_publication_; }
+
     /**
      * Configure the optional handler that is invoked before every node status message is emitted.
      * By default no handler is installed.
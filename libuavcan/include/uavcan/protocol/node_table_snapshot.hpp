@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_NODE_TABLE_SNAPSHOT_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_NODE_TABLE_SNAPSHOT_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/util/seqlock.hpp>
+#include <uavcan/protocol/node_info_retriever.hpp>
+
+namespace uavcan
+{
+/**
+ * Copy of the node table of @ref NodeStatusMonitor and of the summaries of the responses collected by
+ * @ref NodeInfoRetriever, which can be read from other threads without locking, e.g. by a user interface or by
+ * a supervisor that polls the state of the network at a high rate.
+ *
+ * The table is updated incrementally from the thread that spins the node: only the entry of the node that has
+ * sent the status message or the node info is copied. Every entry is protected by its own sequence lock, see
+ * @ref SeqLocked, so the node thread never waits for the readers and the readers of different nodes don't
+ * interfere with each other. Readers that poll the whole table can skip the work if the generation counter has
+ * not changed since the last poll.
+ *
+ * The table is added as a listener to the retriever:
+ *
+ *      uavcan::NodeTableSnapshot snapshot;
+ *      retriever.addListener(&snapshot);
+ *
+ * It can also be fed by a plain @ref NodeStatusMonitor by calling the listener methods from its overrides of
+ * handleNodeStatusChange() and handleNodeStatusMessage(); the node info fields stay empty in that case.
+ *
+ * Node names longer than MaxNameLength are truncated.
+ */
+class UAVCAN_EXPORT NodeTableSnapshot : public INodeInfoListener, Noncopyable
+{
+public:
+    enum { MaxNameLength = 80 };
+    enum { UniqueIDLength = 16 };
+
+    /**
+     * Everything known about a node. The status reflects the status monitor, so the mode becomes offline when
+     * the node times out. The node info fields are valid if info_available is set; they are kept when the node
+     * restarts, until the new response is received.
+     */
+    struct NodeEntry
+    {
+        MonotonicTime last_status_ts;           ///< Reception time of the last status message
+        uint32_t uptime_sec;
+        uint32_t software_vcs_commit;
+        uint64_t software_image_crc;
+        uint16_t vendor_specific_status_code;
+        NodeStatusMonitor::NodeStatus status;
+        bool info_available;                    ///< The response to GetNodeInfo has been received
+        bool info_unavailable;                  ///< The node didn't respond to GetNodeInfo
+        uint8_t software_version_major;
+        uint8_t software_version_minor;
+        uint8_t software_optional_field_flags;
+        uint8_t hardware_version_major;
+        uint8_t hardware_version_minor;
+        uint8_t unique_id[UniqueIDLength];
+        char name[MaxNameLength + 1];           ///< Null-terminated
+
+        NodeEntry()
+            : uptime_sec(0)
+            , software_vcs_commit(0)
+            , software_image_crc(0)
+            , vendor_specific_status_code(0)
+            , info_available(false)
+            , info_unavailable(false)
+            , software_version_major(0)
+            , software_version_minor(0)
+            , software_optional_field_flags(0)
+            , hardware_version_major(0)
+            , hardware_version_minor(0)
+        {
+            fill(unique_id, unique_id + UniqueIDLength, uint8_t(0));
+            fill(name, name + MaxNameLength + 1, '\0');
+        }
+    };
+
+private:
+    SeqLocked<NodeEntry> entries_[NodeID::Max];      // [1, NodeID::Max]
+    std::atomic<uint32_t> generation_;
+
+    static bool isValidNodeID(NodeID node_id)
+    {
+        if (!node_id.isUnicast())
+        {
+            UAVCAN_ASSERT(0);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Loads the entry, lets the modifier update it and stores it back.
+     * The loads never retry because this is the only thread that stores.
+     */
+    template <typename Modifier>
+    void update(NodeID node_id, Modifier modifier)
+    {
+        if (!isValidNodeID(node_id))
+        {
+            return;
+        }
+        SeqLocked<NodeEntry>& slot = entries_[node_id.get() - 1];
+        NodeEntry entry;
+        (void)slot.load(entry);
+        modifier(entry);
+        slot.store(entry);
+        (void)generation_.fetch_add(1, std::memory_order_release);
+    }
+
+    struct StatusChangeModifier
+    {
+        const NodeStatusMonitor::NodeStatus status;
+        explicit StatusChangeModifier(NodeStatusMonitor::NodeStatus arg_status) : status(arg_status) { }
+        void operator()(NodeEntry& entry) const { entry.status = status; }
+    };
+
+    struct StatusMessageModifier
+    {
+        const ReceivedDataStructure<protocol::NodeStatus>& msg;
+        explicit StatusMessageModifier(const ReceivedDataStructure<protocol::NodeStatus>& arg_msg) : msg(arg_msg) { }
+        void operator()(NodeEntry& entry) const
+        {
+            entry.last_status_ts = msg.getMonotonicTimestamp();
+            entry.uptime_sec = msg.uptime_sec;
+            entry.vendor_specific_status_code = msg.vendor_specific_status_code;
+        }
+    };
+
+    struct NodeInfoModifier
+    {
+        const protocol::GetNodeInfo::Response& info;
+        explicit NodeInfoModifier(const protocol::GetNodeInfo::Response& arg_info) : info(arg_info) { }
+        void operator()(NodeEntry& entry) const
+        {
+            entry.info_available = true;
+            entry.info_unavailable = false;
+            entry.software_version_major = info.software_version.major;
+            entry.software_version_minor = info.software_version.minor;
+            entry.software_optional_field_flags = info.software_version.optional_field_flags;
+            entry.software_vcs_commit = info.software_version.vcs_commit;
+            entry.software_image_crc = info.software_version.image_crc;
+            entry.hardware_version_major = info.hardware_version.major;
+            entry.hardware_version_minor = info.hardware_version.minor;
+            for (uint8_t i = 0; i < UniqueIDLength; i++)
+            {
+                entry.unique_id[i] = info.hardware_version.unique_id[i];
+            }
+            const uint8_t name_length = uint8_t(min<unsigned>(info.name.size(), MaxNameLength));
+            for (uint8_t i = 0; i < name_length; i++)
+            {
+                entry.name[i] = char(info.name[i]);
+            }
+            entry.name[name_length] = '\0';
+        }
+    };
+
+    struct NodeInfoUnavailableModifier
+    {
+        void operator()(NodeEntry& entry) const { entry.info_unavailable = true; }
+    };
+
+public:
+    NodeTableSnapshot()
+        : generation_(0)
+    { }
+
+    virtual void handleNodeStatusChange(const NodeStatusMonitor::NodeStatusChangeEvent& event) override
+    {
+        update(event.node_id, StatusChangeModifier(event.status));
+    }
+
+    virtual void handleNodeStatusMessage(const ReceivedDataStructure<protocol::NodeStatus>& msg) override
+    {
+        update(msg.getSrcNodeID(), StatusMessageModifier(msg));
+    }
+
+    virtual void handleNodeInfoRetrieved(NodeID node_id, const protocol::GetNodeInfo::Response& node_info) override
+    {
+        update(node_id, NodeInfoModifier(node_info));
+    }
+
+    virtual void handleNodeInfoUnavailable(NodeID node_id) override
+    {
+        update(node_id, NodeInfoUnavailableModifier());
+    }
+
+    /**
+     * Copies the entry of the given node. Can be called from any thread.
+     * Returns false if the node has never been seen.
+     */
+    bool getNode(NodeID node_id, NodeEntry& out_entry) const
+    {
+        return isValidNodeID(node_id) && entries_[node_id.get() - 1].load(out_entry);
+    }
+
+    /**
+     * Same as @ref NodeStatusMonitor::getNodeStatus(), but can be called from any thread.
+     * Unknown nodes are considered offline.
+     */
+    NodeStatusMonitor::NodeStatus getNodeStatus(NodeID node_id) const
+    {
+        NodeEntry entry;
+        return getNode(node_id, entry) ? entry.status : NodeStatusMonitor::NodeStatus();
+    }
+
+    /**
+     * Number of updates of the given node, or zero if the node has never been seen. Polling this is cheaper than
+     * copying the entry.
+     */
+    uint32_t getNodeGeneration(NodeID node_id) const
+    {
+        return isValidNodeID(node_id) ? entries_[node_id.get() - 1].getNumStores() : 0;
+    }
+
+    /**
+     * Number of updates of the whole table. If it hasn't changed since the last poll, neither has any entry.
+     */
+    uint32_t getGeneration() const { return generation_.load(std::memory_order_acquire); }
+};
+
+}
+
+#endif // UAVCAN_PROTOCOL_NODE_TABLE_SNAPSHOT_HPP_INCLUDED
@@ -8,18 +8,41 @@
 #include <uavcan/debug.hpp>
 #include <uavcan/node/publisher.hpp>
 #include <uavcan/node/timer.hpp>
+#include <uavcan/marshal/bit_stream.hpp>
+#include <uavcan/transport/frame.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
 #include <uavcan/protocol/Panic.hpp>
 
+#if UAVCAN_GENERAL_PURPOSE_PLATFORM && (UAVCAN_CPP_VERSION >= UAVCAN_CPP11)
+# include <atomic>
+#endif
+
 namespace uavcan
 {
 /**
  * Helper for broadcasting the message uavcan.protocol.Panic.
+ *
+ * Besides the regular broadcasting from the node thread, the message can be sent through the emergency path:
+ * the frame is compiled in advance by @ref prepareEmergency(), and @ref triggerEmergency() hands it to every
+ * interface via @ref ICanIface::sendEmergency(), ahead of the TX queues. The trigger doesn't touch the state of
+ * the library, so it can be invoked from an interrupt handler or from another thread, e.g. from a watchdog or
+ * a fault handler, while the node thread is stuck or the TX queue is full; the message goes out within one frame
+ * time if the driver supports this.
  */
 class UAVCAN_EXPORT PanicBroadcaster : private TimerBase
 {
     Publisher<protocol::Panic> pub_;
     protocol::Panic msg_;
 
+    ICanIface* emergency_ifaces_[MaxCanIfaces];
+    CanFrame emergency_frame_;
+    uint8_t num_emergency_ifaces_;
+#if UAVCAN_GENERAL_PURPOSE_PLATFORM && (UAVCAN_CPP_VERSION >= UAVCAN_CPP11)
+    std::atomic<uint8_t> emergency_transfer_id_;
+#else
+    uint8_t emergency_transfer_id_;
+#endif
+
     void publishOnce()
     {
         const int res = pub_.broadcast(msg_);
@@ -38,7 +61,11 @@ public:
     explicit PanicBroadcaster(INode& node)
         : TimerBase(node)
         , pub_(node)
-    { }
+        , num_emergency_ifaces_(0)
+        , emergency_transfer_id_(0)
+    {
+        fill(emergency_ifaces_, emergency_ifaces_ + MaxCanIfaces, static_cast<ICanIface*>(UAVCAN_NULLPTR));
+    }
 
     /**
      * This method does not block and can't fail.
@@ -83,6 +110,112 @@ public:
 
     bool isPanicking() const { return isRunning(); }
 
+    /**
+     * Compiles the frame for @ref triggerEmergency(); must be invoked from the node thread, once the node ID
+     * is set. Can be invoked again to change the reason, but not concurrently with the trigger.
+     * @param short_reason_description  See @ref panic().
+     * @param priority                  Transfer priority; the highest one by default, since it is an emergency.
+     * @return                          Negative error code.
+     */
+    int prepareEmergency(const char* short_reason_description,
+                         const TransferPriority priority = TransferPriority::NumericallyMin)
+    {
+        INode& node = pub_.getNode();
+        if (!node.getNodeID().isUnicast())
+        {
+            return -ErrPassiveMode;
+        }
+        const DataTypeDescriptor* const descr =
+            GlobalDataTypeRegistry::instance().find(DataTypeKindMessage, protocol::Panic::getDataTypeFullName());
+        if (descr == UAVCAN_NULLPTR)
+        {
+            return -ErrUnknownDataType;
+        }
+
+        protocol::Panic msg;
+        for (const char* p = short_reason_description; (p != UAVCAN_NULLPTR) && (*p != '\0'); p++)
+        {
+            if (msg.reason_text.size() == msg.reason_text.capacity())
+            {
+                break;
+            }
+            msg.reason_text.push_back(protocol::Panic::FieldTypes::reason_text::ValueType(*p));
+        }
+
+        StaticTransferBuffer<sizeof(emergency_frame_.data)> buffer;
+        BitStream bitstream(buffer);
+        ScalarCodec codec(bitstream);
+        if (protocol::Panic::encode(msg, codec) < 0)
+        {
+            return -ErrInvalidMarshalData;
+        }
+
+        // The message always fits into a single frame, as the reason is at most 7 bytes long
+        Frame frame(descr->getID(), TransferTypeMessageBroadcast, node.getNodeID(), NodeID::Broadcast, 0);
+        frame.setPriority(priority);
+        frame.setStartOfTransfer(true);
+        frame.setEndOfTransfer(true);
+        const unsigned len = buffer.getMaxWritePos();
+        if ((frame.setPayload(buffer.getRawPtr(), len) != len) || !frame.compile(emergency_frame_))
+        {
+            return -ErrTransferTooLong;
+        }
+
+        ICanDriver& driver = node.getDispatcher().getCanIOManager().getCanDriver();
+        num_emergency_ifaces_ = 0;
+        for (uint8_t i = 0; i < driver.getNumIfaces(); i++)
+        {
+            ICanIface* const iface = driver.getIface(i);
+            if (iface != UAVCAN_NULLPTR)
+            {
+                emergency_ifaces_[num_emergency_ifaces_++] = iface;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * Sends the frame prepared by @ref prepareEmergency() through every interface, bypassing the TX queues.
+     * Can be invoked from an interrupt handler or from another thread, as long as the driver supports that, see
+     * @ref ICanIface::sendEmergency(). On general-purpose platforms with C++11 the transfer ID is advanced
+     * atomically, so several threads may trigger at once; otherwise only one context may invoke this method at
+     * a time, e.g. a single interrupt handler, or the interrupts must be disabled around the call.
+     * Every call sends a new transfer. The emergency transfers are numbered separately from the regular ones;
+     * if both are sent, a receiver may drop some of them as duplicates, which doesn't matter for a message that
+     * is repeated.
+     * @return  Number of interfaces that accepted the frame.
+     */
+    unsigned triggerEmergency()
+    {
+        if (num_emergency_ifaces_ == 0)
+        {
+            return 0;
+        }
+        CanFrame frame = emergency_frame_;
+        const uint8_t tail_index = uint8_t(frame.getDataLength() - 1U);
+#if UAVCAN_GENERAL_PURPOSE_PLATFORM && (UAVCAN_CPP_VERSION >= UAVCAN_CPP11)
+        // Wraps around at a multiple of the transfer ID range
+        const uint8_t transfer_id = uint8_t(emergency_transfer_id_.fetch_add(1U, std::memory_order_relaxed) &
+                                            TransferID::Max);
+#else
+        const uint8_t transfer_id = emergency_transfer_id_;
+        emergency_transfer_id_ = uint8_t((emergency_transfer_id_ + 1U) & TransferID::Max);
+#endif
+        frame.data[tail_index] = uint8_t((frame.data[tail_index] & ~TransferID::Max) | transfer_id);
+
+        unsigned num_accepted = 0;
+        for (uint8_t i = 0; i < num_emergency_ifaces_; i++)
+        {
+            if (emergency_ifaces_[i]->sendEmergency(frame) > 0)
+            {
+                num_accepted++;
+            }
+        }
+        return num_accepted;
+    }
+
+    bool isEmergencyPrepared() const { return num_emergency_ifaces_ > 0; }
+
     const typename protocol::Panic::FieldTypes::reason_text& getReason() const
     {
         return msg_.reason_text;
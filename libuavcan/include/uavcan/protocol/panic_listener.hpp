@@ -18,6 +18,7 @@
 
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
 # include <functional>
+# include <uavcan/util/inplace_function.hpp>
 #endif
 
 namespace uavcan
@@ -33,7 +34,7 @@ namespace uavcan
  */
 template <
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
-          typename Callback = std::function<void (const ReceivedDataStructure<protocol::Panic>&)>
+          typename Callback = DefaultCallback<void (const ReceivedDataStructure<protocol::Panic>&)>
 #else
           typename Callback = void (*)(const ReceivedDataStructure<protocol::Panic>&)
 #endif
@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_PARAM_LOG_STORAGE_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_PARAM_LOG_STORAGE_HPP_INCLUDED
+
+#include <cstring>
+#include <uavcan/build_config.hpp>
+#include <uavcan/data_type.hpp>
+#include <uavcan/node/timer.hpp>
+#include <uavcan/protocol/param_registry.hpp>
+
+namespace uavcan
+{
+/**
+ * Flash memory that holds the parameters saved by @ref ParamLogStorage: two sectors of equal size that can be
+ * erased independently of each other. Implemented by the application; the methods may block.
+ */
+class UAVCAN_EXPORT IParamFlash
+{
+public:
+    enum { NumSectors = 2 };
+
+    virtual ~IParamFlash() { }
+
+    /**
+     * Size of either sector in bytes.
+     */
+    virtual uint32_t getSectorSize() const = 0;
+
+    /**
+     * Returns negative error code.
+     */
+    virtual int read(uint8_t sector, uint32_t offset, uint8_t* data, uint16_t size) = 0;
+
+    /**
+     * Programs the given bytes. The storage never writes to the same location twice between the erasures of
+     * the sector, and never writes across a sector boundary. Returns negative error code.
+     */
+    virtual int write(uint8_t sector, uint32_t offset, const uint8_t* data, uint16_t size) = 0;
+
+    /**
+     * Sets all bytes of the sector to 0xFF. Returns negative error code.
+     */
+    virtual int erase(uint8_t sector) = 0;
+};
+
+/**
+ * Non-generic part of @ref ParamLogStorage; operates on the values of the parameters as 32-bit words.
+ *
+ * The active sector contains a header followed by the log of records, each of which holds the new value of one
+ * parameter and is protected by CRC. Saving appends the records of the parameters that have changed since they
+ * were last saved; loading replays the log, so the last record of every parameter wins. The records that fail
+ * the CRC check, e.g. because the power was lost while they were being written, are skipped.
+ *
+ * Once the free space in the active sector drops below the size of the full parameter set, the log is compacted
+ * in the background: the spare sector is erased, the last values of the parameters are copied to it a few at a
+ * time, and then its header is written, which makes it the active sector. The header is written last, so an
+ * interrupted compaction leaves the previous sector in charge. The sectors alternate, which spreads the wear
+ * evenly between them.
+ */
+class UAVCAN_EXPORT ParamLogStorageBase : private TimerBase
+{
+public:
+    enum { HeaderSize = 12 };
+    enum { RecordSize = 12 };
+
+    /**
+     * Compaction copies that many records per step; the steps are spaced by the interval below.
+     */
+    enum { CompactionRecordsPerStep = 8 };
+    enum { CompactionStepIntervalMs = 10 };
+
+private:
+    enum CompactionState
+    {
+        CompactionIdle,
+        CompactionEraseSpare,
+        CompactionCopy,
+        CompactionEraseOld
+    };
+
+    IParamFlash& flash_;
+    uint32_t* const persisted_values_;  ///< Values in the log, per parameter
+    bool* const recopy_flags_;          ///< Parameters saved during the compaction after they have been copied
+    const unsigned num_params_;
+
+    uint32_t generation_;               ///< Incremented with every compaction; the newer sector is active
+    uint32_t write_offset_;
+    uint32_t compaction_offset_;
+    uint32_t num_corrupted_records_;
+    uint16_t compaction_cursor_;
+    uint8_t active_sector_;
+    uint8_t compaction_state_;
+
+    uint8_t getSpareSector() const { return uint8_t(active_sector_ ^ 1U); }
+
+    uint32_t getCapacity() const { return (flash_.getSectorSize() - HeaderSize) / RecordSize; }
+
+    bool readHeader(uint8_t sector, uint32_t& out_generation);
+    int writeHeader(uint8_t sector, uint32_t generation);
+    int appendRecord(uint8_t sector, uint32_t& inout_offset, unsigned param_index, uint32_t value);
+    int replay();
+    int startNewLog(uint8_t sector, uint32_t generation);
+
+    void startCompaction();
+    void abortCompaction();
+    int stepCompaction();
+
+    virtual void handleTimerEvent(const TimerEvent&) override;
+
+protected:
+    ParamLogStorageBase(INode& node, IParamFlash& flash, uint32_t* persisted_values, bool* recopy_flags,
+                        unsigned num_params)
+        : TimerBase(node)
+        , flash_(flash)
+        , persisted_values_(persisted_values)
+        , recopy_flags_(recopy_flags)
+        , num_params_(num_params)
+        , generation_(0)
+        , write_offset_(HeaderSize)
+        , compaction_offset_(HeaderSize)
+        , num_corrupted_records_(0)
+        , compaction_cursor_(0)
+        , active_sector_(0)
+        , compaction_state_(CompactionIdle)
+    { }
+
+    /**
+     * Identifies the parameter in the log; must not change if the parameters are reordered.
+     */
+    virtual uint32_t getParamKey(unsigned index) const = 0;
+
+    /**
+     * Records of a different kind are ignored when the log is loaded.
+     */
+    virtual uint8_t getParamKind(unsigned index) const = 0;
+
+    virtual uint32_t getParamValue(unsigned index) const = 0;
+    virtual uint32_t getParamDefaultValue(unsigned index) const = 0;
+
+    /**
+     * Invoked for every record while the log is loaded.
+     */
+    virtual void setParamValue(unsigned index, uint32_t value) = 0;
+
+public:
+    /**
+     * Loads the parameters from the log; the parameters that are not in the log keep their current values, which
+     * are expected to be the defaults. Initializes the flash if it contains no log.
+     * Returns negative error code; -ErrInvalidParam if the sectors can't hold twice the number of parameters.
+     */
+    int init();
+
+    /**
+     * Appends the changed parameters to the log. If the active sector is full, the compaction is completed first.
+     * Returns the number of the parameters saved, or negative error code.
+     */
+    int save();
+
+    /**
+     * Erases the log; the parameters will be loaded with the default values.
+     * Returns negative error code.
+     */
+    int erase();
+
+    /**
+     * Completes the compaction if it is in progress, otherwise compacts the log now.
+     * Returns negative error code.
+     */
+    int compact();
+
+    bool isCompacting() const { return compaction_state_ != CompactionIdle; }
+
+    uint8_t getActiveSector() const { return active_sector_; }
+    uint32_t getGeneration() const { return generation_; }
+
+    /**
+     * Number of records that can be appended to the active sector.
+     */
+    uint32_t getNumFreeRecords() const { return getCapacity() - (write_offset_ - HeaderSize) / RecordSize; }
+
+    /**
+     * Number of the records that were skipped when the log was loaded because of the CRC mismatch.
+     */
+    uint32_t getNumCorruptedRecords() const { return num_corrupted_records_; }
+};
+
+/**
+ * Keeps the parameters of @ref ParamRegistry in a log-structured flash region, see @ref ParamLogStorageBase;
+ * saving takes time proportional to the number of changed parameters, not to the size of the parameter set.
+ * The parameters are identified in the log by their names, so the table of parameters can be reordered or extended
+ * between the firmware versions; the values that are out of the limits of the parameter are clamped when loaded.
+ *
+ * Usage:
+ *
+ *      class MyParamManager : public uavcan::ParamRegistry<3>
+ *      {
+ *          uavcan::ParamLogStorage<3> storage_;
+ *
+ *      public:
+ *          MyParamManager(uavcan::INode& node, uavcan::IParamFlash& flash)
+ *              : uavcan::ParamRegistry<3>(params)
+ *              , storage_(node, flash, *this)
+ *          { }
+ *
+ *          int init() { return storage_.init(); }
+ *
+ *          int saveAllParams() override { return storage_.save(); }
+ *          int eraseAllParams() override { return storage_.erase(); }
+ *      };
+ *
+ * @tparam NumParams_       Number of entries of the registry.
+ */
+template <unsigned NumParams_>
+class UAVCAN_EXPORT ParamLogStorage : public ParamLogStorageBase
+{
+    ParamRegistry<NumParams_>& registry_;
+    uint32_t keys_[NumParams_];
+    uint32_t persisted_value_pool_[NumParams_];
+    bool recopy_flag_pool_[NumParams_];
+
+    static uint32_t computeKey(const char* name)
+    {
+        DataTypeSignatureCRC crc;
+        crc.add(reinterpret_cast<const uint8_t*>(name), unsigned(std::strlen(name)));
+        return uint32_t(crc.get() & 0xFFFFFFFFU);
+    }
+
+    static uint32_t floatToWord(float x)
+    {
+        uint32_t w = 0;
+        std::memcpy(&w, &x, sizeof(w));
+        return w;
+    }
+
+    static float wordToFloat(uint32_t w)
+    {
+        float x = 0.0F;
+        std::memcpy(&x, &w, sizeof(x));
+        return x;
+    }
+
+    virtual uint32_t getParamKey(unsigned index) const override { return keys_[index]; }
+
+    virtual uint8_t getParamKind(unsigned index) const override { return uint8_t(registry_.getEntry(index).kind); }
+
+    virtual uint32_t getParamValue(unsigned index) const override;
+    virtual uint32_t getParamDefaultValue(unsigned index) const override;
+    virtual void setParamValue(unsigned index, uint32_t value) override;
+
+public:
+    ParamLogStorage(INode& node, IParamFlash& flash, ParamRegistry<NumParams_>& registry)
+        : ParamLogStorageBase(node, flash, persisted_value_pool_, recopy_flag_pool_, NumParams_)
+        , registry_(registry)
+    {
+        StaticAssert<sizeof(float) == 4>::check();
+        for (unsigned i = 0; i < NumParams_; i++)
+        {
+            keys_[i] = computeKey(registry_.getEntry(i).name);
+            persisted_value_pool_[i] = 0;
+            recopy_flag_pool_[i] = false;
+        }
+    }
+
+    /**
+     * Resets the registry to the default values and loads the saved values; see @ref ParamLogStorageBase::init().
+     */
+    int init()
+    {
+        registry_.resetToDefaults();
+        return ParamLogStorageBase::init();
+    }
+};
+
+// ----------------------------------------------------------------------------
+
+template <unsigned NumParams_>
+uint32_t ParamLogStorage<NumParams_>::getParamValue(unsigned index) const
+{
+    const ParamRegistryEntry& e = registry_.getEntry(index);
+    switch (e.kind)
+    {
+    case ParamRegistryEntry::KindInteger:
+    {
+        return uint32_t(*static_cast<const int32_t*>(e.storage));
+    }
+    case ParamRegistryEntry::KindReal:
+    {
+        return floatToWord(*static_cast<const float*>(e.storage));
+    }
+    case ParamRegistryEntry::KindBoolean:
+    {
+        return *static_cast<const bool*>(e.storage) ? 1U : 0U;
+    }
+    default:
+    {
+        UAVCAN_ASSERT(0);
+        return 0;
+    }
+    }
+}
+
+template <unsigned NumParams_>
+uint32_t ParamLogStorage<NumParams_>::getParamDefaultValue(unsigned index) const
+{
+    const ParamRegistryEntry& e = registry_.getEntry(index);
+    return (e.kind == ParamRegistryEntry::KindReal) ? floatToWord(e.real_default) : uint32_t(e.integer_default);
+}
+
+template <unsigned NumParams_>
+void ParamLogStorage<NumParams_>::setParamValue(unsigned index, uint32_t value)
+{
+    const ParamRegistryEntry& e = registry_.getEntry(index);
+    switch (e.kind)
+    {
+    case ParamRegistryEntry::KindInteger:
+    {
+        const int32_t x = int32_t(value);
+        *static_cast<int32_t*>(e.storage) = max(e.integer_min, min(x, e.integer_max));
+        break;
+    }
+    case ParamRegistryEntry::KindReal:
+    {
+        const float x = wordToFloat(value);
+        if (!isNaN(x))
+        {
+            *static_cast<float*>(e.storage) = max(e.real_min, min(x, e.real_max));
+        }
+        break;
+    }
+    case ParamRegistryEntry::KindBoolean:
+    {
+        *static_cast<bool*>(e.storage) = value != 0;
+        break;
+    }
+    default:
+    {
+        UAVCAN_ASSERT(0);
+        break;
+    }
+    }
+}
+
+}
+
+#endif // UAVCAN_PROTOCOL_PARAM_LOG_STORAGE_HPP_INCLUDED
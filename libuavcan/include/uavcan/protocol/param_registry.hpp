@@ -0,0 +1,354 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_PARAM_REGISTRY_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_PARAM_REGISTRY_HPP_INCLUDED
+
+#include <cstring>
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/protocol/param_server.hpp>
+
+namespace uavcan
+{
+/**
+ * One parameter of @ref ParamRegistry: its name, the variable that holds the value, and the value limits.
+ * Use the factory methods to declare the entries.
+ */
+struct UAVCAN_EXPORT ParamRegistryEntry
+{
+    enum Kind { KindInteger, KindReal, KindBoolean };
+
+    const char* name;
+    void* storage;                      ///< int32_t, float or bool, depending on the kind
+    Kind kind;
+    int32_t integer_default;            ///< Also used for booleans
+    int32_t integer_min;
+    int32_t integer_max;
+    float real_default;
+    float real_min;
+    float real_max;
+
+    static ParamRegistryEntry integer(const char* name, int32_t* storage, int32_t default_value,
+                                      int32_t min_value, int32_t max_value)
+    {
+        ParamRegistryEntry e = make(name, storage, KindInteger);
+        e.integer_default = default_value;
+        e.integer_min = min_value;
+        e.integer_max = max_value;
+        return e;
+    }
+
+    static ParamRegistryEntry real(const char* name, float* storage, float default_value,
+                                   float min_value, float max_value)
+    {
+        ParamRegistryEntry e = make(name, storage, KindReal);
+        e.real_default = default_value;
+        e.real_min = min_value;
+        e.real_max = max_value;
+        return e;
+    }
+
+    static ParamRegistryEntry boolean(const char* name, bool* storage, bool default_value)
+    {
+        ParamRegistryEntry e = make(name, storage, KindBoolean);
+        e.integer_default = default_value ? 1 : 0;
+        e.integer_max = 1;
+        return e;
+    }
+
+private:
+    static ParamRegistryEntry make(const char* name, void* storage, Kind kind)
+    {
+        ParamRegistryEntry e;
+        e.name = name;
+        e.storage = storage;
+        e.kind = kind;
+        e.integer_default = e.integer_min = e.integer_max = 0;
+        e.real_default = e.real_min = e.real_max = 0.0F;
+        return e;
+    }
+};
+
+/**
+ * Ready to use implementation of @ref IParamManager for the parameters that are plain variables of the
+ * application. The parameters are declared as a table:
+ *
+ *      static int32_t mode = 0;
+ *      static float gain = 1.0F;
+ *      static bool enabled = true;
+ *
+ *      static const uavcan::ParamRegistryEntry params[] =
+ *      {
+ *          uavcan::ParamRegistryEntry::integer("ctl.mode", &mode, 0, 0, 3),
+ *          uavcan::ParamRegistryEntry::real("ctl.gain", &gain, 1.0F, 0.0F, 10.0F),
+ *          uavcan::ParamRegistryEntry::boolean("ctl.enabled", &enabled, true)
+ *      };
+ *
+ *      class MyParamManager : public uavcan::ParamRegistry<3> { ... };  // Implements saving and erasing
+ *
+ * The parameter indexes follow the order of the table, so the lookup by index is a direct access. The table is
+ * indexed by name once, when the registry is constructed, so that the lookup by name is a binary search rather
+ * than a comparison with every name. All names must be unique.
+ *
+ * The assigned values are clamped to the limits of the parameter. Integer values can be assigned to real
+ * parameters; the other mismatching assignments are ignored.
+ *
+ * Persisting the parameters is up to the application, see @ref saveAllParams() and @ref eraseAllParams().
+ *
+ * @tparam NumParams_       Number of entries in the table.
+ */
+template <unsigned NumParams_>
+class UAVCAN_EXPORT ParamRegistry : public IParamManager
+{
+    const ParamRegistryEntry* const entries_;
+    uint16_t sorted_[NumParams_];       ///< Indexes of the entries ordered by name
+
+    static int compareNames(const char* a, const char* b)
+    {
+        return std::strncmp(a, b, Name::MaxSize);
+    }
+
+    void buildIndex();
+
+protected:
+    /**
+     * Called after a new value has been assigned to the parameter via @ref assignParamValue().
+     */
+    virtual void handleParamAssignment(const ParamRegistryEntry& entry) { (void)entry; }
+
+public:
+    explicit ParamRegistry(const ParamRegistryEntry (&entries)[NumParams_])
+        : entries_(entries)
+    {
+        StaticAssert<(NumParams_ > 0) && (NumParams_ <= 0xFFFFU)>::check();
+        buildIndex();
+    }
+
+    /**
+     * Returns the entry of the given name or null pointer if there's no such parameter.
+     * Complexity is O(log N).
+     */
+    const ParamRegistryEntry* findEntry(const char* name) const;
+
+    unsigned getNumParams() const { return NumParams_; }
+
+    const ParamRegistryEntry& getEntry(unsigned index) const
+    {
+        UAVCAN_ASSERT(index < NumParams_);
+        return entries_[index];
+    }
+
+    /**
+     * Assigns the default values to all parameters.
+     */
+    void resetToDefaults();
+
+    virtual void getParamNameByIndex(Index index, Name& out_name) const override
+    {
+        if (index < NumParams_)
+        {
+            out_name = entries_[index].name;
+        }
+    }
+
+    virtual void assignParamValue(const Name& name, const Value& value) override;
+
+    virtual void readParamValue(const Name& name, Value& out_value) const override;
+
+    virtual void readParamDefaultMaxMin(const Name& name, Value& out_default,
+                                        NumericValue& out_max, NumericValue& out_min) const override;
+};
+
+// ----------------------------------------------------------------------------
+
+template <unsigned NumParams_>
+void ParamRegistry<NumParams_>::buildIndex()
+{
+    // The table is usually small and sorted partially, if at all; insertion sort is fine
+    for (unsigned i = 0; i < NumParams_; i++)
+    {
+        unsigned pos = i;
+        while ((pos > 0) && (compareNames(entries_[sorted_[pos - 1]].name, entries_[i].name) > 0))
+        {
+            sorted_[pos] = sorted_[pos - 1];
+            pos--;
+        }
+        UAVCAN_ASSERT((pos == 0) || (compareNames(entries_[sorted_[pos - 1]].name, entries_[i].name) != 0));
+        sorted_[pos] = uint16_t(i);
+    }
+}
+
+template <unsigned NumParams_>
+const ParamRegistryEntry* ParamRegistry<NumParams_>::findEntry(const char* name) const
+{
+    unsigned low = 0;
+    unsigned high = NumParams_;
+    while (low < high)
+    {
+        const unsigned mid = low + (high - low) / 2U;
+        const ParamRegistryEntry& entry = entries_[sorted_[mid]];
+        const int cmp = compareNames(entry.name, name);
+        if (cmp == 0)
+        {
+            return &entry;
+        }
+        if (cmp < 0)
+        {
+            low = mid + 1U;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return UAVCAN_NULLPTR;
+}
+
+template <unsigned NumParams_>
+void ParamRegistry<NumParams_>::resetToDefaults()
+{
+    for (unsigned i = 0; i < NumParams_; i++)
+    {
+        const ParamRegistryEntry& e = entries_[i];
+        switch (e.kind)
+        {
+        case ParamRegistryEntry::KindInteger:
+        {
+            *static_cast<int32_t*>(e.storage) = e.integer_default;
+            break;
+        }
+        case ParamRegistryEntry::KindReal:
+        {
+            *static_cast<float*>(e.storage) = e.real_default;
+            break;
+        }
+        case ParamRegistryEntry::KindBoolean:
+        {
+            *static_cast<bool*>(e.storage) = e.integer_default != 0;
+            break;
+        }
+        default:
+        {
+            UAVCAN_ASSERT(0);
+            break;
+        }
+        }
+    }
+}
+
+template <unsigned NumParams_>
+void ParamRegistry<NumParams_>::assignParamValue(const Name& name, const Value& value)
+{
+    const ParamRegistryEntry* const e = findEntry(name.c_str());
+    if (e == UAVCAN_NULLPTR)
+    {
+        return;
+    }
+
+    if ((e->kind == ParamRegistryEntry::KindInteger) && value.is(Value::Tag::integer_value))
+    {
+        const int64_t x = value.integer_value;
+        *static_cast<int32_t*>(e->storage) = int32_t(max<int64_t>(e->integer_min, min<int64_t>(x, e->integer_max)));
+    }
+    else if ((e->kind == ParamRegistryEntry::KindReal) &&
+             (value.is(Value::Tag::real_value) || value.is(Value::Tag::integer_value)))
+    {
+        const float x = value.is(Value::Tag::real_value) ? value.real_value : float(value.integer_value);
+        if (isNaN(x))
+        {
+            UAVCAN_TRACE("ParamRegistry", "NaN assigned to '%s'", e->name);
+            return;
+        }
+        *static_cast<float*>(e->storage) = max(e->real_min, min(x, e->real_max));
+    }
+    else if ((e->kind == ParamRegistryEntry::KindBoolean) && value.is(Value::Tag::boolean_value))
+    {
+        *static_cast<bool*>(e->storage) = value.boolean_value != 0;
+    }
+    else
+    {
+        UAVCAN_TRACE("ParamRegistry", "Type mismatch for '%s'", e->name);
+        return;
+    }
+
+    handleParamAssignment(*e);
+}
+
+template <unsigned NumParams_>
+void ParamRegistry<NumParams_>::readParamValue(const Name& name, Value& out_value) const
+{
+    const ParamRegistryEntry* const e = findEntry(name.c_str());
+    if (e == UAVCAN_NULLPTR)
+    {
+        return;
+    }
+
+    switch (e->kind)
+    {
+    case ParamRegistryEntry::KindInteger:
+    {
+        out_value.to<Value::Tag::integer_value>() = *static_cast<const int32_t*>(e->storage);
+        break;
+    }
+    case ParamRegistryEntry::KindReal:
+    {
+        out_value.to<Value::Tag::real_value>() = *static_cast<const float*>(e->storage);
+        break;
+    }
+    case ParamRegistryEntry::KindBoolean:
+    {
+        out_value.to<Value::Tag::boolean_value>() = *static_cast<const bool*>(e->storage);
+        break;
+    }
+    default:
+    {
+        UAVCAN_ASSERT(0);
+        break;
+    }
+    }
+}
+
+template <unsigned NumParams_>
+void ParamRegistry<NumParams_>::readParamDefaultMaxMin(const Name& name, Value& out_default,
+                                                       NumericValue& out_max, NumericValue& out_min) const
+{
+    const ParamRegistryEntry* const e = findEntry(name.c_str());
+    if (e == UAVCAN_NULLPTR)
+    {
+        return;
+    }
+
+    switch (e->kind)
+    {
+    case ParamRegistryEntry::KindInteger:
+    {
+        out_default.to<Value::Tag::integer_value>() = e->integer_default;
+        out_max.to<NumericValue::Tag::integer_value>() = e->integer_max;
+        out_min.to<NumericValue::Tag::integer_value>() = e->integer_min;
+        break;
+    }
+    case ParamRegistryEntry::KindReal:
+    {
+        out_default.to<Value::Tag::real_value>() = e->real_default;
+        out_max.to<NumericValue::Tag::real_value>() = e->real_max;
+        out_min.to<NumericValue::Tag::real_value>() = e->real_min;
+        break;
+    }
+    case ParamRegistryEntry::KindBoolean:
+    {
+        out_default.to<Value::Tag::boolean_value>() = e->integer_default != 0;
+        break;
+    }
+    default:
+    {
+        UAVCAN_ASSERT(0);
+        break;
+    }
+    }
+}
+
+}
+
+#endif // UAVCAN_PROTOCOL_PARAM_REGISTRY_HPP_INCLUDED
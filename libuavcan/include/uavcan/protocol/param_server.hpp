@@ -74,6 +74,10 @@ public:
 /**
  * Convenience class for supporting the standard configuration services.
  * Highly recommended to use.
+ *
+ * Every request is served as soon as it is received, so a client may send many requests, e.g. for all of the
+ * parameter indexes, without waiting for the responses. The lookup cost is defined by the param manager;
+ * @ref ParamRegistry implements it with constant-time lookup by index and logarithmic lookup by name.
  */
 class UAVCAN_EXPORT ParamServer
 {
@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_READ_AHEAD_FILE_SERVER_BACKEND_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_READ_AHEAD_FILE_SERVER_BACKEND_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/protocol/file_server.hpp>
+
+namespace uavcan
+{
+/**
+ * Read cache that can be placed in front of any other file server backend, so that the file server can serve
+ * many nodes reading the same files, e.g. updating the firmware at the same time, without going to the storage
+ * for every request:
+ *
+ *      MyBackend my_backend;
+ *      uavcan::ReadAheadFileServerBackend<8> cached_backend(my_backend);
+ *      uavcan::BasicFileServer server(node, cached_backend);
+ *
+ * Files are read from the underlying backend in whole blocks, which are kept in memory and shared between all
+ * requesters; when a new block is needed, the least recently used one is replaced. Once a request has been
+ * served from a block, the blocks that follow it are loaded in advance, so that the next sequential requests of
+ * all requesters are served from memory.
+ *
+ * The cache assumes that the files are not modified behind its back while they are being read; otherwise,
+ * @ref invalidate() should be called. Modifications made through this backend invalidate the affected blocks.
+ *
+ * @tparam NumBlocks_           Number of the cached blocks. Each block also keeps the path of its file.
+ * @tparam BlockSize_           Size of a block in bytes; several read sizes are recommended.
+ * @tparam ReadAheadBlocks_     Number of the blocks loaded in advance; zero disables read-ahead.
+ */
+template <unsigned NumBlocks_,
+          unsigned BlockSize_ = 4U * unsigned(IFileServerBackend::ReadSize),
+          unsigned ReadAheadBlocks_ = 1>
+class UAVCAN_EXPORT ReadAheadFileServerBackend : public IFileServerBackend
+{
+    struct Block
+    {
+        Path path;
+        uint64_t index;             ///< Offset divided by the block size
+        uint32_t last_use;
+        uint16_t size;              ///< Less than the block size if the end of file is in this block
+        bool valid;
+        uint8_t data[BlockSize_];
+
+        Block()
+            : index(0)
+            , last_use(0)
+            , size(0)
+            , valid(false)
+        { }
+    };
+
+    IFileServerBackend& backend_;
+    Block blocks_[NumBlocks_];
+    uint32_t use_counter_;
+    uint32_t num_hits_;
+    uint32_t num_misses_;
+    uint32_t num_prefetches_;
+
+    void syncRootPaths();
+
+    Block* findBlock(const Path& path, uint64_t index);
+
+    /**
+     * Returns the error code of the underlying backend.
+     */
+    int16_t loadBlock(const Path& path, uint64_t index, Block*& out_block);
+
+    void prefetch(const Path& path, uint64_t index);
+
+public:
+    explicit ReadAheadFileServerBackend(IFileServerBackend& backend)
+        : backend_(backend)
+        , use_counter_(0)
+        , num_hits_(0)
+        , num_misses_(0)
+        , num_prefetches_(0)
+    {
+        StaticAssert<(NumBlocks_ > 0)>::check();
+        StaticAssert<(BlockSize_ > 0) && (BlockSize_ <= 0xFFFFU)>::check();
+    }
+
+    virtual int16_t getInfo(const Path& path, uint64_t& out_size, EntryType& out_type) override
+    {
+        syncRootPaths();
+        return backend_.getInfo(path, out_size, out_type);
+    }
+
+    virtual int16_t read(const Path& path, const uint64_t offset, uint8_t* out_buffer, uint16_t& inout_size)
+        override;
+
+    virtual int16_t write(const Path& path, const uint64_t offset, const uint8_t* buffer, const uint16_t size)
+        override
+    {
+        syncRootPaths();
+        invalidate(path);
+        return backend_.write(path, offset, buffer, size);
+    }
+
+    virtual int16_t remove(const Path& path) override
+    {
+        syncRootPaths();
+        invalidate(path);
+        return backend_.remove(path);
+    }
+
+    virtual int16_t getDirectoryEntryInfo(const Path& directory_path, const uint32_t entry_index,
+                                          EntryType& out_type, Path& out_entry_full_path) override
+    {
+        syncRootPaths();
+        return backend_.getDirectoryEntryInfo(directory_path, entry_index, out_type, out_entry_full_path);
+    }
+
+    /**
+     * Discards all cached blocks.
+     */
+    void invalidate()
+    {
+        for (unsigned i = 0; i < NumBlocks_; i++)
+        {
+            blocks_[i].valid = false;
+        }
+    }
+
+    /**
+     * Discards the cached blocks of the given file.
+     */
+    void invalidate(const Path& path)
+    {
+        for (unsigned i = 0; i < NumBlocks_; i++)
+        {
+            if (blocks_[i].valid && (blocks_[i].path == path))
+            {
+                blocks_[i].valid = false;
+            }
+        }
+    }
+
+    /**
+     * Number of the blocks that the read requests have been served from without going to the underlying backend,
+     * and the number of those that had to be loaded on demand.
+     */
+    uint32_t getNumHits() const { return num_hits_; }
+    uint32_t getNumMisses() const { return num_misses_; }
+
+    /**
+     * Number of the blocks that have been loaded in advance.
+     */
+    uint32_t getNumPrefetches() const { return num_prefetches_; }
+};
+
+// ----------------------------------------------------------------------------
+
+template <unsigned NumBlocks_, unsigned BlockSize_, unsigned ReadAheadBlocks_>
+void ReadAheadFileServerBackend<NumBlocks_, BlockSize_, ReadAheadBlocks_>::syncRootPaths()
+{
+    // The file server configures the root paths of this backend only, but the underlying one resolves them
+    if ((backend_.getRootPath() != getRootPath()) || (backend_.getAltRootPath() != getAltRootPath()))
+    {
+        backend_.getRootPath() = getRootPath();
+        backend_.getAltRootPath() = getAltRootPath();
+        invalidate();
+    }
+}
+
+template <unsigned NumBlocks_, unsigned BlockSize_, unsigned ReadAheadBlocks_>
+typename ReadAheadFileServerBackend<NumBlocks_, BlockSize_, ReadAheadBlocks_>::Block*
+ReadAheadFileServerBackend<NumBlocks_, BlockSize_, ReadAheadBlocks_>::findBlock(const Path& path, uint64_t index)
+{
+    for (unsigned i = 0; i < NumBlocks_; i++)
+    {
+        Block& b = blocks_[i];
+        if (b.valid && (b.index == index) && (b.path == path))
+        {
+            return &b;
+        }
+    }
+    return UAVCAN_NULLPTR;
+}
+
+template <unsigned NumBlocks_, unsigned BlockSize_, unsigned ReadAheadBlocks_>
+int16_t ReadAheadFileServerBackend<NumBlocks_, BlockSize_, ReadAheadBlocks_>::loadBlock(const Path& path,
+                                                                                        uint64_t index,
+                                                                                        Block*& out_block)
+{
+    Block* victim = &blocks_[0];
+    for (unsigned i = 0; (i < NumBlocks_) && victim->valid; i++)
+    {
+        if (!blocks_[i].valid || (blocks_[i].last_use < victim->last_use))
+        {
+            victim = &blocks_[i];
+        }
+    }
+
+    victim->valid = false;
+    uint16_t size = uint16_t(BlockSize_);
+    const int16_t res = backend_.read(path, index * BlockSize_, victim->data, size);
+    if (res != Error::OK)
+    {
+        return res;
+    }
+    if (size > BlockSize_)
+    {
+        UAVCAN_ASSERT(0);
+        return Error::UNKNOWN_ERROR;
+    }
+
+    victim->path = path;
+    victim->index = index;
+    victim->size = size;
+    victim->last_use = ++use_counter_;
+    victim->valid = true;
+    out_block = victim;
+    return Error::OK;
+}
+
+template <unsigned NumBlocks_, unsigned BlockSize_, unsigned ReadAheadBlocks_>
+void ReadAheadFileServerBackend<NumBlocks_, BlockSize_, ReadAheadBlocks_>::prefetch(const Path& path, uint64_t index)
+{
+    for (unsigned i = 0; i < ReadAheadBlocks_; i++)
+    {
+        if (findBlock(path, index + i) == UAVCAN_NULLPTR)
+        {
+            Block* block = UAVCAN_NULLPTR;
+            if (loadBlock(path, index + i, block) != Error::OK)
+            {
+                break;
+            }
+            num_prefetches_++;
+            if (block->size < BlockSize_)
+            {
+                break;                      // End of file
+            }
+        }
+    }
+}
+
+template <unsigned NumBlocks_, unsigned BlockSize_, unsigned ReadAheadBlocks_>
+int16_t ReadAheadFileServerBackend<NumBlocks_, BlockSize_, ReadAheadBlocks_>::read(const Path& path,
+                                                                                   const uint64_t offset,
+                                                                                   uint8_t* out_buffer,
+                                                                                   uint16_t& inout_size)
+{
+    syncRootPaths();
+
+    const unsigned requested = inout_size;
+    unsigned done = 0;
+    bool end_of_file = false;
+    uint64_t index = offset / BlockSize_;
+
+    while ((done < requested) && !end_of_file)
+    {
+        index = (offset + done) / BlockSize_;
+        const unsigned pos_in_block = unsigned((offset + done) % BlockSize_);
+
+        Block* block = findBlock(path, index);
+        if (block != UAVCAN_NULLPTR)
+        {
+            block->last_use = ++use_counter_;
+            num_hits_++;
+        }
+        else
+        {
+            const int16_t res = loadBlock(path, index, block);
+            if (res != Error::OK)
+            {
+                if (done == 0)
+                {
+                    return res;
+                }
+                break;                      // Serving what has been read, the next request will fail
+            }
+            num_misses_++;
+        }
+
+        end_of_file = block->size < BlockSize_;
+        if (pos_in_block >= block->size)
+        {
+            break;
+        }
+        const unsigned len = min(unsigned(block->size) - pos_in_block, requested - done);
+        (void)copy(block->data + pos_in_block, block->data + pos_in_block + len, out_buffer + done);
+        done += len;
+    }
+
+    inout_size = uint16_t(done);
+
+    if ((done > 0) && !end_of_file)
+    {
+        prefetch(path, index + 1U);
+    }
+    return Error::OK;
+}
+
+}
+
+#endif // UAVCAN_PROTOCOL_READ_AHEAD_FILE_SERVER_BACKEND_HPP_INCLUDED
@@ -15,6 +15,10 @@ namespace uavcan
 /**
  * This class provides statistics about the transport layer performance on the local node.
  * The user's application does not deal with this class directly because it's instantiated by the node class.
+ *
+ * The service response carries only the totals defined by the data type. The extended statistics (per data type
+ * counters, errors by cause, latency histograms; see @ref TransportStats) are exposed to the local application
+ * through the accessors below.
  */
 class UAVCAN_EXPORT TransportStatsProvider : Noncopyable
 {
@@ -58,6 +62,31 @@ public:
     {
         return srv_.start(GetTransportStatsCallback(this, &TransportStatsProvider::handleGetTransportStats));
     }
+
+    /**
+     * Extended statistics of the transfers; all of them read zero if @ref UAVCAN_TRANSPORT_STATS is disabled.
+     */
+    const TransportStats& getTransportStats() const
+    {
+        return srv_.getNode().getDispatcher().getTransferPerfCounter().getTransportStats();
+    }
+
+    /**
+     * Time the frames spent in the TX queues, see @ref CanIOManager::getTxQueueWaitHistogram().
+     */
+    const LatencyHistogram& getTxQueueWaitHistogram() const
+    {
+        return srv_.getNode().getDispatcher().getCanIOManager().getTxQueueWaitHistogram();
+    }
+
+    /**
+     * Resets the extended statistics. The totals reported via the service are not affected.
+     */
+    void resetTransportStats()
+    {
+        srv_.getNode().getDispatcher().getTransferPerfCounter().getTransportStats().reset();
+        srv_.getNode().getDispatcher().getCanIOManager().resetTxQueueWaitHistogram();
+    }
 };
 
 }
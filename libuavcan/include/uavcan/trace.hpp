@@ -0,0 +1,203 @@
+/*
+ * Structured trace points of the hot paths.
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRACE_HPP_INCLUDED
+#define UAVCAN_TRACE_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/util/templates.hpp>
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+# include <atomic>
+# include <uavcan/driver/system_clock.hpp>
+#endif
+
+namespace uavcan
+{
+/**
+ * Trace events. The meaning of the arguments is given for every event as arg0; arg1; arg2.
+ */
+enum TraceEventID
+{
+    TraceEventRxFrame,              ///< Dispatcher got a frame: CAN ID; 0; interface index
+    TraceEventReceiverFrame,        ///< Frame is passed to a transfer receiver: data type ID << 8 | source node ID;
+                                    ///< buffer write position; tail byte (SOT, EOT, toggle, transfer ID)
+    TraceEventReceiverError,        ///< Transfer receiver has registered an error: 0; 0; TransferErrorCause
+    TraceEventTxQueuePush,          ///< Frame is pushed into a TX queue: CAN ID; 0; queue index
+    TraceEventTxQueuePeek,          ///< Frame is taken from a TX queue for transmission: CAN ID; 0; queue index
+    TraceEventTxQueueRemove,        ///< Frame leaves a TX queue: CAN ID; 0; queue index
+    TraceEventTransferSend,         ///< Transfer is being sent: data type ID; payload length; transfer ID
+    TraceEventSubscriberDelivery,   ///< Subscriber callback is invoked: data type ID; source node ID; transfer ID
+    TraceEventSubscriberDone,       ///< Subscriber callback has returned: 0; source node ID; transfer ID
+    NumTraceEvents
+};
+
+/**
+ * Receives the events of the trace points, see @ref UAVCAN_TRACE_POINTS.
+ * The sink is invoked synchronously from the hot paths of the library, so it must be fast and must not call back
+ * into the library. If several nodes run in different threads, the sink will be invoked concurrently.
+ */
+class UAVCAN_EXPORT ITraceSink
+{
+public:
+    virtual ~ITraceSink() { }
+
+    virtual void handleTraceEvent(TraceEventID event, uint32_t arg0, uint16_t arg1, uint8_t arg2) = 0;
+};
+
+#if UAVCAN_TRACE_POINTS
+
+/**
+ * Installs the sink for all nodes of the process; null removes it. The sink must outlive its installation.
+ * The installation is not synchronized with the trace points, so it should take place before the nodes are started.
+ */
+UAVCAN_EXPORT void setTraceSink(ITraceSink* sink);
+
+UAVCAN_EXPORT ITraceSink* getTraceSink();
+
+template <TraceEventID Event>
+struct UAVCAN_EXPORT IsTraceEventEnabled
+{
+    enum { Result = ((uint32_t(UAVCAN_TRACE_POINTS) >> unsigned(Event)) & 1U) != 0 };
+};
+
+/**
+ * Use @ref UAVCAN_TRACE_POINT instead; the disabled events are removed at compile time.
+ */
+template <TraceEventID Event>
+inline void emitTraceEvent(uint32_t arg0, uint16_t arg1, uint8_t arg2)
+{
+    if (IsTraceEventEnabled<Event>::Result)
+    {
+        ITraceSink* const sink = getTraceSink();
+        if (sink != UAVCAN_NULLPTR)
+        {
+            sink->handleTraceEvent(Event, arg0, arg1, arg2);
+        }
+    }
+}
+
+# define UAVCAN_TRACE_POINT(event, arg0, arg1, arg2) \
+    ::uavcan::emitTraceEvent< ::uavcan::event >(uint32_t(arg0), uint16_t(arg1), uint8_t(arg2))
+
+#else
+
+# define UAVCAN_TRACE_POINT(event, arg0, arg1, arg2) ((void)0)
+
+#endif
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+
+/**
+ * Trace sink that keeps the latest events in a ring buffer in RAM, for postmortem analysis of latency spikes,
+ * e.g. from a debugger or from a crash handler.
+ *
+ * Recording is lock-free: every writer claims a slot with an atomic increment and marks the slot with its sequence
+ * number once the record is complete, so concurrent writers and readers never block each other. A record that is
+ * being overwritten while it is read is skipped by the reader.
+ *
+ * @tparam Capacity     Number of records, must be a power of two. Each record takes 20 bytes.
+ */
+template <unsigned Capacity>
+class UAVCAN_EXPORT TraceRingBuffer : public ITraceSink, Noncopyable
+{
+public:
+    struct Record
+    {
+        uint32_t sequence;      ///< Number of the event since the last reset, starting from one
+        uint32_t ts_usec;       ///< Lower 32 bits of the monotonic time
+        uint32_t arg0;
+        uint16_t arg1;
+        uint8_t event;          ///< TraceEventID
+        uint8_t arg2;
+    };
+
+private:
+    struct Slot
+    {
+        std::atomic<uint32_t> sequence;     ///< Zero while the record is being written
+        Record record;
+    };
+
+    ISystemClock& clock_;
+    Slot slots_[Capacity];
+    std::atomic<uint32_t> next_sequence_;
+
+public:
+    explicit TraceRingBuffer(ISystemClock& clock)
+        : clock_(clock)
+    {
+        StaticAssert<(Capacity > 0) && ((Capacity & (Capacity - 1U)) == 0)>::check();
+        reset();
+    }
+
+    virtual void handleTraceEvent(TraceEventID event, uint32_t arg0, uint16_t arg1, uint8_t arg2) override
+    {
+        const uint32_t sequence = next_sequence_.fetch_add(1U, std::memory_order_relaxed) + 1U;
+        Slot& slot = slots_[sequence & (Capacity - 1U)];
+
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.record.sequence = sequence;
+        slot.record.ts_usec = uint32_t(clock_.getMonotonic().toUSec());
+        slot.record.arg0 = arg0;
+        slot.record.arg1 = arg1;
+        slot.record.event = uint8_t(event);
+        slot.record.arg2 = arg2;
+        slot.sequence.store(sequence, std::memory_order_release);
+    }
+
+    /**
+     * Copies up to max_records latest records into the output array, oldest first.
+     * Returns the number of records copied.
+     */
+    unsigned copyLatest(Record* out_records, unsigned max_records) const
+    {
+        const uint32_t last = next_sequence_.load(std::memory_order_acquire);
+        const uint32_t num_available = min(last, uint32_t(Capacity));
+        const uint32_t num_wanted = min(num_available, uint32_t(max_records));
+
+        unsigned num_copied = 0;
+        for (uint32_t sequence = last - num_wanted + 1U; sequence != (last + 1U); sequence++)
+        {
+            const Slot& slot = slots_[sequence & (Capacity - 1U)];
+            if (slot.sequence.load(std::memory_order_acquire) != sequence)
+            {
+                continue;                   // Being written or already overwritten
+            }
+            const Record record = slot.record;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) == sequence)
+            {
+                out_records[num_copied++] = record;
+            }
+        }
+        return num_copied;
+    }
+
+    /**
+     * Total number of events since the last reset, including the overwritten ones.
+     */
+    uint32_t getNumEvents() const { return next_sequence_.load(std::memory_order_relaxed); }
+
+    /**
+     * Must not be called while the sink is installed.
+     */
+    void reset()
+    {
+        for (unsigned i = 0; i < Capacity; i++)
+        {
+            slots_[i].sequence.store(0, std::memory_order_relaxed);
+        }
+        next_sequence_.store(0, std::memory_order_release);
+    }
+};
+
+#endif
+
+}
+
+#endif // UAVCAN_TRACE_HPP_INCLUDED
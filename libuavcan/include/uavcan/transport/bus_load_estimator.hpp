@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_BUS_LOAD_ESTIMATOR_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_BUS_LOAD_ESTIMATOR_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/time.hpp>
+#include <uavcan/util/templates.hpp>
+#include <uavcan/driver/can.hpp>
+
+namespace uavcan
+{
+/**
+ * Estimates the utilization of a CAN bus from the frames that have been seen on it, over a sliding window.
+ * The window is split into @ref NumBuckets buckets; each bucket accumulates the time the bus was occupied by the
+ * frames that were registered within it, and the buckets older than the window are discarded.
+ *
+ * The length of a frame is estimated from its format and payload length, see @ref estimateFrameLength().
+ * The stuff bits depend on the exact content of the frame, so they are not computed but estimated as one stuff bit
+ * per five stuffable bits, which lies between the typical and the worst case. The estimate is therefore somewhat
+ * pessimistic, which is what the throttling of bulk traffic needs.
+ *
+ * The bit rate is not known to the library; it defaults to 1 Mbit/s and must be configured by the application
+ * if it is different, see @ref setBitrate().
+ */
+class UAVCAN_EXPORT BusLoadEstimator
+{
+public:
+    enum { NumBuckets = 8 };
+    enum { DefaultBitrate = 1000000 };
+
+    /**
+     * Number of bits of a frame transmitted at the nominal (arbitration) bit rate and at the data bit rate.
+     * The data phase is only present in CAN FD frames with bit rate switching.
+     */
+    struct FrameLength
+    {
+        uint16_t nominal_bits;
+        uint16_t data_bits;
+
+        FrameLength()
+            : nominal_bits(0)
+            , data_bits(0)
+        { }
+    };
+
+private:
+    uint32_t busy_nsec_[NumBuckets];
+    uint32_t bucket_numbers_[NumBuckets];   ///< Absolute number of the bucket that is stored in the slot
+    uint32_t bucket_usec_;
+    uint32_t nominal_bit_nsec_;
+    uint32_t data_bit_nsec_;
+
+    uint32_t getBucketNumber(MonotonicTime ts) const { return uint32_t(ts.toUSec() / bucket_usec_); }
+
+public:
+    BusLoadEstimator()
+        : bucket_usec_(uint32_t(getDefaultWindow().toUSec() / NumBuckets))
+        , nominal_bit_nsec_(1000000000U / DefaultBitrate)
+        , data_bit_nsec_(1000000000U / DefaultBitrate)
+    {
+        reset();
+    }
+
+    static MonotonicDuration getDefaultWindow() { return MonotonicDuration::fromMSec(1000); }
+    static MonotonicDuration getMinWindow() { return MonotonicDuration::fromMSec(NumBuckets * 10); }
+    static MonotonicDuration getMaxWindow() { return MonotonicDuration::fromMSec(30000); }
+
+    static FrameLength estimateFrameLength(const CanFrame& frame);
+
+    /**
+     * Data bit rate applies to CAN FD frames only; zero means that the bit rate is not switched.
+     * Bit rates that are not known to the application can be left at the default.
+     */
+    void setBitrate(uint32_t nominal_bitrate, uint32_t data_bitrate = 0);
+
+    /**
+     * Length of the averaging window; it is constrained by @ref getMinWindow() and @ref getMaxWindow().
+     * Resets the estimator.
+     */
+    void setWindow(MonotonicDuration window);
+    MonotonicDuration getWindow() const { return MonotonicDuration::fromUSec(int64_t(bucket_usec_) * NumBuckets); }
+
+    /**
+     * Registers a frame that has appeared on the bus at the specified time.
+     */
+    void addFrame(const CanFrame& frame, MonotonicTime ts);
+
+    /**
+     * Bus utilization over the window that ends at the specified time, in percent, 0 to 100.
+     */
+    uint8_t getLoadPercent(MonotonicTime ts) const;
+
+    void reset();
+};
+
+}
+
+#endif // UAVCAN_TRANSPORT_BUS_LOAD_ESTIMATOR_HPP_INCLUDED
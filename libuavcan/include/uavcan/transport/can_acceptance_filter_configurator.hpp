@@ -11,11 +11,92 @@
 #include <uavcan/error.hpp>
 #include <uavcan/transport/dispatcher.hpp>
 #include <uavcan/node/abstract_node.hpp>
+#include <uavcan/node/timer.hpp>
 #include <uavcan/build_config.hpp>
 #include <uavcan/util/multiset.hpp>
 
 namespace uavcan
 {
+#if !UAVCAN_TINY
+/**
+ * This class collects statistics of the incoming CAN traffic for the cost model of
+ * @ref CanAcceptanceFilterConfigurator, which uses it to prefer filter merges that let through fewer frames
+ * nobody is interested in.
+ *
+ * Frames are counted per class, where the class is defined by the CAN ID fields relevant for acceptance filtering:
+ * data type ID, destination node ID, request/response and service/message flags. Priority is ignored, and the source
+ * node ID is only tracked as anonymous/non-anonymous, so that the statistics don't grow with the number of nodes.
+ *
+ * The monitor should be installed as the RX frame listener of the dispatcher, see
+ * @ref Dispatcher::installRxFrameListener(). Note that only frames that passed the hardware filters can be observed,
+ * so the statistics should be collected with the filters open (or at least before they are tightened).
+ */
+class UAVCAN_EXPORT CanBusTrafficMonitor : public IRxFrameListener
+{
+public:
+    enum { Capacity = UAVCAN_CAN_TRAFFIC_MONITOR_CAPACITY };
+
+    struct Entry
+    {
+        uint32_t key;       ///< Frame class, see makeKey(); zero if the entry is not used
+        uint32_t count;
+    };
+
+private:
+    static const uint32_t CountLimit = 1UL << 31;   ///< All counters are halved when this value is reached
+
+    Entry entries_[Capacity];
+    uint32_t num_untracked_frames_;
+    uint16_t num_entries_;
+
+    static unsigned computeHash(uint32_t key);
+
+public:
+    CanBusTrafficMonitor() { reset(); }
+
+    /**
+     * Maps a CAN ID (including flags) to its frame class.
+     */
+    static uint32_t makeKey(uint32_t can_id);
+
+    /**
+     * Whether frames of the given class will pass the given filter.
+     * Frames of non-anonymous classes are assumed to pass any filter on the source node ID, except a filter that
+     * accepts anonymous frames only.
+     */
+    static bool isAcceptedBy(uint32_t key, const CanFilterConfig& cfg);
+
+    virtual void handleRxFrame(const CanRxFrame& frame, CanIOFlags flags) override;
+
+    /**
+     * Accounts for frames with the given CAN ID without observing them on the bus, e.g. from a known bus schedule.
+     */
+    void addFrames(uint32_t can_id, uint32_t count);
+
+    /**
+     * Number of observed frames that would pass the given filter.
+     */
+    uint32_t countAcceptedFrames(const CanFilterConfig& cfg) const;
+
+    void reset();
+
+    /**
+     * Entries are stored in a hash table; unused entries have zero key.
+     */
+    const Entry& getEntry(unsigned index) const
+    {
+        UAVCAN_ASSERT(index < Capacity);
+        return entries_[index];
+    }
+
+    unsigned getNumEntries() const { return num_entries_; }
+
+    /**
+     * Number of frames that could not be classified because the table was full.
+     */
+    uint32_t getNumUntrackedFrames() const { return num_untracked_frames_; }
+};
+#endif
 /**
  * This class configures hardware acceptance filters (if this feature is present on the particular CAN driver) to
  * preclude reception of irrelevant CAN frames on the hardware level.
@@ -75,6 +156,14 @@ private:
     static uint8_t countBits(uint32_t n_);
     uint16_t getNumFilters() const;
 
+#if !UAVCAN_TINY
+    /**
+     * Number of observed frames accepted by the merged config that are not accepted by any of the current configs.
+     * @param accepted  For every entry of the traffic monitor, whether it is accepted by the current configs.
+     */
+    uint32_t computeMergeCost(const CanFilterConfig& merged, const bool* accepted) const;
+#endif
+
     /**
      * Fills the multiset_configs_ to proceed it with mergeConfigurations()
      */
@@ -89,6 +178,9 @@ private:
     INode& node_;               //< Node reference is needed for access to ICanDriver and Dispatcher
     MultisetConfigContainer multiset_configs_;
     uint16_t filters_number_;
+#if !UAVCAN_TINY
+    const CanBusTrafficMonitor* traffic_monitor_;
+#endif
 
 public:
     /**
@@ -102,8 +194,20 @@ public:
         : node_(node)
         , multiset_configs_(node.getAllocator())
         , filters_number_(filters_number)
+#if !UAVCAN_TINY
+        , traffic_monitor_(UAVCAN_NULLPTR)
+#endif
     { }
 
+#if !UAVCAN_TINY
+    /**
+     * Enables the cost model: when configurations have to be merged, the merge that lets through the least number
+     * of unwanted frames observed by the monitor is chosen; ties are resolved by the number of mask bits as usual.
+     * The monitor must outlive computeConfiguration() and applyConfiguration(). Pass null to disable.
+     */
+    void setTrafficMonitor(const CanBusTrafficMonitor* monitor) { traffic_monitor_ = monitor; }
+#endif
+
     /**
      * This method invokes loadInputConfiguration() and mergeConfigurations() consequently
      * in order to comute optimal filter configurations for the current hardware.
@@ -166,6 +270,84 @@ static inline int configureCanAcceptanceFilters(INode& node,
     return cfger.applyConfiguration();
 }
 
+#if !UAVCAN_TINY
+/**
+ * This class keeps the hardware acceptance filters up to date: it periodically checks whether the set of
+ * subscriptions or the node ID has changed, and reconfigures the filters if it did. It also runs a
+ * @ref CanBusTrafficMonitor, which is installed as the RX frame listener of the dispatcher, to feed the cost model of
+ * the configurator with the observed bus traffic.
+ *
+ * If the application needs its own RX frame listener, it can forward the frames to getTrafficMonitor().
+ */
+class UAVCAN_EXPORT CanAcceptanceFilterUpdater : private TimerBase
+{
+public:
+    enum { DefaultUpdateIntervalMs = 1000 };
+
+private:
+    INode& node_;
+    CanBusTrafficMonitor traffic_monitor_;
+    const CanAcceptanceFilterConfigurator::AnonymousMessages mode_;
+    const uint16_t filters_number_;
+    uint32_t applied_signature_;
+    int last_result_;
+    bool applied_;
+
+    uint32_t computeSignature();
+
+    virtual void handleTimerEvent(const TimerEvent&) override { (void)update(false); }
+
+public:
+    /**
+     * @param node              Refer to @ref CanAcceptanceFilterConfigurator.
+     * @param mode              Refer to @ref CanAcceptanceFilterConfigurator::computeConfiguration().
+     * @param filters_number    Refer to @ref CanAcceptanceFilterConfigurator.
+     */
+    explicit CanAcceptanceFilterUpdater(INode& node,
+                                        CanAcceptanceFilterConfigurator::AnonymousMessages mode
+                                            = CanAcceptanceFilterConfigurator::AcceptAnonymousMessages,
+                                        uint16_t filters_number = 0)
+        : TimerBase(node)
+        , node_(node)
+        , mode_(mode)
+        , filters_number_(filters_number)
+        , applied_signature_(0)
+        , last_result_(0)
+        , applied_(false)
+    { }
+
+    virtual ~CanAcceptanceFilterUpdater() { stop(); }
+
+    /**
+     * Installs the traffic monitor and starts periodic updates.
+     * The filters are not configured until the first update, so that the monitor can observe the unfiltered
+     * traffic for one update interval; call update() to configure them immediately.
+     */
+    void start(MonotonicDuration update_interval = MonotonicDuration::fromMSec(DefaultUpdateIntervalMs));
+
+    /**
+     * Stops periodic updates and removes the traffic monitor from the dispatcher.
+     * The filters that were applied last stay in effect.
+     */
+    void stop();
+
+    /**
+     * Reconfigures the filters if the subscriptions have changed since the last successful update, or if forced.
+     * @return 0 = success or nothing to do, negative for error.
+     */
+    int update(bool force = true);
+
+    /**
+     * Result of the last update attempt; 0 = success, negative for error.
+     */
+    int getLastResult() const { return last_result_; }
+
+    bool isRunning() const { return TimerBase::isRunning(); }
+
+    CanBusTrafficMonitor& getTrafficMonitor() { return traffic_monitor_; }
+};
+#endif
+
 }
 
 #endif
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_CAN_FRAME_BRIDGE_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_CAN_FRAME_BRIDGE_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/data_type.hpp>
+#include <uavcan/driver/can.hpp>
+#include <uavcan/driver/system_clock.hpp>
+#include <uavcan/transport/transfer.hpp>
+#include <uavcan/transport/can_io.hpp>
+#include <uavcan/transport/dispatcher.hpp>
+
+namespace uavcan
+{
+#if !UAVCAN_TINY
+/**
+ * Forwards selected CAN frames from one network to another without reassembling or decoding the transfers,
+ * which is what a gateway between two physical networks needs. The frames are sent unchanged, so the priority,
+ * the node IDs and the transfer IDs are preserved; the node IDs must therefore be unique across both networks.
+ *
+ * The bridge is installed as the RX frame listener of the dispatcher of the source network, see
+ * @ref Dispatcher::installRxFrameListener(), and enqueues the matching frames into the CAN IO manager of the
+ * destination network. Loopback frames are never forwarded, so two bridges can connect two networks in both
+ * directions without creating a loop. The hardware acceptance filters of the source network must let the routed
+ * frames through.
+ *
+ * The routes are compiled into CAN ID/mask pairs once they are added, so that matching a frame costs a few
+ * bitwise operations per route. The first matching route wins. Frames of a multi-frame transfer are forwarded
+ * one by one; if the destination TX queue runs out of memory, the transfer will be incomplete, same as with any
+ * other lost frame.
+ */
+class UAVCAN_EXPORT CanFrameBridge : public IRxFrameListener, Noncopyable
+{
+public:
+    enum { MaxRoutes = UAVCAN_CAN_FRAME_BRIDGE_MAX_ROUTES };
+    enum { DefaultTxTimeoutMs = 100 };
+
+    struct Route
+    {
+        uint32_t can_id;
+        uint32_t mask;
+        uint8_t iface_mask;     ///< Interfaces of the destination network to forward to
+
+        Route()
+            : can_id(0)
+            , mask(0)
+            , iface_mask(0)
+        { }
+
+        bool matches(uint32_t frame_can_id) const { return ((frame_can_id ^ can_id) & mask) == 0; }
+    };
+
+private:
+    CanIOManager& target_;
+    ISystemClock& sysclock_;
+    Route routes_[MaxRoutes];
+    MonotonicDuration tx_timeout_;
+    uint32_t num_forwarded_frames_;
+    uint32_t num_dropped_frames_;
+    uint8_t num_routes_;
+    uint8_t rx_iface_mask_;
+
+public:
+    CanFrameBridge(CanIOManager& target, ISystemClock& sysclock)
+        : target_(target)
+        , sysclock_(sysclock)
+        , tx_timeout_(MonotonicDuration::fromMSec(DefaultTxTimeoutMs))
+        , num_forwarded_frames_(0)
+        , num_dropped_frames_(0)
+        , num_routes_(0)
+        , rx_iface_mask_(0xFF)
+    { }
+
+    /**
+     * Route of the messages of the given data type. If the source node ID is not set, messages from all nodes
+     * match, except anonymous ones, which don't carry the full data type ID; use @ref addRoute() for those.
+     */
+    static Route makeMessageRoute(DataTypeID dtid, NodeID src_node_id = NodeID(), uint8_t iface_mask = 0xFF);
+
+    /**
+     * Route of the requests and the responses of the given service. If the destination node ID is set, only the
+     * transfers addressed to that node match, i.e. the requests to the server and the responses to the client.
+     */
+    static Route makeServiceRoute(DataTypeID dtid, NodeID dst_node_id = NodeID(), uint8_t iface_mask = 0xFF);
+
+    /**
+     * @return Negative error code; -ErrLogic if the table is full.
+     */
+    int addRoute(const Route& route);
+    int addMessageRoute(DataTypeID dtid, NodeID src_node_id = NodeID(), uint8_t iface_mask = 0xFF)
+    {
+        return addRoute(makeMessageRoute(dtid, src_node_id, iface_mask));
+    }
+    int addServiceRoute(DataTypeID dtid, NodeID dst_node_id = NodeID(), uint8_t iface_mask = 0xFF)
+    {
+        return addRoute(makeServiceRoute(dtid, dst_node_id, iface_mask));
+    }
+
+    void clearRoutes() { num_routes_ = 0; }
+    unsigned getNumRoutes() const { return num_routes_; }
+
+    /**
+     * Returns the first route that matches the given CAN ID (including flags), or null if there is none.
+     */
+    const Route* findRoute(uint32_t can_id) const;
+
+    /**
+     * Only the frames received from these interfaces of the source network are forwarded. With redundant source
+     * interfaces, this is the way to avoid forwarding every frame once per interface. All by default.
+     */
+    uint8_t getRxIfaceMask() const { return rx_iface_mask_; }
+    void setRxIfaceMask(uint8_t mask) { rx_iface_mask_ = mask; }
+
+    /**
+     * Forwarded frames that could not be transmitted within this time are dropped from the destination TX queue.
+     */
+    MonotonicDuration getTxTimeout() const { return tx_timeout_; }
+    void setTxTimeout(MonotonicDuration timeout) { tx_timeout_ = timeout; }
+
+    /**
+     * Forwarded frames are the ones handed over to the destination; they may still be rejected by its TX queue,
+     * which is reflected in its perf counters. Dropped frames are the ones the destination failed to accept
+     * due to an error.
+     */
+    uint32_t getNumForwardedFrames() const { return num_forwarded_frames_; }
+    uint32_t getNumDroppedFrames() const { return num_dropped_frames_; }
+
+    virtual void handleRxFrame(const CanRxFrame& frame, CanIOFlags flags) override;
+};
+#endif
+
+}
+
+#endif // UAVCAN_TRANSPORT_CAN_FRAME_BRIDGE_HPP_INCLUDED
@@ -17,50 +17,135 @@
 #include <uavcan/driver/can.hpp>
 #include <uavcan/driver/system_clock.hpp>
 #include <uavcan/time.hpp>
+#include <uavcan/transport/transport_stats.hpp>
+#include <uavcan/transport/bus_load_estimator.hpp>
 
 namespace uavcan
 {
 
-struct UAVCAN_EXPORT CanRxFrame : public CanFrame
+/**
+ * Receives notifications about the frames entering and leaving the TX queues, see
+ * @ref CanIOManager::setTxQueueObserver(). The notifications are delivered from within the queue operations,
+ * so the observer must not send frames or otherwise modify the queues.
+ */
+class UAVCAN_EXPORT ITxQueueObserver
 {
-    MonotonicTime ts_mono;
-    UtcTime ts_utc;
-    uint8_t iface_index;
-
-    CanRxFrame()
-        : iface_index(0)
-    { }
+public:
+    virtual ~ITxQueueObserver() { }
 
-#if UAVCAN_TOSTRING
-    std::string toString(StringRepresentation mode = StrTight) const;
-#endif
+    /**
+     * @param can_id    CAN ID of the frame.
+     * @param queued    True if the frame has been queued; false if it has left the queue, either because it has
+     *                  been passed to the driver or because it has been dropped.
+     */
+    virtual void handleTxQueueChange(uint32_t can_id, bool queued) = 0;
 };
 
-
 class UAVCAN_EXPORT CanTxQueue : Noncopyable
 {
 public:
     enum Qos { Volatile, Persistent };
 
-    struct Entry : public LinkedListNode<Entry>  // Not required to be packed - fits the block in any case
+    /**
+     * Priority bands for the backlog limits, see @ref setBandBacklogLimit(). Band 0 holds the highest priorities;
+     * every band spans 8 of the 32 UAVCAN priority levels.
+     */
+    enum { NumPriorityBands = 4 };
+
+    /**
+     * Number of queues an entry can be linked into at the same time, see @ref UAVCAN_CAN_TX_QUEUE_SHARED_ENTRIES.
+     */
+#if UAVCAN_CAN_TX_QUEUE_SHARED_ENTRIES
+    enum { MaxLinksPerEntry = MaxCanIfaces };
+#else
+    enum { MaxLinksPerEntry = 1 };
+#endif
+
+    /**
+     * The frame is the last field, and the data field is the last field of the frame, so that a compact entry can
+     * be allocated without the unused part of the data field, see @ref UAVCAN_CAN_TX_QUEUE_COMPACT_ENTRIES.
+     * The frame of a compact entry must not be passed to the driver or copied as a whole; use @ref getCompleteFrame().
+     */
+    struct Entry  // Not required to be packed - fits the block in any case
     {
         MonotonicTime deadline;
-        CanFrame frame;
-        uint8_t qos;
+        Entry* next_links[MaxLinksPerEntry];    ///< Next entry in every queue of the group, by queue index
         CanIOFlags flags;
+        uint8_t qos;
+        uint8_t links;          ///< Bits 0..3 - queues the entry is linked into; bits 4..7 - index of the owner
+#if UAVCAN_TRANSPORT_STATS
+        uint32_t enqueued_usec; ///< Lower 32 bits of the monotonic time of the push, fits into the padding
+#endif
+        CanFrame frame;
 
         Entry(const CanFrame& arg_frame, MonotonicTime arg_deadline, Qos arg_qos, CanIOFlags arg_flags)
             : deadline(arg_deadline)
-            , frame(arg_frame)
-            , qos(uint8_t(arg_qos))
             , flags(arg_flags)
+            , qos(uint8_t(arg_qos))
+            , links(0)
+#if UAVCAN_TRANSPORT_STATS
+            , enqueued_usec(0)
+#endif
+            , frame(arg_frame, CanFrame::UsedDataOnly)
         {
             UAVCAN_ASSERT((qos == Volatile) || (qos == Persistent));
+            fill(next_links, next_links + MaxLinksPerEntry, static_cast<Entry*>(UAVCAN_NULLPTR));
+            if (!isCompact())
+            {
+                fill(frame.data + frame.getDataLength(), frame.data + CanFrame::MaxDataLen, uint8_t(0));
+            }
             IsDynamicallyAllocatable<Entry>::check();
+            StaticAssert<(MaxCanIfaces <= 4)>::check();
         }
 
         static void destroy(Entry*& obj, IPoolAllocator& allocator);
 
+        /**
+         * Number of bytes to allocate for the entry of the given frame.
+         */
+        static std::size_t getAllocationSize(const CanFrame& frame)
+        {
+#if UAVCAN_CAN_TX_QUEUE_COMPACT_ENTRIES
+            if (!frame.isCanFDFrame())
+            {
+                return sizeof(Entry) - (CanFrame::MaxDataLen - 8U);
+            }
+#else
+            (void)frame;
+#endif
+            return sizeof(Entry);
+        }
+
+        /**
+         * Compact entries are those of classic frames if @ref UAVCAN_CAN_TX_QUEUE_COMPACT_ENTRIES is enabled.
+         */
+        bool isCompact() const
+        {
+#if UAVCAN_CAN_TX_QUEUE_COMPACT_ENTRIES
+            return !frame.isCanFDFrame();
+#else
+            return false;
+#endif
+        }
+
+        /**
+         * Returns the frame if it is complete, otherwise copies it into the given storage and returns the copy.
+         */
+        const CanFrame& getCompleteFrame(CanFrame& storage) const
+        {
+            if (!isCompact())
+            {
+                return frame;
+            }
+            storage = CanFrame(frame.id, frame.data, frame.getDataLength(), frame.canfd);
+            return storage;
+        }
+
+        bool isLinkedInto(uint8_t queue_index) const { return (links & (1U << queue_index)) != 0; }
+        bool isLinked() const { return (links & 0x0FU) != 0; }
+        bool isLinkedOnlyInto(uint8_t queue_index) const { return (links & 0x0FU) == (1U << queue_index); }
+        uint8_t getOwnerIndex() const { return uint8_t(links >> 4); }
+
         bool isExpired(MonotonicTime timestamp) const { return timestamp > deadline; }
 
         bool qosHigherThan(const CanFrame& rhs_frame, Qos rhs_qos) const;
@@ -74,46 +159,273 @@ public:
     };
 
 private:
-    class PriorityInsertionComparator
+    /**
+     * The queue is a single list sorted by CAN arbitration priority; frames of equal priority are kept in the
+     * order of insertion. In order to avoid walking the whole list on insertion, the list is split into
+     * buckets by the 5 most significant bits of the CAN ID (which is the priority field of UAVCAN frames),
+     * and the last entry of every bucket is tracked. A frame is usually appended to the end of its bucket
+     * in constant time; only frames that overtake entries of the same bucket require a walk over that bucket.
+     *
+     * The queues of the redundant interfaces form a group, where an entry can be linked into several queues at
+     * once. The memory block of the entry is accounted to the queue that has allocated it (the owner), and it is
+     * released by the queue that unlinks the entry last. The owner always has a lower index than the other queues
+     * of the entry, so the group must be destroyed starting from the highest index.
+     */
+    enum { NumPriorityBuckets = 32 };
+
+    Entry* head_;
+    CanTxQueue* const* const group_;    ///< All queues of the group by index, or null if the queue is standalone
+    const uint8_t index_;               ///< Index of the queue within its group, also the link of its entries
+    uint16_t num_shared_links_;         ///< Number of linked entries owned by other queues of the group
+    Entry* bucket_tails_[NumPriorityBuckets];
+    uint32_t bucket_mask_;          ///< Bit N is set when bucket N is not empty
+    TaggedPoolAllocator tagged_allocator_;
+    LimitedPoolAllocator limited_allocator_;
+    GuaranteedPoolAllocator allocator_;     ///< The reserve is available only to the guaranteed reservations
+    ISystemClock& sysclock_;
+    ITxQueueObserver* observer_;
+    uint32_t rejected_frames_cnt_;
+    uint32_t deadline_miss_cnt_;
+
+    /**
+     * Memory blocks allocated in advance by @ref reserve(); new entries are placed there first.
+     */
+    struct ReservedBlock
     {
-        const CanFrame& frm_;
-    public:
-        explicit PriorityInsertionComparator(const CanFrame& frm) : frm_(frm) { }
-        bool operator()(const Entry* entry)
-        {
-            UAVCAN_ASSERT(entry);
-            return frm_.priorityHigherThan(entry->frame);
-        }
+        ReservedBlock* next;
     };
+    ReservedBlock* reserved_blocks_;
+    uint16_t num_reserved_blocks_;
 
-    LinkedListRoot<Entry> queue_;
-    LimitedPoolAllocator allocator_;
-    ISystemClock& sysclock_;
-    uint32_t rejected_frames_cnt_;
+    /**
+     * Lower bound of the TX deadlines of all queued entries, or max if the queue is empty.
+     * It is exact after every sweep, and may become stale (too low) when an entry is removed otherwise.
+     * As long as the current time does not exceed it, no entry can be expired, so sweeping is skipped.
+     */
+    MonotonicTime earliest_deadline_;
+
+#if UAVCAN_CAN_TX_QUEUE_COMPACT_ENTRIES
+    mutable CanFrame pending_frame_;    ///< See getTopPriorityPendingFrame()
+#endif
+
+#if UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING
+    MonotonicDuration urgency_window_;          ///< Zero if the promotion of urgent entries is disabled
+    uint16_t band_backlogs_[NumPriorityBands];  ///< Number of linked entries per priority band
+    uint16_t band_limits_[NumPriorityBands];    ///< Zero means unlimited
+
+    const Entry* findUrgentEntry(MonotonicTime timestamp, MonotonicTime& out_earliest_deadline) const;
+    Entry* findUrgentEntry(MonotonicTime timestamp);
+    bool isBandBacklogFull(const CanFrame& frame) const;
+#endif
+
+    static uint8_t getPriorityBucket(const CanFrame& frame);
+    Entry* findBucketPredecessor(uint8_t bucket) const;
+    void link(Entry* entry, Entry* prev);
+    void unlink(Entry* entry);
+    void insert(Entry* entry, bool ahead_of_equal = false);
+    void removeExpired(MonotonicTime timestamp);
 
     void registerRejectedFrame();
+    void registerDeadlineMiss();
+
+    void* allocateEntry(std::size_t size);
+
+    const CanFrame& getCompleteFrame(const Entry& entry) const
+    {
+#if UAVCAN_CAN_TX_QUEUE_COMPACT_ENTRIES
+        return entry.getCompleteFrame(pending_frame_);
+#else
+        return entry.frame;
+#endif
+    }
 
 public:
-    CanTxQueue(IPoolAllocator& allocator, ISystemClock& sysclock, std::size_t allocator_quota)
-        : allocator_(allocator, allocator_quota)
+    /**
+     * @param group     Queues of all interfaces, if entries may be shared between them, see @ref pushShared().
+     * @param index     Index of this queue within the group.
+     */
+    CanTxQueue(IPoolAllocator& allocator, ISystemClock& sysclock, std::size_t allocator_quota,
+               CanTxQueue* const* group = UAVCAN_NULLPTR, uint8_t index = 0)
+        : head_(UAVCAN_NULLPTR)
+        , group_(group)
+        , index_(index)
+        , num_shared_links_(0)
+        , bucket_mask_(0)
+        , tagged_allocator_(allocator, PoolUsageTagTxQueue)
+        , limited_allocator_(tagged_allocator_, allocator_quota)
+        , allocator_(limited_allocator_)
         , sysclock_(sysclock)
+        , observer_(UAVCAN_NULLPTR)
         , rejected_frames_cnt_(0)
-    { }
+        , deadline_miss_cnt_(0)
+        , reserved_blocks_(UAVCAN_NULLPTR)
+        , num_reserved_blocks_(0)
+        , earliest_deadline_(MonotonicTime::getMax())
+    {
+        UAVCAN_ASSERT(index_ < MaxLinksPerEntry);
+        UAVCAN_ASSERT((group_ == UAVCAN_NULLPTR) || (group_[index_] == UAVCAN_NULLPTR) || (group_[index_] == this));
+        fill(bucket_tails_, bucket_tails_ + NumPriorityBuckets, static_cast<Entry*>(UAVCAN_NULLPTR));
+#if UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING
+        fill_n(band_backlogs_, unsigned(NumPriorityBands), uint16_t(0));
+        fill_n(band_limits_, unsigned(NumPriorityBands), uint16_t(0));
+#endif
+    }
 
     ~CanTxQueue();
 
-    void push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags);
+    /**
+     * @return The new entry, or null if the frame was rejected.
+     */
+    Entry* push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags);
+
+    /**
+     * Links an entry of another queue of the same group into this queue, without allocating memory.
+     * The shared entries count against the quota of this queue as well, although they occupy no memory here.
+     * @return False if the entry could not be linked, e.g. due to the quota; the caller should @ref push() a copy
+     *         of the frame then, which will also do the QoS arbitration and register the rejection if necessary.
+     */
+    bool pushShared(Entry* entry);
+
+    /**
+     * Puts back a frame that has been accepted by the driver but aborted before transmission,
+     * see @ref ICanIface::abortLowerPriority(). The frame goes ahead of the queued frames of the same priority,
+     * since it was accepted before them. Nothing is evicted to make room, so that the entries obtained from
+     * @ref peekBatch() stay valid; if there is no memory, the frame is registered as rejected.
+     * @return The new entry, or null if the frame was rejected.
+     */
+    Entry* requeue(const CanFrame& frame, MonotonicTime tx_deadline, CanIOFlags flags);
+
+    /**
+     * Allocates memory for the given number of entries in advance, so that the following pushes can't fail or
+     * evict other entries for the lack of memory. Either all entries are reserved or none; in the latter case
+     * the entries are registered as rejected. Expired entries are dropped if necessary.
+     * The memory that was not used up must be returned with @ref releaseReservation().
+     * If use_guaranteed_blocks is set, the reservation may take the blocks that are guaranteed to the queue,
+     * see @ref setMinBlocks().
+     * @return True on success.
+     */
+    bool reserve(unsigned num_entries, bool use_guaranteed_blocks = false);
+    void releaseReservation();
+
+    unsigned getNumReservedEntries() const { return num_reserved_blocks_; }
 
     Entry* peek();               // Modifier
+
+    /**
+     * Next entry of this queue in the order of transmission; expired entries are not skipped.
+     */
+    Entry* getNextEntry(const Entry* entry) const { return entry->next_links[index_]; }
+
+    /**
+     * Fetches up to max_entries non-expired entries in the order of transmission, dropping expired ones.
+     * If priority_threshold is provided, only entries whose priority is higher than or equal to it are fetched.
+     * An urgent entry (see @ref setUrgencyWindow()) is fetched alone and regardless of the threshold.
+     * The entries stay in the queue until removed.
+     * @return Number of entries written into out_entries.
+     */
+    unsigned peekBatch(Entry** out_entries, unsigned max_entries,
+                       const CanFrame* priority_threshold = UAVCAN_NULLPTR);   // Modifier
     void remove(Entry*& entry);
+
+    /**
+     * The frame is complete, so it can be passed to the driver; the frame of a compact entry is returned as a copy.
+     * The pointer stays valid until the next call or until the queue is modified.
+     */
     const CanFrame* getTopPriorityPendingFrame() const;
 
     /// The 'or equal' condition is necessary to avoid frame reordering.
     bool topPriorityHigherOrEqual(const CanFrame& rhs_frame) const;
 
+    /**
+     * Drops all expired entries, returning their memory to the pool.
+     * This is a constant-time operation unless at least one entry has expired since the previous sweep.
+     */
+    void cleanup(MonotonicTime timestamp);
+
+    /**
+     * Drops the entries whose CAN ID equals the given one in the bits of the mask; these are not registered
+     * as rejected, since they have been superseded rather than lost.
+     * @return Number of dropped entries.
+     */
+    unsigned removeMatching(uint32_t can_id, uint32_t can_id_mask);
+
     uint32_t getRejectedFrameCount() const { return rejected_frames_cnt_; }
 
-    bool isEmpty() const { return queue_.isEmpty(); }
+    /**
+     * Number of frames that have been dropped because their TX deadline expired while they were queued.
+     * These are a subset of the rejected frames; the frames that were refused at admission are not included.
+     */
+    uint32_t getDeadlineMissCount() const { return deadline_miss_cnt_; }
+
+    static uint8_t getPriorityBand(const CanFrame& frame)
+    {
+        return uint8_t(getPriorityBucket(frame) / (NumPriorityBuckets / NumPriorityBands));
+    }
+
+#if UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING
+    /**
+     * Queued entries whose TX deadline is less than the window away are transmitted before all other entries,
+     * earliest deadline first, so that a low priority frame is not dropped while frames of higher priority keep
+     * arriving. The entries of the same CAN ID are never reordered, so a promoted entry takes its predecessors
+     * of the same transfer along. Bus arbitration is not affected. Zero (default) disables the promotion.
+     */
+    MonotonicDuration getUrgencyWindow() const { return urgency_window_; }
+    void setUrgencyWindow(MonotonicDuration window)
+    {
+        urgency_window_ = window.isPositive() ? window : MonotonicDuration();
+    }
+
+    /**
+     * Maximum number of queued entries of the given priority band; the frames beyond it are rejected, unless
+     * they use the memory reserved for a multi-frame transfer, see @ref reserve(). Zero (default) means
+     * no limit other than the memory quota.
+     */
+    uint16_t getBandBacklogLimit(uint8_t band) const
+    {
+        return (band < NumPriorityBands) ? band_limits_[band] : 0U;
+    }
+    void setBandBacklogLimit(uint8_t band, uint16_t max_entries)
+    {
+        if (band < NumPriorityBands)
+        {
+            band_limits_[band] = max_entries;
+        }
+    }
+
+    uint16_t getBandBacklog(uint8_t band) const
+    {
+        return (band < NumPriorityBands) ? band_backlogs_[band] : 0U;
+    }
+#endif
+
+    bool isEmpty() const { return head_ == UAVCAN_NULLPTR; }
+
+    /**
+     * Maximum number of memory blocks the queue can use, see @ref LimitedPoolAllocator::setMaxBlocks().
+     */
+    uint16_t getQuota() const { return limited_allocator_.getMaxBlocks(); }
+    void setQuota(std::size_t num_blocks) { limited_allocator_.setMaxBlocks(num_blocks); }
+
+    /**
+     * Number of memory blocks guaranteed to the queue, see @ref GuaranteedPoolAllocator. The guaranteed blocks are
+     * counted against the quota. They can be used only by reservations that ask for them explicitly, so that
+     * bulk traffic can't take them away from the critical transfers.
+     * @return False if the blocks could not be allocated; the previous value stays in effect then.
+     */
+    uint16_t getMinBlocks() const { return allocator_.getMinBlocks(); }
+    bool setMinBlocks(std::size_t num_blocks) { return allocator_.setMinBlocks(num_blocks); }
+
+    /**
+     * This includes the blocks of the owned entries that have left this queue but are still queued elsewhere.
+     */
+    uint16_t getNumUsedBlocks() const { return limited_allocator_.getNumUsedBlocks(); }
+
+    uint16_t getNumSharedEntries() const { return num_shared_links_; }
+
+    /**
+     * The observer is notified about every frame linked into or unlinked from this queue; null disables it.
+     */
+    void setObserver(ITxQueueObserver* observer) { observer_ = observer; }
 };
 
 
@@ -122,11 +434,15 @@ struct UAVCAN_EXPORT CanIfacePerfCounters
     uint64_t frames_tx;
     uint64_t frames_rx;
     uint64_t errors;
+    uint8_t bus_load_percent;       ///< See @ref CanIOManager::getBusLoadPercent()
+    uint32_t tx_deadline_misses;    ///< See @ref CanTxQueue::getDeadlineMissCount(); also counted in errors
 
     CanIfacePerfCounters()
         : frames_tx(0)
         , frames_rx(0)
         , errors(0)
+        , bus_load_percent(0)
+        , tx_deadline_misses(0)
     { }
 };
 
@@ -147,13 +463,80 @@ class UAVCAN_EXPORT CanIOManager : Noncopyable
     ICanDriver& driver_;
     ISystemClock& sysclock_;
 
-    LazyConstructor<CanTxQueue> tx_queues_[MaxCanIfaces];
+#if UAVCAN_CAN_TX_QUEUE_SHARED_ENTRIES
+    CanTxQueue* tx_queue_group_[MaxCanIfaces];
+#endif
+    LazyConstructor<CanTxQueue> tx_queues_[MaxCanIfaces];     ///< Destroyed from the last, see CanTxQueue
     IfaceFrameCounters counters_[MaxCanIfaces];
+    LatencyHistogram tx_queue_wait_;
+#if UAVCAN_BUS_LOAD_ESTIMATION
+    BusLoadEstimator bus_load_[MaxCanIfaces];
+#endif
 
     const uint8_t num_ifaces_;
 
+#if UAVCAN_CAN_TX_QUEUE_GUARANTEED_QUOTA_PERCENT < 100
+    /**
+     * Counters of the TX queues sampled at the previous cleanup.
+     * Rejections since then mean congestion; transmissions since then mean that the interface is not stuck.
+     */
+    struct TxQuotaSnapshot
+    {
+        uint64_t frames_tx;
+        uint32_t rejected_frames;
+
+        TxQuotaSnapshot()
+            : frames_tx(0)
+            , rejected_frames(0)
+        { }
+    };
+
+    TxQuotaSnapshot tx_quota_snapshots_[MaxCanIfaces];
+    uint16_t tx_quota_initial_;             ///< Per interface; the sum of the quotas stays constant
+    uint16_t tx_quota_guaranteed_;          ///< Per interface
+#endif
+
+#if UAVCAN_CAN_IFACE_HEALTH_TRACKING
+    /**
+     * Counters of an interface sampled at the previous health check, see @ref updateIfaceHealth().
+     */
+    struct IfaceHealth
+    {
+        uint64_t error_count;
+        uint64_t frames_tx;
+        uint32_t rejected_frames;
+        MonotonicTime probe_ts;         ///< When an excluded interface is tried again
+
+        IfaceHealth()
+            : error_count(0)
+            , frames_tx(0)
+            , rejected_frames(0)
+        { }
+    };
+
+    IfaceHealth iface_health_[MaxCanIfaces];
+    MonotonicDuration iface_probe_interval_;
+    uint8_t tx_excluded_mask_;
+#endif
+
+    void rebalanceTxQuotas();
+    void updateIfaceHealth(MonotonicTime ts);
+
     int sendToIface(uint8_t iface_index, const CanFrame& frame, MonotonicTime tx_deadline, CanIOFlags flags);
-    int sendFromTxQueue(uint8_t iface_index);
+    int sendToIfacePreempting(uint8_t iface_index, const CanFrame& frame, MonotonicTime tx_deadline,
+                              CanIOFlags flags);
+    int sendTxQueueEntry(uint8_t iface_index, CanTxQueue::Entry* entry);
+#if UAVCAN_BUS_LOAD_ESTIMATION
+    void registerBusLoad(uint8_t iface_index, const CanFrame* const* frames, unsigned num_frames);
+#else
+    void registerBusLoad(uint8_t, const CanFrame* const*, unsigned) { }
+#endif
+    int sendFromTxQueue(uint8_t iface_index, const CanFrame* priority_threshold = UAVCAN_NULLPTR);
+#if UAVCAN_TRANSPORT_STATS
+    void registerTxQueueWait(CanTxQueue::Entry* const* entries, unsigned num_entries);
+#else
+    void registerTxQueueWait(CanTxQueue::Entry* const*, unsigned) { }
+#endif
     int callSelect(CanSelectMasks& inout_masks, const CanFrame* (& pending_tx)[MaxCanIfaces],
                    MonotonicTime blocking_deadline);
 
@@ -165,11 +548,115 @@ public:
 
     CanIfacePerfCounters getIfacePerfCounters(uint8_t iface_index) const;
 
+    /**
+     * Time the frames spent in the TX queues before they were accepted by the driver, over all interfaces.
+     * Frames that were sent without queueing are not included. Collected if @ref UAVCAN_TRANSPORT_STATS is enabled.
+     */
+    const LatencyHistogram& getTxQueueWaitHistogram() const { return tx_queue_wait_; }
+    void resetTxQueueWaitHistogram() { tx_queue_wait_.reset(); }
+
+    /**
+     * Estimated utilization of the bus of the given interface over the last second, in percent, 0 to 100.
+     * Both transmitted and received frames are accounted for, see @ref BusLoadEstimator.
+     * Always zero if @ref UAVCAN_BUS_LOAD_ESTIMATION is disabled.
+     */
+    uint8_t getBusLoadPercent(uint8_t iface_index) const;
+
+    /**
+     * The highest bus load among all interfaces. Bulk traffic is usually sent over all of them, so this is the
+     * value it should be throttled by.
+     */
+    uint8_t getMaxBusLoadPercent() const;
+
+    /**
+     * Bus load estimation depends on the bit rate, which the library doesn't know otherwise. The default is 1 Mbit/s.
+     * The data bit rate applies to CAN FD frames; zero means the same as nominal.
+     * Applied to all interfaces.
+     */
+    void setBusBitrate(uint32_t nominal_bitrate, uint32_t data_bitrate = 0);
+
+#if UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING
+    /**
+     * Deadline-aware scheduling of the TX queues of all interfaces, see @ref CanTxQueue::setUrgencyWindow()
+     * and @ref CanTxQueue::setBandBacklogLimit(). Disabled by default.
+     */
+    void setTxUrgencyWindow(MonotonicDuration window);
+    void setTxBandBacklogLimit(uint8_t band, uint16_t max_frames);
+#endif
+
     const ICanDriver& getCanDriver() const { return driver_; }
     ICanDriver& getCanDriver()             { return driver_; }
 
     uint8_t makePendingTxMask() const;
 
+    enum { DefaultIfaceProbeIntervalMs = 3000 };
+
+    /**
+     * Redundant interfaces are checked for health on every @ref cleanup(). An interface whose error counter has
+     * risen while it has transmitted nothing despite the queued frames (e.g. bus off) is excluded from
+     * transmission, and its TX queue is flushed. After the probe interval it is included again; if it is still
+     * failing, the next check excludes it once more. The last working interface is never excluded, and
+     * reception is never affected. Zero interval disables the tracking and includes all interfaces.
+     */
+    MonotonicDuration getIfaceProbeInterval() const;
+    void setIfaceProbeInterval(MonotonicDuration interval);
+
+    /**
+     * Interfaces that are currently excluded from transmission due to their poor health.
+     */
+    uint8_t getTxExcludedIfaceMask() const;
+
+    /**
+     * Reserves the TX queue memory for all frames of a multi-frame transfer, see @ref CanTxQueue::reserve(),
+     * so that every interface gets either the whole transfer or nothing of it. A half-sent transfer would only
+     * waste the bus bandwidth and the reassembly buffers of the receivers.
+     * A transfer that would not fit into the queue even if it was empty is admitted without a reservation, as
+     * its frames may still go out directly.
+     * @return Mask of the interfaces that admitted the transfer; the reservations must be released with
+     *         @ref releaseTxQueueReservations() once the transfer has been sent.
+     * If use_guaranteed_blocks is set, the reservations may use the guaranteed memory of the TX queues, see
+     * @ref addTxQueueMinBlocks().
+     */
+    uint8_t reserveTxQueues(uint8_t iface_mask, unsigned num_frames, bool use_guaranteed_blocks = false);
+    void releaseTxQueueReservations(uint8_t iface_mask);
+
+    /**
+     * Raises or lowers the number of memory blocks guaranteed to the TX queue of every interface,
+     * see @ref CanTxQueue::setMinBlocks(). Publishers use this to set aside the memory for their frames.
+     * Raising is done either on all interfaces or on none.
+     * @return Negative error code.
+     */
+    int addTxQueueMinBlocks(unsigned num_blocks);
+    void removeTxQueueMinBlocks(unsigned num_blocks);
+
+    /**
+     * Current memory quota of the TX queue of the given interface, in blocks.
+     * The quotas are rebalanced between the interfaces, see @ref UAVCAN_CAN_TX_QUEUE_GUARANTEED_QUOTA_PERCENT.
+     */
+    uint16_t getTxQueueQuota(uint8_t iface_index) const;
+
+    /**
+     * Number of memory blocks used by the TX queue of the given interface, see @ref CanTxQueue::getNumUsedBlocks().
+     */
+    uint16_t getTxQueueNumUsedBlocks(uint8_t iface_index) const;
+
+    /**
+     * Drops expired frames from the TX queues of all interfaces and rebalances their memory quotas.
+     */
+    void cleanup(MonotonicTime ts);
+
+    /**
+     * Drops the queued frames of the given interfaces whose CAN ID matches, see @ref CanTxQueue::removeMatching().
+     * @return Number of dropped frames, summed over the interfaces.
+     */
+    unsigned removeTxQueueFrames(uint32_t can_id, uint32_t can_id_mask, uint8_t iface_mask);
+
+    /**
+     * Installs the observer into the TX queues of all interfaces, see @ref CanTxQueue::setObserver().
+     * A frame queued for several interfaces is reported once per interface. Null removes the observer.
+     */
+    void setTxQueueObserver(ITxQueueObserver* observer);
+
     /**
      * Returns:
      *  0 - rejected/timedout/enqueued
@@ -179,6 +666,20 @@ public:
     int send(const CanFrame& frame, MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
              uint8_t iface_mask, CanTxQueue::Qos qos, CanIOFlags flags);
     int receive(CanRxFrame& out_frame, MonotonicTime blocking_deadline, CanIOFlags& out_flags);
+
+    /**
+     * Receives up to max_frames frames from all interfaces after a single select() call.
+     * Blocks until at least one frame is received or the deadline is reached, same as @ref receive().
+     * Flags are reported per frame.
+     * Returns:
+     *  0 - timed out
+     *  1+ - number of received frames
+     *  negative - failure
+     * If an interface fails after frames have been received from the others, these frames are returned, and the
+     * failure is reported by the next call if it persists.
+     */
+    int receiveBatch(CanRxFrame* out_frames, CanIOFlags* out_flags, unsigned max_frames,
+                     MonotonicTime blocking_deadline);
 };
 
 }
@@ -27,9 +27,13 @@ namespace uavcan
  */
 class UAVCAN_EXPORT TransferCRC
 {
-#if !UAVCAN_TINY
+#if UAVCAN_TRANSFER_CRC_SLICING > 0
     static const uint16_t Table[256];
 #endif
+#if UAVCAN_TRANSFER_CRC_SLICING > 1
+    /// Entry [K - 1][V] is the CRC of the byte V followed by K zero bytes, with zero initial value
+    static const uint16_t SliceTable[UAVCAN_TRANSFER_CRC_SLICING - 1][256];
+#endif
 
     uint16_t value_;
 
@@ -40,7 +44,12 @@ public:
         : value_(0xFFFFU)
     { }
 
-#if UAVCAN_TINY
+    /// Resumes the computation from a known state, e.g. the base CRC of a data type
+    UAVCAN_CONSTEXPR explicit TransferCRC(uint16_t value)
+        : value_(value)
+    { }
+
+#if UAVCAN_TRANSFER_CRC_SLICING == 0
     void add(uint8_t byte)
     {
         value_ ^= uint16_t(uint16_t(byte) << 8);
@@ -63,14 +72,11 @@ public:
     }
 #endif
 
-    void add(const uint8_t* bytes, unsigned len)
-    {
-        UAVCAN_ASSERT(bytes);
-        while (len--)
-        {
-            add(*bytes++);
-        }
-    }
+    /**
+     * Processes several bytes per step if UAVCAN_TRANSFER_CRC_SLICING is greater than one.
+     * Can be provided by the application, see UAVCAN_USE_EXTERNAL_TRANSFER_CRC.
+     */
+    void add(const uint8_t* bytes, unsigned len);
 
     uint16_t get() const { return value_; }
 };
@@ -13,6 +13,9 @@
 #include <uavcan/transport/transfer_listener.hpp>
 #include <uavcan/transport/outgoing_transfer_registry.hpp>
 #include <uavcan/transport/can_io.hpp>
+#include <uavcan/transport/redundancy_filter.hpp>
+#include <uavcan/transport/rx_rate_limiter.hpp>
+#include <uavcan/transport/node_id_set.hpp>
 #include <uavcan/util/linked_list.hpp>
 
 namespace uavcan
@@ -23,42 +26,194 @@ class UAVCAN_EXPORT Dispatcher;
 #if !UAVCAN_TINY
 /**
  * Inherit this class to receive notifications about all TX CAN frames that were transmitted with the loopback flag.
+ * The listener can be limited to the frames of one data type, which also spares the dispatcher the parsing of the
+ * loopback frames that no listener is interested in.
  */
-class UAVCAN_EXPORT LoopbackFrameListenerBase : public LinkedListNode<LoopbackFrameListenerBase>
+class UAVCAN_EXPORT LoopbackFrameListenerBase : public DoublyLinkedListNode<LoopbackFrameListenerBase>
 {
     Dispatcher& dispatcher_;
+    DataTypeID data_type_id_;
+    TransferType transfer_type_;        ///< NumTransferTypes if the listener accepts all frames
 
 protected:
     explicit LoopbackFrameListenerBase(Dispatcher& dispatcher)
         : dispatcher_(dispatcher)
+        , transfer_type_(TransferType(NumTransferTypes))
     { }
 
     virtual ~LoopbackFrameListenerBase() { stopListening(); }
 
+    /**
+     * Starts listening for all loopback frames.
+     */
     void startListening();
+
+    /**
+     * Starts listening for the loopback frames of the specified data type and transfer type only.
+     */
+    void startListening(DataTypeID data_type_id, TransferType transfer_type);
+
     void stopListening();
     bool isListening() const;
 
     Dispatcher& getDispatcher() { return dispatcher_; }
 
 public:
+    bool acceptsAllFrames() const { return transfer_type_ >= NumTransferTypes; }
+
+    /**
+     * Data type ID the listener is limited to; undefined if the listener accepts all frames.
+     */
+    DataTypeID getDataTypeID() const { return data_type_id_; }
+
+    bool accepts(const RxFrame& frame) const
+    {
+        return acceptsAllFrames() ||
+               ((frame.getDataTypeID() == data_type_id_) && (frame.getTransferType() == transfer_type_));
+    }
+
     virtual void handleLoopbackFrame(const RxFrame& frame) = 0;
 };
 
 
 class UAVCAN_EXPORT LoopbackFrameListenerRegistry : Noncopyable
 {
-    LinkedListRoot<LoopbackFrameListenerBase> listeners_;
+    DoublyLinkedListRoot<LoopbackFrameListenerBase> listeners_;
+
+    /**
+     * Bit N is set if there is a listener whose data type ID modulo DataTypeIDBitmapSize equals N.
+     * Same as in the transfer listener registry, false positives are possible, they are sorted out after parsing.
+     */
+    enum { DataTypeIDBitmapSize = 256 };
+    uint32_t dtid_bitmap_[DataTypeIDBitmapSize / 32];
+    uint8_t num_unfiltered_listeners_;
+
+    void rebuildIndex();
 
 public:
+    LoopbackFrameListenerRegistry()
+        : num_unfiltered_listeners_(0)
+    {
+        fill_n(dtid_bitmap_, DataTypeIDBitmapSize / 32, 0U);
+    }
+
     void add(LoopbackFrameListenerBase* listener);
     void remove(LoopbackFrameListenerBase* listener);
     bool doesExist(const LoopbackFrameListenerBase* listener) const;
     unsigned getNumListeners() const { return listeners_.getLength(); }
 
+    /**
+     * Decodes only the CAN ID; false means that nobody will accept the frame, so it need not be parsed.
+     */
+    bool isFrameOfInterest(const CanFrame& can_frame) const;
+
     void invokeListeners(RxFrame& frame);
 };
 
+/**
+ * Counts the frames of one data type and transfer type that are waiting in the TX queues of this node, so that
+ * a bulk producer (e.g. a file server or a telemetry streamer) can keep a fixed pipeline depth instead of flooding
+ * the queues or throttling conservatively. A frame is in flight from the moment it is queued until it leaves
+ * the queue, either passed to the driver or dropped; a frame queued for several interfaces is counted once per
+ * interface. The frames that the driver has accepted right away, without queuing, are never in flight.
+ * The frames that were queued before the tracker was started are not counted.
+ *
+ * Inherit this class and override @ref handleTxReady() to be notified when the producer can go on.
+ */
+class UAVCAN_EXPORT TxCompletionTracker : public DoublyLinkedListNode<TxCompletionTracker>
+{
+    friend class TxCompletionTrackerRegistry;
+
+    Dispatcher& dispatcher_;
+    DataTypeID data_type_id_;
+    TransferType transfer_type_;
+    uint32_t num_frames_completed_;
+    uint16_t num_frames_in_flight_;
+    uint16_t ready_threshold_;
+    bool ready_pending_;
+
+    void handleTxQueueChange(bool queued);
+
+protected:
+    /**
+     * Called from the spin of the dispatcher once the number of frames in flight has dropped to the ready
+     * threshold. It is safe to send from here.
+     */
+    virtual void handleTxReady() { }
+
+public:
+    explicit TxCompletionTracker(Dispatcher& dispatcher)
+        : dispatcher_(dispatcher)
+        , transfer_type_(TransferType(NumTransferTypes))
+        , num_frames_completed_(0)
+        , num_frames_in_flight_(0)
+        , ready_threshold_(0)
+        , ready_pending_(false)
+    { }
+
+    virtual ~TxCompletionTracker() { stop(); }
+
+    /**
+     * Starts counting the frames of the given data type and transfer type; the counters are reset.
+     */
+    void start(DataTypeID data_type_id, TransferType transfer_type);
+    void stop();
+    bool isStarted() const;
+
+    uint16_t getNumFramesInFlight() const { return num_frames_in_flight_; }
+
+    /**
+     * Number of frames that have left the TX queues since the tracker was started, transmitted or dropped.
+     */
+    uint32_t getNumFramesCompleted() const { return num_frames_completed_; }
+
+    /**
+     * The producer is ready when the number of frames in flight does not exceed the threshold. Default is zero.
+     */
+    uint16_t getReadyThreshold() const { return ready_threshold_; }
+    void setReadyThreshold(uint16_t num_frames) { ready_threshold_ = num_frames; }
+
+    bool isReady() const { return num_frames_in_flight_ <= ready_threshold_; }
+};
+
+/**
+ * Routes the TX queue notifications of the CAN IO manager to the trackers; the observer is installed only while
+ * there are trackers, so that the TX path is not burdened otherwise.
+ */
+class UAVCAN_EXPORT TxCompletionTrackerRegistry : public ITxQueueObserver
+                                                , Noncopyable
+{
+    CanIOManager& canio_;
+    DoublyLinkedListRoot<TxCompletionTracker> trackers_;
+    bool notifications_pending_;
+
+    void deliverPendingNotifications();
+
+public:
+    explicit TxCompletionTrackerRegistry(CanIOManager& canio)
+        : canio_(canio)
+        , notifications_pending_(false)
+    { }
+
+    void add(TxCompletionTracker* tracker);
+    void remove(TxCompletionTracker* tracker);
+    bool doesExist(const TxCompletionTracker* tracker) const;
+    unsigned getNumTrackers() const { return trackers_.getLength(); }
+
+    virtual void handleTxQueueChange(uint32_t can_id, bool queued) override;
+
+    /**
+     * Invokes the pending ready notifications; must be called where the trackers are allowed to send.
+     */
+    void deliverNotifications()
+    {
+        if (notifications_pending_)
+        {
+            deliverPendingNotifications();
+        }
+    }
+};
+
 /**
  * Implement this interface to receive notifications about all incoming CAN frames, including loopback.
  */
@@ -72,6 +227,56 @@ public:
      */
     virtual void handleRxFrame(const CanRxFrame& frame, CanIOFlags flags) = 0;
 };
+
+/**
+ * Lets several virtual nodes share one CAN IO front-end, so that the cost of receiving and parsing the frames
+ * does not grow with the number of nodes.
+ *
+ * The demultiplexer is installed into the dispatcher that owns the receiving driver, see
+ * @ref Dispatcher::installRxDemultiplexer(). Every frame received by that dispatcher is then checked against the
+ * node ID and the listeners of each member dispatcher using the CAN ID alone; the frame is parsed once, when the
+ * first interested member is found, and the parsed frame is handed over to all interested members.
+ * Loopback frames are still handled by the receiving dispatcher only.
+ *
+ * The member dispatchers keep their own transport state, including the redundancy filter; their own drivers are
+ * only used for transmission and should receive nothing, otherwise the frames will be processed twice.
+ * The receiving dispatcher must be added as a member too, unless it has no listeners of its own.
+ * A member must be removed before it is destroyed.
+ */
+class UAVCAN_EXPORT RxFrameDemultiplexer : Noncopyable
+{
+public:
+    enum { MaxNodes = UAVCAN_RX_FRAME_DEMULTIPLEXER_MAX_NODES };
+
+private:
+    Dispatcher* nodes_[MaxNodes];
+    uint32_t num_frames_parsed_;
+    uint8_t num_nodes_;
+
+public:
+    RxFrameDemultiplexer()
+        : num_frames_parsed_(0)
+        , num_nodes_(0)
+    {
+        fill(nodes_, nodes_ + MaxNodes, static_cast<Dispatcher*>(UAVCAN_NULLPTR));
+    }
+
+    /**
+     * @return Negative error code; -ErrLogic if the node is already added or there is no room for it.
+     */
+    int addNode(Dispatcher& node);
+    void removeNode(Dispatcher& node);
+    bool hasNode(const Dispatcher& node) const;
+
+    unsigned getNumNodes() const { return num_nodes_; }
+
+    /**
+     * Number of frames that were of interest to at least one member, i.e. the number of times a frame was parsed.
+     */
+    uint32_t getNumFramesParsed() const { return num_frames_parsed_; }
+
+    void handleFrame(const CanRxFrame& can_frame);
+};
 #endif
 
 /**
@@ -79,16 +284,20 @@ public:
  */
 class UAVCAN_EXPORT Dispatcher : Noncopyable
 {
+    enum { RxBatchSize = UAVCAN_DISPATCHER_RX_BATCH_SIZE };
+
     CanIOManager canio_;
     ISystemClock& sysclock_;
     OutgoingTransferRegistry outgoing_transfer_reg_;
     TransferPerfCounter perf_;
     bool tao_disabled_ = false;
     bool canfd_ = false;
+    bool canfd_negotiation_ = false;
+    NodeIDSet canfd_capable_nodes_;
 
     class ListenerRegistry
     {
-        LinkedListRoot<TransferListener> list_;
+        DoublyLinkedListRoot<TransferListener> list_;
 
         class DataTypeIDInsertionComparator
         {
@@ -102,45 +311,146 @@ class UAVCAN_EXPORT Dispatcher : Noncopyable
             }
         };
 
+#if UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY > 0
+        /**
+         * The index refers to the first listener of every run of listeners sharing the same data type ID.
+         * Entries are ordered by data type ID in ascending order. The index is rebuilt on every modification
+         * of the list, which is rare compared to frame reception.
+         */
+        struct IndexEntry
+        {
+            TransferListener* first;
+            uint16_t dtid;
+        };
+
+        IndexEntry index_[UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY];
+        uint16_t index_len_;
+        bool index_overflow_;       ///< Too many unique data type IDs; the list will be scanned linearly
+
+        void rebuildIndex();
+#endif
+
+        /**
+         * Bit N is set if there is a listener whose data type ID modulo DataTypeIDBitmapSize equals N.
+         * This is exact for services, whose data type IDs are 8 bit wide; for messages it may give false positives.
+         */
+        enum { DataTypeIDBitmapSize = 256 };
+        uint32_t dtid_bitmap_[DataTypeIDBitmapSize / 32];
+
+        void rebuildDataTypeIDBitmap();
+
+        TransferListener* findFirst(DataTypeID dtid) const;
+
+        bool contains(const TransferListener* listener) const;
+
     public:
         enum Mode { UniqueListener, ManyListeners };
 
+        ListenerRegistry()
+#if UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY > 0
+            : index_len_(0)
+            , index_overflow_(false)
+#endif
+        {
+            fill_n(dtid_bitmap_, DataTypeIDBitmapSize / 32, 0U);
+        }
+
+#if UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY > 0
+        bool isIndexed() const { return !index_overflow_; }
+#else
+        bool isIndexed() const { return false; }
+#endif
+
+        /**
+         * Fast check that doesn't need the list to be traversed; false means that there are no listeners for sure.
+         */
+        bool mayHaveListeners(uint16_t dtid) const
+        {
+            const unsigned bit = dtid % DataTypeIDBitmapSize;
+            return (dtid_bitmap_[bit / 32U] & (1UL << (bit % 32U))) != 0;
+        }
+
         bool add(TransferListener* listener, Mode mode);
         void remove(TransferListener* listener);
+        bool replace(TransferListener* old_listener, TransferListener* new_listener);
         bool exists(DataTypeID dtid) const;
-        void cleanup(MonotonicTime ts);
+        void cleanup(MonotonicTime ts, unsigned& position, unsigned slice, unsigned num_slices);
+        void removeReceiversOf(NodeID node_id);
         void handleFrame(const RxFrame& frame, bool tao_disabled);
+        void handleCompletedTransfer(const RxFrame& last_frame, IncomingTransfer& transfer);
 
         unsigned getNumEntries() const { return list_.getLength(); }
 
-        const LinkedListRoot<TransferListener>& getList() const { return list_; }
+        const DoublyLinkedListRoot<TransferListener>& getList() const { return list_; }
     };
 
     ListenerRegistry lmsg_;
     ListenerRegistry lsrv_req_;
     ListenerRegistry lsrv_resp_;
 
+    RedundantFrameFilter redundancy_filter_;
+    RxRateLimiter rx_rate_limiter_;
+
 #if !UAVCAN_TINY
     LoopbackFrameListenerRegistry loopback_listeners_;
+    TxCompletionTrackerRegistry tx_completion_trackers_;
     IRxFrameListener* rx_listener_;
+    RxFrameDemultiplexer* rx_demux_;
+
+    friend class RxFrameDemultiplexer;
 #endif
 
     NodeID self_node_id_;
     bool self_node_id_is_set_;
 
+    MonotonicTime spin_deadline_;       ///< Of the ongoing spin() call; zero otherwise
+
+#if UAVCAN_DISPATCHER_RX_STAGING_CAPACITY > 0
+    enum { RxStagingCapacity = UAVCAN_DISPATCHER_RX_STAGING_CAPACITY };
+
+    CanRxFrame rx_staging_frames_[RxStagingCapacity];
+    CanIOFlags rx_staging_flags_[RxStagingCapacity];
+    bool rx_staging_ = false;
+
+    /**
+     * Drains the available frames into the staging buffer, waiting for the first one until the deadline, and
+     * dispatches them in the order of CAN arbitration priority.
+     * Returns the number of received frames or negative error code; the number of processed frames is added to
+     * the output argument.
+     */
+    int receiveStaged(MonotonicTime blocking_deadline, unsigned max_frames, int& inout_num_frames_processed);
+#endif
+
+    /**
+     * Decodes only the CAN ID fields and checks whether the frame can be accepted by any listener,
+     * so that irrelevant frames are rejected without being parsed.
+     */
+    bool isFrameOfInterest(const CanFrame& can_frame) const;
+
+    /**
+     * Performs the checks that don't need the parsed frame, including the redundancy filter and the rate limiter.
+     */
+    bool acceptFrame(const CanRxFrame& can_frame);
+
+    void dispatchFrame(const RxFrame& frame);
+
     void handleFrame(const CanRxFrame& can_frame);
 
     void handleLoopbackFrame(const CanRxFrame& can_frame);
 
     void notifyRxFrameListener(const CanRxFrame& can_frame, CanIOFlags flags);
 
+    unsigned handleReceivedFrames(const CanRxFrame* frames, const CanIOFlags* flags, unsigned num_frames);
+
 public:
     Dispatcher(ICanDriver& driver, IPoolAllocator& allocator, ISystemClock& sysclock)
         : canio_(driver, allocator, sysclock)
         , sysclock_(sysclock)
         , outgoing_transfer_reg_(allocator)
 #if !UAVCAN_TINY
+        , tx_completion_trackers_(canio_)
         , rx_listener_(UAVCAN_NULLPTR)
+        , rx_demux_(UAVCAN_NULLPTR)
 #endif
         , self_node_id_(NodeID::Broadcast)  // Default
         , self_node_id_is_set_(false)
@@ -149,7 +459,25 @@ public:
     /**
      * This version returns strictly when the deadline is reached.
      */
-    int spin(MonotonicTime deadline);
+    int spin(MonotonicTime deadline) { return spin(deadline, NumericTraits<unsigned>::max()); }
+
+    /**
+     * Same as above, but also returns once the specified number of frames (including loopback) has been received.
+     */
+    int spin(MonotonicTime deadline, unsigned max_frames);
+
+    /**
+     * Makes the ongoing @ref spin() call return no later than the specified time, so that a deadline handler started
+     * from a frame reception callback is not delayed until the original deadline.
+     * The call being blocked in the driver at the moment will not be interrupted. Does nothing outside of spin().
+     */
+    void limitSpinDeadline(MonotonicTime deadline)
+    {
+        if (!spin_deadline_.isZero() && (deadline < spin_deadline_))
+        {
+            spin_deadline_ = deadline;
+        }
+    }
 
     /**
      * This version does not return until all available frames are processed.
@@ -162,7 +490,31 @@ public:
     int send(const Frame& frame, MonotonicTime tx_deadline, MonotonicTime blocking_deadline, CanTxQueue::Qos qos,
              CanIOFlags flags, uint8_t iface_mask);
 
-    void cleanup(MonotonicTime ts);
+    /**
+     * Cleans up everything at once.
+     */
+    void cleanup(MonotonicTime ts) { cleanup(ts, 0, 1); }
+
+    /**
+     * Spreads the cleanup over num_slices calls with the slice index running from zero to num_slices - 1.
+     * Only the listeners whose position among all listeners modulo num_slices equals the slice index are
+     * cleaned up; the CAN IO manager and the outgoing transfer registry are cleaned up with the slice zero.
+     */
+    void cleanup(MonotonicTime ts, unsigned slice, unsigned num_slices);
+
+    /**
+     * Releases the reception state of all listeners that is related to the given node: the transfer receivers and
+     * the buffers of the partially received transfers. Normally this state is released when the receivers time
+     * out, which takes a while; a node that is known to have gone offline doesn't need to wait for that.
+     * The transfers from the node that arrive later are received normally.
+     */
+    void removeRxStateOf(NodeID node_id);
+
+    /**
+     * Delivers a transfer that was reassembled outside of the dispatcher to the matching listeners, see
+     * @ref TransferListener::handleCompletedTransfer(). Transfers addressed to other nodes are ignored.
+     */
+    void dispatchCompletedTransfer(const RxFrame& last_frame, IncomingTransfer& transfer);
 
     bool registerMessageListener(TransferListener* listener);
     bool registerServiceRequestListener(TransferListener* listener);
@@ -172,17 +524,82 @@ public:
     void unregisterServiceRequestListener(TransferListener* listener);
     void unregisterServiceResponseListener(TransferListener* listener);
 
+    /**
+     * Puts the new message listener in place of the old one, which must be registered and have the same data type
+     * ID. Unlike unregistration followed by registration, this is safe to do from a reception callback: the new
+     * listener will not see the frame that is being processed. Returns false if the replacement is not possible.
+     */
+    bool replaceMessageListener(TransferListener* old_listener, TransferListener* new_listener);
+
+    /**
+     * Used by the data type introspection, so they don't scan the lists. The data type ID bitmaps of the listener
+     * registries, which are maintained on registration, answer for the services and rule out most of the absent
+     * message types; the rest is found via the index or via the hash map of the outgoing transfer registry.
+     */
     bool hasSubscriber(DataTypeID dtid) const;
     bool hasPublisher(DataTypeID dtid) const;
     bool hasServer(DataTypeID dtid) const;
 
     bool isTaoDisabled() const { return tao_disabled_; }
     bool isCanFdEnabled() const { return canfd_; }
+    bool isCanFdNegotiationEnabled() const { return canfd_negotiation_; }
+
+    /**
+     * Whether a transfer should be sent in CAN FD frames. If CAN FD is enabled, all transfers are. Otherwise, if
+     * CAN FD negotiation is enabled, service transfers are sent in CAN FD frames to the nodes that are known to
+     * support it, see @ref getCanFdCapableNodes(), and in classic frames to the rest of the network.
+     */
+    bool shouldUseCanFd(TransferType transfer_type, NodeID dst_node_id) const
+    {
+        return canfd_ ||
+               (canfd_negotiation_ && (transfer_type != TransferTypeMessageBroadcast) &&
+                canfd_capable_nodes_.contains(dst_node_id));
+    }
+
+    /**
+     * Nodes that are known to support CAN FD. A node is added once a CAN FD frame from it has been received, e.g.
+     * a response to GetNodeInfo or to any other request. The application can add or remove nodes that it knows
+     * about by other means, e.g. from the hardware version reported in GetNodeInfo; a node that has been replaced
+     * with a classic CAN one has to be removed explicitly, as receiving classic frames doesn't prove anything.
+     */
+    const NodeIDSet& getCanFdCapableNodes() const { return canfd_capable_nodes_; }
+    void setCanFdCapable(NodeID node_id, bool capable) { canfd_capable_nodes_.set(node_id, capable); }
 
     unsigned getNumMessageListeners()         const { return lmsg_.getNumEntries(); }
     unsigned getNumServiceRequestListeners()  const { return lsrv_req_.getNumEntries(); }
     unsigned getNumServiceResponseListeners() const { return lsrv_resp_.getNumEntries(); }
 
+    /**
+     * Whether the listener lookup for the given transfer type is served by the data type ID index.
+     * Returns false if the index is disabled (@ref UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY) or overflown.
+     */
+    bool isListenerLookupIndexed(TransferType tt) const;
+
+    /**
+     * Drops the copies of frames received via redundant interfaces before they are parsed.
+     */
+    const RedundantFrameFilter& getRedundantFrameFilter() const { return redundancy_filter_; }
+
+    /**
+     * Per-source limits of the rate of incoming transfers, applied before the frames are parsed.
+     * Disabled until configured.
+     */
+    RxRateLimiter& getRxRateLimiter() { return rx_rate_limiter_; }
+    const RxRateLimiter& getRxRateLimiter() const { return rx_rate_limiter_; }
+
+#if UAVCAN_DISPATCHER_RX_STAGING_CAPACITY > 0
+    /**
+     * In the RX staging mode, the dispatcher drains all frames that are available from the driver at the moment
+     * (up to @ref UAVCAN_DISPATCHER_RX_STAGING_CAPACITY) and processes them in the order of CAN arbitration
+     * priority, rather than in the FIFO order of the driver. This bounds the reception latency of the high priority
+     * traffic when the RX queue is filled by a burst of low priority frames, e.g. a file transfer.
+     * The order of the frames with the same CAN ID is preserved, hence so is the order of frames within a transfer.
+     * The mode is disabled by default.
+     */
+    bool isRxPriorityStagingEnabled() const { return rx_staging_; }
+    void enableRxPriorityStaging(bool enabled) { rx_staging_ = enabled; }
+#endif
+
     /**
      * These methods can be used to retreive lists of messages, service requests and service responses the
      * dispatcher is currently listening to.
@@ -190,15 +607,15 @@ public:
      * removed from this list as soon as the corresponding service call is complete.
      * @{
      */
-    const LinkedListRoot<TransferListener>& getListOfMessageListeners() const
+    const DoublyLinkedListRoot<TransferListener>& getListOfMessageListeners() const
     {
         return lmsg_.getList();
     }
-    const LinkedListRoot<TransferListener>& getListOfServiceRequestListeners() const
+    const DoublyLinkedListRoot<TransferListener>& getListOfServiceRequestListeners() const
     {
         return lsrv_req_.getList();
     }
-    const LinkedListRoot<TransferListener>& getListOfServiceResponseListeners() const
+    const DoublyLinkedListRoot<TransferListener>& getListOfServiceResponseListeners() const
     {
         return lsrv_resp_.getList();
     }
@@ -210,6 +627,7 @@ public:
 
 #if !UAVCAN_TINY
     LoopbackFrameListenerRegistry& getLoopbackFrameListenerRegistry() { return loopback_listeners_; }
+    TxCompletionTrackerRegistry& getTxCompletionTrackerRegistry() { return tx_completion_trackers_; }
 
     IRxFrameListener* getRxFrameListener() const { return rx_listener_; }
     void removeRxFrameListener() { rx_listener_ = UAVCAN_NULLPTR; }
@@ -218,6 +636,18 @@ public:
         UAVCAN_ASSERT(listener != UAVCAN_NULLPTR);
         rx_listener_ = listener;
     }
+
+    /**
+     * Once installed, the received frames are processed by the demultiplexer instead of this dispatcher.
+     * See @ref RxFrameDemultiplexer.
+     */
+    RxFrameDemultiplexer* getRxDemultiplexer() const { return rx_demux_; }
+    void removeRxDemultiplexer() { rx_demux_ = UAVCAN_NULLPTR; }
+    void installRxDemultiplexer(RxFrameDemultiplexer* demux)
+    {
+        UAVCAN_ASSERT(demux != UAVCAN_NULLPTR);
+        rx_demux_ = demux;
+    }
 #endif
 
     /**
@@ -241,7 +671,12 @@ public:
     const TransferPerfCounter& getTransferPerfCounter() const { return perf_; }
     TransferPerfCounter& getTransferPerfCounter() { return perf_; }
 
-    void set_options(bool tao_disabled, bool canfd) { tao_disabled_ = tao_disabled; canfd_ = canfd; }
+    void set_options(bool tao_disabled, bool canfd, bool canfd_negotiation = false)
+    {
+        tao_disabled_ = tao_disabled;
+        canfd_ = canfd;
+        canfd_negotiation_ = canfd_negotiation;
+    }
 };
 
 }
@@ -23,6 +23,7 @@ class UAVCAN_EXPORT Frame
     enum { PayloadCapacity = 7 };
 #endif
     uint8_t payload_[PayloadCapacity];
+    const uint8_t* payload_ref_;        ///< Points to the payload in the source CAN frame; null if it is copied
     TransferPriority transfer_priority_;
     TransferType transfer_type_;
     DataTypeID data_type_id_;
@@ -36,7 +37,16 @@ class UAVCAN_EXPORT Frame
     bool canfd_frame_;
 
 public:
+    /**
+     * Defines how parse() obtains the payload.
+     * PayloadCopy      - the payload is copied into the frame object.
+     * PayloadReference - the frame object refers to the payload in the source CAN frame, which avoids copying;
+     *                    the source CAN frame must outlive the frame object and all its copies.
+     */
+    enum PayloadStorage { PayloadCopy, PayloadReference };
+
     Frame() :
+        payload_ref_(UAVCAN_NULLPTR),
         transfer_type_(TransferType(NumTransferTypes)),                // Invalid value
         payload_len_(0),
         start_of_transfer_(false),
@@ -51,6 +61,7 @@ public:
           NodeID dst_node_id,
           TransferID transfer_id,
           bool canfd_frame = false) :
+        payload_ref_(UAVCAN_NULLPTR),
         transfer_priority_(TransferPriority::Default),
         transfer_type_(transfer_type),
         data_type_id_(data_type_id),
@@ -86,7 +97,12 @@ public:
     bool isCanFDFrame() const { return canfd_frame_; }
 
     unsigned getPayloadLen() const { return payload_len_; }
-    const uint8_t* getPayloadPtr() const { return payload_; }
+    const uint8_t* getPayloadPtr() const { return (payload_ref_ != UAVCAN_NULLPTR) ? payload_ref_ : payload_; }
+
+    /**
+     * Whether the payload is referenced in the source CAN frame rather than stored in this object.
+     */
+    bool isPayloadReferenced() const { return payload_ref_ != UAVCAN_NULLPTR; }
 
     TransferType getTransferType() const { return transfer_type_; }
     DataTypeID getDataTypeID()     const { return data_type_id_; }
@@ -103,9 +119,22 @@ public:
     void flipToggle() { toggle_ = !toggle_; }
     bool getToggle() const { return toggle_; }
 
-    bool parse(const CanFrame& can_frame);
+    bool parse(const CanFrame& can_frame, PayloadStorage payload_storage = PayloadCopy);
     bool compile(CanFrame& can_frame) const;
 
+    /**
+     * Parts of @ref compile() that can be used to build a CAN frame from a precompiled CAN ID.
+     * The payload is written into the CAN frame followed by the tail byte, and the DLC is set accordingly.
+     * @{
+     */
+    static uint8_t compileTailByte(TransferID transfer_id, bool start_of_transfer, bool end_of_transfer,
+                                   bool toggle);
+    static void compilePayload(CanFrame& out_can_frame, const uint8_t* payload, unsigned payload_len,
+                               uint8_t tail_byte);
+    /**
+     * @}
+     */
+
     bool isValid() const;
 
     bool operator!=(const Frame& rhs) const { return !operator==(rhs); }
@@ -117,6 +146,44 @@ public:
 };
 
 
+/**
+ * Splits the payload of a transfer into frames, see @ref TransferSender.
+ * Every frame but the last one is filled up to the capacity, the first one including the transfer CRC. The last
+ * frame gets the smallest DLC that fits its payload and the tail byte; the gap in between is filled with zeros.
+ * No other split into the same number of frames takes fewer bytes on the bus: the capacity of a frame is the largest
+ * DLC step, so whatever is taken away from a full frame would have to be carried by the last one. Using more frames
+ * than necessary could save a few padding bytes in some cases, but an extra frame costs more than that in the
+ * arbitration, CRC and interframe bits, so the number of frames is kept minimal as well.
+ * Classic CAN frames need no padding.
+ */
+struct UAVCAN_EXPORT TransferFramePlan
+{
+    uint16_t num_frames;
+    uint8_t frame_payload_capacity;     ///< Without the tail byte
+    uint8_t last_frame_payload_len;     ///< Without the padding and the tail byte
+    uint8_t num_padding_bytes;          ///< Taken for payload by the receivers; covered by the multi-frame CRC
+
+    TransferFramePlan(uint16_t payload_len, uint8_t frame_payload_capacity);
+
+    /**
+     * Smallest DLC of a frame that carries the given payload and the tail byte.
+     */
+    static uint8_t getDlcForPayload(unsigned frame_payload_len)
+    {
+        UAVCAN_ASSERT(frame_payload_len < CanFrame::MaxDataLen);
+        return CanFrame::dataLengthToDlc(uint8_t(frame_payload_len + 1U));
+    }
+
+    /**
+     * Sum of the data lengths of all frames, including the tail bytes.
+     */
+    unsigned getNumBytesOnBus() const
+    {
+        return (num_frames - 1U) * (frame_payload_capacity + 1U) + last_frame_payload_len + num_padding_bytes + 1U;
+    }
+};
+
+
 class UAVCAN_EXPORT RxFrame : public Frame
 {
     MonotonicTime ts_mono_;
@@ -136,7 +203,11 @@ public:
         *static_cast<Frame*>(this) = frame;
     }
 
-    bool parse(const CanRxFrame& can_frame);
+    /**
+     * Refer to @ref Frame::PayloadStorage. The dispatcher references the payload in the driver's frame buffer,
+     * which stays valid until the frame has been processed by all listeners.
+     */
+    bool parse(const CanRxFrame& can_frame, PayloadStorage payload_storage = PayloadCopy);
 
     /**
      * Can't be zero.
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_LEADING_FIELD_FILTER_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_LEADING_FIELD_FILTER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/std.hpp>
+#include <uavcan/transport/transfer_listener.hpp>
+#include <uavcan/transport/node_id_set.hpp>
+
+namespace uavcan
+{
+/**
+ * Frame filter that accepts only the transfers where the given leading field of the message equals the given value,
+ * e.g. the status messages of one ESC out of many. The field is decoded straight from the payload of the first frame,
+ * so that the rejected transfers are neither reassembled nor decoded; this saves both memory and CPU time on a busy
+ * bus. The field must be located at a constant offset, which is the case for the leading primitive fields that are
+ * accessible via the lazy view of the generated type:
+ *
+ *      uavcan::LeadingFieldFilter<uint8_t> filter(&uavcan::equipment::esc::Status::LazyView::peek_esc_index, 3);
+ *      subscriber.setFrameFilter(&filter);
+ *
+ * The rest of the frames of a rejected multi-frame transfer are rejected as well: the filter remembers the source
+ * nodes whose current transfer is being skipped (a listener receives at most one transfer from a node at a time).
+ * Transfers whose first frame is too short to contain the field are accepted, so that the filter never hides
+ * malformed messages from the decoder.
+ *
+ * An instance must not be shared between listeners.
+ *
+ * Note that only the first frame is checked, so a transfer delivered by a reception pipeline via
+ * @ref TransferListener::handleCompletedTransfer() is filtered only if it consists of a single frame.
+ */
+template <typename FieldValue>
+class UAVCAN_EXPORT LeadingFieldFilter : public ITransferAcceptanceFilter
+{
+public:
+    /**
+     * Signature of the peek_*() accessors of the generated types.
+     */
+    typedef int (*Peeker)(const uint8_t* data, unsigned len, FieldValue& out_value);
+
+private:
+    enum { TransferCRCSize = 2 };   ///< The first frame of a multi-frame transfer starts with the transfer CRC
+
+    const Peeker peeker_;
+    FieldValue value_;
+    mutable NodeIDSet skipped_sources_;     ///< Their current multi-frame transfers are being rejected
+
+public:
+    LeadingFieldFilter(Peeker peeker, const FieldValue& value)
+        : peeker_(peeker)
+        , value_(value)
+    {
+        UAVCAN_ASSERT(peeker_ != UAVCAN_NULLPTR);
+    }
+
+    /**
+     * The value can be changed at any time from the thread that spins the node.
+     */
+    void setValue(const FieldValue& value) { value_ = value; }
+    const FieldValue& getValue() const { return value_; }
+
+    virtual bool shouldAcceptFrame(const RxFrame& frame) const override
+    {
+        const NodeID src = frame.getSrcNodeID();
+        if (!frame.isStartOfTransfer())
+        {
+            const bool skipped = skipped_sources_.contains(src);
+            if (skipped && frame.isEndOfTransfer())
+            {
+                skipped_sources_.remove(src);
+            }
+            return !skipped;
+        }
+
+        const bool accept = isFieldMatching(frame);
+        if (!frame.isEndOfTransfer() && src.isUnicast())
+        {
+            skipped_sources_.set(src, !accept);
+        }
+        return accept;
+    }
+
+private:
+    bool isFieldMatching(const RxFrame& frame) const
+    {
+        const unsigned offset = frame.isEndOfTransfer() ? 0U : unsigned(TransferCRCSize);
+        if (frame.getPayloadLen() <= offset)
+        {
+            return true;
+        }
+        FieldValue field_value = FieldValue();
+        if (peeker_(frame.getPayloadPtr() + offset, frame.getPayloadLen() - offset, field_value) <= 0)
+        {
+            return true;
+        }
+        return field_value == value_;
+    }
+};
+
+}
+
+#endif // UAVCAN_TRANSPORT_LEADING_FIELD_FILTER_HPP_INCLUDED
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_NODE_ID_SET_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_NODE_ID_SET_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/std.hpp>
+#include <uavcan/transport/transfer.hpp>
+#include <uavcan/util/bitset.hpp>
+
+namespace uavcan
+{
+/**
+ * Set of node IDs, implemented as a bit mask of 128 bits.
+ * Unlike @ref BitSet, it operates on whole words, so that the size of the set, the lowest member, and the next
+ * member after a given one are found in a few steps regardless of the number of members, and the sets can be
+ * combined in bulk. This allows to iterate over the nodes that are actually present in the network rather than
+ * over all possible node IDs.
+ */
+class UAVCAN_EXPORT NodeIDSet
+{
+    enum { BitsPerWord = 32 };
+    enum { NumWords = (NodeID::Max + 1 + BitsPerWord - 1) / BitsPerWord };
+
+    uint32_t words_[NumWords];
+
+    static unsigned getWordIndex(NodeID nid) { return unsigned(nid.get()) / BitsPerWord; }
+    static uint32_t getBitMask(NodeID nid) { return uint32_t(1U) << (unsigned(nid.get()) % BitsPerWord); }
+
+    /**
+     * Lowest member that is not lower than the given value, or an invalid node ID if there is none.
+     */
+    NodeID findFrom(unsigned value) const
+    {
+        if (value > NodeID::Max)
+        {
+            return NodeID();
+        }
+        unsigned word_index = value / BitsPerWord;
+        uint32_t word = words_[word_index] & ~((uint32_t(1U) << (value % BitsPerWord)) - 1U);
+        while (word == 0)
+        {
+            word_index++;
+            if (word_index >= NumWords)
+            {
+                return NodeID();
+            }
+            word = words_[word_index];
+        }
+        return NodeID(uint8_t(word_index * BitsPerWord + findFirstSetBit(word)));
+    }
+
+public:
+    NodeIDSet() { clear(); }
+
+    void clear()
+    {
+        for (unsigned i = 0; i < NumWords; i++)
+        {
+            words_[i] = 0;
+        }
+    }
+
+    /**
+     * Invalid node IDs are ignored.
+     */
+    void add(NodeID nid)
+    {
+        if (nid.isValid())
+        {
+            words_[getWordIndex(nid)] |= getBitMask(nid);
+        }
+        else
+        {
+            UAVCAN_ASSERT(0);
+        }
+    }
+
+    void remove(NodeID nid)
+    {
+        if (nid.isValid())
+        {
+            words_[getWordIndex(nid)] &= ~getBitMask(nid);
+        }
+    }
+
+    void set(NodeID nid, bool value)
+    {
+        if (value)
+        {
+            add(nid);
+        }
+        else
+        {
+            remove(nid);
+        }
+    }
+
+    bool contains(NodeID nid) const
+    {
+        return nid.isValid() && ((words_[getWordIndex(nid)] & getBitMask(nid)) != 0);
+    }
+
+    /**
+     * Bulk operations.
+     */
+    void add(const NodeIDSet& rhs)
+    {
+        for (unsigned i = 0; i < NumWords; i++)
+        {
+            words_[i] |= rhs.words_[i];
+        }
+    }
+
+    void remove(const NodeIDSet& rhs)
+    {
+        for (unsigned i = 0; i < NumWords; i++)
+        {
+            words_[i] &= ~rhs.words_[i];
+        }
+    }
+
+    void intersect(const NodeIDSet& rhs)
+    {
+        for (unsigned i = 0; i < NumWords; i++)
+        {
+            words_[i] &= rhs.words_[i];
+        }
+    }
+
+    bool isEmpty() const
+    {
+        uint32_t accumulator = 0;
+        for (unsigned i = 0; i < NumWords; i++)
+        {
+            accumulator |= words_[i];
+        }
+        return accumulator == 0;
+    }
+
+    /**
+     * Number of members.
+     */
+    unsigned getSize() const
+    {
+        unsigned size = 0;
+        for (unsigned i = 0; i < NumWords; i++)
+        {
+            size += countSetBits(words_[i]);
+        }
+        return size;
+    }
+
+    /**
+     * Lowest member, or an invalid node ID if the set is empty.
+     */
+    NodeID getFirst() const { return findFrom(0); }
+
+    /**
+     * Lowest member that is higher than the given node ID, or an invalid node ID if there is none.
+     * If the argument is an invalid node ID, the result is the same as @ref getFirst().
+     */
+    NodeID getNext(NodeID nid) const { return nid.isValid() ? findFrom(unsigned(nid.get()) + 1U) : getFirst(); }
+
+    /**
+     * Same as @ref getNext(), but wraps around to the lowest member, which is useful for round-robin selection.
+     * The argument itself is returned only if it is the only member.
+     */
+    NodeID getNextCyclic(NodeID nid) const
+    {
+        const NodeID next = getNext(nid);
+        return next.isValid() ? next : getFirst();
+    }
+
+    /**
+     * Calls the operator for every member in ascending order.
+     * The operator may remove members from the set, including the current one.
+     * Operator signature:
+     *   void (NodeID)
+     */
+    template <typename Operator>
+    void forEach(Operator op) const
+    {
+        for (NodeID nid = getFirst(); nid.isValid(); nid = getNext(nid))
+        {
+            op(nid);
+        }
+    }
+
+    bool operator!=(const NodeIDSet& rhs) const { return !operator==(rhs); }
+    bool operator==(const NodeIDSet& rhs) const
+    {
+        for (unsigned i = 0; i < NumWords; i++)
+        {
+            if (words_[i] != rhs.words_[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+}
+
+#endif // UAVCAN_TRANSPORT_NODE_ID_SET_HPP_INCLUDED
@@ -8,7 +8,9 @@
 #include <cassert>
 #include <uavcan/std.hpp>
 #include <uavcan/build_config.hpp>
-#include <uavcan/util/map.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/data_type.hpp>
+#include <uavcan/util/hash_map.hpp>
 #include <uavcan/debug.hpp>
 #include <uavcan/transport/transfer.hpp>
 #include <uavcan/time.hpp>
@@ -43,6 +45,12 @@ public:
     DataTypeID getDataTypeID() const { return data_type_id_; }
     TransferType getTransferType() const { return TransferType(transfer_type_); }
 
+    uint32_t hash() const
+    {
+        return (uint32_t(data_type_id_.get()) << 16) | (uint32_t(transfer_type_) << 8) |
+               uint32_t(destination_node_id_.get());
+    }
+
     bool operator==(const OutgoingTransferRegistryKey& rhs) const
     {
         return
@@ -60,22 +68,73 @@ public:
  * Outgoing transfer registry keeps track of Transfer ID values for all currently existing local transfer senders.
  * If a local transfer sender was inactive for a sufficiently long time, the outgoing transfer registry will
  * remove the respective Transfer ID tracking object.
+ *
+ * If the set of the outgoing transfers is known in advance, which is typical for embedded applications, the
+ * Transfer ID tracking objects can be allocated statically instead, see @ref adoptStaticEntries().
  */
 class UAVCAN_EXPORT OutgoingTransferRegistry : Noncopyable
 {
+public:
+    /**
+     * Statically allocated Transfer ID tracking object, see @ref adoptStaticEntries().
+     */
+    class StaticEntry
+    {
+        friend class OutgoingTransferRegistry;
+
+        OutgoingTransferRegistryKey key_;
+        TransferID tid_;
+
+    public:
+        StaticEntry(DataTypeID data_type_id, TransferType transfer_type, NodeID destination_node_id)
+            : key_(data_type_id, transfer_type, destination_node_id)
+        { }
+
+        const OutgoingTransferRegistryKey& getKey() const { return key_; }
+        TransferID getTransferID() const { return tid_; }
+    };
+
+private:
     struct Value
     {
         MonotonicTime deadline;
         TransferID tid;
     };
 
+public:
+    /**
+     * Reference to the entry of the last key that was accessed with it, which a transfer sender keeps between
+     * the transfers, so that the entry of a key that doesn't change (e.g. of a broadcasting publisher) is accessed
+     * without a lookup. The dynamic entries don't move in memory until they are removed, so a cached reference
+     * stays valid as long as no dynamic entry has been removed from the registry since it was taken.
+     */
+    class EntryCache
+    {
+        friend class OutgoingTransferRegistry;
+
+        OutgoingTransferRegistryKey key_;
+        TransferID* tid_;
+        MonotonicTime* deadline_;           ///< Null for the static entries, which never expire
+        uint32_t generation_;
+
+    public:
+        EntryCache()
+            : tid_(UAVCAN_NULLPTR)
+            , deadline_(UAVCAN_NULLPTR)
+            , generation_(0)
+        { }
+    };
+
+private:
     class DeadlineExpiredPredicate
     {
         const MonotonicTime ts_;
+        unsigned& num_expired_;
 
     public:
-        explicit DeadlineExpiredPredicate(MonotonicTime ts)
+        DeadlineExpiredPredicate(MonotonicTime ts, unsigned& num_expired)
             : ts_(ts)
+            , num_expired_(num_expired)
         { }
 
         bool operator()(const OutgoingTransferRegistryKey& key, const Value& value) const
@@ -87,6 +146,7 @@ class UAVCAN_EXPORT OutgoingTransferRegistry : Noncopyable
             {
                 UAVCAN_TRACE("OutgoingTransferRegistry", "Expired %s tid=%i",
                              key.toString().c_str(), int(value.tid.get()));
+                num_expired_++;
             }
             return expired;
         }
@@ -109,17 +169,68 @@ class UAVCAN_EXPORT OutgoingTransferRegistry : Noncopyable
         }
     };
 
-    Map<OutgoingTransferRegistryKey, Value> map_;
+    TaggedPoolAllocator allocator_;
+    HashMap<OutgoingTransferRegistryKey, Value> map_;
+    StaticEntry* static_entries_;           ///< Sorted by key hash
+    uint16_t num_static_entries_;
+    uint32_t generation_;                   ///< Incremented when dynamic entries are removed, see EntryCache
+
+    StaticEntry* findStaticEntry(const OutgoingTransferRegistryKey& key) const;
+
+    Value* accessOrCreateDynamic(const OutgoingTransferRegistryKey& key, MonotonicTime new_deadline);
 
 public:
     static const MonotonicDuration MinEntryLifetime;
 
     explicit OutgoingTransferRegistry(IPoolAllocator& allocator)
-        : map_(allocator)
+        : allocator_(allocator, PoolUsageTagOutgoingTransferRegistry)
+        , map_(allocator_)
+        , static_entries_(UAVCAN_NULLPTR)
+        , num_static_entries_(0)
+        , generation_(0)
     { }
 
+    /**
+     * Makes the registry use the given statically allocated entries for their keys, so that the transfer senders
+     * of the outgoing transfers that are known in advance (e.g. all publishers of the application) don't need
+     * the pool memory, and the Transfer ID lookups don't involve the hash map. The static entries never expire.
+     * The other keys are handled dynamically as usual.
+     *
+     *      static uavcan::OutgoingTransferRegistry::StaticEntry otr_entries[] =
+     *      {
+     *          { uavcan::protocol::NodeStatus::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+     *            uavcan::NodeID::Broadcast },
+     *          ...
+     *      };
+     *      node.getDispatcher().getOutgoingTransferRegistry().adoptStaticEntries(otr_entries);
+     *
+     * The entries are referenced, not copied, so they must stay valid forever; they are reordered in place.
+     * The Transfer IDs of the keys that already have dynamic entries are carried over.
+     * The entries can be adopted only once.
+     *
+     * Returns negative error code: -ErrLogic if the entries have been adopted already, -ErrInvalidParam if
+     * the keys are not unique.
+     */
+    int adoptStaticEntries(StaticEntry* entries, unsigned num_entries);
+
+    template <unsigned NumEntries>
+    int adoptStaticEntries(StaticEntry (&entries)[NumEntries]) { return adoptStaticEntries(entries, NumEntries); }
+
+    unsigned getNumStaticEntries() const { return num_static_entries_; }
+
     TransferID* accessOrCreate(const OutgoingTransferRegistryKey& key, MonotonicTime new_deadline);
 
+    /**
+     * Same as above, but skips the lookup if the cache refers to the entry of this key; the cache is updated
+     * otherwise.
+     */
+    TransferID* accessOrCreate(const OutgoingTransferRegistryKey& key, MonotonicTime new_deadline,
+                               EntryCache& cache);
+
+    /**
+     * Takes constant time on average for the message broadcast transfers, which is what the data type
+     * introspection asks for; the other transfer types require a scan.
+     */
     bool exists(DataTypeID dtid, TransferType tt) const;
 
     void cleanup(MonotonicTime ts);
@@ -8,6 +8,8 @@
 #include <uavcan/std.hpp>
 #include <uavcan/build_config.hpp>
 #include <uavcan/util/templates.hpp>
+#include <uavcan/transport/frame.hpp>
+#include <uavcan/transport/transport_stats.hpp>
 
 namespace uavcan
 {
@@ -16,14 +18,25 @@ namespace uavcan
 
 class UAVCAN_EXPORT TransferPerfCounter : Noncopyable
 {
+    TransportStats stats_;
+
 public:
     void addTxTransfer() { }
+    void addTxTransfer(TransferType transfer_type, DataTypeID dtid) { stats_.addTxTransfer(transfer_type, dtid); }
     void addRxTransfer() { }
+    void addRxTransfer(TransferType transfer_type, DataTypeID dtid) { stats_.addRxTransfer(transfer_type, dtid); }
     void addError() { }
     void addErrors(unsigned) { }
+    void addRxErrorCauses(uint8_t cause_mask) { stats_.addRxErrors(cause_mask); }
+    void addRxSourceTransfer(const RxFrame&) { }
+    void addRxSourceStartOfTransfer(const RxFrame&) { }
+    void addRxSourceErrors(TransferType, NodeID, DataTypeID, uint8_t) { }
+    void addRxLatency(MonotonicDuration latency) { stats_.addRxLatency(latency); }
     uint64_t getTxTransferCount() const { return 0; }
     uint64_t getRxTransferCount() const { return 0; }
     uint64_t getErrorCount() const { return 0; }
+    const TransportStats& getTransportStats() const { return stats_; }
+    TransportStats& getTransportStats() { return stats_; }
 };
 
 #else
@@ -38,6 +51,7 @@ class UAVCAN_EXPORT TransferPerfCounter : Noncopyable
     uint64_t transfers_tx_;
     uint64_t transfers_rx_;
     uint64_t errors_;
+    TransportStats stats_;
 
 public:
     TransferPerfCounter()
@@ -49,6 +63,20 @@ public:
     void addTxTransfer() { transfers_tx_++; }
     void addRxTransfer() { transfers_rx_++; }
 
+    /**
+     * Same as above, plus the per data type counters of @ref TransportStats.
+     */
+    void addTxTransfer(TransferType transfer_type, DataTypeID dtid)
+    {
+        transfers_tx_++;
+        stats_.addTxTransfer(transfer_type, dtid);
+    }
+    void addRxTransfer(TransferType transfer_type, DataTypeID dtid)
+    {
+        transfers_rx_++;
+        stats_.addRxTransfer(transfer_type, dtid);
+    }
+
     void addError() { errors_++; }
 
     void addErrors(unsigned errors)
@@ -56,6 +84,42 @@ public:
         errors_ += errors;
     }
 
+    /**
+     * Breakdown of the reassembly errors by cause; the errors themselves are counted with addErrors().
+     * Bit N of the mask stands for the cause N, see @ref TransferErrorCause.
+     */
+    void addRxErrorCauses(uint8_t cause_mask)
+    {
+        if (cause_mask != 0)
+        {
+            stats_.addRxErrors(cause_mask);
+        }
+    }
+
+    /**
+     * Per stream statistics of @ref TransportStats: the transfer completed by the given frame, a start-of-transfer
+     * frame that did not complete a transfer, and the causes of the reassembly errors of a stream.
+     */
+    void addRxSourceTransfer(const RxFrame& frame)
+    {
+        stats_.addRxSourceTransfer(frame.getTransferType(), frame.getSrcNodeID(), frame.getDataTypeID(),
+                                   frame.getTransferID());
+    }
+    void addRxSourceStartOfTransfer(const RxFrame& frame)
+    {
+        stats_.addRxSourceStartOfTransfer(frame.getTransferType(), frame.getSrcNodeID(), frame.getDataTypeID(),
+                                          frame.getTransferID());
+    }
+    void addRxSourceErrors(TransferType transfer_type, NodeID src_node_id, DataTypeID dtid, uint8_t cause_mask)
+    {
+        if (cause_mask != 0)
+        {
+            stats_.addRxSourceErrors(transfer_type, src_node_id, dtid, cause_mask);
+        }
+    }
+
+    void addRxLatency(MonotonicDuration latency) { stats_.addRxLatency(latency); }
+
     /**
      * Returned references are guaranteed to be valid as long as this instance of Node exists.
      * This is enforced by virtue of the class being Noncopyable.
@@ -63,6 +127,12 @@ public:
     const uint64_t& getTxTransferCount() const { return transfers_tx_; }
     const uint64_t& getRxTransferCount() const { return transfers_rx_; }
     const uint64_t& getErrorCount() const { return errors_; }
+
+    /**
+     * Extended statistics; all of them read zero if @ref UAVCAN_TRANSPORT_STATS is disabled.
+     */
+    const TransportStats& getTransportStats() const { return stats_; }
+    TransportStats& getTransportStats() { return stats_; }
 };
 
 #endif
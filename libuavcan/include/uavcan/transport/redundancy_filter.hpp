@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_REDUNDANCY_FILTER_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_REDUNDANCY_FILTER_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/driver/can.hpp>
+#include <uavcan/time.hpp>
+
+namespace uavcan
+{
+/**
+ * Drops the copies of CAN frames received via redundant interfaces before they are parsed and dispatched.
+ *
+ * Every stream of frames, i.e. every CAN ID excluding the priority, is locked to one interface, following the same
+ * policy as @ref TransferReceiver: frames from other interfaces are dropped, unless the locked interface has been
+ * silent for longer than the estimated transfer interval of the stream or the TID timeout, whichever is shorter,
+ * in which case the lock is moved to the interface that delivered the next start-of-transfer frame. This way the transfer receivers only get the frames
+ * they would have accepted anyway, which is why the filter can't reject a frame a receiver needs.
+ *
+ * The streams are kept in a small direct-mapped table. The frames of a stream that collides with another active
+ * stream are not filtered; they are deduplicated by the transfer receivers as usual.
+ * Anonymous frames are never filtered, because they are not deduplicated by the receivers either.
+ */
+class UAVCAN_EXPORT RedundantFrameFilter : Noncopyable
+{
+public:
+    enum { Capacity = UAVCAN_DISPATCHER_REDUNDANCY_FILTER_CAPACITY };
+
+#if UAVCAN_DISPATCHER_REDUNDANCY_FILTER_CAPACITY > 0
+private:
+    enum { DefaultIntervalMSec = 1000 };    ///< Same as TransferReceiver::DefaultTransferIntervalMSec
+    enum { StreamTimeoutMSec = 1000 };      ///< Same as TransferReceiver::DefaultTidTimeoutMSec
+
+    struct Stream
+    {
+        MonotonicTime last_ts;              ///< Last frame from the locked interface
+        MonotonicTime last_sot_ts;          ///< Last start-of-transfer frame from the locked interface
+        uint32_t can_id;                    ///< Zero if unused
+        uint16_t interval_msec;
+        uint8_t iface_index;
+
+        Stream()
+            : can_id(0)
+            , interval_msec(DefaultIntervalMSec)
+            , iface_index(0)
+        { }
+    };
+
+    Stream streams_[Capacity];
+    uint32_t num_dropped_frames_;
+    uint32_t num_collisions_;
+
+    static unsigned computeIndex(uint32_t key);
+
+    static void updateInterval(Stream& stream, MonotonicTime sot_ts);
+
+public:
+    RedundantFrameFilter()
+        : num_dropped_frames_(0)
+        , num_collisions_(0)
+    {
+        StaticAssert<(Capacity & (Capacity - 1)) == 0>::check();
+    }
+
+    /**
+     * @param frame         Received frame, not loopback. The interface index and the monotonic timestamp are used.
+     * @return              False if the frame is a redundant copy and must be dropped.
+     */
+    bool accept(const CanRxFrame& frame);
+
+    /**
+     * Forgets all streams; e.g. after the monotonic clock has been adjusted.
+     */
+    void reset();
+
+    /**
+     * Number of frames rejected as redundant copies.
+     */
+    uint32_t getNumDroppedFrames() const { return num_dropped_frames_; }
+
+    /**
+     * Number of frames that were not filtered because their stream collided with another active stream.
+     * If this number grows quickly, the capacity should be increased.
+     */
+    uint32_t getNumCollisions() const { return num_collisions_; }
+#else
+    RedundantFrameFilter() { }
+
+    bool accept(const CanRxFrame&) { return true; }
+    void reset() { }
+    uint32_t getNumDroppedFrames() const { return 0; }
+    uint32_t getNumCollisions() const { return 0; }
+#endif
+};
+
+}
+
+#endif // UAVCAN_TRANSPORT_REDUNDANCY_FILTER_HPP_INCLUDED
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_RX_RATE_LIMITER_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_RX_RATE_LIMITER_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/driver/can.hpp>
+#include <uavcan/time.hpp>
+#include <uavcan/transport/transfer.hpp>
+
+namespace uavcan
+{
+/**
+ * Limits the rate of incoming transfers per source node and transfer type, so that a malfunctioning node that
+ * floods the bus with transfers can't make the transfer listeners allocate receivers and buffers for all of them
+ * and exhaust the memory pool. The other nodes keep their latency and memory while the offender is throttled.
+ *
+ * The limit is a token bucket (implemented as the generic cell rate algorithm) of a given rate and burst size,
+ * which applies to the start-of-transfer frames, since every one of them opens a new transfer; the following
+ * frames of a rejected transfer are ignored by the receivers anyway. The check is done by the dispatcher using the
+ * CAN frame alone, before the frame is parsed. Anonymous frames are not limited.
+ *
+ * The limits are disabled by default; they are configured per transfer type.
+ */
+class UAVCAN_EXPORT RxRateLimiter : Noncopyable
+{
+#if UAVCAN_DISPATCHER_RX_RATE_LIMITING
+    struct Limit
+    {
+        uint32_t transfers_per_second;      ///< Zero if the limit is disabled
+        uint32_t emission_interval_usec;
+        uint32_t tolerance_usec;            ///< Burst size minus one, times the emission interval
+
+        Limit()
+            : transfers_per_second(0)
+            , emission_interval_usec(0)
+            , tolerance_usec(0)
+        { }
+    };
+
+    Limit limits_[NumTransferTypes];
+
+    /**
+     * Theoretical arrival time of the next transfer, lower 32 bits of the monotonic time in microseconds,
+     * per transfer type and source node ID.
+     */
+    uint32_t arrival_times_[NumTransferTypes][NodeID::Max + 1];
+
+    uint32_t num_throttled_transfers_;
+    NodeID last_throttled_node_id_;
+
+public:
+    RxRateLimiter()
+        : num_throttled_transfers_(0)
+    {
+        fill_n(&arrival_times_[0][0], unsigned(NumTransferTypes) * (NodeID::Max + 1U), 0U);
+    }
+
+    /**
+     * @param transfer_type         Transfer type the limit applies to.
+     * @param transfers_per_second  Sustained rate per source node; zero disables the limit.
+     * @param burst                 Number of transfers a node may send at once after having been silent.
+     */
+    void setLimit(TransferType transfer_type, uint32_t transfers_per_second, uint16_t burst);
+
+    /**
+     * Sustained rate per source node of the given transfer type, transfers per second; zero if disabled.
+     */
+    uint32_t getLimit(TransferType transfer_type) const;
+
+    /**
+     * @param frame         Received frame, not loopback. The monotonic timestamp is used.
+     * @return              False if the frame opens a transfer that exceeds the limit and must be dropped.
+     */
+    bool accept(const CanRxFrame& frame);
+
+    /**
+     * Forgets the history of all nodes; e.g. after the monotonic clock has been adjusted.
+     */
+    void reset();
+
+    /**
+     * Number of transfers that have been dropped, over all nodes.
+     */
+    uint32_t getNumThrottledTransfers() const { return num_throttled_transfers_; }
+
+    /**
+     * Source of the most recently dropped transfer, invalid if none; helps to find the offender.
+     */
+    NodeID getLastThrottledNodeID() const { return last_throttled_node_id_; }
+#else
+public:
+    RxRateLimiter() { }
+
+    void setLimit(TransferType, uint32_t, uint16_t) { }
+    uint32_t getLimit(TransferType) const { return 0; }
+    bool accept(const CanRxFrame&) { return true; }
+    void reset() { }
+    uint32_t getNumThrottledTransfers() const { return 0; }
+    NodeID getLastThrottledNodeID() const { return NodeID(); }
+#endif
+};
+
+}
+
+#endif // UAVCAN_TRANSPORT_RX_RATE_LIMITER_HPP_INCLUDED
@@ -109,11 +109,6 @@ class UAVCAN_EXPORT TransferBufferManagerEntry : public ITransferBuffer
 
         static Block* instantiate(IPoolAllocator& allocator);
         static void destroy(Block*& obj, IPoolAllocator& allocator);
-
-        void read(uint8_t*& outptr, unsigned target_offset,
-                  unsigned& total_offset, unsigned& left_to_read);
-        void write(const uint8_t*& inptr, unsigned target_offset,
-                   unsigned& total_offset, unsigned& left_to_write);
     };
 
     IPoolAllocator& allocator_;
@@ -122,11 +117,27 @@ class UAVCAN_EXPORT TransferBufferManagerEntry : public ITransferBuffer
     const uint16_t max_size_;
     TransferBufferManagerKey key_;
 
+    /*
+     * The block that was accessed last, and its offset in the buffer. Transfers are written and decoded
+     * sequentially, so the next access usually starts in the same block, which eliminates walking the chain
+     * from the head on every call.
+     */
+    mutable Block* cached_block_;
+    mutable uint16_t cached_block_offset_;
+
+    /**
+     * Returns the block that contains the specified offset, or the last block if the chain is shorter.
+     * Returns null if there are no blocks.
+     */
+    Block* findBlock(unsigned offset, unsigned& out_block_offset) const;
+
 public:
     TransferBufferManagerEntry(IPoolAllocator& allocator, uint16_t max_size) :
         allocator_(allocator),
         max_write_pos_(0),
-        max_size_(max_size)
+        max_size_(max_size),
+        cached_block_(UAVCAN_NULLPTR),
+        cached_block_offset_(0)
     {
         StaticAssert<(Block::Size > 8)>::check();
         IsDynamicallyAllocatable<Block>::check();
@@ -147,21 +158,115 @@ public:
     bool isEmpty() const { return key_.isEmpty(); }
 };
 
+#if UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD > 0
+/**
+ * Open-addressing hash table of buffer manager entries, keyed by TransferBufferManagerKey.
+ * Internal for TransferBufferManager.
+ * The slots are stored in pool blocks (pages), which are addressed via a two-level directory of pool blocks,
+ * so that the capacity can reach hundreds of entries without any memory allocated outside of the pool.
+ * Collisions are resolved by linear probing; removal uses backward shift, so no tombstones are needed.
+ */
+class UAVCAN_EXPORT TransferBufferIndex : Noncopyable
+{
+    typedef TransferBufferManagerEntry* Slot;
+
+    enum { PointersPerBlock = MemPoolBlockSize / sizeof(void*) };
+    enum { MaxPages = PointersPerBlock * PointersPerBlock };
+
+    struct Page
+    {
+        Slot slots[PointersPerBlock];
+    };
+    struct Directory
+    {
+        Page* pages[PointersPerBlock];
+    };
+    struct Root
+    {
+        Directory* dirs[PointersPerBlock];
+    };
+
+    IPoolAllocator& allocator_;
+    Root* root_;
+    uint16_t num_pages_;
+
+    Slot& slotAt(unsigned index) const
+    {
+        const unsigned page = index / unsigned(PointersPerBlock);
+        return root_->dirs[page / unsigned(PointersPerBlock)]->pages[page % unsigned(PointersPerBlock)]->
+            slots[index % unsigned(PointersPerBlock)];
+    }
+
+    template <typename T> T* allocateBlock();
+    template <typename T> void deallocateBlock(T* ptr);
+
+    unsigned getHomeSlot(const TransferBufferManagerKey& key) const;
+
+public:
+    explicit TransferBufferIndex(IPoolAllocator& allocator)
+        : allocator_(allocator)
+        , root_(UAVCAN_NULLPTR)
+        , num_pages_(0)
+    {
+        StaticAssert<(PointersPerBlock > 1)>::check();
+        IsDynamicallyAllocatable<Page>::check();
+        IsDynamicallyAllocatable<Directory>::check();
+        IsDynamicallyAllocatable<Root>::check();
+    }
+
+    ~TransferBufferIndex() { release(); }
+
+    /**
+     * Reallocates the index so that it can hold num_entries with a reasonable load factor, and fills it
+     * from the list. Returns false and releases the memory if that is impossible (OOM or too many entries).
+     */
+    bool rebuild(const LinkedListRoot<TransferBufferManagerEntry>& list, unsigned num_entries);
+
+    void release();
+
+    bool isActive() const { return root_ != UAVCAN_NULLPTR; }
+
+    unsigned getCapacity() const { return unsigned(num_pages_) * unsigned(PointersPerBlock); }
+
+    /**
+     * Whether the index can accommodate one more entry without degrading the probe sequence length too much.
+     */
+    bool canInsert(unsigned num_entries) const { return (num_entries + 1U) * 4U <= getCapacity() * 3U; }
+
+    TransferBufferManagerEntry* find(const TransferBufferManagerKey& key) const;
+    void insert(TransferBufferManagerEntry* entry);
+    void remove(const TransferBufferManagerEntry* entry);
+};
+#endif
+
 /**
  * Buffer manager implementation.
+ * If the number of buffers reaches @ref UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD, lookups are served
+ * by a hash index instead of walking the list.
  */
 class TransferBufferManager : public Noncopyable
 {
     LinkedListRoot<TransferBufferManagerEntry> buffers_;
     IPoolAllocator& allocator_;
+#if UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD > 0
+    TransferBufferIndex index_;
+#endif
     const uint16_t max_buf_size_;
+    uint16_t num_buffers_;
 
     TransferBufferManagerEntry* findFirst(const TransferBufferManagerKey& key);
 
+    void addToIndex(TransferBufferManagerEntry* entry);
+    void removeFromIndex(const TransferBufferManagerEntry* entry);
+
 public:
     TransferBufferManager(uint16_t max_buf_size, IPoolAllocator& allocator) :
         allocator_(allocator),
-        max_buf_size_(max_buf_size)
+#if UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD > 0
+        index_(allocator),
+#endif
+        max_buf_size_(max_buf_size),
+        num_buffers_(0)
     { }
 
     ~TransferBufferManager();
@@ -172,6 +277,12 @@ public:
     bool isEmpty() const;
 
     unsigned getNumBuffers() const;
+
+#if UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD > 0
+    bool isIndexed() const { return index_.isActive(); }
+#else
+    bool isIndexed() const { return false; }
+#endif
 };
 
 /**
@@ -181,17 +292,39 @@ class UAVCAN_EXPORT TransferBufferAccessor
 {
     TransferBufferManager& bufmgr_;
     const TransferBufferManagerKey key_;
+    ITransferBuffer* const external_buffer_;
 
 public:
     TransferBufferAccessor(TransferBufferManager& bufmgr, TransferBufferManagerKey key) :
         bufmgr_(bufmgr),
-        key_(key)
+        key_(key),
+        external_buffer_(UAVCAN_NULLPTR)
+    {
+        UAVCAN_ASSERT(!key.isEmpty());
+    }
+
+    /**
+     * The given buffer is used instead of the one of the buffer manager, e.g. to consume the payload as it arrives.
+     * Removal is a no-op then.
+     */
+    TransferBufferAccessor(TransferBufferManager& bufmgr, TransferBufferManagerKey key,
+                           ITransferBuffer& external_buffer) :
+        bufmgr_(bufmgr),
+        key_(key),
+        external_buffer_(&external_buffer)
     {
         UAVCAN_ASSERT(!key.isEmpty());
     }
-    ITransferBuffer* access() { return bufmgr_.access(key_); }
-    ITransferBuffer* create() { return bufmgr_.create(key_); }
-    void remove() { bufmgr_.remove(key_); }
+
+    ITransferBuffer* access() { return (external_buffer_ != UAVCAN_NULLPTR) ? external_buffer_ : bufmgr_.access(key_); }
+    ITransferBuffer* create() { return (external_buffer_ != UAVCAN_NULLPTR) ? external_buffer_ : bufmgr_.create(key_); }
+    void remove()
+    {
+        if (external_buffer_ == UAVCAN_NULLPTR)
+        {
+            bufmgr_.remove(key_);
+        }
+    }
 };
 
 }
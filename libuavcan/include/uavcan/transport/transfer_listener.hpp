@@ -14,6 +14,7 @@
 #include <uavcan/util/map.hpp>
 #include <uavcan/debug.hpp>
 #include <uavcan/transport/crc.hpp>
+#include <uavcan/transport/node_id_set.hpp>
 #include <uavcan/data_type.hpp>
 
 namespace uavcan
@@ -57,6 +58,16 @@ public:
      */
     virtual void release() { }
 
+    /**
+     * Returns the pointer to the payload if it is stored contiguously in memory (single-frame transfers),
+     * otherwise null. This allows to decode the payload directly, bypassing read().
+     */
+    virtual const uint8_t* getContiguousPayload(unsigned& out_len) const
+    {
+        out_len = 0;
+        return UAVCAN_NULLPTR;
+    }
+
     /**
      * Whether this is a anonymous transfer
      */
@@ -73,6 +84,65 @@ public:
     bool isTaoDisabled()                  const { return tao_disabled_; }
 };
 
+/**
+ * Payload of an incoming transfer in contiguous memory, for decoding without calling IncomingTransfer::read()
+ * for every field. Single-frame transfers are referenced in place; multi-frame transfers that are not longer than
+ * MaxLen bytes are copied into the internal buffer at once. Otherwise the payload is not available and the transfer
+ * has to be read as usual.
+ */
+template <unsigned MaxLen>
+class UAVCAN_EXPORT LinearizedIncomingTransfer : Noncopyable
+{
+    uint8_t buf_[(MaxLen > 0) ? MaxLen : 1];
+    const uint8_t* data_;
+    unsigned len_;
+
+public:
+    explicit LinearizedIncomingTransfer(const IncomingTransfer& transfer)
+        : data_(UAVCAN_NULLPTR)
+        , len_(0)
+    {
+        data_ = transfer.getContiguousPayload(len_);
+        if ((data_ != UAVCAN_NULLPTR) || (MaxLen == 0))
+        {
+            return;
+        }
+        const int res = transfer.read(0, buf_, MaxLen);
+        if (res < 0)
+        {
+            return;
+        }
+        if (unsigned(res) == MaxLen)
+        {
+            uint8_t probe = 0;                  // The payload must fit completely, otherwise tail arrays break
+            if (transfer.read(MaxLen, &probe, 1) != 0)
+            {
+                return;
+            }
+        }
+        data_ = buf_;
+        len_ = unsigned(res);
+    }
+
+    /**
+     * Null if the payload is not available in contiguous memory.
+     */
+    const uint8_t* getData() const { return data_; }
+    unsigned getLength() const { return len_; }
+};
+
+/**
+ * Size of the buffer of @ref LinearizedIncomingTransfer for the given data type, see
+ * UAVCAN_RX_LINEARIZATION_MAX_LEN.
+ */
+template <typename DataType>
+struct UAVCAN_EXPORT RxLinearizationBufferSize
+{
+    enum { MaxEncodedLen = (unsigned(DataType::MaxBitLen) + 7U) / 8U };
+    enum { Result = (unsigned(MaxEncodedLen) < unsigned(UAVCAN_RX_LINEARIZATION_MAX_LEN)) ?
+                    unsigned(MaxEncodedLen) : unsigned(UAVCAN_RX_LINEARIZATION_MAX_LEN) };
+};
+
 /**
  * Internal.
  */
@@ -84,6 +154,11 @@ public:
     explicit SingleFrameIncomingTransfer(const RxFrame& frm, bool tao_disabled = false);
     virtual int read(unsigned offset, uint8_t* data, unsigned len) const override;
     virtual bool isAnonymousTransfer() const override;
+    virtual const uint8_t* getContiguousPayload(unsigned& out_len) const override
+    {
+        out_len = payload_len_;
+        return payload_;
+    }
 };
 
 /**
@@ -99,51 +174,128 @@ public:
     virtual void release() override { buf_acc_.remove(); }
 };
 
+/**
+ * This class is used by transfer listener to decide if the frame should be accepted or ignored.
+ */
+class ITransferAcceptanceFilter
+{
+public:
+    /**
+     * If it returns false, the frame will be ignored, otherwise accepted.
+     */
+    virtual bool shouldAcceptFrame(const RxFrame& frame) const = 0;
+
+    virtual ~ITransferAcceptanceFilter() { }
+};
+
 /**
  * Internal, refer to the transport dispatcher class.
  */
-class UAVCAN_EXPORT TransferListener : public LinkedListNode<TransferListener>
+class UAVCAN_EXPORT TransferListener : public DoublyLinkedListNode<TransferListener>
 {
     const DataTypeDescriptor& data_type_;
+    GuaranteedPoolAllocator rx_buffer_allocator_;
+    GuaranteedPoolAllocator receiver_map_allocator_;
     TransferBufferManager bufmgr_;
     Map<TransferBufferManagerKey, TransferReceiver> receivers_;
     TransferPerfCounter& perf_;
     const TransferCRC crc_base_;                      ///< Pre-initialized with data type hash, thus constant
+    MonotonicTime earliest_receiver_expiry_;          ///< None of the receivers can time out before this moment
+    NodeIDSet preregistered_sources_;                 ///< Their receivers are kept regardless of the activity
+    NodeIDSet source_filter_;                         ///< Empty if the transfers from all nodes are accepted
+    const ITransferAcceptanceFilter* frame_filter_;
     bool allow_anonymous_transfers_;
+    bool frame_filtering_enabled_;                    ///< Either of the above filters is set
 
     class TimedOutReceiverPredicate
     {
         const MonotonicTime ts_;
         TransferBufferManager& parent_bufmgr_;
+        TransferPerfCounter& perf_;
+        const DataTypeID data_type_id_;
+        const NodeIDSet& preregistered_sources_;
+        MonotonicTime& earliest_expiry_;
 
     public:
-        TimedOutReceiverPredicate(MonotonicTime arg_ts, TransferBufferManager& arg_bufmgr)
+        TimedOutReceiverPredicate(MonotonicTime arg_ts, TransferBufferManager& arg_bufmgr, TransferPerfCounter& perf,
+                                  DataTypeID data_type_id, const NodeIDSet& preregistered_sources,
+                                  MonotonicTime& earliest_expiry)
             : ts_(arg_ts)
             , parent_bufmgr_(arg_bufmgr)
+            , perf_(perf)
+            , data_type_id_(data_type_id)
+            , preregistered_sources_(preregistered_sources)
+            , earliest_expiry_(earliest_expiry)
         { }
 
         bool operator()(const TransferBufferManagerKey& key, const TransferReceiver& value) const;
     };
 
-    bool checkPayloadCrc(const uint16_t compare_with, const ITransferBuffer& tbb) const;
+    class NodeReceiverPredicate
+    {
+        const NodeID node_id_;
+        TransferBufferManager& parent_bufmgr_;
+
+    public:
+        NodeReceiverPredicate(NodeID arg_node_id, TransferBufferManager& arg_bufmgr)
+            : node_id_(arg_node_id)
+            , parent_bufmgr_(arg_bufmgr)
+        { }
+
+        bool operator()(const TransferBufferManagerKey& key, const TransferReceiver&) const;
+    };
 
 protected:
-    void handleReception(TransferReceiver& receiver, const RxFrame& frame, TransferBufferAccessor& tba, bool tao_disabled);
+    /**
+     * Feeds the frame to the receiver and delivers the transfer if it is complete.
+     * Overridden by the listeners that consume the payload differently, see @ref StreamingTransferListener.
+     */
+    virtual void handleReception(TransferReceiver& receiver, const RxFrame& frame, TransferBufferAccessor& tba,
+                                 bool tao_disabled);
     void handleAnonymousTransferReception(const RxFrame& frame, bool tao_disabled);
 
+    TransferPerfCounter& getPerfCounter() { return perf_; }
+
+    const TransferCRC& getTransferCRCBase() const { return crc_base_; }
+
     uint16_t actual_max_buffer_size(uint16_t max_buffer_size);
 
+    bool isFrameFilteredOut(const RxFrame& frame) const;
+
+    /**
+     * Returns the receiver associated with the given key, or null if there is none.
+     * If the receiver does not exist and create is true, a new one will be registered; null will be returned
+     * if the registration has failed.
+     * The default implementation keeps the receivers in a dynamically allocated map.
+     */
+    virtual TransferReceiver* findReceiver(const TransferBufferManagerKey& key, bool create);
+
+    /**
+     * Removes the receivers that have timed out by the given moment, along with their buffers.
+     * Returns the earliest expiry time of the receivers that remain, or @ref MonotonicTime::getMax() if none.
+     * Derived classes that keep receivers outside of the map must extend this method.
+     */
+    virtual MonotonicTime removeTimedOutReceivers(MonotonicTime ts);
+
+    TransferBufferManager& getBufferManager() { return bufmgr_; }
+
+    bool isPreregisteredSource(NodeID node_id) const { return preregistered_sources_.contains(node_id); }
+
     virtual void handleIncomingTransfer(IncomingTransfer& transfer) = 0;
 
 public:
     TransferListener(TransferPerfCounter& perf, const DataTypeDescriptor& data_type,
                      uint16_t max_buffer_size, IPoolAllocator& allocator)
         : data_type_(data_type)
-        , bufmgr_(actual_max_buffer_size(max_buffer_size), allocator)
-        , receivers_(allocator)
+        , rx_buffer_allocator_(allocator, PoolUsageTagRxBuffer)
+        , receiver_map_allocator_(allocator, PoolUsageTagReceiverMap)
+        , bufmgr_(actual_max_buffer_size(max_buffer_size), rx_buffer_allocator_)
+        , receivers_(receiver_map_allocator_)
         , perf_(perf)
-        , crc_base_(data_type.getSignature().toTransferCRC())
+        , crc_base_(data_type.getTransferCRCBase())
+        , frame_filter_(UAVCAN_NULLPTR)
         , allow_anonymous_transfers_(false)
+        , frame_filtering_enabled_(false)
     { }
 
     virtual ~TransferListener();
@@ -156,23 +308,286 @@ public:
      */
     void allowAnonymousTransfers() { allow_anonymous_transfers_ = true; }
 
-    void cleanup(MonotonicTime ts);
+    /**
+     * If the set is not empty, only the frames from these nodes are accepted; anonymous frames are rejected too.
+     * The frames are dropped before a receiver or a buffer is allocated for them, and the set is also used by
+     * @ref CanAcceptanceFilterConfigurator to narrow down the hardware filter of the data type, where the node IDs
+     * share enough bits to allow that. Empty by default, i.e. all nodes are accepted.
+     */
+    void setSourceNodeFilter(const NodeIDSet& sources);
+    const NodeIDSet& getSourceNodeFilter() const { return source_filter_; }
+
+    /**
+     * If set, frames that the filter rejects are dropped before a receiver or a buffer is allocated for them,
+     * e.g. frames below a certain priority. The filter must accept either all frames of a transfer or none.
+     * It is evaluated after the source node filter. The object must outlive the listener or be removed by setting
+     * null, which is the default.
+     */
+    void setFrameFilter(const ITransferAcceptanceFilter* filter);
+    const ITransferAcceptanceFilter* getFrameFilter() const { return frame_filter_; }
+
+    bool isFrameFilteringEnabled() const { return frame_filtering_enabled_; }
+
+    /**
+     * Listeners that return the same non-null key are interchangeable, so that one of them can receive transfers
+     * on behalf of the owners of the others; see @ref Subscriber::startShared(). Null by default.
+     */
+    virtual const void* getSharingKey() const { return UAVCAN_NULLPTR; }
+
+    /**
+     * Sets aside the given number of memory pool blocks for the reception buffers and for the receiver registry
+     * of this listener, so that a critical subscription keeps working when the shared pool is exhausted by other
+     * traffic. The blocks are allocated immediately; see @ref GuaranteedPoolAllocator for details.
+     * A multi-frame transfer needs roughly (transfer size / (@ref MemPoolBlockSize - sizeof(void*))) + 1 buffer
+     * blocks; one receiver block serves a few remote nodes.
+     * Returns negative error code; on failure, the previous reservation stays in effect.
+     */
+    int reservePoolBlocks(uint16_t num_buffer_blocks, uint16_t num_receiver_blocks);
+
+    uint16_t getNumReservedBufferBlocks() const   { return rx_buffer_allocator_.getMinBlocks(); }
+    uint16_t getNumReservedReceiverBlocks() const { return receiver_map_allocator_.getMinBlocks(); }
+
+    /**
+     * Removes the timed out receivers. The receivers are only visited if one of them may have timed out,
+     * so the call is cheap for a listener whose receivers are all active.
+     */
+    virtual void cleanup(MonotonicTime ts);
+
+    /**
+     * Removes the receivers of the transfers from the given node, along with their buffers, without waiting for
+     * them to time out. This is meant for the nodes that have gone offline; see @ref Dispatcher::removeRxStateOf().
+     * A receiver that is still needed will be recreated upon the next transfer from the node.
+     */
+    virtual void removeReceiversOf(NodeID node_id);
+
+    /**
+     * Creates the receiver for the transfers of the given type from the given node in advance, so that the first
+     * transfer from the node does not have to allocate it, which takes time and may fail when the memory pool is
+     * short. The receiver is kept while the node is silent; a receiver that has timed out only releases its buffer,
+     * and @ref removeReceiversOf() only resets it. Use @ref reservePoolBlocks() to secure the reception buffers.
+     * Returns negative error code.
+     */
+    int preregisterSource(NodeID node_id, TransferType transfer_type);
 
     virtual void handleFrame(const RxFrame& frame, bool tao_disabled);
+
+    /**
+     * Delivers a transfer that has been reassembled and CRC-checked elsewhere, e.g. by a reception pipeline running
+     * on another thread (see uavcan/helpers/rx_pipeline.hpp). The last frame carries the transfer header fields;
+     * its payload is not used.
+     */
+    virtual void handleCompletedTransfer(const RxFrame& last_frame, IncomingTransfer& transfer);
 };
 
 /**
- * This class is used by transfer listener to decide if the frame should be accepted or ignored.
+ * Transfer listener that keeps the receivers in a fixed array indexed by source node ID, which makes the
+ * receiver lookup O(1) at the cost of a constant amount of memory: one TransferReceiver per slot.
+ * Each node ID has one slot, which serves the first transfer type received from that node; receivers that do not
+ * fit into the array (other transfer types, or node ID above the bound) are kept in the map of the base class.
+ *
+ * @tparam MaxNodeID_   Highest node ID served by the array; defaults to the maximum node ID.
+ * @tparam Base_        Either @ref TransferListener or @ref TransferListenerWithFilter.
  */
-class ITransferAcceptanceFilter
+template <unsigned MaxNodeID_ = NodeID::Max, typename Base_ = TransferListener>
+class UAVCAN_EXPORT DirectIndexedTransferListener : public Base_
 {
+    enum { SlotInactive = 0xFF };
+
+    /*
+     * The receivers and the transfer types they serve are kept in separate arrays, so that the slots are not
+     * padded to the alignment of the receiver and the lookup does not touch the receivers of other nodes.
+     */
+    TransferReceiver receivers_[MaxNodeID_];
+    uint8_t slot_transfer_types_[MaxNodeID_];     ///< SlotInactive if the slot is free
+
+protected:
+    virtual TransferReceiver* findReceiver(const TransferBufferManagerKey& key, bool create) override
+    {
+        const unsigned node_id = key.getNodeID().get();
+        if ((node_id >= 1) && (node_id <= MaxNodeID_))
+        {
+            const unsigned index = node_id - 1;
+            if (slot_transfer_types_[index] != SlotInactive)
+            {
+                if (slot_transfer_types_[index] == uint8_t(key.getTransferType()))
+                {
+                    return &receivers_[index];
+                }
+            }
+            else
+            {
+                /*
+                 * The receiver may have been created in the map while the slot was occupied by another
+                 * transfer type, so the map must be checked before the slot is taken over.
+                 */
+                TransferReceiver* const recv = Base_::findReceiver(key, false);
+                if ((recv != UAVCAN_NULLPTR) || !create)
+                {
+                    return recv;
+                }
+                receivers_[index] = TransferReceiver();
+                slot_transfer_types_[index] = uint8_t(key.getTransferType());
+                return &receivers_[index];
+            }
+        }
+        return Base_::findReceiver(key, create);
+    }
+
+    virtual MonotonicTime removeTimedOutReceivers(MonotonicTime ts) override
+    {
+        MonotonicTime earliest_expiry = Base_::removeTimedOutReceivers(ts);
+        for (unsigned i = 0; i < MaxNodeID_; i++)
+        {
+            if (slot_transfer_types_[i] == SlotInactive)
+            {
+                continue;
+            }
+            if (receivers_[i].isTimedOut(ts))
+            {
+                // Receivers do not own their buffers, see TransferListener::TimedOutReceiverPredicate
+                const TransferBufferManagerKey key(NodeID(uint8_t(i + 1)), TransferType(slot_transfer_types_[i]));
+                UAVCAN_TRACE("DirectIndexedTransferListener", "Timed out receiver: %s", key.toString().c_str());
+                Base_::getBufferManager().remove(key);
+                if (!Base_::isPreregisteredSource(key.getNodeID()))
+                {
+                    slot_transfer_types_[i] = SlotInactive;
+                }
+            }
+            else
+            {
+                earliest_expiry = min(earliest_expiry, receivers_[i].getExpiryTime());
+            }
+        }
+        return earliest_expiry;
+    }
+
 public:
+    virtual void removeReceiversOf(NodeID node_id) override
+    {
+        const unsigned index = unsigned(node_id.get()) - 1U;
+        if ((index < MaxNodeID_) && (slot_transfer_types_[index] != SlotInactive))
+        {
+            Base_::getBufferManager().remove(TransferBufferManagerKey(node_id,
+                                                                      TransferType(slot_transfer_types_[index])));
+            if (Base_::isPreregisteredSource(node_id))
+            {
+                receivers_[index] = TransferReceiver();
+            }
+            else
+            {
+                slot_transfer_types_[index] = SlotInactive;
+            }
+        }
+        Base_::removeReceiversOf(node_id);
+    }
+
+    DirectIndexedTransferListener(TransferPerfCounter& perf, const DataTypeDescriptor& data_type,
+                                  uint16_t max_buffer_size, IPoolAllocator& allocator)
+        : Base_(perf, data_type, max_buffer_size, allocator)
+    {
+        StaticAssert<(MaxNodeID_ >= 1) && (MaxNodeID_ <= NodeID::Max)>::check();
+        fill_n(slot_transfer_types_, MaxNodeID_, uint8_t(SlotInactive));
+    }
+
     /**
-     * If it returns false, the frame will be ignored, otherwise accepted.
+     * Number of receivers currently served by the array rather than by the map.
      */
-    virtual bool shouldAcceptFrame(const RxFrame& frame) const = 0;
+    unsigned getNumDirectReceivers() const
+    {
+        unsigned num = 0;
+        for (unsigned i = 0; i < MaxNodeID_; i++)
+        {
+            num += (slot_transfer_types_[i] != SlotInactive) ? 1U : 0U;
+        }
+        return num;
+    }
+};
 
-    virtual ~ITransferAcceptanceFilter() { }
+/**
+ * Transfer listener that delivers the payload of multi-frame transfers in chunks as the frames arrive, instead of
+ * reassembling the whole transfer in the memory pool first. This is meant for large transfers that the application
+ * consumes sequentially, e.g. file contents that are written to the storage directly: the memory needed does not
+ * depend on the size of the transfer.
+ *
+ * The chunks of a transfer are delivered in order via @ref handleTransferChunk(). The transfer CRC can only be
+ * verified when the last frame arrives, so the application must not commit the received data until
+ * @ref handleTransferEnd() confirms the transfer. If the transfer fails instead - it is interrupted by a lost frame
+ * or by the next transfer, times out, fails the CRC check, or its source is removed - @ref handleTransferAbort() is
+ * called, and the chunks delivered so far must be discarded. Only one transfer per source node and transfer type
+ * is in progress at any moment.
+ *
+ * Single-frame transfers, anonymous transfers, and the transfers reassembled elsewhere (see
+ * @ref handleCompletedTransfer()) are delivered the same way, all at once. As with buffered reception, the payload
+ * of CAN FD transfers may end with padding bytes.
+ */
+class UAVCAN_EXPORT StreamingTransferListener : public TransferListener
+{
+    /**
+     * Stands for the reassembly buffer; forwards the payload to the listener.
+     */
+    class ChunkSink : public ITransferBuffer
+    {
+        StreamingTransferListener& owner_;
+        const RxFrame& frame_;
+
+    public:
+        ChunkSink(StreamingTransferListener& owner, const RxFrame& frame)
+            : owner_(owner)
+            , frame_(frame)
+        { }
+
+        virtual int read(unsigned, uint8_t*, unsigned) const override { return -ErrLogic; }
+        virtual int write(unsigned offset, const uint8_t* data, unsigned len) override;
+    };
+
+    NodeIDSet open_transfers_[NumTransferTypes];     ///< Sources of the transfers whose chunks have been delivered
+
+    void openTransfer(NodeID src_node_id, TransferType transfer_type);
+    void abortTransfer(NodeID src_node_id, TransferType transfer_type);
+
+    void deliverWholeTransfer(IncomingTransfer& transfer);
+
+protected:
+    virtual void handleReception(TransferReceiver& receiver, const RxFrame& frame, TransferBufferAccessor& tba,
+                                 bool tao_disabled) override;
+
+    virtual void handleIncomingTransfer(IncomingTransfer& transfer) override;
+
+    /**
+     * Next piece of the payload of the transfer from the given node. The offset of the first chunk of a transfer
+     * is zero, and the chunks follow each other without gaps.
+     */
+    virtual void handleTransferChunk(NodeID src_node_id, TransferType transfer_type, unsigned offset,
+                                     const uint8_t* data, unsigned len) = 0;
+
+    /**
+     * The transfer whose chunks have been delivered is complete and valid. The payload is not available via
+     * the transfer object, except for the transfers that were delivered at once.
+     */
+    virtual void handleTransferEnd(IncomingTransfer& transfer) = 0;
+
+    /**
+     * The transfer whose chunks have been delivered has failed; they must be discarded.
+     */
+    virtual void handleTransferAbort(NodeID src_node_id, TransferType transfer_type) = 0;
+
+public:
+    StreamingTransferListener(TransferPerfCounter& perf, const DataTypeDescriptor& data_type,
+                              IPoolAllocator& allocator)
+        : TransferListener(perf, data_type, 0, allocator)
+    { }
+
+    virtual void cleanup(MonotonicTime ts) override;
+
+    virtual void removeReceiversOf(NodeID node_id) override;
+
+    /**
+     * Whether the chunks of a transfer from the given node have been delivered, and the transfer is not over yet.
+     */
+    bool isTransferInProgress(NodeID src_node_id, TransferType transfer_type) const
+    {
+        return (unsigned(transfer_type) < NumTransferTypes) && open_transfers_[transfer_type].contains(src_node_id);
+    }
 };
 
 /**
@@ -183,6 +598,7 @@ class UAVCAN_EXPORT TransferListenerWithFilter : public TransferListener
     const ITransferAcceptanceFilter* filter_;
 
     virtual void handleFrame(const RxFrame& frame, bool tao_disabled) override;
+    virtual void handleCompletedTransfer(const RxFrame& last_frame, IncomingTransfer& transfer) override;
 
 public:
     TransferListenerWithFilter(TransferPerfCounter& perf, const DataTypeDescriptor& data_type,
@@ -7,8 +7,10 @@
 
 #include <cstdlib>
 #include <uavcan/build_config.hpp>
+#include <uavcan/transport/crc.hpp>
 #include <uavcan/transport/frame.hpp>
 #include <uavcan/transport/transfer_buffer.hpp>
+#include <uavcan/transport/transport_stats.hpp>
 
 namespace uavcan
 {
@@ -36,11 +38,21 @@ private:
     enum { ErrorCntMask = 31 };
     enum { IfaceIndexMask = MaxCanIfaces };
 
-    MonotonicTime prev_transfer_ts_;
+    enum { PrevTransferAgeUnknown = 0xFFFFFFFFU };
+
+    enum { MaxIntervalGrowthFactor = 2 };   ///< Longer intervals are limited before they are fed to the estimator
+
+    /*
+     * The timestamp of the previous transfer is only needed to measure the interval and to report it between
+     * the transfers, so it is stored as its age relative to the current transfer in microseconds rather than
+     * as an absolute value. This keeps the receiver small, which matters because there is one per remote node.
+     */
     MonotonicTime this_transfer_ts_;
     UtcTime first_frame_ts_;
+    uint32_t prev_transfer_age_usec_;   ///< Saturates at PrevTransferAgeUnknown, which also means no transfer yet
     uint16_t transfer_interval_msec_;
     uint16_t this_transfer_crc_;
+    TransferCRC payload_crc_;           ///< Accumulated as the payload is being written into the buffer
 
     uint16_t buffer_write_pos_;
 
@@ -51,43 +63,77 @@ private:
     uint8_t iface_index_        : 2;
     mutable uint8_t error_cnt_  : 5;
 
-    bool isInitialized() const { return iface_index_ != IfaceIndexNotSet; }
+    mutable uint8_t error_causes_;      ///< Bit N stands for TransferErrorCause N
 
-    bool isMidTransfer() const { return buffer_write_pos_ > 0; }
+    bool isInitialized() const { return iface_index_ != IfaceIndexNotSet; }
 
     MonotonicDuration getIfaceSwitchDelay() const;
     MonotonicDuration getTidTimeout() const;
 
-    void registerError() const;
+    void registerError(TransferErrorCause cause) const;
 
+    void setThisTransferTimestamp(MonotonicTime ts);
     void updateTransferTimings();
     void prepareForNextTransfer();
 
     bool validate(const RxFrame& frame) const;
-    bool writePayload(const RxFrame& frame, ITransferBuffer& buf);
-    ResultCode receive(const RxFrame& frame, TransferBufferAccessor& tba);
+    bool writePayload(const RxFrame& frame, ITransferBuffer& buf, const TransferCRC& crc_base);
+    ResultCode receive(const RxFrame& frame, TransferBufferAccessor& tba, const TransferCRC& crc_base);
 
 public:
     TransferReceiver() :
+        prev_transfer_age_usec_(PrevTransferAgeUnknown),
         transfer_interval_msec_(DefaultTransferIntervalMSec),
         this_transfer_crc_(0),
         buffer_write_pos_(0),
         next_toggle_(false),
         iface_index_(IfaceIndexNotSet),
-        error_cnt_(0)
+        error_cnt_(0),
+        error_causes_(0)
     { }
 
     bool isTimedOut(MonotonicTime current_ts) const;
 
-    ResultCode addFrame(const RxFrame& frame, TransferBufferAccessor& tba);
+    /**
+     * The receiver is timed out at any moment after this one, unless it accepts a new transfer in the meantime;
+     * the returned value never decreases.
+     */
+    MonotonicTime getExpiryTime() const { return this_transfer_ts_ + getTidTimeout(); }
+
+    /**
+     * @param crc_base  Initial state of the payload CRC, normally pre-initialized with the data type signature.
+     *                  The CRC of multi-frame transfers is computed as the payload is received, so that it can be
+     *                  checked upon completion without reading the buffer again, see @ref isLastTransferCrcValid().
+     */
+    ResultCode addFrame(const RxFrame& frame, TransferBufferAccessor& tba, const TransferCRC& crc_base = TransferCRC());
 
     uint8_t yieldErrorCount();
 
-    MonotonicTime getLastTransferTimestampMonotonic() const { return prev_transfer_ts_; }
+    /**
+     * Causes of the errors registered since the last call, as a mask where bit N stands for the cause N,
+     * see @ref TransferErrorCause. Same as the error count, the mask is reset by this call.
+     */
+    uint8_t yieldErrorCauses();
+
+    bool isMidTransfer() const { return buffer_write_pos_ > 0; }
+
+    /**
+     * Timestamp of the first frame of the last completed transfer. While the next transfer is being received,
+     * the timestamp is only available if it is not older than about an hour; otherwise zero is returned.
+     */
+    MonotonicTime getLastTransferTimestampMonotonic() const;
     UtcTime getLastTransferTimestampUtc() const { return first_frame_ts_; }
 
     uint16_t getLastTransferCrc() const { return this_transfer_crc_; }
 
+    /**
+     * CRC of the payload of the last multi-frame transfer, including the CAN FD padding bytes, which are covered by
+     * the transfer CRC as well. Valid after @ref ResultComplete until the next frame is added.
+     */
+    uint16_t getLastTransferComputedCrc() const { return payload_crc_.get(); }
+
+    bool isLastTransferCrcValid() const { return payload_crc_.get() == this_transfer_crc_; }
+
     MonotonicDuration getInterval() const { return MonotonicDuration::fromMSec(transfer_interval_msec_); }
 };
 
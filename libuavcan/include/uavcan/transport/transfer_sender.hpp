@@ -31,8 +31,57 @@ class UAVCAN_EXPORT TransferSender
     uint8_t iface_mask_;
     bool allow_anonymous_transfers_;
     bool canfd_frames_;
+    bool use_guaranteed_tx_memory_;
+    bool coalescing_;
+
+    /**
+     * CAN ID of the last single-frame transfer and the parameters it was compiled from. As long as they stay
+     * the same, which is the case for periodic publications, further single-frame transfers are compiled
+     * directly into a CAN frame, patching only the payload and the tail byte.
+     */
+    struct SingleFrameCache
+    {
+        uint32_t can_id;                ///< Zero if invalid; valid IDs have the EFF flag set
+        uint8_t src_node_id;
+        uint8_t dst_node_id;
+        uint8_t transfer_type;
+        uint8_t payload_capacity;
+        bool canfd;
+
+        SingleFrameCache()
+            : can_id(0)
+            , src_node_id(0)
+            , dst_node_id(0)
+            , transfer_type(0)
+            , payload_capacity(0)
+            , canfd(false)
+        { }
+
+        bool matches(NodeID src, NodeID dst, TransferType tt, bool fd) const
+        {
+            return (can_id != 0) && (src_node_id == src.get()) && (dst_node_id == dst.get()) &&
+                   (transfer_type == uint8_t(tt)) && (canfd == fd);
+        }
+    };
+    mutable SingleFrameCache single_frame_cache_;
+
+    mutable OutgoingTransferRegistry::EntryCache otr_cache_;    ///< Transfer ID state of the last destination
+
     void registerError() const;
 
+    uint8_t reserveGuaranteedTxMemory(unsigned num_frames) const;
+
+    void updateSingleFrameCache(const Frame& frame) const;
+
+    void dropSupersededFrames(uint32_t can_id) const;
+    void dropSupersededFrames(const Frame& frame) const;
+
+    int sendCachedSingleFrame(CanFrame& can_frame, uint16_t payload_len, MonotonicTime tx_deadline,
+                              MonotonicTime blocking_deadline, TransferID tid, bool canfd) const;
+
+    int allocateTransferID(TransferType transfer_type, NodeID dst_node_id, MonotonicTime tx_deadline,
+                           TransferID& out_tid) const;
+
 public:
     enum { AllIfacesMask = 0xFF };
 
@@ -50,6 +99,8 @@ public:
         , flags_(CanIOFlags(0))
         , iface_mask_(AllIfacesMask)
         , allow_anonymous_transfers_(false)
+        , use_guaranteed_tx_memory_(false)
+        , coalescing_(false)
     {
         init(data_type, qos);
     }
@@ -62,6 +113,8 @@ public:
         , flags_(CanIOFlags(0))
         , iface_mask_(AllIfacesMask)
         , allow_anonymous_transfers_(false)
+        , use_guaranteed_tx_memory_(false)
+        , coalescing_(false)
     { }
 
     void init(const DataTypeDescriptor& dtid, CanTxQueue::Qos qos);
@@ -79,7 +132,11 @@ public:
     }
 
     TransferPriority getPriority() const { return priority_; }
-    void setPriority(TransferPriority prio) { priority_ = prio; }
+    void setPriority(TransferPriority prio)
+    {
+        priority_ = prio;
+        single_frame_cache_ = SingleFrameCache();
+    }
 
     /**
      * Anonymous transfers (i.e. transfers that don't carry a valid Source Node ID) can be sent if
@@ -90,6 +147,23 @@ public:
      */
     void allowAnonymousTransfers() { allow_anonymous_transfers_ = true; }
 
+    /**
+     * Allows the frames of this sender to use the memory guaranteed to the TX queues, which is set aside
+     * with @ref CanIOManager::addTxQueueMinBlocks(). The publishers enable this for themselves once they have
+     * set aside some memory, see @ref GenericPublisherBase::reserveTxQueueMemory().
+     */
+    bool isUsingGuaranteedTxMemory() const { return use_guaranteed_tx_memory_; }
+    void setUseGuaranteedTxMemory(bool enable) { use_guaranteed_tx_memory_ = enable; }
+
+    /**
+     * Latest value wins: every new transfer drops the frames of the previous transfers of the same transfer type
+     * and destination that are still waiting in the TX queues, instead of being queued behind them. The frames are
+     * matched by CAN ID regardless of the priority. The rest of a partially transmitted multi-frame transfer is
+     * dropped as well, so the receivers will discard that transfer. Anonymous transfers are not affected.
+     */
+    bool isCoalescing() const { return coalescing_; }
+    void setCoalescing(bool enable) { coalescing_ = enable; }
+
     /**
      * Send with explicit Transfer ID.
      * Should be used only for service responses, where response TID should match request TID.
@@ -104,10 +178,25 @@ public:
      * Note that as long as the local node operates in passive mode, the
      * flag @ref CanIOFlagAbortOnError will be set implicitly for all outgoing frames.
      *
-     * TID is managed by OutgoingTransferRegistry.
+     * TID is managed by OutgoingTransferRegistry; the entry of the last destination is cached, so that
+     * the TID of a broadcasting publisher is found without a lookup.
      */
     int send(const uint8_t* payload, uint16_t payload_len, MonotonicTime tx_deadline,
              MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id, bool force_std_can = false) const;
+
+    /**
+     * Same as send(), but the payload is located in the data field of the given CAN frame, where it can be
+     * encoded in place. If the transfer fits one frame whose CAN ID is cached, the frame is completed and sent
+     * as is, without copying the payload; otherwise this falls back to the regular send().
+     * The contents of the frame are undefined afterwards.
+     */
+    int sendInPlace(CanFrame& can_frame, uint16_t payload_len, MonotonicTime tx_deadline,
+                    MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id,
+                    TransferID tid, bool force_std_can = false) const;
+
+    int sendInPlace(CanFrame& can_frame, uint16_t payload_len, MonotonicTime tx_deadline,
+                    MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id,
+                    bool force_std_can = false) const;
 };
 
 }
@@ -0,0 +1,345 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_TRANSPORT_STATS_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_TRANSPORT_STATS_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/time.hpp>
+#include <uavcan/data_type.hpp>
+#include <uavcan/transport/transfer.hpp>
+#include <uavcan/util/templates.hpp>
+
+namespace uavcan
+{
+/**
+ * Causes of the transfer reassembly errors, see @ref TransportStats::getRxErrorCount().
+ */
+enum TransferErrorCause
+{
+    TransferErrorToggle,        ///< Unexpected toggle bit, i.e. a frame was lost or duplicated
+    TransferErrorTransferID,    ///< Unexpected transfer ID or start of transfer, i.e. the end of a transfer was lost
+    TransferErrorCrc,           ///< Transfer CRC mismatch
+    TransferErrorTimeout,       ///< The transfer was not completed in time
+    TransferErrorMemory,        ///< No memory for the reassembly buffer, or the transfer is too long
+    TransferErrorFormat,        ///< Malformed first frame of a transfer
+    NumTransferErrorCauses
+};
+
+#if UAVCAN_TRANSPORT_STATS
+
+/**
+ * Histogram of durations with logarithmic buckets. The bucket N holds the durations below
+ * FirstBucketUpperBoundUSec * 2^N microseconds that don't fit the previous buckets; the last bucket also holds
+ * all longer durations. Negative durations, e.g. due to a clock adjustment, go to the first bucket.
+ */
+class UAVCAN_EXPORT LatencyHistogram
+{
+public:
+    enum { NumBuckets = 16 };
+    enum { FirstBucketUpperBoundUSec = 16 };
+
+private:
+    uint32_t buckets_[NumBuckets];
+    uint64_t total_usec_;
+    uint32_t count_;
+    uint32_t max_usec_;
+
+public:
+    LatencyHistogram() { reset(); }
+
+    void add(MonotonicDuration duration);
+
+    void reset();
+
+    /**
+     * Upper bound of the given bucket, exclusive; the last bucket is not bounded though.
+     */
+    static MonotonicDuration getBucketUpperBound(unsigned index)
+    {
+        UAVCAN_ASSERT(index < NumBuckets);
+        return MonotonicDuration::fromUSec(int64_t(FirstBucketUpperBoundUSec) << index);
+    }
+
+    uint32_t getBucketCount(unsigned index) const
+    {
+        UAVCAN_ASSERT(index < NumBuckets);
+        return (index < NumBuckets) ? buckets_[index] : 0;
+    }
+
+    uint32_t getCount() const { return count_; }
+
+    MonotonicDuration getMax() const { return MonotonicDuration::fromUSec(max_usec_); }
+
+    MonotonicDuration getMean() const
+    {
+        return MonotonicDuration::fromUSec((count_ > 0) ? int64_t(total_usec_ / count_) : 0);
+    }
+};
+
+/**
+ * Extended statistics of the transport layer, maintained by @ref TransferPerfCounter:
+ *  - transfer counters per data type;
+ *  - reassembly errors by cause;
+ *  - losses per transfer stream, i.e. per source node and data type, see @ref SourceEntry;
+ *  - latency of the reception, from the frame reception timestamp reported by the driver to the dispatching of the
+ *    frame to the transfer listeners, which is where the subscriber callbacks are invoked from.
+ *
+ * The waiting time of the frames in the TX queues is collected by @ref CanIOManager.
+ *
+ * The data type counters are stored in a hash table of @ref UAVCAN_TRANSPORT_STATS_CAPACITY entries; transfers of
+ * the data types that don't fit into the table are accounted for in a common counter. The counters wrap around.
+ * This feature can be disabled at compile time, see @ref UAVCAN_TRANSPORT_STATS; all counters read zero then.
+ */
+class UAVCAN_EXPORT TransportStats : Noncopyable
+{
+public:
+    enum { Capacity = UAVCAN_TRANSPORT_STATS_CAPACITY };
+
+    struct Entry
+    {
+        uint32_t key;           ///< Data type, see makeKey(); zero if the entry is not used
+        uint32_t transfers_tx;
+        uint32_t transfers_rx;
+
+        DataTypeKind getDataTypeKind() const { return DataTypeKind((key >> 16) & 1U); }
+        DataTypeID getDataTypeID() const { return DataTypeID(uint16_t(key & 0xFFFFU)); }
+    };
+
+    enum { SourceCapacity = UAVCAN_TRANSPORT_STATS_SOURCE_CAPACITY };
+
+    /**
+     * Reception statistics of one stream of transfers. The losses are detected as gaps in the sequence of the
+     * transfer IDs of the received transfers; since the transfer ID is counted modulo 32, a gap of half of that or
+     * more, or a silence long enough to wrap the transfer ID around, is not recognized as a loss.
+     */
+    struct SourceEntry
+    {
+        uint32_t key;               ///< See makeSourceKey(); zero if the entry is not used
+        uint32_t transfers_rx;      ///< Including those that failed the CRC check
+        uint32_t transfers_lost;    ///< Total length of the gaps
+        uint16_t gaps;
+        uint16_t duplicates;        ///< Transfers received again, e.g. via a redundant interface
+        uint16_t timeouts;          ///< Transfers that were not completed in time
+        uint16_t errors;            ///< Other reassembly errors, see @ref TransferErrorCause
+        uint8_t last_transfer_id;   ///< Of the last received transfer, valid if has_transfer_id is set
+        bool has_transfer_id;
+
+        TransferType getTransferType() const { return TransferType((key >> 24) & 3U); }
+        NodeID getSrcNodeID() const { return NodeID(uint8_t((key >> 16) & NodeID::Max)); }
+        DataTypeID getDataTypeID() const { return DataTypeID(uint16_t(key & 0xFFFFU)); }
+
+        uint32_t getNumExpectedTransfers() const { return transfers_rx + transfers_lost; }
+    };
+
+private:
+    Entry entries_[Capacity];
+    SourceEntry sources_[SourceCapacity];
+    LatencyHistogram rx_latency_;
+    uint32_t rx_errors_[NumTransferErrorCauses];
+    uint32_t num_untracked_transfers_;
+    uint32_t num_untracked_source_events_;
+    uint16_t num_entries_;
+    uint16_t num_source_entries_;
+
+    static unsigned computeHash(uint32_t key);
+
+    Entry* findOrCreateEntry(uint32_t key);
+
+    /**
+     * Index of the entry of the given key, or of the free entry where it belongs; SourceCapacity if the table is full.
+     */
+    unsigned findSourceSlot(uint32_t key) const;
+
+    SourceEntry* findOrCreateSourceEntry(uint32_t key);
+
+public:
+    TransportStats() { reset(); }
+
+    /**
+     * Maps a data type to its key in the table. Service requests and responses share the key.
+     */
+    static uint32_t makeKey(DataTypeKind kind, DataTypeID dtid)
+    {
+        return (1UL << 31) | (uint32_t(kind) << 16) | dtid.get();
+    }
+    static uint32_t makeKey(TransferType transfer_type, DataTypeID dtid)
+    {
+        return makeKey((transfer_type == TransferTypeMessageBroadcast) ? DataTypeKindMessage : DataTypeKindService,
+                       dtid);
+    }
+
+    /**
+     * Maps a transfer stream to its key in the table of the streams.
+     */
+    static uint32_t makeSourceKey(TransferType transfer_type, NodeID src_node_id, DataTypeID dtid)
+    {
+        return (1UL << 31) | ((uint32_t(transfer_type) & 3U) << 24) | (uint32_t(src_node_id.get()) << 16) |
+               dtid.get();
+    }
+
+    void addTxTransfer(TransferType transfer_type, DataTypeID dtid);
+    void addRxTransfer(TransferType transfer_type, DataTypeID dtid);
+
+    /**
+     * Transfer received from the given node, complete; the transfer ID is compared against the previous one.
+     */
+    void addRxSourceTransfer(TransferType transfer_type, NodeID src_node_id, DataTypeID dtid, TransferID tid);
+
+    /**
+     * Start-of-transfer frame that did not complete a transfer. If its transfer ID is the one of the last received
+     * transfer, it is a duplicate of that transfer.
+     */
+    void addRxSourceStartOfTransfer(TransferType transfer_type, NodeID src_node_id, DataTypeID dtid,
+                                    TransferID tid);
+
+    /**
+     * @param cause_mask    Bit N stands for the cause N, see @ref TransferErrorCause.
+     */
+    void addRxSourceErrors(TransferType transfer_type, NodeID src_node_id, DataTypeID dtid, uint8_t cause_mask);
+
+    /**
+     * @param cause_mask    Bit N stands for the cause N, see @ref TransferErrorCause.
+     */
+    void addRxErrors(uint8_t cause_mask);
+
+    void addRxLatency(MonotonicDuration latency) { rx_latency_.add(latency); }
+
+    void reset();
+
+    /**
+     * Entries are stored in a hash table; unused entries have zero key.
+     */
+    const Entry& getEntry(unsigned index) const
+    {
+        UAVCAN_ASSERT(index < Capacity);
+        return entries_[index];
+    }
+
+    unsigned getNumEntries() const { return num_entries_; }
+
+    /**
+     * Returns the entry of the given data type, or null if no transfers of this data type have been counted.
+     */
+    const Entry* findEntry(DataTypeKind kind, DataTypeID dtid) const;
+
+    /**
+     * Number of transfers that could not be attributed to their data types because the table was full.
+     */
+    uint32_t getNumUntrackedTransfers() const { return num_untracked_transfers_; }
+
+    /**
+     * Streams are stored in a hash table too; unused entries have zero key.
+     */
+    const SourceEntry& getSourceEntry(unsigned index) const
+    {
+        UAVCAN_ASSERT(index < SourceCapacity);
+        return sources_[index];
+    }
+
+    unsigned getNumSourceEntries() const { return num_source_entries_; }
+
+    /**
+     * Returns the entry of the given stream, or null if nothing has been received from it.
+     */
+    const SourceEntry* findSourceEntry(TransferType transfer_type, NodeID src_node_id, DataTypeID dtid) const;
+
+    /**
+     * Number of transfers and errors that could not be attributed to their streams because the table was full.
+     */
+    uint32_t getNumUntrackedSourceEvents() const { return num_untracked_source_events_; }
+
+    /**
+     * Number of reassembly errors of the given cause. Note that the total error count of @ref TransferPerfCounter
+     * also includes errors that have no cause here, such as failures to send.
+     */
+    uint32_t getRxErrorCount(TransferErrorCause cause) const
+    {
+        return (unsigned(cause) < NumTransferErrorCauses) ? rx_errors_[cause] : 0;
+    }
+
+    const LatencyHistogram& getRxLatencyHistogram() const { return rx_latency_; }
+};
+
+#else
+
+class UAVCAN_EXPORT LatencyHistogram
+{
+public:
+    enum { NumBuckets = 16 };
+    enum { FirstBucketUpperBoundUSec = 16 };
+
+    void add(MonotonicDuration) { }
+    void reset() { }
+    static MonotonicDuration getBucketUpperBound(unsigned index)
+    {
+        return MonotonicDuration::fromUSec(int64_t(FirstBucketUpperBoundUSec) << index);
+    }
+    uint32_t getBucketCount(unsigned) const { return 0; }
+    uint32_t getCount() const { return 0; }
+    MonotonicDuration getMax() const { return MonotonicDuration(); }
+    MonotonicDuration getMean() const { return MonotonicDuration(); }
+};
+
+class UAVCAN_EXPORT TransportStats : Noncopyable
+{
+    LatencyHistogram rx_latency_;
+
+public:
+    enum { Capacity = 0 };
+
+    struct Entry
+    {
+        uint32_t key;
+        uint32_t transfers_tx;
+        uint32_t transfers_rx;
+
+        DataTypeKind getDataTypeKind() const { return DataTypeKind((key >> 16) & 1U); }
+        DataTypeID getDataTypeID() const { return DataTypeID(uint16_t(key & 0xFFFFU)); }
+    };
+
+    enum { SourceCapacity = 0 };
+
+    struct SourceEntry
+    {
+        uint32_t key;
+        uint32_t transfers_rx;
+        uint32_t transfers_lost;
+        uint16_t gaps;
+        uint16_t duplicates;
+        uint16_t timeouts;
+        uint16_t errors;
+        uint8_t last_transfer_id;
+        bool has_transfer_id;
+
+        TransferType getTransferType() const { return TransferType((key >> 24) & 3U); }
+        NodeID getSrcNodeID() const { return NodeID(uint8_t((key >> 16) & NodeID::Max)); }
+        DataTypeID getDataTypeID() const { return DataTypeID(uint16_t(key & 0xFFFFU)); }
+        uint32_t getNumExpectedTransfers() const { return transfers_rx + transfers_lost; }
+    };
+
+    void addTxTransfer(TransferType, DataTypeID) { }
+    void addRxTransfer(TransferType, DataTypeID) { }
+    void addRxSourceTransfer(TransferType, NodeID, DataTypeID, TransferID) { }
+    void addRxSourceStartOfTransfer(TransferType, NodeID, DataTypeID, TransferID) { }
+    void addRxSourceErrors(TransferType, NodeID, DataTypeID, uint8_t) { }
+    void addRxErrors(uint8_t) { }
+    void addRxLatency(MonotonicDuration) { }
+    void reset() { }
+    unsigned getNumEntries() const { return 0; }
+    const Entry* findEntry(DataTypeKind, DataTypeID) const { return UAVCAN_NULLPTR; }
+    uint32_t getNumUntrackedTransfers() const { return 0; }
+    unsigned getNumSourceEntries() const { return 0; }
+    const SourceEntry* findSourceEntry(TransferType, NodeID, DataTypeID) const { return UAVCAN_NULLPTR; }
+    uint32_t getNumUntrackedSourceEvents() const { return 0; }
+    uint32_t getRxErrorCount(TransferErrorCause) const { return 0; }
+    const LatencyHistogram& getRxLatencyHistogram() const { return rx_latency_; }
+};
+
+#endif
+
+}
+
+#endif // UAVCAN_TRANSPORT_TRANSPORT_STATS_HPP_INCLUDED
@@ -14,9 +14,15 @@
 #include <uavcan/node/node.hpp>
 #include <uavcan/node/timer.hpp>
 #include <uavcan/node/publisher.hpp>
+#include <uavcan/node/time_triggered_publisher.hpp>
 #include <uavcan/node/subscriber.hpp>
+#include <uavcan/node/lazy_subscriber.hpp>
+#include <uavcan/node/queued_subscriber.hpp>
+#include <uavcan/node/batch_subscriber.hpp>
 #include <uavcan/node/service_server.hpp>
 #include <uavcan/node/service_client.hpp>
+#include <uavcan/node/async_service_client.hpp>
+#include <uavcan/node/service_fan_out.hpp>
 #include <uavcan/node/global_data_type_registry.hpp>
 
 // Util
@@ -9,9 +9,48 @@
 #include <cstddef>
 #include <cstring>
 #include <uavcan/build_config.hpp>
+#include <uavcan/std.hpp>
 
 namespace uavcan
 {
+/**
+ * Number of set bits in a word (population count).
+ */
+inline unsigned countSetBits(uint32_t x)
+{
+#if __GNUC__
+    return unsigned(__builtin_popcount(x));
+#else
+    x = x - ((x >> 1) & 0x55555555U);
+    x = (x & 0x33333333U) + ((x >> 2) & 0x33333333U);
+    return unsigned((((x + (x >> 4)) & 0x0F0F0F0FU) * 0x01010101U) >> 24);
+#endif
+}
+
+/**
+ * Index of the least significant set bit of a word. The argument must not be zero.
+ */
+inline unsigned findFirstSetBit(uint32_t x)
+{
+    UAVCAN_ASSERT(x != 0);
+#if __GNUC__
+    return unsigned(__builtin_ctz(x));
+#else
+    unsigned index = 0;
+    while ((x & 0xFFU) == 0)
+    {
+        x >>= 8;
+        index += 8;
+    }
+    while ((x & 1U) == 0)
+    {
+        x >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
 /**
  * STL-like bitset
  */
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_UTIL_BUMP_ARENA_HPP_INCLUDED
+#define UAVCAN_UTIL_BUMP_ARENA_HPP_INCLUDED
+
+#include <cassert>
+#include <cstddef>
+#include <uavcan/build_config.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/util/templates.hpp>
+
+namespace uavcan
+{
+/**
+ * Bump allocator over a fixed buffer, intended for short-lived temporary objects, e.g. the decoded data
+ * structures that are passed to the subscription callbacks (see @ref INode::setDecodeArena()).
+ *
+ * Allocation just advances the fill marker; there is no per-object deallocation. Instead, the user takes the
+ * marker before allocating and rolls back to it once the objects are destroyed, which also works for nested
+ * allocations (e.g. if a callback decodes another structure). All allocations are aligned at the maximum
+ * fundamental alignment.
+ */
+class UAVCAN_EXPORT BumpArena : Noncopyable
+{
+    union MaxAlign
+    {
+        long double _aligner1;
+        long long _aligner2;
+        void* _aligner3;
+    };
+
+    uint8_t* const buffer_;
+    const std::size_t capacity_;
+    std::size_t used_;
+    std::size_t peak_used_;
+    uint32_t num_failed_allocations_;
+
+public:
+    typedef std::size_t Marker;
+
+    enum { Alignment = sizeof(MaxAlign) };
+
+    /**
+     * @param buffer    Storage of the arena. Its beginning should be aligned at @ref Alignment.
+     * @param size      Size of the storage in bytes.
+     */
+    BumpArena(void* buffer, std::size_t size)
+        : buffer_(static_cast<uint8_t*>(buffer))
+        , capacity_(size)
+        , used_(0)
+        , peak_used_(0)
+        , num_failed_allocations_(0)
+    {
+        UAVCAN_ASSERT(buffer_ != UAVCAN_NULLPTR || capacity_ == 0);
+    }
+
+    /**
+     * Returns a chunk of the requested size, or null pointer if the arena has not enough space left.
+     */
+    void* allocate(std::size_t size)
+    {
+        const std::size_t aligned_size = (size + Alignment - 1U) / Alignment * Alignment;
+        if (aligned_size > (capacity_ - used_))
+        {
+            num_failed_allocations_++;
+            return UAVCAN_NULLPTR;
+        }
+        void* const ptr = buffer_ + used_;
+        used_ += aligned_size;
+        if (used_ > peak_used_)
+        {
+            peak_used_ = used_;
+        }
+        return ptr;
+    }
+
+    /**
+     * Rolling back to a marker returns all memory that was allocated since the marker was taken.
+     * The objects placed in that memory must be destroyed beforehand.
+     */
+    Marker getMarker() const { return used_; }
+    void rollback(Marker marker)
+    {
+        UAVCAN_ASSERT(marker <= used_);
+        if (marker <= used_)
+        {
+            used_ = marker;
+        }
+    }
+
+    void reset() { used_ = 0; }
+
+    std::size_t getCapacity() const { return capacity_; }
+    std::size_t getUsedSize() const { return used_; }
+
+    /**
+     * Usage statistics. The peak value shows how large the arena should be for the given application;
+     * failed allocations fall back to the stack.
+     */
+    std::size_t getPeakUsedSize() const { return peak_used_; }
+    uint32_t getNumFailedAllocations() const { return num_failed_allocations_; }
+};
+
+/**
+ * Bump arena with statically allocated storage.
+ */
+template <std::size_t Size>
+class UAVCAN_EXPORT StaticBumpArena : public BumpArena
+{
+    union
+    {
+        uint8_t bytes[(Size > 0) ? Size : 1];       // Zero-size arrays are not allowed
+        long double _aligner1;
+        long long _aligner2;
+        void* _aligner3;
+    } storage_;
+
+public:
+    StaticBumpArena() : BumpArena(storage_.bytes, Size) { }
+};
+
+}
+
+#endif // UAVCAN_UTIL_BUMP_ARENA_HPP_INCLUDED
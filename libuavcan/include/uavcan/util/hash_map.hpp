@@ -0,0 +1,516 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_UTIL_HASH_MAP_HPP_INCLUDED
+#define UAVCAN_UTIL_HASH_MAP_HPP_INCLUDED
+
+#include <cassert>
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/dynamic_memory.hpp>
+#include <uavcan/util/map.hpp>
+#include <uavcan/util/templates.hpp>
+#include <uavcan/util/placement_new.hpp>
+
+namespace uavcan
+{
+/**
+ * KV container with the same interface as @ref Map, which it is based on.
+ *
+ * If the number of entries reaches @ref UAVCAN_HASH_MAP_INDEX_THRESHOLD, the map maintains an open-addressing hash
+ * index over its entries, so that access(), insert() and remove() take constant time on average instead of O(N).
+ * The slots of the index are stored in pool blocks (pages), which are addressed via a two-level directory of pool
+ * blocks, like in @ref TransferBufferIndex. Collisions are resolved by linear probing; removal uses backward shift.
+ * If the index can't be allocated, the map falls back to the linear search.
+ * Use it instead of Map for large maps that are accessed often.
+ *
+ * Type requirements are the same as for Map; additionally, the key must implement the following method:
+ *  uint32_t hash() const
+ */
+template <typename Key, typename Value>
+class UAVCAN_EXPORT HashMap : Noncopyable
+{
+    typedef Map<Key, Value> Storage;
+
+public:
+    typedef typename Storage::KVPair KVPair;
+
+private:
+    Storage map_;
+    unsigned size_;
+
+#if UAVCAN_HASH_MAP_INDEX_THRESHOLD > 0
+    typedef KVPair* Slot;
+
+    enum { PointersPerBlock = MemPoolBlockSize / sizeof(void*) };
+    enum { MaxPages = PointersPerBlock * PointersPerBlock };
+
+    struct Page
+    {
+        Slot slots[PointersPerBlock];
+    };
+    struct Directory
+    {
+        Page* pages[PointersPerBlock];
+    };
+    struct Root
+    {
+        Directory* dirs[PointersPerBlock];
+    };
+
+    Root* root_;
+    uint16_t num_pages_;
+
+    Slot& slotAt(unsigned index) const
+    {
+        const unsigned page = index / unsigned(PointersPerBlock);
+        return root_->dirs[page / unsigned(PointersPerBlock)]->pages[page % unsigned(PointersPerBlock)]->
+            slots[index % unsigned(PointersPerBlock)];
+    }
+
+    template <typename T> T* allocateBlock();
+    template <typename T> void deallocateBlock(T* ptr);
+
+    unsigned getCapacity() const { return unsigned(num_pages_) * unsigned(PointersPerBlock); }
+    bool canInsert(unsigned num_entries) const { return (num_entries + 1U) * 4U <= getCapacity() * 3U; }
+
+    unsigned getHomeSlot(const Key& key) const;
+
+    bool rebuildIndex();
+    void releaseIndex();
+    KVPair* findInIndex(const Key& key) const;
+    void insertIntoIndex(KVPair* kv);
+    void removeFromIndex(const Key& key);
+#endif
+
+    void addToIndex(KVPair* kv);
+    void unindex(const Key& key);
+
+    KVPair* findKey(const Key& key);
+
+    template <typename Predicate>
+    class RemovalPredicate
+    {
+        HashMap& owner_;
+        Predicate& predicate_;
+
+    public:
+        RemovalPredicate(HashMap& owner, Predicate& predicate)
+            : owner_(owner)
+            , predicate_(predicate)
+        { }
+
+        bool operator()(const Key& key, const Value& value)
+        {
+            if (predicate_(key, value))
+            {
+                owner_.unindex(key);
+                return true;
+            }
+            return false;
+        }
+    };
+
+public:
+    HashMap(IPoolAllocator& allocator)
+        : map_(allocator)
+        , size_(0)
+#if UAVCAN_HASH_MAP_INDEX_THRESHOLD > 0
+        , root_(UAVCAN_NULLPTR)
+        , num_pages_(0)
+#endif
+    {
+#if UAVCAN_HASH_MAP_INDEX_THRESHOLD > 0
+        StaticAssert<(PointersPerBlock > 1)>::check();
+        IsDynamicallyAllocatable<Page>::check();
+        IsDynamicallyAllocatable<Directory>::check();
+        IsDynamicallyAllocatable<Root>::check();
+#endif
+    }
+
+    ~HashMap()
+    {
+        clear();
+    }
+
+    /**
+     * Returns null pointer if there's no such entry.
+     */
+    Value* access(const Key& key)
+    {
+        UAVCAN_ASSERT(!(key == Key()));
+        KVPair* const kv = findKey(key);
+        return kv ? &kv->value : UAVCAN_NULLPTR;
+    }
+
+    const Value* access(const Key& key) const
+    {
+        return const_cast<HashMap*>(this)->access(key);
+    }
+
+    /**
+     * If entry with the same key already exists, it will be replaced
+     */
+    Value* insert(const Key& key, const Value& value);
+
+    /**
+     * Does nothing if there's no such entry.
+     */
+    void remove(const Key& key);
+
+    /**
+     * Removes entries where the predicate returns true.
+     * Predicate prototype:
+     *  bool (const Key& key, const Value& value)
+     */
+    template <typename Predicate>
+    void removeAllWhere(Predicate predicate)
+    {
+        map_.removeAllWhere(RemovalPredicate<Predicate>(*this, predicate));
+    }
+
+    /**
+     * Returns first entry where the predicate returns true.
+     * Predicate prototype:
+     *  bool (const Key& key, const Value& value)
+     */
+    template <typename Predicate>
+    const Key* find(Predicate predicate) const { return map_.find(predicate); }
+
+    /**
+     * Removes all items.
+     */
+    void clear();
+
+    /**
+     * Refer to @ref Map::getByIndex().
+     */
+    KVPair* getByIndex(unsigned index) { return map_.getByIndex(index); }
+    const KVPair* getByIndex(unsigned index) const { return map_.getByIndex(index); }
+
+    /**
+     * Complexity is O(1).
+     */
+    bool isEmpty() const { return size_ == 0; }
+
+    /**
+     * Complexity is O(1).
+     */
+    unsigned getSize() const { return size_; }
+
+    /**
+     * Whether the lookups are currently served by the hash index.
+     */
+#if UAVCAN_HASH_MAP_INDEX_THRESHOLD > 0
+    bool isIndexed() const { return root_ != UAVCAN_NULLPTR; }
+#else
+    bool isIndexed() const { return false; }
+#endif
+};
+
+// ----------------------------------------------------------------------------
+
+/*
+ * HashMap<>
+ */
+#if UAVCAN_HASH_MAP_INDEX_THRESHOLD > 0
+
+template <typename Key, typename Value>
+template <typename T>
+T* HashMap<Key, Value>::allocateBlock()
+{
+    void* const praw = map_.allocator_.allocate(sizeof(T));
+    if (praw == UAVCAN_NULLPTR)
+    {
+        return UAVCAN_NULLPTR;
+    }
+    return new (praw) T();      // Value-initialization zeroes the pointers
+}
+
+template <typename Key, typename Value>
+template <typename T>
+void HashMap<Key, Value>::deallocateBlock(T* ptr)
+{
+    if (ptr != UAVCAN_NULLPTR)
+    {
+        ptr->~T();
+        map_.allocator_.deallocate(ptr);
+    }
+}
+
+template <typename Key, typename Value>
+unsigned HashMap<Key, Value>::getHomeSlot(const Key& key) const
+{
+    UAVCAN_ASSERT(getCapacity() > 0);
+    uint32_t h = key.hash() * 2654435761U;      // Knuth's multiplicative hash
+    h ^= h >> 16;                               // The capacity may be a power of two, so the upper bits are mixed in
+    return unsigned(h % getCapacity());
+}
+
+template <typename Key, typename Value>
+bool HashMap<Key, Value>::rebuildIndex()
+{
+    releaseIndex();
+
+    // Load factor of 1/2 right after rebuild leaves some room for growth
+    unsigned num_pages = (size_ * 2U + unsigned(PointersPerBlock) - 1U) / unsigned(PointersPerBlock);
+    num_pages = max(num_pages, 1U);
+    num_pages = min(num_pages, unsigned(MaxPages));
+    if (size_ * 4U > num_pages * unsigned(PointersPerBlock) * 3U)
+    {
+        UAVCAN_TRACE("HashMap", "Too many entries: %u", size_);
+        return false;
+    }
+
+    root_ = allocateBlock<Root>();
+    if (root_ == UAVCAN_NULLPTR)
+    {
+        return false;
+    }
+    for (unsigned i = 0; i < num_pages; i++)
+    {
+        Directory*& dir = root_->dirs[i / unsigned(PointersPerBlock)];
+        if (dir == UAVCAN_NULLPTR)
+        {
+            dir = allocateBlock<Directory>();
+        }
+        Page* const page = (dir == UAVCAN_NULLPTR) ? UAVCAN_NULLPTR : allocateBlock<Page>();
+        if (page == UAVCAN_NULLPTR)
+        {
+            UAVCAN_TRACE("HashMap", "OOM, %u pages requested", num_pages);
+            releaseIndex();
+            return false;
+        }
+        dir->pages[i % unsigned(PointersPerBlock)] = page;
+        num_pages_ = uint16_t(i + 1U);
+    }
+
+    for (typename Storage::KVGroup* p = map_.list_.get(); p != UAVCAN_NULLPTR; p = p->getNextListNode())
+    {
+        for (int i = 0; i < Storage::KVGroup::NumKV; i++)
+        {
+            if (!p->kvs[i].match(Key()))
+            {
+                insertIntoIndex(p->kvs + i);
+            }
+        }
+    }
+    return true;
+}
+
+template <typename Key, typename Value>
+void HashMap<Key, Value>::releaseIndex()
+{
+    if (root_ != UAVCAN_NULLPTR)
+    {
+        for (unsigned i = 0; i < unsigned(PointersPerBlock); i++)
+        {
+            Directory* const dir = root_->dirs[i];
+            if (dir != UAVCAN_NULLPTR)
+            {
+                for (unsigned k = 0; k < unsigned(PointersPerBlock); k++)
+                {
+                    deallocateBlock(dir->pages[k]);
+                }
+                deallocateBlock(dir);
+            }
+        }
+        deallocateBlock(root_);
+        root_ = UAVCAN_NULLPTR;
+    }
+    num_pages_ = 0;
+}
+
+template <typename Key, typename Value>
+typename HashMap<Key, Value>::KVPair* HashMap<Key, Value>::findInIndex(const Key& key) const
+{
+    UAVCAN_ASSERT(isIndexed());
+    const unsigned capacity = getCapacity();
+    unsigned index = getHomeSlot(key);
+    for (unsigned probe = 0; probe < capacity; probe++)
+    {
+        KVPair* const kv = slotAt(index);
+        if (kv == UAVCAN_NULLPTR)
+        {
+            break;
+        }
+        if (kv->match(key))
+        {
+            return kv;
+        }
+        index = (index + 1U) % capacity;
+    }
+    return UAVCAN_NULLPTR;
+}
+
+template <typename Key, typename Value>
+void HashMap<Key, Value>::insertIntoIndex(KVPair* kv)
+{
+    UAVCAN_ASSERT(isIndexed() && (kv != UAVCAN_NULLPTR) && !kv->match(Key()));
+    const unsigned capacity = getCapacity();
+    unsigned index = getHomeSlot(kv->key);
+    for (unsigned probe = 0; probe < capacity; probe++)
+    {
+        if (slotAt(index) == UAVCAN_NULLPTR)
+        {
+            slotAt(index) = kv;
+            return;
+        }
+        index = (index + 1U) % capacity;
+    }
+    UAVCAN_ASSERT(0);       // The caller must have checked canInsert()
+}
+
+template <typename Key, typename Value>
+void HashMap<Key, Value>::removeFromIndex(const Key& key)
+{
+    UAVCAN_ASSERT(isIndexed());
+    const unsigned capacity = getCapacity();
+
+    unsigned hole = getHomeSlot(key);
+    unsigned probe = 0;
+    while (probe < capacity)
+    {
+        if (slotAt(hole) == UAVCAN_NULLPTR)
+        {
+            UAVCAN_ASSERT(0);   // Not indexed
+            return;
+        }
+        if (slotAt(hole)->match(key))
+        {
+            break;
+        }
+        hole = (hole + 1U) % capacity;
+        probe++;
+    }
+    if (probe >= capacity)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+
+    // Backward shift of the rest of the cluster
+    unsigned index = hole;
+    while (true)
+    {
+        index = (index + 1U) % capacity;
+        KVPair* const kv = slotAt(index);
+        if (kv == UAVCAN_NULLPTR)
+        {
+            break;
+        }
+        const unsigned home = getHomeSlot(kv->key);
+        const bool reachable_without_hole = (hole <= index) ? ((hole < home) && (home <= index)) :
+                                                              ((hole < home) || (home <= index));
+        if (!reachable_without_hole)
+        {
+            slotAt(hole) = kv;
+            hole = index;
+        }
+    }
+    slotAt(hole) = UAVCAN_NULLPTR;
+}
+
+#endif
+
+template <typename Key, typename Value>
+void HashMap<Key, Value>::addToIndex(KVPair* kv)
+{
+#if UAVCAN_HASH_MAP_INDEX_THRESHOLD > 0
+    if (isIndexed())
+    {
+        if (canInsert(size_ - 1U))
+        {
+            insertIntoIndex(kv);
+        }
+        else
+        {
+            (void)rebuildIndex();   // Grow; falls back to the linear search on failure
+        }
+    }
+    else if (size_ >= UAVCAN_HASH_MAP_INDEX_THRESHOLD)
+    {
+        (void)rebuildIndex();
+    }
+#else
+    (void)kv;
+#endif
+}
+
+template <typename Key, typename Value>
+void HashMap<Key, Value>::unindex(const Key& key)
+{
+    UAVCAN_ASSERT(size_ > 0);
+    size_--;
+#if UAVCAN_HASH_MAP_INDEX_THRESHOLD > 0
+    if (isIndexed())
+    {
+        // Hysteresis prevents reallocation of the index when the number of entries fluctuates around the threshold
+        if (size_ * 2U < unsigned(UAVCAN_HASH_MAP_INDEX_THRESHOLD))
+        {
+            releaseIndex();
+        }
+        else
+        {
+            removeFromIndex(key);
+        }
+    }
+#else
+    (void)key;
+#endif
+}
+
+template <typename Key, typename Value>
+typename HashMap<Key, Value>::KVPair* HashMap<Key, Value>::findKey(const Key& key)
+{
+#if UAVCAN_HASH_MAP_INDEX_THRESHOLD > 0
+    if (isIndexed())
+    {
+        return findInIndex(key);
+    }
+#endif
+    return map_.findKey(key);
+}
+
+template <typename Key, typename Value>
+Value* HashMap<Key, Value>::insert(const Key& key, const Value& value)
+{
+    UAVCAN_ASSERT(!(key == Key()));
+    remove(key);
+
+    KVPair* const kv = map_.insertPair(key, value);
+    if (kv == UAVCAN_NULLPTR)
+    {
+        return UAVCAN_NULLPTR;
+    }
+    size_++;
+    addToIndex(kv);
+    return &kv->value;
+}
+
+template <typename Key, typename Value>
+void HashMap<Key, Value>::remove(const Key& key)
+{
+    UAVCAN_ASSERT(!(key == Key()));
+    KVPair* const kv = findKey(key);
+    if (kv != UAVCAN_NULLPTR)
+    {
+        unindex(key);
+        map_.removePair(kv);
+    }
+}
+
+template <typename Key, typename Value>
+void HashMap<Key, Value>::clear()
+{
+#if UAVCAN_HASH_MAP_INDEX_THRESHOLD > 0
+    releaseIndex();
+#endif
+    map_.clear();
+    size_ = 0;
+}
+
+}
+
+#endif // UAVCAN_UTIL_HASH_MAP_HPP_INCLUDED
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_UTIL_INPLACE_FUNCTION_HPP_INCLUDED
+#define UAVCAN_UTIL_INPLACE_FUNCTION_HPP_INCLUDED
+
+#include <uavcan/error.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/util/placement_new.hpp>
+
+#ifndef UAVCAN_CPP_VERSION
+# error UAVCAN_CPP_VERSION
+#endif
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+namespace uavcan
+{
+/**
+ * Replacement for std::function<> that keeps the callable object in a fixed buffer inside itself.
+ * It never allocates memory and doesn't need RTTI; a callable object that doesn't fit into the buffer is rejected
+ * at compile time. The object is invoked through one function pointer, and copied and destroyed through a table of
+ * function pointers shared by all instances that hold the same callable type.
+ *
+ * Invoking an empty function raises a fatal error, see @ref handleFatalError().
+ *
+ * @tparam Signature    Function signature, e.g. void (const TimerEvent&).
+ * @tparam Capacity     Size of the buffer, in bytes.
+ */
+template <typename Signature, unsigned Capacity = UAVCAN_INPLACE_FUNCTION_CAPACITY>
+class UAVCAN_EXPORT InplaceFunction;
+
+template <typename R, typename... Args, unsigned Capacity>
+class UAVCAN_EXPORT InplaceFunction<R (Args...), Capacity>
+{
+    struct Ops
+    {
+        R (*invoke)(void* storage, Args... args);
+        void (*copy)(void* dst, const void* src);
+        void (*destroy)(void* storage);
+    };
+
+    template <typename F>
+    struct OpsOf
+    {
+        static R invoke(void* storage, Args... args)
+        {
+            return (*static_cast<F*>(storage))(std::forward<Args>(args)...);
+        }
+        static void copy(void* dst, const void* src) { (void)new (dst) F(*static_cast<const F*>(src)); }
+        static void destroy(void* storage) { static_cast<F*>(storage)->~F(); }
+
+        static const Ops Instance;
+    };
+
+    mutable typename std::aligned_storage<Capacity>::type storage_;     ///< Invoked as non-const
+    const Ops* ops_;
+
+    template <typename F>
+    static bool isNull(const F&) { return false; }
+
+    template <typename F>
+    static bool isNull(F* const& ptr) { return ptr == UAVCAN_NULLPTR; }
+
+    template <typename F>
+    static bool isNull(const std::function<F>& fun) { return !fun; }
+
+    template <typename F>
+    void assign(F&& fun)
+    {
+        typedef typename std::decay<F>::type Callable;
+        static_assert(sizeof(Callable) <= Capacity, "The callable object doesn't fit into InplaceFunction");
+        static_assert(alignof(Callable) <= alignof(decltype(storage_)), "The callable object is overaligned");
+        if (!isNull(fun))
+        {
+            (void)new (&storage_) Callable(std::forward<F>(fun));
+            ops_ = &OpsOf<Callable>::Instance;
+        }
+    }
+
+    void copyFrom(const InplaceFunction& rhs)
+    {
+        if (rhs.ops_ != UAVCAN_NULLPTR)
+        {
+            rhs.ops_->copy(&storage_, &rhs.storage_);
+            ops_ = rhs.ops_;
+        }
+    }
+
+    template <typename F>
+    struct IsCallable
+    {
+        enum { Result = !std::is_same<typename std::decay<F>::type, InplaceFunction>::value &&
+                        !std::is_same<typename std::decay<F>::type, std::nullptr_t>::value };
+    };
+
+public:
+    InplaceFunction() : ops_(UAVCAN_NULLPTR) { }
+
+    InplaceFunction(std::nullptr_t) : ops_(UAVCAN_NULLPTR) { }
+
+    InplaceFunction(const InplaceFunction& rhs)
+        : ops_(UAVCAN_NULLPTR)
+    {
+        copyFrom(rhs);
+    }
+
+    /**
+     * Accepts any callable object: a lambda, a functor, a function pointer, a @ref MethodBinder, etc.
+     * Null function pointers and empty std::function<> objects produce an empty function.
+     */
+    template <typename F, typename = typename std::enable_if<IsCallable<F>::Result>::type>
+    InplaceFunction(F&& fun)
+        : ops_(UAVCAN_NULLPTR)
+    {
+        assign(std::forward<F>(fun));
+    }
+
+    ~InplaceFunction() { clear(); }
+
+    InplaceFunction& operator=(const InplaceFunction& rhs)
+    {
+        if (this != &rhs)
+        {
+            clear();
+            copyFrom(rhs);
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(std::nullptr_t)
+    {
+        clear();
+        return *this;
+    }
+
+    template <typename F, typename = typename std::enable_if<IsCallable<F>::Result>::type>
+    InplaceFunction& operator=(F&& fun)
+    {
+        clear();
+        assign(std::forward<F>(fun));
+        return *this;
+    }
+
+    /**
+     * Destroys the callable object, making the function empty.
+     */
+    void clear()
+    {
+        if (ops_ != UAVCAN_NULLPTR)
+        {
+            ops_->destroy(&storage_);
+            ops_ = UAVCAN_NULLPTR;
+        }
+    }
+
+    /**
+     * Returns true if the function is not empty.
+     * The conversion is implicit, same as in @ref MethodBinder, so that the node classes can check the callbacks.
+     */
+    operator bool() const { return ops_ != UAVCAN_NULLPTR; }
+
+    /**
+     * The callable object is invoked as non-const, same as with std::function<>.
+     */
+    R operator()(Args... args) const
+    {
+        if (ops_ == UAVCAN_NULLPTR)
+        {
+            handleFatalError("Null function");
+        }
+        return ops_->invoke(&storage_, std::forward<Args>(args)...);
+    }
+};
+
+template <typename R, typename... Args, unsigned Capacity>
+template <typename F>
+const typename InplaceFunction<R (Args...), Capacity>::Ops
+InplaceFunction<R (Args...), Capacity>::OpsOf<F>::Instance =
+{
+    &InplaceFunction<R (Args...), Capacity>::OpsOf<F>::invoke,
+    &InplaceFunction<R (Args...), Capacity>::OpsOf<F>::copy,
+    &InplaceFunction<R (Args...), Capacity>::OpsOf<F>::destroy
+};
+
+/**
+ * Default callback type of the node classes in C++11 mode, see @ref UAVCAN_INPLACE_CALLBACKS.
+ */
+#if UAVCAN_INPLACE_CALLBACKS
+template <typename Signature>
+using DefaultCallback = InplaceFunction<Signature>;
+#else
+template <typename Signature>
+using DefaultCallback = std::function<Signature>;
+#endif
+
+}
+
+#endif
+
+#endif // UAVCAN_UTIL_INPLACE_FUNCTION_HPP_INCLUDED
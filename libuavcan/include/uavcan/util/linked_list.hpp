@@ -1,5 +1,5 @@
 /*
- * Singly-linked list.
+ * Singly- and doubly-linked lists.
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
@@ -73,6 +73,13 @@ public:
     template <typename Predicate>
     void insertBefore(T* node, Predicate predicate);
 
+    /**
+     * Inserts the node immediately after the node prev, or to the beginning of the list if prev is null.
+     * The node must not be present in the list; prev must be present in the list.
+     * Complexity: O(1)
+     */
+    void insertAfter(T* node, T* prev);
+
     /**
      * Removes only the first occurence of the node.
      * Complexity: O(N)
@@ -80,6 +87,101 @@ public:
     void remove(const T* node);
 };
 
+/**
+ * Classes that are supposed to be listed in a @ref DoublyLinkedListRoot should derive this.
+ */
+template <typename T>
+class UAVCAN_EXPORT DoublyLinkedListNode : Noncopyable
+{
+    T* next_;
+    T* prev_;
+
+protected:
+    DoublyLinkedListNode()
+        : next_(UAVCAN_NULLPTR)
+        , prev_(UAVCAN_NULLPTR)
+    { }
+
+    ~DoublyLinkedListNode() { }
+
+public:
+    T* getNextListNode() const { return next_; }
+    T* getPrevListNode() const { return prev_; }
+
+    void setNextListNode(T* node) { next_ = node; }
+    void setPrevListNode(T* node) { prev_ = node; }
+};
+
+/**
+ * Doubly linked list root with a tail pointer and the cached length.
+ * Unlike @ref LinkedListRoot, it offers O(1) removal, FIFO append and length query, at the cost of
+ * one more pointer per node and two more words in the root.
+ * A node can be a member of at most one list at a time; it must not be passed to a list it is not a member of,
+ * except for insertion.
+ */
+template <typename T>
+class UAVCAN_EXPORT DoublyLinkedListRoot : Noncopyable
+{
+    T* head_;
+    T* tail_;
+    unsigned length_;
+
+    bool contains(const T* node) const { return (node->getPrevListNode() != UAVCAN_NULLPTR) || (head_ == node); }
+
+    void link(T* node, T* prev, T* next);
+
+public:
+    DoublyLinkedListRoot()
+        : head_(UAVCAN_NULLPTR)
+        , tail_(UAVCAN_NULLPTR)
+        , length_(0)
+    { }
+
+    T* get() const { return head_; }
+    T* getTail() const { return tail_; }
+    bool isEmpty() const { return head_ == UAVCAN_NULLPTR; }
+
+    /**
+     * Complexity: O(1)
+     */
+    unsigned getLength() const { return length_; }
+
+    /**
+     * Inserts the node to the beginning of the list.
+     * If the node is already present in the list, it will be relocated to the beginning.
+     * Complexity: O(1)
+     */
+    void insert(T* node) { insertAfter(node, UAVCAN_NULLPTR); }
+
+    /**
+     * Appends the node to the end of the list.
+     * If the node is already present in the list, it will be relocated to the end.
+     * Complexity: O(1)
+     */
+    void pushBack(T* node);
+
+    /**
+     * Inserts the node immediately before the node X where predicate(X) returns true.
+     * If the node is already present in the list, it can be relocated to a new position.
+     * Complexity: O(N)
+     */
+    template <typename Predicate>
+    void insertBefore(T* node, Predicate predicate);
+
+    /**
+     * Inserts the node immediately after the node prev, or to the beginning of the list if prev is null.
+     * If the node is already present in the list, it will be relocated; prev must be present in the list.
+     * Complexity: O(1)
+     */
+    void insertAfter(T* node, T* prev);
+
+    /**
+     * Does nothing if the node is not present in any list.
+     * Complexity: O(1)
+     */
+    void remove(T* node);
+};
+
 // ----------------------------------------------------------------------------
 
 /*
@@ -144,6 +246,26 @@ void LinkedListRoot<T>::insertBefore(T* node, Predicate predicate)
     }
 }
 
+template <typename T>
+void LinkedListRoot<T>::insertAfter(T* node, T* prev)
+{
+    if (node == UAVCAN_NULLPTR || node == prev)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    if (prev == UAVCAN_NULLPTR)
+    {
+        node->setNextListNode(root_);
+        root_ = node;
+    }
+    else
+    {
+        node->setNextListNode(prev->getNextListNode());
+        prev->setNextListNode(node);
+    }
+}
+
 template <typename T>
 void LinkedListRoot<T>::remove(const T* node)
 {
@@ -171,6 +293,110 @@ void LinkedListRoot<T>::remove(const T* node)
     }
 }
 
+/*
+ * DoublyLinkedListRoot<>
+ */
+template <typename T>
+void DoublyLinkedListRoot<T>::link(T* node, T* prev, T* next)
+{
+    node->setPrevListNode(prev);
+    node->setNextListNode(next);
+    if (prev == UAVCAN_NULLPTR)
+    {
+        head_ = node;
+    }
+    else
+    {
+        prev->setNextListNode(node);
+    }
+    if (next == UAVCAN_NULLPTR)
+    {
+        tail_ = node;
+    }
+    else
+    {
+        next->setPrevListNode(node);
+    }
+    length_++;
+}
+
+template <typename T>
+void DoublyLinkedListRoot<T>::pushBack(T* node)
+{
+    if (node == UAVCAN_NULLPTR)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    remove(node);  // Making sure there will be no loops
+    link(node, tail_, UAVCAN_NULLPTR);
+}
+
+template <typename T>
+template <typename Predicate>
+void DoublyLinkedListRoot<T>::insertBefore(T* node, Predicate predicate)
+{
+    if (node == UAVCAN_NULLPTR)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    remove(node);
+
+    T* next = head_;
+    while ((next != UAVCAN_NULLPTR) && !predicate(next))
+    {
+        next = next->getNextListNode();
+    }
+    link(node, (next == UAVCAN_NULLPTR) ? tail_ : next->getPrevListNode(), next);
+}
+
+template <typename T>
+void DoublyLinkedListRoot<T>::insertAfter(T* node, T* prev)
+{
+    if (node == UAVCAN_NULLPTR || node == prev)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    UAVCAN_ASSERT((prev == UAVCAN_NULLPTR) || contains(prev));
+    remove(node);
+    link(node, prev, (prev == UAVCAN_NULLPTR) ? head_ : prev->getNextListNode());
+}
+
+template <typename T>
+void DoublyLinkedListRoot<T>::remove(T* node)
+{
+    if (node == UAVCAN_NULLPTR || !contains(node))
+    {
+        return;
+    }
+
+    T* const prev = node->getPrevListNode();
+    T* const next = node->getNextListNode();
+    if (prev == UAVCAN_NULLPTR)
+    {
+        head_ = next;
+    }
+    else
+    {
+        prev->setNextListNode(next);
+    }
+    if (next == UAVCAN_NULLPTR)
+    {
+        tail_ = prev;
+    }
+    else
+    {
+        next->setPrevListNode(prev);
+    }
+    node->setPrevListNode(UAVCAN_NULLPTR);
+    node->setNextListNode(UAVCAN_NULLPTR);
+
+    UAVCAN_ASSERT(length_ > 0);
+    length_--;
+}
+
 }
 
 #endif // UAVCAN_UTIL_LINKED_LIST_HPP_INCLUDED
@@ -94,14 +94,42 @@ private:
             }
             return UAVCAN_NULLPTR;
         }
+
+        bool contains(const KVPair* kv) const { return (kv >= kvs) && (kv < (kvs + NumKV)); }
+
+        bool isEmpty() const
+        {
+            for (unsigned i = 0; i < static_cast<unsigned>(NumKV); i++)
+            {
+                if (!kvs[i].match(Key()))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
     };
 
     LinkedListRoot<KVGroup> list_;
     IPoolAllocator& allocator_;
 
-    KVPair* findKey(const Key& key);
+    KVPair* findKey(const Key& key, KVGroup** out_group = UAVCAN_NULLPTR);
+
+    /**
+     * Releases the group if it has no entries left. Only the given group is inspected, so that the cost of a
+     * removal doesn't depend on the size of the map.
+     */
+    void releaseGroupIfEmpty(KVGroup* group);
+
+    /**
+     * Used by @ref HashMap, which maintains its index over the stored pairs.
+     * The pairs never move while they are stored.
+     */
+    template <typename, typename> friend class HashMap;
+    template <typename, typename, unsigned> friend class StaticMap;
 
-    void compact();
+    KVPair* insertPair(const Key& key, const Value& value);
+    void removePair(KVPair* kv);
 
     struct YesPredicate
     {
@@ -181,7 +209,7 @@ public:
  * Map<>
  */
 template <typename Key, typename Value>
-typename Map<Key, Value>::KVPair* Map<Key, Value>::findKey(const Key& key)
+typename Map<Key, Value>::KVPair* Map<Key, Value>::findKey(const Key& key, KVGroup** out_group)
 {
     KVGroup* p = list_.get();
     while (p)
@@ -189,6 +217,10 @@ typename Map<Key, Value>::KVPair* Map<Key, Value>::findKey(const Key& key)
         KVPair* const kv = p->find(key);
         if (kv)
         {
+            if (out_group != UAVCAN_NULLPTR)
+            {
+                *out_group = p;
+            }
             return kv;
         }
         p = p->getNextListNode();
@@ -197,27 +229,13 @@ typename Map<Key, Value>::KVPair* Map<Key, Value>::findKey(const Key& key)
 }
 
 template <typename Key, typename Value>
-void Map<Key, Value>::compact()
+void Map<Key, Value>::releaseGroupIfEmpty(KVGroup* group)
 {
-    KVGroup* p = list_.get();
-    while (p)
+    UAVCAN_ASSERT(group != UAVCAN_NULLPTR);
+    if (group->isEmpty())
     {
-        KVGroup* const next = p->getNextListNode();
-        bool remove_this = true;
-        for (int i = 0; i < KVGroup::NumKV; i++)
-        {
-            if (!p->kvs[i].match(Key()))
-            {
-                remove_this = false;
-                break;
-            }
-        }
-        if (remove_this)
-        {
-            list_.remove(p);
-            KVGroup::destroy(p, allocator_);
-        }
-        p = next;
+        list_.remove(group);
+        KVGroup::destroy(group, allocator_);
     }
 }
 
@@ -235,11 +253,18 @@ Value* Map<Key, Value>::insert(const Key& key, const Value& value)
     UAVCAN_ASSERT(!(key == Key()));
     remove(key);
 
+    KVPair* const kv = insertPair(key, value);
+    return kv ? &kv->value : UAVCAN_NULLPTR;
+}
+
+template <typename Key, typename Value>
+typename Map<Key, Value>::KVPair* Map<Key, Value>::insertPair(const Key& key, const Value& value)
+{
     KVPair* const kv = findKey(Key());
     if (kv)
     {
         *kv = KVPair(key, value);
-        return &kv->value;
+        return kv;
     }
 
     KVGroup* const kvg = KVGroup::instantiate(allocator_);
@@ -249,18 +274,36 @@ Value* Map<Key, Value>::insert(const Key& key, const Value& value)
     }
     list_.insert(kvg);
     kvg->kvs[0] = KVPair(key, value);
-    return &kvg->kvs[0].value;
+    return &kvg->kvs[0];
 }
 
 template <typename Key, typename Value>
 void Map<Key, Value>::remove(const Key& key)
 {
     UAVCAN_ASSERT(!(key == Key()));
-    KVPair* const kv = findKey(key);
+    KVGroup* group = UAVCAN_NULLPTR;
+    KVPair* const kv = findKey(key, &group);
     if (kv)
     {
         *kv = KVPair();
-        compact();
+        releaseGroupIfEmpty(group);
+    }
+}
+
+template <typename Key, typename Value>
+void Map<Key, Value>::removePair(KVPair* kv)
+{
+    UAVCAN_ASSERT(kv != UAVCAN_NULLPTR);
+    KVGroup* p = list_.get();
+    while ((p != UAVCAN_NULLPTR) && !p->contains(kv))
+    {
+        p = p->getNextListNode();
+    }
+    UAVCAN_ASSERT(p != UAVCAN_NULLPTR);
+    *kv = KVPair();
+    if (p != UAVCAN_NULLPTR)
+    {
+        releaseGroupIfEmpty(p);
     }
 }
 
@@ -268,13 +311,12 @@ template <typename Key, typename Value>
 template <typename Predicate>
 void Map<Key, Value>::removeAllWhere(Predicate predicate)
 {
-    unsigned num_removed = 0;
-
     KVGroup* p = list_.get();
     while (p != UAVCAN_NULLPTR)
     {
         KVGroup* const next_group = p->getNextListNode();
 
+        bool removed = false;
         for (int i = 0; i < KVGroup::NumKV; i++)
         {
             const KVPair* const kv = p->kvs + i;
@@ -282,18 +324,19 @@ void Map<Key, Value>::removeAllWhere(Predicate predicate)
             {
                 if (predicate(kv->key, kv->value))
                 {
-                    num_removed++;
+                    removed = true;
                     p->kvs[i] = KVPair();
                 }
             }
         }
 
-        p = next_group;
-    }
+        // Empty groups are released on the way, instead of another pass over the list
+        if (removed)
+        {
+            releaseGroupIfEmpty(p);
+        }
 
-    if (num_removed > 0)
-    {
-        compact();
+        p = next_group;
     }
 }
 
@@ -383,6 +426,174 @@ unsigned Map<Key, Value>::getSize() const
     return num;
 }
 
+/**
+ * Same as @ref Map, but the pairs are stored in a fixed array inside the object, so the capacity is limited
+ * at compile time and the pool is never used. This is preferable for the users with a known upper bound on the
+ * number of entries: there are no allocator round trips, no pool fragmentation, and the pairs are located
+ * next to each other.
+ *
+ * Insertion fails (returns null pointer) once the capacity is exhausted.
+ * Type requirements are the same as for @ref Map, except that the size of a pair is not limited.
+ */
+template <typename Key, typename Value, unsigned NumEntries>
+class UAVCAN_EXPORT StaticMap : Noncopyable
+{
+public:
+    typedef typename Map<Key, Value>::KVPair KVPair;
+
+    enum { Capacity = NumEntries };
+
+private:
+    KVPair kvs_[NumEntries];
+
+    KVPair* findKey(const Key& key)
+    {
+        for (unsigned i = 0; i < NumEntries; i++)
+        {
+            if (kvs_[i].match(key))
+            {
+                return kvs_ + i;
+            }
+        }
+        return UAVCAN_NULLPTR;
+    }
+
+public:
+    StaticMap()
+    {
+        StaticAssert<(NumEntries > 0)>::check();
+        UAVCAN_ASSERT(Key() == Key());
+    }
+
+    /**
+     * Returns null pointer if there's no such entry.
+     */
+    Value* access(const Key& key)
+    {
+        UAVCAN_ASSERT(!(key == Key()));
+        KVPair* const kv = findKey(key);
+        return kv ? &kv->value : UAVCAN_NULLPTR;
+    }
+
+    /**
+     * If entry with the same key already exists, it will be replaced.
+     * Returns null pointer if the map is full.
+     */
+    Value* insert(const Key& key, const Value& value)
+    {
+        UAVCAN_ASSERT(!(key == Key()));
+        KVPair* kv = findKey(key);
+        if (kv == UAVCAN_NULLPTR)
+        {
+            kv = findKey(Key());
+        }
+        if (kv == UAVCAN_NULLPTR)
+        {
+            return UAVCAN_NULLPTR;
+        }
+        *kv = KVPair(key, value);
+        return &kv->value;
+    }
+
+    /**
+     * Does nothing if there's no such entry.
+     */
+    void remove(const Key& key)
+    {
+        UAVCAN_ASSERT(!(key == Key()));
+        KVPair* const kv = findKey(key);
+        if (kv)
+        {
+            *kv = KVPair();
+        }
+    }
+
+    /**
+     * Removes entries where the predicate returns true.
+     * Predicate prototype:
+     *  bool (Key& key, Value& value)
+     */
+    template <typename Predicate>
+    void removeAllWhere(Predicate predicate)
+    {
+        for (unsigned i = 0; i < NumEntries; i++)
+        {
+            if (!kvs_[i].match(Key()) && predicate(kvs_[i].key, kvs_[i].value))
+            {
+                kvs_[i] = KVPair();
+            }
+        }
+    }
+
+    /**
+     * Returns first entry where the predicate returns true.
+     * Predicate prototype:
+     *  bool (const Key& key, const Value& value)
+     */
+    template <typename Predicate>
+    const Key* find(Predicate predicate) const
+    {
+        for (unsigned i = 0; i < NumEntries; i++)
+        {
+            if (!kvs_[i].match(Key()) && predicate(kvs_[i].key, kvs_[i].value))
+            {
+                return &kvs_[i].key;
+            }
+        }
+        return UAVCAN_NULLPTR;
+    }
+
+    /**
+     * Removes all items.
+     */
+    void clear() { removeAllWhere(typename Map<Key, Value>::YesPredicate()); }
+
+    /**
+     * Returns a key-value pair located at the specified position from the beginning.
+     * Note that insertion and deletion may change the ordering.
+     * If index is greater than or equal the number of pairs, null pointer will be returned.
+     */
+    KVPair* getByIndex(unsigned index)
+    {
+        for (unsigned i = 0; i < NumEntries; i++)
+        {
+            if (!kvs_[i].match(Key()))
+            {
+                if (index == 0)
+                {
+                    return kvs_ + i;
+                }
+                index--;
+            }
+        }
+        return UAVCAN_NULLPTR;
+    }
+    const KVPair* getByIndex(unsigned index) const
+    {
+        return const_cast<StaticMap*>(this)->getByIndex(index);
+    }
+
+    /**
+     * Complexity is O(N) in the worst case.
+     */
+    bool isEmpty() const { return find(typename Map<Key, Value>::YesPredicate()) == UAVCAN_NULLPTR; }
+
+    /**
+     * Complexity is O(Capacity).
+     */
+    unsigned getSize() const
+    {
+        unsigned num = 0;
+        for (unsigned i = 0; i < NumEntries; i++)
+        {
+            num += kvs_[i].match(Key()) ? 0U : 1U;
+        }
+        return num;
+    }
+
+    static unsigned getCapacity() { return NumEntries; }
+};
+
 }
 
 #endif // UAVCAN_UTIL_MAP_HPP_INCLUDED
@@ -28,6 +28,8 @@ namespace uavcan
 template <typename T>
 class UAVCAN_EXPORT Multiset : Noncopyable
 {
+    template <typename, unsigned> friend class StaticMultiset;
+
     struct Item : ::uavcan::Noncopyable
     {
         T* ptr;
@@ -113,6 +115,18 @@ private:
             }
             return UAVCAN_NULLPTR;
         }
+
+        bool isEmpty() const
+        {
+            for (unsigned i = 0; i < static_cast<unsigned>(NumItems); i++)
+            {
+                if (items[i].isConstructed())
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
     };
 
     /*
@@ -126,7 +140,11 @@ private:
      */
     Item* findOrCreateFreeSlot();
 
-    void compact();
+    /**
+     * Releases the chunk if it has no items left. Only the given chunk is inspected, so that the cost of a
+     * removal doesn't depend on the size of the container.
+     */
+    void releaseChunkIfEmpty(Chunk* chunk);
 
     enum RemoveStrategy { RemoveOne, RemoveAll };
 
@@ -366,27 +384,13 @@ typename Multiset<T>::Item* Multiset<T>::findOrCreateFreeSlot()
 }
 
 template <typename T>
-void Multiset<T>::compact()
+void Multiset<T>::releaseChunkIfEmpty(Chunk* chunk)
 {
-    Chunk* p = list_.get();
-    while (p)
+    UAVCAN_ASSERT(chunk != UAVCAN_NULLPTR);
+    if (chunk->isEmpty())
     {
-        Chunk* const next = p->getNextListNode();
-        bool remove_this = true;
-        for (int i = 0; i < Chunk::NumItems; i++)
-        {
-            if (p->items[i].isConstructed())
-            {
-                remove_this = false;
-                break;
-            }
-        }
-        if (remove_this)
-        {
-            list_.remove(p);
-            Chunk::destroy(p, allocator_);
-        }
-        p = next;
+        list_.remove(chunk);
+        Chunk::destroy(chunk, allocator_);
     }
 }
 
@@ -406,6 +410,7 @@ void Multiset<T>::removeWhere(Predicate predicate, const RemoveStrategy strategy
             break;
         }
 
+        const unsigned num_removed_before = num_removed;
         for (int i = 0; i < Chunk::NumItems; i++)
         {
             Item& item = p->items[i];
@@ -423,12 +428,13 @@ void Multiset<T>::removeWhere(Predicate predicate, const RemoveStrategy strategy
             }
         }
 
-        p = next_chunk;
-    }
+        // Empty chunks are released on the way, instead of another pass over the list
+        if (num_removed > num_removed_before)
+        {
+            releaseChunkIfEmpty(p);
+        }
 
-    if (num_removed > 0)
-    {
-        compact();
+        p = next_chunk;
     }
 }
 
@@ -473,6 +479,187 @@ unsigned Multiset<T>::getSize() const
     return num;
 }
 
+/**
+ * Same as @ref Multiset, but the items are stored in a fixed array inside the object, so the capacity is limited
+ * at compile time and the pool is never used. This is preferable for the users with a known upper bound on the
+ * number of items: there are no allocator round trips, no pool fragmentation, and the items are located
+ * next to each other. The items are not moved either.
+ *
+ * Creation of an item fails (returns null pointer) once the capacity is exhausted.
+ */
+template <typename T, unsigned NumItems>
+class UAVCAN_EXPORT StaticMultiset : Noncopyable
+{
+    typedef Multiset<T> Dynamic;
+    typedef typename Dynamic::Item Item;
+
+    Item items_[NumItems];
+
+    Item* findFreeSlot()
+    {
+        for (unsigned i = 0; i < NumItems; i++)
+        {
+            if (!items_[i].isConstructed())
+            {
+                return items_ + i;
+            }
+        }
+        return UAVCAN_NULLPTR;
+    }
+
+    template <typename Predicate>
+    void removeWhere(Predicate predicate, typename Dynamic::RemoveStrategy strategy)
+    {
+        for (unsigned i = 0; i < NumItems; i++)
+        {
+            if (items_[i].isConstructed() && predicate(*items_[i].ptr))
+            {
+                items_[i].destroy();
+                if (strategy == Dynamic::RemoveOne)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+public:
+    enum { Capacity = NumItems };
+
+    StaticMultiset()
+    {
+        StaticAssert<(NumItems > 0)>::check();
+    }
+
+    /**
+     * Creates one item in-place and returns a pointer to it.
+     * If there is no free slot, UAVCAN_NULLPTR will be returned.
+     * Complexity is O(N).
+     */
+    T* emplace()
+    {
+        Item* const item = findFreeSlot();
+        if (item == UAVCAN_NULLPTR)
+        {
+            return UAVCAN_NULLPTR;
+        }
+        item->ptr = new (item->pool) T();
+        return item->ptr;
+    }
+
+    template <typename P1>
+    T* emplace(P1 p1)
+    {
+        Item* const item = findFreeSlot();
+        if (item == UAVCAN_NULLPTR)
+        {
+            return UAVCAN_NULLPTR;
+        }
+        item->ptr = new (item->pool) T(p1);
+        return item->ptr;
+    }
+
+    template <typename P1, typename P2>
+    T* emplace(P1 p1, P2 p2)
+    {
+        Item* const item = findFreeSlot();
+        if (item == UAVCAN_NULLPTR)
+        {
+            return UAVCAN_NULLPTR;
+        }
+        item->ptr = new (item->pool) T(p1, p2);
+        return item->ptr;
+    }
+
+    template <typename P1, typename P2, typename P3>
+    T* emplace(P1 p1, P2 p2, P3 p3)
+    {
+        Item* const item = findFreeSlot();
+        if (item == UAVCAN_NULLPTR)
+        {
+            return UAVCAN_NULLPTR;
+        }
+        item->ptr = new (item->pool) T(p1, p2, p3);
+        return item->ptr;
+    }
+
+    /**
+     * Behave the same way as the methods of @ref Multiset.
+     */
+    template <typename Predicate>
+    void removeAllWhere(Predicate predicate) { removeWhere<Predicate>(predicate, Dynamic::RemoveAll); }
+
+    template <typename Predicate>
+    void removeFirstWhere(Predicate predicate) { removeWhere<Predicate>(predicate, Dynamic::RemoveOne); }
+
+    void removeFirst(const T& ref) { removeFirstWhere(typename Dynamic::ComparingPredicate(ref)); }
+
+    void removeAll(const T& ref) { removeAllWhere(typename Dynamic::ComparingPredicate(ref)); }
+
+    void clear() { removeAllWhere(typename Dynamic::YesPredicate()); }
+
+    template <typename Predicate>
+    T* find(Predicate predicate)
+    {
+        for (unsigned i = 0; i < NumItems; i++)
+        {
+            if (items_[i].isConstructed() && predicate(*items_[i].ptr))
+            {
+                return items_[i].ptr;
+            }
+        }
+        return UAVCAN_NULLPTR;
+    }
+
+    template <typename Predicate>
+    const T* find(Predicate predicate) const
+    {
+        return const_cast<StaticMultiset*>(this)->find<Predicate>(predicate);
+    }
+
+    template <typename Operator>
+    void forEach(Operator oper)
+    {
+        typename Dynamic::template OperatorToFalsePredicateAdapter<Operator> adapter(oper);
+        (void)find<typename Dynamic::template OperatorToFalsePredicateAdapter<Operator>&>(adapter);
+    }
+
+    template <typename Operator>
+    void forEach(Operator oper) const
+    {
+        const typename Dynamic::template OperatorToFalsePredicateAdapter<Operator> adapter(oper);
+        (void)find<const typename Dynamic::template OperatorToFalsePredicateAdapter<Operator>&>(adapter);
+    }
+
+    T* getByIndex(unsigned index)
+    {
+        typename Dynamic::IndexPredicate predicate(index);
+        return find<typename Dynamic::IndexPredicate&>(predicate);
+    }
+
+    const T* getByIndex(unsigned index) const
+    {
+        return const_cast<StaticMultiset*>(this)->getByIndex(index);
+    }
+
+    bool isEmpty() const { return find(typename Dynamic::YesPredicate()) == UAVCAN_NULLPTR; }
+
+    /**
+     * Complexity is O(Capacity).
+     */
+    unsigned getSize() const
+    {
+        unsigned num = 0;
+        for (unsigned i = 0; i < NumItems; i++)
+        {
+            num += items_[i].isConstructed() ? 1U : 0U;
+        }
+        return num;
+    }
+
+    static unsigned getCapacity() { return NumItems; }
+};
+
 }
 
 #endif // Include guard
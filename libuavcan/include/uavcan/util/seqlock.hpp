@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_UTIL_SEQLOCK_HPP_INCLUDED
+#define UAVCAN_UTIL_SEQLOCK_HPP_INCLUDED
+
+#include <cstring>
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/util/templates.hpp>
+
+#if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
+# error UAVCAN_CPP_VERSION
+#endif
+
+#if UAVCAN_CPP_VERSION < UAVCAN_CPP11
+# error SeqLocked requires C++11 atomics
+#endif
+
+#include <atomic>
+
+namespace uavcan
+{
+/**
+ * Value that is updated by one thread and can be read by any number of other threads without locking.
+ *
+ * The writer never waits for the readers. A reader copies the value and retries if it was updated meanwhile,
+ * which is detected by the sequence counter that is odd while an update is in progress; so the readers always
+ * get a consistent copy. The value is stored as an array of atomic words, so that the concurrent accesses are
+ * well-defined; it must therefore be trivially copyable, which is the case for the generated data types.
+ *
+ * Only one thread may call @ref store() at a time.
+ */
+template <typename T>
+class UAVCAN_EXPORT SeqLocked : Noncopyable
+{
+    enum { NumWords = (sizeof(T) + sizeof(uint32_t) - 1U) / sizeof(uint32_t) };
+
+    std::atomic<uint32_t> seq_;
+    std::atomic<uint32_t> words_[NumWords];
+
+    static unsigned getWordSize(unsigned index)
+    {
+        return min<unsigned>(unsigned(sizeof(T)) - index * unsigned(sizeof(uint32_t)), unsigned(sizeof(uint32_t)));
+    }
+
+public:
+    SeqLocked()
+        : seq_(0)
+    {
+        for (unsigned i = 0; i < NumWords; i++)
+        {
+            words_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void store(const T& value)
+    {
+        const uint8_t* const bytes = reinterpret_cast<const uint8_t*>(&value);
+        const uint32_t seq = seq_.load(std::memory_order_relaxed);
+
+        seq_.store(seq + 1U, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);    // The readers must see the odd value first
+
+        for (unsigned i = 0; i < NumWords; i++)
+        {
+            uint32_t word = 0;
+            (void)std::memcpy(&word, bytes + i * sizeof(uint32_t), getWordSize(i));
+            words_[i].store(word, std::memory_order_relaxed);
+        }
+
+        seq_.store(seq + 2U, std::memory_order_release);
+    }
+
+    /**
+     * Returns false if the value has never been stored; the output is left unchanged in that case.
+     */
+    bool load(T& out_value) const
+    {
+        uint8_t* const bytes = reinterpret_cast<uint8_t*>(&out_value);
+        for (;;)
+        {
+            const uint32_t seq_before = seq_.load(std::memory_order_acquire);
+            if (seq_before == 0)
+            {
+                return false;
+            }
+            if ((seq_before & 1U) != 0)
+            {
+                continue;               // The writer never blocks, so this won't take long
+            }
+
+            for (unsigned i = 0; i < NumWords; i++)
+            {
+                const uint32_t word = words_[i].load(std::memory_order_relaxed);
+                (void)std::memcpy(bytes + i * sizeof(uint32_t), &word, getWordSize(i));
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);    // The copy must complete before the check
+            if (seq_.load(std::memory_order_relaxed) == seq_before)
+            {
+                return true;
+            }
+        }
+    }
+
+    /**
+     * Number of completed updates. Can be used to detect changes without copying the value.
+     */
+    uint32_t getNumStores() const { return seq_.load(std::memory_order_acquire) / 2U; }
+};
+
+}
+
+#endif // UAVCAN_UTIL_SEQLOCK_HPP_INCLUDED
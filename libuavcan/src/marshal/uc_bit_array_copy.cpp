@@ -9,17 +9,34 @@
 
 namespace uavcan
 {
-void bitarrayCopy(const unsigned char* src, std::size_t src_offset, std::size_t src_len,
-                  unsigned char* dst, std::size_t dst_offset)
+namespace
 {
-    /*
-     * Should never be called on a zero-length buffer. The caller will also ensure that the bit
-     * offsets never exceed one byte.
-     */
+/*
+ * Bit arrays are big endian: the first bit is the most significant bit of the first byte. Hence the words are
+ * assembled from bytes explicitly; this also makes the loads safe for any alignment. Compilers turn these into
+ * plain (possibly byte-swapping) loads and stores on the targets that support unaligned access.
+ */
+inline uint32_t loadUnalignedBigEndian32(const unsigned char* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
 
-    UAVCAN_ASSERT(src_len > 0U);
-    UAVCAN_ASSERT(src_offset < 8U && dst_offset < 8U);
+inline void storeUnalignedBigEndian32(unsigned char* p, uint32_t value)
+{
+    p[0] = uint8_t(value >> 24);
+    p[1] = uint8_t(value >> 16);
+    p[2] = uint8_t(value >> 8);
+    p[3] = uint8_t(value);
+}
 
+/**
+ * Reference algorithm that copies up to 8 bits per iteration. Accepts arbitrary offsets.
+ * It is used for the partially written bytes at the edges of the destination range, where the bits that
+ * are outside of the range must be preserved.
+ */
+void copyBitsBytewise(const unsigned char* src, std::size_t src_offset, std::size_t src_len,
+                      unsigned char* dst, std::size_t dst_offset)
+{
     const std::size_t last_bit = src_offset + src_len;
     while (last_bit - src_offset)
     {
@@ -56,4 +73,81 @@ void bitarrayCopy(const unsigned char* src, std::size_t src_offset, std::size_t
         dst_offset += copy_bits;
     }
 }
+
+}
+
+void bitarrayCopy(const unsigned char* src, std::size_t src_offset, std::size_t src_len,
+                  unsigned char* dst, std::size_t dst_offset)
+{
+    /*
+     * Should never be called on a zero-length buffer. The caller will also ensure that the bit
+     * offsets never exceed one byte.
+     */
+
+    UAVCAN_ASSERT(src_len > 0U);
+    UAVCAN_ASSERT(src_offset < 8U && dst_offset < 8U);
+
+    /*
+     * Head - the bits that go into the first destination byte, if it's not written from its beginning.
+     * Once this is done, the destination offset is byte-aligned.
+     */
+    if (dst_offset > 0)
+    {
+        const std::size_t head_bits = uavcan::min(src_len, std::size_t(8U - dst_offset));
+        copyBitsBytewise(src, src_offset, head_bits, dst, dst_offset);
+        src_offset += head_bits;
+        src_len -= head_bits;
+        dst_offset += head_bits;
+    }
+
+    /*
+     * Body - whole destination bytes.
+     * Only the source bytes that contain copied bits are accessed, so the source is never overrun.
+     */
+    const unsigned char* src_bytes = src + (src_offset / 8U);
+    unsigned char* dst_bytes = dst + (dst_offset / 8U);
+    const unsigned shift = unsigned(src_offset % 8U);
+    std::size_t num_body_bytes = src_len / 8U;
+
+    if (num_body_bytes > 0)
+    {
+        UAVCAN_ASSERT(dst_offset % 8U == 0);
+        if (shift == 0)
+        {
+            (void)std::memcpy(dst_bytes, src_bytes, num_body_bytes);
+            src_bytes += num_body_bytes;
+            dst_bytes += num_body_bytes;
+        }
+        else
+        {
+            // Each destination word takes the bits of the source word shifted by the offset, and the remaining low
+            // bits come from the next source byte, which exists because the copied range covers part of it.
+            while (num_body_bytes >= 4U)
+            {
+                const uint32_t word = (loadUnalignedBigEndian32(src_bytes) << shift) |
+                                      (uint32_t(src_bytes[4]) >> (8U - shift));
+                storeUnalignedBigEndian32(dst_bytes, word);
+                src_bytes += 4;
+                dst_bytes += 4;
+                num_body_bytes -= 4U;
+            }
+            while (num_body_bytes > 0)
+            {
+                *dst_bytes = uint8_t((unsigned(src_bytes[0]) << shift) | (unsigned(src_bytes[1]) >> (8U - shift)));
+                src_bytes++;
+                dst_bytes++;
+                num_body_bytes--;
+            }
+        }
+    }
+
+    /*
+     * Tail - less than one byte, the rest of the last destination byte must be preserved.
+     */
+    const std::size_t tail_bits = src_len % 8U;
+    if (tail_bits > 0)
+    {
+        copyBitsBytewise(src_bytes, shift, tail_bits, dst_bytes, 0);
+    }
+}
 }
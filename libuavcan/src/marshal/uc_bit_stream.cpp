@@ -12,14 +12,103 @@ namespace uavcan
 const unsigned BitStream::MaxBytesPerRW;
 const unsigned BitStream::MaxBitsPerRW;
 
+BitStream::BitStream(StaticTransferBufferImpl& buf)
+    : buf_(&buf)
+    , static_buf_(&buf)
+    , direct_data_(UAVCAN_NULLPTR)
+    , direct_len_(0)
+    , bit_offset_(0)
+    , byte_cache_(0)
+{ }
+
+int BitStream::writeStatic(const uint8_t* bytes, const unsigned bitlen)
+{
+    const unsigned new_bit_offset = bit_offset_ + bitlen;
+    const unsigned end_byte = bitlenToBytelen(new_bit_offset);
+    if (end_byte > static_buf_->getSize())
+    {
+        return ResultOutOfBuffer;
+    }
+
+    uint8_t* const data = static_buf_->getRawPtr();
+
+    // The bits preceding the offset within the first byte are preserved by the bit copy algorithm
+    copyBitArrayAlignedToUnaligned(bytes, bitlen, data + bit_offset_ / 8, bit_offset_ % 8);
+
+    // The rest of the last byte is zeroed, same as with the intermediate buffer
+    if ((new_bit_offset % 8) != 0)
+    {
+        data[new_bit_offset / 8] = uint8_t(data[new_bit_offset / 8] & ~(0xFFU >> (new_bit_offset % 8)));
+    }
+
+    if (end_byte > static_buf_->getMaxWritePos())
+    {
+        static_buf_->setMaxWritePos(uint16_t(end_byte));
+    }
+    bit_offset_ = new_bit_offset;
+    return ResultOk;
+}
+
+int BitStream::advanceWritten(const unsigned bitlen)
+{
+    if ((static_buf_ == UAVCAN_NULLPTR) || ((bit_offset_ % 8) != 0))
+    {
+        UAVCAN_ASSERT(0);
+        return -ErrLogic;
+    }
+
+    const unsigned new_bit_offset = bit_offset_ + bitlen;
+    const unsigned end_byte = bitlenToBytelen(new_bit_offset);
+    if (end_byte > static_buf_->getSize())
+    {
+        return ResultOutOfBuffer;
+    }
+
+    if ((new_bit_offset % 8) != 0)
+    {
+        uint8_t* const data = static_buf_->getRawPtr();
+        data[new_bit_offset / 8] = uint8_t(data[new_bit_offset / 8] & ~(0xFFU >> (new_bit_offset % 8)));
+    }
+
+    if (end_byte > static_buf_->getMaxWritePos())
+    {
+        static_buf_->setMaxWritePos(uint16_t(end_byte));
+    }
+    bit_offset_ = new_bit_offset;
+    return ResultOk;
+}
+
+int BitStream::readStatic(uint8_t* bytes, const unsigned bitlen)
+{
+    if ((bit_offset_ / 8 + bitlenToBytelen(bitlen + (bit_offset_ % 8))) > static_buf_->getMaxWritePos())
+    {
+        return ResultOutOfBuffer;
+    }
+    fill(bytes, bytes + bitlenToBytelen(bitlen), uint8_t(0));
+    copyBitArrayUnalignedToAligned(static_buf_->getRawPtr() + bit_offset_ / 8, bit_offset_ % 8, bitlen, bytes);
+    bit_offset_ += bitlen;
+    return ResultOk;
+}
+
 int BitStream::write(const uint8_t* bytes, const unsigned bitlen)
 {
+    if (static_buf_ != UAVCAN_NULLPTR)
+    {
+        return writeStatic(bytes, bitlen);
+    }
+
+    if (buf_ == UAVCAN_NULLPTR)
+    {
+        UAVCAN_ASSERT(0);               // Read-only stream
+        return -ErrLogic;
+    }
+
     // Temporary buffer is needed to merge new bits with cached unaligned bits from the last write() (see byte_cache_)
     uint8_t tmp[MaxBytesPerRW + 1];
 
     // Tmp space must be large enough to accomodate new bits AND unaligned bits from the last write()
     const unsigned bytelen = bitlenToBytelen(bitlen + (bit_offset_ % 8));
-    UAVCAN_ASSERT(MaxBytesPerRW >= bytelen);
+    UAVCAN_ASSERT((MaxBytesPerRW + 1) >= bytelen);    // One extra byte if unaligned
     tmp[0] = tmp[bytelen - 1] = 0;
 
     fill(tmp, tmp + bytelen, uint8_t(0));
@@ -38,7 +127,7 @@ int BitStream::write(const uint8_t* bytes, const unsigned bitlen)
      * Note that if this write was unaligned, last written byte in the buffer will be rewritten with updated value
      * within the next write() operation.
      */
-    const int write_res = buf_.write(bit_offset_ / 8, tmp, bytelen);
+    const int write_res = buf_->write(bit_offset_ / 8, tmp, bytelen);
     if (write_res < 0)
     {
         return write_res;
@@ -54,12 +143,30 @@ int BitStream::write(const uint8_t* bytes, const unsigned bitlen)
 
 int BitStream::read(uint8_t* bytes, const unsigned bitlen)
 {
-    uint8_t tmp[MaxBytesPerRW + 1];
+    if (static_buf_ != UAVCAN_NULLPTR)
+    {
+        return readStatic(bytes, bitlen);
+    }
 
     const unsigned bytelen = bitlenToBytelen(bitlen + (bit_offset_ % 8));
-    UAVCAN_ASSERT(MaxBytesPerRW >= bytelen);
+    UAVCAN_ASSERT((MaxBytesPerRW + 1) >= bytelen);    // One extra byte if unaligned
 
-    const int read_res = buf_.read(bit_offset_ / 8, tmp, bytelen);
+    if (buf_ == UAVCAN_NULLPTR)
+    {
+        // Direct access; zero copy
+        if ((bit_offset_ / 8 + bytelen) > direct_len_)
+        {
+            return ResultOutOfBuffer;
+        }
+        fill(bytes, bytes + bitlenToBytelen(bitlen), uint8_t(0));
+        copyBitArrayUnalignedToAligned(direct_data_ + bit_offset_ / 8, bit_offset_ % 8, bitlen, bytes);
+        bit_offset_ += bitlen;
+        return ResultOk;
+    }
+
+    uint8_t tmp[MaxBytesPerRW + 1];
+
+    const int read_res = buf_->read(bit_offset_ / 8, tmp, bytelen);
     if (read_res < 0)
     {
         return read_res;
@@ -84,7 +191,15 @@ std::string BitStream::toString() const
     for (unsigned offset = 0; true; offset++)
     {
         uint8_t byte = 0;
-        if (1 != buf_.read(offset, &byte, 1U))
+        if (buf_ == UAVCAN_NULLPTR)
+        {
+            if (offset >= direct_len_)
+            {
+                break;
+            }
+            byte = direct_data_[offset];
+        }
+        else if (1 != buf_->read(offset, &byte, 1U))
         {
             break;
         }
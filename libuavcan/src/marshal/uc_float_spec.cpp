@@ -6,11 +6,54 @@
 #include <uavcan/build_config.hpp>
 #include <cmath>
 
+#if UAVCAN_FLOAT16_CONVERSION_INTRINSICS && !UAVCAN_USE_EXTERNAL_FLOAT16_CONVERSION
+# if defined(__F16C__)
+#  include <immintrin.h>
+#  define UAVCAN_FLOAT16_USE_F16C 1
+# elif defined(__ARM_NEON) && defined(__ARM_FP) && (__ARM_FP & 2)
+#  include <arm_neon.h>
+#  define UAVCAN_FLOAT16_USE_NEON 1
+# endif
+#endif
+
+#ifndef UAVCAN_FLOAT16_USE_F16C
+# define UAVCAN_FLOAT16_USE_F16C 0
+#endif
+#ifndef UAVCAN_FLOAT16_USE_NEON
+# define UAVCAN_FLOAT16_USE_NEON 0
+#endif
+
 namespace uavcan
 {
 
 #if !UAVCAN_USE_EXTERNAL_FLOAT16_CONVERSION
 
+#if UAVCAN_FLOAT16_USE_F16C
+
+uint16_t IEEE754Converter::nativeIeeeToHalf(float value)
+{
+    return _cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT);
+}
+
+float IEEE754Converter::halfToNativeIeee(uint16_t value)
+{
+    return _cvtsh_ss(value);
+}
+
+#elif UAVCAN_FLOAT16_USE_NEON
+
+uint16_t IEEE754Converter::nativeIeeeToHalf(float value)
+{
+    return vget_lane_u16(vreinterpret_u16_f16(vcvt_f16_f32(vdupq_n_f32(value))), 0);
+}
+
+float IEEE754Converter::halfToNativeIeee(uint16_t value)
+{
+    return vgetq_lane_f32(vcvt_f32_f16(vreinterpret_f16_u16(vdup_n_u16(value))), 0);
+}
+
+#else
+
 union Fp32
 {
     uint32_t u;
@@ -84,6 +127,54 @@ float IEEE754Converter::halfToNativeIeee(uint16_t value)
     return out.f;
 }
 
+#endif
+
 #endif // !UAVCAN_USE_EXTERNAL_FLOAT16_CONVERSION
 
+/*
+ * The vector kernels convert four values per iteration, the remainder goes through the scalar functions above,
+ * which use the same instructions; so the results do not depend on the position of the value in the array.
+ */
+void IEEE754Converter::nativeIeeeArrayToHalf(const float* src, uint16_t* dst, unsigned count)
+{
+    unsigned i = 0;
+#if UAVCAN_FLOAT16_USE_F16C
+    for (; (i + 4U) <= count; i += 4U)
+    {
+        const __m128i halfs = _mm_cvtps_ph(_mm_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), halfs);
+    }
+#elif UAVCAN_FLOAT16_USE_NEON
+    for (; (i + 4U) <= count; i += 4U)
+    {
+        vst1_u16(dst + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        dst[i] = nativeIeeeToHalf(src[i]);
+    }
+}
+
+void IEEE754Converter::halfArrayToNativeIeee(const uint16_t* src, float* dst, unsigned count)
+{
+    unsigned i = 0;
+#if UAVCAN_FLOAT16_USE_F16C
+    for (; (i + 4U) <= count; i += 4U)
+    {
+        const __m128i halfs = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_ps(dst + i, _mm_cvtph_ps(halfs));
+    }
+#elif UAVCAN_FLOAT16_USE_NEON
+    for (; (i + 4U) <= count; i += 4U)
+    {
+        vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i))));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        dst[i] = halfToNativeIeee(src[i]);
+    }
+}
+
 }
@@ -43,4 +43,61 @@ int ScalarCodec::decodeBytesImpl(uint8_t* const bytes, const unsigned bitlen)
     return read_res;
 }
 
+int ScalarCodec::encodeBitArray(const uint8_t* bytes, unsigned bitlen)
+{
+    UAVCAN_ASSERT(bytes);
+    int res = BitStream::ResultOk;
+    while ((bitlen > 0) && (res > 0))   // The stream limits the length of one operation
+    {
+        const unsigned chunk_bitlen = min(bitlen, BitStream::MaxBitsPerRW);
+        res = stream_.write(bytes, chunk_bitlen);
+        bytes += BitStream::MaxBitsPerRW / 8;
+        bitlen -= chunk_bitlen;
+    }
+    return res;
+}
+
+int ScalarCodec::decodeBitArray(uint8_t* bytes, unsigned bitlen)
+{
+    UAVCAN_ASSERT(bytes);
+    int res = BitStream::ResultOk;
+    while ((bitlen > 0) && (res > 0))
+    {
+        const unsigned chunk_bitlen = min(bitlen, BitStream::MaxBitsPerRW);
+        res = stream_.read(bytes, chunk_bitlen);
+        bytes += BitStream::MaxBitsPerRW / 8;
+        bitlen -= chunk_bitlen;
+    }
+    return res;
+}
+
+int ScalarCodec::encodeBits(uint64_t value, unsigned bitlen)
+{
+    UAVCAN_ASSERT((bitlen > 0) && (bitlen <= 64));
+    uint8_t bytes[8];
+    for (unsigned i = 0; i < sizeof(bytes); i++)   // Little endian regardless of the platform
+    {
+        bytes[i] = uint8_t(value & 0xFFU);
+        value >>= 8;
+    }
+    return encodeBytesImpl(bytes, bitlen);
+}
+
+int ScalarCodec::decodeBits(uint64_t& out_value, unsigned bitlen)
+{
+    UAVCAN_ASSERT((bitlen > 0) && (bitlen <= 64));
+    uint8_t bytes[8] = {};
+    const int read_res = decodeBytesImpl(bytes, bitlen);
+    if (read_res > 0)
+    {
+        uint64_t value = 0;
+        for (unsigned i = sizeof(bytes); i > 0; i--)
+        {
+            value = (value << 8) | bytes[i - 1];
+        }
+        out_value = value;
+    }
+    return read_res;
+}
+
 }
@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/marshal/table_codec.hpp>
+#include <uavcan/marshal/float_spec.hpp>
+
+namespace uavcan
+{
+namespace
+{
+/*
+ * The storage type of the primitive fields is the smallest native type that can hold the value,
+ * same as in @ref IntegerSpec and @ref FloatSpec.
+ */
+uint64_t loadUnsigned(const void* field, unsigned bitlen)
+{
+    if (bitlen <= 8)
+    {
+        return *static_cast<const uint8_t*>(field);
+    }
+    if (bitlen <= 16)
+    {
+        return *static_cast<const uint16_t*>(field);
+    }
+    if (bitlen <= 32)
+    {
+        return *static_cast<const uint32_t*>(field);
+    }
+    return *static_cast<const uint64_t*>(field);
+}
+
+int64_t loadSigned(const void* field, unsigned bitlen)
+{
+    if (bitlen <= 8)
+    {
+        return *static_cast<const int8_t*>(field);
+    }
+    if (bitlen <= 16)
+    {
+        return *static_cast<const int16_t*>(field);
+    }
+    if (bitlen <= 32)
+    {
+        return *static_cast<const int32_t*>(field);
+    }
+    return *static_cast<const int64_t*>(field);
+}
+
+/**
+ * Stores the value truncated to the storage size; the signed types are stored in two's complement.
+ */
+void storeInteger(void* field, unsigned bitlen, uint64_t value)
+{
+    if (bitlen <= 8)
+    {
+        *static_cast<uint8_t*>(field) = uint8_t(value);
+    }
+    else if (bitlen <= 16)
+    {
+        *static_cast<uint16_t*>(field) = uint16_t(value);
+    }
+    else if (bitlen <= 32)
+    {
+        *static_cast<uint32_t*>(field) = uint32_t(value);
+    }
+    else
+    {
+        *static_cast<uint64_t*>(field) = value;
+    }
+}
+
+uint64_t getMask(unsigned bitlen)
+{
+    return (bitlen >= 64) ? 0xFFFFFFFFFFFFFFFFULL : ((uint64_t(1) << bitlen) - 1U);
+}
+
+uint64_t encodeUnsigned(const TableCodecField& entry, const void* field)
+{
+    const uint64_t value = loadUnsigned(field, entry.bitlen);
+    const uint64_t max = getMask(entry.bitlen);
+    if (entry.saturate)
+    {
+        return (value > max) ? max : value;
+    }
+    return value & max;
+}
+
+uint64_t encodeSigned(const TableCodecField& entry, const void* field)
+{
+    int64_t value = loadSigned(field, entry.bitlen);
+    if (entry.saturate && (entry.bitlen < 64))
+    {
+        const int64_t max = int64_t(getMask(entry.bitlen - 1U));
+        const int64_t min = -max - 1;
+        value = (value > max) ? max : ((value < min) ? min : value);
+    }
+    return uint64_t(value) & getMask(entry.bitlen);
+}
+
+uint64_t encodeFloat(const TableCodecField& entry, const void* field)
+{
+    if (entry.bitlen == 16)
+    {
+        float value = *static_cast<const float*>(field);
+        const float max = IEEE754Limits<16>::max();
+        if (isFinite(value) && ((value > max) || (value < -max)))
+        {
+            const bool negative = value < 0;
+            if (entry.saturate)
+            {
+                value = negative ? -max : max;
+            }
+            else
+            {
+                value = negative ? -NumericTraits<float>::infinity() : NumericTraits<float>::infinity();
+            }
+        }
+        return IEEE754Converter::toIeee<16>(value);
+    }
+    if (entry.bitlen == 32)
+    {
+        return IEEE754Converter::toIeee<32>(*static_cast<const float*>(field));
+    }
+    return IEEE754Converter::toIeee<64>(*static_cast<const double*>(field));
+}
+
+void decodeFloat(const TableCodecField& entry, void* field, uint64_t raw)
+{
+    if (entry.bitlen == 16)
+    {
+        *static_cast<float*>(field) = IEEE754Converter::toNative<16>(uint16_t(raw));
+    }
+    else if (entry.bitlen == 32)
+    {
+        *static_cast<float*>(field) = IEEE754Converter::toNative<32>(uint32_t(raw));
+    }
+    else
+    {
+        *static_cast<double*>(field) = IEEE754Converter::toNative<64>(raw);
+    }
+}
+
+TailArrayOptimizationMode getFieldTaoMode(unsigned index, unsigned table_len, TailArrayOptimizationMode tao_mode)
+{
+    return ((index + 1U) == table_len) ? tao_mode : TailArrayOptDisabled;
+}
+
+}
+
+int TableCodec::encode(const TableCodecField* const table, const unsigned table_len, const void* const* fields,
+                       ScalarCodec& codec, const TailArrayOptimizationMode tao_mode)
+{
+    UAVCAN_ASSERT(table != UAVCAN_NULLPTR);
+    for (unsigned i = 0; i < table_len; i++)
+    {
+        const TableCodecField& entry = table[i];
+        if (entry.kind == TableCodecField::KindOther)
+        {
+            const int res = entry.ops->encode(*fields++, codec, getFieldTaoMode(i, table_len, tao_mode));
+            if (res <= 0)
+            {
+                return res;
+            }
+            continue;
+        }
+
+        uint64_t raw = 0;
+        switch (entry.kind)
+        {
+        case TableCodecField::KindBool:
+        {
+            raw = *static_cast<const bool*>(*fields++) ? 1U : 0U;
+            break;
+        }
+        case TableCodecField::KindUnsigned:
+        {
+            raw = encodeUnsigned(entry, *fields++);
+            break;
+        }
+        case TableCodecField::KindSigned:
+        {
+            raw = encodeSigned(entry, *fields++);
+            break;
+        }
+        case TableCodecField::KindFloat:
+        {
+            raw = encodeFloat(entry, *fields++);
+            break;
+        }
+        default:
+        {
+            break;      // Void fields are zero-filled
+        }
+        }
+
+        const int res = codec.encodeBits(raw, entry.bitlen);
+        if (res <= 0)
+        {
+            return res;
+        }
+    }
+    return BitStream::ResultOk;
+}
+
+int TableCodec::decode(const TableCodecField* const table, const unsigned table_len, void* const* fields,
+                       ScalarCodec& codec, const TailArrayOptimizationMode tao_mode)
+{
+    UAVCAN_ASSERT(table != UAVCAN_NULLPTR);
+    for (unsigned i = 0; i < table_len; i++)
+    {
+        const TableCodecField& entry = table[i];
+        if (entry.kind == TableCodecField::KindOther)
+        {
+            const int res = entry.ops->decode(*fields++, codec, getFieldTaoMode(i, table_len, tao_mode));
+            if (res <= 0)
+            {
+                return res;
+            }
+            continue;
+        }
+
+        uint64_t raw = 0;
+        const int res = codec.decodeBits(raw, entry.bitlen);
+        if (res <= 0)
+        {
+            return res;
+        }
+
+        switch (entry.kind)
+        {
+        case TableCodecField::KindBool:
+        {
+            *static_cast<bool*>(*fields++) = raw != 0;
+            break;
+        }
+        case TableCodecField::KindUnsigned:
+        {
+            storeInteger(*fields++, entry.bitlen, raw);
+            break;
+        }
+        case TableCodecField::KindSigned:
+        {
+            const uint64_t sign_bit = uint64_t(1) << (entry.bitlen - 1U);
+            if ((raw & sign_bit) != 0)
+            {
+                raw |= ~getMask(entry.bitlen);
+            }
+            storeInteger(*fields++, entry.bitlen, raw);
+            break;
+        }
+        case TableCodecField::KindFloat:
+        {
+            decodeFloat(entry, *fields++, raw);
+            break;
+        }
+        default:
+        {
+            break;      // Void fields are skipped
+        }
+        }
+    }
+    return BitStream::ResultOk;
+}
+
+unsigned TableCodec::computeEncodedBitLen(const TableCodecField* const table, const unsigned table_len,
+                                          const void* const* fields, const TailArrayOptimizationMode tao_mode)
+{
+    UAVCAN_ASSERT(table != UAVCAN_NULLPTR);
+    unsigned bitlen = 0;
+    for (unsigned i = 0; i < table_len; i++)
+    {
+        const TableCodecField& entry = table[i];
+        if (entry.kind == TableCodecField::KindOther)
+        {
+            bitlen += entry.ops->computeEncodedBitLen(*fields++, getFieldTaoMode(i, table_len, tao_mode));
+        }
+        else
+        {
+            bitlen += entry.bitlen;
+            if (entry.kind != TableCodecField::KindVoid)
+            {
+                fields++;
+            }
+        }
+    }
+    return bitlen;
+}
+
+}
@@ -38,19 +38,126 @@ MonotonicTime GenericPublisherBase::getTxDeadline() const
     return node_.getMonotonicTime() + tx_timeout_;
 }
 
+bool GenericPublisherBase::isRateLimited() const
+{
+    if ((max_bus_load_percent_ > 0) &&
+        (node_.getDispatcher().getCanIOManager().getMaxBusLoadPercent() >= max_bus_load_percent_))
+    {
+        return true;
+    }
+    if (min_publication_interval_.isZero() || last_publication_ts_.isZero())
+    {
+        return false;
+    }
+    return (node_.getMonotonicTime() - last_publication_ts_) < min_publication_interval_;
+}
+
+uint64_t GenericPublisherBase::computePayloadHash(const StaticTransferBufferImpl& buffer,
+                                                  TransferType transfer_type, NodeID dst_node_id) const
+{
+    if (max_silence_interval_.isZero())
+    {
+        return 0;
+    }
+    const uint16_t len = buffer.getMaxWritePos();
+    DataTypeSignatureCRC crc;
+    crc.add(uint8_t(transfer_type));
+    crc.add(dst_node_id.get());
+    crc.add(uint8_t(len & 0xFFU));
+    crc.add(uint8_t(len >> 8));
+    if (len > 0)
+    {
+        crc.add(buffer.getRawPtr(), len);
+    }
+    return crc.get();
+}
+
+bool GenericPublisherBase::isUnchanged(uint64_t payload_hash) const
+{
+    if (max_silence_interval_.isZero() || !last_payload_hash_valid_ || (payload_hash != last_payload_hash_))
+    {
+        return false;
+    }
+    return (node_.getMonotonicTime() - last_publication_ts_) < max_silence_interval_;
+}
+
+void GenericPublisherBase::registerPublication(int send_result, uint64_t payload_hash)
+{
+    if (send_result >= 0)
+    {
+        last_publication_ts_ = node_.getMonotonicTime();
+        last_payload_hash_ = payload_hash;
+        last_payload_hash_valid_ = !max_silence_interval_.isZero();
+    }
+}
+
 int GenericPublisherBase::genericPublish(const StaticTransferBufferImpl& buffer, TransferType transfer_type,
                                          NodeID dst_node_id, TransferID* tid, MonotonicTime blocking_deadline)
 {
+    const uint64_t payload_hash = computePayloadHash(buffer, transfer_type, dst_node_id);
+    if ((tid == UAVCAN_NULLPTR) && isUnchanged(payload_hash))
+    {
+        return 0;
+    }
+
+    int res = 0;
+    if (tid)
+    {
+        res = sender_.send(buffer.getRawPtr(), buffer.getMaxWritePos(), getTxDeadline(),
+                           blocking_deadline, transfer_type, dst_node_id, *tid, force_std_can_);
+    }
+    else
+    {
+        res = sender_.send(buffer.getRawPtr(), buffer.getMaxWritePos(), getTxDeadline(),
+                           blocking_deadline, transfer_type, dst_node_id, force_std_can_);
+    }
+    registerPublication(res, payload_hash);
+    return res;
+}
+
+int GenericPublisherBase::genericPublish(FrameTransferBuffer& buffer, TransferType transfer_type,
+                                         NodeID dst_node_id, TransferID* tid, MonotonicTime blocking_deadline)
+{
+    const uint64_t payload_hash = computePayloadHash(buffer, transfer_type, dst_node_id);
+    if ((tid == UAVCAN_NULLPTR) && isUnchanged(payload_hash))
+    {
+        return 0;
+    }
+
+    int res = 0;
     if (tid)
     {
-        return sender_.send(buffer.getRawPtr(), buffer.getMaxWritePos(), getTxDeadline(),
-                            blocking_deadline, transfer_type, dst_node_id, *tid, force_std_can_);
+        res = sender_.sendInPlace(buffer.getFrame(), buffer.getMaxWritePos(), getTxDeadline(),
+                                  blocking_deadline, transfer_type, dst_node_id, *tid, force_std_can_);
     }
     else
     {
-        return sender_.send(buffer.getRawPtr(), buffer.getMaxWritePos(), getTxDeadline(),
-                            blocking_deadline, transfer_type, dst_node_id, force_std_can_);
+        res = sender_.sendInPlace(buffer.getFrame(), buffer.getMaxWritePos(), getTxDeadline(),
+                                  blocking_deadline, transfer_type, dst_node_id, force_std_can_);
     }
+    registerPublication(res, payload_hash);
+    return res;
+}
+
+int GenericPublisherBase::reserveTxQueueMemory(uint16_t num_blocks)
+{
+    CanIOManager& canio = node_.getDispatcher().getCanIOManager();
+    if (num_blocks > num_reserved_tx_blocks_)
+    {
+        const int res = canio.addTxQueueMinBlocks(unsigned(num_blocks - num_reserved_tx_blocks_));
+        if (res < 0)
+        {
+            UAVCAN_TRACE("GenericPublisher", "Failed to reserve %u TX blocks", unsigned(num_blocks));
+            return res;
+        }
+    }
+    else
+    {
+        canio.removeTxQueueMinBlocks(unsigned(num_reserved_tx_blocks_ - num_blocks));
+    }
+    num_reserved_tx_blocks_ = num_blocks;
+    sender_.setUseGuaranteedTxMemory(num_blocks > 0);
+    return 0;
 }
 
 void GenericPublisherBase::setTxTimeout(MonotonicDuration tx_timeout)
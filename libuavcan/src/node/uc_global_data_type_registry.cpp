@@ -10,6 +10,126 @@
 namespace uavcan
 {
 
+#if UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY > 0
+/*
+ * GlobalDataTypeRegistry::Index
+ */
+unsigned GlobalDataTypeRegistry::Index::hashName(const char* name)
+{
+    uint32_t hash = 2166136261U;                        // FNV-1a
+    for (unsigned i = 0; (i < DataTypeDescriptor::MaxFullNameLen) && (name[i] != '\0'); i++)
+    {
+        hash = (hash ^ uint8_t(name[i])) * 16777619U;
+    }
+    return unsigned(hash % unsigned(HashTableSize));
+}
+
+void GlobalDataTypeRegistry::Index::build(const List& list, const DataTypeDescriptor* table, unsigned table_len)
+{
+    valid_ = false;
+    len_ = 0;
+    fill_n(by_name_, unsigned(HashTableSize), uint16_t(0));
+
+    if ((list.getLength() + table_len) > unsigned(Capacity))
+    {
+        UAVCAN_TRACE("GlobalDataTypeRegistry", "Index overflow, %u data types", list.getLength() + table_len);
+        return;
+    }
+
+    // Both the list and the table are ordered by data type ID already, so they are merged
+    const Entry* p = list.get();
+    unsigned table_pos = 0;
+    while ((p != UAVCAN_NULLPTR) || (table_pos < table_len))
+    {
+        const DataTypeDescriptor* descriptor = UAVCAN_NULLPTR;
+        if ((table_pos >= table_len) ||
+            ((p != UAVCAN_NULLPTR) && (p->descriptor.getID() < table[table_pos].getID())))
+        {
+            descriptor = &p->descriptor;
+            p = p->getNextListNode();
+        }
+        else
+        {
+            descriptor = &table[table_pos++];
+            if (isNameInList(list, descriptor->getFullName()))
+            {
+                continue;                               // Overridden
+            }
+        }
+
+        by_id_[len_] = descriptor;
+        len_++;
+
+        unsigned pos = hashName(descriptor->getFullName());
+        while (by_name_[pos] != 0)
+        {
+            pos = (pos + 1U) % unsigned(HashTableSize);
+        }
+        by_name_[pos] = len_;
+    }
+    valid_ = true;
+}
+
+const DataTypeDescriptor* GlobalDataTypeRegistry::Index::find(DataTypeID dtid) const
+{
+    UAVCAN_ASSERT(valid_);
+    unsigned lo = 0;
+    unsigned hi = len_;
+    while (lo < hi)
+    {
+        const unsigned mid = (lo + hi) / 2U;
+        if (by_id_[mid]->getID() < dtid)
+        {
+            lo = mid + 1U;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    if ((lo < len_) && (by_id_[lo]->getID() == dtid))
+    {
+        return by_id_[lo];
+    }
+    return UAVCAN_NULLPTR;
+}
+
+const DataTypeDescriptor* GlobalDataTypeRegistry::Index::find(const char* name) const
+{
+    UAVCAN_ASSERT(valid_);
+    for (unsigned pos = hashName(name); by_name_[pos] != 0; pos = (pos + 1U) % unsigned(HashTableSize))
+    {
+        const DataTypeDescriptor& descriptor = *by_id_[by_name_[pos] - 1U];
+        if (!std::strncmp(descriptor.getFullName(), name, DataTypeDescriptor::MaxFullNameLen))
+        {
+            return &descriptor;
+        }
+    }
+    return UAVCAN_NULLPTR;
+}
+
+const GlobalDataTypeRegistry::Index* GlobalDataTypeRegistry::selectIndex(DataTypeKind kind) const
+{
+    const Index* const index = (kind == DataTypeKindMessage) ? &msg_index_ : &srv_index_;
+    return index->isValid() ? index : UAVCAN_NULLPTR;
+}
+#endif
+
+/*
+ * GlobalDataTypeRegistry
+ */
+bool GlobalDataTypeRegistry::isNameInList(const List& list, const char* name)
+{
+    for (const Entry* p = list.get(); p != UAVCAN_NULLPTR; p = p->getNextListNode())
+    {
+        if (!std::strncmp(p->descriptor.getFullName(), name, DataTypeDescriptor::MaxFullNameLen))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 GlobalDataTypeRegistry::List* GlobalDataTypeRegistry::selectList(DataTypeKind kind) const
 {
     if (kind == DataTypeKindMessage)
@@ -27,6 +147,67 @@ GlobalDataTypeRegistry::List* GlobalDataTypeRegistry::selectList(DataTypeKind ki
     }
 }
 
+const GlobalDataTypeRegistry::TableRange& GlobalDataTypeRegistry::selectTableRange(DataTypeKind kind) const
+{
+    UAVCAN_ASSERT((kind == DataTypeKindMessage) || (kind == DataTypeKindService));
+    return (kind == DataTypeKindService) ? srv_table_ : msg_table_;
+}
+
+bool GlobalDataTypeRegistry::isOverridden(const DataTypeDescriptor& table_entry) const
+{
+    const List* const list = selectList(table_entry.getKind());
+    return (list != UAVCAN_NULLPTR) && isNameInList(*list, table_entry.getFullName());
+}
+
+const DataTypeDescriptor* GlobalDataTypeRegistry::findInTable(DataTypeKind kind, const char* name) const
+{
+    const TableRange& range = selectTableRange(kind);
+    for (unsigned i = 0; i < range.len; i++)
+    {
+        if (range.begin[i].match(kind, name))
+        {
+            return isOverridden(range.begin[i]) ? UAVCAN_NULLPTR : &range.begin[i];
+        }
+    }
+    return UAVCAN_NULLPTR;
+}
+
+const DataTypeDescriptor* GlobalDataTypeRegistry::findInTable(DataTypeKind kind, DataTypeID dtid) const
+{
+    const TableRange& range = selectTableRange(kind);
+    unsigned lo = 0;
+    unsigned hi = range.len;
+    while (lo < hi)
+    {
+        const unsigned mid = (lo + hi) / 2U;
+        if (range.begin[mid].getID() < dtid)
+        {
+            lo = mid + 1U;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    if ((lo < range.len) && (range.begin[lo].getID() == dtid) && !isOverridden(range.begin[lo]))
+    {
+        return &range.begin[lo];
+    }
+    return UAVCAN_NULLPTR;
+}
+
+unsigned GlobalDataTypeRegistry::getNumTypes(DataTypeKind kind) const
+{
+    const List* const list = selectList(kind);
+    const TableRange& range = selectTableRange(kind);
+    unsigned num = list->getLength();
+    for (unsigned i = 0; i < range.len; i++)
+    {
+        num += isOverridden(range.begin[i]) ? 0U : 1U;
+    }
+    return num;
+}
+
 GlobalDataTypeRegistry::RegistrationResult GlobalDataTypeRegistry::remove(Entry* dtd)
 {
     if (!dtd)
@@ -93,6 +274,23 @@ GlobalDataTypeRegistry::RegistrationResult GlobalDataTypeRegistry::registImpl(En
             p = p->getNextListNode();
         }
     }
+    {   // Collision check against the adopted table, whose entries can be overridden but not removed
+        const TableRange& range = selectTableRange(dtd->descriptor.getKind());
+        for (unsigned i = 0; i < range.len; i++)
+        {
+            const DataTypeDescriptor& entry = range.begin[i];
+            const bool same_name = !std::strncmp(entry.getFullName(), dtd->descriptor.getFullName(),
+                                                 DataTypeDescriptor::MaxFullNameLen);
+            if (same_name && (entry == dtd->descriptor))
+            {
+                return RegistrationResultOk;            // Already there
+            }
+            if (!same_name && (entry.getID() == dtd->descriptor.getID()) && !isOverridden(entry))
+            {
+                return RegistrationResultCollision;
+            }
+        }
+    }
 #if UAVCAN_DEBUG
     const unsigned len_before = list->getLength();
 #endif
@@ -136,11 +334,76 @@ void GlobalDataTypeRegistry::freeze()
     if (!frozen_)
     {
         frozen_ = true;
+#if UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY > 0
+        msg_index_.build(msgs_, msg_table_.begin, msg_table_.len);
+        srv_index_.build(srvs_, srv_table_.begin, srv_table_.len);
+#endif
         UAVCAN_TRACE("GlobalDataTypeRegistry", "Frozen; num msgs: %u, num srvs: %u",
                      getNumMessageTypes(), getNumServiceTypes());
     }
 }
 
+GlobalDataTypeRegistry::RegistrationResult GlobalDataTypeRegistry::adoptTable(const DataTypeDescriptor* table,
+                                                                              unsigned len)
+{
+    if (isFrozen())
+    {
+        return RegistrationResultFrozen;
+    }
+    if ((table == UAVCAN_NULLPTR) || (len == 0) || (len > 0xFFFFU) || hasTable())
+    {
+        return RegistrationResultInvalidParams;
+    }
+
+    // Messages first, then services, each sorted by ID without duplicates
+    unsigned num_msgs = 0;
+    for (unsigned i = 0; i < len; i++)
+    {
+        const DataTypeDescriptor& entry = table[i];
+        if (!entry.isValid())
+        {
+            return RegistrationResultInvalidParams;
+        }
+        if (i > 0)
+        {
+            const DataTypeDescriptor& prev = table[i - 1];
+            const bool kind_order_ok = (prev.getKind() == entry.getKind()) ||
+                                       (prev.getKind() == DataTypeKindMessage);
+            const bool id_order_ok = (prev.getKind() != entry.getKind()) || (prev.getID() < entry.getID());
+            if (!kind_order_ok || !id_order_ok)
+            {
+                return RegistrationResultInvalidParams;
+            }
+        }
+        if (entry.getKind() == DataTypeKindMessage)
+        {
+            num_msgs++;
+        }
+        UAVCAN_ASSERT(entry.getTransferCRCBase().get() == entry.getSignature().toTransferCRC().get());
+    }
+
+    // The types that have been registered already must not collide with the table
+    for (unsigned i = 0; i < len; i++)
+    {
+        const List* const list = selectList(table[i].getKind());
+        for (const Entry* p = list->get(); p != UAVCAN_NULLPTR; p = p->getNextListNode())
+        {
+            if ((p->descriptor.getID() == table[i].getID()) && !isNameInList(*list, table[i].getFullName()))
+            {
+                return RegistrationResultCollision;
+            }
+        }
+    }
+
+    msg_table_.begin = table;
+    msg_table_.len = uint16_t(num_msgs);
+    srv_table_.begin = table + num_msgs;
+    srv_table_.len = uint16_t(len - num_msgs);
+    UAVCAN_TRACE("GlobalDataTypeRegistry", "Table adopted; num msgs: %u, num srvs: %u",
+                 unsigned(msg_table_.len), unsigned(srv_table_.len));
+    return RegistrationResultOk;
+}
+
 const DataTypeDescriptor* GlobalDataTypeRegistry::find(const char* name) const
 {
     const DataTypeDescriptor* desc = find(DataTypeKindMessage, name);
@@ -164,6 +427,13 @@ const DataTypeDescriptor* GlobalDataTypeRegistry::find(DataTypeKind kind, const
         UAVCAN_ASSERT(0);
         return UAVCAN_NULLPTR;
     }
+#if UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY > 0
+    const Index* const index = selectIndex(kind);
+    if (index != UAVCAN_NULLPTR)
+    {
+        return index->find(name);
+    }
+#endif
     Entry* p = list->get();
     while (p)
     {
@@ -173,7 +443,7 @@ const DataTypeDescriptor* GlobalDataTypeRegistry::find(DataTypeKind kind, const
         }
         p = p->getNextListNode();
     }
-    return UAVCAN_NULLPTR;
+    return findInTable(kind, name);
 }
 
 const DataTypeDescriptor* GlobalDataTypeRegistry::find(DataTypeKind kind, DataTypeID dtid) const
@@ -184,6 +454,13 @@ const DataTypeDescriptor* GlobalDataTypeRegistry::find(DataTypeKind kind, DataTy
         UAVCAN_ASSERT(0);
         return UAVCAN_NULLPTR;
     }
+#if UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY > 0
+    const Index* const index = selectIndex(kind);
+    if (index != UAVCAN_NULLPTR)
+    {
+        return index->find(dtid);
+    }
+#endif
     Entry* p = list->get();
     while (p)
     {
@@ -193,7 +470,7 @@ const DataTypeDescriptor* GlobalDataTypeRegistry::find(DataTypeKind kind, DataTy
         }
         p = p->getNextListNode();
     }
-    return UAVCAN_NULLPTR;
+    return findInTable(kind, dtid);
 }
 
 }
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/node/handler_profiler.hpp>
+
+#if UAVCAN_HANDLER_PROFILING
+
+namespace uavcan
+{
+/*
+ * HandlerProfile
+ */
+HandlerProfile::HandlerProfile(HandlerProfiler& profiler, Kind kind, const char* name)
+    : profiler_(profiler)
+    , name_(name)
+    , total_ticks_(0)
+    , num_invocations_(0)
+    , max_ticks_(0)
+    , max_stack_usage_(0)
+    , kind_(kind)
+{
+    profiler_.profiles_.insert(this);
+}
+
+HandlerProfile::~HandlerProfile()
+{
+    if (profiler_.active_ == this)
+    {
+        profiler_.active_ = UAVCAN_NULLPTR;     // Destroyed from its own handler
+    }
+    profiler_.profiles_.remove(this);
+}
+
+void HandlerProfile::account(uint32_t ticks, uint32_t stack_usage)
+{
+    num_invocations_++;
+    total_ticks_ += ticks;
+    max_ticks_ = max(max_ticks_, ticks);
+    max_stack_usage_ = max(max_stack_usage_, stack_usage);
+}
+
+void HandlerProfile::reset()
+{
+    total_ticks_ = 0;
+    num_invocations_ = 0;
+    max_ticks_ = 0;
+    max_stack_usage_ = 0;
+}
+
+/*
+ * HandlerProfiler
+ */
+uint32_t HandlerProfiler::readTicks() const
+{
+    return (hooks_ != UAVCAN_NULLPTR) ? hooks_->readTicks() : uint32_t(sysclock_.getMonotonic().toUSec());
+}
+
+const HandlerProfile* HandlerProfiler::findSlowest() const
+{
+    const HandlerProfile* slowest = UAVCAN_NULLPTR;
+    for (const HandlerProfile* p = profiles_.get(); p != UAVCAN_NULLPTR; p = p->getNextListNode())
+    {
+        if (p->getNumInvocations() == 0)
+        {
+            continue;
+        }
+        if ((slowest == UAVCAN_NULLPTR) || (p->getMaxTicks() > slowest->getMaxTicks()))
+        {
+            slowest = p;
+        }
+    }
+    return slowest;
+}
+
+void HandlerProfiler::resetAll()
+{
+    for (HandlerProfile* p = profiles_.get(); p != UAVCAN_NULLPTR; p = p->getNextListNode())
+    {
+        p->reset();
+    }
+}
+
+/*
+ * HandlerProfilingScope
+ */
+HandlerProfilingScope::~HandlerProfilingScope()
+{
+    const uint32_t ticks = profiler_.readTicks() - started_at_;
+    HandlerProfile* const profile = profiler_.active_;
+    profiler_.active_ = outer_;
+    if (profile != UAVCAN_NULLPTR)
+    {
+        profile->account(ticks, (profiler_.hooks_ != UAVCAN_NULLPTR) ? profiler_.hooks_->sampleStackUsage() : 0);
+    }
+}
+
+}
+
+#endif
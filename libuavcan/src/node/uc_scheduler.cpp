@@ -11,12 +11,36 @@ namespace uavcan
 /*
  * MonotonicDeadlineHandler
  */
+DeadlineHandler::DeadlineHandler(Scheduler& scheduler)
+#if UAVCAN_SCHEDULER_TIMER_WHEEL
+    : slot_(UAVCAN_NULLPTR)
+# if UAVCAN_HANDLER_PROFILING
+    , handler_profile_(scheduler.getHandlerProfiler(), HandlerProfile::KindDeadlineHandler)
+# endif
+    , scheduler_(scheduler)
+#elif UAVCAN_HANDLER_PROFILING
+    : handler_profile_(scheduler.getHandlerProfiler(), HandlerProfile::KindDeadlineHandler)
+    , scheduler_(scheduler)
+#else
+    : scheduler_(scheduler)
+#endif
+{ }
+
+void DeadlineHandler::invokeHandler(MonotonicTime current)
+{
+#if UAVCAN_HANDLER_PROFILING
+    const HandlerProfilingScope profiling_scope(handler_profile_);
+#endif
+    handleDeadline(current);   // This handler may be destroyed or re-registered from the callback
+}
+
 void DeadlineHandler::startWithDeadline(MonotonicTime deadline)
 {
     UAVCAN_ASSERT(!deadline.isZero());
     stop();
     deadline_ = deadline;
     scheduler_.getDeadlineScheduler().add(this);
+    scheduler_.handleDeadlineHandlerStart(deadline + slack_);
 }
 
 void DeadlineHandler::startWithDelay(MonotonicDuration delay)
@@ -34,9 +58,257 @@ bool DeadlineHandler::isRunning() const
     return scheduler_.getDeadlineScheduler().doesExist(this);
 }
 
+void DeadlineHandler::setSlack(MonotonicDuration slack)
+{
+    slack = max(slack, MonotonicDuration());
+    if (isRunning())
+    {
+        stop();                         // The scheduler keeps track of the handlers with slack
+        slack_ = slack;
+        startWithDeadline(deadline_);
+    }
+    else
+    {
+        slack_ = slack;
+    }
+}
+
 /*
  * MonotonicDeadlineScheduler
  */
+#if UAVCAN_SCHEDULER_TIMER_WHEEL
+
+DeadlineHandler* DeadlineScheduler::findEarliest(const Slot& slot)
+{
+    DeadlineHandler* earliest = slot.get();
+    for (DeadlineHandler* p = earliest; p != UAVCAN_NULLPTR; p = p->getNextListNode())
+    {
+        if (p->deadline_ < earliest->deadline_)
+        {
+            earliest = p;
+        }
+    }
+    return earliest;
+}
+
+void DeadlineScheduler::place(DeadlineHandler* mdh)
+{
+    const uint64_t MaxDelta = (uint64_t(1) << (LevelBits * NumLevels)) - 1U;
+
+    // Overdue handlers go to the current slot, the ones beyond the last level are kept in its farthest slot
+    const uint64_t tick = getTickOf(mdh->deadline_);
+    const uint64_t delta = min((tick > current_tick_) ? (tick - current_tick_) : 0U, MaxDelta);
+
+    unsigned level = 0;
+    while ((level + 1U < NumLevels) && (delta >= (uint64_t(1) << (LevelBits * (level + 1U)))))
+    {
+        level++;
+    }
+
+    const unsigned index = unsigned((current_tick_ + delta) >> (LevelBits * level)) & (SlotsPerLevel - 1U);
+    Slot& slot = slots_[level][index];
+    slot.pushBack(mdh);
+    mdh->slot_ = &slot;
+}
+
+void DeadlineScheduler::cascade(unsigned level)
+{
+    const unsigned index = unsigned(current_tick_ >> (LevelBits * level)) & (SlotsPerLevel - 1U);
+    Slot& slot = slots_[level][index];
+
+    Slot pending;                       // The slot can't be reused until it's empty
+    while (DeadlineHandler* const mdh = slot.get())
+    {
+        slot.remove(mdh);
+        pending.pushBack(mdh);
+    }
+    while (DeadlineHandler* const mdh = pending.get())
+    {
+        pending.remove(mdh);
+        place(mdh);
+    }
+}
+
+void DeadlineScheduler::jumpTo(uint64_t tick)
+{
+    Slot pending;
+    for (unsigned level = 0; level < NumLevels; level++)
+    {
+        for (unsigned index = 0; index < SlotsPerLevel; index++)
+        {
+            while (DeadlineHandler* const mdh = slots_[level][index].get())
+            {
+                slots_[level][index].remove(mdh);
+                pending.pushBack(mdh);
+            }
+        }
+    }
+
+    current_tick_ = tick;
+
+    while (DeadlineHandler* const mdh = pending.get())
+    {
+        pending.remove(mdh);
+        place(mdh);
+    }
+}
+
+DeadlineHandler* DeadlineScheduler::popDue(MonotonicTime ts)
+{
+    const uint64_t now_tick = getTickOf(ts);
+    while (true)
+    {
+        Slot& slot = slots_[0][unsigned(current_tick_) & (SlotsPerLevel - 1U)];
+        DeadlineHandler* const mdh = findEarliest(slot);
+        if ((mdh != UAVCAN_NULLPTR) && (mdh->deadline_ <= ts))
+        {
+            remove(mdh);
+            return mdh;
+        }
+
+        // Every handler of a past tick is due, hence the current slot is empty unless we've reached the present
+        if (current_tick_ >= now_tick)
+        {
+            return UAVCAN_NULLPTR;
+        }
+        UAVCAN_ASSERT(slot.isEmpty());
+
+        if (num_handlers_ == 0)
+        {
+            current_tick_ = now_tick;
+        }
+        else if ((now_tick - current_tick_) > uint64_t(NumLevels * SlotsPerLevel))
+        {
+            jumpTo(now_tick);           // Cheaper than going through every tick in between
+        }
+        else
+        {
+            current_tick_++;
+            for (unsigned level = 1; level < NumLevels; level++)
+            {
+                if ((current_tick_ & ((uint64_t(1) << (LevelBits * level)) - 1U)) != 0)
+                {
+                    break;
+                }
+                cascade(level);
+            }
+        }
+    }
+}
+
+void DeadlineScheduler::add(DeadlineHandler* mdh)
+{
+    UAVCAN_ASSERT(mdh);
+    remove(mdh);
+    if (num_handlers_ == 0)             // Nothing to process in between, so the wheel can be moved to the present
+    {
+        current_tick_ = max(current_tick_, getTickOf(mdh->getScheduler().getMonotonicTime()));
+    }
+    place(mdh);
+    num_handlers_++;
+    if (mdh->slack_.isPositive())
+    {
+        num_slack_handlers_++;
+    }
+}
+
+void DeadlineScheduler::remove(DeadlineHandler* mdh)
+{
+    UAVCAN_ASSERT(mdh);
+    if (mdh->slot_ != UAVCAN_NULLPTR)
+    {
+        mdh->slot_->remove(mdh);
+        mdh->slot_ = UAVCAN_NULLPTR;
+        UAVCAN_ASSERT(num_handlers_ > 0);
+        num_handlers_--;
+        if (mdh->slack_.isPositive())
+        {
+            UAVCAN_ASSERT(num_slack_handlers_ > 0);
+            num_slack_handlers_--;
+        }
+    }
+}
+
+bool DeadlineScheduler::doesExist(const DeadlineHandler* mdh) const
+{
+    UAVCAN_ASSERT(mdh);
+    return mdh->slot_ != UAVCAN_NULLPTR;
+}
+
+MonotonicTime DeadlineScheduler::pollAndGetMonotonicTime(ISystemClock& sysclock, unsigned max_handlers)
+{
+    while (true)
+    {
+        const MonotonicTime ts = sysclock.getMonotonic();
+        DeadlineHandler* const mdh = (max_handlers > 0) ? popDue(ts) : UAVCAN_NULLPTR;
+        if (!mdh)
+        {
+            return ts;
+        }
+        max_handlers--;
+        mdh->invokeHandler(ts);    // This handler can be re-registered immediately
+    }
+    UAVCAN_ASSERT(0);
+    return MonotonicTime();
+}
+
+MonotonicTime DeadlineScheduler::getEarliestDeadline() const
+{
+    MonotonicTime earliest = MonotonicTime::getMax();
+    if (num_handlers_ == 0)
+    {
+        return earliest;
+    }
+
+    /*
+     * Within a level, the slots are ordered by time starting from the current position; the current slot of the
+     * upper levels has been cascaded already and can only hold handlers of the next revolution, so it goes last.
+     * The last level can also hold the handlers beyond its range in any slot, so it's searched completely.
+     */
+    for (unsigned level = 0; level < NumLevels; level++)
+    {
+        const unsigned first = (unsigned(current_tick_ >> (LevelBits * level)) + ((level > 0) ? 1U : 0U)) &
+                               (SlotsPerLevel - 1U);
+        for (unsigned i = 0; i < SlotsPerLevel; i++)
+        {
+            const DeadlineHandler* const mdh = findEarliest(slots_[level][(first + i) & (SlotsPerLevel - 1U)]);
+            if (mdh != UAVCAN_NULLPTR)
+            {
+                earliest = min(earliest, mdh->deadline_);
+                if (level + 1U < NumLevels)
+                {
+                    break;
+                }
+            }
+        }
+    }
+    return earliest;
+}
+
+MonotonicTime DeadlineScheduler::getEarliestWakeup() const
+{
+    if (num_slack_handlers_ == 0)
+    {
+        return getEarliestDeadline();
+    }
+
+    // The slack breaks the ordering of the slots, so all of them have to be checked
+    MonotonicTime earliest = MonotonicTime::getMax();
+    for (unsigned level = 0; level < NumLevels; level++)
+    {
+        for (unsigned index = 0; index < SlotsPerLevel; index++)
+        {
+            for (const DeadlineHandler* p = slots_[level][index].get(); p != UAVCAN_NULLPTR; p = p->getNextListNode())
+            {
+                earliest = min(earliest, p->deadline_ + p->slack_);
+            }
+        }
+    }
+    return earliest;
+}
+
+#else
+
 struct MonotonicDeadlineHandlerInsertionComparator
 {
     const MonotonicTime ts;
@@ -84,12 +356,12 @@ bool DeadlineScheduler::doesExist(const DeadlineHandler* mdh) const
     return false;
 }
 
-MonotonicTime DeadlineScheduler::pollAndGetMonotonicTime(ISystemClock& sysclock)
+MonotonicTime DeadlineScheduler::pollAndGetMonotonicTime(ISystemClock& sysclock, unsigned max_handlers)
 {
     while (true)
     {
         DeadlineHandler* const mdh = handlers_.get();
-        if (!mdh)
+        if (!mdh || (max_handlers == 0))
         {
             return sysclock.getMonotonic();
         }
@@ -107,7 +379,8 @@ MonotonicTime DeadlineScheduler::pollAndGetMonotonicTime(ISystemClock& sysclock)
         }
 
         handlers_.remove(mdh);
-        mdh->handleDeadline(ts);   // This handler can be re-registered immediately
+        max_handlers--;
+        mdh->invokeHandler(ts);    // This handler can be re-registered immediately
     }
     UAVCAN_ASSERT(0);
     return MonotonicTime();
@@ -123,32 +396,172 @@ MonotonicTime DeadlineScheduler::getEarliestDeadline() const
     return MonotonicTime::getMax();
 }
 
+MonotonicTime DeadlineScheduler::getEarliestWakeup() const
+{
+    // The list is ordered by deadline, and the slack is never negative, so the search stops early
+    MonotonicTime earliest = MonotonicTime::getMax();
+    for (const DeadlineHandler* p = handlers_.get(); p != UAVCAN_NULLPTR; p = p->getNextListNode())
+    {
+        if (p->getDeadline() >= earliest)
+        {
+            break;
+        }
+        earliest = min(earliest, p->getDeadline() + p->getSlack());
+    }
+    return earliest;
+}
+
+#endif
+
+MonotonicTime DeadlineScheduler::pollAndGetMonotonicTime(ISystemClock& sysclock)
+{
+    return pollAndGetMonotonicTime(sysclock, NumericTraits<unsigned>::max());
+}
+
+/*
+ * PeriodicPhaseAllocator
+ */
+uint8_t PeriodicPhaseAllocator::reverseBinIndex(uint8_t index)
+{
+    uint8_t out = 0;
+    for (unsigned i = 1; i < NumBins; i <<= 1)
+    {
+        out = uint8_t((unsigned(out) << 1) | (index & 1U));
+        index = uint8_t(index >> 1);
+    }
+    return out;
+}
+
+uint8_t PeriodicPhaseAllocator::allocate(uint16_t weight)
+{
+    uint8_t best = 0;
+    for (unsigned i = 1; i < NumBins; i++)
+    {
+        const uint8_t bin = reverseBinIndex(uint8_t(i));
+        if (loads_[bin] < loads_[best])
+        {
+            best = bin;
+        }
+    }
+    loads_[best] += weight;
+    return best;
+}
+
+void PeriodicPhaseAllocator::release(uint8_t bin, uint16_t weight)
+{
+    if (bin < NumBins)
+    {
+        UAVCAN_ASSERT(loads_[bin] >= weight);
+        loads_[bin] = (loads_[bin] > weight) ? (loads_[bin] - weight) : 0U;
+    }
+    else
+    {
+        UAVCAN_ASSERT(0);
+    }
+}
+
 /*
  * Scheduler
  */
-MonotonicTime Scheduler::computeDispatcherSpinDeadline(MonotonicTime spin_deadline) const
+MonotonicTime Scheduler::computeDispatcherSpinDeadline(MonotonicTime spin_deadline, MonotonicTime current) const
 {
-    const MonotonicTime earliest = min(deadline_scheduler_.getEarliestDeadline(), spin_deadline);
-    const MonotonicTime ts = getMonotonicTime();
-    if (earliest > ts)
+    const MonotonicTime earliest = min(deadline_scheduler_.getEarliestWakeup(), spin_deadline);
+    if (event_driven_)
+    {
+        const MonotonicTime dl = min(earliest, prev_cleanup_ts_ + getCleanupSlicePeriod());
+        // The executor can't wake the driver up, so the completions of the pending tasks are polled
+        return (num_pending_tasks_ > 0) ? min(dl, current + deadline_resolution_) : dl;
+    }
+
+    if (earliest > current)
     {
-        if (earliest - ts > deadline_resolution_)
+        if (earliest - current > deadline_resolution_)
         {
-            return ts + deadline_resolution_;
+            return current + deadline_resolution_;
         }
     }
     return earliest;
 }
 
+MonotonicDuration Scheduler::getCleanupSlicePeriod() const
+{
+    return MonotonicDuration::fromUSec(cleanup_period_.toUSec() / UAVCAN_SCHEDULER_CLEANUP_SLICES);
+}
+
+void Scheduler::handleDeadlineHandlerStart(MonotonicTime deadline)
+{
+    if (event_driven_)
+    {
+        dispatcher_.limitSpinDeadline(deadline);
+    }
+}
+
+void Scheduler::pollPoolWatermarks(MonotonicTime mono_ts)
+{
+    if (pool_high_watermark_ == 0)
+    {
+        return;
+    }
+    const uint16_t used = allocator_.getNumUsedBlocks();
+    if (!pool_pressure_ && (used >= pool_high_watermark_))
+    {
+        UAVCAN_TRACE("Scheduler", "Pool usage %u reached the high watermark, cleaning up", unsigned(used));
+        pool_pressure_ = true;
+        num_pool_pressure_events_++;
+        prev_cleanup_ts_ = mono_ts;
+        dispatcher_.cleanup(mono_ts, 0, 1);
+        if (pool_pressure_listener_ != UAVCAN_NULLPTR)
+        {
+            pool_pressure_listener_->handlePoolPressure(true);
+        }
+    }
+    else if (pool_pressure_ && (used <= pool_low_watermark_))
+    {
+        UAVCAN_TRACE("Scheduler", "Pool usage %u dropped to the low watermark", unsigned(used));
+        pool_pressure_ = false;
+        if (pool_pressure_listener_ != UAVCAN_NULLPTR)
+        {
+            pool_pressure_listener_->handlePoolPressure(false);
+        }
+    }
+}
+
 void Scheduler::pollCleanup(MonotonicTime mono_ts, uint32_t num_frames_processed_with_last_spin)
 {
-    // cleanup will be performed less frequently if the stack handles more frames per second
-    const MonotonicTime deadline = prev_cleanup_ts_ + cleanup_period_ * (num_frames_processed_with_last_spin + 1);
-    if (mono_ts > deadline)
+    pollPoolWatermarks(mono_ts);
+
+    // cleanup will be performed less frequently if the stack handles more frames per second, unless memory is scarce
+    if (pool_pressure_)
+    {
+        num_frames_processed_with_last_spin = 0;
+    }
+    const MonotonicTime deadline =
+        prev_cleanup_ts_ + getCleanupSlicePeriod() * (num_frames_processed_with_last_spin + 1);
+    if (mono_ts >= deadline)
     {
         //UAVCAN_TRACE("Scheduler", "Cleanup with %u processed frames", num_frames_processed_with_last_spin);
         prev_cleanup_ts_ = mono_ts;
-        dispatcher_.cleanup(mono_ts);
+        dispatcher_.cleanup(mono_ts, cleanup_slice_, UAVCAN_SCHEDULER_CLEANUP_SLICES);
+        cleanup_slice_ = uint8_t((cleanup_slice_ + 1U) % UAVCAN_SCHEDULER_CLEANUP_SLICES);
+    }
+}
+
+void Scheduler::pollExecutor()
+{
+    // The completion handlers may post new tasks, those are left for the next iteration
+    unsigned budget = num_pending_tasks_;
+    while (budget > 0)
+    {
+        budget--;
+        ExecutorTask* const task = executor_->popCompleted();
+        if (task == UAVCAN_NULLPTR)
+        {
+            break;
+        }
+        UAVCAN_ASSERT(task->pending_ && (num_pending_tasks_ > 0));
+        task->pending_ = false;
+        num_pending_tasks_--;
+        task->handleCompletion();       // The task may be destroyed or posted again from the handler
     }
 }
 
@@ -163,17 +576,20 @@ int Scheduler::spin(MonotonicTime deadline)
     UAVCAN_ASSERT(inside_spin_);
 
     int retval = 0;
+    MonotonicTime ts = getMonotonicTime();
     while (true)
     {
-        const MonotonicTime dl = computeDispatcherSpinDeadline(deadline);
+        const MonotonicTime dl = computeDispatcherSpinDeadline(deadline, ts);
         retval = dispatcher_.spin(dl);
         if (retval < 0)
         {
             break;
         }
 
-        const MonotonicTime ts = deadline_scheduler_.pollAndGetMonotonicTime(getSystemClock());
+        // Reused by the next iteration; the clock is read only once per iteration
+        ts = deadline_scheduler_.pollAndGetMonotonicTime(getSystemClock());
         pollCleanup(ts, unsigned(retval));
+        pollExecutor();
         if (ts >= deadline)
         {
             break;
@@ -183,6 +599,44 @@ int Scheduler::spin(MonotonicTime deadline)
     return retval;
 }
 
+int Scheduler::spin(MonotonicTime deadline, const SpinBudget& budget)
+{
+    if (inside_spin_)  // Preventing recursive calls
+    {
+        UAVCAN_ASSERT(0);
+        return -ErrRecursiveCall;
+    }
+    InsideSpinSetter iss(*this);
+    UAVCAN_ASSERT(inside_spin_);
+
+    int num_frames_processed = 0;
+    MonotonicTime ts = getMonotonicTime();
+    while (true)
+    {
+        MonotonicTime dl = computeDispatcherSpinDeadline(deadline, ts);
+        if ((dl > ts) && ((dl - ts) > budget.max_rx_duration))
+        {
+            dl = ts + budget.max_rx_duration;
+        }
+        const int res = dispatcher_.spin(dl, budget.max_frames);
+        if (res < 0)
+        {
+            return res;
+        }
+        num_frames_processed += res;
+
+        ts = deadline_scheduler_.pollAndGetMonotonicTime(getSystemClock(), budget.max_deadline_handlers);
+        pollCleanup(ts, 0);
+        pollExecutor();
+        if (ts >= deadline)
+        {
+            break;
+        }
+    }
+
+    return num_frames_processed;
+}
+
 int Scheduler::spinOnce()
 {
     if (inside_spin_)  // Preventing recursive calls
@@ -201,8 +655,53 @@ int Scheduler::spinOnce()
 
     const MonotonicTime ts = deadline_scheduler_.pollAndGetMonotonicTime(getSystemClock());
     pollCleanup(ts, unsigned(retval));
+    pollExecutor();
 
     return retval;
 }
 
+MonotonicTime Scheduler::getNextDeadline() const
+{
+    const MonotonicTime dl = min(deadline_scheduler_.getEarliestWakeup(), prev_cleanup_ts_ + getCleanupSlicePeriod());
+    return (num_pending_tasks_ > 0) ? min(dl, getMonotonicTime() + deadline_resolution_) : dl;
+}
+
+int Scheduler::processReady(MonotonicTime& out_next_deadline)
+{
+    const int res = spinOnce();
+    out_next_deadline = getNextDeadline();
+    return res;
+}
+
+int Scheduler::post(ExecutorTask& task)
+{
+    if (task.pending_)
+    {
+        UAVCAN_ASSERT(0);
+        return -ErrLogic;
+    }
+    task.pending_ = true;
+    num_pending_tasks_++;
+    const int res = executor_->post(task);
+    if (res < 0)
+    {
+        task.pending_ = false;
+        num_pending_tasks_--;
+        return res;
+    }
+    // Posted from a callback in the event driven mode, the dispatcher must not keep blocking until the next deadline
+    handleDeadlineHandlerStart(getMonotonicTime() + deadline_resolution_);
+    return res;
+}
+
+int Scheduler::setExecutor(IExecutor* executor)
+{
+    if (num_pending_tasks_ > 0)
+    {
+        return -ErrLogic;
+    }
+    executor_ = (executor == UAVCAN_NULLPTR) ? &inline_executor_ : executor;
+    return 0;
+}
+
 }
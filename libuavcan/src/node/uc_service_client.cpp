@@ -7,27 +7,232 @@
 namespace uavcan
 {
 /*
- * ServiceClientBase::CallState
+ * ServiceClientBase
  */
-void ServiceClientBase::CallState::handleDeadline(MonotonicTime)
+#if UAVCAN_SERVICE_CLIENT_CALL_INDEX_CAPACITY > 0
+
+unsigned ServiceClientBase::computeCallIndexSlot(ServiceCallID call_id)
+{
+    const uint32_t key = uint32_t(call_id.server_node_id.get()) | (uint32_t(call_id.transfer_id.get()) << 8);
+    return unsigned(((key * 2654435769U) >> 16) % unsigned(CallIndexCapacity));
+}
+
+void ServiceClientBase::addIndexedCall(CallState& state)
+{
+    if (call_index_overflow_ || (call_index_size_ >= unsigned(CallIndexMaxSize)))
+    {
+        UAVCAN_TRACE("ServiceClient", "Call index overflow, falling back to the linear search");
+        call_index_overflow_ = true;
+        return;
+    }
+    unsigned slot = computeCallIndexSlot(state.id_);
+    while (call_index_[slot] != UAVCAN_NULLPTR)
+    {
+        slot = (slot + 1U) % unsigned(CallIndexCapacity);
+    }
+    call_index_[slot] = &state;
+    call_index_size_++;
+}
+
+void ServiceClientBase::removeIndexedCall(const CallState& state)
 {
-    UAVCAN_TRACE("ServiceClient::CallState", "Timeout from nid=%d, tid=%d, dtname=%s",
-                 int(id_.server_node_id.get()), int(id_.transfer_id.get()),
-                 (owner_.data_type_descriptor_ == UAVCAN_NULLPTR) ? "???" : owner_.data_type_descriptor_->getFullName());
+    unsigned slot = computeCallIndexSlot(state.id_);
+    while (call_index_[slot] != &state)
+    {
+        if (call_index_[slot] == UAVCAN_NULLPTR)
+        {
+            return;                     // Was not indexed
+        }
+        slot = (slot + 1U) % unsigned(CallIndexCapacity);
+    }
+    UAVCAN_ASSERT(call_index_size_ > 0);
+    call_index_size_--;
     /*
-     * What we're doing here is relaying execution from this call stack to a different one.
-     * We need it because call registry cannot release memory from this callback, because this will destroy the
-     * object method of which we're executing now.
+     * Backward shift deletion: the entries that follow the freed slot in the same probe run are moved back,
+     * unless that would place them before their home slot. This keeps the lookups free of tombstones.
      */
-    UAVCAN_ASSERT(timed_out_ == false);
-    timed_out_ = true;
-    owner_.generateDeadlineImmediately();
-    UAVCAN_TRACE("ServiceClient::CallState", "Relaying execution to the owner's handler via timer callback");
+    unsigned hole = slot;
+    for (;;)
+    {
+        slot = (slot + 1U) % unsigned(CallIndexCapacity);
+        CallState* const entry = call_index_[slot];
+        if (entry == UAVCAN_NULLPTR)
+        {
+            break;
+        }
+        const unsigned home = computeCallIndexSlot(entry->id_);
+        const unsigned entry_distance = (slot + unsigned(CallIndexCapacity) - home) % unsigned(CallIndexCapacity);
+        const unsigned hole_distance = (slot + unsigned(CallIndexCapacity) - hole) % unsigned(CallIndexCapacity);
+        if (entry_distance >= hole_distance)
+        {
+            call_index_[hole] = entry;
+            hole = slot;
+        }
+    }
+    call_index_[hole] = UAVCAN_NULLPTR;
+}
+
+#endif
+
+const ServiceClientBase::CallState* ServiceClientBase::findIndexedCall(ServiceCallID call_id) const
+{
+#if UAVCAN_SERVICE_CLIENT_CALL_INDEX_CAPACITY > 0
+    UAVCAN_ASSERT(!call_index_overflow_);
+    unsigned slot = computeCallIndexSlot(call_id);
+    while (const CallState* const entry = call_index_[slot])
+    {
+        if (entry->id_ == call_id)
+        {
+            UAVCAN_ASSERT(!entry->timed_out_);
+            return entry;
+        }
+        slot = (slot + 1U) % unsigned(CallIndexCapacity);
+    }
+#else
+    (void)call_id;
+    UAVCAN_ASSERT(0);
+#endif
+    return UAVCAN_NULLPTR;
+}
+
+void ServiceClientBase::registerCall(CallState& state)
+{
+    /*
+     * The calls to a server normally share the same timeout, so the new call goes to the end of the list
+     * in constant time, or close to it.
+     */
+    CallState* prev = calls_by_deadline_.getTail();
+    while ((prev != UAVCAN_NULLPTR) && (prev->deadline_ > state.deadline_))
+    {
+        prev = prev->getPrevListNode();
+    }
+    calls_by_deadline_.insertAfter(&state, prev);
+    if (prev == UAVCAN_NULLPTR)
+    {
+        DeadlineHandler::startWithDeadline(state.deadline_);
+    }
+#if UAVCAN_SERVICE_CLIENT_CALL_INDEX_CAPACITY > 0
+    addIndexedCall(state);
+#endif
+}
+
+void ServiceClientBase::unregisterCall(CallState& state)
+{
+    if (!state.timed_out_)
+    {
+        const bool was_earliest = calls_by_deadline_.get() == &state;
+        removeFromDeadlineOrder(state);
+        if (was_earliest)
+        {
+            scheduleNextTimeout();
+        }
+    }
+}
+
+void ServiceClientBase::removeFromDeadlineOrder(CallState& state)
+{
+    calls_by_deadline_.remove(&state);
+#if UAVCAN_SERVICE_CLIENT_CALL_INDEX_CAPACITY > 0
+    removeIndexedCall(state);
+    if (calls_by_deadline_.isEmpty())
+    {
+        UAVCAN_ASSERT(call_index_size_ == 0);
+        call_index_overflow_ = false;   // All remaining calls are known to be indexed again
+    }
+#endif
+}
+
+const ServiceClientBase::CallState* ServiceClientBase::popTimedOutCall(MonotonicTime current)
+{
+    CallState* const state = calls_by_deadline_.get();
+    if ((state == UAVCAN_NULLPTR) || (state->deadline_ > current))
+    {
+        return UAVCAN_NULLPTR;
+    }
+    removeFromDeadlineOrder(*state);
+    state->timed_out_ = true;
+
+    RttEstimate& rtt = rtt_table_[state->id_.server_node_id.get() % unsigned(RttTableSize)];
+    if ((rtt.server_node_id == state->id_.server_node_id.get()) && (rtt.backoff < unsigned(MaxRttBackoff)))
+    {
+        rtt.backoff++;
+    }
+    return state;
+}
+
+void ServiceClientBase::scheduleNextTimeout()
+{
+    const CallState* const state = calls_by_deadline_.get();
+    if (state == UAVCAN_NULLPTR)
+    {
+        DeadlineHandler::stop();
+    }
+    else
+    {
+        DeadlineHandler::startWithDeadline(state->deadline_);
+    }
+}
+
+const ServiceClientBase::RttEstimate* ServiceClientBase::findRttEstimate(NodeID server_node_id) const
+{
+    const RttEstimate& rtt = rtt_table_[server_node_id.get() % unsigned(RttTableSize)];
+    return ((rtt.server_node_id == server_node_id.get()) && (rtt.srtt_usec > 0)) ? &rtt : UAVCAN_NULLPTR;
+}
+
+void ServiceClientBase::registerResponse(const CallState& state, MonotonicTime response_ts)
+{
+    const NodeID server_node_id = state.id_.server_node_id;
+    const MonotonicDuration sample = response_ts - state.started_at_;
+    if (!server_node_id.isUnicast() || !sample.isPositive())
+    {
+        return;                         // Timestamps from different clocks, or the call was made too recently
+    }
+    const uint32_t rtt_usec = uint32_t(min(sample.toUSec(), int64_t(getMaxRequestTimeout().toUSec())));
+
+    RttEstimate& rtt = rtt_table_[server_node_id.get() % unsigned(RttTableSize)];
+    if (rtt.server_node_id != server_node_id.get())
+    {
+        rtt = RttEstimate();
+        rtt.server_node_id = server_node_id.get();
+    }
+
+    if (rtt.srtt_usec == 0)
+    {
+        rtt.srtt_usec = rtt_usec;
+        rtt.rttvar_usec = rtt_usec / 2U;
+    }
+    else
+    {
+        const uint32_t delta = (rtt.srtt_usec > rtt_usec) ? (rtt.srtt_usec - rtt_usec) : (rtt_usec - rtt.srtt_usec);
+        rtt.rttvar_usec = uint32_t((uint64_t(rtt.rttvar_usec) * 3U + delta) / 4U);
+        rtt.srtt_usec = uint32_t((uint64_t(rtt.srtt_usec) * 7U + rtt_usec) / 8U);
+    }
+    rtt.srtt_usec = max(rtt.srtt_usec, uint32_t(1));
+    rtt.backoff = 0;
+}
+
+MonotonicDuration ServiceClientBase::getSmoothedRtt(NodeID server_node_id) const
+{
+    const RttEstimate* const rtt = findRttEstimate(server_node_id);
+    return (rtt == UAVCAN_NULLPTR) ? MonotonicDuration() : MonotonicDuration::fromUSec(rtt->srtt_usec);
+}
+
+MonotonicDuration ServiceClientBase::getRequestTimeoutFor(NodeID server_node_id) const
+{
+    const RttEstimate* const rtt = findRttEstimate(server_node_id);
+    if (!adaptive_request_timeout_ || (rtt == UAVCAN_NULLPTR))
+    {
+        return request_timeout_;
+    }
+    /*
+     * The minimal request timeout plays the role of the clock granularity of RFC 6298.
+     */
+    const uint64_t variance_usec = max(uint64_t(rtt->rttvar_usec) * 4U, uint64_t(getMinRequestTimeout().toUSec()));
+    const uint64_t timeout_usec = (uint64_t(rtt->srtt_usec) + variance_usec) << rtt->backoff;
+    const uint64_t limit_usec = uint64_t(request_timeout_.toUSec());
+    return max(MonotonicDuration::fromUSec(int64_t(min(timeout_usec, limit_usec))), getMinRequestTimeout());
 }
 
-/*
- * ServiceClientBase
- */
 int ServiceClientBase::prepareToCall(INode& node,
                                      const char* dtname,
                                      NodeID server_node_id,
@@ -65,8 +270,9 @@ int ServiceClientBase::prepareToCall(INode& node,
     const OutgoingTransferRegistryKey otr_key(data_type_descriptor_->getID(),
                                               TransferTypeServiceRequest, server_node_id);
     const MonotonicTime otr_deadline = node.getMonotonicTime() + TransferSender::getDefaultMaxTransferInterval();
+    OutgoingTransferRegistry::EntryCache& otr_cache = otr_cache_[server_node_id.get() % TransferIDCacheSize];
     TransferID* const otr_tid =
-        node.getDispatcher().getOutgoingTransferRegistry().accessOrCreate(otr_key, otr_deadline);
+        node.getDispatcher().getOutgoingTransferRegistry().accessOrCreate(otr_key, otr_deadline, otr_cache);
     if (!otr_tid)
     {
         UAVCAN_TRACE("ServiceClient", "OTR access failure, dtd=%s", data_type_descriptor_->toString().c_str());
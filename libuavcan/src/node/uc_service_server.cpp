@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/node/service_server.hpp>
+
+namespace uavcan
+{
+/*
+ * DeferredServiceResponseTable
+ */
+void DeferredServiceResponseTable::destroy(Entry* entry)
+{
+    allocator_.deallocate(entry);
+    UAVCAN_ASSERT(size_ > 0);
+    size_--;
+}
+
+void DeferredServiceResponseTable::removeExpired(MonotonicTime ts)
+{
+    Entry** link = &list_;
+    while (*link != UAVCAN_NULLPTR)
+    {
+        Entry* const entry = *link;
+        if (entry->deadline <= ts)
+        {
+            UAVCAN_TRACE("DeferredServiceResponseTable", "Expired token %u", unsigned(entry->token));
+            *link = entry->next;
+            destroy(entry);
+            num_expired_++;
+        }
+        else
+        {
+            link = &entry->next;
+        }
+    }
+}
+
+ServiceResponseToken DeferredServiceResponseTable::add(MonotonicTime ts, NodeID dst_node_id,
+                                                       TransferID transfer_id, TransferPriority priority)
+{
+    removeExpired(ts);
+    if (size_ >= capacity_)
+    {
+        UAVCAN_TRACE("DeferredServiceResponseTable", "Table is full");
+        return ServiceResponseToken();
+    }
+
+    void* const mem = allocator_.allocate(sizeof(Entry));
+    if (mem == UAVCAN_NULLPTR)
+    {
+        return ServiceResponseToken();
+    }
+
+    last_token_++;
+    if (last_token_ == 0)
+    {
+        last_token_++;                  // Zero is reserved for the invalid token
+    }
+
+    Entry* const entry = static_cast<Entry*>(mem);
+    entry->next = list_;
+    entry->deadline = ts + timeout_;
+    entry->token = last_token_;
+    entry->priority = priority;
+    entry->transfer_id = transfer_id;
+    entry->dst_node_id = dst_node_id;
+    list_ = entry;
+    size_++;
+    return ServiceResponseToken(entry->token);
+}
+
+bool DeferredServiceResponseTable::remove(ServiceResponseToken token, MonotonicTime ts, Entry& out_entry)
+{
+    removeExpired(ts);
+    for (Entry** link = &list_; *link != UAVCAN_NULLPTR; link = &(*link)->next)
+    {
+        Entry* const entry = *link;
+        if (entry->token == token.get())
+        {
+            out_entry = *entry;
+            *link = entry->next;
+            destroy(entry);
+            return true;
+        }
+    }
+    return false;
+}
+
+void DeferredServiceResponseTable::clear()
+{
+    while (list_ != UAVCAN_NULLPTR)
+    {
+        Entry* const entry = list_;
+        list_ = entry->next;
+        destroy(entry);
+    }
+}
+
+/*
+ * ServiceResponseWriter
+ */
+uint8_t* ServiceResponseWriter::openByteArrayWindow(unsigned max_len, unsigned prefix_bitlen)
+{
+    if (failed_ || (window_max_len_ != 0))
+    {
+        UAVCAN_ASSERT(window_max_len_ == 0);
+        failed_ = true;
+        return UAVCAN_NULLPTR;
+    }
+
+    // The elements follow the length prefix; the window starts at the first whole byte they can occupy
+    const unsigned window_offset = (stream_.getBitOffset() + prefix_bitlen + 7U) / 8U;
+    if ((window_offset + max_len) > buffer_.getSize())
+    {
+        UAVCAN_TRACE("ServiceResponseWriter", "Byte array of %u doesn't fit", max_len);
+        failed_ = true;
+        return UAVCAN_NULLPTR;
+    }
+
+    window_max_len_ = max_len;
+    window_prefix_bitlen_ = uint8_t(prefix_bitlen);
+    return buffer_.getRawPtr() + window_offset;
+}
+
+void ServiceResponseWriter::restart()
+{
+    buffer_.reset();
+    stream_.rewind();
+    window_max_len_ = 0;
+    window_prefix_bitlen_ = 0;
+    failed_ = false;
+}
+
+int ServiceResponseWriter::finishByteArray(unsigned len)
+{
+    const unsigned window_offset = (stream_.getBitOffset() + 7U) / 8U;
+    window_max_len_ = 0;
+    window_prefix_bitlen_ = 0;
+
+    if ((stream_.getBitOffset() % 8) == 0)
+    {
+        return (stream_.advanceWritten(len * 8U) < 0) ? -ErrLogic : 1;     // Already in place
+    }
+
+    /*
+     * The elements have to be shifted back by less than one byte to their final position. The destination
+     * always precedes the source, so moving the data forward chunk by chunk doesn't overwrite what's yet to be read.
+     */
+    const uint8_t* src = buffer_.getRawPtr() + window_offset;
+    while (len > 0)
+    {
+        uint8_t chunk[16];
+        const unsigned chunk_len = min(len, unsigned(sizeof(chunk)));
+        (void)copy(src, src + chunk_len, chunk);
+        const int res = stream_.write(chunk, chunk_len * 8U);
+        if (res <= 0)
+        {
+            return res;
+        }
+        src += chunk_len;
+        len -= chunk_len;
+    }
+    return 1;
+}
+
+}
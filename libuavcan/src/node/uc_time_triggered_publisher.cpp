@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/node/time_triggered_publisher.hpp>
+#include <uavcan/debug.hpp>
+#include <cassert>
+
+namespace uavcan
+{
+namespace
+{
+/**
+ * Time from the given moment until the start of the next slot, zero if a slot starts exactly at that moment.
+ */
+int64_t computeDelayToSlot(int64_t time_usec, int64_t cycle_usec, int64_t offset_usec)
+{
+    int64_t phase = (time_usec - offset_usec) % cycle_usec;
+    if (phase < 0)
+    {
+        phase += cycle_usec;
+    }
+    return (phase == 0) ? 0 : (cycle_usec - phase);
+}
+}
+
+/*
+ * TimeTriggeredPublisherBase
+ */
+MonotonicTime TimeTriggeredPublisherBase::computeNextSlotStart(MonotonicTime after) const
+{
+    const int64_t cycle_usec = cycle_.toUSec();
+    const int64_t offset_usec = slot_offset_.toUSec();
+
+    if (utc_aligned_)
+    {
+        const UtcTime utc = getScheduler().getUtcTime();
+        if (!utc.isZero())
+        {
+            const MonotonicTime mono = getScheduler().getMonotonicTime();
+            const int64_t utc_after_usec = int64_t(utc.toUSec()) + (after - mono).toUSec();
+            return after + MonotonicDuration::fromUSec(computeDelayToSlot(utc_after_usec, cycle_usec, offset_usec));
+        }
+    }
+
+    return after + MonotonicDuration::fromUSec(computeDelayToSlot(int64_t(after.toUSec()), cycle_usec, offset_usec));
+}
+
+void TimeTriggeredPublisherBase::handleDeadline(MonotonicTime current)
+{
+    const MonotonicTime slot_start = getDeadline();
+
+    /*
+     * Looking for the next slot from the middle of the current cycle rather than from the current slot, so that
+     * a small adjustment of the UTC clock can't make the same slot come up twice.
+     */
+    MonotonicTime next_slot_start = computeNextSlotStart(slot_start + MonotonicDuration::fromUSec(cycle_.toUSec() / 2));
+    if (next_slot_start <= current)
+    {
+        // The scheduler was blocked for more than a cycle, the slots that have passed since are lost
+        num_missed_slots_ += uint32_t((current - next_slot_start).toUSec() / cycle_.toUSec()) + 1U;
+        next_slot_start = computeNextSlotStart(current + MonotonicDuration::fromUSec(1));
+    }
+    startWithDeadline(next_slot_start);
+
+    const MonotonicDuration delay = current - slot_start;
+    if (delay >= slot_duration_)
+    {
+        UAVCAN_TRACE("TimeTriggeredPublisher", "Slot missed, delay %lld usec", static_cast<long long>(delay.toUSec()));
+        num_missed_slots_++;
+        return;
+    }
+
+    if (delay > max_release_delay_)
+    {
+        max_release_delay_ = delay;
+    }
+
+    const int res = releaseSlot();
+    if (res < 0)
+    {
+        UAVCAN_TRACE("TimeTriggeredPublisher", "Slot release failure %d", res);
+        num_missed_slots_++;
+    }
+    else if (res > 0)
+    {
+        num_released_slots_++;
+    }
+}
+
+int TimeTriggeredPublisherBase::startSchedule(MonotonicDuration cycle, MonotonicDuration slot_offset,
+                                              MonotonicDuration slot_duration)
+{
+    if (!cycle.isPositive() || slot_offset.isNegative() || slot_offset >= cycle ||
+        !slot_duration.isPositive() || slot_duration > cycle)
+    {
+        return -ErrInvalidParam;
+    }
+
+    stop();
+    cycle_ = cycle;
+    slot_offset_ = slot_offset;
+    slot_duration_ = slot_duration;
+    startWithDeadline(computeNextSlotStart(getScheduler().getMonotonicTime()));
+    return 0;
+}
+
+void TimeTriggeredPublisherBase::setUtcAlignment(bool enabled)
+{
+    utc_aligned_ = enabled;
+    if (isRunning())
+    {
+        stop();
+        startWithDeadline(computeNextSlotStart(getScheduler().getMonotonicTime()));
+    }
+}
+
+}
@@ -25,6 +25,21 @@ void TimerBase::handleDeadline(MonotonicTime current)
     handleTimerEvent(TimerEvent(scheduled_time, current));
 }
 
+void TimerBase::releasePhase()
+{
+    if (phase_bin_ != NoPhase)
+    {
+        getScheduler().getPhaseAllocator().release(phase_bin_, phase_weight_);
+        phase_bin_ = NoPhase;
+    }
+}
+
+void TimerBase::stop()
+{
+    releasePhase();
+    DeadlineHandler::stop();
+}
+
 void TimerBase::startOneShotWithDeadline(MonotonicTime deadline)
 {
     stop();
@@ -47,4 +62,24 @@ void TimerBase::startPeriodic(MonotonicDuration period)
     DeadlineHandler::startWithDelay(period);
 }
 
+void TimerBase::startPeriodicSpread(MonotonicDuration period, uint16_t weight)
+{
+    UAVCAN_ASSERT(period.isPositive() && (period < MonotonicDuration::getInfinite()));
+    stop();
+    period_ = period;
+    phase_weight_ = weight;
+    phase_bin_ = getScheduler().getPhaseAllocator().allocate(weight);
+
+    // The phase is relative to the monotonic time, so that it doesn't depend on when exactly the timer is started
+    const int64_t period_usec = period.toUSec();
+    const int64_t offset_usec = PeriodicPhaseAllocator::computeOffset(phase_bin_, period).toUSec();
+    const MonotonicTime ts = getScheduler().getMonotonicTime();
+    int64_t elapsed_usec = (int64_t(ts.toUSec()) - offset_usec) % period_usec;
+    if (elapsed_usec < 0)
+    {
+        elapsed_usec += period_usec;
+    }
+    DeadlineHandler::startWithDeadline(ts + MonotonicDuration::fromUSec(period_usec - elapsed_usec));
+}
+
 }
@@ -40,6 +40,11 @@ void DynamicNodeIDClient::restartTimer(const Mode mode)
                  static_cast<int>(mode), static_cast<int>(delay.toMSec()));
 }
 
+bool DynamicNodeIDClient::isSingleRoundAllocation()
+{
+    return dnida_pub_.getNode().isCanFdEnabled();
+}
+
 void DynamicNodeIDClient::handleTimerEvent(const TimerEvent&)
 {
     UAVCAN_ASSERT(preferred_node_id_.isValid());
@@ -59,7 +64,9 @@ void DynamicNodeIDClient::handleTimerEvent(const TimerEvent&)
     tx.node_id = preferred_node_id_.get();
     tx.first_part_of_unique_id = (size_of_received_unique_id_ == 0);
 
-    const uint8_t size_of_unique_id_in_request =
+    // A CAN FD frame can carry the whole unique ID, so the allocator can respond with the final allocation at once
+    const uint8_t size_of_unique_id_in_request = isSingleRoundAllocation() ?
+        static_cast<uint8_t>(tx.unique_id.capacity() - size_of_received_unique_id_) :
         min(protocol::dynamic_node_id::Allocation::MAX_LENGTH_OF_UNIQUE_ID_IN_REQUEST,
             static_cast<uint8_t>(tx.unique_id.capacity() - size_of_received_unique_id_));
 
@@ -136,11 +143,15 @@ void DynamicNodeIDClient::handleAllocation(const ReceivedDataStructure<protocol:
             UAVCAN_TRACE("DynamicNodeIDClient", "Allocation complete, node ID %d provided by %d",
                          static_cast<int>(allocated_node_id_.get()), static_cast<int>(allocator_node_id_.get()));
         }
-        else
+        else if (!isSingleRoundAllocation())
         {
             size_of_received_unique_id_ = msg.unique_id.size();
             restartTimer(ModeDelayBeforeFollowup);
         }
+        else
+        {
+            UAVCAN_TRACE("DynamicNodeIDClient", "Follow-up ignored in single round mode");
+        }
     }
 }
 
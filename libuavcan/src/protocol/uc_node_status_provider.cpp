@@ -23,9 +23,31 @@ int NodeStatusProvider::publish()
 
     UAVCAN_ASSERT(node_info_.status.health <= protocol::NodeStatus::FieldTypes::health::max());
 
+    published_health_ = node_info_.status.health;
+    published_mode_ = node_info_.status.mode;
+
     return node_status_pub_.broadcast(node_info_.status);
 }
 
+void NodeStatusProvider::handleStatusChange()
+{
+    // The ad-hoc updater is invoked right before a publication, so there's no need to publish twice
+    if (!adaptive_publication_ || ad_hoc_update_in_progress_ || !TimerBase::isRunning())
+    {
+        return;
+    }
+
+    if (!getNode().isPassiveMode())
+    {
+        const int res = publish();
+        if (res < 0)
+        {
+            getNode().registerInternalFailure("NodeStatus pub failed");
+        }
+    }
+    TimerBase::startPeriodic(publication_period_);
+}
+
 void NodeStatusProvider::handleTimerEvent(const TimerEvent&)
 {
     if (getNode().isPassiveMode())
@@ -36,14 +58,32 @@ void NodeStatusProvider::handleTimerEvent(const TimerEvent&)
     {
         if (ad_hoc_status_updater_ != UAVCAN_NULLPTR)
         {
+            ad_hoc_update_in_progress_ = true;
             ad_hoc_status_updater_->updateNodeStatus();
+            ad_hoc_update_in_progress_ = false;
         }
 
+        const bool changed = (published_health_ != node_info_.status.health) ||
+                             (published_mode_ != node_info_.status.mode);
+
         const int res = publish();
         if (res < 0)
         {
             getNode().registerInternalFailure("NodeStatus pub failed");
         }
+
+        if (adaptive_publication_)
+        {
+            const MonotonicDuration maximum =
+                MonotonicDuration::fromMSec(protocol::NodeStatus::MAX_BROADCASTING_PERIOD_MS);
+            const MonotonicDuration current = TimerBase::getPeriod();
+            const MonotonicDuration next = changed ? publication_period_ : min(current + current, maximum);
+            if (next != current)
+            {
+                UAVCAN_TRACE("NodeStatusProvider", "Status pub period: %s", next.toString().c_str());
+                TimerBase::startPeriodic(next);
+            }
+        }
     }
 }
 
@@ -100,6 +140,7 @@ void NodeStatusProvider::setStatusPublicationPeriod(uavcan::MonotonicDuration pe
 
     period = min(period, maximum);
     period = max(period, minimum);
+    publication_period_ = period;
     TimerBase::startPeriodic(period);
 
     const MonotonicDuration tx_timeout = period - MonotonicDuration::fromUSec(period.toUSec() / 20);
@@ -111,7 +152,16 @@ void NodeStatusProvider::setStatusPublicationPeriod(uavcan::MonotonicDuration pe
 
 uavcan::MonotonicDuration NodeStatusProvider::getStatusPublicationPeriod() const
 {
-    return TimerBase::getPeriod();
+    return publication_period_;
+}
+
+void NodeStatusProvider::enableAdaptivePublication(bool enabled)
+{
+    adaptive_publication_ = enabled;
+    if (!enabled && TimerBase::isRunning())
+    {
+        TimerBase::startPeriodic(publication_period_);
+    }
 }
 
 void NodeStatusProvider::setAdHocNodeStatusUpdater(IAdHocNodeStatusUpdater* updater)
@@ -121,12 +171,22 @@ void NodeStatusProvider::setAdHocNodeStatusUpdater(IAdHocNodeStatusUpdater* upda
 
 void NodeStatusProvider::setHealth(uint8_t code)
 {
+    const bool changed = node_info_.status.health != code;
     node_info_.status.health = code;
+    if (changed)
+    {
+        handleStatusChange();
+    }
 }
 
 void NodeStatusProvider::setMode(uint8_t code)
 {
+    const bool changed = node_info_.status.mode != code;
     node_info_.status.mode = code;
+    if (changed)
+    {
+        handleStatusChange();
+    }
 }
 
 void NodeStatusProvider::setVendorSpecificStatusCode(VendorSpecificStatusCode code)
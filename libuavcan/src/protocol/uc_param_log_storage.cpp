@@ -0,0 +1,412 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/protocol/param_log_storage.hpp>
+#include <uavcan/transport/crc.hpp>
+#include <uavcan/debug.hpp>
+#include <cassert>
+
+namespace uavcan
+{
+namespace
+{
+/*
+ * Header:  magic (4), generation (4), record size (2), CRC (2)
+ * Record:  key (4), value (4), kind (1), zero (1), CRC (2)
+ * Little endian. The zero byte makes a written record distinguishable from the erased flash.
+ */
+const uint32_t HeaderMagic = 0x4C504355U;       // "UCPL"
+
+void writeU16(uint8_t* p, uint16_t x)
+{
+    p[0] = uint8_t(x & 0xFFU);
+    p[1] = uint8_t(x >> 8);
+}
+
+void writeU32(uint8_t* p, uint32_t x)
+{
+    writeU16(p, uint16_t(x & 0xFFFFU));
+    writeU16(p + 2, uint16_t(x >> 16));
+}
+
+uint16_t readU16(const uint8_t* p)
+{
+    return uint16_t(p[0] | (p[1] << 8));
+}
+
+uint32_t readU32(const uint8_t* p)
+{
+    return uint32_t(readU16(p)) | (uint32_t(readU16(p + 2)) << 16);
+}
+
+uint16_t computeCrc(const uint8_t* data, unsigned len)
+{
+    TransferCRC crc;
+    crc.add(data, len);
+    return crc.get();
+}
+
+bool isErased(const uint8_t* data, unsigned len)
+{
+    for (unsigned i = 0; i < len; i++)
+    {
+        if (data[i] != 0xFFU)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+bool ParamLogStorageBase::readHeader(uint8_t sector, uint32_t& out_generation)
+{
+    uint8_t buf[HeaderSize];
+    if (flash_.read(sector, 0, buf, HeaderSize) < 0)
+    {
+        return false;
+    }
+    if ((readU32(buf) != HeaderMagic) ||
+        (readU16(buf + 8) != RecordSize) ||
+        (readU16(buf + 10) != computeCrc(buf, 10)))
+    {
+        return false;
+    }
+    out_generation = readU32(buf + 4);
+    return true;
+}
+
+int ParamLogStorageBase::writeHeader(uint8_t sector, uint32_t generation)
+{
+    uint8_t buf[HeaderSize];
+    writeU32(buf, HeaderMagic);
+    writeU32(buf + 4, generation);
+    writeU16(buf + 8, RecordSize);
+    writeU16(buf + 10, computeCrc(buf, 10));
+    return flash_.write(sector, 0, buf, HeaderSize);
+}
+
+int ParamLogStorageBase::appendRecord(uint8_t sector, uint32_t& inout_offset, unsigned param_index, uint32_t value)
+{
+    if ((inout_offset + RecordSize) > flash_.getSectorSize())
+    {
+        return -ErrLogic;
+    }
+
+    uint8_t buf[RecordSize];
+    writeU32(buf, getParamKey(param_index));
+    writeU32(buf + 4, value);
+    buf[8] = getParamKind(param_index);
+    buf[9] = 0;
+    writeU16(buf + 10, computeCrc(buf, 10));
+
+    // The space is consumed even if the write fails, since the location may be partially programmed
+    const uint32_t offset = inout_offset;
+    inout_offset += RecordSize;
+    return flash_.write(sector, offset, buf, RecordSize);
+}
+
+int ParamLogStorageBase::replay()
+{
+    const uint32_t sector_size = flash_.getSectorSize();
+
+    write_offset_ = HeaderSize;
+    for (uint32_t offset = HeaderSize; (offset + RecordSize) <= sector_size; offset += RecordSize)
+    {
+        uint8_t buf[RecordSize];
+        const int res = flash_.read(active_sector_, offset, buf, RecordSize);
+        if (res < 0)
+        {
+            return res;
+        }
+
+        if (isErased(buf, RecordSize))
+        {
+            break;
+        }
+        write_offset_ = offset + RecordSize;
+
+        if ((buf[9] != 0) || (readU16(buf + 10) != computeCrc(buf, 10)))
+        {
+            UAVCAN_TRACE("ParamLogStorage", "Corrupted record at %u", unsigned(offset));
+            num_corrupted_records_++;
+            continue;
+        }
+
+        const uint32_t key = readU32(buf);
+        for (unsigned i = 0; i < num_params_; i++)
+        {
+            if ((getParamKey(i) == key) && (getParamKind(i) == buf[8]))
+            {
+                setParamValue(i, readU32(buf + 4));
+                persisted_values_[i] = getParamValue(i);
+                break;
+            }
+        }
+        // The records of unknown parameters are dropped by the next compaction
+    }
+    return 0;
+}
+
+int ParamLogStorageBase::startNewLog(uint8_t sector, uint32_t generation)
+{
+    int res = flash_.erase(sector);
+    if (res >= 0)
+    {
+        res = writeHeader(sector, generation);
+    }
+    if (res >= 0)
+    {
+        active_sector_ = sector;
+        generation_ = generation;
+        write_offset_ = HeaderSize;
+    }
+    return res;
+}
+
+void ParamLogStorageBase::startCompaction()
+{
+    if (compaction_state_ == CompactionIdle)
+    {
+        UAVCAN_TRACE("ParamLogStorage", "Compaction started, generation %u", unsigned(generation_));
+        compaction_state_ = CompactionEraseSpare;
+        startPeriodic(MonotonicDuration::fromMSec(CompactionStepIntervalMs));
+    }
+}
+
+void ParamLogStorageBase::abortCompaction()
+{
+    compaction_state_ = CompactionIdle;
+    TimerBase::stop();
+}
+
+int ParamLogStorageBase::stepCompaction()
+{
+    switch (compaction_state_)
+    {
+    case CompactionEraseSpare:
+    {
+        const int res = flash_.erase(getSpareSector());
+        if (res < 0)
+        {
+            return res;
+        }
+        compaction_offset_ = HeaderSize;
+        compaction_cursor_ = 0;
+        fill_n(recopy_flags_, num_params_, false);
+        compaction_state_ = CompactionCopy;
+        break;
+    }
+    case CompactionCopy:
+    {
+        for (unsigned n = 0; (n < CompactionRecordsPerStep) && (compaction_cursor_ < num_params_); n++)
+        {
+            const unsigned index = compaction_cursor_++;
+            // The parameters that have their default values need no records
+            if (persisted_values_[index] != getParamDefaultValue(index))
+            {
+                const int res = appendRecord(getSpareSector(), compaction_offset_, index,
+                                             persisted_values_[index]);
+                if (res < 0)
+                {
+                    return res;
+                }
+            }
+        }
+        if (compaction_cursor_ < num_params_)
+        {
+            break;
+        }
+
+        // The parameters that have been saved into the old sector after they had been copied
+        for (unsigned index = 0; index < num_params_; index++)
+        {
+            if (recopy_flags_[index])
+            {
+                const int res = appendRecord(getSpareSector(), compaction_offset_, index, persisted_values_[index]);
+                if (res < 0)
+                {
+                    return res;
+                }
+                recopy_flags_[index] = false;
+            }
+        }
+
+        const int res = writeHeader(getSpareSector(), generation_ + 1U);
+        if (res < 0)
+        {
+            return res;
+        }
+        active_sector_ = getSpareSector();
+        generation_++;
+        write_offset_ = compaction_offset_;
+        compaction_state_ = CompactionEraseOld;
+        UAVCAN_TRACE("ParamLogStorage", "Compacted into sector %u, generation %u",
+                     unsigned(active_sector_), unsigned(generation_));
+        break;
+    }
+    case CompactionEraseOld:
+    {
+        // Not strictly necessary, but the stale sector can't be mistaken for the active one after this
+        const int res = flash_.erase(getSpareSector());
+        if (res < 0)
+        {
+            return res;
+        }
+        abortCompaction();
+        break;
+    }
+    case CompactionIdle:
+    default:
+    {
+        UAVCAN_ASSERT(0);
+        abortCompaction();
+        break;
+    }
+    }
+    return 0;
+}
+
+void ParamLogStorageBase::handleTimerEvent(const TimerEvent&)
+{
+    const int res = stepCompaction();
+    if (res < 0)
+    {
+        UAVCAN_TRACE("ParamLogStorage", "Compaction failed: %d", res);
+        abortCompaction();
+    }
+}
+
+int ParamLogStorageBase::init()
+{
+    abortCompaction();
+    num_corrupted_records_ = 0;
+
+    if ((flash_.getSectorSize() <= HeaderSize) || (getCapacity() < (num_params_ * 2U)) || (num_params_ > 0xFFFFU))
+    {
+        return -ErrInvalidParam;
+    }
+
+    for (unsigned i = 0; i < num_params_; i++)
+    {
+        persisted_values_[i] = getParamDefaultValue(i);
+        recopy_flags_[i] = false;
+    }
+
+    uint32_t generations[IParamFlash::NumSectors] = { 0, 0 };
+    bool valid[IParamFlash::NumSectors] = { false, false };
+    for (uint8_t i = 0; i < IParamFlash::NumSectors; i++)
+    {
+        valid[i] = readHeader(i, generations[i]);
+    }
+
+    if (!valid[0] && !valid[1])
+    {
+        UAVCAN_TRACE("ParamLogStorage", "No log found");
+        return startNewLog(0, 1);
+    }
+
+    if (valid[0] && valid[1])
+    {
+        // The compaction has been interrupted before the old sector has been erased; the generations may wrap
+        active_sector_ = (int32_t(generations[1] - generations[0]) > 0) ? 1 : 0;
+    }
+    else
+    {
+        active_sector_ = valid[0] ? 0 : 1;
+    }
+    generation_ = generations[active_sector_];
+
+    const int res = replay();
+    if (res < 0)
+    {
+        return res;
+    }
+
+    if (getNumFreeRecords() < num_params_)
+    {
+        startCompaction();
+    }
+    return 0;
+}
+
+int ParamLogStorageBase::save()
+{
+    int num_saved = 0;
+
+    for (unsigned index = 0; index < num_params_; index++)
+    {
+        const uint32_t value = getParamValue(index);
+        if (value == persisted_values_[index])
+        {
+            continue;
+        }
+
+        if (getNumFreeRecords() == 0)
+        {
+            int res = compact();
+            if ((res >= 0) && (getNumFreeRecords() == 0))
+            {
+                res = compact();    // The first one has completed the compaction that had been started before
+            }
+            if (res < 0)
+            {
+                return res;
+            }
+        }
+
+        const int res = appendRecord(active_sector_, write_offset_, index, value);
+        if (res < 0)
+        {
+            return res;
+        }
+        persisted_values_[index] = value;
+        num_saved++;
+
+        if ((compaction_state_ == CompactionCopy) && (index < compaction_cursor_))
+        {
+            recopy_flags_[index] = true;
+        }
+    }
+
+    if (getNumFreeRecords() < num_params_)
+    {
+        startCompaction();
+    }
+    return num_saved;
+}
+
+int ParamLogStorageBase::erase()
+{
+    abortCompaction();
+
+    for (unsigned i = 0; i < num_params_; i++)
+    {
+        persisted_values_[i] = getParamDefaultValue(i);
+    }
+
+    const int res = flash_.erase(getSpareSector());
+    if (res < 0)
+    {
+        return res;
+    }
+    return startNewLog(active_sector_, generation_ + 1U);
+}
+
+int ParamLogStorageBase::compact()
+{
+    startCompaction();
+    while (compaction_state_ != CompactionIdle)
+    {
+        const int res = stepCompaction();
+        if (res < 0)
+        {
+            abortCompaction();
+            return res;
+        }
+    }
+    return 0;
+}
+
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/transport/bus_load_estimator.hpp>
+
+namespace uavcan
+{
+
+BusLoadEstimator::FrameLength BusLoadEstimator::estimateFrameLength(const CanFrame& frame)
+{
+    // CRC delimiter is counted separately; ACK slot and delimiter, end of frame, intermission
+    static const unsigned TailBits = 1 + 1 + 7 + 3;
+
+    const unsigned data_len = frame.isRemoteTransmissionRequest() ? 0U : CanFrame::dlcToDataLength(frame.dlc);
+    FrameLength out;
+
+#if UAVCAN_SUPPORT_CANFD
+    if (frame.isCanFDFrame())
+    {
+        // SOF, identifier, RRS/SRR, IDE, FDF, res, BRS
+        const unsigned arbitration_bits = frame.isExtended() ? 36U : 17U;
+        // ESI, DLC, data; then the stuff count and the CRC, where the stuff bits are fixed
+        const unsigned data_bits = 1U + 4U + data_len * 8U;
+        const unsigned crc_bits = (data_len > 16) ? 21U : 17U;
+        const unsigned fixed_stuff_bits = (4U + crc_bits) / 4U + 1U;
+
+        out.nominal_bits = uint16_t(arbitration_bits + arbitration_bits / 5U + TailBits);
+        out.data_bits = uint16_t(data_bits + data_bits / 5U + 4U + crc_bits + fixed_stuff_bits + 1U);
+        return out;
+    }
+#endif
+
+    // SOF, identifier, RTR/SRR, IDE, reserved, DLC, data, CRC
+    const unsigned stuffable_bits = (frame.isExtended() ? 54U : 34U) + data_len * 8U;
+    out.nominal_bits = uint16_t(stuffable_bits + stuffable_bits / 5U + 1U + TailBits);
+    return out;
+}
+
+void BusLoadEstimator::setBitrate(uint32_t nominal_bitrate, uint32_t data_bitrate)
+{
+    if (nominal_bitrate == 0)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    if (data_bitrate == 0)
+    {
+        data_bitrate = nominal_bitrate;
+    }
+    nominal_bit_nsec_ = max(1000000000U / nominal_bitrate, 1U);
+    data_bit_nsec_ = max(1000000000U / data_bitrate, 1U);
+}
+
+void BusLoadEstimator::setWindow(MonotonicDuration window)
+{
+    window = max(window, getMinWindow());
+    window = min(window, getMaxWindow());
+    bucket_usec_ = uint32_t(window.toUSec() / NumBuckets);
+    reset();
+}
+
+void BusLoadEstimator::addFrame(const CanFrame& frame, MonotonicTime ts)
+{
+    const FrameLength length = estimateFrameLength(frame);
+    const uint32_t duration_nsec = length.nominal_bits * nominal_bit_nsec_ + length.data_bits * data_bit_nsec_;
+
+    const uint32_t number = getBucketNumber(ts);
+    const unsigned slot = number % NumBuckets;
+    if (bucket_numbers_[slot] != number)
+    {
+        bucket_numbers_[slot] = number;
+        busy_nsec_[slot] = 0;
+    }
+
+    const uint32_t busy_nsec = busy_nsec_[slot] + duration_nsec;
+    busy_nsec_[slot] = (busy_nsec < busy_nsec_[slot]) ? NumericTraits<uint32_t>::max() : busy_nsec;
+}
+
+uint8_t BusLoadEstimator::getLoadPercent(MonotonicTime ts) const
+{
+    const uint32_t number = getBucketNumber(ts);
+    uint64_t busy_nsec = 0;
+    for (unsigned i = 0; i < NumBuckets; i++)
+    {
+        // Buckets from the future, e.g. after a clock adjustment, wrap around and are ignored as well
+        if (uint32_t(number - bucket_numbers_[i]) < NumBuckets)
+        {
+            busy_nsec += busy_nsec_[i];
+        }
+    }
+
+    // The current bucket is only partially elapsed
+    const uint64_t window_usec = uint64_t(bucket_usec_) * (NumBuckets - 1U) + uint64_t(ts.toUSec()) % bucket_usec_;
+    return uint8_t(min(busy_nsec / (window_usec * 10U), uint64_t(100U)));
+}
+
+void BusLoadEstimator::reset()
+{
+    fill(busy_nsec_, busy_nsec_ + NumBuckets, 0U);
+    fill(bucket_numbers_, bucket_numbers_ + NumBuckets, 0U);
+}
+
+}
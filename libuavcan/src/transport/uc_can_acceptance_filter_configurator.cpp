@@ -14,6 +14,119 @@ const unsigned CanAcceptanceFilterConfigurator::DefaultFilterServiceMask;
 const unsigned CanAcceptanceFilterConfigurator::DefaultAnonMsgMask;
 const unsigned CanAcceptanceFilterConfigurator::DefaultAnonMsgID;
 
+#if !UAVCAN_TINY
+/*
+ * CanBusTrafficMonitor
+ */
+const uint32_t CanBusTrafficMonitor::CountLimit;
+
+unsigned CanBusTrafficMonitor::computeHash(uint32_t key)
+{
+    // The lower 7 bits carry only the anonymous flag, so they are excluded from the multiplicative hash
+    const uint32_t product = static_cast<uint32_t>((key >> 7) * 2654435761U);
+    return static_cast<unsigned>(product >> 16) & (Capacity - 1U);
+}
+
+uint32_t CanBusTrafficMonitor::makeKey(uint32_t can_id)
+{
+    const uint32_t anonymous_flag = ((can_id & 0x7FU) != 0) ? 1U : 0U;
+    return (can_id & 0x00FFFF80U) | CanFrame::FlagEFF | anonymous_flag;
+}
+
+bool CanBusTrafficMonitor::isAcceptedBy(uint32_t key, const CanFilterConfig& cfg)
+{
+    // Priority and source node ID are not tracked
+    static const uint32_t TrackedMask = 0x00FFFF80U | CanFrame::FlagEFF | CanFrame::FlagRTR | CanFrame::FlagERR;
+    if (((key ^ cfg.id) & cfg.mask & TrackedMask) != 0)
+    {
+        return false;
+    }
+
+    const uint32_t src_mask = cfg.mask & 0x7FU;
+    const uint32_t src_id = cfg.id & src_mask;
+    if ((key & 1U) == 0)
+    {
+        return src_id == 0;                             // Anonymous frames have zero source node ID
+    }
+    return !((src_mask == 0x7FU) && (src_id == 0));     // Only a filter for anonymous frames rejects them for sure
+}
+
+void CanBusTrafficMonitor::handleRxFrame(const CanRxFrame& frame, CanIOFlags flags)
+{
+    if (((flags & CanIOFlagLoopback) == 0) &&
+        frame.isExtended() && !frame.isRemoteTransmissionRequest() && !frame.isErrorFrame())
+    {
+        addFrames(frame.id, 1);
+    }
+}
+
+void CanBusTrafficMonitor::addFrames(uint32_t can_id, uint32_t count)
+{
+    const uint32_t key = makeKey(can_id);
+    count = min(count, CountLimit - 1U);
+
+    Entry* entry = UAVCAN_NULLPTR;
+    unsigned index = computeHash(key);
+    for (unsigned i = 0; i < Capacity; i++)
+    {
+        if (entries_[index].key == key)
+        {
+            entry = &entries_[index];
+            break;
+        }
+        if (entries_[index].key == 0)
+        {
+            entry = &entries_[index];
+            entry->key = key;
+            entry->count = 0;
+            num_entries_++;
+            break;
+        }
+        index = (index + 1U) & (Capacity - 1U);
+    }
+
+    uint32_t& counter = (entry != UAVCAN_NULLPTR) ? entry->count : num_untracked_frames_;
+    while (counter >= (CountLimit - count))
+    {
+        // Halving preserves the ratios between the classes, which is all the cost model needs
+        for (unsigned i = 0; i < Capacity; i++)
+        {
+            entries_[i].count /= 2U;
+        }
+        num_untracked_frames_ /= 2U;
+    }
+    counter += count;
+}
+
+uint32_t CanBusTrafficMonitor::countAcceptedFrames(const CanFilterConfig& cfg) const
+{
+    uint32_t result = 0;
+    for (unsigned i = 0; i < Capacity; i++)
+    {
+        if ((entries_[i].key != 0) && isAcceptedBy(entries_[i].key, cfg))
+        {
+            result += min(entries_[i].count, NumericTraits<uint32_t>::max() - result);
+        }
+    }
+    return result;
+}
+
+void CanBusTrafficMonitor::reset()
+{
+    for (unsigned i = 0; i < Capacity; i++)
+    {
+        entries_[i].key = 0;
+        entries_[i].count = 0;
+    }
+    num_untracked_frames_ = 0;
+    num_entries_ = 0;
+}
+#endif
+
+/*
+ * CanAcceptanceFilterConfigurator
+ */
+
 int16_t CanAcceptanceFilterConfigurator::loadInputConfiguration(AnonymousMessages load_mode)
 {
     multiset_configs_.clear();
@@ -44,6 +157,22 @@ int16_t CanAcceptanceFilterConfigurator::loadInputConfiguration(AnonymousMessage
         CanFilterConfig cfg;
         cfg.id = (static_cast<uint32_t>(p->getDataTypeDescriptor().getID().get()) << 8) | CanFrame::FlagEFF;
         cfg.mask = DefaultFilterMsgMask | CanFrame::FlagEFF | CanFrame::FlagRTR | CanFrame::FlagERR;
+
+        // The bits of the source node ID that are the same for all accepted sources can be matched too
+        const NodeIDSet& sources = p->getSourceNodeFilter();
+        if (!sources.isEmpty())
+        {
+            uint32_t common_ones = uint32_t(NodeID::Max);
+            uint32_t any_ones = 0;
+            for (NodeID nid = sources.getFirst(); nid.isValid(); nid = sources.getNext(nid))
+            {
+                common_ones &= nid.get();
+                any_ones |= nid.get();
+            }
+            cfg.id |= common_ones;
+            cfg.mask |= ~(common_ones ^ any_ones) & uint32_t(NodeID::Max);
+        }
+
         if (multiset_configs_.emplace(cfg) == UAVCAN_NULLPTR)
         {
             return -ErrMemory;
@@ -69,13 +198,33 @@ int16_t CanAcceptanceFilterConfigurator::mergeConfigurations()
     }
     UAVCAN_ASSERT(multiset_configs_.getSize() != 0);
 
+#if !UAVCAN_TINY
+    bool accepted[CanBusTrafficMonitor::Capacity];
+#endif
+
     while (acceptance_filters_number < multiset_configs_.getSize())
     {
         uint16_t i_rank = 0, j_rank = 0;
         uint8_t best_rank = 0;
+        uint32_t best_cost = NumericTraits<uint32_t>::max();
 
         const uint16_t multiset_array_size = static_cast<uint16_t>(multiset_configs_.getSize());
 
+#if !UAVCAN_TINY
+        if (traffic_monitor_ != UAVCAN_NULLPTR)
+        {
+            for (unsigned k = 0; k < CanBusTrafficMonitor::Capacity; k++)
+            {
+                const uint32_t key = traffic_monitor_->getEntry(k).key;
+                accepted[k] = false;
+                for (uint16_t i_ind = 0; (key != 0) && !accepted[k] && (i_ind < multiset_array_size); i_ind++)
+                {
+                    accepted[k] = CanBusTrafficMonitor::isAcceptedBy(key, *multiset_configs_.getByIndex(i_ind));
+                }
+            }
+        }
+#endif
+
         for (uint16_t i_ind = 0; i_ind < multiset_array_size - 1; i_ind++)
         {
             for (uint16_t j_ind = static_cast<uint8_t>(i_ind + 1); j_ind < multiset_array_size; j_ind++)
@@ -83,8 +232,16 @@ int16_t CanAcceptanceFilterConfigurator::mergeConfigurations()
                 CanFilterConfig temp_config = mergeFilters(*multiset_configs_.getByIndex(i_ind),
                                                            *multiset_configs_.getByIndex(j_ind));
                 uint8_t rank = countBits(temp_config.mask);
-                if (rank > best_rank)
+                uint32_t cost = 0;
+#if !UAVCAN_TINY
+                if (traffic_monitor_ != UAVCAN_NULLPTR)
                 {
+                    cost = computeMergeCost(temp_config, accepted);
+                }
+#endif
+                if ((cost < best_cost) || ((cost == best_cost) && (rank > best_rank)))
+                {
+                    best_cost = cost;
                     best_rank = rank;
                     i_rank = i_ind;
                     j_rank = j_ind;
@@ -243,6 +400,23 @@ CanFilterConfig CanAcceptanceFilterConfigurator::mergeFilters(CanFilterConfig& a
     return temp_arr;
 }
 
+#if !UAVCAN_TINY
+uint32_t CanAcceptanceFilterConfigurator::computeMergeCost(const CanFilterConfig& merged, const bool* accepted) const
+{
+    UAVCAN_ASSERT(traffic_monitor_ != UAVCAN_NULLPTR);
+    uint32_t cost = 0;
+    for (unsigned k = 0; k < CanBusTrafficMonitor::Capacity; k++)
+    {
+        const CanBusTrafficMonitor::Entry& entry = traffic_monitor_->getEntry(k);
+        if ((entry.key != 0) && !accepted[k] && CanBusTrafficMonitor::isAcceptedBy(entry.key, merged))
+        {
+            cost += min(entry.count, NumericTraits<uint32_t>::max() - cost);
+        }
+    }
+    return cost;
+}
+#endif
+
 uint8_t CanAcceptanceFilterConfigurator::countBits(uint32_t n_)
 {
     uint8_t c_; // c accumulates the total bits set in v
@@ -253,4 +427,72 @@ uint8_t CanAcceptanceFilterConfigurator::countBits(uint32_t n_)
 
     return c_;
 }
+
+#if !UAVCAN_TINY
+/*
+ * CanAcceptanceFilterUpdater
+ */
+uint32_t CanAcceptanceFilterUpdater::computeSignature()
+{
+    // FNV-1a over the node ID and the data type IDs of the message listeners, which are ordered by data type ID
+    uint32_t hash = 2166136261U;
+    hash = (hash ^ node_.getNodeID().get()) * 16777619U;
+
+    const TransferListener* p = node_.getDispatcher().getListOfMessageListeners().get();
+    while (p != UAVCAN_NULLPTR)
+    {
+        const uint16_t dtid = p->getDataTypeDescriptor().getID().get();
+        hash = (hash ^ (dtid & 0xFFU)) * 16777619U;
+        hash = (hash ^ (dtid >> 8)) * 16777619U;
+        p = p->getNextListNode();
+    }
+    return hash;
+}
+
+void CanAcceptanceFilterUpdater::start(MonotonicDuration update_interval)
+{
+    node_.getDispatcher().installRxFrameListener(&traffic_monitor_);
+    startPeriodic(update_interval);
+}
+
+void CanAcceptanceFilterUpdater::stop()
+{
+    TimerBase::stop();
+    if (node_.getDispatcher().getRxFrameListener() == &traffic_monitor_)
+    {
+        node_.getDispatcher().removeRxFrameListener();
+    }
+}
+
+int CanAcceptanceFilterUpdater::update(bool force)
+{
+    const uint32_t signature = computeSignature();
+    if (!force && applied_ && (signature == applied_signature_))
+    {
+        return 0;
+    }
+
+    CanAcceptanceFilterConfigurator cfger(node_, filters_number_);
+    cfger.setTrafficMonitor(&traffic_monitor_);
+
+    int res = cfger.computeConfiguration(mode_);
+    if (res >= 0)
+    {
+        res = cfger.applyConfiguration();
+    }
+
+    last_result_ = res;
+    if (res >= 0)
+    {
+        applied_ = true;
+        applied_signature_ = signature;
+        UAVCAN_TRACE("CanAcceptanceFilterUpdater", "Filters updated, signature %08x", unsigned(signature));
+    }
+    else
+    {
+        UAVCAN_TRACE("CanAcceptanceFilterUpdater", "Update failed: %d", res);
+    }
+    return res;
+}
+#endif
 }
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/transport/can_frame_bridge.hpp>
+#include <uavcan/debug.hpp>
+
+namespace uavcan
+{
+#if !UAVCAN_TINY
+
+CanFrameBridge::Route CanFrameBridge::makeMessageRoute(DataTypeID dtid, NodeID src_node_id, uint8_t iface_mask)
+{
+    UAVCAN_ASSERT(dtid.isValidForDataTypeKind(DataTypeKindMessage));
+    Route route;
+    route.can_id = (uint32_t(dtid.get()) << 8) | CanFrame::FlagEFF;
+    route.mask = 0x00FFFF80U | CanFrame::FlagEFF | CanFrame::FlagRTR | CanFrame::FlagERR;
+    if (src_node_id.isUnicast())
+    {
+        route.can_id |= src_node_id.get();
+        route.mask |= NodeID::Max;
+    }
+    route.iface_mask = iface_mask;
+    return route;
+}
+
+CanFrameBridge::Route CanFrameBridge::makeServiceRoute(DataTypeID dtid, NodeID dst_node_id, uint8_t iface_mask)
+{
+    UAVCAN_ASSERT(dtid.isValidForDataTypeKind(DataTypeKindService));
+    Route route;
+    route.can_id = (uint32_t(dtid.get()) << 16) | (1U << 7) | CanFrame::FlagEFF;
+    route.mask = 0x00FF0080U | CanFrame::FlagEFF | CanFrame::FlagRTR | CanFrame::FlagERR;
+    if (dst_node_id.isUnicast())
+    {
+        route.can_id |= uint32_t(dst_node_id.get()) << 8;
+        route.mask |= uint32_t(NodeID::Max) << 8;
+    }
+    route.iface_mask = iface_mask;
+    return route;
+}
+
+int CanFrameBridge::addRoute(const Route& route)
+{
+    if (num_routes_ >= MaxRoutes)
+    {
+        return -ErrLogic;
+    }
+    routes_[num_routes_] = route;
+    routes_[num_routes_].can_id &= route.mask;
+    num_routes_++;
+    return 0;
+}
+
+const CanFrameBridge::Route* CanFrameBridge::findRoute(uint32_t can_id) const
+{
+    for (unsigned i = 0; i < num_routes_; i++)
+    {
+        if (routes_[i].matches(can_id))
+        {
+            return &routes_[i];
+        }
+    }
+    return UAVCAN_NULLPTR;
+}
+
+void CanFrameBridge::handleRxFrame(const CanRxFrame& frame, CanIOFlags flags)
+{
+    if ((flags & CanIOFlagLoopback) || ((rx_iface_mask_ & (1U << frame.iface_index)) == 0))
+    {
+        return;
+    }
+
+    const Route* const route = findRoute(frame.id);
+    if (route == UAVCAN_NULLPTR)
+    {
+        return;
+    }
+
+    const MonotonicTime ts = sysclock_.getMonotonic();
+    const int res = target_.send(frame, ts + tx_timeout_, ts, route->iface_mask, CanTxQueue::Volatile, CanIOFlags());
+    if (res < 0)
+    {
+        UAVCAN_TRACE("CanFrameBridge", "Failed to forward %s: %i", frame.toString().c_str(), res);
+        num_dropped_frames_++;
+    }
+    else
+    {
+        num_forwarded_frames_++;
+    }
+}
+
+#endif
+}
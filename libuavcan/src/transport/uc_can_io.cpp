@@ -5,6 +5,7 @@
 
 #include <uavcan/transport/can_io.hpp>
 #include <uavcan/debug.hpp>
+#include <uavcan/trace.hpp>
 #include <cassert>
 
 namespace uavcan
@@ -88,13 +89,15 @@ std::string CanTxQueue::Entry::toString() const
  */
 CanTxQueue::~CanTxQueue()
 {
-    Entry* p = queue_.get();
+    Entry* p = head_;
     while (p)
     {
-        Entry* const next = p->getNextListNode();
+        Entry* const next = getNextEntry(p);
         remove(p);
         p = next;
     }
+    releaseReservation();
+    UAVCAN_ASSERT(num_shared_links_ == 0);
 }
 
 void CanTxQueue::registerRejectedFrame()
@@ -105,7 +108,260 @@ void CanTxQueue::registerRejectedFrame()
     }
 }
 
-void CanTxQueue::push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags)
+void CanTxQueue::registerDeadlineMiss()
+{
+    if (deadline_miss_cnt_ < NumericTraits<uint32_t>::max())
+    {
+        deadline_miss_cnt_++;
+    }
+    registerRejectedFrame();
+}
+
+#if UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING
+const CanTxQueue::Entry* CanTxQueue::findUrgentEntry(MonotonicTime timestamp,
+                                                     MonotonicTime& out_earliest_deadline) const
+{
+    out_earliest_deadline = earliest_deadline_;
+    if (!urgency_window_.isPositive() || !(earliest_deadline_ < timestamp + urgency_window_))
+    {
+        return UAVCAN_NULLPTR;      // Nothing can be urgent, no need to walk the list
+    }
+
+    out_earliest_deadline = MonotonicTime::getMax();
+    const Entry* urgent = UAVCAN_NULLPTR;
+    for (const Entry* p = head_; p != UAVCAN_NULLPTR; p = getNextEntry(p))
+    {
+        out_earliest_deadline = min(out_earliest_deadline, p->deadline);
+        if (!p->isExpired(timestamp) && (p->deadline < timestamp + urgency_window_) &&
+            ((urgent == UAVCAN_NULLPTR) || (p->deadline < urgent->deadline)))
+        {
+            urgent = p;
+        }
+    }
+    if (urgent == UAVCAN_NULLPTR)
+    {
+        return UAVCAN_NULLPTR;
+    }
+
+    // Entries of the same CAN ID are kept in the order of insertion, the first one of them must go first
+    for (const Entry* p = head_; p != urgent; p = getNextEntry(p))
+    {
+        if (p->frame.id == urgent->frame.id)
+        {
+            return p;
+        }
+    }
+    return urgent;
+}
+
+CanTxQueue::Entry* CanTxQueue::findUrgentEntry(MonotonicTime timestamp)
+{
+    MonotonicTime earliest_deadline;
+    const Entry* const urgent = static_cast<const CanTxQueue*>(this)->findUrgentEntry(timestamp, earliest_deadline);
+    earliest_deadline_ = earliest_deadline;     // The walk has made it exact
+    return const_cast<Entry*>(urgent);
+}
+
+bool CanTxQueue::isBandBacklogFull(const CanFrame& frame) const
+{
+    const uint8_t band = getPriorityBand(frame);
+    return (band_limits_[band] > 0) && (band_backlogs_[band] >= band_limits_[band]);
+}
+#endif
+
+uint8_t CanTxQueue::getPriorityBucket(const CanFrame& frame)
+{
+    // 5 most significant bits of the 11-bit arbitration field, the same for STD and EXT frames
+    const uint32_t clean_id = frame.id & CanFrame::MaskExtID;
+    const uint32_t arb11 = frame.isExtended() ? (clean_id >> 18) : (clean_id & CanFrame::MaskStdID);
+    return uint8_t((arb11 >> 6) & (NumPriorityBuckets - 1U));
+}
+
+CanTxQueue::Entry* CanTxQueue::findBucketPredecessor(uint8_t bucket) const
+{
+    for (int i = int(bucket) - 1; i >= 0; i--)
+    {
+        if (bucket_mask_ & (1U << i))
+        {
+            return bucket_tails_[i];
+        }
+    }
+    return UAVCAN_NULLPTR;
+}
+
+void CanTxQueue::link(Entry* entry, Entry* prev)
+{
+    UAVCAN_ASSERT(!entry->isLinkedInto(index_));
+    Entry*& next = (prev == UAVCAN_NULLPTR) ? head_ : prev->next_links[index_];
+    entry->next_links[index_] = next;
+    next = entry;
+    entry->links = uint8_t(entry->links | (1U << index_));
+}
+
+void CanTxQueue::unlink(Entry* entry)
+{
+    UAVCAN_ASSERT(entry->isLinkedInto(index_));
+    const uint8_t bucket = getPriorityBucket(entry->frame);
+
+    // The predecessor can't be further than the tail of the previous bucket
+    Entry* const bucket_prev = findBucketPredecessor(bucket);
+    Entry* prev = bucket_prev;
+    Entry* p = (prev == UAVCAN_NULLPTR) ? head_ : getNextEntry(prev);
+    while ((p != UAVCAN_NULLPTR) && (p != entry))
+    {
+        prev = p;
+        p = getNextEntry(p);
+    }
+    UAVCAN_ASSERT(p == entry);
+
+    if (bucket_tails_[bucket] == entry)
+    {
+        if (prev == bucket_prev)
+        {
+            bucket_tails_[bucket] = UAVCAN_NULLPTR;     // That was the only entry in the bucket
+            bucket_mask_ &= ~(1U << bucket);
+        }
+        else
+        {
+            bucket_tails_[bucket] = prev;
+        }
+    }
+
+    Entry*& link_to_entry = (prev == UAVCAN_NULLPTR) ? head_ : prev->next_links[index_];
+    link_to_entry = getNextEntry(entry);
+    entry->next_links[index_] = UAVCAN_NULLPTR;
+    entry->links = uint8_t(entry->links & ~(1U << index_));
+
+#if UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING
+    UAVCAN_ASSERT(band_backlogs_[getPriorityBand(entry->frame)] > 0);
+    band_backlogs_[getPriorityBand(entry->frame)]--;
+#endif
+}
+
+void CanTxQueue::insert(Entry* entry, bool ahead_of_equal)
+{
+    const uint8_t bucket = getPriorityBucket(entry->frame);
+    Entry* const tail = bucket_tails_[bucket];
+
+#if UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING
+    band_backlogs_[getPriorityBand(entry->frame)]++;
+#endif
+    if (observer_ != UAVCAN_NULLPTR)
+    {
+        observer_->handleTxQueueChange(entry->frame.id, true);
+    }
+
+    if (tail == UAVCAN_NULLPTR)
+    {
+        // New bucket goes right after the nearest bucket of higher priority
+        link(entry, findBucketPredecessor(bucket));
+        bucket_tails_[bucket] = entry;
+        bucket_mask_ |= 1U << bucket;
+    }
+    else if (!ahead_of_equal && !entry->frame.priorityHigherThan(tail->frame))
+    {
+        // The most common case - equal or lower priority than anything else in the bucket
+        link(entry, tail);
+        bucket_tails_[bucket] = entry;
+    }
+    else
+    {
+        // The new frame overtakes some entries of the bucket
+        Entry* prev = findBucketPredecessor(bucket);
+        Entry* p = (prev == UAVCAN_NULLPTR) ? head_ : getNextEntry(prev);
+        while ((p != UAVCAN_NULLPTR) && (ahead_of_equal ? p->frame.priorityHigherThan(entry->frame)
+                                                        : !entry->frame.priorityHigherThan(p->frame)))
+        {
+            prev = p;
+            p = getNextEntry(p);
+        }
+        link(entry, prev);
+        if (prev == tail)
+        {
+            bucket_tails_[bucket] = entry;      // Only possible if everything in the bucket has higher priority
+        }
+    }
+}
+
+void* CanTxQueue::allocateEntry(std::size_t size)
+{
+    if (reserved_blocks_ != UAVCAN_NULLPTR)
+    {
+        ReservedBlock* const block = reserved_blocks_;
+        reserved_blocks_ = block->next;
+        num_reserved_blocks_--;
+        return block;
+    }
+    return allocator_.allocateUnreserved(size);
+}
+
+bool CanTxQueue::reserve(unsigned num_entries, bool use_guaranteed_blocks)
+{
+    ReservedBlock* list = UAVCAN_NULLPTR;
+    unsigned num_allocated = 0;
+    bool cleaned_up = false;
+
+    while (num_allocated < num_entries)
+    {
+        void* const praw = use_guaranteed_blocks ? allocator_.allocate(sizeof(Entry))
+                                                 : allocator_.allocateUnreserved(sizeof(Entry));
+        if (praw != UAVCAN_NULLPTR)
+        {
+            ReservedBlock* const block = new (praw) ReservedBlock;
+            block->next = list;
+            list = block;
+            num_allocated++;
+        }
+        else if (!cleaned_up)
+        {
+            removeExpired(sysclock_.getMonotonic());
+            cleaned_up = true;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (num_allocated < num_entries)
+    {
+        UAVCAN_TRACE("CanTxQueue", "Reservation of %u entries rejected", num_entries);
+        while (list != UAVCAN_NULLPTR)
+        {
+            ReservedBlock* const next = list->next;
+            allocator_.deallocate(list);
+            list = next;
+        }
+        for (unsigned i = 0; i < num_entries; i++)
+        {
+            registerRejectedFrame();
+        }
+        return false;
+    }
+
+    while (list != UAVCAN_NULLPTR)
+    {
+        ReservedBlock* const next = list->next;
+        list->next = reserved_blocks_;
+        reserved_blocks_ = list;
+        list = next;
+    }
+    num_reserved_blocks_ = uint16_t(num_reserved_blocks_ + num_allocated);
+    return true;
+}
+
+void CanTxQueue::releaseReservation()
+{
+    while (reserved_blocks_ != UAVCAN_NULLPTR)
+    {
+        ReservedBlock* const next = reserved_blocks_->next;
+        allocator_.deallocate(reserved_blocks_);
+        reserved_blocks_ = next;
+    }
+    num_reserved_blocks_ = 0;
+}
+
+CanTxQueue::Entry* CanTxQueue::push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags)
 {
     const MonotonicTime timestamp = sysclock_.getMonotonic();
 
@@ -113,27 +369,31 @@ void CanTxQueue::push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos,
     {
         UAVCAN_TRACE("CanTxQueue", "Push rejected: already expired");
         registerRejectedFrame();
-        return;
+        return UAVCAN_NULLPTR;
+    }
+
+#if UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING
+    // Reserved memory belongs to a transfer that has been admitted as a whole
+    if ((reserved_blocks_ == UAVCAN_NULLPTR) && isBandBacklogFull(frame))
+    {
+        removeExpired(timestamp);
+        if (isBandBacklogFull(frame))
+        {
+            UAVCAN_TRACE("CanTxQueue", "Push rejected: backlog limit of band %u", unsigned(getPriorityBand(frame)));
+            registerRejectedFrame();
+            return UAVCAN_NULLPTR;
+        }
     }
+#endif
 
-    void* praw = allocator_.allocate(sizeof(Entry));
+    const std::size_t entry_size = Entry::getAllocationSize(frame);
+    void* praw = allocateEntry(entry_size);
     if (praw == UAVCAN_NULLPTR)
     {
         UAVCAN_TRACE("CanTxQueue", "Push OOM #1, cleanup");
         // No memory left in the pool, so we try to remove expired frames
-        Entry* p = queue_.get();
-        while (p)
-        {
-            Entry* const next = p->getNextListNode();
-            if (p->isExpired(timestamp))
-            {
-                UAVCAN_TRACE("CanTxQueue", "Push: Expired %s", p->toString().c_str());
-                registerRejectedFrame();
-                remove(p);
-            }
-            p = next;
-        }
-        praw = allocator_.allocate(sizeof(Entry));         // Try again
+        removeExpired(timestamp);
+        praw = allocator_.allocateUnreserved(entry_size);   // Try again
     }
 
     if (praw == UAVCAN_NULLPTR)
@@ -141,64 +401,247 @@ void CanTxQueue::push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos,
         UAVCAN_TRACE("CanTxQueue", "Push OOM #2, QoS arbitration");
         registerRejectedFrame();
 
-        // Find a frame with lowest QoS
-        Entry* p = queue_.get();
-        if (p == UAVCAN_NULLPTR)
+        // The memory of a replaced entry would go to the guaranteed blocks, so there is no point in replacing
+        if (allocator_.getNumReservedBlocks() < allocator_.getMinBlocks())
         {
-            UAVCAN_TRACE("CanTxQueue", "Push rejected: Nothing to replace");
-            return;
+            UAVCAN_TRACE("CanTxQueue", "Push rejected: guaranteed blocks are in use");
+            return UAVCAN_NULLPTR;
         }
-        Entry* lowestqos = p;
-        while (p)
+
+        // Find a frame with lowest QoS among those whose removal frees a block that can hold the new entry.
+        // Entries owned by other queues or linked into them are skipped, since removing them frees nothing.
+        Entry* lowestqos = UAVCAN_NULLPTR;
+        for (Entry* p = head_; p != UAVCAN_NULLPTR; p = getNextEntry(p))
         {
-            if (lowestqos->qosHigherThan(*p))
+            if ((p->getOwnerIndex() == index_) && p->isLinkedOnlyInto(index_) &&
+                (Entry::getAllocationSize(p->frame) >= entry_size) &&
+                ((lowestqos == UAVCAN_NULLPTR) || lowestqos->qosHigherThan(*p)))
             {
                 lowestqos = p;
             }
-            p = p->getNextListNode();
+        }
+        if (lowestqos == UAVCAN_NULLPTR)
+        {
+            UAVCAN_TRACE("CanTxQueue", "Push rejected: Nothing to replace");
+            return UAVCAN_NULLPTR;
         }
         // Note that frame with *equal* QoS will be replaced too.
         if (lowestqos->qosHigherThan(frame, qos))           // Frame that we want to transmit has lowest QoS
         {
             UAVCAN_TRACE("CanTxQueue", "Push rejected: low QoS");
-            return;                                         // What a loser.
+            return UAVCAN_NULLPTR;                          // What a loser.
         }
         UAVCAN_TRACE("CanTxQueue", "Push: Replacing %s", lowestqos->toString().c_str());
         remove(lowestqos);
-        praw = allocator_.allocate(sizeof(Entry));        // Try again
+        praw = allocator_.allocateUnreserved(entry_size);   // Try again
     }
 
     if (praw == UAVCAN_NULLPTR)
     {
-        return;                                            // Seems that there is no memory at all.
+        return UAVCAN_NULLPTR;                             // Seems that there is no memory at all.
     }
     Entry* entry = new (praw) Entry(frame, tx_deadline, qos, flags);
     UAVCAN_ASSERT(entry);
-    queue_.insertBefore(entry, PriorityInsertionComparator(frame));
+#if UAVCAN_TRANSPORT_STATS
+    entry->enqueued_usec = uint32_t(timestamp.toUSec());
+#endif
+    entry->links = uint8_t(index_ << 4);
+    insert(entry);
+    earliest_deadline_ = min(earliest_deadline_, tx_deadline);
+    UAVCAN_TRACE_POINT(TraceEventTxQueuePush, frame.id, 0, index_);
+    return entry;
+}
+
+bool CanTxQueue::pushShared(Entry* entry)
+{
+    if ((entry == UAVCAN_NULLPTR) || (group_ == UAVCAN_NULLPTR) || entry->isLinkedInto(index_) ||
+        (entry->getOwnerIndex() == index_))
+    {
+        UAVCAN_ASSERT(0);
+        return false;
+    }
+
+    const MonotonicTime timestamp = sysclock_.getMonotonic();
+    if (timestamp >= entry->deadline)
+    {
+        return false;
+    }
+    if ((getNumUsedBlocks() + num_shared_links_) >= getQuota())
+    {
+        removeExpired(timestamp);
+        if ((getNumUsedBlocks() + num_shared_links_) >= getQuota())
+        {
+            UAVCAN_TRACE("CanTxQueue", "Shared push rejected: quota");
+            return false;
+        }
+    }
+#if UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING
+    if ((reserved_blocks_ == UAVCAN_NULLPTR) && isBandBacklogFull(entry->frame))
+    {
+        removeExpired(timestamp);
+        if (isBandBacklogFull(entry->frame))
+        {
+            UAVCAN_TRACE("CanTxQueue", "Shared push rejected: backlog limit");
+            return false;
+        }
+    }
+#endif
+
+    insert(entry);
+    num_shared_links_++;
+    earliest_deadline_ = min(earliest_deadline_, entry->deadline);
+    UAVCAN_TRACE_POINT(TraceEventTxQueuePush, entry->frame.id, 0, index_);
+    return true;
+}
+
+CanTxQueue::Entry* CanTxQueue::requeue(const CanFrame& frame, MonotonicTime tx_deadline, CanIOFlags flags)
+{
+    void* const praw = allocator_.allocateUnreserved(Entry::getAllocationSize(frame));
+    if (praw == UAVCAN_NULLPTR)
+    {
+        UAVCAN_TRACE("CanTxQueue", "Requeue rejected: OOM");
+        registerRejectedFrame();
+        return UAVCAN_NULLPTR;
+    }
+    Entry* const entry = new (praw) Entry(frame, tx_deadline, Persistent, flags);
+#if UAVCAN_TRANSPORT_STATS
+    entry->enqueued_usec = uint32_t(sysclock_.getMonotonic().toUSec());
+#endif
+    entry->links = uint8_t(index_ << 4);
+    insert(entry, true);
+    earliest_deadline_ = min(earliest_deadline_, tx_deadline);
+    UAVCAN_TRACE_POINT(TraceEventTxQueuePush, frame.id, 0, index_);
+    return entry;
+}
+
+void CanTxQueue::removeExpired(MonotonicTime timestamp)
+{
+    if (!(timestamp > earliest_deadline_))
+    {
+        return;         // Nothing could have expired yet
+    }
+    MonotonicTime earliest = MonotonicTime::getMax();
+    Entry* p = head_;
+    while (p)
+    {
+        Entry* const next = getNextEntry(p);
+        if (p->isExpired(timestamp))
+        {
+            UAVCAN_TRACE("CanTxQueue", "Expired %s", p->toString().c_str());
+            registerDeadlineMiss();
+            remove(p);
+        }
+        else
+        {
+            earliest = min(earliest, p->deadline);
+        }
+        p = next;
+    }
+    earliest_deadline_ = earliest;
+}
+
+void CanTxQueue::cleanup(MonotonicTime timestamp)
+{
+    removeExpired(timestamp);
+}
+
+unsigned CanTxQueue::removeMatching(uint32_t can_id, uint32_t can_id_mask)
+{
+    can_id &= can_id_mask;
+    unsigned num_removed = 0;
+    Entry* p = head_;
+    while (p)
+    {
+        Entry* const next = getNextEntry(p);
+        if ((p->frame.id & can_id_mask) == can_id)
+        {
+            UAVCAN_TRACE("CanTxQueue", "Superseded %s", p->toString().c_str());
+            remove(p);
+            num_removed++;
+        }
+        p = next;
+    }
+    return num_removed;
 }
 
 CanTxQueue::Entry* CanTxQueue::peek()
 {
     const MonotonicTime timestamp = sysclock_.getMonotonic();
-    Entry* p = queue_.get();
+#if UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING
+    if (urgency_window_.isPositive())
+    {
+        removeExpired(timestamp);
+        Entry* const urgent = findUrgentEntry(timestamp);
+        if (urgent != UAVCAN_NULLPTR)
+        {
+            UAVCAN_TRACE_POINT(TraceEventTxQueuePeek, urgent->frame.id, 0, index_);
+            return urgent;
+        }
+    }
+#endif
+    Entry* p = head_;
     while (p)
     {
         if (p->isExpired(timestamp))
         {
             UAVCAN_TRACE("CanTxQueue", "Peek: Expired %s", p->toString().c_str());
-            Entry* const next = p->getNextListNode();
-            registerRejectedFrame();
+            Entry* const next = getNextEntry(p);
+            registerDeadlineMiss();
             remove(p);
             p = next;
         }
         else
         {
+            UAVCAN_TRACE_POINT(TraceEventTxQueuePeek, p->frame.id, 0, index_);
             return p;
         }
     }
     return UAVCAN_NULLPTR;
 }
 
+unsigned CanTxQueue::peekBatch(Entry** out_entries, unsigned max_entries, const CanFrame* priority_threshold)
+{
+    UAVCAN_ASSERT(out_entries != UAVCAN_NULLPTR);
+    const MonotonicTime timestamp = sysclock_.getMonotonic();
+#if UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING
+    if (urgency_window_.isPositive() && (max_entries > 0))
+    {
+        removeExpired(timestamp);
+        Entry* const urgent = findUrgentEntry(timestamp);
+        if (urgent != UAVCAN_NULLPTR)
+        {
+            // The urgent entry is fetched alone; the next call will look for the next urgent one
+            UAVCAN_TRACE_POINT(TraceEventTxQueuePeek, urgent->frame.id, 0, index_);
+            out_entries[0] = urgent;
+            return 1;
+        }
+    }
+#endif
+    unsigned num_entries = 0;
+    Entry* p = head_;
+    while ((p != UAVCAN_NULLPTR) && (num_entries < max_entries))
+    {
+        Entry* const next = getNextEntry(p);
+        if (p->isExpired(timestamp))
+        {
+            UAVCAN_TRACE("CanTxQueue", "Peek: Expired %s", p->toString().c_str());
+            registerDeadlineMiss();
+            remove(p);
+        }
+        else
+        {
+            if ((priority_threshold != UAVCAN_NULLPTR) && priority_threshold->priorityHigherThan(p->frame))
+            {
+                break;      // The queue is sorted, the rest is of lower priority as well
+            }
+            UAVCAN_TRACE_POINT(TraceEventTxQueuePeek, p->frame.id, 0, index_);
+            out_entries[num_entries++] = p;
+        }
+        p = next;
+    }
+    return num_entries;
+}
+
 void CanTxQueue::remove(Entry*& entry)
 {
     if (entry == UAVCAN_NULLPTR)
@@ -206,62 +649,236 @@ void CanTxQueue::remove(Entry*& entry)
         UAVCAN_ASSERT(0);
         return;
     }
-    queue_.remove(entry);
-    Entry::destroy(entry, allocator_);
+    UAVCAN_TRACE_POINT(TraceEventTxQueueRemove, entry->frame.id, 0, index_);
+
+    unlink(entry);
+    if (observer_ != UAVCAN_NULLPTR)
+    {
+        observer_->handleTxQueueChange(entry->frame.id, false);
+    }
+
+    const uint8_t owner_index = entry->getOwnerIndex();
+    if (owner_index != index_)
+    {
+        UAVCAN_ASSERT(num_shared_links_ > 0);
+        num_shared_links_--;
+    }
+
+    if (entry->isLinked())
+    {
+        entry = UAVCAN_NULLPTR;                         // Still queued elsewhere
+    }
+    else if (owner_index == index_)
+    {
+        Entry::destroy(entry, allocator_);
+    }
+    else
+    {
+        UAVCAN_ASSERT((group_ != UAVCAN_NULLPTR) && (group_[owner_index] != UAVCAN_NULLPTR));
+        Entry::destroy(entry, group_[owner_index]->allocator_);
+    }
+
+    if (head_ == UAVCAN_NULLPTR)
+    {
+        earliest_deadline_ = MonotonicTime::getMax();
+    }
+}
+
+const CanFrame* CanTxQueue::getTopPriorityPendingFrame() const
+{
+#if UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING
+    MonotonicTime unused;
+    const Entry* const urgent = findUrgentEntry(sysclock_.getMonotonic(), unused);
+    if (urgent != UAVCAN_NULLPTR)
+    {
+        return &getCompleteFrame(*urgent);
+    }
+#endif
+    return (head_ == UAVCAN_NULLPTR) ? UAVCAN_NULLPTR : &getCompleteFrame(*head_);
+}
+
+bool CanTxQueue::topPriorityHigherOrEqual(const CanFrame& rhs_frame) const
+{
+    const Entry* entry = head_;
+    if (entry == UAVCAN_NULLPTR)
+    {
+        return false;
+    }
+#if UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING
+    MonotonicTime unused;
+    if (findUrgentEntry(sysclock_.getMonotonic(), unused) != UAVCAN_NULLPTR)
+    {
+        return true;        // An urgent entry goes before any new frame
+    }
+#endif
+    return !rhs_frame.priorityHigherThan(entry->frame);
+}
+
+/*
+ * CanIOManager
+ */
+int CanIOManager::sendToIface(uint8_t iface_index, const CanFrame& frame, MonotonicTime tx_deadline, CanIOFlags flags)
+{
+    UAVCAN_ASSERT(iface_index < MaxCanIfaces);
+    ICanIface* const iface = driver_.getIface(iface_index);
+    if (iface == UAVCAN_NULLPTR)
+    {
+        UAVCAN_ASSERT(0);   // Nonexistent interface
+        return -ErrLogic;
+    }
+    const int res = iface->send(frame, tx_deadline, flags);
+    if (res != 1)
+    {
+        UAVCAN_TRACE("CanIOManager", "Send failed: code %i, iface %i, frame %s",
+                     res, iface_index, frame.toString().c_str());
+    }
+    if (res > 0)
+    {
+        counters_[iface_index].frames_tx += unsigned(res);
+        const CanFrame* const frames[] = { &frame };
+        registerBusLoad(iface_index, frames, 1);
+    }
+    return res;
+}
+
+int CanIOManager::sendToIfacePreempting(uint8_t iface_index, const CanFrame& frame, MonotonicTime tx_deadline,
+                                        CanIOFlags flags)
+{
+    int res = sendToIface(iface_index, frame, tx_deadline, flags);
+    if (res != 0)
+    {
+        return res;
+    }
+
+    // The driver is full; it may let the frame take the place of a frame of lower priority
+    ICanIface* const iface = driver_.getIface(iface_index);
+    CanFrame aborted_frame;
+    MonotonicTime aborted_deadline;
+    CanIOFlags aborted_flags = 0;
+    if (iface->abortLowerPriority(frame, aborted_frame, aborted_deadline, aborted_flags) <= 0)
+    {
+        return 0;
+    }
+    UAVCAN_ASSERT(frame.priorityHigherThan(aborted_frame));
+    UAVCAN_TRACE("CanIOManager", "Aborted %s on iface %i", aborted_frame.toString().c_str(), int(iface_index));
+
+    if (counters_[iface_index].frames_tx > 0)
+    {
+        counters_[iface_index].frames_tx--;         // It will be counted again once it is accepted again
+    }
+    res = sendToIface(iface_index, frame, tx_deadline, flags);
+    (void)tx_queues_[iface_index]->requeue(aborted_frame, aborted_deadline, aborted_flags);
+    return res;
+}
+
+int CanIOManager::sendTxQueueEntry(uint8_t iface_index, CanTxQueue::Entry* entry)
+{
+#if UAVCAN_CAN_TX_QUEUE_COMPACT_ENTRIES
+    CanFrame storage;
+    const CanFrame& frame = entry->getCompleteFrame(storage);
+#else
+    const CanFrame& frame = entry->frame;
+#endif
+    const int res = sendToIfacePreempting(iface_index, frame, entry->deadline, entry->flags);
+    if (res > 0)
+    {
+        registerTxQueueWait(&entry, 1);
+        tx_queues_[iface_index]->remove(entry);
+    }
+    return res;
 }
 
-const CanFrame* CanTxQueue::getTopPriorityPendingFrame() const
+#if UAVCAN_BUS_LOAD_ESTIMATION
+void CanIOManager::registerBusLoad(uint8_t iface_index, const CanFrame* const* frames, unsigned num_frames)
 {
-    return (queue_.get() == UAVCAN_NULLPTR) ? UAVCAN_NULLPTR : &queue_.get()->frame;
+    const MonotonicTime ts = sysclock_.getMonotonic();
+    for (unsigned i = 0; i < num_frames; i++)
+    {
+        bus_load_[iface_index].addFrame(*frames[i], ts);
+    }
 }
+#endif
 
-bool CanTxQueue::topPriorityHigherOrEqual(const CanFrame& rhs_frame) const
+#if UAVCAN_TRANSPORT_STATS
+void CanIOManager::registerTxQueueWait(CanTxQueue::Entry* const* entries, unsigned num_entries)
 {
-    const Entry* entry = queue_.get();
-    if (entry == UAVCAN_NULLPTR)
+    const uint32_t now_usec = uint32_t(sysclock_.getMonotonic().toUSec());
+    for (unsigned i = 0; i < num_entries; i++)
     {
-        return false;
+        // Modular arithmetic handles the wraparound of the lower 32 bits of the timestamps
+        tx_queue_wait_.add(MonotonicDuration::fromUSec(int64_t(uint32_t(now_usec - entries[i]->enqueued_usec))));
     }
-    return !rhs_frame.priorityHigherThan(entry->frame);
 }
+#endif
 
-/*
- * CanIOManager
- */
-int CanIOManager::sendToIface(uint8_t iface_index, const CanFrame& frame, MonotonicTime tx_deadline, CanIOFlags flags)
+int CanIOManager::sendFromTxQueue(uint8_t iface_index, const CanFrame* priority_threshold)
 {
     UAVCAN_ASSERT(iface_index < MaxCanIfaces);
+    CanTxQueue::Entry* entries[UAVCAN_CAN_TX_BATCH_SIZE];
+    const unsigned num_entries = tx_queues_[iface_index]->peekBatch(entries, UAVCAN_CAN_TX_BATCH_SIZE,
+                                                                    priority_threshold);
+    if (num_entries == 0)
+    {
+        return 0;
+    }
+    if (num_entries == 1)
+    {
+        return sendTxQueueEntry(iface_index, entries[0]);
+    }
+
     ICanIface* const iface = driver_.getIface(iface_index);
     if (iface == UAVCAN_NULLPTR)
     {
         UAVCAN_ASSERT(0);   // Nonexistent interface
         return -ErrLogic;
     }
-    const int res = iface->send(frame, tx_deadline, flags);
-    if (res != 1)
+
+    const CanFrame* frames[UAVCAN_CAN_TX_BATCH_SIZE];
+    MonotonicTime deadlines[UAVCAN_CAN_TX_BATCH_SIZE];
+    CanIOFlags flags[UAVCAN_CAN_TX_BATCH_SIZE];
+#if UAVCAN_CAN_TX_QUEUE_COMPACT_ENTRIES
+    LazyConstructor<CanFrame> complete_frames[UAVCAN_CAN_TX_BATCH_SIZE];   // Only for the compact entries
+#endif
+    for (unsigned i = 0; i < num_entries; i++)
     {
-        UAVCAN_TRACE("CanIOManager", "Send failed: code %i, iface %i, frame %s",
-                     res, iface_index, frame.toString().c_str());
+#if UAVCAN_CAN_TX_QUEUE_COMPACT_ENTRIES
+        if (entries[i]->isCompact())
+        {
+            const CanFrame& f = entries[i]->frame;
+            complete_frames[i].construct<uint32_t, const uint8_t*, uint8_t, bool>(f.id, f.data, f.getDataLength(),
+                                                                                  f.canfd);
+            frames[i] = &*complete_frames[i];
+        }
+        else
+        {
+            frames[i] = &entries[i]->frame;
+        }
+#else
+        frames[i] = &entries[i]->frame;
+#endif
+        deadlines[i] = entries[i]->deadline;
+        flags[i] = entries[i]->flags;
     }
-    if (res > 0)
+
+    const int res = iface->sendBatch(frames, deadlines, flags, uint16_t(num_entries));
+    if (res == 0)
     {
-        counters_[iface_index].frames_tx += unsigned(res);
+        return sendTxQueueEntry(iface_index, entries[0]);     // The top entry may still preempt a held frame
     }
-    return res;
-}
-
-int CanIOManager::sendFromTxQueue(uint8_t iface_index)
-{
-    UAVCAN_ASSERT(iface_index < MaxCanIfaces);
-    CanTxQueue::Entry* entry = tx_queues_[iface_index]->peek();
-    if (entry == UAVCAN_NULLPTR)
+    if (res < 0)
     {
-        return 0;
+        UAVCAN_TRACE("CanIOManager", "Batch send failed: code %i, iface %i, %u frames",
+                     res, iface_index, num_entries);
+        return res;
     }
-    const int res = sendToIface(iface_index, entry->frame, entry->deadline, entry->flags);
-    if (res > 0)
+    UAVCAN_ASSERT(unsigned(res) <= num_entries);
+
+    counters_[iface_index].frames_tx += unsigned(res);
+    registerTxQueueWait(entries, min(unsigned(res), num_entries));
+    registerBusLoad(iface_index, frames, min(unsigned(res), num_entries));
+    for (int i = 0; (i < res) && (unsigned(i) < num_entries); i++)
     {
-        tx_queues_[iface_index]->remove(entry);
+        tx_queues_[iface_index]->remove(entries[i]);
     }
     return res;
 }
@@ -287,6 +904,10 @@ CanIOManager::CanIOManager(ICanDriver& driver, IPoolAllocator& allocator, ISyste
     : driver_(driver)
     , sysclock_(sysclock)
     , num_ifaces_(driver.getNumIfaces())
+#if UAVCAN_CAN_IFACE_HEALTH_TRACKING
+    , iface_probe_interval_(MonotonicDuration::fromMSec(DefaultIfaceProbeIntervalMs))
+    , tx_excluded_mask_(0)
+#endif
 {
     if (num_ifaces_ < 1 || num_ifaces_ > MaxCanIfaces)
     {
@@ -300,11 +921,178 @@ CanIOManager::CanIOManager(ICanDriver& driver, IPoolAllocator& allocator, ISyste
     UAVCAN_TRACE("CanIOManager", "Memory blocks per iface: %u, total: %u",
                  unsigned(mem_blocks_per_iface), unsigned(allocator.getBlockCapacity()));
 
+#if UAVCAN_CAN_TX_QUEUE_SHARED_ENTRIES
+    fill(tx_queue_group_, tx_queue_group_ + MaxCanIfaces, static_cast<CanTxQueue*>(UAVCAN_NULLPTR));
+    for (uint8_t i = 0; i < num_ifaces_; i++)
+    {
+        tx_queues_[i].construct<IPoolAllocator&, ISystemClock&, std::size_t, CanTxQueue* const*, uint8_t>
+        (allocator, sysclock, mem_blocks_per_iface, tx_queue_group_, i);
+        tx_queue_group_[i] = &*tx_queues_[i];
+    }
+#else
     for (int i = 0; i < num_ifaces_; i++)
     {
         tx_queues_[i].construct<IPoolAllocator&, ISystemClock&, std::size_t>
         (allocator, sysclock, mem_blocks_per_iface);
     }
+#endif
+
+#if UAVCAN_CAN_TX_QUEUE_GUARANTEED_QUOTA_PERCENT < 100
+    tx_quota_initial_ = tx_queues_[0]->getQuota();
+    tx_quota_guaranteed_ = uint16_t(max<uint32_t>(1U, uint32_t(tx_quota_initial_) *
+                                                      UAVCAN_CAN_TX_QUEUE_GUARANTEED_QUOTA_PERCENT / 100U));
+#endif
+}
+
+void CanIOManager::rebalanceTxQuotas()
+{
+#if UAVCAN_CAN_TX_QUEUE_GUARANTEED_QUOTA_PERCENT < 100
+    const uint8_t num_ifaces = getNumIfaces();
+    if (num_ifaces < 2)
+    {
+        return;
+    }
+
+    /*
+     * Every queue keeps the blocks it is using and the guaranteed minimum; the rest of the total is split between
+     * the queues that are congested but still transmitting. If there are none, the queues are topped up towards
+     * their initial quotas instead, so that the quotas converge back once the congestion is gone. Queues of stuck
+     * interfaces can't borrow, because the borrowed blocks would only hold frames until they expire.
+     * The sum of the quotas always equals the total, and every quota is not less than the guaranteed minimum and
+     * the number of used blocks, hence the sum of the floors never exceeds the total.
+     */
+    const uint32_t total = uint32_t(tx_quota_initial_) * num_ifaces;
+    uint32_t floors[MaxCanIfaces] = {};
+    bool congested[MaxCanIfaces] = {};
+    uint32_t reserved = 0;
+    unsigned num_congested = 0;
+
+    for (uint8_t i = 0; i < num_ifaces; i++)
+    {
+        const CanTxQueue& q = *tx_queues_[i];
+        const TxQuotaSnapshot& snapshot = tx_quota_snapshots_[i];
+        const bool backlogged = (q.getRejectedFrameCount() != snapshot.rejected_frames) ||
+                                (q.getNumUsedBlocks() >= q.getQuota());
+        const bool transmitting = counters_[i].frames_tx != snapshot.frames_tx;
+        congested[i] = backlogged && transmitting;
+        num_congested += congested[i] ? 1U : 0U;
+
+        floors[i] = max<uint32_t>(tx_quota_guaranteed_, q.getNumUsedBlocks());
+        reserved += floors[i];
+    }
+    UAVCAN_ASSERT(reserved <= total);
+
+    uint32_t spare = (total > reserved) ? (total - reserved) : 0U;
+    const uint32_t share = (num_congested > 0) ? (spare / num_congested) : 0U;
+    uint32_t remainder = (num_congested > 0) ? (spare % num_congested) : 0U;
+
+    for (uint8_t i = 0; i < num_ifaces; i++)
+    {
+        uint32_t quota = floors[i];
+        if (num_congested == 0)
+        {
+            const uint32_t top_up = min(spare, (tx_quota_initial_ > quota) ? (tx_quota_initial_ - quota) : 0U);
+            quota += top_up;
+            spare -= top_up;
+        }
+        else if (congested[i])
+        {
+            quota += share;
+            if (remainder > 0)
+            {
+                quota++;
+                remainder--;
+            }
+        }
+        if (quota != tx_queues_[i]->getQuota())
+        {
+            UAVCAN_TRACE("CanIOManager", "TX quota of iface %i: %u -> %u",
+                         int(i), unsigned(tx_queues_[i]->getQuota()), unsigned(quota));
+            tx_queues_[i]->setQuota(quota);
+        }
+    }
+#endif
+}
+
+void CanIOManager::updateIfaceHealth(MonotonicTime ts)
+{
+#if UAVCAN_CAN_IFACE_HEALTH_TRACKING
+    const uint8_t num_ifaces = getNumIfaces();
+    if ((num_ifaces < 2) || !iface_probe_interval_.isPositive())
+    {
+        return;
+    }
+
+    for (uint8_t i = 0; i < num_ifaces; i++)
+    {
+        IfaceHealth& health = iface_health_[i];
+        CanTxQueue& q = *tx_queues_[i];
+        const ICanIface* const iface = driver_.getIface(i);
+        const uint64_t error_count = (iface == UAVCAN_NULLPTR) ? 0U : iface->getErrorCount();
+
+        const bool errors_rising = error_count > health.error_count;
+        const bool transmitting = counters_[i].frames_tx != health.frames_tx;
+        const bool backlogged = !q.isEmpty() || (q.getRejectedFrameCount() != health.rejected_frames);
+
+        if (tx_excluded_mask_ & (1U << i))
+        {
+            if (ts >= health.probe_ts)
+            {
+                UAVCAN_TRACE("CanIOManager", "Iface %i is probed for recovery", int(i));
+                tx_excluded_mask_ = uint8_t(tx_excluded_mask_ & ~(1U << i));
+            }
+        }
+        else if (errors_rising && backlogged && !transmitting)
+        {
+            const uint8_t included_mask = uint8_t(((1U << num_ifaces) - 1U) & ~tx_excluded_mask_);
+            if ((included_mask & ~(1U << i)) != 0)      // There is another one to carry the traffic
+            {
+                const unsigned num_flushed = q.removeMatching(0, 0);
+                UAVCAN_TRACE("CanIOManager", "Iface %i excluded from TX, %u frames flushed", int(i), num_flushed);
+                (void)num_flushed;
+                tx_excluded_mask_ = uint8_t(tx_excluded_mask_ | (1U << i));
+                health.probe_ts = ts + iface_probe_interval_;
+            }
+        }
+
+        health.error_count = error_count;
+        health.frames_tx = counters_[i].frames_tx;
+        health.rejected_frames = q.getRejectedFrameCount();
+    }
+#else
+    (void)ts;
+#endif
+}
+
+MonotonicDuration CanIOManager::getIfaceProbeInterval() const
+{
+#if UAVCAN_CAN_IFACE_HEALTH_TRACKING
+    return iface_probe_interval_;
+#else
+    return MonotonicDuration();
+#endif
+}
+
+void CanIOManager::setIfaceProbeInterval(MonotonicDuration interval)
+{
+#if UAVCAN_CAN_IFACE_HEALTH_TRACKING
+    iface_probe_interval_ = interval.isPositive() ? interval : MonotonicDuration();
+    if (!iface_probe_interval_.isPositive())
+    {
+        tx_excluded_mask_ = 0;
+    }
+#else
+    (void)interval;
+#endif
+}
+
+uint8_t CanIOManager::getTxExcludedIfaceMask() const
+{
+#if UAVCAN_CAN_IFACE_HEALTH_TRACKING
+    return tx_excluded_mask_;
+#else
+    return 0;
+#endif
 }
 
 uint8_t CanIOManager::makePendingTxMask() const
@@ -320,6 +1108,140 @@ uint8_t CanIOManager::makePendingTxMask() const
     return write_mask;
 }
 
+uint8_t CanIOManager::reserveTxQueues(uint8_t iface_mask, unsigned num_frames, bool use_guaranteed_blocks)
+{
+    uint8_t admitted = 0;
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
+    {
+        if ((iface_mask & (1 << i)) == 0)
+        {
+            continue;
+        }
+        CanTxQueue& q = *tx_queues_[i];
+        if (getTxExcludedIfaceMask() & (1 << i))
+        {
+            admitted = uint8_t(admitted | (1 << i));    // Nothing to reserve, send() will skip it
+        }
+        else if (num_frames > q.getQuota())
+        {
+            UAVCAN_TRACE("CanIOManager", "Transfer of %u frames exceeds the TX quota of iface %i",
+                         num_frames, int(i));
+            admitted = uint8_t(admitted | (1 << i));
+        }
+        else if (q.reserve(num_frames, use_guaranteed_blocks))
+        {
+            admitted = uint8_t(admitted | (1 << i));
+        }
+        else
+        {
+            rebalanceTxQuotas();        // Same as in send(), the rejection may have made this queue a borrower
+        }
+    }
+    return admitted;
+}
+
+void CanIOManager::releaseTxQueueReservations(uint8_t iface_mask)
+{
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
+    {
+        if (iface_mask & (1 << i))
+        {
+            tx_queues_[i]->releaseReservation();
+        }
+    }
+}
+
+int CanIOManager::addTxQueueMinBlocks(unsigned num_blocks)
+{
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
+    {
+        CanTxQueue& q = *tx_queues_[i];
+        if (!q.setMinBlocks(q.getMinBlocks() + num_blocks))
+        {
+            UAVCAN_TRACE("CanIOManager", "Failed to guarantee %u more TX blocks to iface %i",
+                         num_blocks, int(i));
+            for (uint8_t k = 0; k < i; k++)
+            {
+                CanTxQueue& rq = *tx_queues_[k];
+                (void)rq.setMinBlocks(rq.getMinBlocks() - num_blocks);
+            }
+            return -ErrMemory;
+        }
+    }
+    return 0;
+}
+
+void CanIOManager::removeTxQueueMinBlocks(unsigned num_blocks)
+{
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
+    {
+        CanTxQueue& q = *tx_queues_[i];
+        UAVCAN_ASSERT(q.getMinBlocks() >= num_blocks);
+        (void)q.setMinBlocks((q.getMinBlocks() > num_blocks) ? (q.getMinBlocks() - num_blocks) : 0U);
+    }
+}
+
+uint16_t CanIOManager::getTxQueueQuota(uint8_t iface_index) const
+{
+    if (iface_index >= getNumIfaces())
+    {
+        UAVCAN_ASSERT(0);
+        return 0;
+    }
+    return tx_queues_[iface_index]->getQuota();
+}
+
+uint16_t CanIOManager::getTxQueueNumUsedBlocks(uint8_t iface_index) const
+{
+    if (iface_index >= getNumIfaces())
+    {
+        UAVCAN_ASSERT(0);
+        return 0;
+    }
+    return tx_queues_[iface_index]->getNumUsedBlocks();
+}
+
+void CanIOManager::cleanup(MonotonicTime ts)
+{
+    updateIfaceHealth(ts);      // Before the expired frames are dropped, they are a sign of the backlog
+
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
+    {
+        tx_queues_[i]->cleanup(ts);
+    }
+
+    rebalanceTxQuotas();
+
+#if UAVCAN_CAN_TX_QUEUE_GUARANTEED_QUOTA_PERCENT < 100
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
+    {
+        tx_quota_snapshots_[i].frames_tx = counters_[i].frames_tx;
+        tx_quota_snapshots_[i].rejected_frames = tx_queues_[i]->getRejectedFrameCount();
+    }
+#endif
+}
+
+unsigned CanIOManager::removeTxQueueFrames(uint32_t can_id, uint32_t can_id_mask, uint8_t iface_mask)
+{
+    unsigned num_removed = 0;
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
+    {
+        if ((iface_mask & (1 << i)) && !tx_queues_[i]->isEmpty())
+        {
+            num_removed += tx_queues_[i]->removeMatching(can_id, can_id_mask);
+        }
+    }
+    return num_removed;
+}
+
+void CanIOManager::setTxQueueObserver(ITxQueueObserver* observer)
+{
+    for (uint8_t i = 0; i < num_ifaces_; i++)
+    {
+        tx_queues_[i]->setObserver(observer);
+    }
+}
+
 CanIfacePerfCounters CanIOManager::getIfacePerfCounters(uint8_t iface_index) const
 {
     ICanIface* const iface = driver_.getIface(iface_index);
@@ -332,15 +1254,75 @@ CanIfacePerfCounters CanIOManager::getIfacePerfCounters(uint8_t iface_index) con
     cnt.errors = iface->getErrorCount() + tx_queues_[iface_index]->getRejectedFrameCount();
     cnt.frames_rx = counters_[iface_index].frames_rx;
     cnt.frames_tx = counters_[iface_index].frames_tx;
+    cnt.bus_load_percent = getBusLoadPercent(iface_index);
+    cnt.tx_deadline_misses = tx_queues_[iface_index]->getDeadlineMissCount();
     return cnt;
 }
 
+uint8_t CanIOManager::getBusLoadPercent(uint8_t iface_index) const
+{
+    if (iface_index >= num_ifaces_)
+    {
+        UAVCAN_ASSERT(0);
+        return 0;
+    }
+#if UAVCAN_BUS_LOAD_ESTIMATION
+    return bus_load_[iface_index].getLoadPercent(sysclock_.getMonotonic());
+#else
+    return 0;
+#endif
+}
+
+uint8_t CanIOManager::getMaxBusLoadPercent() const
+{
+    uint8_t res = 0;
+#if UAVCAN_BUS_LOAD_ESTIMATION
+    const MonotonicTime ts = sysclock_.getMonotonic();
+    for (uint8_t i = 0; i < num_ifaces_; i++)
+    {
+        res = max(res, bus_load_[i].getLoadPercent(ts));
+    }
+#endif
+    return res;
+}
+
+#if UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING
+void CanIOManager::setTxUrgencyWindow(MonotonicDuration window)
+{
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
+    {
+        tx_queues_[i]->setUrgencyWindow(window);
+    }
+}
+
+void CanIOManager::setTxBandBacklogLimit(uint8_t band, uint16_t max_frames)
+{
+    for (uint8_t i = 0; i < getNumIfaces(); i++)
+    {
+        tx_queues_[i]->setBandBacklogLimit(band, max_frames);
+    }
+}
+#endif
+
+void CanIOManager::setBusBitrate(uint32_t nominal_bitrate, uint32_t data_bitrate)
+{
+#if UAVCAN_BUS_LOAD_ESTIMATION
+    for (uint8_t i = 0; i < MaxCanIfaces; i++)
+    {
+        bus_load_[i].setBitrate(nominal_bitrate, data_bitrate);
+    }
+#else
+    (void)nominal_bitrate;
+    (void)data_bitrate;
+#endif
+}
+
 int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
                        uint8_t iface_mask, CanTxQueue::Qos qos, CanIOFlags flags)
 {
     const uint8_t num_ifaces = getNumIfaces();
     const uint8_t all_ifaces_mask = uint8_t((1U << num_ifaces) - 1);
-    iface_mask &= all_ifaces_mask;
+    iface_mask &= uint8_t(all_ifaces_mask & ~getTxExcludedIfaceMask());
 
     if (blocking_deadline > tx_deadline)
     {
@@ -393,11 +1375,12 @@ int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, Monoton
                 {
                     if (tx_queues_[i]->topPriorityHigherOrEqual(frame))
                     {
-                        res = sendFromTxQueue(i);                 // May return 0 if nothing to transmit (e.g. expired)
+                        // Queued frames of lower priority must not overtake the new frame
+                        res = sendFromTxQueue(i, &frame);         // May return 0 if nothing to transmit (e.g. expired)
                     }
                     if (res <= 0)
                     {
-                        res = sendToIface(i, frame, tx_deadline, flags);
+                        res = sendToIfacePreempting(i, frame, tx_deadline, flags);
                         if (res > 0)
                         {
                             iface_mask &= uint8_t(~(1 << i));     // Mark transmitted
@@ -424,13 +1407,30 @@ int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, Monoton
                 UAVCAN_TRACE("CanIOManager", "Send: Premature timeout in select(), will try again");
                 continue;
             }
+            bool rejected = false;
+            CanTxQueue::Entry* shared_entry = UAVCAN_NULLPTR;
             for (uint8_t i = 0; i < num_ifaces; i++)
             {
                 if (iface_mask & (1 << i))
                 {
-                    tx_queues_[i]->push(frame, tx_deadline, qos, flags);
+#if UAVCAN_CAN_TX_QUEUE_SHARED_ENTRIES
+                    // The same frame on several interfaces occupies one memory block, if the quotas allow
+                    if ((shared_entry != UAVCAN_NULLPTR) && tx_queues_[i]->pushShared(shared_entry))
+                    {
+                        continue;
+                    }
+#endif
+                    const uint32_t num_rejected = tx_queues_[i]->getRejectedFrameCount();
+                    CanTxQueue::Entry* const entry = tx_queues_[i]->push(frame, tx_deadline, qos, flags);
+                    shared_entry = (entry != UAVCAN_NULLPTR) ? entry : shared_entry;
+                    rejected = rejected || (tx_queues_[i]->getRejectedFrameCount() != num_rejected);
                 }
             }
+            (void)shared_entry;
+            if (rejected)
+            {
+                rebalanceTxQuotas();        // Don't wait for the next cleanup to lend more memory to this queue
+            }
             break;
         }
     }
@@ -439,6 +1439,18 @@ int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, Monoton
 
 int CanIOManager::receive(CanRxFrame& out_frame, MonotonicTime blocking_deadline, CanIOFlags& out_flags)
 {
+    return receiveBatch(&out_frame, &out_flags, 1, blocking_deadline);
+}
+
+int CanIOManager::receiveBatch(CanRxFrame* out_frames, CanIOFlags* out_flags, unsigned max_frames,
+                               MonotonicTime blocking_deadline)
+{
+    if ((out_frames == UAVCAN_NULLPTR) || (out_flags == UAVCAN_NULLPTR) || (max_frames == 0))
+    {
+        UAVCAN_ASSERT(0);
+        return -ErrInvalidParam;
+    }
+
     const uint8_t num_ifaces = getNumIfaces();
 
     while (true)
@@ -470,7 +1482,8 @@ int CanIOManager::receive(CanRxFrame& out_frame, MonotonicTime blocking_deadline
         }
 
         // Read
-        for (uint8_t i = 0; i < num_ifaces; i++)
+        unsigned num_received = 0;
+        for (uint8_t i = 0; (i < num_ifaces) && (num_received < max_frames); i++)
         {
             if (masks.read & (1 << i))
             {
@@ -481,21 +1494,48 @@ int CanIOManager::receive(CanRxFrame& out_frame, MonotonicTime blocking_deadline
                     continue;
                 }
 
-                const int res = iface->receive(out_frame, out_frame.ts_mono, out_frame.ts_utc, out_flags);
+                CanRxFrame* const frames = out_frames + num_received;
+                CanIOFlags* const flags = out_flags + num_received;
+                const uint16_t capacity = uint16_t(min(max_frames - num_received, unsigned(0xFFFFU)));
+                fill(flags, flags + capacity, CanIOFlags(0));
+
+                const int res = iface->receiveBatch(frames, flags, capacity);
+                if (res < 0)
+                {
+                    if (num_received > 0)
+                    {
+                        break;          // Deliver what has been received; the error will be reported next time
+                    }
+                    return -ErrDriver;
+                }
                 if (res == 0)
                 {
-                    UAVCAN_ASSERT(0);   // select() reported that iface has pending RX frames, but receive() returned none
+                    UAVCAN_ASSERT(0);   // select() reported pending RX frames, but the driver returned none
                     continue;
                 }
-                out_frame.iface_index = i;
+                UAVCAN_ASSERT(unsigned(res) <= capacity);
 
-                if ((res > 0) && !(out_flags & CanIOFlagLoopback))
+#if UAVCAN_BUS_LOAD_ESTIMATION
+                const MonotonicTime ts = sysclock_.getMonotonic();
+#endif
+                for (int k = 0; k < res; k++)
                 {
-                    counters_[i].frames_rx += 1;
+                    frames[k].iface_index = i;
+                    if (!(flags[k] & CanIOFlagLoopback))    // Loopback frames have been accounted for when sent
+                    {
+                        counters_[i].frames_rx += 1;
+#if UAVCAN_BUS_LOAD_ESTIMATION
+                        bus_load_[i].addFrame(frames[k], ts);
+#endif
+                    }
                 }
-                return (res < 0) ? -ErrDriver : res;
+                num_received += unsigned(res);
             }
         }
+        if (num_received > 0)
+        {
+            return int(num_received);
+        }
 
         // Timeout checked in the last order - this way we can operate with expired deadline:
         if (sysclock_.getMonotonic() >= blocking_deadline)
@@ -4,16 +4,53 @@
 
 #include <uavcan/transport/dispatcher.hpp>
 #include <uavcan/debug.hpp>
+#include <uavcan/trace.hpp>
 #include <cassert>
 
 namespace uavcan
 {
+namespace
+{
+/**
+ * Decodes the data type ID from the CAN ID of a UAVCAN frame; refer to Frame::parse() for the layout.
+ */
+inline uint16_t getDataTypeIDFromCanID(uint32_t id)
+{
+    const bool service_not_message = ((id >> 7) & 1U) != 0U;
+    if (service_not_message)
+    {
+        return static_cast<uint16_t>((id >> 16) & 0xFFU);
+    }
+    const uint16_t dtid = static_cast<uint16_t>((id >> 8) & 0xFFFFU);
+    return ((id & 0x7FU) == 0U) ? static_cast<uint16_t>(dtid & 3U) : dtid;  // Anonymous frame has a discriminator
+}
+
+inline TransferType getTransferTypeFromCanID(uint32_t id)
+{
+    if (((id >> 7) & 1U) == 0U)
+    {
+        return TransferTypeMessageBroadcast;
+    }
+    return (((id >> 15) & 1U) != 0U) ? TransferTypeServiceRequest : TransferTypeServiceResponse;
+}
+}
+
 #if !UAVCAN_TINY
 /*
  * LoopbackFrameListenerBase
  */
 void LoopbackFrameListenerBase::startListening()
 {
+    data_type_id_ = DataTypeID();
+    transfer_type_ = TransferType(NumTransferTypes);
+    dispatcher_.getLoopbackFrameListenerRegistry().add(this);
+}
+
+void LoopbackFrameListenerBase::startListening(DataTypeID data_type_id, TransferType transfer_type)
+{
+    UAVCAN_ASSERT(transfer_type < NumTransferTypes);
+    data_type_id_ = data_type_id;
+    transfer_type_ = transfer_type;
     dispatcher_.getLoopbackFrameListenerRegistry().add(this);
 }
 
@@ -30,16 +67,36 @@ bool LoopbackFrameListenerBase::isListening() const
 /*
  * LoopbackFrameListenerRegistry
  */
+void LoopbackFrameListenerRegistry::rebuildIndex()
+{
+    fill_n(dtid_bitmap_, DataTypeIDBitmapSize / 32, 0U);
+    num_unfiltered_listeners_ = 0;
+    for (const LoopbackFrameListenerBase* p = listeners_.get(); p != UAVCAN_NULLPTR; p = p->getNextListNode())
+    {
+        if (p->acceptsAllFrames())
+        {
+            num_unfiltered_listeners_++;
+        }
+        else
+        {
+            const unsigned bit = p->getDataTypeID().get() % DataTypeIDBitmapSize;
+            dtid_bitmap_[bit / 32U] |= uint32_t(1UL << (bit % 32U));
+        }
+    }
+}
+
 void LoopbackFrameListenerRegistry::add(LoopbackFrameListenerBase* listener)
 {
     UAVCAN_ASSERT(listener);
     listeners_.insert(listener);
+    rebuildIndex();
 }
 
 void LoopbackFrameListenerRegistry::remove(LoopbackFrameListenerBase* listener)
 {
     UAVCAN_ASSERT(listener);
     listeners_.remove(listener);
+    rebuildIndex();
 }
 
 bool LoopbackFrameListenerRegistry::doesExist(const LoopbackFrameListenerBase* listener) const
@@ -57,13 +114,143 @@ bool LoopbackFrameListenerRegistry::doesExist(const LoopbackFrameListenerBase* l
     return false;
 }
 
+bool LoopbackFrameListenerRegistry::isFrameOfInterest(const CanFrame& can_frame) const
+{
+    if (num_unfiltered_listeners_ > 0)
+    {
+        return true;
+    }
+    if (listeners_.isEmpty() || !can_frame.isExtended())
+    {
+        return false;
+    }
+    const unsigned bit = getDataTypeIDFromCanID(can_frame.id & CanFrame::MaskExtID) % DataTypeIDBitmapSize;
+    return (dtid_bitmap_[bit / 32U] & (1UL << (bit % 32U))) != 0;
+}
+
 void LoopbackFrameListenerRegistry::invokeListeners(RxFrame& frame)
 {
     LoopbackFrameListenerBase* p = listeners_.get();
     while (p)
     {
         LoopbackFrameListenerBase* const next = p->getNextListNode();
-        p->handleLoopbackFrame(frame);     // p may be modified
+        if (p->accepts(frame))
+        {
+            p->handleLoopbackFrame(frame);     // p may be modified
+        }
+        p = next;
+    }
+}
+
+/*
+ * TxCompletionTracker
+ */
+void TxCompletionTracker::start(DataTypeID data_type_id, TransferType transfer_type)
+{
+    UAVCAN_ASSERT(transfer_type < NumTransferTypes);
+    stop();
+    data_type_id_ = data_type_id;
+    transfer_type_ = transfer_type;
+    num_frames_completed_ = 0;
+    num_frames_in_flight_ = 0;
+    ready_pending_ = false;
+    dispatcher_.getTxCompletionTrackerRegistry().add(this);
+}
+
+void TxCompletionTracker::stop()
+{
+    dispatcher_.getTxCompletionTrackerRegistry().remove(this);
+}
+
+bool TxCompletionTracker::isStarted() const
+{
+    return dispatcher_.getTxCompletionTrackerRegistry().doesExist(this);
+}
+
+void TxCompletionTracker::handleTxQueueChange(bool queued)
+{
+    if (queued)
+    {
+        if (num_frames_in_flight_ < 0xFFFFU)
+        {
+            num_frames_in_flight_++;
+        }
+        return;
+    }
+    num_frames_completed_++;
+    if (num_frames_in_flight_ > 0)      // Zero if the frame was queued before the tracker was started
+    {
+        num_frames_in_flight_--;
+        if (num_frames_in_flight_ == ready_threshold_)
+        {
+            ready_pending_ = true;
+        }
+    }
+}
+
+/*
+ * TxCompletionTrackerRegistry
+ */
+void TxCompletionTrackerRegistry::add(TxCompletionTracker* tracker)
+{
+    UAVCAN_ASSERT(tracker);
+    trackers_.insert(tracker);
+    canio_.setTxQueueObserver(this);
+}
+
+void TxCompletionTrackerRegistry::remove(TxCompletionTracker* tracker)
+{
+    UAVCAN_ASSERT(tracker);
+    trackers_.remove(tracker);
+    if (trackers_.isEmpty())
+    {
+        canio_.setTxQueueObserver(UAVCAN_NULLPTR);
+    }
+}
+
+bool TxCompletionTrackerRegistry::doesExist(const TxCompletionTracker* tracker) const
+{
+    UAVCAN_ASSERT(tracker);
+    for (const TxCompletionTracker* p = trackers_.get(); p != UAVCAN_NULLPTR; p = p->getNextListNode())
+    {
+        if (p == tracker)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TxCompletionTrackerRegistry::handleTxQueueChange(uint32_t can_id, bool queued)
+{
+    const uint32_t id = can_id & CanFrame::MaskExtID;
+    const uint16_t dtid = getDataTypeIDFromCanID(id);
+    const TransferType transfer_type = getTransferTypeFromCanID(id);
+    for (TxCompletionTracker* p = trackers_.get(); p != UAVCAN_NULLPTR; p = p->getNextListNode())
+    {
+        if ((p->data_type_id_ == dtid) && (p->transfer_type_ == transfer_type))
+        {
+            p->handleTxQueueChange(queued);
+            notifications_pending_ = notifications_pending_ || p->ready_pending_;
+        }
+    }
+}
+
+void TxCompletionTrackerRegistry::deliverPendingNotifications()
+{
+    notifications_pending_ = false;
+    TxCompletionTracker* p = trackers_.get();
+    while (p != UAVCAN_NULLPTR)
+    {
+        TxCompletionTracker* const next = p->getNextListNode();
+        if (p->ready_pending_)
+        {
+            p->ready_pending_ = false;
+            if (p->isReady())           // More frames may have been queued since
+            {
+                p->handleTxReady();     // p may be modified
+            }
+        }
         p = next;
     }
 }
@@ -72,73 +259,205 @@ void LoopbackFrameListenerRegistry::invokeListeners(RxFrame& frame)
 /*
  * Dispatcher::ListenerRegister
  */
-bool Dispatcher::ListenerRegistry::add(TransferListener* listener, Mode mode)
+#if UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY > 0
+void Dispatcher::ListenerRegistry::rebuildIndex()
 {
-    if (mode == UniqueListener)
+    // The list is ordered by data type ID in descending order, so the index is filled from the end
+    unsigned num_unique = 0;
+    for (const TransferListener* p = list_.get(); p != UAVCAN_NULLPTR; p = p->getNextListNode())
     {
-        TransferListener* p = list_.get();
-        while (p)
+        const TransferListener* const next = p->getNextListNode();
+        if ((next == UAVCAN_NULLPTR) || (next->getDataTypeDescriptor().getID() != p->getDataTypeDescriptor().getID()))
         {
-            if (p->getDataTypeDescriptor().getID() == listener->getDataTypeDescriptor().getID())
+            num_unique++;
+        }
+    }
+
+    index_overflow_ = num_unique > UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY;
+    if (index_overflow_)
+    {
+        UAVCAN_TRACE("Dispatcher", "Listener index overflow, %u unique data types", num_unique);
+        index_len_ = 0;
+        return;
+    }
+
+    index_len_ = static_cast<uint16_t>(num_unique);
+    unsigned pos = num_unique;
+    TransferListener* run_first = UAVCAN_NULLPTR;
+    for (TransferListener* p = list_.get(); p != UAVCAN_NULLPTR; p = p->getNextListNode())
+    {
+        if ((run_first == UAVCAN_NULLPTR) ||
+            (run_first->getDataTypeDescriptor().getID() != p->getDataTypeDescriptor().getID()))
+        {
+            run_first = p;
+            UAVCAN_ASSERT(pos > 0);
+            pos--;
+            index_[pos].first = p;
+            index_[pos].dtid = p->getDataTypeDescriptor().getID().get();
+        }
+    }
+    UAVCAN_ASSERT(pos == 0);
+}
+#endif
+
+void Dispatcher::ListenerRegistry::rebuildDataTypeIDBitmap()
+{
+    fill_n(dtid_bitmap_, DataTypeIDBitmapSize / 32, 0U);
+    for (const TransferListener* p = list_.get(); p != UAVCAN_NULLPTR; p = p->getNextListNode())
+    {
+        const unsigned bit = p->getDataTypeDescriptor().getID().get() % DataTypeIDBitmapSize;
+        dtid_bitmap_[bit / 32U] |= uint32_t(1UL << (bit % 32U));
+    }
+}
+
+TransferListener* Dispatcher::ListenerRegistry::findFirst(DataTypeID dtid) const
+{
+#if UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY > 0
+    if (!index_overflow_)
+    {
+        unsigned lo = 0;
+        unsigned hi = index_len_;
+        while (lo < hi)
+        {
+            const unsigned mid = (lo + hi) / 2U;
+            if (index_[mid].dtid < dtid.get())
+            {
+                lo = mid + 1U;
+            }
+            else
             {
-                return false;
+                hi = mid;
             }
-            p = p->getNextListNode();
         }
+        if ((lo < index_len_) && (index_[lo].dtid == dtid.get()))
+        {
+            UAVCAN_ASSERT(index_[lo].first->getDataTypeDescriptor().getID() == dtid);
+            return index_[lo].first;
+        }
+        return UAVCAN_NULLPTR;
     }
-    // Objective is to arrange entries by Data Type ID in ascending order from root.
+#endif
+    TransferListener* p = list_.get();
+    while (p)
+    {
+        if (p->getDataTypeDescriptor().getID() == dtid)
+        {
+            return p;
+        }
+        if (p->getDataTypeDescriptor().getID() < dtid)  // Listeners are ordered by data type id!
+        {
+            break;
+        }
+        p = p->getNextListNode();
+    }
+    return UAVCAN_NULLPTR;
+}
+
+bool Dispatcher::ListenerRegistry::add(TransferListener* listener, Mode mode)
+{
+    if ((mode == UniqueListener) && exists(listener->getDataTypeDescriptor().getID()))
+    {
+        return false;
+    }
+    // Objective is to arrange entries by Data Type ID in descending order from root.
     list_.insertBefore(listener, DataTypeIDInsertionComparator(listener->getDataTypeDescriptor().getID()));
+#if UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY > 0
+    rebuildIndex();
+#endif
+    rebuildDataTypeIDBitmap();
     return true;
 }
 
+bool Dispatcher::ListenerRegistry::contains(const TransferListener* listener) const
+{
+    // The listener may be registered in another registry, which the list can't tell, so its run is searched
+    const DataTypeID dtid = listener->getDataTypeDescriptor().getID();
+    const TransferListener* p = findFirst(dtid);
+    while ((p != listener) && (p != UAVCAN_NULLPTR) && (p->getDataTypeDescriptor().getID() == dtid))
+    {
+        p = p->getNextListNode();
+    }
+    return p == listener;
+}
+
 void Dispatcher::ListenerRegistry::remove(TransferListener* listener)
 {
+    if (!contains(listener))
+    {
+        return;
+    }
+
     list_.remove(listener);
+#if UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY > 0
+    rebuildIndex();
+#endif
+    rebuildDataTypeIDBitmap();
+}
+
+bool Dispatcher::ListenerRegistry::replace(TransferListener* old_listener, TransferListener* new_listener)
+{
+    if ((old_listener->getDataTypeDescriptor().getID() != new_listener->getDataTypeDescriptor().getID()) ||
+        !contains(old_listener) || contains(new_listener))
+    {
+        return false;
+    }
+
+    TransferListener* const prev = old_listener->getPrevListNode();
+    list_.remove(old_listener);
+    list_.insertAfter(new_listener, prev);
+#if UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY > 0
+    rebuildIndex();
+#endif
+    return true;
 }
 
 bool Dispatcher::ListenerRegistry::exists(DataTypeID dtid) const
+{
+    return mayHaveListeners(dtid.get()) && (findFirst(dtid) != UAVCAN_NULLPTR);
+}
+
+void Dispatcher::ListenerRegistry::cleanup(MonotonicTime ts, unsigned& position, unsigned slice,
+                                           unsigned num_slices)
 {
     TransferListener* p = list_.get();
     while (p)
     {
-        if (p->getDataTypeDescriptor().getID() == dtid)
+        TransferListener* const next = p->getNextListNode();
+        if ((position % num_slices) == slice)
         {
-            return true;
+            p->cleanup(ts); // p may be modified
         }
-        p = p->getNextListNode();
+        position++;
+        p = next;
     }
-    return false;
 }
 
-void Dispatcher::ListenerRegistry::cleanup(MonotonicTime ts)
+void Dispatcher::ListenerRegistry::removeReceiversOf(NodeID node_id)
 {
-    TransferListener* p = list_.get();
-    while (p)
+    for (TransferListener* p = list_.get(); p != UAVCAN_NULLPTR; p = p->getNextListNode())
+    {
+        p->removeReceiversOf(node_id);
+    }
+}
+
+void Dispatcher::ListenerRegistry::handleFrame(const RxFrame& frame, bool tao_disabled)
+{
+    TransferListener* p = findFirst(frame.getDataTypeID());
+    while ((p != UAVCAN_NULLPTR) && (p->getDataTypeDescriptor().getID() == frame.getDataTypeID()))
     {
         TransferListener* const next = p->getNextListNode();
-        p->cleanup(ts); // p may be modified
+        p->handleFrame(frame, tao_disabled); // p may be modified
         p = next;
     }
 }
 
-void Dispatcher::ListenerRegistry::handleFrame(const RxFrame& frame, bool tao_disabled)
+void Dispatcher::ListenerRegistry::handleCompletedTransfer(const RxFrame& last_frame, IncomingTransfer& transfer)
 {
-    TransferListener* p = list_.get();
-    while (p)
+    TransferListener* p = findFirst(last_frame.getDataTypeID());
+    while ((p != UAVCAN_NULLPTR) && (p->getDataTypeDescriptor().getID() == last_frame.getDataTypeID()))
     {
         TransferListener* const next = p->getNextListNode();
-        if (p->getDataTypeDescriptor().getID() == frame.getDataTypeID())
-        {
-            p->handleFrame(frame, tao_disabled); // p may be modified
-        }
-        else if (p->getDataTypeDescriptor().getID() < frame.getDataTypeID())  // Listeners are ordered by data type id!
-        {
-            break;
-        }
-        else
-        {
-            ;  // Nothing to do with this one
-        }
+        p->handleCompletedTransfer(last_frame, transfer); // p may be modified
         p = next;
     }
 }
@@ -146,16 +465,59 @@ void Dispatcher::ListenerRegistry::handleFrame(const RxFrame& frame, bool tao_di
 /*
  * Dispatcher
  */
-void Dispatcher::handleFrame(const CanRxFrame& can_frame)
+bool Dispatcher::isFrameOfInterest(const CanFrame& can_frame) const
 {
-    RxFrame frame;
-    if (!frame.parse(can_frame))
+    if (!can_frame.isExtended() || can_frame.isRemoteTransmissionRequest() || can_frame.isErrorFrame())
     {
-        // This is not counted as a transport error
-        UAVCAN_TRACE("Dispatcher", "Invalid CAN frame received: %s", can_frame.toString().c_str());
-        return;
+        return true;    // Will be rejected by the parser
+    }
+
+    // Refer to Frame::parse() for the layout of the CAN ID
+    const uint32_t id = can_frame.id & CanFrame::MaskExtID;
+    const uint16_t dtid = getDataTypeIDFromCanID(id);
+    const bool service_not_message = ((id >> 7) & 1U) != 0U;
+    if (service_not_message)
+    {
+        const uint8_t dst_node_id = static_cast<uint8_t>((id >> 8) & 0x7FU);
+        if ((dst_node_id != NodeID::Broadcast.get()) && (dst_node_id != getNodeID().get()))
+        {
+            return false;
+        }
+        const bool request_not_response = ((id >> 15) & 1U) != 0U;
+        return request_not_response ? lsrv_req_.mayHaveListeners(dtid) : lsrv_resp_.mayHaveListeners(dtid);
     }
+    return lmsg_.mayHaveListeners(dtid);
+}
 
+bool Dispatcher::acceptFrame(const CanRxFrame& can_frame)
+{
+    // Any CAN FD frame proves that its source supports CAN FD, whether the frame is of interest or not
+    if (can_frame.isCanFDFrame() &&
+        ((can_frame.id & (CanFrame::FlagEFF | CanFrame::FlagRTR | CanFrame::FlagERR)) == CanFrame::FlagEFF))
+    {
+        const NodeID src_node_id(uint8_t(can_frame.id & NodeID::Max));
+        if (src_node_id.isUnicast())
+        {
+            canfd_capable_nodes_.add(src_node_id);
+        }
+    }
+
+    if (!isFrameOfInterest(can_frame))
+    {
+        return false;
+    }
+
+    if ((canio_.getNumIfaces() > 1) && !redundancy_filter_.accept(can_frame))
+    {
+        return false;
+    }
+
+    // After the redundancy filter, so that the copies of a transfer are counted once
+    return rx_rate_limiter_.accept(can_frame);
+}
+
+void Dispatcher::dispatchFrame(const RxFrame& frame)
+{
     if ((frame.getDstNodeID() != NodeID::Broadcast) &&
         (frame.getDstNodeID() != getNodeID()))
     {
@@ -187,6 +549,103 @@ void Dispatcher::handleFrame(const CanRxFrame& can_frame)
     }
 }
 
+void Dispatcher::handleFrame(const CanRxFrame& can_frame)
+{
+    UAVCAN_TRACE_POINT(TraceEventRxFrame, can_frame.id, 0, can_frame.iface_index);
+
+#if !UAVCAN_TINY
+    if (rx_demux_ != UAVCAN_NULLPTR)
+    {
+        rx_demux_->handleFrame(can_frame);
+        return;
+    }
+#endif
+
+    if (!acceptFrame(can_frame))
+    {
+        return;
+    }
+
+    RxFrame frame;
+    if (!frame.parse(can_frame, RxFrame::PayloadReference))
+    {
+        // This is not counted as a transport error
+        UAVCAN_TRACE("Dispatcher", "Invalid CAN frame received: %s", can_frame.toString().c_str());
+        return;
+    }
+
+    dispatchFrame(frame);
+}
+
+#if !UAVCAN_TINY
+/*
+ * RxFrameDemultiplexer
+ */
+int RxFrameDemultiplexer::addNode(Dispatcher& node)
+{
+    if (hasNode(node) || (num_nodes_ >= MaxNodes))
+    {
+        return -ErrLogic;
+    }
+    nodes_[num_nodes_++] = &node;
+    return 0;
+}
+
+void RxFrameDemultiplexer::removeNode(Dispatcher& node)
+{
+    for (unsigned i = 0; i < num_nodes_; i++)
+    {
+        if (nodes_[i] == &node)
+        {
+            num_nodes_--;
+            nodes_[i] = nodes_[num_nodes_];
+            nodes_[num_nodes_] = UAVCAN_NULLPTR;
+            break;
+        }
+    }
+}
+
+bool RxFrameDemultiplexer::hasNode(const Dispatcher& node) const
+{
+    for (unsigned i = 0; i < num_nodes_; i++)
+    {
+        if (nodes_[i] == &node)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RxFrameDemultiplexer::handleFrame(const CanRxFrame& can_frame)
+{
+    RxFrame frame;
+    bool parsed = false;
+
+    for (unsigned i = 0; i < num_nodes_; i++)
+    {
+        Dispatcher& node = *nodes_[i];
+        if (!node.acceptFrame(can_frame))
+        {
+            continue;
+        }
+
+        if (!parsed)
+        {
+            if (!frame.parse(can_frame, RxFrame::PayloadReference))
+            {
+                UAVCAN_TRACE("RxFrameDemultiplexer", "Invalid CAN frame received: %s", can_frame.toString().c_str());
+                return;
+            }
+            parsed = true;
+            num_frames_parsed_++;
+        }
+
+        node.dispatchFrame(frame);
+    }
+}
+#endif
+
 #if UAVCAN_TINY
 void Dispatcher::handleLoopbackFrame(const CanRxFrame&)
 {
@@ -198,8 +657,12 @@ void Dispatcher::notifyRxFrameListener(const CanRxFrame&, CanIOFlags)
 #else
 void Dispatcher::handleLoopbackFrame(const CanRxFrame& can_frame)
 {
+    if (!loopback_listeners_.isFrameOfInterest(can_frame))
+    {
+        return;
+    }
     RxFrame frame;
-    if (!frame.parse(can_frame))
+    if (!frame.parse(can_frame))    // Copied, because loopback listeners are allowed to keep the frame
     {
         UAVCAN_TRACE("Dispatcher", "Invalid loopback CAN frame: %s", can_frame.toString().c_str());
         UAVCAN_ASSERT(0);  // No way!
@@ -218,34 +681,134 @@ void Dispatcher::notifyRxFrameListener(const CanRxFrame& can_frame, CanIOFlags f
 }
 #endif
 
-int Dispatcher::spin(MonotonicTime deadline)
+unsigned Dispatcher::handleReceivedFrames(const CanRxFrame* frames, const CanIOFlags* flags, unsigned num_frames)
+{
+#if UAVCAN_TRANSPORT_STATS
+    // Sampled once per batch, so the frames of a batch share the dispatching time
+    const MonotonicTime dispatch_ts = sysclock_.getMonotonic();
+#endif
+    unsigned num_frames_processed = 0;
+    for (unsigned i = 0; i < num_frames; i++)
+    {
+        if (flags[i] & CanIOFlagLoopback)
+        {
+            handleLoopbackFrame(frames[i]);
+        }
+        else
+        {
+            num_frames_processed++;
+#if UAVCAN_TRANSPORT_STATS
+            if (!frames[i].ts_mono.isZero())
+            {
+                perf_.addRxLatency(dispatch_ts - frames[i].ts_mono);
+            }
+#endif
+            handleFrame(frames[i]);
+        }
+        notifyRxFrameListener(frames[i], flags[i]);
+    }
+    return num_frames_processed;
+}
+
+#if UAVCAN_DISPATCHER_RX_STAGING_CAPACITY > 0
+int Dispatcher::receiveStaged(MonotonicTime blocking_deadline, unsigned max_frames, int& inout_num_frames_processed)
+{
+    max_frames = min(max_frames, unsigned(RxStagingCapacity));
+    int res = canio_.receiveBatch(rx_staging_frames_, rx_staging_flags_, max_frames, blocking_deadline);
+    if (res <= 0)
+    {
+        return res;
+    }
+    unsigned num_frames = unsigned(res);
+    while (num_frames < max_frames)
+    {
+        res = canio_.receiveBatch(rx_staging_frames_ + num_frames, rx_staging_flags_ + num_frames,
+                                  max_frames - num_frames, MonotonicTime());
+        if (res <= 0)
+        {
+            break;              // The error is reported once the frames received so far are processed
+        }
+        num_frames += unsigned(res);
+    }
+
+    /*
+     * Stable insertion sort: the frames are mostly in order already, and the order of frames with the same
+     * CAN ID must be preserved.
+     */
+    for (unsigned i = 1; i < num_frames; i++)
+    {
+        unsigned k = i;
+        while ((k > 0) && rx_staging_frames_[i].priorityHigherThan(rx_staging_frames_[k - 1]))
+        {
+            k--;
+        }
+        if (k < i)
+        {
+            const CanRxFrame frame = rx_staging_frames_[i];
+            const CanIOFlags flags = rx_staging_flags_[i];
+            for (unsigned j = i; j > k; j--)
+            {
+                rx_staging_frames_[j] = rx_staging_frames_[j - 1];
+                rx_staging_flags_[j] = rx_staging_flags_[j - 1];
+            }
+            rx_staging_frames_[k] = frame;
+            rx_staging_flags_[k] = flags;
+        }
+    }
+
+    inout_num_frames_processed += int(handleReceivedFrames(rx_staging_frames_, rx_staging_flags_, num_frames));
+    return (res < 0) ? res : int(num_frames);
+}
+
+#endif
+
+int Dispatcher::spin(MonotonicTime deadline, unsigned max_frames)
 {
+    spin_deadline_ = deadline;          // The callbacks invoked below may bring it closer
+
     int num_frames_processed = 0;
-    do
+    unsigned num_frames_received = 0;
+    while (num_frames_received < max_frames)
     {
-        CanIOFlags flags = 0;
-        CanRxFrame frame;
-        const int res = canio_.receive(frame, deadline, flags);
-        if (res < 0)
+#if UAVCAN_DISPATCHER_RX_STAGING_CAPACITY > 0
+        if (rx_staging_)
         {
-            return res;
+            const int res = receiveStaged(spin_deadline_, max_frames - num_frames_received, num_frames_processed);
+            if (res < 0)
+            {
+                spin_deadline_ = MonotonicTime();
+                return res;
+            }
+            num_frames_received += unsigned(res);
         }
-        if (res > 0)
+        else
+#endif
         {
-            if (flags & CanIOFlagLoopback)
+            CanIOFlags flags[RxBatchSize];
+            CanRxFrame frames[RxBatchSize];
+            const unsigned batch_size = min(max_frames - num_frames_received, unsigned(RxBatchSize));
+            const int res = canio_.receiveBatch(frames, flags, batch_size, spin_deadline_);
+            if (res < 0)
             {
-                handleLoopbackFrame(frame);
+                spin_deadline_ = MonotonicTime();
+                return res;
             }
-            else
+            if (res > 0)
             {
-                num_frames_processed++;
-                handleFrame(frame);
+                num_frames_processed += int(handleReceivedFrames(frames, flags, unsigned(res)));
+                num_frames_received += unsigned(res);
             }
-            notifyRxFrameListener(frame, flags);
+        }
+#if !UAVCAN_TINY
+        tx_completion_trackers_.deliverNotifications();
+#endif
+        if (sysclock_.getMonotonic() >= spin_deadline_)
+        {
+            break;
         }
     }
-    while (sysclock_.getMonotonic() < deadline);
 
+    spin_deadline_ = MonotonicTime();
     return num_frames_processed;
 }
 
@@ -255,25 +818,30 @@ int Dispatcher::spinOnce()
 
     while (true)
     {
-        CanIOFlags flags = 0;
-        CanRxFrame frame;
-        const int res = canio_.receive(frame, MonotonicTime(), flags);
+#if UAVCAN_DISPATCHER_RX_STAGING_CAPACITY > 0
+        if (rx_staging_)
+        {
+            const int res = receiveStaged(MonotonicTime(), RxStagingCapacity, num_frames_processed);
+            if (res <= 0)
+            {
+# if !UAVCAN_TINY
+                tx_completion_trackers_.deliverNotifications();
+# endif
+                return (res < 0) ? res : num_frames_processed;
+            }
+            continue;
+        }
+#endif
+        CanIOFlags flags[RxBatchSize];
+        CanRxFrame frames[RxBatchSize];
+        const int res = canio_.receiveBatch(frames, flags, RxBatchSize, MonotonicTime());
         if (res < 0)
         {
             return res;
         }
         else if (res > 0)
         {
-            if (flags & CanIOFlagLoopback)
-            {
-                handleLoopbackFrame(frame);
-            }
-            else
-            {
-                num_frames_processed++;
-                handleFrame(frame);
-            }
-            notifyRxFrameListener(frame, flags);
+            num_frames_processed += int(handleReceivedFrames(frames, flags, unsigned(res)));
         }
         else
         {
@@ -281,6 +849,9 @@ int Dispatcher::spinOnce()
         }
     }
 
+#if !UAVCAN_TINY
+    tx_completion_trackers_.deliverNotifications();
+#endif
     return num_frames_processed;
 }
 
@@ -303,12 +874,67 @@ int Dispatcher::send(const Frame& frame, MonotonicTime tx_deadline, MonotonicTim
     return canio_.send(can_frame, tx_deadline, blocking_deadline, iface_mask, qos, flags);
 }
 
-void Dispatcher::cleanup(MonotonicTime ts)
+void Dispatcher::cleanup(MonotonicTime ts, unsigned slice, unsigned num_slices)
+{
+    UAVCAN_ASSERT((num_slices > 0) && (slice < num_slices));
+    num_slices = max(num_slices, 1U);
+    slice %= num_slices;
+
+    if (slice == 0)
+    {
+        canio_.cleanup(ts);
+        outgoing_transfer_reg_.cleanup(ts);
+    }
+    unsigned position = 0;
+    lmsg_.cleanup(ts, position, slice, num_slices);
+    lsrv_req_.cleanup(ts, position, slice, num_slices);
+    lsrv_resp_.cleanup(ts, position, slice, num_slices);
+}
+
+void Dispatcher::removeRxStateOf(NodeID node_id)
+{
+    if (!node_id.isUnicast())
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    UAVCAN_TRACE("Dispatcher", "Removing the RX state of node %d", int(node_id.get()));
+    lmsg_.removeReceiversOf(node_id);
+    lsrv_req_.removeReceiversOf(node_id);
+    lsrv_resp_.removeReceiversOf(node_id);
+}
+
+void Dispatcher::dispatchCompletedTransfer(const RxFrame& last_frame, IncomingTransfer& transfer)
 {
-    outgoing_transfer_reg_.cleanup(ts);
-    lmsg_.cleanup(ts);
-    lsrv_req_.cleanup(ts);
-    lsrv_resp_.cleanup(ts);
+    if ((last_frame.getDstNodeID() != NodeID::Broadcast) &&
+        (last_frame.getDstNodeID() != getNodeID()))
+    {
+        return;
+    }
+
+    switch (last_frame.getTransferType())
+    {
+    case TransferTypeMessageBroadcast:
+    {
+        lmsg_.handleCompletedTransfer(last_frame, transfer);
+        break;
+    }
+    case TransferTypeServiceRequest:
+    {
+        lsrv_req_.handleCompletedTransfer(last_frame, transfer);
+        break;
+    }
+    case TransferTypeServiceResponse:
+    {
+        lsrv_resp_.handleCompletedTransfer(last_frame, transfer);
+        break;
+    }
+    default:
+    {
+        UAVCAN_ASSERT(0);
+        break;
+    }
+    }
 }
 
 bool Dispatcher::registerMessageListener(TransferListener* listener)
@@ -346,6 +972,11 @@ void Dispatcher::unregisterMessageListener(TransferListener* listener)
     lmsg_.remove(listener);
 }
 
+bool Dispatcher::replaceMessageListener(TransferListener* old_listener, TransferListener* new_listener)
+{
+    return lmsg_.replace(old_listener, new_listener);
+}
+
 void Dispatcher::unregisterServiceRequestListener(TransferListener* listener)
 {
     lsrv_req_.remove(listener);
@@ -368,9 +999,38 @@ bool Dispatcher::hasPublisher(DataTypeID dtid) const
 
 bool Dispatcher::hasServer(DataTypeID dtid) const
 {
+    // The bitmap is exact for the service data type IDs, no lookup needed
+    if (dtid.get() <= DataTypeID::MaxServiceDataTypeIDValue)
+    {
+        return lsrv_req_.mayHaveListeners(dtid.get());
+    }
     return lsrv_req_.exists(dtid);
 }
 
+bool Dispatcher::isListenerLookupIndexed(TransferType tt) const
+{
+    switch (tt)
+    {
+    case TransferTypeMessageBroadcast:
+    {
+        return lmsg_.isIndexed();
+    }
+    case TransferTypeServiceRequest:
+    {
+        return lsrv_req_.isIndexed();
+    }
+    case TransferTypeServiceResponse:
+    {
+        return lsrv_resp_.isIndexed();
+    }
+    default:
+    {
+        UAVCAN_ASSERT(0);
+        return false;
+    }
+    }
+}
+
 bool Dispatcher::setNodeID(NodeID nid)
 {
     if (!self_node_id_is_set_)
@@ -18,6 +18,7 @@ uint8_t Frame::setPayload(const uint8_t* data, unsigned len)
     const uint8_t maxlen = getPayloadCapacity();
     len = min(unsigned(maxlen), len);
     (void)copy(data, data + len, payload_);
+    payload_ref_ = UAVCAN_NULLPTR;
     payload_len_ = uint_fast8_t(len);
     return static_cast<uint8_t>(len);
 }
@@ -31,7 +32,7 @@ inline static uint32_t bitunpack(uint32_t val)
     return (val >> OFFSET) & ((1UL << WIDTH) - 1);
 }
 
-bool Frame::parse(const CanFrame& can_frame)
+bool Frame::parse(const CanFrame& can_frame, PayloadStorage payload_storage)
 {
     if (can_frame.isErrorFrame() || can_frame.isRemoteTransmissionRequest() || !can_frame.isExtended())
     {
@@ -88,7 +89,15 @@ bool Frame::parse(const CanFrame& can_frame)
      * CAN payload parsing
      */
     payload_len_ = static_cast<uint8_t>(CanFrame::dlcToDataLength(can_frame.dlc) - 1U);
-    (void)copy(can_frame.data, can_frame.data + payload_len_, payload_);
+    if (payload_storage == PayloadReference)
+    {
+        payload_ref_ = can_frame.data;
+    }
+    else
+    {
+        payload_ref_ = UAVCAN_NULLPTR;
+        (void)copy(can_frame.data, can_frame.data + payload_len_, payload_);
+    }
 
     const uint8_t tail = can_frame.data[CanFrame::dlcToDataLength(can_frame.dlc) - 1U];
 
@@ -111,6 +120,41 @@ inline static uint32_t bitpack(uint32_t field)
     return uint32_t((field & ((1UL << WIDTH) - 1)) << OFFSET);
 }
 
+uint8_t Frame::compileTailByte(TransferID transfer_id, bool start_of_transfer, bool end_of_transfer, bool toggle)
+{
+    uint8_t tail = transfer_id.get();
+    if (start_of_transfer)
+    {
+        tail |= (1U << 7);
+    }
+    if (end_of_transfer)
+    {
+        tail |= (1U << 6);
+    }
+    if (toggle)
+    {
+        tail |= (1U << 5);
+    }
+    return tail;
+}
+
+void Frame::compilePayload(CanFrame& out_can_frame, const uint8_t* payload, unsigned payload_len,
+                           uint8_t tail_byte)
+{
+    UAVCAN_ASSERT(payload_len < sizeof(static_cast<CanFrame*>(UAVCAN_NULLPTR)->data));
+
+    out_can_frame.dlc = TransferFramePlan::getDlcForPayload(payload_len);
+    if (payload != out_can_frame.data)                  // The payload may have been written in place
+    {
+        (void)copy(payload, payload + payload_len, out_can_frame.data);
+    }
+
+    // The padding must be zero, as the receivers take it for payload
+    const unsigned tail_index = CanFrame::dlcToDataLength(out_can_frame.dlc) - 1U;
+    fill(out_can_frame.data + payload_len, out_can_frame.data + tail_index, uint8_t(0));
+    out_can_frame.data[tail_index] = tail_byte;
+}
+
 bool Frame::compile(CanFrame& out_can_frame) const
 {
     if (!isValid())
@@ -145,34 +189,8 @@ bool Frame::compile(CanFrame& out_can_frame) const
     /*
      * Payload
      */
-    uint8_t tail = transfer_id_.get();
-    if (start_of_transfer_)
-    {
-        tail |= (1U << 7);
-    }
-    if (end_of_transfer_)
-    {
-        tail |= (1U << 6);
-    }
-    if (toggle_)
-    {
-        tail |= (1U << 5);
-    }
-
-    UAVCAN_ASSERT(payload_len_ < sizeof(static_cast<CanFrame*>(UAVCAN_NULLPTR)->data));
-
-    out_can_frame.dlc = CanFrame::dataLengthToDlc(static_cast<uint8_t>(payload_len_));
-    (void)copy(payload_, payload_ + payload_len_, out_can_frame.data);
-
-    if (payload_len_ < 8) {
-        out_can_frame.data[payload_len_] = tail;
-        out_can_frame.dlc++;
-    } else if (payload_len_ == CanFrame::dlcToDataLength(out_can_frame.dlc)){
-        out_can_frame.dlc++;
-        out_can_frame.data[CanFrame::dlcToDataLength(out_can_frame.dlc) - 1] = tail;
-    } else {
-        out_can_frame.data[CanFrame::dlcToDataLength(out_can_frame.dlc) - 1] = tail;
-    }
+    compilePayload(out_can_frame, getPayloadPtr(), payload_len_,
+                   compileTailByte(transfer_id_, start_of_transfer_, end_of_transfer_, toggle_));
 
     out_can_frame.canfd = canfd_frame_;
 
@@ -281,7 +299,7 @@ bool Frame::operator==(const Frame& rhs) const
         (start_of_transfer_ == rhs.start_of_transfer_) &&
         (end_of_transfer_   == rhs.end_of_transfer_) &&
         (payload_len_       == rhs.payload_len_) &&
-        equal(payload_, payload_ + payload_len_, rhs.payload_);
+        equal(getPayloadPtr(), getPayloadPtr() + payload_len_, rhs.getPayloadPtr());
 }
 
 #if UAVCAN_TOSTRING
@@ -298,7 +316,7 @@ std::string Frame::toString() const
     {
         // Coverity Scan complains about payload_ being not default initialized. This is OK.
         // coverity[read_parm_fld]
-        ofs += snprintf(buf + ofs, unsigned(BUFLEN - ofs), "%02x", payload_[i]);
+        ofs += snprintf(buf + ofs, unsigned(BUFLEN - ofs), "%02x", getPayloadPtr()[i]);
         if ((i + 1) < payload_len_)
         {
             ofs += snprintf(buf + ofs, unsigned(BUFLEN - ofs), " ");
@@ -309,12 +327,33 @@ std::string Frame::toString() const
 }
 #endif
 
+/**
+ * TransferFramePlan
+ */
+TransferFramePlan::TransferFramePlan(uint16_t payload_len, uint8_t arg_frame_payload_capacity)
+    : num_frames(1)
+    , frame_payload_capacity(arg_frame_payload_capacity)
+    , last_frame_payload_len(0)
+    , num_padding_bytes(0)
+{
+    UAVCAN_ASSERT(frame_payload_capacity > 0);
+    unsigned len = payload_len;
+    if (len > frame_payload_capacity)
+    {
+        len += 2U;                                      // Transfer CRC
+        num_frames = uint16_t((len + frame_payload_capacity - 1U) / frame_payload_capacity);
+        len -= (num_frames - 1U) * frame_payload_capacity;
+    }
+    last_frame_payload_len = uint8_t(len);
+    num_padding_bytes = uint8_t(CanFrame::dlcToDataLength(getDlcForPayload(len)) - 1U - len);
+}
+
 /**
  * RxFrame
  */
-bool RxFrame::parse(const CanRxFrame& can_frame)
+bool RxFrame::parse(const CanRxFrame& can_frame, PayloadStorage payload_storage)
 {
-    if (!Frame::parse(can_frame))
+    if (!Frame::parse(can_frame, payload_storage))
     {
         return false;
     }
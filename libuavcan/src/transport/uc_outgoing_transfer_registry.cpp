@@ -24,10 +24,81 @@ std::string OutgoingTransferRegistryKey::toString() const
  */
 const MonotonicDuration OutgoingTransferRegistry::MinEntryLifetime = MonotonicDuration::fromMSec(2000);
 
-TransferID* OutgoingTransferRegistry::accessOrCreate(const OutgoingTransferRegistryKey& key,
-                                                     MonotonicTime new_deadline)
+OutgoingTransferRegistry::StaticEntry* OutgoingTransferRegistry::findStaticEntry(
+    const OutgoingTransferRegistryKey& key) const
+{
+    const uint32_t hash = key.hash();       // Unique per key
+    unsigned lo = 0;
+    unsigned hi = num_static_entries_;
+    while (lo < hi)
+    {
+        const unsigned mid = (lo + hi) / 2U;
+        const uint32_t mid_hash = static_entries_[mid].key_.hash();
+        if (mid_hash == hash)
+        {
+            return &static_entries_[mid];
+        }
+        if (mid_hash < hash)
+        {
+            lo = mid + 1U;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return UAVCAN_NULLPTR;
+}
+
+int OutgoingTransferRegistry::adoptStaticEntries(StaticEntry* const entries, const unsigned num_entries)
+{
+    if (static_entries_ != UAVCAN_NULLPTR)
+    {
+        return -ErrLogic;
+    }
+    if ((entries == UAVCAN_NULLPTR) || (num_entries == 0) || (num_entries > 0xFFFFU))
+    {
+        return -ErrInvalidParam;
+    }
+
+    // Insertion sort - the number of entries is small and this is done once
+    for (unsigned i = 1; i < num_entries; i++)
+    {
+        for (unsigned k = i; (k > 0) && (entries[k].key_.hash() < entries[k - 1U].key_.hash()); k--)
+        {
+            const StaticEntry tmp = entries[k];
+            entries[k] = entries[k - 1U];
+            entries[k - 1U] = tmp;
+        }
+    }
+    for (unsigned i = 1; i < num_entries; i++)
+    {
+        if (entries[i].key_ == entries[i - 1U].key_)
+        {
+            return -ErrInvalidParam;
+        }
+    }
+
+    for (unsigned i = 0; i < num_entries; i++)
+    {
+        const Value* const dynamic = map_.access(entries[i].key_);
+        if (dynamic != UAVCAN_NULLPTR)
+        {
+            entries[i].tid_ = dynamic->tid;
+            map_.remove(entries[i].key_);
+            generation_++;
+        }
+    }
+
+    static_entries_ = entries;
+    num_static_entries_ = uint16_t(num_entries);
+    UAVCAN_TRACE("OutgoingTransferRegistry", "Adopted %u static entries", num_entries);
+    return 0;
+}
+
+OutgoingTransferRegistry::Value* OutgoingTransferRegistry::accessOrCreateDynamic(
+    const OutgoingTransferRegistryKey& key, MonotonicTime new_deadline)
 {
-    UAVCAN_ASSERT(!new_deadline.isZero());
     Value* p = map_.access(key);
     if (p == UAVCAN_NULLPTR)
     {
@@ -39,17 +110,83 @@ TransferID* OutgoingTransferRegistry::accessOrCreate(const OutgoingTransferRegis
         UAVCAN_TRACE("OutgoingTransferRegistry", "Created %s", key.toString().c_str());
     }
     p->deadline = new_deadline;
-    return &p->tid;
+    return p;
+}
+
+TransferID* OutgoingTransferRegistry::accessOrCreate(const OutgoingTransferRegistryKey& key,
+                                                     MonotonicTime new_deadline)
+{
+    UAVCAN_ASSERT(!new_deadline.isZero());
+    StaticEntry* const static_entry = findStaticEntry(key);
+    if (static_entry != UAVCAN_NULLPTR)
+    {
+        return &static_entry->tid_;
+    }
+    Value* const p = accessOrCreateDynamic(key, new_deadline);
+    return (p == UAVCAN_NULLPTR) ? UAVCAN_NULLPTR : &p->tid;
+}
+
+TransferID* OutgoingTransferRegistry::accessOrCreate(const OutgoingTransferRegistryKey& key,
+                                                     MonotonicTime new_deadline, EntryCache& cache)
+{
+    UAVCAN_ASSERT(!new_deadline.isZero());
+    if ((cache.tid_ != UAVCAN_NULLPTR) && (cache.generation_ == generation_) && (cache.key_ == key))
+    {
+        if (cache.deadline_ != UAVCAN_NULLPTR)
+        {
+            *cache.deadline_ = new_deadline;
+        }
+        return cache.tid_;
+    }
+
+    cache = EntryCache();
+    StaticEntry* const static_entry = findStaticEntry(key);
+    if (static_entry != UAVCAN_NULLPTR)
+    {
+        cache.tid_ = &static_entry->tid_;
+    }
+    else
+    {
+        Value* const p = accessOrCreateDynamic(key, new_deadline);
+        if (p == UAVCAN_NULLPTR)
+        {
+            return UAVCAN_NULLPTR;
+        }
+        cache.tid_ = &p->tid;
+        cache.deadline_ = &p->deadline;
+    }
+    cache.key_ = key;
+    cache.generation_ = generation_;
+    return cache.tid_;
 }
 
 bool OutgoingTransferRegistry::exists(DataTypeID dtid, TransferType tt) const
 {
+    if (tt == TransferTypeMessageBroadcast)
+    {
+        // There's only one key per broadcast data type, so it can be looked up directly instead of scanning
+        const OutgoingTransferRegistryKey key(dtid, tt, NodeID::Broadcast);
+        return (findStaticEntry(key) != UAVCAN_NULLPTR) || (map_.access(key) != UAVCAN_NULLPTR);
+    }
+
+    for (unsigned i = 0; i < num_static_entries_; i++)
+    {
+        if ((static_entries_[i].key_.getDataTypeID() == dtid) && (static_entries_[i].key_.getTransferType() == tt))
+        {
+            return true;
+        }
+    }
     return UAVCAN_NULLPTR != map_.find(ExistenceCheckingPredicate(dtid, tt));
 }
 
 void OutgoingTransferRegistry::cleanup(MonotonicTime ts)
 {
-    map_.removeAllWhere(DeadlineExpiredPredicate(ts));
+    unsigned num_expired = 0;
+    map_.removeAllWhere(DeadlineExpiredPredicate(ts, num_expired));
+    if (num_expired > 0)
+    {
+        generation_++;
+    }
 }
 
 }
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/transport/redundancy_filter.hpp>
+#include <uavcan/debug.hpp>
+
+namespace uavcan
+{
+
+#if UAVCAN_DISPATCHER_REDUNDANCY_FILTER_CAPACITY > 0
+
+unsigned RedundantFrameFilter::computeIndex(uint32_t key)
+{
+    // Fibonacci hashing; the source node ID is in the lowest bits, so they must be mixed into the upper bits
+    return unsigned((key * 2654435761U) >> 16) & unsigned(Capacity - 1);
+}
+
+void RedundantFrameFilter::updateInterval(Stream& stream, MonotonicTime sot_ts)
+{
+    // Same estimator as in TransferReceiver::updateTransferTimings()
+    if (!stream.last_sot_ts.isZero() && (sot_ts >= stream.last_sot_ts))
+    {
+        uint64_t interval_msec = uint64_t((sot_ts - stream.last_sot_ts).toMSec());
+        interval_msec = min(interval_msec, uint64_t(stream.interval_msec) * 2U);
+        interval_msec = min(interval_msec, uint64_t(0xFFFFU));
+        interval_msec = max(interval_msec, uint64_t(1U));
+        stream.interval_msec = static_cast<uint16_t>((uint64_t(stream.interval_msec) * 7U + interval_msec) / 8U);
+    }
+    stream.last_sot_ts = sot_ts;
+}
+
+bool RedundantFrameFilter::accept(const CanRxFrame& frame)
+{
+    if (!frame.isExtended() || frame.isRemoteTransmissionRequest() || frame.isErrorFrame() || (frame.dlc < 1) ||
+        (frame.dlc > sizeof(frame.data)) || frame.ts_mono.isZero())
+    {
+        return true;    // Will be rejected by the parser or by the receivers
+    }
+
+    // Refer to Frame::parse() for the layout of the CAN ID; the priority is excluded
+    const uint32_t key = (frame.id & 0xFFFFFFU) | CanFrame::FlagEFF;
+    if ((key & 0x7FU) == 0U)
+    {
+        return true;    // Anonymous
+    }
+
+    const uint8_t tail = frame.data[CanFrame::dlcToDataLength(frame.dlc) - 1U];
+    const bool start_of_transfer = (tail & (1U << 7)) != 0;
+
+    Stream& stream = streams_[computeIndex(key)];
+
+    if (stream.can_id != key)
+    {
+        const bool vacant = (stream.can_id == 0) ||
+                            ((frame.ts_mono - stream.last_ts).toMSec() > StreamTimeoutMSec) ||
+                            (frame.ts_mono < stream.last_ts);
+        if (!vacant)
+        {
+            num_collisions_++;
+            return true;
+        }
+        stream = Stream();
+        stream.can_id = key;
+        stream.iface_index = frame.iface_index;
+        stream.last_ts = frame.ts_mono;
+        if (start_of_transfer)
+        {
+            stream.last_sot_ts = frame.ts_mono;
+        }
+        return true;
+    }
+
+    if (stream.iface_index == frame.iface_index)
+    {
+        stream.last_ts = frame.ts_mono;
+        if (start_of_transfer)
+        {
+            updateInterval(stream, frame.ts_mono);
+        }
+        return true;
+    }
+
+    // The lock is moved only when the locked interface went silent, and only at a transfer boundary.
+    // Same as in TransferReceiver, the silence is capped by the TID timeout, so that the streams slower than
+    // the timeout can switch regardless of the jitter of their interval.
+    const uint16_t switch_delay_msec = min(stream.interval_msec, uint16_t(StreamTimeoutMSec));
+    const bool switch_allowed = start_of_transfer && (frame.ts_mono > stream.last_ts) &&
+                                ((frame.ts_mono - stream.last_ts).toMSec() > switch_delay_msec);
+    if (switch_allowed)
+    {
+        UAVCAN_TRACE("RedundantFrameFilter", "Iface switch %d -> %d, CAN ID %08x",
+                     int(stream.iface_index), int(frame.iface_index), unsigned(key));
+        stream.iface_index = frame.iface_index;
+        stream.last_ts = frame.ts_mono;
+        stream.last_sot_ts = frame.ts_mono;
+        return true;
+    }
+
+    num_dropped_frames_++;
+    return false;
+}
+
+void RedundantFrameFilter::reset()
+{
+    for (unsigned i = 0; i < Capacity; i++)
+    {
+        streams_[i] = Stream();
+    }
+}
+
+#endif
+
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/transport/rx_rate_limiter.hpp>
+#include <uavcan/debug.hpp>
+
+namespace uavcan
+{
+
+#if UAVCAN_DISPATCHER_RX_RATE_LIMITING
+
+void RxRateLimiter::setLimit(TransferType transfer_type, uint32_t transfers_per_second, uint16_t burst)
+{
+    if (transfer_type >= NumTransferTypes)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    Limit& limit = limits_[transfer_type];
+    limit = Limit();
+    if (transfers_per_second > 0)
+    {
+        limit.transfers_per_second = transfers_per_second;
+        limit.emission_interval_usec = max(1000000U / transfers_per_second, 1U);
+        // Capped well below the wraparound of the 32-bit arrival times
+        const uint64_t tolerance_usec = uint64_t(max(burst, uint16_t(1)) - 1U) * limit.emission_interval_usec;
+        limit.tolerance_usec = uint32_t(min(tolerance_usec, uint64_t(0x3FFFFFFFU)));
+    }
+    fill_n(&arrival_times_[transfer_type][0], NodeID::Max + 1U, 0U);
+}
+
+uint32_t RxRateLimiter::getLimit(TransferType transfer_type) const
+{
+    return (transfer_type < NumTransferTypes) ? limits_[transfer_type].transfers_per_second : 0U;
+}
+
+bool RxRateLimiter::accept(const CanRxFrame& frame)
+{
+    if (!frame.isExtended() || frame.isRemoteTransmissionRequest() || frame.isErrorFrame() || (frame.dlc < 1) ||
+        (frame.dlc > sizeof(frame.data)) || frame.ts_mono.isZero())
+    {
+        return true;    // Will be rejected by the parser or by the receivers
+    }
+
+    // Refer to Frame::parse() for the layout of the CAN ID
+    const uint8_t src_node_id = uint8_t(frame.id & NodeID::Max);
+    if (src_node_id == 0U)
+    {
+        return true;    // Anonymous
+    }
+
+    const uint8_t tail = frame.data[CanFrame::dlcToDataLength(frame.dlc) - 1U];
+    if ((tail & (1U << 7)) == 0)
+    {
+        return true;    // Not a start of transfer
+    }
+
+    TransferType transfer_type = TransferTypeMessageBroadcast;
+    if (((frame.id >> 7) & 1U) != 0U)
+    {
+        transfer_type = (((frame.id >> 15) & 1U) != 0U) ? TransferTypeServiceRequest : TransferTypeServiceResponse;
+    }
+
+    const Limit& limit = limits_[transfer_type];
+    if (limit.emission_interval_usec == 0)
+    {
+        return true;
+    }
+
+    /*
+     * Generic cell rate algorithm: the transfer is accepted if it doesn't arrive earlier than the tolerance before
+     * its theoretical arrival time. The times are compared modulo 2^32; an arrival time that is too far ahead can
+     * only be left over from a long silence or a clock adjustment, so it is discarded.
+     */
+    const uint32_t now = uint32_t(frame.ts_mono.toUSec());
+    uint32_t& arrival_time = arrival_times_[transfer_type][src_node_id];
+
+    const int32_t ahead = int32_t(arrival_time - now);
+    if ((ahead <= 0) || (uint32_t(ahead) > (limit.tolerance_usec + limit.emission_interval_usec)))
+    {
+        arrival_time = now;
+    }
+    if ((arrival_time - now) > limit.tolerance_usec)
+    {
+        UAVCAN_TRACE("RxRateLimiter", "Throttled SNID %d, TT %d", int(src_node_id), int(transfer_type));
+        num_throttled_transfers_++;
+        last_throttled_node_id_ = NodeID(src_node_id);
+        return false;
+    }
+
+    arrival_time += limit.emission_interval_usec;
+    return true;
+}
+
+void RxRateLimiter::reset()
+{
+    fill_n(&arrival_times_[0][0], unsigned(NumTransferTypes) * (NodeID::Max + 1U), 0U);
+}
+
+#endif
+
+}
@@ -96,34 +96,6 @@ void TransferBufferManagerEntry::Block::destroy(Block*& obj, IPoolAllocator& all
     }
 }
 
-void TransferBufferManagerEntry::Block::read(uint8_t*& outptr, unsigned target_offset,
-                                             unsigned& total_offset, unsigned& left_to_read)
-{
-    UAVCAN_ASSERT(outptr);
-    for (unsigned i = 0; (i < Block::Size) && (left_to_read > 0); i++, total_offset++)
-    {
-        if (total_offset >= target_offset)
-        {
-            *outptr++ = data[i];
-            left_to_read--;
-        }
-    }
-}
-
-void TransferBufferManagerEntry::Block::write(const uint8_t*& inptr, unsigned target_offset,
-                                                     unsigned& total_offset, unsigned& left_to_write)
-{
-    UAVCAN_ASSERT(inptr);
-    for (unsigned i = 0; (i < Block::Size) && (left_to_write > 0); i++, total_offset++)
-    {
-        if (total_offset >= target_offset)
-        {
-            data[i] = *inptr++;
-            left_to_write--;
-        }
-    }
-}
-
 /*
  * DynamicTransferBuffer
  */
@@ -148,6 +120,29 @@ void TransferBufferManagerEntry::destroy(TransferBufferManagerEntry*& obj, IPool
     }
 }
 
+TransferBufferManagerEntry::Block* TransferBufferManagerEntry::findBlock(unsigned offset,
+                                                                          unsigned& out_block_offset) const
+{
+    Block* p = blocks_.get();
+    unsigned block_offset = 0;
+    if ((cached_block_ != UAVCAN_NULLPTR) && (cached_block_offset_ <= offset))
+    {
+        p = cached_block_;
+        block_offset = cached_block_offset_;
+    }
+    if (p == UAVCAN_NULLPTR)
+    {
+        return UAVCAN_NULLPTR;
+    }
+    while (((block_offset + unsigned(Block::Size)) <= offset) && (p->getNextListNode() != UAVCAN_NULLPTR))
+    {
+        p = p->getNextListNode();
+        block_offset += unsigned(Block::Size);
+    }
+    out_block_offset = block_offset;
+    return p;
+}
+
 int TransferBufferManagerEntry::read(unsigned offset, uint8_t* data, unsigned len) const
 {
     if (!data)
@@ -165,19 +160,27 @@ int TransferBufferManagerEntry::read(unsigned offset, uint8_t* data, unsigned le
     }
     UAVCAN_ASSERT((offset + len) <= max_write_pos_);
 
-    // This shall be optimized.
-    unsigned total_offset = 0;
+    unsigned block_offset = 0;
+    Block* p = findBlock(offset, block_offset);
     unsigned left_to_read = len;
     uint8_t* outptr = data;
-    Block* p = blocks_.get();
-    while (p)
+    while ((p != UAVCAN_NULLPTR) && (left_to_read > 0))
     {
-        p->read(outptr, offset, total_offset, left_to_read);
-        if (left_to_read == 0)
+        UAVCAN_ASSERT((block_offset <= offset) && (offset < (block_offset + unsigned(Block::Size))));
+        const unsigned pos = offset - block_offset;
+        const unsigned chunk = min(left_to_read, unsigned(Block::Size) - pos);
+        (void)copy(p->data + pos, p->data + pos + chunk, outptr);
+        outptr += chunk;
+        offset += chunk;
+        left_to_read -= chunk;
+
+        cached_block_ = p;
+        cached_block_offset_ = uint16_t(block_offset);
+        if (left_to_read > 0)
         {
-            break;
+            p = p->getNextListNode();
+            block_offset += unsigned(Block::Size);
         }
-        p = p->getNextListNode();
     }
 
     UAVCAN_ASSERT(left_to_read == 0);
@@ -202,56 +205,61 @@ int TransferBufferManagerEntry::write(unsigned offset, const uint8_t* data, unsi
     }
     UAVCAN_ASSERT((offset + len) <= max_size_);
 
-    unsigned total_offset = 0;
+    const unsigned initial_offset = offset;
     unsigned left_to_write = len;
     const uint8_t* inptr = data;
-    Block* p = blocks_.get();
-    Block* last_written_block = UAVCAN_NULLPTR;
 
-    // First we need to write the part that is already allocated
-    while (p)
-    {
-        last_written_block = p;
-        p->write(inptr, offset, total_offset, left_to_write);
-        if (left_to_write == 0)
-        {
-            break;
-        }
-        p = p->getNextListNode();
-    }
+    unsigned block_offset = 0;
+    Block* p = findBlock(offset, block_offset);
 
-    // Then we need to append new chunks until all data is written
     while (left_to_write > 0)
     {
-        // cppcheck-suppress nullPointer
-        UAVCAN_ASSERT(p == UAVCAN_NULLPTR);
-
-        // Allocating the chunk
-        Block* new_block = Block::instantiate(allocator_);
-        if (new_block == UAVCAN_NULLPTR)
+        if ((p == UAVCAN_NULLPTR) || (offset >= (block_offset + unsigned(Block::Size))))
         {
-            break;                        // We're in deep shit.
+            // The chain ends before the target offset - appending new chunks until it is reached
+            Block* const new_block = Block::instantiate(allocator_);
+            if (new_block == UAVCAN_NULLPTR)
+            {
+                break;                        // We're in deep shit.
+            }
+            if (p != UAVCAN_NULLPTR)
+            {
+                UAVCAN_ASSERT(p->getNextListNode() == UAVCAN_NULLPTR);  // Because it is last in the chain
+                p->setNextListNode(new_block);
+                new_block->setNextListNode(UAVCAN_NULLPTR);
+                block_offset += unsigned(Block::Size);
+            }
+            else
+            {
+                blocks_.insert(new_block);
+                block_offset = 0;
+            }
+            p = new_block;
+            continue;
         }
-        // Appending the chain with the new block
-        if (last_written_block != UAVCAN_NULLPTR)
-        {
-            UAVCAN_ASSERT(last_written_block->getNextListNode() == UAVCAN_NULLPTR);  // Because it is last in the chain
-            last_written_block->setNextListNode(new_block);
-            new_block->setNextListNode(UAVCAN_NULLPTR);
-        }
-        else
+
+        const unsigned pos = offset - block_offset;
+        const unsigned chunk = min(left_to_write, unsigned(Block::Size) - pos);
+        (void)copy(inptr, inptr + chunk, p->data + pos);
+        inptr += chunk;
+        offset += chunk;
+        left_to_write -= chunk;
+
+        cached_block_ = p;
+        cached_block_offset_ = uint16_t(block_offset);
+        if (left_to_write > 0)
         {
-            blocks_.insert(new_block);
+            if (p->getNextListNode() != UAVCAN_NULLPTR)
+            {
+                p = p->getNextListNode();
+                block_offset += unsigned(Block::Size);
+            }
         }
-        last_written_block = new_block;
-
-        // Writing the data
-        new_block->write(inptr, offset, total_offset, left_to_write);
     }
 
     UAVCAN_ASSERT(len >= left_to_write);
     const unsigned actually_written = len - left_to_write;
-    max_write_pos_ = max(uint16_t(offset + actually_written), uint16_t(max_write_pos_));
+    max_write_pos_ = max(uint16_t(initial_offset + actually_written), uint16_t(max_write_pos_));
     return int(actually_written);
 }
 
@@ -259,6 +267,8 @@ void TransferBufferManagerEntry::reset(const TransferBufferManagerKey& key)
 {
     key_ = key;
     max_write_pos_ = 0;
+    cached_block_ = UAVCAN_NULLPTR;
+    cached_block_offset_ = 0;
     Block* p = blocks_.get();
     while (p)
     {
@@ -269,11 +279,203 @@ void TransferBufferManagerEntry::reset(const TransferBufferManagerKey& key)
     }
 }
 
+#if UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD > 0
+/*
+ * TransferBufferIndex
+ */
+unsigned TransferBufferIndex::getHomeSlot(const TransferBufferManagerKey& key) const
+{
+    UAVCAN_ASSERT(getCapacity() > 0);
+    const uint32_t raw = uint32_t(key.getNodeID().get()) * NumTransferTypes + uint32_t(key.getTransferType());
+    return unsigned((raw * 2654435761U) % getCapacity());     // Knuth's multiplicative hash
+}
+
+template <typename T>
+T* TransferBufferIndex::allocateBlock()
+{
+    void* const praw = allocator_.allocate(sizeof(T));
+    if (praw == UAVCAN_NULLPTR)
+    {
+        return UAVCAN_NULLPTR;
+    }
+    return new (praw) T();      // Value-initialization zeroes the pointers
+}
+
+template <typename T>
+void TransferBufferIndex::deallocateBlock(T* ptr)
+{
+    if (ptr != UAVCAN_NULLPTR)
+    {
+        ptr->~T();
+        allocator_.deallocate(ptr);
+    }
+}
+
+bool TransferBufferIndex::rebuild(const LinkedListRoot<TransferBufferManagerEntry>& list, unsigned num_entries)
+{
+    release();
+
+    // Load factor of 1/2 right after rebuild leaves some room for growth
+    unsigned num_pages = (num_entries * 2U + unsigned(PointersPerBlock) - 1U) / unsigned(PointersPerBlock);
+    num_pages = max(num_pages, 1U);
+    num_pages = min(num_pages, unsigned(MaxPages));
+    if (num_entries * 4U > num_pages * unsigned(PointersPerBlock) * 3U)
+    {
+        UAVCAN_TRACE("TransferBufferIndex", "Too many entries: %u", num_entries);
+        return false;
+    }
+
+    root_ = allocateBlock<Root>();
+    if (root_ == UAVCAN_NULLPTR)
+    {
+        return false;
+    }
+    for (unsigned i = 0; i < num_pages; i++)
+    {
+        Directory*& dir = root_->dirs[i / unsigned(PointersPerBlock)];
+        if (dir == UAVCAN_NULLPTR)
+        {
+            dir = allocateBlock<Directory>();
+        }
+        Page* const page = (dir == UAVCAN_NULLPTR) ? UAVCAN_NULLPTR : allocateBlock<Page>();
+        if (page == UAVCAN_NULLPTR)
+        {
+            UAVCAN_TRACE("TransferBufferIndex", "OOM, %u pages requested", num_pages);
+            release();
+            return false;
+        }
+        dir->pages[i % unsigned(PointersPerBlock)] = page;
+        num_pages_ = uint16_t(i + 1U);
+    }
+
+    for (TransferBufferManagerEntry* p = list.get(); p != UAVCAN_NULLPTR; p = p->getNextListNode())
+    {
+        insert(p);
+    }
+    return true;
+}
+
+void TransferBufferIndex::release()
+{
+    if (root_ != UAVCAN_NULLPTR)
+    {
+        for (unsigned i = 0; i < unsigned(PointersPerBlock); i++)
+        {
+            Directory* const dir = root_->dirs[i];
+            if (dir != UAVCAN_NULLPTR)
+            {
+                for (unsigned k = 0; k < unsigned(PointersPerBlock); k++)
+                {
+                    deallocateBlock(dir->pages[k]);
+                }
+                deallocateBlock(dir);
+            }
+        }
+        deallocateBlock(root_);
+        root_ = UAVCAN_NULLPTR;
+    }
+    num_pages_ = 0;
+}
+
+TransferBufferManagerEntry* TransferBufferIndex::find(const TransferBufferManagerKey& key) const
+{
+    if (!isActive())
+    {
+        UAVCAN_ASSERT(0);
+        return UAVCAN_NULLPTR;
+    }
+    const unsigned capacity = getCapacity();
+    unsigned index = getHomeSlot(key);
+    for (unsigned probe = 0; probe < capacity; probe++)
+    {
+        TransferBufferManagerEntry* const entry = slotAt(index);
+        if (entry == UAVCAN_NULLPTR)
+        {
+            break;
+        }
+        if (entry->getKey() == key)
+        {
+            return entry;
+        }
+        index = (index + 1U) % capacity;
+    }
+    return UAVCAN_NULLPTR;
+}
+
+void TransferBufferIndex::insert(TransferBufferManagerEntry* entry)
+{
+    UAVCAN_ASSERT(isActive() && (entry != UAVCAN_NULLPTR) && !entry->isEmpty());
+    const unsigned capacity = getCapacity();
+    unsigned index = getHomeSlot(entry->getKey());
+    for (unsigned probe = 0; probe < capacity; probe++)
+    {
+        if (slotAt(index) == UAVCAN_NULLPTR)
+        {
+            slotAt(index) = entry;
+            return;
+        }
+        index = (index + 1U) % capacity;
+    }
+    UAVCAN_ASSERT(0);       // The caller must have checked canInsert()
+}
+
+void TransferBufferIndex::remove(const TransferBufferManagerEntry* entry)
+{
+    UAVCAN_ASSERT(isActive() && (entry != UAVCAN_NULLPTR));
+    const unsigned capacity = getCapacity();
+
+    unsigned hole = getHomeSlot(entry->getKey());
+    unsigned probe = 0;
+    while ((slotAt(hole) != entry) && (probe < capacity))
+    {
+        if (slotAt(hole) == UAVCAN_NULLPTR)
+        {
+            UAVCAN_ASSERT(0);   // Not indexed
+            return;
+        }
+        hole = (hole + 1U) % capacity;
+        probe++;
+    }
+    if (probe >= capacity)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+
+    // Backward shift of the rest of the cluster
+    unsigned index = hole;
+    while (true)
+    {
+        index = (index + 1U) % capacity;
+        TransferBufferManagerEntry* const p = slotAt(index);
+        if (p == UAVCAN_NULLPTR)
+        {
+            break;
+        }
+        const unsigned home = getHomeSlot(p->getKey());
+        const bool reachable_without_hole = (hole <= index) ? ((hole < home) && (home <= index)) :
+                                                              ((hole < home) || (home <= index));
+        if (!reachable_without_hole)
+        {
+            slotAt(hole) = p;
+            hole = index;
+        }
+    }
+    slotAt(hole) = UAVCAN_NULLPTR;
+}
+#endif
+
 /*
  * TransferBufferManager
  */
 TransferBufferManagerEntry* TransferBufferManager::findFirst(const TransferBufferManagerKey& key)
 {
+#if UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD > 0
+    if (index_.isActive())
+    {
+        return index_.find(key);
+    }
+#endif
     TransferBufferManagerEntry* dyn = buffers_.get();
     while (dyn)
     {
@@ -287,6 +489,50 @@ TransferBufferManagerEntry* TransferBufferManager::findFirst(const TransferBuffe
     return UAVCAN_NULLPTR;
 }
 
+void TransferBufferManager::addToIndex(TransferBufferManagerEntry* entry)
+{
+#if UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD > 0
+    if (index_.isActive())
+    {
+        if (index_.canInsert(num_buffers_ - 1U))
+        {
+            index_.insert(entry);
+        }
+        else
+        {
+            (void)index_.rebuild(buffers_, num_buffers_);   // Grow; falls back to the linear search on failure
+        }
+    }
+    else if (num_buffers_ >= UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD)
+    {
+        (void)index_.rebuild(buffers_, num_buffers_);
+    }
+#else
+    (void)entry;
+#endif
+}
+
+void TransferBufferManager::removeFromIndex(const TransferBufferManagerEntry* entry)
+{
+#if UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD > 0
+    if (index_.isActive())
+    {
+        // Hysteresis prevents reallocation of the index on every transfer when the number of buffers
+        // fluctuates around the threshold
+        if ((num_buffers_ - 1U) * 2U < unsigned(UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD))
+        {
+            index_.release();
+        }
+        else
+        {
+            index_.remove(entry);
+        }
+    }
+#else
+    (void)entry;
+#endif
+}
+
 TransferBufferManager::~TransferBufferManager()
 {
     TransferBufferManagerEntry* dyn = buffers_.get();
@@ -297,6 +543,10 @@ TransferBufferManager::~TransferBufferManager()
         TransferBufferManagerEntry::destroy(dyn, allocator_);
         dyn = next;
     }
+    num_buffers_ = 0;
+#if UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD > 0
+    index_.release();
+#endif
 }
 
 ITransferBuffer* TransferBufferManager::access(const TransferBufferManagerKey& key)
@@ -325,6 +575,7 @@ ITransferBuffer* TransferBufferManager::create(const TransferBufferManagerKey& k
     }
 
     buffers_.insert(tbme);
+    num_buffers_++;
 
     UAVCAN_TRACE("TransferBufferManager", "Buffer created [num=%u], %s", getNumBuffers(), key.toString().c_str());
 
@@ -332,6 +583,7 @@ ITransferBuffer* TransferBufferManager::create(const TransferBufferManagerKey& k
     {
         UAVCAN_ASSERT(tbme->isEmpty());
         tbme->reset(key);
+        addToIndex(tbme);
     }
     return tbme;
 }
@@ -344,6 +596,9 @@ void TransferBufferManager::remove(const TransferBufferManagerKey& key)
     if (dyn != UAVCAN_NULLPTR)
     {
         UAVCAN_TRACE("TransferBufferManager", "Buffer deleted, %s", key.toString().c_str());
+        removeFromIndex(dyn);
+        UAVCAN_ASSERT(num_buffers_ > 0);
+        num_buffers_--;
         buffers_.remove(dyn);
         TransferBufferManagerEntry::destroy(dyn, allocator_);
     }
@@ -356,7 +611,8 @@ bool TransferBufferManager::isEmpty() const
 
 unsigned TransferBufferManager::getNumBuffers() const
 {
-    return buffers_.getLength();
+    UAVCAN_ASSERT(num_buffers_ == buffers_.getLength());
+    return num_buffers_;
 }
 
 }
@@ -88,79 +88,91 @@ bool TransferListener::TimedOutReceiverPredicate::operator()(const TransferBuffe
     if (value.isTimedOut(ts_))
     {
         UAVCAN_TRACE("TransferListener", "Timed out receiver: %s", key.toString().c_str());
+        if (value.isMidTransfer())
+        {
+            perf_.addError();
+            perf_.addRxErrorCauses(uint8_t(1U << TransferErrorTimeout));
+            perf_.addRxSourceErrors(key.getTransferType(), key.getNodeID(), data_type_id_,
+                                    uint8_t(1U << TransferErrorTimeout));
+        }
         /*
          * TransferReceivers do not own their buffers - this helps the Map<> container to copy them
          * around quickly and safely (using default assignment operator). Downside is that we need to
          * destroy the buffers manually.
          * Maybe it is not good that the predicate has side effects, but I ran out of better ideas.
+         * A preregistered receiver stays; it will restart upon the next frame, since it has timed out.
          */
         parent_bufmgr_.remove(key);
-        return true;
+        return !preregistered_sources_.contains(key.getNodeID());
     }
+    earliest_expiry_ = min(earliest_expiry_, value.getExpiryTime());
     return false;
 }
 
 /*
- * TransferListener
+ * TransferListener::NodeReceiverPredicate
  */
-bool TransferListener::checkPayloadCrc(const uint16_t compare_with, const ITransferBuffer& tbb) const
+bool TransferListener::NodeReceiverPredicate::operator()(const TransferBufferManagerKey& key,
+                                                        const TransferReceiver&) const
 {
-    TransferCRC crc = crc_base_;
-    unsigned offset = 0;
-    while (true)
-    {
-        uint8_t buf[16];
-        const int res = tbb.read(offset, buf, sizeof(buf));
-        if (res < 0)
-        {
-            UAVCAN_TRACE("TransferListener", "Failed to check CRC: Buffer read failure %i", res);
-            return false;
-        }
-        if (res == 0)
-        {
-            break;
-        }
-        offset += unsigned(res);
-        crc.add(buf, unsigned(res));
-    }
-    if (crc.get() != compare_with)
+    if (key.getNodeID() == node_id_)
     {
-        UAVCAN_TRACE("TransferListener", "CRC mismatch, expected=0x%04x, got=0x%04x",
-                     int(compare_with), int(crc.get()));
-        return false;
+        UAVCAN_TRACE("TransferListener", "Removed receiver: %s", key.toString().c_str());
+        parent_bufmgr_.remove(key);     // Same as above, the receivers do not own their buffers
+        return true;
     }
-    return true;
+    return false;
 }
 
+/*
+ * TransferListener
+ */
 void TransferListener::handleReception(TransferReceiver& receiver, const RxFrame& frame,
                                            TransferBufferAccessor& tba, bool tao_disabled)
 {
-    switch (receiver.addFrame(frame, tba))
+    const TransferReceiver::ResultCode result = receiver.addFrame(frame, tba, crc_base_);
+    const uint8_t error_causes = receiver.yieldErrorCauses();
+    perf_.addRxErrorCauses(error_causes);
+    perf_.addRxSourceErrors(frame.getTransferType(), frame.getSrcNodeID(), frame.getDataTypeID(), error_causes);
+
+    switch (result)
     {
     case TransferReceiver::ResultNotComplete:
     {
         perf_.addErrors(receiver.yieldErrorCount());
+        if (frame.isStartOfTransfer())
+        {
+            perf_.addRxSourceStartOfTransfer(frame);
+        }
         break;
     }
     case TransferReceiver::ResultSingleFrame:
     {
-        perf_.addRxTransfer();
+        perf_.addRxTransfer(frame.getTransferType(), frame.getDataTypeID());
+        perf_.addRxSourceTransfer(frame);
         SingleFrameIncomingTransfer it(frame, tao_disabled);
         handleIncomingTransfer(it);
         break;
     }
     case TransferReceiver::ResultComplete:
     {
-        perf_.addRxTransfer();
+        perf_.addRxTransfer(frame.getTransferType(), frame.getDataTypeID());
+        perf_.addRxSourceTransfer(frame);
         const ITransferBuffer* tbb = tba.access();
         if (tbb == UAVCAN_NULLPTR)
         {
             UAVCAN_TRACE("TransferListener", "Buffer access failure, last frame: %s", frame.toString().c_str());
             break;
         }
-        if (!checkPayloadCrc(receiver.getLastTransferCrc(), *tbb))
+        if (!receiver.isLastTransferCrcValid())
         {
-            UAVCAN_TRACE("TransferListener", "CRC error, last frame: %s", frame.toString().c_str());
+            UAVCAN_TRACE("TransferListener", "CRC mismatch, expected=0x%04x, got=0x%04x, last frame: %s",
+                         int(receiver.getLastTransferCrc()), int(receiver.getLastTransferComputedCrc()),
+                         frame.toString().c_str());
+            perf_.addError();
+            perf_.addRxErrorCauses(uint8_t(1U << TransferErrorCrc));
+            perf_.addRxSourceErrors(frame.getTransferType(), frame.getSrcNodeID(), frame.getDataTypeID(),
+                                    uint8_t(1U << TransferErrorCrc));
             break;
         }
         MultiFrameIncomingTransfer it(receiver.getLastTransferTimestampMonotonic(),
@@ -181,7 +193,7 @@ void TransferListener::handleAnonymousTransferReception(const RxFrame& frame, bo
 {
     if (allow_anonymous_transfers_)
     {
-        perf_.addRxTransfer();
+        perf_.addRxTransfer(frame.getTransferType(), frame.getDataTypeID());
         SingleFrameIncomingTransfer it(frame, tao_disabled);
         handleIncomingTransfer(it);
     }
@@ -198,34 +210,145 @@ TransferListener::~TransferListener()
     receivers_.clear();
 }
 
+int TransferListener::reservePoolBlocks(uint16_t num_buffer_blocks, uint16_t num_receiver_blocks)
+{
+    /*
+     * Raising a reservation may fail, lowering it can't. If the buffer reservation is being lowered, the receiver
+     * reservation goes first, so that either both are updated or nothing is changed.
+     */
+    const bool buffer_first = num_buffer_blocks >= rx_buffer_allocator_.getMinBlocks();
+    GuaranteedPoolAllocator& first = buffer_first ? rx_buffer_allocator_ : receiver_map_allocator_;
+    GuaranteedPoolAllocator& second = buffer_first ? receiver_map_allocator_ : rx_buffer_allocator_;
+    const uint16_t first_blocks = buffer_first ? num_buffer_blocks : num_receiver_blocks;
+    const uint16_t second_blocks = buffer_first ? num_receiver_blocks : num_buffer_blocks;
+
+    const uint16_t prev_first_blocks = first.getMinBlocks();
+    if (!first.setMinBlocks(first_blocks))
+    {
+        return -ErrMemory;
+    }
+    if (!second.setMinBlocks(second_blocks))
+    {
+        (void)first.setMinBlocks(prev_first_blocks);
+        return -ErrMemory;
+    }
+    UAVCAN_TRACE("TransferListener", "Reserved %u buffer blocks, %u receiver blocks; dtname=%s",
+                 unsigned(num_buffer_blocks), unsigned(num_receiver_blocks), data_type_.getFullName());
+    return 0;
+}
+
+TransferReceiver* TransferListener::findReceiver(const TransferBufferManagerKey& key, bool create)
+{
+    TransferReceiver* recv = receivers_.access(key);
+    if ((recv == UAVCAN_NULLPTR) && create)
+    {
+        TransferReceiver new_recv;
+        recv = receivers_.insert(key, new_recv);
+    }
+    return recv;
+}
+
+MonotonicTime TransferListener::removeTimedOutReceivers(MonotonicTime ts)
+{
+    // Derived classes may keep receivers outside of the map, so the buffer manager is not necessarily empty here
+    MonotonicTime earliest_expiry = MonotonicTime::getMax();
+    receivers_.removeAllWhere(TimedOutReceiverPredicate(ts, bufmgr_, perf_, data_type_.getID(),
+                                                        preregistered_sources_, earliest_expiry));
+    return earliest_expiry;
+}
+
 void TransferListener::cleanup(MonotonicTime ts)
 {
-    receivers_.removeAllWhere(TimedOutReceiverPredicate(ts, bufmgr_));
-    UAVCAN_ASSERT(receivers_.isEmpty() ? bufmgr_.isEmpty() : 1);
+    /*
+     * The expiry time of a receiver never decreases, so the earliest one found by the previous sweep stays a valid
+     * lower bound until a new receiver is added; that is taken care of upon reception.
+     */
+    if (ts > earliest_receiver_expiry_)
+    {
+        earliest_receiver_expiry_ = removeTimedOutReceivers(ts);
+    }
+}
+
+void TransferListener::removeReceiversOf(NodeID node_id)
+{
+    if (!preregistered_sources_.contains(node_id))
+    {
+        receivers_.removeAllWhere(NodeReceiverPredicate(node_id, bufmgr_));
+        return;
+    }
+    for (int tt = 0; tt < NumTransferTypes; tt++)
+    {
+        const TransferBufferManagerKey key(node_id, TransferType(tt));
+        TransferReceiver* const recv = receivers_.access(key);
+        if (recv != UAVCAN_NULLPTR)
+        {
+            *recv = TransferReceiver();
+            bufmgr_.remove(key);
+        }
+    }
+}
+
+int TransferListener::preregisterSource(NodeID node_id, TransferType transfer_type)
+{
+    if (!node_id.isUnicast())
+    {
+        return -ErrInvalidParam;
+    }
+    const TransferBufferManagerKey key(node_id, transfer_type);
+    TransferReceiver* const recv = findReceiver(key, true);
+    if (recv == UAVCAN_NULLPTR)
+    {
+        return -ErrMemory;
+    }
+    preregistered_sources_.add(node_id);
+    earliest_receiver_expiry_ = min(earliest_receiver_expiry_, recv->getExpiryTime());
+    UAVCAN_TRACE("TransferListener", "Preregistered receiver: %s", key.toString().c_str());
+    return 0;
+}
+
+bool TransferListener::isFrameFilteredOut(const RxFrame& frame) const
+{
+    if (!source_filter_.isEmpty() && !source_filter_.contains(frame.getSrcNodeID()))
+    {
+        return true;
+    }
+    return (frame_filter_ != UAVCAN_NULLPTR) && !frame_filter_->shouldAcceptFrame(frame);
+}
+
+void TransferListener::setSourceNodeFilter(const NodeIDSet& sources)
+{
+    source_filter_ = sources;
+    frame_filtering_enabled_ = !source_filter_.isEmpty() || (frame_filter_ != UAVCAN_NULLPTR);
+}
+
+void TransferListener::setFrameFilter(const ITransferAcceptanceFilter* filter)
+{
+    frame_filter_ = filter;
+    frame_filtering_enabled_ = !source_filter_.isEmpty() || (frame_filter_ != UAVCAN_NULLPTR);
 }
 
 void TransferListener::handleFrame(const RxFrame& frame, bool tao_disabled)
 {
+    if (frame_filtering_enabled_ && isFrameFilteredOut(frame))
+    {
+        return;
+    }
+
     if (frame.getSrcNodeID().isUnicast())       // Normal transfer
     {
         const TransferBufferManagerKey key(frame.getSrcNodeID(), frame.getTransferType());
 
-        TransferReceiver* recv = receivers_.access(key);
+        TransferReceiver* const recv = findReceiver(key, frame.isStartOfTransfer());
         if (recv == UAVCAN_NULLPTR)
         {
-            if (!frame.isStartOfTransfer())
-            {
-                return;
-            }
-
-            TransferReceiver new_recv;
-            recv = receivers_.insert(key, new_recv);
-            if (recv == UAVCAN_NULLPTR)
+            if (frame.isStartOfTransfer())
             {
                 UAVCAN_TRACE("TransferListener", "Receiver registration failed; frame %s", frame.toString().c_str());
-                return;
             }
+            return;
         }
+        // A new receiver has not accepted anything yet, so this makes the next cleanup visit the receivers
+        earliest_receiver_expiry_ = min(earliest_receiver_expiry_, recv->getExpiryTime());
         TransferBufferAccessor tba(bufmgr_, key);
         handleReception(*recv, frame, tba, tao_disabled);
     }
@@ -242,6 +365,204 @@ void TransferListener::handleFrame(const RxFrame& frame, bool tao_disabled)
     }
 }
 
+void TransferListener::handleCompletedTransfer(const RxFrame& last_frame, IncomingTransfer& transfer)
+{
+    UAVCAN_ASSERT(last_frame.getDataTypeID() == data_type_.getID());
+    if (transfer.isAnonymousTransfer() && !allow_anonymous_transfers_)
+    {
+        return;
+    }
+    if (frame_filtering_enabled_ && isFrameFilteredOut(last_frame))
+    {
+        return;
+    }
+    perf_.addRxTransfer(transfer.getTransferType(), last_frame.getDataTypeID());
+    handleIncomingTransfer(transfer);
+}
+
+/*
+ * StreamingTransferListener::ChunkSink
+ */
+int StreamingTransferListener::ChunkSink::write(unsigned offset, const uint8_t* data, unsigned len)
+{
+    if (len == 0)
+    {
+        return 0;
+    }
+    if (offset == 0)
+    {
+        owner_.openTransfer(frame_.getSrcNodeID(), frame_.getTransferType());
+    }
+    owner_.handleTransferChunk(frame_.getSrcNodeID(), frame_.getTransferType(), offset, data, len);
+    return int(len);
+}
+
+/*
+ * StreamingTransferListener
+ */
+void StreamingTransferListener::openTransfer(NodeID src_node_id, TransferType transfer_type)
+{
+    abortTransfer(src_node_id, transfer_type);      // Interrupted by the new one
+    open_transfers_[transfer_type].add(src_node_id);
+}
+
+void StreamingTransferListener::abortTransfer(NodeID src_node_id, TransferType transfer_type)
+{
+    if (open_transfers_[transfer_type].contains(src_node_id))
+    {
+        UAVCAN_TRACE("StreamingTransferListener", "Transfer aborted, snid=%d tt=%d",
+                     int(src_node_id.get()), int(transfer_type));
+        open_transfers_[transfer_type].remove(src_node_id);
+        handleTransferAbort(src_node_id, transfer_type);
+    }
+}
+
+void StreamingTransferListener::deliverWholeTransfer(IncomingTransfer& transfer)
+{
+    const NodeID src_node_id = transfer.getSrcNodeID();
+    const TransferType transfer_type = transfer.getTransferType();
+    if (src_node_id.isUnicast())
+    {
+        abortTransfer(src_node_id, transfer_type);
+    }
+
+    unsigned len = 0;
+    const uint8_t* const payload = transfer.getContiguousPayload(len);
+    if (payload != UAVCAN_NULLPTR)
+    {
+        if (len > 0)
+        {
+            handleTransferChunk(src_node_id, transfer_type, 0, payload, len);
+        }
+    }
+    else
+    {
+        uint8_t chunk[CanFrame::MaxDataLen];
+        unsigned offset = 0;
+        for (;;)
+        {
+            const int res = transfer.read(offset, chunk, sizeof(chunk));
+            if (res < 0)
+            {
+                UAVCAN_TRACE("StreamingTransferListener", "Transfer read failure %d", res);
+                if (offset > 0)
+                {
+                    handleTransferAbort(src_node_id, transfer_type);
+                }
+                return;
+            }
+            if (res == 0)
+            {
+                break;
+            }
+            handleTransferChunk(src_node_id, transfer_type, offset, chunk, unsigned(res));
+            offset += unsigned(res);
+        }
+    }
+    handleTransferEnd(transfer);
+}
+
+void StreamingTransferListener::handleReception(TransferReceiver& receiver, const RxFrame& frame,
+                                                TransferBufferAccessor&, bool tao_disabled)
+{
+    ChunkSink sink(*this, frame);
+    TransferBufferAccessor stream_tba(getBufferManager(),
+                                      TransferBufferManagerKey(frame.getSrcNodeID(), frame.getTransferType()), sink);
+
+    const TransferReceiver::ResultCode result = receiver.addFrame(frame, stream_tba, getTransferCRCBase());
+
+    TransferPerfCounter& perf = getPerfCounter();
+    const uint8_t error_causes = receiver.yieldErrorCauses();
+    perf.addRxErrorCauses(error_causes);
+    perf.addRxSourceErrors(frame.getTransferType(), frame.getSrcNodeID(), frame.getDataTypeID(), error_causes);
+
+    switch (result)
+    {
+    case TransferReceiver::ResultNotComplete:
+    {
+        perf.addErrors(receiver.yieldErrorCount());
+        if (frame.isStartOfTransfer())
+        {
+            perf.addRxSourceStartOfTransfer(frame);
+        }
+        if (!receiver.isMidTransfer())
+        {
+            abortTransfer(frame.getSrcNodeID(), frame.getTransferType());      // Dropped by the receiver
+        }
+        break;
+    }
+    case TransferReceiver::ResultSingleFrame:
+    {
+        perf.addRxTransfer(frame.getTransferType(), frame.getDataTypeID());
+        perf.addRxSourceTransfer(frame);
+        SingleFrameIncomingTransfer it(frame, tao_disabled);
+        deliverWholeTransfer(it);
+        break;
+    }
+    case TransferReceiver::ResultComplete:
+    {
+        perf.addRxTransfer(frame.getTransferType(), frame.getDataTypeID());
+        perf.addRxSourceTransfer(frame);
+        if (!receiver.isLastTransferCrcValid())
+        {
+            UAVCAN_TRACE("StreamingTransferListener", "CRC mismatch, expected=0x%04x, got=0x%04x, last frame: %s",
+                         int(receiver.getLastTransferCrc()), int(receiver.getLastTransferComputedCrc()),
+                         frame.toString().c_str());
+            perf.addError();
+            perf.addRxErrorCauses(uint8_t(1U << TransferErrorCrc));
+            perf.addRxSourceErrors(frame.getTransferType(), frame.getSrcNodeID(), frame.getDataTypeID(),
+                                   uint8_t(1U << TransferErrorCrc));
+            abortTransfer(frame.getSrcNodeID(), frame.getTransferType());
+            break;
+        }
+        open_transfers_[frame.getTransferType()].remove(frame.getSrcNodeID());
+        // The payload has been consumed already, reading it back fails
+        MultiFrameIncomingTransfer it(receiver.getLastTransferTimestampMonotonic(),
+                                      receiver.getLastTransferTimestampUtc(), frame, stream_tba, tao_disabled);
+        handleTransferEnd(it);
+        break;
+    }
+    default:
+    {
+        UAVCAN_ASSERT(0);
+        break;
+    }
+    }
+}
+
+void StreamingTransferListener::handleIncomingTransfer(IncomingTransfer& transfer)
+{
+    // Anonymous transfers and the transfers reassembled elsewhere
+    deliverWholeTransfer(transfer);
+}
+
+void StreamingTransferListener::cleanup(MonotonicTime ts)
+{
+    // The receivers of the interrupted transfers must be checked before they are removed
+    for (int tt = 0; tt < NumTransferTypes; tt++)
+    {
+        const NodeIDSet& open = open_transfers_[tt];
+        for (NodeID nid = open.getFirst(); nid.isValid(); nid = open.getNext(nid))
+        {
+            const TransferReceiver* const recv = findReceiver(TransferBufferManagerKey(nid, TransferType(tt)), false);
+            if ((recv == UAVCAN_NULLPTR) || recv->isTimedOut(ts) || !recv->isMidTransfer())
+            {
+                abortTransfer(nid, TransferType(tt));
+            }
+        }
+    }
+    TransferListener::cleanup(ts);
+}
+
+void StreamingTransferListener::removeReceiversOf(NodeID node_id)
+{
+    for (int tt = 0; tt < NumTransferTypes; tt++)
+    {
+        abortTransfer(node_id, TransferType(tt));
+    }
+    TransferListener::removeReceiversOf(node_id);
+}
+
 /*
  * TransferListenerWithFilter
  */
@@ -260,4 +581,19 @@ void TransferListenerWithFilter::handleFrame(const RxFrame& frame, bool tao_disa
     }
 }
 
+void TransferListenerWithFilter::handleCompletedTransfer(const RxFrame& last_frame, IncomingTransfer& transfer)
+{
+    if (filter_ != UAVCAN_NULLPTR)
+    {
+        if (filter_->shouldAcceptFrame(last_frame))
+        {
+            TransferListener::handleCompletedTransfer(last_frame, transfer);
+        }
+    }
+    else
+    {
+        UAVCAN_ASSERT(0);
+    }
+}
+
 }
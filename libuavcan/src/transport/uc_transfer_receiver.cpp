@@ -5,6 +5,7 @@
 #include <uavcan/transport/transfer_receiver.hpp>
 #include <uavcan/transport/crc.hpp>
 #include <uavcan/debug.hpp>
+#include <uavcan/trace.hpp>
 #include <cstdlib>
 #include <cassert>
 
@@ -26,25 +27,44 @@ MonotonicDuration TransferReceiver::getTidTimeout() const
     return MonotonicDuration::fromMSec(DefaultTidTimeoutMSec);
 }
 
-void TransferReceiver::registerError() const
+void TransferReceiver::registerError(TransferErrorCause cause) const
 {
     error_cnt_ = static_cast<uint8_t>(error_cnt_ + 1) & ErrorCntMask;
+    error_causes_ = static_cast<uint8_t>(error_causes_ | (1U << cause));
+    UAVCAN_TRACE_POINT(TraceEventReceiverError, 0, 0, cause);
+}
+
+void TransferReceiver::setThisTransferTimestamp(MonotonicTime ts)
+{
+    UAVCAN_ASSERT(ts >= this_transfer_ts_);
+    if (prev_transfer_age_usec_ != PrevTransferAgeUnknown)
+    {
+        const uint64_t age_usec = uint64_t(prev_transfer_age_usec_) + uint64_t((ts - this_transfer_ts_).toUSec());
+        prev_transfer_age_usec_ = uint32_t(min(age_usec, uint64_t(PrevTransferAgeUnknown)));
+    }
+    this_transfer_ts_ = ts;
 }
 
 void TransferReceiver::updateTransferTimings()
 {
     UAVCAN_ASSERT(!this_transfer_ts_.isZero());
 
-    const MonotonicTime prev_prev_ts = prev_transfer_ts_;
-    prev_transfer_ts_ = this_transfer_ts_;
-
-    if ((!prev_prev_ts.isZero()) && (!prev_transfer_ts_.isZero()) && (prev_transfer_ts_ >= prev_prev_ts))
+    if (prev_transfer_age_usec_ != PrevTransferAgeUnknown)
     {
-        uint64_t interval_msec = uint64_t((prev_transfer_ts_ - prev_prev_ts).toMSec());
+        /*
+         * The interface switch delay is derived from this estimate, so it must not be inflated by the gaps caused
+         * by lost transfers, publisher restarts or interface failures; otherwise a single outage would delay the
+         * failover to the redundant interface until the TID timeout for many transfers to come.
+         * Limiting every sample to twice the estimate keeps the effect of a gap small, while a genuine decrease
+         * of the transfer rate is still followed, by at most 1/8 per transfer.
+         */
+        uint64_t interval_msec = prev_transfer_age_usec_ / 1000U;
+        interval_msec = min(interval_msec, uint64_t(transfer_interval_msec_) * MaxIntervalGrowthFactor);
         interval_msec = min(interval_msec, uint64_t(MaxTransferIntervalMSec));
         interval_msec = max(interval_msec, uint64_t(MinTransferIntervalMSec));
         transfer_interval_msec_ = static_cast<uint16_t>((uint64_t(transfer_interval_msec_) * 7U + interval_msec) / 8U);
     }
+    prev_transfer_age_usec_ = 0;
 }
 
 void TransferReceiver::prepareForNextTransfer()
@@ -63,37 +83,37 @@ bool TransferReceiver::validate(const RxFrame& frame) const
     if (frame.isStartOfTransfer() && !frame.isEndOfTransfer() && (frame.getPayloadLen() < TransferCRC::NumBytes))
     {
         UAVCAN_TRACE("TransferReceiver", "CRC expected, %s", frame.toString().c_str());
-        registerError();
+        registerError(TransferErrorFormat);
         return false;
     }
     if (frame.isStartOfTransfer() && frame.getToggle())
     {
         UAVCAN_TRACE("TransferReceiver", "Toggle bit is not cleared, %s", frame.toString().c_str());
-        registerError();
+        registerError(TransferErrorToggle);
         return false;
     }
     if (frame.isStartOfTransfer() && isMidTransfer())
     {
         UAVCAN_TRACE("TransferReceiver", "Unexpected start of transfer, %s", frame.toString().c_str());
-        registerError();
+        registerError(TransferErrorTransferID);
     }
     if (frame.getToggle() != next_toggle_)
     {
         UAVCAN_TRACE("TransferReceiver", "Unexpected toggle bit (not %i), %s",
                      int(next_toggle_), frame.toString().c_str());
-        registerError();
+        registerError(TransferErrorToggle);
         return false;
     }
     if (frame.getTransferID() != tid_)
     {
         UAVCAN_TRACE("TransferReceiver", "Unexpected TID (current %i), %s", tid_.get(), frame.toString().c_str());
-        registerError();
+        registerError(TransferErrorTransferID);
         return false;
     }
     return true;
 }
 
-bool TransferReceiver::writePayload(const RxFrame& frame, ITransferBuffer& buf)
+bool TransferReceiver::writePayload(const RxFrame& frame, ITransferBuffer& buf, const TransferCRC& crc_base)
 {
     const uint8_t* const payload = frame.getPayloadPtr();
     const unsigned payload_len = frame.getPayloadLen();
@@ -113,6 +133,8 @@ bool TransferReceiver::writePayload(const RxFrame& frame, ITransferBuffer& buf)
         if (success)
         {
             buffer_write_pos_ = static_cast<uint16_t>(buffer_write_pos_ + effective_payload_len);
+            payload_crc_ = crc_base;
+            payload_crc_.add(payload + TransferCRC::NumBytes, effective_payload_len);
         }
         return success;
     }
@@ -123,18 +145,20 @@ bool TransferReceiver::writePayload(const RxFrame& frame, ITransferBuffer& buf)
         if (success)
         {
             buffer_write_pos_ = static_cast<uint16_t>(buffer_write_pos_ + payload_len);
+            payload_crc_.add(payload, payload_len);
         }
         return success;
     }
 }
 
-TransferReceiver::ResultCode TransferReceiver::receive(const RxFrame& frame, TransferBufferAccessor& tba)
+TransferReceiver::ResultCode TransferReceiver::receive(const RxFrame& frame, TransferBufferAccessor& tba,
+                                                      const TransferCRC& crc_base)
 {
     // Transfer timestamps are derived from the first frame
     if (frame.isStartOfTransfer())
     {
-        this_transfer_ts_ = frame.getMonotonicTimestamp();
-        first_frame_ts_   = frame.getUtcTimestamp();
+        setThisTransferTimestamp(frame.getMonotonicTimestamp());
+        first_frame_ts_ = frame.getUtcTimestamp();
     }
 
     if (frame.isStartOfTransfer() && frame.isEndOfTransfer())
@@ -156,15 +180,15 @@ TransferReceiver::ResultCode TransferReceiver::receive(const RxFrame& frame, Tra
     {
         UAVCAN_TRACE("TransferReceiver", "Failed to access the buffer, %s", frame.toString().c_str());
         prepareForNextTransfer();
-        registerError();
+        registerError(TransferErrorMemory);
         return ResultNotComplete;
     }
-    if (!writePayload(frame, *buf))
+    if (!writePayload(frame, *buf, crc_base))
     {
         UAVCAN_TRACE("TransferReceiver", "Payload write failed, %s", frame.toString().c_str());
         tba.remove();
         prepareForNextTransfer();
-        registerError();
+        registerError(TransferErrorMemory);
         return ResultNotComplete;
     }
     next_toggle_ = !next_toggle_;
@@ -178,15 +202,30 @@ TransferReceiver::ResultCode TransferReceiver::receive(const RxFrame& frame, Tra
     return ResultNotComplete;
 }
 
+MonotonicTime TransferReceiver::getLastTransferTimestampMonotonic() const
+{
+    if (prev_transfer_age_usec_ == PrevTransferAgeUnknown)
+    {
+        return MonotonicTime();
+    }
+    return this_transfer_ts_ - MonotonicDuration::fromUSec(prev_transfer_age_usec_);
+}
+
 bool TransferReceiver::isTimedOut(MonotonicTime current_ts) const
 {
-    return (current_ts - this_transfer_ts_) > getTidTimeout();
+    return current_ts > getExpiryTime();
 }
 
-TransferReceiver::ResultCode TransferReceiver::addFrame(const RxFrame& frame, TransferBufferAccessor& tba)
+TransferReceiver::ResultCode TransferReceiver::addFrame(const RxFrame& frame, TransferBufferAccessor& tba,
+                                                       const TransferCRC& crc_base)
 {
+    UAVCAN_TRACE_POINT(TraceEventReceiverFrame,
+                       (uint32_t(frame.getDataTypeID().get()) << 8) | frame.getSrcNodeID().get(),
+                       buffer_write_pos_,
+                       Frame::compileTailByte(frame.getTransferID(), frame.isStartOfTransfer(),
+                                              frame.isEndOfTransfer(), frame.getToggle()));
+
     if ((frame.getMonotonicTimestamp().isZero()) ||
-        (frame.getMonotonicTimestamp() < prev_transfer_ts_) ||
         (frame.getMonotonicTimestamp() < this_transfer_ts_))
     {
         UAVCAN_TRACE("TransferReceiver", "Invalid frame, %s", frame.toString().c_str());
@@ -212,7 +251,7 @@ TransferReceiver::ResultCode TransferReceiver::addFrame(const RxFrame& frame, Tr
     {
         if (!not_initialized && (tid_ != frame.getTransferID()))
         {
-            registerError();
+            registerError((tid_timed_out && isMidTransfer()) ? TransferErrorTimeout : TransferErrorTransferID);
         }
         UAVCAN_TRACE("TransferReceiver", "Restart [ni=%d, isa=%d, tt=%d, si=%d, ff=%d, nwtid=%d, nptid=%d, tid=%d], %s",
                      int(not_initialized), int(iface_switch_allowed), int(tid_timed_out), int(same_iface),
@@ -235,7 +274,7 @@ TransferReceiver::ResultCode TransferReceiver::addFrame(const RxFrame& frame, Tr
     {
         return ResultNotComplete;
     }
-    return receive(frame, tba);
+    return receive(frame, tba, crc_base);
 }
 
 uint8_t TransferReceiver::yieldErrorCount()
@@ -245,4 +284,11 @@ uint8_t TransferReceiver::yieldErrorCount()
     return ret;
 }
 
+uint8_t TransferReceiver::yieldErrorCauses()
+{
+    const uint8_t ret = error_causes_;
+    error_causes_ = 0;
+    return ret;
+}
+
 }
@@ -4,11 +4,38 @@
 
 #include <uavcan/transport/transfer_sender.hpp>
 #include <uavcan/debug.hpp>
+#include <uavcan/trace.hpp>
 #include <cassert>
 
 
 namespace uavcan
 {
+namespace
+{
+/**
+ * Releases the TX queue memory that was reserved for a multi-frame transfer but not used up.
+ */
+class TxQueueReservationGuard : Noncopyable
+{
+    CanIOManager& canio_;
+    const uint8_t iface_mask_;
+
+public:
+    TxQueueReservationGuard(CanIOManager& canio, uint8_t iface_mask)
+        : canio_(canio)
+        , iface_mask_(iface_mask)
+    { }
+
+    ~TxQueueReservationGuard() { canio_.releaseTxQueueReservations(iface_mask_); }
+};
+
+/**
+ * Frames of the same data type, transfer type, source and destination; the priority is ignored, so that
+ * a priority change doesn't leave stale frames behind.
+ */
+const uint32_t CoalescingCanIDMask =
+    CanFrame::FlagEFF | (CanFrame::MaskExtID & ~(uint32_t(TransferPriority::NumericallyMax) << 24));
+}
 
 void TransferSender::registerError() const
 {
@@ -21,14 +48,96 @@ void TransferSender::init(const DataTypeDescriptor& dtid, CanTxQueue::Qos qos)
 
     qos_          = qos;
     data_type_id_ = dtid.getID();
-    crc_base_     = dtid.getSignature().toTransferCRC();
+    crc_base_     = dtid.getTransferCRCBase();
+
+    single_frame_cache_ = SingleFrameCache();
+}
+
+uint8_t TransferSender::reserveGuaranteedTxMemory(unsigned num_frames) const
+{
+    /*
+     * Single-frame transfers are normally not reserved, they take whatever memory the queue has at the moment.
+     * A reservation is made only to let them reach the guaranteed blocks; the frames that can't be reserved
+     * are still sent as usual.
+     */
+    return use_guaranteed_tx_memory_ ? dispatcher_.getCanIOManager().reserveTxQueues(iface_mask_, num_frames, true)
+                                     : uint8_t(0);
+}
+
+void TransferSender::updateSingleFrameCache(const Frame& frame) const
+{
+    CanFrame can_frame;
+    if (!frame.compile(can_frame))
+    {
+        single_frame_cache_ = SingleFrameCache();
+        return;
+    }
+    single_frame_cache_.can_id           = can_frame.id;
+    single_frame_cache_.src_node_id      = frame.getSrcNodeID().get();
+    single_frame_cache_.dst_node_id      = frame.getDstNodeID().get();
+    single_frame_cache_.transfer_type    = uint8_t(frame.getTransferType());
+    single_frame_cache_.payload_capacity = frame.getPayloadCapacity();
+    single_frame_cache_.canfd            = frame.isCanFDFrame();
+}
+
+void TransferSender::dropSupersededFrames(uint32_t can_id) const
+{
+    const unsigned num_dropped = dispatcher_.getCanIOManager().removeTxQueueFrames(can_id, CoalescingCanIDMask,
+                                                                                  iface_mask_);
+    if (num_dropped > 0)
+    {
+        UAVCAN_TRACE("TransferSender", "Dropped %u superseded frames", num_dropped);
+    }
+}
+
+void TransferSender::dropSupersededFrames(const Frame& frame) const
+{
+    CanFrame can_frame;
+    if (frame.compile(can_frame))
+    {
+        dropSupersededFrames(can_frame.id);
+    }
+}
+
+int TransferSender::sendCachedSingleFrame(CanFrame& can_frame, uint16_t payload_len, MonotonicTime tx_deadline,
+                                          MonotonicTime blocking_deadline, TransferID tid, bool canfd) const
+{
+    UAVCAN_ASSERT(payload_len <= single_frame_cache_.payload_capacity);
+
+    dispatcher_.getTransferPerfCounter().addTxTransfer(TransferType(single_frame_cache_.transfer_type), data_type_id_);
+    UAVCAN_TRACE_POINT(TraceEventTransferSend, data_type_id_.get(), payload_len, tid.get());
+
+    can_frame.id = single_frame_cache_.can_id;
+    Frame::compilePayload(can_frame, can_frame.data, payload_len, Frame::compileTailByte(tid, true, true, false));
+    can_frame.canfd = canfd;
+
+    if (coalescing_)
+    {
+        dropSupersededFrames(can_frame.id);
+    }
+
+    CanIOManager& canio = dispatcher_.getCanIOManager();
+    TxQueueReservationGuard reservation_guard(canio, reserveGuaranteedTxMemory(1));
+
+    return canio.send(can_frame, tx_deadline, blocking_deadline, iface_mask_, qos_, flags_);
 }
 
 int TransferSender::send(const uint8_t* payload, uint16_t payload_len, MonotonicTime tx_deadline,
                          MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id,
                          TransferID tid, bool force_std_can) const
 {
-    Frame frame(data_type_id_, transfer_type, dispatcher_.getNodeID(), dst_node_id, tid, !force_std_can && dispatcher_.isCanFdEnabled());
+    const bool canfd = !force_std_can && dispatcher_.shouldUseCanFd(transfer_type, dst_node_id);
+
+    // Anonymous transfers are never cached, so the passive mode checks below are not needed here
+    if (single_frame_cache_.matches(dispatcher_.getNodeID(), dst_node_id, transfer_type, canfd) &&
+        (payload_len <= single_frame_cache_.payload_capacity))
+    {
+        CanFrame can_frame;
+        (void)copy(payload, payload + payload_len, can_frame.data);
+        return sendCachedSingleFrame(can_frame, payload_len, tx_deadline, blocking_deadline, tid, canfd);
+    }
+
+    Frame frame(data_type_id_, transfer_type, dispatcher_.getNodeID(), dst_node_id, tid, canfd);
 
     frame.setPriority(priority_);
     frame.setStartOfTransfer(true);
@@ -50,7 +159,8 @@ int TransferSender::send(const uint8_t* payload, uint16_t payload_len, Monotonic
         }
     }
 
-    dispatcher_.getTransferPerfCounter().addTxTransfer();
+    dispatcher_.getTransferPerfCounter().addTxTransfer(transfer_type, data_type_id_);
+    UAVCAN_TRACE_POINT(TraceEventTransferSend, data_type_id_.get(), payload_len, tid.get());
 
     /*
      * Sending frames
@@ -71,6 +181,17 @@ int TransferSender::send(const uint8_t* payload, uint16_t payload_len, Monotonic
 
         const CanIOFlags flags = frame.getSrcNodeID().isUnicast() ? flags_ : (flags_ | CanIOFlagAbortOnError);
 
+        if (frame.getSrcNodeID().isUnicast())
+        {
+            updateSingleFrameCache(frame);
+            if (coalescing_)
+            {
+                dropSupersededFrames(frame);
+            }
+        }
+
+        TxQueueReservationGuard reservation_guard(dispatcher_.getCanIOManager(), reserveGuaranteedTxMemory(1));
+
         return dispatcher_.send(frame, tx_deadline, blocking_deadline, qos_, flags, iface_mask_);
     }
     else                                                   // Multi Frame Transfer
@@ -78,17 +199,15 @@ int TransferSender::send(const uint8_t* payload, uint16_t payload_len, Monotonic
         UAVCAN_ASSERT(!dispatcher_.isPassiveMode());
         UAVCAN_ASSERT(frame.getSrcNodeID().isUnicast());
 
+        const TransferFramePlan plan(payload_len, frame.getPayloadCapacity());
+
         int offset = 0;
         {
             TransferCRC crc = crc_base_;
             crc.add(payload, payload_len);
-            // Take care of potential padding introduce in CANFD frames over 8Bytes
-            if (payload_len > 63 && frame.isCanFDFrame()) {
-                uint8_t empty = 0;
-                uint8_t padding = CanFrame::getNumPaddingBytes(payload_len);
-                for (uint8_t i=0; i<padding; i++) {
-                    crc.add(&empty, 1);
-                }
+            for (uint8_t i = 0; i < plan.num_padding_bytes; i++)    // The receivers will see the padding
+            {
+                crc.add(uint8_t(0));
             }
 
             static const int BUFLEN = sizeof(static_cast<CanFrame*>(0)->data);
@@ -96,7 +215,7 @@ int TransferSender::send(const uint8_t* payload, uint16_t payload_len, Monotonic
 
             buf[0] = uint8_t(crc.get() & 0xFFU);       // Transfer CRC, little endian
             buf[1] = uint8_t((crc.get() >> 8) & 0xFF);
-            (void)copy(payload, payload + BUFLEN - 2, buf + 2);
+            (void)copy(payload, payload + min(unsigned(payload_len), unsigned(BUFLEN - 2)), buf + 2);
 
             const int write_res = frame.setPayload(buf, BUFLEN);
             if (write_res < 2)
@@ -109,11 +228,31 @@ int TransferSender::send(const uint8_t* payload, uint16_t payload_len, Monotonic
             UAVCAN_ASSERT(int(payload_len) > offset);
         }
 
+        /*
+         * The transfer is admitted by every interface either as a whole or not at all.
+         */
+        const unsigned num_frames = plan.num_frames;
+
+        if (coalescing_)
+        {
+            dropSupersededFrames(frame);        // Before the reservation, so that the freed memory can be taken
+        }
+
+        CanIOManager& canio = dispatcher_.getCanIOManager();
+        const uint8_t iface_mask = canio.reserveTxQueues(iface_mask_, num_frames, use_guaranteed_tx_memory_);
+        TxQueueReservationGuard reservation_guard(canio, iface_mask);
+        if (iface_mask == 0)
+        {
+            UAVCAN_TRACE("TransferSender", "Transfer of %u frames rejected: no TX queue memory", num_frames);
+            registerError();
+            return -ErrMemory;
+        }
+
         int num_sent = 0;
 
         while (true)
         {
-            const int send_res = dispatcher_.send(frame, tx_deadline, blocking_deadline, qos_, flags_, iface_mask_);
+            const int send_res = dispatcher_.send(frame, tx_deadline, blocking_deadline, qos_, flags_, iface_mask);
             if (send_res < 0)
             {
                 registerError();
@@ -123,6 +262,7 @@ int TransferSender::send(const uint8_t* payload, uint16_t payload_len, Monotonic
             num_sent++;
             if (frame.isEndOfTransfer())
             {
+                UAVCAN_ASSERT(unsigned(num_sent) == num_frames);
                 return num_sent;  // Number of frames transmitted
             }
 
@@ -151,9 +291,8 @@ int TransferSender::send(const uint8_t* payload, uint16_t payload_len, Monotonic
     return -ErrLogic; // Return path analysis is apparently broken. There should be no warning, this 'return' is unreachable.
 }
 
-int TransferSender::send(const uint8_t* payload, uint16_t payload_len, MonotonicTime tx_deadline,
-                         MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id,
-                         bool force_std_can) const
+int TransferSender::allocateTransferID(TransferType transfer_type, NodeID dst_node_id, MonotonicTime tx_deadline,
+                                       TransferID& out_tid) const
 {
     /*
      * TODO: TID is not needed for anonymous transfers, this part of the code can be skipped?
@@ -164,7 +303,8 @@ int TransferSender::send(const uint8_t* payload, uint16_t payload_len, Monotonic
     const MonotonicTime otr_deadline = tx_deadline + max(max_transfer_interval_ * 2,
                                                          OutgoingTransferRegistry::MinEntryLifetime);
 
-    TransferID* const tid = dispatcher_.getOutgoingTransferRegistry().accessOrCreate(otr_key, otr_deadline);
+    TransferID* const tid =
+        dispatcher_.getOutgoingTransferRegistry().accessOrCreate(otr_key, otr_deadline, otr_cache_);
     if (tid == UAVCAN_NULLPTR)
     {
         UAVCAN_TRACE("TransferSender", "OTR access failure, dtid=%d tt=%i",
@@ -172,11 +312,55 @@ int TransferSender::send(const uint8_t* payload, uint16_t payload_len, Monotonic
         return -ErrMemory;
     }
 
-    const TransferID this_tid = tid->get();
+    out_tid = tid->get();
     tid->increment();
+    return 0;
+}
+
+int TransferSender::send(const uint8_t* payload, uint16_t payload_len, MonotonicTime tx_deadline,
+                         MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id,
+                         bool force_std_can) const
+{
+    TransferID this_tid;
+    const int res = allocateTransferID(transfer_type, dst_node_id, tx_deadline, this_tid);
+    if (res < 0)
+    {
+        return res;
+    }
 
     return send(payload, payload_len, tx_deadline, blocking_deadline, transfer_type,
                 dst_node_id, this_tid, force_std_can);
 }
 
+int TransferSender::sendInPlace(CanFrame& can_frame, uint16_t payload_len, MonotonicTime tx_deadline,
+                                MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id,
+                                TransferID tid, bool force_std_can) const
+{
+    const bool canfd = !force_std_can && dispatcher_.shouldUseCanFd(transfer_type, dst_node_id);
+
+    if (single_frame_cache_.matches(dispatcher_.getNodeID(), dst_node_id, transfer_type, canfd) &&
+        (payload_len <= single_frame_cache_.payload_capacity))
+    {
+        return sendCachedSingleFrame(can_frame, payload_len, tx_deadline, blocking_deadline, tid, canfd);
+    }
+
+    return send(can_frame.data, payload_len, tx_deadline, blocking_deadline, transfer_type, dst_node_id, tid,
+                force_std_can);
+}
+
+int TransferSender::sendInPlace(CanFrame& can_frame, uint16_t payload_len, MonotonicTime tx_deadline,
+                                MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id,
+                                bool force_std_can) const
+{
+    TransferID this_tid;
+    const int res = allocateTransferID(transfer_type, dst_node_id, tx_deadline, this_tid);
+    if (res < 0)
+    {
+        return res;
+    }
+
+    return sendInPlace(can_frame, payload_len, tx_deadline, blocking_deadline, transfer_type,
+                       dst_node_id, this_tid, force_std_can);
+}
+
 }
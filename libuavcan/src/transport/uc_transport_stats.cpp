@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/transport/transport_stats.hpp>
+
+#if UAVCAN_TRANSPORT_STATS
+
+namespace uavcan
+{
+/*
+ * LatencyHistogram
+ */
+void LatencyHistogram::add(MonotonicDuration duration)
+{
+    const int64_t usec = duration.toUSec();
+    const uint32_t clamped_usec = (usec <= 0) ? 0U :
+                                  uint32_t(min(usec, int64_t(NumericTraits<uint32_t>::max())));
+
+    unsigned index = 0;
+    uint32_t bound = FirstBucketUpperBoundUSec;
+    while ((index < (NumBuckets - 1U)) && (clamped_usec >= bound))
+    {
+        index++;
+        bound <<= 1;
+    }
+
+    buckets_[index]++;
+    count_++;
+    total_usec_ += clamped_usec;
+    max_usec_ = max(max_usec_, clamped_usec);
+}
+
+void LatencyHistogram::reset()
+{
+    fill(buckets_, buckets_ + NumBuckets, 0U);
+    total_usec_ = 0;
+    count_ = 0;
+    max_usec_ = 0;
+}
+
+/*
+ * TransportStats
+ */
+unsigned TransportStats::computeHash(uint32_t key)
+{
+    const uint32_t product = static_cast<uint32_t>((key & 0x1FFFFU) * 2654435761U);
+    return static_cast<unsigned>(product >> 16) & (Capacity - 1U);
+}
+
+TransportStats::Entry* TransportStats::findOrCreateEntry(uint32_t key)
+{
+    unsigned index = computeHash(key);
+    for (unsigned i = 0; i < Capacity; i++)
+    {
+        if (entries_[index].key == key)
+        {
+            return &entries_[index];
+        }
+        if (entries_[index].key == 0)
+        {
+            Entry& entry = entries_[index];
+            entry.key = key;
+            entry.transfers_tx = 0;
+            entry.transfers_rx = 0;
+            num_entries_++;
+            return &entry;
+        }
+        index = (index + 1U) & (Capacity - 1U);
+    }
+    return UAVCAN_NULLPTR;
+}
+
+unsigned TransportStats::findSourceSlot(uint32_t key) const
+{
+    unsigned index = unsigned(static_cast<uint32_t>(key * 2654435761U) >> 16) & (SourceCapacity - 1U);
+    for (unsigned i = 0; i < SourceCapacity; i++)
+    {
+        if ((sources_[index].key == key) || (sources_[index].key == 0))
+        {
+            return index;
+        }
+        index = (index + 1U) & (SourceCapacity - 1U);
+    }
+    return SourceCapacity;
+}
+
+TransportStats::SourceEntry* TransportStats::findOrCreateSourceEntry(uint32_t key)
+{
+    const unsigned index = findSourceSlot(key);
+    if (index >= SourceCapacity)
+    {
+        num_untracked_source_events_++;
+        return UAVCAN_NULLPTR;
+    }
+    SourceEntry& entry = sources_[index];
+    if (entry.key == 0)
+    {
+        entry = SourceEntry();
+        entry.key = key;
+        num_source_entries_++;
+    }
+    return &entry;
+}
+
+void TransportStats::addTxTransfer(TransferType transfer_type, DataTypeID dtid)
+{
+    Entry* const entry = findOrCreateEntry(makeKey(transfer_type, dtid));
+    if (entry != UAVCAN_NULLPTR)
+    {
+        entry->transfers_tx++;
+    }
+    else
+    {
+        num_untracked_transfers_++;
+    }
+}
+
+void TransportStats::addRxTransfer(TransferType transfer_type, DataTypeID dtid)
+{
+    Entry* const entry = findOrCreateEntry(makeKey(transfer_type, dtid));
+    if (entry != UAVCAN_NULLPTR)
+    {
+        entry->transfers_rx++;
+    }
+    else
+    {
+        num_untracked_transfers_++;
+    }
+}
+
+void TransportStats::addRxSourceTransfer(TransferType transfer_type, NodeID src_node_id, DataTypeID dtid,
+                                         TransferID tid)
+{
+    SourceEntry* const entry = findOrCreateSourceEntry(makeSourceKey(transfer_type, src_node_id, dtid));
+    if (entry == UAVCAN_NULLPTR)
+    {
+        return;
+    }
+    if (entry->has_transfer_id)
+    {
+        const int distance = TransferID(entry->last_transfer_id).computeForwardDistance(tid);
+        if (distance == 0)
+        {
+            entry->duplicates++;
+            return;
+        }
+        if ((distance > 1) && (distance < int(TransferID::Half)))
+        {
+            entry->gaps++;
+            entry->transfers_lost += uint32_t(distance - 1);
+        }
+        // A backward jump means that the source has restarted; that is not counted
+    }
+    entry->transfers_rx++;
+    entry->last_transfer_id = tid.get();
+    entry->has_transfer_id = true;
+}
+
+void TransportStats::addRxSourceStartOfTransfer(TransferType transfer_type, NodeID src_node_id, DataTypeID dtid,
+                                                TransferID tid)
+{
+    // Not creating an entry here, since a stream that has not delivered a transfer yet has no duplicates
+    const unsigned index = findSourceSlot(makeSourceKey(transfer_type, src_node_id, dtid));
+    if (index < SourceCapacity)
+    {
+        SourceEntry& entry = sources_[index];
+        if ((entry.key != 0) && entry.has_transfer_id && (entry.last_transfer_id == tid.get()))
+        {
+            entry.duplicates++;
+        }
+    }
+}
+
+void TransportStats::addRxSourceErrors(TransferType transfer_type, NodeID src_node_id, DataTypeID dtid,
+                                       uint8_t cause_mask)
+{
+    if (cause_mask == 0)
+    {
+        return;
+    }
+    SourceEntry* const entry = findOrCreateSourceEntry(makeSourceKey(transfer_type, src_node_id, dtid));
+    if (entry == UAVCAN_NULLPTR)
+    {
+        return;
+    }
+    if ((cause_mask & (1U << TransferErrorTimeout)) != 0)
+    {
+        entry->timeouts++;
+    }
+    if ((cause_mask & ~(1U << TransferErrorTimeout)) != 0)
+    {
+        entry->errors++;
+    }
+}
+
+void TransportStats::addRxErrors(uint8_t cause_mask)
+{
+    for (unsigned i = 0; (cause_mask != 0) && (i < NumTransferErrorCauses); i++)
+    {
+        if ((cause_mask & (1U << i)) != 0)
+        {
+            rx_errors_[i]++;
+            cause_mask = uint8_t(cause_mask & ~(1U << i));
+        }
+    }
+}
+
+void TransportStats::reset()
+{
+    for (unsigned i = 0; i < Capacity; i++)
+    {
+        entries_[i].key = 0;
+        entries_[i].transfers_tx = 0;
+        entries_[i].transfers_rx = 0;
+    }
+    for (unsigned i = 0; i < SourceCapacity; i++)
+    {
+        sources_[i] = SourceEntry();
+    }
+    rx_latency_.reset();
+    fill(rx_errors_, rx_errors_ + NumTransferErrorCauses, 0U);
+    num_untracked_transfers_ = 0;
+    num_untracked_source_events_ = 0;
+    num_entries_ = 0;
+    num_source_entries_ = 0;
+}
+
+const TransportStats::Entry* TransportStats::findEntry(DataTypeKind kind, DataTypeID dtid) const
+{
+    const uint32_t key = makeKey(kind, dtid);
+    unsigned index = computeHash(key);
+    for (unsigned i = 0; i < Capacity; i++)
+    {
+        if (entries_[index].key == key)
+        {
+            return &entries_[index];
+        }
+        if (entries_[index].key == 0)
+        {
+            break;
+        }
+        index = (index + 1U) & (Capacity - 1U);
+    }
+    return UAVCAN_NULLPTR;
+}
+
+const TransportStats::SourceEntry* TransportStats::findSourceEntry(TransferType transfer_type, NodeID src_node_id,
+                                                                   DataTypeID dtid) const
+{
+    const unsigned index = findSourceSlot(makeSourceKey(transfer_type, src_node_id, dtid));
+    return ((index < SourceCapacity) && (sources_[index].key != 0)) ? &sources_[index] : UAVCAN_NULLPTR;
+}
+
+}
+
+#endif
@@ -3,6 +3,7 @@
  */
 
 #include <uavcan/dynamic_memory.hpp>
+#include <uavcan/debug.hpp>
 
 namespace uavcan
 {
@@ -13,8 +14,12 @@ void* LimitedPoolAllocator::allocate(std::size_t size)
 {
     if (used_blocks_ < max_blocks_)
     {
-        used_blocks_++;
-        return allocator_.allocate(size);
+        void* const ptr = allocator_.allocate(size);
+        if (ptr != UAVCAN_NULLPTR)
+        {
+            used_blocks_++;     // Failed allocations must not be accounted, otherwise the limit would shrink
+        }
+        return ptr;
     }
     else
     {
@@ -38,4 +43,252 @@ uint16_t LimitedPoolAllocator::getBlockCapacity() const
     return min(max_blocks_, allocator_.getBlockCapacity());
 }
 
+/*
+ * GuaranteedPoolAllocator
+ */
+void GuaranteedPoolAllocator::releaseReserve(uint16_t num_blocks_to_keep)
+{
+    while ((num_reserved_blocks_ > num_blocks_to_keep) && (reserve_ != UAVCAN_NULLPTR))
+    {
+        ReservedBlock* const block = reserve_;
+        reserve_ = block->next;
+        num_reserved_blocks_--;
+        allocator_.deallocateTagged(block, getTag());
+    }
+}
+
+void* GuaranteedPoolAllocator::allocate(std::size_t size)
+{
+    void* const ptr = allocator_.allocateTagged(size, getTag());
+    if ((ptr != UAVCAN_NULLPTR) || (reserve_ == UAVCAN_NULLPTR) || (size > MemPoolBlockSize))
+    {
+        return ptr;
+    }
+    ReservedBlock* const block = reserve_;
+    reserve_ = block->next;
+    num_reserved_blocks_--;
+    UAVCAN_TRACE("GuaranteedPoolAllocator", "Reserved block taken, %u left", unsigned(num_reserved_blocks_));
+    return block;
+}
+
+void GuaranteedPoolAllocator::deallocate(const void* ptr)
+{
+    if (ptr == UAVCAN_NULLPTR)
+    {
+        return;
+    }
+    /*
+     * The block may be smaller than the reserve requires, e.g. a compact TX queue entry from a pool with several
+     * size classes, so it is never kept as is; the reserve is refilled with a new block of the full size instead.
+     * With a single block size this takes back the same block.
+     */
+    allocator_.deallocateTagged(ptr, getTag());
+    if (num_reserved_blocks_ < min_blocks_)
+    {
+        void* const praw = allocator_.allocateTagged(MemPoolBlockSize, getTag());
+        if (praw == UAVCAN_NULLPTR)
+        {
+            UAVCAN_TRACE("GuaranteedPoolAllocator", "Reserve refill failed, %u blocks", unsigned(num_reserved_blocks_));
+            return;
+        }
+        ReservedBlock* const block = new (praw) ReservedBlock;
+        block->next = reserve_;
+        reserve_ = block;
+        num_reserved_blocks_++;
+    }
+}
+
+bool GuaranteedPoolAllocator::setMinBlocks(std::size_t min_blocks)
+{
+    const uint16_t new_min_blocks = static_cast<uint16_t>(min<std::size_t>(min_blocks, 0xFFFFU));
+
+    /*
+     * The reserve may be partially used up at the moment, in which case only the difference is allocated;
+     * the rest will be refilled by the deallocations as usual.
+     */
+    const unsigned used_from_reserve = unsigned(min_blocks_ - num_reserved_blocks_);
+    if (new_min_blocks <= min_blocks_)
+    {
+        min_blocks_ = new_min_blocks;
+        releaseReserve(uint16_t((new_min_blocks > used_from_reserve) ? (new_min_blocks - used_from_reserve) : 0U));
+        return true;
+    }
+
+    ReservedBlock* list = UAVCAN_NULLPTR;
+    unsigned num_allocated = 0;
+    const unsigned num_needed = unsigned(new_min_blocks - min_blocks_);
+    while (num_allocated < num_needed)
+    {
+        void* const praw = allocator_.allocateTagged(MemPoolBlockSize, getTag());
+        if (praw == UAVCAN_NULLPTR)
+        {
+            break;
+        }
+        ReservedBlock* const block = new (praw) ReservedBlock;
+        block->next = list;
+        list = block;
+        num_allocated++;
+    }
+
+    if (num_allocated < num_needed)
+    {
+        UAVCAN_TRACE("GuaranteedPoolAllocator", "Reservation of %u blocks rejected", num_needed);
+        while (list != UAVCAN_NULLPTR)
+        {
+            ReservedBlock* const next = list->next;
+            allocator_.deallocateTagged(list, getTag());
+            list = next;
+        }
+        return false;
+    }
+
+    while (list != UAVCAN_NULLPTR)
+    {
+        ReservedBlock* const next = list->next;
+        list->next = reserve_;
+        reserve_ = list;
+        list = next;
+    }
+    num_reserved_blocks_ = uint16_t(num_reserved_blocks_ + num_allocated);
+    min_blocks_ = new_min_blocks;
+    return true;
+}
+
+/*
+ * PoolUsageTracker
+ */
+void* PoolUsageTracker::allocateTagged(std::size_t size, PoolUsageTag tag)
+{
+    UAVCAN_ASSERT(tag < NumPoolUsageTags);
+    Usage& usage = usage_[(tag < NumPoolUsageTags) ? tag : PoolUsageTagOther];
+
+    void* const ptr = allocator_.allocate(size);
+    if (ptr == UAVCAN_NULLPTR)
+    {
+        usage.failures++;
+        return UAVCAN_NULLPTR;
+    }
+
+    if (usage.used < 0xFFFFU)
+    {
+        usage.used++;
+    }
+    if (usage.used > usage.max_used)
+    {
+        usage.max_used = usage.used;
+    }
+    return ptr;
+}
+
+void PoolUsageTracker::deallocateTagged(const void* ptr, PoolUsageTag tag)
+{
+    if (ptr == UAVCAN_NULLPTR)
+    {
+        return;
+    }
+    allocator_.deallocate(ptr);
+
+    UAVCAN_ASSERT(tag < NumPoolUsageTags);
+    Usage& usage = usage_[(tag < NumPoolUsageTags) ? tag : PoolUsageTagOther];
+    UAVCAN_ASSERT(usage.used > 0);
+    if (usage.used > 0)
+    {
+        usage.used--;
+    }
+}
+
+uint16_t PoolUsageTracker::getNumUsedBlocks(PoolUsageTag tag) const
+{
+    return (tag < NumPoolUsageTags) ? usage_[tag].used : 0;
+}
+
+uint16_t PoolUsageTracker::getPeakNumUsedBlocks(PoolUsageTag tag) const
+{
+    return (tag < NumPoolUsageTags) ? usage_[tag].max_used : 0;
+}
+
+uint32_t PoolUsageTracker::getNumFailedAllocations(PoolUsageTag tag) const
+{
+    return (tag < NumPoolUsageTags) ? usage_[tag].failures : 0;
+}
+
+uint16_t PoolUsageTracker::getTotalNumUsedBlocks() const
+{
+    unsigned total = 0;
+    for (unsigned i = 0; i < NumPoolUsageTags; i++)
+    {
+        total += usage_[i].used;
+    }
+    return static_cast<uint16_t>(min(total, 0xFFFFU));
+}
+
+void PoolUsageTracker::resetPeaks()
+{
+    for (unsigned i = 0; i < NumPoolUsageTags; i++)
+    {
+        usage_[i].max_used = usage_[i].used;
+    }
+}
+
+/*
+ * PoolAllocatorRouter
+ */
+bool PoolAllocatorRouter::isFirstOccurrence(unsigned index) const
+{
+    for (unsigned i = 0; i < index; i++)
+    {
+        if (allocators_[i] == allocators_[index])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint16_t PoolAllocatorRouter::getBlockCapacity() const
+{
+    unsigned total = 0;
+    for (unsigned i = 0; i < NumPoolUsageTags; i++)
+    {
+        total += isFirstOccurrence(i) ? allocators_[i]->getBlockCapacity() : 0U;
+    }
+    return static_cast<uint16_t>(min(total, 0xFFFFU));
+}
+
+uint16_t PoolAllocatorRouter::getNumUsedBlocks() const
+{
+    unsigned total = 0;
+    for (unsigned i = 0; i < NumPoolUsageTags; i++)
+    {
+        total += isFirstOccurrence(i) ? allocators_[i]->getNumUsedBlocks() : 0U;
+    }
+    return static_cast<uint16_t>(min(total, 0xFFFFU));
+}
+
+void* PoolAllocatorRouter::allocateTagged(std::size_t size, PoolUsageTag tag)
+{
+    UAVCAN_ASSERT(tag < NumPoolUsageTags);
+    return getAllocator(tag).allocateTagged(size, tag);
+}
+
+void PoolAllocatorRouter::deallocateTagged(const void* ptr, PoolUsageTag tag)
+{
+    UAVCAN_ASSERT(tag < NumPoolUsageTags);
+    getAllocator(tag).deallocateTagged(ptr, tag);
+}
+
+void PoolAllocatorRouter::setAllocator(PoolUsageTag tag, IPoolAllocator& allocator)
+{
+    UAVCAN_ASSERT(&allocator != this);
+    if ((tag < NumPoolUsageTags) && (&allocator != this))
+    {
+        allocators_[tag] = &allocator;
+    }
+}
+
+IPoolAllocator& PoolAllocatorRouter::getAllocator(PoolUsageTag tag) const
+{
+    return *allocators_[(tag < NumPoolUsageTags) ? tag : PoolUsageTagOther];
+}
+
 }
@@ -0,0 +1,28 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/trace.hpp>
+
+#if UAVCAN_TRACE_POINTS
+
+namespace uavcan
+{
+namespace
+{
+ITraceSink* trace_sink = UAVCAN_NULLPTR;
+}
+
+void setTraceSink(ITraceSink* sink)
+{
+    trace_sink = sink;
+}
+
+ITraceSink* getTraceSink()
+{
+    return trace_sink;
+}
+
+}
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <thread>
+#include <gtest/gtest.h>
+#include <uavcan/driver/rx_ring.hpp>
+#include "../clock.hpp"
+
+
+static uavcan::CanFrame makeFrame(uavcan::uint32_t id)
+{
+    const uavcan::uint8_t data[4] =
+    {
+        uavcan::uint8_t(id), uavcan::uint8_t(id >> 8), uavcan::uint8_t(id >> 16), uavcan::uint8_t(id >> 24)
+    };
+    return uavcan::CanFrame((id & uavcan::CanFrame::MaskExtID) | uavcan::CanFrame::FlagEFF, data, sizeof(data));
+}
+
+
+TEST(CanRxRing, Basic)
+{
+    uavcan::CanRxRing<4> ring;
+    ASSERT_TRUE(ring.isEmpty());
+    ASSERT_EQ(0, ring.getNumOverflows());
+
+    uavcan::CanFrame frame;
+    uavcan::MonotonicTime ts_mono;
+    uavcan::UtcTime ts_utc;
+    uavcan::CanIOFlags flags = 0;
+    ASSERT_EQ(0, ring.receive(frame, ts_mono, ts_utc, flags));
+
+    ASSERT_TRUE(ring.push(makeFrame(1), tsMono(10), tsUtc(20)));
+    ASSERT_TRUE(ring.push(makeFrame(2), tsMono(11), tsUtc(21), uavcan::CanIOFlagLoopback));
+
+    // Zero-copy insertion
+    uavcan::CanRxFrame* const slot = ring.beginPush();
+    ASSERT_TRUE(slot);
+    static_cast<uavcan::CanFrame&>(*slot) = makeFrame(3);
+    slot->ts_mono = tsMono(12);
+    ring.commitPush();
+
+    ASSERT_TRUE(ring.push(makeFrame(4), tsMono(13), tsUtc(23)));
+    ASSERT_EQ(4, ring.getSize());
+    ASSERT_EQ(4, ring.getPeakSize());
+
+    // Overflow - the new frame is dropped
+    ASSERT_FALSE(ring.push(makeFrame(5), tsMono(14), tsUtc(24)));
+    ASSERT_FALSE(ring.beginPush());
+    ASSERT_EQ(2, ring.getNumOverflows());
+    ASSERT_EQ(4, ring.getSize());
+
+    ASSERT_EQ(1, ring.receive(frame, ts_mono, ts_utc, flags));
+    ASSERT_TRUE(frame == makeFrame(1));
+    ASSERT_EQ(10, ts_mono.toUSec());
+    ASSERT_EQ(20, ts_utc.toUSec());
+    ASSERT_EQ(0, flags);
+
+    ASSERT_EQ(1, ring.receive(frame, ts_mono, ts_utc, flags));
+    ASSERT_TRUE(frame == makeFrame(2));
+    ASSERT_EQ(uavcan::CanIOFlagLoopback, flags);
+
+    // Batch reception is limited by the output capacity
+    uavcan::CanRxFrame frames[8];
+    uavcan::CanIOFlags frame_flags[8] = { };
+    ASSERT_EQ(1, ring.receiveBatch(frames, frame_flags, 1));
+    ASSERT_TRUE(frames[0] == makeFrame(3));
+    ASSERT_EQ(12, frames[0].ts_mono.toUSec());
+    ASSERT_EQ(0, frames[0].ts_utc.toUSec());
+
+    // Wrapping around the end of the storage
+    ASSERT_TRUE(ring.push(makeFrame(6), tsMono(15), tsUtc(25)));
+    ASSERT_TRUE(ring.push(makeFrame(7), tsMono(16), tsUtc(26)));
+    ASSERT_EQ(3, ring.receiveBatch(frames, frame_flags, 8));
+    ASSERT_TRUE(frames[0] == makeFrame(4));
+    ASSERT_TRUE(frames[1] == makeFrame(6));
+    ASSERT_TRUE(frames[2] == makeFrame(7));
+    ASSERT_TRUE(ring.isEmpty());
+    ASSERT_EQ(0, ring.receiveBatch(frames, frame_flags, 8));
+
+    ASSERT_TRUE(ring.push(makeFrame(8), tsMono(17), tsUtc(27)));
+    ring.clear();
+    ASSERT_TRUE(ring.isEmpty());
+    ASSERT_EQ(2, ring.getNumOverflows());
+    ASSERT_EQ(4, ring.getPeakSize());
+}
+
+
+TEST(CanRxRing, ConcurrentProducer)
+{
+    static const unsigned NumFrames = 200000;
+    static uavcan::CanRxRing<64> ring;
+
+    std::thread producer([]()
+    {
+        for (unsigned i = 0; i < NumFrames; i++)
+        {
+            while (!ring.push(makeFrame(i), tsMono(i + 1U), tsUtc(0)))
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    // Every frame must arrive exactly once and in order, despite overflows
+    unsigned expected = 0;
+    uavcan::CanRxFrame frames[16];
+    uavcan::CanIOFlags flags[16];
+    while (expected < NumFrames)
+    {
+        const int res = ring.receiveBatch(frames, flags, 16);
+        ASSERT_LE(0, res);
+        for (int i = 0; i < res; i++)
+        {
+            ASSERT_TRUE(frames[i] == makeFrame(expected));
+            ASSERT_EQ(expected + 1U, frames[i].ts_mono.toUSec());
+            expected++;
+        }
+    }
+    producer.join();
+
+    ASSERT_TRUE(ring.isEmpty());
+    ASSERT_GE(64, ring.getPeakSize());
+}
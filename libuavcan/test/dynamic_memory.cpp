@@ -71,4 +71,276 @@ TEST(DynamicMemory, LimitedPoolAllocator)
     EXPECT_FALSE(ptr6);
 
     EXPECT_EQ(2, pool32.getPeakNumUsedBlocks());
+
+    // Limit adjustment
+    EXPECT_EQ(2, lim.getNumUsedBlocks());
+    lim.setMaxBlocks(1);
+    EXPECT_EQ(1, lim.getMaxBlocks());
+    EXPECT_FALSE(lim.allocate(1));
+    lim.deallocate(ptr4);
+    EXPECT_FALSE(lim.allocate(1));      // Still at the limit
+    lim.setMaxBlocks(8);
+    const void* ptr7 = lim.allocate(1);
+    const void* ptr8 = lim.allocate(1);
+    const void* ptr9 = lim.allocate(1);
+    const void* ptr10 = lim.allocate(1);
+    EXPECT_TRUE(ptr7);
+    EXPECT_TRUE(ptr8);
+    EXPECT_TRUE(ptr9);
+    EXPECT_FALSE(ptr10);                // The underlying pool is exhausted
+    EXPECT_EQ(4, lim.getNumUsedBlocks());
+    EXPECT_EQ(4, lim.getBlockCapacity());
+}
+
+TEST(DynamicMemory, GuaranteedPoolAllocator)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+    uavcan::GuaranteedPoolAllocator guaranteed(pool);
+
+    // No reservation - pass-through
+    EXPECT_EQ(8, guaranteed.getBlockCapacity());
+    void* ptr1 = guaranteed.allocate(1);
+    EXPECT_TRUE(ptr1);
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+    guaranteed.deallocate(ptr1);
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+
+    // All or nothing
+    EXPECT_FALSE(guaranteed.setMinBlocks(9));
+    EXPECT_EQ(0, guaranteed.getMinBlocks());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+    EXPECT_TRUE(guaranteed.setMinBlocks(2));
+    EXPECT_EQ(2, guaranteed.getMinBlocks());
+    EXPECT_EQ(2, guaranteed.getNumReservedBlocks());
+    EXPECT_EQ(2, pool.getNumUsedBlocks());
+
+    // The rest of the pool is used up by someone else; the reserve is used then
+    void* others[6];
+    for (auto& ptr : others)
+    {
+        ptr = pool.allocate(1);
+        EXPECT_TRUE(ptr);
+    }
+    EXPECT_FALSE(guaranteed.allocateUnreserved(1));
+    ptr1 = guaranteed.allocate(1);
+    void* const ptr2 = guaranteed.allocate(uavcan::MemPoolBlockSize);
+    EXPECT_TRUE(ptr1);
+    EXPECT_TRUE(ptr2);
+    EXPECT_FALSE(guaranteed.allocate(1));
+    EXPECT_EQ(0, guaranteed.getNumReservedBlocks());
+
+    // The reserve is refilled first
+    pool.deallocate(others[0]);
+    void* const ptr3 = guaranteed.allocate(1);
+    EXPECT_TRUE(ptr3);
+    EXPECT_EQ(8, pool.getNumUsedBlocks());
+    guaranteed.deallocate(ptr1);
+    guaranteed.deallocate(ptr2);
+    EXPECT_EQ(2, guaranteed.getNumReservedBlocks());
+    EXPECT_EQ(8, pool.getNumUsedBlocks());
+    guaranteed.deallocate(ptr3);
+    EXPECT_EQ(2, guaranteed.getNumReservedBlocks());
+    EXPECT_EQ(7, pool.getNumUsedBlocks());
+
+    // Raising while the reserve is partially used takes only the difference
+    ptr1 = guaranteed.allocate(1);    // From the pool
+    void* const ptr4 = guaranteed.allocate(1);
+    EXPECT_EQ(1, guaranteed.getNumReservedBlocks());
+    EXPECT_FALSE(guaranteed.setMinBlocks(3));   // Pool exhausted
+    EXPECT_EQ(2, guaranteed.getMinBlocks());
+    for (unsigned i = 1; i < 6; i++)
+    {
+        pool.deallocate(others[i]);
+    }
+    EXPECT_TRUE(guaranteed.setMinBlocks(4));
+    EXPECT_EQ(3, guaranteed.getNumReservedBlocks());    // One is still in use
+    guaranteed.deallocate(ptr4);
+    EXPECT_EQ(4, guaranteed.getNumReservedBlocks());
+    guaranteed.deallocate(ptr1);
+    EXPECT_EQ(4, guaranteed.getNumReservedBlocks());
+    EXPECT_EQ(4, pool.getNumUsedBlocks());
+
+    // Lowering
+    EXPECT_TRUE(guaranteed.setMinBlocks(1));
+    EXPECT_EQ(1, guaranteed.getNumReservedBlocks());
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+
+    // Large allocations are not served from the reserve
+    EXPECT_FALSE(guaranteed.allocate(uavcan::MemPoolBlockSize + 1));
+    EXPECT_EQ(1, guaranteed.getNumReservedBlocks());
+
+    EXPECT_TRUE(guaranteed.setMinBlocks(0));
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+}
+
+TEST(DynamicMemory, SegregatedPoolAllocator)
+{
+    uavcan::SegregatedPoolAllocator<32 * 2, 32, 64 * 2, 64, 128 * 2, 128> pool;
+
+    EXPECT_EQ(6, pool.getBlockCapacity());
+    EXPECT_EQ(6, pool.getNumFreeBlocks());
+
+    // Best fit
+    const void* small1 = pool.allocate(20);
+    const void* medium1 = pool.allocate(33);
+    const void* large1 = pool.allocate(128);
+    ASSERT_TRUE(small1);
+    ASSERT_TRUE(medium1);
+    ASSERT_TRUE(large1);
+    EXPECT_EQ(1, pool.getSmallPool().getNumUsedBlocks());
+    EXPECT_EQ(1, pool.getMediumPool().getNumUsedBlocks());
+    EXPECT_EQ(1, pool.getLargePool().getNumUsedBlocks());
+    EXPECT_FALSE(pool.allocate(129));
+
+    // Exhausted classes fall back to the larger ones
+    const void* small2 = pool.allocate(32);
+    const void* small3 = pool.allocate(1);          // Medium
+    const void* small4 = pool.allocate(1);          // Large
+    ASSERT_TRUE(small2);
+    ASSERT_TRUE(small3);
+    ASSERT_TRUE(small4);
+    EXPECT_FALSE(pool.allocate(1));
+    EXPECT_EQ(2, pool.getSmallPool().getNumUsedBlocks());
+    EXPECT_EQ(2, pool.getMediumPool().getNumUsedBlocks());
+    EXPECT_EQ(2, pool.getLargePool().getNumUsedBlocks());
+    EXPECT_EQ(6, pool.getNumUsedBlocks());
+
+    // Blocks are returned to the classes they were taken from
+    pool.deallocate(small4);
+    EXPECT_EQ(1, pool.getLargePool().getNumUsedBlocks());
+    pool.deallocate(small1);
+    pool.deallocate(small3);
+    EXPECT_EQ(1, pool.getSmallPool().getNumUsedBlocks());
+    EXPECT_EQ(1, pool.getMediumPool().getNumUsedBlocks());
+    EXPECT_FALSE(pool.allocate(65) == UAVCAN_NULLPTR);
+    EXPECT_EQ(2, pool.getLargePool().getNumUsedBlocks());
+    EXPECT_EQ(2, pool.getLargePool().getPeakNumUsedBlocks());
+
+    pool.deallocate(UAVCAN_NULLPTR);
+    EXPECT_EQ(4, pool.getNumUsedBlocks());
+}
+
+TEST(DynamicMemory, PoolUsageTracker)
+{
+    uavcan::PoolAllocator<128, 32> pool32;
+    uavcan::PoolUsageTracker tracker(pool32);
+
+    EXPECT_EQ(4, tracker.getBlockCapacity());
+    EXPECT_EQ(0, tracker.getTotalNumUsedBlocks());
+
+    // Untagged allocations
+    const void* ptr1 = tracker.allocate(16);
+    ASSERT_TRUE(ptr1);
+    EXPECT_EQ(1, tracker.getNumUsedBlocks(uavcan::PoolUsageTagOther));
+    EXPECT_EQ(1, pool32.getNumUsedBlocks());
+
+    // Tagged allocations, the limiter is transparent
+    uavcan::TaggedPoolAllocator tx_allocator(tracker, uavcan::PoolUsageTagTxQueue);
+    uavcan::LimitedPoolAllocator limited(tx_allocator, 2);
+    const void* ptr2 = limited.allocate(16);
+    const void* ptr3 = limited.allocate(16);
+    ASSERT_TRUE(ptr2);
+    ASSERT_TRUE(ptr3);
+    EXPECT_FALSE(limited.allocate(16));                         // Limited, not attributed to anything
+#if UAVCAN_POOL_USAGE_ATTRIBUTION
+    EXPECT_EQ(2, tracker.getNumUsedBlocks(uavcan::PoolUsageTagTxQueue));
+    EXPECT_EQ(2, tracker.getPeakNumUsedBlocks(uavcan::PoolUsageTagTxQueue));
+    EXPECT_EQ(1, tracker.getNumUsedBlocks(uavcan::PoolUsageTagOther));
+
+    // The innermost tag takes precedence
+    uavcan::TaggedPoolAllocator outer(tx_allocator, uavcan::PoolUsageTagOther);
+    ASSERT_EQ(uavcan::PoolUsageTagOther, outer.getTag());
+    const void* ptr4 = outer.allocateTagged(16, uavcan::PoolUsageTagRxBuffer);
+    ASSERT_TRUE(ptr4);
+    EXPECT_EQ(1, tracker.getNumUsedBlocks(uavcan::PoolUsageTagRxBuffer));
+    EXPECT_EQ(4, tracker.getTotalNumUsedBlocks());
+
+    // Out of memory is accounted for the subsystem that ran into it
+    EXPECT_FALSE(outer.allocateTagged(16, uavcan::PoolUsageTagReceiverMap));
+    EXPECT_EQ(1, tracker.getNumFailedAllocations(uavcan::PoolUsageTagReceiverMap));
+    EXPECT_EQ(0, tracker.getNumUsedBlocks(uavcan::PoolUsageTagReceiverMap));
+    EXPECT_EQ(0, tracker.getNumFailedAllocations(uavcan::PoolUsageTagTxQueue));
+
+    outer.deallocateTagged(ptr4, uavcan::PoolUsageTagRxBuffer);
+    EXPECT_EQ(0, tracker.getNumUsedBlocks(uavcan::PoolUsageTagRxBuffer));
+    EXPECT_EQ(1, tracker.getPeakNumUsedBlocks(uavcan::PoolUsageTagRxBuffer));
+#else
+    EXPECT_EQ(3, tracker.getNumUsedBlocks(uavcan::PoolUsageTagOther));
+#endif
+
+    limited.deallocate(ptr2);
+    limited.deallocate(ptr3);
+    tracker.deallocate(ptr1);
+    tracker.deallocate(UAVCAN_NULLPTR);
+    EXPECT_EQ(0, tracker.getTotalNumUsedBlocks());
+    EXPECT_EQ(0, pool32.getNumUsedBlocks());
+
+    // Peaks
+#if UAVCAN_POOL_USAGE_ATTRIBUTION
+    EXPECT_EQ(2, tracker.getPeakNumUsedBlocks(uavcan::PoolUsageTagTxQueue));
+#endif
+    tracker.resetPeaks();
+    for (unsigned i = 0; i < uavcan::NumPoolUsageTags; i++)
+    {
+        EXPECT_EQ(0, tracker.getPeakNumUsedBlocks(uavcan::PoolUsageTag(i)));
+    }
+}
+
+TEST(DynamicMemory, PoolAllocatorRouter)
+{
+    uavcan::PoolAllocator<128, 32> sram;
+    uavcan::PoolAllocator<64, 32> ccm;
+    uavcan::PoolAllocatorRouter router(sram);
+
+    EXPECT_EQ(4, router.getBlockCapacity());
+    EXPECT_EQ(&sram, &router.getAllocator(uavcan::PoolUsageTagTxQueue));
+
+    router.setAllocator(uavcan::PoolUsageTagTxQueue, ccm);
+    router.setAllocator(uavcan::PoolUsageTagRxBuffer, ccm);
+    EXPECT_EQ(&ccm, &router.getAllocator(uavcan::PoolUsageTagTxQueue));
+    EXPECT_EQ(&sram, &router.getAllocator(uavcan::PoolUsageTagOther));
+    EXPECT_EQ(6, router.getBlockCapacity());                   // Each allocator is counted once
+
+    // Untagged allocations go to the default allocator
+    const void* ptr1 = router.allocate(16);
+    ASSERT_TRUE(ptr1);
+    EXPECT_EQ(1, sram.getNumUsedBlocks());
+    EXPECT_EQ(0, ccm.getNumUsedBlocks());
+
+    // The subsystems are routed through the tags
+    uavcan::TaggedPoolAllocator tx_allocator(router, uavcan::PoolUsageTagTxQueue);
+    uavcan::TaggedPoolAllocator map_allocator(router, uavcan::PoolUsageTagReceiverMap);
+    const void* ptr2 = static_cast<uavcan::IPoolAllocator&>(tx_allocator).allocate(16);
+    const void* ptr3 = static_cast<uavcan::IPoolAllocator&>(map_allocator).allocate(16);
+    ASSERT_TRUE(ptr2);
+    ASSERT_TRUE(ptr3);
+#if UAVCAN_POOL_USAGE_ATTRIBUTION
+    EXPECT_EQ(2, sram.getNumUsedBlocks());
+    EXPECT_EQ(1, ccm.getNumUsedBlocks());
+
+    // The region of a subsystem runs out independently of the others
+    const void* ptr4 = router.allocateTagged(16, uavcan::PoolUsageTagRxBuffer);
+    ASSERT_TRUE(ptr4);
+    EXPECT_FALSE(router.allocateTagged(16, uavcan::PoolUsageTagRxBuffer));
+    EXPECT_EQ(2, ccm.getNumUsedBlocks());
+    EXPECT_EQ(4, router.getNumUsedBlocks());
+    router.deallocateTagged(ptr4, uavcan::PoolUsageTagRxBuffer);
+#else
+    EXPECT_EQ(3, sram.getNumUsedBlocks());
+#endif
+
+    // The usage can be tracked per region
+    uavcan::PoolUsageTracker tracker(ccm);
+    router.setAllocator(uavcan::PoolUsageTagServiceCallRegistry, tracker);
+    const void* ptr5 = router.allocateTagged(16, uavcan::PoolUsageTagServiceCallRegistry);
+    ASSERT_TRUE(ptr5);
+    EXPECT_EQ(1, tracker.getNumUsedBlocks(uavcan::PoolUsageTagServiceCallRegistry));
+    router.deallocateTagged(ptr5, uavcan::PoolUsageTagServiceCallRegistry);
+    EXPECT_EQ(0, tracker.getTotalNumUsedBlocks());
+
+    static_cast<uavcan::IPoolAllocator&>(map_allocator).deallocate(ptr3);
+    static_cast<uavcan::IPoolAllocator&>(tx_allocator).deallocate(ptr2);
+    router.deallocate(ptr1);
+    EXPECT_EQ(0, sram.getNumUsedBlocks());
+    EXPECT_EQ(0, ccm.getNumUsedBlocks());
 }
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/helpers/binary_record.hpp>
+#include <root_ns_a/MavlinkMessage.hpp>
+#include <root_ns_a/EmptyMessage.hpp>
+
+
+TEST(BinaryRecord, Basic)
+{
+    root_ns_a::MavlinkMessage msg;
+    msg.seq = 1;
+    msg.sysid = 2;
+    msg.compid = 3;
+    msg.msgid = 4;
+    msg.payload = "Hello";
+
+    uint8_t buf[64];
+
+    /*
+     * Two records back to back
+     */
+    const int len1 = uavcan::encodeBinaryRecord(msg, buf, sizeof(buf));
+    ASSERT_EQ(10 + 4 + 5, len1);                            // Tail array optimization
+
+    const uint64_t signature = root_ns_a::MavlinkMessage::getDataTypeSignature().get();
+    ASSERT_EQ(9, buf[0]);
+    ASSERT_EQ(0, buf[1]);
+    ASSERT_EQ(uint8_t(signature & 0xFFU), buf[2]);
+    ASSERT_EQ(uint8_t(signature >> 56), buf[9]);
+    ASSERT_EQ(1, buf[10]);
+    ASSERT_EQ('H', buf[14]);
+
+    root_ns_a::EmptyMessage empty;
+    const int len2 = uavcan::encodeBinaryRecord(empty, buf + len1, unsigned(sizeof(buf) - unsigned(len1)));
+    ASSERT_EQ(10, len2);
+
+    /*
+     * The records are walked through by the headers
+     */
+    uavcan::BinaryRecordHeader header;
+    ASSERT_EQ(10, uavcan::readBinaryRecordHeader(buf, unsigned(len1 + len2), header));
+    ASSERT_EQ(signature, header.schema_id);
+    ASSERT_EQ(9, header.payload_length);
+    ASSERT_EQ(unsigned(len1), header.getRecordLength());
+
+    ASSERT_EQ(10, uavcan::readBinaryRecordHeader(buf + len1, unsigned(len2), header));
+    ASSERT_EQ(root_ns_a::EmptyMessage::getDataTypeSignature().get(), header.schema_id);
+    ASSERT_EQ(0, header.payload_length);
+
+    /*
+     * Decoding
+     */
+    root_ns_a::MavlinkMessage decoded;
+    ASSERT_EQ(len1, uavcan::decodeBinaryRecord(buf, unsigned(len1 + len2), decoded));
+    ASSERT_TRUE(decoded == msg);
+
+    ASSERT_EQ(-uavcan::ErrUnknownDataType, uavcan::decodeBinaryRecord(buf + len1, unsigned(len2), decoded));
+    ASSERT_EQ(len2, uavcan::decodeBinaryRecord(buf + len1, unsigned(len2), empty));
+
+    // Explicit schema ID, e.g. for the services
+    ASSERT_EQ(len1, uavcan::encodeBinaryRecord(msg, 0x1122334455667788ULL, buf, sizeof(buf)));
+    ASSERT_EQ(len1, uavcan::decodeBinaryRecord(buf, sizeof(buf), 0x1122334455667788ULL, decoded));
+
+    /*
+     * Short buffers
+     */
+    ASSERT_EQ(0, uavcan::encodeBinaryRecord(msg, buf, unsigned(len1 - 1)));
+    ASSERT_EQ(0, uavcan::decodeBinaryRecord(buf, unsigned(len1 - 1), 0x1122334455667788ULL, decoded));
+    ASSERT_EQ(0, uavcan::readBinaryRecordHeader(buf, 9, header));
+    ASSERT_EQ(-uavcan::ErrInvalidParam, uavcan::encodeBinaryRecord(msg, UAVCAN_NULLPTR, 100));
+}
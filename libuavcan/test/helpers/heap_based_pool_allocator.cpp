@@ -108,6 +108,98 @@ TEST(HeapBasedPoolAllocator, Limits)
     ASSERT_EQ(0, al.getNumAllocatedBlocks());
 }
 
+TEST(HeapBasedPoolAllocator, Chunks)
+{
+    uavcan::HeapBasedPoolAllocator<uavcan::MemPoolBlockSize> al(8, 10);
+    al.setChunkSize(4);
+    ASSERT_EQ(4, al.getChunkSize());
+
+    // The first allocation acquires a whole chunk
+    void* a = al.allocate(10);
+    ASSERT_TRUE(a);
+    ASSERT_EQ(4, al.getNumReservedBlocks());
+    ASSERT_EQ(1, al.getNumAllocatedBlocks());
+
+    void* b = al.allocate(10);
+    void* c = al.allocate(10);
+    void* d = al.allocate(10);
+    ASSERT_TRUE(b && c && d);
+    ASSERT_EQ(4, al.getNumReservedBlocks());
+
+    // The last chunk is cut down to the hard limit
+    void* e = al.allocate(10);
+    ASSERT_TRUE(e);
+    ASSERT_EQ(8, al.getNumReservedBlocks());
+    ASSERT_TRUE(al.preallocate(5));
+    ASSERT_EQ(10, al.getNumReservedBlocks());
+    ASSERT_FALSE(al.preallocate(6));
+
+    // A chunk is freed only when none of its blocks is used
+    al.deallocate(a);
+    al.deallocate(b);
+    al.deallocate(c);
+    al.shrink();
+    ASSERT_EQ(8, al.getNumReservedBlocks());                // The preallocated chunk was not used
+    al.deallocate(d);
+    al.shrink();
+    ASSERT_EQ(4, al.getNumReservedBlocks());
+    ASSERT_EQ(1, al.getNumAllocatedBlocks());
+
+    // The freed chunk is acquired again when needed
+    void* blocks[9] = {};
+    for (unsigned i = 0; i < 9; i++)
+    {
+        blocks[i] = al.allocate(10);
+        ASSERT_TRUE(blocks[i]);
+    }
+    ASSERT_FALSE(al.allocate(10));
+    ASSERT_EQ(10, al.getNumReservedBlocks());
+    for (unsigned i = 0; i < 9; i++)
+    {
+        al.deallocate(blocks[i]);
+    }
+    al.deallocate(e);
+    al.shrink();
+    ASSERT_EQ(0, al.getNumReservedBlocks());
+    ASSERT_EQ(0, al.getNumAllocatedBlocks());
+}
+
+TEST(HeapBasedPoolAllocator, Trim)
+{
+    uavcan::HeapBasedPoolAllocator<uavcan::MemPoolBlockSize> al(100);
+
+    // Peak load of 4 blocks, then 1 block
+    void* blocks[4] = {};
+    for (unsigned i = 0; i < 4; i++)
+    {
+        blocks[i] = al.allocate(10);
+    }
+    for (unsigned i = 1; i < 4; i++)
+    {
+        al.deallocate(blocks[i]);
+    }
+    ASSERT_EQ(4, al.getNumReservedBlocks());
+
+    // The reserve was empty during the last period - nothing is freed
+    ASSERT_EQ(0, al.trim());
+    ASSERT_EQ(4, al.getNumReservedBlocks());
+
+    // The load recurs, two blocks stay unused - only those are freed
+    void* x = al.allocate(10);
+    al.deallocate(x);
+    ASSERT_EQ(2, al.trim());
+    ASSERT_EQ(2, al.getNumReservedBlocks());
+
+    // The load is gone
+    ASSERT_EQ(1, al.trim());
+    ASSERT_EQ(1, al.getNumReservedBlocks());
+    ASSERT_EQ(0, al.trim());
+
+    al.deallocate(blocks[0]);
+    al.shrink();
+    ASSERT_EQ(0, al.getNumReservedBlocks());
+}
+
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
 
 #include <thread>
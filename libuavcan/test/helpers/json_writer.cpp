@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <cstring>
+#include <string>
+#include <limits>
+#include <gtest/gtest.h>
+#include <uavcan/helpers/json_writer.hpp>
+#include <uavcan/marshal/types.hpp>
+#include <root_ns_a/MavlinkMessage.hpp>
+
+namespace
+{
+
+template <typename T, typename V>
+std::string toJson(const V& value)
+{
+    char buf[256];
+    uavcan::JsonWriter writer(buf, sizeof(buf));
+    uavcan::JsonStreamer<T>::stream(writer, value);
+    EXPECT_FALSE(writer.isOverflowed());
+    return std::string(writer.getText());
+}
+
+}
+
+TEST(JsonWriter, Primitives)
+{
+    using uavcan::IntegerSpec;
+    using uavcan::FloatSpec;
+
+    typedef IntegerSpec<8, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> U8;
+    typedef IntegerSpec<13, uavcan::SignednessSigned, uavcan::CastModeSaturate> S13;
+    typedef IntegerSpec<64, uavcan::SignednessSigned, uavcan::CastModeSaturate> S64;
+    typedef IntegerSpec<64, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> U64;
+    typedef FloatSpec<16, uavcan::CastModeSaturate> F16;
+    typedef FloatSpec<32, uavcan::CastModeSaturate> F32;
+    typedef FloatSpec<64, uavcan::CastModeSaturate> F64;
+
+    EXPECT_EQ("0", toJson<U8>(uint8_t(0)));
+    EXPECT_EQ("255", toJson<U8>(uint8_t(255)));
+    EXPECT_EQ("-4096", toJson<S13>(int16_t(-4096)));
+    EXPECT_EQ("-9223372036854775808", toJson<S64>(std::numeric_limits<int64_t>::min()));
+    EXPECT_EQ("18446744073709551615", toJson<U64>(std::numeric_limits<uint64_t>::max()));
+
+    EXPECT_EQ("0.5", toJson<F16>(0.5F));
+    EXPECT_EQ("-1.5", toJson<F32>(-1.5F));
+    EXPECT_EQ("0.10000000000000001", toJson<F64>(0.1));
+    EXPECT_EQ("null", toJson<F32>(std::numeric_limits<float>::quiet_NaN()));
+    EXPECT_EQ("null", toJson<F64>(-std::numeric_limits<double>::infinity()));
+}
+
+TEST(JsonWriter, Arrays)
+{
+    typedef uavcan::IntegerSpec<8, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> U8;
+    typedef uavcan::Array<U8, uavcan::ArrayModeDynamic, 32> String;
+    typedef uavcan::Array<uavcan::IntegerSpec<1, uavcan::SignednessUnsigned, uavcan::CastModeSaturate>,
+                          uavcan::ArrayModeStatic, 3> Bits;
+    typedef uavcan::Array<uavcan::Array<uavcan::FloatSpec<32, uavcan::CastModeSaturate>,
+                                        uavcan::ArrayModeDynamic, 4>, uavcan::ArrayModeDynamic, 4> Matrix;
+
+    String str;
+    EXPECT_EQ("\"\"", toJson<String>(str));
+    str = "Say \"hi\"\\\n";
+    EXPECT_EQ("\"Say \\\"hi\\\"\\\\\\n\"", toJson<String>(str));
+    str.clear();
+    str.push_back(72);
+    str.push_back(0);
+    str.push_back(200);
+    EXPECT_EQ("[72,0,200]", toJson<String>(str));      // Not printable - the values
+
+    Bits bits;
+    bits[1] = true;
+    EXPECT_EQ("[0,1,0]", toJson<Bits>(bits));
+
+    Matrix matrix;
+    EXPECT_EQ("[]", toJson<Matrix>(matrix));
+    matrix.resize(2);
+    matrix[0].push_back(1.0F);
+    matrix[0].push_back(2.0F);
+    EXPECT_EQ("[[1,2],[]]", toJson<Matrix>(matrix));
+}
+
+TEST(JsonWriter, Messages)
+{
+    root_ns_a::MavlinkMessage msg;
+    msg.seq = 1;
+    msg.sysid = 2;
+    msg.compid = 3;
+    msg.msgid = 4;
+    msg.payload = "Hello";
+
+    char buf[64];
+    const char* const Expected = "{\"seq\":1,\"sysid\":2,\"compid\":3,\"msgid\":4,\"payload\":\"Hello\"}";
+    ASSERT_EQ(int(std::strlen(Expected)), uavcan::encodeJson(msg, buf, sizeof(buf)));
+    ASSERT_STREQ(Expected, buf);
+
+    // Truncated, still null-terminated
+    ASSERT_EQ(0, uavcan::encodeJson(msg, buf, 10));
+    ASSERT_STREQ("{\"seq\":1,", buf);
+
+    ASSERT_EQ(-uavcan::ErrInvalidParam, uavcan::encodeJson(msg, buf, 0));
+
+    // The writer can be reused
+    uavcan::JsonWriter writer(buf, sizeof(buf));
+    uavcan::JsonStreamer<root_ns_a::MavlinkMessage>::stream(writer, msg);
+    writer.reset();
+    writer.writeEscaped('\x01');
+    ASSERT_STREQ("\\u0001", writer.getText());
+    ASSERT_EQ(6, writer.getLength());
+}
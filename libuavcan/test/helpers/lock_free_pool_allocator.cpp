@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <uavcan/helpers/lock_free_pool_allocator.hpp>
+
+
+TEST(LockFreePoolAllocator, Basic)
+{
+    uavcan::LockFreePoolAllocator<64 * 16, 64, 4, 2> pool;
+
+    ASSERT_EQ(16, pool.getBlockCapacity());
+    ASSERT_EQ(16, pool.getNumFreeBlocks());
+    ASSERT_EQ(0, pool.getPeakNumUsedBlocks());
+
+    ASSERT_FALSE(pool.allocate(65));
+
+    std::vector<void*> blocks;
+    for (int i = 0; i < 16; i++)
+    {
+        void* const ptr = pool.allocate(64);
+        ASSERT_TRUE(ptr);
+        std::memset(ptr, i, 64);
+        blocks.push_back(ptr);
+    }
+    ASSERT_FALSE(pool.allocate(1));
+    ASSERT_EQ(16, pool.getNumUsedBlocks());
+    ASSERT_EQ(16, pool.getPeakNumUsedBlocks());
+
+    // No overlaps
+    for (int i = 0; i < 16; i++)
+    {
+        ASSERT_EQ(uint8_t(i), static_cast<uint8_t*>(blocks[unsigned(i)])[63]);
+    }
+
+    // The magazine overflows into the stack
+    for (void* ptr : blocks)
+    {
+        pool.deallocate(ptr);
+    }
+    pool.deallocate(UAVCAN_NULLPTR);
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+    ASSERT_EQ(16, pool.getPeakNumUsedBlocks());
+
+    // The most recently freed block is reused first
+    void* const last = blocks.back();
+    ASSERT_EQ(last, pool.allocate(1));
+    pool.deallocate(last);
+
+    blocks.clear();
+    for (int i = 0; i < 16; i++)
+    {
+        void* const ptr = pool.allocate(1);
+        ASSERT_TRUE(ptr);
+        blocks.push_back(ptr);
+    }
+    ASSERT_FALSE(pool.allocate(1));
+    for (void* ptr : blocks)
+    {
+        pool.deallocate(ptr);
+    }
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+}
+
+TEST(LockFreePoolAllocator, CachedBlocksAreNotLost)
+{
+    uavcan::LockFreePoolAllocator<64 * 8, 64, 8, 4> pool;
+
+    // Another thread frees the blocks into its magazine and exits
+    std::vector<void*> blocks;
+    for (int i = 0; i < 8; i++)
+    {
+        blocks.push_back(pool.allocate(1));
+        ASSERT_TRUE(blocks.back());
+    }
+    std::thread([&pool, &blocks]()
+    {
+        for (void* ptr : blocks)
+        {
+            pool.deallocate(ptr);
+        }
+    }).join();
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+
+    // All blocks can still be allocated from this thread
+    blocks.clear();
+    for (int i = 0; i < 8; i++)
+    {
+        blocks.push_back(pool.allocate(1));
+        ASSERT_TRUE(blocks.back());
+    }
+    ASSERT_FALSE(pool.allocate(1));
+    for (void* ptr : blocks)
+    {
+        pool.deallocate(ptr);
+    }
+}
+
+TEST(LockFreePoolAllocator, Concurrency)
+{
+    static const unsigned NumThreads = 6;
+    static const unsigned NumIterations = 20000;
+
+    uavcan::LockFreePoolAllocator<64 * 64, 64, 8, 4> pool;    // Fewer magazines than threads
+
+    std::atomic<unsigned> num_corruptions(0);
+    std::atomic<unsigned> num_failures(0);
+
+    // Blocks are passed between the threads, so that they are freed by other threads than allocated them
+    std::mutex exchange_mutex;
+    std::vector<void*> exchange;
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < NumThreads; t++)
+    {
+        threads.emplace_back([&, t]()
+        {
+            const uint8_t pattern = uint8_t(t + 1);
+            for (unsigned i = 0; i < NumIterations; i++)
+            {
+                void* held[3] = {};
+                for (auto& ptr : held)
+                {
+                    ptr = pool.allocate(64);
+                    if (ptr == UAVCAN_NULLPTR)
+                    {
+                        num_failures++;
+                        continue;
+                    }
+                    std::memset(ptr, pattern, 64);
+                }
+                std::this_thread::yield();
+                for (auto ptr : held)
+                {
+                    if (ptr == UAVCAN_NULLPTR)
+                    {
+                        continue;
+                    }
+                    const uint8_t* const bytes = static_cast<const uint8_t*>(ptr);
+                    if ((bytes[0] != pattern) || (bytes[63] != pattern))
+                    {
+                        num_corruptions++;
+                    }
+                }
+                pool.deallocate(held[0]);
+                {
+                    std::lock_guard<std::mutex> lock(exchange_mutex);
+                    if (held[1] != UAVCAN_NULLPTR)
+                    {
+                        exchange.push_back(held[1]);
+                    }
+                    if (!exchange.empty())
+                    {
+                        pool.deallocate(exchange.front());
+                        exchange.erase(exchange.begin());
+                    }
+                }
+                pool.deallocate(held[2]);
+            }
+        });
+    }
+    for (auto& x : threads)
+    {
+        x.join();
+    }
+    for (void* ptr : exchange)
+    {
+        pool.deallocate(ptr);
+    }
+
+    // At most 3 blocks per thread plus one in the exchange, so that the pool never runs out
+    EXPECT_EQ(0, num_failures);
+    EXPECT_EQ(0, num_corruptions);
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+    EXPECT_GE(64, pool.getPeakNumUsedBlocks());
+    EXPECT_LE(3, pool.getPeakNumUsedBlocks());
+
+    // Nothing is leaked
+    std::vector<void*> blocks;
+    for (int i = 0; i < 64; i++)
+    {
+        blocks.push_back(pool.allocate(1));
+        ASSERT_TRUE(blocks.back());
+    }
+    ASSERT_FALSE(pool.allocate(1));
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <set>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <uavcan/helpers/publish_queue.hpp>
+#include <uavcan/node/subscriber.hpp>
+#include <root_ns_a/MavlinkMessage.hpp>
+#include "../node/test_node.hpp"
+
+
+namespace
+{
+struct MessageCollector
+{
+    std::multiset<unsigned> ids;
+
+    void handleMessage(const uavcan::ReceivedDataStructure<root_ns_a::MavlinkMessage>& msg)
+    {
+        ids.insert(unsigned(msg.sysid) * 256U + msg.seq);
+    }
+
+    typedef uavcan::MethodBinder<MessageCollector*,
+        void (MessageCollector::*)(const uavcan::ReceivedDataStructure<root_ns_a::MavlinkMessage>&)> Binder;
+
+    Binder bind() { return Binder(this, &MessageCollector::handleMessage); }
+};
+}
+
+TEST(PublishQueue, Basic)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    MessageCollector collector;
+    uavcan::Subscriber<root_ns_a::MavlinkMessage, MessageCollector::Binder> sub(nodes.a);
+    ASSERT_EQ(0, sub.start(collector.bind()));
+
+    uavcan::PublishQueue<root_ns_a::MavlinkMessage, 4> queue(nodes.b);
+    ASSERT_EQ(0, queue.init());
+
+    root_ns_a::MavlinkMessage msg;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        msg.seq = i;
+        ASSERT_EQ(0, queue.push(msg));
+    }
+    ASSERT_EQ(-uavcan::ErrMemory, queue.push(msg));                         // Full
+    ASSERT_EQ(1, queue.getNumRejectedMessages());
+
+    ASSERT_EQ(1, queue.drain(1));
+    ASSERT_EQ(0, queue.push(msg));                                          // One slot was freed
+    ASSERT_EQ(4, queue.drain());
+    ASSERT_EQ(0, queue.drain());
+    ASSERT_EQ(0, queue.getNumSendFailures());
+
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(20)));
+    ASSERT_EQ(5, collector.ids.size());
+    ASSERT_EQ(2, collector.ids.count(3));
+    ASSERT_EQ(1, collector.ids.count(0));
+}
+
+TEST(PublishQueue, ConcurrentProducers)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    MessageCollector collector;
+    uavcan::Subscriber<root_ns_a::MavlinkMessage, MessageCollector::Binder> sub(nodes.a);
+    ASSERT_EQ(0, sub.start(collector.bind()));
+
+    typedef uavcan::PublishQueue<root_ns_a::MavlinkMessage, 8> QueueType;
+    QueueType queue(nodes.b);
+    ASSERT_EQ(0, queue.init());
+    queue.startAutoDrain(uavcan::MonotonicDuration::fromMSec(1));
+    ASSERT_TRUE(queue.isAutoDrainRunning());
+
+    /*
+     * The producers retry until every message gets into the queue, while the node thread drains it
+     */
+    static const unsigned NumThreads = 4;
+    static const unsigned NumMessagesPerThread = 50;
+
+    std::vector<std::thread> producers;
+    for (unsigned t = 0; t < NumThreads; t++)
+    {
+        producers.push_back(std::thread([&queue, t]()
+        {
+            root_ns_a::MavlinkMessage msg;
+            msg.sysid = uint8_t(t);
+            for (unsigned i = 0; i < NumMessagesPerThread; i++)
+            {
+                msg.seq = uint8_t(i);
+                while (queue.push(msg) == -uavcan::ErrMemory)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+
+    for (unsigned i = 0; (i < 2000) && (collector.ids.size() < NumThreads * NumMessagesPerThread); i++)
+    {
+        ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(2)));
+    }
+    for (unsigned t = 0; t < NumThreads; t++)
+    {
+        producers[t].join();
+    }
+
+    ASSERT_EQ(NumThreads * NumMessagesPerThread, collector.ids.size());
+    for (unsigned t = 0; t < NumThreads; t++)
+    {
+        for (unsigned i = 0; i < NumMessagesPerThread; i++)
+        {
+            ASSERT_EQ(1, collector.ids.count(t * 256U + i));
+        }
+    }
+    ASSERT_EQ(0, queue.getNumSendFailures());
+
+    queue.stopAutoDrain();
+    ASSERT_FALSE(queue.isAutoDrainRunning());
+}
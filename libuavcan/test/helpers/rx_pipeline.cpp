@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <chrono>
+#include <thread>
+#include <gtest/gtest.h>
+#include <uavcan/helpers/rx_pipeline.hpp>
+#include "../node/test_node.hpp"
+#include "../transport/transfer_test_helpers.hpp"
+#include "../clock.hpp"
+
+
+namespace
+{
+
+struct PipelineTestMessage
+{
+    enum { DefaultDataTypeID = 20 };
+    enum { DataTypeKind = uavcan::DataTypeKindMessage };
+    static uavcan::DataTypeSignature getDataTypeSignature() { return uavcan::DataTypeSignature(0x1234567890ULL); }
+    static const char* getDataTypeFullName() { return "pipeline_test.Message"; }
+};
+
+struct PipelineTestService
+{
+    enum { DefaultDataTypeID = 30 };
+    enum { DataTypeKind = uavcan::DataTypeKindService };
+    static uavcan::DataTypeSignature getDataTypeSignature() { return uavcan::DataTypeSignature(0x9876543210ULL); }
+    static const char* getDataTypeFullName() { return "pipeline_test.Service"; }
+};
+
+template <typename Pipeline>
+void pushTransfer(Pipeline& pipeline, uavcan::uint8_t iface_index, const Transfer& transfer)
+{
+    const std::vector<uavcan::RxFrame> frames = serializeTransfer(transfer);
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        uavcan::CanRxFrame can_frame;
+        ASSERT_TRUE(frames[i].compile(can_frame));
+        can_frame.ts_mono = frames[i].getMonotonicTimestamp();
+        can_frame.ts_utc = frames[i].getUtcTimestamp();
+        ASSERT_TRUE(pipeline.push(iface_index, can_frame));
+    }
+}
+
+template <typename Pipeline>
+unsigned dispatchUntil(Pipeline& pipeline, unsigned expected)
+{
+    unsigned num = 0;
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((num < expected) && (std::chrono::steady_clock::now() < deadline))
+    {
+        num += pipeline.dispatch();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return num;
+}
+
+}
+
+
+TEST(RxPipeline, Basic)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<PipelineTestMessage> _reg1;
+    uavcan::DefaultDataTypeRegistrator<PipelineTestService> _reg2;
+
+    SystemClockMock clock_mock(100);
+    CanDriverMock driver(2, clock_mock);
+    TestNode node(driver, clock_mock, 1);
+
+    const uavcan::DataTypeDescriptor& msg_type =
+        *uavcan::GlobalDataTypeRegistry::instance().find("pipeline_test.Message");
+    const uavcan::DataTypeDescriptor& srv_type =
+        *uavcan::GlobalDataTypeRegistry::instance().find("pipeline_test.Service");
+
+    TestListener msg_listener(node.getDispatcher().getTransferPerfCounter(), msg_type, 256, node.getAllocator());
+    TestListener srv_listener(node.getDispatcher().getTransferPerfCounter(), srv_type, 256, node.getAllocator());
+    ASSERT_TRUE(node.getDispatcher().registerMessageListener(&msg_listener));
+    ASSERT_TRUE(node.getDispatcher().registerServiceRequestListener(&srv_listener));
+
+    uavcan::RxPipeline<64, 16> pipeline(node);
+    ASSERT_FALSE(pipeline.isRunning());
+    ASSERT_FALSE(pipeline.push(0, uavcan::CanRxFrame()));
+
+    ASSERT_LE(0, pipeline.start());
+    ASSERT_TRUE(pipeline.isRunning());
+    ASSERT_TRUE(uavcan::GlobalDataTypeRegistry::instance().isFrozen());
+    ASSERT_GT(0, pipeline.start());
+
+    /*
+     * Each transfer is received via both interfaces; the second copy must be dropped.
+     * The service request addressed to another node must be ignored.
+     */
+    const Transfer msg_single(100, 1000, uavcan::TransferPriority::Default, uavcan::TransferTypeMessageBroadcast,
+                              0, 42, uavcan::NodeID::Broadcast, "123", msg_type);
+    const Transfer msg_multi(200, 2000, uavcan::TransferPriority::Default, uavcan::TransferTypeMessageBroadcast,
+                             1, 42, uavcan::NodeID::Broadcast, "Multi-frame transfer payload", msg_type);
+    const Transfer srv_for_us(300, 3000, uavcan::TransferPriority::Default, uavcan::TransferTypeServiceRequest,
+                              2, 42, 1, "Request for us", srv_type);
+    const Transfer srv_for_other(400, 4000, uavcan::TransferPriority::Default, uavcan::TransferTypeServiceRequest,
+                                 3, 42, 2, "Request for 2", srv_type);
+
+    pushTransfer(pipeline, 0, msg_single);
+    pushTransfer(pipeline, 0, msg_multi);
+    pushTransfer(pipeline, 0, srv_for_us);
+    pushTransfer(pipeline, 0, srv_for_other);
+
+    // The worker of the first interface must complete all transfers before the copies arrive
+    ASSERT_EQ(3, dispatchUntil(pipeline, 3));
+
+    std::thread second_iface_driver([&]()
+    {
+        pushTransfer(pipeline, 1, msg_single);
+        pushTransfer(pipeline, 1, msg_multi);
+        pushTransfer(pipeline, 1, srv_for_us);
+        pushTransfer(pipeline, 1, srv_for_other);
+    });
+    second_iface_driver.join();
+
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((pipeline.getNumDuplicateTransfers() < 3) && (std::chrono::steady_clock::now() < deadline))
+    {
+        ASSERT_EQ(0, pipeline.dispatch());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(3, pipeline.getNumDuplicateTransfers());
+
+    ASSERT_EQ(2, msg_listener.getNumReceivedTransfers());
+    ASSERT_TRUE(msg_listener.matchAndPop(msg_single));
+    ASSERT_TRUE(msg_listener.matchAndPop(msg_multi));
+    ASSERT_EQ(1, srv_listener.getNumReceivedTransfers());
+    ASSERT_TRUE(srv_listener.matchAndPop(srv_for_us));
+
+    ASSERT_EQ(0, pipeline.getNumRingOverflows());
+    ASSERT_EQ(0, pipeline.getNumDroppedTransfers());
+    ASSERT_EQ(0, pipeline.getNumTransferErrors());
+
+    pipeline.stop();
+    ASSERT_FALSE(pipeline.isRunning());
+    ASSERT_FALSE(pipeline.push(0, uavcan::CanRxFrame()));
+
+    node.getDispatcher().unregisterMessageListener(&msg_listener);
+    node.getDispatcher().unregisterServiceRequestListener(&srv_listener);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+}
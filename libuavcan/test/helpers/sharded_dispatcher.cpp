@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <chrono>
+#include <thread>
+#include <gtest/gtest.h>
+#include <uavcan/helpers/sharded_dispatcher.hpp>
+#include "../transport/transfer_test_helpers.hpp"
+#include "../transport/can/can.hpp"
+
+
+namespace
+{
+
+struct ShardTestMessage
+{
+    enum { DefaultDataTypeID = 20 };
+    enum { DataTypeKind = uavcan::DataTypeKindMessage };
+    enum { MaxBitLen = 8 };
+    static uavcan::DataTypeSignature getDataTypeSignature() { return uavcan::DataTypeSignature(0x1234567890ULL); }
+    static const char* getDataTypeFullName() { return "shard_test.Message"; }
+
+    uavcan::uint8_t value;
+
+    ShardTestMessage() : value(0) { }
+
+    static int decode(ShardTestMessage& self, uavcan::ScalarCodec& codec, uavcan::TailArrayOptimizationMode)
+    {
+        return codec.decode<8>(self.value);
+    }
+};
+
+struct ShardTestService
+{
+    enum { DefaultDataTypeID = 30 };
+    enum { DataTypeKind = uavcan::DataTypeKindService };
+    static uavcan::DataTypeSignature getDataTypeSignature() { return uavcan::DataTypeSignature(0x9876543210ULL); }
+    static const char* getDataTypeFullName() { return "shard_test.Service"; }
+};
+
+unsigned pushTransfer(CanDriverMock& driver, const Transfer& transfer)
+{
+    const std::vector<uavcan::RxFrame> frames = serializeTransfer(transfer);
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        driver.ifaces.at(0).pushRx(frames[i]);
+    }
+    return unsigned(frames.size());
+}
+
+template <typename Sharded>
+uavcan::uint64_t getNumProcessedFrames(Sharded& sharded)
+{
+    uavcan::uint64_t sum = 0;
+    for (unsigned i = 0; i < sharded.getNumShards(); i++)
+    {
+        sum += sharded.getShard(i).getNumProcessedFrames();
+    }
+    return sum;
+}
+
+}
+
+
+TEST(ShardedDispatcher, Basic)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<ShardTestMessage> _reg1;
+    uavcan::DefaultDataTypeRegistrator<ShardTestService> _reg2;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> pool;
+    SystemClockMock clock_mock(100);
+    CanDriverMock driver(1, clock_mock);
+    uavcan::Dispatcher frontend(driver, pool, clock_mock);
+    ASSERT_TRUE(frontend.setNodeID(1));
+
+    const uavcan::DataTypeDescriptor& msg_type =
+        *uavcan::GlobalDataTypeRegistry::instance().find("shard_test.Message");
+    const uavcan::DataTypeDescriptor& srv_type =
+        *uavcan::GlobalDataTypeRegistry::instance().find("shard_test.Service");
+
+    uavcan::ShardedDispatcher<64> sharded(frontend, 2, 64);
+    ASSERT_EQ(2, sharded.getNumShards());
+    ASSERT_GT(2, sharded.getShardIndex(uavcan::DataTypeKindMessage, msg_type.getID()));
+
+    {
+        uavcan::ShardedDispatcher<64>::Shard& msg_shard = sharded.getShardFor(msg_type);
+        uavcan::ShardedDispatcher<64>::Shard& srv_shard = sharded.getShardFor(srv_type);
+        TestListener msg_listener(msg_shard.getTransferPerfCounter(), msg_type, 256, msg_shard.getAllocator());
+        TestListener srv_listener(srv_shard.getTransferPerfCounter(), srv_type, 256, srv_shard.getAllocator());
+        ASSERT_EQ(0, sharded.registerListener(uavcan::TransferTypeMessageBroadcast, msg_listener));
+        ASSERT_EQ(0, sharded.registerListener(uavcan::TransferTypeServiceRequest, srv_listener));
+
+        std::vector<uavcan::uint8_t> values;
+        uavcan::ShardedSubscriber<ShardTestMessage, std::function<void (const uavcan::ReceivedDataStructure<
+            ShardTestMessage>&)>, 64> subscriber(sharded,
+            [&](const uavcan::ReceivedDataStructure<ShardTestMessage>& msg) { values.push_back(msg.value); });
+
+        ASSERT_LE(0, sharded.start());
+        ASSERT_TRUE(sharded.isRunning());
+        ASSERT_EQ(&sharded, frontend.getRxFrameListener());
+        ASSERT_GT(0, sharded.start());
+        ASSERT_GT(0, sharded.registerListener(uavcan::TransferTypeMessageBroadcast, msg_listener));
+
+        /*
+         * The request addressed to another node and the response nobody waits for are dropped by the front-end
+         */
+        const Transfer msg_single(100, 1000, uavcan::TransferPriority::Default,
+                                  uavcan::TransferTypeMessageBroadcast, 0, 42, uavcan::NodeID::Broadcast, "1", msg_type);
+        const Transfer msg_multi(200, 2000, uavcan::TransferPriority::Default,
+                                 uavcan::TransferTypeMessageBroadcast, 1, 42, uavcan::NodeID::Broadcast,
+                                 "Multi-frame transfer payload", msg_type);
+        const Transfer srv_for_us(300, 3000, uavcan::TransferPriority::Default, uavcan::TransferTypeServiceRequest,
+                                  2, 42, 1, "Request for us", srv_type);
+        const Transfer srv_for_other(400, 4000, uavcan::TransferPriority::Default,
+                                     uavcan::TransferTypeServiceRequest, 3, 42, 2, "Request for 2", srv_type);
+        const Transfer srv_response(500, 5000, uavcan::TransferPriority::Default,
+                                    uavcan::TransferTypeServiceResponse, 4, 42, 1, "Response", srv_type);
+
+        unsigned num_frames_of_interest = 0;
+        num_frames_of_interest += pushTransfer(driver, msg_single);
+        num_frames_of_interest += pushTransfer(driver, msg_multi);
+        num_frames_of_interest += pushTransfer(driver, srv_for_us);
+        (void)pushTransfer(driver, srv_for_other);
+        (void)pushTransfer(driver, srv_response);
+
+        while (frontend.spinOnce() > 0)
+        {
+        }
+
+        const std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while ((getNumProcessedFrames(sharded) < num_frames_of_interest) &&
+               (std::chrono::steady_clock::now() < deadline))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ASSERT_EQ(num_frames_of_interest, getNumProcessedFrames(sharded));
+
+        sharded.stop();
+        ASSERT_FALSE(sharded.isRunning());
+        ASSERT_FALSE(frontend.getRxFrameListener());
+
+        ASSERT_TRUE(msg_listener.matchAndPop(msg_single));
+        ASSERT_TRUE(msg_listener.matchAndPop(msg_multi));
+        ASSERT_TRUE(msg_listener.isEmpty());
+        ASSERT_TRUE(srv_listener.matchAndPop(srv_for_us));
+        ASSERT_TRUE(srv_listener.isEmpty());
+
+        // Decoded and delivered in the thread of the shard; the multi-frame transfer exceeds the max size of the type
+        ASSERT_EQ(1, values.size());
+        ASSERT_EQ('1', values[0]);
+        ASSERT_EQ(0, subscriber.getFailureCount());
+
+        ASSERT_EQ(0, sharded.getNumDroppedFrames());
+
+        ASSERT_EQ(0, sharded.unregisterListener(uavcan::TransferTypeMessageBroadcast, msg_listener));
+        ASSERT_EQ(0, sharded.unregisterListener(uavcan::TransferTypeServiceRequest, srv_listener));
+    }
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+}
@@ -7,6 +7,8 @@
 # pragma GCC diagnostic ignored "-Wdouble-promotion"
 #endif
 
+#include <cstring>
+#include <limits>
 #include <gtest/gtest.h>
 #include <uavcan/marshal/types.hpp>
 #include <uavcan/transport/transfer_buffer.hpp>
@@ -660,6 +662,400 @@ TEST(Array, StaticEncodeDecodeErrors)
 }
 
 
+template <typename Float16Spec>
+static void testFloat16Bulk()
+{
+    typedef IntegerSpec<3, SignednessUnsigned, CastModeTruncate> Prefix;
+    typedef Array<Float16Spec, ArrayModeDynamic, 40> DynamicArray;
+    typedef IntegerSpec<6, SignednessUnsigned, CastModeTruncate> LengthSpec;
+
+    const float special[] =
+    {
+        0.0F, -0.0F, 1.0F, -2.5F, 65504.0F, 65519.0F, 65520.0F, 1e6F, -1e6F, 6e-8F, 1e-9F, 3.14159F,
+        std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+        std::numeric_limits<float>::quiet_NaN()
+    };
+
+    for (unsigned len = 0; len <= DynamicArray::MaxSize; len++)
+    {
+        DynamicArray array;
+        for (uint8_t i = 0; i < len; i++)
+        {
+            const unsigned num_special = unsigned(sizeof(special) / sizeof(special[0]));
+            array.push_back((i < num_special) ? special[i] : (float(i) * 123.456F - 2000.0F));
+        }
+
+        // Reference - element by element
+        uavcan::StaticTransferBuffer<100> ref_buf;
+        uavcan::BitStream ref_bs(ref_buf);
+        uavcan::ScalarCodec ref_sc(ref_bs);
+        ASSERT_EQ(1, Prefix::encode(5, ref_sc, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, LengthSpec::encode(uint8_t(len), ref_sc, uavcan::TailArrayOptDisabled));
+        for (uint8_t i = 0; i < len; i++)
+        {
+            ASSERT_EQ(1, Float16Spec::encode(array[i], ref_sc, uavcan::TailArrayOptDisabled));
+        }
+
+        // Bulk - unaligned on purpose
+        uavcan::StaticTransferBuffer<100> buf;
+        uavcan::BitStream bs_wr(buf);
+        uavcan::ScalarCodec sc_wr(bs_wr);
+        ASSERT_EQ(1, Prefix::encode(5, sc_wr, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, DynamicArray::encode(array, sc_wr, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(ref_bs.toString(), bs_wr.toString());
+
+        // Decoding
+        uavcan::BitStream bs_rd(buf);
+        uavcan::ScalarCodec sc_rd(bs_rd);
+        uint8_t prefix = 0;
+        ASSERT_EQ(1, Prefix::decode(prefix, sc_rd, uavcan::TailArrayOptDisabled));
+        DynamicArray decoded;
+        ASSERT_EQ(1, DynamicArray::decode(decoded, sc_rd, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(len, decoded.size());
+
+        uavcan::BitStream ref_bs_rd(ref_buf);
+        uavcan::ScalarCodec ref_sc_rd(ref_bs_rd);
+        ASSERT_EQ(1, Prefix::decode(prefix, ref_sc_rd, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, LengthSpec::decode(prefix, ref_sc_rd, uavcan::TailArrayOptDisabled));
+        for (uint8_t i = 0; i < len; i++)
+        {
+            float ref = 0;
+            ASSERT_EQ(1, Float16Spec::decode(ref, ref_sc_rd, uavcan::TailArrayOptDisabled));
+            ASSERT_EQ(0, std::memcmp(&ref, &decoded[i], sizeof(float)));
+        }
+
+        // Out of buffer space
+        if (len > 0)
+        {
+            uavcan::StaticTransferBuffer<40> small_buf;
+            uavcan::BitStream small_bs(small_buf);
+            uavcan::ScalarCodec small_sc(small_bs);
+            ASSERT_EQ(int(len < 20), DynamicArray::encode(array, small_sc, uavcan::TailArrayOptDisabled));
+        }
+    }
+}
+
+TEST(Array, Float16Bulk)
+{
+    testFloat16Bulk<FloatSpec<16, CastModeSaturate> >();
+    testFloat16Bulk<FloatSpec<16, CastModeTruncate> >();
+
+    // Static arrays go through the same path
+    Array<FloatSpec<16, CastModeSaturate>, ArrayModeStatic, 3> a;
+    a[0] = 1.0F;
+    a[1] = -2.0F;
+    a[2] = 1e6F;
+    uavcan::StaticTransferBuffer<6> buf;
+    uavcan::BitStream bs_wr(buf);
+    uavcan::ScalarCodec sc_wr(bs_wr);
+    ASSERT_EQ(1, (Array<FloatSpec<16, CastModeSaturate>, ArrayModeStatic, 3>::encode(a, sc_wr,
+                                                                                     uavcan::TailArrayOptEnabled)));
+    ASSERT_EQ("00000000 00111100 00000000 11000000 11111111 01111011", bs_wr.toString());
+}
+
+
+TEST(Array, ByteArrayBulk)
+{
+    typedef IntegerSpec<3, SignednessUnsigned, CastModeTruncate> Prefix;
+    typedef IntegerSpec<8, SignednessSigned, CastModeTruncate> Int8;
+    typedef Array<Int8, ArrayModeDynamic, 40> DynamicArray;
+    typedef IntegerSpec<6, SignednessUnsigned, CastModeTruncate> LengthSpec;
+
+    for (int tao = 0; tao < 2; tao++)
+    {
+        const uavcan::TailArrayOptimizationMode tao_mode = tao ? uavcan::TailArrayOptEnabled
+                                                               : uavcan::TailArrayOptDisabled;
+        for (unsigned len = 0; len <= DynamicArray::MaxSize; len++)
+        {
+            DynamicArray array;
+            for (uint8_t i = 0; i < len; i++)
+            {
+                array.push_back(int8_t(i * 37U - 100U));
+            }
+
+            // Reference - element by element
+            uavcan::StaticTransferBuffer<50> ref_buf;
+            uavcan::BitStream ref_bs(ref_buf);
+            uavcan::ScalarCodec ref_sc(ref_bs);
+            ASSERT_EQ(1, Prefix::encode(5, ref_sc, uavcan::TailArrayOptDisabled));
+            if (!tao)
+            {
+                ASSERT_EQ(1, LengthSpec::encode(uint8_t(len), ref_sc, uavcan::TailArrayOptDisabled));
+            }
+            for (uint8_t i = 0; i < len; i++)
+            {
+                ASSERT_EQ(1, Int8::encode(array[i], ref_sc, uavcan::TailArrayOptDisabled));
+            }
+
+            // Bulk - unaligned on purpose
+            uavcan::StaticTransferBuffer<50> buf;
+            uavcan::BitStream bs_wr(buf);
+            uavcan::ScalarCodec sc_wr(bs_wr);
+            ASSERT_EQ(1, Prefix::encode(5, sc_wr, uavcan::TailArrayOptDisabled));
+            ASSERT_EQ(1, DynamicArray::encode(array, sc_wr, tao_mode));
+            ASSERT_EQ(ref_bs.toString(), bs_wr.toString());
+
+            uavcan::BitStream bs_rd(buf);
+            uavcan::ScalarCodec sc_rd(bs_rd);
+            uint8_t prefix = 0;
+            ASSERT_EQ(1, Prefix::decode(prefix, sc_rd, uavcan::TailArrayOptDisabled));
+            DynamicArray decoded;
+            ASSERT_EQ(1, DynamicArray::decode(decoded, sc_rd, tao_mode));
+            ASSERT_TRUE(array == decoded);
+
+            // Out of buffer space - whatever fits is written, same as element by element
+            uavcan::StaticTransferBuffer<20> small_ref_buf;
+            uavcan::BitStream small_ref_bs(small_ref_buf);
+            uavcan::ScalarCodec small_ref_sc(small_ref_bs);
+            int ref_res = 1;
+            for (uint8_t i = 0; (i < len) && (ref_res > 0); i++)
+            {
+                ref_res = Int8::encode(array[i], small_ref_sc, uavcan::TailArrayOptDisabled);
+            }
+
+            uavcan::StaticTransferBuffer<20> small_buf;
+            uavcan::BitStream small_bs(small_buf);
+            uavcan::ScalarCodec small_sc(small_bs);
+            ASSERT_EQ(ref_res, DynamicArray::encode(array, small_sc, uavcan::TailArrayOptEnabled));
+            ASSERT_EQ(small_ref_bs.toString(), small_bs.toString());
+        }
+    }
+
+    // Maximum length close to the limit of the size type
+    {
+        typedef Array<Int8, ArrayModeDynamic, 255> LongArray;
+        LongArray array;
+        for (unsigned i = 0; i < LongArray::MaxSize; i++)
+        {
+            array.push_back(int8_t(i));
+        }
+        uavcan::StaticTransferBuffer<300> buf;
+        uavcan::BitStream bs_wr(buf);
+        uavcan::ScalarCodec sc_wr(bs_wr);
+        ASSERT_EQ(1, LongArray::encode(array, sc_wr, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(256, buf.getMaxWritePos());
+
+        uavcan::BitStream bs_rd(buf);
+        uavcan::ScalarCodec sc_rd(bs_rd);
+        LongArray decoded;
+        ASSERT_EQ(1, LongArray::decode(decoded, sc_rd, uavcan::TailArrayOptDisabled));
+        ASSERT_TRUE(array == decoded);
+    }
+
+    // Tail array longer than the maximum length
+    uavcan::StaticTransferBuffer<50> buf;
+    for (unsigned i = 0; i < 41; i++)
+    {
+        const uint8_t byte = uint8_t(i);
+        ASSERT_EQ(1, buf.write(i, &byte, 1));
+    }
+    uavcan::BitStream bs_rd(buf);
+    uavcan::ScalarCodec sc_rd(bs_rd);
+    DynamicArray decoded;
+    ASSERT_EQ(-uavcan::ErrInvalidMarshalData, DynamicArray::decode(decoded, sc_rd, uavcan::TailArrayOptEnabled));
+}
+
+
+/*
+ * Packed arrays must be bit-exact with element by element coding, including the cast modes.
+ */
+template <typename ElementSpec>
+static void testPackedIntegerBulk()
+{
+    typedef IntegerSpec<3, SignednessUnsigned, CastModeTruncate> Prefix;
+    typedef Array<ElementSpec, ArrayModeDynamic, 20> DynamicArray;
+    typedef IntegerSpec<5, SignednessUnsigned, CastModeTruncate> LengthSpec;
+    typedef typename ElementSpec::StorageType StorageType;
+
+    ASSERT_TRUE(uavcan::BulkArrayCodec<ElementSpec>::IsSupported);
+
+    for (unsigned len = 0; len <= DynamicArray::MaxSize; len++)
+    {
+        DynamicArray array;
+        for (uint8_t i = 0; i < len; i++)
+        {
+            // Covers the whole range of the storage type, so that the cast mode matters
+            array.push_back(StorageType(uint64_t(i) * 0x9E3779B97F4A7C15ULL >> 32));
+        }
+        if (len > 1)
+        {
+            array[0] = ElementSpec::max();
+            array[1] = ElementSpec::min();
+        }
+
+        for (int tao = 0; tao < 2; tao++)
+        {
+            const uavcan::TailArrayOptimizationMode tao_mode = tao ? uavcan::TailArrayOptEnabled
+                                                                   : uavcan::TailArrayOptDisabled;
+            const bool has_length = !tao || (ElementSpec::MinBitLen < 8);
+
+            // Reference - element by element
+            uavcan::StaticTransferBuffer<100> ref_buf;
+            uavcan::BitStream ref_bs(ref_buf);
+            uavcan::ScalarCodec ref_sc(ref_bs);
+            ASSERT_EQ(1, Prefix::encode(5, ref_sc, uavcan::TailArrayOptDisabled));
+            if (has_length)
+            {
+                ASSERT_EQ(1, LengthSpec::encode(uint8_t(len), ref_sc, uavcan::TailArrayOptDisabled));
+            }
+            for (uint8_t i = 0; i < len; i++)
+            {
+                ASSERT_EQ(1, ElementSpec::encode(array[i], ref_sc, uavcan::TailArrayOptDisabled));
+            }
+
+            // Bulk - unaligned on purpose
+            uavcan::StaticTransferBuffer<100> buf;
+            uavcan::BitStream bs_wr(buf);
+            uavcan::ScalarCodec sc_wr(bs_wr);
+            ASSERT_EQ(1, Prefix::encode(5, sc_wr, uavcan::TailArrayOptDisabled));
+            ASSERT_EQ(1, DynamicArray::encode(array, sc_wr, tao_mode));
+            ASSERT_EQ(ref_bs.toString(), bs_wr.toString());
+
+            // Decoding yields the same values as the reference decoder
+            uavcan::BitStream bs_rd(buf);
+            uavcan::ScalarCodec sc_rd(bs_rd);
+            uint8_t prefix = 0;
+            ASSERT_EQ(1, Prefix::decode(prefix, sc_rd, uavcan::TailArrayOptDisabled));
+            DynamicArray decoded;
+            ASSERT_EQ(1, DynamicArray::decode(decoded, sc_rd, tao_mode));
+            ASSERT_EQ(len, decoded.size());
+
+            uavcan::BitStream ref_bs_rd(ref_buf);
+            uavcan::ScalarCodec ref_sc_rd(ref_bs_rd);
+            ASSERT_EQ(1, Prefix::decode(prefix, ref_sc_rd, uavcan::TailArrayOptDisabled));
+            if (has_length)
+            {
+                ASSERT_EQ(1, LengthSpec::decode(prefix, ref_sc_rd, uavcan::TailArrayOptDisabled));
+            }
+            for (uint8_t i = 0; i < len; i++)
+            {
+                StorageType ref = StorageType();
+                ASSERT_EQ(1, ElementSpec::decode(ref, ref_sc_rd, uavcan::TailArrayOptDisabled));
+                ASSERT_EQ(ref, decoded[i]);
+            }
+        }
+
+        // Out of buffer space - whatever fits is written, same as element by element
+        uavcan::StaticTransferBuffer<12> small_ref_buf;
+        uavcan::BitStream small_ref_bs(small_ref_buf);
+        uavcan::ScalarCodec small_ref_sc(small_ref_bs);
+        int ref_res = 1;
+        if (ElementSpec::MinBitLen < 8)
+        {
+            ref_res = LengthSpec::encode(uint8_t(len), small_ref_sc, uavcan::TailArrayOptDisabled);
+        }
+        for (uint8_t i = 0; (i < len) && (ref_res > 0); i++)
+        {
+            ref_res = ElementSpec::encode(array[i], small_ref_sc, uavcan::TailArrayOptDisabled);
+        }
+
+        uavcan::StaticTransferBuffer<12> small_buf;
+        uavcan::BitStream small_bs(small_buf);
+        uavcan::ScalarCodec small_sc(small_bs);
+        ASSERT_EQ(ref_res, DynamicArray::encode(array, small_sc, uavcan::TailArrayOptEnabled));
+        ASSERT_EQ(small_ref_bs.toString(), small_bs.toString());
+    }
+}
+
+TEST(Array, PackedIntegerBulk)
+{
+    testPackedIntegerBulk<IntegerSpec<2, SignednessSigned, CastModeSaturate> >();
+    testPackedIntegerBulk<IntegerSpec<3, SignednessUnsigned, CastModeTruncate> >();
+    testPackedIntegerBulk<IntegerSpec<7, SignednessSigned, CastModeTruncate> >();
+    testPackedIntegerBulk<IntegerSpec<11, SignednessUnsigned, CastModeSaturate> >();
+    testPackedIntegerBulk<IntegerSpec<13, SignednessUnsigned, CastModeTruncate> >();
+    testPackedIntegerBulk<IntegerSpec<14, SignednessSigned, CastModeSaturate> >();     // esc.RawCommand
+    testPackedIntegerBulk<IntegerSpec<14, SignednessSigned, CastModeTruncate> >();
+    testPackedIntegerBulk<IntegerSpec<16, SignednessUnsigned, CastModeSaturate> >();
+    testPackedIntegerBulk<IntegerSpec<19, SignednessSigned, CastModeSaturate> >();
+    testPackedIntegerBulk<IntegerSpec<24, SignednessUnsigned, CastModeTruncate> >();
+    testPackedIntegerBulk<IntegerSpec<27, SignednessSigned, CastModeTruncate> >();
+    testPackedIntegerBulk<IntegerSpec<32, SignednessSigned, CastModeSaturate> >();
+    testPackedIntegerBulk<IntegerSpec<32, SignednessUnsigned, CastModeTruncate> >();
+
+    // Booleans and 64-bit integers are coded element by element
+    ASSERT_FALSE((uavcan::BulkArrayCodec<IntegerSpec<1, SignednessUnsigned, CastModeSaturate> >::IsSupported));
+    ASSERT_FALSE((uavcan::BulkArrayCodec<IntegerSpec<33, SignednessSigned, CastModeSaturate> >::IsSupported));
+    ASSERT_FALSE((uavcan::BulkArrayCodec<IntegerSpec<64, SignednessUnsigned, CastModeTruncate> >::IsSupported));
+}
+
+/*
+ * The computed bit length is verified against the number of bytes written after every possible bit prefix,
+ * which pins down the exact number of bits.
+ */
+template <typename ArrayType>
+static void checkComputedEncodedBitLen(const ArrayType& array, uavcan::TailArrayOptimizationMode tao_mode)
+{
+    typedef IntegerSpec<1, SignednessUnsigned, CastModeTruncate> Bit;
+    const unsigned bitlen = ArrayType::computeEncodedBitLen(array, tao_mode);
+    for (unsigned prefix = 0; prefix < 8; prefix++)
+    {
+        uavcan::StaticTransferBuffer<100> buf;
+        uavcan::BitStream bs(buf);
+        uavcan::ScalarCodec sc(bs);
+        for (unsigned i = 0; i < prefix; i++)
+        {
+            ASSERT_EQ(1, Bit::encode(true, sc, uavcan::TailArrayOptDisabled));
+        }
+        ASSERT_EQ(1, ArrayType::encode(array, sc, tao_mode));
+        ASSERT_EQ((prefix + bitlen + 7U) / 8U, buf.getMaxWritePos());
+    }
+}
+
+TEST(Array, ComputeEncodedBitLen)
+{
+    typedef IntegerSpec<12, SignednessSigned, CastModeTruncate> Int12;
+    typedef IntegerSpec<8, SignednessUnsigned, CastModeTruncate> UInt8;
+    typedef Array<FloatSpec<16, CastModeSaturate>, ArrayModeStatic, 5> StaticFloat16;
+    typedef Array<Int12, ArrayModeDynamic, 9> DynamicInt12;
+    typedef Array<IntegerSpec<1, SignednessUnsigned, CastModeTruncate>, ArrayModeDynamic, 20> DynamicBool;
+    typedef Array<UInt8, ArrayModeDynamic, 5> DynamicUInt8;
+    typedef Array<DynamicUInt8, ArrayModeDynamic, 4> NestedDynamic;
+    typedef Array<DynamicUInt8, ArrayModeStatic, 3> NestedStatic;
+
+    ASSERT_EQ(80, StaticFloat16::computeEncodedBitLen(StaticFloat16(), uavcan::TailArrayOptEnabled));
+
+    for (int tao = 0; tao < 2; tao++)
+    {
+        const uavcan::TailArrayOptimizationMode tao_mode = tao ? uavcan::TailArrayOptEnabled
+                                                               : uavcan::TailArrayOptDisabled;
+        checkComputedEncodedBitLen(StaticFloat16(), tao_mode);
+
+        DynamicInt12 ints;
+        DynamicBool bools;
+        for (unsigned len = 0; len <= DynamicInt12::MaxSize; len++)
+        {
+            ASSERT_EQ(len * 12U + (tao ? 0U : 4U), DynamicInt12::computeEncodedBitLen(ints, tao_mode));
+            checkComputedEncodedBitLen(ints, tao_mode);
+            checkComputedEncodedBitLen(bools, tao_mode);
+            if (len < DynamicInt12::MaxSize)
+            {
+                ints.push_back(int16_t(len * 100U));
+                bools.push_back((len % 3U) == 0);
+                bools.push_back(true);
+            }
+        }
+
+        NestedDynamic nested_dynamic;
+        NestedStatic nested_static;
+        for (unsigned len = 0; len < NestedDynamic::MaxSize; len++)
+        {
+            checkComputedEncodedBitLen(nested_dynamic, tao_mode);
+            checkComputedEncodedBitLen(nested_static, tao_mode);
+            DynamicUInt8 inner;
+            for (unsigned i = 0; i <= len; i++)
+            {
+                inner.push_back(uint8_t(i));
+            }
+            nested_dynamic.push_back(inner);
+            nested_static[uint8_t(len % NestedStatic::MaxSize)] = inner;
+        }
+        checkComputedEncodedBitLen(nested_dynamic, tao_mode);
+        checkComputedEncodedBitLen(nested_static, tao_mode);
+    }
+}
+
+
 TEST(Array, Copyability)
 {
     typedef Array<IntegerSpec<1, SignednessUnsigned, CastModeSaturate>, ArrayModeDynamic, 5>   OneBitArray;
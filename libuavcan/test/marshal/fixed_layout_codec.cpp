@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <limits>
+#include <uavcan/marshal/types.hpp>
+#include <uavcan/marshal/type_util.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
+
+
+TEST(FixedLayoutCodec, SameAsScalarCodec)
+{
+    /*
+     * Reference
+     */
+    uavcan::StaticTransferBuffer<32> ref_buf;
+    uavcan::BitStream ref_bs(ref_buf);
+    uavcan::ScalarCodec ref_sc(ref_bs);
+
+    ASSERT_EQ(1, ref_sc.encode<3>(uint8_t(5)));
+    ASSERT_EQ(1, ref_sc.encode<12>(uint16_t(0xbeda)));
+    ASSERT_EQ(1, ref_sc.encode<1>(true));
+    ASSERT_EQ(1, ref_sc.encode<20>(int32_t(-123456)));
+    ASSERT_EQ(1, ref_sc.encode<64>(std::numeric_limits<int64_t>::min()));
+    ASSERT_EQ(1, ref_sc.encode<7>(int8_t(-3)));
+    ASSERT_EQ(1, ref_sc.encode<64>(uint64_t(0x0123456789abcdefULL)));      // Total 171 bit
+
+    /*
+     * Fused
+     */
+    enum { BitLen = 171 };
+    uint8_t image[uavcan::BitLenToByteLen<BitLen>::Result] = {};
+    {
+        uavcan::FixedLayoutCodec<0> c(image);
+        ASSERT_EQ(1, c.encode<3>(uint8_t(5)));
+    }
+    {
+        uavcan::FixedLayoutCodec<3> c(image);
+        ASSERT_EQ(1, c.encode<12>(uint16_t(0xbeda)));
+    }
+    {
+        uavcan::FixedLayoutCodec<15> c(image);
+        ASSERT_EQ(1, c.encode<1>(true));
+    }
+    {
+        uavcan::FixedLayoutCodec<16> c(image);
+        ASSERT_EQ(1, c.encode<20>(int32_t(-123456)));
+    }
+    {
+        uavcan::FixedLayoutCodec<36> c(image);
+        ASSERT_EQ(1, c.encode<64>(std::numeric_limits<int64_t>::min()));
+    }
+    {
+        uavcan::FixedLayoutCodec<100> c(image);
+        ASSERT_EQ(1, c.encode<7>(int8_t(-3)));
+    }
+    {
+        uavcan::FixedLayoutCodec<107> c(image);
+        ASSERT_EQ(1, c.encode<64>(uint64_t(0x0123456789abcdefULL)));
+    }
+
+    uavcan::StaticTransferBuffer<32> buf;
+    uavcan::BitStream bs(buf);
+    uavcan::ScalarCodec sc(bs);
+    ASSERT_EQ(1, sc.encodeBitArray(image, BitLen));
+    ASSERT_EQ(ref_bs.toString(), bs.toString());
+
+    /*
+     * Decoding back
+     */
+    uint8_t image_rd[uavcan::BitLenToByteLen<BitLen>::Result] = {};
+    uavcan::BitStream bs_rd(buf);
+    uavcan::ScalarCodec sc_rd(bs_rd);
+    ASSERT_EQ(1, sc_rd.decodeBitArray(image_rd, BitLen));
+    ASSERT_EQ(0, std::memcmp(image, image_rd, sizeof(image)));
+
+    uint16_t u16 = 0;
+    int32_t i32 = 0;
+    int64_t i64 = 0;
+    int8_t i8 = 0;
+    {
+        uavcan::FixedLayoutCodec<3> c(image_rd);
+        ASSERT_EQ(1, c.decode<12>(u16));
+        ASSERT_EQ(0xeda, u16);
+    }
+    {
+        uavcan::FixedLayoutCodec<16> c(image_rd);
+        ASSERT_EQ(1, c.decode<20>(i32));
+        ASSERT_EQ(-123456, i32);
+    }
+    {
+        uavcan::FixedLayoutCodec<36> c(image_rd);
+        ASSERT_EQ(1, c.decode<64>(i64));
+        ASSERT_EQ(std::numeric_limits<int64_t>::min(), i64);
+    }
+    {
+        uavcan::FixedLayoutCodec<100> c(image_rd);
+        ASSERT_EQ(1, c.decode<7>(i8));
+        ASSERT_EQ(-3, i8);
+    }
+
+    // Out of buffer space
+    uavcan::StaticTransferBuffer<8> small_buf;
+    uavcan::BitStream small_bs(small_buf);
+    uavcan::ScalarCodec small_sc(small_bs);
+    ASSERT_EQ(0, small_sc.encodeBitArray(image, BitLen));
+}
+
+TEST(FixedLayoutCodec, DecodeFieldFromBuffer)
+{
+    typedef uavcan::IntegerSpec<3, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> U3;
+    typedef uavcan::IntegerSpec<20, uavcan::SignednessSigned, uavcan::CastModeSaturate> I20;
+    typedef uavcan::FloatSpec<16, uavcan::CastModeSaturate> F16;
+    typedef uavcan::IntegerSpec<8, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> U8;
+
+    uavcan::StaticTransferBuffer<8> buf;
+    {
+        uavcan::BitStream bs(buf);
+        uavcan::ScalarCodec sc(bs);
+        ASSERT_EQ(1, U3::encode(5, sc, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, I20::encode(-123456, sc, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, F16::encode(-2.5F, sc, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, U8::encode(0xA5, sc, uavcan::TailArrayOptDisabled));   // Total 47 bit
+    }
+
+    uint8_t u8 = 0;
+    int32_t i32 = 0;
+    float f32 = 0;
+    ASSERT_EQ(1, (uavcan::decodeFixedLayoutField<U3, 0>(buf, u8)));
+    ASSERT_EQ(5, u8);
+    ASSERT_EQ(1, (uavcan::decodeFixedLayoutField<I20, 3>(buf, i32)));
+    ASSERT_EQ(-123456, i32);
+    ASSERT_EQ(1, (uavcan::decodeFixedLayoutField<F16, 23>(buf, f32)));
+    ASSERT_FLOAT_EQ(-2.5F, f32);
+    ASSERT_EQ(1, (uavcan::decodeFixedLayoutField<U8, 39>(buf, u8)));
+    ASSERT_EQ(0xA5, u8);
+
+    // Beyond the end of the data
+    ASSERT_EQ(0, (uavcan::decodeFixedLayoutField<U8, 47>(buf, u8)));
+    ASSERT_EQ(0xA5, u8);
+}
+
+TEST(FixedLayoutCodec, DecodeFieldFromMemory)
+{
+    typedef uavcan::IntegerSpec<3, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> U3;
+    typedef uavcan::IntegerSpec<20, uavcan::SignednessSigned, uavcan::CastModeSaturate> I20;
+    typedef uavcan::IntegerSpec<8, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> U8;
+
+    uavcan::StaticTransferBuffer<8> buf;
+    {
+        uavcan::BitStream bs(buf);
+        uavcan::ScalarCodec sc(bs);
+        ASSERT_EQ(1, U3::encode(5, sc, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, I20::encode(-123456, sc, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, U8::encode(0xA5, sc, uavcan::TailArrayOptDisabled));   // Total 31 bit
+    }
+    uint8_t data[4] = {};
+    ASSERT_EQ(4, buf.read(0, data, 4));
+
+    uint8_t u8 = 0;
+    int32_t i32 = 0;
+    ASSERT_EQ(1, (uavcan::decodeFixedLayoutField<U3, 0>(data, 4, u8)));
+    ASSERT_EQ(5, u8);
+    ASSERT_EQ(1, (uavcan::decodeFixedLayoutField<I20, 3>(data, 4, i32)));
+    ASSERT_EQ(-123456, i32);
+    ASSERT_EQ(1, (uavcan::decodeFixedLayoutField<U8, 23>(data, 4, u8)));
+    ASSERT_EQ(0xA5, u8);
+
+    // Only the bytes that the field occupies are needed
+    ASSERT_EQ(1, (uavcan::decodeFixedLayoutField<U3, 0>(data, 1, u8)));
+    ASSERT_EQ(5, u8);
+    ASSERT_EQ(0, (uavcan::decodeFixedLayoutField<I20, 3>(data, 2, i32)));
+    ASSERT_EQ(-123456, i32);
+    ASSERT_GT(0, (uavcan::decodeFixedLayoutField<U8, 0>(UAVCAN_NULLPTR, 4, u8)));
+}
+
+TEST(FixedLayoutCodec, EncodeFieldInMemory)
+{
+    typedef uavcan::IntegerSpec<3, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> U3;
+    typedef uavcan::IntegerSpec<20, uavcan::SignednessSigned, uavcan::CastModeSaturate> I20;
+    typedef uavcan::IntegerSpec<8, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> U8;
+
+    const auto encode = [](uint8_t a, int32_t b, uint8_t c, uint8_t* out_data)
+    {
+        uavcan::StaticTransferBuffer<8> buf;
+        uavcan::BitStream bs(buf);
+        uavcan::ScalarCodec sc(bs);
+        EXPECT_EQ(1, U3::encode(a, sc, uavcan::TailArrayOptDisabled));
+        EXPECT_EQ(1, I20::encode(b, sc, uavcan::TailArrayOptDisabled));
+        EXPECT_EQ(1, U8::encode(c, sc, uavcan::TailArrayOptDisabled));
+        EXPECT_EQ(4, buf.read(0, out_data, 4));
+    };
+
+    uint8_t data[4] = {};
+    uint8_t reference[4] = {};
+    encode(5, -123456, 0xA5, data);
+
+    // The neighbouring fields are left intact
+    ASSERT_EQ(1, (uavcan::encodeFixedLayoutField<I20, 3>(data, 4, 98765)));
+    encode(5, 98765, 0xA5, reference);
+    ASSERT_EQ(0, std::memcmp(data, reference, 4));
+
+    ASSERT_EQ(1, (uavcan::encodeFixedLayoutField<U3, 0>(data, 4, 9)));       // Saturated
+    ASSERT_EQ(1, (uavcan::encodeFixedLayoutField<U8, 23>(data, 4, 0x5A)));
+    encode(7, 98765, 0x5A, reference);
+    ASSERT_EQ(0, std::memcmp(data, reference, 4));
+
+    // Only the bytes that the field occupies are needed
+    ASSERT_EQ(1, (uavcan::encodeFixedLayoutField<U3, 0>(data, 1, 2)));
+    ASSERT_EQ(0, (uavcan::encodeFixedLayoutField<I20, 3>(data, 2, 0)));
+    ASSERT_GT(0, (uavcan::encodeFixedLayoutField<U8, 0>(UAVCAN_NULLPTR, 4, 0)));
+    encode(2, 98765, 0x5A, reference);
+    ASSERT_EQ(0, std::memcmp(data, reference, 4));
+}
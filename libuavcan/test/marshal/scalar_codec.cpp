@@ -96,3 +96,77 @@ TEST(ScalarCodec, RepresentationCorrectness)
     static const std::string REFERENCE = "11011010 11101111 01111100 00000000";
     ASSERT_EQ(REFERENCE, bs_wr.toString());
 }
+
+TEST(ScalarCodec, RunTimeBitLength)
+{
+    uavcan::StaticTransferBuffer<32> ref_buf;
+    uavcan::StaticTransferBuffer<32> buf;
+    {
+        uavcan::BitStream ref_bs(ref_buf);
+        uavcan::ScalarCodec ref_sc(ref_bs);
+        ASSERT_EQ(1, ref_sc.encode<3>(uint8_t(5)));
+        ASSERT_EQ(1, ref_sc.encode<12>(uint16_t(0xeda)));
+        ASSERT_EQ(1, ref_sc.encode<64>(uint64_t(0x0123456789abcdefULL)));
+        ASSERT_EQ(1, ref_sc.encode<33>(uint64_t(0x1ffffffffULL)));
+
+        uavcan::BitStream bs(buf);
+        uavcan::ScalarCodec sc(bs);
+        ASSERT_EQ(1, sc.encodeBits(5, 3));
+        ASSERT_EQ(1, sc.encodeBits(0xeda, 12));
+        ASSERT_EQ(1, sc.encodeBits(0x0123456789abcdefULL, 64));
+        ASSERT_EQ(1, sc.encodeBits(0x1ffffffffULL, 33));
+        ASSERT_EQ(ref_bs.toString(), bs.toString());
+    }
+
+    uavcan::BitStream bs(buf);
+    uavcan::ScalarCodec sc(bs);
+    uint64_t value = 0;
+    ASSERT_EQ(1, sc.decodeBits(value, 3));
+    ASSERT_EQ(5, value);
+    ASSERT_EQ(1, sc.decodeBits(value, 12));
+    ASSERT_EQ(0xeda, value);
+    ASSERT_EQ(1, sc.decodeBits(value, 64));
+    ASSERT_EQ(0x0123456789abcdefULL, value);
+    ASSERT_EQ(1, sc.decodeBits(value, 33));
+    ASSERT_EQ(0x1ffffffffULL, value);
+}
+
+template <unsigned BitLen, typename T>
+static void checkSignExtension()
+{
+    const T max = T((uint64_t(1) << (BitLen - 1)) - 1U);
+    const T values[] = { T(-max - 1), T(-max), T(-1), T(0), T(1), T(max - 1), max };
+
+    uavcan::StaticTransferBuffer<64> buf;
+    uavcan::BitStream bs_wr(buf);
+    uavcan::ScalarCodec sc_wr(bs_wr);
+    for (unsigned i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+    {
+        ASSERT_EQ(1, sc_wr.encode<BitLen>(values[i]));
+    }
+
+    uavcan::BitStream bs_rd(buf);
+    uavcan::ScalarCodec sc_rd(bs_rd);
+    for (unsigned i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+    {
+        T value = 0;
+        ASSERT_EQ(1, sc_rd.decode<BitLen>(value));
+        ASSERT_EQ(values[i], value);
+    }
+}
+
+TEST(ScalarCodec, SignExtension)
+{
+    checkSignExtension<2, int8_t>();
+    checkSignExtension<7, int8_t>();
+    checkSignExtension<8, int8_t>();
+    checkSignExtension<9, int16_t>();
+    checkSignExtension<14, int16_t>();
+    checkSignExtension<16, int16_t>();
+    checkSignExtension<17, int32_t>();
+    checkSignExtension<31, int32_t>();
+    checkSignExtension<32, int32_t>();
+    checkSignExtension<33, int64_t>();
+    checkSignExtension<63, int64_t>();
+    checkSignExtension<64, int64_t>();
+}
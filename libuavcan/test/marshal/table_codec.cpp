@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <limits>
+#include <uavcan/marshal/types.hpp>
+#include <uavcan/marshal/table_codec.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
+
+
+namespace
+{
+
+typedef uavcan::IntegerSpec<3, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> U3;
+typedef uavcan::IntegerSpec<20, uavcan::SignednessSigned, uavcan::CastModeSaturate> I20;
+typedef uavcan::IntegerSpec<1, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> Bool;
+typedef uavcan::IntegerSpec<5, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> Void5;
+typedef uavcan::FloatSpec<16, uavcan::CastModeSaturate> F16;
+typedef uavcan::FloatSpec<64, uavcan::CastModeTruncate> F64;
+typedef uavcan::IntegerSpec<7, uavcan::SignednessSigned, uavcan::CastModeTruncate> I7;
+typedef uavcan::IntegerSpec<64, uavcan::SignednessUnsigned, uavcan::CastModeTruncate> U64;
+typedef uavcan::Array<uavcan::IntegerSpec<8, uavcan::SignednessUnsigned, uavcan::CastModeSaturate>,
+                      uavcan::ArrayModeDynamic, 10> Tail;
+
+/**
+ * Mimics a generated type: the table below is what the DSDL compiler emits with --table-codec.
+ */
+struct Sample
+{
+    uint8_t a;
+    int32_t b;
+    bool c;
+    float d;
+    double e;
+    int8_t f;
+    uint64_t g;
+    Tail tail;
+
+    Sample() : a(), b(), c(), d(), e(), f(), g() { }
+
+    static const uavcan::TableCodecField CodecTable[];
+    enum { CodecTableLength = 9 };
+
+    static int encodeInline(const Sample& self, uavcan::ScalarCodec& codec, uavcan::TailArrayOptimizationMode tao)
+    {
+        int res = U3::encode(self.a, codec, uavcan::TailArrayOptDisabled);
+        res = (res > 0) ? I20::encode(self.b, codec, uavcan::TailArrayOptDisabled) : res;
+        res = (res > 0) ? Bool::encode(self.c, codec, uavcan::TailArrayOptDisabled) : res;
+        res = (res > 0) ? Void5::encode(0, codec, uavcan::TailArrayOptDisabled) : res;
+        res = (res > 0) ? F16::encode(self.d, codec, uavcan::TailArrayOptDisabled) : res;
+        res = (res > 0) ? F64::encode(self.e, codec, uavcan::TailArrayOptDisabled) : res;
+        res = (res > 0) ? I7::encode(self.f, codec, uavcan::TailArrayOptDisabled) : res;
+        res = (res > 0) ? U64::encode(self.g, codec, uavcan::TailArrayOptDisabled) : res;
+        res = (res > 0) ? Tail::encode(self.tail, codec, tao) : res;
+        return res;
+    }
+
+    static int encode(const Sample& self, uavcan::ScalarCodec& codec, uavcan::TailArrayOptimizationMode tao)
+    {
+        const void* const fields[] = { &self.a, &self.b, &self.c, &self.d, &self.e, &self.f, &self.g, &self.tail };
+        return uavcan::TableCodec::encode(CodecTable, CodecTableLength, fields, codec, tao);
+    }
+
+    static int decode(Sample& self, uavcan::ScalarCodec& codec, uavcan::TailArrayOptimizationMode tao)
+    {
+        void* const fields[] = { &self.a, &self.b, &self.c, &self.d, &self.e, &self.f, &self.g, &self.tail };
+        return uavcan::TableCodec::decode(CodecTable, CodecTableLength, fields, codec, tao);
+    }
+
+    static unsigned computeEncodedBitLen(const Sample& self, uavcan::TailArrayOptimizationMode tao)
+    {
+        const void* const fields[] = { &self.a, &self.b, &self.c, &self.d, &self.e, &self.f, &self.g, &self.tail };
+        return uavcan::TableCodec::computeEncodedBitLen(CodecTable, CodecTableLength, fields, tao);
+    }
+};
+
+const uavcan::TableCodecField Sample::CodecTable[] =
+{
+    { uavcan::TableCodecField::KindUnsigned, 3, 1, UAVCAN_NULLPTR },
+    { uavcan::TableCodecField::KindSigned, 20, 1, UAVCAN_NULLPTR },
+    { uavcan::TableCodecField::KindBool, 1, 1, UAVCAN_NULLPTR },
+    { uavcan::TableCodecField::KindVoid, 5, 1, UAVCAN_NULLPTR },
+    { uavcan::TableCodecField::KindFloat, 16, 1, UAVCAN_NULLPTR },
+    { uavcan::TableCodecField::KindFloat, 64, 0, UAVCAN_NULLPTR },
+    { uavcan::TableCodecField::KindSigned, 7, 0, UAVCAN_NULLPTR },
+    { uavcan::TableCodecField::KindUnsigned, 64, 0, UAVCAN_NULLPTR },
+    { uavcan::TableCodecField::KindOther, 0, 0, &uavcan::TableCodecFieldOps<Tail>::Instance }
+};
+
+Sample makeSample()
+{
+    Sample s;
+    s.a = 9;                    // Saturated to 7
+    s.b = -1000000;             // Saturated to the 20-bit minimum
+    s.c = true;
+    s.d = 1e6F;                 // Saturated to the float16 maximum
+    s.e = -123.456;
+    s.f = 100;                  // Truncated
+    s.g = 0xFEDCBA9876543210ULL;
+    s.tail.push_back(1);
+    s.tail.push_back(2);
+    s.tail.push_back(255);
+    return s;
+}
+
+std::string encodeToString(const Sample& s, bool inline_codec, uavcan::TailArrayOptimizationMode tao)
+{
+    uavcan::StaticTransferBuffer<64> buf;
+    uavcan::BitStream bs(buf);
+    uavcan::ScalarCodec sc(bs);
+    const int res = inline_codec ? Sample::encodeInline(s, sc, tao) : Sample::encode(s, sc, tao);
+    EXPECT_EQ(1, res);
+    return bs.toString();
+}
+
+}
+
+TEST(TableCodec, SameAsInlineCodec)
+{
+    const Sample s = makeSample();
+    ASSERT_EQ(encodeToString(s, true, uavcan::TailArrayOptEnabled),
+              encodeToString(s, false, uavcan::TailArrayOptEnabled));
+    ASSERT_EQ(encodeToString(s, true, uavcan::TailArrayOptDisabled),
+              encodeToString(s, false, uavcan::TailArrayOptDisabled));
+
+    ASSERT_EQ(3U + 20U + 1U + 5U + 16U + 64U + 7U + 64U + 24U,
+              Sample::computeEncodedBitLen(s, uavcan::TailArrayOptEnabled));
+    ASSERT_EQ(3U + 20U + 1U + 5U + 16U + 64U + 7U + 64U + 4U + 24U,
+              Sample::computeEncodedBitLen(s, uavcan::TailArrayOptDisabled));
+}
+
+TEST(TableCodec, Decode)
+{
+    const Sample ref = makeSample();
+
+    uavcan::StaticTransferBuffer<64> buf;
+    {
+        uavcan::BitStream bs(buf);
+        uavcan::ScalarCodec sc(bs);
+        ASSERT_EQ(1, Sample::encode(ref, sc, uavcan::TailArrayOptEnabled));
+    }
+
+    Sample s;
+    {
+        uavcan::BitStream bs(buf);
+        uavcan::ScalarCodec sc(bs);
+        ASSERT_EQ(1, Sample::decode(s, sc, uavcan::TailArrayOptEnabled));
+    }
+    ASSERT_EQ(7, s.a);
+    ASSERT_EQ(-524288, s.b);
+    ASSERT_TRUE(s.c);
+    ASSERT_FLOAT_EQ(65504.0F, s.d);
+    ASSERT_DOUBLE_EQ(-123.456, s.e);
+    ASSERT_EQ(-28, s.f);                        // 100 truncated to 7 bits is 0b1100100
+    ASSERT_EQ(0xFEDCBA9876543210ULL, s.g);
+    ASSERT_TRUE(s.tail == ref.tail);
+
+    // Running out of data
+    uavcan::StaticTransferBuffer<4> short_buf;
+    {
+        uavcan::BitStream bs(short_buf);
+        uavcan::ScalarCodec sc(bs);
+        ASSERT_EQ(0, Sample::encode(ref, sc, uavcan::TailArrayOptEnabled));
+    }
+    {
+        uavcan::BitStream bs(short_buf);
+        uavcan::ScalarCodec sc(bs);
+        ASSERT_EQ(0, Sample::decode(s, sc, uavcan::TailArrayOptEnabled));
+    }
+}
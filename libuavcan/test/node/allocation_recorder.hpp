@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <execinfo.h>
+#include <unistd.h>
+#include <iostream>
+#include <map>
+#include <vector>
+#include <uavcan/dynamic_memory.hpp>
+#include "test_node.hpp"
+
+/**
+ * Pool allocator wrapper that counts the allocations per phase of a test scenario and records where they come from,
+ * so that the tests can verify that the hot paths of the library don't allocate once the node has warmed up.
+ * Every allocation is attributed to its call site, which is identified by the backtrace rather than by the return
+ * address, because the library usually allocates through intermediate allocators. The call sites of the steady state
+ * can be printed to find out where an unexpected allocation comes from.
+ */
+class AllocationRecorder : public uavcan::IPoolAllocator
+{
+public:
+    enum Phase
+    {
+        PhaseInit,
+        PhaseWarmUp,
+        PhaseSteadyState,
+        NumPhases
+    };
+
+private:
+    enum { MaxBacktraceDepth = 24 };
+
+    typedef std::vector<void*> Backtrace;
+
+    uavcan::IPoolAllocator& backend_;
+    Phase phase_;
+    unsigned num_allocations_[NumPhases];
+    unsigned num_deallocations_[NumPhases];
+    std::map<Backtrace, unsigned> call_sites_[NumPhases];
+
+    void record()
+    {
+        Backtrace frames(MaxBacktraceDepth);
+        frames.resize(unsigned(::backtrace(frames.data(), MaxBacktraceDepth)));
+        num_allocations_[phase_]++;
+        call_sites_[phase_][frames]++;
+    }
+
+public:
+    explicit AllocationRecorder(uavcan::IPoolAllocator& backend)
+        : backend_(backend)
+        , phase_(PhaseInit)
+    {
+        for (unsigned i = 0; i < NumPhases; i++)
+        {
+            num_allocations_[i] = 0;
+            num_deallocations_[i] = 0;
+        }
+    }
+
+    virtual void* allocate(std::size_t size)
+    {
+        record();
+        return backend_.allocate(size);
+    }
+
+    virtual void deallocate(const void* ptr)
+    {
+        num_deallocations_[phase_]++;
+        backend_.deallocate(ptr);
+    }
+
+    virtual void* allocateTagged(std::size_t size, uavcan::PoolUsageTag tag)
+    {
+        record();
+        return backend_.allocateTagged(size, tag);
+    }
+
+    virtual void deallocateTagged(const void* ptr, uavcan::PoolUsageTag tag)
+    {
+        num_deallocations_[phase_]++;
+        backend_.deallocateTagged(ptr, tag);
+    }
+
+    virtual uavcan::uint16_t getBlockCapacity() const { return backend_.getBlockCapacity(); }
+
+    Phase getPhase() const { return phase_; }
+    void setPhase(Phase phase) { phase_ = phase; }
+
+    unsigned getNumAllocations(Phase phase) const { return num_allocations_[phase]; }
+    unsigned getNumDeallocations(Phase phase) const { return num_deallocations_[phase]; }
+    unsigned getNumCallSites(Phase phase) const { return unsigned(call_sites_[phase].size()); }
+
+    /**
+     * Prints the counters of all phases.
+     */
+    void report(const char* scenario) const
+    {
+        static const char* const PhaseNames[NumPhases] = { "init", "warm-up", "steady state" };
+        std::cout << "Allocations in scenario " << scenario << ":" << std::endl;
+        for (unsigned i = 0; i < NumPhases; i++)
+        {
+            std::cout << "\t" << PhaseNames[i] << ": " << num_allocations_[i] << " allocations, "
+                      << num_deallocations_[i] << " deallocations, " << call_sites_[i].size() << " call sites"
+                      << std::endl;
+        }
+    }
+
+    /**
+     * Prints the backtraces of the call sites of the given phase.
+     * The addresses can be resolved with addr2line if the test binary is built without -rdynamic.
+     */
+    void printCallSites(Phase phase) const
+    {
+        const std::map<Backtrace, unsigned>& sites = call_sites_[phase];
+        for (std::map<Backtrace, unsigned>::const_iterator it = sites.begin(); it != sites.end(); ++it)
+        {
+            std::cout << "Call site of " << it->second << " allocations:" << std::endl;
+            std::cout.flush();
+            ::backtrace_symbols_fd(it->first.data(), int(it->first.size()), STDOUT_FILENO);
+        }
+    }
+};
+
+/**
+ * Same as @ref TestNode, but the memory pool is accessed through @ref AllocationRecorder.
+ */
+struct AllocationRecordingTestNode : public uavcan::INode
+{
+    uavcan::HeapBasedPoolAllocator<uavcan::MemPoolBlockSize> backend;
+    AllocationRecorder pool;
+    uavcan::Scheduler scheduler;
+
+    AllocationRecordingTestNode(uavcan::ICanDriver& can_driver, uavcan::ISystemClock& clock_driver,
+                                uavcan::NodeID self_node_id)
+        : backend(1024)
+        , pool(backend)
+        , scheduler(can_driver, pool, clock_driver)
+    {
+        setNodeID(self_node_id);
+    }
+
+    virtual void registerInternalFailure(const char* msg)
+    {
+        std::cout << "AllocationRecordingTestNode internal failure: " << msg << std::endl;
+    }
+
+    virtual uavcan::IPoolAllocator& getAllocator() { return pool; }
+    virtual uavcan::Scheduler& getScheduler() { return scheduler; }
+    virtual const uavcan::Scheduler& getScheduler() const { return scheduler; }
+};
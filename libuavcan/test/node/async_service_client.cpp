@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/node/async_service_client.hpp>
+#include <uavcan/node/service_server.hpp>
+#include <root_ns_a/StringService.hpp>
+#include "test_node.hpp"
+
+
+static void stringServiceServerCallback(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>& req,
+                                        uavcan::ServiceResponseDataStructure<root_ns_a::StringService::Response>& rsp)
+{
+    rsp.string_response = "Request string: ";
+    rsp.string_response += req.string_request;
+}
+
+
+TEST(AsyncServiceClient, Basic)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    // Type registration
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    // Server
+    uavcan::ServiceServer<root_ns_a::StringService> server(nodes.a);
+    ASSERT_EQ(0, server.start(stringServiceServerCallback));
+
+    typedef uavcan::AsyncServiceClient<root_ns_a::StringService> ClientType;
+    typedef ClientType::Future FutureType;
+
+    ClientType client(nodes.b);
+    ASSERT_EQ(0, client.init());
+    client.getServiceClient().setRequestTimeout(uavcan::MonotonicDuration::fromMSec(100));
+
+    root_ns_a::StringService::Request request;
+
+    FutureType futures[3];
+    FutureType stray;                                                       // Addressed to a nonexistent node
+    for (unsigned i = 0; i < 3; i++)
+    {
+        ASSERT_EQ(FutureType::Idle, futures[i].getStatus());
+        request.string_request = "Hello ";
+        request.string_request.push_back(uint8_t('0' + i));
+        ASSERT_LT(0, client.call(1, request, futures[i]));
+        ASSERT_TRUE(futures[i].isPending());
+    }
+    ASSERT_LT(0, client.call(99, request, stray));
+    ASSERT_EQ(4, client.getServiceClient().getNumPendingCalls());
+
+    {
+        FutureType cancelled;                                               // Destroyed while pending
+        ASSERT_LT(0, client.call(1, request, cancelled));
+        ASSERT_EQ(5, client.getServiceClient().getNumPendingCalls());
+    }
+    ASSERT_EQ(4, client.getServiceClient().getNumPendingCalls());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(20));
+
+    for (unsigned i = 0; i < 3; i++)
+    {
+        ASSERT_TRUE(futures[i].isReady());
+        ASSERT_TRUE(futures[i].isSuccessful());
+        ASSERT_EQ(uavcan::NodeID(1), futures[i].getCallID().server_node_id);
+        std::string expected = "Request string: Hello ";
+        expected.push_back(char('0' + i));
+        ASSERT_EQ(expected, futures[i].getResponse().string_response.c_str());
+    }
+    ASSERT_TRUE(stray.isPending());
+    ASSERT_EQ(1, client.getServiceClient().getNumPendingCalls());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(200));
+
+    ASSERT_TRUE(stray.isReady());
+    ASSERT_FALSE(stray.isSuccessful());
+    ASSERT_EQ(FutureType::ErrorTimeout, stray.getStatus());
+    ASSERT_FALSE(client.getServiceClient().hasPendingCalls());
+
+    // Reusing a future
+    ASSERT_LT(0, client.call(1, request, futures[0]));
+    ASSERT_TRUE(futures[0].isPending());
+    futures[0].cancel();
+    ASSERT_EQ(FutureType::Idle, futures[0].getStatus());
+    ASSERT_FALSE(client.getServiceClient().hasPendingCalls());
+
+    // The client is destroyed before the future
+    FutureType orphan;
+    {
+        ClientType short_lived_client(nodes.b);
+        ASSERT_LT(0, short_lived_client.call(1, request, orphan));
+        ASSERT_TRUE(orphan.isPending());
+    }
+    ASSERT_EQ(FutureType::Idle, orphan.getStatus());
+    ASSERT_EQ(0, nodes.b.getDispatcher().getNumServiceResponseListeners());
+}
+
+
+#if UAVCAN_COROUTINES
+
+namespace
+{
+/// Minimal eagerly started coroutine type
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask get_return_object() { return DetachedTask(); }
+        std::suspend_never initial_suspend() { return std::suspend_never(); }
+        std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+        void return_void() { }
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+DetachedTask callSequentially(uavcan::AsyncServiceClient<root_ns_a::StringService>& client,
+                              std::vector<std::string>& out_responses, bool& out_done)
+{
+    root_ns_a::StringService::Request request;
+    uavcan::ServiceCallFuture<root_ns_a::StringService> future;
+    for (unsigned i = 0; i < 3; i++)
+    {
+        request.string_request = "Hello ";
+        request.string_request.push_back(uint8_t('0' + i));
+        if (client.call(i < 2 ? 1 : 99, request, future) < 0)
+        {
+            break;
+        }
+        if (co_await future)
+        {
+            out_responses.push_back(future.getResponse().string_response.c_str());
+        }
+        else
+        {
+            out_responses.push_back("timeout");
+        }
+    }
+    out_done = true;
+}
+}
+
+TEST(AsyncServiceClient, Coroutine)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    uavcan::ServiceServer<root_ns_a::StringService> server(nodes.a);
+    ASSERT_EQ(0, server.start(stringServiceServerCallback));
+
+    uavcan::AsyncServiceClient<root_ns_a::StringService> client(nodes.b);
+    client.getServiceClient().setRequestTimeout(uavcan::MonotonicDuration::fromMSec(100));
+
+    std::vector<std::string> responses;
+    bool done = false;
+    callSequentially(client, responses, done);                              // Suspends on the first call
+    ASSERT_FALSE(done);
+    ASSERT_TRUE(responses.empty());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(300));
+
+    ASSERT_TRUE(done);
+    ASSERT_EQ(3, responses.size());
+    ASSERT_EQ("Request string: Hello 0", responses[0]);
+    ASSERT_EQ("Request string: Hello 1", responses[1]);
+    ASSERT_EQ("timeout", responses[2]);
+}
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <vector>
+#include <uavcan/node/batch_subscriber.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <root_ns_a/MavlinkMessage.hpp>
+#include "../clock.hpp"
+#include "../transport/can/can.hpp"
+#include "test_node.hpp"
+
+
+struct BatchSink
+{
+    std::vector<unsigned> batch_sizes;
+    std::vector<uavcan::uint8_t> seqs;
+    std::vector<uavcan::NodeID> src_node_ids;
+
+    void handleBatch(const uavcan::ReceivedDataBatch<root_ns_a::MavlinkMessage>& batch)
+    {
+        batch_sizes.push_back(batch.getSize());
+        for (unsigned i = 0; i < batch.getSize(); i++)
+        {
+            seqs.push_back(batch[i].seq);
+            src_node_ids.push_back(batch[i].getSrcNodeID());
+        }
+    }
+
+    typedef uavcan::MethodBinder<BatchSink*,
+        void (BatchSink::*)(const uavcan::ReceivedDataBatch<root_ns_a::MavlinkMessage>&)> Binder;
+
+    Binder bind() { return Binder(this, &BatchSink::handleBatch); }
+};
+
+TEST(BatchSubscriber, Basic)
+{
+    // Manual type registration - we can't rely on the GDTR state
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(2, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    BatchSink sink;
+    uavcan::BatchSubscriber<root_ns_a::MavlinkMessage, 4, BatchSink::Binder> sub(node);
+
+    ASSERT_EQ(-uavcan::ErrInvalidParam, sub.start(BatchSink::Binder(UAVCAN_NULLPTR, UAVCAN_NULLPTR)));
+    ASSERT_EQ(0, sub.start(sink.bind()));
+
+    uavcan::TransferID tid;
+    const auto publish = [&](unsigned num_messages)
+    {
+        for (uint8_t i = 0; i < num_messages; i++)
+        {
+            uavcan::Frame frame(root_ns_a::MavlinkMessage::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                                uavcan::NodeID(uint8_t(i + 100)), uavcan::NodeID::Broadcast, tid);
+            frame.setStartOfTransfer(true);
+            frame.setEndOfTransfer(true);
+            const uint8_t payload[] = {i, 0x72, 0x08, 0xa5};
+            frame.setPayload(payload, sizeof(payload));
+            can_driver.ifaces[0].pushRx(uavcan::RxFrame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0));
+        }
+        tid.increment();
+    };
+
+    /*
+     * All messages of one spin iteration arrive in one batch
+     */
+    publish(3);
+    ASSERT_LE(0, node.spinOnce());
+
+    ASSERT_EQ(1, sink.batch_sizes.size());
+    ASSERT_EQ(3, sink.batch_sizes.at(0));
+    ASSERT_EQ(0, sink.seqs.at(0));
+    ASSERT_EQ(2, sink.seqs.at(2));
+    ASSERT_EQ(uavcan::NodeID(102), sink.src_node_ids.at(2));
+    ASSERT_EQ(0, sub.getNumPendingMessages());
+
+    /*
+     * Overflowing batch is delivered right away
+     */
+    publish(6);
+    ASSERT_LE(0, node.spinOnce());
+
+    ASSERT_EQ(3, sink.batch_sizes.size());
+    ASSERT_EQ(4, sink.batch_sizes.at(1));
+    ASSERT_EQ(2, sink.batch_sizes.at(2));
+    ASSERT_EQ(9, sink.seqs.size());
+    ASSERT_EQ(5, sink.seqs.at(8));
+
+    /*
+     * Nothing is delivered when there are no messages
+     */
+    ASSERT_LE(0, node.spin(clock_driver.getMonotonic() + durMono(10000)));
+    ASSERT_EQ(3, sink.batch_sizes.size());
+    ASSERT_EQ(0, sub.flush());
+    ASSERT_EQ(3, sink.batch_sizes.size());
+    ASSERT_EQ(0, sub.getFailureCount());
+}
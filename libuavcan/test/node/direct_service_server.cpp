@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <uavcan/node/service_server.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <root_ns_a/StringService.hpp>
+#include "../clock.hpp"
+#include "../transport/can/can.hpp"
+#include "test_node.hpp"
+
+
+TEST(ServiceResponseWriter, ByteArray)
+{
+    typedef uavcan::IntegerSpec<3, uavcan::SignednessUnsigned, uavcan::CastModeTruncate> Header;
+    typedef uavcan::Array<uavcan::IntegerSpec<8, uavcan::SignednessUnsigned, uavcan::CastModeTruncate>,
+                          uavcan::ArrayModeDynamic, 200> Data;
+    typedef uavcan::StaticTransferBuffer<(Header::MaxBitLen + Data::MaxBitLen + 7) / 8> Buffer;
+
+    const unsigned Lengths[] = { 0, 1, 15, 16, 17, 200 };
+    for (unsigned header_bitlen = 0; header_bitlen <= 3; header_bitlen += 3)
+    {
+        for (int tao = 0; tao < 2; tao++)
+        {
+            const uavcan::TailArrayOptimizationMode tao_mode =
+                (tao != 0) ? uavcan::TailArrayOptEnabled : uavcan::TailArrayOptDisabled;
+
+            for (unsigned l = 0; l < (sizeof(Lengths) / sizeof(Lengths[0])); l++)
+            {
+                const unsigned len = Lengths[l];
+
+                // Reference encoding
+                Data data;
+                for (unsigned i = 0; i < len; i++)
+                {
+                    data.push_back(uint8_t(i * 7 + 1));
+                }
+                Buffer reference;
+                {
+                    uavcan::BitStream stream(reference);
+                    uavcan::ScalarCodec codec(stream);
+                    if (header_bitlen > 0)
+                    {
+                        ASSERT_LT(0, Header::encode(5, codec, uavcan::TailArrayOptDisabled));
+                    }
+                    ASSERT_LT(0, Data::encode(data, codec, tao_mode));
+                }
+
+                // Same thing written in place
+                Buffer buffer;
+                std::memset(buffer.getRawPtr(), 0xAA, buffer.getSize());
+                uavcan::ServiceResponseWriter writer(buffer, tao_mode);
+                if (header_bitlen > 0)
+                {
+                    ASSERT_LT(0, writer.encodeField<Header>(5));
+                }
+                uint8_t* const window = writer.beginByteArray<Data>(true);
+                ASSERT_TRUE(window);
+                for (unsigned i = 0; i < len; i++)
+                {
+                    window[i] = uint8_t(i * 7 + 1);
+                }
+                ASSERT_LT(0, writer.commitByteArray<Data>(len));
+                ASSERT_FALSE(writer.isFailed());
+
+                ASSERT_EQ(reference.getMaxWritePos(), buffer.getMaxWritePos());
+                ASSERT_EQ(0, std::memcmp(reference.getRawPtr(), buffer.getRawPtr(), reference.getMaxWritePos()))
+                    << "header " << header_bitlen << " tao " << tao << " len " << len;
+            }
+        }
+    }
+
+    /*
+     * Errors
+     */
+    uavcan::StaticTransferBuffer<8> small_buffer;
+    uavcan::ServiceResponseWriter writer(small_buffer, uavcan::TailArrayOptEnabled);
+    ASSERT_FALSE(writer.beginByteArray<Data>(true));                    // Doesn't fit
+    ASSERT_TRUE(writer.isFailed());
+
+    writer.restart();
+    ASSERT_FALSE(writer.isFailed());
+    ASSERT_LT(0, writer.encodeField<Header>(5));
+    ASSERT_EQ(1, small_buffer.getMaxWritePos());
+    ASSERT_EQ(0xA0, small_buffer.getRawPtr()[0]);
+}
+
+
+struct DirectStringServerImpl
+{
+    const char* string_response;
+    bool respond;
+
+    explicit DirectStringServerImpl(const char* string_response)
+        : string_response(string_response)
+        , respond(true)
+    { }
+
+    void handleRequest(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>& request,
+                       uavcan::ServiceResponseWriter& writer)
+    {
+        typedef root_ns_a::StringService::Response::FieldTypes::string_response StringField;
+
+        char* const window = reinterpret_cast<char*>(writer.beginByteArray<StringField>(true));
+        ASSERT_TRUE(window);
+        std::memcpy(window, request.string_request.c_str(), request.string_request.size());
+        const unsigned len = unsigned(request.string_request.size()) +
+            unsigned(std::sprintf(window + request.string_request.size(), " --> %s", string_response));
+        ASSERT_LT(0, writer.commitByteArray<StringField>(len));
+        writer.setResponseEnabled(respond);
+    }
+
+    typedef uavcan::MethodBinder<DirectStringServerImpl*,
+        void (DirectStringServerImpl::*)(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>&,
+                                         uavcan::ServiceResponseWriter&)> Binder;
+
+    Binder bind() { return Binder(this, &DirectStringServerImpl::handleRequest); }
+};
+
+
+TEST(DirectServiceServer, Basic)
+{
+    // Manual type registration - we can't rely on the GDTR state
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(1, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    DirectStringServerImpl impl("456");
+
+    const auto push_request = [&](uint8_t i)
+    {
+        uavcan::Frame frame(root_ns_a::StringService::DefaultDataTypeID, uavcan::TransferTypeServiceRequest,
+                            uavcan::NodeID(uint8_t(i + 0x10)), 1, i);
+        const uint8_t req[] = {'r', 'e', 'q', uint8_t(i + '0')};
+        frame.setPayload(req, sizeof(req));
+        frame.setStartOfTransfer(true);
+        frame.setEndOfTransfer(true);
+        frame.setPriority(i);
+        can_driver.ifaces[0].pushRx(uavcan::RxFrame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0));
+    };
+
+    {
+        uavcan::DirectServiceServer<root_ns_a::StringService, DirectStringServerImpl::Binder> server(node);
+
+        ASSERT_EQ(0, node.getDispatcher().getNumServiceRequestListeners());
+        ASSERT_LE(0, server.start(impl.bind()));
+        ASSERT_EQ(1, node.getDispatcher().getNumServiceRequestListeners());
+
+        for (uint8_t i = 0; i < 2; i++)
+        {
+            push_request(i);
+        }
+        node.spin(clock_driver.getMonotonic() + uavcan::MonotonicDuration::fromUSec(10000));
+
+        /*
+         * Responses (MFT), same as the ones of the regular server
+         */
+        ASSERT_EQ(4, can_driver.ifaces[0].tx.size());
+        for (int i = 0; i < 2; i++)
+        {
+            char payloads[2][8];
+            std::snprintf(payloads[0], 8, "req%i ", i);
+            std::snprintf(payloads[1], 8, "--> 456");
+
+            uavcan::Frame fr;
+            ASSERT_TRUE(fr.parse(can_driver.ifaces[0].popTxFrame()));
+            ASSERT_FALSE(std::strncmp(payloads[0], reinterpret_cast<const char*>(fr.getPayloadPtr() + 2), 5));
+            ASSERT_EQ(i, fr.getTransferID().get());
+            ASSERT_EQ(uavcan::TransferTypeServiceResponse, fr.getTransferType());
+            ASSERT_EQ(i + 0x10, fr.getDstNodeID().get());
+            ASSERT_EQ(i, fr.getPriority().get());
+
+            ASSERT_TRUE(fr.parse(can_driver.ifaces[0].popTxFrame()));
+            ASSERT_FALSE(std::strncmp(payloads[1], reinterpret_cast<const char*>(fr.getPayloadPtr()), 7));
+            ASSERT_EQ(i, fr.getTransferID().get());
+        }
+
+        /*
+         * Suppressed response
+         */
+        impl.respond = false;
+        push_request(2);
+        node.spin(clock_driver.getMonotonic() + uavcan::MonotonicDuration::fromUSec(10000));
+        ASSERT_EQ(0, can_driver.ifaces[0].tx.size());
+
+        ASSERT_EQ(0, server.getRequestFailureCount());
+        ASSERT_EQ(0, server.getResponseFailureCount());
+    }
+    ASSERT_EQ(0, node.getDispatcher().getNumServiceRequestListeners());
+}
@@ -2,6 +2,8 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <cstdio>
+#include <vector>
 #include <gtest/gtest.h>
 #include <uavcan/node/global_data_type_registry.hpp>
 
@@ -48,6 +50,56 @@ struct DataTypeD
     static const char* getDataTypeFullName() { return "foo.DataTypeD"; }
 };
 
+struct DataTypeE             // Provides the precomputed transfer CRC, like the generated types
+{
+    enum { DefaultDataTypeID = 44 };
+    enum { DataTypeKind = uavcan::DataTypeKindMessage };
+    enum { TransferCRCBase = 0x6EA2U };
+    static uavcan::DataTypeSignature getDataTypeSignature() { return uavcan::DataTypeSignature(0xABCDEF0123456789ULL); }
+    static const char* getDataTypeFullName() { return "foo.DataTypeE"; }
+};
+
+struct TableMessage1          // Same as the entry of the adopted table
+{
+    enum { DataTypeKind = uavcan::DataTypeKindMessage };
+    static uavcan::DataTypeSignature getDataTypeSignature() { return uavcan::DataTypeSignature(1001); }
+    static const char* getDataTypeFullName() { return "table.Message1"; }
+};
+
+struct TableMessage3
+{
+    enum { DataTypeKind = uavcan::DataTypeKindMessage };
+    static uavcan::DataTypeSignature getDataTypeSignature() { return uavcan::DataTypeSignature(1003); }
+    static const char* getDataTypeFullName() { return "table.Message3"; }
+};
+
+template <unsigned N>
+struct IndexedDataType
+{
+    enum { DataTypeKind = uavcan::DataTypeKindMessage };
+    static uavcan::DataTypeSignature getDataTypeSignature() { return uavcan::DataTypeSignature(N + 1000U); }
+    static const char* getDataTypeFullName()
+    {
+        static char name[32];
+        (void)std::snprintf(name, sizeof(name), "indexed.Type%u", N);
+        return name;
+    }
+};
+
+inline void registerIndexedDataTypes(unsigned, uavcan::IntToType<0>) { }
+
+template <int N>
+void registerIndexedDataTypes(unsigned num_types, uavcan::IntToType<N>)
+{
+    if (unsigned(N) <= num_types)
+    {
+        ASSERT_EQ(uavcan::GlobalDataTypeRegistry::RegistrationResultOk,
+                  uavcan::GlobalDataTypeRegistry::instance().registerDataType<IndexedDataType<unsigned(N - 1)> >(
+                      uint16_t((N * 37) % 20000)));
+    }
+    registerIndexedDataTypes(num_types, uavcan::IntToType<N - 1>());
+}
+
 template <typename Type>
 uavcan::DataTypeDescriptor extractDescriptor(uint16_t dtid = Type::DefaultDataTypeID)
 {
@@ -166,3 +218,196 @@ TEST(GlobalDataTypeRegistry, Reset)
     GlobalDataTypeRegistry::instance().reset();
     ASSERT_FALSE(GlobalDataTypeRegistry::instance().isFrozen());
 }
+
+
+TEST(GlobalDataTypeRegistry, TransferCRCBase)
+{
+    using uavcan::GlobalDataTypeRegistry;
+    GlobalDataTypeRegistry::instance().reset();
+
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultOk,
+              GlobalDataTypeRegistry::instance().registerDataType<DataTypeB>(DataTypeB::DefaultDataTypeID));
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultOk,
+              GlobalDataTypeRegistry::instance().registerDataType<DataTypeE>(DataTypeE::DefaultDataTypeID));
+
+    // Computed at registration
+    const uavcan::DataTypeDescriptor* pdtd = GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage,
+                                                                                      "my_namespace.DataTypeB");
+    ASSERT_TRUE(pdtd);
+    ASSERT_EQ(DataTypeB::getDataTypeSignature().toTransferCRC().get(), pdtd->getTransferCRCBase().get());
+
+    // Precomputed - same algorithm as in the DSDL compiler
+    pdtd = GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage, "foo.DataTypeE");
+    ASSERT_TRUE(pdtd);
+    ASSERT_EQ(0x6EA2, pdtd->getTransferCRCBase().get());
+    ASSERT_EQ(0x6EA2, DataTypeE::getDataTypeSignature().toTransferCRC().get());
+
+    GlobalDataTypeRegistry::instance().reset();
+}
+
+
+TEST(GlobalDataTypeRegistry, Index)
+{
+    using uavcan::GlobalDataTypeRegistry;
+    enum { MaxNumTypes = UAVCAN_DATA_TYPE_REGISTRY_INDEX_CAPACITY + 1 };
+
+    // Fits the index, then overflows it - the results must be the same either way
+    const unsigned nums_types[] = { 1, MaxNumTypes - 1, MaxNumTypes };
+    for (unsigned n = 0; n < sizeof(nums_types) / sizeof(nums_types[0]); n++)
+    {
+        const unsigned num_types = nums_types[n];
+        GlobalDataTypeRegistry::instance().reset();
+        registerIndexedDataTypes(num_types, uavcan::IntToType<MaxNumTypes>());
+        ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultOk,
+                  GlobalDataTypeRegistry::instance().registerDataType<DataTypeD>(DataTypeD::DefaultDataTypeID));
+        ASSERT_EQ(num_types, GlobalDataTypeRegistry::instance().getNumMessageTypes());
+
+        // Lookups before freezing are the reference
+        std::vector<const uavcan::DataTypeDescriptor*> by_name;
+        std::vector<const uavcan::DataTypeDescriptor*> by_id;
+        for (uint16_t id = 0; id < 20000; id++)
+        {
+            by_id.push_back(GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage, id));
+        }
+        for (unsigned i = 0; i < MaxNumTypes + 1U; i++)
+        {
+            char name[32];
+            (void)std::snprintf(name, sizeof(name), "indexed.Type%u", i);
+            by_name.push_back(GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage, name));
+            ASSERT_EQ(i < num_types, by_name.back() != UAVCAN_NULLPTR);
+        }
+
+        GlobalDataTypeRegistry::instance().freeze();
+
+        for (uint16_t id = 0; id < 20000; id++)
+        {
+            ASSERT_EQ(by_id[id], GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage, id));
+        }
+        for (unsigned i = 0; i < MaxNumTypes + 1U; i++)
+        {
+            char name[32];
+            (void)std::snprintf(name, sizeof(name), "indexed.Type%u", i);
+            ASSERT_EQ(by_name[i], GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage, name));
+            ASSERT_EQ(by_name[i], GlobalDataTypeRegistry::instance().find(name));
+        }
+
+        // Services are indexed separately
+        ASSERT_FALSE(GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage, "foo.DataTypeD"));
+        const uavcan::DataTypeDescriptor* const pdtd = GlobalDataTypeRegistry::instance().find("foo.DataTypeD");
+        ASSERT_TRUE(pdtd);
+        ASSERT_EQ(pdtd, GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindService,
+                                                                 DataTypeD::DefaultDataTypeID));
+        ASSERT_FALSE(GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindService, uavcan::DataTypeID(0)));
+    }
+
+    GlobalDataTypeRegistry::instance().reset();
+}
+
+
+TEST(GlobalDataTypeRegistry, AdoptTable)
+{
+    using uavcan::GlobalDataTypeRegistry;
+    using uavcan::DataTypeDescriptor;
+    using uavcan::DataTypeSignature;
+    GlobalDataTypeRegistry::instance().reset();
+
+    static const DataTypeDescriptor Table[] =
+    {
+        DataTypeDescriptor(uavcan::DataTypeKindMessage, 10, DataTypeSignature(1001), "table.Message1"),
+        DataTypeDescriptor(uavcan::DataTypeKindMessage, 42, DataTypeSignature(456), "my_namespace.DataTypeB"),
+        DataTypeDescriptor(uavcan::DataTypeKindMessage, 100, DataTypeSignature(1003), "table.Message3"),
+        DataTypeDescriptor(uavcan::DataTypeKindService, 5, DataTypeSignature(1005), "table.Service1")
+    };
+
+    // Registered before adoption, e.g. by a static constructor; same as the table entry
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultOk,
+              GlobalDataTypeRegistry::instance().registerDataType<DataTypeB>(DataTypeB::DefaultDataTypeID));
+
+    ASSERT_FALSE(GlobalDataTypeRegistry::instance().hasTable());
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultOk, GlobalDataTypeRegistry::instance().adoptTable(Table));
+    ASSERT_TRUE(GlobalDataTypeRegistry::instance().hasTable());
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultInvalidParams,
+              GlobalDataTypeRegistry::instance().adoptTable(Table));
+
+    ASSERT_EQ(3, GlobalDataTypeRegistry::instance().getNumMessageTypes());
+    ASSERT_EQ(1, GlobalDataTypeRegistry::instance().getNumServiceTypes());
+
+    ASSERT_EQ(&Table[0], GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage, "table.Message1"));
+    ASSERT_EQ(&Table[2], GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage, uavcan::DataTypeID(100)));
+    ASSERT_EQ(&Table[3], GlobalDataTypeRegistry::instance().find("table.Service1"));
+    ASSERT_FALSE(GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage, "table.Service1"));
+    ASSERT_FALSE(GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindService, uavcan::DataTypeID(10)));
+    const DataTypeDescriptor* const pdtd_b =
+        GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage, uavcan::DataTypeID(42));
+    ASSERT_TRUE(pdtd_b);
+    ASSERT_STREQ("my_namespace.DataTypeB", pdtd_b->getFullName());
+
+    // The IDs of the table are taken
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultCollision,
+              GlobalDataTypeRegistry::instance().registerDataType<DataTypeC>(10));
+
+    // Registration of the same type under the same ID has no effect
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultOk,
+              GlobalDataTypeRegistry::instance().registerDataType<TableMessage1>(10));
+    ASSERT_EQ(3, GlobalDataTypeRegistry::instance().getNumMessageTypes());
+    ASSERT_EQ(&Table[0], GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage, "table.Message1"));
+
+    // Override with another ID frees the old one
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultOk,
+              GlobalDataTypeRegistry::instance().registerDataType<TableMessage3>(101));
+    ASSERT_EQ(3, GlobalDataTypeRegistry::instance().getNumMessageTypes());
+    ASSERT_FALSE(GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage, uavcan::DataTypeID(100)));
+    const DataTypeDescriptor* const pdtd_3 =
+        GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage, "table.Message3");
+    ASSERT_TRUE(pdtd_3);
+    ASSERT_EQ(101, pdtd_3->getID().get());
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultOk,
+              GlobalDataTypeRegistry::instance().registerDataType<DataTypeC>(100));
+    ASSERT_EQ(4, GlobalDataTypeRegistry::instance().getNumMessageTypes());
+
+    // Same results from the index
+    std::vector<const DataTypeDescriptor*> by_id;
+    for (uint16_t id = 0; id < 200; id++)
+    {
+        by_id.push_back(GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage, id));
+    }
+    GlobalDataTypeRegistry::instance().freeze();
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultFrozen,
+              GlobalDataTypeRegistry::instance().adoptTable(Table));
+    for (uint16_t id = 0; id < 200; id++)
+    {
+        ASSERT_EQ(by_id[id], GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage, id));
+    }
+    ASSERT_EQ(&Table[0], GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage, "table.Message1"));
+    ASSERT_EQ(pdtd_3, GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage, "table.Message3"));
+    ASSERT_EQ(&Table[3], GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindService, uavcan::DataTypeID(5)));
+
+    GlobalDataTypeRegistry::instance().reset();
+    ASSERT_FALSE(GlobalDataTypeRegistry::instance().hasTable());
+    ASSERT_FALSE(GlobalDataTypeRegistry::instance().find("table.Message1"));
+
+    // Invalid tables
+    static const DataTypeDescriptor Unsorted[] =
+    {
+        DataTypeDescriptor(uavcan::DataTypeKindMessage, 42, DataTypeSignature(456), "my_namespace.DataTypeB"),
+        DataTypeDescriptor(uavcan::DataTypeKindMessage, 10, DataTypeSignature(1001), "table.Message1")
+    };
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultInvalidParams,
+              GlobalDataTypeRegistry::instance().adoptTable(Unsorted));
+
+    static const DataTypeDescriptor ServicesFirst[] =
+    {
+        DataTypeDescriptor(uavcan::DataTypeKindService, 5, DataTypeSignature(1005), "table.Service1"),
+        DataTypeDescriptor(uavcan::DataTypeKindMessage, 10, DataTypeSignature(1001), "table.Message1")
+    };
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultInvalidParams,
+              GlobalDataTypeRegistry::instance().adoptTable(ServicesFirst));
+
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultOk,
+              GlobalDataTypeRegistry::instance().registerDataType<DataTypeC>(42));
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultCollision,
+              GlobalDataTypeRegistry::instance().adoptTable(Table));
+    ASSERT_FALSE(GlobalDataTypeRegistry::instance().hasTable());
+
+    GlobalDataTypeRegistry::instance().reset();
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/node/subscriber.hpp>
+#include <uavcan/node/timer.hpp>
+#include <root_ns_a/MavlinkMessage.hpp>
+#include "../clock.hpp"
+#include "../transport/can/can.hpp"
+#include "test_node.hpp"
+
+#if UAVCAN_HANDLER_PROFILING && (UAVCAN_CPP_VERSION >= UAVCAN_CPP11)
+
+namespace
+{
+/**
+ * Every handler takes 5 ticks plus whatever it consumes explicitly; the stack grows with every sample.
+ */
+struct ProfilerHooks : public uavcan::IHandlerProfilerHooks
+{
+    uavcan::uint32_t ticks;
+    uavcan::uint32_t stack_usage;
+
+    ProfilerHooks() : ticks(0xFFFFFFF0U), stack_usage(0) { }     // Wraps around during the test
+
+    virtual uavcan::uint32_t readTicks()
+    {
+        ticks += 5;
+        return ticks;
+    }
+
+    virtual uavcan::uint32_t sampleStackUsage()
+    {
+        stack_usage += 100;
+        return stack_usage;
+    }
+};
+
+void publishMavlink(CanDriverMock& can_driver, SystemClockDriver& clock_driver, uavcan::TransferID tid)
+{
+    uavcan::Frame frame(root_ns_a::MavlinkMessage::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                        uavcan::NodeID(100), uavcan::NodeID::Broadcast, tid);
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    const uint8_t payload[] = {1, 2, 3, 4, 5, 6, 7};
+    frame.setPayload(payload, sizeof(payload));
+    can_driver.ifaces[0].pushRx(uavcan::RxFrame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0));
+}
+
+}
+
+TEST(HandlerProfiler, Basic)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(2, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    uavcan::HandlerProfiler& profiler = node.getScheduler().getHandlerProfiler();
+    ProfilerHooks hooks;
+    profiler.setHooks(&hooks);
+    ASSERT_EQ(0, profiler.getNumProfiles());
+    ASSERT_FALSE(profiler.findSlowest());
+
+    /*
+     * Handlers
+     */
+    ProfilerHooks* const hooks_ptr = &hooks;
+    int num_messages = 0;
+    uavcan::Subscriber<root_ns_a::MavlinkMessage> sub(node);
+    ASSERT_LE(0, sub.start([&num_messages, hooks_ptr](const root_ns_a::MavlinkMessage&)
+    {
+        num_messages++;
+        hooks_ptr->ticks += 1000;
+    }));
+    ASSERT_STREQ("root_ns_a.MavlinkMessage", sub.getHandlerProfile().getName());
+    ASSERT_EQ(uavcan::HandlerProfile::KindSubscriber, sub.getHandlerProfile().getKind());
+
+    int num_timer_events = 0;
+    uavcan::Timer tm(node, [&num_timer_events](const uavcan::TimerEvent&) { num_timer_events++; });
+    tm.getHandlerProfile().setName("tm");
+    ASSERT_EQ(uavcan::HandlerProfile::KindDeadlineHandler, tm.getHandlerProfile().getKind());
+
+    ASSERT_EQ(2, profiler.getNumProfiles());
+    ASSERT_EQ(&tm.getHandlerProfile(), profiler.getProfiles());     // Newest first
+    ASSERT_EQ(&sub.getHandlerProfile(), profiler.getProfiles()->getNextListNode());
+
+    /*
+     * Invocation
+     */
+    tm.startPeriodic(uavcan::MonotonicDuration::fromMSec(10));
+    publishMavlink(can_driver, clock_driver, 0);
+    publishMavlink(can_driver, clock_driver, 1);
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(25)));
+    tm.stop();
+
+    ASSERT_EQ(2, num_messages);
+    ASSERT_LE(1, num_timer_events);
+
+    const uavcan::HandlerProfile& sub_profile = sub.getHandlerProfile();
+    EXPECT_EQ(2, sub_profile.getNumInvocations());
+    EXPECT_EQ(2 * 1005, sub_profile.getTotalTicks());
+    EXPECT_EQ(1005, sub_profile.getMaxTicks());
+    EXPECT_LT(0, sub_profile.getMaxStackUsage());
+
+    const uavcan::HandlerProfile& tm_profile = tm.getHandlerProfile();
+    EXPECT_EQ(unsigned(num_timer_events), tm_profile.getNumInvocations());
+    EXPECT_EQ(5U * unsigned(num_timer_events), tm_profile.getTotalTicks());
+    EXPECT_EQ(5, tm_profile.getMaxTicks());
+    EXPECT_EQ(hooks.stack_usage, std::max(sub_profile.getMaxStackUsage(), tm_profile.getMaxStackUsage()));
+
+    ASSERT_EQ(&sub_profile, profiler.findSlowest());
+
+    /*
+     * Reset and unregistration
+     */
+    profiler.resetAll();
+    EXPECT_EQ(0, sub_profile.getNumInvocations());
+    EXPECT_EQ(0, sub_profile.getTotalTicks());
+    EXPECT_EQ(0, tm_profile.getMaxStackUsage());
+    ASSERT_FALSE(profiler.findSlowest());
+
+    {
+        uavcan::Timer tm2(node);
+        ASSERT_EQ(3, profiler.getNumProfiles());
+    }
+    ASSERT_EQ(2, profiler.getNumProfiles());
+    profiler.setHooks(UAVCAN_NULLPTR);
+}
+
+TEST(HandlerProfiler, DestroyedFromHandler)
+{
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(2, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    uavcan::HandlerProfiler& profiler = node.getScheduler().getHandlerProfiler();
+
+    // The system clock is used when there are no hooks
+    uavcan::Timer* tm = new uavcan::Timer(node);
+    tm->setCallback([&tm](const uavcan::TimerEvent&)
+    {
+        uavcan::Timer*& self = tm;          // The lambda object is destroyed along with the timer
+        delete self;
+        self = UAVCAN_NULLPTR;
+    });
+    tm->startOneShotWithDelay(uavcan::MonotonicDuration::fromMSec(1));
+    ASSERT_EQ(1, profiler.getNumProfiles());
+
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_FALSE(tm);
+    ASSERT_EQ(0, profiler.getNumProfiles());
+
+    // The next handler is measured normally
+    uavcan::Timer tm2(node, [](const uavcan::TimerEvent&) { });
+    tm2.startOneShotWithDelay(uavcan::MonotonicDuration::fromMSec(1));
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_EQ(1, tm2.getHandlerProfile().getNumInvocations());
+    ASSERT_EQ(&tm2.getHandlerProfile(), profiler.findSlowest());
+}
+
+#endif
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <atomic>
+#include <thread>
+#include <gtest/gtest.h>
+#include <uavcan/node/latest_value_subscriber.hpp>
+#include <root_ns_a/MavlinkMessage.hpp>
+#include "../clock.hpp"
+#include "../transport/can/can.hpp"
+#include "test_node.hpp"
+
+
+static void publishMavlink(CanDriverMock& can_driver, SystemClockDriver& clock_driver, uavcan::uint8_t src_node_id,
+                           uavcan::uint8_t value, uavcan::TransferID tid)
+{
+    uavcan::Frame frame(root_ns_a::MavlinkMessage::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                        uavcan::NodeID(src_node_id), uavcan::NodeID::Broadcast, tid);
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    const uint8_t payload[] = {value, value, value, value, value, value, value};
+    frame.setPayload(payload, sizeof(payload));
+    can_driver.ifaces[0].pushRx(uavcan::RxFrame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0));
+}
+
+
+TEST(LatestValueSubscriber, Basic)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(2, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    typedef uavcan::LatestValueSubscriber<root_ns_a::MavlinkMessage> SubscriberType;
+    SubscriberType sub(node);
+    SubscriberType::Snapshot snapshot;
+
+    ASSERT_EQ(0, sub.start());
+    ASSERT_FALSE(sub.read(snapshot));
+    ASSERT_EQ(0, sub.getNumUsedSlots());
+
+    publishMavlink(can_driver, clock_driver, 100, 1, 0);
+    publishMavlink(can_driver, clock_driver, 101, 2, 0);
+    ASSERT_LE(0, node.spin(clock_driver.getMonotonic() + durMono(10000)));
+
+    ASSERT_TRUE(sub.read(snapshot));
+    ASSERT_EQ(2, snapshot.msg.seq);
+    ASSERT_EQ(2, snapshot.msg.msgid);
+    ASSERT_EQ(3, snapshot.msg.payload.size());
+    ASSERT_EQ(uavcan::NodeID(101), snapshot.src_node_id);
+    ASSERT_EQ(2, snapshot.update_count);
+    ASSERT_FALSE(snapshot.ts_monotonic.isZero());
+    ASSERT_EQ(1, sub.getNumUsedSlots());
+
+    // A single slot holds the message from the node that was heard last
+    ASSERT_TRUE(sub.read(uavcan::NodeID(101), snapshot));
+    ASSERT_FALSE(sub.read(uavcan::NodeID(100), snapshot));
+
+    sub.stop();
+    ASSERT_EQ(0, node.getDispatcher().getNumMessageListeners());
+    ASSERT_TRUE(sub.read(snapshot));                                    // Kept after the subscription is stopped
+    ASSERT_EQ(0, sub.getFailureCount());
+}
+
+
+TEST(LatestValueSubscriber, PerNode)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(2, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    typedef uavcan::LatestValueSubscriber<root_ns_a::MavlinkMessage, 2> SubscriberType;
+    SubscriberType sub(node);
+    SubscriberType::Snapshot snapshot;
+    ASSERT_EQ(0, sub.start());
+
+    publishMavlink(can_driver, clock_driver, 100, 10, 0);
+    publishMavlink(can_driver, clock_driver, 101, 20, 0);
+    publishMavlink(can_driver, clock_driver, 102, 30, 0);              // No slot left
+    publishMavlink(can_driver, clock_driver, 100, 11, 1);
+    ASSERT_LE(0, node.spin(clock_driver.getMonotonic() + durMono(10000)));
+
+    ASSERT_EQ(2, sub.getNumUsedSlots());
+    ASSERT_EQ(1, sub.getNumDroppedMessages());
+    ASSERT_EQ(uavcan::NodeID(100), sub.getSlotNodeID(0));
+    ASSERT_EQ(uavcan::NodeID(101), sub.getSlotNodeID(1));
+    ASSERT_FALSE(sub.getSlotNodeID(2).isValid());
+
+    ASSERT_TRUE(sub.read(uavcan::NodeID(100), snapshot));
+    ASSERT_EQ(11, snapshot.msg.seq);
+    ASSERT_EQ(2, snapshot.update_count);
+    ASSERT_TRUE(sub.read(uavcan::NodeID(101), snapshot));
+    ASSERT_EQ(20, snapshot.msg.seq);
+    ASSERT_EQ(1, snapshot.update_count);
+    ASSERT_FALSE(sub.read(uavcan::NodeID(102), snapshot));
+
+    ASSERT_TRUE(sub.read(snapshot));                                    // The latest one from any node
+    ASSERT_EQ(uavcan::NodeID(100), snapshot.src_node_id);
+    ASSERT_EQ(11, snapshot.msg.seq);
+}
+
+
+TEST(LatestValueSubscriber, ConcurrentReader)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(2, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    typedef uavcan::LatestValueSubscriber<root_ns_a::MavlinkMessage> SubscriberType;
+    SubscriberType sub(node);
+    ASSERT_EQ(0, sub.start());
+
+    std::atomic<bool> done(false);
+    std::atomic<unsigned> num_torn(0);
+    std::atomic<unsigned> num_reads(0);
+
+    // Every published message has all fields equal, so a torn snapshot is easy to detect
+    std::thread reader([&]()
+    {
+        SubscriberType::Snapshot snapshot;
+        uavcan::uint32_t last_update_count = 0;
+        while (!done.load())
+        {
+            if (sub.read(snapshot))
+            {
+                const uavcan::uint8_t value = snapshot.msg.seq;
+                if ((snapshot.msg.sysid != value) || (snapshot.msg.compid != value) ||
+                    (snapshot.msg.msgid != value) || (snapshot.msg.payload.size() != 3) ||
+                    (snapshot.msg.payload[0] != value) || (snapshot.msg.payload[2] != value) ||
+                    (snapshot.update_count < last_update_count))
+                {
+                    num_torn++;
+                }
+                last_update_count = snapshot.update_count;
+                num_reads++;
+            }
+        }
+    });
+
+    uavcan::TransferID tid;
+    for (unsigned i = 0; i < 2000; i++)
+    {
+        publishMavlink(can_driver, clock_driver, 100, uavcan::uint8_t(i), tid);
+        tid.increment();
+        ASSERT_LE(0, node.spinOnce());
+    }
+
+    done = true;
+    reader.join();
+
+    ASSERT_EQ(0, num_torn.load());
+    ASSERT_LT(0, num_reads.load());
+
+    SubscriberType::Snapshot snapshot;
+    ASSERT_TRUE(sub.read(snapshot));
+    ASSERT_EQ(2000, snapshot.update_count);
+    ASSERT_EQ(0, sub.getFailureCount());
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/node/lazy_subscriber.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <root_ns_a/MavlinkMessage.hpp>
+#include "../clock.hpp"
+#include "../transport/can/can.hpp"
+#include "test_node.hpp"
+
+
+struct LazySubscriptionListener
+{
+    typedef uavcan::ReceivedLazyView<root_ns_a::MavlinkMessage> ReceivedLazyView;
+
+    struct Received
+    {
+        uavcan::NodeID src_node_id;
+        uavcan::TransferID transfer_id;
+        uint8_t seq;
+        uint8_t msgid;
+        int msgid_res;
+        int decode_res;
+        root_ns_a::MavlinkMessage msg;
+    };
+
+    std::vector<Received> received;
+
+    void receive(const ReceivedLazyView& view)
+    {
+        Received r;
+        r.src_node_id = view.getSrcNodeID();
+        r.transfer_id = view.getTransferID();
+        r.seq = 0;
+        r.msgid = 0;
+        EXPECT_EQ(1, view.get_seq(r.seq));
+        r.msgid_res = view.get_msgid(r.msgid);
+        r.decode_res = view.decode(r.msg);
+        received.push_back(r);
+    }
+
+    typedef uavcan::MethodBinder<LazySubscriptionListener*,
+                                 void (LazySubscriptionListener::*)(const ReceivedLazyView&)> Binder;
+
+    Binder bind() { return Binder(this, &LazySubscriptionListener::receive); }
+};
+
+
+TEST(LazySubscriber, Basic)
+{
+    // Manual type registration - we can't rely on the GDTR state
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(2, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    LazySubscriptionListener listener;
+    uavcan::LazySubscriber<root_ns_a::MavlinkMessage, LazySubscriptionListener::Binder> sub(node);
+
+    // Null binder - will fail
+    ASSERT_EQ(-uavcan::ErrInvalidParam, sub.start(LazySubscriptionListener::Binder(UAVCAN_NULLPTR, UAVCAN_NULLPTR)));
+
+    /*
+     * Message layout:
+     * uint8 seq
+     * uint8 sysid
+     * uint8 compid
+     * uint8 msgid
+     * uint8[<256] payload
+     */
+    const uint8_t full_payload[] = {0x42, 0x72, 0x08, 0xa5, 'M', 's', 'g'};
+    const uint8_t short_payload[] = {0x43, 0x72};        // Truncated - the later fields are not available
+
+    std::vector<uavcan::RxFrame> rx_frames;
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        uavcan::Frame frame(root_ns_a::MavlinkMessage::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                            uavcan::NodeID(uint8_t(i + 100)), uavcan::NodeID::Broadcast, i);
+        frame.setStartOfTransfer(true);
+        frame.setEndOfTransfer(true);
+        if (i == 0)
+        {
+            frame.setPayload(full_payload, sizeof(full_payload));
+        }
+        else
+        {
+            frame.setPayload(short_payload, sizeof(short_payload));
+        }
+        rx_frames.push_back(uavcan::RxFrame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0));
+    }
+
+    ASSERT_EQ(0, sub.start(listener.bind()));
+    ASSERT_EQ(1, node.getDispatcher().getNumMessageListeners());
+
+    for (unsigned i = 0; i < rx_frames.size(); i++)
+    {
+        can_driver.ifaces[0].pushRx(rx_frames[i]);
+    }
+    ASSERT_LE(0, node.spin(clock_driver.getMonotonic() + durMono(10000)));
+
+    /*
+     * Validation
+     */
+    ASSERT_EQ(2, listener.received.size());
+
+    const LazySubscriptionListener::Received& full = listener.received.at(0);
+    ASSERT_EQ(rx_frames[0].getSrcNodeID(), full.src_node_id);
+    ASSERT_EQ(rx_frames[0].getTransferID(), full.transfer_id);
+    ASSERT_EQ(0x42, full.seq);
+    ASSERT_EQ(1, full.msgid_res);
+    ASSERT_EQ(0xa5, full.msgid);
+    ASSERT_LT(0, full.decode_res);          // Full decoding on demand
+    ASSERT_EQ(0x72, full.msg.sysid);
+    ASSERT_TRUE(full.msg.payload == "Msg");
+
+    const LazySubscriptionListener::Received& truncated = listener.received.at(1);
+    ASSERT_EQ(0x43, truncated.seq);
+    ASSERT_EQ(0, truncated.msgid_res);
+
+    sub.stop();
+    ASSERT_EQ(0, node.getDispatcher().getNumMessageListeners());
+}
@@ -88,3 +88,34 @@ TEST(Node, Basic)
     ASSERT_TRUE(log_sub.collector.msg.get());
     std::cout << *log_sub.collector.msg << std::endl;
 }
+
+
+TEST(Node, SelectedServices)
+{
+    registerTypes();
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::Node<1024> full(nodes.can_a, nodes.clock_a);
+    full.setName("com.example.full");
+    full.setNodeID(1);
+
+    uavcan::Node<1024, uavcan::NodeServiceLogger> bare(nodes.can_b, nodes.clock_b);
+    bare.setName("com.example.bare");
+    bare.setNodeID(2);
+
+    std::cout << "sizeof(uavcan::Node<1024>): " << sizeof(full) << std::endl;
+    std::cout << "sizeof(uavcan::Node<1024, NodeServiceLogger>): " << sizeof(bare) << std::endl;
+    ASSERT_GT(sizeof(full), sizeof(bare));
+
+    ASSERT_LE(0, full.start());
+    ASSERT_LE(0, bare.start());
+
+    // GetNodeInfo, GetDataTypeInfo, RestartNode, GetTransportStats
+    ASSERT_EQ(4, full.getDispatcher().getNumServiceRequestListeners());
+    // GetNodeInfo only
+    ASSERT_EQ(1, bare.getDispatcher().getNumServiceRequestListeners());
+
+    // The logger is still available
+    bare.getLogger().setLevel(uavcan::protocol::debug::LogLevel::DEBUG);
+    bare.logInfo("test", "Hello");
+}
@@ -95,3 +95,140 @@ TEST(Publisher, Basic)
     ASSERT_TRUE(uavcan::GlobalDataTypeRegistry::instance().isFrozen());
     ASSERT_TRUE(publisher.getTransferSender().isInitialized());
 }
+
+
+TEST(Publisher, RateLimit)
+{
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(2, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    uavcan::Publisher<root_ns_a::MavlinkMessage> publisher(node);
+    ASSERT_TRUE(publisher.getMinPublicationInterval().isZero());
+    publisher.setMinPublicationInterval(uavcan::MonotonicDuration::fromMSec(10));
+
+    root_ns_a::MavlinkMessage msg;
+    msg.payload = "Msg";
+
+    ASSERT_LT(0, publisher.broadcast(msg));
+    clock_mock.advance(5000);
+    ASSERT_EQ(0, publisher.broadcast(msg));                 // Skipped
+    clock_mock.advance(5000);
+    ASSERT_LT(0, publisher.broadcast(msg));
+
+    ASSERT_EQ(2, can_driver.ifaces[0].tx.size());
+    ASSERT_EQ(2, can_driver.ifaces[1].tx.size());
+}
+
+
+TEST(Publisher, ChangeOnly)
+{
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    uavcan::Publisher<root_ns_a::MavlinkMessage> publisher(node);
+    ASSERT_TRUE(publisher.getMaxSilenceInterval().isZero());
+    publisher.setMaxSilenceInterval(uavcan::MonotonicDuration::fromMSec(100));
+
+    root_ns_a::MavlinkMessage msg;
+    msg.payload = "Msg";
+
+    ASSERT_LT(0, publisher.broadcast(msg));
+    clock_mock.advance(10000);
+    ASSERT_EQ(0, publisher.broadcast(msg));                 // Unchanged
+    ASSERT_EQ(1, can_driver.ifaces[0].tx.size());
+
+    msg.seq = 1;
+    ASSERT_LT(0, publisher.broadcast(msg));                 // Changed
+    clock_mock.advance(50000);
+    ASSERT_EQ(0, publisher.broadcast(msg));
+    clock_mock.advance(50000);
+    ASSERT_LT(0, publisher.broadcast(msg));                 // Keepalive
+    ASSERT_EQ(3, can_driver.ifaces[0].tx.size());
+
+    // Multi-frame messages, a change in the last frame
+    msg.payload = "The quick brown fox jumps over the lazy dog";
+    ASSERT_LT(0, publisher.broadcast(msg));
+    const unsigned num_frames = unsigned(can_driver.ifaces[0].tx.size()) - 3U;
+    ASSERT_LT(1, num_frames);
+    ASSERT_EQ(0, publisher.broadcast(msg));
+    msg.payload = "The quick brown fox jumps over the lazy cat";
+    ASSERT_LT(0, publisher.broadcast(msg));
+    ASSERT_EQ(0, publisher.broadcast(msg));
+    ASSERT_EQ(3 + num_frames * 2, can_driver.ifaces[0].tx.size());
+
+    // Explicit Transfer ID is never suppressed
+    ASSERT_LT(0, publisher.broadcast(msg, uavcan::TransferID(7)));
+    ASSERT_EQ(3 + num_frames * 3, can_driver.ifaces[0].tx.size());
+
+    // Disabled
+    publisher.setMaxSilenceInterval(uavcan::MonotonicDuration());
+    ASSERT_LT(0, publisher.broadcast(msg));
+    ASSERT_LT(0, publisher.broadcast(msg));
+    ASSERT_EQ(3 + num_frames * 5, can_driver.ifaces[0].tx.size());
+}
+
+
+TEST(Publisher, PreparedMessage)
+{
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(2, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    uavcan::Publisher<root_ns_a::MavlinkMessage> publisher(node);
+    uavcan::Publisher<root_ns_a::MavlinkMessage>::PreparedMessage prepared;
+
+    ASSERT_FALSE(prepared.isValid());
+    ASSERT_EQ(-uavcan::ErrInvalidParam, publisher.broadcast(prepared));
+    ASSERT_EQ(-uavcan::ErrInvalidParam, prepared.patch(&root_ns_a::MavlinkMessage::LazyView::poke_seq,
+                                                       uavcan::uint8_t(1)));
+
+    root_ns_a::MavlinkMessage msg;
+    msg.seq = 0x42;
+    msg.sysid = 0x72;
+    msg.compid = 0x08;
+    msg.msgid = 0xa5;
+    msg.payload = "Msg";
+
+    ASSERT_LE(0, publisher.prepare(msg, prepared));
+    ASSERT_TRUE(prepared.isValid());
+    ASSERT_EQ(7, prepared.getBuffer().getMaxWritePos());
+
+    const uint64_t tx_timeout_usec = uint64_t(publisher.getDefaultTxTimeout().toUSec());
+
+    for (uavcan::uint8_t i = 0; i < 3; i++)
+    {
+        ASSERT_LT(0, prepared.patch(&root_ns_a::MavlinkMessage::LazyView::poke_seq, i));
+        ASSERT_LT(0, prepared.patch(&root_ns_a::MavlinkMessage::LazyView::poke_msgid, uavcan::uint8_t(0xF0U + i)));
+        ASSERT_LT(0, publisher.broadcast(prepared));
+
+        // Same as if the message were encoded from scratch
+        msg.seq = i;
+        msg.msgid = uavcan::uint8_t(0xF0U + i);
+        uavcan::Publisher<root_ns_a::MavlinkMessage>::PreparedMessage reference;
+        ASSERT_LE(0, publisher.prepare(msg, reference));
+        ASSERT_EQ(0, std::memcmp(reference.getBuffer().getRawPtr(), prepared.getBuffer().getRawPtr(), 7));
+
+        uavcan::Frame expected_frame(root_ns_a::MavlinkMessage::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                                     node.getNodeID(), uavcan::NodeID::Broadcast, i);
+        expected_frame.setPayload(reference.getBuffer().getRawPtr(), 7);
+        expected_frame.setStartOfTransfer(true);
+        expected_frame.setEndOfTransfer(true);
+
+        uavcan::CanFrame expected_can_frame;
+        ASSERT_TRUE(expected_frame.compile(expected_can_frame));
+
+        ASSERT_TRUE(can_driver.ifaces[0].matchAndPopTx(expected_can_frame, tx_timeout_usec + 100));
+        ASSERT_TRUE(can_driver.ifaces[1].matchAndPopTx(expected_can_frame, tx_timeout_usec + 100));
+    }
+}
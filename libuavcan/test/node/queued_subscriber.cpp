@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <vector>
+#include <uavcan/node/queued_subscriber.hpp>
+#include <uavcan/helpers/heap_based_pool_allocator.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <root_ns_a/MavlinkMessage.hpp>
+#include "../clock.hpp"
+#include "../transport/can/can.hpp"
+#include "test_node.hpp"
+
+
+struct QueuedMessageSink
+{
+    std::vector<uavcan::uint8_t> seqs;
+    std::vector<uavcan::NodeID> src_node_ids;
+
+    void handleMessage(const uavcan::ReceivedDataStructure<root_ns_a::MavlinkMessage>& msg)
+    {
+        seqs.push_back(msg.seq);
+        src_node_ids.push_back(msg.getSrcNodeID());
+    }
+
+    void clear()
+    {
+        seqs.clear();
+        src_node_ids.clear();
+    }
+
+    typedef uavcan::MethodBinder<QueuedMessageSink*,
+        void (QueuedMessageSink::*)(const uavcan::ReceivedDataStructure<root_ns_a::MavlinkMessage>&)> Binder;
+
+    Binder bind() { return Binder(this, &QueuedMessageSink::handleMessage); }
+};
+
+TEST(QueuedSubscriber, Basic)
+{
+    // Manual type registration - we can't rely on the GDTR state
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(2, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    typedef uavcan::QueuedSubscriber<root_ns_a::MavlinkMessage, QueuedMessageSink::Binder> SubscriberType;
+
+    uavcan::HeapBasedPoolAllocator<SubscriberType::QueueEntrySize> queue_pool(16);
+    QueuedMessageSink sink;
+
+    uavcan::TransferID tid;
+    const auto publish = [&](unsigned num_messages)
+    {
+        for (uint8_t i = 0; i < num_messages; i++)
+        {
+            uavcan::Frame frame(root_ns_a::MavlinkMessage::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                                uavcan::NodeID(uint8_t(i + 100)), uavcan::NodeID::Broadcast, tid);
+            frame.setStartOfTransfer(true);
+            frame.setEndOfTransfer(true);
+            const uint8_t payload[] = {i, 0x72, 0x08, 0xa5, 'M', 's', 'g'};
+            frame.setPayload(payload, sizeof(payload));
+            can_driver.ifaces[0].pushRx(uavcan::RxFrame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0));
+        }
+        tid.increment();
+    };
+
+    {
+        SubscriberType sub(node, queue_pool, 3);
+        ASSERT_EQ(0, sub.start(sink.bind()));
+        ASSERT_FALSE(sub.peek());
+
+        /*
+         * Drop oldest
+         */
+        publish(5);
+        ASSERT_LE(0, node.spin(clock_driver.getMonotonic() + durMono(10000)));
+
+        ASSERT_TRUE(sink.seqs.empty());                                     // Nothing delivered yet
+        ASSERT_EQ(3, sub.getQueueSize());
+        ASSERT_EQ(2, sub.getNumDroppedMessages());
+        ASSERT_EQ(3, queue_pool.getNumAllocatedBlocks());
+
+        ASSERT_TRUE(sub.peek());
+        ASSERT_EQ(2, sub.peek()->seq);
+        ASSERT_EQ(uavcan::NodeID(102), sub.peek()->getSrcNodeID());
+        ASSERT_EQ(uavcan::TransferTypeMessageBroadcast, sub.peek()->getTransferType());
+
+        ASSERT_EQ(1, sub.drain(1));
+        ASSERT_EQ(2, sub.drain());
+        ASSERT_EQ(0, sub.drain());
+        ASSERT_EQ(3, sink.seqs.size());
+        ASSERT_EQ(2, sink.seqs.at(0));
+        ASSERT_EQ(4, sink.seqs.at(2));
+        ASSERT_EQ(uavcan::NodeID(104), sink.src_node_ids.at(2));
+        ASSERT_EQ(0, sub.getQueueSize());
+        ASSERT_EQ(0, queue_pool.getNumAllocatedBlocks());
+
+        /*
+         * Drop newest
+         */
+        sink.clear();
+        sub.setOverflowPolicy(SubscriberType::DropNewest);
+        publish(5);
+        ASSERT_LE(0, node.spin(clock_driver.getMonotonic() + durMono(10000)));
+
+        ASSERT_EQ(3, sub.getQueueSize());
+        ASSERT_EQ(4, sub.getNumDroppedMessages());
+        ASSERT_EQ(0, sub.peek()->seq);
+        sub.pop();
+        ASSERT_EQ(1, sub.peek()->seq);
+
+        sub.setQueueCapacity(1);                                            // Discards the oldest
+        ASSERT_EQ(1, sub.getQueueSize());
+        ASSERT_EQ(5, sub.getNumDroppedMessages());
+        ASSERT_EQ(2, sub.peek()->seq);
+        sub.clear();
+        ASSERT_EQ(0, sub.getQueueSize());
+        ASSERT_EQ(0, queue_pool.getNumAllocatedBlocks());
+        ASSERT_TRUE(sink.seqs.empty());
+
+        /*
+         * Automatic draining at the end of the spin iteration
+         */
+        sub.setQueueCapacity(8);
+        sub.setAutoDrain(true);
+        publish(4);
+        ASSERT_LE(0, node.spin(clock_driver.getMonotonic() + durMono(10000)));
+
+        ASSERT_EQ(4, sink.seqs.size());
+        ASSERT_EQ(3, sink.seqs.at(3));
+        ASSERT_EQ(0, sub.getQueueSize());
+        ASSERT_EQ(5, sub.getNumDroppedMessages());
+        ASSERT_EQ(0, sub.getFailureCount());
+
+        /*
+         * Messages that are still queued are freed with the subscriber
+         */
+        sub.setAutoDrain(false);
+        publish(2);
+        ASSERT_LE(0, node.spin(clock_driver.getMonotonic() + durMono(10000)));
+        ASSERT_EQ(2, sub.getQueueSize());
+        ASSERT_EQ(2, queue_pool.getNumAllocatedBlocks());
+    }
+    ASSERT_EQ(0, queue_pool.getNumAllocatedBlocks());
+    ASSERT_EQ(0, node.getDispatcher().getNumMessageListeners());
+}
+
+
+TEST(QueuedSubscriber, NodePool)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(2, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    /*
+     * The entries don't fit the blocks of the node's pool, so every message is dropped
+     */
+    QueuedMessageSink sink;
+    uavcan::QueuedSubscriber<root_ns_a::MavlinkMessage, QueuedMessageSink::Binder> sub(node, 4);
+    ASSERT_EQ(0, sub.start(sink.bind()));
+
+    uavcan::Frame frame(root_ns_a::MavlinkMessage::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                        uavcan::NodeID(100), uavcan::NodeID::Broadcast, 0);
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    const uint8_t payload[] = {0x42, 0x72, 0x08, 0xa5};
+    frame.setPayload(payload, sizeof(payload));
+    can_driver.ifaces[0].pushRx(uavcan::RxFrame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0));
+
+    ASSERT_LE(0, node.spin(clock_driver.getMonotonic() + durMono(10000)));
+
+    ASSERT_EQ(0, sub.getQueueSize());
+    ASSERT_EQ(1, sub.getNumDroppedMessages());
+    ASSERT_EQ(0, sub.drain());
+    ASSERT_TRUE(sink.seqs.empty());
+}
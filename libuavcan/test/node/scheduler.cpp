@@ -114,3 +114,648 @@ TEST(Scheduler, TimerCpp11)
 }
 
 #endif
+
+
+struct DeadlineRecorder : public uavcan::DeadlineHandler
+{
+    std::vector<uavcan::MonotonicTime>& fired_deadlines;
+    uavcan::MonotonicTime last_event;
+
+    DeadlineRecorder(uavcan::Scheduler& scheduler, std::vector<uavcan::MonotonicTime>& arg_fired_deadlines)
+        : uavcan::DeadlineHandler(scheduler)
+        , fired_deadlines(arg_fired_deadlines)
+    { }
+
+    virtual void handleDeadline(uavcan::MonotonicTime current)
+    {
+        fired_deadlines.push_back(getDeadline());
+        last_event = current;
+    }
+};
+
+/*
+ * Checks the ordering invariants of whichever backend is selected, with deadlines ranging from the past to hours
+ * ahead and a clock that moves both in small steps and in large jumps.
+ */
+TEST(Scheduler, DeadlineOrdering)
+{
+    SystemClockMock clock_mock(1000000);
+    CanDriverMock can_driver(2, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+    uavcan::DeadlineScheduler& ds = node.getScheduler().getDeadlineScheduler();
+
+    std::vector<uavcan::MonotonicTime> fired;
+    std::vector<DeadlineRecorder*> handlers;
+    for (unsigned i = 0; i < 300; i++)
+    {
+        handlers.push_back(new DeadlineRecorder(node.getScheduler(), fired));
+    }
+
+    uint64_t seed = 1;
+    const uint64_t Ranges[] = { 100000ULL, 10000000ULL, 600000000ULL, 20000000000ULL };
+    for (unsigned i = 0; i < handlers.size(); i++)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        const uint64_t range = Ranges[i % (sizeof(Ranges) / sizeof(Ranges[0]))];
+        const uint64_t deadline = clock_mock.monotonic - 50000 + (seed >> 20) % range;
+        handlers[i]->startWithDeadline(uavcan::MonotonicTime::fromUSec(deadline));
+    }
+    ASSERT_EQ(300, ds.getNumHandlers());
+
+    // A few handlers are stopped and restarted, which must not affect the others
+    for (unsigned i = 0; i < handlers.size(); i += 7)
+    {
+        handlers[i]->stop();
+        ASSERT_FALSE(handlers[i]->isRunning());
+    }
+    ASSERT_EQ(257, ds.getNumHandlers());
+    for (unsigned i = 0; i < handlers.size(); i += 14)
+    {
+        handlers[i]->startWithDelay(uavcan::MonotonicDuration::fromMSec(i));
+        ASSERT_TRUE(handlers[i]->isRunning());
+    }
+    ASSERT_EQ(279, ds.getNumHandlers());
+
+    unsigned step = 0;
+    while (ds.getNumHandlers() > 0)
+    {
+        uavcan::MonotonicTime expected_earliest = uavcan::MonotonicTime::getMax();
+        for (unsigned i = 0; i < handlers.size(); i++)
+        {
+            if (handlers[i]->isRunning())
+            {
+                expected_earliest = uavcan::min(expected_earliest, handlers[i]->getDeadline());
+            }
+        }
+        ASSERT_EQ(expected_earliest, ds.getEarliestDeadline());
+
+        const unsigned num_fired_before = unsigned(fired.size());
+        const uavcan::MonotonicTime ts = ds.pollAndGetMonotonicTime(clock_mock);
+
+        // Everything due was fired, in order; nothing else was
+        for (unsigned i = num_fired_before; i < fired.size(); i++)
+        {
+            ASSERT_LE(fired[i].toUSec(), ts.toUSec());
+            if (i > 0)
+            {
+                ASSERT_LE(fired[i - 1].toUSec(), fired[i].toUSec());
+            }
+        }
+        for (unsigned i = 0; i < handlers.size(); i++)
+        {
+            if (handlers[i]->isRunning())
+            {
+                ASSERT_GT(handlers[i]->getDeadline().toUSec(), ts.toUSec());
+            }
+        }
+
+        // Mostly short steps, sometimes a long stall
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        clock_mock.advance(((++step % 50) == 0) ? ((seed >> 20) % 3000000000ULL) : ((seed >> 20) % 20000ULL));
+    }
+    ASSERT_EQ(279, fired.size());
+    ASSERT_EQ(uavcan::MonotonicTime::getMax(), ds.getEarliestDeadline());
+
+    for (unsigned i = 0; i < handlers.size(); i++)
+    {
+        delete handlers[i];
+    }
+}
+
+
+struct TimerStartingRxFrameListener : public uavcan::IRxFrameListener
+{
+    uavcan::TimerBase& timer;
+
+    explicit TimerStartingRxFrameListener(uavcan::TimerBase& arg_timer) : timer(arg_timer) { }
+
+    virtual void handleRxFrame(const uavcan::CanRxFrame&, uavcan::CanIOFlags)
+    {
+        timer.startOneShotWithDelay(uavcan::MonotonicDuration::fromMSec(1));
+    }
+};
+
+struct SelectCountingCanDriverMock : public CanDriverMock
+{
+    unsigned num_selects;
+
+    SelectCountingCanDriverMock(unsigned num_ifaces, uavcan::ISystemClock& iclock)
+        : CanDriverMock(num_ifaces, iclock)
+        , num_selects(0)
+    { }
+
+    virtual uavcan::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                                   const uavcan::CanFrame* (& pending_tx)[uavcan::MaxCanIfaces],
+                                   uavcan::MonotonicTime deadline)
+    {
+        num_selects++;
+        return CanDriverMock::select(inout_masks, pending_tx, deadline);
+    }
+};
+
+TEST(Scheduler, EventDriven)
+{
+    SystemClockMock clock_mock(1000000);
+    SelectCountingCanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+    uavcan::Scheduler& sch = node.getScheduler();
+
+    TimerCallCounter tcc;
+    uavcan::TimerEventForwarder<TimerCallCounter::Binder> a(node, tcc.bindA());
+
+    /*
+     * Polling mode - the scheduler wakes up every 5 ms (the default resolution) regardless of the deadlines
+     */
+    ASSERT_FALSE(sch.isEventDriven());
+    const uavcan::MonotonicTime start_ts = clock_mock.getMonotonic();
+    a.startOneShotWithDeadline(start_ts + durMono(12345));
+    ASSERT_EQ(0, node.spin(start_ts + durMono(100000)));
+    ASSERT_EQ(1, tcc.events_a.size());
+    ASSERT_EQ(start_ts + durMono(12345), tcc.events_a[0].real_time);
+    ASSERT_LE(20, can_driver.num_selects);
+
+    /*
+     * Event driven mode - the clock mock jumps straight to the deadline
+     */
+    sch.setEventDriven(true);
+    ASSERT_TRUE(sch.isEventDriven());
+    tcc.events_a.clear();
+    can_driver.num_selects = 0;
+    const uavcan::MonotonicTime ts = clock_mock.getMonotonic();
+    a.startOneShotWithDeadline(ts + durMono(12345));
+    ASSERT_EQ(0, node.spin(ts + durMono(100000)));
+    ASSERT_EQ(1, tcc.events_a.size());
+    ASSERT_EQ(ts + durMono(12345), tcc.events_a[0].real_time);
+    ASSERT_EQ(ts + durMono(100000), clock_mock.getMonotonic());
+    ASSERT_GE(4, can_driver.num_selects);               // The timer, the end of spin, maybe a cleanup
+
+    /*
+     * A timer started from a reception callback cuts the ongoing dispatcher spin short
+     */
+    TimerStartingRxFrameListener listener(a);
+    node.getDispatcher().installRxFrameListener(&listener);
+    tcc.events_a.clear();
+    const uavcan::MonotonicTime rx_ts = clock_mock.getMonotonic();
+    const uint8_t data[] = { 1, 2, 3 };
+    can_driver.ifaces.at(0).pushRx(uavcan::CanFrame(123 | uavcan::CanFrame::FlagEFF, data, sizeof(data)));
+    ASSERT_LE(0, node.spin(rx_ts + durMono(100000)));
+    ASSERT_EQ(1, tcc.events_a.size());
+    ASSERT_EQ(rx_ts + durMono(1000), tcc.events_a[0].real_time);
+    node.getDispatcher().removeRxFrameListener();
+}
+
+TEST(Scheduler, TimerSlack)
+{
+    SystemClockMock clock_mock(1000000);
+    SelectCountingCanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+    uavcan::Scheduler& sch = node.getScheduler();
+    uavcan::DeadlineScheduler& ds = sch.getDeadlineScheduler();
+    sch.setEventDriven(true);
+
+    TimerCallCounter tcc;
+    uavcan::TimerEventForwarder<TimerCallCounter::Binder> a(node, tcc.bindA());
+    uavcan::TimerEventForwarder<TimerCallCounter::Binder> b(node, tcc.bindB());
+
+    /*
+     * A lone timer with slack fires at the end of its slack window
+     */
+    ASSERT_EQ(0, a.getSlack().toUSec());
+    a.setSlack(durMono(-1000));
+    ASSERT_EQ(0, a.getSlack().toUSec());
+    a.setSlack(durMono(5000));
+    ASSERT_EQ(5000, a.getSlack().toUSec());
+
+    uavcan::MonotonicTime ts = clock_mock.getMonotonic();
+    a.startOneShotWithDeadline(ts + durMono(10000));
+    ASSERT_EQ(ts + durMono(10000), ds.getEarliestDeadline());
+    ASSERT_EQ(ts + durMono(15000), ds.getEarliestWakeup());
+    ASSERT_EQ(0, node.spin(ts + durMono(100000)));
+    ASSERT_EQ(1, tcc.events_a.size());
+    ASSERT_EQ(ts + durMono(10000), tcc.events_a[0].scheduled_time);
+    ASSERT_EQ(ts + durMono(15000), tcc.events_a[0].real_time);
+
+    /*
+     * The timers whose windows overlap fire together, in the order of their deadlines
+     */
+    tcc.events_a.clear();
+    ts = clock_mock.getMonotonic();
+    a.startPeriodic(durMono(10000));
+    b.startOneShotWithDeadline(ts + durMono(13000));
+    ASSERT_EQ(ts + durMono(13000), ds.getEarliestWakeup());
+    ASSERT_EQ(0, node.spin(ts + durMono(14000)));
+    ASSERT_EQ(1, tcc.events_a.size());
+    ASSERT_EQ(1, tcc.events_b.size());
+    ASSERT_EQ(ts + durMono(13000), tcc.events_a[0].real_time);
+    ASSERT_EQ(ts + durMono(13000), tcc.events_b[0].real_time);
+
+    // The period doesn't drift
+    ASSERT_EQ(ts + durMono(20000), a.getDeadline());
+    ASSERT_EQ(ts + durMono(25000), ds.getEarliestWakeup());
+
+    /*
+     * Changing the slack of a running timer takes effect immediately
+     */
+    a.setSlack(uavcan::MonotonicDuration());
+    ASSERT_TRUE(a.isRunning());
+    ASSERT_EQ(ts + durMono(20000), a.getDeadline());
+    ASSERT_EQ(ts + durMono(20000), ds.getEarliestWakeup());
+    a.stop();
+    ASSERT_EQ(uavcan::MonotonicTime::getMax(), ds.getEarliestWakeup());
+}
+
+
+struct FrameCountingRxFrameListener : public uavcan::IRxFrameListener
+{
+    unsigned num_frames;
+
+    FrameCountingRxFrameListener() : num_frames(0) { }
+
+    virtual void handleRxFrame(const uavcan::CanRxFrame&, uavcan::CanIOFlags) { num_frames++; }
+};
+
+struct FrameCountRecorder
+{
+    const FrameCountingRxFrameListener& listener;
+    std::vector<unsigned> frame_counts;
+
+    explicit FrameCountRecorder(const FrameCountingRxFrameListener& arg_listener) : listener(arg_listener) { }
+
+    void handle(const uavcan::TimerEvent&) { frame_counts.push_back(listener.num_frames); }
+
+    typedef uavcan::MethodBinder<FrameCountRecorder*, void (FrameCountRecorder::*)(const uavcan::TimerEvent&)> Binder;
+};
+
+TEST(Scheduler, SpinBudget)
+{
+    SystemClockMock clock_mock(1000000);
+    CanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+
+    FrameCountingRxFrameListener listener;
+    node.getDispatcher().installRxFrameListener(&listener);
+
+    FrameCountRecorder recorder(listener);
+    std::vector<uavcan::TimerEventForwarder<FrameCountRecorder::Binder>*> timers;
+    for (unsigned i = 0; i < 3; i++)
+    {
+        timers.push_back(new uavcan::TimerEventForwarder<FrameCountRecorder::Binder>(node,
+            FrameCountRecorder::Binder(&recorder, &FrameCountRecorder::handle)));
+        timers.back()->startOneShotWithDeadline(clock_mock.getMonotonic());
+    }
+
+    // A flood of frames is pending while the timers are already due
+    for (uint8_t i = 0; i < 20; i++)
+    {
+        can_driver.ifaces.at(0).pushRx(uavcan::CanFrame(123 | uavcan::CanFrame::FlagEFF, &i, 1));
+    }
+
+    uavcan::SpinBudget budget;
+    budget.max_frames = 4;
+    budget.max_deadline_handlers = 1;
+
+    /*
+     * Every slice processes up to 4 frames, then one timer; the flood doesn't hold the timers back
+     */
+    ASSERT_EQ(20, node.spin(clock_mock.getMonotonic() + durMono(10000), budget));
+    ASSERT_EQ(20, listener.num_frames);
+    ASSERT_EQ(3, recorder.frame_counts.size());
+    ASSERT_LE(1, recorder.frame_counts[0]);
+    ASSERT_GE(4, recorder.frame_counts[0]);
+    for (unsigned i = 1; i < recorder.frame_counts.size(); i++)
+    {
+        ASSERT_LT(recorder.frame_counts[i - 1], recorder.frame_counts[i]);
+        ASSERT_GE(recorder.frame_counts[i - 1] + 4, recorder.frame_counts[i]);
+    }
+
+    /*
+     * The default budget is unlimited
+     */
+    recorder.frame_counts.clear();
+    listener.num_frames = 0;
+    for (uint8_t i = 0; i < 20; i++)
+    {
+        can_driver.ifaces.at(0).pushRx(uavcan::CanFrame(123 | uavcan::CanFrame::FlagEFF, &i, 1));
+    }
+    for (unsigned i = 0; i < timers.size(); i++)
+    {
+        timers[i]->startOneShotWithDeadline(clock_mock.getMonotonic());
+    }
+    ASSERT_LE(0, node.spin(clock_mock.getMonotonic() + durMono(10000), uavcan::SpinBudget()));
+    ASSERT_EQ(20, listener.num_frames);
+    ASSERT_EQ(3, recorder.frame_counts.size());
+    ASSERT_EQ(recorder.frame_counts[0], recorder.frame_counts[2]);     // All timers were handled at once
+
+    node.getDispatcher().removeRxFrameListener();
+    for (unsigned i = 0; i < timers.size(); i++)
+    {
+        delete timers[i];
+    }
+}
+
+
+TEST(Scheduler, EventLoopIntegration)
+{
+    SystemClockMock clock_mock(1000000);
+    CanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+    uavcan::Scheduler& sch = node.getScheduler();
+
+    FrameCountingRxFrameListener listener;
+    node.getDispatcher().installRxFrameListener(&listener);
+
+    TimerCallCounter tcc;
+    uavcan::TimerEventForwarder<TimerCallCounter::Binder> a(node, tcc.bindA());
+
+    /*
+     * Without timers, the next deadline is the next cleanup
+     */
+    const uavcan::MonotonicTime start_ts = clock_mock.getMonotonic();
+    uavcan::MonotonicTime next_deadline;
+    ASSERT_EQ(0, node.processReady(next_deadline));
+    ASSERT_LT(start_ts, next_deadline);
+    ASSERT_GE(start_ts + sch.getCleanupPeriod(), next_deadline);
+    ASSERT_EQ(next_deadline, sch.getNextDeadline());
+
+    /*
+     * A timer brings it closer; nothing blocks and the clock doesn't move
+     */
+    a.startOneShotWithDeadline(start_ts + durMono(1000));
+    ASSERT_EQ(start_ts + durMono(1000), sch.getNextDeadline());
+
+    const uint8_t data[] = { 1, 2, 3 };
+    can_driver.ifaces.at(0).pushRx(uavcan::CanFrame(123 | uavcan::CanFrame::FlagEFF, data, sizeof(data)));
+    ASSERT_EQ(1, node.processReady(next_deadline));
+    ASSERT_EQ(1, listener.num_frames);
+    ASSERT_EQ(start_ts + durMono(1000), next_deadline);
+    ASSERT_EQ(start_ts, clock_mock.getMonotonic());
+    ASSERT_EQ(0, tcc.events_a.size());
+
+    clock_mock.advance(1000);
+    ASSERT_EQ(0, node.processReady(next_deadline));
+    ASSERT_EQ(1, tcc.events_a.size());
+    ASSERT_LT(start_ts + durMono(1000), next_deadline);
+
+    /*
+     * The interfaces that have to be watched for writing
+     */
+    ASSERT_EQ(0, sch.getIfacesAwaitingWrite());
+    can_driver.ifaces.at(0).writeable = false;
+    ASSERT_EQ(0, node.getDispatcher().getCanIOManager().send(
+        uavcan::CanFrame(456 | uavcan::CanFrame::FlagEFF, data, sizeof(data)), start_ts + durMono(100000),
+        uavcan::MonotonicTime(), 1, uavcan::CanTxQueue::Volatile, uavcan::CanIOFlags()));
+    ASSERT_EQ(1, sch.getIfacesAwaitingWrite());
+
+    can_driver.ifaces.at(0).writeable = true;
+    ASSERT_LE(0, node.processReady(next_deadline));
+    ASSERT_EQ(0, sch.getIfacesAwaitingWrite());
+    ASSERT_TRUE(can_driver.ifaces.at(0).matchAndPopTx(
+        uavcan::CanFrame(456 | uavcan::CanFrame::FlagEFF, data, sizeof(data)), start_ts + durMono(100000)));
+
+    node.getDispatcher().removeRxFrameListener();
+}
+
+
+struct PoolPressureRecorder : public uavcan::IPoolPressureListener
+{
+    std::vector<bool> events;
+
+    virtual void handlePoolPressure(bool high) { events.push_back(high); }
+};
+
+TEST(Scheduler, PoolWatermarks)
+{
+    SystemClockMock clock_mock(1000000);
+    CanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+    uavcan::Scheduler& sch = node.getScheduler();
+
+    PoolPressureRecorder recorder;
+    sch.setPoolPressureListener(&recorder);
+    sch.setPoolWatermarks(10, 20);
+    ASSERT_EQ(10, sch.getPoolHighWatermark());
+    ASSERT_EQ(10, sch.getPoolLowWatermark());      // Clamped
+    sch.setPoolWatermarks(10, 2);
+
+    /*
+     * The TX queue is filled with the frames that will expire while the interface is not writeable
+     */
+    can_driver.ifaces.at(0).writeable = false;
+    const uint8_t data[] = { 1, 2, 3 };
+    const uavcan::MonotonicTime tx_deadline = clock_mock.getMonotonic() + durMono(1000);
+    for (uint32_t i = 0; i < 12; i++)
+    {
+        ASSERT_EQ(0, node.getDispatcher().getCanIOManager().send(
+            uavcan::CanFrame((100 + i) | uavcan::CanFrame::FlagEFF, data, sizeof(data)), tx_deadline,
+            uavcan::MonotonicTime(), 1, uavcan::CanTxQueue::Volatile, uavcan::CanIOFlags()));
+    }
+    ASSERT_LE(10, node.getAllocator().getNumUsedBlocks());
+    ASSERT_FALSE(sch.isUnderPoolPressure());
+
+    /*
+     * The regular cleanup is far away, but the high watermark triggers it at once
+     */
+    clock_mock.advance(2000);
+    ASSERT_LE(0, node.spinOnce());
+    ASSERT_TRUE(sch.isUnderPoolPressure());
+    ASSERT_EQ(1, sch.getNumPoolPressureEvents());
+    ASSERT_GE(2, node.getAllocator().getNumUsedBlocks());
+    ASSERT_EQ(1, recorder.events.size());
+    ASSERT_TRUE(recorder.events[0]);
+
+    ASSERT_LE(0, node.spinOnce());
+    ASSERT_FALSE(sch.isUnderPoolPressure());
+    ASSERT_EQ(2, recorder.events.size());
+    ASSERT_FALSE(recorder.events[1]);
+
+    /*
+     * Disabled
+     */
+    sch.setPoolWatermarks(0, 0);
+    ASSERT_LE(0, node.spinOnce());
+    ASSERT_EQ(1, sch.getNumPoolPressureEvents());
+    ASSERT_EQ(2, recorder.events.size());
+}
+
+
+TEST(Scheduler, PhaseSpreading)
+{
+    SystemClockMock clock_mock(1000000);
+    CanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+    node.getScheduler().setEventDriven(true);
+
+    const uavcan::PeriodicPhaseAllocator& alloc = node.getScheduler().getPhaseAllocator();
+    const uint8_t NumBins = uavcan::PeriodicPhaseAllocator::NumBins;
+    ASSERT_LE(4, NumBins);
+
+    const uavcan::MonotonicDuration period = durMono(10000);
+    const uavcan::MonotonicTime start_ts = clock_mock.getMonotonic();   // Multiple of the period
+    const uavcan::MonotonicDuration offset_b = uavcan::PeriodicPhaseAllocator::computeOffset(NumBins / 2, period);
+
+    TimerCallCounter tcc;
+    uavcan::TimerEventForwarder<TimerCallCounter::Binder> a(node, tcc.bindA());
+    uavcan::TimerEventForwarder<TimerCallCounter::Binder> b(node, tcc.bindB());
+
+    /*
+     * Equally weighted timers take the phases in the bit-reversed order
+     */
+    a.startPeriodicSpread(period);
+    b.startPeriodicSpread(period);
+    ASSERT_EQ(1, alloc.getLoad(0));
+    ASSERT_EQ(1, alloc.getLoad(NumBins / 2));
+    ASSERT_EQ(start_ts + period, a.getDeadline());
+    ASSERT_EQ(start_ts + offset_b, b.getDeadline());
+
+    ASSERT_EQ(0, node.spin(start_ts + durMono(42000)));
+    ASSERT_EQ(4, tcc.events_a.size());
+    ASSERT_EQ(4, tcc.events_b.size());
+    for (unsigned i = 0; i < 4; i++)
+    {
+        ASSERT_EQ(start_ts + period * int64_t(i + 1), tcc.events_a[i].scheduled_time);
+        ASSERT_EQ(start_ts + offset_b + period * int64_t(i), tcc.events_b[i].scheduled_time);
+    }
+
+    /*
+     * A heavy timer takes a phase of its own; the phases are freed when the timers are stopped, restarted
+     * or destroyed
+     */
+    {
+        uavcan::TimerEventForwarder<TimerCallCounter::Binder> c(node, tcc.bindA());
+        uavcan::TimerEventForwarder<TimerCallCounter::Binder> d(node, tcc.bindA());
+        c.startPeriodicSpread(period, 3);
+        d.startPeriodicSpread(period);
+        ASSERT_EQ(3, alloc.getLoad(NumBins / 4));
+        ASSERT_EQ(1, alloc.getLoad(NumBins / 4 * 3));
+
+        a.stop();
+        ASSERT_EQ(0, alloc.getLoad(0));
+        b.startPeriodic(period);
+        ASSERT_EQ(0, alloc.getLoad(NumBins / 2));
+
+        d.startPeriodicSpread(period);              // Restart takes the least loaded phase again
+        ASSERT_EQ(1, alloc.getLoad(0));
+        ASSERT_EQ(0, alloc.getLoad(NumBins / 4 * 3));
+    }
+    for (uint8_t i = 0; i < NumBins; i++)
+    {
+        ASSERT_EQ(0, alloc.getLoad(i));
+    }
+}
+
+namespace
+{
+
+struct CountingTask : public uavcan::ExecutorTask
+{
+    unsigned num_executed;
+    unsigned num_completed;
+    bool executed_when_completed;
+
+    CountingTask()
+        : num_executed(0)
+        , num_completed(0)
+        , executed_when_completed(false)
+    { }
+
+    virtual void execute() { num_executed++; }
+
+    virtual void handleCompletion()
+    {
+        executed_when_completed = num_executed > num_completed;
+        num_completed++;
+    }
+};
+
+/**
+ * Executes the tasks only when told to, like a busy thread pool.
+ */
+struct ManualExecutor : public uavcan::IExecutor
+{
+    std::vector<uavcan::ExecutorTask*> queued;
+    std::vector<uavcan::ExecutorTask*> completed;
+
+    virtual int post(uavcan::ExecutorTask& task)
+    {
+        queued.push_back(&task);
+        return 0;
+    }
+
+    virtual uavcan::ExecutorTask* popCompleted()
+    {
+        if (completed.empty())
+        {
+            return UAVCAN_NULLPTR;
+        }
+        uavcan::ExecutorTask* const task = completed.front();
+        completed.erase(completed.begin());
+        return task;
+    }
+
+    void runAll()
+    {
+        for (unsigned i = 0; i < queued.size(); i++)
+        {
+            queued[i]->execute();
+            completed.push_back(queued[i]);
+        }
+        queued.clear();
+    }
+};
+
+}
+
+TEST(Scheduler, Executor)
+{
+    SystemClockMock clock_mock(1000000);
+    CanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+    uavcan::Scheduler& sch = node.getScheduler();
+
+    /*
+     * The default executor runs the task at once, but the completion is deferred until the next spin
+     */
+    CountingTask a;
+    ASSERT_EQ(0, sch.post(a));
+    ASSERT_EQ(1, a.num_executed);
+    ASSERT_EQ(0, a.num_completed);
+    ASSERT_TRUE(a.isPending());
+    ASSERT_EQ(1, sch.getNumPendingTasks());
+
+    ASSERT_LE(0, node.spinOnce());
+    ASSERT_EQ(1, a.num_completed);
+    ASSERT_TRUE(a.executed_when_completed);
+    ASSERT_FALSE(a.isPending());
+    ASSERT_EQ(0, sch.getNumPendingTasks());
+
+    /*
+     * Custom executor
+     */
+    ManualExecutor executor;
+    ASSERT_EQ(0, sch.setExecutor(&executor));
+    ASSERT_EQ(&executor, &sch.getExecutor());
+
+    CountingTask b;
+    ASSERT_EQ(0, sch.post(a));
+    ASSERT_EQ(0, sch.post(b));
+    ASSERT_EQ(2, sch.getNumPendingTasks());
+    ASSERT_EQ(-uavcan::ErrLogic, sch.setExecutor(UAVCAN_NULLPTR));     // Tasks are pending
+
+    ASSERT_LE(0, node.spinOnce());
+    ASSERT_EQ(1, a.num_completed);                                      // Not executed yet
+    ASSERT_EQ(2, sch.getNumPendingTasks());
+
+    // In the event driven mode the scheduler keeps polling the executor while there are pending tasks
+    sch.setEventDriven(true);
+    ASSERT_GE(sch.getMonotonicTime() + sch.getDeadlineResolution(), sch.getNextDeadline());
+
+    executor.runAll();
+    ASSERT_LE(0, node.spin(clock_mock.getMonotonic() + durMono(1000)));
+    ASSERT_EQ(2, a.num_completed);
+    ASSERT_EQ(1, b.num_completed);
+    ASSERT_TRUE(b.executed_when_completed);
+    ASSERT_EQ(0, sch.getNumPendingTasks());
+
+    ASSERT_EQ(0, sch.setExecutor(UAVCAN_NULLPTR));
+    ASSERT_NE(&executor, &sch.getExecutor());
+}
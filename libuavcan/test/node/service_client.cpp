@@ -10,7 +10,9 @@
 #include <uavcan/protocol/GetDataTypeInfo.hpp>
 #include <root_ns_a/StringService.hpp>
 #include <root_ns_a/EmptyService.hpp>
+#include <memory>
 #include <queue>
+#include <vector>
 #include <sstream>
 #include "test_node.hpp"
 
@@ -354,6 +356,144 @@ TEST(ServiceClient, ConcurrentCalls)
 }
 
 
+TEST(ServiceClient, ManyConcurrentCalls)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    uavcan::ServiceServer<root_ns_a::StringService> server(nodes.a);
+    ASSERT_EQ(0, server.start(stringServiceServerCallback));
+
+    typedef uavcan::ServiceCallResult<root_ns_a::StringService> ResultType;
+    typedef uavcan::ServiceClient<root_ns_a::StringService,
+                                  typename ServiceCallResultHandler<root_ns_a::StringService>::Binder > ClientType;
+    ServiceCallResultHandler<root_ns_a::StringService> handler;
+
+    ClientType client(nodes.b, handler.bind());
+
+    /*
+     * Half of the calls are addressed to nonexistent servers, their timeouts decrease with every call,
+     * so that the deadlines are registered in the reverse order
+     */
+    std::vector<uavcan::NodeID> stray_servers;
+    for (unsigned i = 0; i < 60; i++)
+    {
+        std::ostringstream os;
+        os << i;
+        root_ns_a::StringService::Request request;
+        request.string_request = os.str().c_str();
+        ASSERT_LT(0, client.call(1, request));
+
+        client.setRequestTimeout(uavcan::MonotonicDuration::fromMSec(400 - i * 5));
+        const uavcan::NodeID stray_nid(uint8_t(10 + i));
+        ASSERT_LT(0, client.call(stray_nid, request));
+        stray_servers.push_back(stray_nid);
+    }
+    ASSERT_EQ(120, client.getNumPendingCalls());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(50));
+
+    ASSERT_EQ(60, client.getNumPendingCalls());
+    ASSERT_EQ(60, handler.responses.size());
+    for (unsigned i = 0; i < 60; i++)
+    {
+        std::ostringstream os;
+        os << "Request string: " << i;
+        ASSERT_STREQ(os.str().c_str(), handler.responses.front().string_response.c_str());
+        handler.responses.pop();
+    }
+
+    /*
+     * Timeouts must be reported earliest first, i.e. the calls that are still pending are always the first ones
+     */
+    while (client.hasPendingCalls())
+    {
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1));
+        unsigned num_pending = 0;
+        while ((num_pending < stray_servers.size()) && client.hasPendingCallToServer(stray_servers[num_pending]))
+        {
+            num_pending++;
+        }
+        ASSERT_EQ(num_pending, client.getNumPendingCalls());
+    }
+    ASSERT_TRUE(handler.match(ResultType::ErrorTimeout, stray_servers.front(), root_ns_a::StringService::Response()));
+
+    ASSERT_FALSE(client.hasPendingCalls());
+    ASSERT_EQ(0, nodes.b.getDispatcher().getNumServiceResponseListeners());
+}
+
+
+TEST(ServiceClient, AdaptiveTimeout)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    std::unique_ptr<uavcan::ServiceServer<root_ns_a::StringService> > server(
+        new uavcan::ServiceServer<root_ns_a::StringService>(nodes.a));
+    ASSERT_EQ(0, server->start(stringServiceServerCallback));
+
+    typedef uavcan::ServiceCallResult<root_ns_a::StringService> ResultType;
+    typedef uavcan::ServiceClient<root_ns_a::StringService,
+                                  typename ServiceCallResultHandler<root_ns_a::StringService>::Binder > ClientType;
+    ServiceCallResultHandler<root_ns_a::StringService> handler;
+
+    ClientType client(nodes.b, handler.bind());
+    const uavcan::MonotonicDuration limit = client.getRequestTimeout();
+
+    ASSERT_FALSE(client.isAdaptiveRequestTimeoutEnabled());
+    ASSERT_TRUE(client.getSmoothedRtt(1).isZero());
+    ASSERT_EQ(limit, client.getRequestTimeoutFor(1));
+
+    root_ns_a::StringService::Request request;
+    request.string_request = "Hello";
+
+    /*
+     * The round trip times are collected, but not used until enabled
+     */
+    for (int i = 0; i < 3; i++)
+    {
+        ASSERT_LT(0, client.call(1, request));
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(20));
+        ASSERT_FALSE(client.hasPendingCalls());
+        ASSERT_EQ(ResultType::Success, handler.last_status);
+    }
+    ASSERT_FALSE(client.getSmoothedRtt(1).isZero());
+    ASSERT_GT(uavcan::MonotonicDuration::fromMSec(20), client.getSmoothedRtt(1));
+    ASSERT_EQ(limit, client.getRequestTimeoutFor(1));
+
+    client.setAdaptiveRequestTimeout(true);
+    const uavcan::MonotonicDuration timeout = client.getRequestTimeoutFor(1);
+    ASSERT_LE(uavcan::ServiceClient<root_ns_a::StringService>::getMinRequestTimeout(), timeout);
+    ASSERT_GT(uavcan::MonotonicDuration::fromMSec(100), timeout);
+    ASSERT_EQ(limit, client.getRequestTimeoutFor(2));           // No statistics, the configured timeout is used
+
+    /*
+     * A lost call is detected long before the configured timeout, and every timeout doubles the next one
+     */
+    server.reset();
+    ASSERT_LT(0, client.call(1, request));
+    nodes.spinBoth(timeout + uavcan::MonotonicDuration::fromMSec(20));
+    ASSERT_FALSE(client.hasPendingCalls());
+    ASSERT_TRUE(handler.match(ResultType::ErrorTimeout, 1, root_ns_a::StringService::Response()));
+    ASSERT_EQ(timeout * 2, client.getRequestTimeoutFor(1));
+
+    ASSERT_LT(0, client.call(1, request));
+    nodes.spinBoth(timeout * 2 + uavcan::MonotonicDuration::fromMSec(20));
+    ASSERT_FALSE(client.hasPendingCalls());
+    ASSERT_EQ(timeout * 4, client.getRequestTimeoutFor(1));
+
+    // Never longer than the configured timeout
+    client.setRequestTimeout(timeout * 3);
+    ASSERT_EQ(timeout * 3, client.getRequestTimeoutFor(1));
+
+    client.setAdaptiveRequestTimeout(false);
+    ASSERT_EQ(timeout * 3, client.getRequestTimeoutFor(1));
+}
+
 TEST(ServiceClient, Empty)
 {
     InterlinkedTestNodesWithSysClock nodes;
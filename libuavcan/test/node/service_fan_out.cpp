@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <uavcan/node/service_fan_out.hpp>
+#include <uavcan/node/service_server.hpp>
+#include <root_ns_a/StringService.hpp>
+#include "test_node.hpp"
+
+
+static void stringServiceServerCallback(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>& req,
+                                        uavcan::ServiceResponseDataStructure<root_ns_a::StringService::Response>& rsp)
+{
+    rsp.string_response = "Request string: ";
+    rsp.string_response += req.string_request;
+}
+
+struct FanOutResultRecorder
+{
+    std::vector<uavcan::NodeID> successful;
+    std::vector<uavcan::NodeID> failed;
+    std::vector<std::string> responses;
+
+    void handleResult(const uavcan::ServiceCallResult<root_ns_a::StringService>& result)
+    {
+        if (result.isSuccessful())
+        {
+            successful.push_back(result.getCallID().server_node_id);
+            responses.push_back(result.getResponse().string_response.c_str());
+        }
+        else
+        {
+            failed.push_back(result.getCallID().server_node_id);
+        }
+    }
+
+    typedef uavcan::MethodBinder<FanOutResultRecorder*,
+        void (FanOutResultRecorder::*)(const uavcan::ServiceCallResult<root_ns_a::StringService>&)> Binder;
+
+    Binder bind() { return Binder(this, &FanOutResultRecorder::handleResult); }
+};
+
+
+TEST(ServiceFanOut, Basic)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    uavcan::ServiceServer<root_ns_a::StringService> server(nodes.a);
+    ASSERT_EQ(0, server.start(stringServiceServerCallback));
+
+    typedef uavcan::ServiceFanOut<root_ns_a::StringService, FanOutResultRecorder::Binder> FanOutType;
+
+    FanOutResultRecorder recorder;
+    FanOutType fan_out(nodes.b, recorder.bind());
+    ASSERT_EQ(0, fan_out.init());
+    fan_out.getServiceClient().setRequestTimeout(uavcan::MonotonicDuration::fromMSec(100));
+
+    ASSERT_TRUE(fan_out.isFinished());
+
+    /*
+     * One real server, three that don't exist, and the local node, which cannot be called
+     */
+    uavcan::NodeIDSet servers;
+    servers.add(1);
+    servers.add(2);
+    servers.add(50);
+    servers.add(51);
+    servers.add(52);
+
+    root_ns_a::StringService::Request request;
+    request.string_request = "Hello";
+
+    ASSERT_EQ(2, fan_out.start(servers, request, 2));                   // Window of two
+
+    ASSERT_FALSE(fan_out.isFinished());
+    ASSERT_EQ(FanOutType::Pending, fan_out.getNodeStatus(1));
+    ASSERT_EQ(FanOutType::ErrorSend, fan_out.getNodeStatus(2));
+    ASSERT_EQ(FanOutType::Pending, fan_out.getNodeStatus(50));
+    ASSERT_EQ(FanOutType::Queued, fan_out.getNodeStatus(51));
+    ASSERT_EQ(FanOutType::Queued, fan_out.getNodeStatus(52));
+    ASSERT_EQ(FanOutType::NotRequested, fan_out.getNodeStatus(3));
+    ASSERT_EQ(2, fan_out.getServiceClient().getNumPendingCalls());
+
+    /*
+     * The response from the real server frees a slot for the next one
+     */
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(20));
+
+    ASSERT_EQ(FanOutType::Success, fan_out.getNodeStatus(1));
+    ASSERT_EQ(FanOutType::Pending, fan_out.getNodeStatus(50));
+    ASSERT_EQ(FanOutType::Pending, fan_out.getNodeStatus(51));
+    ASSERT_EQ(FanOutType::Queued, fan_out.getNodeStatus(52));
+    ASSERT_EQ(1, recorder.successful.size());
+    ASSERT_EQ("Request string: Hello", recorder.responses.at(0));
+
+    /*
+     * The stray calls time out one after another
+     */
+    while (!fan_out.isFinished())
+    {
+        ASSERT_GE(2, fan_out.getServiceClient().getNumPendingCalls());
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    }
+
+    ASSERT_EQ(3, recorder.failed.size());
+    ASSERT_EQ(uavcan::NodeID(50), recorder.failed.at(0));
+    ASSERT_EQ(uavcan::NodeID(52), recorder.failed.at(2));
+    ASSERT_EQ(FanOutType::ErrorTimeout, fan_out.getNodeStatus(52));
+
+    ASSERT_EQ(1, fan_out.getSucceededNodes().getSize());
+    ASSERT_EQ(3, fan_out.getTimedOutNodes().getSize());
+    ASSERT_EQ(1, fan_out.getSendFailedNodes().getSize());
+    ASSERT_FALSE(fan_out.getServiceClient().hasPendingCalls());
+    ASSERT_EQ(0, nodes.b.getDispatcher().getNumServiceResponseListeners());
+
+    /*
+     * Unlimited window; cancellation resets the remaining servers
+     */
+    ASSERT_EQ(4, fan_out.start(servers, request));
+    ASSERT_EQ(0, fan_out.getSucceededNodes().getSize());
+    ASSERT_EQ(4, fan_out.getServiceClient().getNumPendingCalls());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(20));
+    ASSERT_EQ(2, recorder.successful.size());
+    ASSERT_EQ(3, fan_out.getServiceClient().getNumPendingCalls());
+
+    fan_out.cancel();
+    ASSERT_TRUE(fan_out.isFinished());
+    ASSERT_EQ(FanOutType::Success, fan_out.getNodeStatus(1));
+    ASSERT_EQ(FanOutType::NotRequested, fan_out.getNodeStatus(50));
+    ASSERT_FALSE(fan_out.getServiceClient().hasPendingCalls());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(200));
+    ASSERT_EQ(3, recorder.failed.size());                               // No timeouts after cancellation
+}
@@ -3,8 +3,10 @@
  */
 
 #include <gtest/gtest.h>
+#include <vector>
 #include <uavcan/node/service_server.hpp>
 #include <uavcan/util/method_binder.hpp>
+#include <uavcan/helpers/heap_based_pool_allocator.hpp>
 #include <root_ns_a/StringService.hpp>
 #include <root_ns_a/EmptyService.hpp>
 #include "../clock.hpp"
@@ -154,3 +156,248 @@ TEST(ServiceServer, Empty)
     ASSERT_GE(0, server.start(impl.bind()));
     ASSERT_EQ(1, node.getDispatcher().getNumServiceRequestListeners());
 }
+
+
+struct CountingStringServerImpl : public StringServerImpl
+{
+    unsigned num_calls;
+
+    CountingStringServerImpl() : StringServerImpl("456"), num_calls(0) { }
+
+    void handleRequest(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>& request,
+                       root_ns_a::StringService::Response& response)
+    {
+        num_calls++;
+        StringServerImpl::handleRequest(request, response);
+    }
+
+    typedef uavcan::MethodBinder<CountingStringServerImpl*,
+        void (CountingStringServerImpl::*)(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>&,
+                                           root_ns_a::StringService::Response&)> Binder;
+
+    Binder bind() { return Binder(this, &CountingStringServerImpl::handleRequest); }
+};
+
+
+TEST(ServiceServer, ResponseCache)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(1, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    typedef uavcan::ServiceServer<root_ns_a::StringService, CountingStringServerImpl::Binder> ServerType;
+
+    uavcan::HeapBasedPoolAllocator<ServerType::ResponseCacheEntrySize> cache_pool(2, 2);
+    CountingStringServerImpl impl;
+
+    const auto request = [&](uint8_t src_node_id, uint8_t tid, char suffix)
+    {
+        uavcan::Frame frame(root_ns_a::StringService::DefaultDataTypeID, uavcan::TransferTypeServiceRequest,
+                            uavcan::NodeID(src_node_id), 1, tid);
+        const uint8_t req[] = {'r', 'e', 'q', uint8_t(suffix)};
+        frame.setPayload(req, sizeof(req));
+        frame.setStartOfTransfer(true);
+        frame.setEndOfTransfer(true);
+        can_driver.ifaces[0].pushRx(uavcan::RxFrame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0));
+        node.spin(clock_driver.getMonotonic() + uavcan::MonotonicDuration::fromUSec(1000));
+    };
+
+    // Checks the destination and the transfer ID of the response, returns the payload of its first frame
+    const auto pop_response = [&](uint8_t dst_node_id, uint8_t tid)
+    {
+        uavcan::Frame fr;
+        EXPECT_EQ(2, can_driver.ifaces[0].tx.size());
+        EXPECT_TRUE(fr.parse(can_driver.ifaces[0].popTxFrame()));
+        EXPECT_EQ(dst_node_id, fr.getDstNodeID().get());
+        EXPECT_EQ(tid, fr.getTransferID().get());
+        const std::string first(reinterpret_cast<const char*>(fr.getPayloadPtr() + 2), 5);
+        EXPECT_TRUE(fr.parse(can_driver.ifaces[0].popTxFrame()));
+        EXPECT_EQ(tid, fr.getTransferID().get());
+        return first;
+    };
+
+    {
+        ServerType server(node);
+        ASSERT_LE(0, server.start(impl.bind()));
+
+        ASSERT_FALSE(server.isResponseCacheEnabled());
+        ASSERT_EQ(-uavcan::ErrInvalidParam, server.enableResponseCache(cache_pool, 0, durMono(1000000)));
+        ASSERT_EQ(-uavcan::ErrInvalidParam, server.enableResponseCache(cache_pool, 3, durMono(0)));
+        ASSERT_EQ(0, server.enableResponseCache(cache_pool, 3, durMono(1000000)));
+        ASSERT_TRUE(server.isResponseCacheEnabled());
+
+        // The first request is served by the callback, the same one from another node is served from the cache
+        request(0x10, 0, 'a');
+        ASSERT_EQ("reqa ", pop_response(0x10, 0));
+        request(0x11, 5, 'a');
+        ASSERT_EQ("reqa ", pop_response(0x11, 5));
+        ASSERT_EQ(1, impl.num_calls);
+        ASSERT_EQ(1, server.getResponseCacheHitCount());
+        ASSERT_EQ(1, server.getResponseCacheSize());
+
+        // Different request
+        request(0x12, 1, 'b');
+        ASSERT_EQ("reqb ", pop_response(0x12, 1));
+        ASSERT_EQ(2, impl.num_calls);
+        ASSERT_EQ(2, server.getResponseCacheSize());
+
+        // The pool has space for two entries only, so the least recently used one makes room for the new one
+        request(0x13, 2, 'a');
+        ASSERT_EQ("reqa ", pop_response(0x13, 2));
+        request(0x14, 3, 'c');
+        ASSERT_EQ("reqc ", pop_response(0x14, 3));
+        ASSERT_EQ(3, impl.num_calls);
+        ASSERT_EQ(2, server.getResponseCacheSize());
+        ASSERT_EQ(2, cache_pool.getNumAllocatedBlocks());
+        request(0x15, 4, 'a');
+        ASSERT_EQ("reqa ", pop_response(0x15, 4));
+        ASSERT_EQ(3, impl.num_calls);
+        request(0x15, 5, 'b');
+        ASSERT_EQ("reqb ", pop_response(0x15, 5));
+        ASSERT_EQ(4, impl.num_calls);
+
+        // Expiration
+        ASSERT_EQ(0, server.enableResponseCache(cache_pool, 3, durMono(10000)));
+        ASSERT_EQ(0, cache_pool.getNumAllocatedBlocks());
+        request(0x10, 6, 'a');
+        ASSERT_EQ("reqa ", pop_response(0x10, 6));
+        ASSERT_EQ(5, impl.num_calls);
+        node.spin(uavcan::MonotonicDuration::fromMSec(20));
+        request(0x11, 7, 'a');
+        ASSERT_EQ("reqa ", pop_response(0x11, 7));
+        ASSERT_EQ(6, impl.num_calls);
+        ASSERT_EQ(1, server.getResponseCacheSize());
+
+        // Invalidation
+        server.invalidateResponseCache();
+        ASSERT_EQ(0, server.getResponseCacheSize());
+        request(0x12, 8, 'a');
+        ASSERT_EQ("reqa ", pop_response(0x12, 8));
+        ASSERT_EQ(7, impl.num_calls);
+        ASSERT_EQ(0, server.getResponseFailureCount());
+        ASSERT_EQ(1, cache_pool.getNumAllocatedBlocks());
+    }
+    ASSERT_EQ(0, cache_pool.getNumAllocatedBlocks());
+}
+
+
+struct DeferringStringServerImpl
+{
+    typedef uavcan::ServiceServer<root_ns_a::StringService,
+        uavcan::MethodBinder<DeferringStringServerImpl*,
+            void (DeferringStringServerImpl::*)(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>&,
+                                                root_ns_a::StringService::Response&)> > ServerType;
+
+    ServerType* server;
+    std::vector<uavcan::ServiceResponseToken> tokens;
+
+    DeferringStringServerImpl() : server(UAVCAN_NULLPTR) { }
+
+    void handleRequest(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>& request,
+                       root_ns_a::StringService::Response& response)
+    {
+        const uavcan::ServiceResponseToken token = server->deferResponse(request);
+        if (token.isValid())
+        {
+            tokens.push_back(token);
+        }
+        else
+        {
+            response.string_response = "sync";
+        }
+    }
+
+    ServerType::Callback bind() { return ServerType::Callback(this, &DeferringStringServerImpl::handleRequest); }
+};
+
+
+TEST(ServiceServer, DeferredResponse)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(1, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    DeferringStringServerImpl impl;
+    unsigned blocks_before = 0;
+
+    const auto request = [&](uint8_t src_node_id, uint8_t tid)
+    {
+        uavcan::Frame frame(root_ns_a::StringService::DefaultDataTypeID, uavcan::TransferTypeServiceRequest,
+                            uavcan::NodeID(src_node_id), 1, tid);
+        const uint8_t req[] = {'r', 'e', 'q'};
+        frame.setPayload(req, sizeof(req));
+        frame.setStartOfTransfer(true);
+        frame.setEndOfTransfer(true);
+        frame.setPriority(tid);
+        can_driver.ifaces[0].pushRx(uavcan::RxFrame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0));
+        node.spin(clock_driver.getMonotonic() + uavcan::MonotonicDuration::fromUSec(1000));
+    };
+
+    {
+        DeferringStringServerImpl::ServerType server(node);
+        impl.server = &server;
+        ASSERT_LE(0, server.start(impl.bind()));
+        server.setMaxDeferredResponses(2);
+
+        ASSERT_EQ(2, server.getMaxDeferredResponses());
+        ASSERT_EQ(uavcan::MonotonicDuration::fromMSec(1000), server.getDeferredResponseTimeout());
+
+        // Two requests are deferred, the third one doesn't fit and is served synchronously
+        request(0x10, 3);
+        request(0x11, 4);
+        ASSERT_EQ(0, can_driver.ifaces[0].tx.size());
+        ASSERT_EQ(2, impl.tokens.size());
+        ASSERT_NE(impl.tokens.at(0), impl.tokens.at(1));
+        ASSERT_EQ(2, server.getNumDeferredResponses());
+
+        request(0x12, 5);
+        uavcan::Frame fr;
+        ASSERT_EQ(1, can_driver.ifaces[0].tx.size());
+        ASSERT_TRUE(fr.parse(can_driver.ifaces[0].popTxFrame()));
+        ASSERT_EQ(0x12, fr.getDstNodeID().get());
+        ASSERT_EQ(0, std::strncmp("sync", reinterpret_cast<const char*>(fr.getPayloadPtr()), 4));
+
+        // Completion in reverse order
+        root_ns_a::StringService::Response response;
+        response.string_response = "late";
+        ASSERT_LE(0, server.sendDeferredResponse(impl.tokens.at(1), response));
+        ASSERT_EQ(-uavcan::ErrInvalidParam, server.sendDeferredResponse(impl.tokens.at(1), response));
+        ASSERT_EQ(1, can_driver.ifaces[0].tx.size());
+        ASSERT_TRUE(fr.parse(can_driver.ifaces[0].popTxFrame()));
+        ASSERT_EQ(0x11, fr.getDstNodeID().get());
+        ASSERT_EQ(4, fr.getTransferID().get());
+        ASSERT_EQ(4, fr.getPriority().get());
+        ASSERT_EQ(uavcan::TransferTypeServiceResponse, fr.getTransferType());
+        ASSERT_EQ(0, std::strncmp("late", reinterpret_cast<const char*>(fr.getPayloadPtr()), 4));
+
+        ASSERT_TRUE(server.cancelDeferredResponse(impl.tokens.at(0)));
+        ASSERT_FALSE(server.cancelDeferredResponse(impl.tokens.at(0)));
+        ASSERT_EQ(0, server.getNumDeferredResponses());
+        ASSERT_EQ(0, can_driver.ifaces[0].tx.size());
+
+        // Expiration
+        impl.tokens.clear();
+        server.setDeferredResponseTimeout(uavcan::MonotonicDuration::fromMSec(10));
+        request(0x13, 6);
+        ASSERT_EQ(1, impl.tokens.size());
+        ASSERT_EQ(1, server.getNumDeferredResponses());
+        node.spin(uavcan::MonotonicDuration::fromMSec(20));
+        ASSERT_EQ(-uavcan::ErrInvalidParam, server.sendDeferredResponse(impl.tokens.at(0), response));
+        ASSERT_EQ(0, server.getNumDeferredResponses());
+        ASSERT_EQ(1, server.getNumExpiredDeferredResponses());
+        ASSERT_EQ(0, server.getResponseFailureCount());
+
+        // Pending requests are released with the server
+        blocks_before = node.pool.getNumAllocatedBlocks();
+        request(0x14, 7);
+        ASSERT_EQ(1, server.getNumDeferredResponses());
+        ASSERT_LT(blocks_before, node.pool.getNumAllocatedBlocks());
+    }
+    ASSERT_GE(blocks_before, node.pool.getNumAllocatedBlocks());
+}
@@ -2,6 +2,8 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <functional>
+#include <memory>
 #include <gtest/gtest.h>
 #include <uavcan/node/subscriber.hpp>
 #include <uavcan/util/method_binder.hpp>
@@ -280,3 +282,232 @@ TEST(Subscriber, SingleFrameTransfer)
         ASSERT_TRUE(listener.simple.at(i) == root_ns_a::EmptyMessage());
     }
 }
+
+
+struct ArenaCheckingSink
+{
+    const uavcan::BumpArena* arena;
+    unsigned num_calls;
+    unsigned num_in_arena;
+
+    explicit ArenaCheckingSink(const uavcan::BumpArena* arg_arena)
+        : arena(arg_arena)
+        , num_calls(0)
+        , num_in_arena(0)
+    { }
+
+    void operator()(const uavcan::ReceivedDataStructure<root_ns_a::EmptyMessage>& msg)
+    {
+        num_calls++;
+        if (arena->getUsedSize() >= sizeof(msg))
+        {
+            num_in_arena++;
+        }
+        ASSERT_EQ(100, msg.getSrcNodeID().get());
+    }
+};
+
+TEST(Subscriber, DecodeArena)
+{
+    // Manual type registration - we can't rely on the GDTR state
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::EmptyMessage> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(2, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    uavcan::StaticBumpArena<256> arena;
+    uavcan::StaticBumpArena<0> empty_arena;
+    ASSERT_FALSE(node.getDecodeArena());
+
+    ArenaCheckingSink sink(&arena);
+    uavcan::Subscriber<root_ns_a::EmptyMessage> sub(node);
+    ASSERT_LE(0, sub.start(std::ref(sink)));
+
+    uavcan::TransferID tid;
+    const auto publish = [&]()
+    {
+        uavcan::Frame frame(root_ns_a::EmptyMessage::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                            uavcan::NodeID(100), uavcan::NodeID::Broadcast, tid);
+        tid.increment();
+        frame.setStartOfTransfer(true);
+        frame.setEndOfTransfer(true);
+        uavcan::RxFrame rx_frame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0);
+        can_driver.ifaces[0].pushRx(rx_frame);
+        ASSERT_LE(0, node.spin(clock_driver.getMonotonic() + durMono(1000)));
+    };
+
+    // No arena - the stack is used
+    publish();
+    ASSERT_EQ(1, sink.num_calls);
+    ASSERT_EQ(0, sink.num_in_arena);
+
+    // The structure is placed into the arena, the arena is rolled back after the callback
+    node.setDecodeArena(&arena);
+    publish();
+    publish();
+    ASSERT_EQ(3, sink.num_calls);
+    ASSERT_EQ(2, sink.num_in_arena);
+    ASSERT_EQ(0, arena.getUsedSize());
+    ASSERT_LE(sizeof(uavcan::ReceivedDataStructure<root_ns_a::EmptyMessage>), arena.getPeakUsedSize());
+    ASSERT_EQ(0, arena.getNumFailedAllocations());
+
+    // Not enough space - falls back to the stack
+    node.setDecodeArena(&empty_arena);
+    publish();
+    ASSERT_EQ(4, sink.num_calls);
+    ASSERT_EQ(2, sink.num_in_arena);
+    ASSERT_EQ(1, empty_arena.getNumFailedAllocations());
+
+    node.setDecodeArena(UAVCAN_NULLPTR);
+    ASSERT_EQ(0, sub.getFailureCount());
+}
+
+
+struct SharedSink
+{
+    std::vector<uavcan::NodeID> sources;
+    uavcan::Subscriber<root_ns_a::MavlinkMessage>* sub_to_stop;
+    std::unique_ptr<uavcan::Subscriber<root_ns_a::MavlinkMessage> >* sub_to_destroy;
+
+    SharedSink()
+        : sub_to_stop(UAVCAN_NULLPTR)
+        , sub_to_destroy(UAVCAN_NULLPTR)
+    { }
+
+    void operator()(const uavcan::ReceivedDataStructure<root_ns_a::MavlinkMessage>& msg)
+    {
+        ASSERT_EQ(0x42, msg.seq);
+        ASSERT_EQ(3, msg.payload.size());
+        sources.push_back(msg.getSrcNodeID());
+        if (sub_to_stop != UAVCAN_NULLPTR)
+        {
+            sub_to_stop->stop();
+            sub_to_stop = UAVCAN_NULLPTR;
+        }
+        if (sub_to_destroy != UAVCAN_NULLPTR)
+        {
+            sub_to_destroy->reset();
+            sub_to_destroy = UAVCAN_NULLPTR;
+        }
+    }
+};
+
+TEST(Subscriber, Shared)
+{
+    // Manual type registration - we can't rely on the GDTR state
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(2, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    typedef uavcan::Subscriber<root_ns_a::MavlinkMessage> Sub;
+    SharedSink sinks[4];
+    Sub sub_a(node);
+    Sub sub_b(node);
+    Sub sub_c(node);
+    Sub sub_regular(node);
+
+    uavcan::TransferID tid;
+    const auto publish = [&](uavcan::uint8_t src_node_id)
+    {
+        const uint8_t payload[] = {0x42, 0x72, 0x08, 0xa5, 'M', 's', 'g'};
+        uavcan::Frame frame(root_ns_a::MavlinkMessage::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                            uavcan::NodeID(src_node_id), uavcan::NodeID::Broadcast, tid);
+        tid.increment();
+        frame.setStartOfTransfer(true);
+        frame.setEndOfTransfer(true);
+        frame.setPayload(payload, sizeof(payload));
+        uavcan::RxFrame rx_frame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0);
+        can_driver.ifaces[0].pushRx(rx_frame);
+        ASSERT_LE(0, node.spin(clock_driver.getMonotonic() + durMono(1000)));
+    };
+
+    /*
+     * The shared subscribers use one listener
+     */
+    ASSERT_LE(0, sub_a.startShared(std::ref(sinks[0])));
+    ASSERT_LE(0, sub_b.startShared(std::ref(sinks[1])));
+    ASSERT_LE(0, sub_c.startShared(std::ref(sinks[2])));
+    ASSERT_EQ(1, node.getDispatcher().getNumMessageListeners());
+    ASSERT_LE(0, sub_regular.start(std::ref(sinks[3])));
+    ASSERT_EQ(2, node.getDispatcher().getNumMessageListeners());
+
+    publish(10);
+    for (unsigned i = 0; i < 4; i++)
+    {
+        ASSERT_EQ(1, sinks[i].sources.size());
+        ASSERT_EQ(10, sinks[i].sources.at(0).get());
+    }
+
+    /*
+     * A follower stops another follower from its callback
+     */
+    sinks[0].sub_to_stop = &sub_c;
+    publish(11);
+    ASSERT_EQ(2, sinks[0].sources.size());
+    ASSERT_EQ(2, sinks[1].sources.size());
+    ASSERT_EQ(1, sinks[2].sources.size());      // The followers are served in the reverse order of joining
+    ASSERT_EQ(2, node.getDispatcher().getNumMessageListeners());
+
+    /*
+     * The leader stops itself from its callback, the group is taken over by the follower
+     */
+    ASSERT_LE(0, sub_c.startShared(std::ref(sinks[2])));
+    sinks[0].sub_to_stop = &sub_a;
+    publish(12);
+    ASSERT_EQ(3, sinks[0].sources.size());
+    ASSERT_EQ(3, sinks[1].sources.size());
+    ASSERT_EQ(2, sinks[2].sources.size());
+    ASSERT_EQ(2, node.getDispatcher().getNumMessageListeners());
+
+    publish(13);
+    ASSERT_EQ(3, sinks[0].sources.size());
+    ASSERT_EQ(4, sinks[1].sources.size());
+    ASSERT_EQ(13, sinks[1].sources.back().get());
+    ASSERT_EQ(13, sinks[2].sources.back().get());
+    ASSERT_EQ(13, sinks[3].sources.back().get());
+
+    /*
+     * Subscribers are destroyed from the callbacks: a follower by the leader, then the leader by itself
+     */
+    std::unique_ptr<Sub> sub_d(new Sub(node));
+    ASSERT_LE(0, sub_d->startShared(std::ref(sinks[0])));
+    sinks[2].sub_to_destroy = &sub_d;           // sub_c is the leader now
+    publish(14);
+    ASSERT_FALSE(sub_d);
+    ASSERT_EQ(3, sinks[0].sources.size());
+    ASSERT_EQ(14, sinks[1].sources.back().get());
+    ASSERT_EQ(14, sinks[2].sources.back().get());
+
+    sub_b.stop();
+    sub_c.stop();
+    ASSERT_EQ(1, node.getDispatcher().getNumMessageListeners());
+    sub_d.reset(new Sub(node));
+    ASSERT_LE(0, sub_d->startShared(std::ref(sinks[0])));
+    ASSERT_LE(0, sub_b.startShared(std::ref(sinks[1])));
+    sinks[0].sub_to_destroy = &sub_d;
+    publish(15);
+    ASSERT_FALSE(sub_d);
+    ASSERT_EQ(15, sinks[0].sources.back().get());
+    ASSERT_EQ(15, sinks[1].sources.back().get());
+    ASSERT_EQ(2, node.getDispatcher().getNumMessageListeners());
+
+    publish(16);
+    ASSERT_EQ(4, sinks[0].sources.size());
+    ASSERT_EQ(16, sinks[1].sources.back().get());
+
+    /*
+     * Leaving the group
+     */
+    sub_b.stop();
+    ASSERT_EQ(1, node.getDispatcher().getNumMessageListeners());
+    sub_regular.stop();
+    ASSERT_EQ(0, node.getDispatcher().getNumMessageListeners());
+
+    ASSERT_EQ(0, sub_a.getFailureCount());
+    ASSERT_EQ(0, sub_b.getFailureCount());
+}
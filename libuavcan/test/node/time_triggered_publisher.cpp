@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/node/time_triggered_publisher.hpp>
+#include <root_ns_a/MavlinkMessage.hpp>
+#include "../clock.hpp"
+#include "../transport/can/can.hpp"
+#include "test_node.hpp"
+
+
+TEST(TimeTriggeredPublisher, Basic)
+{
+    SystemClockMock clock_mock(1000000);
+    CanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+    node.getScheduler().setEventDriven(true);           // The clock mock jumps straight to the deadlines
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    uavcan::TimeTriggeredPublisher<root_ns_a::MavlinkMessage> pub(node);
+
+    /*
+     * Invalid schedules
+     */
+    ASSERT_EQ(-uavcan::ErrInvalidParam, pub.start(durMono(0), durMono(0), durMono(1000)));
+    ASSERT_EQ(-uavcan::ErrInvalidParam, pub.start(durMono(10000), durMono(10000), durMono(1000)));
+    ASSERT_EQ(-uavcan::ErrInvalidParam, pub.start(durMono(10000), durMono(-1), durMono(1000)));
+    ASSERT_EQ(-uavcan::ErrInvalidParam, pub.start(durMono(10000), durMono(2500), durMono(0)));
+    ASSERT_EQ(-uavcan::ErrInvalidParam, pub.start(durMono(10000), durMono(2500), durMono(10001)));
+    ASSERT_FALSE(pub.isRunning());
+
+    /*
+     * Slots at 2.5 ms past every 10 ms of the monotonic time
+     */
+    ASSERT_EQ(0, pub.start(durMono(10000), durMono(2500), durMono(1000)));
+    ASSERT_TRUE(pub.isRunning());
+    ASSERT_EQ(uavcan::MonotonicTime::fromUSec(1002500), pub.getNextSlotStart());
+    ASSERT_EQ(durMono(1000), pub.getPublisher().getTxTimeout());
+
+    // Nothing is published until the message is set
+    ASSERT_EQ(0, node.spin(uavcan::MonotonicTime::fromUSec(1010000)));
+    ASSERT_TRUE(can_driver.ifaces[0].tx.empty());
+    ASSERT_EQ(0, pub.getNumReleasedSlots());
+    ASSERT_EQ(0, pub.getNumMissedSlots());
+
+    root_ns_a::MavlinkMessage msg;
+    msg.seq = 0x42;
+    msg.payload = "Msg";
+    ASSERT_LE(0, pub.setMessage(msg));
+
+    ASSERT_EQ(0, node.spin(uavcan::MonotonicTime::fromUSec(1100000)));
+    ASSERT_EQ(9, can_driver.ifaces[0].tx.size());          // 1012500 ... 1092500
+    ASSERT_EQ(9, pub.getNumReleasedSlots());
+    ASSERT_EQ(0, pub.getNumMissedSlots());
+    ASSERT_EQ(durMono(0), pub.getMaxReleaseDelay());
+    ASSERT_EQ(uavcan::MonotonicTime::fromUSec(1102500), pub.getNextSlotStart());
+
+    /*
+     * The scheduler is late by a fraction of the slot - the message is still released, the schedule is kept
+     */
+    clock_mock.advance(2500 + 300);
+    ASSERT_LE(0, node.spinOnce());
+    ASSERT_EQ(10, pub.getNumReleasedSlots());
+    ASSERT_EQ(durMono(300), pub.getMaxReleaseDelay());
+    ASSERT_EQ(uavcan::MonotonicTime::fromUSec(1112500), pub.getNextSlotStart());
+
+    /*
+     * The scheduler is blocked from the slot at 1112500 until 1141500 - three slots are lost
+     */
+    clock_mock.advance(38700);
+    ASSERT_LE(0, node.spinOnce());
+    ASSERT_EQ(10, pub.getNumReleasedSlots());
+    ASSERT_EQ(3, pub.getNumMissedSlots());
+    ASSERT_EQ(uavcan::MonotonicTime::fromUSec(1142500), pub.getNextSlotStart());
+
+    /*
+     * Stop
+     */
+    pub.stop();
+    ASSERT_FALSE(pub.isRunning());
+    const unsigned num_frames = unsigned(can_driver.ifaces[0].tx.size());
+    ASSERT_EQ(0, node.spin(durMono(100000)));
+    ASSERT_EQ(num_frames, can_driver.ifaces[0].tx.size());
+    ASSERT_EQ(10, pub.getNumReleasedSlots());
+}
+
+
+TEST(TimeTriggeredPublisher, UtcAlignment)
+{
+    SystemClockMock clock_mock(1000000);
+    clock_mock.utc = 5000000000ULL + 4000;              // UTC is 4 ms into the cycle while the monotonic time is not
+    CanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+    node.getScheduler().setEventDriven(true);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    uavcan::TimeTriggeredPublisher<root_ns_a::MavlinkMessage> pub(node);
+    ASSERT_FALSE(pub.isUtcAligned());
+    ASSERT_EQ(0, pub.start(durMono(10000), durMono(2500), durMono(1000)));
+    ASSERT_EQ(uavcan::MonotonicTime::fromUSec(1002500), pub.getNextSlotStart());
+
+    // The slot moves to 2.5 ms past the UTC cycle, i.e. 8.5 ms from now
+    pub.setUtcAlignment(true);
+    ASSERT_TRUE(pub.isUtcAligned());
+    ASSERT_EQ(uavcan::MonotonicTime::fromUSec(1008500), pub.getNextSlotStart());
+
+    root_ns_a::MavlinkMessage msg;
+    ASSERT_LE(0, pub.setMessage(msg));
+    ASSERT_EQ(0, node.spin(uavcan::MonotonicTime::fromUSec(1050000)));
+    ASSERT_EQ(5, can_driver.ifaces[0].tx.size());
+    ASSERT_EQ(uavcan::MonotonicTime::fromUSec(1058500), pub.getNextSlotStart());
+
+    // The UTC clock is adjusted by a small amount - the schedule follows, no slots are skipped or repeated
+    clock_mock.utc += 1000;
+    ASSERT_EQ(0, node.spin(uavcan::MonotonicTime::fromUSec(1070000)));
+    ASSERT_EQ(7, can_driver.ifaces[0].tx.size());
+    ASSERT_EQ(uavcan::MonotonicTime::fromUSec(1067500), pub.getNextSlotStart() - durMono(10000));
+    ASSERT_EQ(0, pub.getNumMissedSlots());
+
+    // Unknown UTC - falling back to the monotonic time
+    clock_mock.utc = 0;
+    clock_mock.preserve_utc = true;
+    pub.setUtcAlignment(true);
+    ASSERT_EQ(uavcan::MonotonicTime::fromUSec(1072500), pub.getNextSlotStart());
+}
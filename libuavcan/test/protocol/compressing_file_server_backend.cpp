@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <cstdlib>
+#include <uavcan/protocol/compressing_file_server_backend.hpp>
+#include <uavcan/protocol/file_downloader.hpp>
+#include "helpers.hpp"
+
+
+class CompressionTestFileServerBackend : public uavcan::IFileServerBackend
+{
+public:
+    std::string file_data;
+    unsigned num_reads;
+
+    explicit CompressionTestFileServerBackend(unsigned size)
+        : num_reads(0)
+    {
+        for (unsigned i = 0; i < size; i++)
+        {
+            const unsigned word = i / 4;
+            static const uint8_t Pattern[] = { 0x00, 0xBF, 0x08, 0x46 };     // Looks like machine code
+            file_data.push_back(((word % 7) == 0) ? char(std::rand()) : char(Pattern[i % 4] + (word % 3)));
+        }
+    }
+
+    virtual int16_t getInfo(const Path& path, uint64_t& out_size, EntryType& out_type)
+    {
+        if (path != "fw")
+        {
+            return Error::NOT_FOUND;
+        }
+        out_size = file_data.length();
+        out_type.flags = EntryType::FLAG_FILE | EntryType::FLAG_READABLE;
+        return 0;
+    }
+
+    virtual int16_t read(const Path& path, const uint64_t offset, uint8_t* out_buffer, uint16_t& inout_size)
+    {
+        num_reads++;
+        if (path != "fw")
+        {
+            return Error::NOT_FOUND;
+        }
+        const uint64_t len = (offset < file_data.length()) ? std::min<uint64_t>(file_data.length() - offset,
+                                                                                 inout_size) : 0;
+        std::memcpy(out_buffer, file_data.c_str() + offset, std::size_t(len));
+        inout_size = uint16_t(len);
+        return 0;
+    }
+
+    virtual int16_t write(const Path&, const uint64_t, const uint8_t*, const uint16_t)
+    {
+        file_data[0] = 'X';
+        return 0;
+    }
+};
+
+
+struct CompressionTestCollector : public uavcan::IFileDownloadSink
+{
+    std::string data;
+    int result;
+    unsigned num_completions;
+
+    CompressionTestCollector()
+        : result(1000)
+        , num_completions(0)
+    { }
+
+    virtual void handleFileData(uint64_t offset, const uint8_t* bytes, uint16_t size)
+    {
+        EXPECT_EQ(data.size(), offset);
+        data.append(reinterpret_cast<const char*>(bytes), size);
+    }
+
+    virtual void handleFileDownloadCompletion(int error)
+    {
+        result = error;
+        num_completions++;
+    }
+};
+
+
+TEST(CompressingFileServerBackend, Basic)
+{
+    std::srand(42);
+    CompressionTestFileServerBackend backend(3000);
+    uavcan::CompressingFileServerBackend<4> compressing(backend);
+
+    const auto read = [&](const char* path, uint64_t offset, uint16_t size, std::string& out)
+    {
+        uint8_t buffer[256];
+        const int16_t res = compressing.read(path, offset, buffer, size);
+        out.assign(reinterpret_cast<const char*>(buffer), size);
+        return res;
+    };
+
+    std::string out;
+
+    // Plain files are passed through
+    ASSERT_EQ(0, read("fw", 10, 100, out));
+    ASSERT_TRUE(backend.file_data.substr(10, 100) == out);
+    ASSERT_EQ(0, compressing.getNumBlocksCompressed());
+
+    // The size of the compressed file
+    uint64_t size = 0;
+    uavcan::protocol::file::EntryType type;
+    ASSERT_EQ(0, compressing.getInfo("fw.blz", size, type));
+    ASSERT_EQ(3, compressing.getNumBlocksCompressed());
+    ASSERT_LT(0, size);
+    ASSERT_GT(2000, size);
+    ASSERT_EQ(uavcan::protocol::file::Error::NOT_FOUND, compressing.getInfo("nonexistent.blz", size, type));
+    ASSERT_EQ(0, compressing.getInfo("fw.blz", size, type));
+
+    // The index is kept, the last compressed block is reused
+    std::string compressed;
+    uint64_t offset = 0;
+    do
+    {
+        ASSERT_EQ(0, read("fw.blz", offset, 256, out));
+        compressed += out;
+        offset += out.size();
+    }
+    while (out.size() == 256);
+    ASSERT_EQ(size, compressed.size());
+    ASSERT_GE(6U, compressing.getNumBlocksCompressed());
+
+    uavcan::BlockLZDecoder decoder;
+    std::string decompressed;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(compressed.c_str());
+    unsigned left = unsigned(compressed.size());
+    while (left > 0)
+    {
+        ASSERT_LE(0, decoder.feed(p, left));
+        decompressed.append(reinterpret_cast<const char*>(decoder.getBlock()), decoder.getBlockSize());
+    }
+    ASSERT_TRUE(decoder.isComplete());
+    ASSERT_TRUE(backend.file_data == decompressed);
+
+    // Random access and retries give the same data
+    ASSERT_EQ(0, read("fw.blz", 100, 256, out));
+    ASSERT_TRUE(compressed.substr(100, 256) == out);
+    ASSERT_EQ(0, read("fw.blz", 100, 256, out));
+    ASSERT_TRUE(compressed.substr(100, 256) == out);
+    ASSERT_EQ(0, read("fw.blz", size + 10, 256, out));
+    ASSERT_TRUE(out.empty());
+
+    // Modification through the adapter invalidates the index
+    ASSERT_EQ(0, compressing.write("fw", 0, UAVCAN_NULLPTR, 0));
+    ASSERT_EQ(0, read("fw.blz", 0, 256, out));
+    ASSERT_FALSE(compressed.substr(0, 256) == out);
+
+    // Errors
+    ASSERT_EQ(uavcan::protocol::file::Error::NOT_FOUND, read("nonexistent.blz", 0, 256, out));
+
+    backend.file_data.resize(5000, 'x');
+    compressing.invalidate();
+    ASSERT_EQ(uavcan::protocol::file::Error::FILE_TOO_LARGE, compressing.getInfo("fw.blz", size, type));
+}
+
+
+TEST(CompressingFileServerBackend, Download)
+{
+    using namespace uavcan::protocol::file;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<GetInfo> _reg1;
+    uavcan::DefaultDataTypeRegistrator<Read> _reg2;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    std::srand(42);
+    CompressionTestFileServerBackend backend(20 * 1024);     // The last block is empty
+    uavcan::CompressingFileServerBackend<> compressing(backend);
+    uavcan::BasicFileServer serv(nodes.a, compressing);
+    ASSERT_LE(0, serv.start());
+
+    CompressionTestCollector collector;
+    uavcan::DecompressingFileDownloadSink decompressor(collector);
+    uavcan::FileDownloader<> downloader(nodes.b, decompressor);
+
+    uavcan::BlockLZ::Path path;
+    ASSERT_TRUE(uavcan::BlockLZ::makeCompressedFilePath("fw", path));
+    ASSERT_LE(0, downloader.start(1, path));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+
+    ASSERT_FALSE(downloader.isRunning());
+    ASSERT_EQ(1, collector.num_completions);
+    ASSERT_EQ(0, collector.result);
+    ASSERT_TRUE(backend.file_data == collector.data);
+    ASSERT_EQ(21, compressing.getNumBlocksCompressed());
+
+    /*
+     * Fallback to the plain file is up to the client
+     */
+    collector = CompressionTestCollector();
+    decompressor.reset();
+    ASSERT_LE(0, downloader.start(1, "nonexistent.blz"));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_EQ(1, collector.num_completions);
+    ASSERT_EQ(Error::NOT_FOUND, collector.result);
+}
@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <uavcan/protocol/delta_file_server_backend.hpp>
+#include <uavcan/protocol/file_downloader.hpp>
+#include "helpers.hpp"
+
+
+class DeltaTestFileServerBackend : public uavcan::IFileServerBackend
+{
+public:
+    std::map<std::string, std::string> files;
+    unsigned num_reads;
+
+    DeltaTestFileServerBackend() : num_reads(0) { }
+
+    virtual int16_t getInfo(const Path& path, uint64_t& out_size, EntryType& out_type)
+    {
+        const std::map<std::string, std::string>::const_iterator it = files.find(path.c_str());
+        if (it == files.end())
+        {
+            return Error::NOT_FOUND;
+        }
+        out_size = it->second.length();
+        out_type.flags = EntryType::FLAG_FILE | EntryType::FLAG_READABLE | EntryType::FLAG_WRITEABLE;
+        return 0;
+    }
+
+    virtual int16_t read(const Path& path, const uint64_t offset, uint8_t* out_buffer, uint16_t& inout_size)
+    {
+        num_reads++;
+        const std::map<std::string, std::string>::const_iterator it = files.find(path.c_str());
+        if (it == files.end())
+        {
+            return Error::NOT_FOUND;
+        }
+        const std::string& data = it->second;
+        const uint64_t len = (offset < data.length()) ? std::min<uint64_t>(data.length() - offset, inout_size) : 0;
+        std::memcpy(out_buffer, data.c_str() + offset, std::size_t(len));
+        inout_size = uint16_t(len);
+        return 0;
+    }
+
+    virtual int16_t write(const Path& path, const uint64_t, const uint8_t*, const uint16_t)
+    {
+        files[path.c_str()][0] = 'X';
+        return 0;
+    }
+};
+
+
+struct DeltaTestImageStorage : public uavcan::IFirmwareImageStorage
+{
+    std::vector<uint8_t> memory;
+
+    explicit DeltaTestImageStorage(const std::string& image)
+        : memory(image.begin(), image.end())
+    {
+        memory.resize(memory.size() + 4096, 0xFF);
+    }
+
+    virtual int read(uint32_t offset, uint8_t* data, uint16_t size)
+    {
+        std::copy(memory.begin() + offset, memory.begin() + offset + size, data);
+        return 0;
+    }
+
+    virtual int write(uint32_t offset, const uint8_t* data, uint16_t size)
+    {
+        std::copy(data, data + size, memory.begin() + offset);
+        return 0;
+    }
+
+    virtual uint32_t getCapacity() const { return uint32_t(memory.size()); }
+};
+
+
+struct DeltaTestCompletionSink : public uavcan::IFileDownloadSink
+{
+    uint64_t num_bytes;
+    int result;
+    unsigned num_completions;
+
+    DeltaTestCompletionSink()
+        : num_bytes(0)
+        , result(1000)
+        , num_completions(0)
+    { }
+
+    virtual void handleFileData(uint64_t, const uint8_t*, uint16_t size) { num_bytes += size; }
+
+    virtual void handleFileDownloadCompletion(int error)
+    {
+        result = error;
+        num_completions++;
+    }
+};
+
+
+static std::string makeDeltaTestImage(unsigned size)
+{
+    std::string data;
+    for (unsigned i = 0; i < size; i++)
+    {
+        const unsigned word = i / 4;
+        static const uint8_t Pattern[] = { 0x00, 0xBF, 0x08, 0x46 };     // Looks like machine code
+        data.push_back(((word % 5) == 0) ? char(std::rand()) : char(Pattern[i % 4] + (word % 3)));
+    }
+    return data;
+}
+
+
+TEST(DeltaFileServerBackend, Basic)
+{
+    using uavcan::protocol::file::Error;
+
+    std::srand(42);
+    DeltaTestFileServerBackend backend;
+    const std::string old_image = makeDeltaTestImage(10000);
+    std::string new_image = old_image;
+    new_image.insert(500, makeDeltaTestImage(200));
+    backend.files["fw.bin"] = new_image;
+    backend.files["archive/00000000deadbeef.bin"] = old_image;
+
+    typedef uavcan::DeltaFileServerBackend<16384> SmallDeltaFileServerBackend;
+    std::unique_ptr<SmallDeltaFileServerBackend> delta(new SmallDeltaFileServerBackend(backend));
+    delta->setArchivePath("archive");
+
+    uavcan::IFileServerBackend::Path path;
+    ASSERT_TRUE(delta->makeArchivedImagePath(0xDEADBEEFULL, path));
+    ASSERT_TRUE(path == "archive/00000000deadbeef.bin");
+
+    const auto read = [&](const char* p, uint64_t offset, uint16_t size, std::string& out)
+    {
+        uint8_t buffer[256];
+        const int16_t res = delta->read(p, offset, buffer, size);
+        out.assign(reinterpret_cast<const char*>(buffer), size);
+        return res;
+    };
+
+    std::string out;
+
+    // Plain files are passed through
+    ASSERT_EQ(0, read("fw.bin", 10, 100, out));
+    ASSERT_TRUE(new_image.substr(10, 100) == out);
+    ASSERT_EQ(0, delta->getNumPatchesMade());
+
+    // The patch is made once
+    uint64_t size = 0;
+    uavcan::protocol::file::EntryType type;
+    ASSERT_EQ(0, delta->getInfo("fw.bin.00000000deadbeef.dlt", size, type));
+    ASSERT_EQ(1, delta->getNumPatchesMade());
+    ASSERT_LT(uavcan::FirmwareDelta::HeaderSize, size);
+    ASSERT_GT(1000, size);
+    ASSERT_EQ(0, type.flags & uavcan::protocol::file::EntryType::FLAG_WRITEABLE);
+
+    std::string patch;
+    uint64_t offset = 0;
+    do
+    {
+        ASSERT_EQ(0, read("fw.bin.00000000deadbeef.dlt", offset, 256, out));
+        patch += out;
+        offset += out.size();
+    }
+    while (out.size() == 256);
+    ASSERT_EQ(size, patch.size());
+    ASSERT_EQ(1, delta->getNumPatchesMade());
+
+    uavcan::FirmwareDelta::Header header;
+    ASSERT_TRUE(uavcan::FirmwareDelta::readHeader(reinterpret_cast<const uint8_t*>(patch.c_str()), header));
+    ASSERT_EQ(0xDEADBEEFULL, header.base_crc);
+    ASSERT_EQ(old_image.size(), header.base_size);
+    ASSERT_EQ(new_image.size(), header.target_size);
+    ASSERT_GE(delta->getMaxShift(), header.shift);
+
+    // Unknown base or target
+    ASSERT_EQ(Error::NOT_FOUND, delta->getInfo("fw.bin.00000000deadbeee.dlt", size, type));
+    ASSERT_EQ(Error::NOT_FOUND, read("fw.bin.00000000deadbeee.dlt", 0, 256, out));
+    ASSERT_EQ(Error::NOT_FOUND, delta->getInfo("nonexistent.00000000deadbeef.dlt", size, type));
+
+    // The patch that is not smaller than the image is not offered
+    std::string& unrelated = backend.files["unrelated.bin"];
+    for (unsigned i = 0; i < 5000; i++)
+    {
+        unrelated.push_back(char(std::rand()));
+    }
+    ASSERT_EQ(Error::NOT_FOUND, read("unrelated.bin.00000000deadbeef.dlt", 0, 256, out));
+
+    // Modification through the adapter invalidates the patch
+    const unsigned num_patches = delta->getNumPatchesMade();
+    ASSERT_EQ(0, read("fw.bin.00000000deadbeef.dlt", 0, 256, out));
+    ASSERT_EQ(num_patches + 1U, delta->getNumPatchesMade());
+    ASSERT_EQ(0, delta->write("fw.bin", 0, UAVCAN_NULLPTR, 0));
+    ASSERT_EQ(0, read("fw.bin.00000000deadbeef.dlt", 0, 256, out));
+    ASSERT_EQ(num_patches + 2U, delta->getNumPatchesMade());
+    ASSERT_FALSE(patch.substr(0, 256) == out);
+
+    // Images that don't fit
+    backend.files["large.bin"] = makeDeltaTestImage(20000);
+    ASSERT_EQ(Error::FILE_TOO_LARGE, read("large.bin.00000000deadbeef.dlt", 0, 256, out));
+}
+
+
+TEST(DeltaFileServerBackend, Download)
+{
+    using namespace uavcan::protocol::file;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<GetInfo> _reg1;
+    uavcan::DefaultDataTypeRegistrator<Read> _reg2;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    std::srand(42);
+    DeltaTestFileServerBackend backend;
+    const std::string old_image = makeDeltaTestImage(20000);
+    std::string new_image = old_image;
+    new_image.insert(1000, makeDeltaTestImage(300));
+    new_image.erase(15000, 500);
+    backend.files["fw.bin"] = new_image;
+    backend.files["archive/0000000000000123.bin"] = old_image;
+
+    std::unique_ptr<uavcan::DeltaFileServerBackend<> > delta(new uavcan::DeltaFileServerBackend<>(backend));
+    delta->setArchivePath("archive/");
+    uavcan::BasicFileServer serv(nodes.a, *delta);
+    ASSERT_LE(0, serv.start());
+
+    DeltaTestImageStorage storage(old_image);
+    DeltaTestCompletionSink sink;
+    uavcan::DeltaPatchingFileDownloadSink patcher(storage, sink);
+    uavcan::FileDownloader<> downloader(nodes.b, patcher);
+
+    uavcan::FirmwareDelta::Path path;
+    ASSERT_TRUE(uavcan::FirmwareDelta::makeDeltaFilePath("fw.bin", 0x123, path));
+    patcher.reset(0x123, uint32_t(old_image.size()));
+    ASSERT_LE(0, downloader.start(1, path));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+
+    ASSERT_FALSE(downloader.isRunning());
+    ASSERT_EQ(1, sink.num_completions);
+    ASSERT_EQ(0, sink.result);
+    ASSERT_EQ(new_image.size(), sink.num_bytes);
+    ASSERT_TRUE(std::string(storage.memory.begin(), storage.memory.begin() + long(new_image.size())) == new_image);
+    ASSERT_EQ(1, delta->getNumPatchesMade());
+
+    /*
+     * The server doesn't know the base - the storage is intact, the client falls back to the full image
+     */
+    sink = DeltaTestCompletionSink();
+    DeltaTestImageStorage other_storage(old_image);
+    uavcan::DeltaPatchingFileDownloadSink other_patcher(other_storage, sink);
+    uavcan::FileDownloader<> other_downloader(nodes.b, other_patcher);
+    ASSERT_TRUE(uavcan::FirmwareDelta::makeDeltaFilePath("fw.bin", 0x124, path));
+    other_patcher.reset(0x124, uint32_t(old_image.size()));
+    ASSERT_LE(0, other_downloader.start(1, path));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+
+    ASSERT_EQ(1, sink.num_completions);
+    ASSERT_EQ(Error::NOT_FOUND, sink.result);
+    ASSERT_FALSE(other_patcher.hasModifiedStorage());
+    ASSERT_TRUE(std::string(other_storage.memory.begin(), other_storage.memory.begin() + long(old_image.size())) ==
+                old_image);
+}
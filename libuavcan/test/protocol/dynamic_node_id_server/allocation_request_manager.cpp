@@ -115,3 +115,145 @@ TEST(dynamic_node_id_server_AllocationRequestManager, Basic)
 
     ASSERT_EQ(PreferredNodeID, client.getAllocatedNodeID());
 }
+
+
+static uavcan::protocol::dynamic_node_id::Allocation makeAllocationRequest(const UniqueID& unique_id,
+                                                                           uavcan::uint8_t stage)
+{
+    using uavcan::protocol::dynamic_node_id::Allocation;
+    static const uavcan::uint8_t Offsets[] = { 0, Allocation::MAX_LENGTH_OF_UNIQUE_ID_IN_REQUEST,
+                                               Allocation::MAX_LENGTH_OF_UNIQUE_ID_IN_REQUEST * 2, 16 };
+    Allocation msg;
+    msg.first_part_of_unique_id = (stage == 1);
+    for (uavcan::uint8_t i = Offsets[stage - 1]; i < Offsets[stage]; i++)
+    {
+        msg.unique_id.push_back(unique_id[i]);
+    }
+    return msg;
+}
+
+
+TEST(dynamic_node_id_server_AllocationRequestManager, ParkedRequests)
+{
+    using namespace uavcan::protocol::dynamic_node_id;
+    using namespace uavcan::dynamic_node_id_server;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Allocation> _reg1;
+
+    // Node A is Allocator, Node B emulates two allocatees
+    InterlinkedTestNodesWithSysClock nodes(uavcan::NodeID(10), uavcan::NodeID::Broadcast);
+
+    EventTracer tracer;
+    AllocationRequestHandler handler;
+    handler.can_followup = true;
+
+    AllocationRequestManager manager(nodes.a, tracer, handler);
+    ASSERT_LE(0, manager.init(uavcan::TransferPriority::OneHigherThanLowest));
+
+    uavcan::Publisher<Allocation> pub(nodes.b);
+    ASSERT_LE(0, pub.init());
+    pub.allowAnonymousTransfers();
+
+    SubscriberWithCollector<Allocation> sub(nodes.b);
+    ASSERT_LE(0, sub.start());
+
+    UniqueID uid_x;
+    UniqueID uid_y;
+    for (uavcan::uint8_t i = 0; i < uid_x.size(); i++)
+    {
+        uid_x[i] = i;
+        uid_y[i] = uavcan::uint8_t(0x80U + i);
+    }
+
+    /*
+     * X starts the exchange, Y comes while it is in progress and gets parked
+     */
+    ASSERT_LE(0, pub.broadcast(makeAllocationRequest(uid_x, 1)));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(sub.collector.msg.get());
+    ASSERT_EQ(Allocation::MAX_LENGTH_OF_UNIQUE_ID_IN_REQUEST, sub.collector.msg->unique_id.size());
+    ASSERT_EQ(uid_x[0], sub.collector.msg->unique_id[0]);
+
+    ASSERT_LE(0, pub.broadcast(makeAllocationRequest(uid_y, 1)));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_EQ(1, manager.getNumParkedRequests());
+    ASSERT_EQ(1, tracer.countEvents(TraceAllocationRequestParked));
+
+    ASSERT_LE(0, pub.broadcast(makeAllocationRequest(uid_y, 1)));       // Repeated - still one
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_EQ(1, manager.getNumParkedRequests());
+    ASSERT_EQ(1, tracer.countEvents(TraceAllocationRequestParked));
+
+    /*
+     * X completes; the exchange with Y is started immediately
+     */
+    sub.collector.msg.reset();
+    ASSERT_LE(0, pub.broadcast(makeAllocationRequest(uid_x, 2)));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_LE(0, pub.broadcast(makeAllocationRequest(uid_x, 3)));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(handler.matchAndPopLastRequest(uid_x, uavcan::NodeID::Broadcast));
+
+    ASSERT_EQ(0, manager.getNumParkedRequests());
+    ASSERT_TRUE(sub.collector.msg.get());
+    ASSERT_EQ(Allocation::MAX_LENGTH_OF_UNIQUE_ID_IN_REQUEST, sub.collector.msg->unique_id.size());
+    ASSERT_EQ(uid_y[0], sub.collector.msg->unique_id[0]);
+
+    /*
+     * Y proceeds with the second stage right away
+     */
+    ASSERT_LE(0, pub.broadcast(makeAllocationRequest(uid_y, 2)));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_LE(0, pub.broadcast(makeAllocationRequest(uid_y, 3)));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(handler.matchAndPopLastRequest(uid_y, uavcan::NodeID::Broadcast));
+}
+
+#if UAVCAN_SUPPORT_CANFD
+TEST(dynamic_node_id_server_AllocationRequestManager, SingleRoundCanFd)
+{
+    using namespace uavcan::protocol::dynamic_node_id;
+    using namespace uavcan::protocol::dynamic_node_id::server;
+    using namespace uavcan::dynamic_node_id_server;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Allocation> _reg1;
+
+    InterlinkedTestNodesWithSysClock nodes(uavcan::NodeID(10), uavcan::NodeID::Broadcast);
+    nodes.a.enableCanFd();
+    nodes.b.enableCanFd();
+
+    uavcan::DynamicNodeIDClient client(nodes.b);
+
+    uavcan::protocol::HardwareVersion::FieldTypes::unique_id unique_id;
+    for (uavcan::uint8_t i = 0; i < unique_id.size(); i++)
+    {
+        unique_id[i] = uavcan::uint8_t(0x10U + i);
+    }
+    const uavcan::NodeID PreferredNodeID = 42;
+    ASSERT_LE(0, client.start(unique_id, PreferredNodeID));
+
+    /*
+     * The follow-ups are not needed - the whole unique ID comes in one request
+     */
+    EventTracer tracer;
+    AllocationRequestHandler handler;
+    handler.can_followup = false;
+
+    AllocationRequestManager manager(nodes.a, tracer, handler);
+    ASSERT_LE(0, manager.init(uavcan::TransferPriority::OneHigherThanLowest));
+
+    // One request period is enough
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(Allocation::MAX_REQUEST_PERIOD_MS + 100));
+
+    ASSERT_TRUE(handler.matchAndPopLastRequest(unique_id, PreferredNodeID));
+
+    ASSERT_LE(0, manager.broadcastAllocationResponse(unique_id, PreferredNodeID));
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+
+    ASSERT_TRUE(client.isAllocationComplete());
+    ASSERT_EQ(PreferredNodeID, client.getAllocatedNodeID());
+}
+#endif
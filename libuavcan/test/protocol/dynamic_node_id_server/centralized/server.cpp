@@ -69,6 +69,54 @@ TEST(dynamic_node_id_server_centralized_Server, Basic)
 }
 
 
+TEST(dynamic_node_id_server_centralized_Server, AllocationBatching)
+{
+    using namespace uavcan::dynamic_node_id_server;
+    using namespace uavcan::protocol::dynamic_node_id;
+    using namespace uavcan::protocol::dynamic_node_id::server;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Allocation> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg3;
+
+    EventTracer tracer;
+    MemoryStorageBackend storage;
+
+    InterlinkedTestNodesWithSysClock nodes(uavcan::NodeID(10), uavcan::NodeID::Broadcast);
+
+    UniqueID own_unique_id;
+    own_unique_id[0] = 0xAA;
+
+    uavcan::dynamic_node_id_server::CentralizedServer server(nodes.a, storage, tracer);
+    ASSERT_FALSE(server.isAllocationBatchingEnabled());
+    server.setAllocationBatchWindow(uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_TRUE(server.isAllocationBatchingEnabled());
+    ASSERT_EQ(uavcan::MonotonicDuration::fromMSec(100), server.getAllocationBatchWindow());
+
+    ASSERT_LE(0, server.init(own_unique_id));
+    ASSERT_EQ(1, server.getNumAllocations());   // The own node ID is stored synchronously
+    ASSERT_EQ(0, storage.num_set_many_calls);
+
+    uavcan::DynamicNodeIDClient client(nodes.b);
+    uavcan::protocol::HardwareVersion::FieldTypes::unique_id unique_id;
+    for (uavcan::uint8_t i = 0; i < unique_id.size(); i++)
+    {
+        unique_id[i] = i;
+    }
+    const uavcan::NodeID PreferredNodeID = 42;
+    ASSERT_LE(0, client.start(unique_id, PreferredNodeID));
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(15000));
+
+    ASSERT_TRUE(client.isAllocationComplete());
+    ASSERT_EQ(PreferredNodeID, client.getAllocatedNodeID());
+
+    // The response was sent after the batch had been written
+    ASSERT_EQ(2, server.getNumAllocations());
+    ASSERT_EQ(1, storage.num_set_many_calls);
+}
+
 TEST(dynamic_node_id_server_centralized, ObjectSizes)
 {
     using namespace uavcan::dynamic_node_id_server;
@@ -128,3 +128,80 @@ TEST(dynamic_node_id_server_centralized_Storage, Basic)
 
     storage.print();
 }
+
+
+TEST(dynamic_node_id_server_centralized_Storage, PendingBatch)
+{
+    using namespace uavcan::dynamic_node_id_server::centralized;
+    using uavcan::dynamic_node_id_server::UniqueID;
+
+    MemoryStorageBackend storage;
+    Storage stor(storage);
+    ASSERT_LE(0, stor.init());
+
+    UniqueID unique_id;
+    unique_id[0] = 1;
+    ASSERT_LE(0, stor.add(1, unique_id));
+    ASSERT_EQ(2, storage.getNumKeys());
+
+    /*
+     * Pending entries take their node IDs, but don't touch the storage
+     */
+    unique_id[0] = 2;
+    ASSERT_LE(0, stor.addPending(2, unique_id));
+    unique_id[0] = 3;
+    ASSERT_LE(0, stor.addPending(3, unique_id));
+    ASSERT_EQ(-uavcan::ErrInvalidParam, stor.addPending(3, unique_id));    // Occupied
+    ASSERT_EQ(-uavcan::ErrInvalidParam, stor.addPending(1, unique_id));
+
+    ASSERT_EQ(2, stor.getNumPendingEntries());
+    ASSERT_TRUE(stor.isNodeIDOccupied(2));
+    ASSERT_TRUE(stor.isNodeIDOccupied(3));
+    ASSERT_EQ(3, stor.getPendingNodeIDForUniqueID(unique_id).get());
+    ASSERT_FALSE(stor.getNodeIDForUniqueID(unique_id).isValid());
+    ASSERT_EQ(1, stor.getSize());
+    ASSERT_EQ(2, storage.getNumKeys());
+    ASSERT_EQ(0, storage.num_set_many_calls);
+
+    /*
+     * Commit - one backend call for the whole batch
+     */
+    ASSERT_LE(0, stor.commitPending());
+    ASSERT_EQ(1, storage.num_set_many_calls);
+    ASSERT_EQ("0e000000000000000000000000000000", storage.get("occupation_mask"));
+    ASSERT_EQ("2",                                storage.get("02000000000000000000000000000000"));
+    ASSERT_EQ("3",                                storage.get("03000000000000000000000000000000"));
+    ASSERT_EQ(3, stor.getSize());
+    ASSERT_EQ(3, stor.getNodeIDForUniqueID(unique_id).get());
+
+    ASSERT_EQ(2, stor.getNumPendingEntries());     // Kept for the caller
+    ASSERT_EQ(2, stor.getPendingEntry(0).node_id.get());
+    stor.discardPending();
+    ASSERT_EQ(0, stor.getNumPendingEntries());
+    ASSERT_TRUE(stor.isNodeIDOccupied(3));
+
+    /*
+     * Failed commit - the entries are not allocated
+     */
+    storage.failOnSetCalls(true);
+    unique_id[0] = 4;
+    ASSERT_LE(0, stor.addPending(4, unique_id));
+    ASSERT_GT(0, stor.commitPending());
+    stor.discardPending();
+    ASSERT_FALSE(stor.isNodeIDOccupied(4));
+    ASSERT_EQ(3, stor.getSize());
+
+    /*
+     * Capacity
+     */
+    storage.failOnSetCalls(false);
+    for (uavcan::uint8_t i = 0; i < Storage::MaxPendingEntries; i++)
+    {
+        unique_id[0] = uavcan::uint8_t(10 + i);
+        ASSERT_LE(0, stor.addPending(uavcan::uint8_t(10 + i), unique_id));
+    }
+    ASSERT_EQ(-uavcan::ErrLogic, stor.addPending(100, unique_id));
+    ASSERT_LE(0, stor.commitPending());
+    stor.discardPending();
+    ASSERT_EQ(3 + Storage::MaxPendingEntries, stor.getSize());
+}
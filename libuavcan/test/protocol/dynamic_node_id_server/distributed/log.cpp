@@ -241,3 +241,217 @@ TEST(dynamic_node_id_server_Log, Remove)
 
     storage.print();
 }
+
+
+namespace
+{
+
+int findLastIndexByTraversal(const uavcan::dynamic_node_id_server::distributed::Log& log,
+                             const uavcan::dynamic_node_id_server::UniqueID& unique_id)
+{
+    for (int index = log.getLastIndex(); index >= 0; index--)
+    {
+        if (log.getEntryAtIndex(uavcan::uint8_t(index))->unique_id == unique_id)
+        {
+            return index;
+        }
+    }
+    return -1;
+}
+
+int findLastIndexByTraversal(const uavcan::dynamic_node_id_server::distributed::Log& log, uavcan::NodeID node_id)
+{
+    for (int index = log.getLastIndex(); index >= 0; index--)
+    {
+        if (log.getEntryAtIndex(uavcan::uint8_t(index))->node_id == node_id.get())
+        {
+            return index;
+        }
+    }
+    return -1;
+}
+
+void checkIndexes(const uavcan::dynamic_node_id_server::distributed::Log& log)
+{
+    using uavcan::dynamic_node_id_server::UniqueID;
+
+    UniqueID unique_id;
+    for (unsigned i = 0; i < 256; i++)
+    {
+        unique_id[0] = uavcan::uint8_t(i);
+        ASSERT_EQ(findLastIndexByTraversal(log, unique_id), log.findLastIndexOfUniqueID(unique_id));
+    }
+    unique_id[0] = 0;
+    unique_id[15] = 0xFF;
+    ASSERT_EQ(-1, log.findLastIndexOfUniqueID(unique_id));
+
+    for (uavcan::uint8_t i = 0; i <= uavcan::NodeID::Max; i++)
+    {
+        ASSERT_EQ(findLastIndexByTraversal(log, uavcan::NodeID(i)), log.findLastIndexOfNodeID(i));
+    }
+    ASSERT_EQ(-1, log.findLastIndexOfNodeID(uavcan::NodeID()));
+}
+
+}
+
+TEST(dynamic_node_id_server_Log, Indexes)
+{
+    using namespace uavcan::dynamic_node_id_server::distributed;
+
+    EventTracer tracer;
+    MemoryStorageBackend storage;
+    Log log(storage, tracer);
+    ASSERT_LE(0, log.init());
+
+    // The zero entry is found like in a traversal
+    ASSERT_EQ(0, log.findLastIndexOfUniqueID(uavcan::dynamic_node_id_server::UniqueID()));
+    ASSERT_EQ(0, log.findLastIndexOfNodeID(0));
+    ASSERT_EQ(-1, log.findLastIndexOfNodeID(1));
+    checkIndexes(log);
+
+    /*
+     * Filling the log fully; some unique IDs and node IDs repeat, e.g. the nodes discovered without unique IDs
+     */
+    uavcan::protocol::dynamic_node_id::server::Entry entry;
+    entry.term = 1;
+    while (log.getLastIndex() < (log.Capacity - 1))
+    {
+        const unsigned next = log.getLastIndex() + 1U;
+        entry.node_id = uavcan::uint8_t(next % 100U);
+        entry.unique_id[0] = uavcan::uint8_t((next % 3U == 0) ? 0 : next);
+        ASSERT_LE(0, log.append(entry));
+    }
+    checkIndexes(log);
+
+    /*
+     * Removal
+     */
+    ASSERT_LE(0, log.removeEntriesWhereIndexGreaterOrEqual(110));
+    checkIndexes(log);
+    ASSERT_LE(0, log.removeEntriesWhereIndexGreater(30));
+    checkIndexes(log);
+
+    entry.node_id = 120;
+    entry.unique_id[0] = 120;
+    ASSERT_LE(0, log.append(entry));
+    ASSERT_EQ(31, log.findLastIndexOfNodeID(120));
+    ASSERT_EQ(31, log.findLastIndexOfUniqueID(entry.unique_id));
+    checkIndexes(log);
+
+    /*
+     * Restoring from the storage
+     */
+    Log restored(storage, tracer);
+    ASSERT_LE(0, restored.init());
+    ASSERT_EQ(31, restored.getLastIndex());
+    checkIndexes(restored);
+
+    /*
+     * Restoring from the journal
+     */
+    JournaledMemoryStorageBackend journaled_storage;
+    {
+        Log journaled(journaled_storage, tracer);
+        ASSERT_LE(0, journaled.init());
+        for (uavcan::uint8_t i = 1; i <= 40; i++)
+        {
+            entry.node_id = uavcan::uint8_t(i % 7U);
+            entry.unique_id[0] = uavcan::uint8_t(i % 5U);
+            ASSERT_LE(0, journaled.append(entry));
+        }
+        ASSERT_LE(0, journaled.removeEntriesWhereIndexGreater(20));
+        checkIndexes(journaled);
+    }
+    Log journaled(journaled_storage, tracer);
+    ASSERT_LE(0, journaled.init());
+    ASSERT_EQ(20, journaled.getLastIndex());
+    checkIndexes(journaled);
+}
+
+TEST(dynamic_node_id_server_Log, Journal)
+{
+    using namespace uavcan::dynamic_node_id_server::distributed;
+
+    EventTracer tracer;
+    JournaledMemoryStorageBackend storage;
+
+    /*
+     * Empty journal - empty log, nothing is written
+     */
+    {
+        Log log(storage, tracer);
+        ASSERT_LE(0, log.init());
+        ASSERT_EQ(0, log.getLastIndex());
+        ASSERT_EQ(0, log.getEntryAtIndex(0)->term);
+        ASSERT_TRUE(storage.journal.records.empty());
+    }
+
+    /*
+     * One record per operation, nothing in the key/value storage
+     */
+    uavcan::protocol::dynamic_node_id::server::Entry entry;
+    {
+        Log log(storage, tracer);
+        ASSERT_LE(0, log.init());
+
+        for (uint8_t i = 1; i <= 5; i++)
+        {
+            entry.term = 0x10000U + i;
+            entry.node_id = uint8_t(120U + i);
+            entry.unique_id[0] = i;
+            entry.unique_id[15] = uint8_t(0xF0U + i);
+            ASSERT_LE(0, log.append(entry));
+        }
+        ASSERT_EQ(5, storage.journal.records.size());
+
+        ASSERT_LE(0, log.removeEntriesWhereIndexGreater(3));
+        ASSERT_EQ(3, log.getLastIndex());
+        ASSERT_LE(0, log.removeEntriesWhereIndexGreater(3));       // Nothing to remove
+        ASSERT_EQ(6, storage.journal.records.size());
+
+        ASSERT_LE(0, log.append(entry));
+        ASSERT_EQ(4, log.getLastIndex());
+        ASSERT_EQ(7, storage.journal.records.size());
+
+        storage.journal.fail = true;
+        ASSERT_GT(0, log.append(entry));
+        ASSERT_GT(0, log.removeEntriesWhereIndexGreater(1));
+        ASSERT_EQ(4, log.getLastIndex());
+        storage.journal.fail = false;
+
+        ASSERT_EQ(0, storage.getNumKeys());
+    }
+
+    /*
+     * Replay
+     */
+    {
+        Log log(storage, tracer);
+        ASSERT_LE(0, log.init());
+        ASSERT_EQ(4, log.getLastIndex());
+        for (uint8_t i = 1; i <= 3; i++)
+        {
+            const Entry* const e = log.getEntryAtIndex(i);
+            ASSERT_EQ(0x10000U + i, e->term);
+            ASSERT_EQ(120U + i, e->node_id);
+            ASSERT_EQ(i, e->unique_id[0]);
+            ASSERT_EQ(0xF0U + i, e->unique_id[15]);
+        }
+        ASSERT_TRUE(entry == *log.getEntryAtIndex(4));
+    }
+
+    /*
+     * Inconsistent records
+     */
+    storage.journal.records.back()[1] = 10;                         // Gap in the log
+    {
+        Log log(storage, tracer);
+        ASSERT_GT(0, log.init());
+    }
+    storage.journal.records.back()[1] = 4;
+    storage.journal.records.back().pop_back();                      // Wrong length
+    {
+        Log log(storage, tracer);
+        ASSERT_GT(0, log.init());
+    }
+}
@@ -207,3 +207,84 @@ TEST(dynamic_node_id_server_PersistentState, Basic)
      */
     ASSERT_GT(10, storage.getNumKeys());  // Making sure there's some sane number of keys in the storage
 }
+
+
+TEST(dynamic_node_id_server_PersistentState, Journal)
+{
+    using namespace uavcan::dynamic_node_id_server::distributed;
+
+    EventTracer tracer;
+    JournaledMemoryStorageBackend storage;
+
+    /*
+     * Empty journal, nothing is written
+     */
+    {
+        PersistentState pers(storage, tracer);
+        ASSERT_LE(0, pers.init());
+        ASSERT_EQ(0, pers.getCurrentTerm());
+        ASSERT_EQ(0, pers.getVotedFor().get());
+        ASSERT_TRUE(storage.journal.records.empty());
+    }
+
+    /*
+     * A transaction is synced once; the key/value storage is not used
+     */
+    {
+        PersistentState pers(storage, tracer);
+        ASSERT_LE(0, pers.init());
+
+        Entry entry;
+        entry.term = 2;
+        entry.node_id = 42;
+
+        pers.beginTransaction();
+        ASSERT_LE(0, pers.setCurrentTerm(2));
+        ASSERT_LE(0, pers.resetVotedFor());
+        ASSERT_LE(0, pers.getLog().append(entry));
+        ASSERT_LE(0, pers.getLog().append(entry));
+        ASSERT_EQ(4, storage.journal.records.size());
+        ASSERT_EQ(0, storage.journal.num_syncs);
+        ASSERT_EQ(2, pers.getCurrentTerm());                       // Updated in memory immediately
+        ASSERT_LE(0, pers.commitTransaction());
+        ASSERT_EQ(1, storage.journal.num_syncs);
+        ASSERT_EQ(4, storage.journal.num_synced_records);
+
+        pers.beginTransaction();                                    // Empty transaction - no sync
+        ASSERT_LE(0, pers.commitTransaction());
+        ASSERT_EQ(1, storage.journal.num_syncs);
+
+        ASSERT_LE(0, pers.setVotedFor(uavcan::NodeID(7)));          // No transaction - synced immediately
+        ASSERT_EQ(2, storage.journal.num_syncs);
+
+        pers.beginTransaction();
+        storage.journal.fail = true;
+        ASSERT_GT(0, pers.setCurrentTerm(3));
+        ASSERT_GT(0, pers.commitTransaction());
+        storage.journal.fail = false;
+        ASSERT_EQ(2, pers.getCurrentTerm());
+
+        ASSERT_EQ(0, storage.getNumKeys());
+    }
+
+    /*
+     * Restoring
+     */
+    {
+        PersistentState pers(storage, tracer);
+        ASSERT_LE(0, pers.init());
+        ASSERT_EQ(2, pers.getCurrentTerm());
+        ASSERT_EQ(7, pers.getVotedFor().get());
+        ASSERT_EQ(2, pers.getLog().getLastIndex());
+        ASSERT_EQ(42, pers.getLog().getEntryAtIndex(2)->node_id);
+    }
+
+    /*
+     * Current term is missing while the log is not empty
+     */
+    storage.journal.records.erase(storage.journal.records.begin());
+    {
+        PersistentState pers(storage, tracer);
+        ASSERT_GT(0, pers.init());
+    }
+}
@@ -114,6 +114,187 @@ TEST(dynamic_node_id_server_RaftCore, Basic)
 }
 
 
+TEST(dynamic_node_id_server_RaftCore, CatchUp)
+{
+    using namespace uavcan::dynamic_node_id_server::distributed;
+    using namespace uavcan::protocol::dynamic_node_id::server;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Discovery> _reg1;
+    uavcan::DefaultDataTypeRegistrator<AppendEntries> _reg2;
+    uavcan::DefaultDataTypeRegistrator<RequestVote> _reg3;
+
+    EventTracer tracer_a("a");
+    EventTracer tracer_b("b");
+    MemoryStorageBackend storage_a;
+    MemoryStorageBackend storage_b;
+    CommitHandler commit_handler_a("a");
+    CommitHandler commit_handler_b("b");
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    std::unique_ptr<RaftCore> raft_a(new RaftCore(nodes.a, storage_a, tracer_a, commit_handler_a));
+    std::unique_ptr<RaftCore> raft_b(new RaftCore(nodes.b, storage_b, tracer_b, commit_handler_b));
+
+    ASSERT_LE(0, raft_a->init(2, uavcan::TransferPriority::OneHigherThanLowest));
+    ASSERT_LE(0, raft_b->init(2, uavcan::TransferPriority::OneHigherThanLowest));
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(9000));
+
+    std::unique_ptr<RaftCore>& leader = raft_a->isLeader() ? raft_a : raft_b;
+    std::unique_ptr<RaftCore>& follower = raft_a->isLeader() ? raft_b : raft_a;
+    ASSERT_TRUE(leader->isLeader());
+
+    /*
+     * The leader accumulates many entries while the follower is down
+     */
+    const bool follower_is_b = (&follower == &raft_b);
+    follower.reset();
+    (follower_is_b ? storage_b : storage_a).reset();
+
+    Entry::FieldTypes::unique_id unique_id;
+    for (uint8_t i = 1; i <= 40; i++)
+    {
+        uavcan::fill_n(unique_id.begin(), 16, i);
+        leader->appendLog(unique_id, uavcan::NodeID(i));
+    }
+    ASSERT_EQ(40, leader->getPersistentState().getLog().getLastIndex());
+
+    /*
+     * The replaced follower receives the whole log in much less time than one entry per update interval needs
+     */
+    if (follower_is_b)
+    {
+        follower.reset(new RaftCore(nodes.b, storage_b, tracer_b, commit_handler_b));
+    }
+    else
+    {
+        follower.reset(new RaftCore(nodes.a, storage_a, tracer_a, commit_handler_a));
+    }
+    ASSERT_LE(0, follower->init(2, uavcan::TransferPriority::OneHigherThanLowest));
+    ASSERT_EQ(0, follower->getPersistentState().getLog().getLastIndex());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(3000));
+
+    ASSERT_LT(3000, 40 * leader->getUpdateInterval().toMSec());     // One entry per update would take longer
+
+    ASSERT_TRUE(leader->isLeader());
+    ASSERT_EQ(40, follower->getPersistentState().getLog().getLastIndex());
+    ASSERT_EQ(*leader->getPersistentState().getLog().getEntryAtIndex(40),
+              *follower->getPersistentState().getLog().getEntryAtIndex(40));
+}
+
+TEST(dynamic_node_id_server_RaftCore, Pipelining)
+{
+    using namespace uavcan::dynamic_node_id_server::distributed;
+    using namespace uavcan::protocol::dynamic_node_id::server;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Discovery> _reg1;
+    uavcan::DefaultDataTypeRegistrator<AppendEntries> _reg2;
+    uavcan::DefaultDataTypeRegistrator<RequestVote> _reg3;
+
+    EventTracer tracer_a("a");
+    EventTracer tracer_b("b");
+    MemoryStorageBackend storage_a;
+    MemoryStorageBackend storage_b;
+    CommitHandler commit_handler_a("a");
+    CommitHandler commit_handler_b("b");
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    RaftCore raft_a(nodes.a, storage_a, tracer_a, commit_handler_a);
+    RaftCore raft_b(nodes.b, storage_b, tracer_b, commit_handler_b);
+
+    ASSERT_LE(0, raft_a.init(2, uavcan::TransferPriority::OneHigherThanLowest));
+    ASSERT_LE(0, raft_b.init(2, uavcan::TransferPriority::OneHigherThanLowest));
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(9000));
+
+    RaftCore& leader = raft_a.isLeader() ? raft_a : raft_b;
+    RaftCore& follower = raft_a.isLeader() ? raft_b : raft_a;
+    ASSERT_TRUE(leader.isLeader());
+
+    /*
+     * A burst of allocations is replicated and committed within a couple of update intervals,
+     * rather than one entry per update interval
+     */
+    Entry::FieldTypes::unique_id unique_id;
+    for (uint8_t i = 1; i <= 30; i++)
+    {
+        uavcan::fill_n(unique_id.begin(), 16, i);
+        leader.appendLog(unique_id, uavcan::NodeID(i));
+    }
+
+    nodes.spinBoth(leader.getUpdateInterval() * 2);
+
+    ASSERT_EQ(30, follower.getPersistentState().getLog().getLastIndex());
+    ASSERT_EQ(30, leader.getCommitIndex());
+    ASSERT_TRUE(leader.areAllLogEntriesCommitted());
+
+    nodes.spinBoth(leader.getUpdateInterval() * 2);
+
+    ASSERT_EQ(30, follower.getCommitIndex());
+}
+
+TEST(dynamic_node_id_server_RaftCore, LeaderHandover)
+{
+    using namespace uavcan::dynamic_node_id_server::distributed;
+    using namespace uavcan::protocol::dynamic_node_id::server;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Discovery> _reg1;
+    uavcan::DefaultDataTypeRegistrator<AppendEntries> _reg2;
+    uavcan::DefaultDataTypeRegistrator<RequestVote> _reg3;
+
+    EventTracer tracer_a("a");
+    EventTracer tracer_b("b");
+    MemoryStorageBackend storage_a;
+    MemoryStorageBackend storage_b;
+    CommitHandler commit_handler_a("a");
+    CommitHandler commit_handler_b("b");
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    RaftCore raft_a(nodes.a, storage_a, tracer_a, commit_handler_a);
+    RaftCore raft_b(nodes.b, storage_b, tracer_b, commit_handler_b);
+
+    ASSERT_LE(0, raft_a.init(2, uavcan::TransferPriority::OneHigherThanLowest));
+    ASSERT_LE(0, raft_b.init(2, uavcan::TransferPriority::OneHigherThanLowest));
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(9000));
+
+    RaftCore& leader = raft_a.isLeader() ? raft_a : raft_b;
+    RaftCore& follower = raft_a.isLeader() ? raft_b : raft_a;
+    ASSERT_TRUE(leader.isLeader());
+    ASSERT_EQ(leader.getLeaderNodeID(), follower.getLeaderNodeID());
+
+    const uavcan::NodeID leader_node_id = leader.getLeaderNodeID();
+    const Term term = leader.getPersistentState().getCurrentTerm();
+    ASSERT_EQ(term, follower.getPersistentState().getCurrentTerm());
+
+    /*
+     * Nothing happens if a server other than the leader goes offline
+     */
+    follower.handleServerShutdown(uavcan::NodeID(127));
+    ASSERT_EQ(leader_node_id, follower.getLeaderNodeID());
+
+    /*
+     * The leader steps down and announces the shutdown; the follower takes over within a few update intervals,
+     * which is well below the election timeout
+     */
+    leader.handOverLeadership();
+    ASSERT_FALSE(leader.isLeader());
+    follower.handleServerShutdown(leader_node_id);
+
+    nodes.spinBoth(follower.getUpdateInterval() * 5);
+
+    ASSERT_TRUE(follower.isLeader());
+    ASSERT_FALSE(leader.isLeader());
+    ASSERT_EQ(term + 1, follower.getPersistentState().getCurrentTerm());
+    ASSERT_EQ(follower.getLeaderNodeID(), leader.getLeaderNodeID());
+}
+
 TEST(dynamic_node_id_server_Server, Basic)
 {
     using namespace uavcan::dynamic_node_id_server;
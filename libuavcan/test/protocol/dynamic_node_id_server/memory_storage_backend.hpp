@@ -5,6 +5,7 @@
 #pragma once
 
 #include <map>
+#include <vector>
 #include <uavcan/protocol/dynamic_node_id_server/storage_backend.hpp>
 
 class MemoryStorageBackend : public uavcan::dynamic_node_id_server::IStorageBackend
@@ -15,8 +16,11 @@ class MemoryStorageBackend : public uavcan::dynamic_node_id_server::IStorageBack
     bool fail_;
 
 public:
+    unsigned num_set_many_calls;
+
     MemoryStorageBackend()
         : fail_(false)
+        , num_set_many_calls(0)
     { }
 
     virtual String get(const String& key) const
@@ -37,6 +41,12 @@ public:
         }
     }
 
+    virtual void setMany(const String* keys, const String* values, uavcan::uint8_t count)
+    {
+        num_set_many_calls++;
+        IStorageBackend::setMany(keys, values, count);
+    }
+
     void failOnSetCalls(bool really) { fail_ = really; }
 
     void reset() { container_.clear(); }
@@ -51,3 +61,65 @@ public:
         }
     }
 };
+
+
+class MemoryJournalStorageBackend : public uavcan::dynamic_node_id_server::IJournalStorageBackend
+{
+public:
+    std::vector<std::vector<uavcan::uint8_t> > records;
+    unsigned num_synced_records;
+    unsigned num_syncs;
+    bool fail;
+
+    MemoryJournalStorageBackend()
+        : num_synced_records(0)
+        , num_syncs(0)
+        , fail(false)
+    { }
+
+    virtual int append(const uavcan::uint8_t* data, uavcan::uint8_t length)
+    {
+        const int res = appendWithoutSync(data, length);
+        return (res < 0) ? res : sync();
+    }
+
+    virtual int appendWithoutSync(const uavcan::uint8_t* data, uavcan::uint8_t length)
+    {
+        if (fail)
+        {
+            return -uavcan::ErrFailure;
+        }
+        records.push_back(std::vector<uavcan::uint8_t>(data, data + length));
+        return 0;
+    }
+
+    virtual int sync()
+    {
+        if (fail)
+        {
+            return -uavcan::ErrFailure;
+        }
+        num_synced_records = unsigned(records.size());
+        num_syncs++;
+        return 0;
+    }
+
+    virtual int read(uavcan::uint32_t index, uavcan::uint8_t (&out_data)[MaxRecordLength])
+    {
+        if (index >= records.size())
+        {
+            return 0;
+        }
+        std::copy(records[index].begin(), records[index].end(), out_data);
+        return int(records[index].size());
+    }
+};
+
+
+class JournaledMemoryStorageBackend : public MemoryStorageBackend
+{
+public:
+    MemoryJournalStorageBackend journal;
+
+    virtual uavcan::dynamic_node_id_server::IJournalStorageBackend* getJournal() { return &journal; }
+};
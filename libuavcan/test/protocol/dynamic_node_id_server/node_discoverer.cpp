@@ -8,6 +8,7 @@
 
 #include <gtest/gtest.h>
 #include <vector>
+#include <memory>
 #include <uavcan/protocol/dynamic_node_id_server/node_discoverer.hpp>
 #include <uavcan/node/publisher.hpp>
 #include "event_tracer.hpp"
@@ -273,6 +274,69 @@ TEST(dynamic_node_id_server_NodeDiscoverer, RestartAndMaxAttempts)
 }
 
 
+TEST(dynamic_node_id_server_NodeDiscoverer, ConcurrentRequests)
+{
+    using namespace uavcan::protocol::dynamic_node_id::server;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+
+    const int windows[] = { NodeDiscoverer::MaxConcurrentRequests, 1 };
+    for (int window : windows)
+    {
+        EventTracer tracer;
+        TestNetwork<6> nodes;
+        NodeDiscoveryHandler handler;
+        handler.can_discover = true;
+
+        NodeDiscoverer disc(nodes[0], tracer, handler);
+        ASSERT_LE(0, disc.init(uavcan::TransferPriority::OneHigherThanLowest));
+        disc.setMaxConcurrentRequests(uavcan::uint8_t(window));
+        ASSERT_EQ(window, disc.getMaxConcurrentRequests());
+
+        /*
+         * Nodes 2 and 3 respond to GetNodeInfo; the nodes 4, 5, 6 don't, and they are heard from last,
+         * so they are queried first
+         */
+        std::vector<std::shared_ptr<GetNodeInfoMockServer> > servers;
+        for (unsigned i = 1; i <= 2; i++)
+        {
+            servers.push_back(std::make_shared<GetNodeInfoMockServer>(nodes[i]));
+            servers.back()->response.hardware_version.unique_id[0] = uavcan::uint8_t(i);
+            ASSERT_LE(0, servers.back()->start());
+        }
+
+        uavcan::protocol::NodeStatus node_status;
+        node_status.uptime_sec = 10;
+        for (unsigned i = 1; i <= 5; i++)
+        {
+            uavcan::Publisher<uavcan::protocol::NodeStatus> node_status_pub(nodes[i]);
+            ASSERT_LE(0, node_status_pub.broadcast(node_status));
+            ASSERT_LE(0, nodes.spinAll(uavcan::MonotonicDuration::fromMSec(12)));
+        }
+        ASSERT_EQ(5, disc.getNumUnknownNodes());
+
+        /*
+         * The responsive nodes don't have to wait for the silent ones if the window is wide enough
+         */
+        ASSERT_LE(0, nodes.spinAll(uavcan::MonotonicDuration::fromMSec(400)));
+
+        if (window > 3)
+        {
+            ASSERT_EQ(2, handler.nodes.size());
+            ASSERT_TRUE(handler.findNode(uavcan::NodeID(2)));
+            ASSERT_TRUE(handler.findNode(uavcan::NodeID(3)));
+            ASSERT_EQ(3, disc.getNumUnknownNodes());
+        }
+        else
+        {
+            ASSERT_EQ(0, handler.nodes.size());
+            ASSERT_EQ(5, disc.getNumUnknownNodes());
+        }
+    }
+}
+
 TEST(dynamic_node_id_server_NodeDiscoverer, Sizes)
 {
     using namespace uavcan;
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <uavcan/protocol/file_broadcast.hpp>
+#include <uavcan/protocol/file_server.hpp>
+#include <root_ns_a/FileChunk.hpp>
+#include "helpers.hpp"
+
+
+class BroadcastTestFileServerBackend : public uavcan::IFileServerBackend
+{
+public:
+    std::string file_data;
+    unsigned num_reads;
+
+    explicit BroadcastTestFileServerBackend(unsigned size)
+        : num_reads(0)
+    {
+        for (unsigned i = 0; i < size; i++)
+        {
+            file_data.push_back(char('a' + (i % 26)));
+        }
+    }
+
+    virtual int16_t getInfo(const Path&, uint64_t&, EntryType&)
+    {
+        return Error::NOT_IMPLEMENTED;
+    }
+
+    virtual int16_t read(const Path& path, const uint64_t offset, uint8_t* out_buffer, uint16_t& inout_size)
+    {
+        num_reads++;
+        if (path != "fw")
+        {
+            return Error::NOT_FOUND;
+        }
+        const uint64_t len = (offset < file_data.length()) ? std::min<uint64_t>(file_data.length() - offset,
+                                                                                 inout_size) : 0;
+        std::memcpy(out_buffer, file_data.c_str() + offset, std::size_t(len));
+        inout_size = uint16_t(len);
+        return 0;
+    }
+};
+
+
+struct FileBroadcastCollector : public uavcan::IFileBroadcastSink
+{
+    std::string data;
+    unsigned num_chunks;
+    int result;
+    unsigned num_completions;
+
+    FileBroadcastCollector()
+        : num_chunks(0)
+        , result(1000)
+        , num_completions(0)
+    { }
+
+    virtual void handleFileChunk(uint64_t offset, const uint8_t* bytes, uint16_t size)
+    {
+        num_chunks++;
+        if (data.size() < (offset + size))
+        {
+            data.resize(std::size_t(offset + size), '?');
+        }
+        data.replace(std::size_t(offset), size, reinterpret_cast<const char*>(bytes), size);
+    }
+
+    virtual void handleFileReceptionCompletion(int error)
+    {
+        result = error;
+        num_completions++;
+    }
+};
+
+typedef uavcan::FileBroadcaster<root_ns_a::FileChunk> Broadcaster;
+typedef uavcan::FileBroadcastReceiver<root_ns_a::FileChunk, 4096> Receiver;
+
+
+TEST(FileBroadcast, ImageID)
+{
+    uavcan::protocol::file::Path::FieldTypes::path a;
+    uavcan::protocol::file::Path::FieldTypes::path b;
+    a = "fw/esc.bin";
+    b = "fw/esc.bin";
+    ASSERT_EQ(uavcan::makeFileBroadcastImageID(a), uavcan::makeFileBroadcastImageID(b));
+    b = "fw/esc2.bin";
+    ASSERT_NE(uavcan::makeFileBroadcastImageID(a), uavcan::makeFileBroadcastImageID(b));
+}
+
+
+TEST(FileBroadcast, WholeFleet)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::file::Read> _reg1;
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::FileChunk> _reg2;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::file::GetInfo> _reg3;
+
+    TestNetwork<4> nodes;
+
+    BroadcastTestFileServerBackend backend(256 * 10 + 100);
+    uavcan::BasicFileServer server(nodes[0], backend);
+    ASSERT_LE(0, server.start());
+
+    Broadcaster broadcaster(nodes[0], backend);
+    broadcaster.setChunkInterval(uavcan::MonotonicDuration::fromMSec(5));
+
+    FileBroadcastCollector sinks[3];
+    std::unique_ptr<Receiver> receivers[3];
+    for (unsigned i = 0; i < 3; i++)
+    {
+        receivers[i].reset(new Receiver(nodes[i + 1], sinks[i]));
+        ASSERT_LE(0, receivers[i]->start(1, "fw"));
+        ASSERT_TRUE(receivers[i]->isRunning());
+    }
+
+    /*
+     * One round is enough for everybody; the file server is not involved
+     */
+    ASSERT_LE(0, broadcaster.start("fw", 1));
+    ASSERT_TRUE(broadcaster.isRunning());
+
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(300));
+
+    ASSERT_FALSE(broadcaster.isRunning());
+    ASSERT_EQ(11, broadcaster.getNumChunksBroadcast());
+    ASSERT_EQ(11, backend.num_reads);
+
+    for (unsigned i = 0; i < 3; i++)
+    {
+        ASSERT_FALSE(receivers[i]->isRunning());
+        ASSERT_EQ(1, sinks[i].num_completions);
+        ASSERT_EQ(0, sinks[i].result);
+        ASSERT_EQ(11, sinks[i].num_chunks);
+        ASSERT_EQ(0, receivers[i]->getNumChunksRead());
+        ASSERT_TRUE(backend.file_data == sinks[i].data);
+    }
+}
+
+
+TEST(FileBroadcast, LateJoinerRepair)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::file::Read> _reg1;
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::FileChunk> _reg2;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::file::GetInfo> _reg3;
+
+    TestNetwork<2> nodes;
+
+    BroadcastTestFileServerBackend backend(256 * 15);          // The last chunk is empty
+    uavcan::BasicFileServer server(nodes[0], backend);
+    ASSERT_LE(0, server.start());
+
+    Broadcaster broadcaster(nodes[0], backend);
+    broadcaster.setChunkInterval(uavcan::MonotonicDuration::fromMSec(10));
+
+    FileBroadcastCollector sink;
+    Receiver receiver(nodes[1], sink);
+    receiver.setBroadcastTimeout(uavcan::MonotonicDuration::fromMSec(200));
+
+    /*
+     * The receiver joins in the middle of the only round, so the beginning of the file has to be read
+     */
+    ASSERT_LE(0, broadcaster.start("fw", 1));
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_TRUE(broadcaster.isRunning());
+    ASSERT_LT(0, broadcaster.getNumChunksBroadcast());
+
+    ASSERT_LE(0, receiver.start(1, "fw"));
+
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(1000));
+
+    ASSERT_FALSE(broadcaster.isRunning());
+    ASSERT_EQ(16, broadcaster.getNumChunksBroadcast());
+
+    ASSERT_FALSE(receiver.isRunning());
+    ASSERT_EQ(1, sink.num_completions);
+    ASSERT_EQ(0, sink.result);
+    ASSERT_TRUE(backend.file_data == sink.data);
+    ASSERT_EQ(16, receiver.getNumChunksReceived());
+    ASSERT_LT(0, receiver.getNumChunksRead());
+    ASSERT_GT(16, receiver.getNumChunksRead());
+
+    /*
+     * No broadcast at all - the whole file is read from the server
+     */
+    sink = FileBroadcastCollector();
+    ASSERT_LE(0, receiver.start(1, "fw"));
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(1000));
+
+    ASSERT_EQ(1, sink.num_completions);
+    ASSERT_EQ(0, sink.result);
+    ASSERT_TRUE(backend.file_data == sink.data);
+    ASSERT_EQ(16, receiver.getNumChunksRead());
+
+    /*
+     * Nonexistent file - the error is reported by the server
+     */
+    sink = FileBroadcastCollector();
+    ASSERT_LE(0, receiver.start(1, "nonexistent"));
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(500));
+
+    ASSERT_EQ(1, sink.num_completions);
+    ASSERT_EQ(uavcan::protocol::file::Error::NOT_FOUND, sink.result);
+
+    /*
+     * The file does not fit into the bitmap
+     */
+    backend.file_data.resize(5000, 'x');
+    sink = FileBroadcastCollector();
+    ASSERT_LE(0, receiver.start(1, "fw"));
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(1000));
+
+    ASSERT_FALSE(receiver.isRunning());
+    ASSERT_EQ(1, sink.num_completions);
+    ASSERT_EQ(-uavcan::ErrFailure, sink.result);
+}
+
+
+TEST(FileBroadcast, Extension)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::file::Read> _reg1;
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::FileChunk> _reg2;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::file::GetInfo> _reg3;
+
+    TestNetwork<2> nodes;
+
+    BroadcastTestFileServerBackend backend(256 * 10 + 1);
+    Broadcaster broadcaster(nodes[0], backend);
+    broadcaster.setChunkInterval(uavcan::MonotonicDuration::fromMSec(10));
+
+    ASSERT_GT(0, broadcaster.start("fw", 0));
+
+    /*
+     * A new receiver in the middle of the round extends the broadcast to the same offset of the next round
+     */
+    ASSERT_LE(0, broadcaster.start("fw", 1));
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(55));
+    const uint32_t num_broadcast_before_extension = broadcaster.getNumChunksBroadcast();
+    ASSERT_LT(0, num_broadcast_before_extension);
+    ASSERT_GT(11, num_broadcast_before_extension);
+
+    ASSERT_LE(0, broadcaster.start("fw", 1));
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(500));
+
+    ASSERT_FALSE(broadcaster.isRunning());
+    ASSERT_EQ(11 + num_broadcast_before_extension, broadcaster.getNumChunksBroadcast());
+
+    /*
+     * Read failure stops the broadcast
+     */
+    ASSERT_LE(0, broadcaster.start("nonexistent"));
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(50));
+    ASSERT_FALSE(broadcaster.isRunning());
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <uavcan/protocol/file_compression.hpp>
+
+
+static std::string compress(const std::string& data)
+{
+    uavcan::BlockLZEncoder encoder;
+    std::string out;
+    std::size_t pos = 0;
+    while (true)
+    {
+        const unsigned len = unsigned(std::min<std::size_t>(data.size() - pos, uavcan::BlockLZ::BlockSize));
+        uint8_t block[uavcan::BlockLZ::MaxEncodedBlockSize];
+        const unsigned size = encoder.encode(reinterpret_cast<const uint8_t*>(data.c_str()) + pos, len, block);
+        EXPECT_GE(unsigned(uavcan::BlockLZ::MaxEncodedBlockSize), size);
+        out.append(reinterpret_cast<const char*>(block), size);
+        pos += len;
+        if (len < uavcan::BlockLZ::BlockSize)
+        {
+            return out;
+        }
+    }
+}
+
+/**
+ * Feeds the input in pieces of the given size; returns false if the input is corrupted or incomplete.
+ */
+static bool decompress(const std::string& compressed, unsigned piece_size, std::string& out)
+{
+    uavcan::BlockLZDecoder decoder;
+    out.clear();
+    for (std::size_t pos = 0; pos < compressed.size(); pos += piece_size)
+    {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(compressed.c_str()) + pos;
+        unsigned left = unsigned(std::min<std::size_t>(compressed.size() - pos, piece_size));
+        while (left > 0)
+        {
+            const int res = decoder.feed(p, left);
+            if (res < 0)
+            {
+                return false;
+            }
+            if (res > 0)
+            {
+                out.append(reinterpret_cast<const char*>(decoder.getBlock()), decoder.getBlockSize());
+            }
+        }
+    }
+    return decoder.isComplete();
+}
+
+static std::string makeFirmwareLikeData(unsigned size)
+{
+    std::string data;
+    for (unsigned i = 0; i < size; i++)
+    {
+        const unsigned word = i / 4;
+        static const uint8_t Pattern[] = { 0x00, 0xBF, 0x08, 0x46 };     // Looks like machine code
+        data.push_back(((word % 7) == 0) ? char(std::rand()) : char(Pattern[i % 4] + (word % 3)));
+    }
+    return data;
+}
+
+
+TEST(FileCompression, Paths)
+{
+    uavcan::BlockLZ::Path path;
+    uavcan::BlockLZ::Path compressed;
+    path = "fw/esc.bin";
+    ASSERT_FALSE(uavcan::BlockLZ::isCompressedFilePath(path));
+
+    ASSERT_TRUE(uavcan::BlockLZ::makeCompressedFilePath(path, compressed));
+    ASSERT_TRUE(compressed == "fw/esc.bin.blz");
+    ASSERT_TRUE(uavcan::BlockLZ::isCompressedFilePath(compressed));
+
+    uavcan::BlockLZ::Path original;
+    uavcan::BlockLZ::makeOriginalFilePath(compressed, original);
+    ASSERT_TRUE(original == path);
+
+    path = ".blz";
+    ASSERT_FALSE(uavcan::BlockLZ::isCompressedFilePath(path));
+
+    path.clear();
+    while (path.size() < (path.capacity() - 1))
+    {
+        path.push_back('x');
+    }
+    ASSERT_FALSE(uavcan::BlockLZ::makeCompressedFilePath(path, compressed));
+}
+
+
+TEST(FileCompression, RoundTrip)
+{
+    std::srand(42);
+    const unsigned sizes[] = { 0, 1, 2, 3, 100, 1023, 1024, 1025, 2048, 5000 };
+
+    for (unsigned i = 0; i < (sizeof(sizes) / sizeof(sizes[0])); i++)
+    {
+        std::string random;
+        for (unsigned k = 0; k < sizes[i]; k++)
+        {
+            random.push_back(char(std::rand()));
+        }
+        const std::string repetitive(sizes[i], 'a');
+        const std::string firmware = makeFirmwareLikeData(sizes[i]);
+        const std::string* inputs[] = { &random, &repetitive, &firmware };
+
+        for (unsigned k = 0; k < 3; k++)
+        {
+            const std::string compressed = compress(*inputs[k]);
+            std::string out;
+            ASSERT_TRUE(decompress(compressed, 7, out)) << sizes[i] << " " << k;
+            ASSERT_TRUE(*inputs[k] == out) << sizes[i] << " " << k;
+            ASSERT_TRUE(decompress(compressed, 100000, out));
+            ASSERT_TRUE(*inputs[k] == out);
+        }
+
+        // Incompressible data only gets the headers and the literal run tokens
+        const unsigned num_blocks = sizes[i] / uavcan::BlockLZ::BlockSize + 1;
+        ASSERT_GE(sizes[i] + num_blocks * uavcan::BlockLZ::HeaderSize + (sizes[i] + 127) / 128 + num_blocks,
+                  compress(random).size());
+    }
+
+    ASSERT_GT(200U, compress(std::string(5000, 'a')).size());
+    const std::string firmware = makeFirmwareLikeData(10000);
+    ASSERT_GT(firmware.size() * 2 / 3, compress(firmware).size());
+}
+
+
+TEST(FileCompression, CorruptedInput)
+{
+    std::srand(42);
+    const std::string data = makeFirmwareLikeData(3000);
+    const std::string compressed = compress(data);
+    std::string out;
+
+    // Truncated
+    ASSERT_FALSE(decompress(compressed.substr(0, compressed.size() - 1), 100, out));
+    ASSERT_FALSE(decompress(compressed.substr(0, 1024), 100, out));
+
+    // Trailing garbage
+    ASSERT_FALSE(decompress(compressed + "x", 100, out));
+
+    // Block size out of range
+    std::string bad = compressed;
+    bad[1] = char(0x10);
+    ASSERT_FALSE(decompress(bad, 100, out));
+
+    // Distance beyond the beginning of the block
+    const uint8_t backref[] = { 4, 0, 4, 0, 0x80, 0x01, 0x00, 0x00 };
+    ASSERT_FALSE(decompress(std::string(reinterpret_cast<const char*>(backref), sizeof(backref)), 100, out));
+
+    // Random corruption never makes the decoder misbehave; mostly it is detected
+    for (unsigned i = 0; i < 1000; i++)
+    {
+        bad = compressed;
+        bad[std::size_t(std::rand()) % bad.size()] = char(std::rand());
+        (void)decompress(bad, 1 + unsigned(std::rand()) % 300, out);
+        ASSERT_GE(3072U, out.size());
+    }
+}
+
+
+struct DecompressedDataCollector : public uavcan::IFileDownloadSink
+{
+    std::string data;
+    int result;
+    unsigned num_completions;
+
+    DecompressedDataCollector()
+        : result(1000)
+        , num_completions(0)
+    { }
+
+    virtual void handleFileData(uint64_t offset, const uint8_t* bytes, uint16_t size)
+    {
+        EXPECT_EQ(data.size(), offset);
+        EXPECT_GE(uavcan::BlockLZ::BlockSize, size);
+        data.append(reinterpret_cast<const char*>(bytes), size);
+    }
+
+    virtual void handleFileDownloadCompletion(int error)
+    {
+        result = error;
+        num_completions++;
+    }
+};
+
+
+TEST(FileCompression, DecompressingSink)
+{
+    std::srand(42);
+    const std::string data = makeFirmwareLikeData(4096);
+    const std::string compressed = compress(data);
+
+    DecompressedDataCollector collector;
+    uavcan::DecompressingFileDownloadSink sink(collector);
+
+    const auto feed = [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t pos = begin; pos < end; pos += 256)
+        {
+            const std::size_t len = std::min<std::size_t>(end - pos, 256);
+            sink.handleFileData(pos, reinterpret_cast<const uint8_t*>(compressed.c_str()) + pos, uint16_t(len));
+        }
+    };
+
+    feed(0, compressed.size());
+    ASSERT_EQ(data.size(), sink.getNumBytesDecompressed());
+    sink.handleFileDownloadCompletion(0);
+    ASSERT_EQ(1, collector.num_completions);
+    ASSERT_EQ(0, collector.result);
+    ASSERT_TRUE(data == collector.data);
+    ASSERT_EQ(0, sink.getNumBytesDecompressed());
+
+    // Truncated file
+    collector = DecompressedDataCollector();
+    feed(0, compressed.size() - 10);
+    sink.handleFileDownloadCompletion(0);
+    ASSERT_EQ(-uavcan::ErrFailure, collector.result);
+
+    // Errors are passed as is
+    collector = DecompressedDataCollector();
+    feed(0, 100);
+    sink.handleFileDownloadCompletion(-uavcan::ErrDriver);
+    ASSERT_EQ(-uavcan::ErrDriver, collector.result);
+
+    // The download must start from the beginning
+    collector = DecompressedDataCollector();
+    feed(256, compressed.size());
+    ASSERT_TRUE(collector.data.empty());
+    sink.handleFileDownloadCompletion(0);
+    ASSERT_EQ(-uavcan::ErrFailure, collector.result);
+}
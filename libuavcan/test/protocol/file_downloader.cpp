@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <uavcan/protocol/file_downloader.hpp>
+#include <uavcan/protocol/file_server.hpp>
+#include "helpers.hpp"
+
+
+class DownloadTestFileServerBackend : public uavcan::IFileServerBackend
+{
+public:
+    std::string file_data;
+    unsigned num_reads;
+
+    explicit DownloadTestFileServerBackend(unsigned size)
+        : num_reads(0)
+    {
+        for (unsigned i = 0; i < size; i++)
+        {
+            file_data.push_back(char('a' + (i % 26)));
+        }
+    }
+
+    virtual int16_t getInfo(const Path&, uint64_t&, EntryType&)
+    {
+        return Error::NOT_IMPLEMENTED;
+    }
+
+    virtual int16_t read(const Path& path, const uint64_t offset, uint8_t* out_buffer, uint16_t& inout_size)
+    {
+        num_reads++;
+        if (path != "fw")
+        {
+            return Error::NOT_FOUND;
+        }
+        const uint64_t len = (offset < file_data.length()) ? std::min<uint64_t>(file_data.length() - offset,
+                                                                                 inout_size) : 0;
+        std::memcpy(out_buffer, file_data.c_str() + offset, std::size_t(len));
+        inout_size = uint16_t(len);
+        return 0;
+    }
+};
+
+
+struct FileDownloadCollector : public uavcan::IFileDownloadSink
+{
+    std::string data;
+    uint64_t next_offset;
+    int result;
+    unsigned num_completions;
+    bool cancel_on_data;
+    uavcan::FileDownloader<>* downloader;
+
+    FileDownloadCollector()
+        : next_offset(0)
+        , result(1000)
+        , num_completions(0)
+        , cancel_on_data(false)
+        , downloader(UAVCAN_NULLPTR)
+    { }
+
+    void reset(uint64_t offset)
+    {
+        data.clear();
+        next_offset = offset;
+        result = 1000;
+        num_completions = 0;
+    }
+
+    virtual void handleFileData(uint64_t offset, const uint8_t* bytes, uint16_t size)
+    {
+        EXPECT_EQ(next_offset, offset);         // Strictly in order
+        next_offset = offset + size;
+        data.append(reinterpret_cast<const char*>(bytes), size);
+        if (cancel_on_data)
+        {
+            downloader->cancel();
+        }
+    }
+
+    virtual void handleFileDownloadCompletion(int error)
+    {
+        result = error;
+        num_completions++;
+    }
+};
+
+
+TEST(FileDownloader, Basic)
+{
+    using namespace uavcan::protocol::file;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<GetInfo> _reg1;
+    uavcan::DefaultDataTypeRegistrator<Read> _reg2;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    DownloadTestFileServerBackend backend(1000);
+    uavcan::BasicFileServer serv(nodes.a, backend);
+    ASSERT_LE(0, serv.start());
+
+    FileDownloadCollector sink;
+    uavcan::FileDownloader<> downloader(nodes.b, sink);
+    sink.downloader = &downloader;
+
+    /*
+     * The whole file; the last chunk is shorter than the others
+     */
+    ASSERT_LE(0, downloader.start(1, "fw"));
+    ASSERT_TRUE(downloader.isRunning());
+    ASSERT_EQ(0, backend.num_reads);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+
+    ASSERT_FALSE(downloader.isRunning());
+    ASSERT_EQ(1, sink.num_completions);
+    ASSERT_EQ(0, sink.result);
+    ASSERT_EQ(backend.file_data, sink.data);
+    ASSERT_EQ(1000, downloader.getNumBytesDelivered());
+    // The window was refilled past the end of the file until the short chunk arrived
+    ASSERT_EQ(7, backend.num_reads);
+    ASSERT_EQ(0, downloader.getNumRetries());
+
+    /*
+     * A file whose size is a multiple of the chunk size ends with an empty chunk
+     */
+    backend.file_data.resize(512);
+    backend.num_reads = 0;
+    sink.reset(0);
+    ASSERT_LE(0, downloader.start(1, "fw"));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+
+    ASSERT_EQ(1, sink.num_completions);
+    ASSERT_EQ(0, sink.result);
+    ASSERT_EQ(backend.file_data, sink.data);
+
+    /*
+     * From the middle of the file
+     */
+    backend.file_data.resize(768);
+    backend.num_reads = 0;
+    sink.reset(200);
+    ASSERT_LE(0, downloader.start(1, "fw", 200));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+
+    ASSERT_EQ(1, sink.num_completions);
+    ASSERT_EQ(0, sink.result);
+    ASSERT_EQ(backend.file_data.substr(200), sink.data);
+    ASSERT_EQ(568, downloader.getNumBytesDelivered());
+
+    /*
+     * Error reported by the server
+     */
+    sink.reset(0);
+    ASSERT_LE(0, downloader.start(1, "nonexistent"));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+
+    ASSERT_EQ(1, sink.num_completions);
+    ASSERT_EQ(Error::NOT_FOUND, sink.result);
+    ASSERT_TRUE(sink.data.empty());
+
+    /*
+     * Cancelled by the sink
+     */
+    sink.reset(0);
+    sink.cancel_on_data = true;
+    ASSERT_LE(0, downloader.start(1, "fw"));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+
+    ASSERT_FALSE(downloader.isRunning());
+    ASSERT_EQ(0, sink.num_completions);
+    ASSERT_EQ(256, sink.data.size());
+    sink.cancel_on_data = false;
+
+    /*
+     * No server; every request is repeated once before giving up
+     */
+    sink.reset(0);
+    downloader.setMaxAttempts(2);
+    downloader.setRequestTimeout(uavcan::MonotonicDuration::fromMSec(20));
+    ASSERT_LE(0, downloader.start(99, "fw"));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+
+    ASSERT_FALSE(downloader.isRunning());
+    ASSERT_EQ(1, sink.num_completions);
+    ASSERT_EQ(-uavcan::ErrFailure, sink.result);
+    ASSERT_LE(1, downloader.getNumRetries());
+    ASSERT_GE(4, downloader.getNumRetries());
+
+    /*
+     * Invalid server
+     */
+    ASSERT_GT(0, downloader.start(2, "fw"));               // Own node ID
+    ASSERT_FALSE(downloader.isRunning());
+}
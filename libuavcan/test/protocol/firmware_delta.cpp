@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <uavcan/protocol/firmware_delta.hpp>
+
+
+typedef uavcan::FirmwareDeltaEncoder<> Encoder;
+
+struct MemoryImageStorage : public uavcan::IFirmwareImageStorage
+{
+    std::vector<uint8_t> memory;
+    unsigned num_writes;
+
+    explicit MemoryImageStorage(unsigned capacity)
+        : memory(capacity, 0xFF)
+        , num_writes(0)
+    { }
+
+    virtual int read(uint32_t offset, uint8_t* data, uint16_t size)
+    {
+        EXPECT_GE(memory.size(), std::size_t(offset) + size);
+        std::copy(memory.begin() + offset, memory.begin() + offset + size, data);
+        return 0;
+    }
+
+    virtual int write(uint32_t offset, const uint8_t* data, uint16_t size)
+    {
+        EXPECT_GE(memory.size(), std::size_t(offset) + size);
+        std::copy(data, data + size, memory.begin() + offset);
+        num_writes++;
+        return 0;
+    }
+
+    virtual uint32_t getCapacity() const { return uint32_t(memory.size()); }
+
+    void load(const std::string& image)
+    {
+        std::fill(memory.begin(), memory.end(), 0xFF);
+        std::copy(image.begin(), image.end(), memory.begin());
+    }
+
+    bool holds(const std::string& image) const
+    {
+        return std::string(memory.begin(), memory.begin() + long(image.size())) == image;
+    }
+};
+
+struct CompletionSink : public uavcan::IFileDownloadSink
+{
+    uint64_t num_bytes;
+    int error;
+    unsigned num_completions;
+
+    CompletionSink()
+        : num_bytes(0)
+        , error(1234)
+        , num_completions(0)
+    { }
+
+    virtual void handleFileData(uint64_t offset, const uint8_t*, uint16_t size)
+    {
+        EXPECT_EQ(num_bytes, offset);
+        num_bytes += size;
+    }
+
+    virtual void handleFileDownloadCompletion(int arg_error)
+    {
+        error = arg_error;
+        num_completions++;
+    }
+};
+
+static std::string makeFirmwareLikeData(unsigned size)
+{
+    std::string data;
+    for (unsigned i = 0; i < size; i++)
+    {
+        const unsigned word = i / 4;
+        static const uint8_t Pattern[] = { 0x00, 0xBF, 0x08, 0x46 };     // Looks like machine code
+        data.push_back(((word % 5) == 0) ? char(std::rand()) : char(Pattern[i % 4] + (word % 3)));
+    }
+    return data;
+}
+
+static std::string makePatch(const std::string& base, uint64_t base_crc, const std::string& target,
+                             uint32_t max_shift)
+{
+    std::unique_ptr<Encoder> encoder(new Encoder);
+    std::vector<uint8_t> out(uavcan::FirmwareDelta::getMaxPatchSize(uint32_t(target.size())));
+    const uint32_t size = encoder->encode(reinterpret_cast<const uint8_t*>(base.c_str()), uint32_t(base.size()),
+                                          base_crc, reinterpret_cast<const uint8_t*>(target.c_str()),
+                                          uint32_t(target.size()), max_shift, &out[0]);
+    EXPECT_GE(out.size(), size);
+    return std::string(out.begin(), out.begin() + size);
+}
+
+/**
+ * Feeds the patch in pieces of the given size; returns the completion error.
+ */
+static int applyPatch(MemoryImageStorage& storage, const std::string& base, uint64_t base_crc,
+                      const std::string& patch, unsigned piece_size)
+{
+    CompletionSink sink;
+    uavcan::DeltaPatchingFileDownloadSink patcher(storage, sink);
+    storage.load(base);
+    patcher.reset(base_crc, uint32_t(base.size()));
+    for (std::size_t pos = 0; pos < patch.size(); pos += piece_size)
+    {
+        const unsigned len = unsigned(std::min<std::size_t>(patch.size() - pos, piece_size));
+        patcher.handleFileData(pos, reinterpret_cast<const uint8_t*>(patch.c_str()) + pos, uint16_t(len));
+    }
+    patcher.handleFileDownloadCompletion(0);
+    EXPECT_EQ(1, sink.num_completions);
+    if (sink.error == 0)
+    {
+        EXPECT_EQ(patcher.getTargetSize(), sink.num_bytes);
+    }
+    return sink.error;
+}
+
+
+TEST(FirmwareDelta, Paths)
+{
+    uavcan::FirmwareDelta::Path path;
+    uavcan::FirmwareDelta::Path delta;
+    uavcan::FirmwareDelta::Path original;
+    uint64_t crc = 0;
+
+    path = "fw/esc.bin";
+    ASSERT_FALSE(uavcan::FirmwareDelta::parseDeltaFilePath(path, original, crc));
+
+    ASSERT_TRUE(uavcan::FirmwareDelta::makeDeltaFilePath(path, 0x0123456789ABCDEFULL, delta));
+    ASSERT_TRUE(delta == "fw/esc.bin.0123456789abcdef.dlt");
+    ASSERT_TRUE(uavcan::FirmwareDelta::parseDeltaFilePath(delta, original, crc));
+    ASSERT_TRUE(original == path);
+    ASSERT_EQ(0x0123456789ABCDEFULL, crc);
+
+    delta = "fw/esc.bin.0123456789ABCDEF.dlt";             // Lowercase only
+    ASSERT_FALSE(uavcan::FirmwareDelta::parseDeltaFilePath(delta, original, crc));
+    delta = "fw/esc.bin0123456789abcdef0.dlt";              // No dot
+    ASSERT_FALSE(uavcan::FirmwareDelta::parseDeltaFilePath(delta, original, crc));
+    delta = ".0123456789abcdef.dlt";                        // No file name
+    ASSERT_FALSE(uavcan::FirmwareDelta::parseDeltaFilePath(delta, original, crc));
+
+    path.clear();
+    while (path.size() < (path.capacity() - 10))
+    {
+        path.push_back('x');
+    }
+    ASSERT_FALSE(uavcan::FirmwareDelta::makeDeltaFilePath(path, 0, delta));
+}
+
+
+TEST(FirmwareDelta, RoundTrip)
+{
+    std::srand(42);
+    const std::string base = makeFirmwareLikeData(20000);
+    const uint64_t base_crc = 0xDEADBEEFCAFEULL;
+
+    std::string inserted = base;                            // Code grows near the beginning
+    inserted.insert(1000, makeFirmwareLikeData(300));
+
+    std::string removed = base;                             // Code shrinks
+    removed.erase(5000, 700);
+
+    std::string modified = base;                            // A few constants change
+    for (unsigned i = 0; i < 20; i++)
+    {
+        modified[(i * 997U) % modified.size()] = char(std::rand());
+    }
+
+    const std::string appended = base + makeFirmwareLikeData(1000);
+    const std::string unrelated = makeFirmwareLikeData(15000);
+    const std::string empty;
+
+    const std::string* targets[] = { &base, &inserted, &removed, &modified, &appended, &unrelated, &empty };
+    const uint32_t shifts[] = { 0, 4096 };
+
+    MemoryImageStorage storage(32768);
+
+    for (unsigned i = 0; i < (sizeof(targets) / sizeof(targets[0])); i++)
+    {
+        for (unsigned k = 0; k < (sizeof(shifts) / sizeof(shifts[0])); k++)
+        {
+            const std::string patch = makePatch(base, base_crc, *targets[i], shifts[k]);
+            ASSERT_GE(uavcan::FirmwareDelta::getMaxPatchSize(uint32_t(targets[i]->size())), patch.size());
+
+            uavcan::FirmwareDelta::Header header;
+            ASSERT_TRUE(uavcan::FirmwareDelta::readHeader(reinterpret_cast<const uint8_t*>(patch.c_str()), header));
+            ASSERT_GE(shifts[k], header.shift);
+
+            ASSERT_EQ(0, applyPatch(storage, base, base_crc, patch, 7)) << i << " " << k;
+            ASSERT_TRUE(storage.holds(*targets[i])) << i << " " << k;
+            ASSERT_EQ(0, applyPatch(storage, base, base_crc, patch, 256)) << i << " " << k;
+            ASSERT_TRUE(storage.holds(*targets[i])) << i << " " << k;
+
+            std::cout << "Target " << i << " max shift " << shifts[k] << ": " << targets[i]->size() << " --> "
+                      << patch.size() << " shift " << header.shift << std::endl;
+        }
+    }
+
+    /*
+     * The similar versions make small patches; the insertion needs the shift to be small as well
+     */
+    ASSERT_GT(100U, makePatch(base, base_crc, base, 0).size());
+    ASSERT_GT(1000U, makePatch(base, base_crc, removed, 0).size());
+    ASSERT_GT(1000U, makePatch(base, base_crc, modified, 0).size());
+    ASSERT_GT(2000U, makePatch(base, base_crc, appended, 0).size());
+    ASSERT_GT(1000U, makePatch(base, base_crc, inserted, 4096).size());
+    ASSERT_LT(10000U, makePatch(base, base_crc, inserted, 0).size());
+}
+
+
+TEST(FirmwareDelta, Rejection)
+{
+    std::srand(42);
+    const std::string base = makeFirmwareLikeData(5000);
+    std::string target = base;
+    target.insert(100, makeFirmwareLikeData(100));
+    target.resize(base.size());
+    const std::string patch = makePatch(base, 1, target, 1024);
+
+    MemoryImageStorage storage(8192);
+
+    /*
+     * Different base - the storage is not modified
+     */
+    ASSERT_GT(0, applyPatch(storage, base, 2, patch, 64));
+    ASSERT_TRUE(storage.holds(base));
+
+    std::string shorter_base = base;
+    shorter_base.resize(4000);
+    ASSERT_GT(0, applyPatch(storage, shorter_base, 1, patch, 64));
+    ASSERT_TRUE(storage.holds(shorter_base));
+
+    /*
+     * Not enough memory for the shift
+     */
+    MemoryImageStorage small_storage(5050);
+    ASSERT_GT(0, applyPatch(small_storage, base, 1, patch, 64));
+    ASSERT_TRUE(small_storage.holds(base));
+
+    /*
+     * Truncated or damaged patch
+     */
+    ASSERT_GT(0, applyPatch(storage, base, 1, patch.substr(0, patch.size() - 1), 64));
+    ASSERT_GT(0, applyPatch(storage, base, 1, patch.substr(0, 10), 64));
+
+    std::string damaged = patch;
+    damaged[damaged.size() - 1] = char(damaged[damaged.size() - 1] ^ 1);
+    ASSERT_GT(0, applyPatch(storage, base, 1, damaged, 64));
+
+    damaged = patch;
+    damaged[uavcan::FirmwareDelta::HeaderSize] = char(0x81);     // Reserved operation
+    ASSERT_GT(0, applyPatch(storage, base, 1, damaged, 64));
+
+    damaged = patch;
+    damaged[0] = 'X';
+    ASSERT_GT(0, applyPatch(storage, base, 1, damaged, 64));
+    ASSERT_TRUE(storage.holds(base));
+
+    /*
+     * Copy from a range of the base that has been overwritten already
+     */
+    uavcan::FirmwareDelta::Header header;
+    header.base_crc = 1;
+    header.base_size = uint32_t(base.size());
+    header.target_size = 20;
+    std::string bad_order(uavcan::FirmwareDelta::HeaderSize, '\0');
+    uavcan::FirmwareDelta::writeHeader(header, reinterpret_cast<uint8_t*>(&bad_order[0]));
+    bad_order += std::string(1, char(9)) + base.substr(0, 10);                              // 10 literals
+    const char copy_op[] = { char(0x80), 0, 0, 0, 0, 10, 0 };                               // From the offset zero
+    bad_order += std::string(copy_op, sizeof(copy_op));
+    ASSERT_GT(0, applyPatch(storage, base, 1, bad_order, 64));
+
+    /*
+     * Server errors are passed through
+     */
+    CompletionSink sink;
+    uavcan::DeltaPatchingFileDownloadSink patcher(storage, sink);
+    patcher.reset(1, uint32_t(base.size()));
+    patcher.handleFileDownloadCompletion(2);
+    ASSERT_EQ(2, sink.error);
+    ASSERT_FALSE(patcher.hasModifiedStorage());
+}
@@ -2,6 +2,8 @@
  * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <map>
+#include <vector>
 #include <gtest/gtest.h>
 #include <uavcan/protocol/firmware_update_trigger.hpp>
 #include <uavcan/protocol/node_status_provider.hpp>
@@ -22,11 +24,16 @@ struct FirmwareVersionChecker : public uavcan::IFirmwareVersionChecker
 
     BeginFirmwareUpdate::Response last_error_response;
 
+    std::map<int, uint8_t> priorities;
+    std::vector<int> confirmed_node_ids;
+    bool admit_updates;
+
     FirmwareVersionChecker()
         : should_request_cnt(0)
         , should_retry_cnt(0)
         , confirmation_cnt(0)
         , retry_quota(0)
+        , admit_updates(true)
     { }
 
     virtual bool shouldRequestFirmwareUpdate(uavcan::NodeID node_id,
@@ -39,6 +46,13 @@ struct FirmwareVersionChecker : public uavcan::IFirmwareVersionChecker
         return node_info.name == expected_node_name_to_update;
     }
 
+    virtual uint8_t getFirmwareUpdatePriority(uavcan::NodeID node_id, const uavcan::protocol::GetNodeInfo::Response&)
+    {
+        return (priorities.count(node_id.get()) > 0) ? priorities[node_id.get()] : uint8_t(0);
+    }
+
+    virtual bool canBeginFirmwareUpdate(uavcan::NodeID) { return admit_updates; }
+
     virtual bool shouldRetryFirmwareUpdate(uavcan::NodeID node_id,
                                            const BeginFirmwareUpdate::Response& error_response,
                                            FirmwareFilePath& out_firmware_file_path)
@@ -64,6 +78,7 @@ struct FirmwareVersionChecker : public uavcan::IFirmwareVersionChecker
                                                   const BeginFirmwareUpdate::Response& response)
     {
         confirmation_cnt++;
+        confirmed_node_ids.push_back(node_id.get());
         std::cout << "CONFIRMED " << int(node_id.get()) << "\n" << response << std::endl;
     }
 };
@@ -334,3 +349,91 @@ TEST(FirmwareUpdateTrigger, MultiNode)
 
     ASSERT_FALSE(trigger.isTimerRunning());
 }
+
+
+TEST(FirmwareUpdateTrigger, Orchestration)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<BeginFirmwareUpdate> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg3;
+
+    TestNetwork<5> nodes;
+
+    FirmwareVersionChecker checker;
+    uavcan::NodeInfoRetriever node_info_retriever(nodes[0]);
+    uavcan::FirmwareUpdateTrigger trigger(nodes[0], checker);
+
+    ASSERT_EQ(0, trigger.getMaxConcurrentUpdates());        // Unlimited by default
+    trigger.setMaxConcurrentUpdates(2);
+    ASSERT_LE(0, trigger.start(node_info_retriever));
+    ASSERT_LE(0, node_info_retriever.start());
+
+    checker.expected_node_name_to_update = "Victor";
+    checker.firmware_path = "abc";
+    checker.priorities[5] = 0;                              // Most urgent
+    checker.priorities[3] = 1;
+    checker.priorities[2] = 2;
+    checker.priorities[4] = 2;
+    checker.admit_updates = false;                          // The file server is busy
+
+    /*
+     * All clients need the update and confirm it at once
+     */
+    std::unique_ptr<uavcan::NodeStatusProvider> providers[4];
+    std::unique_ptr<uavcan::ServiceServer<BeginFirmwareUpdate, BeginFirmwareUpdateServer::Callback> > servers[4];
+    BeginFirmwareUpdateServer server_impl;
+    server_impl.response_error_code = BeginFirmwareUpdate::Response::ERROR_OK;
+
+    for (unsigned i = 0; i < 4; i++)
+    {
+        providers[i].reset(new uavcan::NodeStatusProvider(nodes[i + 1]));
+        servers[i].reset(new uavcan::ServiceServer<BeginFirmwareUpdate, BeginFirmwareUpdateServer::Callback>(
+            nodes[i + 1]));
+        ASSERT_LE(0, servers[i]->start(server_impl.makeCallback()));
+    }
+    for (unsigned i = 0; i < 4; i++)
+    {
+        uavcan::protocol::HardwareVersion hwver;
+        hwver.unique_id[0] = uint8_t(i);
+        providers[i]->setHardwareVersion(hwver);
+        providers[i]->setName("Victor");
+        ASSERT_LE(0, providers[i]->startAndPublish());
+    }
+
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(3000));
+
+    ASSERT_TRUE(trigger.isTimerRunning());
+    ASSERT_EQ(4, trigger.getNumPendingNodes());
+    ASSERT_EQ(0, checker.confirmation_cnt);                 // Nothing was admitted
+
+    /*
+     * Only two nodes are allowed to update at a time, the most urgent ones go first
+     */
+    checker.admit_updates = true;
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(4000));
+
+    ASSERT_EQ(2, checker.confirmation_cnt);
+    ASSERT_EQ(5, checker.confirmed_node_ids.at(0));
+    ASSERT_EQ(3, checker.confirmed_node_ids.at(1));
+    ASSERT_EQ(2, trigger.getNumUpdatingNodes());
+    ASSERT_EQ(2, trigger.getNumPendingNodes());
+
+    /*
+     * One node finishes the update, which frees a slot for the next one
+     */
+    providers[3]->setMode(uavcan::protocol::NodeStatus::MODE_SOFTWARE_UPDATE);
+    ASSERT_LE(0, providers[3]->forcePublish());
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_EQ(2, trigger.getNumUpdatingNodes());
+
+    providers[3]->setMode(uavcan::protocol::NodeStatus::MODE_OPERATIONAL);
+    ASSERT_LE(0, providers[3]->forcePublish());
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(2100));
+
+    ASSERT_EQ(3, checker.confirmation_cnt);
+    ASSERT_EQ(2, trigger.getNumUpdatingNodes());
+    ASSERT_EQ(1, trigger.getNumPendingNodes());
+
+    ASSERT_EQ(0, nodes[0].internal_failure_count);
+}
@@ -33,6 +33,7 @@ struct GlobalTimeSyncTestNetwork
         slave.can.others.insert(&master_low.can);
         master_low.can.others.insert(&slave.can);
         master_high.can.others.insert(&slave.can);
+        master_high.can.others.insert(&master_low.can);
     }
 
     void spinAll(uavcan::MonotonicDuration duration = uavcan::MonotonicDuration::fromMSec(9))
@@ -129,3 +130,67 @@ TEST(GlobalTimeSyncMaster, Basic)
     ASSERT_TRUE(slave.isActive());
     ASSERT_EQ(nwk.master_high.node.getNodeID(), slave.getMasterNodeID());
 }
+
+TEST(GlobalTimeSyncMaster, Standby)
+{
+    GlobalTimeSyncTestNetwork nwk;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GlobalTimeSync> _reg1;
+
+    uavcan::GlobalTimeSyncSlave slave(nwk.slave.node);
+    uavcan::GlobalTimeSyncMaster master_standby(nwk.master_low.node);
+    uavcan::GlobalTimeSyncMaster master_active(nwk.master_high.node);
+
+    ASSERT_LE(0, slave.start());
+    slave.setMasterFailoverTimeout(uavcan::MonotonicDuration::fromMSec(500));
+    ASSERT_LE(0, master_active.init());
+    ASSERT_LE(0, master_standby.init());
+    ASSERT_FALSE(master_standby.isStandbyEnabled());
+    ASSERT_LE(0, master_standby.enableStandby(true));
+    ASSERT_TRUE(master_standby.isStandbyEnabled());
+    ASSERT_TRUE(master_standby.isActive());         // No other master seen yet
+
+    /*
+     * The standby master keeps quiet while the active one publishes
+     */
+    for (int i = 0; i < 3; i++)
+    {
+        ASSERT_LE(0, master_active.publish());
+        nwk.spinAll();
+        ASSERT_FALSE(master_standby.isActive());
+        ASSERT_LE(0, master_standby.publish());
+        ASSERT_TRUE(nwk.slave.can.read_queue.empty());
+        usleep(200000);
+    }
+    ASSERT_TRUE(slave.isActive());
+    ASSERT_EQ(nwk.master_high.node.getNodeID(), slave.getMasterNodeID());
+
+    // The takeover timeout follows the broadcasting period of the active master
+    ASSERT_LT(500, master_standby.getTakeoverTimeout().toMSec());
+    ASSERT_GT(700, master_standby.getTakeoverTimeout().toMSec());
+
+    /*
+     * The active master goes silent; the standby one takes over, the slave follows without waiting for
+     * the broadcaster timeout
+     */
+    usleep(600000);
+    ASSERT_TRUE(master_standby.isActive());
+    ASSERT_LE(0, master_standby.publish());         // Update
+    nwk.spinAll();
+    ASSERT_EQ(nwk.master_low.node.getNodeID(), slave.getMasterNodeID());
+
+    usleep(200000);
+    ASSERT_LE(0, master_standby.publish());         // Adjustment
+    nwk.spinAll();
+    ASSERT_TRUE(areTimestampsClose(nwk.slave.clock.getUtc(), nwk.master_low.clock.getUtc()));
+
+    /*
+     * Standby disabled - always active
+     */
+    ASSERT_LE(0, master_active.publish());
+    nwk.spinAll();
+    ASSERT_FALSE(master_standby.isActive());
+    ASSERT_LE(0, master_standby.enableStandby(false));
+    ASSERT_TRUE(master_standby.isActive());
+}
@@ -312,3 +312,183 @@ TEST(GlobalTimeSyncSlave, Suppression)
     ASSERT_EQ(8, gtss.getMasterNodeID().get());
     ASSERT_EQ(0, slave_clock.utc);                  // The clock shall not be asjusted
 }
+
+
+TEST(GlobalTimeSyncSlave, Filter)
+{
+    uavcan::GlobalTimeSyncFilter filter;
+    const uavcan::MonotonicDuration interval = uavcan::MonotonicDuration::fromMSec(1000);
+
+    /*
+     * The first offset is applied at once
+     */
+    ASSERT_FALSE(filter.isLocked());
+    uavcan::GlobalTimeSyncFilter::Output out = filter.update(123456, interval);
+    ASSERT_TRUE(out.stepped);
+    ASSERT_FALSE(out.rejected);
+    ASSERT_EQ(123456, out.phase_usec);
+    ASSERT_TRUE(filter.isLocked());
+
+    /*
+     * The local clock is 50 ppm slow; the measured offsets are jittery.
+     * The rate difference shall be estimated, and the residual error shall be well below the jitter.
+     */
+    int64_t true_offset = 0;
+    uint32_t rnd = 1;
+    int64_t sum_abs_error = 0;
+    for (int i = 0; i < 300; i++)
+    {
+        true_offset += 50;
+        rnd = rnd * 1103515245U + 12345U;
+        const int64_t noise = int64_t((rnd >> 16) % 41U) - 20;
+        if (i >= 200)
+        {
+            sum_abs_error += (true_offset < 0) ? -true_offset : true_offset;
+        }
+        out = filter.update(true_offset + noise, interval);
+        ASSERT_FALSE(out.stepped);
+        true_offset -= out.phase_usec + out.drift_usec;     // Nothing to apply if rejected
+    }
+    ASSERT_GT(10, sum_abs_error / 100);
+    ASSERT_NEAR(50.0F, filter.getRateAdjustmentPPM(), 5.0F);
+
+    /*
+     * A single spike is rejected, a persistent offset is not
+     */
+    const uint32_t num_rejected = filter.getNumRejectedOffsets();
+    out = filter.update(5000, interval);
+    ASSERT_TRUE(out.rejected);
+    ASSERT_EQ(0, out.phase_usec);
+    ASSERT_EQ(num_rejected + 1, filter.getNumRejectedOffsets());
+    for (int i = 0; i < 2; i++)
+    {
+        ASSERT_TRUE(filter.update(5000, interval).rejected);
+    }
+    out = filter.update(5000, interval);
+    ASSERT_FALSE(out.rejected);
+    ASSERT_LT(0, out.phase_usec);
+    ASSERT_EQ(num_rejected + 3, filter.getNumRejectedOffsets());
+
+    /*
+     * A large offset is a step
+     */
+    out = filter.update(-20000, interval);
+    ASSERT_TRUE(out.stepped);
+    ASSERT_EQ(-20000, out.phase_usec);
+    ASSERT_FLOAT_EQ(0.0F, filter.getRateAdjustmentPPM());
+
+    filter.reset();
+    ASSERT_FALSE(filter.isLocked());
+}
+
+
+TEST(GlobalTimeSyncSlave, FilteredAdjustment)
+{
+    InterlinkedTestNodesWithClockMock nodes(64, 65);
+
+    SystemClockMock& slave_clock = nodes.clock_a;
+    SystemClockMock& master_clock = nodes.clock_b;
+
+    slave_clock.advance(1000000);
+    master_clock.advance(1000000);
+
+    master_clock.monotonic_auto_advance = slave_clock.monotonic_auto_advance = 1000;
+    master_clock.preserve_utc = slave_clock.preserve_utc = true;
+    slave_clock.utc = 0;
+    master_clock.utc = 1000000000;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GlobalTimeSync> _reg1;
+
+    uavcan::GlobalTimeSyncSlave gtss(nodes.a);
+    uavcan::Publisher<uavcan::protocol::GlobalTimeSync> gts_pub(nodes.b);
+
+    ASSERT_LE(0, gtss.start());
+    ASSERT_FALSE(gtss.isFilterEnabled());
+    gtss.enableFilter(true);
+    ASSERT_TRUE(gtss.isFilterEnabled());
+
+    /*
+     * Update, then adjust; the initial offset is applied at once
+     */
+    uavcan::protocol::GlobalTimeSync gts;
+    gts.previous_transmission_timestamp_usec = 0;
+    for (int i = 0; i < 2; i++)
+    {
+        ASSERT_LE(0, gts_pub.broadcast(gts));
+        gts.previous_transmission_timestamp_usec = master_clock.utc;
+        ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration()));
+    }
+    ASSERT_TRUE(gtss.isActive());
+    ASSERT_TRUE(gtss.getFilter().isLocked());
+    ASSERT_EQ(master_clock.utc, slave_clock.utc);
+
+    /*
+     * Update, then adjust; a small offset is applied partially
+     */
+    master_clock.utc += 50;
+    for (int i = 0; i < 2; i++)
+    {
+        ASSERT_LE(0, gts_pub.broadcast(gts));
+        gts.previous_transmission_timestamp_usec = master_clock.utc;
+        ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration()));
+    }
+    ASSERT_LT(master_clock.utc - 50, slave_clock.utc);
+    ASSERT_GT(master_clock.utc, slave_clock.utc);
+
+    gtss.enableFilter(false);
+    ASSERT_FALSE(gtss.getFilter().isLocked());
+}
+
+
+TEST(GlobalTimeSyncSlave, Failover)
+{
+    SystemClockMock slave_clock;
+    slave_clock.monotonic = 1000000;
+    slave_clock.preserve_utc = true;
+
+    CanDriverMock slave_can(1, slave_clock);
+    slave_can.ifaces.at(0).enable_utc_timestamping = true;
+
+    TestNode node(slave_can, slave_clock, 64);
+
+    uavcan::GlobalTimeSyncSlave gtss(node);
+    ASSERT_LE(0, gtss.start());
+    gtss.enableFilter(true);
+    ASSERT_FALSE(gtss.getMasterFailoverTimeout().isPositive());
+    gtss.setMasterFailoverTimeout(uavcan::MonotonicDuration::fromMSec(300));
+    ASSERT_EQ(300, gtss.getMasterFailoverTimeout().toMSec());
+
+    broadcastSyncMsg(slave_can.ifaces.at(0), 0, 8, 0);    // Update
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+    broadcastSyncMsg(slave_can.ifaces.at(0), 1000, 8, 1); // Adjust, applied at once
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+
+    ASSERT_EQ(8, gtss.getMasterNodeID().get());
+    ASSERT_EQ(1000, slave_clock.utc);
+    ASSERT_TRUE(gtss.getFilter().isLocked());
+
+    /*
+     * The standby master is ignored while the active one is alive
+     */
+    slave_clock.monotonic += 100000;
+    broadcastSyncMsg(slave_can.ifaces.at(0), 0, 9, 0);
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_EQ(8, gtss.getMasterNodeID().get());
+
+    /*
+     * The active master has been silent for longer than the failover timeout - the standby one is taken at once,
+     * long before the broadcaster timeout; the filter is not reset
+     */
+    slave_clock.monotonic += 400000;
+    broadcastSyncMsg(slave_can.ifaces.at(0), 0, 9, 1);
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_EQ(9, gtss.getMasterNodeID().get());
+    ASSERT_TRUE(gtss.getFilter().isLocked());
+
+    // The lost master is back; it has higher priority, so it is switched to, as usual
+    broadcastSyncMsg(slave_can.ifaces.at(0), 0, 8, 2);
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_EQ(8, gtss.getMasterNodeID().get());
+    ASSERT_FALSE(gtss.getFilter().isLocked());
+}
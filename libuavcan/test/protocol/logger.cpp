@@ -2,6 +2,8 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <string>
+#include <vector>
 #include <gtest/gtest.h>
 #include <uavcan/protocol/logger.hpp>
 #include "helpers.hpp"
@@ -117,6 +119,90 @@ TEST(Logger, Basic)
     ASSERT_TRUE(sink.popMatchByLevelAndText(uavcan::protocol::debug::LogLevel::DEBUG,   "foo", "Debug"));
 }
 
+TEST(Logger, Buffering)
+{
+    using uavcan::protocol::debug::LogLevel;
+    using uavcan::protocol::debug::LogMessage;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<LogMessage> _reg1;
+
+    uavcan::Logger logger(nodes.a);
+    ASSERT_LE(0, logger.init());
+    logger.setLevel(LogLevel::INFO);
+
+    LogSink sink;
+    sink.level = LogLevel::DEBUG;
+    logger.setExternalSink(&sink);
+
+    std::vector<std::string> received;
+    uavcan::Subscriber<LogMessage> log_sub(nodes.b);
+    ASSERT_LE(0, log_sub.start([&](const LogMessage& msg) { received.push_back(msg.text.c_str()); }));
+
+    uavcan::Logger::BufferEntry buffer[3];
+    ASSERT_GT(0, logger.enableBuffering(buffer, 0));
+    ASSERT_FALSE(logger.isBufferingEnabled());
+    ASSERT_LE(0, logger.enableBuffering(buffer, 3, uavcan::MonotonicDuration::fromMSec(20), 2));
+    ASSERT_TRUE(logger.isBufferingEnabled());
+
+    /*
+     * The sink is invoked right away, the broadcasting is deferred; repetitions are aggregated
+     */
+    ASSERT_EQ(0, logger.logInfo("foo", "A"));
+    ASSERT_EQ(0, logger.logInfo("foo", "B"));
+    ASSERT_EQ(0, logger.logInfo("foo", "B"));
+    ASSERT_EQ(0, logger.logInfo("foo", "B"));
+    ASSERT_EQ(0, logger.logDebug("foo", "Not broadcast"));
+    ASSERT_EQ(0, logger.logInfo("foo", "C"));
+    ASSERT_EQ(6, sink.msgs.size());
+    ASSERT_EQ(3, logger.getNumBufferedMessages());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(5));
+    ASSERT_TRUE(received.empty());
+
+    // Two messages per flush, the repetition notice doesn't count
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(20));
+    ASSERT_EQ(3, received.size());
+    ASSERT_EQ("A", received.at(0));
+    ASSERT_EQ("B", received.at(1));
+    ASSERT_EQ("Last message repeated 2 times", received.at(2));
+    ASSERT_EQ(1, logger.getNumBufferedMessages());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(20));
+    ASSERT_EQ(4, received.size());
+    ASSERT_EQ("C", received.at(3));
+    ASSERT_EQ(0, logger.getNumBufferedMessages());
+
+    /*
+     * Overflow drops the oldest messages
+     */
+    received.clear();
+    ASSERT_EQ(0, logger.logInfo("foo", "1"));
+    ASSERT_EQ(0, logger.logInfo("foo", "2"));
+    ASSERT_EQ(0, logger.logInfo("foo", "3"));
+    ASSERT_EQ(0, logger.logInfo("foo", "4"));
+    ASSERT_EQ(1, logger.getNumDroppedMessages());
+    ASSERT_EQ(3, logger.flush());
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(5));
+    ASSERT_EQ(3, received.size());
+    ASSERT_EQ("2", received.at(0));
+    ASSERT_EQ("4", received.at(2));
+
+    /*
+     * Back to immediate broadcasting
+     */
+    received.clear();
+    ASSERT_EQ(0, logger.logInfo("foo", "Lost"));
+    logger.disableBuffering();
+    ASSERT_EQ(0, logger.getNumBufferedMessages());
+    ASSERT_LE(0, logger.logInfo("foo", "Immediate"));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(5));
+    ASSERT_EQ(1, received.size());
+    ASSERT_EQ("Immediate", received.at(0));
+}
+
 #if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
 # error UAVCAN_CPP_VERSION
 #endif
@@ -141,4 +227,85 @@ TEST(Logger, Cpp11Formatting)
     ASSERT_EQ(log_sub.collector.msg->text, "char='$', double is 12.34");
 }
 
+TEST(Logger, DeferredFormatting)
+{
+    using uavcan::protocol::debug::LogLevel;
+    using uavcan::protocol::debug::LogMessage;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<LogMessage> _reg1;
+
+    uavcan::Logger logger(nodes.a);
+    ASSERT_LE(0, logger.init());
+    logger.setLevel(LogLevel::INFO);
+
+    LogSink sink;
+    sink.level = LogLevel::DEBUG;
+    logger.setExternalSink(&sink);
+
+    std::vector<std::string> received;
+    uavcan::Subscriber<LogMessage> log_sub(nodes.b);
+    ASSERT_LE(0, log_sub.start([&](const LogMessage& msg) { received.push_back(msg.text.c_str()); }));
+
+    uint8_t ring[300];
+    ASSERT_GT(0, logger.enableDeferredFormatting(ring, uavcan::Logger::MaxDeferredRecordSize - 1));
+    ASSERT_FALSE(logger.isDeferredFormattingEnabled());
+    ASSERT_LE(0, logger.enableDeferredFormatting(ring, sizeof(ring), uavcan::MonotonicDuration::fromMSec(20), 2));
+    ASSERT_TRUE(logger.isDeferredFormattingEnabled());
+
+    /*
+     * Nothing is formatted or delivered until the flush; the strings are copied
+     */
+    std::string str = "string";
+    ASSERT_EQ(0, logger.logWarning("foo", "char='%*', %* is %*", '$', "double", 12.34));
+    ASSERT_EQ(0, logger.logDebug("bar", "%* %* %*%%, %* %*", -42, 42U, str.c_str(), true));
+    ASSERT_EQ(0, logger.logDebug("bar", "No arguments %*"));
+    str = "changed";
+    ASSERT_TRUE(sink.msgs.empty());
+    ASSERT_EQ(3, logger.getNumDeferredRecords());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(30));
+    ASSERT_EQ(2, sink.msgs.size());
+    ASSERT_EQ(1, logger.getNumDeferredRecords());
+    ASSERT_TRUE(sink.popMatchByLevelAndText(LogLevel::WARNING, "foo", "char='$', double is 12.34"));
+    ASSERT_TRUE(sink.popMatchByLevelAndText(LogLevel::DEBUG, "bar", "-42 42 string%, 1 %*"));
+    ASSERT_EQ(1, received.size());                      // Debug messages are not broadcast
+    ASSERT_EQ("char='$', double is 12.34", received.at(0));
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(20));
+    ASSERT_TRUE(sink.popMatchByLevelAndText(LogLevel::DEBUG, "bar", "No arguments %*"));
+    ASSERT_EQ(0, logger.getNumDeferredRecords());
+
+    /*
+     * Overflow drops the oldest records
+     */
+    received.clear();
+    sink.level = logger.getLogLevelAboveAll();
+    for (int i = 0; i < 20; i++)
+    {
+        ASSERT_EQ(0, logger.logInfo("foo", "%*", i));
+    }
+    const unsigned num_dropped = logger.getNumDroppedMessages();
+    ASSERT_LT(0, num_dropped);
+    ASSERT_EQ(20, logger.getNumDeferredRecords() + num_dropped);
+    ASSERT_EQ(20 - num_dropped, logger.flushDeferred());
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(5));
+    ASSERT_EQ(20 - num_dropped, received.size());
+    ASSERT_EQ(std::to_string(num_dropped), received.front());
+    ASSERT_EQ("19", received.back());
+
+    /*
+     * Back to immediate formatting
+     */
+    sink.level = LogLevel::DEBUG;
+    ASSERT_EQ(0, logger.logInfo("foo", "Lost"));
+    logger.disableDeferredFormatting();
+    ASSERT_EQ(0, logger.getNumDeferredRecords());
+    ASSERT_LE(0, logger.logInfo("foo", "%*", "Immediate"));
+    ASSERT_TRUE(sink.popMatchByLevelAndText(LogLevel::INFO, "foo", "Immediate"));
+    ASSERT_TRUE(sink.msgs.empty());
+}
+
 #endif
@@ -6,6 +6,7 @@
 # pragma GCC diagnostic ignored "-Wzero-as-null-pointer-constant"
 #endif
 
+#include <map>
 #include <memory>
 #include <gtest/gtest.h>
 #include <uavcan/protocol/node_info_retriever.hpp>
@@ -30,11 +31,13 @@ struct NodeInfoListener : public uavcan::INodeInfoListener
     unsigned status_message_cnt;
     unsigned status_change_cnt;
     unsigned info_unavailable_cnt;
+    unsigned batch_complete_cnt;
 
     NodeInfoListener()
         : status_message_cnt(0)
         , status_change_cnt(0)
         , info_unavailable_cnt(0)
+        , batch_complete_cnt(0)
     { }
 
     virtual void handleNodeInfoRetrieved(uavcan::NodeID node_id,
@@ -64,6 +67,11 @@ struct NodeInfoListener : public uavcan::INodeInfoListener
         std::cout << msg << std::endl;
         status_message_cnt++;
     }
+
+    virtual void handleNodeInfoBatchComplete()
+    {
+        batch_complete_cnt++;
+    }
 };
 
 
@@ -121,6 +129,7 @@ TEST(NodeInfoRetriever, Basic)
     ASSERT_EQ(2, listener.status_message_cnt);
     ASSERT_EQ(1, listener.status_change_cnt);
     ASSERT_EQ(0, listener.info_unavailable_cnt);
+    ASSERT_EQ(1, listener.batch_complete_cnt);
     ASSERT_TRUE(listener.last_node_info.get());
     ASSERT_EQ(uavcan::NodeID(2), listener.last_node_id);
     ASSERT_EQ("Ivan", listener.last_node_info->name);
@@ -289,3 +298,184 @@ TEST(NodeInfoRetriever, MaxConcurrentRequests)
     ASSERT_EQ(0, retr.getNumPendingRequests());
     ASSERT_FALSE(retr.isRetrievingInProgress());
 }
+
+
+TEST(NodeInfoRetriever, ConcurrentRequests)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::NodeInfoRetriever retr(nodes.a);
+
+    NodeInfoListener listener;
+
+    ASSERT_LE(0, retr.start());
+    retr.addListener(&listener);
+
+    /*
+     * Limits
+     */
+    ASSERT_EQ(1, retr.getMaxConcurrentRequests());      // Default
+    retr.setMaxConcurrentRequests(0);
+    ASSERT_EQ(1, retr.getMaxConcurrentRequests());
+    retr.setMaxConcurrentRequests(200);
+    ASSERT_EQ(uavcan::NodeInfoRetriever::MaxConcurrentRequests, retr.getMaxConcurrentRequests());
+
+    retr.setMaxConcurrentRequests(8);
+    retr.setNumRequestAttempts(1);
+
+    /*
+     * None of these nodes implements GetNodeInfo; the first interval issues the whole window at once
+     */
+    for (uint8_t node_id = 10U; node_id < 30U; node_id++)
+    {
+        publishNodeStatus(nodes.can_a, node_id, 10, uavcan::TransferID());
+    }
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(50));
+    ASSERT_EQ(8, retr.getNumPendingRequests());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(40));    // One per interval once the window is full
+    ASSERT_EQ(9, retr.getNumPendingRequests());
+
+    /*
+     * The unavailability notifications are followed by one batch completion per interval at most
+     */
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(2500));
+    ASSERT_FALSE(retr.isRetrievingInProgress());
+    ASSERT_EQ(0, retr.getNumPendingRequests());
+    ASSERT_EQ(20, listener.info_unavailable_cnt);
+    ASSERT_LE(1, listener.batch_complete_cnt);
+    ASSERT_GT(20, listener.batch_complete_cnt);
+}
+
+
+struct MemoryNodeInfoCache : public uavcan::INodeInfoCache
+{
+    std::map<uavcan::uint8_t, std::pair<uavcan::protocol::GetNodeInfo::Response, uavcan::UtcTime> > entries;
+    unsigned num_loads;
+    unsigned num_stores;
+
+    MemoryNodeInfoCache()
+        : num_loads(0)
+        , num_stores(0)
+    { }
+
+    virtual bool load(uavcan::NodeID node_id, uavcan::protocol::GetNodeInfo::Response& out_node_info,
+                      uavcan::UtcTime& out_retrieval_time)
+    {
+        num_loads++;
+        if (entries.count(node_id.get()) == 0)
+        {
+            return false;
+        }
+        out_node_info = entries[node_id.get()].first;
+        out_retrieval_time = entries[node_id.get()].second;
+        return true;
+    }
+
+    virtual void store(uavcan::NodeID node_id, const uavcan::protocol::GetNodeInfo::Response& node_info,
+                       uavcan::UtcTime retrieval_time)
+    {
+        num_stores++;
+        entries[node_id.get()] = std::make_pair(node_info, retrieval_time);
+    }
+
+    virtual void remove(uavcan::NodeID node_id)
+    {
+        entries.erase(node_id.get());
+    }
+};
+
+
+TEST(NodeInfoRetriever, PersistentCache)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    MemoryNodeInfoCache cache;
+    NodeInfoListener listener;
+
+    uavcan::NodeStatusProvider provider(nodes.b);
+    provider.setName("Ivan");
+    ASSERT_LE(0, provider.startAndPublish());
+
+    /*
+     * The first run populates the cache
+     */
+    std::unique_ptr<uavcan::NodeInfoRetriever> retr(new uavcan::NodeInfoRetriever(nodes.a));
+    ASSERT_FALSE(retr->getCache());
+    retr->setCache(&cache);
+    ASSERT_EQ(&cache, retr->getCache());
+    ASSERT_LE(0, retr->start());
+    retr->addListener(&listener);
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1500));
+    ASSERT_FALSE(retr->isRetrievingInProgress());
+    ASSERT_EQ(0, retr->getNumCacheHits());
+    ASSERT_EQ(1, cache.num_loads);                      // Nothing there yet
+    ASSERT_EQ(1, cache.num_stores);
+    ASSERT_EQ(1, cache.entries.count(2));
+    ASSERT_EQ("Ivan", cache.entries[2].first.name);
+    ASSERT_FALSE(cache.entries[2].second.isZero());
+
+    /*
+     * Restarting the retriever; the node keeps running, so it is served from the cache without a request
+     */
+    retr.reset(new uavcan::NodeInfoRetriever(nodes.a));
+    retr->setCache(&cache);
+    ASSERT_LE(0, retr->start());
+    retr->addListener(&listener);
+    listener.last_node_info.reset();
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1500));
+    ASSERT_FALSE(retr->isRetrievingInProgress());
+    ASSERT_EQ(0, retr->getNumPendingRequests());
+    ASSERT_EQ(1, retr->getNumCacheHits());
+    ASSERT_EQ(2, cache.num_loads);
+    ASSERT_EQ(1, cache.num_stores);                     // Not queried
+    ASSERT_TRUE(listener.last_node_info.get());
+    ASSERT_EQ(uavcan::NodeID(2), listener.last_node_id);
+    ASSERT_EQ("Ivan", listener.last_node_info->name);
+
+    /*
+     * The cached uptime is longer than the current one, hence the node has restarted and must be queried again
+     */
+    cache.entries[2].first.status.uptime_sec = 1000;
+
+    retr.reset(new uavcan::NodeInfoRetriever(nodes.a));
+    retr->setCache(&cache);
+    ASSERT_LE(0, retr->start());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1500));
+    ASSERT_FALSE(retr->isRetrievingInProgress());
+    ASSERT_EQ(0, retr->getNumCacheHits());
+    ASSERT_EQ(3, cache.num_loads);
+    ASSERT_EQ(2, cache.num_stores);
+    ASSERT_GT(1000, cache.entries[2].first.status.uptime_sec);
+
+    /*
+     * Same if the cached retrieval time is so old that the node would have a much longer uptime by now
+     */
+    cache.entries[2].second -= uavcan::UtcDuration::fromMSec(3600 * 1000);
+
+    retr.reset(new uavcan::NodeInfoRetriever(nodes.a));
+    retr->setCache(&cache);
+    ASSERT_LE(0, retr->start());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1500));
+    ASSERT_EQ(0, retr->getNumCacheHits());
+    ASSERT_EQ(3, cache.num_stores);
+
+    /*
+     * Invalidation clears the cache
+     */
+    retr->invalidateAll();
+    ASSERT_TRUE(cache.entries.empty());
+}
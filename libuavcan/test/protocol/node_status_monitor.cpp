@@ -174,3 +174,118 @@ TEST(NodeStatusMonitor, Basic)
     ASSERT_EQ(NodeStatus::MODE_OFFLINE, nsm.getNodeStatus(uavcan::NodeID(9)).mode);
     ASSERT_EQ(NodeStatus::HEALTH_CRITICAL, nsm.getNodeStatus(uavcan::NodeID(9)).health);
 }
+
+
+TEST(NodeStatusMonitor, Deadlines)
+{
+    using uavcan::protocol::NodeStatus;
+    using uavcan::NodeID;
+
+    SystemClockMock clock_mock(100);
+    clock_mock.monotonic_auto_advance = 1000;
+
+    CanDriverMock can(2, clock_mock);
+
+    TestNode node(can, clock_mock, 64);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+
+    uavcan::NodeStatusMonitor nsm(node);
+    ASSERT_LE(0, nsm.start());
+
+    /*
+     * Each node times out independently, after the offline timeout since its own last message
+     */
+    publishNodeStatus(can, 10, NodeStatus::HEALTH_OK, NodeStatus::MODE_OPERATIONAL, 1, 0);
+    shortSpin(node);
+
+    clock_mock.advance(2500000);
+    shortSpin(node);
+    publishNodeStatus(can, 20, NodeStatus::HEALTH_OK, NodeStatus::MODE_OPERATIONAL, 1, 0);
+    shortSpin(node);
+    ASSERT_EQ(2, nsm.getOnlineNodes().getSize());
+
+    clock_mock.advance(600000);
+    shortSpin(node);
+    ASSERT_EQ(NodeStatus::MODE_OFFLINE, nsm.getNodeStatus(NodeID(10)).mode);
+    ASSERT_EQ(NodeStatus::MODE_OPERATIONAL, nsm.getNodeStatus(NodeID(20)).mode);
+
+    // Node 20 keeps publishing, so it stays online
+    for (uavcan::uint8_t i = 1; i <= 5; i++)
+    {
+        clock_mock.advance(1000000);
+        publishNodeStatus(can, 20, NodeStatus::HEALTH_OK, NodeStatus::MODE_OPERATIONAL, 1, i);
+        shortSpin(node);
+        ASSERT_EQ(NodeStatus::MODE_OPERATIONAL, nsm.getNodeStatus(NodeID(20)).mode);
+    }
+
+    clock_mock.advance(2900000);
+    shortSpin(node);
+    ASSERT_EQ(NodeStatus::MODE_OPERATIONAL, nsm.getNodeStatus(NodeID(20)).mode);
+
+    clock_mock.advance(200000);
+    shortSpin(node);
+    ASSERT_EQ(NodeStatus::MODE_OFFLINE, nsm.getNodeStatus(NodeID(20)).mode);
+    ASSERT_TRUE(nsm.getOnlineNodes().isEmpty());
+    ASSERT_EQ(2, nsm.getOfflineNodes().getSize());
+
+    /*
+     * A node that comes back online is tracked again
+     */
+    publishNodeStatus(can, 10, NodeStatus::HEALTH_WARNING, NodeStatus::MODE_OPERATIONAL, 1, 1);
+    shortSpin(node);
+    ASSERT_EQ(NodeStatus::MODE_OPERATIONAL, nsm.getNodeStatus(NodeID(10)).mode);
+
+    clock_mock.advance(3100000);
+    shortSpin(node);
+    ASSERT_EQ(NodeStatus::MODE_OFFLINE, nsm.getNodeStatus(NodeID(10)).mode);
+}
+
+
+TEST(NodeStatusMonitor, RxStateReclaim)
+{
+    using uavcan::protocol::NodeStatus;
+    using uavcan::NodeID;
+
+    SystemClockMock clock_mock(100);
+    clock_mock.monotonic_auto_advance = 1000;
+
+    CanDriverMock can(2, clock_mock);
+
+    TestNode node(can, clock_mock, 64);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+
+    uavcan::NodeStatusMonitor nsm(node);
+    ASSERT_LE(0, nsm.start());
+    ASSERT_TRUE(nsm.isRxStateReclaimEnabled());
+
+    publishNodeStatus(can, 10, NodeStatus::HEALTH_OK, NodeStatus::MODE_OPERATIONAL, 1, 0);
+    shortSpin(node);
+    const unsigned num_blocks = node.pool.getNumAllocatedBlocks();
+
+    /*
+     * The receiver is released as soon as the node goes offline, long before it would have timed out
+     */
+    publishNodeStatus(can, 10, NodeStatus::HEALTH_OK, NodeStatus::MODE_OFFLINE, 1, 1);
+    shortSpin(node);
+    ASSERT_EQ(NodeStatus::MODE_OFFLINE, nsm.getNodeStatus(NodeID(10)).mode);
+    ASSERT_GT(num_blocks, node.pool.getNumAllocatedBlocks());
+
+    // The node is received normally when it comes back
+    publishNodeStatus(can, 10, NodeStatus::HEALTH_OK, NodeStatus::MODE_OPERATIONAL, 1, 2);
+    shortSpin(node);
+    ASSERT_EQ(NodeStatus::MODE_OPERATIONAL, nsm.getNodeStatus(NodeID(10)).mode);
+    ASSERT_EQ(num_blocks, node.pool.getNumAllocatedBlocks());
+
+    /*
+     * Same with the reclaim disabled, the receiver stays until it times out
+     */
+    nsm.setRxStateReclaimEnabled(false);
+    publishNodeStatus(can, 10, NodeStatus::HEALTH_OK, NodeStatus::MODE_OFFLINE, 1, 3);
+    shortSpin(node);
+    ASSERT_EQ(NodeStatus::MODE_OFFLINE, nsm.getNodeStatus(NodeID(10)).mode);
+    ASSERT_EQ(num_blocks, node.pool.getNumAllocatedBlocks());
+}
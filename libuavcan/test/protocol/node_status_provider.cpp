@@ -148,3 +148,66 @@ TEST(NodeStatusProvider, Basic)
     EXPECT_EQ(1, ad_hoc.invokations);   // No timer-triggered publications happened yet
     EXPECT_EQ(4, nodes.a.getDispatcher().getTransferPerfCounter().getTxTransferCount());
 }
+
+
+TEST(NodeStatusProvider, AdaptivePublication)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+
+    uavcan::NodeStatusProvider nsp(nodes.a);
+    nsp.setName("adaptive");
+
+    ASSERT_FALSE(nsp.isAdaptivePublicationEnabled());
+    nsp.enableAdaptivePublication(true);
+    ASSERT_TRUE(nsp.isAdaptivePublicationEnabled());
+
+    nsp.setHealthWarning();                 // Not started yet, nothing to publish
+    ASSERT_EQ(0, nodes.a.getDispatcher().getTransferPerfCounter().getTxTransferCount());
+
+    ASSERT_LE(0, nsp.startAndPublish());
+    nsp.setStatusPublicationPeriod(uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_EQ(1, nodes.a.getDispatcher().getTransferPerfCounter().getTxTransferCount());
+
+    SubscriberWithCollector<uavcan::protocol::NodeStatus> status_sub(nodes.b);
+    ASSERT_LE(0, status_sub.start());
+
+    /*
+     * The status doesn't change, so the period grows: 100, 200, 400, 800, 1000, 1000 ms...
+     * That's 5 publications within 2.5 seconds, whereas the configured rate would yield 25.
+     */
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(2550));
+    const uavcan::uint64_t num_periodic = nodes.a.getDispatcher().getTransferPerfCounter().getTxTransferCount() - 1;
+    ASSERT_LE(4, num_periodic);
+    ASSERT_GE(5, num_periodic);
+    ASSERT_EQ(uavcan::MonotonicDuration::fromMSec(100), nsp.getStatusPublicationPeriod());
+
+    /*
+     * A change is published immediately
+     */
+    nsp.setModeOperational();
+    ASSERT_EQ(num_periodic + 2, nodes.a.getDispatcher().getTransferPerfCounter().getTxTransferCount());
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(status_sub.collector.msg.get());
+    ASSERT_EQ(uavcan::protocol::NodeStatus::MODE_OPERATIONAL, status_sub.collector.msg->mode);
+    ASSERT_EQ(uavcan::protocol::NodeStatus::HEALTH_WARNING, status_sub.collector.msg->health);
+
+    nsp.setModeOperational();               // Same value, no publication
+    ASSERT_EQ(num_periodic + 2, nodes.a.getDispatcher().getTransferPerfCounter().getTxTransferCount());
+
+    // Then the configured period is used again
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(150));
+    ASSERT_EQ(num_periodic + 3, nodes.a.getDispatcher().getTransferPerfCounter().getTxTransferCount());
+
+    /*
+     * Back to the fixed rate
+     */
+    nsp.enableAdaptivePublication(false);
+    nsp.setHealthOk();
+    ASSERT_EQ(num_periodic + 3, nodes.a.getDispatcher().getTransferPerfCounter().getTxTransferCount());
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1050));
+    ASSERT_LE(num_periodic + 12, nodes.a.getDispatcher().getTransferPerfCounter().getTxTransferCount());
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#if __GNUC__
+# pragma GCC diagnostic ignored "-Wzero-as-null-pointer-constant"
+#endif
+
+#include <memory>
+#include <gtest/gtest.h>
+#include <uavcan/protocol/node_table_snapshot.hpp>
+#include <uavcan/protocol/node_status_provider.hpp>
+#include "helpers.hpp"
+
+
+TEST(NodeTableSnapshot, Basic)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::NodeInfoRetriever retr(nodes.a);
+    std::unique_ptr<uavcan::NodeStatusProvider> provider(new uavcan::NodeStatusProvider(nodes.b));
+
+    std::unique_ptr<uavcan::NodeTableSnapshot> snapshot(new uavcan::NodeTableSnapshot);
+    std::cout << "sizeof(uavcan::NodeTableSnapshot): " << sizeof(uavcan::NodeTableSnapshot) << std::endl;
+
+    ASSERT_LE(0, retr.start());
+    retr.addListener(snapshot.get());
+
+    uavcan::protocol::HardwareVersion hwver;
+    hwver.unique_id[0] = 123;
+    hwver.unique_id[15] = 45;
+    provider->setName("Ivan");
+    provider->setHardwareVersion(hwver);
+    provider->setVendorSpecificStatusCode(1234);
+    provider->setModeOperational();
+    ASSERT_LE(0, provider->startAndPublish());
+
+    uavcan::NodeTableSnapshot::NodeEntry entry;
+    ASSERT_FALSE(snapshot->getNode(2, entry));
+    ASSERT_EQ(0, snapshot->getGeneration());
+    ASSERT_EQ(0, snapshot->getNodeGeneration(2));
+    ASSERT_EQ(uavcan::protocol::NodeStatus::MODE_OFFLINE, snapshot->getNodeStatus(2).mode);
+
+    /*
+     * Discovery and node info retrieval
+     */
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1500));
+    ASSERT_FALSE(retr.isRetrievingInProgress());
+
+    ASSERT_TRUE(snapshot->getNode(2, entry));
+    ASSERT_TRUE(entry.status == retr.getNodeStatus(2));
+    ASSERT_EQ(uavcan::protocol::NodeStatus::MODE_OPERATIONAL, entry.status.mode);
+    ASSERT_EQ(1234, entry.vendor_specific_status_code);
+    ASSERT_FALSE(entry.last_status_ts.isZero());
+    ASSERT_TRUE(entry.info_available);
+    ASSERT_FALSE(entry.info_unavailable);
+    ASSERT_STREQ("Ivan", entry.name);
+    ASSERT_EQ(123, entry.unique_id[0]);
+    ASSERT_EQ(45, entry.unique_id[15]);
+
+    ASSERT_FALSE(snapshot->getNode(3, entry));
+    ASSERT_LT(0, snapshot->getNodeGeneration(2));
+    ASSERT_EQ(snapshot->getNodeGeneration(2), snapshot->getGeneration());
+
+    /*
+     * Status messages update the entry, the node info is kept
+     */
+    const uavcan::uint32_t generation = snapshot->getGeneration();
+    const uavcan::MonotonicTime last_status_ts = entry.last_status_ts;
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1100));
+    ASSERT_LT(generation, snapshot->getGeneration());
+    ASSERT_TRUE(snapshot->getNode(2, entry));
+    ASSERT_LT(last_status_ts, entry.last_status_ts);
+    ASSERT_STREQ("Ivan", entry.name);
+
+    /*
+     * Timeout
+     */
+    provider.reset();
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(5000));
+    ASSERT_EQ(uavcan::protocol::NodeStatus::MODE_OFFLINE, retr.getNodeStatus(2).mode);
+    ASSERT_TRUE(snapshot->getNode(2, entry));
+    ASSERT_EQ(uavcan::protocol::NodeStatus::MODE_OFFLINE, entry.status.mode);
+    ASSERT_EQ(uavcan::protocol::NodeStatus::MODE_OFFLINE, snapshot->getNodeStatus(2).mode);
+    ASSERT_TRUE(entry.info_available);
+
+    retr.removeListener(snapshot.get());
+}
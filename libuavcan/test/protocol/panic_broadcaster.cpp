@@ -46,3 +46,59 @@ TEST(PanicBroadcaster, Basic)
     nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(300));
     ASSERT_FALSE(sub.collector.msg.get());
 }
+
+
+TEST(PanicBroadcaster, Emergency)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::Panic> _reg1;
+
+    SystemClockMock clock;
+    CanDriverMock driver(2, clock);
+    driver.ifaces.at(0).emergency_supported = true;
+    TestNode node(driver, clock, 42);
+
+    uavcan::PanicBroadcaster panicker(node);
+
+    ASSERT_FALSE(panicker.isEmergencyPrepared());
+    ASSERT_EQ(0, panicker.triggerEmergency());
+
+    ASSERT_LE(0, panicker.prepareEmergency("I lost my towel!"));
+    ASSERT_TRUE(panicker.isEmergencyPrepared());
+    ASSERT_FALSE(panicker.isPanicking());           // Nothing is sent until triggered
+
+    /*
+     * The frames go out even though the interfaces are not writeable; the second one doesn't support this
+     */
+    driver.ifaces.at(0).writeable = false;
+    for (uint8_t i = 0; i < 40; i++)
+    {
+        ASSERT_EQ(1, panicker.triggerEmergency());
+        ASSERT_EQ(1, driver.ifaces.at(0).tx.size());
+
+        uavcan::Frame frame;
+        ASSERT_TRUE(frame.parse(driver.ifaces.at(0).popTxFrame()));
+        ASSERT_EQ(uavcan::protocol::Panic::DefaultDataTypeID, frame.getDataTypeID().get());
+        ASSERT_EQ(uavcan::TransferTypeMessageBroadcast, frame.getTransferType());
+        ASSERT_EQ(42, frame.getSrcNodeID().get());
+        ASSERT_EQ(uavcan::TransferPriority::NumericallyMin, frame.getPriority().get());
+        ASSERT_TRUE(frame.isStartOfTransfer());
+        ASSERT_TRUE(frame.isEndOfTransfer());
+        ASSERT_EQ(i % 32U, frame.getTransferID().get());
+        ASSERT_EQ(std::string("I lost "),
+                  std::string(reinterpret_cast<const char*>(frame.getPayloadPtr()), frame.getPayloadLen()));
+    }
+    ASSERT_TRUE(driver.ifaces.at(1).tx.empty());
+    ASSERT_EQ(40, driver.ifaces.at(0).num_emergency_frames);
+
+    /*
+     * Errors
+     */
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    ASSERT_EQ(-uavcan::ErrUnknownDataType, panicker.prepareEmergency("X"));
+
+    TestNode passive_node(driver, clock, uavcan::NodeID());
+    uavcan::PanicBroadcaster passive_panicker(passive_node);
+    ASSERT_EQ(-uavcan::ErrPassiveMode, passive_panicker.prepareEmergency("X"));
+    ASSERT_EQ(0, passive_panicker.triggerEmergency());
+}
@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <uavcan/protocol/param_log_storage.hpp>
+#include "helpers.hpp"
+
+namespace
+{
+
+class FlashMock : public uavcan::IParamFlash
+{
+public:
+    enum { NumRecords = 10 };
+    enum
+    {
+        SectorSize = uavcan::ParamLogStorageBase::HeaderSize + uavcan::ParamLogStorageBase::RecordSize * NumRecords
+    };
+
+    std::vector<uint8_t> sectors[NumSectors];
+    unsigned num_writes;
+    unsigned num_erasures;
+
+    FlashMock()
+        : num_writes(0)
+        , num_erasures(0)
+    {
+        for (unsigned i = 0; i < NumSectors; i++)
+        {
+            sectors[i].assign(SectorSize, 0xFF);
+        }
+    }
+
+    virtual uint32_t getSectorSize() const { return SectorSize; }
+
+    virtual int read(uint8_t sector, uint32_t offset, uint8_t* data, uint16_t size)
+    {
+        if ((sector >= NumSectors) || ((offset + size) > SectorSize))
+        {
+            return -1;
+        }
+        std::copy(sectors[sector].begin() + offset, sectors[sector].begin() + offset + size, data);
+        return 0;
+    }
+
+    virtual int write(uint8_t sector, uint32_t offset, const uint8_t* data, uint16_t size)
+    {
+        if ((sector >= NumSectors) || ((offset + size) > SectorSize))
+        {
+            return -1;
+        }
+        for (unsigned i = 0; i < size; i++)
+        {
+            EXPECT_EQ(0xFF, sectors[sector][offset + i]);      // Writing over the programmed bytes
+            sectors[sector][offset + i] &= data[i];
+        }
+        num_writes++;
+        return 0;
+    }
+
+    virtual int erase(uint8_t sector)
+    {
+        if (sector >= NumSectors)
+        {
+            return -1;
+        }
+        sectors[sector].assign(SectorSize, 0xFF);
+        num_erasures++;
+        return 0;
+    }
+};
+
+int32_t mode = 0;
+float gain = 0.0F;
+bool enabled = false;
+int32_t count = 0;
+
+const uavcan::ParamRegistryEntry test_params[] =
+{
+    uavcan::ParamRegistryEntry::integer("ctl.mode", &mode, 1, 0, 3),
+    uavcan::ParamRegistryEntry::real("ctl.gain", &gain, 1.5F, -10.0F, 10.0F),
+    uavcan::ParamRegistryEntry::boolean("enabled", &enabled, true),
+    uavcan::ParamRegistryEntry::integer("a.count", &count, 42, -100, 100)
+};
+
+class TestParamManager : public uavcan::ParamRegistry<4>
+{
+public:
+    uavcan::ParamLogStorage<4> storage;
+
+    TestParamManager(uavcan::INode& node, uavcan::IParamFlash& flash)
+        : uavcan::ParamRegistry<4>(test_params)
+        , storage(node, flash, *this)
+    { }
+
+    virtual int saveAllParams() { return storage.save(); }
+    virtual int eraseAllParams() { return storage.erase(); }
+};
+
+}
+
+TEST(ParamLogStorage, Basic)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+    FlashMock flash;
+
+    /*
+     * Blank flash
+     */
+    {
+        TestParamManager mgr(nodes.a, flash);
+        ASSERT_EQ(0, mgr.storage.init());
+        ASSERT_EQ(1, mode);
+        ASSERT_FLOAT_EQ(1.5F, gain);
+        ASSERT_TRUE(enabled);
+        ASSERT_EQ(42, count);
+        ASSERT_EQ(0, mgr.storage.getActiveSector());
+        ASSERT_EQ(1, mgr.storage.getGeneration());
+        ASSERT_EQ(FlashMock::NumRecords, mgr.storage.getNumFreeRecords());
+
+        // Nothing has changed, nothing is written
+        const unsigned num_writes = flash.num_writes;
+        ASSERT_EQ(0, mgr.saveAllParams());
+        ASSERT_EQ(num_writes, flash.num_writes);
+
+        // Only the changed parameters are written
+        mode = 2;
+        gain = -3.25F;
+        ASSERT_EQ(2, mgr.saveAllParams());
+        ASSERT_EQ(num_writes + 2, flash.num_writes);
+        ASSERT_EQ(FlashMock::NumRecords - 2, mgr.storage.getNumFreeRecords());
+        ASSERT_EQ(0, mgr.saveAllParams());
+
+        mode = 3;
+        ASSERT_EQ(1, mgr.saveAllParams());
+    }
+
+    /*
+     * Replaying the log
+     */
+    mode = 0;
+    gain = 0.0F;
+    {
+        TestParamManager mgr(nodes.a, flash);
+        ASSERT_EQ(0, mgr.storage.init());
+        ASSERT_EQ(3, mode);
+        ASSERT_FLOAT_EQ(-3.25F, gain);
+        ASSERT_TRUE(enabled);
+        ASSERT_EQ(42, count);
+        ASSERT_EQ(FlashMock::NumRecords - 3, mgr.storage.getNumFreeRecords());
+        ASSERT_EQ(0, mgr.storage.getNumCorruptedRecords());
+
+        ASSERT_EQ(0, mgr.eraseAllParams());
+        ASSERT_EQ(FlashMock::NumRecords, mgr.storage.getNumFreeRecords());
+    }
+
+    /*
+     * Erased - the defaults are loaded
+     */
+    {
+        TestParamManager mgr(nodes.a, flash);
+        ASSERT_EQ(0, mgr.storage.init());
+        ASSERT_EQ(1, mode);
+        ASSERT_FLOAT_EQ(1.5F, gain);
+    }
+
+    /*
+     * The sectors must hold at least twice the parameter set
+     */
+    {
+        struct SmallFlashMock : public FlashMock
+        {
+            virtual uint32_t getSectorSize() const
+            {
+                return uavcan::ParamLogStorageBase::HeaderSize + uavcan::ParamLogStorageBase::RecordSize * 7;
+            }
+        } small_flash;
+        TestParamManager mgr(nodes.a, small_flash);
+        ASSERT_EQ(-uavcan::ErrInvalidParam, mgr.storage.init());
+    }
+}
+
+TEST(ParamLogStorage, Compaction)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+    FlashMock flash;
+
+    TestParamManager mgr(nodes.a, flash);
+    ASSERT_EQ(0, mgr.storage.init());
+
+    count = 0;
+    ASSERT_EQ(1, mgr.saveAllParams());
+
+    // The compaction starts once there's no room for the full parameter set
+    for (int i = 1; i <= 6; i++)
+    {
+        count = i;
+        ASSERT_EQ(1, mgr.saveAllParams());
+        ASSERT_EQ(i >= 6, mgr.storage.isCompacting());
+    }
+    ASSERT_EQ(FlashMock::NumRecords - 7, mgr.storage.getNumFreeRecords());
+    ASSERT_EQ(0, mgr.storage.getActiveSector());
+
+    // It runs in the background
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_FALSE(mgr.storage.isCompacting());
+    ASSERT_EQ(1, mgr.storage.getActiveSector());
+    ASSERT_EQ(2, mgr.storage.getGeneration());
+    ASSERT_EQ(FlashMock::NumRecords - 1, mgr.storage.getNumFreeRecords());     // Only one parameter is not default
+
+    // The old sector is erased
+    ASSERT_EQ(std::vector<uint8_t>(FlashMock::SectorSize, 0xFF), flash.sectors[0]);
+
+    /*
+     * If the sector fills up before the compaction has completed, it is completed right away
+     */
+    for (int i = 1; i <= 9; i++)
+    {
+        count = -i;
+        ASSERT_EQ(1, mgr.saveAllParams());
+    }
+    ASSERT_TRUE(mgr.storage.isCompacting());
+    ASSERT_EQ(0, mgr.storage.getNumFreeRecords());
+
+    mode = 0;
+    ASSERT_EQ(1, mgr.saveAllParams());
+    ASSERT_FALSE(mgr.storage.isCompacting());
+    ASSERT_EQ(0, mgr.storage.getActiveSector());
+    ASSERT_EQ(3, mgr.storage.getGeneration());
+    ASSERT_EQ(FlashMock::NumRecords - 2, mgr.storage.getNumFreeRecords());
+
+    mode = 3;
+    count = 0;
+    {
+        TestParamManager reloaded(nodes.a, flash);
+        ASSERT_EQ(0, reloaded.storage.init());
+        ASSERT_EQ(0, mode);
+        ASSERT_EQ(-9, count);
+        ASSERT_EQ(3, reloaded.storage.getGeneration());
+    }
+}
+
+TEST(ParamLogStorage, PowerLoss)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+    FlashMock flash;
+
+    {
+        TestParamManager mgr(nodes.a, flash);
+        ASSERT_EQ(0, mgr.storage.init());
+        mode = 2;
+        ASSERT_EQ(1, mgr.saveAllParams());
+    }
+
+    /*
+     * The record that was being written is skipped, the next one is appended after it
+     */
+    const unsigned torn_offset = uavcan::ParamLogStorageBase::HeaderSize + uavcan::ParamLogStorageBase::RecordSize;
+    flash.sectors[0][torn_offset] = 0x12;
+    flash.sectors[0][torn_offset + 9] = 0x00;
+    {
+        TestParamManager mgr(nodes.a, flash);
+        ASSERT_EQ(0, mgr.storage.init());
+        ASSERT_EQ(2, mode);
+        ASSERT_EQ(1, mgr.storage.getNumCorruptedRecords());
+        ASSERT_EQ(FlashMock::NumRecords - 2, mgr.storage.getNumFreeRecords());
+
+        enabled = false;
+        ASSERT_EQ(1, mgr.saveAllParams());
+    }
+    {
+        TestParamManager mgr(nodes.a, flash);
+        ASSERT_EQ(0, mgr.storage.init());
+        ASSERT_EQ(2, mode);
+        ASSERT_FALSE(enabled);
+    }
+
+    /*
+     * The compaction was interrupted while copying - the spare sector has no header and is ignored
+     */
+    flash.sectors[1][uavcan::ParamLogStorageBase::HeaderSize] = 0x00;
+    {
+        TestParamManager mgr(nodes.a, flash);
+        ASSERT_EQ(0, mgr.storage.init());
+        ASSERT_EQ(0, mgr.storage.getActiveSector());
+        ASSERT_EQ(2, mode);
+        ASSERT_FALSE(enabled);
+
+        /*
+         * The compaction was interrupted before the old sector was erased - the newer generation wins
+         */
+        const std::vector<uint8_t> old_sector = flash.sectors[0];
+        ASSERT_EQ(0, mgr.storage.compact());
+        ASSERT_EQ(1, mgr.storage.getActiveSector());
+        mode = 1;
+        ASSERT_EQ(1, mgr.saveAllParams());
+        flash.sectors[0] = old_sector;
+    }
+    {
+        TestParamManager mgr(nodes.a, flash);
+        ASSERT_EQ(0, mgr.storage.init());
+        ASSERT_EQ(1, mgr.storage.getActiveSector());
+        ASSERT_EQ(2, mgr.storage.getGeneration());
+        ASSERT_EQ(1, mode);
+        ASSERT_FALSE(enabled);
+    }
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <uavcan/protocol/param_registry.hpp>
+#include "helpers.hpp"
+
+namespace
+{
+
+int32_t mode = 0;
+float gain = 0.0F;
+bool enabled = false;
+int32_t count = 0;
+
+const uavcan::ParamRegistryEntry test_params[] =
+{
+    uavcan::ParamRegistryEntry::integer("ctl.mode", &mode, 1, 0, 3),
+    uavcan::ParamRegistryEntry::real("ctl.gain", &gain, 1.5F, -10.0F, 10.0F),
+    uavcan::ParamRegistryEntry::boolean("enabled", &enabled, true),
+    uavcan::ParamRegistryEntry::integer("a.count", &count, 42, -100, 100)
+};
+
+class TestParamRegistry : public uavcan::ParamRegistry<4>
+{
+    virtual void handleParamAssignment(const uavcan::ParamRegistryEntry& entry)
+    {
+        assigned.push_back(entry.name);
+    }
+
+public:
+    std::vector<std::string> assigned;
+
+    TestParamRegistry() : uavcan::ParamRegistry<4>(test_params) { }
+
+    virtual int saveAllParams() { return 0; }
+    virtual int eraseAllParams() { return -1; }
+};
+
+}
+
+TEST(ParamRegistry, Basic)
+{
+    using uavcan::protocol::param::Value;
+    using uavcan::protocol::param::NumericValue;
+
+    TestParamRegistry reg;
+    reg.resetToDefaults();
+    ASSERT_EQ(1, mode);
+    ASSERT_FLOAT_EQ(1.5F, gain);
+    ASSERT_TRUE(enabled);
+    ASSERT_EQ(42, count);
+
+    /*
+     * Lookup
+     */
+    ASSERT_EQ(4, reg.getNumParams());
+    for (unsigned i = 0; i < reg.getNumParams(); i++)
+    {
+        ASSERT_EQ(&reg.getEntry(i), reg.findEntry(test_params[i].name));
+    }
+    ASSERT_FALSE(reg.findEntry("ctl"));
+    ASSERT_FALSE(reg.findEntry("ctl.modes"));
+    ASSERT_FALSE(reg.findEntry(""));
+    ASSERT_FALSE(reg.findEntry("zzz"));
+
+    TestParamRegistry::Name name;
+    reg.getParamNameByIndex(1, name);
+    ASSERT_STREQ("ctl.gain", name.c_str());
+    name.clear();
+    reg.getParamNameByIndex(4, name);
+    ASSERT_TRUE(name.empty());
+
+    /*
+     * Reading
+     */
+    Value value;
+    reg.readParamValue("ctl.mode", value);
+    ASSERT_EQ(1, value.to<Value::Tag::integer_value>());
+    reg.readParamValue("enabled", value);
+    ASSERT_TRUE(value.is(Value::Tag::boolean_value));
+
+    value = Value();
+    reg.readParamValue("nonexistent", value);
+    ASSERT_TRUE(value.is(Value::Tag::empty));
+
+    Value def;
+    NumericValue max;
+    NumericValue min;
+    reg.readParamDefaultMaxMin("ctl.gain", def, max, min);
+    ASSERT_FLOAT_EQ(1.5F, def.to<Value::Tag::real_value>());
+    ASSERT_FLOAT_EQ(10.0F, max.to<NumericValue::Tag::real_value>());
+    ASSERT_FLOAT_EQ(-10.0F, min.to<NumericValue::Tag::real_value>());
+
+    /*
+     * Assignment, clamped to the limits
+     */
+    value.to<Value::Tag::integer_value>() = 1000;
+    reg.assignParamValue("a.count", value);
+    ASSERT_EQ(100, count);
+
+    value.to<Value::Tag::integer_value>() = -3;                 // Integer to real is fine
+    reg.assignParamValue("ctl.gain", value);
+    ASSERT_FLOAT_EQ(-3.0F, gain);
+
+    value.to<Value::Tag::real_value>() = -30.0F;
+    reg.assignParamValue("ctl.gain", value);
+    ASSERT_FLOAT_EQ(-10.0F, gain);
+
+    value.to<Value::Tag::boolean_value>() = 0;
+    reg.assignParamValue("enabled", value);
+    ASSERT_FALSE(enabled);
+
+    ASSERT_EQ(4, reg.assigned.size());
+    ASSERT_EQ("a.count", reg.assigned.at(0));
+    ASSERT_EQ("enabled", reg.assigned.at(3));
+
+    // Mismatching types and unknown names are ignored
+    value.to<Value::Tag::real_value>() = 2.0F;
+    reg.assignParamValue("ctl.mode", value);
+    value.to<Value::Tag::string_value>() = "1";
+    reg.assignParamValue("enabled", value);
+    reg.assignParamValue("nonexistent", value);
+    ASSERT_EQ(1, mode);
+    ASSERT_FALSE(enabled);
+    ASSERT_EQ(4, reg.assigned.size());
+}
+
+
+TEST(ParamRegistry, PipelinedRequests)
+{
+    using uavcan::protocol::param::GetSet;
+    using uavcan::protocol::param::Value;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<GetSet> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::param::ExecuteOpcode> _reg2;
+
+    TestParamRegistry reg;
+    reg.resetToDefaults();
+
+    uavcan::ParamServer server(nodes.a);
+    ASSERT_LE(0, server.start(&reg));
+
+    /*
+     * A client may request all parameters at once without waiting for each response
+     */
+    std::vector<std::string> names;
+    uavcan::ServiceClient<GetSet> client(nodes.b, [&](const uavcan::ServiceCallResult<GetSet>& result)
+        {
+            ASSERT_TRUE(result.isSuccessful());
+            names.push_back(result.getResponse().name.c_str());
+        });
+
+    for (uint16_t i = 0; i <= reg.getNumParams(); i++)
+    {
+        GetSet::Request req;
+        req.index = i;
+        ASSERT_LE(0, client.call(1, req));
+    }
+    ASSERT_EQ(5, client.getNumPendingCalls());
+
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10)));
+
+    ASSERT_FALSE(client.hasPendingCalls());
+    ASSERT_EQ(5, names.size());
+    for (unsigned i = 0; i < reg.getNumParams(); i++)
+    {
+        ASSERT_EQ(test_params[i].name, names.at(i));
+    }
+    ASSERT_TRUE(names.at(4).empty());                           // Out of range
+}
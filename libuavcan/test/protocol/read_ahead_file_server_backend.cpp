@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <uavcan/protocol/read_ahead_file_server_backend.hpp>
+
+
+class InMemoryFileServerBackend : public uavcan::IFileServerBackend
+{
+public:
+    std::string file_data;
+    unsigned num_reads;
+    int16_t error;
+
+    InMemoryFileServerBackend()
+        : num_reads(0)
+        , error(0)
+    {
+        for (unsigned i = 0; i < 1000; i++)
+        {
+            file_data.push_back(char('a' + (i % 26)));
+        }
+    }
+
+    virtual int16_t getInfo(const Path& path, uint64_t& out_size, EntryType& out_type)
+    {
+        if (path != "fw")
+        {
+            return Error::NOT_FOUND;
+        }
+        out_size = file_data.length();
+        out_type.flags = EntryType::FLAG_FILE | EntryType::FLAG_READABLE;
+        return 0;
+    }
+
+    virtual int16_t read(const Path& path, const uint64_t offset, uint8_t* out_buffer, uint16_t& inout_size)
+    {
+        num_reads++;
+        if (error != 0)
+        {
+            return error;
+        }
+        if ((path != "fw") && (path != "fw2"))
+        {
+            return Error::NOT_FOUND;
+        }
+        const uint64_t len = (offset < file_data.length()) ? std::min<uint64_t>(file_data.length() - offset,
+                                                                                 inout_size) : 0;
+        std::memcpy(out_buffer, file_data.c_str() + offset, std::size_t(len));
+        inout_size = uint16_t(len);
+        return 0;
+    }
+
+    virtual int16_t write(const Path&, const uint64_t, const uint8_t*, const uint16_t)
+    {
+        file_data[0] = 'X';
+        return 0;
+    }
+};
+
+
+TEST(ReadAheadFileServerBackend, Basic)
+{
+    InMemoryFileServerBackend backend;
+    uavcan::ReadAheadFileServerBackend<3, 300> cache(backend);
+
+    const auto read = [&](const char* path, uint64_t offset, uint16_t size, std::string& out)
+    {
+        uint8_t buffer[256];
+        const int16_t res = cache.read(path, offset, buffer, size);
+        out.assign(reinterpret_cast<const char*>(buffer), size);
+        return res;
+    };
+
+    std::string out;
+
+    // First request loads the block it needs and the next one
+    ASSERT_EQ(0, read("fw", 0, 256, out));
+    ASSERT_EQ(backend.file_data.substr(0, 256), out);
+    ASSERT_EQ(2, backend.num_reads);
+    ASSERT_EQ(1, cache.getNumMisses());
+    ASSERT_EQ(1, cache.getNumPrefetches());
+
+    // Another requester reading the same data, then a request spanning two blocks
+    ASSERT_EQ(0, read("fw", 0, 256, out));
+    ASSERT_EQ(0, read("fw", 256, 256, out));
+    ASSERT_EQ(backend.file_data.substr(256, 256), out);
+    ASSERT_EQ(3, backend.num_reads);                        // Read-ahead of the third block
+    ASSERT_EQ(3, cache.getNumHits());
+
+    // End of file, no more read-ahead
+    ASSERT_EQ(0, read("fw", 768, 256, out));
+    ASSERT_EQ(backend.file_data.substr(768), out);
+    ASSERT_EQ(4, backend.num_reads);
+    ASSERT_EQ(0, read("fw", 1000, 256, out));
+    ASSERT_TRUE(out.empty());
+    ASSERT_EQ(4, backend.num_reads);
+
+    // Other file; the least recently used blocks are replaced
+    ASSERT_EQ(0, read("fw2", 0, 100, out));
+    ASSERT_EQ(backend.file_data.substr(0, 100), out);
+    ASSERT_EQ(6, backend.num_reads);
+    ASSERT_EQ(0, read("fw", 900, 100, out));
+    ASSERT_EQ(6, backend.num_reads);                        // The last block, used recently
+    ASSERT_EQ(0, read("fw", 0, 10, out));
+    ASSERT_EQ(8, backend.num_reads);                        // Evicted, loaded again along with the next one
+
+    // Errors are not cached
+    ASSERT_EQ(uavcan::IFileServerBackend::Error::NOT_FOUND, read("nope", 0, 10, out));
+    ASSERT_EQ(uavcan::IFileServerBackend::Error::NOT_FOUND, read("nope", 0, 10, out));
+    ASSERT_EQ(10, backend.num_reads);
+
+    // Writes invalidate the file
+    ASSERT_EQ(0, cache.write("fw", 0, reinterpret_cast<const uint8_t*>("X"), 1));
+    ASSERT_EQ(0, read("fw", 0, 10, out));
+    ASSERT_EQ("Xbcdefghij", out);
+
+    // Other operations are forwarded, with the root paths configured by the server
+    cache.setRootPath("/srv");
+    uint64_t size = 0;
+    uavcan::IFileServerBackend::EntryType type;
+    ASSERT_EQ(0, cache.getInfo("fw", size, type));
+    ASSERT_EQ(1000, size);
+    ASSERT_EQ("/srv/", backend.getRootPath());
+    ASSERT_EQ(uavcan::IFileServerBackend::Error::NOT_IMPLEMENTED, cache.remove("fw"));
+}
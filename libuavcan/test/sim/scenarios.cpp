@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ *
+ * Network-level scenarios on the simulated bus. Everything runs in virtual time, so the results are reproducible
+ * and independent of the host; they are printed and recorded as test properties (see --gtest_output=xml).
+ * The fleet sizes below are kept moderate so that the scenarios can run with every build; raise them to
+ * explore the scaling.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <gtest/gtest.h>
+#include <uavcan/protocol/dynamic_node_id_client.hpp>
+#include <uavcan/protocol/dynamic_node_id_server/centralized.hpp>
+#include <uavcan/protocol/node_info_retriever.hpp>
+#include <uavcan/protocol/node_status_provider.hpp>
+#include <uavcan/protocol/file_downloader.hpp>
+#include <uavcan/protocol/file_server.hpp>
+#include "../protocol/dynamic_node_id_server/memory_storage_backend.hpp"
+#include "sim_network.hpp"
+
+
+namespace
+{
+
+const uavcan::uint32_t Bitrate = 1000000;
+
+const unsigned NumAllocatees = 24;
+const unsigned NumDiscoveredNodes = 64;
+const unsigned NumFirmwareClients = 4;
+const unsigned FirmwareImageSize = 16384;
+
+void report(const char* name, double value, const char* unit)
+{
+    std::cout << "SIM RESULT " << name << ": " << value << " " << unit << std::endl;
+    ::testing::Test::RecordProperty(name, std::to_string(value));
+}
+
+double toSec(uavcan::MonotonicDuration d) { return double(d.toUSec()) * 1e-6; }
+
+class SilentEventTracer : public uavcan::dynamic_node_id_server::IEventTracer
+{
+    virtual void onEvent(uavcan::dynamic_node_id_server::TraceCode, uavcan::int64_t) { }
+};
+
+class FirmwareBackend : public uavcan::IFileServerBackend
+{
+public:
+    virtual uavcan::int16_t getInfo(const Path&, uavcan::uint64_t& out_size, EntryType& out_type)
+    {
+        out_size = FirmwareImageSize;
+        out_type.flags = EntryType::FLAG_FILE | EntryType::FLAG_READABLE;
+        return 0;
+    }
+
+    virtual uavcan::int16_t read(const Path&, const uavcan::uint64_t offset, uavcan::uint8_t* out_buffer,
+                                 uavcan::uint16_t& inout_size)
+    {
+        const uavcan::uint64_t len = (offset < FirmwareImageSize) ?
+                                     std::min<uavcan::uint64_t>(FirmwareImageSize - offset, inout_size) : 0;
+        for (unsigned i = 0; i < len; i++)
+        {
+            out_buffer[i] = uavcan::uint8_t(offset + i);
+        }
+        inout_size = uavcan::uint16_t(len);
+        return 0;
+    }
+};
+
+struct FirmwareSink : public uavcan::IFileDownloadSink
+{
+    uavcan::uint64_t num_bytes;
+    int result;
+    bool done;
+    uavcan::MonotonicTime completed_at;
+    const SimClock& clock;
+
+    explicit FirmwareSink(const SimClock& arg_clock)
+        : num_bytes(0)
+        , result(0)
+        , done(false)
+        , clock(arg_clock)
+    { }
+
+    virtual void handleFileData(uavcan::uint64_t offset, const uavcan::uint8_t* bytes, uavcan::uint16_t size)
+    {
+        for (unsigned i = 0; i < size; i++)
+        {
+            EXPECT_EQ(uavcan::uint8_t(offset + i), bytes[i]);
+        }
+        num_bytes += size;
+    }
+
+    virtual void handleFileDownloadCompletion(int error)
+    {
+        result = error;
+        done = true;
+        completed_at = clock.getMonotonic();
+    }
+};
+
+struct DiscoveryListener : public uavcan::INodeInfoListener
+{
+    std::set<uavcan::uint8_t> nodes;
+    unsigned num_unavailable;
+
+    DiscoveryListener() : num_unavailable(0) { }
+
+    virtual void handleNodeInfoRetrieved(uavcan::NodeID node_id, const uavcan::protocol::GetNodeInfo::Response&)
+    {
+        nodes.insert(node_id.get());
+    }
+
+    virtual void handleNodeInfoUnavailable(uavcan::NodeID) { num_unavailable++; }
+};
+
+}
+
+/**
+ * Many anonymous nodes request node IDs from a centralized allocator at once.
+ */
+TEST(SimScenario, DynamicNodeIDAllocation)
+{
+    using namespace uavcan::protocol::dynamic_node_id;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Allocation> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg3;
+
+    std::srand(42);
+
+    SimNetwork network(1, Bitrate);
+
+    SilentEventTracer tracer;
+    MemoryStorageBackend storage;
+    uavcan::dynamic_node_id_server::CentralizedServer server(network.addNode(1), storage, tracer);
+    uavcan::dynamic_node_id_server::UniqueID server_unique_id;
+    server_unique_id[0] = 0xFF;
+    ASSERT_LE(0, server.init(server_unique_id));
+
+    std::vector<std::unique_ptr<uavcan::DynamicNodeIDClient> > clients;
+    for (unsigned i = 0; i < NumAllocatees; i++)
+    {
+        clients.push_back(std::unique_ptr<uavcan::DynamicNodeIDClient>(
+            new uavcan::DynamicNodeIDClient(network.addNode(uavcan::NodeID::Broadcast))));
+        uavcan::protocol::HardwareVersion::FieldTypes::unique_id unique_id;
+        for (uavcan::uint8_t k = 0; k < unique_id.size(); k++)
+        {
+            unique_id[k] = uavcan::uint8_t(i * 7U + k);
+        }
+        unique_id[0] = uavcan::uint8_t(i);
+        ASSERT_LE(0, clients.back()->start(unique_id));
+    }
+
+    const uavcan::MonotonicTime start = network.clock.getMonotonic();
+    std::vector<uavcan::MonotonicDuration> completion_times(NumAllocatees);
+
+    const bool converged = network.runUntil([&]()
+        {
+            bool all = true;
+            for (unsigned i = 0; i < NumAllocatees; i++)
+            {
+                if (clients[i]->isAllocationComplete() && completion_times[i].isZero())
+                {
+                    completion_times[i] = network.clock.getMonotonic() - start;
+                }
+                all = all && clients[i]->isAllocationComplete();
+            }
+            return all;
+        }, uavcan::MonotonicDuration::fromMSec(600 * 1000));
+    ASSERT_TRUE(converged);
+
+    std::set<uavcan::uint8_t> allocated;
+    for (unsigned i = 0; i < NumAllocatees; i++)
+    {
+        ASSERT_TRUE(clients[i]->getAllocatedNodeID().isUnicast());
+        EXPECT_EQ(1, clients[i]->getAllocatorNodeID().get());
+        allocated.insert(clients[i]->getAllocatedNodeID().get());
+    }
+    EXPECT_EQ(NumAllocatees, allocated.size());
+    EXPECT_EQ(NumAllocatees + 1, server.getNumAllocations());
+
+    std::sort(completion_times.begin(), completion_times.end());
+    report("dna_num_allocatees", NumAllocatees, "nodes");
+    report("dna_convergence_time", toSec(completion_times.back()), "s");
+    report("dna_median_allocation_time", toSec(completion_times[NumAllocatees / 2]), "s");
+    report("dna_error_frames", double(network.getBus(0).num_error_frames), "frames");
+    report("dna_bus_utilization", network.getBus(0).getUtilization(completion_times.back()) * 100.0, "%");
+}
+
+/**
+ * A monitor discovers a fleet of nodes that appear simultaneously, as after a power-up.
+ */
+TEST(SimScenario, NodeInfoDiscovery)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+
+    SimNetwork network(2, Bitrate);
+
+    uavcan::NodeInfoRetriever retriever(network.addNode(1));
+    DiscoveryListener listener;
+    ASSERT_LE(0, retriever.start());
+    ASSERT_LE(0, retriever.addListener(&listener));
+
+    std::vector<std::unique_ptr<uavcan::NodeStatusProvider> > providers;
+    for (unsigned i = 0; i < NumDiscoveredNodes; i++)
+    {
+        providers.push_back(std::unique_ptr<uavcan::NodeStatusProvider>(
+            new uavcan::NodeStatusProvider(network.addNode(uavcan::NodeID(uavcan::uint8_t(10 + i))))));
+        providers.back()->setName("org.uavcan.sim.node");
+        ASSERT_LE(0, providers.back()->startAndPublish());
+    }
+
+    const uavcan::MonotonicTime start = network.clock.getMonotonic();
+    ASSERT_TRUE(network.runUntil([&]() { return listener.nodes.size() == NumDiscoveredNodes; },
+                                 uavcan::MonotonicDuration::fromMSec(60 * 1000)));
+    const uavcan::MonotonicDuration discovery_time = network.clock.getMonotonic() - start;
+    EXPECT_EQ(0, listener.num_unavailable);
+
+    report("discovery_num_nodes", NumDiscoveredNodes, "nodes");
+    report("discovery_time", toSec(discovery_time), "s");
+    report("discovery_bus_utilization", network.getBus(0).getUtilization(discovery_time) * 100.0, "%");
+}
+
+/**
+ * Several nodes download the same firmware image from one file server concurrently.
+ */
+TEST(SimScenario, FirmwareDownload)
+{
+    using namespace uavcan::protocol::file;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<GetInfo> _reg1;
+    uavcan::DefaultDataTypeRegistrator<Read> _reg2;
+
+    SimNetwork network(1, Bitrate);
+
+    FirmwareBackend backend;
+    uavcan::BasicFileServer server(network.addNode(1), backend);
+    ASSERT_LE(0, server.start());
+
+    std::vector<std::unique_ptr<FirmwareSink> > sinks;
+    std::vector<std::unique_ptr<uavcan::FileDownloader<> > > downloaders;
+    for (unsigned i = 0; i < NumFirmwareClients; i++)
+    {
+        sinks.push_back(std::unique_ptr<FirmwareSink>(new FirmwareSink(network.clock)));
+        downloaders.push_back(std::unique_ptr<uavcan::FileDownloader<> >(
+            new uavcan::FileDownloader<>(network.addNode(uavcan::NodeID(uavcan::uint8_t(10 + i))), *sinks.back())));
+        ASSERT_LE(0, downloaders.back()->start(1, "fw.bin"));
+    }
+
+    const uavcan::MonotonicTime start = network.clock.getMonotonic();
+    ASSERT_TRUE(network.runUntil([&]()
+        {
+            bool all = true;
+            for (unsigned i = 0; i < NumFirmwareClients; i++)
+            {
+                all = all && sinks[i]->done;
+            }
+            return all;
+        }, uavcan::MonotonicDuration::fromMSec(600 * 1000)));
+
+    uavcan::MonotonicDuration slowest;
+    for (unsigned i = 0; i < NumFirmwareClients; i++)
+    {
+        EXPECT_EQ(0, sinks[i]->result);
+        EXPECT_EQ(FirmwareImageSize, sinks[i]->num_bytes);
+        slowest = std::max(slowest, sinks[i]->completed_at - start);
+    }
+
+    const double seconds = toSec(slowest);
+    report("firmware_num_clients", NumFirmwareClients, "nodes");
+    report("firmware_image_size", FirmwareImageSize, "bytes");
+    report("firmware_completion_time", seconds, "s");
+    report("firmware_aggregate_throughput", double(NumFirmwareClients * FirmwareImageSize) / seconds, "B/s");
+    report("firmware_bus_utilization", network.getBus(0).getUtilization(slowest) * 100.0, "%");
+}
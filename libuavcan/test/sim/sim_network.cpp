@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/node/publisher.hpp>
+#include <uavcan/node/subscriber.hpp>
+#include <root_ns_a/MavlinkMessage.hpp>
+#include "sim_network.hpp"
+
+
+namespace
+{
+
+/**
+ * A bare bus with a few controllers, driven step by step without nodes
+ */
+struct BusFixture
+{
+    SimClock clock;
+    SimRandom random;
+    SimBus bus;
+    std::vector<std::unique_ptr<SimCanDriver> > drivers;
+
+    explicit BusFixture(unsigned num_drivers)
+        : random(1)
+        , bus(1000000, random)
+    {
+        for (unsigned i = 0; i < num_drivers; i++)
+        {
+            drivers.push_back(std::unique_ptr<SimCanDriver>(new SimCanDriver(clock, 1)));
+            bus.attach(drivers.back()->getIface(0));
+        }
+    }
+
+    SimCanIface& iface(unsigned index) { return *drivers.at(index)->getIface(0); }
+
+    /// Processes the bus until it is idle and nothing is pending
+    void runToIdle()
+    {
+        for (unsigned i = 0; i < 10000; i++)
+        {
+            (void)bus.complete(clock.getMonotonic());
+            (void)bus.startIfIdle(clock.getMonotonic());
+            const uavcan::MonotonicTime next = bus.getNextEventTime();
+            if (next.isZero() || (next == uavcan::MonotonicTime::getMax()))
+            {
+                return;
+            }
+            clock.setMonotonic(next);
+        }
+        FAIL() << "The bus did not go idle";
+    }
+};
+
+uavcan::CanFrame makeFrame(uavcan::uint32_t id, uavcan::uint8_t first_byte, uavcan::uint8_t length = 1)
+{
+    const uavcan::uint8_t data[8] = { first_byte, 0, 0, 0, 0, 0, 0, 0 };
+    return uavcan::CanFrame(id, data, length);
+}
+
+}
+
+TEST(SimNetwork, FrameLength)
+{
+    // All zeros: 34 bits in the stuffed region, 6 stuff bits, 10 bits of the frame end
+    EXPECT_EQ(50, computeCanFrameLengthBits(makeFrame(0, 0, 0)));
+
+    // Extended frame with 8 bytes: 128 bits without stuffing, at most one stuff bit per 4 bits of the rest
+    const uavcan::uint8_t data[8] = { 0, 0xFF, 0, 0xFF, 0x55, 0xAA, 0, 0 };
+    const unsigned len = computeCanFrameLengthBits(uavcan::CanFrame(0x1ABCDEF | uavcan::CanFrame::FlagEFF,
+                                                                    data, 8));
+    EXPECT_LE(128, len);
+    EXPECT_GE(128 + (118 - 1) / 4, len);
+}
+
+TEST(SimNetwork, Timing)
+{
+    BusFixture f(2);
+    const uavcan::MonotonicTime start = f.clock.getMonotonic();
+
+    EXPECT_EQ(1, f.iface(0).send(makeFrame(0, 0, 0), uavcan::MonotonicTime::getMax(),
+                                 uavcan::CanIOFlagLoopback));
+    EXPECT_EQ(1, f.iface(0).send(makeFrame(0, 0, 0), uavcan::MonotonicTime::getMax(), 0));
+    f.runToIdle();
+
+    uavcan::CanFrame frame;
+    uavcan::MonotonicTime ts;
+    uavcan::UtcTime ts_utc;
+    uavcan::CanIOFlags flags = 0;
+
+    // Frame, then the interframe space, then the second frame
+    ASSERT_EQ(1, f.iface(1).receive(frame, ts, ts_utc, flags));
+    EXPECT_EQ(50, (ts - start).toUSec());
+    ASSERT_EQ(1, f.iface(1).receive(frame, ts, ts_utc, flags));
+    EXPECT_EQ(50 + 3 + 50, (ts - start).toUSec());
+    EXPECT_EQ(0, f.iface(1).receive(frame, ts, ts_utc, flags));
+
+    // Loopback of the first frame only
+    ASSERT_EQ(1, f.iface(0).receive(frame, ts, ts_utc, flags));
+    EXPECT_EQ(uavcan::CanIOFlagLoopback, flags);
+    EXPECT_EQ(50, (ts - start).toUSec());
+    EXPECT_EQ(0, f.iface(0).receive(frame, ts, ts_utc, flags));
+
+    EXPECT_EQ(2, f.bus.num_frames);
+    EXPECT_EQ(103 + 3, f.bus.busy_usec);
+}
+
+TEST(SimNetwork, Arbitration)
+{
+    BusFixture f(4);
+
+    // The mailboxes are full
+    EXPECT_EQ(1, f.iface(0).send(makeFrame(0x300, 0), uavcan::MonotonicTime::getMax(), 0));
+    EXPECT_EQ(1, f.iface(0).send(makeFrame(0x301, 0), uavcan::MonotonicTime::getMax(), 0));
+    EXPECT_EQ(1, f.iface(0).send(makeFrame(0x050, 0), uavcan::MonotonicTime::getMax(), 0));
+    EXPECT_FALSE(f.iface(0).canAcceptTx());
+    EXPECT_EQ(0, f.iface(0).send(makeFrame(0x000, 0), uavcan::MonotonicTime::getMax(), 0));
+
+    EXPECT_EQ(1, f.iface(1).send(makeFrame(0x100, 0), uavcan::MonotonicTime::getMax(), 0));
+    EXPECT_EQ(1, f.iface(2).send(makeFrame(0x200, 0), uavcan::MonotonicTime::getMax(), 0));
+    EXPECT_EQ(1, f.iface(2).send(makeFrame((0x100 << 18) | uavcan::CanFrame::FlagEFF, 0),
+                                 uavcan::MonotonicTime::getMax(), 0));   // Loses to the standard frame of same ID
+    f.runToIdle();
+
+    const uavcan::uint32_t expected[] = { 0x050, 0x100, (0x100 << 18) | uavcan::CanFrame::FlagEFF, 0x200, 0x300, 0x301 };
+    for (unsigned i = 0; i < sizeof(expected) / sizeof(expected[0]); i++)
+    {
+        uavcan::CanFrame frame;
+        uavcan::MonotonicTime ts;
+        uavcan::UtcTime ts_utc;
+        uavcan::CanIOFlags flags = 0;
+        ASSERT_EQ(1, f.iface(3).receive(frame, ts, ts_utc, flags));
+        EXPECT_EQ(expected[i], frame.id);
+    }
+    EXPECT_FALSE(f.iface(3).hasRx());
+    EXPECT_EQ(0, f.iface(3).getErrorCount());
+}
+
+TEST(SimNetwork, Collision)
+{
+    BusFixture f(3);
+    uavcan::CanFrame frame;
+    uavcan::MonotonicTime ts;
+    uavcan::UtcTime ts_utc;
+    uavcan::CanIOFlags flags = 0;
+
+    // Identical frames merge
+    EXPECT_EQ(1, f.iface(0).send(makeFrame(0x123, 42), uavcan::MonotonicTime::getMax(), 0));
+    EXPECT_EQ(1, f.iface(1).send(makeFrame(0x123, 42), uavcan::MonotonicTime::getMax(), 0));
+    f.runToIdle();
+    ASSERT_EQ(1, f.iface(2).receive(frame, ts, ts_utc, flags));
+    EXPECT_FALSE(f.iface(2).hasRx());
+    EXPECT_FALSE(f.iface(0).hasRx());
+    EXPECT_TRUE(f.iface(0).canAcceptTx());
+    EXPECT_TRUE(f.iface(1).canAcceptTx());
+    EXPECT_EQ(1, f.bus.num_frames);
+
+    // Same ID, different payload, abort on error - both transmitters give up, like anonymous frames do
+    EXPECT_EQ(1, f.iface(0).send(makeFrame(0x123, 1), uavcan::MonotonicTime::getMax(),
+                                 uavcan::CanIOFlagAbortOnError));
+    EXPECT_EQ(1, f.iface(1).send(makeFrame(0x123, 2), uavcan::MonotonicTime::getMax(),
+                                 uavcan::CanIOFlagAbortOnError));
+    f.runToIdle();
+    EXPECT_FALSE(f.iface(2).hasRx());
+    EXPECT_EQ(1, f.iface(0).getErrorCount());
+    EXPECT_EQ(1, f.iface(1).getErrorCount());
+    EXPECT_EQ(1, f.iface(2).getErrorCount());
+    EXPECT_EQ(1, f.bus.num_error_frames);
+    EXPECT_TRUE(f.iface(0).canAcceptTx());
+    EXPECT_TRUE(f.iface(1).canAcceptTx());
+}
+
+TEST(SimNetwork, ErrorInjection)
+{
+    BusFixture f(2);
+    uavcan::CanFrame frame;
+    uavcan::MonotonicTime ts;
+    uavcan::UtcTime ts_utc;
+    uavcan::CanIOFlags flags = 0;
+
+    // Every frame is destroyed; the controller retries until the deadline
+    f.bus.frame_error_probability = 1.0;
+    EXPECT_EQ(1, f.iface(0).send(makeFrame(0x123, 1), f.clock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(1),
+                                 0));
+    f.runToIdle();
+    EXPECT_FALSE(f.iface(1).hasRx());
+    EXPECT_EQ(1, f.iface(0).getNumTxTimeouts());
+    EXPECT_LT(5, f.iface(0).getErrorCount());
+    EXPECT_EQ(f.iface(0).getErrorCount(), f.bus.num_error_frames);
+    EXPECT_EQ(0, f.bus.num_frames);
+
+    // Abort on error
+    EXPECT_EQ(1, f.iface(0).send(makeFrame(0x123, 1), uavcan::MonotonicTime::getMax(), uavcan::CanIOFlagAbortOnError));
+    f.runToIdle();
+    EXPECT_FALSE(f.iface(1).hasRx());
+    EXPECT_TRUE(f.iface(0).canAcceptTx());
+
+    // Lost by the receiver only
+    f.bus.frame_error_probability = 0.0;
+    f.bus.rx_loss_probability = 1.0;
+    EXPECT_EQ(1, f.iface(0).send(makeFrame(0x123, 1), uavcan::MonotonicTime::getMax(), 0));
+    f.runToIdle();
+    EXPECT_FALSE(f.iface(1).hasRx());
+    EXPECT_EQ(1, f.bus.num_frames);
+
+    // Back to normal
+    f.bus.rx_loss_probability = 0.0;
+    EXPECT_EQ(1, f.iface(0).send(makeFrame(0x123, 1), uavcan::MonotonicTime::getMax(), 0));
+    f.runToIdle();
+    ASSERT_EQ(1, f.iface(1).receive(frame, ts, ts_utc, flags));
+    EXPECT_EQ(0x123, frame.id);
+}
+
+TEST(SimNetwork, Nodes)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _reg1;
+
+    SimNetwork network(2, 1000000);
+    TestNode& publisher_node = network.addNode(1);
+    TestNode& subscriber_node = network.addNode(2);
+
+    uavcan::Publisher<root_ns_a::MavlinkMessage> publisher(publisher_node);
+    std::vector<root_ns_a::MavlinkMessage> received;
+    uavcan::Subscriber<root_ns_a::MavlinkMessage, std::function<void (const root_ns_a::MavlinkMessage&)> >
+        subscriber(subscriber_node);
+    ASSERT_LE(0, subscriber.start([&received](const root_ns_a::MavlinkMessage& msg) { received.push_back(msg); }));
+
+    root_ns_a::MavlinkMessage msg;
+    msg.seq = 42;
+    for (unsigned i = 0; i < 100; i++)
+    {
+        msg.payload.push_back(uavcan::uint8_t(i));
+    }
+
+    // Multi-frame transfer over both buses; the virtual time is consumed by the frames only
+    const uavcan::MonotonicTime start = network.clock.getMonotonic();
+    ASSERT_LE(0, publisher.broadcast(msg));
+    ASSERT_TRUE(network.runUntil([&received]() { return !received.empty(); }, uavcan::MonotonicDuration::fromMSec(10)));
+    EXPECT_EQ(msg, received.at(0));
+    const uavcan::MonotonicDuration transfer_time = network.clock.getMonotonic() - start;
+    EXPECT_LT(15 * 100, transfer_time.toUSec());        // 15 frames of at least 100 bits
+    EXPECT_GT(15 * 150, transfer_time.toUSec());
+    EXPECT_EQ(network.getBus(0).num_frames, network.getBus(1).num_frames);
+
+    // One bus fails; the receiver switches over to the other one after the interface switch timeout
+    network.getBus(0).failed = true;
+    network.run(uavcan::TransferReceiver::getDefaultTransferInterval() * 2);
+    msg.seq = 43;
+    ASSERT_LE(0, publisher.broadcast(msg));
+    ASSERT_TRUE(network.runUntil([&received]() { return received.size() == 2; },
+                                 uavcan::MonotonicDuration::fromMSec(10)));
+    EXPECT_EQ(43, received.at(1).seq);
+
+    // Nothing else happens; the time is advanced to the end of the interval
+    const uavcan::MonotonicTime before_idle = network.clock.getMonotonic();
+    network.run(uavcan::MonotonicDuration::fromMSec(100));
+    EXPECT_EQ(100000, (network.clock.getMonotonic() - before_idle).toUSec());
+    EXPECT_EQ(2, received.size());
+    EXPECT_LT(0, network.getDriver(0).getIface(0)->getNumTxTimeouts());
+}
@@ -0,0 +1,742 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ *
+ * Deterministic discrete-event simulation of a UAVCAN network: any number of nodes connected to one or several
+ * redundant CAN buses, with bit-accurate frame timing, CAN ID arbitration, error injection and virtual time.
+ */
+
+#pragma once
+
+#if __GNUC__
+# pragma GCC diagnostic ignored "-Wzero-as-null-pointer-constant"
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <uavcan/driver/can.hpp>
+#include <uavcan/driver/system_clock.hpp>
+#include "../node/test_node.hpp"
+
+/**
+ * Virtual time shared by all nodes of a simulated network; it only advances when the simulator moves it.
+ */
+class SimClock : public uavcan::ISystemClock
+{
+    uavcan::MonotonicTime monotonic_;
+    uavcan::UtcDuration utc_offset_;
+
+public:
+    SimClock()
+        : monotonic_(uavcan::MonotonicTime::fromUSec(1000000))
+        , utc_offset_(uavcan::UtcDuration::fromUSec(1500000000000000LL))
+    { }
+
+    void setMonotonic(uavcan::MonotonicTime time)
+    {
+        assert(time >= monotonic_);
+        monotonic_ = time;
+    }
+
+    virtual uavcan::MonotonicTime getMonotonic() const { return monotonic_; }
+
+    virtual uavcan::UtcTime getUtc() const
+    {
+        return uavcan::UtcTime::fromUSec(monotonic_.toUSec() + uavcan::uint64_t(utc_offset_.toUSec()));
+    }
+
+    virtual void adjustUtc(uavcan::UtcDuration adjustment) { utc_offset_ += adjustment; }
+};
+
+/**
+ * Deterministic pseudo-random source of the simulation, so that the results don't depend on the standard library.
+ */
+class SimRandom
+{
+    uavcan::uint64_t state_;
+
+public:
+    explicit SimRandom(uavcan::uint64_t seed) : state_(seed ^ 0x9E3779B97F4A7C15ULL) { }
+
+    uavcan::uint32_t next()
+    {
+        // xorshift64*
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return uavcan::uint32_t((state_ * 2685821657736338717ULL) >> 32);
+    }
+
+    /// True with the given probability
+    bool chance(double probability)
+    {
+        return (probability > 0.0) && ((double(next()) / 4294967296.0) < probability);
+    }
+
+    /// Uniform in [0, bound)
+    unsigned below(unsigned bound) { return (bound > 0) ? unsigned(next() % bound) : 0U; }
+};
+
+/**
+ * Length of a classic CAN frame on the wire in bits, from SOF to the end of EOF, including the stuff bits.
+ * The stuff bits are computed from the actual frame content and CRC, so the timing is exact.
+ * CAN FD frames are timed as classic frames carrying the longer payload at the nominal bit rate.
+ */
+inline unsigned computeCanFrameLengthBits(const uavcan::CanFrame& frame)
+{
+    std::vector<bool> bits;
+    const auto push = [&bits](uavcan::uint32_t value, unsigned width)
+    {
+        while (width --> 0)
+        {
+            bits.push_back(((value >> width) & 1U) != 0);
+        }
+    };
+
+    const bool rtr = frame.isRemoteTransmissionRequest();
+    push(0, 1);                                                 // SOF
+    if (frame.isExtended())
+    {
+        const uavcan::uint32_t id = frame.id & uavcan::CanFrame::MaskExtID;
+        push(id >> 18, 11);
+        push(1, 1);                                             // SRR
+        push(1, 1);                                             // IDE
+        push(id & 0x3FFFFU, 18);
+        push(rtr ? 1 : 0, 1);
+        push(0, 2);                                             // r1, r0
+    }
+    else
+    {
+        push(frame.id & uavcan::CanFrame::MaskStdID, 11);
+        push(rtr ? 1 : 0, 1);
+        push(0, 2);                                             // IDE, r0
+    }
+    push(frame.dlc & 0xFU, 4);
+    const unsigned data_len = rtr ? 0U : uavcan::CanFrame::dlcToDataLength(frame.dlc);
+    for (unsigned i = 0; i < data_len; i++)
+    {
+        push(frame.data[i], 8);
+    }
+
+    uavcan::uint32_t crc = 0;                                   // CRC-15, polynomial 0x4599
+    for (std::size_t i = 0; i < bits.size(); i++)
+    {
+        const bool crc_next = bits[i] != (((crc >> 14) & 1U) != 0);
+        crc = (crc << 1) & 0x7FFFU;
+        if (crc_next)
+        {
+            crc ^= 0x4599U;
+        }
+    }
+    push(crc, 15);
+
+    unsigned num_stuff_bits = 0;
+    unsigned run_length = 0;
+    bool run_value = false;
+    for (std::size_t i = 0; i < bits.size(); i++)
+    {
+        if ((run_length > 0) && (bits[i] == run_value))
+        {
+            run_length++;
+        }
+        else
+        {
+            run_value = bits[i];
+            run_length = 1;
+        }
+        if (run_length == 5)
+        {
+            num_stuff_bits++;
+            run_value = !run_value;                             // The stuff bit starts the next run
+            run_length = 1;
+        }
+    }
+
+    return unsigned(bits.size()) + num_stuff_bits + 1U + 2U + 7U;   // CRC delimiter, ACK slot and delimiter, EOF
+}
+
+class SimCanDriver;
+
+/**
+ * Interface of a node to one simulated bus. The controller has a few TX mailboxes; the highest priority frame
+ * of the mailboxes takes part in the bus arbitration.
+ */
+class SimCanIface : public uavcan::ICanIface
+{
+    friend class SimBus;
+
+public:
+    enum { NumTxMailboxes = 3 };
+
+    struct PendingTx
+    {
+        uavcan::CanFrame frame;
+        uavcan::MonotonicTime deadline;
+        uavcan::CanIOFlags flags;
+    };
+
+    struct Rx
+    {
+        uavcan::CanFrame frame;
+        uavcan::MonotonicTime ts;
+        uavcan::CanIOFlags flags;
+    };
+
+private:
+    SimCanDriver& driver_;
+    const SimClock& clock_;
+    std::vector<PendingTx> mailboxes_;
+    std::deque<Rx> rx_;
+    uavcan::uint64_t num_errors_;
+    uavcan::uint64_t num_tx_timeouts_;
+
+    int findHighestPriorityMailbox() const
+    {
+        int best = -1;
+        for (unsigned i = 0; i < mailboxes_.size(); i++)
+        {
+            if ((best < 0) || mailboxes_[i].frame.priorityHigherThan(mailboxes_[unsigned(best)].frame))
+            {
+                best = int(i);
+            }
+        }
+        return best;
+    }
+
+    void markDirty();
+
+public:
+    SimCanIface(SimCanDriver& driver, const SimClock& clock)
+        : driver_(driver)
+        , clock_(clock)
+        , num_errors_(0)
+        , num_tx_timeouts_(0)
+    { }
+
+    bool canAcceptTx() const { return mailboxes_.size() < NumTxMailboxes; }
+    bool hasRx() const { return !rx_.empty(); }
+
+    uavcan::uint64_t getNumTxTimeouts() const { return num_tx_timeouts_; }
+
+    virtual uavcan::int16_t send(const uavcan::CanFrame& frame, uavcan::MonotonicTime tx_deadline,
+                                 uavcan::CanIOFlags flags)
+    {
+        if (!canAcceptTx())
+        {
+            return 0;
+        }
+        PendingTx tx;
+        tx.frame = frame;
+        tx.deadline = tx_deadline;
+        tx.flags = flags;
+        mailboxes_.push_back(tx);
+        markDirty();            // The node may have more frames for the remaining mailboxes
+        return 1;
+    }
+
+    virtual uavcan::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                                    uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags)
+    {
+        if (rx_.empty())
+        {
+            return 0;
+        }
+        const Rx rx = rx_.front();
+        rx_.pop_front();
+        out_frame = rx.frame;
+        out_ts_monotonic = rx.ts;
+        out_ts_utc = clock_.getUtc() - uavcan::UtcDuration::fromUSec((clock_.getMonotonic() - rx.ts).toUSec());
+        out_flags = rx.flags;
+        return 1;
+    }
+
+    virtual uavcan::int16_t configureFilters(const uavcan::CanFilterConfig*, uavcan::uint16_t) { return 0; }
+    virtual uavcan::uint16_t getNumFilters() const { return 0; }
+    virtual uavcan::uint64_t getErrorCount() const { return num_errors_; }
+};
+
+/**
+ * Simulated CAN bus. Frames are transmitted one at a time; when the bus becomes idle, the highest priority frame
+ * among all attached interfaces wins the arbitration.
+ *
+ * Frames with the same CAN ID and different payloads (e.g. anonymous frames of different nodes) collide like on
+ * a real bus: the transmitters detect a bit error, the frame is destroyed and every transmitter either retries or
+ * drops the frame if it was sent with CanIOFlagAbortOnError. Identical frames of different transmitters merge
+ * into one.
+ */
+class SimBus
+{
+    struct Transmission
+    {
+        std::vector<SimCanIface*> senders;
+        uavcan::CanFrame frame;
+        uavcan::MonotonicTime end;          ///< End of the frame or of the error frame
+        uavcan::MonotonicTime idle;         ///< End of the interframe space
+        bool error;
+    };
+
+    const uavcan::uint32_t bitrate_;
+    SimRandom& random_;
+    std::vector<SimCanIface*> ifaces_;
+    std::unique_ptr<Transmission> ongoing_;
+    uavcan::MonotonicTime idle_since_;
+
+public:
+    double frame_error_probability;         ///< Probability of a frame being destroyed by an error frame
+    double rx_loss_probability;             ///< Probability of a receiver losing a frame, e.g. due to overrun
+    bool failed;                            ///< The bus is disconnected; nothing can be transmitted
+
+    uavcan::uint64_t num_frames;            ///< Successfully transmitted
+    uavcan::uint64_t num_error_frames;
+    uavcan::uint64_t busy_usec;
+
+    SimBus(uavcan::uint32_t bitrate, SimRandom& random)
+        : bitrate_(bitrate)
+        , random_(random)
+        , frame_error_probability(0.0)
+        , rx_loss_probability(0.0)
+        , failed(false)
+        , num_frames(0)
+        , num_error_frames(0)
+        , busy_usec(0)
+    {
+        assert(bitrate > 0);
+    }
+
+    void attach(SimCanIface* iface) { ifaces_.push_back(iface); }
+
+    uavcan::uint32_t getBitrate() const { return bitrate_; }
+
+    uavcan::MonotonicDuration bitsToDuration(unsigned bits) const
+    {
+        return uavcan::MonotonicDuration::fromUSec(
+            int64_t((uavcan::uint64_t(bits) * 1000000ULL + bitrate_ - 1U) / bitrate_));
+    }
+
+    /**
+     * Time of the next state change, or the maximum time if the bus will remain idle.
+     */
+    uavcan::MonotonicTime getNextEventTime() const
+    {
+        if (!ongoing_)
+        {
+            return uavcan::MonotonicTime::getMax();
+        }
+        return ongoing_->senders.empty() ? ongoing_->idle : ongoing_->end;
+    }
+
+    /**
+     * Completes the ongoing transmission if it has ended by now. Returns true if something has changed.
+     */
+    bool complete(uavcan::MonotonicTime now);
+
+    /**
+     * Starts the arbitration if the bus is idle. Returns true if a transmission has started.
+     */
+    bool startIfIdle(uavcan::MonotonicTime now);
+
+    double getUtilization(uavcan::MonotonicDuration period) const
+    {
+        return (period.toUSec() > 0) ? double(busy_usec) / double(period.toUSec()) : 0.0;
+    }
+};
+
+/**
+ * CAN driver of a simulated node, with one interface per bus of the network.
+ * It never blocks: the simulator runs the nodes whenever their state changes, see @ref SimNetwork.
+ */
+class SimCanDriver : public uavcan::ICanDriver
+{
+    std::vector<std::unique_ptr<SimCanIface> > ifaces_;
+    bool dirty_;
+
+public:
+    SimCanDriver(const SimClock& clock, unsigned num_ifaces)
+        : dirty_(true)
+    {
+        assert((num_ifaces > 0) && (num_ifaces <= uavcan::MaxCanIfaces));
+        for (unsigned i = 0; i < num_ifaces; i++)
+        {
+            ifaces_.push_back(std::unique_ptr<SimCanIface>(new SimCanIface(*this, clock)));
+        }
+    }
+
+    void markDirty() { dirty_ = true; }
+
+    bool takeDirty()
+    {
+        const bool res = dirty_;
+        dirty_ = false;
+        return res;
+    }
+
+    virtual SimCanIface* getIface(uavcan::uint8_t iface_index)
+    {
+        return (iface_index < ifaces_.size()) ? ifaces_[iface_index].get() : UAVCAN_NULLPTR;
+    }
+
+    virtual const SimCanIface* getIface(uavcan::uint8_t iface_index) const
+    {
+        return (iface_index < ifaces_.size()) ? ifaces_[iface_index].get() : UAVCAN_NULLPTR;
+    }
+
+    virtual uavcan::uint8_t getNumIfaces() const { return uavcan::uint8_t(ifaces_.size()); }
+
+    virtual uavcan::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                                   const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                                   uavcan::MonotonicTime)
+    {
+        uavcan::CanSelectMasks out_masks;
+        for (unsigned i = 0; i < ifaces_.size(); i++)
+        {
+            const uavcan::uint8_t bit = uavcan::uint8_t(1U << i);
+            if ((inout_masks.read & bit) && ifaces_[i]->hasRx())
+            {
+                out_masks.read |= bit;
+            }
+            if ((inout_masks.write & bit) && ifaces_[i]->canAcceptTx())
+            {
+                out_masks.write |= bit;
+            }
+        }
+        inout_masks = out_masks;
+        return uavcan::int16_t(((out_masks.read | out_masks.write) != 0) ? 1 : 0);
+    }
+};
+
+inline void SimCanIface::markDirty() { driver_.markDirty(); }
+
+inline bool SimBus::complete(uavcan::MonotonicTime now)
+{
+    if (!ongoing_)
+    {
+        return false;
+    }
+    bool changed = false;
+
+    if (!ongoing_->senders.empty() && (ongoing_->end <= now))
+    {
+        Transmission& tr = *ongoing_;
+        for (unsigned i = 0; i < tr.senders.size(); i++)
+        {
+            SimCanIface& sender = *tr.senders[i];
+            const int mb = sender.findHighestPriorityMailbox();
+            assert(mb >= 0);
+            const SimCanIface::PendingTx tx = sender.mailboxes_[unsigned(mb)];
+            if (tr.error)
+            {
+                sender.num_errors_++;
+                if (tx.flags & uavcan::CanIOFlagAbortOnError)
+                {
+                    sender.mailboxes_.erase(sender.mailboxes_.begin() + mb);
+                }
+            }
+            else
+            {
+                sender.mailboxes_.erase(sender.mailboxes_.begin() + mb);
+                if (tx.flags & uavcan::CanIOFlagLoopback)
+                {
+                    SimCanIface::Rx rx;
+                    rx.frame = tx.frame;
+                    rx.ts = tr.end;
+                    rx.flags = uavcan::CanIOFlagLoopback;
+                    sender.rx_.push_back(rx);
+                }
+            }
+            sender.markDirty();
+        }
+
+        for (unsigned i = 0; i < ifaces_.size(); i++)
+        {
+            SimCanIface& iface = *ifaces_[i];
+            bool is_sender = false;
+            for (unsigned k = 0; k < tr.senders.size(); k++)
+            {
+                is_sender = is_sender || (tr.senders[k] == &iface);
+            }
+            if (is_sender)
+            {
+                continue;
+            }
+            if (tr.error)
+            {
+                iface.num_errors_++;
+            }
+            else if (!random_.chance(rx_loss_probability))
+            {
+                SimCanIface::Rx rx;
+                rx.frame = tr.frame;
+                rx.ts = tr.end;
+                rx.flags = 0;
+                iface.rx_.push_back(rx);
+                iface.markDirty();
+            }
+        }
+
+        if (tr.error)
+        {
+            num_error_frames++;
+        }
+        else
+        {
+            num_frames++;
+        }
+        tr.senders.clear();
+        changed = true;
+    }
+
+    if (ongoing_->senders.empty() && (ongoing_->idle <= now))
+    {
+        busy_usec += uavcan::uint64_t((ongoing_->idle - ongoing_->end).toUSec());
+        idle_since_ = ongoing_->idle;
+        ongoing_.reset();
+        changed = true;
+    }
+    return changed;
+}
+
+inline bool SimBus::startIfIdle(uavcan::MonotonicTime now)
+{
+    if (ongoing_)
+    {
+        return false;
+    }
+
+    /*
+     * Frames that have missed their deadlines are discarded by the controllers
+     */
+    for (unsigned i = 0; i < ifaces_.size(); i++)
+    {
+        SimCanIface& iface = *ifaces_[i];
+        for (unsigned k = 0; k < iface.mailboxes_.size();)
+        {
+            if (iface.mailboxes_[k].deadline < now)
+            {
+                iface.mailboxes_.erase(iface.mailboxes_.begin() + k);
+                iface.num_tx_timeouts_++;
+                iface.markDirty();
+            }
+            else
+            {
+                k++;
+            }
+        }
+    }
+
+    if (failed)
+    {
+        return false;
+    }
+
+    /*
+     * Arbitration
+     */
+    const uavcan::CanFrame* winner = UAVCAN_NULLPTR;
+    for (unsigned i = 0; i < ifaces_.size(); i++)
+    {
+        const int mb = ifaces_[i]->findHighestPriorityMailbox();
+        if (mb >= 0)
+        {
+            const uavcan::CanFrame& frame = ifaces_[i]->mailboxes_[unsigned(mb)].frame;
+            if ((winner == UAVCAN_NULLPTR) || frame.priorityHigherThan(*winner))
+            {
+                winner = &frame;
+            }
+        }
+    }
+    if (winner == UAVCAN_NULLPTR)
+    {
+        return false;
+    }
+
+    std::unique_ptr<Transmission> tr(new Transmission);
+    tr->frame = *winner;
+    tr->error = false;
+    for (unsigned i = 0; i < ifaces_.size(); i++)
+    {
+        const int mb = ifaces_[i]->findHighestPriorityMailbox();
+        if ((mb >= 0) && (ifaces_[i]->mailboxes_[unsigned(mb)].frame.id == tr->frame.id))
+        {
+            tr->senders.push_back(ifaces_[i]);
+            tr->error = tr->error || !(ifaces_[i]->mailboxes_[unsigned(mb)].frame == tr->frame);  // Collision
+        }
+    }
+
+    // The transmission starts no earlier than the end of the interframe space
+    const uavcan::MonotonicTime start = (now > idle_since_) ? now : idle_since_;
+    const unsigned frame_bits = computeCanFrameLengthBits(tr->frame);
+    tr->error = tr->error || random_.chance(frame_error_probability);
+    if (tr->error)
+    {
+        // The frame is interrupted at some bit after the arbitration field, followed by the error frame
+        const unsigned error_bit = 32U + random_.below((frame_bits > 32U) ? (frame_bits - 32U) : 1U);
+        tr->end = start + bitsToDuration(error_bit + 6U + 8U);
+    }
+    else
+    {
+        tr->end = start + bitsToDuration(frame_bits);
+    }
+    tr->idle = tr->end + bitsToDuration(3);
+    busy_usec += uavcan::uint64_t((tr->end - start).toUSec());
+    ongoing_ = std::move(tr);
+    return true;
+}
+
+/**
+ * A set of test nodes connected to the same buses, all sharing one virtual clock.
+ *
+ * The nodes must not be spun directly; run() advances the virtual time from one event to the next, where an event
+ * is either the end of a frame or an error frame on a bus, or a deadline of a node. After every event, the nodes
+ * whose state has changed are spun once without blocking.
+ */
+class SimNetwork
+{
+    struct Member
+    {
+        std::unique_ptr<SimCanDriver> driver;
+        std::unique_ptr<TestNode> node;
+    };
+
+    std::vector<std::unique_ptr<SimBus> > buses_;
+    std::vector<Member> members_;
+
+    bool processCurrentTime()
+    {
+        const uavcan::MonotonicTime now = clock.getMonotonic();
+        bool changed = false;
+        for (unsigned iteration = 0; iteration < 1000; iteration++)
+        {
+            bool progress = false;
+            for (unsigned i = 0; i < buses_.size(); i++)
+            {
+                progress = buses_[i]->complete(now) || progress;
+            }
+            for (unsigned i = 0; i < members_.size(); i++)
+            {
+                Member& m = members_[i];
+                const bool timer_due = m.node->getScheduler().getDeadlineScheduler().getEarliestDeadline() <= now;
+                if (m.driver->takeDirty() || timer_due)
+                {
+                    const int res = m.node->spinOnce();
+                    EXPECT_LE(0, res);
+                    progress = true;
+                }
+            }
+            for (unsigned i = 0; i < buses_.size(); i++)
+            {
+                progress = buses_[i]->startIfIdle(now) || progress;
+            }
+            changed = changed || progress;
+            if (!progress)
+            {
+                break;
+            }
+        }
+        return changed;
+    }
+
+    uavcan::MonotonicTime getNextEventTime() const
+    {
+        uavcan::MonotonicTime next = uavcan::MonotonicTime::getMax();
+        for (unsigned i = 0; i < buses_.size(); i++)
+        {
+            next = std::min(next, buses_[i]->getNextEventTime());
+        }
+        for (unsigned i = 0; i < members_.size(); i++)
+        {
+            next = std::min(next, members_[i].node->getScheduler().getDeadlineScheduler().getEarliestDeadline());
+        }
+        return next;
+    }
+
+public:
+    SimClock clock;
+    SimRandom random;
+
+    /**
+     * @param num_buses     Number of redundant buses; every node is connected to all of them.
+     * @param bitrate       Bit rate of the buses, bit/s.
+     * @param seed          Seed of the error injection; the library's own randomness, if any, is seeded separately.
+     */
+    SimNetwork(unsigned num_buses, uavcan::uint32_t bitrate, uavcan::uint64_t seed = 42)
+        : random(seed)
+    {
+        for (unsigned i = 0; i < num_buses; i++)
+        {
+            buses_.push_back(std::unique_ptr<SimBus>(new SimBus(bitrate, random)));
+        }
+    }
+
+    /**
+     * Adds a node connected to all buses; the node ID may be broadcast for a passive node.
+     */
+    TestNode& addNode(uavcan::NodeID node_id)
+    {
+        Member m;
+        m.driver.reset(new SimCanDriver(clock, unsigned(buses_.size())));
+        for (unsigned i = 0; i < buses_.size(); i++)
+        {
+            buses_[i]->attach(m.driver->getIface(uavcan::uint8_t(i)));
+        }
+        m.node.reset(new TestNode(*m.driver, clock, node_id));
+        members_.push_back(std::move(m));
+        return *members_.back().node;
+    }
+
+    unsigned getNumNodes() const { return unsigned(members_.size()); }
+    TestNode& getNode(unsigned index) { return *members_.at(index).node; }
+    SimCanDriver& getDriver(unsigned index) { return *members_.at(index).driver; }
+
+    unsigned getNumBuses() const { return unsigned(buses_.size()); }
+    SimBus& getBus(unsigned index) { return *buses_.at(index); }
+
+    /**
+     * Runs the simulation until the predicate returns true or the virtual time reaches the deadline.
+     * Returns whether the predicate was satisfied.
+     */
+    template <typename Predicate>
+    bool runUntil(Predicate predicate, uavcan::MonotonicTime deadline)
+    {
+        for (unsigned i = 0; i < members_.size(); i++)
+        {
+            members_[i].driver->markDirty();        // The test may have changed the state of the nodes
+        }
+        while (true)
+        {
+            (void)processCurrentTime();
+            if (predicate())
+            {
+                return true;
+            }
+            const uavcan::MonotonicTime now = clock.getMonotonic();
+            uavcan::MonotonicTime next = getNextEventTime();
+            if (next <= now)
+            {
+                next = now + uavcan::MonotonicDuration::fromUSec(1);
+            }
+            if (next > deadline)
+            {
+                if (deadline > now)
+                {
+                    clock.setMonotonic(deadline);
+                    (void)processCurrentTime();
+                }
+                return predicate();
+            }
+            clock.setMonotonic(next);
+        }
+    }
+
+    template <typename Predicate>
+    bool runUntil(Predicate predicate, uavcan::MonotonicDuration timeout)
+    {
+        return runUntil(predicate, clock.getMonotonic() + timeout);
+    }
+
+    void run(uavcan::MonotonicDuration duration)
+    {
+        (void)runUntil([]() { return false; }, duration);
+    }
+};
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/trace.hpp>
+#include "clock.hpp"
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+
+TEST(TraceRingBuffer, Basic)
+{
+    SystemClockMock clock(1000);
+    uavcan::TraceRingBuffer<4> ring(clock);
+
+    typedef uavcan::TraceRingBuffer<4>::Record Record;
+    Record records[8];
+
+    ASSERT_EQ(0, ring.getNumEvents());
+    ASSERT_EQ(0, ring.copyLatest(records, 8));
+
+    ring.handleTraceEvent(uavcan::TraceEventRxFrame, 0x1234, 0, 1);
+    clock.advance(10);
+    ring.handleTraceEvent(uavcan::TraceEventTransferSend, 341, 7, 3);
+
+    ASSERT_EQ(2, ring.getNumEvents());
+    ASSERT_EQ(2, ring.copyLatest(records, 8));
+    EXPECT_EQ(1, records[0].sequence);
+    EXPECT_EQ(1000, records[0].ts_usec);
+    EXPECT_EQ(uavcan::TraceEventRxFrame, records[0].event);
+    EXPECT_EQ(0x1234, records[0].arg0);
+    EXPECT_EQ(1, records[0].arg2);
+    EXPECT_EQ(2, records[1].sequence);
+    EXPECT_EQ(1010, records[1].ts_usec);
+    EXPECT_EQ(uavcan::TraceEventTransferSend, records[1].event);
+    EXPECT_EQ(341, records[1].arg0);
+    EXPECT_EQ(7, records[1].arg1);
+    EXPECT_EQ(3, records[1].arg2);
+
+    /*
+     * Overwriting - only the latest records are kept, oldest first
+     */
+    for (unsigned i = 0; i < 5; i++)
+    {
+        ring.handleTraceEvent(uavcan::TraceEventTxQueuePush, 100 + i, 0, 0);
+    }
+    ASSERT_EQ(7, ring.getNumEvents());
+    ASSERT_EQ(4, ring.copyLatest(records, 8));
+    EXPECT_EQ(4, records[0].sequence);
+    EXPECT_EQ(101, records[0].arg0);
+    EXPECT_EQ(7, records[3].sequence);
+    EXPECT_EQ(104, records[3].arg0);
+
+    ASSERT_EQ(2, ring.copyLatest(records, 2));
+    EXPECT_EQ(103, records[0].arg0);
+    EXPECT_EQ(104, records[1].arg0);
+
+    ring.reset();
+    ASSERT_EQ(0, ring.getNumEvents());
+    ASSERT_EQ(0, ring.copyLatest(records, 8));
+}
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/transport/bus_load_estimator.hpp>
+
+static uavcan::CanFrame makeFrame(uavcan::uint32_t id, uavcan::uint8_t len, bool canfd = false)
+{
+    const uavcan::uint8_t data[uavcan::CanFrame::MaxDataLen] = {};
+    return uavcan::CanFrame(id, data, len, canfd);
+}
+
+static uavcan::MonotonicTime tsMSec(uavcan::uint64_t msec)
+{
+    return uavcan::MonotonicTime::fromMSec(msec);
+}
+
+TEST(BusLoadEstimator, FrameLength)
+{
+    using uavcan::BusLoadEstimator;
+    using uavcan::CanFrame;
+
+    // 34 stuffable bits, 6 stuff bits, 13 fixed bits
+    BusLoadEstimator::FrameLength len = BusLoadEstimator::estimateFrameLength(makeFrame(123, 0));
+    EXPECT_EQ(53, len.nominal_bits);
+    EXPECT_EQ(0, len.data_bits);
+
+    len = BusLoadEstimator::estimateFrameLength(makeFrame(123, 8));
+    EXPECT_EQ(98 + 19 + 13, len.nominal_bits);
+
+    // Extended frames carry 20 more stuffable bits
+    len = BusLoadEstimator::estimateFrameLength(makeFrame(123 | CanFrame::FlagEFF, 8));
+    EXPECT_EQ(118 + 23 + 13, len.nominal_bits);
+    EXPECT_EQ(0, len.data_bits);
+
+    // Payload of remote frames is not transmitted
+    len = BusLoadEstimator::estimateFrameLength(makeFrame(123 | CanFrame::FlagRTR, 8));
+    EXPECT_EQ(53, len.nominal_bits);
+
+#if UAVCAN_SUPPORT_CANFD
+    // Arbitration and the tail at the nominal bit rate, the rest at the data bit rate
+    len = BusLoadEstimator::estimateFrameLength(makeFrame(123 | CanFrame::FlagEFF, 8, true));
+    EXPECT_EQ(36 + 7 + 12, len.nominal_bits);
+    EXPECT_EQ(69 + 13 + 4 + 17 + 6 + 1, len.data_bits);
+
+    len = BusLoadEstimator::estimateFrameLength(makeFrame(123 | CanFrame::FlagEFF, 64, true));
+    EXPECT_EQ(36 + 7 + 12, len.nominal_bits);
+    EXPECT_EQ(517 + 103 + 4 + 21 + 7 + 1, len.data_bits);
+#endif
+}
+
+TEST(BusLoadEstimator, Load)
+{
+    using uavcan::BusLoadEstimator;
+    using uavcan::CanFrame;
+
+    BusLoadEstimator est;
+    EXPECT_EQ(1000, est.getWindow().toMSec());
+    EXPECT_EQ(0, est.getLoadPercent(tsMSec(0)));
+    EXPECT_EQ(0, est.getLoadPercent(tsMSec(100000)));
+
+    // 154 us per frame at 1 Mbit/s; 1000 frames per second make 15.4%
+    const CanFrame frame = makeFrame(123 | CanFrame::FlagEFF, 8);
+    for (unsigned i = 0; i < 2000; i++)
+    {
+        est.addFrame(frame, tsMSec(10000 + i));
+    }
+    EXPECT_EQ(15, est.getLoadPercent(tsMSec(11999)));
+
+    // Same traffic at 500 kbit/s takes twice as long
+    est.reset();
+    est.setBitrate(500000);
+    for (unsigned i = 0; i < 2000; i++)
+    {
+        est.addFrame(frame, tsMSec(20000 + i));
+    }
+    EXPECT_EQ(30, est.getLoadPercent(tsMSec(21999)));
+
+    // The traffic leaves the window gradually
+    EXPECT_GE(20, est.getLoadPercent(tsMSec(22400)));
+    EXPECT_LE(10, est.getLoadPercent(tsMSec(22400)));
+    EXPECT_EQ(0, est.getLoadPercent(tsMSec(23000)));
+
+    // Overload is clamped
+    for (unsigned i = 0; i < 10000; i++)
+    {
+        est.addFrame(frame, tsMSec(30000 + i / 10));
+    }
+    EXPECT_EQ(100, est.getLoadPercent(tsMSec(30999)));
+
+    // Timestamps from the past are not counted
+    EXPECT_EQ(0, est.getLoadPercent(tsMSec(29000)));
+
+    // Window is constrained
+    est.setWindow(uavcan::MonotonicDuration::fromMSec(1));
+    EXPECT_EQ(BusLoadEstimator::getMinWindow(), est.getWindow());
+    EXPECT_EQ(0, est.getLoadPercent(tsMSec(30999)));
+    est.setWindow(uavcan::MonotonicDuration::fromMSec(100000));
+    EXPECT_EQ(BusLoadEstimator::getMaxWindow(), est.getWindow());
+}
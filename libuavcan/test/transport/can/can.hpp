@@ -55,6 +55,15 @@ public:
     uavcan::ISystemClock& iclock;
     bool enable_utc_timestamping;
     uavcan::CanFrame pending_tx;
+    unsigned rx_batch_size;             ///< Zero - use the default receiveBatch() implementation
+    unsigned num_rx_batch_calls;
+    unsigned tx_batch_size;             ///< Zero - use the default sendBatch() implementation
+    unsigned num_tx_batch_calls;
+    unsigned num_mailboxes;             ///< Zero - frames go to the bus directly; otherwise see transmitMailboxes()
+    std::vector<FrameWithTime> mailboxes;
+    unsigned num_aborts;
+    bool emergency_supported;           ///< See sendEmergency()
+    unsigned num_emergency_frames;
 
     CanIfaceMock(uavcan::ISystemClock& iclock)
         : writeable(true)
@@ -63,8 +72,61 @@ public:
         , num_errors(0)
         , iclock(iclock)
         , enable_utc_timestamping(false)
+        , rx_batch_size(0)
+        , num_rx_batch_calls(0)
+        , tx_batch_size(0)
+        , num_tx_batch_calls(0)
+        , num_mailboxes(0)
+        , num_aborts(0)
+        , emergency_supported(false)
+        , num_emergency_frames(0)
     { }
 
+    /**
+     * Index of the mailbox that would be transmitted last, i.e. the lowest priority one, the latest among equals.
+     */
+    int findLowestPriorityMailbox() const
+    {
+        int lowest = -1;
+        for (unsigned i = 0; i < mailboxes.size(); i++)
+        {
+            if ((lowest < 0) || !mailboxes[i].frame.priorityHigherThan(mailboxes[unsigned(lowest)].frame))
+            {
+                lowest = int(i);
+            }
+        }
+        return lowest;
+    }
+
+    bool canAccept(const uavcan::CanFrame& frame) const
+    {
+        if ((num_mailboxes == 0) || (mailboxes.size() < num_mailboxes))
+        {
+            return true;
+        }
+        return frame.priorityHigherThan(mailboxes.at(unsigned(findLowestPriorityMailbox())).frame);
+    }
+
+    /**
+     * Moves the contents of the mailboxes to the bus in the order of priority.
+     */
+    void transmitMailboxes()
+    {
+        while (!mailboxes.empty())
+        {
+            unsigned top = 0;
+            for (unsigned i = 1; i < mailboxes.size(); i++)
+            {
+                if (mailboxes[i].frame.priorityHigherThan(mailboxes[top].frame))
+                {
+                    top = i;
+                }
+            }
+            tx.push(mailboxes[top]);
+            mailboxes.erase(mailboxes.begin() + long(top));
+        }
+    }
+
     void pushRx(const uavcan::CanFrame& frame)
     {
         rx.push(FrameWithTime(frame, iclock.getMonotonic()));
@@ -130,6 +192,16 @@ public:
         {
             return 0;
         }
+        if (num_mailboxes > 0)
+        {
+            if (mailboxes.size() >= num_mailboxes)
+            {
+                return 0;
+            }
+            mailboxes.push_back(FrameWithTime(frame, tx_deadline));
+            mailboxes.back().flags = flags;
+            return 1;
+        }
         tx.push(FrameWithTime(frame, tx_deadline));
         tx.back().flags = flags;
         if (flags & uavcan::CanIOFlagLoopback)
@@ -139,6 +211,58 @@ public:
         return 1;
     }
 
+    virtual uavcan::int16_t sendBatch(const uavcan::CanFrame* const* frames, const uavcan::MonotonicTime* tx_deadlines,
+                                      const uavcan::CanIOFlags* flags, uavcan::uint16_t num_frames)
+    {
+        num_tx_batch_calls++;
+        if (tx_batch_size == 0)
+        {
+            return uavcan::ICanIface::sendBatch(frames, tx_deadlines, flags, num_frames);
+        }
+        uavcan::int16_t num = 0;
+        while ((num < num_frames) && (unsigned(num) < tx_batch_size))
+        {
+            const uavcan::int16_t res = send(*frames[num], tx_deadlines[num], flags[num]);
+            if (res <= 0)
+            {
+                return (num > 0) ? num : res;
+            }
+            num++;
+        }
+        return num;
+    }
+
+    virtual uavcan::int16_t abortLowerPriority(const uavcan::CanFrame& frame, uavcan::CanFrame& out_frame,
+                                               uavcan::MonotonicTime& out_tx_deadline, uavcan::CanIOFlags& out_flags)
+    {
+        const int lowest = findLowestPriorityMailbox();
+        if ((num_mailboxes == 0) || (lowest < 0) ||
+            !frame.priorityHigherThan(mailboxes.at(unsigned(lowest)).frame))
+        {
+            return 0;
+        }
+        out_frame = mailboxes.at(unsigned(lowest)).frame;
+        out_tx_deadline = mailboxes.at(unsigned(lowest)).time;
+        out_flags = mailboxes.at(unsigned(lowest)).flags;
+        mailboxes.erase(mailboxes.begin() + lowest);
+        num_aborts++;
+        return 1;
+    }
+
+    /**
+     * The emergency frames go to the bus directly, regardless of the mailboxes and the writeable flag.
+     */
+    virtual uavcan::int16_t sendEmergency(const uavcan::CanFrame& frame)
+    {
+        if (!emergency_supported)
+        {
+            return uavcan::ICanIface::sendEmergency(frame);
+        }
+        tx.push(FrameWithTime(frame, iclock.getMonotonic()));
+        num_emergency_frames++;
+        return 1;
+    }
+
     virtual uavcan::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
                                     uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags)
     {
@@ -179,6 +303,28 @@ public:
         return 1;
     }
 
+    virtual uavcan::int16_t receiveBatch(uavcan::CanRxFrame* out_frames, uavcan::CanIOFlags* out_flags,
+                                         uavcan::uint16_t max_frames)
+    {
+        num_rx_batch_calls++;
+        if (rx_batch_size == 0)
+        {
+            return uavcan::ICanIface::receiveBatch(out_frames, out_flags, max_frames);
+        }
+        uavcan::int16_t num = 0;
+        while ((num < max_frames) && (unsigned(num) < rx_batch_size) && (!rx.empty() || !loopback.empty()))
+        {
+            const uavcan::int16_t res = receive(out_frames[num], out_frames[num].ts_mono, out_frames[num].ts_utc,
+                                                out_flags[num]);
+            if (res <= 0)
+            {
+                return (num > 0) ? num : res;
+            }
+            num++;
+        }
+        return num;
+    }
+
     // cppcheck-suppress unusedFunction
     // cppcheck-suppress functionConst
     virtual uavcan::int16_t configureFilters(const uavcan::CanFilterConfig*, uavcan::uint16_t) { return 0; }
@@ -234,7 +380,8 @@ public:
         for (unsigned i = 0; i < getNumIfaces(); i++)
         {
             const uavcan::uint8_t mask = uavcan::uint8_t(1 << i);
-            if ((inout_masks.write & mask) && ifaces.at(i).writeable)
+            if ((inout_masks.write & mask) && ifaces.at(i).writeable &&
+                ((pending_tx[i] == UAVCAN_NULLPTR) || ifaces.at(i).canAccept(*pending_tx[i])))
             {
                 out_write_mask |= mask;
             }
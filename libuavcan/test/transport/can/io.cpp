@@ -111,6 +111,102 @@ TEST(CanIOManager, Reception)
     EXPECT_EQ(0, iomgr.getIfacePerfCounters(1).frames_tx);
 }
 
+TEST(CanIOManager, BatchReception)
+{
+    // Memory
+    uavcan::PoolAllocator<sizeof(uavcan::CanTxQueue::Entry) * 4, sizeof(uavcan::CanTxQueue::Entry)> pool;
+
+    // Platform interface
+    SystemClockMock clockmock;
+    CanDriverMock driver(2, clockmock);
+    driver.ifaces.at(0).rx_batch_size = 8;      // Iface 1 relies on the default implementation
+
+    // IO Manager
+    uavcan::CanIOManager iomgr(driver, pool, clockmock);
+    ASSERT_EQ(2, iomgr.getNumIfaces());
+
+    uavcan::CanRxFrame frames[4];
+    uavcan::CanIOFlags flags[4];
+
+    /*
+     * Empty, will time out
+     */
+    EXPECT_EQ(0, iomgr.receiveBatch(frames, flags, 4, tsMono(100)));
+    EXPECT_EQ(100, clockmock.monotonic);
+    EXPECT_EQ(0, driver.ifaces.at(0).num_rx_batch_calls);
+
+    /*
+     * Iface 0 delivers multiple frames per call, iface 1 only one
+     */
+    const uavcan::CanFrame txframes[2][3] = {
+        { makeCanFrame(1, "a0", EXT),    makeCanFrame(99, "a1", EXT),  makeCanFrame(803, "a2", STD) },
+        { makeCanFrame(6341, "b0", EXT), makeCanFrame(196, "b1", STD), makeCanFrame(73, "b2", EXT) },
+    };
+    for (int i = 0; i < 3; i++)
+    {
+        clockmock.advance(10);
+        driver.ifaces.at(0).pushRx(txframes[0][i]);  // Timestamps 110, 120, 130
+        driver.ifaces.at(1).pushRx(txframes[1][i]);
+    }
+
+    ASSERT_EQ(4, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+    EXPECT_TRUE(rxFrameEquals(frames[0], txframes[0][0], 110, 0));
+    EXPECT_TRUE(rxFrameEquals(frames[1], txframes[0][1], 120, 0));
+    EXPECT_TRUE(rxFrameEquals(frames[2], txframes[0][2], 130, 0));
+    EXPECT_TRUE(rxFrameEquals(frames[3], txframes[1][0], 110, 1));
+    for (int i = 0; i < 4; i++)
+    {
+        EXPECT_EQ(0, flags[i]);
+    }
+
+    ASSERT_EQ(1, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+    EXPECT_TRUE(rxFrameEquals(frames[0], txframes[1][1], 120, 1));
+
+    // The batch capacity is respected
+    driver.ifaces.at(0).pushRx(txframes[0][0]);
+    driver.ifaces.at(0).pushRx(txframes[0][1]);
+    ASSERT_EQ(1, iomgr.receiveBatch(frames, flags, 1, uavcan::MonotonicTime()));
+    EXPECT_TRUE(rxFrameEquals(frames[0], txframes[0][0], 130, 0));
+
+    ASSERT_EQ(2, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+    EXPECT_TRUE(rxFrameEquals(frames[0], txframes[0][1], 130, 0));
+    EXPECT_TRUE(rxFrameEquals(frames[1], txframes[1][2], 130, 1));
+
+    EXPECT_EQ(0, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));  // Will time out
+
+    /*
+     * Loopback frames are flagged individually
+     */
+    ASSERT_EQ(1, iomgr.send(txframes[0][0], tsMono(1000), tsMono(0), 1, uavcan::CanTxQueue::Volatile,
+                            uavcan::CanIOFlagLoopback));
+    driver.ifaces.at(0).pushRx(txframes[0][1]);
+    ASSERT_EQ(2, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+    EXPECT_EQ(uavcan::CanIOFlagLoopback, flags[0]);
+    EXPECT_TRUE(static_cast<const uavcan::CanFrame&>(frames[0]) == txframes[0][0]);
+    EXPECT_EQ(0, flags[1]);
+    EXPECT_TRUE(rxFrameEquals(frames[1], txframes[0][1], 130, 0));
+
+    /*
+     * Errors
+     */
+    driver.ifaces.at(1).pushRx(txframes[0][0]);
+    driver.ifaces.at(1).rx_failure = true;
+    EXPECT_EQ(-uavcan::ErrDriver, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+
+    // The frames received from the other interfaces before the failure are not lost
+    driver.ifaces.at(0).pushRx(txframes[0][2]);
+    ASSERT_EQ(1, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+    EXPECT_TRUE(rxFrameEquals(frames[0], txframes[0][2], 130, 0));
+    EXPECT_EQ(-uavcan::ErrDriver, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+
+    /*
+     * Perf counters - loopback frames are not registered as RX
+     */
+    EXPECT_EQ(7, iomgr.getIfacePerfCounters(0).frames_rx);
+    EXPECT_EQ(3, iomgr.getIfacePerfCounters(1).frames_rx);
+    EXPECT_EQ(1, iomgr.getIfacePerfCounters(0).frames_tx);
+}
+
 TEST(CanIOManager, Transmission)
 {
     using uavcan::CanIOManager;
@@ -129,6 +225,9 @@ TEST(CanIOManager, Transmission)
 
     const int ALL_IFACES_MASK = 3;
 
+    // A frame queued on both interfaces takes one block if the entries are shared
+    const bool shared = CanTxQueue::MaxLinksPerEntry > 1;
+
     const uavcan::CanFrame frames[] = {
         makeCanFrame(1, "a0", EXT),    makeCanFrame(99, "a1", EXT),  makeCanFrame(803, "a2", STD)
     };
@@ -176,7 +275,7 @@ TEST(CanIOManager, Transmission)
     // Sending to both, both blocked
     driver.ifaces.at(1).writeable = false;
     EXPECT_EQ(0, iomgr.send(frames[1], tsMono(777), tsMono(300), ALL_IFACES_MASK, CanTxQueue::Volatile, flags));
-    EXPECT_EQ(3, pool.getNumUsedBlocks());          // Total 3 frames in TX queue now
+    EXPECT_EQ(shared ? 2 : 3, pool.getNumUsedBlocks()); // 3 queued frames, the new one takes 1 block if shared
     EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(frames[0])); // Still 0
     EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[1])); // 1!!
 
@@ -186,7 +285,7 @@ TEST(CanIOManager, Transmission)
     EXPECT_EQ(400, clockmock.utc);
     EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
     EXPECT_TRUE(driver.ifaces.at(1).tx.empty());
-    EXPECT_EQ(4, pool.getNumUsedBlocks());
+    EXPECT_EQ(shared ? 3 : 4, pool.getNumUsedBlocks());
     EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(frames[0]));
     EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[1]));
 
@@ -228,7 +327,7 @@ TEST(CanIOManager, Transmission)
     driver.ifaces.at(0).writeable = false;
     driver.ifaces.at(1).writeable = false;
 
-    // Sending 5 frames, one will be rejected
+    // Sending 5 frames, one will be rejected unless the entries are shared
     EXPECT_EQ(0, iomgr.send(frames[2], tsMono(2222), tsMono(1000), ALL_IFACES_MASK, CanTxQueue::Persistent, flags));
     EXPECT_EQ(0, iomgr.send(frames[0], tsMono(3333), tsMono(1100), 2, CanTxQueue::Persistent, flags));
     // One frame kicked here:
@@ -238,7 +337,7 @@ TEST(CanIOManager, Transmission)
     EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[0]));
 
     // State checks
-    EXPECT_EQ(4, pool.getNumUsedBlocks());          // TX queue is full
+    EXPECT_EQ(shared ? 3 : 4, pool.getNumUsedBlocks()); // TX queue is full
     EXPECT_EQ(1200, clockmock.monotonic);
     EXPECT_EQ(1200, clockmock.utc);
     EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
@@ -264,9 +363,22 @@ TEST(CanIOManager, Transmission)
     EXPECT_EQ(1, iomgr.receive(rx_frame, tsMono(0), flags));
     EXPECT_TRUE(rxFrameEquals(rx_frame, rx_frames[1], 1200, 1));
     EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frames[2], 2222));
-    EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frames[2], 2222));  // Iface #1, frame[1] was rejected (VOLATILE)
+    if (shared)
+    {
+        EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frames[1], 4444));  // Nothing was rejected
+        ASSERT_EQ(0, flags);
+        EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[1]));
+
+        EXPECT_EQ(0, iomgr.receive(rx_frame, tsMono(0), flags));
+        EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frames[2], 2222));
+        EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(uavcan::CanFrame()));
+    }
+    else
+    {
+        EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frames[2], 2222));  // Iface #1, frame[1] was rejected (VOLATILE)
+        EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(frames[2]));
+    }
     ASSERT_EQ(0, flags);
-    EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(frames[2]));
     EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[2]));
 
     // State checks
@@ -276,7 +388,7 @@ TEST(CanIOManager, Transmission)
     EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
     EXPECT_TRUE(driver.ifaces.at(1).tx.empty());
     EXPECT_EQ(1, iomgr.getIfacePerfCounters(0).errors);
-    EXPECT_EQ(1, iomgr.getIfacePerfCounters(1).errors); // This is because of rejected frame[1]
+    EXPECT_EQ(shared ? 0 : 1, iomgr.getIfacePerfCounters(1).errors); // This is because of rejected frame[1]
 
     /*
      * Error handling
@@ -303,7 +415,7 @@ TEST(CanIOManager, Transmission)
     EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(frames[0]));
     EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[0]));
 
-    ASSERT_EQ(2, pool.getNumUsedBlocks());               // Untransmitted frames will be buffered
+    ASSERT_EQ(shared ? 1 : 2, pool.getNumUsedBlocks());  // Untransmitted frames will be buffered
 
     // Failure removed - transmission shall proceed
     driver.ifaces.at(0).tx_failure = false;
@@ -323,8 +435,244 @@ TEST(CanIOManager, Transmission)
     EXPECT_EQ(1, iomgr.getIfacePerfCounters(1).frames_rx);
 
     EXPECT_EQ(6, iomgr.getIfacePerfCounters(0).frames_tx);
-    EXPECT_EQ(8, iomgr.getIfacePerfCounters(1).frames_tx);
+    EXPECT_EQ(shared ? 9 : 8, iomgr.getIfacePerfCounters(1).frames_tx);
+}
+
+TEST(CanIOManager, BatchTransmission)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    // Memory
+    uavcan::PoolAllocator<sizeof(CanTxQueue::Entry) * 8, sizeof(CanTxQueue::Entry)> pool;
+
+    // Platform interface
+    SystemClockMock clockmock;
+    CanDriverMock driver(2, clockmock);
+    driver.ifaces.at(0).tx_batch_size = 8;      // Iface 1 relies on the default implementation
+
+    // IO Manager
+    CanIOManager iomgr(driver, pool, clockmock, 9999);
+    ASSERT_EQ(2, iomgr.getNumIfaces());
+
+    const int ALL_IFACES_MASK = 3;
+
+    const uavcan::CanFrame frames[] = {
+        makeCanFrame(1, "a0", EXT),    makeCanFrame(99, "a1", EXT),  makeCanFrame(803, "a2", EXT)
+    };
+
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+
+    /*
+     * Filling the queues
+     */
+    driver.ifaces.at(0).writeable = false;
+    driver.ifaces.at(1).writeable = false;
+    EXPECT_EQ(0, iomgr.send(frames[2], tsMono(1000), tsMono(10), ALL_IFACES_MASK, CanTxQueue::Persistent, flags));
+    EXPECT_EQ(0, iomgr.send(frames[1], tsMono(1000), tsMono(20), ALL_IFACES_MASK, CanTxQueue::Persistent, flags));
+    EXPECT_EQ(0, iomgr.send(frames[0], tsMono(1000), tsMono(30), ALL_IFACES_MASK, CanTxQueue::Persistent, flags));
+    EXPECT_EQ(CanTxQueue::MaxLinksPerEntry > 1 ? 3 : 6, pool.getNumUsedBlocks());   // Shared between the ifaces
+    EXPECT_EQ(0, driver.ifaces.at(0).num_tx_batch_calls);
+
+    /*
+     * Iface 0 takes the whole queue at once; iface 1 - one frame per select()
+     */
+    driver.ifaces.at(0).writeable = true;
+    driver.ifaces.at(1).writeable = true;
+    uavcan::CanRxFrame dummy_rx_frame;
+    uavcan::CanIOFlags rx_flags = uavcan::CanIOFlags();
+    EXPECT_EQ(0, iomgr.receive(dummy_rx_frame, tsMono(0), rx_flags));
+    EXPECT_EQ(1, driver.ifaces.at(0).num_tx_batch_calls);
+    EXPECT_EQ(1, driver.ifaces.at(1).num_tx_batch_calls);
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frames[0], 1000));     // Priority order
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frames[1], 1000));
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frames[2], 1000));
+    EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
+    EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frames[0], 1000));
+    EXPECT_TRUE(driver.ifaces.at(1).tx.empty());
+    EXPECT_EQ(2, pool.getNumUsedBlocks());
+
+    EXPECT_EQ(0, iomgr.receive(dummy_rx_frame, tsMono(0), rx_flags));
+    EXPECT_EQ(0, iomgr.receive(dummy_rx_frame, tsMono(0), rx_flags));
+    EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frames[1], 1000));
+    EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frames[2], 1000));
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+
+    /*
+     * Queued frames of lower priority do not overtake a new frame of higher priority
+     */
+    driver.ifaces.at(0).writeable = false;
+    EXPECT_EQ(0, iomgr.send(frames[2], tsMono(2000), tsMono(40), 1, CanTxQueue::Persistent, flags));
+    EXPECT_EQ(0, iomgr.send(frames[0], tsMono(2000), tsMono(50), 1, CanTxQueue::Persistent, flags));
+    driver.ifaces.at(0).writeable = true;
+    EXPECT_EQ(2, iomgr.send(frames[1], tsMono(2000), tsMono(100), 1, CanTxQueue::Persistent, flags));
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frames[0], 2000));     // Higher priority, sent from the queue
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frames[1], 2000));
+    EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+
+    EXPECT_EQ(0, iomgr.receive(dummy_rx_frame, tsMono(0), rx_flags));
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frames[2], 2000));
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+
+    /*
+     * Perf counters
+     */
+    EXPECT_EQ(6, iomgr.getIfacePerfCounters(0).frames_tx);
+    EXPECT_EQ(3, iomgr.getIfacePerfCounters(1).frames_tx);
+    EXPECT_EQ(0, iomgr.getIfacePerfCounters(0).errors);
+}
+
+TEST(CanIOManager, MailboxPreemption)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    // Memory
+    uavcan::PoolAllocator<sizeof(CanTxQueue::Entry) * 8, sizeof(CanTxQueue::Entry)> pool;
+
+    // Platform interface, two hardware mailboxes
+    SystemClockMock clockmock;
+    CanDriverMock driver(1, clockmock);
+    CanIfaceMock& iface = driver.ifaces.at(0);
+    iface.num_mailboxes = 2;
+
+    // IO Manager
+    CanIOManager iomgr(driver, pool, clockmock, 9999);
+
+    const uavcan::CanFrame lo0 = makeCanFrame(1000, "lo0", EXT);
+    const uavcan::CanFrame lo1 = makeCanFrame(1000, "lo1", EXT);
+    const uavcan::CanFrame lo2 = makeCanFrame(1000, "lo2", EXT);
+    const uavcan::CanFrame hi0 = makeCanFrame(10, "hi0", EXT);
+    const uavcan::CanFrame hi1 = makeCanFrame(11, "hi1", EXT);
+
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+
+    EXPECT_EQ(1, iomgr.send(lo0, tsMono(1000), tsMono(0), 1, CanTxQueue::Persistent, flags));
+    EXPECT_EQ(1, iomgr.send(lo1, tsMono(1000), tsMono(0), 1, CanTxQueue::Persistent, flags));
+    EXPECT_EQ(2, iface.mailboxes.size());
+
+    // The frame that would be transmitted last gives up its mailbox and goes back into the queue
+    EXPECT_EQ(1, iomgr.send(hi0, tsMono(1000), tsMono(0), 1, CanTxQueue::Persistent, flags));
+    EXPECT_EQ(1, iface.num_aborts);
+    ASSERT_EQ(2, iface.mailboxes.size());
+    EXPECT_EQ(lo0, iface.mailboxes.at(0).frame);
+    EXPECT_EQ(hi0, iface.mailboxes.at(1).frame);
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+    EXPECT_EQ(2, iomgr.getIfacePerfCounters(0).frames_tx);
+
+    // Frames of equal priority can't preempt; the new frame is queued after the aborted one
+    EXPECT_EQ(0, iomgr.send(lo2, tsMono(1000), tsMono(10), 1, CanTxQueue::Persistent, flags));
+    EXPECT_EQ(1, iface.num_aborts);
+    EXPECT_EQ(2, pool.getNumUsedBlocks());
+    EXPECT_TRUE(iface.matchPendingTx(lo1));
+
+    // Higher priority than the queued frames, goes out directly
+    iface.transmitMailboxes();
+    EXPECT_EQ(1, iomgr.send(hi1, tsMono(1000), tsMono(10), 1, CanTxQueue::Persistent, flags));
+    EXPECT_EQ(1, iface.num_aborts);
+
+    uavcan::CanRxFrame dummy_rx_frame;
+    uavcan::CanIOFlags rx_flags = uavcan::CanIOFlags();
+    EXPECT_EQ(0, iomgr.receive(dummy_rx_frame, tsMono(0), rx_flags));
+    iface.transmitMailboxes();
+    EXPECT_EQ(0, iomgr.receive(dummy_rx_frame, tsMono(0), rx_flags));
+    iface.transmitMailboxes();
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+
+    // The transfer order is preserved on the bus
+    EXPECT_TRUE(iface.matchAndPopTx(hi0, 1000));
+    EXPECT_TRUE(iface.matchAndPopTx(lo0, 1000));
+    EXPECT_TRUE(iface.matchAndPopTx(hi1, 1000));
+    EXPECT_TRUE(iface.matchAndPopTx(lo1, 1000));
+    EXPECT_TRUE(iface.matchAndPopTx(lo2, 1000));
+    EXPECT_TRUE(iface.tx.empty());
+    EXPECT_EQ(5, iomgr.getIfacePerfCounters(0).frames_tx);
+    EXPECT_EQ(0, iomgr.getIfacePerfCounters(0).errors);
+}
+
+#if UAVCAN_CAN_IFACE_HEALTH_TRACKING
+TEST(CanIOManager, IfaceHealth)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<sizeof(CanTxQueue::Entry) * 16, sizeof(CanTxQueue::Entry)> pool;
+
+    SystemClockMock clockmock;
+    CanDriverMock driver(2, clockmock);
+
+    CanIOManager iomgr(driver, pool, clockmock, 8);
+    EXPECT_EQ(uavcan::MonotonicDuration::fromMSec(CanIOManager::DefaultIfaceProbeIntervalMs),
+              iomgr.getIfaceProbeInterval());
+
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+    const uavcan::CanFrame frame = makeCanFrame(123, "health", EXT);
+
+    // Iface 1 is bus off: the frames are queued, and the error counter goes up
+    driver.ifaces.at(1).writeable = false;
+    EXPECT_EQ(1, iomgr.send(frame, tsMono(100000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(1, iomgr.send(frame, tsMono(100000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(2, pool.getNumUsedBlocks());
+
+    // Errors alone are not enough, neither is the backlog alone
+    iomgr.cleanup(clockmock.getMonotonic());
+    EXPECT_EQ(0, iomgr.getTxExcludedIfaceMask());
+    driver.ifaces.at(0).num_errors = 10;
+    iomgr.cleanup(clockmock.getMonotonic());
+    EXPECT_EQ(0, iomgr.getTxExcludedIfaceMask());
+
+    driver.ifaces.at(1).num_errors = 10;
+    iomgr.cleanup(clockmock.getMonotonic());
+    EXPECT_EQ(2, iomgr.getTxExcludedIfaceMask());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());              // Flushed
+
+    // The traffic goes to the healthy iface only, even if explicitly addressed to both
+    EXPECT_EQ(1, iomgr.send(frame, tsMono(100000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(0, iomgr.send(frame, tsMono(100000), tsMono(0), 2, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+    EXPECT_EQ(3, iomgr.reserveTxQueues(3, 2));
+    EXPECT_EQ(2, pool.getNumUsedBlocks());              // Reserved on iface 0 only
+    iomgr.releaseTxQueueReservations(3);
+
+    // The last working iface is never excluded, even if it is failing as well
+    driver.ifaces.at(0).writeable = false;
+    EXPECT_EQ(0, iomgr.send(frame, tsMono(100000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    driver.ifaces.at(0).num_errors = 20;
+    iomgr.cleanup(clockmock.getMonotonic());
+    EXPECT_EQ(2, iomgr.getTxExcludedIfaceMask());
+    driver.ifaces.at(0).writeable = true;
+    EXPECT_EQ(1, iomgr.send(frame, tsMono(100000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+
+    // Probing - still failing, excluded again
+    clockmock.advance(CanIOManager::DefaultIfaceProbeIntervalMs * 1000U);
+    iomgr.cleanup(clockmock.getMonotonic());
+    EXPECT_EQ(0, iomgr.getTxExcludedIfaceMask());
+    EXPECT_EQ(1, iomgr.send(frame, tsMono(10000000), tsMono(clockmock.monotonic), 3, CanTxQueue::Volatile, flags));
+    driver.ifaces.at(1).num_errors = 20;
+    iomgr.cleanup(clockmock.getMonotonic());
+    EXPECT_EQ(2, iomgr.getTxExcludedIfaceMask());
+
+    // Probing - recovered
+    clockmock.advance(CanIOManager::DefaultIfaceProbeIntervalMs * 1000U);
+    iomgr.cleanup(clockmock.getMonotonic());
+    EXPECT_EQ(0, iomgr.getTxExcludedIfaceMask());
+    driver.ifaces.at(1).writeable = true;
+    EXPECT_EQ(2, iomgr.send(frame, tsMono(10000000), tsMono(clockmock.monotonic), 3, CanTxQueue::Volatile, flags));
+    driver.ifaces.at(1).num_errors = 30;
+    iomgr.cleanup(clockmock.getMonotonic());
+    EXPECT_EQ(0, iomgr.getTxExcludedIfaceMask());
+
+    // Disabled tracking includes everything
+    driver.ifaces.at(1).writeable = false;
+    EXPECT_EQ(1, iomgr.send(frame, tsMono(10000000), tsMono(clockmock.monotonic), 3, CanTxQueue::Volatile, flags));
+    driver.ifaces.at(1).num_errors = 40;
+    iomgr.cleanup(clockmock.getMonotonic());
+    EXPECT_EQ(2, iomgr.getTxExcludedIfaceMask());
+    iomgr.setIfaceProbeInterval(uavcan::MonotonicDuration());
+    EXPECT_EQ(0, iomgr.getTxExcludedIfaceMask());
 }
+#endif
 
 TEST(CanIOManager, Loopback)
 {
@@ -380,7 +728,328 @@ TEST(CanIOManager, Loopback)
     EXPECT_EQ(0, iomgr.getIfacePerfCounters(1).frames_tx);
 }
 
+#if UAVCAN_CAN_TX_QUEUE_GUARANTEED_QUOTA_PERCENT == 50
+TEST(CanIOManager, TxQuotaRebalancing)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<sizeof(CanTxQueue::Entry) * 20, sizeof(CanTxQueue::Entry)> pool;
+
+    SystemClockMock clockmock;
+    CanDriverMock driver(2, clockmock);
+
+    CanIOManager iomgr(driver, pool, clockmock, 8);     // 16 blocks in total, 4 guaranteed per iface
+    ASSERT_EQ(8, iomgr.getTxQueueQuota(0));
+    ASSERT_EQ(8, iomgr.getTxQueueQuota(1));
+
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+    uavcan::MonotonicTime tx_deadline = tsMono(1000000);
+
+    // Both ifaces have transmitted something since the last cleanup
+    ASSERT_EQ(2, iomgr.send(makeCanFrame(1, "a", EXT), tx_deadline, tsMono(0), 3, CanTxQueue::Volatile, flags));
+
+    /*
+     * Iface 0 is congested but still transmitting - it borrows everything the iface 1 doesn't need
+     */
+    driver.ifaces.at(0).writeable = false;
+    for (uint32_t i = 0; i < 14; i++)
+    {
+        ASSERT_EQ(0, iomgr.send(makeCanFrame(100 + i, "b", EXT), tx_deadline, tsMono(0), 1,
+                                CanTxQueue::Volatile, flags));
+    }
+    EXPECT_EQ(12, iomgr.getTxQueueQuota(0));
+    EXPECT_EQ(4, iomgr.getTxQueueQuota(1));
+    EXPECT_EQ(2, iomgr.getIfacePerfCounters(0).errors);
+    EXPECT_EQ(12, pool.getNumUsedBlocks());
+    EXPECT_EQ(12, iomgr.getTxQueueNumUsedBlocks(0));
+    EXPECT_EQ(0, iomgr.getTxQueueNumUsedBlocks(1));
+
+    /*
+     * The guaranteed minimum of iface 1 is still available
+     */
+    driver.ifaces.at(1).writeable = false;
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        ASSERT_EQ(0, iomgr.send(makeCanFrame(200 + i, "c", EXT), tx_deadline, tsMono(0), 2,
+                                CanTxQueue::Volatile, flags));
+    }
+    EXPECT_EQ(12, iomgr.getTxQueueQuota(0));
+    EXPECT_EQ(4, iomgr.getTxQueueQuota(1));
+    EXPECT_EQ(1, iomgr.getIfacePerfCounters(1).errors);
+    EXPECT_EQ(16, pool.getNumUsedBlocks());
+
+    /*
+     * Everything expires; both queues were congested, so the spare blocks are split evenly
+     */
+    clockmock.advance(2000000);
+    iomgr.cleanup(clockmock.getMonotonic());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+    EXPECT_EQ(8, iomgr.getTxQueueQuota(0));
+    EXPECT_EQ(8, iomgr.getTxQueueQuota(1));
+    EXPECT_EQ(14, iomgr.getIfacePerfCounters(0).errors);
+    EXPECT_EQ(5, iomgr.getIfacePerfCounters(1).errors);
+
+    /*
+     * Iface 0 is stuck now - nothing was transmitted since the last cleanup, so it can't borrow
+     */
+    tx_deadline = clockmock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(1000);
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        ASSERT_EQ(0, iomgr.send(makeCanFrame(300 + i, "d", EXT), tx_deadline, tsMono(0), 1,
+                                CanTxQueue::Volatile, flags));
+    }
+    EXPECT_EQ(8, iomgr.getTxQueueQuota(0));
+    EXPECT_EQ(8, iomgr.getTxQueueQuota(1));
+    EXPECT_EQ(16, iomgr.getIfacePerfCounters(0).errors);
+    EXPECT_EQ(8, pool.getNumUsedBlocks());
+}
+#endif
+
+#if UAVCAN_CAN_TX_QUEUE_SHARED_ENTRIES
+TEST(CanIOManager, SharedTxEntries)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<sizeof(CanTxQueue::Entry) * 4, sizeof(CanTxQueue::Entry)> pool;
+
+    SystemClockMock clockmock;
+    CanDriverMock driver(3, clockmock);
+
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+    const uavcan::CanFrame frames[] = { makeCanFrame(1, "a0", EXT), makeCanFrame(99, "a1", EXT) };
+    uavcan::CanRxFrame dummy_rx_frame;
+    uavcan::CanIOFlags rx_flags = uavcan::CanIOFlags();
+
+    {
+        CanIOManager iomgr(driver, pool, clockmock, 9999);
+        ASSERT_EQ(3, iomgr.getNumIfaces());
+
+        /*
+         * The block is released once the frame has left all of the queues
+         */
+        for (unsigned i = 0; i < 3; i++)
+        {
+            driver.ifaces.at(i).writeable = false;
+        }
+        EXPECT_EQ(0, iomgr.send(frames[0], tsMono(1000), tsMono(10), 7, CanTxQueue::Persistent, flags));
+        EXPECT_EQ(1, pool.getNumUsedBlocks());
+        EXPECT_EQ(7, iomgr.makePendingTxMask());
+
+        driver.ifaces.at(0).writeable = true;                // The owner goes first
+        EXPECT_EQ(0, iomgr.receive(dummy_rx_frame, tsMono(0), rx_flags));
+        EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frames[0], 1000));
+        EXPECT_EQ(1, pool.getNumUsedBlocks());
+        EXPECT_EQ(6, iomgr.makePendingTxMask());
+
+        driver.ifaces.at(2).writeable = true;
+        EXPECT_EQ(0, iomgr.receive(dummy_rx_frame, tsMono(0), rx_flags));
+        EXPECT_TRUE(driver.ifaces.at(2).matchAndPopTx(frames[0], 1000));
+        EXPECT_EQ(1, pool.getNumUsedBlocks());
+
+        driver.ifaces.at(1).writeable = true;
+        EXPECT_EQ(0, iomgr.receive(dummy_rx_frame, tsMono(0), rx_flags));
+        EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frames[0], 1000));
+        EXPECT_EQ(0, pool.getNumUsedBlocks());
+        EXPECT_EQ(0, iomgr.makePendingTxMask());
+
+        /*
+         * Shared entries expire on every interface separately
+         */
+        driver.ifaces.at(0).writeable = false;
+        driver.ifaces.at(1).writeable = false;
+        EXPECT_EQ(1, iomgr.send(frames[1], tsMono(100), tsMono(20), 7, CanTxQueue::Volatile, flags));
+        EXPECT_TRUE(driver.ifaces.at(2).matchAndPopTx(frames[1], 100));
+        EXPECT_EQ(1, pool.getNumUsedBlocks());
+
+        clockmock.advance(1000);
+        iomgr.cleanup(clockmock.getMonotonic());
+        EXPECT_EQ(0, pool.getNumUsedBlocks());
+        EXPECT_EQ(0, iomgr.makePendingTxMask());
+        EXPECT_EQ(1, iomgr.getIfacePerfCounters(0).errors);
+        EXPECT_EQ(1, iomgr.getIfacePerfCounters(1).errors);
+        EXPECT_EQ(0, iomgr.getIfacePerfCounters(2).errors);
+
+        /*
+         * Destroyed with shared entries in the queues
+         */
+        driver.ifaces.at(2).writeable = false;
+        const uavcan::MonotonicTime tx_deadline = clockmock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(1);
+        EXPECT_EQ(0, iomgr.send(frames[0], tx_deadline, tsMono(0), 7, CanTxQueue::Persistent, flags));
+        EXPECT_EQ(0, iomgr.send(frames[1], tx_deadline, tsMono(0), 6, CanTxQueue::Persistent, flags));
+        EXPECT_EQ(2, pool.getNumUsedBlocks());
+    }
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+}
+
+TEST(CanTxQueue, SharedEntryQuota)
+{
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<sizeof(CanTxQueue::Entry) * 8, sizeof(CanTxQueue::Entry)> pool;
+    SystemClockMock clockmock;
+
+    CanTxQueue* group[2] = {};
+    CanTxQueue q0(pool, clockmock, 8, group, 0);
+    CanTxQueue q1(pool, clockmock, 2, group, 1);
+    group[0] = &q0;
+    group[1] = &q1;
+
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+    CanTxQueue::Entry* entries[3] = {};
+    for (unsigned i = 0; i < 3; i++)
+    {
+        entries[i] = q0.push(makeCanFrame(100 + i, "a", EXT), tsMono(1000), CanTxQueue::Persistent, flags);
+        ASSERT_TRUE(entries[i] != UAVCAN_NULLPTR);
+    }
+    EXPECT_TRUE(q1.pushShared(entries[0]));
+    EXPECT_TRUE(q1.pushShared(entries[1]));
+    EXPECT_FALSE(q1.pushShared(entries[2]));                 // The quota covers the shared entries as well
+    EXPECT_EQ(2, q1.getNumSharedEntries());
+    EXPECT_EQ(3, q0.getNumUsedBlocks());
+    EXPECT_EQ(0, q1.getNumUsedBlocks());
+
+    // Removal from the sharing queue doesn't release the memory, removal from the last one does
+    CanTxQueue::Entry* e = q1.peek();
+    ASSERT_TRUE(e == entries[0]);
+    q1.remove(e);
+    EXPECT_EQ(1, q1.getNumSharedEntries());
+    EXPECT_EQ(3, pool.getNumUsedBlocks());
+    e = q0.peek();
+    ASSERT_TRUE(e == entries[0]);
+    q0.remove(e);
+    EXPECT_EQ(2, pool.getNumUsedBlocks());
+
+    // Expired entries can't be shared
+    clockmock.advance(2000);
+    EXPECT_FALSE(q1.pushShared(entries[2]));
+    q1.cleanup(clockmock.getMonotonic());
+    EXPECT_EQ(0, q1.getNumSharedEntries());
+    EXPECT_EQ(2, pool.getNumUsedBlocks());                   // Still in q0
+    q0.cleanup(clockmock.getMonotonic());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+}
+
+TEST(CanTxQueue, SharedEntryQosArbitration)
+{
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<sizeof(CanTxQueue::Entry) * 4, sizeof(CanTxQueue::Entry)> pool;
+    SystemClockMock clockmock;
+
+    CanTxQueue* group[2] = {};
+    CanTxQueue q0(pool, clockmock, 8, group, 0);
+    CanTxQueue q1(pool, clockmock, 8, group, 1);
+    group[0] = &q0;
+    group[1] = &q1;
+
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+    CanTxQueue::Entry* entries[4] = {};
+    for (unsigned i = 0; i < 4; i++)
+    {
+        entries[i] = q0.push(makeCanFrame(300 + i, "a", EXT), tsMono(1000), CanTxQueue::Volatile, flags);
+        ASSERT_TRUE(entries[i] != UAVCAN_NULLPTR);
+    }
+    EXPECT_TRUE(q1.pushShared(entries[0]));
+    EXPECT_TRUE(q1.pushShared(entries[1]));
+
+    // The shared entries have the lowest QoS, but replacing them would not free any memory
+    EXPECT_FALSE(q1.push(makeCanFrame(100, "b", EXT), tsMono(1000), CanTxQueue::Persistent, flags));
+    EXPECT_EQ(2, q1.getNumSharedEntries());
+
+    q0.remove(entries[3]);
+    ASSERT_TRUE(q1.push(makeCanFrame(200, "b", EXT), tsMono(1000), CanTxQueue::Volatile, flags));
+    EXPECT_EQ(4, pool.getNumUsedBlocks());
+
+    // Only the own entry can be replaced
+    ASSERT_TRUE(q1.push(makeCanFrame(100, "b", EXT), tsMono(1000), CanTxQueue::Persistent, flags));
+    EXPECT_EQ(2, q1.getNumSharedEntries());
+    EXPECT_EQ(4, pool.getNumUsedBlocks());
+    const CanTxQueue::Entry* e = q1.peek();
+    ASSERT_TRUE(e);
+    EXPECT_EQ(100 | uavcan::CanFrame::FlagEFF, e->frame.id);
+    EXPECT_TRUE(q1.getNextEntry(e) == entries[0]);
+    EXPECT_TRUE(q1.getNextEntry(entries[0]) == entries[1]);
+
+    // Same for the owner, whose entries are linked into the other queue
+    ASSERT_TRUE(q0.push(makeCanFrame(150, "c", EXT), tsMono(1000), CanTxQueue::Persistent, flags));
+    EXPECT_EQ(4, pool.getNumUsedBlocks());
+    e = q0.peek();
+    ASSERT_TRUE(e);
+    EXPECT_EQ(150 | uavcan::CanFrame::FlagEFF, e->frame.id);
+    EXPECT_TRUE(q0.getNextEntry(e) == entries[0]);
+    EXPECT_TRUE(q0.getNextEntry(entries[0]) == entries[1]);
+    EXPECT_FALSE(q0.getNextEntry(entries[1]));
+
+    clockmock.advance(2000);
+    q1.cleanup(clockmock.getMonotonic());
+    q0.cleanup(clockmock.getMonotonic());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+}
+#endif
+
 TEST(CanIOManager, Size)
 {
     std::cout << sizeof(uavcan::CanIOManager) << std::endl;
 }
+
+#if UAVCAN_BUS_LOAD_ESTIMATION
+TEST(CanIOManager, BusLoad)
+{
+    using uavcan::CanTxQueue;
+
+    // Memory
+    uavcan::PoolAllocator<sizeof(CanTxQueue::Entry) * 4, sizeof(CanTxQueue::Entry)> pool;
+
+    // Platform interface
+    SystemClockMock clockmock;
+    CanDriverMock driver(2, clockmock);
+
+    // IO Manager
+    uavcan::CanIOManager iomgr(driver, pool, clockmock);
+    clockmock.advance(10 * 1000 * 1000);
+    EXPECT_EQ(0, iomgr.getBusLoadPercent(0));
+    EXPECT_EQ(0, iomgr.getMaxBusLoadPercent());
+
+    const uavcan::CanFrame frame = makeCanFrame(123, "12345678", EXT);
+    uavcan::CanRxFrame rx_frame;
+    uavcan::CanIOFlags flags = 0;
+
+    // Transmitted frames on the first interface, received frames on the second one, one frame per millisecond
+    for (int i = 0; i < 1000; i++)
+    {
+        clockmock.advance(1000);
+        ASSERT_EQ(1, iomgr.send(frame, tsMono(clockmock.monotonic + 1000), tsMono(0), 1,
+                                CanTxQueue::Volatile, uavcan::CanIOFlags()));
+        driver.ifaces.at(1).pushRx(frame);
+        ASSERT_EQ(1, iomgr.receive(rx_frame, tsMono(0), flags));
+    }
+
+    const unsigned expected = (154U * 100U) / 1000U;     // 154 us per frame
+    EXPECT_EQ(expected, iomgr.getBusLoadPercent(0));
+    EXPECT_EQ(expected, iomgr.getBusLoadPercent(1));
+    EXPECT_EQ(expected, iomgr.getMaxBusLoadPercent());
+    EXPECT_EQ(expected, iomgr.getIfacePerfCounters(1).bus_load_percent);
+
+    // Loopback frames are not counted twice
+    ASSERT_EQ(1, iomgr.send(frame, tsMono(clockmock.monotonic + 1000), tsMono(0), 2,
+                            CanTxQueue::Volatile, uavcan::CanIOFlagLoopback));
+    ASSERT_EQ(1, iomgr.receive(rx_frame, tsMono(0), flags));
+    ASSERT_EQ(uavcan::CanIOFlagLoopback, flags);
+
+    // Slower bus
+    iomgr.setBusBitrate(250000);
+    for (int i = 0; i < 1000; i++)
+    {
+        clockmock.advance(1000);
+        ASSERT_EQ(1, iomgr.send(frame, tsMono(clockmock.monotonic + 1000), tsMono(0), 1,
+                                CanTxQueue::Volatile, uavcan::CanIOFlags()));
+    }
+    EXPECT_EQ((154U * 4U * 100U) / 1000U, iomgr.getBusLoadPercent(0));
+    EXPECT_EQ(0, iomgr.getBusLoadPercent(1));
+
+    clockmock.advance(2 * 1000 * 1000);
+    EXPECT_EQ(0, iomgr.getMaxBusLoadPercent());
+}
+#endif
@@ -14,7 +14,7 @@ static int getQueueLength(uavcan::CanTxQueue& queue)
     while (p)
     {
         length++;
-        p = p->getNextListNode();
+        p = queue.getNextEntry(p);
     }
     return length;
 }
@@ -28,7 +28,7 @@ static bool isInQueue(uavcan::CanTxQueue& queue, const uavcan::CanFrame& frame)
         {
             return true;
         }
-        p = p->getNextListNode();
+        p = queue.getNextEntry(p);
     }
     return false;
 }
@@ -65,9 +65,11 @@ TEST(CanTxQueue, TxQueue)
     using uavcan::CanTxQueue;
     using uavcan::CanFrame;
 
-    ASSERT_GE(40, sizeof(CanTxQueue::Entry)); // should be true for any platforms, though not required
+    // One list link per interface if the entries can be shared, see UAVCAN_CAN_TX_QUEUE_SHARED_ENTRIES
+    static const unsigned EntrySize = 40 + (CanTxQueue::MaxLinksPerEntry - 1) * sizeof(void*);
+    ASSERT_GE(EntrySize, sizeof(CanTxQueue::Entry)); // should be true for any platforms, though not required
 
-    uavcan::PoolAllocator<40 * 4, 40> pool;
+    uavcan::PoolAllocator<EntrySize * 4, EntrySize> pool;
 
     SystemClockMock clockmock;
 
@@ -121,7 +123,7 @@ TEST(CanTxQueue, TxQueue)
     while (p)
     {
         std::cout << p->toString() << std::endl;
-        p = p->getNextListNode();
+        p = queue.getNextEntry(p);
     }
 
     /*
@@ -214,3 +216,576 @@ TEST(CanTxQueue, TxQueue)
     EXPECT_FALSE(queue.peek());
     EXPECT_FALSE(queue.topPriorityHigherOrEqual(f0));
 }
+
+TEST(CanTxQueue, PriorityBuckets)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    static const unsigned NumFrames = 200;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NumFrames, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock;
+
+    CanTxQueue queue(pool, clockmock, 99999);
+
+    const uavcan::CanIOFlags flags = 0;
+
+    /*
+     * Random STD and EXT frames across all buckets, with plenty of duplicate IDs.
+     * The frame payload stores the insertion order to validate FIFO ordering of equal priorities.
+     */
+    std::srand(42);
+    std::vector<CanFrame> reference;
+    for (unsigned i = 0; i < NumFrames; i++)
+    {
+        const bool ext = (std::rand() % 4) != 0;
+        uint32_t id = uint32_t(std::rand()) & (ext ? CanFrame::MaskExtID : CanFrame::MaskStdID);
+        if (!reference.empty() && (std::rand() % 3 == 0))
+        {
+            id = reference.at(unsigned(std::rand()) % reference.size()).id;    // Duplicate
+        }
+        else if (ext)
+        {
+            id |= CanFrame::FlagEFF;
+        }
+        const uint8_t payload[2] = { uint8_t(i & 0xFF), uint8_t(i >> 8) };
+        const CanFrame frame(id, payload, 2);
+
+        // Short deadline makes some frames expire early, so that the removal is exercised in the middle of the queue
+        const uint64_t deadline = (std::rand() % 10 == 0) ? 10 : 1000;
+        queue.push(frame, tsMono(deadline), CanTxQueue::Persistent, flags);
+        if (deadline > 10)
+        {
+            std::vector<CanFrame>::iterator it = reference.begin();
+            while ((it != reference.end()) && !frame.priorityHigherThan(*it))
+            {
+                ++it;
+            }
+            reference.insert(it, frame);
+        }
+    }
+
+    ASSERT_EQ(NumFrames, unsigned(getQueueLength(queue)));
+
+    // The pool is exhausted now; the next push removes the expired frames from the middle of the queue
+    clockmock.advance(100);
+    {
+        const uint8_t payload[2] = { 0xFE, 0xFE };
+        const CanFrame frame(reference.front().id, payload, 2);
+        queue.push(frame, tsMono(1000), CanTxQueue::Persistent, flags);
+        std::vector<CanFrame>::iterator it = reference.begin();
+        while ((it != reference.end()) && !frame.priorityHigherThan(*it))
+        {
+            ++it;
+        }
+        reference.insert(it, frame);
+    }
+    ASSERT_EQ(reference.size(), unsigned(getQueueLength(queue)));
+
+    /*
+     * Popping everything out; the order must match the reference exactly
+     */
+    for (unsigned i = 0; i < reference.size(); i++)
+    {
+        CanTxQueue::Entry* entry = queue.peek();
+        ASSERT_TRUE(entry);
+        ASSERT_EQ(reference[i], entry->frame);
+        ASSERT_EQ(reference[i], *queue.getTopPriorityPendingFrame());
+        queue.remove(entry);
+
+        // Inserting a frame of the same ID again, it must go after the ones that are already queued
+        if ((i % 7 == 0) && (i + 1 < reference.size()))
+        {
+            const uint8_t payload[2] = { 0xFF, 0xFF };
+            const CanFrame frame(reference[i].id, payload, 2);
+            queue.push(frame, tsMono(1000), CanTxQueue::Persistent, flags);
+            std::vector<CanFrame>::iterator it = reference.begin() + long(i) + 1;
+            while ((it != reference.end()) && !frame.priorityHigherThan(*it))
+            {
+                ++it;
+            }
+            reference.insert(it, frame);
+        }
+    }
+
+    EXPECT_TRUE(queue.isEmpty());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+}
+
+TEST(CanTxQueue, Cleanup)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock;
+
+    CanTxQueue queue(pool, clockmock, 99999);
+
+    const uavcan::CanIOFlags flags = 0;
+
+    const CanFrame f0 = makeCanFrame(0, "f0", EXT);
+    const CanFrame f1 = makeCanFrame(10, "f1", EXT);
+    const CanFrame f2 = makeCanFrame(20, "f2", EXT);
+
+    queue.cleanup(tsMono(1000));                                // Empty, nothing to do
+    EXPECT_EQ(0, queue.getRejectedFrameCount());
+
+    queue.push(f0, tsMono(300), CanTxQueue::Persistent, flags);
+    queue.push(f1, tsMono(100), CanTxQueue::Volatile, flags);   // In the middle, expires first
+    queue.push(f2, tsMono(200), CanTxQueue::Volatile, flags);
+    EXPECT_EQ(3, pool.getNumUsedBlocks());
+
+    queue.cleanup(tsMono(100));                                 // Not expired yet
+    EXPECT_EQ(3, pool.getNumUsedBlocks());
+
+    queue.cleanup(tsMono(101));
+    EXPECT_EQ(2, pool.getNumUsedBlocks());
+    EXPECT_EQ(1, queue.getRejectedFrameCount());
+    EXPECT_FALSE(isInQueue(queue, f1));
+
+    queue.cleanup(tsMono(250));
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+    EXPECT_EQ(2, queue.getRejectedFrameCount());
+    EXPECT_EQ(f0, queue.getTopPriorityPendingFrame() ? *queue.getTopPriorityPendingFrame() : CanFrame());
+
+    // Removing the last entry resets the deadline bound
+    CanTxQueue::Entry* entry = queue.peek();
+    ASSERT_TRUE(entry);
+    queue.remove(entry);
+    EXPECT_TRUE(queue.isEmpty());
+
+    clockmock.advance(500);
+    queue.push(f2, tsMono(1000), CanTxQueue::Volatile, flags);
+    queue.cleanup(tsMono(900));
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+    queue.cleanup(tsMono(1001));
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+    EXPECT_EQ(3, queue.getRejectedFrameCount());
+    EXPECT_EQ(3, queue.getDeadlineMissCount());
+}
+
+TEST(CanTxQueue, Requeue)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock;
+
+    CanTxQueue queue(pool, clockmock, 5);
+
+    const uavcan::CanIOFlags flags = 0;
+
+    const CanFrame a0 = makeCanFrame(100, "a0", EXT);
+    const CanFrame a1 = makeCanFrame(100, "a1", EXT);
+    const CanFrame a2 = makeCanFrame(100, "a2", EXT);
+    const CanFrame b = makeCanFrame(50, "b", EXT);
+    const CanFrame c = makeCanFrame(200, "c", EXT);
+
+    queue.push(a1, tsMono(1000), CanTxQueue::Volatile, flags);
+    queue.push(a2, tsMono(1000), CanTxQueue::Volatile, flags);
+
+    // Goes ahead of the frames of the same ID
+    ASSERT_TRUE(queue.requeue(a0, tsMono(1000), uavcan::CanIOFlagLoopback));
+    ASSERT_TRUE(queue.requeue(c, tsMono(1000), flags));
+    ASSERT_TRUE(queue.requeue(b, tsMono(1000), flags));
+
+    const CanTxQueue::Entry* p = queue.peek();
+    const CanFrame expected[] = { b, a0, a1, a2, c };
+    for (unsigned i = 0; i < sizeof(expected) / sizeof(expected[0]); i++)
+    {
+        ASSERT_TRUE(p);
+        EXPECT_EQ(expected[i], p->frame);
+        p = queue.getNextEntry(p);
+    }
+    EXPECT_FALSE(p);
+    EXPECT_EQ(uavcan::CanIOFlagLoopback, queue.peek()->next_links[0]->flags);
+
+    // Nothing is evicted if the quota is exhausted
+    EXPECT_FALSE(queue.requeue(b, tsMono(1000), flags));
+    EXPECT_EQ(1, queue.getRejectedFrameCount());
+    EXPECT_EQ(5, getQueueLength(queue));
+
+    // Bucket tail is maintained, the following push goes last
+    CanTxQueue::Entry* entry = queue.peek();
+    queue.remove(entry);
+    queue.push(makeCanFrame(200, "c1", EXT), tsMono(1000), CanTxQueue::Volatile, flags);
+    p = queue.peek();
+    while (queue.getNextEntry(p))
+    {
+        p = queue.getNextEntry(p);
+    }
+    EXPECT_EQ(makeCanFrame(200, "c1", EXT), p->frame);
+}
+
+TEST(CanTxQueue, Reservation)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock;
+
+    CanTxQueue queue(pool, clockmock, 6);
+
+    const uavcan::CanIOFlags flags = 0;
+
+    queue.push(makeCanFrame(0, "f0", EXT), tsMono(100), CanTxQueue::Volatile, flags);
+    queue.push(makeCanFrame(1, "f1", EXT), tsMono(200), CanTxQueue::Volatile, flags);
+
+    // All or nothing
+    EXPECT_FALSE(queue.reserve(5));
+    EXPECT_EQ(0, queue.getNumReservedEntries());
+    EXPECT_EQ(2, pool.getNumUsedBlocks());
+    EXPECT_EQ(5, queue.getRejectedFrameCount());
+
+    EXPECT_TRUE(queue.reserve(3));
+    EXPECT_EQ(3, queue.getNumReservedEntries());
+    EXPECT_EQ(5, pool.getNumUsedBlocks());
+
+    // Pushes use the reserved memory
+    queue.push(makeCanFrame(2, "f2", EXT), tsMono(300), CanTxQueue::Volatile, flags);
+    EXPECT_EQ(2, queue.getNumReservedEntries());
+    EXPECT_EQ(5, pool.getNumUsedBlocks());
+    EXPECT_EQ(3, getQueueLength(queue));
+
+    // Expired entries are dropped to make room
+    clockmock.advance(150);
+    EXPECT_TRUE(queue.reserve(2));
+    EXPECT_EQ(4, queue.getNumReservedEntries());
+    EXPECT_EQ(6, pool.getNumUsedBlocks());
+    EXPECT_EQ(2, getQueueLength(queue));
+    EXPECT_EQ(6, queue.getRejectedFrameCount());
+
+    queue.releaseReservation();
+    EXPECT_EQ(0, queue.getNumReservedEntries());
+    EXPECT_EQ(2, pool.getNumUsedBlocks());
+}
+
+TEST(CanTxQueue, GuaranteedBlocks)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock;
+
+    CanTxQueue queue(pool, clockmock, 6);
+
+    const uavcan::CanIOFlags flags = 0;
+
+    EXPECT_TRUE(queue.setMinBlocks(2));
+    EXPECT_EQ(2, queue.getMinBlocks());
+    EXPECT_EQ(2, pool.getNumUsedBlocks());
+    EXPECT_FALSE(queue.setMinBlocks(7));        // Above the quota
+    EXPECT_EQ(2, queue.getMinBlocks());
+
+    // Bulk traffic can't get the guaranteed blocks
+    for (uint8_t i = 0; i < 6; i++)
+    {
+        queue.push(makeCanFrame(100U + i, "bulk", EXT), tsMono(1000), CanTxQueue::Volatile, flags);
+    }
+    EXPECT_EQ(4, getQueueLength(queue));
+    EXPECT_EQ(2, queue.getRejectedFrameCount());
+    EXPECT_FALSE(queue.reserve(1));
+    EXPECT_EQ(3, queue.getRejectedFrameCount());
+
+    // Critical traffic can
+    EXPECT_TRUE(queue.reserve(2, true));
+    queue.push(makeCanFrame(1, "crit1", EXT), tsMono(1000), CanTxQueue::Volatile, flags);
+    queue.push(makeCanFrame(2, "crit2", EXT), tsMono(1000), CanTxQueue::Volatile, flags);
+    queue.releaseReservation();
+    EXPECT_EQ(6, getQueueLength(queue));
+    EXPECT_EQ(6, pool.getNumUsedBlocks());
+    EXPECT_FALSE(queue.reserve(1, true));
+
+    // Removed entries refill the guaranteed blocks first
+    CanTxQueue::Entry* entry = queue.peek();
+    ASSERT_TRUE(entry);
+    queue.remove(entry);
+    EXPECT_EQ(6, pool.getNumUsedBlocks());
+    queue.push(makeCanFrame(103, "bulk", EXT), tsMono(1000), CanTxQueue::Volatile, flags);
+    EXPECT_EQ(5, getQueueLength(queue));
+    EXPECT_TRUE(queue.reserve(1, true));
+    queue.releaseReservation();
+
+    // Expired entries
+    clockmock.advance(2000);
+    queue.cleanup(clockmock.getMonotonic());
+    EXPECT_TRUE(queue.isEmpty());
+    EXPECT_EQ(2, pool.getNumUsedBlocks());
+
+    EXPECT_TRUE(queue.setMinBlocks(0));
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+}
+
+#if UAVCAN_CAN_TX_QUEUE_DEADLINE_SCHEDULING
+TEST(CanTxQueue, DeadlineScheduling)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock;
+
+    CanTxQueue queue(pool, clockmock, 99999);
+
+    const uavcan::CanIOFlags flags = 0;
+
+    // High priority bulk frames in band 0, low priority frames with close deadlines in band 3
+    const CanFrame hi0 = makeCanFrame((1U << 24) | 1U, "hi0", EXT);
+    const CanFrame hi1 = makeCanFrame((1U << 24) | 1U, "hi1", EXT);
+    const CanFrame hi2 = makeCanFrame((1U << 24) | 1U, "hi2", EXT);
+    const CanFrame lo0 = makeCanFrame((30U << 24) | 5U, "lo0", EXT);
+    const CanFrame lo1 = makeCanFrame((30U << 24) | 5U, "lo1", EXT);
+    const CanFrame lo2 = makeCanFrame((30U << 24) | 6U, "lo2", EXT);
+    ASSERT_EQ(0, CanTxQueue::getPriorityBand(hi0));
+    ASSERT_EQ(3, CanTxQueue::getPriorityBand(lo0));
+
+    queue.push(hi0, tsMono(1000), CanTxQueue::Volatile, flags);
+    queue.push(hi1, tsMono(1000), CanTxQueue::Volatile, flags);
+    queue.push(hi2, tsMono(1000), CanTxQueue::Volatile, flags);
+    queue.push(lo0, tsMono(200), CanTxQueue::Volatile, flags);
+    queue.push(lo1, tsMono(190), CanTxQueue::Volatile, flags);
+    queue.push(lo2, tsMono(150), CanTxQueue::Volatile, flags);
+    EXPECT_EQ(3, queue.getBandBacklog(0));
+    EXPECT_EQ(3, queue.getBandBacklog(3));
+
+    // Pure priority order by default
+    clockmock.advance(60);
+    EXPECT_EQ(hi0, queue.peek()->frame);
+
+    // Nothing is urgent yet
+    queue.setUrgencyWindow(uavcan::MonotonicDuration::fromUSec(50));
+    EXPECT_EQ(hi0, queue.peek()->frame);
+
+    // The earliest deadline goes first, regardless of the threshold
+    queue.setUrgencyWindow(uavcan::MonotonicDuration::fromUSec(100));
+    EXPECT_EQ(lo2, queue.peek()->frame);
+    EXPECT_EQ(lo2, *queue.getTopPriorityPendingFrame());
+    EXPECT_TRUE(queue.topPriorityHigherOrEqual(makeCanFrame(0, "new", EXT)));
+    {
+        CanTxQueue::Entry* entries[4] = {};
+        ASSERT_EQ(1, queue.peekBatch(entries, 4, &hi0));
+        EXPECT_EQ(lo2, entries[0]->frame);
+        queue.remove(entries[0]);
+    }
+
+    // lo1 has the earliest deadline, but lo0 of the same CAN ID must not be overtaken
+    clockmock.advance(60);
+    CanTxQueue::Entry* entry = queue.peek();
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(lo0, entry->frame);
+    queue.remove(entry);
+    entry = queue.peek();
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(lo1, entry->frame);
+    queue.remove(entry);
+    EXPECT_EQ(hi0, queue.peek()->frame);
+    EXPECT_EQ(0, queue.getBandBacklog(3));
+
+    // Deadline misses are rejections, but not the other way around
+    queue.push(lo0, tsMono(130), CanTxQueue::Volatile, flags);
+    clockmock.advance(20);
+    EXPECT_EQ(hi0, queue.peek()->frame);
+    EXPECT_EQ(1, queue.getDeadlineMissCount());
+    EXPECT_EQ(1, queue.getRejectedFrameCount());
+
+    // Backlog limit of the band
+    queue.setBandBacklogLimit(0, 3);
+    EXPECT_EQ(3, queue.getBandBacklogLimit(0));
+    EXPECT_FALSE(queue.push(hi0, tsMono(1000), CanTxQueue::Volatile, flags));
+    EXPECT_EQ(2, queue.getRejectedFrameCount());
+    EXPECT_EQ(1, queue.getDeadlineMissCount());
+    EXPECT_TRUE(queue.push(lo0, tsMono(1000), CanTxQueue::Volatile, flags));     // Other bands are not affected
+
+    // Reserved transfers are admitted as a whole
+    EXPECT_TRUE(queue.reserve(1));
+    EXPECT_TRUE(queue.push(hi0, tsMono(1000), CanTxQueue::Volatile, flags));
+    queue.releaseReservation();
+    EXPECT_EQ(4, queue.getBandBacklog(0));
+
+    queue.setBandBacklogLimit(0, 0);
+    EXPECT_TRUE(queue.push(hi0, tsMono(1000), CanTxQueue::Volatile, flags));
+    EXPECT_EQ(5, queue.getBandBacklog(0));
+
+    queue.setUrgencyWindow(uavcan::MonotonicDuration());
+    while (!queue.isEmpty())
+    {
+        entry = queue.peek();
+        queue.remove(entry);
+    }
+    EXPECT_EQ(0, queue.getBandBacklog(0));
+    EXPECT_EQ(0, queue.getBandBacklog(3));
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+}
+#endif
+
+#if UAVCAN_CAN_TX_QUEUE_COMPACT_ENTRIES
+TEST(CanTxQueue, CompactEntries)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    uavcan::SegregatedPoolAllocator<64 * 4, 64, 96 * 4, 96,
+                                    uavcan::MemPoolBlockSize * 4, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock;
+
+    CanTxQueue queue(pool, clockmock, 99999);
+
+    const uint8_t fd_data[20] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20 };
+    const CanFrame classic = makeCanFrame(100, "abcdefg", EXT);
+    const CanFrame fd(200 | CanFrame::FlagEFF, fd_data, sizeof(fd_data), true);
+    ASSERT_GE(64, CanTxQueue::Entry::getAllocationSize(classic));
+    ASSERT_EQ(sizeof(CanTxQueue::Entry), CanTxQueue::Entry::getAllocationSize(fd));
+
+    /*
+     * Classic frames take the small blocks, CAN FD frames take the large ones
+     */
+    ASSERT_TRUE(queue.push(classic, tsMono(1000), CanTxQueue::Volatile, 0));
+    ASSERT_TRUE(queue.push(fd, tsMono(1000), CanTxQueue::Volatile, 0));
+    EXPECT_EQ(1, pool.getSmallPool().getNumUsedBlocks());
+    EXPECT_EQ(0, pool.getMediumPool().getNumUsedBlocks());
+    EXPECT_EQ(1, pool.getLargePool().getNumUsedBlocks());
+
+    /*
+     * The frames passed to the driver are complete
+     */
+    CanTxQueue::Entry* entry = queue.peek();
+    ASSERT_TRUE(entry);
+    EXPECT_TRUE(entry->isCompact());
+    const CanFrame* pending = queue.getTopPriorityPendingFrame();
+    ASSERT_TRUE(pending);
+    EXPECT_NE(&entry->frame, pending);
+    EXPECT_TRUE(classic == *pending);
+    EXPECT_EQ(7, pending->dlc);
+    for (unsigned i = 7; i < CanFrame::MaxDataLen; i++)
+    {
+        EXPECT_EQ(0, pending->data[i]);
+    }
+    queue.remove(entry);
+
+    entry = queue.peek();
+    ASSERT_TRUE(entry);
+    EXPECT_FALSE(entry->isCompact());
+    EXPECT_EQ(&entry->frame, queue.getTopPriorityPendingFrame());
+    EXPECT_TRUE(fd == entry->frame);
+    queue.remove(entry);
+
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+}
+
+TEST(CanTxQueue, CompactEntriesGuaranteedBlocks)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    uavcan::SegregatedPoolAllocator<64 * 2, 64, 96 * 2, 96,
+                                    uavcan::MemPoolBlockSize * 3, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock;
+
+    CanTxQueue queue(pool, clockmock, 99999);
+
+    const uint8_t fd_data[20] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20 };
+    const CanFrame fd(500 | CanFrame::FlagEFF, fd_data, sizeof(fd_data), true);
+    ASSERT_LT(96, sizeof(CanTxQueue::Entry));       // Full entries fit only the large blocks
+    ASSERT_GE(64, CanTxQueue::Entry::getAllocationSize(makeCanFrame(10, "classic", EXT)));
+
+    ASSERT_TRUE(queue.setMinBlocks(2));
+    EXPECT_EQ(2, pool.getLargePool().getNumUsedBlocks());
+
+    /*
+     * Compact entries take the small and the medium blocks, then the guaranteed ones
+     */
+    ASSERT_TRUE(queue.push(fd, tsMono(1000), CanTxQueue::Volatile, 0));
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        ASSERT_TRUE(queue.push(makeCanFrame(10 + i, "classic", EXT), tsMono(1000), CanTxQueue::Volatile, 0));
+    }
+    ASSERT_TRUE(queue.reserve(2, true));
+    ASSERT_TRUE(queue.push(makeCanFrame(20, "classic", EXT), tsMono(1000), CanTxQueue::Volatile, 0));
+    ASSERT_TRUE(queue.push(makeCanFrame(21, "classic", EXT), tsMono(1000), CanTxQueue::Volatile, 0));
+    queue.releaseReservation();
+    EXPECT_EQ(7, getQueueLength(queue));
+    EXPECT_EQ(7, pool.getNumUsedBlocks());
+
+    /*
+     * The small blocks released while the reserve is in use must not end up in the reserve
+     */
+    for (unsigned i = 0; i < 2; i++)
+    {
+        CanTxQueue::Entry* entry = queue.peek();
+        ASSERT_TRUE(entry);
+        ASSERT_TRUE(entry->isCompact());
+        queue.remove(entry);
+    }
+    EXPECT_EQ(0, pool.getSmallPool().getNumUsedBlocks());
+    EXPECT_EQ(3, pool.getLargePool().getNumUsedBlocks());
+    EXPECT_FALSE(queue.reserve(1, true));
+
+    // The large blocks do
+    for (unsigned i = 0; i < 4; i++)
+    {
+        CanTxQueue::Entry* entry = queue.peek();
+        ASSERT_TRUE(entry);
+        ASSERT_TRUE(entry->isCompact());
+        queue.remove(entry);
+    }
+    EXPECT_EQ(0, pool.getMediumPool().getNumUsedBlocks());
+    EXPECT_EQ(3, pool.getLargePool().getNumUsedBlocks());
+    EXPECT_EQ(1, getQueueLength(queue));
+
+    ASSERT_TRUE(queue.reserve(2, true));
+    ASSERT_TRUE(queue.push(CanFrame(400 | CanFrame::FlagEFF, fd_data, sizeof(fd_data), true), tsMono(1000),
+                           CanTxQueue::Persistent, 0));
+    ASSERT_TRUE(queue.push(CanFrame(401 | CanFrame::FlagEFF, fd_data, sizeof(fd_data), true), tsMono(1000),
+                           CanTxQueue::Persistent, 0));
+    queue.releaseReservation();
+    EXPECT_EQ(3, getQueueLength(queue));
+    EXPECT_EQ(3, pool.getLargePool().getNumUsedBlocks());
+
+    /*
+     * QoS arbitration replaces only the entries whose blocks can hold the new one
+     */
+    clockmock.advance(2000);
+    queue.cleanup(clockmock.getMonotonic());
+    EXPECT_TRUE(queue.isEmpty());
+    ASSERT_TRUE(queue.setMinBlocks(0));
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        ASSERT_TRUE(queue.push(CanFrame((300 + i) | CanFrame::FlagEFF, fd_data, sizeof(fd_data), true),
+                               tsMono(10000), CanTxQueue::Persistent, 0));
+    }
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        ASSERT_TRUE(queue.push(makeCanFrame(10 + i, "classic", EXT), tsMono(10000), CanTxQueue::Volatile, 0));
+    }
+    EXPECT_EQ(7, pool.getNumUsedBlocks());
+
+    // The compact entries have the lowest QoS, but replacing them would not help
+    EXPECT_FALSE(queue.push(fd, tsMono(10000), CanTxQueue::Volatile, 0));
+    EXPECT_EQ(7, getQueueLength(queue));
+
+    const CanFrame fd_high(200 | CanFrame::FlagEFF, fd_data, sizeof(fd_data), true);
+    ASSERT_TRUE(queue.push(fd_high, tsMono(10000), CanTxQueue::Persistent, 0));
+    EXPECT_EQ(7, getQueueLength(queue));
+    EXPECT_TRUE(isInQueue(queue, fd_high));
+    EXPECT_TRUE(isInQueue(queue, makeCanFrame(13, "classic", EXT)));
+    EXPECT_FALSE(isInQueue(queue, CanFrame(302 | CanFrame::FlagEFF, fd_data, sizeof(fd_data), true)));
+
+    clockmock.advance(20000);
+    queue.cleanup(clockmock.getMonotonic());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+}
+#endif
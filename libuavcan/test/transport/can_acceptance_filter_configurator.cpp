@@ -216,4 +216,198 @@ TEST(CanAcceptanceFilter, Basic_test)
     ASSERT_EQ(configure_array_2.getByIndex(3)->id, 2147745792);
     ASSERT_EQ(configure_array_2.getByIndex(3)->mask, 3774868352);
 }
+
+static uavcan::CanFilterConfig makeMessageFilterConfig(uavcan::uint16_t dtid)
+{
+    uavcan::CanFilterConfig cfg;
+    cfg.id = (uavcan::uint32_t(dtid) << 8) | uavcan::CanFrame::FlagEFF;
+    cfg.mask = 0xFFFF80 | uavcan::CanFrame::FlagEFF | uavcan::CanFrame::FlagRTR | uavcan::CanFrame::FlagERR;
+    return cfg;
+}
+
+static uavcan::uint32_t makeMessageCanID(uavcan::uint16_t dtid, uavcan::uint8_t src_node_id)
+{
+    return (uavcan::uint32_t(16) << 24) | (uavcan::uint32_t(dtid) << 8) | src_node_id | uavcan::CanFrame::FlagEFF;
+}
+
+TEST(CanAcceptanceFilter, TrafficMonitor)
+{
+    uavcan::CanBusTrafficMonitor monitor;
+    ASSERT_EQ(0, monitor.getNumEntries());
+
+    // Source node ID and priority are not tracked
+    monitor.addFrames(makeMessageCanID(100, 10), 5);
+    monitor.addFrames(makeMessageCanID(100, 11) & ~(uavcan::uint32_t(0x1F) << 24), 5);
+    monitor.addFrames(makeMessageCanID(101, 10), 3);
+    monitor.addFrames(makeMessageCanID(100, 0), 7);                       // Anonymous
+    ASSERT_EQ(3, monitor.getNumEntries());
+
+    // Loopback, RTR and standard frames are ignored
+    const uavcan::uint8_t data[1] = { 0 };
+    uavcan::CanRxFrame frame;
+    static_cast<uavcan::CanFrame&>(frame) = uavcan::CanFrame(makeMessageCanID(101, 10), data, 1);
+    monitor.handleRxFrame(frame, 0);
+    monitor.handleRxFrame(frame, uavcan::CanIOFlagLoopback);
+    static_cast<uavcan::CanFrame&>(frame) = uavcan::CanFrame(makeMessageCanID(101, 10) | uavcan::CanFrame::FlagRTR,
+                                                             data, 1);
+    monitor.handleRxFrame(frame, 0);
+    static_cast<uavcan::CanFrame&>(frame) = uavcan::CanFrame(123, data, 1);
+    monitor.handleRxFrame(frame, 0);
+    ASSERT_EQ(3, monitor.getNumEntries());
+
+    ASSERT_EQ(17, monitor.countAcceptedFrames(makeMessageFilterConfig(100)));
+    ASSERT_EQ(4, monitor.countAcceptedFrames(makeMessageFilterConfig(101)));
+    ASSERT_EQ(0, monitor.countAcceptedFrames(makeMessageFilterConfig(102)));
+
+    uavcan::CanFilterConfig anon_cfg;
+    anon_cfg.id = uavcan::CanFrame::FlagEFF;
+    anon_cfg.mask = 0xFF | uavcan::CanFrame::FlagEFF | uavcan::CanFrame::FlagRTR | uavcan::CanFrame::FlagERR;
+    ASSERT_EQ(7, monitor.countAcceptedFrames(anon_cfg));
+
+    // Overflowing counters are scaled down together
+    monitor.addFrames(makeMessageCanID(101, 10), 0xFFFFFFFFU);
+    ASSERT_GT(monitor.countAcceptedFrames(makeMessageFilterConfig(101)), 0x10000000U);
+    ASSERT_LT(monitor.countAcceptedFrames(makeMessageFilterConfig(100)), 17);
+
+    monitor.reset();
+    ASSERT_EQ(0, monitor.getNumEntries());
+    ASSERT_EQ(0, monitor.countAcceptedFrames(makeMessageFilterConfig(101)));
+
+    // When the table is full, the frames are counted as untracked
+    for (unsigned i = 0; i < uavcan::CanBusTrafficMonitor::Capacity + 3; i++)
+    {
+        monitor.addFrames(makeMessageCanID(uavcan::uint16_t(i), 1), 1);
+    }
+    ASSERT_EQ(uavcan::CanBusTrafficMonitor::Capacity, monitor.getNumEntries());
+    ASSERT_EQ(3, monitor.getNumUntrackedFrames());
+}
+
+TEST(CanAcceptanceFilter, CostModel)
+{
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(1, clock_driver);
+    TestNode node(can_driver, clock_driver, 24);
+
+    /*
+     * DTID 96 and 99 are the best pair by the number of mask bits, but the merged filter would let through
+     * DTID 97, which is heavily used on the bus.
+     */
+    static const uavcan::uint16_t Wanted[] = { 96, 99, 7, 56 };
+    static const uavcan::uint16_t Unwanted = 97;
+
+    uavcan::CanBusTrafficMonitor monitor;
+    monitor.addFrames(makeMessageCanID(Unwanted, 10), 1000);
+    for (unsigned i = 0; i < (sizeof(Wanted) / sizeof(Wanted[0])); i++)
+    {
+        monitor.addFrames(makeMessageCanID(Wanted[i], 10), 100);
+    }
+
+    for (int use_monitor = 0; use_monitor < 2; use_monitor++)
+    {
+        uavcan::CanAcceptanceFilterConfigurator cfger(node, 4);
+        cfger.setTrafficMonitor(use_monitor ? &monitor : UAVCAN_NULLPTR);
+
+        ASSERT_EQ(0, cfger.computeConfiguration(uavcan::CanAcceptanceFilterConfigurator::IgnoreAnonymousMessages));
+        for (unsigned i = 0; i < (sizeof(Wanted) / sizeof(Wanted[0])); i++)
+        {
+            ASSERT_EQ(0, cfger.addFilterConfig(makeMessageFilterConfig(Wanted[i])));
+        }
+        ASSERT_EQ(5, cfger.getConfiguration().getSize());
+        ASSERT_EQ(0, cfger.applyConfiguration());
+        ASSERT_EQ(4, cfger.getConfiguration().getSize());
+
+        bool unwanted_accepted = false;
+        bool wanted_accepted[sizeof(Wanted) / sizeof(Wanted[0])] = { };
+        for (unsigned k = 0; k < cfger.getConfiguration().getSize(); k++)
+        {
+            const uavcan::CanFilterConfig& cfg = *cfger.getConfiguration().getByIndex(k);
+            const uavcan::uint32_t unwanted_key = uavcan::CanBusTrafficMonitor::makeKey(makeMessageCanID(Unwanted, 1));
+            unwanted_accepted = unwanted_accepted || uavcan::CanBusTrafficMonitor::isAcceptedBy(unwanted_key, cfg);
+            for (unsigned i = 0; i < (sizeof(Wanted) / sizeof(Wanted[0])); i++)
+            {
+                const uavcan::uint32_t key = uavcan::CanBusTrafficMonitor::makeKey(makeMessageCanID(Wanted[i], 1));
+                wanted_accepted[i] = wanted_accepted[i] || uavcan::CanBusTrafficMonitor::isAcceptedBy(key, cfg);
+            }
+        }
+
+        for (unsigned i = 0; i < (sizeof(Wanted) / sizeof(Wanted[0])); i++)
+        {
+            ASSERT_TRUE(wanted_accepted[i]);
+        }
+        ASSERT_EQ(use_monitor == 0, unwanted_accepted);
+    }
+}
+
+TEST(CanAcceptanceFilter, Updater)
+{
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(1, clock_driver);
+    TestNode node(can_driver, clock_driver, 24);
+
+    {
+        uavcan::CanAcceptanceFilterUpdater updater(node);
+        ASSERT_FALSE(updater.isRunning());
+
+        updater.start(uavcan::MonotonicDuration::fromMSec(10));
+        ASSERT_TRUE(updater.isRunning());
+        ASSERT_EQ(&updater.getTrafficMonitor(), node.getDispatcher().getRxFrameListener());
+
+        ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(30)));
+        ASSERT_EQ(0, updater.getLastResult());
+        ASSERT_EQ(0, updater.update(false));      // Nothing changed
+        ASSERT_EQ(0, updater.update());
+
+        updater.stop();
+        ASSERT_FALSE(updater.isRunning());
+        ASSERT_EQ(UAVCAN_NULLPTR, node.getDispatcher().getRxFrameListener());
+
+        updater.start();
+    }
+    ASSERT_EQ(UAVCAN_NULLPTR, node.getDispatcher().getRxFrameListener());   // Removed by the destructor
+}
+
+TEST(CanAcceptanceFilter, SourceNodeFilter)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::equipment::ahrs::Solution> _reg1;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(1, clock_driver);
+    TestNode node(can_driver, clock_driver, 24);
+
+    SubscriptionListener<uavcan::equipment::ahrs::Solution> listener;
+    uavcan::Subscriber<uavcan::equipment::ahrs::Solution,
+                       SubscriptionListener<uavcan::equipment::ahrs::Solution>::ExtendedBinder> sub(node);
+
+    // Nodes 10 (0001010) and 14 (0001110) differ in one bit only
+    uavcan::NodeIDSet sources;
+    sources.add(10);
+    sources.add(14);
+    ASSERT_EQ(0, sub.setSourceNodeFilter(sources));
+    ASSERT_LE(0, sub.start(listener.bindExtended()));
+    ASSERT_GT(0, sub.startShared(listener.bindExtended()));        // Filtered subscribers can't be shared
+
+    uavcan::CanAcceptanceFilterConfigurator cfger(node, 10);
+    ASSERT_EQ(0, cfger.computeConfiguration(uavcan::CanAcceptanceFilterConfigurator::IgnoreAnonymousMessages));
+    ASSERT_EQ(2, cfger.getConfiguration().getSize());               // Service frames and the message
+
+    const uavcan::uint16_t dtid = uavcan::equipment::ahrs::Solution::DefaultDataTypeID;
+    bool found = false;
+    for (unsigned k = 0; k < cfger.getConfiguration().getSize(); k++)
+    {
+        const uavcan::CanFilterConfig& cfg = *cfger.getConfiguration().getByIndex(k);
+        if ((cfg.id & 0x80) != 0)
+        {
+            continue;                                               // Service frames
+        }
+        found = true;
+        ASSERT_EQ(0xFFFFFB | uavcan::CanFrame::FlagEFF | uavcan::CanFrame::FlagRTR | uavcan::CanFrame::FlagERR,
+                  cfg.mask);
+        ASSERT_EQ(0, (makeMessageCanID(dtid, 10) ^ cfg.id) & cfg.mask);
+        ASSERT_EQ(0, (makeMessageCanID(dtid, 14) ^ cfg.id) & cfg.mask);
+        ASSERT_NE(0, (makeMessageCanID(dtid, 11) ^ cfg.id) & cfg.mask);
+    }
+    ASSERT_TRUE(found);
+}
+
 #endif
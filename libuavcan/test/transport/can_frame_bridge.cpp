@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/transport/can_frame_bridge.hpp>
+#include <uavcan/transport/frame.hpp>
+#include "can/can.hpp"
+
+#if !UAVCAN_TINY
+
+static uavcan::CanRxFrame makeFrame(uavcan::uint16_t dtid, uavcan::TransferType transfer_type,
+                                    uavcan::uint8_t src_node_id, uavcan::uint8_t dst_node_id,
+                                    uavcan::uint8_t iface_index = 0)
+{
+    uavcan::Frame frame(dtid, transfer_type, src_node_id, dst_node_id, 3);
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    frame.setPriority(20);
+    const uavcan::uint8_t payload[3] = { 1, 2, 3 };
+    frame.setPayload(payload, sizeof(payload));
+
+    uavcan::CanRxFrame can_frame;
+    EXPECT_TRUE(frame.compile(can_frame));
+    can_frame.iface_index = iface_index;
+    return can_frame;
+}
+
+
+TEST(CanFrameBridge, Routing)
+{
+    using uavcan::CanFrameBridge;
+    using uavcan::TransferTypeMessageBroadcast;
+    using uavcan::TransferTypeServiceRequest;
+    using uavcan::TransferTypeServiceResponse;
+
+    CanFrameBridge::Route route = CanFrameBridge::makeMessageRoute(1000);
+    EXPECT_TRUE(route.matches(makeFrame(1000, TransferTypeMessageBroadcast, 10, 0).id));
+    EXPECT_TRUE(route.matches(makeFrame(1000, TransferTypeMessageBroadcast, 11, 0).id));
+    EXPECT_FALSE(route.matches(makeFrame(1001, TransferTypeMessageBroadcast, 10, 0).id));
+    EXPECT_FALSE(route.matches(makeFrame(232, TransferTypeServiceRequest, 10, 20).id));   // 1000 & 0xFF
+
+    route = CanFrameBridge::makeMessageRoute(1000, 10);
+    EXPECT_TRUE(route.matches(makeFrame(1000, TransferTypeMessageBroadcast, 10, 0).id));
+    EXPECT_FALSE(route.matches(makeFrame(1000, TransferTypeMessageBroadcast, 11, 0).id));
+
+    route = CanFrameBridge::makeServiceRoute(30);
+    EXPECT_TRUE(route.matches(makeFrame(30, TransferTypeServiceRequest, 10, 20).id));
+    EXPECT_TRUE(route.matches(makeFrame(30, TransferTypeServiceResponse, 20, 10).id));
+    EXPECT_FALSE(route.matches(makeFrame(31, TransferTypeServiceRequest, 10, 20).id));
+    EXPECT_FALSE(route.matches(makeFrame(30, TransferTypeMessageBroadcast, 10, 0).id));
+
+    route = CanFrameBridge::makeServiceRoute(30, 20);
+    EXPECT_TRUE(route.matches(makeFrame(30, TransferTypeServiceRequest, 10, 20).id));
+    EXPECT_FALSE(route.matches(makeFrame(30, TransferTypeServiceResponse, 20, 10).id));
+}
+
+
+TEST(CanFrameBridge, Forwarding)
+{
+    using uavcan::CanFrameBridge;
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+    using uavcan::TransferTypeMessageBroadcast;
+    using uavcan::TransferTypeServiceRequest;
+
+    uavcan::PoolAllocator<sizeof(CanTxQueue::Entry) * 8, sizeof(CanTxQueue::Entry)> pool;
+    SystemClockMock clockmock(1000);
+    CanDriverMock driver(2, clockmock);
+    CanIOManager target(driver, pool, clockmock);
+
+    CanFrameBridge bridge(target, clockmock);
+    ASSERT_EQ(0, bridge.addMessageRoute(1000, uavcan::NodeID(), 1));
+    ASSERT_EQ(0, bridge.addServiceRoute(30, 20));
+    ASSERT_EQ(2, bridge.getNumRoutes());
+
+    // Routed frames go out unchanged to the interfaces of their route
+    const uavcan::CanRxFrame msg = makeFrame(1000, TransferTypeMessageBroadcast, 10, 0);
+    bridge.handleRxFrame(msg, uavcan::CanIOFlags());
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(msg, 1000 + CanFrameBridge::DefaultTxTimeoutMs * 1000U));
+    EXPECT_TRUE(driver.ifaces.at(1).tx.empty());
+
+    const uavcan::CanRxFrame req = makeFrame(30, TransferTypeServiceRequest, 10, 20);
+    bridge.handleRxFrame(req, uavcan::CanIOFlags());
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(req, 1000 + CanFrameBridge::DefaultTxTimeoutMs * 1000U));
+    EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(req, 1000 + CanFrameBridge::DefaultTxTimeoutMs * 1000U));
+    EXPECT_EQ(2, bridge.getNumForwardedFrames());
+
+    // Not routed, loopback, or from an excluded interface
+    bridge.handleRxFrame(makeFrame(30, TransferTypeServiceRequest, 10, 21), uavcan::CanIOFlags());
+    bridge.handleRxFrame(msg, uavcan::CanIOFlagLoopback);
+    bridge.setRxIfaceMask(1);
+    bridge.handleRxFrame(makeFrame(1000, TransferTypeMessageBroadcast, 10, 0, 1), uavcan::CanIOFlags());
+    EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
+    EXPECT_TRUE(driver.ifaces.at(1).tx.empty());
+    EXPECT_EQ(2, bridge.getNumForwardedFrames());
+
+    // The destination is busy, the frame is queued with the bridge timeout
+    driver.ifaces.at(0).writeable = false;
+    bridge.setTxTimeout(uavcan::MonotonicDuration::fromMSec(5));
+    bridge.handleRxFrame(msg, uavcan::CanIOFlags());
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+    EXPECT_EQ(3, bridge.getNumForwardedFrames());
+    target.cleanup(tsMono(1000 + 5001));
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+
+    // Errors
+    driver.ifaces.at(0).writeable = true;
+    driver.select_failure = true;
+    bridge.handleRxFrame(msg, uavcan::CanIOFlags());
+    EXPECT_EQ(1, bridge.getNumDroppedFrames());
+
+    // Table capacity
+    bridge.clearRoutes();
+    for (unsigned i = 0; i < CanFrameBridge::MaxRoutes; i++)
+    {
+        ASSERT_EQ(0, bridge.addMessageRoute(uavcan::uint16_t(i)));
+    }
+    EXPECT_EQ(-uavcan::ErrLogic, bridge.addMessageRoute(2000));
+}
+
+#endif
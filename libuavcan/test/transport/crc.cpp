@@ -30,3 +30,47 @@ TEST(TransferCRC, Correctness)
     crc.add(reinterpret_cast<const uint8_t*>("456789"), 6);
     ASSERT_EQ(0x29B1, crc.get());
 }
+
+
+TEST(TransferCRC, BlockUpdate)
+{
+    // Reference bitwise implementation
+    struct Reference
+    {
+        static uavcan::uint16_t compute(uavcan::uint16_t crc, const uint8_t* bytes, unsigned len)
+        {
+            while (len--)
+            {
+                crc = uavcan::uint16_t(crc ^ (*bytes++ << 8));
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    crc = uavcan::uint16_t((crc & 0x8000U) ? ((crc << 1) ^ 0x1021U) : (crc << 1));
+                }
+            }
+            return crc;
+        }
+    };
+
+    uint8_t data[300];
+    for (unsigned i = 0; i < sizeof(data); i++)
+    {
+        data[i] = uint8_t(i * 7U + (i >> 3));
+    }
+
+    // All lengths and alignments around the slice size, so that both the sliced and the bytewise paths are covered
+    for (unsigned offset = 0; offset < 9; offset++)
+    {
+        for (unsigned len = 0; len <= (sizeof(data) - offset); len += (len < 40) ? 1 : 37)
+        {
+            uavcan::TransferCRC crc;
+            crc.add(data + offset, len);
+            ASSERT_EQ(Reference::compute(0xFFFF, data + offset, len), crc.get()) << offset << " " << len;
+
+            // Split in two parts
+            uavcan::TransferCRC split;
+            split.add(data + offset, len / 3U);
+            split.add(data + offset + len / 3U, len - len / 3U);
+            ASSERT_EQ(crc.get(), split.get());
+        }
+    }
+}
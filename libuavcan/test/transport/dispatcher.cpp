@@ -217,6 +217,20 @@ TEST(Dispatcher, Reception)
         ASSERT_TRUE(subscribers[i]->isEmpty());
     }
 
+    /*
+     * Unregistering from the wrong registry does nothing, e.g. when a subscriber is stopped
+     */
+    for (int i = 3; i < NumSubscribers; i++)
+    {
+        dispatcher.unregisterMessageListener(subscribers[i].get());
+    }
+    dispatcher.unregisterServiceResponseListener(subscribers[3].get());
+    dispatcher.unregisterServiceRequestListener(subscribers[4].get());
+    dispatcher.unregisterServiceRequestListener(subscribers[5].get());
+    ASSERT_EQ(3, dispatcher.getNumMessageListeners());
+    ASSERT_EQ(1, dispatcher.getNumServiceRequestListeners());
+    ASSERT_EQ(2, dispatcher.getNumServiceResponseListeners());
+
     /*
      * Unregistering all transfers
      */
@@ -246,6 +260,307 @@ TEST(Dispatcher, Reception)
 }
 
 
+TEST(Dispatcher, ListenerIndex)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    DispatcherTransferEmulator emulator(driver, SELF_NODE_ID);
+
+    /*
+     * More unique data types than the index can hold, so that the fallback path is exercised too
+     */
+    static const unsigned NumTypes = UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY + 2;
+    std::vector<uavcan::DataTypeDescriptor> types;
+    for (unsigned i = 0; i < NumTypes; i++)
+    {
+        types.push_back(makeDataType(uavcan::DataTypeKindMessage, uint16_t(1000 + i * 7)));
+    }
+
+    typedef std::unique_ptr<TestListener> TestListenerPtr;
+    std::vector<TestListenerPtr> listeners;
+    for (unsigned i = 0; i < NumTypes; i++)
+    {
+        listeners.push_back(TestListenerPtr(new TestListener(dispatcher.getTransferPerfCounter(), types[i], 8, pool)));
+    }
+
+    // Registering in shuffled order
+    for (unsigned i = 0; i < NumTypes; i += 2)
+    {
+        ASSERT_TRUE(dispatcher.registerMessageListener(listeners[i].get()));
+    }
+    for (unsigned i = 1; i < NumTypes; i += 2)
+    {
+        ASSERT_TRUE(dispatcher.registerMessageListener(listeners[i].get()));
+    }
+    ASSERT_EQ(NumTypes, dispatcher.getNumMessageListeners());
+    ASSERT_FALSE(dispatcher.isListenerLookupIndexed(uavcan::TransferTypeMessageBroadcast));
+
+    for (unsigned i = 0; i < NumTypes; i++)
+    {
+        ASSERT_TRUE(dispatcher.hasSubscriber(types[i].getID()));
+        ASSERT_FALSE(dispatcher.hasSubscriber(uint16_t(types[i].getID().get() + 1)));
+        ASSERT_FALSE(dispatcher.hasSubscriber(uint16_t(types[i].getID().get() + 256)));   // Same bitmap bit
+    }
+
+    // Going back below the capacity - the index will be used again
+    dispatcher.unregisterMessageListener(listeners[0].get());
+    dispatcher.unregisterMessageListener(listeners[NumTypes - 1].get());
+    ASSERT_EQ(NumTypes - 2, dispatcher.getNumMessageListeners());
+    ASSERT_EQ(UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY > 0,
+              dispatcher.isListenerLookupIndexed(uavcan::TransferTypeMessageBroadcast));
+
+    ASSERT_FALSE(dispatcher.hasSubscriber(types[0].getID()));
+    ASSERT_FALSE(dispatcher.hasSubscriber(types[NumTypes - 1].getID()));
+    for (unsigned i = 1; i < (NumTypes - 1); i++)
+    {
+        ASSERT_TRUE(dispatcher.hasSubscriber(types[i].getID()));
+    }
+
+    // Second listener of an already indexed data type
+    TestListener duplicate(dispatcher.getTransferPerfCounter(), types[5], 8, pool);
+    ASSERT_TRUE(dispatcher.registerMessageListener(&duplicate));
+
+    /*
+     * Reception
+     */
+    const Transfer transfers[4] =
+    {
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "abc", types[1]),
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "def", types[5]),
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "ghi", types[NumTypes - 2]),
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "jkl", types[0])      // Nobody listens
+    };
+    emulator.send(transfers);
+
+    while (dispatcher.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+
+    ASSERT_TRUE(listeners[1]->matchAndPop(transfers[0]));
+    ASSERT_TRUE(listeners[5]->matchAndPop(transfers[1]));
+    ASSERT_TRUE(duplicate.matchAndPop(transfers[1]));
+    ASSERT_TRUE(listeners[NumTypes - 2]->matchAndPop(transfers[2]));
+
+    for (unsigned i = 0; i < NumTypes; i++)
+    {
+        ASSERT_TRUE(listeners[i]->isEmpty());
+    }
+
+    dispatcher.unregisterMessageListener(&duplicate);
+    for (unsigned i = 0; i < NumTypes; i++)
+    {
+        dispatcher.unregisterMessageListener(listeners[i].get());
+    }
+    ASSERT_EQ(0, dispatcher.getNumMessageListeners());
+    ASSERT_EQ(UAVCAN_DISPATCHER_LISTENER_INDEX_CAPACITY > 0,
+              dispatcher.isListenerLookupIndexed(uavcan::TransferTypeMessageBroadcast));
+}
+
+
+TEST(Dispatcher, EarlyRejection)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    /*
+     * Data type IDs that differ by a multiple of 256 share the same bit of the pre-parse bitmap
+     */
+    const uavcan::DataTypeDescriptor msg_type = makeDataType(uavcan::DataTypeKindMessage, 1);
+    const uavcan::DataTypeDescriptor msg_alias = makeDataType(uavcan::DataTypeKindMessage, 257);
+    const uavcan::DataTypeDescriptor msg_other = makeDataType(uavcan::DataTypeKindMessage, 2);
+    const uavcan::DataTypeDescriptor srv_type = makeDataType(uavcan::DataTypeKindService, 1);
+    const uavcan::DataTypeDescriptor srv_other = makeDataType(uavcan::DataTypeKindService, 2);
+
+    TestListener msg_listener(dispatcher.getTransferPerfCounter(), msg_type, 8, pool);
+    TestListener srv_listener(dispatcher.getTransferPerfCounter(), srv_type, 8, pool);
+    ASSERT_TRUE(dispatcher.registerMessageListener(&msg_listener));
+    ASSERT_TRUE(dispatcher.registerServiceRequestListener(&srv_listener));
+
+    DispatcherTransferEmulator emulator(driver, SELF_NODE_ID);
+    DispatcherTransferEmulator emulator_other_node(driver, uavcan::NodeID(uint8_t(SELF_NODE_ID.get() + 1)));
+
+    const Transfer transfers[] =
+    {
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "abc", msg_type),
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 11, "def", msg_alias),     // Nobody listens
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 12, "ghi", msg_other),     // Nobody listens
+        emulator.makeTransfer(0, uavcan::TransferTypeServiceRequest,   13, "jkl", srv_type),
+        emulator.makeTransfer(0, uavcan::TransferTypeServiceRequest,   14, "mno", srv_other),     // Nobody listens
+        emulator.makeTransfer(0, uavcan::TransferTypeServiceResponse,  15, "pqr", srv_type)       // Nobody listens
+    };
+    emulator.send(transfers);
+
+    const Transfer foreign = emulator_other_node.makeTransfer(0, uavcan::TransferTypeServiceRequest, 16, "stu",
+                                                              srv_type);
+    emulator_other_node.send(&foreign, 1);
+
+    while (dispatcher.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+
+    ASSERT_TRUE(msg_listener.matchAndPop(transfers[0]));
+    ASSERT_TRUE(srv_listener.matchAndPop(transfers[3]));
+    ASSERT_TRUE(msg_listener.isEmpty());
+    ASSERT_TRUE(srv_listener.isEmpty());
+
+    /*
+     * Once the listener is removed, its data type is rejected before parsing
+     */
+    dispatcher.unregisterMessageListener(&msg_listener);
+    const Transfer late = emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "vwx", msg_type);
+    emulator.send(&late, 1);
+    while (dispatcher.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+    ASSERT_TRUE(msg_listener.isEmpty());
+
+    dispatcher.unregisterServiceRequestListener(&srv_listener);
+}
+
+
+#if !UAVCAN_TINY
+#if UAVCAN_DISPATCHER_RX_RATE_LIMITING
+TEST(Dispatcher, RxRateLimiting)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    // One transfer per second with the burst of two, per source node
+    dispatcher.getRxRateLimiter().setLimit(uavcan::TransferTypeMessageBroadcast, 1, 2);
+
+    const uavcan::DataTypeDescriptor msg_type = makeDataType(uavcan::DataTypeKindMessage, 1);
+    TestListener msg_listener(dispatcher.getTransferPerfCounter(), msg_type, 8, pool);
+    ASSERT_TRUE(dispatcher.registerMessageListener(&msg_listener));
+
+    DispatcherTransferEmulator emulator(driver, SELF_NODE_ID);
+
+    const Transfer transfers[] =
+    {
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "abc", msg_type),
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "def", msg_type),
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "ghi", msg_type),     // Throttled
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "jkl", msg_type),     // Throttled
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 11, "mno", msg_type)
+    };
+    emulator.send(transfers);
+
+    while (dispatcher.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+
+    ASSERT_TRUE(msg_listener.matchAndPop(transfers[0]));
+    ASSERT_TRUE(msg_listener.matchAndPop(transfers[1]));
+    ASSERT_TRUE(msg_listener.matchAndPop(transfers[4]));
+    ASSERT_TRUE(msg_listener.isEmpty());
+
+    ASSERT_EQ(2, dispatcher.getRxRateLimiter().getNumThrottledTransfers());
+    ASSERT_EQ(10, dispatcher.getRxRateLimiter().getLastThrottledNodeID().get());
+
+    dispatcher.unregisterMessageListener(&msg_listener);
+}
+#endif
+
+
+TEST(Dispatcher, RxDemultiplexer)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock front_driver(1, clockmock);
+    CanDriverMock virtual_driver(1, clockmock);     // Transmission only
+
+    const uavcan::NodeID virtual_node_id(uint8_t(SELF_NODE_ID.get() + 1));
+
+    uavcan::Dispatcher front(front_driver, pool, clockmock);
+    uavcan::Dispatcher virt(virtual_driver, pool, clockmock);
+    ASSERT_TRUE(front.setNodeID(SELF_NODE_ID));
+    ASSERT_TRUE(virt.setNodeID(virtual_node_id));
+
+    uavcan::RxFrameDemultiplexer demux;
+    ASSERT_EQ(0, demux.addNode(front));
+    ASSERT_EQ(0, demux.addNode(virt));
+    ASSERT_EQ(-uavcan::ErrLogic, demux.addNode(virt));
+    ASSERT_EQ(2, demux.getNumNodes());
+    front.installRxDemultiplexer(&demux);
+    ASSERT_EQ(&demux, front.getRxDemultiplexer());
+
+    const uavcan::DataTypeDescriptor msg_type = makeDataType(uavcan::DataTypeKindMessage, 1);
+    const uavcan::DataTypeDescriptor srv_type = makeDataType(uavcan::DataTypeKindService, 1);
+
+    TestListener front_msg_listener(front.getTransferPerfCounter(), msg_type, 8, pool);
+    TestListener virt_msg_listener(virt.getTransferPerfCounter(), msg_type, 8, pool);
+    TestListener virt_srv_listener(virt.getTransferPerfCounter(), srv_type, 8, pool);
+    ASSERT_TRUE(front.registerMessageListener(&front_msg_listener));
+    ASSERT_TRUE(virt.registerMessageListener(&virt_msg_listener));
+    ASSERT_TRUE(virt.registerServiceRequestListener(&virt_srv_listener));
+
+    DispatcherTransferEmulator emulator_front(front_driver, SELF_NODE_ID);
+    DispatcherTransferEmulator emulator_virt(front_driver, virtual_node_id);
+
+    const Transfer msg = emulator_front.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "abc", msg_type);
+    const Transfer req_virt = emulator_virt.makeTransfer(0, uavcan::TransferTypeServiceRequest, 11, "def", srv_type);
+    const Transfer req_front = emulator_front.makeTransfer(0, uavcan::TransferTypeServiceRequest, 12, "ghi",
+                                                           srv_type);     // Nobody listens
+    emulator_front.send(&msg, 1);
+    emulator_virt.send(&req_virt, 1);
+    emulator_front.send(&req_front, 1);
+
+    while (front.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+    ASSERT_EQ(0, virt.spinOnce());
+
+    // Both nodes got the message, but every frame was parsed once, and the uninteresting one was not parsed at all
+    ASSERT_TRUE(front_msg_listener.matchAndPop(msg));
+    ASSERT_TRUE(virt_msg_listener.matchAndPop(msg));
+    ASSERT_TRUE(virt_srv_listener.matchAndPop(req_virt));
+    ASSERT_TRUE(front_msg_listener.isEmpty());
+    ASSERT_TRUE(virt_msg_listener.isEmpty());
+    ASSERT_TRUE(virt_srv_listener.isEmpty());
+    EXPECT_EQ(2, demux.getNumFramesParsed());
+
+    // A removed node receives nothing
+    demux.removeNode(virt);
+    ASSERT_FALSE(demux.hasNode(virt));
+    ASSERT_TRUE(demux.hasNode(front));
+    const Transfer msg2 = emulator_front.makeTransfer(1, uavcan::TransferTypeMessageBroadcast, 10, "jkl", msg_type);
+    emulator_front.send(&msg2, 1);
+    while (front.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+    ASSERT_TRUE(front_msg_listener.matchAndPop(msg2));
+    ASSERT_TRUE(virt_msg_listener.isEmpty());
+
+    front.removeRxDemultiplexer();
+    front.unregisterMessageListener(&front_msg_listener);
+    virt.unregisterMessageListener(&virt_msg_listener);
+    virt.unregisterServiceRequestListener(&virt_srv_listener);
+}
+#endif
+
+
 TEST(Dispatcher, Transmission)
 {
     uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
@@ -332,6 +647,71 @@ TEST(Dispatcher, Spin)
 }
 
 
+#if UAVCAN_DISPATCHER_RX_STAGING_CAPACITY > 0
+
+TEST(Dispatcher, RxPriorityStaging)
+{
+    NullAllocator poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    RxFrameListener rx_listener;
+    dispatcher.installRxFrameListener(&rx_listener);
+
+    // A burst of low priority frames, with two high priority ones queued behind it
+    const uint32_t LowPrioID = 0x1F00107FU | uavcan::CanFrame::FlagEFF;
+    const uint32_t HighPrioID = 0x00010201U | uavcan::CanFrame::FlagEFF;
+    const uint32_t MidPrioID = 0x08010201U | uavcan::CanFrame::FlagEFF;
+    const uint32_t ids[] = { LowPrioID, LowPrioID, MidPrioID, LowPrioID, HighPrioID, LowPrioID };
+    const unsigned NumFrames = sizeof(ids) / sizeof(ids[0]);
+
+    const auto push_frames = [&]()
+    {
+        for (uint8_t i = 0; i < NumFrames; i++)
+        {
+            driver.ifaces.at(0).pushRx(uavcan::CanFrame(ids[i], &i, 1));
+        }
+    };
+
+    /*
+     * FIFO order by default
+     */
+    ASSERT_FALSE(dispatcher.isRxPriorityStagingEnabled());
+    push_frames();
+    ASSERT_EQ(NumFrames, dispatcher.spinOnce());
+    ASSERT_EQ(NumFrames, rx_listener.rx_frames.size());
+    for (unsigned i = 0; i < NumFrames; i++)
+    {
+        ASSERT_EQ(ids[i], rx_listener.rx_frames[i].id);
+    }
+
+    /*
+     * Priority order, the frames with the same CAN ID keep their order
+     */
+    dispatcher.enableRxPriorityStaging(true);
+    ASSERT_TRUE(dispatcher.isRxPriorityStagingEnabled());
+    rx_listener.rx_frames.clear();
+    push_frames();
+    ASSERT_EQ(NumFrames, dispatcher.spin(tsMono(1000)));
+    ASSERT_EQ(NumFrames, rx_listener.rx_frames.size());
+
+    const uint8_t expected_order[] = { 4, 2, 0, 1, 3, 5 };
+    for (unsigned i = 0; i < NumFrames; i++)
+    {
+        ASSERT_EQ(ids[expected_order[i]], rx_listener.rx_frames[i].id);
+        ASSERT_EQ(expected_order[i], rx_listener.rx_frames[i].data[0]);
+    }
+
+    dispatcher.removeRxFrameListener();
+}
+
+#endif
+
+
 struct DispatcherTestLoopbackFrameListener : public uavcan::LoopbackFrameListenerBase
 {
     uavcan::RxFrame last_frame;
@@ -390,3 +770,228 @@ TEST(Dispatcher, Loopback)
     }
     ASSERT_EQ(0, dispatcher.getLoopbackFrameListenerRegistry().getNumListeners());
 }
+
+TEST(Dispatcher, LoopbackFiltered)
+{
+    NullAllocator poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    DispatcherTestLoopbackFrameListener listener(dispatcher);
+    listener.startListening(456, uavcan::TransferTypeMessageBroadcast);
+    ASSERT_TRUE(listener.isListening());
+
+    // Same data type ID, different transfer type; different data type ID, same transfer type
+    uavcan::Frame rejected_frames[] = {
+        uavcan::Frame(200, uavcan::TransferTypeServiceResponse, SELF_NODE_ID, 2, 0),
+        uavcan::Frame(457, uavcan::TransferTypeMessageBroadcast, SELF_NODE_ID, uavcan::NodeID::Broadcast, 0)
+    };
+    for (unsigned i = 0; i < sizeof(rejected_frames) / sizeof(rejected_frames[0]); i++)
+    {
+        rejected_frames[i].setPayload(reinterpret_cast<const uint8_t*>("123"), 3);
+        ASSERT_LE(0, dispatcher.send(rejected_frames[i], tsMono(1000), tsMono(0), uavcan::CanTxQueue::Persistent,
+                                     uavcan::CanIOFlagLoopback, 0xFF));
+    }
+    ASSERT_EQ(0, dispatcher.spin(tsMono(1000)));
+    ASSERT_EQ(0, listener.count);
+
+    uavcan::Frame frame(456, uavcan::TransferTypeMessageBroadcast, SELF_NODE_ID, uavcan::NodeID::Broadcast, 0);
+    frame.setPayload(reinterpret_cast<const uint8_t*>("123"), 3);
+    ASSERT_LE(0, dispatcher.send(frame, tsMono(1000), tsMono(0), uavcan::CanTxQueue::Persistent,
+                                 uavcan::CanIOFlagLoopback, 0xFF));
+    ASSERT_EQ(0, dispatcher.spin(tsMono(1000)));
+    ASSERT_EQ(2, listener.count);              // One per iface
+    ASSERT_TRUE(listener.last_frame == frame);
+}
+
+
+struct DispatcherTestTxCompletionTracker : public uavcan::TxCompletionTracker
+{
+    unsigned num_ready_calls;
+
+    DispatcherTestTxCompletionTracker(uavcan::Dispatcher& dispatcher)
+        : uavcan::TxCompletionTracker(dispatcher)
+        , num_ready_calls(0)
+    { }
+
+    virtual void handleTxReady() { num_ready_calls++; }
+};
+
+TEST(Dispatcher, TxCompletionTracker)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    DispatcherTestTxCompletionTracker tracker(dispatcher);
+    ASSERT_FALSE(tracker.isStarted());
+    tracker.start(456, uavcan::TransferTypeMessageBroadcast);
+    ASSERT_TRUE(tracker.isStarted());
+    tracker.setReadyThreshold(2);
+
+    /*
+     * The interfaces are busy, so everything is queued; only the tracked data type is counted, once per iface
+     */
+    driver.ifaces.at(0).writeable = false;
+    driver.ifaces.at(1).writeable = false;
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        uavcan::Frame frame(456, uavcan::TransferTypeMessageBroadcast, SELF_NODE_ID, uavcan::NodeID::Broadcast, i);
+        frame.setPayload(reinterpret_cast<const uint8_t*>("123"), 3);
+        ASSERT_EQ(0, dispatcher.send(frame, tsMono(100000), tsMono(0), uavcan::CanTxQueue::Volatile,
+                                     uavcan::CanIOFlags(), 0xFF));
+    }
+    uavcan::Frame other(457, uavcan::TransferTypeMessageBroadcast, SELF_NODE_ID, uavcan::NodeID::Broadcast, 0);
+    other.setPayload(reinterpret_cast<const uint8_t*>("123"), 3);
+    ASSERT_EQ(0, dispatcher.send(other, tsMono(100000), tsMono(0), uavcan::CanTxQueue::Volatile,
+                                 uavcan::CanIOFlags(), 0xFF));
+
+    ASSERT_EQ(6, tracker.getNumFramesInFlight());
+    ASSERT_EQ(0, tracker.getNumFramesCompleted());
+    ASSERT_FALSE(tracker.isReady());
+
+    /*
+     * One iface drains its queue; the notification is delivered from the spin, not from the TX path
+     */
+    driver.ifaces.at(0).writeable = true;
+    ASSERT_EQ(0, dispatcher.spin(clockmock.getMonotonic() + durMono(1000)));
+    ASSERT_EQ(3, tracker.getNumFramesInFlight());
+    ASSERT_EQ(3, tracker.getNumFramesCompleted());
+    ASSERT_EQ(0, tracker.num_ready_calls);
+
+    driver.ifaces.at(1).writeable = true;
+    ASSERT_EQ(0, dispatcher.spin(clockmock.getMonotonic() + durMono(1000)));
+    ASSERT_EQ(0, tracker.getNumFramesInFlight());
+    ASSERT_EQ(6, tracker.getNumFramesCompleted());
+    ASSERT_EQ(1, tracker.num_ready_calls);
+    ASSERT_TRUE(tracker.isReady());
+
+    /*
+     * Expired frames are completed as well
+     */
+    driver.ifaces.at(0).writeable = false;
+    driver.ifaces.at(1).writeable = false;
+    uavcan::Frame frame(456, uavcan::TransferTypeMessageBroadcast, SELF_NODE_ID, uavcan::NodeID::Broadcast, 3);
+    frame.setPayload(reinterpret_cast<const uint8_t*>("123"), 3);
+    ASSERT_EQ(0, dispatcher.send(frame, clockmock.getMonotonic() + durMono(100), tsMono(0),
+                                 uavcan::CanTxQueue::Volatile, uavcan::CanIOFlags(), 0xFF));
+    ASSERT_EQ(2, tracker.getNumFramesInFlight());
+    clockmock.advance(1000);
+    dispatcher.cleanup(clockmock.getMonotonic(), 0, 1);
+    ASSERT_EQ(0, tracker.getNumFramesInFlight());
+    ASSERT_EQ(8, tracker.getNumFramesCompleted());
+
+    tracker.stop();
+    ASSERT_FALSE(tracker.isStarted());
+    ASSERT_EQ(0, dispatcher.getTxCompletionTrackerRegistry().getNumTrackers());
+}
+
+
+namespace
+{
+struct CleanupCountingListener : public TestListener
+{
+    unsigned num_cleanups;
+
+    CleanupCountingListener(uavcan::TransferPerfCounter& perf, const uavcan::DataTypeDescriptor& data_type,
+                            uavcan::IPoolAllocator& allocator)
+        : TestListener(perf, data_type, 8, allocator)
+        , num_cleanups(0)
+    { }
+
+    virtual void cleanup(uavcan::MonotonicTime ts) override
+    {
+        num_cleanups++;
+        TestListener::cleanup(ts);
+    }
+};
+}
+
+TEST(Dispatcher, SlicedCleanup)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    static const unsigned NumMessageListeners = 7;
+    static const unsigned NumServiceListeners = 3;
+    static const unsigned NumSlices = 4;
+
+    typedef std::unique_ptr<CleanupCountingListener> ListenerPtr;
+    std::vector<uavcan::DataTypeDescriptor> types;
+    std::vector<ListenerPtr> listeners;
+    for (unsigned i = 0; i < NumMessageListeners + NumServiceListeners; i++)
+    {
+        const bool service = i >= NumMessageListeners;
+        types.push_back(makeDataType(service ? uavcan::DataTypeKindService : uavcan::DataTypeKindMessage,
+                                     uint16_t(100 + i)));
+    }
+    for (unsigned i = 0; i < types.size(); i++)
+    {
+        listeners.push_back(ListenerPtr(new CleanupCountingListener(dispatcher.getTransferPerfCounter(),
+                                                                    types[i], pool)));
+        if (i < NumMessageListeners)
+        {
+            ASSERT_TRUE(dispatcher.registerMessageListener(listeners.back().get()));
+        }
+        else
+        {
+            ASSERT_TRUE(dispatcher.registerServiceRequestListener(listeners.back().get()));
+        }
+    }
+
+    // Every slice takes a bounded share of the listeners, and every listener is visited once per round
+    for (unsigned slice = 0; slice < NumSlices; slice++)
+    {
+        unsigned num_cleaned_before = 0;
+        for (auto& x : listeners)
+        {
+            num_cleaned_before += x->num_cleanups;
+        }
+
+        dispatcher.cleanup(tsMono(1000), slice, NumSlices);
+
+        unsigned num_cleaned_after = 0;
+        for (auto& x : listeners)
+        {
+            num_cleaned_after += x->num_cleanups;
+        }
+        ASSERT_GE((listeners.size() + NumSlices - 1) / NumSlices, num_cleaned_after - num_cleaned_before);
+        ASSERT_LT(0, num_cleaned_after - num_cleaned_before);
+    }
+    for (auto& x : listeners)
+    {
+        ASSERT_EQ(1, x->num_cleanups);
+    }
+
+    // The non-sliced version cleans up everything at once
+    dispatcher.cleanup(tsMono(2000));
+    for (auto& x : listeners)
+    {
+        ASSERT_EQ(2, x->num_cleanups);
+    }
+
+    for (unsigned i = 0; i < listeners.size(); i++)
+    {
+        if (i < NumMessageListeners)
+        {
+            dispatcher.unregisterMessageListener(listeners[i].get());
+        }
+        else
+        {
+            dispatcher.unregisterServiceRequestListener(listeners[i].get());
+        }
+    }
+}
@@ -3,6 +3,8 @@
  */
 
 #include <string>
+#include <vector>
+#include <algorithm>
 #include <gtest/gtest.h>
 #include <uavcan/transport/transfer.hpp>
 #include <uavcan/transport/crc.hpp>
@@ -347,6 +349,52 @@ TEST(Frame, RxFrameParse)
 }
 
 
+TEST(Frame, PayloadReference)
+{
+    using uavcan::Frame;
+    using uavcan::RxFrame;
+    using uavcan::CanFrame;
+    using uavcan::CanRxFrame;
+
+    CanRxFrame can_rx_frame;
+    can_rx_frame.ts_mono = tsMono(123);
+    can_rx_frame.id = CanFrame::FlagEFF | (2 << 24) | (456 << 8) | (0 << 7) | (42 << 0);
+    const uint8_t data[] = { 1, 2, 3, 4, 5, 0xc0 };  // SOT, EOT
+    std::copy(data, data + sizeof(data), can_rx_frame.data);
+    can_rx_frame.dlc = sizeof(data);
+
+    RxFrame copied;
+    ASSERT_TRUE(copied.parse(can_rx_frame));
+    ASSERT_FALSE(copied.isPayloadReferenced());
+    ASSERT_NE(can_rx_frame.data, copied.getPayloadPtr());
+
+    RxFrame referenced;
+    ASSERT_TRUE(referenced.parse(can_rx_frame, Frame::PayloadReference));
+    ASSERT_TRUE(referenced.isPayloadReferenced());
+    ASSERT_EQ(can_rx_frame.data, referenced.getPayloadPtr());
+    ASSERT_EQ(5, referenced.getPayloadLen());
+    ASSERT_TRUE(copied == referenced);
+
+    // Compiles into the same CAN frame
+    CanFrame can_frame;
+    ASSERT_TRUE(referenced.compile(can_frame));
+    ASSERT_TRUE(can_frame == static_cast<const CanFrame&>(can_rx_frame));
+
+    // Setting the payload explicitly drops the reference
+    const uint8_t new_payload[] = { 9, 8 };
+    ASSERT_EQ(2, referenced.setPayload(new_payload, sizeof(new_payload)));
+    ASSERT_FALSE(referenced.isPayloadReferenced());
+    ASSERT_EQ(9, referenced.getPayloadPtr()[0]);
+    ASSERT_EQ(1, can_rx_frame.data[0]);
+
+    // Parsing again with copying drops the reference too
+    ASSERT_TRUE(referenced.parse(can_rx_frame, Frame::PayloadReference));
+    ASSERT_TRUE(referenced.parse(can_rx_frame));
+    ASSERT_FALSE(referenced.isPayloadReferenced());
+    ASSERT_TRUE(copied == referenced);
+}
+
+
 TEST(Frame, FrameToString)
 {
     using uavcan::Frame;
@@ -387,3 +435,119 @@ TEST(Frame, FrameToString)
     EXPECT_EQ("prio=31 dtid=65535 tt=2 snid=127 dnid=0 sot=1 eot=1 togl=1 tid=31 payload=[00 01 02 03 04 05 06]",
               frame.toString());
 }
+
+
+TEST(TransferFramePlan, Basic)
+{
+    using uavcan::TransferFramePlan;
+
+    // Classic CAN
+    TransferFramePlan plan(0, 7);
+    EXPECT_EQ(1, plan.num_frames);
+    EXPECT_EQ(0, plan.last_frame_payload_len);
+    EXPECT_EQ(0, plan.num_padding_bytes);
+    EXPECT_EQ(1, plan.getNumBytesOnBus());
+
+    plan = TransferFramePlan(7, 7);
+    EXPECT_EQ(1, plan.num_frames);
+    EXPECT_EQ(7, plan.last_frame_payload_len);
+    EXPECT_EQ(8, plan.getNumBytesOnBus());
+
+    plan = TransferFramePlan(8, 7);                 // 10 bytes with the CRC
+    EXPECT_EQ(2, plan.num_frames);
+    EXPECT_EQ(3, plan.last_frame_payload_len);
+    EXPECT_EQ(0, plan.num_padding_bytes);
+    EXPECT_EQ(12, plan.getNumBytesOnBus());
+
+#if UAVCAN_SUPPORT_CANFD
+    plan = TransferFramePlan(9, 63);                // 9 bytes and the tail byte need 12
+    EXPECT_EQ(1, plan.num_frames);
+    EXPECT_EQ(9, plan.last_frame_payload_len);
+    EXPECT_EQ(2, plan.num_padding_bytes);
+    EXPECT_EQ(12, plan.getNumBytesOnBus());
+
+    plan = TransferFramePlan(63, 63);
+    EXPECT_EQ(1, plan.num_frames);
+    EXPECT_EQ(0, plan.num_padding_bytes);
+
+    plan = TransferFramePlan(64, 63);               // 66 bytes with the CRC
+    EXPECT_EQ(2, plan.num_frames);
+    EXPECT_EQ(3, plan.last_frame_payload_len);
+    EXPECT_EQ(0, plan.num_padding_bytes);
+
+    plan = TransferFramePlan(110, 63);              // 112 bytes with the CRC, 49 of them in the last frame
+    EXPECT_EQ(2, plan.num_frames);
+    EXPECT_EQ(49, plan.last_frame_payload_len);
+    EXPECT_EQ(14, plan.num_padding_bytes);
+    EXPECT_EQ(128, plan.getNumBytesOnBus());
+#endif
+
+    EXPECT_EQ(1, TransferFramePlan::getDlcForPayload(0));
+    EXPECT_EQ(8, TransferFramePlan::getDlcForPayload(7));
+
+#if UAVCAN_SUPPORT_CANFD
+    EXPECT_EQ(9, TransferFramePlan::getDlcForPayload(8));
+    EXPECT_EQ(9, TransferFramePlan::getDlcForPayload(11));
+    EXPECT_EQ(10, TransferFramePlan::getDlcForPayload(12));
+    EXPECT_EQ(15, TransferFramePlan::getDlcForPayload(63));
+#endif
+}
+
+/**
+ * Compares the plan against an exhaustive search over all splits into the same number of frames.
+ */
+TEST(TransferFramePlan, Optimality)
+{
+    using uavcan::TransferFramePlan;
+
+    static const unsigned MaxPayloadLen = 1000;
+    static const unsigned DataLengths[] = { 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+#if UAVCAN_SUPPORT_CANFD
+    static const unsigned Capacities[] = { 7, 63 };
+#else
+    static const unsigned Capacities[] = { 7 };
+#endif
+
+    for (unsigned c = 0; c < sizeof(Capacities) / sizeof(Capacities[0]); c++)
+    {
+        const unsigned capacity = Capacities[c];
+        const unsigned max_frames = (MaxPayloadLen + 2U + capacity - 1U) / capacity;
+
+        // reachable[n][k] - whether n frames can take exactly k bytes on the bus
+        std::vector<std::vector<bool> > reachable(max_frames + 1,
+                                                  std::vector<bool>(max_frames * (capacity + 1U) + 1U, false));
+        reachable[0][0] = true;
+        for (unsigned n = 1; n <= max_frames; n++)
+        {
+            for (unsigned k = 0; k < reachable[n].size(); k++)
+            {
+                for (unsigned i = 0; i < sizeof(DataLengths) / sizeof(DataLengths[0]); i++)
+                {
+                    const unsigned len = DataLengths[i];
+                    if ((len <= capacity + 1U) && (len <= k) && reachable[n - 1][k - len])
+                    {
+                        reachable[n][k] = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        for (unsigned payload_len = 0; payload_len <= MaxPayloadLen; payload_len++)
+        {
+            const TransferFramePlan plan(static_cast<uavcan::uint16_t>(payload_len),
+                                         static_cast<uavcan::uint8_t>(capacity));
+            const unsigned data_len = (payload_len > capacity) ? (payload_len + 2U) : payload_len;
+
+            ASSERT_EQ(std::max((data_len + capacity - 1U) / capacity, 1U), plan.num_frames);
+            ASSERT_EQ(data_len + plan.num_frames + plan.num_padding_bytes, plan.getNumBytesOnBus());
+
+            unsigned best = data_len + plan.num_frames;
+            while (!reachable[plan.num_frames][best])
+            {
+                best++;
+            }
+            ASSERT_EQ(best, plan.getNumBytesOnBus()) << "payload_len=" << payload_len << " capacity=" << capacity;
+        }
+    }
+}
@@ -64,6 +64,10 @@ TEST(SingleFrameIncomingTransfer, Basic)
     SingleFrameIncomingTransfer it(frame);
 
     ASSERT_TRUE(match(it, frame, frame.getPayloadPtr(), frame.getPayloadLen()));
+
+    unsigned len = 0;
+    ASSERT_EQ(frame.getPayloadPtr(), it.getContiguousPayload(len));
+    ASSERT_EQ(frame.getPayloadLen(), len);
 }
 
 
@@ -87,6 +91,10 @@ TEST(MultiFrameIncomingTransfer, Basic)
     uint8_t data_byte = 0;
     ASSERT_GT(0, it.read(0, &data_byte, 1));  // Error - no such buffer
 
+    unsigned len = 1;
+    ASSERT_FALSE(it.getContiguousPayload(len)); // Multi-frame payload is never contiguous
+    ASSERT_EQ(0, len);
+
     /*
      * Filling the test data
      */
@@ -108,3 +116,52 @@ TEST(MultiFrameIncomingTransfer, Basic)
     it.release();
     ASSERT_FALSE(bufmgr.access(bufmgr_key));
 }
+
+
+TEST(LinearizedIncomingTransfer, Basic)
+{
+    using uavcan::RxFrame;
+    using uavcan::LinearizedIncomingTransfer;
+
+    // Single-frame transfers are referenced in place
+    const RxFrame frame = makeFrame();
+    {
+        uavcan::SingleFrameIncomingTransfer it(frame);
+        const LinearizedIncomingTransfer<4> lit(it);
+        ASSERT_EQ(frame.getPayloadPtr(), lit.getData());
+        ASSERT_EQ(frame.getPayloadLen(), lit.getLength());
+    }
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> poolmgr;
+    uavcan::TransferBufferManager bufmgr(256, poolmgr);
+    uavcan::TransferBufferManagerKey bufmgr_key(frame.getSrcNodeID(), frame.getTransferType());
+    uavcan::TransferBufferAccessor tba(bufmgr, bufmgr_key);
+    uavcan::MultiFrameIncomingTransfer it(frame.getMonotonicTimestamp(), frame.getUtcTimestamp(), frame, tba);
+
+    // No buffer
+    ASSERT_FALSE((LinearizedIncomingTransfer<64>(it).getData()));
+
+    const std::string data = "123Hello world, this payload spans several memory blocks";
+    ASSERT_TRUE(bufmgr.create(bufmgr_key));
+    ASSERT_EQ(data.length(), bufmgr.access(bufmgr_key)->write(0, reinterpret_cast<const uint8_t*>(data.c_str()),
+                                                             unsigned(data.length())));
+
+    // Copied if it fits completely
+    {
+        const LinearizedIncomingTransfer<64> lit(it);
+        ASSERT_TRUE(lit.getData());
+        ASSERT_EQ(data.length(), lit.getLength());
+        ASSERT_EQ(data, std::string(reinterpret_cast<const char*>(lit.getData()), lit.getLength()));
+    }
+    {
+        const LinearizedIncomingTransfer<56> lit(it);               // Exactly the length of the payload
+        ASSERT_TRUE(lit.getData());
+        ASSERT_EQ(data.length(), lit.getLength());
+    }
+
+    // Not available otherwise
+    ASSERT_FALSE((LinearizedIncomingTransfer<55>(it).getData()));
+    ASSERT_FALSE((LinearizedIncomingTransfer<0>(it).getData()));
+
+    it.release();
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <uavcan/transport/node_id_set.hpp>
+
+
+namespace
+{
+
+struct Collector
+{
+    std::vector<uint8_t>* output;
+    explicit Collector(std::vector<uint8_t>* arg_output) : output(arg_output) { }
+    void operator()(uavcan::NodeID nid) { output->push_back(nid.get()); }
+};
+
+struct SelfRemover
+{
+    uavcan::NodeIDSet* set;
+    unsigned num_calls;
+    explicit SelfRemover(uavcan::NodeIDSet* arg_set) : set(arg_set), num_calls(0) { }
+    void operator()(uavcan::NodeID nid)
+    {
+        num_calls++;
+        set->remove(nid);
+        set->remove(uint8_t(nid.get() + 1U));      // The next one must be skipped
+    }
+};
+
+}
+
+
+TEST(NodeIDSet, BitHelpers)
+{
+    ASSERT_EQ(0, uavcan::countSetBits(0));
+    ASSERT_EQ(1, uavcan::countSetBits(1));
+    ASSERT_EQ(32, uavcan::countSetBits(0xFFFFFFFFU));
+    ASSERT_EQ(3, uavcan::countSetBits(0x80010100U));
+
+    ASSERT_EQ(0, uavcan::findFirstSetBit(1));
+    ASSERT_EQ(8, uavcan::findFirstSetBit(0x80010100U));
+    ASSERT_EQ(31, uavcan::findFirstSetBit(0x80000000U));
+}
+
+TEST(NodeIDSet, Basic)
+{
+    using uavcan::NodeID;
+
+    uavcan::NodeIDSet set;
+    ASSERT_TRUE(set.isEmpty());
+    ASSERT_EQ(0, set.getSize());
+    ASSERT_FALSE(set.getFirst().isValid());
+    ASSERT_FALSE(set.getNext(NodeID(1)).isValid());
+    ASSERT_FALSE(set.getNextCyclic(NodeID(1)).isValid());
+    ASSERT_FALSE(set.contains(NodeID()));
+
+    set.add(NodeID(1));
+    set.add(NodeID(31));
+    set.add(NodeID(32));
+    set.add(NodeID(127));
+    set.add(NodeID(32));                // Duplicate
+    set.add(NodeID(0));                 // Broadcast is representable as well
+    ASSERT_FALSE(set.isEmpty());
+    ASSERT_EQ(5, set.getSize());
+    ASSERT_TRUE(set.contains(NodeID(0)));
+    ASSERT_TRUE(set.contains(NodeID(32)));
+    ASSERT_FALSE(set.contains(NodeID(33)));
+    ASSERT_FALSE(set.contains(NodeID()));
+
+    set.remove(NodeID(0));
+    set.remove(NodeID(100));            // Not a member
+    set.remove(NodeID());               // Ignored
+    ASSERT_EQ(4, set.getSize());
+
+    // Ordered iteration
+    ASSERT_EQ(1, set.getFirst().get());
+    ASSERT_EQ(1, set.getNext(NodeID()).get());
+    ASSERT_EQ(31, set.getNext(NodeID(1)).get());
+    ASSERT_EQ(32, set.getNext(NodeID(31)).get());
+    ASSERT_EQ(127, set.getNext(NodeID(32)).get());
+    ASSERT_EQ(127, set.getNext(NodeID(64)).get());
+    ASSERT_FALSE(set.getNext(NodeID(127)).isValid());
+
+    // Round-robin
+    ASSERT_EQ(1, set.getNextCyclic(NodeID(127)).get());
+    ASSERT_EQ(31, set.getNextCyclic(NodeID(1)).get());
+    ASSERT_EQ(1, set.getNextCyclic(NodeID(0)).get());
+
+    set.set(NodeID(31), false);
+    set.set(NodeID(50), true);
+    ASSERT_FALSE(set.contains(NodeID(31)));
+    ASSERT_TRUE(set.contains(NodeID(50)));
+
+    std::vector<uint8_t> members;
+    set.forEach(Collector(&members));
+    ASSERT_EQ(4, members.size());
+    ASSERT_EQ(1, members[0]);
+    ASSERT_EQ(32, members[1]);
+    ASSERT_EQ(50, members[2]);
+    ASSERT_EQ(127, members[3]);
+
+    // The only member is returned by the cyclic search
+    set.clear();
+    ASSERT_TRUE(set.isEmpty());
+    set.add(NodeID(64));
+    ASSERT_EQ(64, set.getNextCyclic(NodeID(64)).get());
+    ASSERT_EQ(64, set.getNextCyclic(NodeID(100)).get());
+}
+
+TEST(NodeIDSet, Bulk)
+{
+    using uavcan::NodeID;
+
+    uavcan::NodeIDSet a;
+    uavcan::NodeIDSet b;
+    for (uint8_t i = 1; i <= 100; i++)
+    {
+        a.add(i);
+        if ((i % 2) == 0)
+        {
+            b.add(i);
+        }
+    }
+    b.add(NodeID(120));
+    ASSERT_EQ(100, a.getSize());
+    ASSERT_EQ(51, b.getSize());
+    ASSERT_TRUE(a != b);
+
+    uavcan::NodeIDSet c = a;
+    ASSERT_TRUE(c == a);
+    c.intersect(b);
+    ASSERT_EQ(50, c.getSize());
+    ASSERT_FALSE(c.contains(NodeID(120)));
+    ASSERT_TRUE(c.contains(NodeID(100)));
+    ASSERT_FALSE(c.contains(NodeID(99)));
+
+    c = a;
+    c.remove(b);
+    ASSERT_EQ(50, c.getSize());
+    ASSERT_TRUE(c.contains(NodeID(99)));
+    ASSERT_FALSE(c.contains(NodeID(100)));
+
+    c.add(b);
+    ASSERT_EQ(101, c.getSize());
+    ASSERT_TRUE(c.contains(NodeID(120)));
+
+    // Removal during iteration
+    SelfRemover remover(&a);
+    a.forEach(remover);
+    ASSERT_TRUE(a.isEmpty());
+    uavcan::NodeIDSet a2;
+    for (uint8_t i = 1; i <= 100; i++)
+    {
+        a2.add(i);
+    }
+    SelfRemover remover2(&a2);
+    for (NodeID nid = a2.getFirst(); nid.isValid(); nid = a2.getNext(nid))
+    {
+        remover2(nid);
+    }
+    ASSERT_EQ(50, remover2.num_calls);
+    ASSERT_TRUE(a2.isEmpty());
+}
@@ -88,3 +88,120 @@ TEST(OutgoingTransferRegistry, Basic)
     otr.cleanup(tsMono(5000001));    // Frees some memory for 4
     ASSERT_EQ(0, otr.accessOrCreate(keys[0], tsMono(1000000))->get());
 }
+
+TEST(OutgoingTransferRegistry, PoolUsageAttribution)
+{
+    using uavcan::OutgoingTransferRegistryKey;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 2, uavcan::MemPoolBlockSize> poolmgr;
+    uavcan::PoolUsageTracker tracker(poolmgr);
+    uavcan::OutgoingTransferRegistry otr(tracker);
+
+    ASSERT_TRUE(otr.accessOrCreate(OutgoingTransferRegistryKey(123, uavcan::TransferTypeServiceRequest, 42),
+                                   tsMono(1000000)));
+#if UAVCAN_POOL_USAGE_ATTRIBUTION
+    EXPECT_EQ(1, tracker.getNumUsedBlocks(uavcan::PoolUsageTagOutgoingTransferRegistry));
+    EXPECT_EQ(0, tracker.getNumUsedBlocks(uavcan::PoolUsageTagOther));
+#endif
+    EXPECT_EQ(1, tracker.getTotalNumUsedBlocks());
+
+    otr.cleanup(tsMono(2000000));
+    EXPECT_EQ(0, tracker.getTotalNumUsedBlocks());
+#if UAVCAN_POOL_USAGE_ATTRIBUTION
+    EXPECT_EQ(1, tracker.getPeakNumUsedBlocks(uavcan::PoolUsageTagOutgoingTransferRegistry));
+#endif
+}
+
+TEST(OutgoingTransferRegistry, StaticEntries)
+{
+    using uavcan::OutgoingTransferRegistryKey;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 2, uavcan::MemPoolBlockSize> poolmgr;
+    uavcan::PoolUsageTracker tracker(poolmgr);
+    uavcan::OutgoingTransferRegistry otr(tracker);
+
+    const OutgoingTransferRegistryKey dynamic_key(456, uavcan::TransferTypeServiceRequest, 2);
+    const OutgoingTransferRegistryKey carried_key(321, uavcan::TransferTypeMessageBroadcast, 0);
+
+    otr.accessOrCreate(carried_key, tsMono(1000000))->increment();
+    otr.accessOrCreate(carried_key, tsMono(1000000))->increment();
+    ASSERT_EQ(1, tracker.getTotalNumUsedBlocks());
+
+    uavcan::OutgoingTransferRegistry::StaticEntry entries[] =
+    {
+        { 123, uavcan::TransferTypeServiceRequest,   42 },
+        { 321, uavcan::TransferTypeMessageBroadcast, 0 },
+        { 123, uavcan::TransferTypeServiceRequest,   2 },
+        { 7,   uavcan::TransferTypeMessageBroadcast, 0 }
+    };
+
+    uavcan::OutgoingTransferRegistry::StaticEntry duplicates[] =
+    {
+        { 123, uavcan::TransferTypeServiceRequest, 42 },
+        { 123, uavcan::TransferTypeServiceRequest, 42 }
+    };
+    ASSERT_EQ(-uavcan::ErrInvalidParam, otr.adoptStaticEntries(duplicates));
+    ASSERT_EQ(0, otr.getNumStaticEntries());
+
+    ASSERT_EQ(0, otr.adoptStaticEntries(entries));
+    ASSERT_EQ(4, otr.getNumStaticEntries());
+    ASSERT_EQ(-uavcan::ErrLogic, otr.adoptStaticEntries(entries));
+    ASSERT_EQ(0, tracker.getTotalNumUsedBlocks());           // The dynamic entry has been carried over
+
+    // The static entries are used without the pool
+    for (unsigned i = 0; i < 4; i++)
+    {
+        uavcan::TransferID* const tid = otr.accessOrCreate(entries[i].getKey(), tsMono(1000000));
+        ASSERT_TRUE(tid);
+        ASSERT_EQ((entries[i].getKey() == carried_key) ? 2 : 0, tid->get());
+        tid->increment();
+        ASSERT_EQ(tid, otr.accessOrCreate(entries[i].getKey(), tsMono(1000000)));
+    }
+    ASSERT_EQ(0, tracker.getTotalNumUsedBlocks());
+    ASSERT_EQ(3, otr.accessOrCreate(carried_key, tsMono(1000000))->get());
+
+    // The static entries never expire
+    otr.cleanup(tsMono(9000000));
+    ASSERT_EQ(3, otr.accessOrCreate(carried_key, tsMono(1000000))->get());
+    ASSERT_TRUE(otr.exists(7, uavcan::TransferTypeMessageBroadcast));
+    ASSERT_FALSE(otr.exists(7, uavcan::TransferTypeServiceRequest));
+
+    // The rest of the keys are handled dynamically
+    ASSERT_FALSE(otr.exists(dynamic_key.getDataTypeID(), dynamic_key.getTransferType()));
+    ASSERT_EQ(0, otr.accessOrCreate(dynamic_key, tsMono(1000000))->get());
+    ASSERT_EQ(1, tracker.getTotalNumUsedBlocks());
+    ASSERT_TRUE(otr.exists(dynamic_key.getDataTypeID(), dynamic_key.getTransferType()));
+}
+
+TEST(OutgoingTransferRegistry, EntryCache)
+{
+    using uavcan::OutgoingTransferRegistryKey;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 2, uavcan::MemPoolBlockSize> poolmgr;
+    uavcan::OutgoingTransferRegistry otr(poolmgr);
+    uavcan::OutgoingTransferRegistry::EntryCache cache;
+
+    const OutgoingTransferRegistryKey key_a(123, uavcan::TransferTypeMessageBroadcast, 0);
+    const OutgoingTransferRegistryKey key_b(123, uavcan::TransferTypeServiceRequest, 42);
+
+    uavcan::TransferID* const tid_a = otr.accessOrCreate(key_a, tsMono(1000000), cache);
+    ASSERT_TRUE(tid_a);
+    tid_a->increment();
+    ASSERT_EQ(tid_a, otr.accessOrCreate(key_a, tsMono(3000000), cache));
+    ASSERT_EQ(tid_a, otr.accessOrCreate(key_a, tsMono(3000000)));      // Same entry
+
+    // Another key replaces the cached one
+    uavcan::TransferID* const tid_b = otr.accessOrCreate(key_b, tsMono(2000000), cache);
+    ASSERT_TRUE(tid_b);
+    ASSERT_NE(tid_a, tid_b);
+    ASSERT_EQ(1, otr.accessOrCreate(key_a, tsMono(3000000), cache)->get());
+
+    // The deadline is updated through the cache
+    otr.cleanup(tsMono(2500000));                                       // Kills B
+    ASSERT_TRUE(otr.exists(key_a.getDataTypeID(), key_a.getTransferType()));
+    ASSERT_FALSE(otr.exists(key_b.getDataTypeID(), key_b.getTransferType()));
+
+    // Removal invalidates the cache
+    ASSERT_EQ(1, otr.accessOrCreate(key_a, tsMono(4000000), cache)->get());
+    otr.cleanup(tsMono(5000000));                                       // Kills A
+    ASSERT_FALSE(otr.exists(key_a.getDataTypeID(), key_a.getTransferType()));
+    ASSERT_EQ(0, otr.accessOrCreate(key_a, tsMono(6000000), cache)->get());
+    ASSERT_TRUE(otr.exists(key_a.getDataTypeID(), key_a.getTransferType()));
+}
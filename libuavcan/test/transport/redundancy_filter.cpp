@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/transport/redundancy_filter.hpp>
+#include <uavcan/transport/frame.hpp>
+#include "../clock.hpp"
+
+#if UAVCAN_DISPATCHER_REDUNDANCY_FILTER_CAPACITY > 0
+
+static uavcan::CanRxFrame makeFrame(uavcan::uint8_t src_node_id, uavcan::uint8_t transfer_id, bool sot, bool eot,
+                                    uavcan::uint8_t iface_index, uavcan::uint64_t ts_msec)
+{
+    uavcan::Frame frame(20, uavcan::TransferTypeMessageBroadcast, src_node_id, uavcan::NodeID::Broadcast,
+                        transfer_id);
+    frame.setStartOfTransfer(sot);
+    frame.setEndOfTransfer(eot);
+    const uavcan::uint8_t payload[3] = { 1, 2, 3 };
+    frame.setPayload(payload, sizeof(payload));
+
+    uavcan::CanRxFrame can_frame;
+    EXPECT_TRUE(frame.compile(can_frame));
+    can_frame.iface_index = iface_index;
+    can_frame.ts_mono = tsMono(ts_msec * 1000U);
+    return can_frame;
+}
+
+
+TEST(RedundantFrameFilter, Basic)
+{
+    uavcan::RedundantFrameFilter filter;
+
+    /*
+     * The stream gets locked to the interface that delivered the first frame, copies from the other one are
+     * dropped regardless of the arrival order
+     */
+    for (uavcan::uint8_t tid = 0; tid < 10; tid++)
+    {
+        const uavcan::uint64_t ts = 10U + tid * 10U;
+        if ((tid % 2) == 0)
+        {
+            ASSERT_TRUE(filter.accept(makeFrame(42, tid, true, true, 0, ts)));
+            ASSERT_FALSE(filter.accept(makeFrame(42, tid, true, true, 1, ts)));
+        }
+        else
+        {
+            ASSERT_FALSE(filter.accept(makeFrame(42, tid, true, true, 1, ts)));
+            ASSERT_TRUE(filter.accept(makeFrame(42, tid, true, true, 0, ts)));
+        }
+    }
+    ASSERT_EQ(10, filter.getNumDroppedFrames());
+
+    /*
+     * Another node, independent stream
+     */
+    ASSERT_TRUE(filter.accept(makeFrame(43, 0, true, true, 1, 105)));
+    ASSERT_FALSE(filter.accept(makeFrame(43, 0, true, true, 0, 105)));
+
+    /*
+     * Anonymous frames are never filtered
+     */
+    ASSERT_TRUE(filter.accept(makeFrame(0, 0, true, true, 0, 110)));
+    ASSERT_TRUE(filter.accept(makeFrame(0, 0, true, true, 1, 110)));
+
+    /*
+     * Interface 0 goes silent; the lock is moved only at a start of transfer once the estimated interval
+     * has elapsed
+     */
+    ASSERT_FALSE(filter.accept(makeFrame(42, 10, true, false, 1, 150)));    // Too early
+    ASSERT_FALSE(filter.accept(makeFrame(42, 10, false, true, 1, 1150)));   // Not a start of transfer
+    ASSERT_TRUE(filter.accept(makeFrame(42, 11, true, false, 1, 1160)));
+    ASSERT_TRUE(filter.accept(makeFrame(42, 11, false, true, 1, 1161)));
+    ASSERT_FALSE(filter.accept(makeFrame(42, 11, true, false, 0, 1162)));   // Interface 0 is back, but too late
+
+    /*
+     * Reset
+     */
+    filter.reset();
+    ASSERT_TRUE(filter.accept(makeFrame(42, 12, true, true, 0, 1200)));
+    ASSERT_FALSE(filter.accept(makeFrame(42, 12, true, true, 1, 1200)));
+}
+
+
+TEST(RedundantFrameFilter, SlowStreamFailover)
+{
+    uavcan::RedundantFrameFilter filter;
+
+    /*
+     * A stream slower than the TID timeout, both interfaces deliver every transfer
+     */
+    uavcan::uint64_t ts = 100;
+    uavcan::uint8_t tid = 0;
+    for (; tid < 20; tid++)
+    {
+        ASSERT_TRUE(filter.accept(makeFrame(42, tid, true, true, 0, ts)));
+        ASSERT_FALSE(filter.accept(makeFrame(42, tid, true, true, 1, ts + 1)));
+        ts += 1500U;
+    }
+
+    /*
+     * Interface 0 fails; the next transfer comes from interface 1 a bit earlier than one period after the last
+     * frame from interface 0, it must be accepted anyway, same as TransferReceiver does through its TID timeout
+     */
+    ts -= 100U;
+    ASSERT_TRUE(filter.accept(makeFrame(42, tid, true, true, 1, ts)));
+    ASSERT_FALSE(filter.accept(makeFrame(42, tid, true, true, 0, ts + 1)));  // Interface 0 is locked out now
+}
+
+#endif
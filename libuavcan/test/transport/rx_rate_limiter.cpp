@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/transport/rx_rate_limiter.hpp>
+#include <uavcan/transport/frame.hpp>
+#include "../clock.hpp"
+
+#if UAVCAN_DISPATCHER_RX_RATE_LIMITING
+
+static uavcan::CanRxFrame makeFrame(uavcan::TransferType transfer_type, uavcan::uint8_t src_node_id, bool sot,
+                                    uavcan::uint64_t ts_msec)
+{
+    const uavcan::NodeID dst = (transfer_type == uavcan::TransferTypeMessageBroadcast) ?
+                               uavcan::NodeID::Broadcast : uavcan::NodeID(127);
+    uavcan::Frame frame(20, transfer_type, src_node_id, dst, 0);
+    frame.setStartOfTransfer(sot);
+    frame.setEndOfTransfer(true);
+    const uavcan::uint8_t payload[3] = { 1, 2, 3 };
+    frame.setPayload(payload, sizeof(payload));
+
+    uavcan::CanRxFrame can_frame;
+    EXPECT_TRUE(frame.compile(can_frame));
+    can_frame.ts_mono = tsMono(ts_msec * 1000U);
+    return can_frame;
+}
+
+
+TEST(RxRateLimiter, Basic)
+{
+    using uavcan::TransferTypeMessageBroadcast;
+    using uavcan::TransferTypeServiceRequest;
+
+    uavcan::RxRateLimiter limiter;
+
+    // No limits by default
+    for (int i = 0; i < 100; i++)
+    {
+        ASSERT_TRUE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 10, true, 1000)));
+    }
+    ASSERT_EQ(0, limiter.getLimit(TransferTypeMessageBroadcast));
+
+    // 10 transfers per second with the burst of 3
+    limiter.setLimit(TransferTypeMessageBroadcast, 10, 3);
+    ASSERT_EQ(10, limiter.getLimit(TransferTypeMessageBroadcast));
+
+    ASSERT_TRUE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 10, true, 2000)));
+    ASSERT_TRUE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 10, true, 2000)));
+    ASSERT_TRUE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 10, true, 2000)));
+    ASSERT_FALSE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 10, true, 2000)));
+    ASSERT_FALSE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 10, true, 2050)));
+    ASSERT_EQ(2, limiter.getNumThrottledTransfers());
+    ASSERT_EQ(10, limiter.getLastThrottledNodeID().get());
+
+    // Continuation frames are not limited
+    ASSERT_TRUE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 10, false, 2050)));
+
+    // Other nodes and other transfer types are not affected
+    ASSERT_TRUE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 11, true, 2050)));
+    ASSERT_TRUE(limiter.accept(makeFrame(TransferTypeServiceRequest, 10, true, 2050)));
+
+    // Anonymous frames are not limited
+    for (int i = 0; i < 10; i++)
+    {
+        ASSERT_TRUE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 0, true, 2050)));
+    }
+
+    // The bucket refills at the configured rate
+    ASSERT_TRUE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 10, true, 2100)));
+    ASSERT_FALSE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 10, true, 2150)));
+    ASSERT_TRUE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 10, true, 2200)));
+    ASSERT_EQ(3, limiter.getNumThrottledTransfers());
+
+    // The whole burst is available again after a silence
+    ASSERT_TRUE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 10, true, 5000)));
+    ASSERT_TRUE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 10, true, 5000)));
+    ASSERT_TRUE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 10, true, 5000)));
+    ASSERT_FALSE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 10, true, 5000)));
+
+    // The clock went backwards; the stale state must not block the node
+    ASSERT_TRUE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 10, true, 1000)));
+
+    // Reset
+    limiter.reset();
+    ASSERT_TRUE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 10, true, 5000)));
+
+    // Disabling
+    limiter.setLimit(TransferTypeMessageBroadcast, 0, 0);
+    for (int i = 0; i < 100; i++)
+    {
+        ASSERT_TRUE(limiter.accept(makeFrame(TransferTypeMessageBroadcast, 10, true, 5000)));
+    }
+    ASSERT_EQ(4, limiter.getNumThrottledTransfers());
+}
+
+#endif
@@ -195,6 +195,67 @@ TEST(TransferBufferManagerEntry, Basic)
 }
 
 
+TEST(TransferBufferManagerEntry, RandomAccess)
+{
+    using uavcan::TransferBufferManagerEntry;
+
+    static const unsigned MAX_SIZE = 500;
+    static const int POOL_BLOCKS = 20;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * POOL_BLOCKS, uavcan::MemPoolBlockSize> pool;
+
+    TransferBufferManagerEntry buf(pool, MAX_SIZE);
+
+    std::vector<uint8_t> reference(MAX_SIZE, 0);
+    {
+        std::vector<uint8_t> zeros(MAX_SIZE, 0);
+        ASSERT_EQ(int(MAX_SIZE), buf.write(0, zeros.data(), MAX_SIZE));
+    }
+
+    /*
+     * Writes and reads of random length at random offsets, including offsets going backwards,
+     * must behave exactly like a flat array
+     */
+    std::srand(1);
+    for (int iteration = 0; iteration < 2000; iteration++)
+    {
+        const unsigned offset = unsigned(std::rand()) % MAX_SIZE;
+        const unsigned len = unsigned(std::rand()) % 100;
+        const unsigned expected_len = std::min(len, MAX_SIZE - offset);
+        if (std::rand() % 2)
+        {
+            std::vector<uint8_t> data(len + 1);
+            for (unsigned i = 0; i < len; i++)
+            {
+                data[i] = uint8_t(std::rand());
+            }
+            ASSERT_EQ(int(expected_len), buf.write(offset, data.data(), len));
+            std::copy(data.begin(), data.begin() + expected_len, reference.begin() + offset);
+        }
+        else
+        {
+            std::vector<uint8_t> data(len + 1);
+            ASSERT_EQ(int(expected_len), buf.read(offset, data.data(), len));
+            ASSERT_TRUE(std::equal(data.begin(), data.begin() + expected_len, reference.begin() + offset));
+        }
+    }
+
+    // Sequential byte-by-byte reading, like the decoder does
+    for (unsigned i = 0; i < MAX_SIZE; i++)
+    {
+        uint8_t byte = 0;
+        ASSERT_EQ(1, buf.read(i, &byte, 1));
+        ASSERT_EQ(reference[i], byte);
+    }
+
+    // Reset drops the cached block along with the data
+    buf.reset();
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+    uint8_t byte = 0;
+    ASSERT_EQ(0, buf.read(0, &byte, 1));
+    ASSERT_EQ(1, buf.write(300, &byte, 1));
+    ASSERT_EQ(1, buf.read(300, &byte, 1));
+}
+
 static const std::string MGR_TEST_DATA[4] =
 {
     "I thought you would cry out again \'don\'t speak of it, leave off.\'\" Raskolnikov gave a laugh, but rather a "
@@ -316,3 +377,87 @@ TEST(TransferBufferManager, Basic)
     mgr.reset();
     ASSERT_EQ(0, pool.getNumUsedBlocks());
 }
+
+TEST(TransferBufferManager, Index)
+{
+    using uavcan::TransferBufferManager;
+    using uavcan::TransferBufferManagerKey;
+    using uavcan::ITransferBuffer;
+
+    static const int POOL_BLOCKS = 400;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * POOL_BLOCKS, uavcan::MemPoolBlockSize> pool;
+
+    TransferBufferManager mgr(MGR_MAX_BUFFER_SIZE, pool);
+
+    // Keys of all transfer types from many nodes, in a scattered order
+    std::vector<TransferBufferManagerKey> keys;
+    for (unsigned i = 0; i < 100; i++)
+    {
+        const uavcan::NodeID nid = uavcan::uint8_t((i * 37U) % 127U + 1U);
+        keys.push_back(TransferBufferManagerKey(nid, uavcan::TransferType(i % uavcan::NumTransferTypes)));
+    }
+
+    for (unsigned i = 0; i < keys.size(); i++)
+    {
+        ITransferBuffer* const tbb = mgr.create(keys[i]);
+        ASSERT_TRUE(tbb);
+        const uavcan::uint8_t data = uavcan::uint8_t(i);
+        ASSERT_EQ(1, tbb->write(0, &data, 1));
+        ASSERT_EQ(i + 1, mgr.getNumBuffers());
+        if (UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD > 0)
+        {
+            ASSERT_EQ(mgr.getNumBuffers() >= UAVCAN_TRANSFER_BUFFER_INDEX_THRESHOLD, mgr.isIndexed());
+        }
+    }
+
+    // Recreating an existing buffer doesn't increase the number of buffers
+    ASSERT_TRUE(mgr.create(keys[5]));
+    ASSERT_EQ(keys.size(), mgr.getNumBuffers());
+    {
+        const uavcan::uint8_t data = 5;
+        ASSERT_EQ(1, mgr.access(keys[5])->write(0, &data, 1));
+    }
+
+    // Every buffer is found, and holds the right data
+    for (unsigned i = 0; i < keys.size(); i++)
+    {
+        ITransferBuffer* const tbb = mgr.access(keys[i]);
+        ASSERT_TRUE(tbb);
+        uavcan::uint8_t data = 0;
+        ASSERT_EQ(1, tbb->read(0, &data, 1));
+        ASSERT_EQ(uavcan::uint8_t(i), data);
+    }
+    ASSERT_FALSE(mgr.access(TransferBufferManagerKey(127, uavcan::TransferTypeServiceRequest)));
+
+    // Removing every third buffer; the rest must still be accessible
+    for (unsigned i = 0; i < keys.size(); i += 3)
+    {
+        mgr.remove(keys[i]);
+        ASSERT_FALSE(mgr.access(keys[i]));
+    }
+    for (unsigned i = 0; i < keys.size(); i++)
+    {
+        ITransferBuffer* const tbb = mgr.access(keys[i]);
+        if (i % 3 == 0)
+        {
+            ASSERT_FALSE(tbb);
+        }
+        else
+        {
+            ASSERT_TRUE(tbb);
+            uavcan::uint8_t data = 0;
+            ASSERT_EQ(1, tbb->read(0, &data, 1));
+            ASSERT_EQ(uavcan::uint8_t(i), data);
+        }
+    }
+
+    // Removing the rest; the index must be released eventually
+    for (unsigned i = 0; i < keys.size(); i++)
+    {
+        mgr.remove(keys[i]);
+        ASSERT_FALSE(mgr.access(keys[i]));
+    }
+    ASSERT_TRUE(mgr.isEmpty());
+    ASSERT_FALSE(mgr.isIndexed());
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+}
@@ -3,6 +3,9 @@
  */
 
 #include <gtest/gtest.h>
+#include <uavcan/transport/leading_field_filter.hpp>
+#include <uavcan/marshal/fixed_layout_codec.hpp>
+#include <uavcan/marshal/integer_spec.hpp>
 #include "transfer_test_helpers.hpp"
 #include "../clock.hpp"
 
@@ -225,6 +228,264 @@ TEST(TransferListener, Cleanup)
 }
 
 
+namespace
+{
+
+class SweepCountingListener : public TestListener
+{
+    virtual uavcan::MonotonicTime removeTimedOutReceivers(uavcan::MonotonicTime ts) override
+    {
+        num_sweeps++;
+        return TestListener::removeTimedOutReceivers(ts);
+    }
+
+public:
+    unsigned num_sweeps;
+
+    SweepCountingListener(uavcan::TransferPerfCounter& perf, const uavcan::DataTypeDescriptor& data_type,
+                          uavcan::IPoolAllocator& allocator)
+        : TestListener(perf, data_type, 256, allocator)
+        , num_sweeps(0)
+    { }
+};
+
+}
+
+TEST(TransferListener, CleanupSkipsActiveReceivers)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    static const int NUM_POOL_BLOCKS = 100;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NUM_POOL_BLOCKS, uavcan::MemPoolBlockSize> poolmgr;
+    uavcan::TransferPerfCounter perf;
+    SweepCountingListener subscriber(perf, type, poolmgr);
+
+    TransferListenerEmulator emulator(subscriber, type);
+    const Transfer tr_a = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 11, "abcd");
+    const Transfer tr_b = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 12, "123456789abcdefghik");
+
+    std::vector<std::vector<uavcan::RxFrame> > sers;
+    sers.push_back(serializeTransfer(tr_a));
+    emulator.send(sers);
+    ASSERT_TRUE(subscriber.matchAndPop(tr_a));
+
+    /*
+     * The first cleanup visits the receivers; the following ones don't until a receiver may have timed out
+     */
+    subscriber.cleanup(tsMono(1000));
+    ASSERT_EQ(1, subscriber.num_sweeps);
+    subscriber.cleanup(tsMono(500000));
+    ASSERT_EQ(1, subscriber.num_sweeps);
+
+    /*
+     * A new receiver can't time out earlier than the existing ones either
+     */
+    sers.clear();
+    sers.push_back(serializeTransfer(tr_b));
+    emulator.send(sers);
+    ASSERT_TRUE(subscriber.matchAndPop(tr_b));
+    subscriber.cleanup(tsMono(600000));
+    ASSERT_EQ(1, subscriber.num_sweeps);
+
+    /*
+     * All receivers time out; nothing is left to visit afterwards
+     */
+    subscriber.cleanup(tsMono(2000000));
+    ASSERT_EQ(2, subscriber.num_sweeps);
+    subscriber.cleanup(tsMono(3000000));
+    ASSERT_EQ(2, subscriber.num_sweeps);
+
+    sers.clear();
+    sers.push_back(serializeTransfer(tr_a));
+    sers.push_back(serializeTransfer(tr_b));
+    emulator.send(sers);
+    ASSERT_TRUE(subscriber.matchAndPop(tr_a));
+    ASSERT_TRUE(subscriber.matchAndPop(tr_b));
+    ASSERT_TRUE(subscriber.isEmpty());
+}
+
+
+TEST(TransferListener, RemoveReceiversOfNode)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindService, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    static const int NUM_POOL_BLOCKS = 100;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NUM_POOL_BLOCKS, uavcan::MemPoolBlockSize> poolmgr;
+    uavcan::TransferPerfCounter perf;
+    TestListenerBase<uavcan::DirectIndexedTransferListener<64> > subscriber(perf, type, 256, poolmgr);
+
+    TransferListenerEmulator emulator(subscriber, type);
+    const Transfer tr_array = emulator.makeTransfer(16, uavcan::TransferTypeServiceRequest,  1, "123456789abcdefghik");
+    const Transfer tr_map   = emulator.makeTransfer(16, uavcan::TransferTypeServiceResponse, 1, "abcdefghijklmnopqrs");
+    const Transfer tr_other = emulator.makeTransfer(16, uavcan::TransferTypeServiceRequest,  2, "zxcvbnmasdfghjklqw");
+
+    /*
+     * Unfinished transfers from two nodes, one of which is served by both the array and the map
+     */
+    emulator.sendOneFrame(serializeTransfer(tr_array).front());
+    emulator.sendOneFrame(serializeTransfer(tr_map).front());
+    emulator.sendOneFrame(serializeTransfer(tr_other).front());
+    ASSERT_EQ(2, subscriber.getNumDirectReceivers());
+    const unsigned num_blocks = poolmgr.getNumUsedBlocks();
+
+    /*
+     * All state of the node 1 is released at once; the other node is not affected
+     */
+    subscriber.removeReceiversOf(uavcan::NodeID(1));
+    ASSERT_EQ(1, subscriber.getNumDirectReceivers());
+    ASSERT_GT(num_blocks, poolmgr.getNumUsedBlocks());
+
+    subscriber.removeReceiversOf(uavcan::NodeID(1));       // Nothing to do
+    subscriber.removeReceiversOf(uavcan::NodeID(100));     // Ditto
+
+    subscriber.removeReceiversOf(uavcan::NodeID(2));
+    ASSERT_EQ(0, subscriber.getNumDirectReceivers());
+    ASSERT_EQ(0, poolmgr.getNumUsedBlocks());
+
+    /*
+     * The node is received normally afterwards
+     */
+    std::vector<std::vector<uavcan::RxFrame> > sers;
+    sers.push_back(serializeTransfer(tr_array));
+    emulator.send(sers);
+    ASSERT_TRUE(subscriber.matchAndPop(tr_array));
+    ASSERT_TRUE(subscriber.isEmpty());
+}
+
+
+TEST(TransferListener, PreregisteredSources)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    static const int NUM_POOL_BLOCKS = 100;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NUM_POOL_BLOCKS, uavcan::MemPoolBlockSize> poolmgr;
+    uavcan::TransferPerfCounter perf;
+    TestListener subscriber(perf, type, 256, poolmgr);
+
+    ASSERT_GT(0, subscriber.preregisterSource(uavcan::NodeID::Broadcast, uavcan::TransferTypeMessageBroadcast));
+    ASSERT_EQ(0, poolmgr.getNumUsedBlocks());
+
+    ASSERT_LE(0, subscriber.preregisterSource(uavcan::NodeID(42), uavcan::TransferTypeMessageBroadcast));
+    const unsigned num_blocks = poolmgr.getNumUsedBlocks();
+    ASSERT_LT(0, num_blocks);
+
+    /*
+     * The receiver survives cleanups while the node is silent
+     */
+    subscriber.cleanup(tsMono(100000000));
+    ASSERT_EQ(num_blocks, poolmgr.getNumUsedBlocks());
+
+    /*
+     * The first transfer doesn't need to allocate the receiver
+     */
+    TransferListenerEmulator emulator(subscriber, type);
+    const Transfer tr_sft = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 42, "abcd");
+
+    std::vector<std::vector<uavcan::RxFrame> > sers;
+    sers.push_back(serializeTransfer(tr_sft));
+    emulator.send(sers);
+    ASSERT_TRUE(subscriber.matchAndPop(tr_sft));
+    ASSERT_EQ(num_blocks, poolmgr.getNumUsedBlocks());
+
+    /*
+     * Timed out and removed receivers only release their buffers
+     */
+    const Transfer tr_timed_out = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 42, "123456789ab");
+    emulator.sendOneFrame(serializeTransfer(tr_timed_out).front());
+    ASSERT_LT(num_blocks, poolmgr.getNumUsedBlocks());
+    subscriber.cleanup(tsMono(200000000));
+    ASSERT_EQ(num_blocks, poolmgr.getNumUsedBlocks());
+    ASSERT_EQ(1, perf.getErrorCount());
+
+    const Transfer tr_removed = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 42, "123456789ab");
+    emulator.sendOneFrame(serializeTransfer(tr_removed).front());
+    ASSERT_LT(num_blocks, poolmgr.getNumUsedBlocks());
+    subscriber.removeReceiversOf(uavcan::NodeID(42));
+    ASSERT_EQ(num_blocks, poolmgr.getNumUsedBlocks());
+
+    const Transfer tr_mft = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 42, "123456789abcdefghik");
+    sers.clear();
+    sers.push_back(serializeTransfer(tr_mft));
+    emulator.send(sers);
+    ASSERT_TRUE(subscriber.matchAndPop(tr_mft));
+    ASSERT_TRUE(subscriber.isEmpty());
+}
+
+
+TEST(TransferListener, DirectIndexedReceivers)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindService, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    static const int NUM_POOL_BLOCKS = 100;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NUM_POOL_BLOCKS, uavcan::MemPoolBlockSize> poolmgr;
+    uavcan::TransferPerfCounter perf;
+    TestListenerBase<uavcan::DirectIndexedTransferListener<64> > subscriber(perf, type, 256, poolmgr);
+
+    TransferListenerEmulator emulator(subscriber, type);
+    const Transfer transfers[] =
+    {
+        emulator.makeTransfer(16, uavcan::TransferTypeServiceRequest,  1,  "123456789abcdefghik"),   // Array
+        emulator.makeTransfer(16, uavcan::TransferTypeServiceResponse, 1,  "abcdefghijklmnopqrst"),  // Map, same node
+        emulator.makeTransfer(16, uavcan::TransferTypeServiceRequest,  64, "zxcvbnmasdfghjklqw"),    // Array, last slot
+        emulator.makeTransfer(16, uavcan::TransferTypeServiceRequest,  65, "qwertyuiopasdfghjkl"),   // Map, out of range
+        emulator.makeTransfer(16, uavcan::TransferTypeServiceResponse, 42, "abcd")                   // Array, SFT
+    };
+    const unsigned NumTransfers = sizeof(transfers) / sizeof(transfers[0]);
+    const unsigned ReceptionOrder[NumTransfers] = { 4, 0, 2, 3, 1 };    // Shorter transfers complete earlier
+
+    /*
+     * Interleaved multi-frame transfers, all receivers are created on the fly
+     */
+    std::vector<std::vector<uavcan::RxFrame> > sers;
+    for (unsigned i = 0; i < NumTransfers; i++)
+    {
+        sers.push_back(serializeTransfer(transfers[i]));
+    }
+    emulator.send(sers);
+
+    for (unsigned i = 0; i < NumTransfers; i++)
+    {
+        ASSERT_TRUE(subscriber.matchAndPop(transfers[ReceptionOrder[i]]));
+    }
+    ASSERT_TRUE(subscriber.isEmpty());
+    ASSERT_EQ(3, subscriber.getNumDirectReceivers());
+
+    /*
+     * Repeated transfers are rejected as duplicates, same as with the map-based receivers
+     */
+    emulator.send(sers);
+    ASSERT_TRUE(subscriber.isEmpty());
+
+    /*
+     * Cleanup removes all receivers, so the same transfers will be accepted again
+     */
+    subscriber.cleanup(tsMono(100000000));
+    ASSERT_EQ(0, subscriber.getNumDirectReceivers());
+
+    emulator.send(sers);
+
+    for (unsigned i = 0; i < NumTransfers; i++)
+    {
+        ASSERT_TRUE(subscriber.matchAndPop(transfers[ReceptionOrder[i]]));
+    }
+    ASSERT_TRUE(subscriber.isEmpty());
+
+    /*
+     * An unfinished transfer holds a buffer, which must be released by cleanup
+     */
+    const Transfer tr_unfinished = emulator.makeTransfer(16, uavcan::TransferTypeServiceRequest, 1, "123456789abcdefghik");
+    const std::vector<uavcan::RxFrame> ser_unfinished = serializeTransfer(tr_unfinished);
+    emulator.sendOneFrame(ser_unfinished.front());
+    ASSERT_TRUE(subscriber.isEmpty());
+    ASSERT_EQ(3, subscriber.getNumDirectReceivers());
+    ASSERT_LT(0, poolmgr.getNumUsedBlocks());
+
+    subscriber.cleanup(tsMono(200000000));
+    ASSERT_EQ(0, subscriber.getNumDirectReceivers());
+    ASSERT_EQ(0, poolmgr.getNumUsedBlocks());
+}
+
+
 TEST(TransferListener, AnonymousTransfers)
 {
     const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
@@ -260,6 +521,308 @@ TEST(TransferListener, AnonymousTransfers)
     ASSERT_TRUE(subscriber.isEmpty());
 }
 
+struct MinPriorityFrameFilter : public uavcan::ITransferAcceptanceFilter
+{
+    uavcan::uint8_t lowest_priority;
+
+    explicit MinPriorityFrameFilter(uavcan::uint8_t arg_lowest_priority) : lowest_priority(arg_lowest_priority) { }
+
+    virtual bool shouldAcceptFrame(const uavcan::RxFrame& frame) const
+    {
+        return frame.getPriority().get() <= lowest_priority;
+    }
+};
+
+TEST(TransferListener, FrameFilters)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    static const int NUM_POOL_BLOCKS = 100;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NUM_POOL_BLOCKS, uavcan::MemPoolBlockSize> poolmgr;
+    uavcan::TransferPerfCounter perf;
+    TestListener subscriber(perf, type, 256, poolmgr);
+    subscriber.allowAnonymousTransfers();
+
+    TransferListenerEmulator emulator(subscriber, type);
+    std::vector<Transfer> transfers;
+    const auto make_transfers = [&]()
+    {
+        transfers.clear();
+        transfers.push_back(emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "Multi-frame, node 1"));
+        transfers.push_back(emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "Multi-frame, node 2"));
+        transfers.push_back(emulator.makeTransfer(20, uavcan::TransferTypeMessageBroadcast, 3, "123"));
+        transfers.push_back(emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 0, "Anon"));
+    };
+
+    uavcan::NodeIDSet sources;
+    sources.add(1);
+    sources.add(3);
+    subscriber.setSourceNodeFilter(sources);
+    ASSERT_TRUE(subscriber.isFrameFilteringEnabled());
+    ASSERT_EQ(2, subscriber.getSourceNodeFilter().getSize());
+
+    make_transfers();
+    emulator.send(&transfers[0], unsigned(transfers.size()));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[2]));      // Single-frame transfers are completed first
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[0]));
+    ASSERT_TRUE(subscriber.isEmpty());                      // Other nodes and anonymous transfers are rejected
+    ASSERT_EQ(2, poolmgr.getNumUsedBlocks());               // Only the receivers of the accepted nodes
+
+    // The frame filter is applied on top of the source filter
+    const MinPriorityFrameFilter filter(16);
+    subscriber.setFrameFilter(&filter);
+    make_transfers();
+    emulator.send(&transfers[0], unsigned(transfers.size()));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[0]));
+    ASSERT_TRUE(subscriber.isEmpty());
+
+    // Removing the filters restores the reception from everyone
+    subscriber.setFrameFilter(UAVCAN_NULLPTR);
+    subscriber.setSourceNodeFilter(uavcan::NodeIDSet());
+    ASSERT_FALSE(subscriber.isFrameFilteringEnabled());
+    make_transfers();
+    emulator.send(&transfers[0], unsigned(transfers.size()));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[2]));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[3]));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[0]));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[1]));
+    ASSERT_TRUE(subscriber.isEmpty());
+}
+
+static int peekFirstByte(const uavcan::uint8_t* data, unsigned len, uavcan::uint8_t& out_value)
+{
+    typedef uavcan::IntegerSpec<8, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> U8;
+    return uavcan::decodeFixedLayoutField<U8, 0>(data, len, out_value);
+}
+
+TEST(TransferListener, LeadingFieldFilter)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    static const int NUM_POOL_BLOCKS = 100;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NUM_POOL_BLOCKS, uavcan::MemPoolBlockSize> poolmgr;
+    uavcan::TransferPerfCounter perf;
+    TestListener subscriber(perf, type, 256, poolmgr);
+
+    const uavcan::LeadingFieldFilter<uavcan::uint8_t> filter(&peekFirstByte, uavcan::uint8_t('A'));
+    subscriber.setFrameFilter(&filter);
+
+    TransferListenerEmulator emulator(subscriber, type);
+    std::vector<Transfer> transfers;
+    transfers.push_back(emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "A multi-frame transfer"));
+    transfers.push_back(emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "B multi-frame transfer"));
+    transfers.push_back(emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 3, "A12"));
+    transfers.push_back(emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 4, "B12"));
+    transfers.push_back(emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 5, ""));    // Too short
+
+    emulator.send(&transfers[0], unsigned(transfers.size()));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[2]));      // Single-frame transfers are completed first
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[4]));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[0]));
+    ASSERT_TRUE(subscriber.isEmpty());
+    ASSERT_EQ(3, poolmgr.getNumUsedBlocks());               // No receiver for the rejected nodes
+
+    // The rejected node is received normally once its transfers match
+    transfers.clear();
+    transfers.push_back(emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "All the frames are here"));
+    emulator.send(&transfers[0], unsigned(transfers.size()));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[0]));
+    ASSERT_TRUE(subscriber.isEmpty());
+    ASSERT_EQ(0, perf.getErrorCount());
+}
+
+TEST(TransferListener, ReservedPoolBlocks)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    static const int NUM_POOL_BLOCKS = 32;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NUM_POOL_BLOCKS, uavcan::MemPoolBlockSize> pool;
+
+    uavcan::TransferPerfCounter perf;
+    TestListener critical(perf, type, 256, pool);
+    TestListener bulk(perf, type, 256, pool);
+
+    ASSERT_EQ(0, critical.reservePoolBlocks(8, 2));
+    ASSERT_EQ(8, critical.getNumReservedBufferBlocks());
+    ASSERT_EQ(2, critical.getNumReservedReceiverBlocks());
+    ASSERT_EQ(10, pool.getNumUsedBlocks());
+
+    // Either both or nothing
+    ASSERT_EQ(-uavcan::ErrMemory, critical.reservePoolBlocks(8, 30));
+    ASSERT_EQ(8, critical.getNumReservedBufferBlocks());
+    ASSERT_EQ(2, critical.getNumReservedReceiverBlocks());
+    ASSERT_EQ(10, pool.getNumUsedBlocks());
+
+    // The rest of the pool is used up
+    std::vector<void*> blocks;
+    while (void* const ptr = pool.allocate(1))
+    {
+        blocks.push_back(ptr);
+    }
+
+    const std::string data(100, 'a');
+    TransferListenerEmulator critical_emulator(critical, type);
+    TransferListenerEmulator bulk_emulator(bulk, type);
+    const Transfer critical_tr = critical_emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, data);
+    const Transfer bulk_tr = bulk_emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, data);
+
+    critical_emulator.send(std::vector<std::vector<uavcan::RxFrame> >(1, serializeTransfer(critical_tr)));
+    bulk_emulator.send(std::vector<std::vector<uavcan::RxFrame> >(1, serializeTransfer(bulk_tr)));
+
+    ASSERT_TRUE(critical.matchAndPop(critical_tr));
+    ASSERT_TRUE(critical.isEmpty());
+    ASSERT_TRUE(bulk.isEmpty());
+
+    for (void* ptr : blocks)
+    {
+        pool.deallocate(ptr);
+    }
+
+    // Cancelling; the receiver stays in the map
+    ASSERT_EQ(0, critical.reservePoolBlocks(0, 0));
+    ASSERT_EQ(0, critical.getNumReservedBufferBlocks());
+    ASSERT_GE(2, pool.getNumUsedBlocks());
+}
+
+
+namespace
+{
+
+class TestStreamingListener : public uavcan::StreamingTransferListener
+{
+    virtual void handleTransferChunk(uavcan::NodeID src_node_id, uavcan::TransferType transfer_type,
+                                     unsigned offset, const uavcan::uint8_t* data, unsigned len) override
+    {
+        std::string& pending = pending_[transfer_type][src_node_id.get()];
+        EXPECT_EQ(pending.size(), offset);
+        pending.append(reinterpret_cast<const char*>(data), len);
+        num_chunks++;
+    }
+
+    virtual void handleTransferEnd(uavcan::IncomingTransfer& transfer) override
+    {
+        std::string& pending = pending_[transfer.getTransferType()][transfer.getSrcNodeID().get()];
+        completed.push_back(pending);
+        pending.clear();
+    }
+
+    virtual void handleTransferAbort(uavcan::NodeID src_node_id, uavcan::TransferType transfer_type) override
+    {
+        pending_[transfer_type][src_node_id.get()].clear();
+        num_aborts++;
+    }
+
+    std::string pending_[uavcan::NumTransferTypes][uavcan::NodeID::Max + 1];
+
+public:
+    std::vector<std::string> completed;
+    unsigned num_chunks = 0;
+    unsigned num_aborts = 0;
+
+    TestStreamingListener(uavcan::TransferPerfCounter& perf, const uavcan::DataTypeDescriptor& data_type,
+                          uavcan::IPoolAllocator& allocator)
+        : uavcan::StreamingTransferListener(perf, data_type, allocator)
+    { }
+};
+
+}
+
+TEST(TransferListener, Streaming)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> pool;
+    uavcan::TransferPerfCounter perf;
+    TestStreamingListener listener(perf, type, pool);
+
+    TransferListenerEmulator emulator(listener, type);
+    const std::string long_data = "The USSR, which they'd begun to renovate and improve at about the time when Tatarsky "
+                                  "decided to change his profession, improved so much that it ceased to exist";
+
+    /*
+     * The chunks are delivered as the frames arrive, nothing is buffered
+     */
+    const Transfer mft = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, long_data);
+    const std::vector<uavcan::RxFrame> ser_mft = serializeTransfer(mft);
+    ASSERT_LT(2, ser_mft.size());
+
+    const unsigned used_blocks_before = pool.getNumUsedBlocks();
+    for (unsigned i = 0; i < (ser_mft.size() - 1); i++)
+    {
+        listener.handleFrame(ser_mft[i], false);
+        ASSERT_EQ(i + 1, listener.num_chunks);
+    }
+    ASSERT_TRUE(listener.isTransferInProgress(1, uavcan::TransferTypeMessageBroadcast));
+    ASSERT_TRUE(listener.completed.empty());
+    ASSERT_GE(used_blocks_before + 1, pool.getNumUsedBlocks());     // Receiver only
+
+    listener.handleFrame(ser_mft.back(), false);
+    ASSERT_FALSE(listener.isTransferInProgress(1, uavcan::TransferTypeMessageBroadcast));
+    ASSERT_EQ(1, listener.completed.size());
+    ASSERT_EQ(long_data, listener.completed[0]);
+    ASSERT_EQ(1, perf.getRxTransferCount());
+
+    /*
+     * Single-frame transfers are delivered at once
+     */
+    const Transfer sft = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "abc");
+    emulator.send(&sft, 1);
+    ASSERT_EQ(2, listener.completed.size());
+    ASSERT_EQ("abc", listener.completed[1]);
+
+    /*
+     * A transfer interrupted by the next one from the same node is aborted
+     */
+    const Transfer interrupted = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 3, long_data);
+    const Transfer next = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 3, long_data + "!");
+    const std::vector<uavcan::RxFrame> ser_interrupted = serializeTransfer(interrupted);
+    listener.handleFrame(ser_interrupted[0], false);
+    listener.handleFrame(ser_interrupted[1], false);
+    ASSERT_TRUE(listener.isTransferInProgress(3, uavcan::TransferTypeMessageBroadcast));
+    ASSERT_EQ(0, listener.num_aborts);
+
+    emulator.send(&next, 1);
+    ASSERT_EQ(1, listener.num_aborts);
+    ASSERT_EQ(3, listener.completed.size());
+    ASSERT_EQ(long_data + "!", listener.completed[2]);
+
+    /*
+     * CRC failure
+     */
+    const Transfer damaged = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 4, long_data);
+    std::vector<uavcan::RxFrame> ser_damaged = serializeTransfer(damaged);
+    const_cast<uint8_t*>(ser_damaged[1].getPayloadPtr())[1] = uint8_t(~ser_damaged[1].getPayloadPtr()[1]);
+    for (unsigned i = 0; i < ser_damaged.size(); i++)
+    {
+        listener.handleFrame(ser_damaged[i], false);
+    }
+    ASSERT_EQ(2, listener.num_aborts);
+    ASSERT_EQ(3, listener.completed.size());
+    ASSERT_FALSE(listener.isTransferInProgress(4, uavcan::TransferTypeMessageBroadcast));
+
+    /*
+     * Timeout and removal of the source
+     */
+    const Transfer timed_out = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 5, long_data);
+    const Transfer removed = emulator.makeTransfer(16, uavcan::TransferTypeServiceRequest, 6, long_data);
+    listener.handleFrame(serializeTransfer(timed_out)[0], false);
+    listener.handleFrame(serializeTransfer(removed)[0], false);
+    ASSERT_TRUE(listener.isTransferInProgress(5, uavcan::TransferTypeMessageBroadcast));
+    ASSERT_TRUE(listener.isTransferInProgress(6, uavcan::TransferTypeServiceRequest));
+
+    listener.removeReceiversOf(6);
+    ASSERT_EQ(3, listener.num_aborts);
+    ASSERT_FALSE(listener.isTransferInProgress(6, uavcan::TransferTypeServiceRequest));
+
+    listener.cleanup(tsMono(1000));
+    ASSERT_EQ(3, listener.num_aborts);
+    listener.cleanup(tsMono(100000000));
+    ASSERT_EQ(4, listener.num_aborts);
+    ASSERT_FALSE(listener.isTransferInProgress(5, uavcan::TransferTypeMessageBroadcast));
+    ASSERT_EQ(3, listener.completed.size());
+}
+
+
 TEST(TransferListener, Sizes)
 {
     using namespace uavcan;
@@ -241,7 +241,7 @@ TEST(TransferReceiver, Basic)
     ASSERT_FALSE(rcv.isTimedOut(tsMono(900000300)));
     ASSERT_TRUE(rcv.isTimedOut(tsMono(9990000000)));
 
-    ASSERT_LT(TransferReceiver::getDefaultTransferInterval(), rcv.getInterval());
+    ASSERT_GT(TransferReceiver::getDefaultTransferInterval(), rcv.getInterval());    // Long gaps are limited
     ASSERT_LE(TransferReceiver::getMinTransferInterval(), rcv.getInterval());
     ASSERT_GE(TransferReceiver::getMaxTransferInterval(), rcv.getInterval());
     ASSERT_TRUE(matchBufferContent(bufmgr.access(gen.bufmgr_key), "34567qwe"));
@@ -348,6 +348,52 @@ TEST(TransferReceiver, IntervalMeasurement)
 }
 
 
+TEST(TransferReceiver, IfaceSwitchAfterOutage)
+{
+    Context<32> context;
+    RxFrameGenerator gen(789);
+    uavcan::TransferReceiver& rcv = context.receiver;
+    uavcan::TransferBufferAccessor bk(context.bufmgr, RxFrameGenerator::DEFAULT_KEY);
+
+    static const uint64_t INTERVAL = 10000;
+    uavcan::TransferID tid;
+    uint64_t timestamp = 100000000;
+
+    for (int i = 0; i < 100; i++)
+    {
+        CHECK_SINGLE_FRAME(rcv.addFrame(gen(0, "", SET110, tid.get(), timestamp), bk));
+        timestamp += INTERVAL;
+        tid.increment();
+    }
+    ASSERT_EQ(INTERVAL, uint64_t(rcv.getInterval().toUSec()));
+
+    /*
+     * The publisher pauses for 5 seconds, then resumes; the pause must not inflate the interval estimate
+     */
+    timestamp += 5000000;
+    for (int i = 0; i < 10; i++)
+    {
+        CHECK_SINGLE_FRAME(rcv.addFrame(gen(0, "", SET110, tid.get(), timestamp), bk));
+        timestamp += INTERVAL;
+        tid.increment();
+    }
+    ASSERT_GT(2 * INTERVAL, uint64_t(rcv.getInterval().toUSec()));
+
+    /*
+     * Interface 0 fails; the transfers from interface 1 must be accepted within two intervals
+     */
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "", SET110, uint8_t(tid.get() - 1U), timestamp - INTERVAL), bk));
+    int num_lost = 0;
+    while (rcv.addFrame(gen(1, "", SET110, tid.get(), timestamp), bk) != uavcan::TransferReceiver::ResultSingleFrame)
+    {
+        num_lost++;
+        ASSERT_GE(2, num_lost);
+        timestamp += INTERVAL;
+        tid.increment();
+    }
+}
+
+
 TEST(TransferReceiver, Restart)
 {
     Context<32> context;
@@ -447,6 +493,40 @@ TEST(TransferReceiver, UtcTransferTimestamping)
 }
 
 
+TEST(TransferReceiver, LastTransferTimestampAge)
+{
+    Context<32> context;
+    RxFrameGenerator gen(789);
+    uavcan::TransferReceiver& rcv = context.receiver;
+    uavcan::TransferBufferAccessor bk(context.bufmgr, RxFrameGenerator::DEFAULT_KEY);
+
+    ASSERT_GE(32, sizeof(uavcan::TransferReceiver));
+
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "1234567", SET100, 0, 100000000), bk));
+    CHECK_COMPLETE(    rcv.addFrame(gen(1, "abcd",    SET011, 0, 100000100), bk));
+    ASSERT_EQ(100000000, rcv.getLastTransferTimestampMonotonic().toUSec());
+
+    /*
+     * The previous timestamp is reported while the next transfer is in progress
+     */
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "1234567", SET100, 1, 100500000), bk));
+    ASSERT_EQ(100000000, rcv.getLastTransferTimestampMonotonic().toUSec());
+    CHECK_COMPLETE(    rcv.addFrame(gen(1, "abcd",    SET011, 1, 100500100), bk));
+    ASSERT_EQ(100500000, rcv.getLastTransferTimestampMonotonic().toUSec());
+    ASSERT_GT(uavcan::TransferReceiver::getDefaultTransferInterval(), rcv.getInterval());
+
+    /*
+     * Unless it is too old to be kept; the interval is saturated then
+     */
+    const uavcan::MonotonicDuration interval = rcv.getInterval();
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "1234567", SET100, 5, 10000000000ULL), bk));
+    ASSERT_EQ(0, rcv.getLastTransferTimestampMonotonic().toUSec());
+    CHECK_COMPLETE(    rcv.addFrame(gen(1, "abcd",    SET011, 5, 10000000100ULL), bk));
+    ASSERT_EQ(10000000000ULL, rcv.getLastTransferTimestampMonotonic().toUSec());
+    ASSERT_EQ(interval, rcv.getInterval());
+}
+
+
 TEST(TransferReceiver, HeaderParsing)
 {
     static const std::string SFT_PAYLOAD = "1234567";
@@ -559,3 +639,48 @@ TEST(TransferReceiver, HeaderParsing)
 
 
 }
+
+
+TEST(TransferReceiver, IncrementalCrc)
+{
+    Context<32> context;
+    RxFrameGenerator gen(789);
+    uavcan::TransferReceiver& rcv = context.receiver;
+    uavcan::TransferBufferAccessor bk(context.bufmgr, RxFrameGenerator::DEFAULT_KEY);
+
+    uavcan::TransferCRC crc_base;
+    crc_base.add(uint8_t(0xAB));
+
+    uavcan::TransferCRC expected_crc = crc_base;
+    expected_crc.add(reinterpret_cast<const uint8_t*>("34567qwertyuabcd"), 16);
+    std::string crc_str;                                    // Little endian
+    crc_str += char(expected_crc.get() & 0xFF);
+    crc_str += char(expected_crc.get() >> 8);
+
+    /*
+     * Valid CRC, computed from the seeded base
+     */
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(0, crc_str + "34567", SET100, 0, 100), bk, crc_base));
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(0, "qwertyu",         SET001, 0, 200), bk, crc_base));
+    CHECK_COMPLETE(    rcv.addFrame(gen(0, "abcd",            SET010, 0, 300), bk, crc_base));
+    ASSERT_EQ(expected_crc.get(), rcv.getLastTransferCrc());
+    ASSERT_EQ(expected_crc.get(), rcv.getLastTransferComputedCrc());
+    ASSERT_TRUE(rcv.isLastTransferCrcValid());
+
+    /*
+     * Corrupted payload; the state of the previous transfer must not leak into the next one
+     */
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(0, crc_str + "34567", SET100, 1, 1000), bk, crc_base));
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(0, "qwertyu",         SET001, 1, 1100), bk, crc_base));
+    CHECK_COMPLETE(    rcv.addFrame(gen(0, "abce",            SET010, 1, 1200), bk, crc_base));
+    ASSERT_EQ(expected_crc.get(), rcv.getLastTransferCrc());
+    ASSERT_FALSE(rcv.isLastTransferCrcValid());
+
+    /*
+     * Same payload, but the base is not seeded
+     */
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(0, crc_str + "34567", SET100, 2, 2000), bk));
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(0, "qwertyu",         SET001, 2, 2100), bk));
+    CHECK_COMPLETE(    rcv.addFrame(gen(0, "abcd",            SET010, 2, 2200), bk));
+    ASSERT_FALSE(rcv.isLastTransferCrcValid());
+}
@@ -264,3 +264,298 @@ TEST(TransferSender, PassiveMode)
     EXPECT_EQ(1, dispatcher.getTransferPerfCounter().getTxTransferCount());
     EXPECT_EQ(0, dispatcher.getTransferPerfCounter().getRxTransferCount());
 }
+
+TEST(TransferSender, AtomicAdmission)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 30, uavcan::MemPoolBlockSize> poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+    driver.ifaces.at(0).writeable = false;
+    driver.ifaces.at(1).writeable = false;
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock);     // TX queue quota is 11 blocks
+    ASSERT_TRUE(dispatcher.setNodeID(64));
+    const uavcan::CanIOManager& canio = dispatcher.getCanIOManager();
+    ASSERT_EQ(11, canio.getTxQueueQuota(1));
+
+    uavcan::TransferSender sender(dispatcher, makeDataType(uavcan::DataTypeKindMessage, 1),
+                                  uavcan::CanTxQueue::Volatile);
+
+    // Filling the queue of the iface 1 up to 3 free blocks; nothing can be transmitted, so everything is queued
+    sender.setIfaceMask(2);
+    for (int i = 0; i < 8; i++)
+    {
+        ASSERT_EQ(0, sendOne(sender, "123", 1000000, 0, uavcan::TransferTypeMessageBroadcast, 0));
+    }
+    ASSERT_EQ(0, canio.getIfacePerfCounters(1).errors);
+    const unsigned num_used_blocks = poolmgr.getNumUsedBlocks();
+
+    // The transfer of 5 frames fits into the queue of the iface 0 only; nothing is sent to the iface 1
+    const std::string payload(33, 'x');
+    sender.setIfaceMask(3);
+    ASSERT_EQ(5, sendOne(sender, payload, 1000000, 0, uavcan::TransferTypeMessageBroadcast, 0));
+    EXPECT_EQ(0, canio.getIfacePerfCounters(0).errors);
+    EXPECT_EQ(5, canio.getIfacePerfCounters(1).errors);
+    EXPECT_EQ(num_used_blocks + 5, poolmgr.getNumUsedBlocks());
+
+    // Not admitted anywhere
+    sender.setIfaceMask(2);
+    EXPECT_EQ(-uavcan::ErrMemory, sendOne(sender, payload, 1000000, 0, uavcan::TransferTypeMessageBroadcast, 0));
+    EXPECT_EQ(10, canio.getIfacePerfCounters(1).errors);
+    EXPECT_EQ(num_used_blocks + 5, poolmgr.getNumUsedBlocks());
+    EXPECT_EQ(1, dispatcher.getTransferPerfCounter().getErrorCount());
+
+    // Multi-frame transfers that can't fit into the queue anyway are sent as before
+    const std::string long_payload(100, 'x');
+    sender.setIfaceMask(1);
+    ASSERT_EQ(15, sendOne(sender, long_payload, 1000000, 0, uavcan::TransferTypeMessageBroadcast, 0));
+    EXPECT_EQ(num_used_blocks + 11, poolmgr.getNumUsedBlocks());
+}
+
+static uavcan::CanFrame compileSingleFrame(const uavcan::DataTypeDescriptor& type, uavcan::TransferType transfer_type,
+                                           uavcan::NodeID src, uavcan::NodeID dst, uavcan::TransferID tid,
+                                           uavcan::TransferPriority priority, const std::string& payload)
+{
+    uavcan::Frame frame(type.getID(), transfer_type, src, dst, tid);
+    frame.setPriority(priority);
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    EXPECT_EQ(payload.length(), frame.setPayload(reinterpret_cast<const uint8_t*>(payload.c_str()),
+                                                 unsigned(payload.length())));
+    uavcan::CanFrame can_frame;
+    EXPECT_TRUE(frame.compile(can_frame));
+    return can_frame;
+}
+
+TEST(TransferSender, SingleFrameCache)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    static const uavcan::NodeID TX_NODE_ID(64);
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(TX_NODE_ID));
+
+    const uavcan::DataTypeDescriptor msg_type = makeDataType(uavcan::DataTypeKindMessage, 1);
+    const uavcan::DataTypeDescriptor srv_type = makeDataType(uavcan::DataTypeKindService, 1);
+    uavcan::TransferSender msg_sender(dispatcher, msg_type, uavcan::CanTxQueue::Volatile);
+    uavcan::TransferSender srv_sender(dispatcher, srv_type, uavcan::CanTxQueue::Persistent);
+
+    CanIfaceMock& iface = driver.ifaces.at(0);
+    const uavcan::TransferType MsgBcast = uavcan::TransferTypeMessageBroadcast;
+    const uavcan::TransferType SrvReq = uavcan::TransferTypeServiceRequest;
+    const uavcan::NodeID Bcast = uavcan::NodeID::Broadcast;
+
+    // The first transfer fills the cache, the following ones are compiled from it
+    const char* const payloads[] = { "abc", "defghij", "", "k" };
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        ASSERT_EQ(1, sendOne(msg_sender, payloads[i], 1000000, 0, MsgBcast, Bcast, i));
+        EXPECT_TRUE(iface.popTxFrame() == compileSingleFrame(msg_type, MsgBcast, TX_NODE_ID, Bcast, i,
+                                                             uavcan::TransferPriority::Default, payloads[i]));
+    }
+
+    // Priority change invalidates the cache
+    msg_sender.setPriority(5);
+    for (uint8_t i = 4; i < 6; i++)
+    {
+        ASSERT_EQ(1, sendOne(msg_sender, "12", 1000000, 0, MsgBcast, Bcast, i));
+        EXPECT_TRUE(iface.popTxFrame() == compileSingleFrame(msg_type, MsgBcast, TX_NODE_ID, Bcast, i, 5, "12"));
+    }
+
+    // The destination is a part of the key
+    ASSERT_EQ(1, sendOne(srv_sender, "req", 1000000, 0, SrvReq, 65, 7));
+    EXPECT_TRUE(iface.popTxFrame() == compileSingleFrame(srv_type, SrvReq, TX_NODE_ID, 65, 7,
+                                                         uavcan::TransferPriority::Default, "req"));
+    ASSERT_EQ(1, sendOne(srv_sender, "req", 1000000, 0, SrvReq, 66, 8));
+    EXPECT_TRUE(iface.popTxFrame() == compileSingleFrame(srv_type, SrvReq, TX_NODE_ID, 66, 8,
+                                                         uavcan::TransferPriority::Default, "req"));
+    ASSERT_EQ(1, sendOne(srv_sender, "req", 1000000, 0, SrvReq, 66, 9));
+    EXPECT_TRUE(iface.popTxFrame() == compileSingleFrame(srv_type, SrvReq, TX_NODE_ID, 66, 9,
+                                                         uavcan::TransferPriority::Default, "req"));
+
+    // Multi-frame transfers bypass the cache
+    ASSERT_EQ(2, sendOne(msg_sender, "Multi-frame", 1000000, 0, MsgBcast, Bcast, 10));
+    EXPECT_EQ(2, iface.tx.size());
+    EXPECT_EQ(0, dispatcher.getTransferPerfCounter().getErrorCount());
+    EXPECT_EQ(10, dispatcher.getTransferPerfCounter().getTxTransferCount());
+}
+
+static int sendOneInPlace(uavcan::TransferSender& sender, const std::string& data, uavcan::TransferType transfer_type,
+                          uavcan::NodeID dst_node_id, uavcan::TransferID tid)
+{
+    uavcan::CanFrame can_frame;
+    (void)std::copy(data.begin(), data.end(), can_frame.data);
+    return sender.sendInPlace(can_frame, uint16_t(data.length()), tsMono(1000000), tsMono(0), transfer_type,
+                              dst_node_id, tid);
+}
+
+TEST(TransferSender, SendInPlace)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    static const uavcan::NodeID TX_NODE_ID(64);
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(TX_NODE_ID));
+
+    const uavcan::DataTypeDescriptor msg_type = makeDataType(uavcan::DataTypeKindMessage, 1);
+    uavcan::TransferSender sender(dispatcher, msg_type, uavcan::CanTxQueue::Volatile);
+
+    CanIfaceMock& iface = driver.ifaces.at(0);
+    const uavcan::TransferType MsgBcast = uavcan::TransferTypeMessageBroadcast;
+    const uavcan::NodeID Bcast = uavcan::NodeID::Broadcast;
+
+    // The first transfer goes the regular way and fills the cache, the following ones are sent in place
+    const char* const payloads[] = { "abc", "defghij", "", "k" };
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        ASSERT_EQ(1, sendOneInPlace(sender, payloads[i], MsgBcast, Bcast, i));
+        EXPECT_TRUE(iface.popTxFrame() == compileSingleFrame(msg_type, MsgBcast, TX_NODE_ID, Bcast, i,
+                                                             uavcan::TransferPriority::Default, payloads[i]));
+    }
+
+    // Automatic Transfer ID
+    uavcan::CanFrame can_frame;
+    can_frame.data[0] = 'x';
+    ASSERT_EQ(1, sender.sendInPlace(can_frame, 1, tsMono(1000000), tsMono(0), MsgBcast, Bcast));
+    EXPECT_TRUE(iface.popTxFrame() == compileSingleFrame(msg_type, MsgBcast, TX_NODE_ID, Bcast, 0,
+                                                         uavcan::TransferPriority::Default, "x"));
+
+    // Transfers that don't fit one frame fall back to the regular multi-frame path
+    ASSERT_EQ(2, sendOneInPlace(sender, "Multiple", MsgBcast, Bcast, 10));
+    EXPECT_EQ(2, iface.tx.size());
+    EXPECT_EQ(0, dispatcher.getTransferPerfCounter().getErrorCount());
+    EXPECT_EQ(6, dispatcher.getTransferPerfCounter().getTxTransferCount());
+}
+
+TEST(TransferSender, Coalescing)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+    driver.ifaces.at(0).writeable = false;
+    driver.ifaces.at(1).writeable = false;
+
+    static const uavcan::NodeID TX_NODE_ID(64);
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(TX_NODE_ID));
+    uavcan::CanIOManager& canio = dispatcher.getCanIOManager();
+
+    const uavcan::DataTypeDescriptor msg_type = makeDataType(uavcan::DataTypeKindMessage, 1);
+    const uavcan::DataTypeDescriptor other_type = makeDataType(uavcan::DataTypeKindMessage, 2);
+    uavcan::TransferSender sender(dispatcher, msg_type, uavcan::CanTxQueue::Volatile);
+    uavcan::TransferSender other_sender(dispatcher, other_type, uavcan::CanTxQueue::Volatile);
+    ASSERT_FALSE(sender.isCoalescing());
+    sender.setCoalescing(true);
+
+    const uavcan::TransferType MsgBcast = uavcan::TransferTypeMessageBroadcast;
+    const uavcan::NodeID Bcast = uavcan::NodeID::Broadcast;
+
+    // Only the latest transfer stays in the queues, including the cached and multi-frame ones
+    ASSERT_EQ(0, sendOne(other_sender, "other", 1000000, 0, MsgBcast, Bcast, 0));
+    ASSERT_EQ(0, sendOne(sender, "abc", 1000000, 0, MsgBcast, Bcast, 0));
+    ASSERT_EQ(0, sendOne(sender, "def", 1000000, 0, MsgBcast, Bcast, 1));
+    ASSERT_EQ(2, sendOne(sender, "Multi-frame", 1000000, 0, MsgBcast, Bcast, 2));
+    ASSERT_EQ(2, sendOne(sender, "Multi-frame", 1000000, 0, MsgBcast, Bcast, 3));
+    sender.setPriority(5);                                          // The priority is not a part of the key
+    ASSERT_EQ(0, sendOne(sender, "ghi", 1000000, 0, MsgBcast, Bcast, 4));
+    ASSERT_EQ(0, sendOne(sender, "jkl", 1000000, 0, MsgBcast, Bcast, 5));
+
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        driver.ifaces.at(i).writeable = true;
+    }
+    uavcan::CanRxFrame rx_frame;
+    uavcan::CanIOFlags flags = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        ASSERT_EQ(0, canio.receive(rx_frame, tsMono(0), flags));
+    }
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        CanIfaceMock& iface = driver.ifaces.at(i);
+        ASSERT_EQ(2, iface.tx.size());
+        EXPECT_TRUE(iface.popTxFrame() == compileSingleFrame(msg_type, MsgBcast, TX_NODE_ID, Bcast, 5, 5, "jkl"));
+        EXPECT_TRUE(iface.popTxFrame() == compileSingleFrame(other_type, MsgBcast, TX_NODE_ID, Bcast, 0,
+                                                             uavcan::TransferPriority::Default, "other"));
+        // Superseded frames are not errors
+        EXPECT_EQ(0, canio.getIfacePerfCounters(i).errors);
+    }
+    EXPECT_EQ(0, poolmgr.getNumUsedBlocks());
+    EXPECT_EQ(0, dispatcher.getTransferPerfCounter().getErrorCount());
+}
+
+TEST(TransferSender, CanFdNegotiation)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    static const uavcan::NodeID TX_NODE_ID(64);
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock);
+    ASSERT_TRUE(dispatcher.setNodeID(TX_NODE_ID));
+    dispatcher.set_options(false, false, true);
+
+    const uavcan::DataTypeDescriptor msg_type = makeDataType(uavcan::DataTypeKindMessage, 1);
+    const uavcan::DataTypeDescriptor srv_type = makeDataType(uavcan::DataTypeKindService, 1);
+    uavcan::TransferSender msg_sender(dispatcher, msg_type, uavcan::CanTxQueue::Volatile);
+    uavcan::TransferSender srv_sender(dispatcher, srv_type, uavcan::CanTxQueue::Persistent);
+
+    CanIfaceMock& iface = driver.ifaces.at(0);
+    const uavcan::TransferType MsgBcast = uavcan::TransferTypeMessageBroadcast;
+    const uavcan::TransferType SrvReq = uavcan::TransferTypeServiceRequest;
+    const uavcan::TransferType SrvResp = uavcan::TransferTypeServiceResponse;
+
+    // Nothing is known yet
+    ASSERT_EQ(1, sendOne(srv_sender, "req", 1000000, 0, SrvReq, 65, 0));
+    EXPECT_FALSE(iface.popTxFrame().isCanFDFrame());
+
+    // A CAN FD frame from node 65 addressed to another node
+    uavcan::Frame frame(srv_type.getID(), SrvResp, 65, 66, 0, true);
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    uavcan::CanFrame can_frame;
+    ASSERT_TRUE(frame.compile(can_frame));
+    EXPECT_TRUE(can_frame.isCanFDFrame());
+    iface.pushRx(can_frame);
+    ASSERT_LE(0, dispatcher.spinOnce());
+    EXPECT_TRUE(dispatcher.getCanFdCapableNodes().contains(65));
+    EXPECT_FALSE(dispatcher.getCanFdCapableNodes().contains(66));
+
+    // Service transfers to node 65 go in CAN FD frames, the rest stays classic
+    ASSERT_EQ(1, sendOne(srv_sender, "req", 1000000, 0, SrvReq, 65, 1));
+    EXPECT_TRUE(iface.popTxFrame().isCanFDFrame());
+    ASSERT_EQ(1, sendOne(srv_sender, "resp", 1000000, 0, SrvResp, 65, 1));
+    EXPECT_TRUE(iface.popTxFrame().isCanFDFrame());
+    ASSERT_EQ(1, sendOne(srv_sender, "req", 1000000, 0, SrvReq, 66, 1));
+    EXPECT_FALSE(iface.popTxFrame().isCanFDFrame());
+    ASSERT_EQ(1, sendOne(msg_sender, "msg", 1000000, 0, MsgBcast, uavcan::NodeID::Broadcast, 1));
+    EXPECT_FALSE(iface.popTxFrame().isCanFDFrame());
+
+    // The per-sender override still applies
+    ASSERT_EQ(1, srv_sender.send(reinterpret_cast<const uint8_t*>("req"), 3, tsMono(1000000), tsMono(0), SrvReq,
+                                 65, uavcan::TransferID(2), true));
+    EXPECT_FALSE(iface.popTxFrame().isCanFDFrame());
+
+    // Negotiation disabled, or the node forgotten
+    dispatcher.set_options(false, false, false);
+    ASSERT_EQ(1, sendOne(srv_sender, "req", 1000000, 0, SrvReq, 65, 3));
+    EXPECT_FALSE(iface.popTxFrame().isCanFDFrame());
+    dispatcher.set_options(false, false, true);
+    dispatcher.setCanFdCapable(65, false);
+    ASSERT_EQ(1, sendOne(srv_sender, "req", 1000000, 0, SrvReq, 65, 4));
+    EXPECT_FALSE(iface.popTxFrame().isCanFDFrame());
+
+    // Global CAN FD overrides the negotiation
+    dispatcher.set_options(false, true, true);
+    ASSERT_EQ(1, sendOne(msg_sender, "msg", 1000000, 0, MsgBcast, uavcan::NodeID::Broadcast, 2));
+    EXPECT_TRUE(iface.popTxFrame().isCanFDFrame());
+}
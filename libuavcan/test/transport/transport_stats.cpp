@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/transport/transport_stats.hpp>
+#include <uavcan/transport/perf_counter.hpp>
+
+#if UAVCAN_TRANSPORT_STATS
+
+TEST(LatencyHistogram, Basic)
+{
+    uavcan::LatencyHistogram hist;
+    ASSERT_EQ(0, hist.getCount());
+    ASSERT_EQ(0, hist.getMax().toUSec());
+    ASSERT_EQ(0, hist.getMean().toUSec());
+
+    ASSERT_EQ(16, uavcan::LatencyHistogram::getBucketUpperBound(0).toUSec());
+    ASSERT_EQ(32, uavcan::LatencyHistogram::getBucketUpperBound(1).toUSec());
+
+    hist.add(uavcan::MonotonicDuration::fromUSec(-5));      // Negative goes to the first bucket
+    hist.add(uavcan::MonotonicDuration::fromUSec(15));
+    hist.add(uavcan::MonotonicDuration::fromUSec(16));
+    hist.add(uavcan::MonotonicDuration::fromUSec(100));     // [64, 128)
+    hist.add(uavcan::MonotonicDuration::fromMSec(100000));  // Last bucket
+
+    EXPECT_EQ(2, hist.getBucketCount(0));
+    EXPECT_EQ(1, hist.getBucketCount(1));
+    EXPECT_EQ(1, hist.getBucketCount(3));
+    EXPECT_EQ(1, hist.getBucketCount(uavcan::LatencyHistogram::NumBuckets - 1));
+    EXPECT_EQ(5, hist.getCount());
+    EXPECT_EQ(100000000, hist.getMax().toUSec());
+    EXPECT_EQ((15 + 16 + 100 + 100000000) / 5, hist.getMean().toUSec());
+
+    hist.reset();
+    EXPECT_EQ(0, hist.getCount());
+    EXPECT_EQ(0, hist.getBucketCount(0));
+}
+
+
+TEST(TransportStats, DataTypeCounters)
+{
+    uavcan::TransportStats stats;
+    ASSERT_EQ(0, stats.getNumEntries());
+    ASSERT_FALSE(stats.findEntry(uavcan::DataTypeKindMessage, 341));
+
+    stats.addTxTransfer(uavcan::TransferTypeMessageBroadcast, 341);
+    stats.addRxTransfer(uavcan::TransferTypeMessageBroadcast, 341);
+    stats.addRxTransfer(uavcan::TransferTypeMessageBroadcast, 341);
+    stats.addRxTransfer(uavcan::TransferTypeServiceRequest, 1);
+    stats.addTxTransfer(uavcan::TransferTypeServiceResponse, 1);
+    stats.addRxTransfer(uavcan::TransferTypeMessageBroadcast, 1);
+
+    ASSERT_EQ(3, stats.getNumEntries());
+
+    const uavcan::TransportStats::Entry* e = stats.findEntry(uavcan::DataTypeKindMessage, 341);
+    ASSERT_TRUE(e);
+    EXPECT_EQ(1, e->transfers_tx);
+    EXPECT_EQ(2, e->transfers_rx);
+    EXPECT_EQ(uavcan::DataTypeKindMessage, e->getDataTypeKind());
+    EXPECT_EQ(341, e->getDataTypeID().get());
+
+    e = stats.findEntry(uavcan::DataTypeKindService, 1);        // Requests and responses are counted together
+    ASSERT_TRUE(e);
+    EXPECT_EQ(1, e->transfers_tx);
+    EXPECT_EQ(1, e->transfers_rx);
+    EXPECT_EQ(uavcan::DataTypeKindService, e->getDataTypeKind());
+
+    e = stats.findEntry(uavcan::DataTypeKindMessage, 1);
+    ASSERT_TRUE(e);
+    EXPECT_EQ(0, e->transfers_tx);
+    EXPECT_EQ(1, e->transfers_rx);
+
+    /*
+     * Overflow
+     */
+    for (unsigned i = 0; i < uavcan::TransportStats::Capacity + 10; i++)
+    {
+        stats.addRxTransfer(uavcan::TransferTypeMessageBroadcast, uavcan::DataTypeID(uavcan::uint16_t(1000 + i)));
+    }
+    EXPECT_EQ(unsigned(uavcan::TransportStats::Capacity), stats.getNumEntries());
+    EXPECT_EQ(13, stats.getNumUntrackedTransfers());
+    ASSERT_TRUE(stats.findEntry(uavcan::DataTypeKindMessage, 341));
+
+    stats.reset();
+    EXPECT_EQ(0, stats.getNumEntries());
+    EXPECT_EQ(0, stats.getNumUntrackedTransfers());
+    EXPECT_FALSE(stats.findEntry(uavcan::DataTypeKindMessage, 341));
+}
+
+
+TEST(TransportStats, ErrorsAndPerfCounter)
+{
+    uavcan::TransferPerfCounter perf;
+    const uavcan::TransportStats& stats = perf.getTransportStats();
+
+    perf.addRxTransfer(uavcan::TransferTypeMessageBroadcast, 20);
+    perf.addTxTransfer(uavcan::TransferTypeMessageBroadcast, 20);
+    EXPECT_EQ(1, perf.getRxTransferCount());
+    EXPECT_EQ(1, perf.getTxTransferCount());
+    ASSERT_TRUE(stats.findEntry(uavcan::DataTypeKindMessage, 20));
+
+    perf.addErrors(2);
+    perf.addRxErrorCauses(uavcan::uint8_t((1U << uavcan::TransferErrorToggle) | (1U << uavcan::TransferErrorCrc)));
+    perf.addRxErrorCauses(uavcan::uint8_t(1U << uavcan::TransferErrorToggle));
+    perf.addRxErrorCauses(0);
+    EXPECT_EQ(2, perf.getErrorCount());
+    EXPECT_EQ(2, stats.getRxErrorCount(uavcan::TransferErrorToggle));
+    EXPECT_EQ(1, stats.getRxErrorCount(uavcan::TransferErrorCrc));
+    EXPECT_EQ(0, stats.getRxErrorCount(uavcan::TransferErrorTimeout));
+    EXPECT_EQ(0, stats.getRxErrorCount(uavcan::TransferErrorMemory));
+
+    perf.addRxLatency(uavcan::MonotonicDuration::fromUSec(200));
+    EXPECT_EQ(1, stats.getRxLatencyHistogram().getCount());
+    EXPECT_EQ(200, stats.getRxLatencyHistogram().getMax().toUSec());
+}
+
+TEST(TransportStats, SourceLosses)
+{
+    using uavcan::TransferTypeMessageBroadcast;
+    using uavcan::TransferTypeServiceRequest;
+
+    uavcan::TransportStats stats;
+    ASSERT_EQ(0, stats.getNumSourceEntries());
+    ASSERT_FALSE(stats.findSourceEntry(TransferTypeMessageBroadcast, 10, 20));
+
+    // In sequence, including the wraparound
+    for (unsigned i = 30; i < 34; i++)
+    {
+        stats.addRxSourceTransfer(TransferTypeMessageBroadcast, 10, 20, uavcan::TransferID(uavcan::uint8_t(i % 32U)));
+    }
+    const uavcan::TransportStats::SourceEntry* entry = stats.findSourceEntry(TransferTypeMessageBroadcast, 10, 20);
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(TransferTypeMessageBroadcast, entry->getTransferType());
+    EXPECT_EQ(10, entry->getSrcNodeID().get());
+    EXPECT_EQ(20, entry->getDataTypeID().get());
+    EXPECT_EQ(4, entry->transfers_rx);
+    EXPECT_EQ(0, entry->transfers_lost);
+    EXPECT_EQ(0, entry->gaps);
+
+    // Two gaps: 1 -> 4, 4 -> 5, 5 -> 10
+    stats.addRxSourceTransfer(TransferTypeMessageBroadcast, 10, 20, 4);
+    stats.addRxSourceTransfer(TransferTypeMessageBroadcast, 10, 20, 5);
+    stats.addRxSourceTransfer(TransferTypeMessageBroadcast, 10, 20, 10);
+    EXPECT_EQ(7, entry->transfers_rx);
+    EXPECT_EQ(6, entry->transfers_lost);
+    EXPECT_EQ(2, entry->gaps);
+    EXPECT_EQ(13, entry->getNumExpectedTransfers());
+
+    // Duplicates; the start of the next transfer is not one
+    stats.addRxSourceTransfer(TransferTypeMessageBroadcast, 10, 20, 10);
+    stats.addRxSourceStartOfTransfer(TransferTypeMessageBroadcast, 10, 20, 10);
+    stats.addRxSourceStartOfTransfer(TransferTypeMessageBroadcast, 10, 20, 11);
+    EXPECT_EQ(2, entry->duplicates);
+    EXPECT_EQ(7, entry->transfers_rx);
+
+    // Restart of the source is not a loss
+    stats.addRxSourceTransfer(TransferTypeMessageBroadcast, 10, 20, 0);
+    EXPECT_EQ(8, entry->transfers_rx);
+    EXPECT_EQ(6, entry->transfers_lost);
+
+    // Errors
+    stats.addRxSourceErrors(TransferTypeMessageBroadcast, 10, 20, uavcan::uint8_t(1U << uavcan::TransferErrorTimeout));
+    stats.addRxSourceErrors(TransferTypeMessageBroadcast, 10, 20, uavcan::uint8_t((1U << uavcan::TransferErrorCrc) |
+                                                                              (1U << uavcan::TransferErrorToggle)));
+    EXPECT_EQ(1, entry->timeouts);
+    EXPECT_EQ(1, entry->errors);
+
+    // Other streams are independent; an unknown stream has no duplicates
+    stats.addRxSourceStartOfTransfer(TransferTypeServiceRequest, 10, 20, 0);
+    ASSERT_FALSE(stats.findSourceEntry(TransferTypeServiceRequest, 10, 20));
+    stats.addRxSourceTransfer(TransferTypeServiceRequest, 10, 20, 7);
+    stats.addRxSourceTransfer(TransferTypeMessageBroadcast, 11, 20, 7);
+    EXPECT_EQ(3, stats.getNumSourceEntries());
+    EXPECT_EQ(1, stats.findSourceEntry(TransferTypeServiceRequest, 10, 20)->transfers_rx);
+    EXPECT_EQ(1, stats.findSourceEntry(TransferTypeMessageBroadcast, 11, 20)->transfers_rx);
+    EXPECT_EQ(8, entry->transfers_rx);
+
+    // Overflow
+    for (unsigned i = 0; i < uavcan::TransportStats::SourceCapacity; i++)
+    {
+        stats.addRxSourceTransfer(TransferTypeMessageBroadcast, 12, uavcan::DataTypeID(uavcan::uint16_t(i)), 0);
+    }
+    EXPECT_EQ(uavcan::TransportStats::SourceCapacity, stats.getNumSourceEntries());
+    EXPECT_EQ(3, stats.getNumUntrackedSourceEvents());
+
+    unsigned num_used = 0;
+    for (unsigned i = 0; i < uavcan::TransportStats::SourceCapacity; i++)
+    {
+        num_used += (stats.getSourceEntry(i).key != 0) ? 1U : 0U;
+    }
+    EXPECT_EQ(uavcan::TransportStats::SourceCapacity, num_used);
+
+    stats.reset();
+    EXPECT_EQ(0, stats.getNumSourceEntries());
+    EXPECT_EQ(0, stats.getNumUntrackedSourceEvents());
+    ASSERT_FALSE(stats.findSourceEntry(TransferTypeMessageBroadcast, 10, 20));
+}
+
+#endif
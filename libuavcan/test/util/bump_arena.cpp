@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <cstring>
+#include <gtest/gtest.h>
+#include <uavcan/util/bump_arena.hpp>
+
+
+TEST(BumpArena, Basic)
+{
+    uavcan::StaticBumpArena<128> arena;
+    ASSERT_EQ(128, arena.getCapacity());
+    ASSERT_EQ(0, arena.getUsedSize());
+
+    // Allocations are aligned
+    void* const a = arena.allocate(1);
+    ASSERT_TRUE(a);
+    ASSERT_EQ(0, reinterpret_cast<std::size_t>(a) % uavcan::BumpArena::Alignment);
+    const uavcan::BumpArena::Marker marker = arena.getMarker();
+    void* const b = arena.allocate(uavcan::BumpArena::Alignment + 1);
+    ASSERT_TRUE(b);
+    ASSERT_EQ(0, reinterpret_cast<std::size_t>(b) % uavcan::BumpArena::Alignment);
+    ASSERT_EQ(std::size_t(uavcan::BumpArena::Alignment), std::size_t(static_cast<char*>(b) - static_cast<char*>(a)));
+    std::memset(b, 0xAA, uavcan::BumpArena::Alignment + 1);
+    ASSERT_EQ(uavcan::BumpArena::Alignment * 3, arena.getUsedSize());
+
+    // Rollback returns only the memory allocated after the marker
+    arena.rollback(marker);
+    ASSERT_EQ(uavcan::BumpArena::Alignment, arena.getUsedSize());
+    ASSERT_EQ(b, arena.allocate(1));
+
+    // Out of space
+    ASSERT_FALSE(arena.allocate(129));
+    ASSERT_EQ(1, arena.getNumFailedAllocations());
+    ASSERT_EQ(uavcan::BumpArena::Alignment * 3, arena.getPeakUsedSize());
+
+    arena.reset();
+    ASSERT_EQ(0, arena.getUsedSize());
+    ASSERT_TRUE(arena.allocate(128));
+    ASSERT_FALSE(arena.allocate(1));
+    ASSERT_EQ(128, arena.getPeakUsedSize());
+}
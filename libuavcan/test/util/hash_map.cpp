@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <cstdlib>
+#include <map>
+#include <gtest/gtest.h>
+#include <uavcan/util/hash_map.hpp>
+
+
+namespace
+{
+/**
+ * The key's hash can be made degenerate, so that all keys collide.
+ */
+struct TestKey
+{
+    static bool degenerate_hash;
+
+    uint16_t value;
+
+    TestKey() : value(0) { }
+    TestKey(uint16_t arg_value) : value(arg_value) { }
+
+    uint32_t hash() const { return degenerate_hash ? 0 : uint32_t(value) << 16; }
+
+    bool operator==(const TestKey& rhs) const { return value == rhs.value; }
+};
+
+bool TestKey::degenerate_hash = false;
+
+struct OddValuePredicate
+{
+    bool operator()(const TestKey&, const uint32_t& value) const { return (value & 1U) != 0; }
+};
+
+struct ValueFindPredicate
+{
+    const uint32_t target;
+    explicit ValueFindPredicate(uint32_t target) : target(target) { }
+    bool operator()(const TestKey&, const uint32_t& value) const { return value == target; }
+};
+
+typedef uavcan::HashMap<TestKey, uint32_t> MapType;
+
+void checkConsistency(MapType& map, const std::map<uint16_t, uint32_t>& reference)
+{
+    ASSERT_EQ(reference.size(), map.getSize());
+    ASSERT_EQ(reference.empty(), map.isEmpty());
+    for (const auto& kv : reference)
+    {
+        const uint32_t* const value = map.access(kv.first);
+        ASSERT_TRUE(value);
+        ASSERT_EQ(kv.second, *value);
+    }
+    for (unsigned i = 0; i < map.getSize(); i++)
+    {
+        const MapType::KVPair* const kv = map.getByIndex(i);
+        ASSERT_TRUE(kv);
+        ASSERT_EQ(1, reference.count(kv->key.value));
+    }
+    ASSERT_FALSE(map.getByIndex(map.getSize()));
+}
+
+void runRandomOperations(unsigned num_keys)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 256, uavcan::MemPoolBlockSize> pool;
+    std::map<uint16_t, uint32_t> reference;
+    {
+        MapType map(pool);
+
+        std::srand(42);
+        for (unsigned i = 0; i < 3000; i++)
+        {
+            const uint16_t key = uint16_t(1 + (unsigned(std::rand()) % num_keys));
+            const uint32_t value = uint32_t(std::rand());
+            switch (std::rand() % 4)
+            {
+            case 0:
+            case 1:
+            {
+                ASSERT_TRUE(map.insert(key, value));
+                reference[key] = value;
+                break;
+            }
+            case 2:
+            {
+                map.remove(key);
+                reference.erase(key);
+                break;
+            }
+            default:
+            {
+                uint32_t* const p = map.access(key);
+                ASSERT_EQ(reference.count(key), p ? 1U : 0U);
+                if (p)
+                {
+                    ASSERT_EQ(reference[key], *p);
+                }
+                break;
+            }
+            }
+            if ((i % 100) == 0)
+            {
+                checkConsistency(map, reference);
+            }
+        }
+        checkConsistency(map, reference);
+
+        map.removeAllWhere(OddValuePredicate());
+        for (auto it = reference.begin(); it != reference.end();)
+        {
+            it = ((it->second & 1U) != 0) ? reference.erase(it) : std::next(it);
+        }
+        checkConsistency(map, reference);
+    }
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+}
+
+}
+
+
+TEST(HashMap, Basic)
+{
+    TestKey::degenerate_hash = false;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 128, uavcan::MemPoolBlockSize> pool;
+    MapType map(pool);
+
+    // Empty
+    ASSERT_FALSE(map.access(1));
+    map.remove(1);
+    ASSERT_TRUE(map.isEmpty());
+    ASSERT_FALSE(map.isIndexed());
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+
+    // Growing
+    for (uint16_t i = 1; i <= 100; i++)
+    {
+        ASSERT_TRUE(map.insert(i, i * 10U));
+        ASSERT_EQ(i, map.getSize());
+#if UAVCAN_HASH_MAP_INDEX_THRESHOLD > 0
+        ASSERT_EQ(i >= UAVCAN_HASH_MAP_INDEX_THRESHOLD, map.isIndexed());
+#endif
+    }
+    for (uint16_t i = 1; i <= 100; i++)
+    {
+        ASSERT_TRUE(map.access(i));
+        ASSERT_EQ(i * 10U, *map.access(i));
+    }
+    ASSERT_FALSE(map.access(101));
+
+    // Replacing
+    ASSERT_EQ(123, *map.insert(50, 123));
+    ASSERT_EQ(123, *map.access(50));
+    ASSERT_EQ(100, map.getSize());
+
+    // Search
+    ASSERT_TRUE(map.find(ValueFindPredicate(123)));
+    ASSERT_EQ(50, map.find(ValueFindPredicate(123))->value);
+    ASSERT_FALSE(map.find(ValueFindPredicate(500)));
+
+    // Removal, the index is dropped when the map gets small
+    map.removeAllWhere(OddValuePredicate());    // Only 123 is odd
+    ASSERT_FALSE(map.access(50));
+    ASSERT_EQ(99, map.getSize());
+    for (uint16_t i = 1; i <= 99; i++)
+    {
+        map.remove(i);
+        ASSERT_FALSE(map.access(i));
+        ASSERT_EQ(99U - i + ((i >= 50) ? 1U : 0U), map.getSize());
+    }
+    ASSERT_EQ(1, map.getSize());
+    ASSERT_FALSE(map.isIndexed());
+    ASSERT_EQ(1000, *map.access(100));
+
+    map.clear();
+    ASSERT_TRUE(map.isEmpty());
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+}
+
+TEST(HashMap, OutOfMemory)
+{
+    TestKey::degenerate_hash = false;
+
+    // The index competes with the entries for the memory
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+    MapType map(pool);
+
+    uint16_t num_inserted = 0;
+    while (map.insert(uint16_t(num_inserted + 1), num_inserted))
+    {
+        num_inserted++;
+    }
+    ASSERT_LT(0, num_inserted);
+    ASSERT_EQ(num_inserted, map.getSize());
+
+    // The index may be lost on growth, the linear search works the same way
+    for (uint16_t i = 1; i <= num_inserted; i++)
+    {
+        ASSERT_TRUE(map.access(i));
+        ASSERT_EQ(i - 1U, *map.access(i));
+    }
+
+    map.clear();
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+}
+
+TEST(HashMap, RandomOperations)
+{
+    TestKey::degenerate_hash = false;
+    runRandomOperations(200);
+    runRandomOperations(20);
+    runRandomOperations(5);
+
+    // All keys are in the same probe sequence, which exercises the backward shift removal
+    TestKey::degenerate_hash = true;
+    runRandomOperations(60);
+    TestKey::degenerate_hash = false;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/util/inplace_function.hpp>
+#include <uavcan/util/method_binder.hpp>
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+
+namespace
+{
+
+int addOne(int x) { return x + 1; }
+
+/**
+ * Counts the live instances, so that the leaks and double destructions are detected.
+ */
+struct CountingFunctor
+{
+    static int num_instances;
+    int increment;
+
+    explicit CountingFunctor(int arg_increment) : increment(arg_increment) { num_instances++; }
+    CountingFunctor(const CountingFunctor& rhs) : increment(rhs.increment) { num_instances++; }
+    ~CountingFunctor() { num_instances--; }
+
+    int operator()(int x) { return x + increment; }
+};
+
+int CountingFunctor::num_instances = 0;
+
+struct Accumulator
+{
+    int sum;
+    Accumulator() : sum(0) { }
+    void add(int& x) { sum += x; }
+};
+
+}
+
+TEST(InplaceFunction, Basic)
+{
+    typedef uavcan::InplaceFunction<int (int)> Function;
+
+    Function empty;
+    ASSERT_FALSE(empty);
+    ASSERT_FALSE(Function(nullptr));
+    ASSERT_FALSE(Function(static_cast<int (*)(int)>(UAVCAN_NULLPTR)));
+    ASSERT_FALSE(Function(std::function<int (int)>()));
+
+    // Function pointer
+    Function f(&addOne);
+    ASSERT_TRUE(f);
+    ASSERT_EQ(2, f(1));
+
+    // Stateful lambda, invoked as non-const
+    int counter = 0;
+    int offset = 10;
+    f = [&counter, offset](int x) { counter++; return x + offset; };
+    ASSERT_EQ(15, f(5));
+    ASSERT_EQ(1, counter);
+
+    // Copies are independent
+    const Function g = f;
+    f = nullptr;
+    ASSERT_FALSE(f);
+    ASSERT_EQ(11, g(1));
+    ASSERT_EQ(2, counter);
+
+    // std::function fits as well
+    f = std::function<int (int)>(&addOne);
+    ASSERT_EQ(4, f(3));
+}
+
+TEST(InplaceFunction, Lifetime)
+{
+    typedef uavcan::InplaceFunction<int (int)> Function;
+    ASSERT_EQ(0, CountingFunctor::num_instances);
+    {
+        Function a(CountingFunctor(3));
+        ASSERT_EQ(1, CountingFunctor::num_instances);
+        ASSERT_EQ(4, a(1));
+
+        Function b = a;
+        Function c;
+        c = b;
+        ASSERT_EQ(3, CountingFunctor::num_instances);
+
+        b = &addOne;
+        ASSERT_EQ(2, CountingFunctor::num_instances);
+        c.clear();
+        ASSERT_EQ(1, CountingFunctor::num_instances);
+        a = a;
+        ASSERT_EQ(1, CountingFunctor::num_instances);
+        ASSERT_EQ(4, a(1));
+    }
+    ASSERT_EQ(0, CountingFunctor::num_instances);
+}
+
+TEST(InplaceFunction, MethodBinder)
+{
+    typedef uavcan::MethodBinder<Accumulator*, void (Accumulator::*)(int&)> Binder;
+
+    Accumulator acc;
+    uavcan::InplaceFunction<void (int&)> f(Binder(&acc, &Accumulator::add));
+    int x = 5;
+    f(x);
+    f(x);
+    ASSERT_EQ(10, acc.sum);
+
+    // The buffer size can be chosen per instance
+    uavcan::InplaceFunction<void (int&), 64> large(f);
+    large(x);
+    ASSERT_EQ(15, acc.sum);
+}
+
+#endif
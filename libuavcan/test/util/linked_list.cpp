@@ -2,6 +2,7 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <vector>
 #include <gtest/gtest.h>
 #include <uavcan/util/linked_list.hpp>
 
@@ -143,3 +144,102 @@ TEST(LinkedList, Sorting)
         item = item->getNextListNode();
     }
 }
+
+struct DoublyListItem : uavcan::DoublyLinkedListNode<DoublyListItem>
+{
+    int value;
+
+    DoublyListItem(int value = 0)
+        : value(value)
+    { }
+
+    struct GreaterThanComparator
+    {
+        const int compare_with;
+
+        GreaterThanComparator(int compare_with)
+            : compare_with(compare_with)
+        { }
+
+        bool operator()(const DoublyListItem* item) const
+        {
+            return item->value > compare_with;
+        }
+    };
+};
+
+/**
+ * Checks the links in both directions, the tail and the cached length.
+ */
+static void checkDoublyLinkedList(const uavcan::DoublyLinkedListRoot<DoublyListItem>& root,
+                                  const std::vector<int>& expected_values)
+{
+    std::vector<int> forward;
+    const DoublyListItem* last = UAVCAN_NULLPTR;
+    for (const DoublyListItem* p = root.get(); p != UAVCAN_NULLPTR; p = p->getNextListNode())
+    {
+        ASSERT_EQ(last, p->getPrevListNode());
+        forward.push_back(p->value);
+        last = p;
+    }
+    ASSERT_EQ(last, root.getTail());
+    ASSERT_EQ(expected_values, forward);
+    ASSERT_EQ(expected_values.size(), root.getLength());
+    ASSERT_EQ(expected_values.empty(), root.isEmpty());
+}
+
+TEST(LinkedList, DoublyLinked)
+{
+    uavcan::DoublyLinkedListRoot<DoublyListItem> root;
+    checkDoublyLinkedList(root, {});
+
+    DoublyListItem items[5];
+    for (int i = 0; i < 5; i++)
+    {
+        items[i].value = i;
+    }
+
+    // FIFO
+    root.pushBack(items + 1);
+    root.pushBack(items + 2);
+    root.insert(items + 0);
+    root.pushBack(items + 3);
+    checkDoublyLinkedList(root, { 0, 1, 2, 3 });
+
+    // Relocation
+    root.pushBack(items + 0);
+    checkDoublyLinkedList(root, { 1, 2, 3, 0 });
+    root.insert(items + 0);
+    checkDoublyLinkedList(root, { 0, 1, 2, 3 });
+    root.insertAfter(items + 4, items + 1);
+    checkDoublyLinkedList(root, { 0, 1, 4, 2, 3 });
+    root.insertAfter(items + 4, items + 3);
+    checkDoublyLinkedList(root, { 0, 1, 2, 3, 4 });
+
+    // Removal from the middle, both ends, and of a node that is not in the list
+    root.remove(items + 2);
+    checkDoublyLinkedList(root, { 0, 1, 3, 4 });
+    root.remove(items + 2);
+    root.remove(UAVCAN_NULLPTR);
+    checkDoublyLinkedList(root, { 0, 1, 3, 4 });
+    root.remove(items + 0);
+    root.remove(items + 4);
+    checkDoublyLinkedList(root, { 1, 3 });
+
+    // Sorting
+    root.insertBefore(items + 2, DoublyListItem::GreaterThanComparator(2));
+    root.insertBefore(items + 4, DoublyListItem::GreaterThanComparator(4));
+    root.insertBefore(items + 0, DoublyListItem::GreaterThanComparator(0));
+    checkDoublyLinkedList(root, { 0, 1, 2, 3, 4 });
+
+    for (auto& x : items)
+    {
+        root.remove(&x);
+    }
+    checkDoublyLinkedList(root, {});
+    for (auto& x : items)
+    {
+        ASSERT_FALSE(x.getNextListNode());
+        ASSERT_FALSE(x.getPrevListNode());
+    }
+}
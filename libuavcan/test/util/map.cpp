@@ -222,3 +222,72 @@ TEST(Map, PrimitiveKey)
     ASSERT_FALSE(map->getByIndex(5));
     ASSERT_FALSE(map->getByIndex(1000));
 }
+
+namespace
+{
+
+struct OddKeyPredicate
+{
+    bool operator()(const short& key, const short&) const { return (key & 1) != 0; }
+};
+
+struct ValueEqualsPredicate
+{
+    const short target;
+    explicit ValueEqualsPredicate(short arg_target) : target(arg_target) { }
+    bool operator()(const short&, const short& value) const { return value == target; }
+};
+
+}
+
+TEST(Map, Static)
+{
+    typedef uavcan::StaticMap<short, short, 4> MapType;
+    MapType map;
+
+    ASSERT_EQ(4, MapType::getCapacity());
+    ASSERT_TRUE(map.isEmpty());
+    ASSERT_FALSE(map.access(1));
+    ASSERT_FALSE(map.getByIndex(0));
+    map.remove(1);
+
+    // Filling up
+    for (short i = 1; i <= 4; i++)
+    {
+        ASSERT_EQ(i * 10, *map.insert(i, short(i * 10)));
+        ASSERT_EQ(unsigned(i), map.getSize());
+    }
+    ASSERT_FALSE(map.insert(5, 50));                    // No space left
+    ASSERT_EQ(4, map.getSize());
+    ASSERT_EQ(123, *map.insert(3, 123));                // Replacement does not need space
+    ASSERT_EQ(123, *map.access(3));
+    ASSERT_EQ(4, map.getSize());
+
+    // Search
+    ASSERT_TRUE(map.find(ValueEqualsPredicate(123)));
+    ASSERT_EQ(3, *map.find(ValueEqualsPredicate(123)));
+    ASSERT_FALSE(map.find(ValueEqualsPredicate(30)));
+    ASSERT_TRUE(map.getByIndex(3));
+    ASSERT_FALSE(map.getByIndex(4));
+
+    // Removal
+    map.removeAllWhere(OddKeyPredicate());
+    ASSERT_EQ(2, map.getSize());
+    ASSERT_FALSE(map.access(1));
+    ASSERT_FALSE(map.access(3));
+    ASSERT_EQ(20, *map.access(2));
+    ASSERT_EQ(40, *map.access(4));
+
+    // The freed slots are reused
+    ASSERT_EQ(50, *map.insert(5, 50));
+    ASSERT_EQ(60, *map.insert(6, 60));
+    ASSERT_FALSE(map.insert(7, 70));
+
+    map.remove(4);
+    ASSERT_EQ(3, map.getSize());
+    ASSERT_FALSE(map.access(4));
+
+    map.clear();
+    ASSERT_TRUE(map.isEmpty());
+    ASSERT_EQ(0, map.getSize());
+}
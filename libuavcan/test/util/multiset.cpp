@@ -265,3 +265,64 @@ TEST(Multiset, NoncopyableWithCounter)
     ASSERT_EQ(0, pool.getNumUsedBlocks());
     ASSERT_EQ(0, NoncopyableWithCounter::num_objects);          // All destroyed
 }
+
+TEST(Multiset, Static)
+{
+    typedef uavcan::StaticMultiset<NoncopyableWithCounter, 4> MultisetType;
+    ASSERT_EQ(4, MultisetType::getCapacity());
+    {
+        MultisetType mset;
+        ASSERT_TRUE(mset.isEmpty());
+        ASSERT_FALSE(mset.getByIndex(0));
+
+        ASSERT_EQ(0, NoncopyableWithCounter::num_objects);
+        ASSERT_EQ(0,    mset.emplace()->value);
+        ASSERT_EQ(123,  mset.emplace(123)->value);
+        ASSERT_EQ(-456, mset.emplace(-456)->value);
+        ASSERT_EQ(-789, mset.emplace(-789)->value);
+        ASSERT_FALSE(mset.emplace(1));                          // No space left
+        ASSERT_EQ(4, NoncopyableWithCounter::num_objects);
+        ASSERT_EQ(4, mset.getSize());
+
+        // The items are never moved
+        NoncopyableWithCounter* const item_123 = mset.getByIndex(1);
+        ASSERT_EQ(123, item_123->value);
+
+        mset.removeFirst(NoncopyableWithCounter(0));
+        ASSERT_EQ(3, NoncopyableWithCounter::num_objects);
+        ASSERT_EQ(item_123, mset.getByIndex(0));
+
+        mset.removeFirstWhere(&NoncopyableWithCounter::isNegative);
+        ASSERT_EQ(2, mset.getSize());
+        ASSERT_EQ(-789, mset.getByIndex(1)->value);
+
+        // The freed slot is reused
+        ASSERT_EQ(42, mset.emplace(42)->value);
+        ASSERT_EQ(3, mset.getSize());
+
+        mset.removeAllWhere(&NoncopyableWithCounter::isNegative);
+        ASSERT_EQ(2, NoncopyableWithCounter::num_objects);
+        ASSERT_EQ(42, mset.getByIndex(0)->value);               // Took the first free slot
+        ASSERT_EQ(item_123, mset.getByIndex(1));
+
+        long long sum = 0;
+        for (unsigned i = 0; i < mset.getSize(); i++)
+        {
+            sum += mset.getByIndex(i)->value;
+        }
+        ASSERT_EQ(165, sum);
+    }
+    ASSERT_EQ(0, NoncopyableWithCounter::num_objects);          // All destroyed
+
+    uavcan::StaticMultiset<int, 3> ints;
+    ints.emplace(1);
+    ints.emplace(2);
+    ints.emplace(3);
+    SummationOperator<int> summation_operator;
+    ints.forEach<SummationOperator<int>&>(summation_operator);
+    ASSERT_EQ(6, summation_operator.accumulator);
+    ints.forEach(ClearingOperator());
+    ASSERT_EQ(0, *ints.getByIndex(2));
+    ints.removeAll(0);
+    ASSERT_TRUE(ints.isEmpty());
+}
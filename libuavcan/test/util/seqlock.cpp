@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <thread>
+#include <gtest/gtest.h>
+#include <uavcan/util/seqlock.hpp>
+
+
+namespace
+{
+
+struct OddSizedValue
+{
+    uavcan::uint8_t bytes[7];
+};
+
+struct CheckedValue
+{
+    uavcan::uint32_t a;
+    uavcan::uint64_t b;
+    uavcan::uint8_t c[13];
+};
+
+}
+
+TEST(SeqLocked, Basic)
+{
+    uavcan::SeqLocked<OddSizedValue> value;
+    OddSizedValue out;
+    out.bytes[0] = 42;
+    ASSERT_FALSE(value.load(out));
+    ASSERT_EQ(42, out.bytes[0]);                // Unchanged
+    ASSERT_EQ(0, value.getNumStores());
+
+    OddSizedValue in;
+    for (unsigned i = 0; i < sizeof(in.bytes); i++)
+    {
+        in.bytes[i] = uavcan::uint8_t(i + 1);
+    }
+    value.store(in);
+    ASSERT_TRUE(value.load(out));
+    ASSERT_EQ(0, std::memcmp(&in, &out, sizeof(in)));
+    ASSERT_EQ(1, value.getNumStores());
+
+    in.bytes[6] = 200;
+    value.store(in);
+    ASSERT_TRUE(value.load(out));
+    ASSERT_EQ(200, out.bytes[6]);
+    ASSERT_EQ(2, value.getNumStores());
+}
+
+
+TEST(SeqLocked, ConcurrentReader)
+{
+    uavcan::SeqLocked<CheckedValue> value;
+    std::atomic<bool> done(false);
+    unsigned num_torn = 0;
+    unsigned num_reads = 0;
+
+    // Every stored value has all fields derived from the same counter, so a torn copy is easy to detect
+    std::thread reader([&]()
+    {
+        CheckedValue out;
+        while (!done.load())
+        {
+            if (value.load(out))
+            {
+                num_reads++;
+                bool torn = (out.b != out.a * 3ULL);
+                for (unsigned i = 0; i < sizeof(out.c); i++)
+                {
+                    torn = torn || (out.c[i] != uavcan::uint8_t(out.a));
+                }
+                num_torn += torn ? 1U : 0U;
+            }
+        }
+    });
+
+    for (uavcan::uint32_t i = 1; i <= 100000; i++)
+    {
+        CheckedValue in;
+        in.a = i;
+        in.b = i * 3ULL;
+        std::memset(in.c, int(uavcan::uint8_t(i)), sizeof(in.c));
+        value.store(in);
+    }
+
+    done = true;
+    reader.join();
+
+    ASSERT_EQ(0, num_torn);
+    ASSERT_LT(0, num_reads);
+    ASSERT_EQ(100000, value.getNumStores());
+}
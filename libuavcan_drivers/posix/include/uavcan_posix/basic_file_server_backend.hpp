@@ -10,6 +10,8 @@
 #define UAVCAN_POSIX_BASIC_FILE_SERVER_BACKEND_HPP_INCLUDED
 
 #include <sys/stat.h>
+#include <dirent.h>
+#include <algorithm>
 #include <cstdio>
 #include <cstddef>
 #include <cstdlib>
@@ -59,11 +61,34 @@ protected:
             return ::close(fd);
         }
 
+        virtual int getAttributes(int fd, uavcan::uint64_t& out_size, mode_t& out_mode)
+        {
+            struct stat sb;
+            if (::fstat(fd, &sb) < 0)
+            {
+                return -1;
+            }
+            out_size = uavcan::uint64_t(sb.st_size);
+            out_mode = sb.st_mode;
+            return 0;
+        }
+
         virtual void init() { }
     };
 
     FDCacheBase fallback_;
 
+    /**
+     * Keeps the descriptors of the recently read files open, so that the consecutive requests for the same file
+     * don't have to open it again; the reads use pread(), so one descriptor serves any number of concurrent
+     * transfers of the file. The size and the type of the file are cached with the descriptor, so that GetInfo
+     * doesn't have to stat it.
+     *
+     * The entries are hashed by path and by descriptor, so every lookup takes constant time. The number of open
+     * descriptors is limited; when the limit is reached, the least recently used entry is closed. An entry is
+     * also closed when the file has been read to the end or the read has failed, or if it hasn't been used
+     * for @ref MaxAgeSeconds, so that replaced files are picked up.
+     */
     class FDCache : public FDCacheBase, protected uavcan::TimerBase
     {
         /// Age in Seconds an entry will stay in the cache if not accessed.
@@ -74,97 +99,85 @@ protected:
 
         IFileServerBackend::Path& alt_root_path_;
         IFileServerBackend::Path& root_path_;
+        const bool& advise_sequential_;
 
         class FDCacheItem : uavcan::Noncopyable
         {
-            friend FDCache;
+            friend class FDCache;
 
-            FDCacheItem* next_;
+            FDCacheItem* path_next_;    ///< Next in the path bucket, or in the free list
+            FDCacheItem* fd_next_;      ///< Next in the descriptor bucket
+            FDCacheItem* newer_;
+            FDCacheItem* older_;
             std::time_t last_access_;
-            const int fd_;
-            const int oflags_;
-            const char* const path_;
+            int fd_;
+            int oflags_;
+            uavcan::uint32_t path_hash_;
+            uavcan::uint64_t size_;
+            mode_t mode_;
+            Path path_;
 
         public:
             enum { InvalidFD = -1 };
 
             FDCacheItem() :
-                next_(UAVCAN_NULLPTR),
+                path_next_(UAVCAN_NULLPTR),
+                fd_next_(UAVCAN_NULLPTR),
+                newer_(UAVCAN_NULLPTR),
+                older_(UAVCAN_NULLPTR),
                 last_access_(0),
                 fd_(InvalidFD),
                 oflags_(0),
-                path_(UAVCAN_NULLPTR)
-            { }
-
-            FDCacheItem(int fd, const char* path, int oflags) :
-                next_(UAVCAN_NULLPTR),
-                last_access_(0),
-                fd_(fd),
-                oflags_(oflags),
-                path_(::strndup(path, uavcan::protocol::file::Path::FieldTypes::path::MaxSize))
+                path_hash_(0),
+                size_(0),
+                mode_(0)
             { }
 
-            ~FDCacheItem()
-            {
-                using namespace std;
-                if (valid())
-                {
-                    ::free(const_cast<char*>(path_));
-                }
-            }
-
-            bool valid() const
-            {
-                return path_ != UAVCAN_NULLPTR;
-            }
-
-            int getFD() const
-            {
-                return fd_;
-            }
-
-            std::time_t getAccess() const
-            {
-                return last_access_;
-            }
-
-            std::time_t acessed()
-            {
-                using namespace std;
-                last_access_ = time(UAVCAN_NULLPTR);
-                return getAccess();
-            }
-
-            void expire()
+            bool expired(std::time_t now) const
             {
-                last_access_ = 0;
-            }
-
-            bool expired() const
-            {
-                using namespace std;
-                return 0 == last_access_ || (time(UAVCAN_NULLPTR) - last_access_) > MaxAgeSeconds;
+                return (now - last_access_) > MaxAgeSeconds;
             }
+        };
 
-            bool equals(const char* path, int oflags) const
+        FDCacheItem* const items_;
+        FDCacheItem** const path_buckets_;
+        FDCacheItem** const fd_buckets_;
+        const unsigned max_items_;
+        const unsigned bucket_mask_;
+        FDCacheItem* free_;
+        FDCacheItem* newest_;
+        FDCacheItem* oldest_;
+        unsigned num_items_;
+
+        static unsigned computeNumBuckets(unsigned max_items)
+        {
+            unsigned n = 1;
+            while (n < max_items * 2U)
             {
-                using namespace std;
-                return oflags_ == oflags && 0 == ::strcmp(path, path_);
+                n <<= 1;
             }
+            return n;
+        }
 
-            bool equals(int fd) const
+        /// FNV-1a
+        static uavcan::uint32_t computePathHash(const char* path, int oflags)
+        {
+            uavcan::uint32_t hash = 2166136261U ^ uavcan::uint32_t(oflags);
+            for (; *path != '\0'; path++)
             {
-                return fd_ == fd;
+                hash = (hash ^ uavcan::uint8_t(*path)) * 16777619U;
             }
-        };
+            return hash;
+        }
 
-        FDCacheItem* head_;
+        FDCacheItem*& pathBucket(uavcan::uint32_t hash) { return path_buckets_[hash & bucket_mask_]; }
+        FDCacheItem*& fdBucket(int fd)                   { return fd_buckets_[unsigned(fd) & bucket_mask_]; }
 
-        FDCacheItem* find(const char* path, int oflags)
+        FDCacheItem* find(const char* path, int oflags, uavcan::uint32_t hash)
         {
-            for (FDCacheItem* pi = head_; pi; pi = pi->next_)
+            for (FDCacheItem* pi = pathBucket(hash); pi; pi = pi->path_next_)
             {
-                if (pi->equals(path, oflags))
+                if (pi->path_hash_ == hash && pi->oflags_ == oflags && 0 == std::strcmp(pi->path_.c_str(), path))
                 {
                     return pi;
                 }
@@ -174,9 +187,9 @@ protected:
 
         FDCacheItem* find(int fd)
         {
-            for (FDCacheItem* pi = head_; pi; pi = pi->next_)
+            for (FDCacheItem* pi = fdBucket(fd); pi; pi = pi->fd_next_)
             {
-                if (pi->equals(fd))
+                if (pi->fd_ == fd)
                 {
                     return pi;
                 }
@@ -184,74 +197,139 @@ protected:
             return UAVCAN_NULLPTR;
         }
 
-        FDCacheItem* add(FDCacheItem* pi)
+        void unlinkFromAge(FDCacheItem* pi)
         {
-            pi->next_ = head_;
-            head_ = pi;
-            pi->acessed();
-            return pi;
+            (pi->newer_ ? pi->newer_->older_ : newest_) = pi->older_;
+            (pi->older_ ? pi->older_->newer_ : oldest_) = pi->newer_;
+            pi->newer_ = UAVCAN_NULLPTR;
+            pi->older_ = UAVCAN_NULLPTR;
         }
 
-        void removeExpired(FDCacheItem** pi)
+        void touch(FDCacheItem* pi, std::time_t now)
         {
-            while (*pi)
+            pi->last_access_ = now;
+            if (pi != newest_)
             {
-                if ((*pi)->expired())
-                {
-                    FDCacheItem* next = (*pi)->next_;
-                    (void)FDCacheBase::close((*pi)->fd_);
-                    delete (*pi);
-                    *pi = next;
-                    continue;
-                }
-                pi = &(*pi)->next_;
+                unlinkFromAge(pi);
+                pi->older_ = newest_;
+                newest_->newer_ = pi;
+                newest_ = pi;
             }
         }
 
-        void remove(FDCacheItem* pi, bool done)
+        void remove(FDCacheItem* pi)
         {
-            if (done)
+            FDCacheItem** pp = &pathBucket(pi->path_hash_);
+            while (*pp != pi)
             {
-                pi->expire();
+                pp = &(*pp)->path_next_;
+            }
+            *pp = pi->path_next_;
+
+            pp = &fdBucket(pi->fd_);
+            while (*pp != pi)
+            {
+                pp = &(*pp)->fd_next_;
+            }
+            *pp = pi->fd_next_;
+
+            unlinkFromAge(pi);
+            (void)FDCacheBase::close(pi->fd_);
+            pi->fd_ = FDCacheItem::InvalidFD;
+            pi->path_next_ = free_;
+            free_ = pi;
+            num_items_--;
+        }
+
+        void add(int fd, const char* path, int oflags, uavcan::uint32_t hash, const struct stat& sb, std::time_t now)
+        {
+            if (free_ == UAVCAN_NULLPTR)
+            {
+                remove(oldest_);
+            }
+            FDCacheItem* const pi = free_;
+            free_ = pi->path_next_;
+
+            pi->fd_ = fd;
+            pi->oflags_ = oflags;
+            pi->path_hash_ = hash;
+            pi->size_ = uavcan::uint64_t(sb.st_size);
+            pi->mode_ = sb.st_mode;
+            pi->path_ = path;
+            pi->last_access_ = now;
+
+            pi->path_next_ = pathBucket(hash);
+            pathBucket(hash) = pi;
+            pi->fd_next_ = fdBucket(fd);
+            fdBucket(fd) = pi;
+
+            pi->newer_ = UAVCAN_NULLPTR;
+            pi->older_ = newest_;
+            (newest_ ? newest_->newer_ : oldest_) = pi;
+            newest_ = pi;
+            num_items_++;
+        }
+
+        void removeExpired(std::time_t now)
+        {
+            while (oldest_ != UAVCAN_NULLPTR && oldest_->expired(now))
+            {
+                remove(oldest_);
             }
-            removeExpired(&head_);
         }
 
         void clear()
         {
-            FDCacheItem* tmp;
-            for (FDCacheItem* pi = head_; pi; pi = tmp)
+            while (oldest_ != UAVCAN_NULLPTR)
             {
-                tmp = pi->next_;
-                (void)FDCacheBase::close(pi->fd_);
-                delete pi;
+                remove(oldest_);
             }
         }
 
         /* Removed stale entries. In the normal case a node will read the
          * complete contents of a file and the read of the last block will
-         * cause the method remove() to be invoked with done true. Thereby
+         * cause the method close() to be invoked with done true. Thereby
          * flushing the entry from the cache. But if the node does not
          * stay the course of the read, it may leave a dangling entry.
-         * This call back handles the garbage collection.
+         * This call back handles the garbage collection; the entries are
+         * ordered by age, so only the stale ones are visited.
          */
         virtual void handleTimerEvent(const uavcan::TimerEvent&)
         {
-            removeExpired(&head_);
+            removeExpired(std::time(UAVCAN_NULLPTR));
         }
 
     public:
-        FDCache(uavcan::INode& node, IFileServerBackend::Path& root_path, IFileServerBackend::Path& alt_root_path) :
+        FDCache(uavcan::INode& node, IFileServerBackend::Path& root_path, IFileServerBackend::Path& alt_root_path,
+                unsigned max_open_files, const bool& advise_sequential) :
             TimerBase(node),
             alt_root_path_(alt_root_path),
             root_path_(root_path),
-            head_(UAVCAN_NULLPTR)
-        { }
+            advise_sequential_(advise_sequential),
+            items_(new FDCacheItem[max_open_files]),
+            path_buckets_(new FDCacheItem*[computeNumBuckets(max_open_files)]()),
+            fd_buckets_(new FDCacheItem*[computeNumBuckets(max_open_files)]()),
+            max_items_(max_open_files),
+            bucket_mask_(computeNumBuckets(max_open_files) - 1U),
+            free_(UAVCAN_NULLPTR),
+            newest_(UAVCAN_NULLPTR),
+            oldest_(UAVCAN_NULLPTR),
+            num_items_(0)
+        {
+            for (unsigned i = 0; i < max_items_; i++)
+            {
+                items_[i].path_next_ = free_;
+                free_ = &items_[i];
+            }
+        }
 
         virtual ~FDCache()
         {
             stop();
             clear();
+            delete[] fd_buckets_;
+            delete[] path_buckets_;
+            delete[] items_;
         }
 
         virtual void init()
@@ -261,58 +339,56 @@ protected:
 
         virtual int open(const char* path, int oflags)
         {
-            int fd = FDCacheItem::InvalidFD;
-
-            FDCacheItem* pi = find(path, oflags);
+            const std::time_t now = std::time(UAVCAN_NULLPTR);
+            const uavcan::uint32_t hash = computePathHash(path, oflags);
 
+            FDCacheItem* pi = find(path, oflags, hash);
             if (pi != UAVCAN_NULLPTR)
             {
-                pi->acessed();
-            }
-            else
-            {
-                Path vpath = root_path_.c_str();
-                vpath += path;
-
-                fd = FDCacheBase::open(vpath.c_str(), oflags);
-
-                if (fd < 0)
+                if (!pi->expired(now))
                 {
-                    vpath = alt_root_path_.c_str();
-                    vpath += path;
-                    fd = FDCacheBase::open(vpath.c_str(), oflags);
+                    touch(pi, now);
+                    return pi->fd_;
                 }
+                remove(pi);                     // The file may have been replaced, reopening
+            }
 
-                if (fd < 0)
-                {
-                    return fd;
-                }
+            Path vpath = root_path_.c_str();
+            vpath += path;
 
-                /* Allocate and clone path */
+            int fd = FDCacheBase::open(vpath.c_str(), oflags);
 
-                pi = new FDCacheItem(fd, path, oflags);
+            if (fd < 0)
+            {
+                vpath = alt_root_path_.c_str();
+                vpath += path;
+                fd = FDCacheBase::open(vpath.c_str(), oflags);
+            }
 
-                /* Allocation worked but check clone */
+            if (fd < 0)
+            {
+                return fd;
+            }
 
-                if (pi && !pi->valid())
+            struct stat sb;
+            if ((max_items_ > 0 || advise_sequential_) && ::fstat(fd, &sb) == 0)
+            {
+                if (advise_sequential_ && S_ISREG(sb.st_mode))
                 {
-                    /* Allocation worked but clone or path failed */
-                    delete pi;
-                    pi = UAVCAN_NULLPTR;
+                    // Files are normally read front to back, so the kernel can read ahead the whole file
+                    (void)::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+                    (void)::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
                 }
-
-                if (pi == UAVCAN_NULLPTR)
+                if (max_items_ > 0)
                 {
-                    /*
-                     * If allocation fails no harm just can not cache it
-                     * return open fd
-                     */
-                    return fd;
+                    add(fd, path, oflags, hash, sb, now);
                 }
-                /* add new */
-                add(pi);
             }
-            return pi->getFD();
+            /*
+             * Otherwise the descriptor is just not cached;
+             * close() will close it
+             */
+            return fd;
         }
 
         virtual int close(int fd, bool done)
@@ -325,19 +401,290 @@ protected:
                  */
                 return FDCacheBase::close(fd);
             }
-            remove(pi, done);
+            if (done)
+            {
+                remove(pi);
+            }
             return 0;
         }
+
+        virtual int getAttributes(int fd, uavcan::uint64_t& out_size, mode_t& out_mode)
+        {
+            const FDCacheItem* const pi = find(fd);
+            if (pi == UAVCAN_NULLPTR)
+            {
+                return FDCacheBase::getAttributes(fd, out_size, out_mode);
+            }
+            out_size = pi->size_;
+            out_mode = pi->mode_;
+            return 0;
+        }
+
+        unsigned getNumOpenFiles() const { return num_items_; }
+    };
+
+    /**
+     * Keeps the listings of the recently browsed directories, so that GetDirectoryEntryInfo, which addresses
+     * the entries by index, doesn't have to read the directory up to the index for every request; a complete
+     * listing would take quadratic time otherwise. The names are kept in one buffer per directory, so any entry
+     * is found in constant time.
+     *
+     * A listing is validated against the identity and the modification time of the directory on every request,
+     * which costs one stat(); adding, removing or renaming an entry updates the modification time, so the listing
+     * is read again. The directory is stat'ed before it is read, so a modification made while it is being read
+     * makes the listing be read again on the next request. The entries are listed in the order of readdir(),
+     * the entries whose full path would not fit into the response are skipped.
+     */
+    class DirCache : uavcan::Noncopyable
+    {
+    public:
+        /// Number of directories whose listings are kept; the least recently used one is replaced first.
+        enum { MaxListings = 4 };
+
+    private:
+        struct Entry
+        {
+            uavcan::uint32_t name_offset;
+            uavcan::uint8_t flags;
+        };
+
+        struct Listing : uavcan::Noncopyable
+        {
+            Path path;
+            dev_t dev;
+            ino_t ino;
+            struct timespec mtime;
+            uavcan::uint64_t used_at;
+            Entry* entries;
+            uavcan::uint32_t num_entries;
+            uavcan::uint32_t entries_capacity;
+            char* names;
+            uavcan::uint32_t names_size;
+            uavcan::uint32_t names_capacity;
+            bool valid;
+
+            Listing() :
+                dev(0),
+                ino(0),
+                used_at(0),
+                entries(UAVCAN_NULLPTR),
+                num_entries(0),
+                entries_capacity(0),
+                names(UAVCAN_NULLPTR),
+                names_size(0),
+                names_capacity(0),
+                valid(false)
+            {
+                mtime.tv_sec = 0;
+                mtime.tv_nsec = 0;
+            }
+
+            ~Listing()
+            {
+                delete[] entries;
+                delete[] names;
+            }
+
+            bool matches(const struct stat& sb) const
+            {
+                return valid && dev == sb.st_dev && ino == sb.st_ino &&
+                       mtime.tv_sec == sb.st_mtim.tv_sec && mtime.tv_nsec == sb.st_mtim.tv_nsec;
+            }
+        };
+
+        Listing listings_[MaxListings];
+        uavcan::uint64_t use_counter_;
+        uavcan::uint32_t num_scans_;
+
+        template <typename T>
+        static void reserve(T*& array, uavcan::uint32_t& capacity, uavcan::uint32_t size, uavcan::uint32_t needed)
+        {
+            if (needed > capacity)
+            {
+                uavcan::uint32_t new_capacity = (capacity > 0) ? capacity : 64U;
+                while (new_capacity < needed)
+                {
+                    new_capacity *= 2U;
+                }
+                T* const new_array = new T[new_capacity];
+                std::copy(array, array + size, new_array);
+                delete[] array;
+                array = new_array;
+                capacity = new_capacity;
+            }
+        }
+
+        static uavcan::uint8_t getEntryFlags(int dir_fd, const struct dirent* de)
+        {
+            using uavcan::protocol::file::EntryType;
+
+            // TODO Using fixed flag FLAG_READABLE until we add file permission checks to return actual value.
+            uavcan::uint8_t flags = EntryType::FLAG_READABLE;
+            unsigned char type = de->d_type;
+            if (type == DT_LNK || type == DT_UNKNOWN)
+            {
+                if (type == DT_LNK)
+                {
+                    flags |= EntryType::FLAG_SYMLINK;
+                }
+                struct stat sb;
+                type = (::fstatat(dir_fd, de->d_name, &sb, 0) != 0) ? DT_UNKNOWN :
+                       S_ISDIR(sb.st_mode) ? DT_DIR : S_ISREG(sb.st_mode) ? DT_REG : DT_UNKNOWN;
+            }
+            if (type == DT_DIR)
+            {
+                flags |= EntryType::FLAG_DIRECTORY;
+            }
+            else if (type == DT_REG)
+            {
+                flags |= EntryType::FLAG_FILE;
+            }
+            return flags;
+        }
+
+        /**
+         * Returns errno.
+         */
+        int scan(Listing& listing, const char* real_path, const Path& path, const struct stat& sb)
+        {
+            listing.valid = false;
+            listing.num_entries = 0;
+            listing.names_size = 0;
+
+            DIR* const dir = ::opendir(real_path);
+            if (dir == UAVCAN_NULLPTR)
+            {
+                return errno;
+            }
+            num_scans_++;
+
+            // The full path of an entry is the directory path, the separator and the name
+            const unsigned prefix_length = path.size() +
+                ((path.empty() || path.back() == getPathSeparator()) ? 0U : 1U);
+
+            struct dirent* de;
+            while ((de = ::readdir(dir)) != UAVCAN_NULLPTR)
+            {
+                const unsigned name_length = unsigned(std::strlen(de->d_name));
+                if ((std::strcmp(de->d_name, ".") == 0) || (std::strcmp(de->d_name, "..") == 0) ||
+                    (prefix_length + name_length) > Path::MaxSize)
+                {
+                    continue;
+                }
+                reserve(listing.entries, listing.entries_capacity, listing.num_entries, listing.num_entries + 1U);
+                reserve(listing.names, listing.names_capacity, listing.names_size,
+                        listing.names_size + name_length + 1U);
+
+                Entry& entry = listing.entries[listing.num_entries++];
+                entry.name_offset = listing.names_size;
+                entry.flags = getEntryFlags(::dirfd(dir), de);
+                std::memcpy(listing.names + listing.names_size, de->d_name, name_length + 1U);
+                listing.names_size += name_length + 1U;
+            }
+            (void)::closedir(dir);
+
+            listing.path = path;
+            listing.dev = sb.st_dev;
+            listing.ino = sb.st_ino;
+            listing.mtime = sb.st_mtim;
+            listing.valid = true;
+            return 0;
+        }
+
+    public:
+        DirCache() :
+            use_counter_(0),
+            num_scans_(0)
+        { }
+
+        /**
+         * Returns the error code for the response; see uavcan.protocol.file.GetDirectoryEntryInfo.
+         */
+        int getEntry(const Path& root_path, const Path& alt_root_path, const Path& directory_path,
+                     uavcan::uint32_t entry_index, EntryType& out_type, Path& out_entry_full_path)
+        {
+            Path real_path = root_path.c_str();
+            real_path += directory_path;
+
+            struct stat sb;
+            if (::stat(real_path.c_str(), &sb) != 0)
+            {
+                real_path = alt_root_path.c_str();
+                real_path += directory_path;
+                if (::stat(real_path.c_str(), &sb) != 0)
+                {
+                    return errno;
+                }
+            }
+            if (!S_ISDIR(sb.st_mode))
+            {
+                return uavcan::protocol::file::Error::INVALID_VALUE;
+            }
+
+            Listing* listing = UAVCAN_NULLPTR;
+            for (unsigned i = 0; i < MaxListings; i++)
+            {
+                if (listings_[i].valid && listings_[i].path == directory_path)
+                {
+                    listing = &listings_[i];
+                    break;
+                }
+                if (listing == UAVCAN_NULLPTR || listings_[i].used_at < listing->used_at)
+                {
+                    listing = &listings_[i];    // The least recently used one is taken if there's no match
+                }
+            }
+            listing->used_at = ++use_counter_;
+
+            if (!(listing->path == directory_path && listing->matches(sb)))
+            {
+                const int rv = scan(*listing, real_path.c_str(), directory_path, sb);
+                if (rv != 0)
+                {
+                    return rv;
+                }
+            }
+
+            if (entry_index >= listing->num_entries)
+            {
+                return uavcan::protocol::file::Error::NOT_FOUND;
+            }
+            const Entry& entry = listing->entries[entry_index];
+            out_entry_full_path = directory_path;
+            if (!out_entry_full_path.empty() && out_entry_full_path.back() != getPathSeparator())
+            {
+                out_entry_full_path.push_back(static_cast<unsigned char>(getPathSeparator()));
+            }
+            out_entry_full_path += listing->names + entry.name_offset;
+            out_type.flags = entry.flags;
+            return 0;
+        }
+
+        void invalidate()
+        {
+            for (unsigned i = 0; i < MaxListings; i++)
+            {
+                listings_[i].valid = false;
+            }
+        }
+
+        /**
+         * Number of times a directory has been read.
+         */
+        uavcan::uint32_t getNumScans() const { return num_scans_; }
     };
 
     FDCacheBase* fdcache_;
+    DirCache dircache_;
     uavcan::INode& node_;
+    const unsigned max_open_files_;
+    bool advise_sequential_;
 
     FDCacheBase& getFDCache()
     {
         if (fdcache_ == UAVCAN_NULLPTR)
         {
-            fdcache_ = new FDCache(node_, getRootPath(), getAltRootPath());
+            fdcache_ = new FDCache(node_, getRootPath(), getAltRootPath(), max_open_files_, advise_sequential_);
 
             if (fdcache_ == UAVCAN_NULLPTR)
             {
@@ -363,17 +710,40 @@ protected:
 
           using namespace std;
 
-          struct stat sb;
+          uavcan::uint64_t size = 0;
+          mode_t mode = 0;
 
-          Path vpath = getRootPath().c_str();
-          vpath += path;
+          /*
+           * The file is opened through the cache, so that the Read requests
+           * that normally follow will find it open already
+           */
+          FDCacheBase& cache = getFDCache();
+          int fd = (&cache != &fallback_) ? cache.open(path.c_str(), O_RDONLY) : -1;
+          if (fd >= 0)
+          {
+              rv = cache.getAttributes(fd, size, mode);
+              (void)cache.close(fd, rv < 0);
+          }
 
-          rv = stat(vpath.c_str(), &sb);
-          if (rv < 0)
+          if (fd < 0 || rv < 0)
           {
-              vpath = getAltRootPath().c_str();
+              struct stat sb;
+
+              Path vpath = getRootPath().c_str();
               vpath += path;
+
               rv = stat(vpath.c_str(), &sb);
+              if (rv < 0)
+              {
+                  vpath = getAltRootPath().c_str();
+                  vpath += path;
+                  rv = stat(vpath.c_str(), &sb);
+              }
+              if (rv >= 0)
+              {
+                  size = sb.st_size;
+                  mode = sb.st_mode;
+              }
           }
 
           if (rv < 0)
@@ -383,13 +753,13 @@ protected:
           else
           {
               rv = 0;
-              out_size = sb.st_size;
+              out_size = size;
               out_type.flags = uavcan::protocol::file::EntryType::FLAG_READABLE;
-              if (S_ISDIR(sb.st_mode))
+              if (S_ISDIR(mode))
               {
                   out_type.flags |= uavcan::protocol::file::EntryType::FLAG_DIRECTORY;
               }
-              else if (S_ISREG(sb.st_mode))
+              else if (S_ISREG(mode))
               {
                   out_type.flags |= uavcan::protocol::file::EntryType::FLAG_FILE;
               }
@@ -426,33 +796,24 @@ protected:
             else
             {
                 ssize_t total_read = 0;
-
-                rv = ::lseek(fd, offset, SEEK_SET);
-
-                if (rv < 0)
-                {
-                    rv = -errno;
-                }
-                else
+                ssize_t remaining = inout_size;
+                ssize_t nread = 0;
+                rv = 0;
+                do
                 {
-                    rv = 0;
-                    ssize_t remaining = inout_size;
-                    ssize_t nread = 0;
-                    do
+                    // pread() leaves the offset of the shared descriptor alone
+                    nread = ::pread(fd, &out_buffer[total_read], remaining, off_t(offset + total_read));
+                    if (nread < 0)
                     {
-                        nread = ::read(fd, &out_buffer[total_read], remaining);
-                        if (nread < 0)
-                        {
-                            rv = errno;
-                        }
-                        else
-                        {
-                            remaining -= nread,
-                            total_read += nread;
-                        }
+                        rv = errno;
+                    }
+                    else
+                    {
+                        remaining -= nread,
+                        total_read += nread;
                     }
-                    while (nread > 0 && remaining > 0);
                 }
+                while (nread > 0 && remaining > 0);
 
                 (void)cache.close(fd, rv != 0 || total_read != inout_size);
                 inout_size = total_read;
@@ -461,10 +822,32 @@ protected:
         return rv;
     }
 
+    /**
+     * Back-end for uavcan.protocol.file.GetDirectoryEntryInfo.
+     * The listings are cached, see @ref DirCache. An empty path refers to the root directory.
+     * On success the method must return zero.
+     */
+    virtual uavcan::int16_t getDirectoryEntryInfo(const Path& directory_path, const uavcan::uint32_t entry_index,
+                                                  EntryType& out_type, Path& out_entry_full_path)
+    {
+        return uavcan::int16_t(dircache_.getEntry(getRootPath(), getAltRootPath(), directory_path, entry_index,
+                                                  out_type, out_entry_full_path));
+    }
+
 public:
-    BasicFileServerBackend(uavcan::INode& node) :
+    /// Default limit of open descriptors kept by the cache.
+    enum { DefaultMaxOpenFiles = 16 };
+
+    /**
+     * @param max_open_files    Maximum number of file descriptors kept open by the cache. Servers that deliver
+     *                          many different files at once, e.g. firmware images to many nodes, may need more.
+     *                          Zero disables caching.
+     */
+    BasicFileServerBackend(uavcan::INode& node, unsigned max_open_files = DefaultMaxOpenFiles) :
         fdcache_(UAVCAN_NULLPTR),
-        node_(node)
+        node_(node),
+        max_open_files_(max_open_files),
+        advise_sequential_(false)
     { }
 
     ~BasicFileServerBackend()
@@ -475,6 +858,25 @@ public:
             fdcache_ = UAVCAN_NULLPTR;
         }
     }
+
+    /**
+     * If enabled, the kernel is advised to read ahead every file when the file is opened, which suits
+     * the typical transfers that read the whole file front to back, like firmware updates.
+     * Disabled by default. Takes effect for the files opened after the call.
+     */
+    void setSequentialAccessAdvice(bool enabled) { advise_sequential_ = enabled; }
+    bool isSequentialAccessAdviceEnabled() const { return advise_sequential_; }
+
+    /**
+     * Makes the directories be read again on the next GetDirectoryEntryInfo request. Not needed normally, the
+     * listings follow the modification time of the directories.
+     */
+    void invalidateDirectoryListings() { dircache_.invalidate(); }
+
+    /**
+     * Number of times a directory has been read to serve GetDirectoryEntryInfo.
+     */
+    uavcan::uint32_t getNumDirectoryScans() const { return dircache_.getNumScans(); }
 };
 
 #if __GNUC__
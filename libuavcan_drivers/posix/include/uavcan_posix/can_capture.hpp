@@ -0,0 +1,398 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_CAN_CAPTURE_HPP_INCLUDED
+#define UAVCAN_POSIX_CAN_CAPTURE_HPP_INCLUDED
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <uavcan/driver/can.hpp>
+#include <uavcan/transport/dispatcher.hpp>
+
+namespace uavcan_posix
+{
+/**
+ * Binary format of the CAN traffic captures, see @ref CanCaptureWriter and @ref CanCaptureFile.
+ *
+ * The file starts with a 16 byte header: the magic string, the format version (uint16) and six reserved bytes.
+ * It is followed by the records, one per received frame, each consisting of a 24 byte fixed part and the payload:
+ *
+ *      uint64  monotonic timestamp, microseconds
+ *      uint64  UTC timestamp, microseconds
+ *      uint32  CAN ID with flags, as in uavcan::CanFrame
+ *      uint8   DLC
+ *      uint8   interface index
+ *      uint8   flags; bit 0 - loopback
+ *      uint8   payload length
+ *      uint8[] payload
+ *
+ * All fields are little endian, so that the captures are portable between hosts.
+ */
+struct CanCaptureFormat
+{
+    static const char* getMagic() { return "UAVCANCP"; }
+
+    enum { MagicLen = 8 };
+    enum { Version = 1 };
+    enum { HeaderSize = 16 };
+    enum { RecordHeaderSize = 24 };
+    enum { MaxRecordSize = RecordHeaderSize + uavcan::CanFrame::MaxDataLen };
+
+    enum { RecordFlagLoopback = 1 };
+
+    static void writeHeader(uavcan::uint8_t* out)
+    {
+        (void)std::memset(out, 0, HeaderSize);
+        (void)std::memcpy(out, getMagic(), MagicLen);
+        putLE(out + MagicLen, Version, 2);
+    }
+
+    static bool checkHeader(const uavcan::uint8_t* in)
+    {
+        return (std::memcmp(in, getMagic(), MagicLen) == 0) && (getLE(in + MagicLen, 2) == Version);
+    }
+
+    /**
+     * Returns the size of the record.
+     */
+    static unsigned writeRecord(const uavcan::CanRxFrame& frame, uavcan::CanIOFlags flags, uavcan::uint8_t* out)
+    {
+        const uavcan::uint8_t len = uavcan::CanFrame::dlcToDataLength(frame.dlc);
+        putLE(out, frame.ts_mono.toUSec(), 8);
+        putLE(out + 8, frame.ts_utc.toUSec(), 8);
+        putLE(out + 16, frame.id, 4);
+        out[20] = frame.dlc;
+        out[21] = frame.iface_index;
+        out[22] = uavcan::uint8_t((flags & uavcan::CanIOFlagLoopback) ? RecordFlagLoopback : 0);
+        out[23] = len;
+        (void)std::memcpy(out + RecordHeaderSize, frame.data, len);
+        return RecordHeaderSize + len;
+    }
+
+    /**
+     * Returns the size of the record, or zero if the record is truncated or malformed.
+     */
+    static unsigned readRecord(const uavcan::uint8_t* in, std::size_t available,
+                               uavcan::CanRxFrame& out_frame, uavcan::CanIOFlags& out_flags)
+    {
+        if (available < RecordHeaderSize)
+        {
+            return 0;
+        }
+        const uavcan::uint8_t len = in[23];
+        if ((len > uavcan::CanFrame::MaxDataLen) || (available < std::size_t(RecordHeaderSize + len)) ||
+            (uavcan::CanFrame::dlcToDataLength(in[20]) != len))
+        {
+            return 0;
+        }
+        out_frame = uavcan::CanRxFrame();
+        out_frame.ts_mono = uavcan::MonotonicTime::fromUSec(getLE(in, 8));
+        out_frame.ts_utc = uavcan::UtcTime::fromUSec(getLE(in + 8, 8));
+        out_frame.id = uavcan::uint32_t(getLE(in + 16, 4));
+        out_frame.dlc = in[20];
+        out_frame.iface_index = in[21];
+        out_flags = uavcan::CanIOFlags((in[22] & RecordFlagLoopback) ? uavcan::CanIOFlagLoopback : 0);
+        (void)std::memcpy(out_frame.data, in + RecordHeaderSize, len);
+        return RecordHeaderSize + len;
+    }
+
+private:
+    static void putLE(uavcan::uint8_t* out, uavcan::uint64_t value, unsigned num_bytes)
+    {
+        for (unsigned i = 0; i < num_bytes; i++)
+        {
+            out[i] = uavcan::uint8_t(value >> (i * 8U));
+        }
+    }
+
+    static uavcan::uint64_t getLE(const uavcan::uint8_t* in, unsigned num_bytes)
+    {
+        uavcan::uint64_t value = 0;
+        for (unsigned i = 0; i < num_bytes; i++)
+        {
+            value |= uavcan::uint64_t(in[i]) << (i * 8U);
+        }
+        return value;
+    }
+};
+
+/**
+ * Records all frames received by a node into a capture file. Install it with
+ * uavcan::INode::installRxFrameListener(); the listener that was installed before, if any, can be passed to the
+ * constructor and will keep receiving the frames.
+ *
+ * The records are collected in a buffer and written out when it is full, so the listener adds no system calls to
+ * the reception of most frames. The buffer is also flushed on destruction. If the file can't be written, the
+ * frames are counted as dropped.
+ */
+class CanCaptureWriter : public uavcan::IRxFrameListener, uavcan::Noncopyable
+{
+    enum { BufferSize = 65536 };
+
+    uavcan::IRxFrameListener* const next_;
+    int fd_;
+    unsigned buffer_len_;
+    unsigned num_buffered_frames_;
+    uavcan::uint64_t num_frames_;
+    uavcan::uint64_t num_dropped_frames_;
+    uavcan::uint8_t buffer_[BufferSize];
+
+    int writeAll(const uavcan::uint8_t* data, std::size_t len)
+    {
+        while (len > 0)
+        {
+            const ssize_t res = ::write(fd_, data, len);
+            if (res < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return -errno;
+            }
+            data += res;
+            len -= std::size_t(res);
+        }
+        return 0;
+    }
+
+public:
+    explicit CanCaptureWriter(uavcan::IRxFrameListener* next = UAVCAN_NULLPTR) :
+        next_(next),
+        fd_(-1),
+        buffer_len_(0),
+        num_buffered_frames_(0),
+        num_frames_(0),
+        num_dropped_frames_(0)
+    { }
+
+    ~CanCaptureWriter()
+    {
+        close();
+    }
+
+    /**
+     * Creates the capture file, replacing the existing one.
+     * Returns negative errno.
+     */
+    int open(const char* path)
+    {
+        close();
+        fd_ = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0)
+        {
+            return -errno;
+        }
+        uavcan::uint8_t header[CanCaptureFormat::HeaderSize];
+        CanCaptureFormat::writeHeader(header);
+        const int res = writeAll(header, sizeof(header));
+        if (res < 0)
+        {
+            close();
+        }
+        return res;
+    }
+
+    /**
+     * Writes out the buffered records and closes the file.
+     */
+    void close()
+    {
+        if (fd_ >= 0)
+        {
+            (void)flush();
+            (void)::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    /**
+     * Writes out the buffered records.
+     * Returns negative errno.
+     */
+    int flush()
+    {
+        if ((fd_ < 0) || (buffer_len_ == 0))
+        {
+            return 0;
+        }
+        const int res = writeAll(buffer_, buffer_len_);
+        if (res < 0)
+        {
+            num_frames_ -= num_buffered_frames_;
+            num_dropped_frames_ += num_buffered_frames_;
+        }
+        buffer_len_ = 0;
+        num_buffered_frames_ = 0;
+        return res;
+    }
+
+    virtual void handleRxFrame(const uavcan::CanRxFrame& frame, uavcan::CanIOFlags flags)
+    {
+        if (fd_ >= 0)
+        {
+            if ((buffer_len_ + CanCaptureFormat::MaxRecordSize) > BufferSize)
+            {
+                (void)flush();
+            }
+            buffer_len_ += CanCaptureFormat::writeRecord(frame, flags, buffer_ + buffer_len_);
+            num_buffered_frames_++;
+            num_frames_++;
+        }
+        else
+        {
+            num_dropped_frames_++;
+        }
+
+        if (next_ != UAVCAN_NULLPTR)
+        {
+            next_->handleRxFrame(frame, flags);
+        }
+    }
+
+    bool isOpen() const { return fd_ >= 0; }
+
+    /**
+     * Number of the frames that have been captured, including the buffered ones.
+     */
+    uavcan::uint64_t getNumFrames() const { return num_frames_; }
+
+    uavcan::uint64_t getNumDroppedFrames() const { return num_dropped_frames_; }
+};
+
+/**
+ * Read-only view of a capture file. The file is mapped into memory, so the records are parsed straight from the
+ * page cache without copying or system calls.
+ */
+class CanCaptureFile : uavcan::Noncopyable
+{
+    const uavcan::uint8_t* data_;
+    std::size_t size_;
+    std::size_t offset_;
+    uavcan::uint64_t num_records_;
+    uavcan::uint8_t num_ifaces_;
+
+public:
+    CanCaptureFile() :
+        data_(UAVCAN_NULLPTR),
+        size_(0),
+        offset_(0),
+        num_records_(0),
+        num_ifaces_(0)
+    { }
+
+    ~CanCaptureFile()
+    {
+        close();
+    }
+
+    /**
+     * Maps the file and validates all of its records.
+     * Returns negative errno; -EINVAL if the file is not a valid capture.
+     */
+    int open(const char* path)
+    {
+        close();
+
+        const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return -errno;
+        }
+        struct stat sb;
+        if (::fstat(fd, &sb) < 0)
+        {
+            const int rv = -errno;
+            (void)::close(fd);
+            return rv;
+        }
+        if (sb.st_size < CanCaptureFormat::HeaderSize)
+        {
+            (void)::close(fd);
+            return -EINVAL;
+        }
+
+        void* const data = ::mmap(UAVCAN_NULLPTR, std::size_t(sb.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        (void)::close(fd);
+        if (data == MAP_FAILED)
+        {
+            return -errno;
+        }
+        (void)::madvise(data, std::size_t(sb.st_size), MADV_SEQUENTIAL);
+        data_ = static_cast<const uavcan::uint8_t*>(data);
+        size_ = std::size_t(sb.st_size);
+
+        if (!CanCaptureFormat::checkHeader(data_))
+        {
+            close();
+            return -EINVAL;
+        }
+
+        rewind();
+        uavcan::CanRxFrame frame;
+        uavcan::CanIOFlags flags = 0;
+        while (offset_ < size_)
+        {
+            if (!next(frame, flags))
+            {
+                close();
+                return -EINVAL;
+            }
+            num_records_++;
+            num_ifaces_ = uavcan::max(num_ifaces_, uavcan::uint8_t(frame.iface_index + 1U));
+        }
+        rewind();
+        return 0;
+    }
+
+    void close()
+    {
+        if (data_ != UAVCAN_NULLPTR)
+        {
+            (void)::munmap(const_cast<uavcan::uint8_t*>(data_), size_);
+        }
+        data_ = UAVCAN_NULLPTR;
+        size_ = 0;
+        offset_ = 0;
+        num_records_ = 0;
+        num_ifaces_ = 0;
+    }
+
+    /**
+     * Reads the next record; returns false at the end of the file.
+     */
+    bool next(uavcan::CanRxFrame& out_frame, uavcan::CanIOFlags& out_flags)
+    {
+        if (data_ == UAVCAN_NULLPTR)
+        {
+            return false;
+        }
+        const unsigned len = CanCaptureFormat::readRecord(data_ + offset_, size_ - offset_, out_frame, out_flags);
+        offset_ += len;
+        return len > 0;
+    }
+
+    void rewind() { offset_ = CanCaptureFormat::HeaderSize; }
+
+    bool isOpen() const { return data_ != UAVCAN_NULLPTR; }
+
+    uavcan::uint64_t getNumRecords() const { return num_records_; }
+
+    /**
+     * Number of interfaces the frames were received from, i.e. the highest interface index plus one.
+     */
+    uavcan::uint8_t getNumIfaces() const { return num_ifaces_; }
+};
+
+}
+
+#endif // Include guard
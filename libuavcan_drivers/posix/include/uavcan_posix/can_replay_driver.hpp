@@ -0,0 +1,380 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_CAN_REPLAY_DRIVER_HPP_INCLUDED
+#define UAVCAN_POSIX_CAN_REPLAY_DRIVER_HPP_INCLUDED
+
+#include <ctime>
+#include <unistd.h>
+
+#include <uavcan/driver/can.hpp>
+#include <uavcan/driver/system_clock.hpp>
+#include <uavcan/trace.hpp>
+#include <uavcan_posix/can_capture.hpp>
+
+namespace uavcan_posix
+{
+/**
+ * CAN driver that feeds a recorded capture into a node, for profiling the stack under production load.
+ *
+ * In the real time mode the frames are delivered when their time comes, relative to the first frame of the
+ * capture; in the fast mode they are delivered as fast as the node can take them. The timestamps of the frames
+ * are rebased onto the clock of the node in both modes, so the intervals between the frames are preserved and the
+ * transfer timeouts behave as they did during the recording.
+ *
+ * The loopback frames of the capture were sent by the recording node itself and are skipped. The frames sent by
+ * the node are accepted and discarded. The number of interfaces is taken from the capture.
+ *
+ * Typical use:
+ *
+ *      CanCaptureFile capture;
+ *      capture.open("flight.cap");
+ *      CanReplayDriver driver(capture, clock, CanReplayDriver::ModeFast);
+ *      uavcan::Node<...> node(driver, clock);
+ *      ...
+ *      while (!driver.isFinished()) { node.spinOnce(); }
+ *      printf("%f frames/s\n", driver.getFramesPerSecond());
+ */
+class CanReplayDriver : public uavcan::ICanDriver, uavcan::Noncopyable
+{
+public:
+    enum Mode
+    {
+        ModeFast,
+        ModeRealTime
+    };
+
+private:
+    class Iface : public uavcan::ICanIface
+    {
+        CanReplayDriver& owner_;
+        const uavcan::uint8_t index_;
+
+    public:
+        Iface(CanReplayDriver& owner, uavcan::uint8_t index) :
+            owner_(owner),
+            index_(index)
+        { }
+
+        virtual uavcan::int16_t send(const uavcan::CanFrame&, uavcan::MonotonicTime, uavcan::CanIOFlags)
+        {
+            owner_.num_discarded_tx_frames_++;
+            return 1;
+        }
+
+        virtual uavcan::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                                        uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags)
+        {
+            if (!owner_.isNextFrameDue(index_))
+            {
+                return 0;
+            }
+            owner_.take(out_frame, out_ts_monotonic, out_ts_utc);
+            out_flags = 0;
+            return 1;
+        }
+
+        virtual uavcan::int16_t configureFilters(const uavcan::CanFilterConfig*, uavcan::uint16_t) { return 0; }
+        virtual uavcan::uint16_t getNumFilters() const { return 0; }
+        virtual uavcan::uint64_t getErrorCount() const { return 0; }
+    };
+
+    CanCaptureFile& capture_;
+    const uavcan::ISystemClock& clock_;
+    const Mode mode_;
+    Iface* ifaces_[uavcan::MaxCanIfaces];
+    uavcan::uint8_t num_ifaces_;
+
+    uavcan::CanRxFrame next_frame_;
+    bool has_next_frame_;
+    bool started_;
+    uavcan::MonotonicTime capture_start_;
+    uavcan::MonotonicTime replay_start_;
+    uavcan::int64_t utc_offset_usec_;
+
+    uavcan::uint64_t num_frames_;
+    uavcan::uint64_t num_discarded_tx_frames_;
+    uavcan::uint64_t first_frame_wall_usec_;
+    uavcan::uint64_t last_frame_wall_usec_;
+
+    static uavcan::uint64_t getWallUSec()
+    {
+        ::timespec ts;
+        (void)::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return uavcan::uint64_t(ts.tv_sec) * 1000000ULL + uavcan::uint64_t(ts.tv_nsec) / 1000ULL;
+    }
+
+    void fetch()
+    {
+        uavcan::CanIOFlags flags = 0;
+        do
+        {
+            has_next_frame_ = capture_.next(next_frame_, flags);
+        }
+        while (has_next_frame_ && ((flags & uavcan::CanIOFlagLoopback) || (next_frame_.iface_index >= num_ifaces_)));
+    }
+
+    void startIfNeeded()
+    {
+        if (!started_)
+        {
+            started_ = true;
+            fetch();
+            replay_start_ = clock_.getMonotonic();
+            capture_start_ = has_next_frame_ ? next_frame_.ts_mono : replay_start_;
+            utc_offset_usec_ = has_next_frame_ ?
+                uavcan::int64_t(clock_.getUtc().toUSec() - next_frame_.ts_utc.toUSec()) : 0;
+        }
+    }
+
+    uavcan::MonotonicTime getRebasedTimestamp() const
+    {
+        return replay_start_ + (next_frame_.ts_mono - capture_start_);
+    }
+
+    bool isNextFrameDue(uavcan::uint8_t iface_index)
+    {
+        startIfNeeded();
+        return has_next_frame_ && (next_frame_.iface_index == iface_index) &&
+               ((mode_ == ModeFast) || (clock_.getMonotonic() >= getRebasedTimestamp()));
+    }
+
+    void take(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic, uavcan::UtcTime& out_ts_utc)
+    {
+        out_frame = next_frame_;
+        out_ts_monotonic = getRebasedTimestamp();
+        out_ts_utc = uavcan::UtcTime::fromUSec(next_frame_.ts_utc.toUSec() + uavcan::uint64_t(utc_offset_usec_));
+
+        last_frame_wall_usec_ = getWallUSec();
+        if (num_frames_ == 0)
+        {
+            first_frame_wall_usec_ = last_frame_wall_usec_;
+        }
+        num_frames_++;
+        fetch();
+    }
+
+public:
+    CanReplayDriver(CanCaptureFile& capture, const uavcan::ISystemClock& clock, Mode mode) :
+        capture_(capture),
+        clock_(clock),
+        mode_(mode),
+        num_ifaces_(uavcan::min(capture.getNumIfaces(), uavcan::uint8_t(uavcan::MaxCanIfaces))),
+        has_next_frame_(false),
+        started_(false),
+        utc_offset_usec_(0),
+        num_frames_(0),
+        num_discarded_tx_frames_(0),
+        first_frame_wall_usec_(0),
+        last_frame_wall_usec_(0)
+    {
+        if (num_ifaces_ == 0)
+        {
+            num_ifaces_ = 1;
+        }
+        for (uavcan::uint8_t i = 0; i < uavcan::MaxCanIfaces; i++)
+        {
+            ifaces_[i] = (i < num_ifaces_) ? new Iface(*this, i) : UAVCAN_NULLPTR;
+        }
+        capture_.rewind();
+    }
+
+    virtual ~CanReplayDriver()
+    {
+        for (uavcan::uint8_t i = 0; i < uavcan::MaxCanIfaces; i++)
+        {
+            delete ifaces_[i];
+        }
+    }
+
+    virtual uavcan::ICanIface* getIface(uavcan::uint8_t iface_index)
+    {
+        return (iface_index < num_ifaces_) ? ifaces_[iface_index] : UAVCAN_NULLPTR;
+    }
+
+    virtual const uavcan::ICanIface* getIface(uavcan::uint8_t iface_index) const
+    {
+        return (iface_index < num_ifaces_) ? ifaces_[iface_index] : UAVCAN_NULLPTR;
+    }
+
+    virtual uavcan::uint8_t getNumIfaces() const { return num_ifaces_; }
+
+    virtual uavcan::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                                   const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                                   uavcan::MonotonicTime blocking_deadline)
+    {
+        startIfNeeded();
+
+        // In the real time mode, wait for the next frame or for the deadline, whichever comes first
+        const uavcan::uint8_t all_ifaces = uavcan::uint8_t((1U << num_ifaces_) - 1U);
+        if ((mode_ == ModeRealTime) && ((inout_masks.write & all_ifaces) == 0))
+        {
+            const uavcan::MonotonicTime now = clock_.getMonotonic();
+            uavcan::MonotonicTime wake_up = blocking_deadline;
+            if (has_next_frame_ && (getRebasedTimestamp() < wake_up))
+            {
+                wake_up = getRebasedTimestamp();
+            }
+            if (wake_up > now)
+            {
+                (void)::usleep(useconds_t((wake_up - now).toUSec()));
+            }
+        }
+
+        uavcan::CanSelectMasks out_masks;
+        out_masks.write = uavcan::uint8_t(inout_masks.write & all_ifaces);      // Always ready, frames are discarded
+        if (has_next_frame_ && isNextFrameDue(next_frame_.iface_index))
+        {
+            out_masks.read = uavcan::uint8_t(inout_masks.read & (1U << next_frame_.iface_index));
+        }
+        inout_masks = out_masks;
+        return uavcan::int16_t(((out_masks.read | out_masks.write) != 0) ? 1 : 0);
+    }
+
+    /**
+     * True when all frames of the capture have been delivered.
+     */
+    bool isFinished() const { return started_ && !has_next_frame_; }
+
+    uavcan::uint64_t getNumFrames() const { return num_frames_; }
+
+    uavcan::uint64_t getNumDiscardedTxFrames() const { return num_discarded_tx_frames_; }
+
+    /**
+     * Number of frames the node has taken per second of wall time, from the first frame to the last one.
+     * In the fast mode, this is the throughput of the node's reception path.
+     */
+    double getFramesPerSecond() const
+    {
+        const uavcan::uint64_t elapsed = last_frame_wall_usec_ - first_frame_wall_usec_;
+        return (elapsed > 0) ? (double(num_frames_ - 1U) * 1e6 / double(elapsed)) : 0.0;
+    }
+};
+
+/**
+ * Trace sink that measures the CPU time spent in the callbacks of every subscribed data type, and the number of
+ * frames handled by the dispatcher. Requires the trace points TraceEventRxFrame, TraceEventSubscriberDelivery and
+ * TraceEventSubscriberDone to be enabled (see UAVCAN_TRACE_POINTS); install it with uavcan::setTraceSink().
+ *
+ * The time is measured with CLOCK_THREAD_CPUTIME_ID of the thread that spins the node. The sink is meant to be
+ * used with one node at a time, e.g. with @ref CanReplayDriver.
+ */
+class ReplayProfiler : public uavcan::ITraceSink, uavcan::Noncopyable
+{
+public:
+    enum { MaxDataTypes = 64 };
+
+    struct Entry
+    {
+        uavcan::uint16_t data_type_id;
+        uavcan::uint64_t num_calls;
+        uavcan::uint64_t cpu_nsec;
+    };
+
+private:
+    enum { MaxNesting = 4 };
+
+    struct Frame
+    {
+        unsigned entry_index;
+        uavcan::uint64_t start_nsec;
+    };
+
+    Entry entries_[MaxDataTypes];
+    unsigned num_entries_;
+    Frame stack_[MaxNesting];
+    unsigned depth_;
+    uavcan::uint64_t num_rx_frames_;
+
+    static uavcan::uint64_t getThreadCpuNSec()
+    {
+        ::timespec ts;
+        (void)::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return uavcan::uint64_t(ts.tv_sec) * 1000000000ULL + uavcan::uint64_t(ts.tv_nsec);
+    }
+
+    unsigned findOrAdd(uavcan::uint16_t data_type_id)
+    {
+        for (unsigned i = 0; i < num_entries_; i++)
+        {
+            if (entries_[i].data_type_id == data_type_id)
+            {
+                return i;
+            }
+        }
+        if (num_entries_ >= MaxDataTypes)
+        {
+            return MaxDataTypes;
+        }
+        entries_[num_entries_].data_type_id = data_type_id;
+        entries_[num_entries_].num_calls = 0;
+        entries_[num_entries_].cpu_nsec = 0;
+        return num_entries_++;
+    }
+
+public:
+    ReplayProfiler()
+    {
+        reset();
+    }
+
+    virtual void handleTraceEvent(uavcan::TraceEventID event, uavcan::uint32_t arg0, uavcan::uint16_t,
+                                  uavcan::uint8_t)
+    {
+        if (event == uavcan::TraceEventRxFrame)
+        {
+            num_rx_frames_++;
+        }
+        else if (event == uavcan::TraceEventSubscriberDelivery)
+        {
+            if (depth_ < MaxNesting)
+            {
+                stack_[depth_].entry_index = findOrAdd(uavcan::uint16_t(arg0));
+                stack_[depth_].start_nsec = getThreadCpuNSec();
+            }
+            depth_++;
+        }
+        else if ((event == uavcan::TraceEventSubscriberDone) && (depth_ > 0))
+        {
+            depth_--;
+            if ((depth_ < MaxNesting) && (stack_[depth_].entry_index < MaxDataTypes))
+            {
+                Entry& e = entries_[stack_[depth_].entry_index];
+                e.num_calls++;
+                e.cpu_nsec += getThreadCpuNSec() - stack_[depth_].start_nsec;
+            }
+        }
+        else
+        {
+            ;
+        }
+    }
+
+    void reset()
+    {
+        num_entries_ = 0;
+        depth_ = 0;
+        num_rx_frames_ = 0;
+    }
+
+    /**
+     * Number of frames handled by the dispatcher.
+     */
+    uavcan::uint64_t getNumRxFrames() const { return num_rx_frames_; }
+
+    unsigned getNumEntries() const { return num_entries_; }
+
+    /**
+     * Entries are ordered by the first delivery of their data type. The time of a nested callback is included in
+     * the time of the outer one.
+     */
+    const Entry& getEntry(unsigned index) const { return entries_[index]; }
+};
+
+}
+
+#endif // Include guard
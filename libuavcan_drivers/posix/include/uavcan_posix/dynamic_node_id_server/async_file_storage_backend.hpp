@@ -0,0 +1,270 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_DYNAMIC_NODE_ID_SERVER_ASYNC_FILE_STORAGE_BACKEND_HPP_INCLUDED
+#define UAVCAN_POSIX_DYNAMIC_NODE_ID_SERVER_ASYNC_FILE_STORAGE_BACKEND_HPP_INCLUDED
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <uavcan/node/timer.hpp>
+#include <uavcan_posix/dynamic_node_id_server/file_journal_storage_backend.hpp>
+
+namespace uavcan_posix
+{
+namespace dynamic_node_id_server
+{
+/**
+ * File storage backend that writes the key/value pairs from a background thread, so that set() doesn't wait
+ * for the flash. The pairs are stored in the same format as by @ref FileStorageBackend.
+ *
+ * set() puts the pair into a write-behind queue and returns; get() returns the latest queued value of the key,
+ * if any, so the values read back are always the latest ones. The background thread writes and syncs the queued
+ * pairs one by one, in the order of the set() calls, so after a power loss the storage holds the values as of
+ * some set() call, never a mix of older and newer ones.
+ *
+ * The persistent state of Raft (the log, the current term and the vote) is kept in a journal, like with
+ * @ref JournaledFileStorageBackend, because Raft must not respond before the state is on stable storage.
+ * Before writing to the journal, the queue is flushed, so the durability order of all updates is preserved.
+ *
+ * The completion of the background writes is reported from a timer of the node; refer to
+ * @ref handleWritesDurable(). Everything except the background writes takes place in the node thread.
+ */
+class AsyncFileStorageBackend : public FileStorageBackend
+                              , protected uavcan::TimerBase
+{
+    enum { QueueCapacity = 64 };
+
+    enum { CompletionPollPeriodMs = 10 };
+
+    struct Pair
+    {
+        String key;
+        String value;
+    };
+
+    /**
+     * Flushes the key/value queue before every journal write.
+     */
+    class BarrierJournal : public FileJournalStorageBackend
+    {
+        AsyncFileStorageBackend& owner_;
+
+    public:
+        explicit BarrierJournal(AsyncFileStorageBackend& owner) : owner_(owner) { }
+
+        virtual int append(const uint8_t* data, uint8_t length)
+        {
+            owner_.flush();
+            return FileJournalStorageBackend::append(data, length);
+        }
+
+        virtual int sync()
+        {
+            owner_.flush();
+            return FileJournalStorageBackend::sync();
+        }
+    };
+
+    BarrierJournal journal_;
+    Pair queue_[QueueCapacity];
+    unsigned queue_head_;
+    unsigned queue_length_;
+    uavcan::uint32_t num_queued_;           ///< Total number of pairs ever queued
+    uavcan::uint32_t num_durable_;          ///< Total number of pairs written and synced
+    uavcan::uint32_t num_reported_;         ///< Last value passed to handleWritesDurable()
+    bool stop_;
+    mutable std::mutex mutex_;
+    std::condition_variable queue_cv_;      ///< Signaled when a pair is queued
+    std::condition_variable durable_cv_;    ///< Signaled when a pair is written
+    std::thread thread_;
+
+    void writerThread()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            queue_cv_.wait(lock, [this]() { return stop_ || (queue_length_ > 0); });
+            if (queue_length_ == 0)
+            {
+                break;                      // Stopping, nothing left to write
+            }
+
+            // The pair stays in the queue until written, so get() keeps returning it meanwhile
+            const Pair pair = queue_[queue_head_];
+            lock.unlock();
+            FileStorageBackend::set(pair.key, pair.value);
+            lock.lock();
+
+            queue_head_ = (queue_head_ + 1U) % QueueCapacity;
+            queue_length_--;
+            num_durable_++;
+            durable_cv_.notify_all();
+        }
+    }
+
+    void stopWriter()
+    {
+        if (thread_.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            queue_cv_.notify_one();
+            thread_.join();
+        }
+    }
+
+    virtual void handleTimerEvent(const uavcan::TimerEvent&)
+    {
+        uavcan::uint32_t num_durable = 0;
+        bool idle = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            num_durable = num_durable_;
+            idle = queue_length_ == 0;
+        }
+        if (idle)
+        {
+            stop();
+        }
+        if (num_durable != num_reported_)
+        {
+            num_reported_ = num_durable;
+            handleWritesDurable(num_durable);
+        }
+    }
+
+protected:
+    virtual String get(const String& key) const
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (unsigned i = queue_length_; i > 0; i--)
+            {
+                const Pair& pair = queue_[(queue_head_ + i - 1U) % QueueCapacity];
+                if (pair.key == key)
+                {
+                    return pair.value;
+                }
+            }
+        }
+        return FileStorageBackend::get(key);
+    }
+
+    virtual void set(const String& key, const String& value)
+    {
+        if (!thread_.joinable())
+        {
+            FileStorageBackend::set(key, value);
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            durable_cv_.wait(lock, [this]() { return queue_length_ < QueueCapacity; });
+            Pair& pair = queue_[(queue_head_ + queue_length_) % QueueCapacity];
+            pair.key = key;
+            pair.value = value;
+            queue_length_++;
+            num_queued_++;
+        }
+        queue_cv_.notify_one();
+
+        if (!isRunning())
+        {
+            startPeriodic(uavcan::MonotonicDuration::fromMSec(CompletionPollPeriodMs));
+        }
+    }
+
+    /**
+     * Called from the node thread when more pairs have been written and synced to the storage.
+     * The argument is the total number of pairs on stable storage, which can be compared against the value
+     * returned by @ref getNumQueuedWrites() after the set() call of interest.
+     * Does nothing by default.
+     */
+    virtual void handleWritesDurable(uavcan::uint32_t num_durable_writes) { (void)num_durable_writes; }
+
+public:
+    explicit AsyncFileStorageBackend(uavcan::INode& node)
+        : uavcan::TimerBase(node)
+        , journal_(*this)
+        , queue_head_(0)
+        , queue_length_(0)
+        , num_queued_(0)
+        , num_durable_(0)
+        , num_reported_(0)
+        , stop_(false)
+    { }
+
+    virtual ~AsyncFileStorageBackend()
+    {
+        stopWriter();                       // Writes the remaining pairs
+    }
+
+    virtual uavcan::dynamic_node_id_server::IJournalStorageBackend* getJournal() { return &journal_; }
+
+    /**
+     * Same as @ref JournaledFileStorageBackend::init(), plus the start of the background thread.
+     * Returns negative error code.
+     */
+    int init(const char* path)
+    {
+        stopWriter();
+        stop_ = false;
+
+        int rv = FileStorageBackend::init(path);
+        if (rv < 0)
+        {
+            return rv;
+        }
+
+        typedef uavcan::MakeString<256>::Type JournalPathString;
+        JournalPathString journal_path = path;
+        if (journal_path.back() != '/')
+        {
+            journal_path.push_back('/');
+        }
+        journal_path += "log_journal";
+        rv = journal_.init(journal_path.c_str());
+        if (rv < 0)
+        {
+            return rv;
+        }
+
+        thread_ = std::thread(&AsyncFileStorageBackend::writerThread, this);
+        return 0;
+    }
+
+    /**
+     * Blocks until all queued pairs are on stable storage.
+     */
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        durable_cv_.wait(lock, [this]() { return queue_length_ == 0; });
+    }
+
+    /**
+     * Total number of pairs queued by set() and written to stable storage, respectively.
+     */
+    uavcan::uint32_t getNumQueuedWrites() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return num_queued_;
+    }
+    uavcan::uint32_t getNumDurableWrites() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return num_durable_;
+    }
+};
+}
+}
+
+#endif // Include guard
@@ -11,9 +11,14 @@
 
 #include <uavcan/protocol/dynamic_node_id_server/event.hpp>
 #include <cstdio>
+#include <cstring>
 #include <time.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 namespace uavcan_posix
 {
@@ -94,6 +99,172 @@ public:
         return rv;
     }
 };
+
+/**
+ * Same as @ref FileEventTracer, except that the file is kept open and written from a background thread.
+ * The events are formatted into a memory buffer, which is handed over to the background thread when it's half
+ * full or every @ref FlushPeriodMs, whichever comes first; thus the Raft servers never wait for the file system.
+ * If the buffer gets full before the background thread empties it, the new events are dropped and counted.
+ * The events can be reported from any thread.
+ */
+class BufferedFileEventTracer : public uavcan::dynamic_node_id_server::IEventTracer
+                              , uavcan::Noncopyable
+{
+public:
+    enum { FlushPeriodMs = 100 };
+
+private:
+    enum { BufferSize = 4096 };
+
+    enum { FilePermissions = 438 };     ///< 0o666
+
+    int fd_;
+    char buffers_[2][BufferSize];
+    unsigned active_buffer_;            ///< Index of the buffer the events are formatted into
+    unsigned active_size_;
+    uavcan::uint32_t num_dropped_;
+    bool stop_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+
+    void writerThread()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            (void)cv_.wait_for(lock, std::chrono::milliseconds(FlushPeriodMs),
+                               [this]() { return stop_ || (active_size_ >= (BufferSize / 2)); });
+            const bool stopping = stop_;
+
+            // The other buffer is not used until the next swap, so it can be written without the lock
+            const char* const data = buffers_[active_buffer_];
+            const unsigned size = active_size_;
+            active_buffer_ ^= 1U;
+            active_size_ = 0;
+            lock.unlock();
+
+            unsigned total_written = 0;
+            while (total_written < size)
+            {
+                const ssize_t written = ::write(fd_, &data[total_written], size - total_written);
+                if (written <= 0)
+                {
+                    break;
+                }
+                total_written += unsigned(written);
+            }
+
+            lock.lock();
+            if (stopping)
+            {
+                break;
+            }
+        }
+    }
+
+    void stopWriter()
+    {
+        if (thread_.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            cv_.notify_one();
+            thread_.join();
+        }
+        if (fd_ >= 0)
+        {
+            (void)::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+protected:
+    virtual void onEvent(uavcan::dynamic_node_id_server::TraceCode code, uavcan::int64_t argument)
+    {
+        using namespace std;
+
+        timespec ts = timespec();               // If clock_gettime() fails, zero time will be used
+        (void)clock_gettime(CLOCK_REALTIME, &ts);
+
+        const int FormatBufferLength = 63;
+        char line[FormatBufferLength + 1];
+        const int length = snprintf(line, FormatBufferLength, "%ld.%06ld\t%d\t%lld\n",
+                                    static_cast<long>(ts.tv_sec), static_cast<long>(ts.tv_nsec / 1000L),
+                                    static_cast<int>(code), static_cast<long long>(argument));
+        if (length <= 0)
+        {
+            return;
+        }
+        const unsigned size = min(unsigned(length), unsigned(FormatBufferLength - 1));
+
+        bool wake_writer = false;
+        {
+            lock_guard<mutex> lock(mutex_);
+            if (!thread_.joinable() || ((active_size_ + size) > BufferSize))
+            {
+                num_dropped_++;
+                return;
+            }
+            (void)memcpy(&buffers_[active_buffer_][active_size_], line, size);
+            active_size_ += size;
+            wake_writer = active_size_ >= (BufferSize / 2);
+        }
+        if (wake_writer)
+        {
+            cv_.notify_one();
+        }
+    }
+
+public:
+    BufferedFileEventTracer()
+        : fd_(-1)
+        , active_buffer_(0)
+        , active_size_(0)
+        , num_dropped_(0)
+        , stop_(false)
+    { }
+
+    virtual ~BufferedFileEventTracer()
+    {
+        stopWriter();                           // Writes the remaining events
+    }
+
+    /**
+     * Truncates or creates the trace file and starts the background thread.
+     * Returns negative error code.
+     */
+    int init(const char* path)
+    {
+        stopWriter();
+
+        if ((path == UAVCAN_NULLPTR) || (path[0] == '\0'))
+        {
+            return -uavcan::ErrInvalidParam;
+        }
+        fd_ = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, FilePermissions);
+        if (fd_ < 0)
+        {
+            return -uavcan::ErrFailure;
+        }
+
+        active_size_ = 0;
+        stop_ = false;
+        thread_ = std::thread(&BufferedFileEventTracer::writerThread, this);
+        return 0;
+    }
+
+    /**
+     * Number of events that didn't fit into the buffer.
+     */
+    uavcan::uint32_t getNumDroppedEvents() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return num_dropped_;
+    }
+};
 }
 }
 
@@ -0,0 +1,273 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*              David Sidrane <david_s5@usa.net>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_DYNAMIC_NODE_ID_SERVER_FILE_JOURNAL_STORAGE_BACKEND_HPP_INCLUDED
+#define UAVCAN_POSIX_DYNAMIC_NODE_ID_SERVER_FILE_JOURNAL_STORAGE_BACKEND_HPP_INCLUDED
+
+#include <sys/types.h>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <uavcan/transport/crc.hpp>
+#include <uavcan/protocol/dynamic_node_id_server/journal_storage_backend.hpp>
+#include <uavcan_posix/dynamic_node_id_server/file_storage_backend.hpp>
+
+namespace uavcan_posix
+{
+namespace dynamic_node_id_server
+{
+/**
+ * This class implements a POSIX compliant IJournalStorageBackend interface on top of a single file.
+ * Every record is stored as its length byte, the data, and CRC-16-CCITT of both.
+ * A record is written with one write and one fsync; the records appended without sync are buffered and then
+ * written together, also with one write and one fsync. Incomplete or corrupted records at the end of the file,
+ * that are left by an interrupted write, are truncated away on initialization.
+ */
+class FileJournalStorageBackend : public uavcan::dynamic_node_id_server::IJournalStorageBackend
+                                , uavcan::Noncopyable
+{
+    enum { FilePermissions = 438 };     ///< 0o666
+
+    enum { RecordOverhead = 3 };        ///< Length byte and CRC
+
+    enum { MaxFrameLength = MaxRecordLength + RecordOverhead };
+
+    enum { PendingBufferSize = MaxFrameLength * 8 };
+
+    int fd_;
+    off_t end_offset_;                  ///< End of the last valid record, not including the pending ones
+    unsigned pending_size_;
+    uint8_t pending_[PendingBufferSize];
+    uint32_t cursor_index_;             ///< Record that starts at the cursor offset
+    off_t cursor_offset_;
+
+    static uint16_t computeCrc(const uint8_t* frame, unsigned length)
+    {
+        uavcan::TransferCRC crc;
+        crc.add(frame, length);
+        return crc.get();
+    }
+
+    int writePending()
+    {
+        if (pending_size_ == 0)
+        {
+            return 0;
+        }
+        const ssize_t size = ssize_t(pending_size_);
+        pending_size_ = 0;
+        if (::pwrite(fd_, pending_, size_t(size), end_offset_) != size)
+        {
+            (void)::ftruncate(fd_, end_offset_);
+            return -uavcan::ErrFailure;
+        }
+        end_offset_ += size;
+        return 0;
+    }
+
+    /**
+     * Returns the length of the record; zero if there's no valid record at this offset.
+     */
+    int readRecordAt(off_t offset, uint8_t* out_data) const
+    {
+        uint8_t frame[MaxFrameLength];
+        const ssize_t nread = ::pread(fd_, frame, sizeof(frame), offset);
+        if (nread < 0)
+        {
+            return -uavcan::ErrFailure;
+        }
+        if (nread < RecordOverhead)
+        {
+            return 0;
+        }
+
+        const unsigned length = frame[0];
+        if ((length == 0) || (length > MaxRecordLength) || (nread < ssize_t(length + RecordOverhead)))
+        {
+            return 0;
+        }
+        const uint16_t crc = uint16_t(frame[length + 1] | (frame[length + 2] << 8));
+        if (crc != computeCrc(frame, length + 1))
+        {
+            return 0;
+        }
+
+        (void)std::memcpy(out_data, &frame[1], length);
+        return int(length);
+    }
+
+public:
+    FileJournalStorageBackend()
+        : fd_(-1)
+        , end_offset_(0)
+        , pending_size_(0)
+        , cursor_index_(0)
+        , cursor_offset_(0)
+    { }
+
+    virtual ~FileJournalStorageBackend()
+    {
+        if (fd_ >= 0)
+        {
+            (void)::close(fd_);
+        }
+    }
+
+    /**
+     * Opens or creates the journal file, and discards the incomplete records at its end, if any.
+     * Returns negative error code.
+     */
+    int init(const char* path)
+    {
+        if (fd_ >= 0)
+        {
+            (void)::close(fd_);
+        }
+        end_offset_ = 0;
+        pending_size_ = 0;
+        cursor_index_ = 0;
+        cursor_offset_ = 0;
+
+        fd_ = ::open(path, O_RDWR | O_CREAT, FilePermissions);
+        if (fd_ < 0)
+        {
+            return -uavcan::ErrFailure;
+        }
+
+        uint8_t data[MaxRecordLength];
+        int length = 0;
+        while ((length = readRecordAt(end_offset_, data)) > 0)
+        {
+            end_offset_ += length + RecordOverhead;
+        }
+        if (length < 0)
+        {
+            return length;
+        }
+
+        return (::ftruncate(fd_, end_offset_) == 0) ? 0 : -uavcan::ErrFailure;
+    }
+
+    virtual int append(const uint8_t* data, uint8_t length)
+    {
+        const int res = appendWithoutSync(data, length);
+        return (res < 0) ? res : sync();
+    }
+
+    virtual int appendWithoutSync(const uint8_t* data, uint8_t length)
+    {
+        if ((fd_ < 0) || (data == UAVCAN_NULLPTR) || (length == 0) || (length > MaxRecordLength))
+        {
+            return -uavcan::ErrInvalidParam;
+        }
+
+        if ((pending_size_ + length + RecordOverhead) > PendingBufferSize)
+        {
+            const int res = writePending();
+            if (res < 0)
+            {
+                return res;
+            }
+        }
+
+        uint8_t* const frame = &pending_[pending_size_];
+        frame[0] = length;
+        (void)std::memcpy(&frame[1], data, length);
+        const uint16_t crc = computeCrc(frame, length + 1U);
+        frame[length + 1] = uint8_t(crc);
+        frame[length + 2] = uint8_t(crc >> 8);
+        pending_size_ += length + RecordOverhead;
+        return 0;
+    }
+
+    virtual int sync()
+    {
+        if (fd_ < 0)
+        {
+            return -uavcan::ErrNotInited;
+        }
+        const int res = writePending();
+        if (res < 0)
+        {
+            return res;
+        }
+        return (::fsync(fd_) == 0) ? 0 : -uavcan::ErrFailure;
+    }
+
+    virtual int read(uint32_t index, uint8_t (&out_data)[MaxRecordLength])
+    {
+        if (fd_ < 0)
+        {
+            return -uavcan::ErrNotInited;
+        }
+        const int res = writePending();
+        if (res < 0)
+        {
+            return res;
+        }
+
+        if (index < cursor_index_)
+        {
+            cursor_index_ = 0;
+            cursor_offset_ = 0;
+        }
+        while (true)
+        {
+            if (cursor_offset_ >= end_offset_)
+            {
+                return 0;
+            }
+            const int length = readRecordAt(cursor_offset_, out_data);
+            if ((length <= 0) || (cursor_index_ == index))
+            {
+                return length;
+            }
+            cursor_offset_ += length + RecordOverhead;
+            cursor_index_++;
+        }
+    }
+};
+
+/**
+ * File storage backend that keeps the persistent state of Raft in a journal file in the same directory, named
+ * "log_journal".
+ * Refer to @ref uavcan::dynamic_node_id_server::IStorageBackend::getJournal().
+ */
+class JournaledFileStorageBackend : public FileStorageBackend
+{
+    FileJournalStorageBackend journal_;
+
+public:
+    virtual uavcan::dynamic_node_id_server::IJournalStorageBackend* getJournal() { return &journal_; }
+
+    /**
+     * Same as @ref FileStorageBackend::init(), plus initialization of the journal.
+     */
+    int init(const char* path)
+    {
+        int rv = FileStorageBackend::init(path);
+        if (rv < 0)
+        {
+            return rv;
+        }
+
+        typedef uavcan::MakeString<256>::Type JournalPathString;
+        JournalPathString journal_path = path;
+        if (journal_path.back() != '/')
+        {
+            journal_path.push_back('/');
+        }
+        journal_path += "log_journal";
+        return journal_.init(journal_path.c_str());
+    }
+};
+}
+}
+
+#endif // Include guard
@@ -0,0 +1,191 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_FILE_NODE_INFO_CACHE_HPP_INCLUDED
+#define UAVCAN_POSIX_FILE_NODE_INFO_CACHE_HPP_INCLUDED
+
+#include <sys/stat.h>
+#include <cstdio>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <uavcan/protocol/node_info_retriever.hpp>
+#include <uavcan/helpers/binary_record.hpp>
+
+namespace uavcan_posix
+{
+/**
+ * Keeps the GetNodeInfo responses in a directory, one file per node ID, for @ref uavcan::NodeInfoRetriever.
+ *
+ * A file contains the UTC time of retrieval in microseconds (8 bytes, little endian), followed by the response as
+ * a binary record (see @ref uavcan::encodeBinaryRecord()), whose schema ID makes the files of an incompatible
+ * definition of GetNodeInfo unreadable rather than wrong. The files are replaced atomically via rename(), but not
+ * synced; an entry lost to a power failure only costs one request.
+ *
+ * Typical use:
+ *
+ *      FileNodeInfoCache cache;
+ *      cache.init("/var/lib/uavcan/node_info");
+ *      retriever.setCache(&cache);
+ */
+class FileNodeInfoCache : public uavcan::INodeInfoCache
+{
+    enum { MaxPathLength = 128 };
+
+    enum { FilePermissions = 438 };     ///< 0o666
+
+    enum { TimestampSize = 8 };
+
+    enum
+    {
+        BufferSize = TimestampSize + uavcan::BinaryRecordHeader::Size +
+                     (uavcan::protocol::GetNodeInfo::Response::MaxBitLen + 7) / 8
+    };
+
+    typedef uavcan::MakeString<MaxPathLength>::Type PathString;
+
+    PathString base_path_;
+
+    static uavcan::uint64_t getSchemaID() { return uavcan::protocol::GetNodeInfo::getDataTypeSignature().get(); }
+
+    PathString makePath(uavcan::NodeID node_id, const char* suffix) const
+    {
+        char name[16];
+        (void)std::snprintf(name, sizeof(name), "%u%s", unsigned(node_id.get()), suffix);
+        PathString path = base_path_.c_str();
+        path += name;
+        return path;
+    }
+
+    static bool writeAll(int fd, const uavcan::uint8_t* data, unsigned size)
+    {
+        unsigned total_written = 0;
+        while (total_written < size)
+        {
+            const ssize_t written = ::write(fd, data + total_written, size - total_written);
+            if (written <= 0)
+            {
+                return false;
+            }
+            total_written += unsigned(written);
+        }
+        return true;
+    }
+
+public:
+    /**
+     * Creates the directory if it doesn't exist.
+     * Returns negative error code.
+     */
+    int init(const PathString& path)
+    {
+        if (path.empty() || ((path.size() + 8U) > MaxPathLength))    // "127.tmp" must fit
+        {
+            return -uavcan::ErrInvalidParam;
+        }
+
+        base_path_ = path.c_str();
+        if (base_path_.back() == '/')
+        {
+            base_path_.pop_back();
+        }
+
+        struct stat sb;
+        if ((::stat(base_path_.c_str(), &sb) != 0) || !S_ISDIR(sb.st_mode))
+        {
+            if (::mkdir(base_path_.c_str(), S_IRWXU | S_IRWXG | S_IRWXO) != 0)
+            {
+                return -errno;
+            }
+        }
+        base_path_.push_back('/');
+        return 0;
+    }
+
+    virtual bool load(uavcan::NodeID node_id, uavcan::protocol::GetNodeInfo::Response& out_node_info,
+                      uavcan::UtcTime& out_retrieval_time) override
+    {
+        const int fd = ::open(makePath(node_id, "").c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        uavcan::uint8_t buffer[BufferSize];
+        unsigned size = 0;
+        ssize_t nread = 0;
+        do
+        {
+            nread = ::read(fd, buffer + size, sizeof(buffer) - size);
+            if (nread > 0)
+            {
+                size += unsigned(nread);
+            }
+        }
+        while ((nread > 0) && (size < sizeof(buffer)));
+        (void)::close(fd);
+
+        if (size < unsigned(TimestampSize))
+        {
+            return false;
+        }
+        uavcan::uint64_t usec = 0;
+        for (unsigned i = 0; i < TimestampSize; i++)
+        {
+            usec |= uavcan::uint64_t(buffer[i]) << (i * 8U);
+        }
+
+        if (uavcan::decodeBinaryRecord(buffer + TimestampSize, size - TimestampSize, getSchemaID(),
+                                       out_node_info) <= 0)
+        {
+            UAVCAN_TRACE("FileNodeInfoCache", "Entry of node %d is corrupted", int(node_id.get()));
+            return false;
+        }
+        out_retrieval_time = uavcan::UtcTime::fromUSec(usec);
+        return true;
+    }
+
+    virtual void store(uavcan::NodeID node_id, const uavcan::protocol::GetNodeInfo::Response& node_info,
+                       uavcan::UtcTime retrieval_time) override
+    {
+        uavcan::uint8_t buffer[BufferSize];
+        for (unsigned i = 0; i < TimestampSize; i++)
+        {
+            buffer[i] = uavcan::uint8_t((retrieval_time.toUSec() >> (i * 8U)) & 0xFFU);
+        }
+        const int len = uavcan::encodeBinaryRecord(node_info, getSchemaID(), buffer + TimestampSize,
+                                                   sizeof(buffer) - TimestampSize);
+        if (len <= 0)
+        {
+            return;
+        }
+
+        const PathString tmp_path = makePath(node_id, ".tmp");
+        const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, FilePermissions);
+        if (fd < 0)
+        {
+            return;
+        }
+        const bool written = writeAll(fd, buffer, unsigned(TimestampSize) + unsigned(len));
+        (void)::close(fd);
+
+        if (!written || (::rename(tmp_path.c_str(), makePath(node_id, "").c_str()) != 0))
+        {
+            (void)::unlink(tmp_path.c_str());
+        }
+    }
+
+    virtual void remove(uavcan::NodeID node_id) override
+    {
+        (void)::unlink(makePath(node_id, "").c_str());
+    }
+};
+
+}
+
+#endif // Include guard
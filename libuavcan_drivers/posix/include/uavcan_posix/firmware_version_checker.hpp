@@ -14,7 +14,10 @@
 #include <cstring>
 #include <fcntl.h>
 #include <cerrno>
+#include <ctime>
 #include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <uavcan/protocol/firmware_update_trigger.hpp>
 
@@ -30,9 +33,42 @@ namespace uavcan_posix
 /**
  * Firmware version checking logic.
  * Refer to @ref FirmwareUpdateTrigger for details.
+ *
+ * The descriptors of the firmware images are kept in a catalogue, so that the images are not read and scanned
+ * again for every node that reports the same board. A catalogue entry records the identity of the image files
+ * (device, inode, size and modification time) it was made from; it is checked against the file system at most
+ * once per @ref CatalogueRevalidationSeconds, and the image is scanned again only if the files have changed.
+ *
+ * Optionally, every image that has been scanned is copied into an archive directory under the name made of its
+ * image CRC, see @ref setImageArchivePath(). The images are kept there after they have been replaced, so that
+ * @ref uavcan::DeltaFileServerBackend can serve the nodes that still run them a patch instead of the full image.
  */
 class FirmwareVersionChecker : public uavcan::IFirmwareVersionChecker
 {
+public:
+    struct AppDescriptor
+    {
+        uavcan::uint8_t signature[sizeof(uavcan::uint64_t)];
+        union{
+            uavcan::uint64_t image_crc;
+            uavcan::uint32_t crc32_block1;
+            uavcan::uint32_t crc32_block2;
+        };
+        uavcan::uint32_t image_size;
+        uavcan::uint32_t vcs_commit;
+        uavcan::uint8_t  major_version;
+        uavcan::uint8_t  minor_version;
+        uavcan::uint16_t board_id;
+        uavcan::uint8_t  reserved[ 3 + 3 + 2];
+    };
+
+    /// Number of boards whose images are kept in the catalogue; the least recently used entry is replaced first.
+    enum { MaxCatalogueEntries = 16 };
+
+    /// Interval in Seconds between the checks of a catalogue entry against the file system.
+    enum { CatalogueRevalidationSeconds = 1 };
+
+private:
     enum { FilePermissions = 438 }; ///< 0o666
 
     enum { MaxBasePathLength = 128 };
@@ -54,6 +90,7 @@ class FirmwareVersionChecker : public uavcan::IFirmwareVersionChecker
 
     BasePathString base_path_;
     BasePathString alt_base_path_;
+    BasePathString archive_path_;
 
     static void addSlash(BasePathString& path)
     {
@@ -71,6 +108,200 @@ class FirmwareVersionChecker : public uavcan::IFirmwareVersionChecker
         }
     }
 
+    /**
+     * Identity of an image file; all zeros if the file doesn't exist.
+     */
+    struct FileStamp
+    {
+        dev_t dev;
+        ino_t ino;
+        off_t size;
+        std::time_t mtime;
+
+        FileStamp() : dev(0), ino(0), size(0), mtime(0) { }
+
+        explicit FileStamp(const char* path) : dev(0), ino(0), size(0), mtime(0)
+        {
+            struct stat sb;
+            if (::stat(path, &sb) == 0)
+            {
+                dev = sb.st_dev;
+                ino = sb.st_ino;
+                size = sb.st_size;
+                mtime = sb.st_mtime;
+            }
+        }
+
+        bool operator==(const FileStamp& rhs) const
+        {
+            return dev == rhs.dev && ino == rhs.ino && size == rhs.size && mtime == rhs.mtime;
+        }
+        bool operator!=(const FileStamp& rhs) const { return !operator==(rhs); }
+    };
+
+    struct CatalogueEntry
+    {
+        FileStamp primary;
+        FileStamp alt;
+        std::time_t checked_at;
+        std::time_t used_at;
+        uavcan::uint16_t board_id;
+        bool in_use;
+        bool found;
+        AppDescriptor descriptor;       ///< Valid if found
+    };
+
+    CatalogueEntry catalogue_[MaxCatalogueEntries];
+    uavcan::uint32_t num_image_scans_;
+
+    CatalogueEntry& findCatalogueEntry(uavcan::uint16_t board_id)
+    {
+        CatalogueEntry* oldest = &catalogue_[0];
+        for (unsigned i = 0; i < MaxCatalogueEntries; i++)
+        {
+            CatalogueEntry& e = catalogue_[i];
+            if (e.in_use && e.board_id == board_id)
+            {
+                return e;
+            }
+            if (!e.in_use || (oldest->in_use && e.used_at < oldest->used_at))
+            {
+                oldest = &e;
+            }
+        }
+        oldest->in_use = false;
+        oldest->board_id = board_id;
+        return *oldest;
+    }
+
+    /**
+     * Returns the descriptor of the image for the board, or null if there's no valid image.
+     */
+    const AppDescriptor* findImage(uavcan::uint16_t board_id, const char* bin_file_name)
+    {
+        using namespace std;
+
+        const time_t now = time(UAVCAN_NULLPTR);
+        CatalogueEntry& e = findCatalogueEntry(board_id);
+        e.used_at = now;
+
+        if (e.in_use && (now - e.checked_at) < CatalogueRevalidationSeconds)
+        {
+            return e.found ? &e.descriptor : UAVCAN_NULLPTR;
+        }
+
+        char primary_path[MaxBasePathLength + 1];
+        char alt_path[MaxBasePathLength + 1];
+
+        // Look on Primary location
+        snprintf(primary_path, sizeof(primary_path), "%s%s", getFirmwareBasePath().c_str(), bin_file_name);
+        snprintf(alt_path, sizeof(alt_path), "%s/%s", getFirmwareAltBasePath().c_str(), bin_file_name);
+        const bool has_alt = !getFirmwareAltBasePath().empty();
+
+        const FileStamp primary(primary_path);
+        const FileStamp alt = has_alt ? FileStamp(alt_path) : FileStamp();
+        if (!e.in_use || e.primary != primary || e.alt != alt)
+        {
+            // We have a file path, is it a valid image
+            e.descriptor = AppDescriptor();
+            e.found = getFileInfo(primary_path, e.descriptor) == 0;
+            num_image_scans_++;
+            const char* found_path = primary_path;
+
+            if (!e.found && has_alt)
+            {
+                e.found = getFileInfo(alt_path, e.descriptor) == 0;
+                num_image_scans_++;
+                found_path = alt_path;
+            }
+            if (e.found)
+            {
+                (void)archiveImage(found_path, e.descriptor.image_crc);
+            }
+            e.primary = primary;
+            e.alt = alt;
+            e.in_use = true;
+        }
+        e.checked_at = now;
+        return e.found ? &e.descriptor : UAVCAN_NULLPTR;
+    }
+
+    /**
+     * Copies the image into the archive unless it is there already. Returns negative errno.
+     */
+    int archiveImage(const char* path, uavcan::uint64_t image_crc) const
+    {
+        using namespace std;
+
+        if (archive_path_.empty())
+        {
+            return 0;
+        }
+
+        char archived_path[MaxBasePathLength + 32];
+        char tmp_path[sizeof(archived_path) + 4];
+        const int n = snprintf(archived_path, sizeof(archived_path), "%s%016llx.bin", archive_path_.c_str(),
+                               static_cast<unsigned long long>(image_crc));
+        if (n <= 0 || n >= static_cast<int>(sizeof(archived_path)))
+        {
+            return -ENAMETOOLONG;
+        }
+        snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", archived_path);
+
+        struct stat sb;
+        if (stat(archived_path, &sb) == 0)
+        {
+            return 0;
+        }
+
+        const int src_fd = open(path, O_RDONLY);
+        if (src_fd < 0)
+        {
+            return -errno;
+        }
+        const int dst_fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, FilePermissions);
+        if (dst_fd < 0)
+        {
+            const int rv = -errno;
+            (void)close(src_fd);
+            return rv;
+        }
+
+        int rv = 0;
+        uavcan::uint8_t buffer[512];
+        while (rv == 0)
+        {
+            const ssize_t len = read(src_fd, buffer, sizeof(buffer));
+            if (len <= 0)
+            {
+                rv = (len < 0) ? -errno : 1;
+                break;
+            }
+            ssize_t written = 0;
+            while (written < len)
+            {
+                const ssize_t n = write(dst_fd, buffer + written, size_t(len - written));
+                if (n <= 0)
+                {
+                    rv = -EIO;
+                    break;
+                }
+                written += n;
+            }
+        }
+        (void)close(src_fd);
+        (void)close(dst_fd);
+
+        // The name appears only once the copy is complete
+        if ((rv < 0) || (rename(tmp_path, archived_path) != 0))
+        {
+            rv = (rv < 0) ? rv : -errno;
+            (void)unlink(tmp_path);
+            return rv;
+        }
+        return 0;
+    }
+
     void setFirmwareBasePath(const char* path)
     {
         base_path_ = path;
@@ -118,31 +349,11 @@ protected:
 
         if (n > 0 && n < (int)sizeof(bin_file_name) - 2)
         {
-            char bin_file_path[MaxBasePathLength + 1];
-
-            // Look on Primary location
+            const AppDescriptor* const descriptor = findImage(board_id, bin_file_name);
 
-            snprintf(bin_file_path, sizeof(bin_file_path), "%s%s",
-                      getFirmwareBasePath().c_str(), bin_file_name);
-
-           // We have a file path, is it a valid image
-
-            AppDescriptor descriptor{0};
-
-            bool found = getFileInfo(bin_file_path, descriptor) == 0;
-
-            if (!found && !getFirmwareAltBasePath().empty())
-            {
-                snprintf(bin_file_name, sizeof(bin_file_name), "%u.bin", board_id);
-                snprintf(bin_file_path, sizeof(bin_file_path), "%s/%s",
-                         getFirmwareAltBasePath().c_str(), bin_file_name);
-
-                found = getFileInfo(bin_file_path, descriptor) == 0;
-            }
-
-            if (found && (node_info.software_version.image_crc == 0 ||
+            if (descriptor != UAVCAN_NULLPTR && (node_info.software_version.image_crc == 0 ||
                 (node_info.software_version.major == 0 && node_info.software_version.minor == 0) ||
-                descriptor.image_crc != node_info.software_version.image_crc))
+                descriptor->image_crc != node_info.software_version.image_crc))
             {
                 rv = true;
                 out_firmware_file_path = bin_file_name;
@@ -179,22 +390,6 @@ protected:
     }
 
 public:
-    struct AppDescriptor
-    {
-        uavcan::uint8_t signature[sizeof(uavcan::uint64_t)];
-        union{
-            uavcan::uint64_t image_crc;
-            uavcan::uint32_t crc32_block1;
-            uavcan::uint32_t crc32_block2;
-        };
-        uavcan::uint32_t image_size;
-        uavcan::uint32_t vcs_commit;
-        uavcan::uint8_t  major_version;
-        uavcan::uint8_t  minor_version;
-        uavcan::uint16_t board_id;
-        uavcan::uint8_t  reserved[ 3 + 3 + 2];
-    };
-
     static int getFileInfo(const char* path, AppDescriptor& descriptor, int limit = 0)
     {
         using namespace std;
@@ -318,6 +513,38 @@ public:
         return rv;
     }
 
+    /**
+     * Enables the archive of the images, see the class documentation; the directory is created if it doesn't exist.
+     * The path should be the archive path of @ref uavcan::DeltaFileServerBackend resolved against the root of the
+     * file server. The images that have been scanned before are archived when they are scanned again.
+     * Returns negative errno.
+     */
+    int setImageArchivePath(const char* path)
+    {
+        using namespace std;
+
+        if (path == UAVCAN_NULLPTR || strlen(path) == 0 || strlen(path) >= archive_path_.MaxSize)
+        {
+            return -uavcan::ErrInvalidParam;
+        }
+        archive_path_ = path;
+        removeSlash(archive_path_);
+
+        struct stat sb;
+        if ((stat(archive_path_.c_str(), &sb) != 0 || !S_ISDIR(sb.st_mode)) &&
+            mkdir(archive_path_.c_str(), S_IRWXU | S_IRWXG | S_IRWXO) != 0)
+        {
+            const int rv = -errno;
+            archive_path_.clear();
+            return rv;
+        }
+        addSlash(archive_path_);
+        invalidateCatalogue();
+        return 0;
+    }
+
+    const BasePathString& getImageArchivePath() const { return archive_path_; }
+
     const char* getFirmwarePath() const
     {
         return getFirmwareBasePath().c_str();
@@ -327,6 +554,35 @@ public:
     {
         return getFirmwareAltBasePath().c_str();
     }
+
+    /**
+     * Makes the images be scanned again on the next check, e.g. after the files have been updated in place
+     * within the revalidation interval.
+     */
+    void invalidateCatalogue()
+    {
+        for (unsigned i = 0; i < MaxCatalogueEntries; i++)
+        {
+            catalogue_[i].in_use = false;
+        }
+    }
+
+    /**
+     * Number of times a firmware image has been read and scanned for its descriptor.
+     */
+    uavcan::uint32_t getNumImageScans() const { return num_image_scans_; }
+
+    FirmwareVersionChecker() : num_image_scans_(0)
+    {
+        for (unsigned i = 0; i < MaxCatalogueEntries; i++)
+        {
+            catalogue_[i].checked_at = 0;
+            catalogue_[i].used_at = 0;
+            catalogue_[i].board_id = 0;
+            catalogue_[i].in_use = false;
+            catalogue_[i].found = false;
+        }
+    }
 };
 }
 
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_POSIX_HUGE_PAGE_CHUNK_SOURCE_HPP_INCLUDED
+#define UAVCAN_POSIX_HUGE_PAGE_CHUNK_SOURCE_HPP_INCLUDED
+
+#include <sys/mman.h>
+#include <cstddef>
+#include <cstring>
+#include <uavcan/helpers/heap_based_pool_allocator.hpp>
+
+namespace uavcan_posix
+{
+/**
+ * Chunk source for uavcan::HeapBasedPoolAllocator that maps every chunk directly from the kernel, backed by huge
+ * pages where possible, which reduces the TLB misses when the pool is large. Usage:
+ *     typedef uavcan::HeapBasedPoolAllocator<uavcan::MemPoolBlockSize, RaiiSynchronizer,
+ *                                            uavcan_posix::HugePageChunkSource> Pool;
+ *     Pool pool(16384);
+ *     pool.setChunkSize(8192);
+ *
+ * On Linux, explicit huge pages (MAP_HUGETLB) are tried first; they have to be reserved by the system,
+ * e.g. via /proc/sys/vm/nr_hugepages. If none are available, regular pages are mapped, and the kernel is advised
+ * to back them with transparent huge pages. Every chunk occupies at least one page, so the chunks should be
+ * large, ideally close to the size of a huge page; the source itself uses a few bytes of every chunk.
+ */
+struct HugePageChunkSource
+{
+    enum { HugePageSize = 2 * 1024 * 1024 };
+
+    /// Keeps the length of the mapping; its size keeps the returned memory aligned for any type.
+    enum { PrefixSize = 16 };
+
+    static void* allocate(std::size_t size)
+    {
+        std::size_t length = size + PrefixSize;
+        void* base = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        const std::size_t huge_length = ((length + HugePageSize - 1U) / HugePageSize) * HugePageSize;
+        base = ::mmap(UAVCAN_NULLPTR, huge_length, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base != MAP_FAILED)
+        {
+            length = huge_length;
+        }
+#endif
+        if (base == MAP_FAILED)
+        {
+            base = ::mmap(UAVCAN_NULLPTR, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (base == MAP_FAILED)
+            {
+                return UAVCAN_NULLPTR;
+            }
+#ifdef MADV_HUGEPAGE
+            (void)::madvise(base, length, MADV_HUGEPAGE);
+#endif
+        }
+
+        std::memcpy(base, &length, sizeof(length));
+        return static_cast<char*>(base) + PrefixSize;
+    }
+
+    static void deallocate(void* ptr, std::size_t)
+    {
+        if (ptr != UAVCAN_NULLPTR)
+        {
+            void* const base = static_cast<char*>(ptr) - PrefixSize;
+            std::size_t length = 0;
+            std::memcpy(&length, base, sizeof(length));
+            (void)::munmap(base, length);
+        }
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,818 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_IO_URING_SOCKETCAN_HPP_INCLUDED
+#define UAVCAN_POSIX_IO_URING_SOCKETCAN_HPP_INCLUDED
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <linux/io_uring.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <unistd.h>
+
+#include <uavcan_posix/socketcan.hpp>
+
+namespace uavcan_posix
+{
+/**
+ * Receiver of the completions of the operations that it has submitted to @ref IoUring.
+ */
+class IIoUringCompletionHandler
+{
+public:
+    /**
+     * @param tag       Tag of the operation, as submitted.
+     * @param res       Result of the operation; negative errno on failure.
+     * @param flags     Completion flags, e.g. IORING_CQE_F_MORE.
+     */
+    virtual void handleIoUringCompletion(unsigned tag, int res, unsigned flags) = 0;
+
+    virtual ~IIoUringCompletionHandler() { }
+};
+
+/**
+ * Minimal io_uring instance on top of the raw system calls, so that no library is needed.
+ *
+ * The submission and completion queues are shared memory, so the operations are queued and their completions
+ * are consumed without system calls; one io_uring_enter() call submits all queued operations and waits for the
+ * completions of all of them. Every operation refers to the handler of its completion, see @ref getSqe().
+ */
+class IoUring : uavcan::Noncopyable
+{
+public:
+    /// Tags must be less than this, they are stored in the alignment bits of the handler pointer.
+    enum { MaxTags = 8 };
+
+private:
+    int fd_;
+    void* sq_ring_;
+    std::size_t sq_ring_size_;
+    void* cq_ring_;
+    std::size_t cq_ring_size_;
+    ::io_uring_sqe* sqes_;
+    std::size_t sqes_size_;
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    ::io_uring_cqe* cqes_;
+    unsigned sqe_tail_;             ///< Ahead of the shared tail by the operations that are not published yet
+
+    static int enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, std::size_t size)
+    {
+        return int(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, size));
+    }
+
+public:
+    IoUring()
+        : fd_(-1)
+        , sq_ring_(MAP_FAILED)
+        , sq_ring_size_(0)
+        , cq_ring_(MAP_FAILED)
+        , cq_ring_size_(0)
+        , sqes_(UAVCAN_NULLPTR)
+        , sqes_size_(0)
+        , sq_head_(UAVCAN_NULLPTR)
+        , sq_tail_(UAVCAN_NULLPTR)
+        , sq_mask_(0)
+        , sq_entries_(0)
+        , cq_head_(UAVCAN_NULLPTR)
+        , cq_tail_(UAVCAN_NULLPTR)
+        , cq_mask_(0)
+        , cqes_(UAVCAN_NULLPTR)
+        , sqe_tail_(0)
+    { }
+
+    ~IoUring() { close(); }
+
+    /**
+     * Creates the rings; the sizes are rounded up to powers of two by the kernel.
+     * Requires Linux 5.11 or newer. Returns negative errno.
+     */
+    int init(unsigned sq_entries, unsigned cq_entries)
+    {
+        close();
+
+        ::io_uring_params params;
+        (void)std::memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = cq_entries;
+        fd_ = int(::syscall(__NR_io_uring_setup, sq_entries, &params));
+        if (fd_ < 0)
+        {
+            return -errno;
+        }
+        if ((params.features & IORING_FEAT_EXT_ARG) == 0)
+        {
+            close();
+            return -ENOSYS;             // Waiting with a timeout is not supported
+        }
+
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(::io_uring_cqe);
+        const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap)
+        {
+            sq_ring_size_ = uavcan::max(sq_ring_size_, cq_ring_size_);
+            cq_ring_size_ = sq_ring_size_;
+        }
+
+        sq_ring_ = ::mmap(UAVCAN_NULLPTR, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                          IORING_OFF_SQ_RING);
+        if (sq_ring_ == MAP_FAILED)
+        {
+            const int rv = -errno;
+            close();
+            return rv;
+        }
+        cq_ring_ = single_mmap ? sq_ring_ :
+                   ::mmap(UAVCAN_NULLPTR, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                          IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED)
+        {
+            const int rv = -errno;
+            close();
+            return rv;
+        }
+        sqes_size_ = params.sq_entries * sizeof(::io_uring_sqe);
+        void* const sqes = ::mmap(UAVCAN_NULLPTR, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                  fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+        {
+            const int rv = -errno;
+            close();
+            return rv;
+        }
+        sqes_ = static_cast< ::io_uring_sqe*>(sqes);
+
+        char* const sq = static_cast<char*>(sq_ring_);
+        char* const cq = static_cast<char*>(cq_ring_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_entries_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast< ::io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        unsigned* const array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        for (unsigned i = 0; i < sq_entries_; i++)
+        {
+            array[i] = i;
+        }
+        sqe_tail_ = *sq_tail_;
+        return 0;
+    }
+
+    /**
+     * Cancels all operations and releases the rings. The memory that is used by the operations in progress
+     * is not safe to release until they have completed, see @ref submit().
+     */
+    void close()
+    {
+        if (sqes_ != UAVCAN_NULLPTR)
+        {
+            (void)::munmap(sqes_, sqes_size_);
+            sqes_ = UAVCAN_NULLPTR;
+        }
+        if ((cq_ring_ != MAP_FAILED) && (cq_ring_ != sq_ring_))
+        {
+            (void)::munmap(cq_ring_, cq_ring_size_);
+        }
+        cq_ring_ = MAP_FAILED;
+        if (sq_ring_ != MAP_FAILED)
+        {
+            (void)::munmap(sq_ring_, sq_ring_size_);
+            sq_ring_ = MAP_FAILED;
+        }
+        if (fd_ >= 0)
+        {
+            (void)::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    bool isInited() const { return sqes_ != UAVCAN_NULLPTR; }
+
+    /**
+     * Returns a zeroed submission queue entry with the completion handler and the tag set, or null if the queue
+     * is full. The entry will be submitted by the next call of @ref submit().
+     */
+    ::io_uring_sqe* getSqe(IIoUringCompletionHandler* handler, unsigned tag)
+    {
+        UAVCAN_ASSERT(tag < MaxTags);
+        if (!isInited() || ((sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE)) >= sq_entries_))
+        {
+            return UAVCAN_NULLPTR;
+        }
+        ::io_uring_sqe* const sqe = &sqes_[sqe_tail_ & sq_mask_];
+        (void)std::memset(sqe, 0, sizeof(*sqe));
+        sqe->user_data = uavcan::uint64_t(reinterpret_cast<uintptr_t>(handler)) | tag;
+        sqe_tail_++;
+        return sqe;
+    }
+
+    /**
+     * Submits the queued operations and waits for at least the given number of completions, or until the timeout
+     * expires; a negative timeout means forever. Nothing is waited for if the number is zero, so that no system
+     * call is made if there is nothing to submit either.
+     * The completions are not processed, see @ref processCompletions(). Returns negative errno.
+     */
+    int submit(unsigned wait_nr, uavcan::int64_t timeout_usec)
+    {
+        if (!isInited())
+        {
+            return -EBADF;
+        }
+        __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+        const unsigned to_submit = sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if ((to_submit == 0) && (wait_nr == 0))
+        {
+            return 0;
+        }
+
+        unsigned flags = 0;
+        ::io_uring_getevents_arg arg;
+        (void)std::memset(&arg, 0, sizeof(arg));
+        ::__kernel_timespec ts;
+        if (wait_nr > 0)
+        {
+            flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+            if (timeout_usec >= 0)
+            {
+                ts.tv_sec = timeout_usec / 1000000;
+                ts.tv_nsec = (timeout_usec % 1000000) * 1000;
+                arg.ts = uavcan::uint64_t(reinterpret_cast<uintptr_t>(&ts));
+            }
+        }
+
+        if (enter(fd_, to_submit, wait_nr, flags, &arg, sizeof(arg)) < 0)
+        {
+            const int error = errno;
+            if ((error == ETIME) || (error == EINTR) || (error == EBUSY) || (error == EAGAIN))
+            {
+                return 0;
+            }
+            return -error;
+        }
+        return 0;
+    }
+
+    /**
+     * Passes the completions that are in the completion queue to their handlers; no system calls are made.
+     * The handlers may queue new operations. Returns the number of the completions.
+     */
+    unsigned processCompletions()
+    {
+        if (!isInited())
+        {
+            return 0;
+        }
+        unsigned num_processed = 0;
+        unsigned head = *cq_head_;
+        while (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+        {
+            const ::io_uring_cqe cqe = cqes_[head & cq_mask_];
+            head++;
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+            num_processed++;
+
+            IIoUringCompletionHandler* const handler =
+                reinterpret_cast<IIoUringCompletionHandler*>(uintptr_t(cqe.user_data & ~uavcan::uint64_t(MaxTags - 1)));
+            if (handler != UAVCAN_NULLPTR)
+            {
+                handler->handleIoUringCompletion(unsigned(cqe.user_data & (MaxTags - 1)), cqe.res, cqe.flags);
+            }
+        }
+        return num_processed;
+    }
+
+    /**
+     * Registers a ring of provided buffers (Linux 5.19 or newer); the memory must be page aligned.
+     * Returns negative errno.
+     */
+    int registerBufferRing(void* ring, unsigned num_entries, uavcan::uint16_t group_id)
+    {
+        ::io_uring_buf_reg reg;
+        (void)std::memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = uavcan::uint64_t(reinterpret_cast<uintptr_t>(ring));
+        reg.ring_entries = num_entries;
+        reg.bgid = group_id;
+        if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        {
+            return -errno;
+        }
+        return 0;
+    }
+
+    void unregisterBufferRing(uavcan::uint16_t group_id)
+    {
+        ::io_uring_buf_reg reg;
+        (void)std::memset(&reg, 0, sizeof(reg));
+        reg.bgid = group_id;
+        (void)::syscall(__NR_io_uring_register, fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    }
+};
+
+/**
+ * SocketCAN interface that receives the frames via io_uring. Unlike @ref SocketCanIface, which needs one system
+ * call per batch of frames per interface, the frames of all interfaces of the driver are received without any
+ * system calls, and one io_uring_enter() call in select() waits for all interfaces at once.
+ *
+ * The socket is read by a multishot recvmsg operation into a ring of registered buffers; the received frames stay
+ * in their buffers until the library fetches them, and the buffers are returned to the kernel afterwards. If the
+ * library doesn't keep up and all buffers are filled, the socket buffer of the kernel holds the excess frames.
+ *
+ * The frames are transmitted with sendmmsg() as in @ref SocketCanIface. The CAN sockets report a full transmission
+ * queue with ENOBUFS, which io_uring doesn't retry, so asynchronous transmission could neither keep the frames in
+ * order nor report the backpressure to the library.
+ *
+ * Requires Linux 6.0 or newer.
+ */
+class IoUringSocketCanIface : public SocketCanIface, private IIoUringCompletionHandler
+{
+public:
+    /// Number of the receive buffers; a power of two.
+    enum { NumRxBuffers = 64 };
+
+private:
+    enum { TagRecv, TagCancel };
+
+    enum { RxBufferSize = sizeof(::io_uring_recvmsg_out) + ControlBufferSize + CANFD_MTU };
+    enum { RxBufferWords = (RxBufferSize + sizeof(uavcan::uint64_t) - 1) / sizeof(uavcan::uint64_t) };
+    enum { BufferRingSize = NumRxBuffers * sizeof(::io_uring_buf) };
+
+    IoUring& ring_;
+    const uavcan::uint16_t group_id_;
+    ::io_uring_buf* buffer_ring_;               ///< Shared with the kernel
+    uavcan::uint16_t buffer_ring_tail_;
+    bool buffer_ring_registered_;
+    bool recv_armed_;
+    ::msghdr recv_msghdr_;                      ///< Defines the layout of the receive buffers
+    uavcan::uint16_t rx_queue_[NumRxBuffers];   ///< Filled buffers in the order of reception
+    uavcan::uint16_t rx_lengths_[NumRxBuffers];
+    unsigned rx_queue_head_;
+    unsigned rx_queue_size_;
+    uavcan::uint64_t num_rx_errors_;
+    uavcan::uint64_t rx_buffers_[NumRxBuffers][RxBufferWords];
+
+    uavcan::uint16_t* getBufferRingTail()
+    {
+        // The tail overlays the reserved field of the first entry
+        return reinterpret_cast<uavcan::uint16_t*>(reinterpret_cast<char*>(buffer_ring_) +
+                                                   offsetof(::io_uring_buf, resv));
+    }
+
+    void provideBuffer(uavcan::uint16_t buffer_id)
+    {
+        ::io_uring_buf& entry = buffer_ring_[buffer_ring_tail_ & (NumRxBuffers - 1)];
+        entry.addr = uavcan::uint64_t(reinterpret_cast<uintptr_t>(rx_buffers_[buffer_id]));
+        entry.len = RxBufferSize;
+        entry.bid = buffer_id;
+        buffer_ring_tail_++;
+    }
+
+    void publishBuffers()
+    {
+        __atomic_store_n(getBufferRingTail(), buffer_ring_tail_, __ATOMIC_RELEASE);
+    }
+
+    virtual void handleIoUringCompletion(unsigned tag, int res, unsigned flags)
+    {
+        if (tag != TagRecv)
+        {
+            return;
+        }
+        if ((flags & IORING_CQE_F_MORE) == 0)
+        {
+            recv_armed_ = false;        // Will be re-armed by the next select() call
+        }
+        if (res < 0)
+        {
+            if (res != -ENOBUFS)
+            {
+                num_rx_errors_++;
+            }
+            return;
+        }
+        if ((flags & IORING_CQE_F_BUFFER) != 0)
+        {
+            UAVCAN_ASSERT(rx_queue_size_ < NumRxBuffers);
+            const unsigned index = (rx_queue_head_ + rx_queue_size_) & (NumRxBuffers - 1);
+            rx_queue_[index] = uavcan::uint16_t(flags >> IORING_CQE_BUFFER_SHIFT);
+            rx_lengths_[index] = uavcan::uint16_t(res);
+            rx_queue_size_++;
+        }
+    }
+
+public:
+    IoUringSocketCanIface(const uavcan::ISystemClock& clock, int socket_fd, bool canfd, IoUring& ring,
+                          uavcan::uint16_t group_id)
+        : SocketCanIface(clock, socket_fd, canfd)
+        , ring_(ring)
+        , group_id_(group_id)
+        , buffer_ring_(UAVCAN_NULLPTR)
+        , buffer_ring_tail_(0)
+        , buffer_ring_registered_(false)
+        , recv_armed_(false)
+        , rx_queue_head_(0)
+        , rx_queue_size_(0)
+        , num_rx_errors_(0)
+    {
+        (void)std::memset(&recv_msghdr_, 0, sizeof(recv_msghdr_));
+        recv_msghdr_.msg_controllen = ControlBufferSize;
+    }
+
+    virtual ~IoUringSocketCanIface()
+    {
+        UAVCAN_ASSERT(!recv_armed_);
+        if (buffer_ring_registered_)
+        {
+            ring_.unregisterBufferRing(group_id_);
+        }
+        if (buffer_ring_ != UAVCAN_NULLPTR)
+        {
+            (void)::munmap(buffer_ring_, BufferRingSize);
+        }
+    }
+
+    /**
+     * Registers the receive buffers. Returns negative errno.
+     */
+    int init()
+    {
+        void* const mem = ::mmap(UAVCAN_NULLPTR, BufferRingSize, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED)
+        {
+            return -errno;
+        }
+        buffer_ring_ = static_cast< ::io_uring_buf*>(mem);
+        const int res = ring_.registerBufferRing(buffer_ring_, NumRxBuffers, group_id_);
+        if (res < 0)
+        {
+            return res;
+        }
+        buffer_ring_registered_ = true;
+        for (unsigned i = 0; i < NumRxBuffers; i++)
+        {
+            provideBuffer(uavcan::uint16_t(i));
+        }
+        publishBuffers();
+        return 0;
+    }
+
+    /**
+     * Queues the receive operation unless it's running. Returns false if the submission queue is full.
+     */
+    bool armReception()
+    {
+        if (recv_armed_)
+        {
+            return true;
+        }
+        ::io_uring_sqe* const sqe = ring_.getSqe(this, TagRecv);
+        if (sqe == UAVCAN_NULLPTR)
+        {
+            return false;
+        }
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->fd = fd_;
+        sqe->addr = uavcan::uint64_t(reinterpret_cast<uintptr_t>(&recv_msghdr_));
+        sqe->len = 1;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = group_id_;
+        recv_armed_ = true;
+        return true;
+    }
+
+    /**
+     * Queues the cancellation of the receive operation; it is stopped once @ref isReceptionArmed() returns false.
+     */
+    bool cancelReception()
+    {
+        if (!recv_armed_)
+        {
+            return true;
+        }
+        ::io_uring_sqe* const sqe = ring_.getSqe(this, TagCancel);
+        if (sqe == UAVCAN_NULLPTR)
+        {
+            return false;
+        }
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = uavcan::uint64_t(reinterpret_cast<uintptr_t>(static_cast<IIoUringCompletionHandler*>(this))) |
+                    TagRecv;
+        return true;
+    }
+
+    bool isReceptionArmed() const { return recv_armed_; }
+
+    bool hasReceivedFrames() const { return rx_queue_size_ > 0; }
+
+    virtual uavcan::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                                    uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags)
+    {
+        uavcan::CanRxFrame frame;
+        const uavcan::int16_t res = receiveBatch(&frame, &out_flags, 1);
+        if (res > 0)
+        {
+            out_frame = frame;
+            out_ts_monotonic = frame.ts_mono;
+            out_ts_utc = frame.ts_utc;
+        }
+        return res;
+    }
+
+    virtual uavcan::int16_t receiveBatch(uavcan::CanRxFrame* out_frames, uavcan::CanIOFlags* out_flags,
+                                         uavcan::uint16_t max_frames)
+    {
+        if ((out_frames == UAVCAN_NULLPTR) || (out_flags == UAVCAN_NULLPTR) || (max_frames == 0))
+        {
+            UAVCAN_ASSERT(0);
+            return 0;
+        }
+        if (rx_queue_size_ == 0)
+        {
+            (void)ring_.processCompletions();
+        }
+        if (rx_queue_size_ == 0)
+        {
+            return 0;
+        }
+
+        const NowTimestamps now(clock_);
+        unsigned num_out = 0;
+        while ((rx_queue_size_ > 0) && (num_out < max_frames))
+        {
+            const uavcan::uint16_t buffer_id = rx_queue_[rx_queue_head_];
+            const unsigned length = rx_lengths_[rx_queue_head_];
+            rx_queue_head_ = (rx_queue_head_ + 1) & (NumRxBuffers - 1);
+            rx_queue_size_--;
+
+            char* const buffer = reinterpret_cast<char*>(rx_buffers_[buffer_id]);
+            const ::io_uring_recvmsg_out* const out = reinterpret_cast<const ::io_uring_recvmsg_out*>(buffer);
+            const unsigned payload_offset = unsigned(sizeof(::io_uring_recvmsg_out)) + ControlBufferSize;
+            if ((length >= payload_offset) && ((out->flags & MSG_TRUNC) == 0) &&
+                (out->payloadlen <= (length - payload_offset)))
+            {
+                ::msghdr hdr;
+                (void)std::memset(&hdr, 0, sizeof(hdr));
+                hdr.msg_control = buffer + sizeof(::io_uring_recvmsg_out);
+                hdr.msg_controllen = out->controllen;
+                hdr.msg_flags = int(out->flags);
+                const ::canfd_frame& raw = *reinterpret_cast<const ::canfd_frame*>(buffer + payload_offset);
+                if (processReceivedFrame(raw, out->payloadlen, hdr, now, out_frames[num_out], out_flags[num_out]))
+                {
+                    num_out++;
+                }
+            }
+            provideBuffer(buffer_id);
+        }
+        publishBuffers();
+        return uavcan::int16_t(num_out);
+    }
+
+    /**
+     * Failures of the receive operation other than running out of buffers.
+     */
+    uavcan::uint64_t getNumRxErrors() const { return num_rx_errors_; }
+};
+
+/**
+ * SocketCAN driver for several redundant interfaces that share one io_uring instance, see
+ * @ref IoUringSocketCanIface. It is a drop-in replacement for @ref SocketCanDriver:
+ *
+ *      uavcan_posix::IoUringSocketCanDriver driver(clock);
+ *      if ((driver.init() < 0) || (driver.addIface("can0") < 0) || (driver.addIface("can1") < 0))
+ *      {
+ *          ...
+ *      }
+ *      uavcan::Node<16384> node(driver, clock);
+ *
+ * The readiness for writing is checked with one-shot poll operations on the same ring, so that select() makes one
+ * system call regardless of the number of interfaces, and none if the frames have already been received.
+ */
+class IoUringSocketCanDriver : public uavcan::ICanDriver, private IIoUringCompletionHandler, uavcan::Noncopyable
+{
+    enum { SubmissionQueueSize = 16 };
+    enum { CompletionQueueSize = 4 * IoUringSocketCanIface::NumRxBuffers * uavcan::MaxCanIfaces };
+
+    const uavcan::ISystemClock& clock_;
+    IoUring ring_;
+    uavcan::LazyConstructor<IoUringSocketCanIface> ifaces_[uavcan::MaxCanIfaces];
+    uavcan::uint8_t num_ifaces_;
+    uavcan::uint8_t write_poll_armed_mask_;
+    uavcan::uint8_t writable_mask_;
+
+    virtual void handleIoUringCompletion(unsigned tag, int res, unsigned)
+    {
+        // Tags of this handler are the interface indices; the writability is reported once per poll
+        UAVCAN_ASSERT(tag < uavcan::MaxCanIfaces);
+        write_poll_armed_mask_ = uavcan::uint8_t(write_poll_armed_mask_ & ~(1U << tag));
+        if ((res >= 0) || (res == -ECANCELED))
+        {
+            writable_mask_ = uavcan::uint8_t(writable_mask_ | (1U << tag));
+        }
+    }
+
+    bool armWritePoll(uavcan::uint8_t iface_index)
+    {
+        if (write_poll_armed_mask_ & (1U << iface_index))
+        {
+            return true;
+        }
+        ::io_uring_sqe* const sqe = ring_.getSqe(this, iface_index);
+        if (sqe == UAVCAN_NULLPTR)
+        {
+            return false;
+        }
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = ifaces_[iface_index]->getFileDescriptor();
+        sqe->poll32_events = POLLOUT;
+        write_poll_armed_mask_ = uavcan::uint8_t(write_poll_armed_mask_ | (1U << iface_index));
+        return true;
+    }
+
+    uavcan::CanSelectMasks getReadyMasks(const uavcan::CanSelectMasks& requested) const
+    {
+        uavcan::CanSelectMasks ready;
+        for (uavcan::uint8_t i = 0; i < num_ifaces_; i++)
+        {
+            if ((requested.read & (1U << i)) && ifaces_[i]->hasReceivedFrames())
+            {
+                ready.read = uavcan::uint8_t(ready.read | (1U << i));
+            }
+        }
+        ready.write = uavcan::uint8_t(requested.write & writable_mask_);
+        return ready;
+    }
+
+    /**
+     * The buffers of the interfaces must not be released until the kernel has stopped writing into them.
+     */
+    void stopReception()
+    {
+        for (unsigned attempt = 0; attempt < 10; attempt++)
+        {
+            bool armed = false;
+            for (uavcan::uint8_t i = 0; i < num_ifaces_; i++)
+            {
+                if (ifaces_[i]->isReceptionArmed())
+                {
+                    armed = true;
+                    (void)ifaces_[i]->cancelReception();
+                }
+            }
+            if (!armed)
+            {
+                break;
+            }
+            (void)ring_.submit(1, 100000);
+            (void)ring_.processCompletions();
+        }
+    }
+
+public:
+    explicit IoUringSocketCanDriver(const uavcan::ISystemClock& clock)
+        : clock_(clock)
+        , num_ifaces_(0)
+        , write_poll_armed_mask_(0)
+        , writable_mask_(0)
+    { }
+
+    virtual ~IoUringSocketCanDriver()
+    {
+        stopReception();
+        for (unsigned i = 0; i < uavcan::MaxCanIfaces; i++)
+        {
+            ifaces_[i].destroy();
+        }
+        ring_.close();
+    }
+
+    /**
+     * Returns negative errno, e.g. if io_uring is not supported.
+     */
+    int init()
+    {
+        return ring_.isInited() ? 0 : ring_.init(SubmissionQueueSize, CompletionQueueSize);
+    }
+
+    /**
+     * Opens the interface, e.g. "can0", see @ref SocketCanIface::openSocket().
+     * The interfaces are indexed in the order they are added.
+     * Returns the index of the interface or negative errno.
+     */
+    int addIface(const char* iface_name, bool canfd = bool(UAVCAN_SUPPORT_CANFD))
+    {
+        if (!ring_.isInited())
+        {
+            return -EBADF;
+        }
+        if (num_ifaces_ >= uavcan::MaxCanIfaces)
+        {
+            return -EMFILE;
+        }
+        const int fd = SocketCanIface::openSocket(iface_name, canfd);
+        if (fd < 0)
+        {
+            return fd;
+        }
+        return addIfaceSocket(fd, canfd);
+    }
+
+    /**
+     * Same as @ref addIface(), for a socket that has been opened by the application; the driver takes ownership
+     * of it.
+     */
+    int addIfaceSocket(int socket_fd, bool canfd)
+    {
+        if (!ring_.isInited() || (num_ifaces_ >= uavcan::MaxCanIfaces))
+        {
+            (void)::close(socket_fd);
+            return ring_.isInited() ? -EMFILE : -EBADF;
+        }
+        ifaces_[num_ifaces_].construct<const uavcan::ISystemClock&, int, bool, IoUring&, uavcan::uint16_t>
+            (clock_, socket_fd, canfd, ring_, num_ifaces_);
+        const int res = ifaces_[num_ifaces_]->init();
+        if (res < 0)
+        {
+            ifaces_[num_ifaces_].destroy();
+            return res;
+        }
+        return num_ifaces_++;
+    }
+
+    virtual IoUringSocketCanIface* getIface(uavcan::uint8_t iface_index)
+    {
+        return (iface_index < num_ifaces_) ? static_cast<IoUringSocketCanIface*>(ifaces_[iface_index]) :
+               UAVCAN_NULLPTR;
+    }
+
+    virtual uavcan::uint8_t getNumIfaces() const { return num_ifaces_; }
+
+    virtual uavcan::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                                   const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                                   uavcan::MonotonicTime blocking_deadline)
+    {
+        const uavcan::CanSelectMasks requested = inout_masks;
+        for (uavcan::uint8_t i = 0; i < num_ifaces_; i++)
+        {
+            if (((requested.read & (1U << i)) && !ifaces_[i]->armReception()) ||
+                ((requested.write & (1U << i)) && !(writable_mask_ & (1U << i)) && !armWritePoll(i)))
+            {
+                return -uavcan::ErrDriver;
+            }
+        }
+
+        (void)ring_.processCompletions();
+        uavcan::CanSelectMasks ready = getReadyMasks(requested);
+        if ((ready.read == 0) && (ready.write == 0))
+        {
+            uavcan::int64_t timeout_usec = 0;
+            if (!blocking_deadline.isZero())
+            {
+                timeout_usec = uavcan::max<uavcan::int64_t>((blocking_deadline - clock_.getMonotonic()).toUSec(), 0);
+            }
+            if (ring_.submit((timeout_usec > 0) ? 1U : 0U, timeout_usec) < 0)
+            {
+                return -uavcan::ErrDriver;
+            }
+            (void)ring_.processCompletions();
+            ready = getReadyMasks(requested);
+        }
+        else if (ring_.submit(0, 0) < 0)
+        {
+            return -uavcan::ErrDriver;
+        }
+
+        writable_mask_ = uavcan::uint8_t(writable_mask_ & ~ready.write);     // Polled again when requested
+        inout_masks = ready;
+        uavcan::int16_t num_ready = 0;
+        for (uavcan::uint8_t i = 0; i < num_ifaces_; i++)
+        {
+            if ((ready.read | ready.write) & (1U << i))
+            {
+                num_ready++;
+            }
+        }
+        return num_ready;
+    }
+};
+
+}
+
+#endif // Include guard
@@ -0,0 +1,317 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_MMAP_FILE_SERVER_BACKEND_HPP_INCLUDED
+#define UAVCAN_POSIX_MMAP_FILE_SERVER_BACKEND_HPP_INCLUDED
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <uavcan_posix/basic_file_server_backend.hpp>
+
+namespace uavcan_posix
+{
+/**
+ * File server backend for the files that are read by many nodes at once and rarely change, such as firmware
+ * images. Every file is mapped into memory once, when it is read for the first time, and the read requests are
+ * then served by copying straight from the mapping into the response, without any system calls; the size
+ * reported by GetInfo comes from the same mapping.
+ *
+ * The mappings are checked against the file system periodically, and those whose files have been replaced or
+ * changed, or which haven't been read for a while, are released. Files are expected to be replaced rather than
+ * modified in place (e.g. written next to the old one and renamed over it), because truncating a mapped file
+ * makes the reads past its new end fail with SIGBUS.
+ *
+ * The files that can't be mapped, and all other requests, are handled by @ref BasicFileServerBackend.
+ */
+class MmapFileServerBackend : public BasicFileServerBackend, private uavcan::TimerBase
+{
+    /// Maximum number of files kept mapped at the same time; the least recently read one is released first.
+    enum { MaxMappedFiles = 8 };
+
+    /// Age in Seconds a mapping will be kept if not read.
+    enum { MaxAgeSeconds = 60 };
+
+    /// Rate in Seconds that the mappings will be checked against the file system.
+    enum { RevalidationSeconds = 5 };
+
+    class Mapping : uavcan::Noncopyable
+    {
+        friend class MmapFileServerBackend;
+
+        Mapping* next_;
+        std::time_t last_access_;
+        const Path path_;               ///< As requested
+        const Path full_path_;          ///< As resolved against the root paths
+        const uavcan::uint8_t* const data_;
+        const uavcan::uint64_t size_;
+        const dev_t dev_;
+        const ino_t ino_;
+        const std::time_t mtime_;
+
+    public:
+        Mapping(const Path& path, const Path& full_path, const void* data, const struct stat& sb) :
+            next_(UAVCAN_NULLPTR),
+            last_access_(std::time(UAVCAN_NULLPTR)),
+            path_(path),
+            full_path_(full_path),
+            data_(static_cast<const uavcan::uint8_t*>(data)),
+            size_(uavcan::uint64_t(sb.st_size)),
+            dev_(sb.st_dev),
+            ino_(sb.st_ino),
+            mtime_(sb.st_mtime)
+        { }
+
+        ~Mapping()
+        {
+            if (data_ != UAVCAN_NULLPTR)
+            {
+                (void)::munmap(const_cast<uavcan::uint8_t*>(data_), size_t(size_));
+            }
+        }
+
+        bool matches(const struct stat& sb) const
+        {
+            return dev_ == sb.st_dev && ino_ == sb.st_ino && mtime_ == sb.st_mtime &&
+                   size_ == uavcan::uint64_t(sb.st_size);
+        }
+
+        bool expired(std::time_t now) const
+        {
+            return (now - last_access_) > MaxAgeSeconds;
+        }
+    };
+
+    Mapping* head_;
+    unsigned num_mappings_;
+    uavcan::uint32_t num_mapped_reads_;
+
+    Mapping* find(const Path& path)
+    {
+        for (Mapping* m = head_; m; m = m->next_)
+        {
+            if (m->path_ == path)
+            {
+                return m;
+            }
+        }
+        return UAVCAN_NULLPTR;
+    }
+
+    void release(Mapping** pm)
+    {
+        Mapping* const next = (*pm)->next_;
+        delete *pm;
+        *pm = next;
+        num_mappings_--;
+    }
+
+    void releaseLeastRecentlyRead()
+    {
+        Mapping** oldest = &head_;
+        for (Mapping** pm = &head_; *pm; pm = &(*pm)->next_)
+        {
+            if ((*pm)->last_access_ < (*oldest)->last_access_)
+            {
+                oldest = pm;
+            }
+        }
+        if (*oldest != UAVCAN_NULLPTR)
+        {
+            release(oldest);
+        }
+    }
+
+    /**
+     * Returns zero and the mapping on success, otherwise a file error code. The mapping is null if the path
+     * refers to something that can't be mapped; such requests are to be served by the base class.
+     */
+    int map(const Path& path, Mapping*& out_mapping)
+    {
+        using namespace std;
+
+        out_mapping = UAVCAN_NULLPTR;
+
+        Path full_path = getRootPath().c_str();
+        full_path += path;
+        int fd = ::open(full_path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            full_path = getAltRootPath().c_str();
+            full_path += path;
+            fd = ::open(full_path.c_str(), O_RDONLY);
+        }
+        if (fd < 0)
+        {
+            return errno;
+        }
+
+        struct stat sb;
+        if (::fstat(fd, &sb) < 0)
+        {
+            const int rv = errno;
+            (void)::close(fd);
+            return rv;
+        }
+        if (!S_ISREG(sb.st_mode) || sb.st_size <= 0)
+        {
+            (void)::close(fd);          // Directories and empty files are left to the base class
+            return 0;
+        }
+
+        void* const data = ::mmap(UAVCAN_NULLPTR, size_t(sb.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        (void)::close(fd);              // The mapping stays valid without the descriptor
+        if (data == MAP_FAILED)
+        {
+            return 0;
+        }
+
+        Mapping* const m = new Mapping(path, full_path, data, sb);
+        if (m == UAVCAN_NULLPTR)
+        {
+            (void)::munmap(data, size_t(sb.st_size));
+            return 0;
+        }
+
+        if (num_mappings_ >= MaxMappedFiles)
+        {
+            releaseLeastRecentlyRead();
+        }
+        m->next_ = head_;
+        head_ = m;
+        num_mappings_++;
+
+        if (!TimerBase::isRunning())
+        {
+            TimerBase::startPeriodic(uavcan::MonotonicDuration::fromMSec(RevalidationSeconds * 1000));
+        }
+
+        out_mapping = m;
+        return 0;
+    }
+
+    virtual void handleTimerEvent(const uavcan::TimerEvent&)
+    {
+        const std::time_t now = std::time(UAVCAN_NULLPTR);
+        Mapping** pm = &head_;
+        while (*pm)
+        {
+            struct stat sb;
+            if ((*pm)->expired(now) || ::stat((*pm)->full_path_.c_str(), &sb) < 0 || !(*pm)->matches(sb))
+            {
+                release(pm);
+                continue;
+            }
+            pm = &(*pm)->next_;
+        }
+
+        if (head_ == UAVCAN_NULLPTR)
+        {
+            TimerBase::stop();
+        }
+    }
+
+protected:
+    virtual uavcan::int16_t getInfo(const Path& path, uavcan::uint64_t& out_size, EntryType& out_type)
+    {
+        const Mapping* const m = find(path);
+        if (m == UAVCAN_NULLPTR)
+        {
+            return BasicFileServerBackend::getInfo(path, out_size, out_type);
+        }
+        out_size = m->size_;
+        out_type.flags = uavcan::protocol::file::EntryType::FLAG_READABLE |
+                         uavcan::protocol::file::EntryType::FLAG_FILE;
+        return 0;
+    }
+
+    virtual uavcan::int16_t read(const Path& path, const uavcan::uint64_t offset, uavcan::uint8_t* out_buffer,
+                                 uavcan::uint16_t& inout_size)
+    {
+        if (path.size() == 0 || inout_size == 0)
+        {
+            return uavcan::protocol::file::Error::INVALID_VALUE;
+        }
+
+        Mapping* m = find(path);
+        if (m == UAVCAN_NULLPTR)
+        {
+            const int rv = map(path, m);
+            if (rv != 0)
+            {
+                return uavcan::int16_t(rv);
+            }
+            if (m == UAVCAN_NULLPTR)
+            {
+                return BasicFileServerBackend::read(path, offset, out_buffer, inout_size);
+            }
+        }
+
+        m->last_access_ = std::time(UAVCAN_NULLPTR);
+        num_mapped_reads_++;
+
+        if (offset >= m->size_)
+        {
+            inout_size = 0;
+        }
+        else
+        {
+            const uavcan::uint64_t remaining = m->size_ - offset;
+            if (remaining < inout_size)
+            {
+                inout_size = uavcan::uint16_t(remaining);
+            }
+            (void)std::memcpy(out_buffer, m->data_ + offset, inout_size);
+        }
+        return 0;
+    }
+
+public:
+    MmapFileServerBackend(uavcan::INode& node) :
+        BasicFileServerBackend(node),
+        TimerBase(node),
+        head_(UAVCAN_NULLPTR),
+        num_mappings_(0),
+        num_mapped_reads_(0)
+    { }
+
+    ~MmapFileServerBackend()
+    {
+        TimerBase::stop();
+        releaseAll();
+    }
+
+    /**
+     * Releases all mappings, e.g. after the files have been updated; they will be mapped again when read.
+     */
+    void releaseAll()
+    {
+        while (head_)
+        {
+            release(&head_);
+        }
+    }
+
+    /**
+     * Number of the files that are currently mapped.
+     */
+    unsigned getNumMappedFiles() const { return num_mappings_; }
+
+    /**
+     * Number of the read requests that have been served from the mappings.
+     */
+    uavcan::uint32_t getNumMappedReads() const { return num_mapped_reads_; }
+};
+
+}
+
+#endif // Include guard
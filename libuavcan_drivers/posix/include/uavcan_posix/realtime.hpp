@@ -0,0 +1,279 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_REALTIME_HPP_INCLUDED
+#define UAVCAN_POSIX_REALTIME_HPP_INCLUDED
+
+#include <sys/mman.h>
+#include <pthread.h>
+#include <sched.h>
+#include <cerrno>
+#include <cstring>
+
+#include <uavcan/dynamic_memory.hpp>
+#include <uavcan/node/timer.hpp>
+
+namespace uavcan_posix
+{
+/**
+ * Scheduling parameters of a thread, see @ref RealtimeTuning.
+ */
+struct RealtimeThreadConfig
+{
+    /// SCHED_FIFO priority, 1 to 99; zero leaves the scheduling policy of the thread unchanged.
+    int fifo_priority;
+
+    /// The thread is pinned to this CPU; negative leaves the affinity of the thread unchanged.
+    int cpu;
+
+    RealtimeThreadConfig() : fifo_priority(0), cpu(-1) { }
+
+    RealtimeThreadConfig(int arg_fifo_priority, int arg_cpu) : fifo_priority(arg_fifo_priority), cpu(arg_cpu) { }
+};
+
+/**
+ * Configures the process and its threads for low latency. The latency tails of a node on Linux mostly come from
+ * the page faults on the first use of memory, from the preemption by other threads and from the migration between
+ * CPUs, rather than from the library itself. Typical use, from the node thread, before it starts spinning:
+ *
+ *      RealtimeTuning::lockMemory();
+ *      RealtimeTuning::applyToCurrentThread(RealtimeThreadConfig(80, 3));     // SCHED_FIFO 80, CPU 3
+ *      RealtimeTuning::prefaultStack<>();
+ *      RealtimeTuning::prefaultPool(node.getAllocator());
+ *
+ * The other threads that serve the node, e.g. a driver thread or the workers of @ref ThreadPoolExecutor, can be
+ * moved to other CPUs with @ref applyToThread(), so that they don't compete with the node thread.
+ *
+ * All methods return negative errno. Setting a real-time priority and locking the memory require the corresponding
+ * privileges (CAP_SYS_NICE and CAP_IPC_LOCK, or the rtprio and memlock limits).
+ */
+class RealtimeTuning
+{
+public:
+    /// Default amount of stack pre-faulted by @ref prefaultStack().
+    enum { DefaultStackPrefaultSize = 64 * 1024 };
+
+    /**
+     * Locks the current and the future pages of the process in memory, so that they are never paged out and
+     * the future allocations are backed by memory immediately.
+     */
+    static int lockMemory()
+    {
+        return (::mlockall(MCL_CURRENT | MCL_FUTURE) == 0) ? 0 : -errno;
+    }
+
+    static int applyToThread(pthread_t thread, const RealtimeThreadConfig& config)
+    {
+        if (config.cpu >= 0)
+        {
+            if (config.cpu >= CPU_SETSIZE)
+            {
+                return -EINVAL;
+            }
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(unsigned(config.cpu), &cpus);
+            const int res = ::pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+            if (res != 0)
+            {
+                return -res;
+            }
+        }
+        if (config.fifo_priority > 0)
+        {
+            ::sched_param param;
+            (void)std::memset(&param, 0, sizeof(param));
+            param.sched_priority = config.fifo_priority;
+            const int res = ::pthread_setschedparam(thread, SCHED_FIFO, &param);
+            if (res != 0)
+            {
+                return -res;
+            }
+        }
+        return 0;
+    }
+
+    static int applyToCurrentThread(const RealtimeThreadConfig& config)
+    {
+        return applyToThread(::pthread_self(), config);
+    }
+
+    /**
+     * Touches the given amount of the stack of the calling thread, so that the pages are mapped before they are
+     * needed; with the memory locked they stay mapped. Must be called from the thread whose stack is to be
+     * pre-faulted, at a shallow call depth.
+     */
+    template <unsigned Size = DefaultStackPrefaultSize>
+    static void prefaultStack()
+    {
+        volatile unsigned char stack[Size];
+        for (unsigned i = 0; i < Size; i += 256U)
+        {
+            stack[i] = 0;
+        }
+        (void)stack[0];
+    }
+
+    /**
+     * Allocates every free block of the allocator, writes it and returns it, so that the memory of the pool is
+     * mapped, and so that the allocators that grow on demand, like @ref uavcan::HeapBasedPoolAllocator, acquire
+     * their blocks in advance. The blocks are linked through their first bytes while they are held, nothing else
+     * is allocated.
+     * @param block_size    Size of the blocks to request, the block size of the allocator by default.
+     * @return              Number of the blocks that have been pre-faulted.
+     */
+    static unsigned prefaultPool(uavcan::IPoolAllocator& allocator,
+                                 std::size_t block_size = uavcan::MemPoolBlockSize)
+    {
+        if (block_size < sizeof(void*))
+        {
+            return 0;
+        }
+        void* held = UAVCAN_NULLPTR;
+        unsigned num_blocks = 0;
+        while (num_blocks < allocator.getBlockCapacity())
+        {
+            void* const block = allocator.allocate(block_size);
+            if (block == UAVCAN_NULLPTR)
+            {
+                break;
+            }
+            (void)std::memset(block, 0, block_size);
+            (void)std::memcpy(block, &held, sizeof(held));
+            held = block;
+            num_blocks++;
+        }
+        while (held != UAVCAN_NULLPTR)
+        {
+            void* next = UAVCAN_NULLPTR;
+            (void)std::memcpy(&next, held, sizeof(next));
+            allocator.deallocate(held);
+            held = next;
+        }
+        return num_blocks;
+    }
+};
+
+/**
+ * Measures how late the scheduler serves the deadlines, i.e. the jitter of @ref uavcan::Scheduler::spin(),
+ * by running a probe timer: every period, the time between the deadline of the timer and the moment its handler
+ * is invoked is recorded. This includes the wakeup latency of the thread, the preemption, and the time taken by
+ * the other handlers invoked in the same pass, which is what any time-critical handler of the node would see.
+ * The resolution is limited by the deadline resolution of the scheduler, see
+ * @ref uavcan::Scheduler::setDeadlineResolution().
+ *
+ * If the node thread has been stalled for longer than a period, the missed periods are counted and skipped,
+ * so that a single stall doesn't produce a burst of samples.
+ */
+class SpinJitterMonitor : private uavcan::TimerBase
+{
+public:
+    /// The bucket 0 counts the samples below 1 usec, the bucket N > 0 counts [2^(N-1), 2^N) usec, the last one
+    /// counts everything above.
+    enum { NumHistogramBuckets = 24 };
+
+    struct Statistics
+    {
+        uavcan::uint64_t num_samples;
+        uavcan::uint64_t num_missed_periods;
+        uavcan::uint64_t sum_usec;
+        uavcan::uint64_t min_usec;
+        uavcan::uint64_t max_usec;
+        uavcan::uint32_t histogram[NumHistogramBuckets];
+
+        Statistics()
+            : num_samples(0)
+            , num_missed_periods(0)
+            , sum_usec(0)
+            , min_usec(0)
+            , max_usec(0)
+        {
+            (void)std::memset(histogram, 0, sizeof(histogram));
+        }
+
+        uavcan::uint64_t getMeanUSec() const { return (num_samples > 0) ? (sum_usec / num_samples) : 0; }
+
+        /**
+         * Upper bound of the lateness of the given fraction of the samples, e.g. 0.999, from the histogram.
+         * The result is a power of two, or zero if there are no samples.
+         */
+        uavcan::uint64_t getPercentileUSec(double fraction) const
+        {
+            const double threshold = fraction * double(num_samples);
+            uavcan::uint64_t count = 0;
+            for (unsigned i = 0; i < NumHistogramBuckets; i++)
+            {
+                count += histogram[i];
+                if ((count > 0) && (double(count) >= threshold))
+                {
+                    return uavcan::uint64_t(1) << i;
+                }
+            }
+            return 0;
+        }
+    };
+
+private:
+    uavcan::MonotonicDuration period_;
+    Statistics stats_;
+
+    static unsigned getBucket(uavcan::uint64_t usec)
+    {
+        unsigned bucket = 0;
+        while ((usec > 0) && (bucket < (NumHistogramBuckets - 1U)))
+        {
+            usec >>= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+
+    virtual void handleTimerEvent(const uavcan::TimerEvent& event) override
+    {
+        const uavcan::MonotonicTime now = getScheduler().getMonotonicTime();
+        const uavcan::int64_t lateness = (now - event.scheduled_time).toUSec();
+        const uavcan::uint64_t usec = (lateness > 0) ? uavcan::uint64_t(lateness) : 0U;
+
+        stats_.min_usec = (stats_.num_samples == 0) ? usec : uavcan::min(stats_.min_usec, usec);
+        stats_.max_usec = uavcan::max(stats_.max_usec, usec);
+        stats_.sum_usec += usec;
+        stats_.num_samples++;
+        stats_.histogram[getBucket(usec)]++;
+
+        uavcan::MonotonicTime next = event.scheduled_time + period_;
+        while (next <= now)
+        {
+            next += period_;
+            stats_.num_missed_periods++;
+        }
+        startOneShotWithDeadline(next);
+    }
+
+public:
+    explicit SpinJitterMonitor(uavcan::INode& node) : uavcan::TimerBase(node) { }
+
+    /**
+     * Starts the probe timer. The period should be short enough to sample the behavior of the node thread, e.g.
+     * a few milliseconds; every sample costs one wakeup of the scheduler.
+     */
+    void start(uavcan::MonotonicDuration period)
+    {
+        period_ = period;
+        startOneShotWithDeadline(getScheduler().getMonotonicTime() + period);
+    }
+
+    using uavcan::TimerBase::stop;
+    using uavcan::TimerBase::isRunning;
+
+    const Statistics& getStatistics() const { return stats_; }
+
+    void resetStatistics() { stats_ = Statistics(); }
+};
+
+}
+
+#endif // Include guard
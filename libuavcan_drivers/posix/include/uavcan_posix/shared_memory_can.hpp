@@ -0,0 +1,845 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_SHARED_MEMORY_CAN_HPP_INCLUDED
+#define UAVCAN_POSIX_SHARED_MEMORY_CAN_HPP_INCLUDED
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <unistd.h>
+
+#include <uavcan/driver/can.hpp>
+#include <uavcan/driver/system_clock.hpp>
+#include <uavcan/util/lazy_constructor.hpp>
+
+namespace uavcan_posix
+{
+/**
+ * Shared memory segment through which several processes use the same CAN interfaces, see @ref SharedCanBusOwner
+ * and @ref SharedCanBusDriver.
+ *
+ * The segment holds two rings:
+ *  - The RX ring, where the owner publishes every frame received from the bus and every frame transmitted on
+ *    behalf of a client. It is a broadcast ring: each client reads it with its own cursor, nothing is ever
+ *    consumed, and the owner overwrites the oldest frames regardless of the readers. The slots are protected with
+ *    sequence numbers, so a reader that has been overrun detects it and skips ahead.
+ *  - The TX ring, where the clients enqueue their frames. It is a bounded multi-producer single-consumer queue,
+ *    drained by the owner only.
+ *
+ * The frames are copied word by word with relaxed atomic accesses, so that a torn read caused by an overrun is
+ * detected by the sequence number rather than being a data race. All processes must be built with the same
+ * compiler and the same UAVCAN_SUPPORT_CANFD setting.
+ */
+class SharedCanBus
+{
+public:
+    enum { RxCapacity = 1024 };     ///< Must be a power of two
+    enum { TxCapacity = 256 };      ///< Must be a power of two
+    enum { Magic = 0x55434231 };
+
+    struct Record
+    {
+        uavcan::uint64_t ts_usec;       ///< RX: monotonic timestamp; TX: monotonic deadline
+        uavcan::uint32_t id;
+        uavcan::uint32_t origin;        ///< Client that has sent the frame; zero for the frames from the bus
+        uavcan::uint16_t flags;         ///< IO flags requested by the sender
+        uavcan::uint8_t dlc;
+        uavcan::uint8_t canfd;
+        uavcan::uint8_t iface_index;
+        uavcan::uint8_t reserved[3];
+        uavcan::uint8_t data[64];
+    };
+
+    struct Slot
+    {
+        uavcan::uint64_t seq;
+        uavcan::uint32_t words[sizeof(Record) / 4];
+    };
+
+    struct Layout
+    {
+        uavcan::uint32_t magic;         ///< Written last by the owner
+        uavcan::uint32_t size;
+        uavcan::uint32_t event_counter; ///< Futex; bumped when frames are published or the TX ring is drained
+        uavcan::uint32_t num_waiters;
+        uavcan::uint32_t next_client_id;
+        uavcan::uint8_t num_ifaces;
+        uavcan::uint8_t reserved[3];
+        uavcan::uint64_t error_counts[uavcan::MaxCanIfaces];
+        uavcan::uint64_t rx_head;       ///< Written by the owner only
+        uavcan::uint64_t tx_head;       ///< Claimed by the clients
+        uavcan::uint64_t tx_tail;       ///< Written by the owner only
+        Slot rx[RxCapacity];
+        Slot tx[TxCapacity];
+    };
+
+    static void storeRecord(Slot& slot, const Record& rec)
+    {
+        uavcan::StaticAssert<(sizeof(Record) % 4) == 0>::check();
+        uavcan::StaticAssert<(uavcan::CanFrame::MaxDataLen <= sizeof(rec.data))>::check();
+        uavcan::uint32_t words[sizeof(Record) / 4];
+        (void)std::memcpy(words, &rec, sizeof(words));
+        for (unsigned i = 0; i < (sizeof(Record) / 4); i++)
+        {
+            __atomic_store_n(&slot.words[i], words[i], __ATOMIC_RELAXED);
+        }
+    }
+
+    static void loadRecord(const Slot& slot, Record& out_rec)
+    {
+        uavcan::uint32_t words[sizeof(Record) / 4];
+        for (unsigned i = 0; i < (sizeof(Record) / 4); i++)
+        {
+            words[i] = __atomic_load_n(&slot.words[i], __ATOMIC_RELAXED);
+        }
+        (void)std::memcpy(&out_rec, words, sizeof(words));
+    }
+
+    static void toRecord(const uavcan::CanFrame& frame, Record& out_rec)
+    {
+        (void)std::memset(&out_rec, 0, sizeof(out_rec));
+        out_rec.id = frame.id;
+        out_rec.dlc = frame.dlc;
+        out_rec.canfd = frame.canfd ? 1U : 0U;
+        (void)std::memcpy(out_rec.data, frame.data, uavcan::CanFrame::MaxDataLen);
+    }
+
+    static void fromRecord(const Record& rec, uavcan::CanFrame& out_frame)
+    {
+        out_frame.id = rec.id;
+        out_frame.dlc = rec.dlc;
+        out_frame.canfd = rec.canfd != 0;
+        (void)std::memcpy(out_frame.data, rec.data, uavcan::CanFrame::MaxDataLen);
+    }
+
+    /**
+     * Maps the segment; the owner creates it. Returns null and sets errno on failure.
+     */
+    static Layout* map(const char* name, bool create)
+    {
+        const int fd = ::shm_open(name, create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR, 0660);
+        if (fd < 0)
+        {
+            return UAVCAN_NULLPTR;
+        }
+        if (create && (::ftruncate(fd, off_t(sizeof(Layout))) < 0))
+        {
+            const int err = errno;
+            (void)::close(fd);
+            errno = err;
+            return UAVCAN_NULLPTR;
+        }
+        struct ::stat st;
+        if ((::fstat(fd, &st) < 0) || (std::size_t(st.st_size) < sizeof(Layout)))
+        {
+            (void)::close(fd);
+            errno = EPROTO;
+            return UAVCAN_NULLPTR;
+        }
+        void* const mem = ::mmap(UAVCAN_NULLPTR, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        (void)::close(fd);
+        return (mem == MAP_FAILED) ? UAVCAN_NULLPTR : static_cast<Layout*>(mem);
+    }
+
+    static void unmap(Layout* layout)
+    {
+        if (layout != UAVCAN_NULLPTR)
+        {
+            (void)::munmap(layout, sizeof(Layout));
+        }
+    }
+
+    /**
+     * Waits until the event counter differs from the expected value or the timeout expires.
+     */
+    static void waitForEvent(Layout& layout, uavcan::uint32_t expected, uavcan::int64_t timeout_usec)
+    {
+        ::timespec ts;
+        ts.tv_sec = time_t(timeout_usec / 1000000);
+        ts.tv_nsec = long((timeout_usec % 1000000) * 1000);
+        (void)::syscall(SYS_futex, &layout.event_counter, FUTEX_WAIT, expected, &ts, UAVCAN_NULLPTR, 0);
+    }
+
+    static void notify(Layout& layout)
+    {
+        (void)__atomic_add_fetch(&layout.event_counter, 1U, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&layout.num_waiters, __ATOMIC_SEQ_CST) > 0)
+        {
+            (void)::syscall(SYS_futex, &layout.event_counter, FUTEX_WAKE, INT_MAX, UAVCAN_NULLPTR, UAVCAN_NULLPTR, 0);
+        }
+    }
+};
+
+/**
+ * Process that owns the physical CAN interfaces and shares them with the clients through the shared memory,
+ * so that every frame is copied from the kernel to the user space once, regardless of the number of processes
+ * that run a node. The owner does not run a node itself; its own process can be a client like any other.
+ *
+ * The frames enqueued by the clients are collected into per-interface queues and transmitted in the order of
+ * their CAN priority, so the owner arbitrates between the clients the same way the bus does. The frames are
+ * transmitted with the loopback flag, and their loopback copies are published into the RX ring, so that the
+ * clients receive the frames of each other as if they were separate nodes on the bus, and the sender gets its
+ * loopback frame with the true transmission timestamp if it has requested it. The physical driver must support
+ * loopback, like @ref SocketCanDriver does.
+ *
+ * The owner cannot be woken up by the clients while it is blocked in the physical driver, so the TX ring is
+ * checked at least once per @ref getTxPollInterval(), which bounds the added transmission latency.
+ *
+ * Typical use:
+ *
+ *      SocketCanDriver can(clock);
+ *      can.init();
+ *      can.addIface("can0");
+ *      SharedCanBusOwner owner(can, clock);
+ *      owner.init("/uavcan_can0");
+ *      while (true) { owner.spin(clock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(100)); }
+ */
+class SharedCanBusOwner : uavcan::Noncopyable
+{
+public:
+    enum { MaxPendingTxFrames = 64 };           ///< Per interface
+    enum { DefaultTxPollIntervalUsec = 1000 };
+
+private:
+    enum { MaxPendingLoopbackFrames = 64 };
+    enum { RxBatchSize = 32 };
+
+    struct LoopbackEntry
+    {
+        uavcan::uint32_t id;
+        uavcan::uint32_t origin;
+        uavcan::uint16_t flags;
+    };
+
+    uavcan::ICanDriver& driver_;
+    const uavcan::ISystemClock& clock_;
+    SharedCanBus::Layout* layout_;
+    std::string name_;
+    uavcan::MonotonicDuration tx_poll_interval_;
+
+    SharedCanBus::Record pending_tx_[uavcan::MaxCanIfaces][MaxPendingTxFrames];
+    unsigned num_pending_tx_[uavcan::MaxCanIfaces];
+    LoopbackEntry loopback_[uavcan::MaxCanIfaces][MaxPendingLoopbackFrames];
+    unsigned loopback_head_[uavcan::MaxCanIfaces];
+    unsigned num_loopback_[uavcan::MaxCanIfaces];
+
+    uavcan::uint64_t num_published_frames_;
+    uavcan::uint64_t num_dropped_tx_frames_;
+
+    void publish(const uavcan::CanRxFrame& frame, uavcan::uint32_t origin, uavcan::uint16_t flags)
+    {
+        SharedCanBus::Record rec;
+        SharedCanBus::toRecord(frame, rec);
+        rec.ts_usec = frame.ts_mono.toUSec();
+        rec.origin = origin;
+        rec.flags = flags;
+        rec.iface_index = frame.iface_index;
+
+        const uavcan::uint64_t pos = layout_->rx_head;
+        SharedCanBus::Slot& slot = layout_->rx[pos & (SharedCanBus::RxCapacity - 1U)];
+        __atomic_store_n(&slot.seq, pos * 2U + 1U, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        SharedCanBus::storeRecord(slot, rec);
+        __atomic_store_n(&slot.seq, pos * 2U + 2U, __ATOMIC_RELEASE);
+        __atomic_store_n(&layout_->rx_head, pos + 1U, __ATOMIC_RELEASE);
+        num_published_frames_++;
+    }
+
+    bool drainTxRing()
+    {
+        bool drained = false;
+        while (true)
+        {
+            const uavcan::uint64_t pos = layout_->tx_tail;
+            SharedCanBus::Slot& slot = layout_->tx[pos & (SharedCanBus::TxCapacity - 1U)];
+            if (__atomic_load_n(&slot.seq, __ATOMIC_ACQUIRE) != (pos + 1U))
+            {
+                break;
+            }
+            SharedCanBus::Record rec;
+            SharedCanBus::loadRecord(slot, rec);
+            __atomic_store_n(&slot.seq, pos + SharedCanBus::TxCapacity, __ATOMIC_RELEASE);
+            __atomic_store_n(&layout_->tx_tail, pos + 1U, __ATOMIC_RELEASE);
+            drained = true;
+
+            const uavcan::uint8_t i = rec.iface_index;
+            if ((i >= layout_->num_ifaces) || (num_pending_tx_[i] >= MaxPendingTxFrames))
+            {
+                num_dropped_tx_frames_++;
+                continue;
+            }
+            pending_tx_[i][num_pending_tx_[i]++] = rec;
+        }
+        return drained;
+    }
+
+    void removePendingTx(uavcan::uint8_t iface_index, unsigned index)
+    {
+        num_pending_tx_[iface_index]--;
+        pending_tx_[iface_index][index] = pending_tx_[iface_index][num_pending_tx_[iface_index]];
+    }
+
+    /**
+     * Index of the pending frame of the highest priority; the expired frames are dropped on the way.
+     */
+    unsigned findTopPendingTx(uavcan::uint8_t iface_index, uavcan::MonotonicTime now, uavcan::CanFrame& out_frame)
+    {
+        unsigned top = MaxPendingTxFrames;
+        unsigned i = 0;
+        while (i < num_pending_tx_[iface_index])
+        {
+            const SharedCanBus::Record& rec = pending_tx_[iface_index][i];
+            if (uavcan::MonotonicTime::fromUSec(rec.ts_usec) < now)
+            {
+                num_dropped_tx_frames_++;
+                removePendingTx(iface_index, i);
+                if (top == num_pending_tx_[iface_index])
+                {
+                    top = i;                    // The top entry has been moved into this place
+                }
+                continue;
+            }
+            uavcan::CanFrame frame;
+            SharedCanBus::fromRecord(rec, frame);
+            if ((top == MaxPendingTxFrames) || frame.priorityHigherThan(out_frame))
+            {
+                top = i;
+                out_frame = frame;
+            }
+            i++;
+        }
+        return top;
+    }
+
+    void transmit(uavcan::uint8_t iface_index, uavcan::MonotonicTime now)
+    {
+        uavcan::ICanIface* const iface = driver_.getIface(iface_index);
+        while (iface != UAVCAN_NULLPTR)
+        {
+            uavcan::CanFrame frame;
+            const unsigned top = findTopPendingTx(iface_index, now, frame);
+            if (top == MaxPendingTxFrames)
+            {
+                break;
+            }
+            const SharedCanBus::Record& rec = pending_tx_[iface_index][top];
+            const uavcan::int16_t res = iface->send(frame, uavcan::MonotonicTime::fromUSec(rec.ts_usec),
+                                                    uavcan::CanIOFlags(rec.flags | uavcan::CanIOFlagLoopback));
+            if (res == 0)
+            {
+                break;
+            }
+            if (res > 0)
+            {
+                const unsigned n = num_loopback_[iface_index];
+                LoopbackEntry& e =
+                    loopback_[iface_index][(loopback_head_[iface_index] + n) % MaxPendingLoopbackFrames];
+                e.id = rec.id;
+                e.origin = rec.origin;
+                e.flags = rec.flags;
+                if (n < MaxPendingLoopbackFrames)
+                {
+                    num_loopback_[iface_index]++;
+                }
+                else
+                {
+                    loopback_head_[iface_index] = (loopback_head_[iface_index] + 1U) % MaxPendingLoopbackFrames;
+                }
+            }
+            else
+            {
+                num_dropped_tx_frames_++;
+            }
+            removePendingTx(iface_index, top);
+        }
+    }
+
+    /**
+     * The loopback frames come in the order of transmission; the entries of the frames that have been lost
+     * are skipped. Returns false if the frame was not transmitted on behalf of a client.
+     */
+    bool matchLoopback(const uavcan::CanFrame& frame, uavcan::uint8_t iface_index, LoopbackEntry& out_entry)
+    {
+        while (num_loopback_[iface_index] > 0)
+        {
+            out_entry = loopback_[iface_index][loopback_head_[iface_index]];
+            loopback_head_[iface_index] = (loopback_head_[iface_index] + 1U) % MaxPendingLoopbackFrames;
+            num_loopback_[iface_index]--;
+            if (out_entry.id == frame.id)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    unsigned receive(uavcan::uint8_t iface_index)
+    {
+        uavcan::ICanIface* const iface = driver_.getIface(iface_index);
+        unsigned num_published = 0;
+        for (unsigned i = 0; (iface != UAVCAN_NULLPTR) && (i < RxBatchSize); i++)
+        {
+            uavcan::CanRxFrame frame;
+            uavcan::CanIOFlags flags = 0;
+            if (iface->receive(frame, frame.ts_mono, frame.ts_utc, flags) <= 0)
+            {
+                break;
+            }
+            frame.iface_index = iface_index;
+            if (flags & uavcan::CanIOFlagLoopback)
+            {
+                LoopbackEntry entry;
+                if (matchLoopback(frame, iface_index, entry))
+                {
+                    publish(frame, entry.origin, entry.flags);
+                    num_published++;
+                }
+            }
+            else
+            {
+                publish(frame, 0, 0);
+                num_published++;
+            }
+        }
+        return num_published;
+    }
+
+public:
+    SharedCanBusOwner(uavcan::ICanDriver& driver, const uavcan::ISystemClock& clock)
+        : driver_(driver)
+        , clock_(clock)
+        , layout_(UAVCAN_NULLPTR)
+        , tx_poll_interval_(uavcan::MonotonicDuration::fromUSec(DefaultTxPollIntervalUsec))
+        , num_published_frames_(0)
+        , num_dropped_tx_frames_(0)
+    {
+        for (unsigned i = 0; i < uavcan::MaxCanIfaces; i++)
+        {
+            num_pending_tx_[i] = 0;
+            loopback_head_[i] = 0;
+            num_loopback_[i] = 0;
+        }
+    }
+
+    ~SharedCanBusOwner()
+    {
+        if (layout_ != UAVCAN_NULLPTR)
+        {
+            SharedCanBus::unmap(layout_);
+            (void)::shm_unlink(name_.c_str());
+        }
+    }
+
+    /**
+     * Creates the shared memory segment, e.g. "/uavcan_can0"; an existing one is replaced, which detaches the
+     * clients that are still attached to it. The interfaces of the driver must be opened beforehand.
+     * Returns negative errno.
+     */
+    int init(const char* name)
+    {
+        if (layout_ != UAVCAN_NULLPTR)
+        {
+            return -EALREADY;
+        }
+        SharedCanBus::Layout* const layout = SharedCanBus::map(name, true);
+        if (layout == UAVCAN_NULLPTR)
+        {
+            return -errno;
+        }
+        layout->size = sizeof(SharedCanBus::Layout);
+        layout->num_ifaces = driver_.getNumIfaces();
+        layout->next_client_id = 1;
+        for (unsigned i = 0; i < SharedCanBus::TxCapacity; i++)
+        {
+            layout->tx[i].seq = i;
+        }
+        __atomic_store_n(&layout->magic, uavcan::uint32_t(SharedCanBus::Magic), __ATOMIC_RELEASE);
+        layout_ = layout;
+        name_ = name;
+        return 0;
+    }
+
+    /**
+     * Moves the frames between the interfaces and the shared memory; blocks until there is something to do or
+     * until the deadline, but no longer than @ref getTxPollInterval().
+     * Returns the number of published frames or negative error code.
+     */
+    int spinOnce(uavcan::MonotonicTime blocking_deadline)
+    {
+        if (layout_ == UAVCAN_NULLPTR)
+        {
+            return -uavcan::ErrNotInited;
+        }
+        bool notify = drainTxRing();
+
+        uavcan::CanSelectMasks masks;
+        const uavcan::CanFrame* pending_tx[uavcan::MaxCanIfaces] = { };
+        uavcan::CanFrame top_frames[uavcan::MaxCanIfaces];
+        const uavcan::MonotonicTime now = clock_.getMonotonic();
+        for (uavcan::uint8_t i = 0; i < layout_->num_ifaces; i++)
+        {
+            masks.read = uavcan::uint8_t(masks.read | (1U << i));
+            if (findTopPendingTx(i, now, top_frames[i]) < MaxPendingTxFrames)
+            {
+                masks.write = uavcan::uint8_t(masks.write | (1U << i));
+                pending_tx[i] = &top_frames[i];
+            }
+        }
+
+        uavcan::MonotonicTime wake_up = now + tx_poll_interval_;
+        if (blocking_deadline < wake_up)
+        {
+            wake_up = blocking_deadline;
+        }
+        const uavcan::int16_t res = driver_.select(masks, pending_tx, wake_up);
+        if (res < 0)
+        {
+            return res;
+        }
+
+        unsigned num_published = 0;
+        const uavcan::MonotonicTime tx_ts = clock_.getMonotonic();
+        for (uavcan::uint8_t i = 0; i < layout_->num_ifaces; i++)
+        {
+            if (masks.read & (1U << i))
+            {
+                num_published += receive(i);
+            }
+            if (masks.write & (1U << i))
+            {
+                transmit(i, tx_ts);
+            }
+            const uavcan::ICanIface* const iface = driver_.getIface(i);
+            if (iface != UAVCAN_NULLPTR)
+            {
+                __atomic_store_n(&layout_->error_counts[i], iface->getErrorCount(), __ATOMIC_RELAXED);
+            }
+        }
+
+        notify = notify || (num_published > 0);
+        if (notify)
+        {
+            SharedCanBus::notify(*layout_);
+        }
+        return int(num_published);
+    }
+
+    /**
+     * Returns strictly when the deadline is reached, or on error.
+     * Returns the number of published frames or negative error code.
+     */
+    int spin(uavcan::MonotonicTime deadline)
+    {
+        int num_published = 0;
+        do
+        {
+            const int res = spinOnce(deadline);
+            if (res < 0)
+            {
+                return res;
+            }
+            num_published += res;
+        }
+        while (clock_.getMonotonic() < deadline);
+        return num_published;
+    }
+
+    uavcan::MonotonicDuration getTxPollInterval() const { return tx_poll_interval_; }
+    void setTxPollInterval(uavcan::MonotonicDuration interval) { tx_poll_interval_ = interval; }
+
+    uavcan::uint64_t getNumPublishedFrames() const { return num_published_frames_; }
+
+    /**
+     * Frames of the clients that could not be queued, expired, or were rejected by the driver.
+     */
+    uavcan::uint64_t getNumDroppedTxFrames() const { return num_dropped_tx_frames_; }
+};
+
+/**
+ * CAN driver of a client process of @ref SharedCanBusOwner. The received frames are read from the shared memory
+ * without system calls; a system call is only made to block in @ref select() when there is nothing to do.
+ *
+ * The frames sent by this client are not received back unless the loopback is requested, like with SocketCAN;
+ * the frames of the other clients are received as regular frames. The monotonic timestamps are taken by the owner,
+ * which must use a clock based on CLOCK_MONOTONIC, like @ref SystemClock; the UTC timestamps are derived from them
+ * with the clock of this client, so that its own UTC adjustments apply.
+ *
+ * If the client falls behind the owner by more than @ref SharedCanBus::RxCapacity frames, the frames it has missed
+ * are lost, see @ref getNumRxOverruns(). There are no acceptance filters, the frames are rejected by the library
+ * before they are parsed. A client that dies in the middle of enqueueing a frame stalls the TX ring until the
+ * owner is restarted.
+ */
+class SharedCanBusDriver : public uavcan::ICanDriver, uavcan::Noncopyable
+{
+    class Iface : public uavcan::ICanIface
+    {
+        SharedCanBusDriver& owner_;
+        const uavcan::uint8_t index_;
+
+    public:
+        Iface(SharedCanBusDriver& owner, uavcan::uint8_t index)
+            : owner_(owner)
+            , index_(index)
+        { }
+
+        virtual uavcan::int16_t send(const uavcan::CanFrame& frame, uavcan::MonotonicTime tx_deadline,
+                                     uavcan::CanIOFlags flags)
+        {
+            return owner_.push(frame, tx_deadline, flags, index_);
+        }
+
+        virtual uavcan::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                                        uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags)
+        {
+            return owner_.take(index_, out_frame, out_ts_monotonic, out_ts_utc, out_flags);
+        }
+
+        virtual uavcan::int16_t configureFilters(const uavcan::CanFilterConfig*, uavcan::uint16_t) { return 0; }
+        virtual uavcan::uint16_t getNumFilters() const { return 0; }
+        virtual uavcan::uint64_t getErrorCount() const { return owner_.getErrorCount(index_); }
+    };
+
+    const uavcan::ISystemClock& clock_;
+    SharedCanBus::Layout* layout_;
+    uavcan::LazyConstructor<Iface> ifaces_[uavcan::MaxCanIfaces];
+    uavcan::uint8_t num_ifaces_;
+    uavcan::uint32_t client_id_;
+    uavcan::uint64_t cursor_;
+    SharedCanBus::Record next_;
+    bool has_next_;
+    uavcan::uint64_t num_rx_overruns_;
+
+    /**
+     * Reads the next frame addressed to this client into the lookahead record, unless it is already there.
+     */
+    bool fetch()
+    {
+        while (!has_next_)
+        {
+            const uavcan::uint64_t head = __atomic_load_n(&layout_->rx_head, __ATOMIC_ACQUIRE);
+            if (cursor_ == head)
+            {
+                return false;
+            }
+            const SharedCanBus::Slot& slot = layout_->rx[cursor_ & (SharedCanBus::RxCapacity - 1U)];
+            const uavcan::uint64_t expected_seq = cursor_ * 2U + 2U;
+            bool valid = __atomic_load_n(&slot.seq, __ATOMIC_ACQUIRE) == expected_seq;
+            if (valid)
+            {
+                SharedCanBus::loadRecord(slot, next_);
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                valid = __atomic_load_n(&slot.seq, __ATOMIC_RELAXED) == expected_seq;
+            }
+            if (!valid)
+            {
+                num_rx_overruns_++;                 // Overwritten by the owner, skipping to the newest frame
+                cursor_ = __atomic_load_n(&layout_->rx_head, __ATOMIC_ACQUIRE);
+                continue;
+            }
+            cursor_++;
+            const bool own = next_.origin == client_id_;
+            has_next_ = (next_.iface_index < num_ifaces_) && (!own || (next_.flags & uavcan::CanIOFlagLoopback));
+        }
+        return true;
+    }
+
+    uavcan::int16_t take(uavcan::uint8_t iface_index, uavcan::CanFrame& out_frame,
+                         uavcan::MonotonicTime& out_ts_monotonic, uavcan::UtcTime& out_ts_utc,
+                         uavcan::CanIOFlags& out_flags)
+    {
+        if (!fetch() || (next_.iface_index != iface_index))
+        {
+            return 0;
+        }
+        SharedCanBus::fromRecord(next_, out_frame);
+        out_ts_monotonic = uavcan::MonotonicTime::fromUSec(next_.ts_usec);
+        out_ts_utc = clock_.getUtc() +
+                     uavcan::UtcDuration::fromUSec((out_ts_monotonic - clock_.getMonotonic()).toUSec());
+        out_flags = (next_.origin == client_id_) ? uavcan::CanIOFlagLoopback : uavcan::CanIOFlags(0);
+        has_next_ = false;
+        return 1;
+    }
+
+    bool isTxRingFull() const
+    {
+        const uavcan::uint64_t pos = __atomic_load_n(&layout_->tx_head, __ATOMIC_RELAXED);
+        const uavcan::uint64_t seq =
+            __atomic_load_n(&layout_->tx[pos & (SharedCanBus::TxCapacity - 1U)].seq, __ATOMIC_ACQUIRE);
+        return seq < pos;
+    }
+
+    uavcan::int16_t push(const uavcan::CanFrame& frame, uavcan::MonotonicTime tx_deadline, uavcan::CanIOFlags flags,
+                         uavcan::uint8_t iface_index)
+    {
+        SharedCanBus::Record rec;
+        SharedCanBus::toRecord(frame, rec);
+        rec.ts_usec = tx_deadline.toUSec();
+        rec.origin = client_id_;
+        rec.flags = flags;
+        rec.iface_index = iface_index;
+
+        uavcan::uint64_t pos = __atomic_load_n(&layout_->tx_head, __ATOMIC_RELAXED);
+        while (true)
+        {
+            SharedCanBus::Slot& slot = layout_->tx[pos & (SharedCanBus::TxCapacity - 1U)];
+            const uavcan::uint64_t seq = __atomic_load_n(&slot.seq, __ATOMIC_ACQUIRE);
+            if (seq < pos)
+            {
+                return 0;                           // Full
+            }
+            if (seq == pos)
+            {
+                if (__atomic_compare_exchange_n(&layout_->tx_head, &pos, pos + 1U, false,
+                                                __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                {
+                    SharedCanBus::storeRecord(slot, rec);
+                    __atomic_store_n(&slot.seq, pos + 1U, __ATOMIC_RELEASE);
+                    return 1;
+                }
+            }
+            else
+            {
+                pos = __atomic_load_n(&layout_->tx_head, __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    uavcan::CanSelectMasks getReadyMasks(const uavcan::CanSelectMasks& requested)
+    {
+        uavcan::CanSelectMasks out;
+        if (fetch())
+        {
+            out.read = uavcan::uint8_t(requested.read & (1U << next_.iface_index));
+        }
+        if (!isTxRingFull())
+        {
+            out.write = uavcan::uint8_t(requested.write & ((1U << num_ifaces_) - 1U));
+        }
+        return out;
+    }
+
+public:
+    explicit SharedCanBusDriver(const uavcan::ISystemClock& clock)
+        : clock_(clock)
+        , layout_(UAVCAN_NULLPTR)
+        , num_ifaces_(0)
+        , client_id_(0)
+        , cursor_(0)
+        , has_next_(false)
+        , num_rx_overruns_(0)
+    {
+        (void)std::memset(&next_, 0, sizeof(next_));
+    }
+
+    virtual ~SharedCanBusDriver()
+    {
+        for (unsigned i = 0; i < uavcan::MaxCanIfaces; i++)
+        {
+            ifaces_[i].destroy();
+        }
+        SharedCanBus::unmap(layout_);
+    }
+
+    /**
+     * Attaches to the segment created by the owner. The frames published before this call are not received.
+     * Returns negative errno; -EAGAIN if the owner has not initialized the segment yet.
+     */
+    int init(const char* name)
+    {
+        if (layout_ != UAVCAN_NULLPTR)
+        {
+            return -EALREADY;
+        }
+        SharedCanBus::Layout* const layout = SharedCanBus::map(name, false);
+        if (layout == UAVCAN_NULLPTR)
+        {
+            return -errno;
+        }
+        if (__atomic_load_n(&layout->magic, __ATOMIC_ACQUIRE) != uavcan::uint32_t(SharedCanBus::Magic))
+        {
+            SharedCanBus::unmap(layout);
+            return -EAGAIN;
+        }
+        if (layout->size != sizeof(SharedCanBus::Layout))
+        {
+            SharedCanBus::unmap(layout);
+            return -EPROTO;
+        }
+        layout_ = layout;
+        num_ifaces_ = uavcan::min(layout->num_ifaces, uavcan::uint8_t(uavcan::MaxCanIfaces));
+        client_id_ = __atomic_fetch_add(&layout->next_client_id, 1U, __ATOMIC_RELAXED);
+        cursor_ = __atomic_load_n(&layout->rx_head, __ATOMIC_ACQUIRE);
+        for (uavcan::uint8_t i = 0; i < num_ifaces_; i++)
+        {
+            ifaces_[i].construct<SharedCanBusDriver&, uavcan::uint8_t>(*this, i);
+        }
+        return 0;
+    }
+
+    virtual Iface* getIface(uavcan::uint8_t iface_index)
+    {
+        return (iface_index < num_ifaces_) ? static_cast<Iface*>(ifaces_[iface_index]) : UAVCAN_NULLPTR;
+    }
+
+    virtual uavcan::uint8_t getNumIfaces() const { return num_ifaces_; }
+
+    virtual uavcan::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                                   const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                                   uavcan::MonotonicTime blocking_deadline)
+    {
+        if (layout_ == UAVCAN_NULLPTR)
+        {
+            return -uavcan::ErrNotInited;
+        }
+
+        uavcan::CanSelectMasks out = getReadyMasks(inout_masks);
+        while (((out.read | out.write) == 0) && !blocking_deadline.isZero())
+        {
+            const uavcan::int64_t timeout_usec = (blocking_deadline - clock_.getMonotonic()).toUSec();
+            if (timeout_usec <= 0)
+            {
+                break;
+            }
+            // The waiter is registered before the final check, so that a notification can't be missed
+            const uavcan::uint32_t event = __atomic_load_n(&layout_->event_counter, __ATOMIC_ACQUIRE);
+            (void)__atomic_add_fetch(&layout_->num_waiters, 1U, __ATOMIC_SEQ_CST);
+            out = getReadyMasks(inout_masks);
+            if ((out.read | out.write) == 0)
+            {
+                SharedCanBus::waitForEvent(*layout_, event, timeout_usec);
+                out = getReadyMasks(inout_masks);
+            }
+            (void)__atomic_sub_fetch(&layout_->num_waiters, 1U, __ATOMIC_SEQ_CST);
+        }
+
+        inout_masks = out;
+        return uavcan::int16_t(((out.read | out.write) != 0) ? 1 : 0);
+    }
+
+    uavcan::uint64_t getErrorCount(uavcan::uint8_t iface_index) const
+    {
+        return (iface_index < num_ifaces_) ? __atomic_load_n(&layout_->error_counts[iface_index], __ATOMIC_RELAXED)
+                                           : 0;
+    }
+
+    /**
+     * Number of times this client has fallen behind the owner and lost frames.
+     */
+    uavcan::uint64_t getNumRxOverruns() const { return num_rx_overruns_; }
+};
+
+}
+
+#endif // Include guard
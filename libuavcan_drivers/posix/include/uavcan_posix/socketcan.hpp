@@ -0,0 +1,781 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_SOCKETCAN_HPP_INCLUDED
+#define UAVCAN_POSIX_SOCKETCAN_HPP_INCLUDED
+
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <net/if.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <linux/can/error.h>
+#include <linux/net_tstamp.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+
+#include <uavcan/driver/can.hpp>
+#include <uavcan/driver/system_clock.hpp>
+#include <uavcan/util/lazy_constructor.hpp>
+
+namespace uavcan_posix
+{
+/**
+ * Part of the SocketCAN interfaces that doesn't depend on how the frames are exchanged with the kernel: the socket,
+ * the conversion of the frames and their timestamps, the loopback frames, the kernel filters and the error counter.
+ *
+ * The reception timestamps are taken by the kernel via SO_TIMESTAMPING and converted to the monotonic and UTC time
+ * of the system clock of the library; the hardware timestamps can be used instead if the clock of the CAN adapter
+ * is synchronized with the system time, see @ref setUseHardwareTimestamps().
+ *
+ * The hardware filters of the library are installed as kernel filters (CAN_RAW_FILTER), so the frames that are not
+ * needed are dropped before they are copied to the user space. The loopback frames are the own frames echoed by
+ * the kernel, so their timestamps are the actual transmission times.
+ */
+class SocketCanIfaceBase : public uavcan::ICanIface, uavcan::Noncopyable
+{
+public:
+    /// Maximum number of kernel filters.
+    enum { MaxFilters = 64 };
+
+private:
+    /// Own frames that have been sent with the loopback flag and are not echoed yet.
+    enum { MaxPendingLoopbackFrames = 16 };
+
+    /// Bus errors that are counted; arbitration loss is not an error.
+    enum
+    {
+        CountedErrors = CAN_ERR_TX_TIMEOUT | CAN_ERR_CRTL | CAN_ERR_PROT | CAN_ERR_TRX | CAN_ERR_ACK |
+                        CAN_ERR_BUSOFF | CAN_ERR_BUSERROR
+    };
+
+    bool use_hardware_timestamps_;
+    uavcan::uint64_t error_count_;
+    uavcan::uint32_t pending_loopback_ids_[MaxPendingLoopbackFrames];
+    unsigned num_pending_loopback_;
+
+    static ::canid_t makeSocketCanID(uavcan::uint32_t id)
+    {
+        ::canid_t out = id & uavcan::CanFrame::MaskExtID;
+        if (id & uavcan::CanFrame::FlagEFF)
+        {
+            out |= CAN_EFF_FLAG;
+        }
+        if (id & uavcan::CanFrame::FlagRTR)
+        {
+            out |= CAN_RTR_FLAG;
+        }
+        return out;
+    }
+
+    /**
+     * Returns false if the frame is to be ignored.
+     */
+    static bool fromSocketCanFrame(const ::canfd_frame& frame, unsigned size, uavcan::CanFrame& out)
+    {
+        bool canfd = false;
+        if (size == CANFD_MTU)
+        {
+            canfd = true;
+        }
+        else if ((size != CAN_MTU) || (frame.len > 8))
+        {
+            return false;
+        }
+#if !UAVCAN_SUPPORT_CANFD
+        if (canfd)
+        {
+            return false;
+        }
+#endif
+
+        if (frame.can_id & CAN_EFF_FLAG)
+        {
+            out.id = (frame.can_id & CAN_EFF_MASK) | uavcan::CanFrame::FlagEFF;
+        }
+        else
+        {
+            out.id = frame.can_id & CAN_SFF_MASK;
+        }
+        if (frame.can_id & CAN_RTR_FLAG)
+        {
+            out.id |= uavcan::CanFrame::FlagRTR;
+        }
+        out.canfd = canfd;
+        out.dlc = canfd ? uavcan::CanFrame::dataLengthToDlc(frame.len) : frame.len;
+        const uavcan::uint8_t len = uavcan::CanFrame::dlcToDataLength(out.dlc);
+        (void)std::memcpy(out.data, frame.data, len);
+        (void)std::memset(out.data + len, 0, unsigned(uavcan::CanFrame::MaxDataLen) - len);
+        return true;
+    }
+
+    /**
+     * Returns true if the own frame has been sent with the loopback flag.
+     */
+    bool acceptLoopbackFrame(uavcan::uint32_t id)
+    {
+        for (unsigned i = 0; i < num_pending_loopback_; i++)
+        {
+            if (pending_loopback_ids_[i] == id)
+            {
+                (void)std::memmove(pending_loopback_ids_ + i, pending_loopback_ids_ + i + 1,
+                                   sizeof(pending_loopback_ids_[0]) * (num_pending_loopback_ - i - 1));
+                num_pending_loopback_--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * The kernel timestamps are in the real time of the system; the age of the frame is subtracted from the
+     * current time of the library clock, so that the library clock may be adjusted independently.
+     */
+    void computeTimestamps(::msghdr& hdr, const ::timespec& now_realtime, uavcan::MonotonicTime now_mono,
+                           uavcan::UtcTime now_utc, uavcan::CanRxFrame& out) const
+    {
+        const ::timespec* ts = UAVCAN_NULLPTR;
+        for (::cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != UAVCAN_NULLPTR; cmsg = CMSG_NXTHDR(&hdr, cmsg))
+        {
+            if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_TIMESTAMPING))
+            {
+                const ::timespec* const stamps = reinterpret_cast<const ::timespec*>(CMSG_DATA(cmsg));
+                ts = &stamps[0];
+                if (use_hardware_timestamps_ && ((stamps[2].tv_sec != 0) || (stamps[2].tv_nsec != 0)))
+                {
+                    ts = &stamps[2];
+                }
+            }
+        }
+
+        uavcan::int64_t age_usec = 0;
+        if (ts != UAVCAN_NULLPTR)
+        {
+            age_usec = (uavcan::int64_t(now_realtime.tv_sec) - uavcan::int64_t(ts->tv_sec)) * 1000000 +
+                       (uavcan::int64_t(now_realtime.tv_nsec) - uavcan::int64_t(ts->tv_nsec)) / 1000;
+            if (age_usec < 0)
+            {
+                age_usec = 0;
+            }
+        }
+        out.ts_mono = now_mono - uavcan::MonotonicDuration::fromUSec(age_usec);
+        out.ts_utc = now_utc.isZero() ? uavcan::UtcTime() : (now_utc - uavcan::UtcDuration::fromUSec(age_usec));
+    }
+
+protected:
+    /// Enough for the timestamps of one frame.
+    enum { ControlBufferSize = CMSG_SPACE(sizeof(::timespec) * 3) };
+
+    union ControlBuffer
+    {
+        ::cmsghdr align;
+        char data[ControlBufferSize];
+    };
+
+    /**
+     * Current time, taken once per batch of received frames.
+     */
+    struct NowTimestamps
+    {
+        ::timespec realtime;
+        uavcan::MonotonicTime mono;
+        uavcan::UtcTime utc;
+
+        explicit NowTimestamps(const uavcan::ISystemClock& clock)
+        {
+            (void)::clock_gettime(CLOCK_REALTIME, &realtime);
+            mono = clock.getMonotonic();
+            utc = clock.getUtc();
+        }
+    };
+
+    const uavcan::ISystemClock& clock_;
+    const int fd_;
+    const bool canfd_;
+
+    static bool isTemporaryError(int error)
+    {
+        return (error == EAGAIN) || (error == EWOULDBLOCK) || (error == ENOBUFS) || (error == EINTR);
+    }
+
+    /**
+     * Returns the number of bytes to write; zero if the frame can't be sent through this socket.
+     */
+    unsigned toSocketCanFrame(const uavcan::CanFrame& frame, ::canfd_frame& out) const
+    {
+        (void)std::memset(&out, 0, sizeof(out));
+        out.can_id = makeSocketCanID(frame.id);
+        const uavcan::uint8_t len = uavcan::CanFrame::dlcToDataLength(frame.dlc);
+        out.len = len;
+        (void)std::memcpy(out.data, frame.data, len);
+#if UAVCAN_SUPPORT_CANFD
+        if (frame.isCanFDFrame())
+        {
+            if (!canfd_)
+            {
+                return 0;
+            }
+            out.flags = CANFD_BRS;
+            return CANFD_MTU;
+        }
+#endif
+        return CAN_MTU;
+    }
+
+    void registerLoopbackFrame(uavcan::uint32_t id)
+    {
+        if (num_pending_loopback_ >= MaxPendingLoopbackFrames)
+        {
+            // The oldest one must have been lost
+            (void)std::memmove(pending_loopback_ids_, pending_loopback_ids_ + 1,
+                               sizeof(pending_loopback_ids_[0]) * (MaxPendingLoopbackFrames - 1));
+            num_pending_loopback_--;
+        }
+        pending_loopback_ids_[num_pending_loopback_++] = id;
+    }
+
+    /**
+     * Converts a frame received from the socket, together with its control messages and flags.
+     * Returns false if the frame is not to be passed to the library, e.g. an error frame.
+     */
+    bool processReceivedFrame(const ::canfd_frame& raw, unsigned size, ::msghdr& hdr, const NowTimestamps& now,
+                              uavcan::CanRxFrame& out_frame, uavcan::CanIOFlags& out_flags)
+    {
+        if (raw.can_id & CAN_ERR_FLAG)
+        {
+            if (raw.can_id & CountedErrors)
+            {
+                error_count_++;
+            }
+            return false;
+        }
+        if (!fromSocketCanFrame(raw, size, out_frame))
+        {
+            return false;
+        }
+        out_flags = 0;
+        if ((hdr.msg_flags & MSG_CONFIRM) != 0)
+        {
+            if (!acceptLoopbackFrame(out_frame.id))
+            {
+                return false;           // Own frame that has been sent without the loopback flag
+            }
+            out_flags = uavcan::CanIOFlagLoopback;
+        }
+        computeTimestamps(hdr, now.realtime, now.mono, now.utc, out_frame);
+        return true;
+    }
+
+public:
+    /**
+     * Use @ref openSocket() to obtain the socket; this object takes ownership of it.
+     */
+    SocketCanIfaceBase(const uavcan::ISystemClock& clock, int socket_fd, bool canfd)
+        : use_hardware_timestamps_(false)
+        , error_count_(0)
+        , num_pending_loopback_(0)
+        , clock_(clock)
+        , fd_(socket_fd)
+        , canfd_(canfd)
+    {
+        UAVCAN_ASSERT(fd_ >= 0);
+    }
+
+    virtual ~SocketCanIfaceBase()
+    {
+        (void)::close(fd_);
+    }
+
+    /**
+     * Opens and configures a non-blocking raw CAN socket bound to the given interface, e.g. "can0".
+     * CAN FD frames are enabled if requested and supported by the library.
+     * Returns the socket descriptor or negative errno.
+     */
+    static int openSocket(const char* iface_name, bool canfd)
+    {
+        if ((iface_name == UAVCAN_NULLPTR) || (std::strlen(iface_name) >= IFNAMSIZ))
+        {
+            return -EINVAL;
+        }
+
+        const int fd = ::socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, CAN_RAW);
+        if (fd < 0)
+        {
+            return -errno;
+        }
+
+        ::ifreq ifr;
+        (void)std::memset(&ifr, 0, sizeof(ifr));
+        (void)std::strncpy(ifr.ifr_name, iface_name, IFNAMSIZ - 1);
+        int rv = (::ioctl(fd, SIOCGIFINDEX, &ifr) < 0) ? -errno : 0;
+
+        const int on = 1;
+        const int timestamping = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+                                 SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+        const ::can_err_mask_t err_mask = CountedErrors;
+        if ((rv == 0) &&
+            ((::setsockopt(fd, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, &on, sizeof(on)) < 0) ||
+             (::setsockopt(fd, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &err_mask, sizeof(err_mask)) < 0) ||
+             (::setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &timestamping, sizeof(timestamping)) < 0)))
+        {
+            rv = -errno;
+        }
+#if UAVCAN_SUPPORT_CANFD
+        if ((rv == 0) && canfd && (::setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &on, sizeof(on)) < 0))
+        {
+            rv = -errno;
+        }
+#else
+        (void)canfd;
+#endif
+
+        if (rv == 0)
+        {
+            ::sockaddr_can addr;
+            (void)std::memset(&addr, 0, sizeof(addr));
+            addr.can_family = AF_CAN;
+            addr.can_ifindex = ifr.ifr_ifindex;
+            if (::bind(fd, reinterpret_cast< ::sockaddr*>(&addr), sizeof(addr)) < 0)
+            {
+                rv = -errno;
+            }
+        }
+
+        if (rv < 0)
+        {
+            (void)::close(fd);
+            return rv;
+        }
+        return fd;
+    }
+
+    /**
+     * The filters are installed in the kernel. No filters means that all frames are accepted.
+     */
+    virtual uavcan::int16_t configureFilters(const uavcan::CanFilterConfig* filter_configs,
+                                             uavcan::uint16_t num_configs)
+    {
+        if ((num_configs > MaxFilters) || ((filter_configs == UAVCAN_NULLPTR) && (num_configs > 0)))
+        {
+            return -uavcan::ErrInvalidParam;
+        }
+
+        ::can_filter filters[MaxFilters];
+        unsigned num_filters = num_configs;
+        for (unsigned i = 0; i < num_configs; i++)
+        {
+            filters[i].can_id = makeSocketCanID(filter_configs[i].id);
+            filters[i].can_mask = makeSocketCanID(filter_configs[i].mask);
+        }
+        if (num_filters == 0)
+        {
+            filters[0].can_id = 0;
+            filters[0].can_mask = 0;
+            num_filters = 1;
+        }
+
+        if (::setsockopt(fd_, SOL_CAN_RAW, CAN_RAW_FILTER, filters, socklen_t(sizeof(filters[0]) * num_filters)) < 0)
+        {
+            return -uavcan::ErrDriver;
+        }
+        return 0;
+    }
+
+    virtual uavcan::uint16_t getNumFilters() const { return MaxFilters; }
+
+    /**
+     * Bus errors reported by the controller via error frames.
+     */
+    virtual uavcan::uint64_t getErrorCount() const { return error_count_; }
+
+    /**
+     * Makes the reception timestamps be taken from the CAN adapter, if it provides them. This is only correct
+     * if the clock of the adapter is synchronized with the system real time clock, e.g. by phc2sys.
+     */
+    void setUseHardwareTimestamps(bool use) { use_hardware_timestamps_ = use; }
+
+    /**
+     * The frame is written into the socket directly, bypassing the TX queue of the library; see
+     * @ref uavcan::ICanIface::sendEmergency(). This only takes a write() call, which is safe to invoke from any
+     * thread or from a signal handler. The kernel queue of the interface is FIFO unless a priority queueing
+     * discipline is configured for it, so the frame can't overtake the frames that are already in that queue.
+     */
+    virtual uavcan::int16_t sendEmergency(const uavcan::CanFrame& frame)
+    {
+        ::canfd_frame raw;
+        const unsigned size = toSocketCanFrame(frame, raw);
+        if (size == 0)
+        {
+            return -uavcan::ErrInvalidParam;
+        }
+        const ssize_t res = ::write(fd_, &raw, size);
+        if (res < 0)
+        {
+            return isTemporaryError(errno) ? 0 : -uavcan::ErrDriver;
+        }
+        return 1;
+    }
+
+    bool isCanFDEnabled() const { return canfd_; }
+
+    int getFileDescriptor() const { return fd_; }
+};
+
+/**
+ * Non-blocking SocketCAN interface.
+ *
+ * The frames are exchanged with the kernel in batches, up to @ref MaxBatchSize frames per recvmmsg() or sendmmsg()
+ * call, so that the library can drain a burst of frames with one system call. CAN FD frames are supported if the
+ * library is built with UAVCAN_SUPPORT_CANFD and the interface is opened with CAN FD enabled.
+ */
+class SocketCanIface : public SocketCanIfaceBase
+{
+public:
+    /// Maximum number of frames exchanged with the kernel per system call.
+    enum { MaxBatchSize = 32 };
+
+private:
+    ::canfd_frame buffers_[MaxBatchSize];
+    ::iovec iovecs_[MaxBatchSize];
+    ::mmsghdr messages_[MaxBatchSize];
+    ControlBuffer controls_[MaxBatchSize];
+
+    void prepareMessage(unsigned index, unsigned size, bool with_control)
+    {
+        iovecs_[index].iov_base = &buffers_[index];
+        iovecs_[index].iov_len = size;
+        ::msghdr& hdr = messages_[index].msg_hdr;
+        (void)std::memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_iov = &iovecs_[index];
+        hdr.msg_iovlen = 1;
+        if (with_control)
+        {
+            hdr.msg_control = controls_[index].data;
+            hdr.msg_controllen = sizeof(controls_[index].data);
+        }
+        messages_[index].msg_len = 0;
+    }
+
+    /**
+     * Fetches the frames that are already in the socket buffer; returns zero only if there are none.
+     */
+    int readFrames(uavcan::CanRxFrame* out_frames, uavcan::CanIOFlags* out_flags, unsigned max_frames)
+    {
+        const unsigned batch = uavcan::min(max_frames, unsigned(MaxBatchSize));
+        while (true)
+        {
+            for (unsigned i = 0; i < batch; i++)
+            {
+                prepareMessage(i, sizeof(buffers_[i]), true);
+            }
+            const int res = ::recvmmsg(fd_, messages_, batch, MSG_DONTWAIT, UAVCAN_NULLPTR);
+            if (res <= 0)
+            {
+                return ((res == 0) || isTemporaryError(errno)) ? 0 : -uavcan::ErrDriver;
+            }
+
+            const NowTimestamps now(clock_);
+            unsigned num_out = 0;
+            for (unsigned i = 0; i < unsigned(res); i++)
+            {
+                if (processReceivedFrame(buffers_[i], messages_[i].msg_len, messages_[i].msg_hdr, now,
+                                         out_frames[num_out], out_flags[num_out]))
+                {
+                    num_out++;
+                }
+            }
+
+            if ((num_out > 0) || (unsigned(res) < batch))
+            {
+                return int(num_out);
+            }
+        }
+    }
+
+public:
+    SocketCanIface(const uavcan::ISystemClock& clock, int socket_fd, bool canfd)
+        : SocketCanIfaceBase(clock, socket_fd, canfd)
+    { }
+
+    virtual uavcan::int16_t send(const uavcan::CanFrame& frame, uavcan::MonotonicTime tx_deadline,
+                                 uavcan::CanIOFlags flags)
+    {
+        const uavcan::CanFrame* const frames[] = { &frame };
+        return sendBatch(frames, &tx_deadline, &flags, 1);
+    }
+
+    /**
+     * The frames whose deadlines have expired are discarded and reported as accepted.
+     */
+    virtual uavcan::int16_t sendBatch(const uavcan::CanFrame* const* frames, const uavcan::MonotonicTime* tx_deadlines,
+                                      const uavcan::CanIOFlags* flags, uavcan::uint16_t num_frames)
+    {
+        if ((frames == UAVCAN_NULLPTR) || (tx_deadlines == UAVCAN_NULLPTR) || (flags == UAVCAN_NULLPTR))
+        {
+            UAVCAN_ASSERT(0);
+            return -uavcan::ErrInvalidParam;
+        }
+
+        const unsigned num_considered = uavcan::min(unsigned(num_frames), unsigned(MaxBatchSize));
+        const uavcan::MonotonicTime now = clock_.getMonotonic();
+        unsigned frame_indices[MaxBatchSize];
+        unsigned num_messages = 0;
+        for (unsigned i = 0; i < num_considered; i++)
+        {
+            if (tx_deadlines[i] <= now)
+            {
+                continue;
+            }
+            const unsigned size = toSocketCanFrame(*frames[i], buffers_[num_messages]);
+            if (size == 0)
+            {
+                return -uavcan::ErrInvalidParam;
+            }
+            prepareMessage(num_messages, size, false);
+            frame_indices[num_messages] = i;
+            num_messages++;
+        }
+        if (num_messages == 0)
+        {
+            return uavcan::int16_t(num_considered);
+        }
+
+        const int res = ::sendmmsg(fd_, messages_, num_messages, MSG_DONTWAIT);
+        if ((res < 0) && !isTemporaryError(errno))
+        {
+            return -uavcan::ErrDriver;
+        }
+        const unsigned num_sent = (res < 0) ? 0U : unsigned(res);
+
+        for (unsigned i = 0; i < num_sent; i++)
+        {
+            if (flags[frame_indices[i]] & uavcan::CanIOFlagLoopback)
+            {
+                registerLoopbackFrame(frames[frame_indices[i]]->id);
+            }
+        }
+        // All frames up to the first one that has not been sent are either sent or discarded
+        return uavcan::int16_t((num_sent < num_messages) ? frame_indices[num_sent] : num_considered);
+    }
+
+    virtual uavcan::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                                    uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags)
+    {
+        uavcan::CanRxFrame frame;
+        const int res = readFrames(&frame, &out_flags, 1);
+        if (res > 0)
+        {
+            out_frame = frame;
+            out_ts_monotonic = frame.ts_mono;
+            out_ts_utc = frame.ts_utc;
+        }
+        return uavcan::int16_t(res);
+    }
+
+    virtual uavcan::int16_t receiveBatch(uavcan::CanRxFrame* out_frames, uavcan::CanIOFlags* out_flags,
+                                         uavcan::uint16_t max_frames)
+    {
+        if ((out_frames == UAVCAN_NULLPTR) || (out_flags == UAVCAN_NULLPTR) || (max_frames == 0))
+        {
+            UAVCAN_ASSERT(0);
+            return 0;
+        }
+        return uavcan::int16_t(readFrames(out_frames, out_flags, max_frames));
+    }
+};
+
+/**
+ * SocketCAN driver for several redundant interfaces:
+ *
+ *      uavcan_posix::SocketCanDriver driver(clock);
+ *      if ((driver.init() < 0) || (driver.addIface("can0") < 0) || (driver.addIface("can1") < 0))
+ *      {
+ *          ...
+ *      }
+ *      uavcan::Node<16384> node(driver, clock);
+ *
+ * The interfaces are waited for with one epoll instance; the events that are not requested by the library are
+ * removed from the epoll set, so that e.g. an interface that is ready for writing does not wake up the node while
+ * there is nothing to transmit.
+ */
+class SocketCanDriver : public uavcan::ICanDriver, uavcan::Noncopyable
+{
+    const uavcan::ISystemClock& clock_;
+    uavcan::LazyConstructor<SocketCanIface> ifaces_[uavcan::MaxCanIfaces];
+    uavcan::uint32_t epoll_events_[uavcan::MaxCanIfaces];     ///< As currently registered
+    uavcan::uint8_t num_ifaces_;
+    int epoll_fd_;
+
+    int updateEpollEvents(uavcan::uint8_t iface_index, uavcan::uint32_t events)
+    {
+        if (epoll_events_[iface_index] == events)
+        {
+            return 0;
+        }
+        ::epoll_event ev;
+        (void)std::memset(&ev, 0, sizeof(ev));
+        ev.events = events;
+        ev.data.u32 = iface_index;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, ifaces_[iface_index]->getFileDescriptor(), &ev) < 0)
+        {
+            return -uavcan::ErrDriver;
+        }
+        epoll_events_[iface_index] = events;
+        return 0;
+    }
+
+public:
+    explicit SocketCanDriver(const uavcan::ISystemClock& clock)
+        : clock_(clock)
+        , num_ifaces_(0)
+        , epoll_fd_(-1)
+    {
+        for (unsigned i = 0; i < uavcan::MaxCanIfaces; i++)
+        {
+            epoll_events_[i] = 0;
+        }
+    }
+
+    virtual ~SocketCanDriver()
+    {
+        for (unsigned i = 0; i < uavcan::MaxCanIfaces; i++)
+        {
+            ifaces_[i].destroy();
+        }
+        if (epoll_fd_ >= 0)
+        {
+            (void)::close(epoll_fd_);
+        }
+    }
+
+    /**
+     * Returns negative errno.
+     */
+    int init()
+    {
+        if (epoll_fd_ < 0)
+        {
+            epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        }
+        return (epoll_fd_ < 0) ? -errno : 0;
+    }
+
+    /**
+     * Opens the interface, e.g. "can0", see @ref SocketCanIface::openSocket().
+     * The interfaces are indexed in the order they are added.
+     * Returns the index of the interface or negative errno.
+     */
+    int addIface(const char* iface_name, bool canfd = bool(UAVCAN_SUPPORT_CANFD))
+    {
+        if (epoll_fd_ < 0)
+        {
+            return -EBADF;
+        }
+        if (num_ifaces_ >= uavcan::MaxCanIfaces)
+        {
+            return -EMFILE;
+        }
+
+        const int fd = SocketCanIface::openSocket(iface_name, canfd);
+        if (fd < 0)
+        {
+            return fd;
+        }
+
+        ::epoll_event ev;
+        (void)std::memset(&ev, 0, sizeof(ev));
+        ev.events = 0;
+        ev.data.u32 = num_ifaces_;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0)
+        {
+            const int rv = -errno;
+            (void)::close(fd);
+            return rv;
+        }
+
+        ifaces_[num_ifaces_].construct<const uavcan::ISystemClock&, int, bool>(clock_, fd, canfd);
+        epoll_events_[num_ifaces_] = 0;
+        return num_ifaces_++;
+    }
+
+    virtual SocketCanIface* getIface(uavcan::uint8_t iface_index)
+    {
+        return (iface_index < num_ifaces_) ? static_cast<SocketCanIface*>(ifaces_[iface_index]) : UAVCAN_NULLPTR;
+    }
+
+    virtual uavcan::uint8_t getNumIfaces() const { return num_ifaces_; }
+
+    /**
+     * The socket of the interface, for the applications that run the node from their own event loop, see
+     * uavcan::Scheduler::getNextDeadline(). Returns -1 if the index is out of range.
+     */
+    int getFileDescriptor(uavcan::uint8_t iface_index) const
+    {
+        return (iface_index < num_ifaces_) ? ifaces_[iface_index]->getFileDescriptor() : -1;
+    }
+
+    virtual uavcan::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                                   const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                                   uavcan::MonotonicTime blocking_deadline)
+    {
+        for (uavcan::uint8_t i = 0; i < num_ifaces_; i++)
+        {
+            uavcan::uint32_t events = 0;
+            if (inout_masks.read & (1U << i))
+            {
+                events |= EPOLLIN;
+            }
+            if (inout_masks.write & (1U << i))
+            {
+                events |= EPOLLOUT;
+            }
+            if (updateEpollEvents(i, events) < 0)
+            {
+                return -uavcan::ErrDriver;
+            }
+        }
+
+        int timeout_msec = 0;
+        if (!blocking_deadline.isZero())
+        {
+            const uavcan::int64_t timeout_usec = (blocking_deadline - clock_.getMonotonic()).toUSec();
+            if (timeout_usec > 0)
+            {
+                timeout_msec = int(uavcan::min<uavcan::int64_t>((timeout_usec + 999) / 1000, 0x7FFFFFFF));
+            }
+        }
+
+        ::epoll_event events[uavcan::MaxCanIfaces];
+        const int res = ::epoll_wait(epoll_fd_, events, uavcan::MaxCanIfaces, timeout_msec);
+        if ((res < 0) && (errno != EINTR))
+        {
+            return -uavcan::ErrDriver;
+        }
+
+        inout_masks = uavcan::CanSelectMasks();
+        for (int i = 0; i < res; i++)
+        {
+            const uavcan::uint32_t index = events[i].data.u32;
+            if (events[i].events & (EPOLLIN | EPOLLERR))
+            {
+                inout_masks.read = uavcan::uint8_t(inout_masks.read | (1U << index));
+            }
+            if (events[i].events & EPOLLOUT)
+            {
+                inout_masks.write = uavcan::uint8_t(inout_masks.write | (1U << index));
+            }
+        }
+        return uavcan::int16_t((res < 0) ? 0 : res);
+    }
+};
+
+}
+
+#endif // Include guard
@@ -0,0 +1,248 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_SYSTEM_CLOCK_HPP_INCLUDED
+#define UAVCAN_POSIX_SYSTEM_CLOCK_HPP_INCLUDED
+
+#include <ctime>
+#include <cerrno>
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <cpuid.h>
+# include <x86intrin.h>
+#endif
+
+#include <uavcan/driver/system_clock.hpp>
+#include <uavcan/util/templates.hpp>
+
+namespace uavcan_posix
+{
+/**
+ * System clock for Linux and other POSIX systems.
+ *
+ * The library reads the monotonic time many times per frame, so the monotonic clock is derived from the counter
+ * of the CPU where it is known to be stable: the invariant TSC on x86, or the generic timer on ARMv8 (CNTVCT).
+ * Reading the counter takes a few nanoseconds, without entering the kernel or the vDSO. The counter is converted
+ * to microseconds with a fixed-point rate and re-anchored to CLOCK_MONOTONIC every @ref ReanchorPeriodMs, so
+ * that the error doesn't accumulate; the rate is refined at every re-anchoring. On other systems, or if disabled,
+ * CLOCK_MONOTONIC is read directly. The returned time never goes backwards.
+ *
+ * The UTC time is CLOCK_REALTIME plus the adjustments made by the library, which are private to this object;
+ * the system clock is not modified, so no privileges are required.
+ *
+ * The fast path keeps its state in this object without synchronization, so the object must be used from one
+ * thread only, like the rest of the library.
+ */
+class SystemClock : public uavcan::ISystemClock, uavcan::Noncopyable
+{
+public:
+    enum { ReanchorPeriodMs = 100 };
+
+private:
+    enum { CalibrationPeriodUSec = 10000 };
+    enum { FixedPointShift = 32 };
+
+    bool use_counter_;
+    mutable uavcan::uint64_t anchor_ticks_;
+    mutable uavcan::uint64_t anchor_usec_;
+    mutable uavcan::uint64_t usec_per_tick_;     ///< Fixed point, see FixedPointShift
+    mutable uavcan::uint64_t max_delta_ticks_;   ///< Re-anchoring period in counter ticks
+    mutable uavcan::uint64_t last_usec_;
+    uavcan::int64_t utc_adjustment_usec_;
+
+    static uavcan::uint64_t readOsMonotonicUSec()
+    {
+        ::timespec ts;
+        (void)::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return uavcan::uint64_t(ts.tv_sec) * 1000000ULL + uavcan::uint64_t(ts.tv_nsec / 1000);
+    }
+
+    static bool isCounterAvailable()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+        return (__get_cpuid(0x80000007U, &eax, &ebx, &ecx, &edx) != 0) && ((edx & (1U << 8)) != 0);  // Invariant
+#elif defined(__aarch64__)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static uavcan::uint64_t readCounter()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return uavcan::uint64_t(__rdtsc());
+#elif defined(__aarch64__)
+        uavcan::uint64_t value = 0;
+        __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r"(value) : : "memory");
+        return value;
+#else
+        return 0;
+#endif
+    }
+
+    static uavcan::uint64_t getKnownCounterFrequency()
+    {
+#if defined(__aarch64__)
+        uavcan::uint64_t value = 0;
+        __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(value));
+        return value;
+#else
+        return 0;                                   // Has to be measured
+#endif
+    }
+
+    /**
+     * Samples the counter and the OS clock at the same instant, approximately.
+     */
+    static void sampleAnchor(uavcan::uint64_t& out_ticks, uavcan::uint64_t& out_usec)
+    {
+        const uavcan::uint64_t before = readCounter();
+        out_usec = readOsMonotonicUSec();
+        const uavcan::uint64_t after = readCounter();
+        out_ticks = before + (after - before) / 2U;
+    }
+
+    void calibrate()
+    {
+        uavcan::uint64_t start_ticks = 0;
+        uavcan::uint64_t start_usec = 0;
+        sampleAnchor(start_ticks, start_usec);
+
+        const uavcan::uint64_t known_frequency = getKnownCounterFrequency();
+        if (known_frequency > 0)
+        {
+            usec_per_tick_ = (1000000ULL << FixedPointShift) / known_frequency;
+        }
+        else
+        {
+            ::timespec delay;
+            delay.tv_sec = 0;
+            delay.tv_nsec = long(CalibrationPeriodUSec) * 1000L;
+            while ((::nanosleep(&delay, &delay) != 0) && (errno == EINTR)) { }
+
+            uavcan::uint64_t end_ticks = 0;
+            uavcan::uint64_t end_usec = 0;
+            sampleAnchor(end_ticks, end_usec);
+            if ((end_ticks <= start_ticks) || (end_usec <= start_usec))
+            {
+                use_counter_ = false;
+                return;
+            }
+            usec_per_tick_ = ((end_usec - start_usec) << FixedPointShift) / (end_ticks - start_ticks);
+        }
+
+        if (usec_per_tick_ == 0)                    // Faster than 4 THz, surely broken
+        {
+            use_counter_ = false;
+            return;
+        }
+        max_delta_ticks_ = (uavcan::uint64_t(ReanchorPeriodMs) * 1000ULL << FixedPointShift) / usec_per_tick_;
+        anchor_ticks_ = start_ticks;
+        anchor_usec_ = start_usec;
+    }
+
+    void reanchor() const
+    {
+        uavcan::uint64_t ticks = 0;
+        uavcan::uint64_t usec = 0;
+        sampleAnchor(ticks, usec);
+        const uavcan::uint64_t elapsed_ticks = ticks - anchor_ticks_;
+        const uavcan::uint64_t elapsed_usec = usec - anchor_usec_;
+        // The rate measured over a short or an overly long interval (e.g. after a suspend) is not reliable
+        if ((elapsed_ticks >= max_delta_ticks_) && (elapsed_ticks < (max_delta_ticks_ * 2U)) && (elapsed_usec > 0))
+        {
+            const uavcan::uint64_t measured = (elapsed_usec << FixedPointShift) / elapsed_ticks;
+            usec_per_tick_ = (usec_per_tick_ * 7U + measured) / 8U;
+        }
+        anchor_ticks_ = ticks;
+        anchor_usec_ = usec;
+    }
+
+    uavcan::uint64_t getMonotonicUSec() const
+    {
+        uavcan::uint64_t usec = 0;
+        if (use_counter_)
+        {
+            const uavcan::uint64_t ticks = readCounter();
+            const uavcan::uint64_t delta = ticks - anchor_ticks_;
+            if (delta >= max_delta_ticks_)
+            {
+                reanchor();
+                usec = anchor_usec_;
+            }
+            else
+            {
+                usec = anchor_usec_ + ((delta * usec_per_tick_) >> FixedPointShift);
+            }
+        }
+        else
+        {
+            usec = readOsMonotonicUSec();
+        }
+        last_usec_ = uavcan::max(last_usec_, usec);
+        return last_usec_;
+    }
+
+public:
+    /**
+     * @param use_cpu_counter       Use the CPU counter if it's suitable; CLOCK_MONOTONIC is used otherwise.
+     *                              The calibration takes up to 10 ms on x86.
+     */
+    explicit SystemClock(bool use_cpu_counter = true)
+        : use_counter_(use_cpu_counter && isCounterAvailable())
+        , anchor_ticks_(0)
+        , anchor_usec_(0)
+        , usec_per_tick_(0)
+        , max_delta_ticks_(0)
+        , last_usec_(0)
+        , utc_adjustment_usec_(0)
+    {
+        if (use_counter_)
+        {
+            calibrate();
+        }
+    }
+
+    virtual uavcan::MonotonicTime getMonotonic() const
+    {
+        return uavcan::MonotonicTime::fromUSec(getMonotonicUSec());
+    }
+
+    virtual uavcan::UtcTime getUtc() const
+    {
+        ::timespec ts;
+        (void)::clock_gettime(CLOCK_REALTIME, &ts);
+        const uavcan::int64_t usec = uavcan::int64_t(ts.tv_sec) * 1000000LL + uavcan::int64_t(ts.tv_nsec / 1000);
+        return uavcan::UtcTime::fromUSec(uavcan::uint64_t(usec + utc_adjustment_usec_));
+    }
+
+    virtual void adjustUtc(uavcan::UtcDuration adjustment)
+    {
+        utc_adjustment_usec_ += adjustment.toUSec();
+    }
+
+    /**
+     * Whether the monotonic time comes from the CPU counter rather than from the OS.
+     */
+    bool isUsingCpuCounter() const { return use_counter_; }
+
+    /**
+     * Total adjustment of the UTC time relative to CLOCK_REALTIME.
+     */
+    uavcan::UtcDuration getUtcAdjustment() const { return uavcan::UtcDuration::fromUSec(utc_adjustment_usec_); }
+
+    /**
+     * Fixed-point rate of the CPU counter, in microseconds per tick times 2^32; zero if the counter is not used.
+     */
+    uavcan::uint64_t getCounterRate() const { return use_counter_ ? usec_per_tick_ : 0; }
+};
+
+}
+
+#endif // Include guard
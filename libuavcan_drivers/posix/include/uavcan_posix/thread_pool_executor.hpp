@@ -0,0 +1,265 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_THREAD_POOL_EXECUTOR_HPP_INCLUDED
+#define UAVCAN_POSIX_THREAD_POOL_EXECUTOR_HPP_INCLUDED
+
+#include <sys/eventfd.h>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+#include <uavcan/node/executor.hpp>
+
+namespace uavcan_posix
+{
+/**
+ * Work-stealing thread pool for @ref uavcan::Scheduler::post(), so that the slow operations (file IO, fsync(), ...)
+ * don't block the processing of the frames.
+ *
+ * Every worker thread has its own queue; the posted tasks are distributed over the queues in turn, and a worker
+ * takes the tasks of its own queue in order. A worker whose queue is empty steals a task from the tail of the
+ * longest queue of the other workers, so a long task doesn't hold up the tasks queued behind it while there are
+ * idle workers. The tasks are linked into the queues intrusively, nothing is allocated per task.
+ *
+ * The completed tasks are handed back to the node thread by @ref popCompleted(), which the scheduler polls.
+ * The applications that run the node from an external event loop (see @ref uavcan::Scheduler::processReady())
+ * can watch @ref getCompletionFd() to process the completions without the polling delay.
+ *
+ * The pool must outlive the node. The destructor waits for the queued tasks to be executed.
+ *
+ * Typical use:
+ *
+ *      ThreadPoolExecutor executor;
+ *      executor.init(4);
+ *      node.getScheduler().setExecutor(&executor);
+ */
+class ThreadPoolExecutor : public uavcan::IExecutor, uavcan::Noncopyable
+{
+public:
+    enum { MaxThreads = 16 };
+
+private:
+    typedef uavcan::DoublyLinkedListRoot<uavcan::ExecutorTask> TaskList;
+
+    struct Worker
+    {
+        std::mutex mutex;
+        TaskList queue;
+        std::thread thread;
+    };
+
+    Worker workers_[MaxThreads];
+    unsigned num_threads_;
+    unsigned next_worker_;                  ///< Node thread only
+
+    std::mutex idle_mutex_;
+    std::condition_variable idle_cv_;
+    unsigned num_queued_;                   ///< Guarded by idle_mutex_
+    bool stop_;                             ///< Guarded by idle_mutex_
+
+    std::mutex completed_mutex_;
+    TaskList completed_;
+    int event_fd_;
+
+    std::atomic<uavcan::uint64_t> num_executed_;
+    std::atomic<uavcan::uint64_t> num_stolen_;
+
+    uavcan::ExecutorTask* takeOwn(unsigned index)
+    {
+        std::lock_guard<std::mutex> lock(workers_[index].mutex);
+        uavcan::ExecutorTask* const task = workers_[index].queue.get();
+        workers_[index].queue.remove(task);
+        return task;
+    }
+
+    uavcan::ExecutorTask* steal(unsigned thief)
+    {
+        unsigned victim = thief;
+        unsigned max_length = 0;
+        for (unsigned i = 0; i < num_threads_; i++)
+        {
+            if (i == thief)
+            {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(workers_[i].mutex);
+            if (workers_[i].queue.getLength() > max_length)
+            {
+                victim = i;
+                max_length = workers_[i].queue.getLength();
+            }
+        }
+        if (victim == thief)
+        {
+            return UAVCAN_NULLPTR;
+        }
+        // The queue may have been drained in the meantime
+        std::lock_guard<std::mutex> lock(workers_[victim].mutex);
+        uavcan::ExecutorTask* const task = workers_[victim].queue.getTail();
+        workers_[victim].queue.remove(task);
+        return task;
+    }
+
+    void complete(uavcan::ExecutorTask* task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(completed_mutex_);
+            completed_.pushBack(task);
+        }
+        if (event_fd_ >= 0)
+        {
+            const uavcan::uint64_t one = 1;
+            (void)::write(event_fd_, &one, sizeof(one));
+        }
+    }
+
+    void workerThread(unsigned index)
+    {
+        while (true)
+        {
+            uavcan::ExecutorTask* task = takeOwn(index);
+            if (task == UAVCAN_NULLPTR)
+            {
+                task = steal(index);
+                if (task != UAVCAN_NULLPTR)
+                {
+                    num_stolen_++;
+                }
+            }
+
+            if (task != UAVCAN_NULLPTR)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(idle_mutex_);
+                    num_queued_--;
+                }
+                task->execute();
+                num_executed_++;
+                complete(task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(idle_mutex_);
+            if (stop_ && (num_queued_ == 0))
+            {
+                break;
+            }
+            // The count is updated after the task is queued, so a task can't be missed
+            idle_cv_.wait(lock, [this]() { return stop_ || (num_queued_ > 0); });
+        }
+    }
+
+public:
+    ThreadPoolExecutor()
+        : num_threads_(0)
+        , next_worker_(0)
+        , num_queued_(0)
+        , stop_(false)
+        , event_fd_(-1)
+        , num_executed_(0)
+        , num_stolen_(0)
+    { }
+
+    virtual ~ThreadPoolExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex_);
+            stop_ = true;
+        }
+        idle_cv_.notify_all();
+        for (unsigned i = 0; i < num_threads_; i++)
+        {
+            workers_[i].thread.join();
+        }
+        if (event_fd_ >= 0)
+        {
+            (void)::close(event_fd_);
+        }
+    }
+
+    /**
+     * Starts the worker threads. Returns negative errno.
+     */
+    int init(unsigned num_threads)
+    {
+        if (num_threads_ > 0)
+        {
+            return -EALREADY;
+        }
+        if ((num_threads == 0) || (num_threads > MaxThreads))
+        {
+            return -EINVAL;
+        }
+        event_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (event_fd_ < 0)
+        {
+            return -errno;
+        }
+        num_threads_ = num_threads;             // The workers read it
+        for (unsigned i = 0; i < num_threads; i++)
+        {
+            workers_[i].thread = std::thread(&ThreadPoolExecutor::workerThread, this, i);
+        }
+        return 0;
+    }
+
+    virtual int post(uavcan::ExecutorTask& task) override
+    {
+        if (num_threads_ == 0)
+        {
+            return -uavcan::ErrNotInited;
+        }
+        Worker& w = workers_[next_worker_];
+        next_worker_ = (next_worker_ + 1U) % num_threads_;
+        {
+            std::lock_guard<std::mutex> lock(w.mutex);
+            w.queue.pushBack(&task);
+        }
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex_);
+            num_queued_++;
+        }
+        idle_cv_.notify_one();
+        return 0;
+    }
+
+    virtual uavcan::ExecutorTask* popCompleted() override
+    {
+        std::lock_guard<std::mutex> lock(completed_mutex_);
+        uavcan::ExecutorTask* const task = completed_.get();
+        if (task == UAVCAN_NULLPTR)
+        {
+            uavcan::uint64_t counter = 0;
+            (void)::read(event_fd_, &counter, sizeof(counter));     // Resetting the readiness
+            return UAVCAN_NULLPTR;
+        }
+        completed_.remove(task);
+        return task;
+    }
+
+    /**
+     * Becomes readable when there are completed tasks; see @ref popCompleted().
+     */
+    int getCompletionFd() const { return event_fd_; }
+
+    unsigned getNumThreads() const { return num_threads_; }
+
+    uavcan::uint64_t getNumExecutedTasks() const { return num_executed_; }
+
+    /**
+     * Number of tasks executed by a worker other than the one they were queued to.
+     */
+    uavcan::uint64_t getNumStolenTasks() const { return num_stolen_; }
+};
+
+}
+
+#endif // Include guard
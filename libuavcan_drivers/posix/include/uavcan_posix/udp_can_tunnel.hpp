@@ -0,0 +1,1477 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_UDP_CAN_TUNNEL_HPP_INCLUDED
+#define UAVCAN_POSIX_UDP_CAN_TUNNEL_HPP_INCLUDED
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+
+#include <uavcan/driver/can.hpp>
+#include <uavcan/driver/system_clock.hpp>
+#include <uavcan/util/lazy_constructor.hpp>
+
+namespace uavcan_posix
+{
+/**
+ * Wire format of the CAN tunnel over UDP, see @ref UdpCanTunnelServer and @ref UdpCanTunnelDriver.
+ *
+ * Every datagram carries as many frames as fit into @ref MaxDatagramSize, so that a busy bus costs a few datagrams
+ * per millisecond rather than one per frame. Little endian.
+ *
+ * Datagram header:
+ *  - magic (4)
+ *  - sequence number (4), incremented with every datagram of the sender; a gap means that datagrams were lost
+ *  - number of records (2)
+ *  - number of interfaces of the sender (1)
+ *  - reserved (1)
+ *  - monotonic time of the sender when the datagram was sent, microseconds (8)
+ *
+ * Record:
+ *  - timestamp (8): for the frames from the bus, the monotonic timestamp of the frame on the server; for the
+ *    frames to be transmitted, the time left until the TX deadline, microseconds
+ *  - CAN ID (4)
+ *  - interface index (1)
+ *  - flags (1)
+ *  - DLC (1)
+ *  - as many data bytes as the DLC implies
+ *
+ * The timestamps are never compared across hosts: the receiver only uses the difference between the timestamp
+ * of the record and the timestamp of the datagram, which is how long the frame has been waiting in the batch.
+ * A datagram without records is a keepalive.
+ */
+class UdpCanTunnel
+{
+public:
+    enum { Magic = 0x31544355 };            ///< "UCT1"
+    enum { DefaultPort = 9382 };
+    enum { MaxDatagramSize = 1400 };        ///< Fits into the Ethernet MTU with the IP and UDP headers
+    enum { HeaderSize = 20 };
+    enum { RecordHeaderSize = 15 };
+
+    enum { RecordFlagCanFd = 1 };
+    enum { RecordFlagAbortOnError = 2 };
+
+    struct Header
+    {
+        uavcan::uint32_t seq;
+        uavcan::uint16_t num_records;
+        uavcan::uint8_t num_ifaces;
+        uavcan::uint64_t ts_usec;
+
+        Header()
+            : seq(0)
+            , num_records(0)
+            , num_ifaces(0)
+            , ts_usec(0)
+        { }
+    };
+
+    struct Record
+    {
+        uavcan::CanFrame frame;
+        uavcan::uint64_t ts_usec;
+        uavcan::uint8_t iface_index;
+        uavcan::CanIOFlags flags;
+
+        Record()
+            : ts_usec(0)
+            , iface_index(0)
+            , flags(0)
+        { }
+    };
+
+    static void writeU16(uavcan::uint8_t* p, uavcan::uint16_t x)
+    {
+        p[0] = uavcan::uint8_t(x & 0xFFU);
+        p[1] = uavcan::uint8_t(x >> 8);
+    }
+
+    static void writeU32(uavcan::uint8_t* p, uavcan::uint32_t x)
+    {
+        writeU16(p, uavcan::uint16_t(x & 0xFFFFU));
+        writeU16(p + 2, uavcan::uint16_t(x >> 16));
+    }
+
+    static void writeU64(uavcan::uint8_t* p, uavcan::uint64_t x)
+    {
+        writeU32(p, uavcan::uint32_t(x & 0xFFFFFFFFU));
+        writeU32(p + 4, uavcan::uint32_t(x >> 32));
+    }
+
+    static uavcan::uint16_t readU16(const uavcan::uint8_t* p)
+    {
+        return uavcan::uint16_t(p[0] | (p[1] << 8));
+    }
+
+    static uavcan::uint32_t readU32(const uavcan::uint8_t* p)
+    {
+        return uavcan::uint32_t(readU16(p)) | (uavcan::uint32_t(readU16(p + 2)) << 16);
+    }
+
+    static uavcan::uint64_t readU64(const uavcan::uint8_t* p)
+    {
+        return uavcan::uint64_t(readU32(p)) | (uavcan::uint64_t(readU32(p + 4)) << 32);
+    }
+
+    static void writeHeader(uavcan::uint8_t* p, const Header& header)
+    {
+        writeU32(p, uavcan::uint32_t(Magic));
+        writeU32(p + 4, header.seq);
+        writeU16(p + 8, header.num_records);
+        p[10] = header.num_ifaces;
+        p[11] = 0;
+        writeU64(p + 12, header.ts_usec);
+    }
+
+    static bool readHeader(const uavcan::uint8_t* p, unsigned size, Header& out_header)
+    {
+        if ((size < unsigned(HeaderSize)) || (readU32(p) != uavcan::uint32_t(Magic)))
+        {
+            return false;
+        }
+        out_header.seq = readU32(p + 4);
+        out_header.num_records = readU16(p + 8);
+        out_header.num_ifaces = p[10];
+        out_header.ts_usec = readU64(p + 12);
+        return true;
+    }
+
+    static unsigned getRecordLength(const uavcan::CanFrame& frame)
+    {
+        return unsigned(RecordHeaderSize) + uavcan::CanFrame::dlcToDataLength(frame.dlc);
+    }
+
+    /**
+     * The buffer must have room for @ref getRecordLength() bytes. Returns the length of the record.
+     */
+    static unsigned writeRecord(uavcan::uint8_t* p, const Record& rec)
+    {
+        const unsigned data_len = uavcan::CanFrame::dlcToDataLength(rec.frame.dlc);
+        writeU64(p, rec.ts_usec);
+        writeU32(p + 8, rec.frame.id);
+        p[12] = rec.iface_index;
+        p[13] = uavcan::uint8_t((rec.frame.canfd ? unsigned(RecordFlagCanFd) : 0U) |
+                                ((rec.flags & uavcan::CanIOFlagAbortOnError) ? unsigned(RecordFlagAbortOnError) : 0U));
+        p[14] = rec.frame.dlc;
+        (void)std::memcpy(p + RecordHeaderSize, rec.frame.data, data_len);
+        return unsigned(RecordHeaderSize) + data_len;
+    }
+
+    /**
+     * Returns the length of the record, or zero if it is malformed or does not fit into the given size.
+     */
+    static unsigned readRecord(const uavcan::uint8_t* p, unsigned size, Record& out_rec)
+    {
+        if (size < unsigned(RecordHeaderSize))
+        {
+            return 0;
+        }
+        const bool canfd = (p[13] & RecordFlagCanFd) != 0;
+        const uavcan::uint8_t dlc = p[14];
+        const unsigned data_len = uavcan::CanFrame::dlcToDataLength(dlc);
+        if ((dlc > 15) || (!canfd && (dlc > 8)) || (data_len > uavcan::CanFrame::MaxDataLen) ||
+            ((unsigned(RecordHeaderSize) + data_len) > size))
+        {
+            return 0;
+        }
+        out_rec.ts_usec = readU64(p);
+        out_rec.frame.id = readU32(p + 8);
+        out_rec.iface_index = p[12];
+        out_rec.flags = (p[13] & RecordFlagAbortOnError) ? uavcan::CanIOFlagAbortOnError : uavcan::CanIOFlags(0);
+        out_rec.frame.dlc = dlc;
+        out_rec.frame.canfd = canfd;
+        (void)std::memset(out_rec.frame.data, 0, uavcan::CanFrame::MaxDataLen);
+        (void)std::memcpy(out_rec.frame.data, p + RecordHeaderSize, data_len);
+        return unsigned(RecordHeaderSize) + data_len;
+    }
+
+    static bool isTemporaryError(int error)
+    {
+        return (error == EAGAIN) || (error == EWOULDBLOCK) || (error == ENOBUFS) || (error == EINTR);
+    }
+
+    /**
+     * Returns the socket descriptor or negative errno.
+     */
+    static int openSocket()
+    {
+        const int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        return (fd < 0) ? -errno : fd;
+    }
+
+    /**
+     * Datagrams that are being filled with records and waiting to be sent. The headers are written when the
+     * datagrams are sent, because the sequence numbers are assigned in the order of transmission.
+     */
+    class Batch : uavcan::Noncopyable
+    {
+    public:
+        enum { MaxDatagrams = 8 };
+
+    private:
+        uavcan::uint8_t buffers_[MaxDatagrams][MaxDatagramSize];
+        uavcan::uint16_t lengths_[MaxDatagrams];
+        uavcan::uint16_t num_records_[MaxDatagrams];
+        unsigned num_datagrams_;
+        uavcan::MonotonicTime start_ts_;
+
+        bool open(uavcan::MonotonicTime now)
+        {
+            if (num_datagrams_ >= MaxDatagrams)
+            {
+                return false;
+            }
+            if (num_datagrams_ == 0)
+            {
+                start_ts_ = now;
+            }
+            lengths_[num_datagrams_] = HeaderSize;
+            num_records_[num_datagrams_] = 0;
+            num_datagrams_++;
+            return true;
+        }
+
+    public:
+        Batch()
+            : num_datagrams_(0)
+        { }
+
+        /**
+         * Returns false if there is no room; nothing is appended then.
+         */
+        bool append(const Record& rec, uavcan::MonotonicTime now)
+        {
+            const unsigned len = getRecordLength(rec.frame);
+            if (((num_datagrams_ == 0) || ((lengths_[num_datagrams_ - 1] + len) > unsigned(MaxDatagramSize))) &&
+                !open(now))
+            {
+                return false;
+            }
+            const unsigned index = num_datagrams_ - 1U;
+            lengths_[index] = uavcan::uint16_t(lengths_[index] + writeRecord(&buffers_[index][lengths_[index]], rec));
+            num_records_[index]++;
+            return true;
+        }
+
+        /**
+         * Makes sure that at least one datagram will be sent, even if it has no records.
+         */
+        void appendKeepalive(uavcan::MonotonicTime now)
+        {
+            if (num_datagrams_ == 0)
+            {
+                (void)open(now);
+            }
+        }
+
+        bool isEmpty() const { return num_datagrams_ == 0; }
+
+        /**
+         * True if the batch may not have room for the next frame.
+         */
+        bool isFull() const
+        {
+            return (num_datagrams_ >= MaxDatagrams) &&
+                   ((lengths_[MaxDatagrams - 1] + unsigned(RecordHeaderSize) + uavcan::CanFrame::MaxDataLen) >
+                    unsigned(MaxDatagramSize));
+        }
+
+        unsigned getNumDatagrams() const { return num_datagrams_; }
+
+        /**
+         * When the first datagram of the batch was opened; the batch is due once the flush latency has elapsed.
+         */
+        uavcan::MonotonicTime getStartTime() const { return start_ts_; }
+
+        /**
+         * Writes the header of the datagram and points the IO vector to it.
+         */
+        void prepare(unsigned index, uavcan::uint32_t seq, uavcan::uint8_t num_ifaces, uavcan::MonotonicTime now,
+                     ::iovec& out_iovec)
+        {
+            UAVCAN_ASSERT(index < num_datagrams_);
+            Header header;
+            header.seq = seq;
+            header.num_records = num_records_[index];
+            header.num_ifaces = num_ifaces;
+            header.ts_usec = now.toUSec();
+            writeHeader(buffers_[index], header);
+            out_iovec.iov_base = buffers_[index];
+            out_iovec.iov_len = lengths_[index];
+        }
+
+        /**
+         * Removes the first datagrams, e.g. after they have been sent.
+         */
+        void remove(unsigned num)
+        {
+            num = uavcan::min(num, num_datagrams_);
+            for (unsigned i = num; i < num_datagrams_; i++)
+            {
+                (void)std::memcpy(buffers_[i - num], buffers_[i], lengths_[i]);
+                lengths_[i - num] = lengths_[i];
+                num_records_[i - num] = num_records_[i];
+            }
+            num_datagrams_ -= num;
+        }
+
+        void clear() { num_datagrams_ = 0; }
+    };
+};
+
+/**
+ * Server side of the CAN tunnel over UDP: gives the remote hosts access to the interfaces of a local driver,
+ * e.g. @ref SocketCanDriver. The remote hosts use @ref UdpCanTunnelDriver.
+ *
+ * The clients are learned from the datagrams they send, and are forgotten once they have been silent for
+ * @ref ClientTimeoutMs (the clients send keepalives). Every frame received from the bus is sent to every client;
+ * the frames are collected into per-client batches, which are sent once the oldest frame in the batch has been
+ * waiting for the flush latency, with one sendmmsg() call for all clients. The incoming datagrams are read in
+ * batches with recvmmsg().
+ *
+ * The frames of the clients are queued per interface and transmitted in the order of their CAN priority,
+ * like @ref SharedCanBusOwner does. They are transmitted with the loopback flag, and their loopback copies are sent
+ * to the other clients, so that the clients see each other's frames as if they were separate nodes on the bus.
+ * The physical driver must support loopback.
+ *
+ * The server cannot be woken up by the socket while it is blocked in the physical driver, so the socket is
+ * checked at least once per @ref getPollInterval(), which bounds the added latency in both directions.
+ *
+ * Typical use:
+ *
+ *      SocketCanDriver can(clock);
+ *      can.init();
+ *      can.addIface("can0");
+ *      UdpCanTunnelServer server(can, clock);
+ *      server.init(UdpCanTunnel::DefaultPort);
+ *      while (true) { server.spin(clock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(100)); }
+ */
+class UdpCanTunnelServer : uavcan::Noncopyable
+{
+public:
+    enum { MaxClients = 8 };
+    enum { ClientTimeoutMs = 3000 };
+    enum { MaxPendingTxFrames = 64 };           ///< Per interface
+    enum { DefaultPollIntervalUsec = 1000 };
+    enum { DefaultFlushLatencyUsec = 1000 };
+
+private:
+    enum { MaxPendingLoopbackFrames = 64 };
+    enum { RxBatchSize = 16 };                  ///< Datagrams per recvmmsg()
+    enum { CanRxBatchSize = 32 };
+    enum { MaxTxDatagrams = MaxClients * UdpCanTunnel::Batch::MaxDatagrams };
+
+    struct Client
+    {
+        ::sockaddr_in addr;
+        uavcan::MonotonicTime last_seen;
+        uavcan::uint32_t id;                    ///< Zero if the slot is free
+        uavcan::uint32_t tx_seq;
+        uavcan::uint32_t expected_rx_seq;
+        UdpCanTunnel::Batch batch;
+    };
+
+    struct PendingTx
+    {
+        uavcan::CanFrame frame;
+        uavcan::MonotonicTime deadline;
+        uavcan::uint32_t origin;
+        uavcan::CanIOFlags flags;
+    };
+
+    struct LoopbackEntry
+    {
+        uavcan::uint32_t id;
+        uavcan::uint32_t origin;
+    };
+
+    uavcan::ICanDriver& driver_;
+    const uavcan::ISystemClock& clock_;
+    int fd_;
+    uavcan::MonotonicDuration poll_interval_;
+    uavcan::MonotonicDuration flush_latency_;
+    uavcan::uint32_t next_client_id_;
+
+    Client clients_[MaxClients];
+
+    PendingTx pending_tx_[uavcan::MaxCanIfaces][MaxPendingTxFrames];
+    unsigned num_pending_tx_[uavcan::MaxCanIfaces];
+    LoopbackEntry loopback_[uavcan::MaxCanIfaces][MaxPendingLoopbackFrames];
+    unsigned loopback_head_[uavcan::MaxCanIfaces];
+    unsigned num_loopback_[uavcan::MaxCanIfaces];
+
+    uavcan::uint8_t rx_buffers_[RxBatchSize][UdpCanTunnel::MaxDatagramSize];
+    ::sockaddr_in rx_addrs_[RxBatchSize];
+    ::iovec rx_iovecs_[RxBatchSize];
+    ::mmsghdr rx_messages_[RxBatchSize];
+    ::iovec tx_iovecs_[MaxTxDatagrams];
+    ::mmsghdr tx_messages_[MaxTxDatagrams];
+    Client* tx_clients_[MaxTxDatagrams];
+
+    uavcan::uint64_t num_forwarded_frames_;
+    uavcan::uint64_t num_dropped_tx_frames_;
+    uavcan::uint64_t num_dropped_rx_frames_;
+    uavcan::uint64_t num_lost_datagrams_;
+
+    Client* findClient(const ::sockaddr_in& addr, uavcan::uint32_t seq)
+    {
+        Client* free_slot = UAVCAN_NULLPTR;
+        for (unsigned i = 0; i < MaxClients; i++)
+        {
+            Client& c = clients_[i];
+            if (c.id == 0)
+            {
+                free_slot = (free_slot == UAVCAN_NULLPTR) ? &c : free_slot;
+            }
+            else if ((c.addr.sin_addr.s_addr == addr.sin_addr.s_addr) && (c.addr.sin_port == addr.sin_port))
+            {
+                return &c;
+            }
+        }
+        if (free_slot != UAVCAN_NULLPTR)
+        {
+            free_slot->addr = addr;
+            free_slot->expected_rx_seq = seq;
+            free_slot->id = next_client_id_++;
+            next_client_id_ = (next_client_id_ == 0) ? 1U : next_client_id_;
+            free_slot->tx_seq = 0;
+            free_slot->batch.clear();
+        }
+        return free_slot;
+    }
+
+    void expireClients(uavcan::MonotonicTime now)
+    {
+        for (unsigned i = 0; i < MaxClients; i++)
+        {
+            if ((clients_[i].id != 0) &&
+                ((now - clients_[i].last_seen).toMSec() > ClientTimeoutMs))
+            {
+                clients_[i].id = 0;
+                clients_[i].batch.clear();
+            }
+        }
+    }
+
+    void processDatagram(const uavcan::uint8_t* data, unsigned size, const ::sockaddr_in& addr,
+                         uavcan::MonotonicTime now)
+    {
+        UdpCanTunnel::Header header;
+        if (!UdpCanTunnel::readHeader(data, size, header))
+        {
+            return;
+        }
+        Client* const client = findClient(addr, header.seq);
+        if (client == UAVCAN_NULLPTR)
+        {
+            return;                                 // No free slots
+        }
+        const uavcan::uint32_t gap = header.seq - client->expected_rx_seq;
+        if ((gap > 0) && (gap < 0x80000000U))
+        {
+            num_lost_datagrams_ += gap;
+        }
+        client->expected_rx_seq = header.seq + 1U;
+        client->last_seen = now;
+
+        unsigned offset = UdpCanTunnel::HeaderSize;
+        for (unsigned i = 0; i < header.num_records; i++)
+        {
+            UdpCanTunnel::Record rec;
+            const unsigned len = UdpCanTunnel::readRecord(data + offset, size - offset, rec);
+            if (len == 0)
+            {
+                break;
+            }
+            offset += len;
+
+            const uavcan::uint8_t iface = rec.iface_index;
+            if ((iface >= driver_.getNumIfaces()) || (num_pending_tx_[iface] >= MaxPendingTxFrames))
+            {
+                num_dropped_tx_frames_++;
+                continue;
+            }
+            PendingTx& p = pending_tx_[iface][num_pending_tx_[iface]++];
+            p.frame = rec.frame;
+            p.deadline = now + uavcan::MonotonicDuration::fromUSec(uavcan::int64_t(rec.ts_usec));
+            p.origin = client->id;
+            p.flags = rec.flags;
+        }
+    }
+
+    void readSocket()
+    {
+        while (true)
+        {
+            for (unsigned i = 0; i < RxBatchSize; i++)
+            {
+                rx_iovecs_[i].iov_base = rx_buffers_[i];
+                rx_iovecs_[i].iov_len = sizeof(rx_buffers_[i]);
+                ::msghdr& hdr = rx_messages_[i].msg_hdr;
+                (void)std::memset(&hdr, 0, sizeof(hdr));
+                hdr.msg_name = &rx_addrs_[i];
+                hdr.msg_namelen = sizeof(rx_addrs_[i]);
+                hdr.msg_iov = &rx_iovecs_[i];
+                hdr.msg_iovlen = 1;
+                rx_messages_[i].msg_len = 0;
+            }
+            const int res = ::recvmmsg(fd_, rx_messages_, RxBatchSize, MSG_DONTWAIT, UAVCAN_NULLPTR);
+            if (res <= 0)
+            {
+                break;
+            }
+            const uavcan::MonotonicTime now = clock_.getMonotonic();
+            for (unsigned i = 0; i < unsigned(res); i++)
+            {
+                if (rx_messages_[i].msg_hdr.msg_namelen == sizeof(::sockaddr_in))
+                {
+                    processDatagram(rx_buffers_[i], rx_messages_[i].msg_len, rx_addrs_[i], now);
+                }
+            }
+            if (unsigned(res) < RxBatchSize)
+            {
+                break;
+            }
+        }
+    }
+
+    /**
+     * Sends the batches that are due, or all of them if forced, with one system call.
+     */
+    void flush(uavcan::MonotonicTime now, bool force)
+    {
+        unsigned num_messages = 0;
+        for (unsigned i = 0; i < MaxClients; i++)
+        {
+            Client& c = clients_[i];
+            if ((c.id == 0) || c.batch.isEmpty() || (!force && ((c.batch.getStartTime() + flush_latency_) > now)))
+            {
+                continue;
+            }
+            for (unsigned k = 0; k < c.batch.getNumDatagrams(); k++)
+            {
+                c.batch.prepare(k, c.tx_seq + k, driver_.getNumIfaces(), now, tx_iovecs_[num_messages]);
+                ::msghdr& hdr = tx_messages_[num_messages].msg_hdr;
+                (void)std::memset(&hdr, 0, sizeof(hdr));
+                hdr.msg_name = &c.addr;
+                hdr.msg_namelen = sizeof(c.addr);
+                hdr.msg_iov = &tx_iovecs_[num_messages];
+                hdr.msg_iovlen = 1;
+                tx_clients_[num_messages] = &c;
+                num_messages++;
+            }
+        }
+
+        unsigned num_sent = 0;
+        while (num_sent < num_messages)
+        {
+            const int res = ::sendmmsg(fd_, tx_messages_ + num_sent, num_messages - num_sent, MSG_DONTWAIT);
+            if (res > 0)
+            {
+                num_sent += unsigned(res);
+            }
+            else if ((res < 0) && !UdpCanTunnel::isTemporaryError(errno))
+            {
+                num_sent++;                         // This datagram can't be sent, e.g. the client is unreachable
+            }
+            else
+            {
+                break;                              // The socket buffer is full, the rest will be sent later
+            }
+        }
+
+        // The datagrams of a client are contiguous and in order, so the sent ones are at the head of the batch
+        unsigned k = 0;
+        while (k < num_sent)
+        {
+            Client* const c = tx_clients_[k];
+            unsigned n = 0;
+            while (((k + n) < num_sent) && (tx_clients_[k + n] == c))
+            {
+                n++;
+            }
+            c->batch.remove(n);
+            c->tx_seq += n;
+            k += n;
+        }
+    }
+
+    void forward(const uavcan::CanRxFrame& frame, uavcan::uint32_t origin, uavcan::MonotonicTime now)
+    {
+        UdpCanTunnel::Record rec;
+        rec.frame = frame;
+        rec.ts_usec = frame.ts_mono.toUSec();
+        rec.iface_index = frame.iface_index;
+
+        for (unsigned i = 0; i < MaxClients; i++)
+        {
+            Client& c = clients_[i];
+            if ((c.id == 0) || (c.id == origin))
+            {
+                continue;
+            }
+            if (!c.batch.append(rec, now))
+            {
+                flush(now, true);
+                if (!c.batch.append(rec, now))
+                {
+                    num_dropped_rx_frames_++;
+                }
+            }
+        }
+        num_forwarded_frames_++;
+    }
+
+    void removePendingTx(uavcan::uint8_t iface_index, unsigned index)
+    {
+        num_pending_tx_[iface_index]--;
+        pending_tx_[iface_index][index] = pending_tx_[iface_index][num_pending_tx_[iface_index]];
+    }
+
+    /**
+     * Index of the pending frame of the highest priority; the expired frames are dropped on the way.
+     */
+    unsigned findTopPendingTx(uavcan::uint8_t iface_index, uavcan::MonotonicTime now)
+    {
+        unsigned top = MaxPendingTxFrames;
+        unsigned i = 0;
+        while (i < num_pending_tx_[iface_index])
+        {
+            const PendingTx& p = pending_tx_[iface_index][i];
+            if (p.deadline < now)
+            {
+                num_dropped_tx_frames_++;
+                removePendingTx(iface_index, i);
+                if (top == num_pending_tx_[iface_index])
+                {
+                    top = i;                    // The top entry has been moved into this place
+                }
+                continue;
+            }
+            if ((top == MaxPendingTxFrames) || p.frame.priorityHigherThan(pending_tx_[iface_index][top].frame))
+            {
+                top = i;
+            }
+            i++;
+        }
+        return top;
+    }
+
+    void transmit(uavcan::uint8_t iface_index, uavcan::MonotonicTime now)
+    {
+        uavcan::ICanIface* const iface = driver_.getIface(iface_index);
+        while (iface != UAVCAN_NULLPTR)
+        {
+            const unsigned top = findTopPendingTx(iface_index, now);
+            if (top == MaxPendingTxFrames)
+            {
+                break;
+            }
+            const PendingTx& p = pending_tx_[iface_index][top];
+            const uavcan::int16_t res = iface->send(p.frame, p.deadline,
+                                                    uavcan::CanIOFlags(p.flags | uavcan::CanIOFlagLoopback));
+            if (res == 0)
+            {
+                break;
+            }
+            if (res > 0)
+            {
+                const unsigned n = num_loopback_[iface_index];
+                LoopbackEntry& e =
+                    loopback_[iface_index][(loopback_head_[iface_index] + n) % MaxPendingLoopbackFrames];
+                e.id = p.frame.id;
+                e.origin = p.origin;
+                if (n < MaxPendingLoopbackFrames)
+                {
+                    num_loopback_[iface_index]++;
+                }
+                else
+                {
+                    loopback_head_[iface_index] = (loopback_head_[iface_index] + 1U) % MaxPendingLoopbackFrames;
+                }
+            }
+            else
+            {
+                num_dropped_tx_frames_++;
+            }
+            removePendingTx(iface_index, top);
+        }
+    }
+
+    /**
+     * Same as in @ref SharedCanBusOwner: the loopback frames come in the order of transmission.
+     */
+    bool matchLoopback(const uavcan::CanFrame& frame, uavcan::uint8_t iface_index, uavcan::uint32_t& out_origin)
+    {
+        while (num_loopback_[iface_index] > 0)
+        {
+            const LoopbackEntry& e = loopback_[iface_index][loopback_head_[iface_index]];
+            loopback_head_[iface_index] = (loopback_head_[iface_index] + 1U) % MaxPendingLoopbackFrames;
+            num_loopback_[iface_index]--;
+            if (e.id == frame.id)
+            {
+                out_origin = e.origin;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    unsigned receive(uavcan::uint8_t iface_index, uavcan::MonotonicTime now)
+    {
+        uavcan::ICanIface* const iface = driver_.getIface(iface_index);
+        if (iface == UAVCAN_NULLPTR)
+        {
+            return 0;
+        }
+        uavcan::CanRxFrame frames[CanRxBatchSize];
+        uavcan::CanIOFlags flags[CanRxBatchSize];
+        const uavcan::int16_t res = iface->receiveBatch(frames, flags, CanRxBatchSize);
+        unsigned num_forwarded = 0;
+        for (unsigned i = 0; i < ((res > 0) ? unsigned(res) : 0U); i++)
+        {
+            frames[i].iface_index = iface_index;
+            uavcan::uint32_t origin = 0;
+            if ((flags[i] & uavcan::CanIOFlagLoopback) && !matchLoopback(frames[i], iface_index, origin))
+            {
+                continue;
+            }
+            forward(frames[i], origin, now);
+            num_forwarded++;
+        }
+        return num_forwarded;
+    }
+
+    uavcan::MonotonicTime getEarliestFlushTime() const
+    {
+        uavcan::MonotonicTime ts;
+        for (unsigned i = 0; i < MaxClients; i++)
+        {
+            if ((clients_[i].id != 0) && !clients_[i].batch.isEmpty())
+            {
+                const uavcan::MonotonicTime due = clients_[i].batch.getStartTime() + flush_latency_;
+                ts = (ts.isZero() || (due < ts)) ? due : ts;
+            }
+        }
+        return ts;
+    }
+
+public:
+    UdpCanTunnelServer(uavcan::ICanDriver& driver, const uavcan::ISystemClock& clock)
+        : driver_(driver)
+        , clock_(clock)
+        , fd_(-1)
+        , poll_interval_(uavcan::MonotonicDuration::fromUSec(DefaultPollIntervalUsec))
+        , flush_latency_(uavcan::MonotonicDuration::fromUSec(DefaultFlushLatencyUsec))
+        , next_client_id_(1)
+        , num_forwarded_frames_(0)
+        , num_dropped_tx_frames_(0)
+        , num_dropped_rx_frames_(0)
+        , num_lost_datagrams_(0)
+    {
+        for (unsigned i = 0; i < MaxClients; i++)
+        {
+            (void)std::memset(&clients_[i].addr, 0, sizeof(clients_[i].addr));
+            clients_[i].id = 0;
+            clients_[i].tx_seq = 0;
+            clients_[i].expected_rx_seq = 0;
+        }
+        for (unsigned i = 0; i < uavcan::MaxCanIfaces; i++)
+        {
+            num_pending_tx_[i] = 0;
+            loopback_head_[i] = 0;
+            num_loopback_[i] = 0;
+        }
+    }
+
+    ~UdpCanTunnelServer()
+    {
+        if (fd_ >= 0)
+        {
+            (void)::close(fd_);
+        }
+    }
+
+    /**
+     * Binds the socket to the given UDP port on all local addresses. The interfaces of the driver must be opened
+     * beforehand. Returns negative errno.
+     */
+    int init(uavcan::uint16_t port = UdpCanTunnel::DefaultPort)
+    {
+        if (fd_ >= 0)
+        {
+            return -EALREADY;
+        }
+        const int fd = UdpCanTunnel::openSocket();
+        if (fd < 0)
+        {
+            return fd;
+        }
+        ::sockaddr_in addr;
+        (void)std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        if (::bind(fd, reinterpret_cast< ::sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            const int err = errno;
+            (void)::close(fd);
+            return -err;
+        }
+        fd_ = fd;
+        return 0;
+    }
+
+    /**
+     * Moves the frames between the interfaces and the clients; blocks until there is something to do or until
+     * the deadline, but no longer than @ref getPollInterval() or until the next batch is due.
+     * Returns the number of frames forwarded to the clients or negative error code.
+     */
+    int spinOnce(uavcan::MonotonicTime blocking_deadline)
+    {
+        if (fd_ < 0)
+        {
+            return -uavcan::ErrNotInited;
+        }
+        readSocket();
+
+        const uavcan::MonotonicTime now = clock_.getMonotonic();
+        expireClients(now);
+
+        uavcan::CanSelectMasks masks;
+        const uavcan::CanFrame* pending_tx[uavcan::MaxCanIfaces] = { };
+        const uavcan::uint8_t num_ifaces = uavcan::min(driver_.getNumIfaces(), uavcan::uint8_t(uavcan::MaxCanIfaces));
+        for (uavcan::uint8_t i = 0; i < num_ifaces; i++)
+        {
+            masks.read = uavcan::uint8_t(masks.read | (1U << i));
+            const unsigned top = findTopPendingTx(i, now);
+            if (top < MaxPendingTxFrames)
+            {
+                masks.write = uavcan::uint8_t(masks.write | (1U << i));
+                pending_tx[i] = &pending_tx_[i][top].frame;
+            }
+        }
+
+        uavcan::MonotonicTime wake_up = now + poll_interval_;
+        const uavcan::MonotonicTime flush_ts = getEarliestFlushTime();
+        if (!flush_ts.isZero() && (flush_ts < wake_up))
+        {
+            wake_up = flush_ts;
+        }
+        if (blocking_deadline < wake_up)
+        {
+            wake_up = blocking_deadline;
+        }
+        const uavcan::int16_t res = driver_.select(masks, pending_tx, wake_up);
+        if (res < 0)
+        {
+            return res;
+        }
+
+        unsigned num_forwarded = 0;
+        const uavcan::MonotonicTime io_ts = clock_.getMonotonic();
+        for (uavcan::uint8_t i = 0; i < num_ifaces; i++)
+        {
+            if (masks.read & (1U << i))
+            {
+                num_forwarded += receive(i, io_ts);
+            }
+            if (masks.write & (1U << i))
+            {
+                transmit(i, io_ts);
+            }
+        }
+
+        flush(clock_.getMonotonic(), false);
+        return int(num_forwarded);
+    }
+
+    /**
+     * Returns strictly when the deadline is reached, or on error.
+     * Returns the number of frames forwarded to the clients or negative error code.
+     */
+    int spin(uavcan::MonotonicTime deadline)
+    {
+        int num_forwarded = 0;
+        do
+        {
+            const int res = spinOnce(deadline);
+            if (res < 0)
+            {
+                return res;
+            }
+            num_forwarded += res;
+        }
+        while (clock_.getMonotonic() < deadline);
+        return num_forwarded;
+    }
+
+    uavcan::MonotonicDuration getPollInterval() const { return poll_interval_; }
+    void setPollInterval(uavcan::MonotonicDuration interval) { poll_interval_ = interval; }
+
+    /**
+     * How long a frame may wait in a batch before the batch is sent. Zero sends every batch at the end of
+     * @ref spinOnce(), which still packs the frames received from the bus in one go into one datagram.
+     */
+    uavcan::MonotonicDuration getFlushLatency() const { return flush_latency_; }
+    void setFlushLatency(uavcan::MonotonicDuration latency) { flush_latency_ = latency; }
+
+    unsigned getNumClients() const
+    {
+        unsigned n = 0;
+        for (unsigned i = 0; i < MaxClients; i++)
+        {
+            n += (clients_[i].id != 0) ? 1U : 0U;
+        }
+        return n;
+    }
+
+    uavcan::uint64_t getNumForwardedFrames() const { return num_forwarded_frames_; }
+
+    /**
+     * Frames of the clients that could not be queued, expired, or were rejected by the driver.
+     */
+    uavcan::uint64_t getNumDroppedTxFrames() const { return num_dropped_tx_frames_; }
+
+    /**
+     * Frames that could not be sent to a client because its socket buffer was full.
+     */
+    uavcan::uint64_t getNumDroppedRxFrames() const { return num_dropped_rx_frames_; }
+
+    /**
+     * Datagrams from the clients that were lost on the way, as detected by the gaps in the sequence numbers.
+     */
+    uavcan::uint64_t getNumLostDatagrams() const { return num_lost_datagrams_; }
+};
+
+/**
+ * CAN driver that accesses the interfaces of a remote host through @ref UdpCanTunnelServer.
+ *
+ * The frames sent by the library are collected into a batch, which is sent once its oldest frame has been waiting
+ * for the flush latency (see @ref setFlushLatency()), or when it is full; the batch is checked in @ref select(),
+ * which the library calls regularly. The TX deadlines are sent as the time left, so the clocks of the hosts
+ * need not be synchronized; the server transmits the frames in the order of their CAN priority.
+ *
+ * The received datagrams are read in batches with recvmmsg() into the RX ring. The monotonic timestamps of the
+ * received frames are reconstructed from the time the datagram arrived and the time the frame waited in the batch
+ * on the server; the network latency is not accounted for. The UTC timestamps are derived with the local clock.
+ *
+ * The loopback frames are produced locally once the datagram with the frame has been handed over to the kernel,
+ * so their timestamps are not the true transmission timestamps; the other clients of the server receive the frame
+ * when it has been transmitted on the bus. There are no acceptance filters, the frames are rejected by the library
+ * before they are parsed. The client sends a keepalive every @ref KeepaliveIntervalMs, so that the server does not
+ * forget it while the node is silent.
+ */
+class UdpCanTunnelDriver : public uavcan::ICanDriver, uavcan::Noncopyable
+{
+public:
+    enum { RxCapacity = 1024 };                 ///< Frames; must be a power of two
+    enum { DefaultFlushLatencyUsec = 1000 };
+    enum { KeepaliveIntervalMs = 1000 };
+
+private:
+    enum { RxBatchSize = 16 };                  ///< Datagrams per recvmmsg()
+    enum { MaxPendingLoopbackFrames = 64 };
+
+    class Iface : public uavcan::ICanIface
+    {
+        UdpCanTunnelDriver& owner_;
+        const uavcan::uint8_t index_;
+
+    public:
+        Iface(UdpCanTunnelDriver& owner, uavcan::uint8_t index)
+            : owner_(owner)
+            , index_(index)
+        { }
+
+        virtual uavcan::int16_t send(const uavcan::CanFrame& frame, uavcan::MonotonicTime tx_deadline,
+                                     uavcan::CanIOFlags flags)
+        {
+            return owner_.push(frame, tx_deadline, flags, index_);
+        }
+
+        virtual uavcan::int16_t sendBatch(const uavcan::CanFrame* const* frames,
+                                          const uavcan::MonotonicTime* tx_deadlines,
+                                          const uavcan::CanIOFlags* flags, uavcan::uint16_t num_frames)
+        {
+            if ((frames == UAVCAN_NULLPTR) || (tx_deadlines == UAVCAN_NULLPTR) || (flags == UAVCAN_NULLPTR))
+            {
+                UAVCAN_ASSERT(0);
+                return -uavcan::ErrInvalidParam;
+            }
+            uavcan::int16_t num_accepted = 0;
+            while (num_accepted < num_frames)
+            {
+                const uavcan::int16_t res = owner_.push(*frames[num_accepted], tx_deadlines[num_accepted],
+                                                        flags[num_accepted], index_);
+                if (res <= 0)
+                {
+                    return (num_accepted > 0) ? num_accepted : res;
+                }
+                num_accepted++;
+            }
+            return num_accepted;
+        }
+
+        virtual uavcan::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                                        uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags)
+        {
+            return owner_.take(index_, out_frame, out_ts_monotonic, out_ts_utc, out_flags);
+        }
+
+        virtual uavcan::int16_t configureFilters(const uavcan::CanFilterConfig*, uavcan::uint16_t) { return 0; }
+        virtual uavcan::uint16_t getNumFilters() const { return 0; }
+        virtual uavcan::uint64_t getErrorCount() const { return owner_.getNumSocketErrors(); }
+    };
+
+    struct RxEntry
+    {
+        uavcan::CanFrame frame;
+        uavcan::MonotonicTime ts;
+        uavcan::uint8_t iface_index;
+        bool loopback;
+    };
+
+    struct LoopbackEntry
+    {
+        RxEntry entry;
+        unsigned datagram_index;                ///< Within the TX batch
+    };
+
+    const uavcan::ISystemClock& clock_;
+    int fd_;
+    uavcan::LazyConstructor<Iface> ifaces_[uavcan::MaxCanIfaces];
+    uavcan::uint8_t num_ifaces_;
+    uavcan::MonotonicDuration flush_latency_;
+
+    UdpCanTunnel::Batch tx_batch_;
+    uavcan::uint32_t tx_seq_;
+    uavcan::MonotonicTime last_tx_ts_;
+    LoopbackEntry loopback_[MaxPendingLoopbackFrames];
+    unsigned num_loopback_;
+    ::iovec tx_iovecs_[UdpCanTunnel::Batch::MaxDatagrams];
+    ::mmsghdr tx_messages_[UdpCanTunnel::Batch::MaxDatagrams];
+
+    RxEntry rx_[RxCapacity];
+    uavcan::uint64_t rx_head_;
+    uavcan::uint64_t rx_tail_;
+    uavcan::uint8_t rx_buffers_[RxBatchSize][UdpCanTunnel::MaxDatagramSize];
+    ::iovec rx_iovecs_[RxBatchSize];
+    ::mmsghdr rx_messages_[RxBatchSize];
+    uavcan::uint32_t expected_rx_seq_;
+    bool rx_seq_known_;
+
+    uavcan::uint64_t num_rx_overruns_;
+    uavcan::uint64_t num_lost_datagrams_;
+    uavcan::uint64_t num_socket_errors_;
+
+    void pushRx(const RxEntry& entry)
+    {
+        if ((rx_head_ - rx_tail_) >= RxCapacity)
+        {
+            rx_tail_++;                             // Dropping the oldest frame
+            num_rx_overruns_++;
+        }
+        rx_[rx_head_ & (RxCapacity - 1U)] = entry;
+        rx_head_++;
+    }
+
+    /**
+     * Sends the batch, as much of it as the socket accepts. Returns false if nothing could be sent.
+     */
+    bool flush(uavcan::MonotonicTime now)
+    {
+        const unsigned num_messages = tx_batch_.getNumDatagrams();
+        if (num_messages == 0)
+        {
+            return true;
+        }
+        for (unsigned i = 0; i < num_messages; i++)
+        {
+            tx_batch_.prepare(i, tx_seq_ + i, num_ifaces_, now, tx_iovecs_[i]);
+            ::msghdr& hdr = tx_messages_[i].msg_hdr;
+            (void)std::memset(&hdr, 0, sizeof(hdr));
+            hdr.msg_iov = &tx_iovecs_[i];
+            hdr.msg_iovlen = 1;
+        }
+
+        unsigned num_sent = 0;
+        unsigned num_dropped = 0;
+        const int res = ::sendmmsg(fd_, tx_messages_, num_messages, MSG_DONTWAIT);
+        if (res > 0)
+        {
+            num_sent = unsigned(res);
+        }
+        else if ((res < 0) && !UdpCanTunnel::isTemporaryError(errno))
+        {
+            num_dropped = 1;                        // E.g. ECONNREFUSED while the server is down
+            num_socket_errors_++;
+        }
+        const unsigned num_removed = num_sent + num_dropped;
+        if (num_removed == 0)
+        {
+            return false;
+        }
+        tx_batch_.remove(num_removed);
+        tx_seq_ += num_removed;
+        last_tx_ts_ = now;
+
+        // The loopback frames of the sent datagrams are delivered; those of the dropped datagrams are lost
+        unsigned num_kept = 0;
+        for (unsigned i = 0; i < num_loopback_; i++)
+        {
+            LoopbackEntry& e = loopback_[i];
+            if (e.datagram_index < num_sent)
+            {
+                e.entry.ts = now;
+                pushRx(e.entry);
+            }
+            else if (e.datagram_index >= num_removed)
+            {
+                e.datagram_index -= num_removed;
+                loopback_[num_kept++] = e;
+            }
+        }
+        num_loopback_ = num_kept;
+        return true;
+    }
+
+    void processDatagram(const uavcan::uint8_t* data, unsigned size, uavcan::MonotonicTime now)
+    {
+        UdpCanTunnel::Header header;
+        if (!UdpCanTunnel::readHeader(data, size, header))
+        {
+            return;
+        }
+        if (rx_seq_known_)
+        {
+            const uavcan::uint32_t gap = header.seq - expected_rx_seq_;
+            if ((gap > 0) && (gap < 0x80000000U))
+            {
+                num_lost_datagrams_ += gap;
+            }
+        }
+        expected_rx_seq_ = header.seq + 1U;
+        rx_seq_known_ = true;
+
+        unsigned offset = UdpCanTunnel::HeaderSize;
+        for (unsigned i = 0; i < header.num_records; i++)
+        {
+            UdpCanTunnel::Record rec;
+            const unsigned len = UdpCanTunnel::readRecord(data + offset, size - offset, rec);
+            if (len == 0)
+            {
+                break;
+            }
+            offset += len;
+            if (rec.iface_index >= num_ifaces_)
+            {
+                continue;
+            }
+            // How long the frame had been waiting on the server before the datagram was sent
+            const uavcan::uint64_t age_usec = (header.ts_usec > rec.ts_usec) ? (header.ts_usec - rec.ts_usec) : 0U;
+            RxEntry entry;
+            entry.frame = rec.frame;
+            entry.ts = now - uavcan::MonotonicDuration::fromUSec(uavcan::int64_t(age_usec));
+            entry.iface_index = rec.iface_index;
+            entry.loopback = false;
+            pushRx(entry);
+        }
+    }
+
+    void readSocket()
+    {
+        while (true)
+        {
+            for (unsigned i = 0; i < RxBatchSize; i++)
+            {
+                rx_iovecs_[i].iov_base = rx_buffers_[i];
+                rx_iovecs_[i].iov_len = sizeof(rx_buffers_[i]);
+                ::msghdr& hdr = rx_messages_[i].msg_hdr;
+                (void)std::memset(&hdr, 0, sizeof(hdr));
+                hdr.msg_iov = &rx_iovecs_[i];
+                hdr.msg_iovlen = 1;
+                rx_messages_[i].msg_len = 0;
+            }
+            const int res = ::recvmmsg(fd_, rx_messages_, RxBatchSize, MSG_DONTWAIT, UAVCAN_NULLPTR);
+            if (res <= 0)
+            {
+                if ((res < 0) && !UdpCanTunnel::isTemporaryError(errno))
+                {
+                    num_socket_errors_++;
+                }
+                break;
+            }
+            const uavcan::MonotonicTime now = clock_.getMonotonic();
+            for (unsigned i = 0; i < unsigned(res); i++)
+            {
+                processDatagram(rx_buffers_[i], rx_messages_[i].msg_len, now);
+            }
+            if (unsigned(res) < RxBatchSize)
+            {
+                break;
+            }
+        }
+    }
+
+    /**
+     * Sends the batch if it is due, and the keepalive if nothing has been sent for a while.
+     */
+    void serviceTx(uavcan::MonotonicTime now)
+    {
+        if (!tx_batch_.isEmpty() && ((tx_batch_.getStartTime() + flush_latency_) <= now))
+        {
+            (void)flush(now);
+        }
+        if ((now - last_tx_ts_).toMSec() >= KeepaliveIntervalMs)
+        {
+            tx_batch_.appendKeepalive(now);
+            (void)flush(now);
+        }
+    }
+
+    uavcan::int16_t push(const uavcan::CanFrame& frame, uavcan::MonotonicTime tx_deadline, uavcan::CanIOFlags flags,
+                         uavcan::uint8_t iface_index)
+    {
+        const uavcan::MonotonicTime now = clock_.getMonotonic();
+        if (tx_deadline <= now)
+        {
+            return 1;                               // Expired, discarded
+        }
+        const bool loopback = (flags & uavcan::CanIOFlagLoopback) != 0;
+        if (loopback && (num_loopback_ >= MaxPendingLoopbackFrames) && (!flush(now) || (num_loopback_ > 0)))
+        {
+            return 0;
+        }
+
+        UdpCanTunnel::Record rec;
+        rec.frame = frame;
+        rec.ts_usec = uavcan::uint64_t((tx_deadline - now).toUSec());
+        rec.iface_index = iface_index;
+        rec.flags = flags;
+        if (!tx_batch_.append(rec, now) && (!flush(now) || !tx_batch_.append(rec, now)))
+        {
+            return 0;
+        }
+
+        if (loopback)
+        {
+            LoopbackEntry& e = loopback_[num_loopback_++];
+            e.entry.frame = frame;
+            e.entry.iface_index = iface_index;
+            e.entry.loopback = true;
+            e.datagram_index = tx_batch_.getNumDatagrams() - 1U;
+        }
+        if (flush_latency_.isZero())
+        {
+            (void)flush(now);
+        }
+        return 1;
+    }
+
+    uavcan::int16_t take(uavcan::uint8_t iface_index, uavcan::CanFrame& out_frame,
+                         uavcan::MonotonicTime& out_ts_monotonic, uavcan::UtcTime& out_ts_utc,
+                         uavcan::CanIOFlags& out_flags)
+    {
+        if (rx_head_ == rx_tail_)
+        {
+            readSocket();
+        }
+        if ((rx_head_ == rx_tail_) || (rx_[rx_tail_ & (RxCapacity - 1U)].iface_index != iface_index))
+        {
+            return 0;
+        }
+        const RxEntry& e = rx_[rx_tail_ & (RxCapacity - 1U)];
+        out_frame = e.frame;
+        out_ts_monotonic = e.ts;
+        out_ts_utc = clock_.getUtc() + uavcan::UtcDuration::fromUSec((e.ts - clock_.getMonotonic()).toUSec());
+        out_flags = e.loopback ? uavcan::CanIOFlagLoopback : uavcan::CanIOFlags(0);
+        rx_tail_++;
+        return 1;
+    }
+
+    uavcan::CanSelectMasks getReadyMasks(const uavcan::CanSelectMasks& requested) const
+    {
+        uavcan::CanSelectMasks out;
+        if (rx_head_ != rx_tail_)
+        {
+            out.read = uavcan::uint8_t(requested.read & (1U << rx_[rx_tail_ & (RxCapacity - 1U)].iface_index));
+        }
+        if (!tx_batch_.isFull())
+        {
+            out.write = uavcan::uint8_t(requested.write & ((1U << num_ifaces_) - 1U));
+        }
+        return out;
+    }
+
+public:
+    explicit UdpCanTunnelDriver(const uavcan::ISystemClock& clock)
+        : clock_(clock)
+        , fd_(-1)
+        , num_ifaces_(0)
+        , flush_latency_(uavcan::MonotonicDuration::fromUSec(DefaultFlushLatencyUsec))
+        , tx_seq_(0)
+        , num_loopback_(0)
+        , rx_head_(0)
+        , rx_tail_(0)
+        , expected_rx_seq_(0)
+        , rx_seq_known_(false)
+        , num_rx_overruns_(0)
+        , num_lost_datagrams_(0)
+        , num_socket_errors_(0)
+    { }
+
+    virtual ~UdpCanTunnelDriver()
+    {
+        for (unsigned i = 0; i < uavcan::MaxCanIfaces; i++)
+        {
+            ifaces_[i].destroy();
+        }
+        if (fd_ >= 0)
+        {
+            (void)::close(fd_);
+        }
+    }
+
+    /**
+     * Connects to the server, e.g. "192.168.0.10"; the number of interfaces must not exceed the number of the
+     * interfaces of the server. The server learns about this client from the first keepalive, which is sent here.
+     * Returns negative errno.
+     */
+    int init(const char* server_address, uavcan::uint16_t port = UdpCanTunnel::DefaultPort,
+             uavcan::uint8_t num_ifaces = 1)
+    {
+        if (fd_ >= 0)
+        {
+            return -EALREADY;
+        }
+        if ((server_address == UAVCAN_NULLPTR) || (num_ifaces == 0) || (num_ifaces > uavcan::MaxCanIfaces))
+        {
+            return -EINVAL;
+        }
+        ::sockaddr_in addr;
+        (void)std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (::inet_pton(AF_INET, server_address, &addr.sin_addr) != 1)
+        {
+            return -EINVAL;
+        }
+        const int fd = UdpCanTunnel::openSocket();
+        if (fd < 0)
+        {
+            return fd;
+        }
+        if (::connect(fd, reinterpret_cast< ::sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            const int err = errno;
+            (void)::close(fd);
+            return -err;
+        }
+        fd_ = fd;
+        num_ifaces_ = num_ifaces;
+        for (uavcan::uint8_t i = 0; i < num_ifaces_; i++)
+        {
+            ifaces_[i].construct<UdpCanTunnelDriver&, uavcan::uint8_t>(*this, i);
+        }
+        const uavcan::MonotonicTime now = clock_.getMonotonic();
+        tx_batch_.appendKeepalive(now);
+        (void)flush(now);
+        return 0;
+    }
+
+    virtual Iface* getIface(uavcan::uint8_t iface_index)
+    {
+        return (iface_index < num_ifaces_) ? static_cast<Iface*>(ifaces_[iface_index]) : UAVCAN_NULLPTR;
+    }
+
+    virtual uavcan::uint8_t getNumIfaces() const { return num_ifaces_; }
+
+    virtual uavcan::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                                   const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                                   uavcan::MonotonicTime blocking_deadline)
+    {
+        if (fd_ < 0)
+        {
+            return -uavcan::ErrNotInited;
+        }
+
+        uavcan::CanSelectMasks out;
+        while (true)
+        {
+            const uavcan::MonotonicTime now = clock_.getMonotonic();
+            serviceTx(now);
+            readSocket();
+            out = getReadyMasks(inout_masks);
+            if (((out.read | out.write) != 0) || (now >= blocking_deadline))
+            {
+                break;
+            }
+
+            uavcan::MonotonicTime wake_up = last_tx_ts_ + uavcan::MonotonicDuration::fromMSec(KeepaliveIntervalMs);
+            if (!tx_batch_.isEmpty() && ((tx_batch_.getStartTime() + flush_latency_) < wake_up))
+            {
+                wake_up = tx_batch_.getStartTime() + flush_latency_;
+            }
+            if (blocking_deadline < wake_up)
+            {
+                wake_up = blocking_deadline;
+            }
+            const uavcan::int64_t timeout_usec = uavcan::max(uavcan::int64_t(0), (wake_up - now).toUSec());
+            ::timespec ts;
+            ts.tv_sec = time_t(timeout_usec / 1000000);
+            ts.tv_nsec = long((timeout_usec % 1000000) * 1000);
+            ::pollfd pfd;
+            pfd.fd = fd_;
+            pfd.events = short(POLLIN | (tx_batch_.isFull() ? POLLOUT : 0));
+            pfd.revents = 0;
+            if ((::ppoll(&pfd, 1, &ts, UAVCAN_NULLPTR) < 0) && (errno != EINTR))
+            {
+                return -uavcan::ErrDriver;
+            }
+        }
+
+        inout_masks = out;
+        return uavcan::int16_t(((out.read | out.write) != 0) ? 1 : 0);
+    }
+
+    /**
+     * How long a frame may wait in the TX batch before the batch is sent; larger values save datagrams on a busy
+     * node at the cost of latency. Zero sends every frame right away.
+     */
+    uavcan::MonotonicDuration getFlushLatency() const { return flush_latency_; }
+    void setFlushLatency(uavcan::MonotonicDuration latency) { flush_latency_ = latency; }
+
+    /**
+     * Number of frames that were lost because the library did not read them out of the RX ring in time.
+     */
+    uavcan::uint64_t getNumRxOverruns() const { return num_rx_overruns_; }
+
+    /**
+     * Datagrams from the server that were lost on the way, as detected by the gaps in the sequence numbers.
+     */
+    uavcan::uint64_t getNumLostDatagrams() const { return num_lost_datagrams_; }
+
+    /**
+     * Failed socket operations, e.g. because the server is not running; reported as the error count of every
+     * interface.
+     */
+    uavcan::uint64_t getNumSocketErrors() const { return num_socket_errors_; }
+};
+
+}
+
+#endif // Include guard